@@ -6,10 +6,25 @@
 #ifndef BITSTREAMF_H
 #define BITSTREAMF_H
 
+#include <stdint.h>
+#include <string.h>
 
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#endif
+
+/* CONFIG_FLAC_DECODER_FAST_MEMORY: 热点代码放IRAM 查表放内部DRAM */
+#if CONFIG_FLAC_DECODER_FAST_MEMORY
+#define IBSS_ATTR   DRAM_ATTR
+#define ICONST_ATTR DRAM_ATTR
+#define ICODE_ATTR  IRAM_ATTR
+#else
 #define IBSS_ATTR
 #define ICONST_ATTR
 #define ICODE_ATTR
+#endif
 
 #ifndef ICODE_ATTR_FLAC
 #define ICODE_ATTR_FLAC ICODE_ATTR
@@ -95,7 +110,10 @@ static __inline uint32_t unaligned32(const void *v) {
 	
 	return ((struct Unaligned *)v)->i;
 */
-	return *(__packed unsigned long *)v;
+	/* Xtensa faults on unaligned l32i, let the compiler pick a safe load */
+	uint32_t x;
+	memcpy(&x, v, sizeof(x));
+	return x;
 }
 
 
@@ -145,7 +163,8 @@ for examples see get_bits, show_bits, skip_bits, get_vlc
 */
 
 static __inline int unaligned32_be(const void *v){
-	return betoh32(unaligned32(v));  // original
+	const uint8_t *p = (const uint8_t *)v;
+	return (int)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]);
 }
 
 static __inline int unaligned32_le(const void *v){
@@ -215,6 +234,16 @@ static __inline unsigned int get_bits(GetBitContext *s, int n){
     return tmp;
 }
 
+/* n可以超过MIN_CACHE_BITS 最多32位 分两次读 */
+static __inline int get_sbits_long(GetBitContext *s, int n){
+	if (n <= MIN_CACHE_BITS)
+		return get_sbits(s, n);
+	{
+		unsigned hi = (unsigned)get_sbits(s, n - 16);
+		return (int)((hi << 16) | get_bits(s, 16));
+	}
+}
+
 static __inline unsigned int show_bits(GetBitContext *s, int n){
 	register int tmp;
 	OPEN_READER(re, s)
@@ -0,0 +1,145 @@
+#include "flac_mc.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+
+static const char *TAG = "flac_mc";
+
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_done_sem;    // 汇合时还没做完才睡在这上面
+static int s_core = -1;
+static flac_mc_fn s_fn;
+static void *s_arg;
+static uint32_t s_posted;               // 交出的序号 只有交出的一方写
+static uint32_t s_done;                 // 做完的序号 只有另一个核写
+static uint32_t s_owner;                // 0是槽空着 交出的一方占到汇合 两个解码器同时跑时后来的自己做
+static uint32_t s_waiting;              // 汇合的一方要睡了 做完要给信号量
+static int64_t s_wait_frame[2];         // 这一帧在这个核上等了多久 记账时从忙的时间里扣掉 s_lock管着
+static flac_mc_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void worker_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t seq = __atomic_load_n(&s_posted, __ATOMIC_ACQUIRE);
+        if (seq == s_done)
+        {
+            continue;
+        }
+        int64_t t0 = esp_timer_get_time();
+        s_fn(s_arg);
+        int64_t us = esp_timer_get_time() - t0;
+        // 先发做完再看要不要叫 和汇合那边先挂等待再看做完对着 两边总有一边看得到对方
+        __atomic_store_n(&s_done, seq, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&s_waiting, __ATOMIC_SEQ_CST))
+        {
+            xSemaphoreGive(s_done_sem);
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.busy_us[s_core] += us;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+esp_err_t flac_mc_start(int core, int prio, int stack)
+{
+    if (s_task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_RETURN_ON_FALSE(core == 0 || core == 1, ESP_ERR_INVALID_ARG, TAG, "worker needs a pinned core");
+    s_done_sem = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(s_done_sem, ESP_ERR_NO_MEM, TAG, "semaphore alloc failed");
+    s_core = core;
+    if (xTaskCreatePinnedToCore(worker_task, "flac_mc", stack, NULL, prio, &s_task, core) != pdPASS)
+    {
+        vSemaphoreDelete(s_done_sem);
+        s_done_sem = NULL;
+        s_core = -1;
+        ESP_LOGE(TAG, "task create failed");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "stereo channel 0 restored on core %d", core);
+    return ESP_OK;
+}
+
+bool flac_mc_post(flac_mc_fn fn, void *arg)
+{
+    uint32_t idle = 0;
+    if (s_task == NULL || xPortGetCoreID() == s_core ||
+        !__atomic_compare_exchange_n(&s_owner, &idle, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.inline_jobs++;
+        portEXIT_CRITICAL(&s_lock);
+        return false;
+    }
+    s_fn = fn;
+    s_arg = arg;
+    __atomic_store_n(&s_posted, s_posted + 1, __ATOMIC_RELEASE);
+    xTaskNotifyGive(s_task);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.jobs++;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+void flac_mc_join(void)
+{
+    uint32_t seq = s_posted;
+    if (__atomic_load_n(&s_done, __ATOMIC_ACQUIRE) != seq)
+    {
+        int64_t t0 = esp_timer_get_time();
+        __atomic_store_n(&s_waiting, 1, __ATOMIC_SEQ_CST);
+        // 上次汇合时没用上的信号会让这里多转一圈
+        while (__atomic_load_n(&s_done, __ATOMIC_SEQ_CST) != seq)
+        {
+            xSemaphoreTake(s_done_sem, portMAX_DELAY);
+        }
+        __atomic_store_n(&s_waiting, 0, __ATOMIC_RELAXED);
+        int64_t us = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_lock);
+        s_wait_frame[xPortGetCoreID()] += us;
+        s_stats.waits++;
+        s_stats.wait_us += us;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    __atomic_store_n(&s_owner, 0, __ATOMIC_RELEASE);
+}
+
+int64_t flac_mc_now(void)
+{
+    return esp_timer_get_time();
+}
+
+void flac_mc_frame_done(int64_t t0_us, int blocksize, int samplerate)
+{
+    int core = xPortGetCoreID();
+    int64_t now = esp_timer_get_time();
+    // 交叉淡入时两个解码任务可能在同一个核上 等待的时间和别的任务共用 读和清都在锁里
+    portENTER_CRITICAL(&s_lock);
+    int64_t busy = now - t0_us - s_wait_frame[core];
+    s_wait_frame[core] = 0;
+    s_stats.frames++;
+    s_stats.busy_us[core] += busy > 0 ? busy : 0;
+    s_stats.audio_us += samplerate > 0 ? (int64_t)blocksize * 1000000 / samplerate : 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void flac_mc_get_stats(flac_mc_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    stats->worker_core = s_core;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _FLAC_MC_H
+#define _FLAC_MC_H
+
+/* 双核解码 立体声帧的两个子帧在比特流里是接着放的 第二个从哪开始要把第一个的残差全解完才知道
+ * 所以熵解码只能按顺序来 能拆开的是第一声道的预测还原:
+ *   解码核解完第一声道的残差 把还原交给另一个核 自己接着解第二声道的残差和还原 去相关之前汇合
+ * 交接是一个单生产者单消费者的槽 只用两个序号 交出和做完各自只有一边写 不上锁
+ * 另一个核正在做(交叉淡入时两个解码器)或调用者就在那个核上时 调用者自己还原
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#define FLAC_MC_MIN_BLOCKSIZE   1024    // 块太小 交接的开销比还原还大
+
+typedef void (*flac_mc_fn)(void *arg);
+
+typedef struct {
+    uint32_t frames;            // 记过账的帧
+    uint32_t jobs;              // 交给另一个核的还原
+    uint32_t inline_jobs;       // 另一个核忙着或就在那个核上 自己做的
+    uint32_t waits;             // 汇合时另一个核还没做完
+    uint64_t wait_us;
+    uint64_t audio_us;          // 解出来的音频时长
+    uint64_t busy_us[2];        // 每个核上解FLAC的时间 不算汇合的等待 除audio_us是解码占这个核的比例
+    int worker_core;            // -1是没启动
+} flac_mc_stats_t;
+
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+esp_err_t flac_mc_start(int core, int prio, int stack);    // 组件自己的任务 配置由应用的任务表给
+bool flac_mc_post(flac_mc_fn fn, void *arg);                // 交出去返回true 否则调用者自己做
+void flac_mc_join(void);                                    // 等交出去的做完 post返回true才调
+int64_t flac_mc_now(void);
+void flac_mc_frame_done(int64_t t0_us, int blocksize, int samplerate);  // 解码核上一帧做完
+void flac_mc_get_stats(flac_mc_stats_t *stats);
+#endif
+
+#endif
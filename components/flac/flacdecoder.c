@@ -37,6 +37,9 @@
 //#include "arm.h"
 #include "golomb.h"
 #include "flacdecoder.h"
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+#include "flac_mc.h"
+#endif
 
 
 #define FFMAX(a,b) ((a) > (b) ? (a) : (b))
@@ -48,7 +51,7 @@ static const int sample_rate_table[] ICONST_ATTR =
   0, 0, 0, 0 };
 
 static const int sample_size_table[] ICONST_ATTR = 
-{ 0, 8, 12, 0, 16, 20, 24, 0 };
+{ 0, 8, 12, 0, 16, 20, 24, 32 };
 
 static const int blocksize_table[] ICONST_ATTR = {
      0,    192, 576<<0, 576<<1, 576<<2, 576<<3,      0,      0, 
@@ -128,6 +131,78 @@ static int get_crc8(const uint8_t *buf, int count)
     return crc;
 }
 
+/* 整个Rice分区一次解完
+ * 64位缓存在整个分区期间留在寄存器里 不再每个样本都OPEN_READER/UPDATE_CACHE
+ * cache高位对齐 bits为其中有效位数 一元前缀用count leading zeros一次取出
+ * 读到帧尾之后补0 不越界读取 (p - buffer)*8 - bits 就是新的位置
+ */
+#define RICE_REFILL() \
+    do { \
+        if (bits < 32) { \
+            if (p + 4 <= end) { \
+                cache |= (uint64_t)(uint32_t)unaligned32_be(p) << (32 - bits); \
+                p += 4; \
+                bits += 32; \
+            } else { \
+                while (bits <= 56) { \
+                    cache |= (uint64_t)(p < end ? *p : 0) << (56 - bits); \
+                    p++; \
+                    bits += 8; \
+                } \
+            } \
+        } \
+    } while (0)
+
+static int decode_rice_partition(GetBitContext *gb, int32_t *out, int n, int k) ICODE_ATTR_FLAC;
+static int decode_rice_partition(GetBitContext *gb, int32_t *out, int n, int k)
+{
+    const uint8_t *p = gb->buffer + (gb->index >> 3);
+    const uint8_t *end = gb->buffer_end;
+    uint64_t cache = 0;
+    int bits = 0;
+    int skip = gb->index & 7;
+    int i;
+
+    RICE_REFILL();
+    cache <<= skip;
+    bits -= skip;
+
+    for (i = 0; i < n; i++) {
+        uint32_t q, u;
+
+        RICE_REFILL();
+        if (cache != 0 && (q = __builtin_clzll(cache)) + 1 + k <= (unsigned)bits) {
+            /* 常见情况 前缀和余数都在缓存里 */
+            cache <<= q;
+            u = (q << k) | (k ? (uint32_t)((cache << 1) >> (64 - k)) : 0);
+            cache <<= 1 + k;
+            bits -= q + 1 + k;
+        } else {
+            /* 长前缀跨越缓存 */
+            q = 0;
+            while (cache == 0) {
+                if (p > end + 8)
+                    return -1;
+                q += bits;
+                bits = 0;
+                RICE_REFILL();
+            }
+            u = __builtin_clzll(cache);
+            q += u;
+            cache <<= u + 1;
+            bits -= u + 1;
+            RICE_REFILL();
+            u = (q << k) | (k ? (uint32_t)(cache >> (64 - k)) : 0);
+            cache <<= k;
+            bits -= k;
+        }
+        out[i] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+    }
+
+    gb->index = (int)(p - gb->buffer) * 8 - bits;
+    return 0;
+}
+
 static int decode_residuals(FLACContext *s, int32_t* decoded, int pred_order) ICODE_ATTR_FLAC;
 static int decode_residuals(FLACContext *s, int32_t* decoded, int pred_order)
 {
@@ -154,13 +229,14 @@ static int decode_residuals(FLACContext *s, int32_t* decoded, int pred_order)
             //fprintf(stderr,"fixed len partition\n");
             tmp = get_bits(&s->gb, 5);
             for (; i < samples; i++, sample++)
-                decoded[sample] = get_sbits(&s->gb, tmp);
+                decoded[sample] = tmp ? get_sbits_long(&s->gb, tmp) : 0;
         }
         else
         {
-            for (; i < samples; i++, sample++){
-                decoded[sample] = get_sr_golomb_flac(&s->gb, tmp, INT_MAX, 0);
-            }
+            if (decode_rice_partition(&s->gb, decoded + sample, samples - i, tmp) < 0)
+                return -3;
+            sample += samples - i;
+            i = samples;
         }
         i= 0;
     }
@@ -168,20 +244,24 @@ static int decode_residuals(FLACContext *s, int32_t* decoded, int pred_order)
     return 0;
 }    
 
-static int decode_subframe_fixed(FLACContext *s, int32_t* decoded, int pred_order) ICODE_ATTR_FLAC;
-static int decode_subframe_fixed(FLACContext *s, int32_t* decoded, int pred_order)
+/* 立体声第一声道解完残差后 预测还原记在这里 双核时交给另一个核做(见flac_mc.h)
+ * 第二声道的残差在比特流里紧接着 调用者接着解 去相关之前等它做完
+ */
+typedef struct {
+    int32_t *decoded;
+    int coeffs[32];
+    int order, qlevel, wide;
+    int lpc;                    // 0定长预测 1 LPC
+    int wasted;
+    int blocksize;
+    int pending;                // 残差解完了 还没还原
+    int posted;                 // 交给另一个核了 还没汇合
+} restore_job;
+
+static int fixed_restore(int32_t *decoded, int pred_order, int blocksize) ICODE_ATTR_FLAC;
+static int fixed_restore(int32_t *decoded, int pred_order, int blocksize)
 {
-    const int blocksize = s->blocksize;
     int a, b, c, d, i;
-        
-    /* warm up samples */
-    for (i = 0; i < pred_order; i++)
-    {
-        decoded[i] = get_sbits(&s->gb, s->curr_bps);
-    }
-    
-    if (decode_residuals(s, decoded, pred_order) < 0)
-        return -4;
 
     a = decoded[pred_order-1];
     b = a - decoded[pred_order-2];
@@ -215,21 +295,242 @@ static int decode_subframe_fixed(FLACContext *s, int32_t* decoded, int pred_orde
     return 0;
 }
 
+/* job不为NULL时只解到残差 还原记进job由调用者安排 */
+static int decode_subframe_fixed(FLACContext *s, int32_t* decoded, int pred_order, restore_job *job) ICODE_ATTR_FLAC;
+static int decode_subframe_fixed(FLACContext *s, int32_t* decoded, int pred_order, restore_job *job)
+{
+    int i;
+
+    /* warm up samples */
+    for (i = 0; i < pred_order; i++)
+    {
+        decoded[i] = get_sbits_long(&s->gb, s->curr_bps);
+    }
+
+    if (decode_residuals(s, decoded, pred_order) < 0)
+        return -4;
+
+    if (job)
+    {
+        job->lpc = 0;
+        job->order = pred_order;
+        job->pending = 1;
+        return 0;
+    }
+    return fixed_restore(decoded, pred_order, s->blocksize);
+}
+
 
-/* level8 用到这个函数最多
- * 之前版本经过验证是不行的
- * 这个函数有arm汇编版,但移植不成功
- * 找了个C语言版本的,效率不高
+/* 最后一个声道是定长预测时 预测还原/去相关/交织输出在同一个循环里完成
+ * 还原后的样本只留在寄存器里 不再写回decoded再读一遍
+ * 阶数/声道模式/输出位宽都是常数实参 展开后每种组合一个专用循环
  */
-int decode_subframe_lpc(FLACContext *s, int32_t* decoded, int pred_order)
+enum {
+    OUT_MONO,           // 单声道 复制到左右
+    OUT_INDEPENDENT,
+    OUT_LEFT_SIDE,
+    OUT_RIGHT_SIDE,
+    OUT_MID_SIDE,
+};
+
+static __inline __attribute__((always_inline))
+void pcm_emit(void *wav, int i, int x, int y, int mode, int out32)
+{
+    int l, r;
+    switch (mode) {
+        case OUT_MONO:        l = y;     r = y;     break;
+        case OUT_INDEPENDENT: l = x;     r = y;     break;
+        case OUT_LEFT_SIDE:   l = x;     r = x - y; break;
+        case OUT_RIGHT_SIDE:  l = x + y; r = y;     break;
+        default:              x -= y >> 1; l = x + y; r = x; break;
+    }
+    if (out32) {
+        ((s32 *)wav)[2*i]   = l;
+        ((s32 *)wav)[2*i+1] = r;
+    } else {
+        ((s16 *)wav)[2*i]   = l;
+        ((s16 *)wav)[2*i+1] = r;
+    }
+}
+
+/* res: 预热样本+残差 ch0: 已还原的第一声道(单声道时不用) */
+static __inline __attribute__((always_inline))
+void fixed_out(const int32_t *res, const int32_t *ch0, void *wav, int blocksize,
+               int order, int mode, int out32, int wasted)
+{
+    int a = 0, b = 0, c = 0, d = 0, i;
+
+    for (i = 0; i < order; i++)
+        pcm_emit(wav, i, ch0[i], res[i] << wasted, mode, out32);
+
+    if (order >= 1) a = res[order-1];
+    if (order >= 2) b = a - res[order-2];
+    if (order >= 3) c = b - res[order-2] + res[order-3];
+    if (order >= 4) d = c - res[order-2] + 2*res[order-3] - res[order-4];
+
+    for (; i < blocksize; i++) {
+        int v;
+        switch (order) {
+            case 0:  v = res[i]; break;
+            case 1:  v = a += res[i]; break;
+            case 2:  v = a += b += res[i]; break;
+            case 3:  v = a += b += c += res[i]; break;
+            default: v = a += b += c += d += res[i]; break;
+        }
+        pcm_emit(wav, i, ch0[i], v << wasted, mode, out32);
+    }
+}
+
+#define FIXED_OUT_ORDERS(mode, out32) \
+    switch (order) { \
+        case 0: fixed_out(res, ch0, wav, blocksize, 0, mode, out32, wasted); break; \
+        case 1: fixed_out(res, ch0, wav, blocksize, 1, mode, out32, wasted); break; \
+        case 2: fixed_out(res, ch0, wav, blocksize, 2, mode, out32, wasted); break; \
+        case 3: fixed_out(res, ch0, wav, blocksize, 3, mode, out32, wasted); break; \
+        default: fixed_out(res, ch0, wav, blocksize, 4, mode, out32, wasted); break; \
+    }
+
+#define FIXED_OUT_MODES(out32) \
+    switch (mode) { \
+        case OUT_MONO:        FIXED_OUT_ORDERS(OUT_MONO, out32); break; \
+        case OUT_INDEPENDENT: FIXED_OUT_ORDERS(OUT_INDEPENDENT, out32); break; \
+        case OUT_LEFT_SIDE:   FIXED_OUT_ORDERS(OUT_LEFT_SIDE, out32); break; \
+        case OUT_RIGHT_SIDE:  FIXED_OUT_ORDERS(OUT_RIGHT_SIDE, out32); break; \
+        default:              FIXED_OUT_ORDERS(OUT_MID_SIDE, out32); break; \
+    }
+
+static void fixed_out_dispatch(const int32_t *res, const int32_t *ch0, void *wav, int blocksize,
+                               int order, int mode, int out32, int wasted) ICODE_ATTR_FLAC;
+static void fixed_out_dispatch(const int32_t *res, const int32_t *ch0, void *wav, int blocksize,
+                               int order, int mode, int out32, int wasted)
+{
+    if (out32) {
+        FIXED_OUT_MODES(1);
+    } else {
+        FIXED_OUT_MODES(0);
+    }
+}
+
+/* LPC还原 level8用到这个函数最多
+ * 递推的每个样本都依赖前一个输出 只能在阶数方向上展开
+ * 常见阶数(1~12)按常数阶展开成乘加链 系数常驻寄存器
+ * 累加位宽按流的上界选择: curr_bps + bitlen(sum|coeff|) <= 32 时32位累加不会溢出
+ * 否则(24bit和部分17bit side声道)走64位累加
+ */
+#define LPC_UNROLL_MAX 12
+
+static __inline __attribute__((always_inline))
+void lpc_restore_32(int32_t *decoded, const int *coeffs, int order, int qlevel, int blocksize)
+{
+    int i, j;
+    for (i = order; i < blocksize; i++) {
+        const int32_t *h = decoded + i;
+        int sum = 0;
+#pragma GCC unroll 12
+        for (j = 0; j < order; j++)
+            sum += coeffs[j] * h[-j-1];
+        decoded[i] += sum >> qlevel;
+    }
+}
+
+static __inline __attribute__((always_inline))
+void lpc_restore_64(int32_t *decoded, const int *coeffs, int order, int qlevel, int blocksize)
+{
+    int i, j;
+    for (i = order; i < blocksize; i++) {
+        const int32_t *h = decoded + i;
+        int64_t sum = 0;
+#pragma GCC unroll 12
+        for (j = 0; j < order; j++)
+            sum += (int64_t)coeffs[j] * h[-j-1];
+        decoded[i] += (int32_t)(sum >> qlevel);
+    }
+}
+
+/* 高阶(13~32)通用版本 每次算两个样本 共用历史样本的读取 */
+static void lpc_restore_32_generic(int32_t *decoded, const int *coeffs, int order, int qlevel, int blocksize) ICODE_ATTR_FLAC;
+static void lpc_restore_32_generic(int32_t *decoded, const int *coeffs, int order, int qlevel, int blocksize)
+{
+    int i, j;
+    for (i = order; i < blocksize-1; i += 2) {
+        int c;
+        int d = decoded[i-order];
+        int s0 = 0, s1 = 0;
+        for (j = order-1; j > 0; j--) {
+            c = coeffs[j];
+            s0 += c*d;
+            d = decoded[i-j];
+            s1 += c*d;
+        }
+        c = coeffs[0];
+        s0 += c*d;
+        d = decoded[i] += s0 >> qlevel;
+        s1 += c*d;
+        decoded[i+1] += s1 >> qlevel;
+    }
+    if (i < blocksize) {
+        int sum = 0;
+        for (j = 0; j < order; j++)
+            sum += coeffs[j] * decoded[i-j-1];
+        decoded[i] += sum >> qlevel;
+    }
+}
+
+static void lpc_restore_64_generic(int32_t *decoded, const int *coeffs, int order, int qlevel, int blocksize) ICODE_ATTR_FLAC;
+static void lpc_restore_64_generic(int32_t *decoded, const int *coeffs, int order, int qlevel, int blocksize)
+{
+    int i, j;
+    int64_t sum;
+    for (i = order; i < blocksize; i++) {
+        sum = 0;
+        for (j = 0; j < order; j++)
+            sum += (int64_t)coeffs[j] * decoded[i-j-1];
+        decoded[i] += sum >> qlevel;
+    }
+}
+
+/* |sum| <= 2^(curr_bps-1) * abs_sum 超过32位就要64位累加 */
+static __inline int lpc_need_wide(int curr_bps, unsigned abs_sum)
+{
+    return abs_sum && curr_bps + av_log2(abs_sum) + 1 > 32;
+}
+
+#define LPC_CASE(bits, n) \
+    case n: lpc_restore_##bits(decoded, coeffs, n, qlevel, blocksize); break
+
+static void lpc_restore(int32_t *decoded, const int *coeffs, int order, int qlevel,
+                        int blocksize, int wide) ICODE_ATTR_FLAC;
+static void lpc_restore(int32_t *decoded, const int *coeffs, int order, int qlevel,
+                        int blocksize, int wide)
+{
+    if (wide) {
+        switch (order) {
+            LPC_CASE(64, 1);  LPC_CASE(64, 2);  LPC_CASE(64, 3);  LPC_CASE(64, 4);
+            LPC_CASE(64, 5);  LPC_CASE(64, 6);  LPC_CASE(64, 7);  LPC_CASE(64, 8);
+            LPC_CASE(64, 9);  LPC_CASE(64, 10); LPC_CASE(64, 11); LPC_CASE(64, 12);
+            default: lpc_restore_64_generic(decoded, coeffs, order, qlevel, blocksize); break;
+        }
+    } else {
+        switch (order) {
+            LPC_CASE(32, 1);  LPC_CASE(32, 2);  LPC_CASE(32, 3);  LPC_CASE(32, 4);
+            LPC_CASE(32, 5);  LPC_CASE(32, 6);  LPC_CASE(32, 7);  LPC_CASE(32, 8);
+            LPC_CASE(32, 9);  LPC_CASE(32, 10); LPC_CASE(32, 11); LPC_CASE(32, 12);
+            default: lpc_restore_32_generic(decoded, coeffs, order, qlevel, blocksize); break;
+        }
+    }
+}
+
+int decode_subframe_lpc(FLACContext *s, int32_t* decoded, int pred_order, restore_job *job) ICODE_ATTR_FLAC;
+int decode_subframe_lpc(FLACContext *s, int32_t* decoded, int pred_order, restore_job *job)
 {
-     int i, j;
-     int coeff_prec, qlevel;
+     int i;
+     int coeff_prec, qlevel, wide;
      int coeffs[32];
+     unsigned abs_sum = 0;
  
      /* warm up samples */
      for (i = 0; i < pred_order; i++) {
-         decoded[i] = get_sbits(&s->gb, s->curr_bps);
+         decoded[i] = get_sbits_long(&s->gb, s->curr_bps);
      }
  
      coeff_prec = get_bits(&s->gb, 4) + 1;
@@ -246,49 +547,75 @@ int decode_subframe_lpc(FLACContext *s, int32_t* decoded, int pred_order)
  
      for (i = 0; i < pred_order; i++) {
         coeffs[i] = get_sbits(&s->gb, coeff_prec);
+        abs_sum += coeffs[i] < 0 ? -coeffs[i] : coeffs[i];
      }
  
      if (decode_residuals(s, decoded, pred_order) < 0)
          return -1;
- 
-     if (s->bps > 16) {
-         int64_t sum;
-         for (i = pred_order; i < s->blocksize; i++) {
-             sum = 0;
-             for (j = 0; j < pred_order; j++)
-                 sum += (int64_t)coeffs[j] * decoded[i-j-1];
-             decoded[i] += sum >> qlevel;
-         }
-     } else {
-         for (i = pred_order; i < s->blocksize-1; i += 2) {
-             int c;
-             int d = decoded[i-pred_order];
-             int s0 = 0, s1 = 0;
-             for (j = pred_order-1; j > 0; j--) {
-                 c = coeffs[j];
-                 s0 += c*d;
-                 d = decoded[i-j];
-                 s1 += c*d;
-             }
-             c = coeffs[0];
-             s0 += c*d;
-             d = decoded[i] += s0 >> qlevel;
-             s1 += c*d;
-             decoded[i+1] += s1 >> qlevel;
-         }
-         if (i < s->blocksize) {
-             int sum = 0;
-             for (j = 0; j < pred_order; j++)
-                 sum += coeffs[j] * decoded[i-j-1];
-             decoded[i] += sum >> qlevel;
-         }
+
+     wide = lpc_need_wide(s->curr_bps, abs_sum);
+     if (job) {
+         memcpy(job->coeffs, coeffs, pred_order * sizeof(int));
+         job->lpc = 1;
+         job->order = pred_order;
+         job->qlevel = qlevel;
+         job->wide = wide;
+         job->pending = 1;
+         return 0;
      }
- 
+     lpc_restore(decoded, coeffs, pred_order, qlevel, s->blocksize, wide);
+
      return 0;
 
 }
 
-static __inline int decode_subframe(FLACContext *s, int channel, int32_t* decoded)
+/* 还原记下来的声道 双核时在另一个核上跑 */
+static void restore_run(void *arg) ICODE_ATTR_FLAC;
+static void restore_run(void *arg)
+{
+    restore_job *job = (restore_job *)arg;
+    int i;
+
+    if (job->lpc)
+        lpc_restore(job->decoded, job->coeffs, job->order, job->qlevel, job->blocksize, job->wide);
+    else
+        fixed_restore(job->decoded, job->order, job->blocksize);
+    if (job->wasted)
+        for (i = 0; i < job->blocksize; i++)
+            job->decoded[i] <<= job->wasted;
+    job->pending = 0;
+}
+
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+static void restore_start(restore_job *job)
+{
+    if (job->pending && !(job->posted = flac_mc_post(restore_run, job)))
+        restore_run(job);
+}
+
+/* 第一声道还在另一个核上时 用它之前先等 */
+static void restore_wait(restore_job *job)
+{
+    if (job && job->posted) {
+        flac_mc_join();
+        job->posted = 0;
+    }
+}
+
+#define FRAME_T0()      int64_t frame_t0 = flac_mc_now()
+#define FRAME_DONE(s)   flac_mc_frame_done(frame_t0, (s)->blocksize, (s)->samplerate)
+#else
+#define restore_start(job)  do { if ((job)->pending) restore_run(job); } while (0)
+#define restore_wait(job)   ((void)(job))
+#define FRAME_T0()
+#define FRAME_DONE(s)
+#endif
+
+/* wav不为NULL表示这是最后一个声道 定长预测时直接输出交织PCM并返回1
+ * job: 第一声道时把预测还原记进去不做 最后一个声道直接输出前先等它做完
+ */
+static __inline int decode_subframe(FLACContext *s, int channel, int32_t* decoded, void *wav, int out32,
+                                    restore_job *job)
 {
     int type, wasted = 0;
     int i, tmp;
@@ -302,6 +629,11 @@ static __inline int decode_subframe(FLACContext *s, int channel, int32_t* decode
             s->curr_bps++;
     }
 
+    if (s->curr_bps > 32)
+    {
+        return -9;  // 32bit流的side声道需要33位 int32放不下
+    }
+
     if (get_bits1(&s->gb))
     {
         //fprintf(stderr,"invalid subframe padding\n");
@@ -336,7 +668,7 @@ static __inline int decode_subframe(FLACContext *s, int channel, int32_t* decode
     if (type == 0)
     {
         //fprintf(stderr,"coding type: constant\n");
-        tmp = get_sbits(&s->gb, s->curr_bps);
+        tmp = get_sbits_long(&s->gb, s->curr_bps);
         for (i = 0; i < s->blocksize; i++)
             decoded[i] = tmp;
     }
@@ -344,18 +676,31 @@ static __inline int decode_subframe(FLACContext *s, int channel, int32_t* decode
     {
         //fprintf(stderr,"coding type: verbatim\n");
         for (i = 0; i < s->blocksize; i++)
-            decoded[i] = get_sbits(&s->gb, s->curr_bps);
+            decoded[i] = get_sbits_long(&s->gb, s->curr_bps);
     }
     else if ((type >= 8) && (type <= 12))
     {
         //fprintf(stderr,"coding type: fixed\n");
-        if (decode_subframe_fixed(s, decoded, type & ~0x8) < 0)
+        if (wav)
+        {
+            int order = type & ~0x8;
+            for (i = 0; i < order; i++)
+                decoded[i] = get_sbits_long(&s->gb, s->curr_bps);
+            if (decode_residuals(s, decoded, order) < 0)
+                return -10;
+            restore_wait(job);
+            fixed_out_dispatch(decoded, s->decoded[0], wav, s->blocksize, order,
+                               s->channels == 1 ? OUT_MONO : OUT_INDEPENDENT + s->decorrelation,
+                               out32, wasted);
+            return 1;
+        }
+        if (decode_subframe_fixed(s, decoded, type & ~0x8, channel == 0 ? job : NULL) < 0)
             return -10;
     }
     else if (type >= 32)
     {
         //fprintf(stderr,"coding type: lpc\n");
-        if (decode_subframe_lpc(s, decoded, (type & ~0x20)+1) < 0)
+        if (decode_subframe_lpc(s, decoded, (type & ~0x20)+1, channel == 0 ? job : NULL) < 0)
             return -11;
     }
     else
@@ -363,7 +708,14 @@ static __inline int decode_subframe(FLACContext *s, int channel, int32_t* decode
         //fprintf(stderr,"Unknown coding type: %d\n",type);
         return -12;
     }
-        
+
+    if (channel == 0 && job && job->pending)
+    {
+        job->decoded = decoded;
+        job->blocksize = s->blocksize;
+        job->wasted = wasted;
+        return 0;
+    }
     if (wasted)
     {
         int i;
@@ -374,11 +726,16 @@ static __inline int decode_subframe(FLACContext *s, int channel, int32_t* decode
     return 0;
 }
 
-static int decode_frame(FLACContext *s) ICODE_ATTR_FLAC;
-static int decode_frame(FLACContext *s){
+/* 返回1表示最后一个声道已直接写好wav 不需要再交织 */
+static int decode_frame(FLACContext *s, void *wav, int out32) ICODE_ATTR_FLAC;
+static int decode_frame(FLACContext *s, void *wav, int out32){
 	int blocksize_code, sample_rate_code, sample_size_code, assignment, crc8;
 	int decorrelation, bps, blocksize, samplerate;
-	int res;
+	int res = 0, ch;
+	restore_job *mc = NULL;
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+	restore_job job;
+#endif
     
     blocksize_code = get_bits(&s->gb, 4);
 
@@ -397,7 +754,7 @@ static int decode_frame(FLACContext *s){
     sample_size_code = get_bits(&s->gb, 3);
     if(sample_size_code == 0)
         bps= s->bps;
-    else if((sample_size_code != 3) && (sample_size_code != 7))
+    else if(sample_size_code != 3)
         bps = sample_size_table[sample_size_code];
     else 
     {
@@ -465,24 +822,142 @@ static int decode_frame(FLACContext *s){
     s->decorrelation= (enum decorrelation_type)decorrelation;
 
     /* subframes */
-    if ((res=decode_subframe(s, 0, s->decoded0)) < 0){
-    	return res-100;
+    /* 单声道/立体声的最后一个声道可以直接输出 多声道要等全部声道解完再混音 */
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+    if (s->channels == 2 && blocksize >= FLAC_MC_MIN_BLOCKSIZE) {
+        job.pending = job.posted = 0;
+        mc = &job;
     }
-
-
-    if (s->channels==2) {
-      if ((res=decode_subframe(s, 1, s->decoded1)) < 0){
-    	  return res-200;
-      }
+#endif
+    for (ch = 0; ch < s->channels; ch++) {
+        void *out = (ch == s->channels-1 && s->channels <= 2) ? wav : NULL;
+        if ((res=decode_subframe(s, ch, s->decoded[ch], out, out32, mc)) < 0){
+            restore_wait(mc);   // 另一个核还在写decoded[0] 不能带着它返回
+            return res-100*(ch+1);
+        }
+        if (ch == 0 && mc)
+            restore_start(mc);
     }
+    restore_wait(mc);
     
     align_get_bits(&s->gb);
 
     /* frame footer */
     skip_bits(&s->gb, 16); /* data crc */
 
-    return 0;
+    return res;
 } 
+/* 多声道混成立体声的系数 Q15 每行和为32768 不会削顶
+ * 声道顺序按FLAC规定: 3:L R C  4:FL FR BL BR  5:FL FR FC BL BR  6:FL FR FC LFE BL BR
+ * 7:FL FR FC LFE BC SL SR  8:FL FR FC LFE BL BR SL SR
+ * 中置/环绕按-3dB并入 LFE丢弃
+ */
+static const int16_t downmix_table[FLAC_MAX_CHANNELS - 2][2][FLAC_MAX_CHANNELS] ICONST_ATTR = {
+    { { 19195, 0, 13573 },                               { 0, 19195, 13573 } },
+    { { 19195, 0, 13573, 0 },                            { 0, 19195, 0, 13573 } },
+    { { 13572, 0, 9598, 9598, 0 },                       { 0, 13572, 9598, 0, 9598 } },
+    { { 13572, 0, 9598, 0, 9598, 0 },                    { 0, 13572, 9598, 0, 0, 9598 } },
+    { { 11244, 0, 7951, 0, 5622, 7951, 0 },              { 0, 11244, 7951, 0, 5622, 0, 7951 } },
+    { { 10498, 0, 7423, 0, 7423, 0, 7423, 0 },           { 0, 10498, 7423, 0, 0, 7423, 0, 7423 } },
+};
+
+/* 大于2声道: 混音或交织在输出循环里完成 不经过中间缓冲
+ * 16位输出的乘加不超过2^30 32位累加即可; 32位输出最多2^46 用64位
+ */
+static void multichannel_out(FLACContext *s, void *wav, int out32) ICODE_ATTR_FLAC;
+static void multichannel_out(FLACContext *s, void *wav, int out32)
+{
+    const int n = s->channels;
+    int i, c;
+
+    if (!s->downmix) {
+        for (i = 0; i < s->blocksize; i++)
+            for (c = 0; c < n; c++) {
+                if (out32)
+                    ((s32 *)wav)[i*n + c] = s->decoded[c][i];
+                else
+                    ((s16 *)wav)[i*n + c] = s->decoded[c][i];
+            }
+        return;
+    }
+
+    const int16_t *wl = downmix_table[n - 3][0];
+    const int16_t *wr = downmix_table[n - 3][1];
+    if (out32) {
+        s32 *out = (s32 *)wav;
+        for (i = 0; i < s->blocksize; i++) {
+            int64_t l = 0, r = 0;
+            for (c = 0; c < n; c++) {
+                int x = s->decoded[c][i];
+                l += (int64_t)wl[c] * x;
+                r += (int64_t)wr[c] * x;
+            }
+            out[2*i]   = (s32)(l >> 15);
+            out[2*i+1] = (s32)(r >> 15);
+        }
+    } else {
+        s16 *out = (s16 *)wav;
+        for (i = 0; i < s->blocksize; i++) {
+            int l = 0, r = 0;
+            for (c = 0; c < n; c++) {
+                int x = s->decoded[c][i];
+                l += wl[c] * x;
+                r += wr[c] * x;
+            }
+            out[2*i]   = l >> 15;
+            out[2*i+1] = r >> 15;
+        }
+    }
+}
+
+/* 帧尾CRC-16(多项式0x8005 初值0) slice-by-4
+ * crc16_table[k][b] = 字节b后面再跟k个0字节的CRC 每次并行处理4个字节
+ * 表在第一次用到时生成 放在内部RAM的bss里
+ */
+static uint16_t crc16_table[4][256];
+static bool crc16_ready;
+
+static void crc16_init(void)
+{
+    int b, k, i;
+    for (b = 0; b < 256; b++) {
+        uint16_t crc = b << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1;
+        crc16_table[0][b] = crc;
+    }
+    for (k = 1; k < 4; k++)
+        for (b = 0; b < 256; b++) {
+            uint16_t prev = crc16_table[k-1][b];
+            crc16_table[k][b] = (prev << 8) ^ crc16_table[0][prev >> 8];
+        }
+    crc16_ready = true;
+}
+
+//校验一帧的CRC-16
+//buf:帧起始地址(同步字)
+//size:帧大小 包含末尾2字节CRC
+//返回值:0,校验通过
+//    -19,数据损坏
+int flac_check_crc16(const uint8_t *buf, int size)
+{
+    const uint16_t (*t)[256] = crc16_table;
+    unsigned crc = 0;
+
+    if (!crc16_ready)
+        crc16_init();
+
+    /* 整帧(含CRC本身)算下来余数为0即正确 */
+    for (; size >= 4; size -= 4, buf += 4) {
+        crc = t[3][(crc >> 8) ^ buf[0]] ^ t[2][(crc & 0xff) ^ buf[1]] ^
+              t[1][buf[2]] ^ t[0][buf[3]];
+    }
+    for (; size > 0; size--, buf++)
+        crc = ((crc << 8) & 0xffff) ^ t[0][(crc >> 8) ^ *buf];
+
+    return crc ? -19 : 0;
+}
+
 //查找下一帧起始地址
 //buf:输入数组
 //size:数组大小
@@ -497,6 +972,7 @@ int flac_seek_frame(uint8_t *buf,uint32_t size,FLACContext * fc)
 	uint32_t bps; 
 	uint8_t seekok=0;
 	p=buf;
+	if(size<4)return -1;
 	for(i=0;i<size-3;i++,p++)
 	{ 
 		if(p[0]==0XFF&&((p[1]&0XFC)==0XF8))//找到帧同步字(0XFFF8)
@@ -506,6 +982,7 @@ int flac_seek_frame(uint8_t *buf,uint32_t size,FLACContext * fc)
 			else if(samplerate>11)continue;
 			else samplerate=sample_rate_table[samplerate]; 
 			bps=sample_size_table[(p[3]&0X0F)>>1];//采样深度 16/24位
+			if(((p[3]&0X0F)>>1)==0)bps=fc->bps;	//位深编码为0时取STREAMINFO中的值
 			if(samplerate==fc->samplerate&&bps==fc->bps)
 			{
 				seekok=1;
@@ -526,19 +1003,29 @@ int flac_seek_frame(uint8_t *buf,uint32_t size,FLACContext * fc)
 int flac_decode_frame24(FLACContext *fc, uint8_t *buf, int buf_size, s32 *wavbuf)
 {
 	s32 sampleCnt, *ch0, *ch1; 
+	FRAME_T0();
 	
 	init_get_bits(&fc->gb, buf, buf_size*8);
 	skip_bits(&fc->gb, 16); 
-	if((sampleCnt=decode_frame(fc))<0)
+	if((sampleCnt=decode_frame(fc, wavbuf, 1))<0)
 	{
-		fc->bitstream_size=0;
-		fc->bitstream_index=0;
 		return sampleCnt;
 	} 
 	fc->framesize = (get_bits_count(&fc->gb)+7)>>3; 
+	if(sampleCnt)	//已经在解码时直接输出
+	{
+		FRAME_DONE(fc);
+		return 0;
+	}
+	if(fc->channels>2)
+	{
+		multichannel_out(fc, wavbuf, 1);
+		FRAME_DONE(fc);
+		return 0;
+	}
 	sampleCnt = fc->blocksize;
-	ch0=fc->decoded0;
-	ch1=fc->decoded1;
+	ch0=fc->decoded[0];
+	ch1=fc->decoded[1];
 
 	switch(fc->decorrelation)
 	{
@@ -591,6 +1078,7 @@ int flac_decode_frame24(FLACContext *fc, uint8_t *buf, int buf_size, s32 *wavbuf
 				*(wavbuf ++) = 0;
 			}while(-- sampleCnt);
 	} 
+	FRAME_DONE(fc);
 	return 0;
 }
 //解码一帧16位FLAC文件 
@@ -603,19 +1091,29 @@ int flac_decode_frame24(FLACContext *fc, uint8_t *buf, int buf_size, s32 *wavbuf
 int flac_decode_frame16(FLACContext *fc, uint8_t *buf, int buf_size, s16 *wavbuf)
 {
 	int sampleCnt, *ch0, *ch1; 
+	FRAME_T0();
 	
 	init_get_bits(&fc->gb, buf, buf_size*8);
 	skip_bits(&fc->gb, 16); 
-	if((sampleCnt=decode_frame(fc))<0)
+	if((sampleCnt=decode_frame(fc, wavbuf, 0))<0)
 	{
-		fc->bitstream_size=0;
-		fc->bitstream_index=0;
 		return sampleCnt;
 	} 
 	fc->framesize = (get_bits_count(&fc->gb)+7)>>3; 
+	if(sampleCnt)	//已经在解码时直接输出
+	{
+		FRAME_DONE(fc);
+		return 0;
+	}
+	if(fc->channels>2)
+	{
+		multichannel_out(fc, wavbuf, 0);
+		FRAME_DONE(fc);
+		return 0;
+	}
 	sampleCnt = fc->blocksize;
-	ch0=fc->decoded0;
-	ch1=fc->decoded1;
+	ch0=fc->decoded[0];
+	ch1=fc->decoded[1];
 
 	switch(fc->decorrelation)
 	{
@@ -668,6 +1166,7 @@ int flac_decode_frame16(FLACContext *fc, uint8_t *buf, int buf_size, s16 *wavbuf
 				*(wavbuf ++) = 0;
 			}while(-- sampleCnt);
 	} 
+	FRAME_DONE(fc);
 	return 0;
 }
 
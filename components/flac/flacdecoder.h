@@ -20,6 +20,8 @@ enum decorrelation_type {
 //#define RIGHT_SIDE   2
 //#define MID_SIDE     3
 
+#define FLAC_MAX_CHANNELS 8				//FLAC格式最多8声道
+
 //元数据块
 typedef struct FLACContext 
 {
@@ -38,17 +40,25 @@ typedef struct FLACContext
 	int seektable;  
 	int seekpoints; 
 
-	int bitstream_size; 
-	int bitstream_index;
+	int bitstream_size; 				  //输入缓冲区已填充的字节数 由调用者维护 解码核心不改
+	int bitstream_index;				  //输入缓冲区的读位置
 
 	int sample_skip; 				  //跳过的样本数 目标帧偏移量
 	int framesize; 					  //当前帧大小
 
-	int *decoded0;  // channel 0
-	int *decoded1;  // channel 1
+	int *decoded[FLAC_MAX_CHANNELS];	//每声道工作区 blocksize个样本 只需分配前channels个
+	int downmix;						//大于2声道时混成立体声输出 否则按声道交织输出
 }FLACContext;
 
-int flac_decode_frame24(FLACContext *s, uint8_t *buf, int buf_size, s32 *wavbuf);
-int flac_decode_frame16(FLACContext *s, uint8_t *buf, int buf_size, s16 *wavbuf);
+//decoded[]的分配属性 解码循环每个样本都要读写
+#if CONFIG_FLAC_DECODER_FAST_MEMORY
+#define FLAC_DECODED_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#else
+#define FLAC_DECODED_CAPS MALLOC_CAP_DEFAULT
+#endif
+
+int flac_decode_frame24(FLACContext *s, uint8_t *buf, int buf_size, s32 *wavbuf) ICODE_ATTR_FLAC;
+int flac_decode_frame16(FLACContext *s, uint8_t *buf, int buf_size, s16 *wavbuf) ICODE_ATTR_FLAC;
 int flac_seek_frame(uint8_t *buf,uint32_t size,FLACContext * fc);
+int flac_check_crc16(const uint8_t *buf, int size) ICODE_ATTR_FLAC;
 #endif
@@ -1,7 +1,8 @@
 #include <inttypes.h>
+#include "bitstreamf.h"
 
 /* From ffmpeg - libavutil/common.h */
-const uint8_t ff_log2_tab[256] = {
+const uint8_t ff_log2_tab[256] ICONST_ATTR = {
     0,0,1,1,2,2,2,2,3,3,3,3,3,3,3,3,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,
     5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,
     6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,
@@ -0,0 +1,724 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <sys/time.h>
+#include "alarm.h"
+#include "esp32_s3_szp.h"
+#include "audio_pcm.h"
+#include "audio_resample.h"
+#include "boot.h"
+#include "time_sync.h"
+#include "idle_mgr.h"
+#include "pm_ctl.h"
+#include "voice_memo.h"
+#include "multiroom.h"
+#include "ota_update.h"
+#include "task_plan.h"
+#include "mp3dec.h"
+#include "nvs.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "alarm";
+
+#define ALARM_NVS_KEY           "cfg"
+#define ALARM_KEY_GPIO          GPIO_NUM_0      // BOOT键 外部上拉 按下是低
+#define ALARM_SOUND_MAX_BYTES   (ALARM_SOUND_RATE * 2 * ALARM_SOUND_MAX_S)
+#define ALARM_SOUND_TMP         SPIFFS_BASE"/alarm.tmp"
+#define ALARM_PIECE_FRAMES      (ALARM_SOUND_RATE / 2)  // 醒着响铃时一段0.5秒 两段在队列里
+#define ALARM_DECODE_IN_BUF     4096
+
+extern const uint8_t sword_pcm_start[] asm("_binary_sword_pcm_start");
+extern const uint8_t sword_pcm_end[]   asm("_binary_sword_pcm_end");
+
+// 深度睡眠前记下 醒来用
+RTC_DATA_ATTR static int64_t s_rtc_alarm_us;   // 要响的闹钟 墙上时间 0是没有
+RTC_DATA_ATTR static int64_t s_rtc_wake_us;    // 定时器该叫醒的时刻
+RTC_DATA_ATTR static uint32_t s_rtc_boot_ms;   // 上次醒来到能出声
+RTC_DATA_ATTR static uint32_t s_rtc_lead_ms;
+RTC_DATA_ATTR static uint32_t s_rtc_sleeps;
+RTC_DATA_ATTR static uint32_t s_rtc_resleeps;
+
+typedef struct {
+    int16_t *pcm;                       // PSRAM 单声道
+    size_t frames;
+    uint32_t rate;
+    bool custom;
+} alarm_sound_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static alarm_cfg_t s_cfg;
+static bool s_cfg_loaded = false;
+static volatile bool s_cfg_changed = false;
+static alarm_stats_t s_stats;
+static TaskHandle_t s_task = NULL;
+static TaskHandle_t s_decode_task = NULL;
+
+// 醒着响铃
+static alarm_sound_t s_ring;
+static volatile bool s_ringing = false;
+static atomic_int s_ring_out = 0;       // 交给audio_pcm还没放完的段 放完在送数任务里减
+static size_t s_ring_pos = 0;
+
+static int64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void cfg_load(void)
+{
+    alarm_cfg_t cfg = {0};
+    nvs_handle_t nvs;
+    if (nvs_open(ALARM_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK)
+    {
+        size_t len = sizeof(cfg);
+        if (nvs_get_blob(nvs, ALARM_NVS_KEY, &cfg, &len) != ESP_OK || len != sizeof(cfg))
+        {
+            memset(&cfg, 0, sizeof(cfg)); // 结构体变化后的旧数据
+        }
+        nvs_close(nvs);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_cfg = cfg;
+    s_cfg_loaded = true;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static esp_err_t cfg_save(const alarm_cfg_t *cfg)
+{
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(ALARM_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs_open failed");
+    esp_err_t ret = nvs_set_blob(nvs, ALARM_NVS_KEY, cfg, sizeof(*cfg));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+// 只响一次的闹钟响过就关
+static void cfg_fired(void)
+{
+    alarm_cfg_t cfg;
+    alarm_get(&cfg);
+    if (cfg.enabled && cfg.days == 0)
+    {
+        cfg.enabled = false;
+        portENTER_CRITICAL(&s_lock);
+        s_cfg = cfg;
+        portEXIT_CRITICAL(&s_lock);
+        cfg_save(&cfg);
+    }
+}
+
+void alarm_get(alarm_cfg_t *cfg)
+{
+    if (!s_cfg_loaded)
+    {
+        cfg_load();
+    }
+    portENTER_CRITICAL(&s_lock);
+    *cfg = s_cfg;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+time_t alarm_next(time_t now)
+{
+    alarm_cfg_t cfg;
+    alarm_get(&cfg);
+    if (!cfg.enabled)
+    {
+        return 0;
+    }
+    struct tm tm;
+    localtime_r(&now, &tm);
+    for (int d = 0; d <= 7; d++)
+    {
+        struct tm t = tm;
+        t.tm_mday += d;
+        t.tm_hour = cfg.hour;
+        t.tm_min = cfg.minute;
+        t.tm_sec = 0;
+        t.tm_isdst = -1;
+        time_t at = mktime(&t); // 顺便把tm_wday算出来
+        if (at > now && (cfg.days == 0 || (cfg.days & (1 << t.tm_wday))))
+        {
+            return at;
+        }
+    }
+    return 0;
+}
+
+/*********************** 铃声 ****************************/
+static esp_err_t sound_load(alarm_sound_t *snd)
+{
+    memset(snd, 0, sizeof(*snd));
+    FILE *fp = fopen(ALARM_SOUND_PCM, "rb");
+    if (fp)
+    {
+        alarm_pcm_hdr_t hdr;
+        if (fread(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr) && memcmp(hdr.magic, "APCM", 4) == 0 &&
+            hdr.channels == 1 && hdr.rate && hdr.bytes >= 2 && hdr.bytes <= ALARM_SOUND_MAX_BYTES)
+        {
+            snd->pcm = heap_caps_malloc(hdr.bytes, MALLOC_CAP_SPIRAM);
+            if (snd->pcm && fread(snd->pcm, 1, hdr.bytes, fp) == hdr.bytes)
+            {
+                snd->frames = hdr.bytes / 2;
+                snd->rate = hdr.rate;
+                snd->custom = true;
+                fclose(fp);
+                return ESP_OK;
+            }
+            free(snd->pcm);
+            snd->pcm = NULL;
+        }
+        fclose(fp);
+        ESP_LOGW(TAG, "%s is not a valid sound, using the boot sound", ALARM_SOUND_PCM);
+    }
+    // 固件里的开机音 双声道 合成单声道
+    const int16_t *src = (const int16_t *)sword_pcm_start;
+    size_t frames = (sword_pcm_end - sword_pcm_start) / 4;
+    snd->pcm = heap_caps_malloc(frames * 2, MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(snd->pcm, ESP_ERR_NO_MEM, TAG, "no memory for the sound");
+    for (size_t i = 0; i < frames; i++)
+    {
+        snd->pcm[i] = (src[2 * i] + src[2 * i + 1]) / 2;
+    }
+    snd->frames = frames;
+    snd->rate = BOOT_PCM_SAMPLE_RATE;
+    return ESP_OK;
+}
+
+static void sound_free(alarm_sound_t *snd)
+{
+    free(snd->pcm);
+    snd->pcm = NULL;
+    snd->frames = 0;
+}
+
+// 单声道16位 转到ALARM_SOUND_RATE写进文件 返回写了多少字节
+static size_t decode_write(audio_resample_t *rs, const int16_t *in, size_t frames, int16_t *out, size_t out_frames,
+                           FILE *fp, size_t written)
+{
+    while (frames && written < ALARM_SOUND_MAX_BYTES)
+    {
+        size_t used = 0;
+        size_t n = audio_resample_process(rs, in, frames, out, out_frames, &used);
+        size_t bytes = n * 2;
+        if (bytes > ALARM_SOUND_MAX_BYTES - written)
+        {
+            bytes = ALARM_SOUND_MAX_BYTES - written;
+        }
+        if (bytes && fwrite(out, 1, bytes, fp) != bytes)
+        {
+            return ALARM_SOUND_MAX_BYTES + 1; // 写满了 当失败
+        }
+        written += bytes;
+        in += used;
+        frames -= used;
+        if (used == 0 && n == 0)
+        {
+            break;
+        }
+    }
+    return written;
+}
+
+// 解码卡上MP3的开头 先写临时文件 整个写完了再改名 半截的文件不会被当成铃声
+static esp_err_t decode_sound(void)
+{
+    esp_err_t ret = ESP_FAIL;
+    FILE *in = fopen(ALARM_SOUND_SRC, "rb");
+    ESP_RETURN_ON_FALSE(in, ESP_ERR_NOT_FOUND, TAG, "no %s", ALARM_SOUND_SRC);
+    FILE *out = fopen(ALARM_SOUND_TMP, "wb");
+    HMP3Decoder h = MP3InitDecoder();
+    uint8_t *buf = heap_caps_malloc(ALARM_DECODE_IN_BUF, MALLOC_CAP_SPIRAM);
+    int16_t *pcm = heap_caps_malloc(MAX_NSAMP * MAX_NGRAN * MAX_NCHAN * 2, MALLOC_CAP_SPIRAM);
+    int16_t *rs_out = heap_caps_malloc(RESAMPLE_BLOCK * 4 * 2, MALLOC_CAP_SPIRAM);
+    audio_resample_t rs = {0};
+    bool rs_ready = false;
+    alarm_pcm_hdr_t hdr = {.magic = {'A', 'P', 'C', 'M'}, .rate = ALARM_SOUND_RATE, .channels = 1};
+    size_t written = 0;
+    ESP_GOTO_ON_FALSE(out && h && buf && pcm && rs_out, ESP_ERR_NO_MEM, done, TAG, "decode setup failed");
+    fwrite(&hdr, 1, sizeof(hdr), out); // 长度最后再补
+
+    uint8_t *ptr = buf;
+    int left = 0;
+    bool eof = false, refill = true;
+    MP3FrameInfo fi;
+    while (written < ALARM_SOUND_MAX_BYTES)
+    {
+        if ((refill || left < ALARM_DECODE_IN_BUF / 2) && !eof)
+        {
+            memmove(buf, ptr, left);
+            ptr = buf;
+            size_t n = fread(buf + left, 1, ALARM_DECODE_IN_BUF - left, in);
+            eof = n < (size_t)(ALARM_DECODE_IN_BUF - left);
+            left += n;
+            refill = false;
+        }
+        int sync = MP3FindSyncWord(ptr, left);
+        if (sync < 0)
+        {
+            if (eof)
+            {
+                break;
+            }
+            left = 0;
+            continue;
+        }
+        ptr += sync;
+        left -= sync;
+        int err = MP3Decode(h, &ptr, &left, pcm, 0);
+        if (err == ERR_MP3_INDATA_UNDERFLOW)
+        {
+            if (eof)
+            {
+                break;
+            }
+            refill = true;
+            continue;
+        }
+        if (err == ERR_MP3_MAINDATA_UNDERFLOW)
+        {
+            continue;
+        }
+        if (err)
+        {
+            ptr++; // 假同步字 往后再找
+            left--;
+            continue;
+        }
+        MP3GetLastFrameInfo(h, &fi);
+        if (fi.nChans < 1 || fi.nChans > 2 || fi.samprate <= 0)
+        {
+            continue;
+        }
+        if (!rs_ready)
+        {
+            ESP_GOTO_ON_ERROR(audio_resample_init(&rs, fi.samprate, ALARM_SOUND_RATE, 1), done, TAG, "resample init failed");
+            rs_ready = true;
+        }
+        size_t frames = fi.outputSamps / fi.nChans;
+        if (fi.nChans == 2)
+        {
+            for (size_t i = 0; i < frames; i++)
+            {
+                pcm[i] = (pcm[2 * i] + pcm[2 * i + 1]) / 2;
+            }
+        }
+        written = decode_write(&rs, pcm, frames, rs_out, RESAMPLE_BLOCK * 4, out, written);
+        vTaskDelay(1); // 后台慢慢解 不占着SD卡和核
+    }
+    ESP_GOTO_ON_FALSE(written >= 2 && written <= ALARM_SOUND_MAX_BYTES, ESP_FAIL, done, TAG, "nothing decoded or SPIFFS full");
+    hdr.bytes = written & ~1u;
+    fseek(out, 0, SEEK_SET);
+    fwrite(&hdr, 1, sizeof(hdr), out);
+    ret = ESP_OK;
+done:
+    if (rs_ready)
+    {
+        audio_resample_deinit(&rs);
+    }
+    free(rs_out);
+    free(pcm);
+    free(buf);
+    if (h)
+    {
+        MP3FreeDecoder(h);
+    }
+    if (out && fclose(out) != 0)
+    {
+        ret = ESP_FAIL;
+    }
+    fclose(in);
+    if (ret == ESP_OK)
+    {
+        remove(ALARM_SOUND_PCM);
+        if (rename(ALARM_SOUND_TMP, ALARM_SOUND_PCM) != 0)
+        {
+            ret = ESP_FAIL;
+        }
+    }
+    if (ret != ESP_OK)
+    {
+        remove(ALARM_SOUND_TMP);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "alarm sound decoded, %u bytes at %d Hz", (unsigned)hdr.bytes, ALARM_SOUND_RATE);
+    }
+    return ret;
+}
+
+static void decode_task(void *arg)
+{
+    decode_sound();
+    s_decode_task = NULL;
+    vTaskDelete(NULL);
+}
+
+/*********************** 深度睡眠和快速开机 ****************************/
+static uint32_t lead_ms(int64_t sleep_us)
+{
+    uint32_t lead = s_rtc_boot_ms + ALARM_LEAD_MARGIN_MS;
+    if (lead < ALARM_LEAD_MIN_MS)
+    {
+        lead = ALARM_LEAD_MIN_MS;
+    }
+    return lead + (uint32_t)(sleep_us / 1000 * ALARM_DRIFT_PPM / 1000000);
+}
+
+void alarm_sleep(void)
+{
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+    time_t next = time_sync_valid() ? alarm_next(time(NULL)) : 0;
+    s_rtc_alarm_us = 0;
+    if (next)
+    {
+        int64_t now = wall_us();
+        int64_t alarm_us = (int64_t)next * 1000000;
+        uint32_t lead = lead_ms(alarm_us - now);
+        int64_t sleep_us = alarm_us - (int64_t)lead * 1000 - now;
+        if (sleep_us < ALARM_LEAD_MIN_MS * 1000LL)
+        {
+            ESP_LOGI(TAG, "alarm in %lld ms, staying awake", (alarm_us - now) / 1000);
+            return;
+        }
+        s_rtc_alarm_us = alarm_us;
+        s_rtc_wake_us = now + sleep_us;
+        s_rtc_lead_ms = lead;
+        esp_sleep_enable_timer_wakeup(sleep_us);
+    }
+    // BOOT键随时叫醒 正常开机
+    rtc_gpio_pullup_en(ALARM_KEY_GPIO);
+    rtc_gpio_pulldown_dis(ALARM_KEY_GPIO);
+    esp_sleep_enable_ext0_wakeup(ALARM_KEY_GPIO, 0);
+    s_rtc_sleeps++;
+    ESP_LOGI(TAG, "deep sleep, alarm %s, lead %lu ms", next ? "set" : "off", (unsigned long)s_rtc_lead_ms);
+    fflush(stdout);
+    esp_deep_sleep_start();
+}
+
+bool alarm_boot_pending(void)
+{
+    esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+    if (cause != ESP_SLEEP_WAKEUP_UNDEFINED)
+    {
+        rtc_gpio_deinit(ALARM_KEY_GPIO); // 睡前接到了RTC上 换回普通GPIO
+    }
+    if (cause != ESP_SLEEP_WAKEUP_TIMER)
+    {
+        s_rtc_alarm_us = 0;
+    }
+    return s_rtc_alarm_us != 0;
+}
+
+static bool boot_touched(void)
+{
+    return gpio_get_level(ALARM_KEY_GPIO) == 0 || bsp_touch_pressed_raw();
+}
+
+// 走开机音的预装路径一遍遍放 没人碰就放ALARM_RING_S秒 返回有没有人碰
+static bool boot_ring(const alarm_sound_t *snd, int64_t alarm_us)
+{
+    const uint8_t *data = (const uint8_t *)snd->pcm;
+    size_t len = snd->frames * 2;
+    size_t chunk = snd->rate * 2 * ALARM_POLL_MS / 1000;
+    int64_t t0 = esp_timer_get_time();
+    bool touched = false;
+    bool first = true;
+    while (!touched && esp_timer_get_time() - t0 < ALARM_RING_S * 1000000LL)
+    {
+        size_t off = 0;
+        if (bsp_pcm_preload(data, len, snd->rate, I2S_SLOT_MODE_MONO, &off) != ESP_OK)
+        {
+            break;
+        }
+        if (first)
+        {
+            s_stats.late_ms = (int32_t)((wall_us() - alarm_us) / 1000); // 通道一打开预装的就出去了
+            first = false;
+        }
+        while (off < len && !touched)
+        {
+            size_t n = len - off < chunk ? len - off : chunk, w = 0;
+            if (bsp_i2s_write((void *)(data + off), n, &w, 1000) != ESP_OK)
+            {
+                break;
+            }
+            off += w;
+            touched = boot_touched();
+        }
+        // 等DMA发完再停一下 接着读触摸
+        int64_t gap_end = esp_timer_get_time() + ALARM_GAP_MS * 1000;
+        int64_t deadline = esp_timer_get_time() + BOOT_PCM_TIMEOUT_MS * 1000LL;
+        while (!touched && esp_timer_get_time() < deadline &&
+               (!(xEventGroupGetBits(my_event_group) & START_MUSIC_COMPLETED) || esp_timer_get_time() < gap_end))
+        {
+            vTaskDelay(pdMS_TO_TICKS(ALARM_POLL_MS));
+            touched = boot_touched();
+        }
+    }
+    bsp_pcm_preload_stop();
+    return touched;
+}
+
+esp_err_t alarm_boot_run(void)
+{
+    s_stats.fast_boot = true;
+    int64_t alarm_us = s_rtc_alarm_us;
+    s_rtc_alarm_us = 0;
+    gpio_config_t key = {
+        .pin_bit_mask = BIT64(ALARM_KEY_GPIO),
+        .mode = GPIO_MODE_INPUT,
+    };
+    gpio_config(&key);
+
+    // 醒早了 定时器的误差比预想的大 再睡一小觉
+    int64_t early_us = alarm_us - wall_us();
+    if (early_us > ALARM_RESLEEP_S * 1000000LL)
+    {
+        s_rtc_resleeps++;
+        ESP_LOGI(TAG, "woke %lld s early, sleeping again", early_us / 1000000);
+        alarm_sleep();
+    }
+
+    boot_stage_begin(BOOT_STAGE_CODEC);
+    esp_err_t ret = bsp_codec_init();
+    boot_stage_done(BOOT_STAGE_CODEC, ret);
+    boot_stage_begin(BOOT_STAGE_SPIFFS);
+    boot_stage_done(BOOT_STAGE_SPIFFS, bsp_spiffs_mount());
+    ESP_RETURN_ON_ERROR(ret, TAG, "codec failed, normal boot");
+
+    int64_t l0 = esp_timer_get_time();
+    alarm_sound_t snd;
+    ESP_RETURN_ON_ERROR(sound_load(&snd), TAG, "no sound, normal boot");
+    s_stats.load_ms = (esp_timer_get_time() - l0) / 1000;
+    s_stats.app_ms = esp_timer_get_time() / 1000;
+    int64_t ready = wall_us() - s_rtc_wake_us;
+    s_stats.boot_ms = ready > 0 ? ready / 1000 : 0;
+    s_stats.lead_ms = s_rtc_lead_ms;
+    s_stats.sound_rate = snd.rate;
+    s_stats.sound_bytes = snd.frames * 2;
+    s_stats.sound_custom = snd.custom;
+    s_rtc_boot_ms = s_stats.boot_ms; // 下次的提前量按这次的算
+
+    // 等到点 这中间碰了就当醒了 到点由醒着的闹钟任务响
+    bool touched = false;
+    while (!touched && wall_us() < alarm_us)
+    {
+        vTaskDelay(pdMS_TO_TICKS(ALARM_POLL_MS));
+        touched = boot_touched();
+    }
+    if (!touched)
+    {
+        touched = boot_ring(&snd, alarm_us);
+        cfg_fired();
+    }
+    sound_free(&snd);
+    ESP_LOGI(TAG, "fast boot: ready %lu ms after wake (app %lu ms, load %lu ms), sound %ld ms late, %s",
+             (unsigned long)s_stats.boot_ms, (unsigned long)s_stats.app_ms, (unsigned long)s_stats.load_ms,
+             (long)s_stats.late_ms, touched ? "touched" : "no one there");
+    s_stats.touched = touched;
+    if (!touched)
+    {
+        alarm_sleep();
+    }
+    return ESP_OK;
+}
+
+/*********************** 醒着的时候 ****************************/
+static esp_err_t ring_queue(void);
+
+// 在送数任务里 接着排下一段
+static void ring_piece_done(void *arg)
+{
+    s_ring_out--;
+    if (s_ringing)
+    {
+        ring_queue();
+    }
+}
+
+static esp_err_t ring_queue(void)
+{
+    size_t n = s_ring.frames - s_ring_pos;
+    if (n > ALARM_PIECE_FRAMES)
+    {
+        n = ALARM_PIECE_FRAMES;
+    }
+    s_ring_out++;
+    esp_err_t ret = audio_pcm_prompt(s_ring.pcm + s_ring_pos, n, s_ring.rate, ring_piece_done, NULL);
+    if (ret != ESP_OK)
+    {
+        s_ring_out--;
+        return ret;
+    }
+    s_ring_pos += n;
+    if (s_ring_pos >= s_ring.frames)
+    {
+        s_ring_pos = 0;
+    }
+    return ESP_OK;
+}
+
+// 点亮屏幕 混在歌里响 碰一下屏幕或者ALARM_RING_S秒停
+static void awake_ring(void)
+{
+    if (audio_pcm_init(AUDIO_PCM_RING_MS_DEFAULT) != ESP_OK || sound_load(&s_ring) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "cannot ring");
+        return;
+    }
+    s_stats.rings++;
+    s_stats.sound_rate = s_ring.rate;
+    s_stats.sound_bytes = s_ring.frames * 2;
+    s_stats.sound_custom = s_ring.custom;
+    bool own_pm = !pm_ctl_held(PM_CLIENT_AUDIO); // 在放歌就是播放器拿着 不替它放
+    if (own_pm)
+    {
+        pm_ctl_set(PM_CLIENT_AUDIO, true);
+    }
+    idle_mgr_kick();
+    bsp_touch_stats_t ts;
+    bsp_touch_get_stats(&ts);
+    uint32_t presses = ts.presses;
+
+    s_ring_pos = 0;
+    s_ringing = true;
+    ring_queue();
+    ring_queue();
+    for (int t = 0; t < ALARM_RING_S * 1000 / ALARM_POLL_MS; t++)
+    {
+        vTaskDelay(pdMS_TO_TICKS(ALARM_POLL_MS));
+        bsp_touch_get_stats(&ts);
+        if (ts.presses != presses || gpio_get_level(ALARM_KEY_GPIO) == 0)
+        {
+            break;
+        }
+        if (s_ring_out == 0)
+        {
+            ring_queue(); // 队列满丢过
+        }
+    }
+    s_ringing = false;
+    while (s_ring_out > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS(ALARM_POLL_MS)); // 排着的段放完才能释放
+    }
+    sound_free(&s_ring);
+    if (own_pm)
+    {
+        pm_ctl_set(PM_CLIENT_AUDIO, false);
+    }
+}
+
+// 熄屏了 没有在放歌 录音 拍照 同步播放 升级固件
+static bool can_sleep(void)
+{
+    ota_update_stats_t ou;
+    ota_update_get_stats(&ou);
+    return idle_mgr_state() == IDLE_OFF && !pm_ctl_held(PM_CLIENT_CAMERA) && !pm_ctl_held(PM_CLIENT_AUDIO) &&
+           !voice_memo_active() && multiroom_role() == MULTIROOM_OFF && s_decode_task == NULL &&
+           (ou.state == OTA_UPDATE_IDLE || ou.state == OTA_UPDATE_FAILED);
+}
+
+static void alarm_task(void *arg)
+{
+    time_t armed = 0;
+    int64_t off_since = 0;
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(ALARM_CHECK_MS));
+        if (!time_sync_valid())
+        {
+            continue;
+        }
+        time_t now = time(NULL);
+        if (s_cfg_changed || armed == 0)
+        {
+            s_cfg_changed = false;
+            armed = alarm_next(now);
+        }
+        if (armed && now >= armed)
+        {
+            if (now - armed < ALARM_LATE_S)
+            {
+                ESP_LOGI(TAG, "ringing");
+                cfg_fired();
+                awake_ring();
+            }
+            armed = alarm_next(time(NULL));
+        }
+
+        if (ALARM_SLEEP_AFTER_S == 0 || armed == 0 || !can_sleep())
+        {
+            off_since = 0;
+            continue;
+        }
+        int64_t t = esp_timer_get_time();
+        if (off_since == 0)
+        {
+            off_since = t;
+        }
+        else if (t - off_since >= ALARM_SLEEP_AFTER_S * 1000000LL)
+        {
+            alarm_sleep(); // 离闹钟太近会返回 下一次再看
+            off_since = 0;
+        }
+    }
+}
+
+esp_err_t alarm_start(void)
+{
+    if (s_task)
+    {
+        return ESP_OK;
+    }
+    cfg_load();
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_ALARM, alarm_task, NULL, &s_task) == pdPASS, ESP_ERR_NO_MEM,
+                        TAG, "task create failed");
+    return ESP_OK;
+}
+
+esp_err_t alarm_set(const alarm_cfg_t *cfg)
+{
+    ESP_RETURN_ON_FALSE(cfg->hour < 24 && cfg->minute < 60 && cfg->days < 0x80, ESP_ERR_INVALID_ARG, TAG, "bad alarm");
+    ESP_RETURN_ON_ERROR(cfg_save(cfg), TAG, "save failed");
+    portENTER_CRITICAL(&s_lock);
+    s_cfg = *cfg;
+    s_cfg_loaded = true;
+    portEXIT_CRITICAL(&s_lock);
+    s_cfg_changed = true;
+    ESP_LOGI(TAG, "alarm %s %02u:%02u days 0x%02x", cfg->enabled ? "on" : "off", cfg->hour, cfg->minute, cfg->days);
+
+    FILE *fp = cfg->enabled && s_decode_task == NULL ? fopen(ALARM_SOUND_SRC, "rb") : NULL;
+    if (fp)
+    {
+        fclose(fp);
+        task_plan_create(TASK_ALARM_DECODE, decode_task, NULL, &s_decode_task);
+    }
+    return ESP_OK;
+}
+
+void alarm_get_stats(alarm_stats_t *stats)
+{
+    *stats = s_stats;
+    stats->resleeps = s_rtc_resleeps;
+    stats->sleeps = s_rtc_sleeps;
+    if (!stats->fast_boot)
+    {
+        stats->lead_ms = s_rtc_lead_ms;
+    }
+}
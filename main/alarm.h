@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 闹钟 ****************************/
+// 一个闹钟 时 分 和按星期重复的掩码 存NVS 要有时间(time_sync_valid)才会响
+// 熄屏ALARM_SLEEP_AFTER_S秒 没有在放歌 录音 拍照 就深度睡眠 定时器叫醒在闹钟前ALARM_LEAD_MIN_MS以上
+// 提前量是上次醒来到能出声的实测时间加ALARM_LEAD_MARGIN_MS 存在RTC内存里 醒得越快提前得越少
+// 定时器叫醒而且RTC里记着闹钟时走快速开机: 只起I2C IO扩展和音频芯片 不起屏幕 LVGL 摄像头和WiFi
+//   铃声是预先解码好的单声道PCM(SPIFFS里的ALARM_SOUND_PCM 没有就用固件里的开机音) 整个读进PSRAM
+//   等到闹钟时刻走开机音的预装路径出声 循环放 每块之间读一次触摸芯片和BOOT键
+//   摸了屏幕才接着正常开机 起界面 ALARM_RING_S秒没人理就睡到下一个闹钟
+//   RTC慢时钟睡久了有误差 提前量再按睡的时长加ALARM_DRIFT_PPM 醒得太早就再睡一小觉
+// 醒着的时候到点了不睡 同一段铃声当语音提示交给audio_pcm 在放歌就混在歌里 碰一下屏幕停
+// 铃声: 卡上有ALARM_SOUND_SRC时保存闹钟的同时在后台解码 前ALARM_SOUND_MAX_S秒转成16k单声道写进SPIFFS
+//
+// 开机到出声分三段记: 定时器该叫醒的时刻到能出声(墙上时间 含ROM和二级引导) 其中应用启动以后的部分
+// 和真正出声的时刻比闹钟晚了多少 提前量够的话这个是0附近
+
+#define ALARM_NVS_NAMESPACE     "alarm"
+#define ALARM_SOUND_SRC         SD_MOUNT_POINT"/alarm.mp3"
+#define ALARM_SOUND_PCM         SPIFFS_BASE"/alarm.pcm"
+#define ALARM_SOUND_MAX_S       10      // 16k单声道320KB SPIFFS只有1MB
+#define ALARM_SOUND_RATE        16000
+#define ALARM_RING_S            CONFIG_APP_ALARM_RING_S
+#define ALARM_SLEEP_AFTER_S     CONFIG_APP_ALARM_SLEEP_AFTER_S  // 0不自动睡
+#define ALARM_LEAD_MIN_MS       2000
+#define ALARM_LEAD_MARGIN_MS    1500
+#define ALARM_DRIFT_PPM         2000    // 睡8小时多提前将近1分钟
+#define ALARM_RESLEEP_S         60      // 醒来离闹钟还有这么久就再睡
+#define ALARM_GAP_MS            400     // 铃声一遍和下一遍之间
+#define ALARM_LATE_S            60      // 醒着时错过闹钟这么久就不响了 比如刚对上时
+#define ALARM_POLL_MS           50      // 响铃时读触摸的间隔 也是每次写I2S的时长
+#define ALARM_CHECK_MS          1000    // 醒着时多久看一次到点和该不该睡
+
+typedef struct {
+    bool enabled;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t days;                       // bit0周日 bit6周六 0是只响一次 响过就关
+} alarm_cfg_t;
+
+// ALARM_SOUND_PCM的文件头 后面是16位PCM
+typedef struct {
+    char magic[4];                      // "APCM"
+    uint32_t rate;
+    uint16_t channels;
+    uint16_t reserved;
+    uint32_t bytes;
+} alarm_pcm_hdr_t;
+
+typedef struct {
+    bool fast_boot;                     // 这次是闹钟叫醒的快速开机
+    bool touched;                       // 快速开机里摸了屏幕 接着正常开机
+    uint32_t boot_ms;                   // 该叫醒的时刻到能出声
+    uint32_t app_ms;                    // 其中应用启动以后的 初始化音频芯片和读铃声
+    uint32_t load_ms;                   // 其中读铃声
+    int32_t late_ms;                    // 出声比闹钟晚多少 负的是提前了
+    uint32_t lead_ms;                   // 这次睡的时候用的提前量
+    uint32_t rings;                     // 醒着时到点响的
+    uint32_t resleeps;                  // 其中醒早了再睡的 也在RTC里
+    uint32_t sleeps;                    // 进深度睡眠的次数 RTC里存着 断电清零
+    uint32_t sound_rate;
+    uint32_t sound_bytes;
+    bool sound_custom;                  // 用的是卡上解码来的铃声
+} alarm_stats_t;
+
+bool alarm_boot_pending(void);          // I2C和IO扩展起来以后调 是闹钟叫醒的
+// 快速开机 自己走SPIFFS和音频芯片两个开机阶段 返回时都起好了 接着正常开机 没人理就直接睡了不返回
+esp_err_t alarm_boot_run(void);
+esp_err_t alarm_start(void);            // 主界面起来以后调 到点响铃和熄屏后睡眠
+esp_err_t alarm_set(const alarm_cfg_t *cfg);    // 存NVS 卡上有铃声就在后台解码
+void alarm_get(alarm_cfg_t *cfg);
+time_t alarm_next(time_t now);          // 下一次响的时刻 0是没有
+void alarm_sleep(void);                 // 马上睡到下一个闹钟 没有闹钟只等BOOT键 离闹钟比提前量还近就返回不睡
+void alarm_get_stats(alarm_stats_t *stats);
@@ -0,0 +1,350 @@
+#include "app_mod.h"
+#include "task_plan.h"
+#include "ui_msg.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "imu.h"
+#include "attitude.h"
+#include "idle_mgr.h"
+#include "imu_log.h"
+#include "pedometer.h"
+#include "esp32_s3_szp.h"
+
+/******************************** 第1个图标 姿态传感器 应用程序*************************************************************************************/
+lv_obj_t *label_x; // x角度值
+lv_obj_t *label_y; // y角度值
+lv_obj_t *label_z; // z角度值
+lv_obj_t *x_bar;   // x角度bar
+lv_obj_t *y_bar;   // y角度bar
+lv_obj_t *z_bar;   // z角度bar
+
+lv_obj_t *att_label; // 标题栏文字
+
+#define ATT_VIEW_PERIOD_MS  200     // 角度最多这么久刷一次
+
+static volatile bool s_att_listening; // 界面开着 解算任务发布了就来刷
+static volatile bool s_att_posted;    // 已经排进LVGL队列还没刷 不重复排
+static bool s_att_own_imu;            // imu_start和attitude_start过 退出时配对停掉
+
+lv_obj_t *btn_att_back; // att姿态应用 后退按钮
+
+// 退出时不再听解算任务 界面留着下次直接显示
+static void att_leave(lv_obj_t *root)
+{
+    attitude_set_listener(NULL, 0);
+    s_att_listening = false;
+}
+
+static lv_obj_t *s_att_log_label = NULL;
+#if CONFIG_APP_PEDOMETER
+static lv_obj_t *s_att_step_label;    // 今天的步数和现在的活动
+#endif
+
+// 原始数据记录开关 传感器还没起来时不理
+static void btn_att_log_cb(lv_event_t *e)
+{
+    if (imu_log_active())
+    {
+        imu_log_stop();
+        lv_label_set_text(s_att_log_label, "LOG");
+    }
+    else if (imu_running() && imu_log_start() == ESP_OK)
+    {
+        lv_label_set_text(s_att_log_label, "0s");
+    }
+}
+
+// 开着IMU和解算的话配对停掉 别的模块也在用就还接着跑
+static void att_release(void)
+{
+    if (s_att_own_imu)
+    {
+        attitude_stop();
+        imu_stop();             // 先停下读FIFO的任务
+        idle_mgr_imu_released(); // 空闲管理还要靠它测运动 没开的话关闭芯片运行
+        s_att_own_imu = false;
+    }
+}
+
+// 返回主界面按钮事件处理函数
+static void btn_att_back_cb(lv_event_t *e)
+{
+    if (imu_log_active())
+    {
+        imu_log_stop(); // 记录要在采样任务停下之前收尾
+        lv_label_set_text(s_att_log_label, "LOG");
+    }
+    att_release();
+    ui_screen_leave(1);
+    icon_flag = 0;
+}
+
+// 解算任务发布以后更新姿态角度值 姿态是融合好的 这里不走I2C 在LVGL任务里执行
+static void att_update_cb(void *arg)
+{
+    t_sQMI8658 QMI8658;
+    attitude_t att;
+    int att_x, att_y, att_z;
+    s_att_posted = false;
+    if (!s_att_listening || !attitude_get(&att))
+    {
+        return;
+    }
+    // 获取XYZ角度 融合出来的重力方向按加速度的刻度换过去 三个倾角的算法和原来一样
+    QMI8658.acc_x = att.gravity[0] * IMU_ACC_LSB_PER_G;
+    QMI8658.acc_y = att.gravity[1] * IMU_ACC_LSB_PER_G;
+    QMI8658.acc_z = att.gravity[2] * IMU_ACC_LSB_PER_G;
+    qmi8658_calc_angleFromAcc(&QMI8658);
+    att_x = round(QMI8658.AngleX); // 四舍五入
+    att_y = round(QMI8658.AngleY); // 四舍五入
+    att_z = round(QMI8658.AngleZ); // 四舍五入
+    // 更新角度值
+    lv_label_set_text_fmt(label_x, "X: %d", att_x);
+    lv_label_set_text_fmt(label_y, "Y: %d", att_y);
+    lv_label_set_text_fmt(label_z, "Z: %d", att_z);
+    // 更新角度bar
+    lv_bar_set_start_value(x_bar, att_x - 10, LV_ANIM_OFF);
+    lv_bar_set_value(x_bar, att_x + 10, LV_ANIM_OFF);
+    lv_bar_set_start_value(y_bar, att_y - 10, LV_ANIM_OFF);
+    lv_bar_set_value(y_bar, att_y + 10, LV_ANIM_OFF);
+    lv_bar_set_start_value(z_bar, att_z - 10, LV_ANIM_OFF);
+    lv_bar_set_value(z_bar, att_z + 10, LV_ANIM_OFF);
+
+    // 记录中显示时长 丢过样本的话跟上丢的组数
+    if (imu_log_active())
+    {
+        imu_log_stats_t ls;
+        imu_log_get_stats(&ls);
+        uint32_t lost = ls.lost_fifo + ls.lost_ring + ls.lost_buf;
+        if (lost)
+        {
+            lv_label_set_text_fmt(s_att_log_label, "%lus -%lu", (unsigned long)(ls.duration_us / 1000000), (unsigned long)lost);
+        }
+        else
+        {
+            lv_label_set_text_fmt(s_att_log_label, "%lus", (unsigned long)(ls.duration_us / 1000000));
+        }
+    }
+    else if (strcmp(lv_label_get_text(s_att_log_label), "LOG"))
+    {
+        lv_label_set_text(s_att_log_label, "LOG"); // 拔卡时被热插拔任务停掉了
+    }
+
+#if CONFIG_APP_PEDOMETER
+    pedo_day_t today;
+    pedometer_today(&today);
+    lv_label_set_text_fmt(s_att_step_label, "Steps: %lu  %s", (unsigned long)today.steps,
+                          pedometer_activity_name(pedometer_activity()));
+#endif
+
+    // 判断运动状态
+    uint8_t status = imu_motion();
+    if (status & 0x20) // 判断是否发生Any-Motion
+    {
+        lv_label_set_text(att_label, "运动或震动");
+    }
+    else if (status & 0x40) // 判断是否发生No-Motion
+    {
+        lv_label_set_text(att_label, "静止");
+    }
+    else if (status & 0x80) // 判断是否发生Significant-Motion
+    {
+        lv_label_set_text(att_label, "剧烈运动");
+    }
+}
+
+// 传感器初始化失败的提示 在LVGL任务里执行
+static void att_error_show(void *arg)
+{
+    lv_obj_t *label = lv_label_create(icon_in_obj);
+    lv_label_set_text(label, "QMI8658传感器错误...");
+    lv_obj_set_style_text_color(label, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
+}
+
+// 提示过错误后整个界面删掉 不把错误提示留在缓存的界面里
+static void att_error_exit(void *arg)
+{
+    ui_screen_evict(1);
+    icon_flag = 0;
+}
+
+// 解算任务发布了一次 在解算任务里
+static void att_changed(void)
+{
+    if (!s_att_posted)
+    {
+        s_att_posted = true;
+        if (!ui_post_call(att_update_cb, NULL))
+        {
+            s_att_posted = false; // 队列满了 下次发布再来
+        }
+    }
+}
+
+// 传感器初始化好了才开始刷新角度 在LVGL任务里执行
+static void att_listen_start(void *arg)
+{
+    if (icon_flag != 1)
+    {
+        att_release(); // 初始化传感器期间已经按了返回键
+        return;
+    }
+    if (s_att_listening)
+    {
+        return;
+    }
+    s_att_listening = true;
+    attitude_set_listener(att_changed, ATT_VIEW_PERIOD_MS);
+}
+
+// 姿态监测处理任务 只初始化传感器 界面交给LVGL任务去建
+static void task_process_att(void *arg)
+{
+    // 手势 计步这些已经开着IMU的话不再初始化芯片 跟着用
+    esp_err_t ret = imu_running() ? ESP_OK : qmi8658_init();
+    if (ret == ESP_OK)
+    {
+        ret = imu_start(); // FIFO批量读 I2C离开LVGL任务
+        if (ret == ESP_OK)
+        {
+            ret = attitude_start(); // 陀螺仪和加速度融合
+            if (ret != ESP_OK)
+            {
+                attitude_stop();
+                imu_stop();
+            }
+        }
+    }
+    s_att_own_imu = ret == ESP_OK;
+    if (ret != ESP_OK)
+    { // 如果传感器初始化不成功
+        idle_mgr_imu_released();
+        // 液晶屏提醒用户 传感器错误
+        ui_post_call(att_error_show, NULL);
+        vTaskDelay(1000 / portTICK_PERIOD_MS); // 提示词保留1秒
+        ui_post_call(att_error_exit, NULL);    // 删除画布 回到主界面
+    }
+    else
+    { // 传感器初始化成功
+        ui_post_call(att_listen_start, NULL);
+    }
+
+    vTaskDelete(NULL);
+}
+
+// 第一次进入时创建 标题栏 返回键 三个角度值和角度bar
+static void att_build(lv_obj_t *root)
+{
+    // 创建标题背景
+    lv_obj_t *att_title = lv_obj_create(root);
+    lv_obj_add_style(att_title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(att_title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(att_title, lv_color_hex(0x30a830), 0);
+    // 显示标题
+    att_label = lv_label_create(att_title);
+    lv_label_set_text(att_label, "运动监测");
+    lv_obj_set_style_text_color(att_label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(att_label, &font_alipuhui20, 0);
+    lv_obj_align(att_label, LV_ALIGN_CENTER, 0, 0);
+    // 创建后退按钮
+    btn_att_back = lv_btn_create(att_title);
+    lv_obj_align(btn_att_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_att_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_att_back, btn_att_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
+
+    lv_obj_t *label_back = lv_label_create(btn_att_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    // 创建记录按钮 按FIFO的速率把原始数据记到卡上
+    lv_obj_t *btn_log = lv_btn_create(att_title);
+    lv_obj_align(btn_log, LV_ALIGN_RIGHT_MID, 0, 0);
+    lv_obj_add_style(btn_log, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_set_width(btn_log, LV_SIZE_CONTENT);
+    lv_obj_add_event_cb(btn_log, btn_att_log_cb, LV_EVENT_CLICKED, NULL);
+
+    s_att_log_label = lv_label_create(btn_log);
+    lv_label_set_text(s_att_log_label, "LOG");
+    lv_obj_add_style(s_att_log_label, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_set_style_text_font(s_att_log_label, &lv_font_montserrat_14, 0);
+    lv_obj_center(s_att_log_label);
+
+    // 显示x角度值
+    label_x = lv_label_create(root);
+    lv_label_set_text(label_x, "X:");
+    lv_obj_set_style_text_color(label_x, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(label_x, &lv_font_montserrat_20, 0);
+    lv_obj_align(label_x, LV_ALIGN_TOP_LEFT, 20, 60);
+    // 显示x角度bar
+    x_bar = lv_bar_create(root);
+    lv_obj_set_size(x_bar, 200, 25);
+    lv_obj_align(x_bar, LV_ALIGN_TOP_LEFT, 80, 60);
+    lv_bar_set_mode(x_bar, LV_BAR_MODE_RANGE);
+    lv_bar_set_range(x_bar, -101, 101);
+    lv_bar_set_start_value(x_bar, -10, LV_ANIM_OFF);
+    lv_bar_set_value(x_bar, 10, LV_ANIM_OFF);
+
+    // 显示y角度值
+    label_y = lv_label_create(root);
+    lv_label_set_text(label_y, "Y:");
+    lv_obj_set_style_text_color(label_y, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(label_y, &lv_font_montserrat_20, 0);
+    lv_obj_align(label_y, LV_ALIGN_TOP_LEFT, 20, 120);
+    // 显示y角度bar
+    y_bar = lv_bar_create(root);
+    lv_obj_set_size(y_bar, 200, 25);
+    lv_obj_align(y_bar, LV_ALIGN_TOP_LEFT, 80, 120);
+    lv_bar_set_mode(y_bar, LV_BAR_MODE_RANGE);
+    lv_bar_set_range(y_bar, -101, 101);
+    lv_bar_set_start_value(y_bar, -10, LV_ANIM_OFF);
+    lv_bar_set_value(y_bar, 10, LV_ANIM_OFF);
+
+    // 显示z角度值
+    label_z = lv_label_create(root);
+    lv_label_set_text(label_z, "Z:");
+    lv_obj_set_style_text_color(label_z, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(label_z, &lv_font_montserrat_20, 0);
+    lv_obj_align(label_z, LV_ALIGN_TOP_LEFT, 20, 180);
+    // 显示z角度bar
+    z_bar = lv_bar_create(root);
+    lv_obj_set_size(z_bar, 200, 25);
+    lv_obj_align(z_bar, LV_ALIGN_TOP_LEFT, 80, 180);
+    lv_bar_set_mode(z_bar, LV_BAR_MODE_RANGE);
+    lv_bar_set_range(z_bar, -101, 101);
+    lv_bar_set_start_value(z_bar, -10, LV_ANIM_OFF);
+    lv_bar_set_value(z_bar, 10, LV_ANIM_OFF);
+#if CONFIG_APP_PEDOMETER
+    // 计步在后台一直算 这里只是看一眼
+    s_att_step_label = lv_label_create(root);
+    lv_label_set_text(s_att_step_label, "Steps:");
+    lv_obj_set_style_text_color(s_att_step_label, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(s_att_step_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(s_att_step_label, LV_ALIGN_BOTTOM_LEFT, 20, -8);
+#endif
+}
+
+static const ui_screen_desc_t s_att_screen = {
+    .name = "att",
+    .bg_color = 0xffffff,
+    .build = att_build,
+    .leave = att_leave,
+};
+
+static void att_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(1, &s_att_screen);
+    icon_flag = 1; // 标记已经进入第一个应用
+    task_plan_create(TASK_ATT_VIEW, task_process_att, NULL, NULL);
+}
+
+const app_mod_t app_mod_att = {
+    .name = "att",
+    .id = 1,
+    .color = 0x30a830,
+    .icon = "img_att_icon",
+    .open = att_event_handler,
+    .back = btn_att_back_cb,
+};
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <string.h>
+#include "app_mod.h"
+#include "ui_msg.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "bench_suite.h"
+#include "esp_log.h"
+
+static const char *TAG = "app_bench";
+
+/******************************** 第11个图标 基准测试 应用程序 ***********************************************************************************/
+// 点开始跑bench_suite 每出一个结果加一行 跑完显示报告的文件名
+// 跑的时候返回也行 当前这一项跑完就停 不写报告
+#define BENCH_COLOR         0x795548
+#define BENCH_LINE_LEN      40
+
+static lv_obj_t *s_bench_list = NULL;
+static lv_obj_t *s_bench_status = NULL;
+static lv_obj_t *s_bench_btn = NULL;
+static char s_bench_text[BENCH_MAX_RESULTS * BENCH_LINE_LEN];
+
+// 在LVGL任务里 arg是bench_suite里的结果 下一次开始之前一直有效
+static void bench_show_result(void *arg)
+{
+    const bench_result_t *r = arg;
+    size_t n = strlen(s_bench_text);
+    if (r->err == ESP_OK)
+    {
+        snprintf(s_bench_text + n, sizeof(s_bench_text) - n, "%-16s %9.2f %s\n", r->name, r->value, r->unit);
+    }
+    else
+    {
+        snprintf(s_bench_text + n, sizeof(s_bench_text) - n, "%-16s   skipped\n", r->name);
+    }
+    if (s_bench_list)
+    {
+        lv_label_set_text_static(s_bench_list, s_bench_text);
+        lv_obj_scroll_to_y(lv_obj_get_parent(s_bench_list), LV_COORD_MAX, LV_ANIM_OFF);
+    }
+}
+
+static void bench_show_done(void *arg)
+{
+    bench_suite_stats_t st;
+    bench_suite_get_stats(&st);
+    if (s_bench_status)
+    {
+        if (st.last_report[0])
+        {
+            lv_label_set_text_fmt(s_bench_status, "%s (%lu s)", st.last_report + sizeof("/sdcard"),
+                                  (unsigned long)st.last_ms / 1000);
+        }
+        else
+        {
+            lv_label_set_text_static(s_bench_status, "未保存报告");
+        }
+        lv_obj_clear_state(s_bench_btn, LV_STATE_DISABLED);
+    }
+}
+
+// 在测试任务里
+static void bench_cb(const bench_result_t *r, void *arg)
+{
+    if (!ui_post_call(r ? bench_show_result : bench_show_done, (void *)r))
+    {
+        ESP_LOGW(TAG, "ui queue full");
+    }
+}
+
+static void btn_bench_start_cb(lv_event_t *e)
+{
+    s_bench_text[0] = '\0';
+    if (bench_suite_start(bench_cb, NULL) == ESP_OK)
+    {
+        lv_label_set_text_static(s_bench_list, s_bench_text);
+        lv_label_set_text_static(s_bench_status, "测试中 请勿操作");
+        lv_obj_add_state(s_bench_btn, LV_STATE_DISABLED);
+    }
+}
+
+static void btn_bench_back_cb(lv_event_t *e)
+{
+    bench_suite_cancel();
+    ui_screen_leave(11);
+    icon_flag = 0;
+}
+
+static void bench_build(lv_obj_t *root)
+{
+    lv_obj_t *title = lv_obj_create(root);
+    lv_obj_add_style(title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(title, lv_color_hex(BENCH_COLOR), 0);
+    lv_obj_t *label = lv_label_create(title);
+    lv_label_set_text(label, "基准测试");
+    lv_obj_set_style_text_color(label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
+
+    lv_obj_t *btn_back = lv_btn_create(title);
+    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_bench_back_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT);
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    s_bench_btn = lv_btn_create(title);
+    lv_obj_set_size(s_bench_btn, 60, 30);
+    lv_obj_align(s_bench_btn, LV_ALIGN_RIGHT_MID, -5, 0);
+    lv_obj_add_event_cb(s_bench_btn, btn_bench_start_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label_start = lv_label_create(s_bench_btn);
+    lv_label_set_text(label_start, "开始");
+    lv_obj_set_style_text_font(label_start, &font_alipuhui20, 0);
+    lv_obj_center(label_start);
+
+    /* 结果 一行一项 */
+    lv_obj_t *box = lv_obj_create(root);
+    lv_obj_set_size(box, 310, 160);
+    lv_obj_align(box, LV_ALIGN_TOP_MID, 0, 45);
+    lv_obj_set_style_pad_all(box, 4, 0);
+    s_bench_list = lv_label_create(box);
+    lv_obj_set_style_text_font(s_bench_list, &lv_font_montserrat_14, 0);
+    lv_label_set_text_static(s_bench_list, s_bench_text);
+
+    s_bench_status = lv_label_create(root);
+    lv_obj_set_width(s_bench_status, 300);
+    lv_label_set_long_mode(s_bench_status, LV_LABEL_LONG_DOT);
+    lv_obj_set_style_text_font(s_bench_status, &font_alipuhui20, 0);
+    lv_obj_align(s_bench_status, LV_ALIGN_BOTTOM_MID, 0, -6);
+    lv_label_set_text_static(s_bench_status, "参考文件 bench/ref.mp3 ref.flac");
+}
+
+static void bench_evicted(void)
+{
+    s_bench_list = NULL;
+    s_bench_status = NULL;
+    s_bench_btn = NULL;
+}
+
+static const ui_screen_desc_t s_bench_screen = {
+    .name = "bench",
+    .bg_color = 0xffffff,
+    .build = bench_build,
+    .evicted = bench_evicted,
+};
+
+static void bench_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(11, &s_bench_screen);
+    icon_flag = 11;
+    // 返回后上一轮可能还在收尾 按钮等它跑完再放开
+    if (bench_suite_running())
+    {
+        lv_obj_add_state(s_bench_btn, LV_STATE_DISABLED);
+    }
+}
+
+// 没有图片 用符号
+const app_mod_t app_mod_bench = {
+    .name = "bench",
+    .id = 11,
+    .color = BENCH_COLOR,
+    .symbol = LV_SYMBOL_CHARGE,
+    .open = bench_event_handler,
+    .back = btn_bench_back_cb,
+};
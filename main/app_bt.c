@@ -0,0 +1,82 @@
+#include "app_mod.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "bt/ble_hidd_demo.h"
+#include "bt/ble_svc.h"
+
+/******************************** 第6个图标 蓝牙设置 应用程序***********************************************************************************/
+lv_obj_t *ble_label;
+lv_obj_t *btn_ble_back;
+
+// 返回主界面按钮事件处理函数
+static void btn_ble_back_cb(lv_event_t *e)
+{
+    bt_hid_end();
+    ui_screen_leave(6);
+    icon_flag = 0;
+}
+
+// 标题栏和返回键
+static void btset_build(lv_obj_t *root)
+{
+    // 创建标题背景
+    lv_obj_t *ble_title = lv_obj_create(root);
+    lv_obj_add_style(ble_title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(ble_title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(ble_title, lv_color_hex(0xb87fa8), 0);
+    // 显示标题
+    ble_label = lv_label_create(ble_title);
+    lv_label_set_text(ble_label, "蓝牙控制器");
+    lv_obj_set_style_text_color(ble_label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(ble_label, &font_alipuhui20, 0);
+    lv_obj_align(ble_label, LV_ALIGN_CENTER, 0, 0);
+    // 创建后退按钮
+    btn_ble_back = lv_btn_create(ble_title);
+    lv_obj_align(btn_ble_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_ble_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_ble_back, btn_ble_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
+
+    lv_obj_t *label_back = lv_label_create(btn_ble_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+}
+
+// 没有人用了就停广播 协议栈要不要留着由ble_svc自己定
+static const app_res_ops_t s_bt_res = {
+    .up = ble_svc_open,
+    .down = ble_svc_close,
+};
+
+static const ui_screen_desc_t s_btset_screen = {
+    .name = "bt",
+    .bg_color = 0xffffff,
+    .res = APP_RES_BIT(APP_RES_BT),
+    .build = btset_build,
+};
+
+// 进入蓝牙设置应用
+static void btset_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(6, &s_btset_screen);
+
+    app_hid_ctrl();
+
+    icon_flag = 6; // 标记已经进入第6个应用
+}
+
+// 第一次打开前 广播交给app_res
+static void btset_init(void)
+{
+    app_res_register(APP_RES_BT, &s_bt_res);
+}
+
+const app_mod_t app_mod_bt = {
+    .name = "bt",
+    .id = 6,
+    .color = 0xb87fa8,
+    .icon = "img_btset_icon",
+    .init = btset_init,
+    .open = btset_event_handler,
+    .back = btn_ble_back_cb,
+};
@@ -0,0 +1,1266 @@
+#include "app_mod.h"
+#include "task_plan.h"
+#include "ui_perf.h"
+#include "ui_msg.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "cam_capture.h"
+#include "cam_jpeg.h"
+#include "cam_timelapse.h"
+#include "cam_avi.h"
+#include "cam_stream.h"
+#include "intercom.h"
+#include "cam_motion.h"
+#include "cam_zoom.h"
+#if CONFIG_APP_CAMERA_FACE
+#include "cam_face.h"
+#endif
+#include "idle_mgr.h"
+#include "pm_ctl.h"
+#include "wifi_svc.h"
+#include "esp32_s3_szp.h"
+#include "sys_trace.h"
+#include "psram_bw.h"
+
+static const char *TAG = "app_camera";
+
+/******************************** 第4个图标 摄像头 应用程序 *****************************************************************************/
+lv_obj_t *img_camera;
+
+// 摄像头图像
+lv_img_dsc_t img_camera_dsc = {
+    .header.cf = LV_IMG_CF_TRUE_COLOR,
+    .header.always_zero = 0,
+    .header.reserved = 0,
+    .header.w = 320,
+    .header.h = 240,
+    .data_size = 240 * 320 * 2,
+};
+
+// 摄像头处理任务
+// 按一次加一 取帧任务每帧处理一次 连着点几下不会被合并掉
+static volatile uint32_t s_capture_requests = 0;
+static uint32_t s_capture_served = 0;
+static volatile bool s_burst_requested = false;
+static lv_obj_t *s_cam_overlays[7];     // 返回 拍照 模式 延时摄影 录像 直播和移动侦测按钮 直通预览时叠加在画面上
+static lv_obj_t *s_cam_mode_label = NULL;
+static lv_obj_t *s_cam_rec_label = NULL;
+static lv_obj_t *s_cam_live_label = NULL;
+static lv_obj_t *s_cam_motion_label = NULL;
+static bsp_camera_mode_t s_cam_mode = BSP_CAMERA_RGB565;   // 用户选的模式 下次进来还用它
+static bsp_camera_mode_t s_cam_res_mode = BSP_CAMERA_RGB565;    // app_res打开摄像头时用的 扫码要灰度
+static volatile bool s_cam_mode_requested = false;
+static volatile bool s_timelapse_requested = false;
+static volatile bool s_rec_requested = false;
+static bsp_camera_mode_t s_rec_prev_mode;   // 录像前的模式 停了切回去
+static uint32_t s_rec_seen = 0;             // 录像时隔一帧才解一次预览 省下CPU给取帧
+static volatile bool s_live_requested = false;
+static bsp_camera_mode_t s_live_prev_mode;  // 直播前的模式 停了切回去
+static volatile bool s_motion_requested = false;
+static int s_zoom_logged = 0;               // 上次打帧率时的档
+static int64_t s_pinch_d0 = 0;              // 双指开始时距离的平方 0是没在捏
+static bool s_pinch_skip = false;           // 抬起一根手指后这一下的位移不算平移
+static bool s_motion_rec = false;           // 这段录像是移动侦测开的 画面静下来就停
+#if CONFIG_APP_CAMERA_FACE
+static volatile bool s_face_requested = false;
+static lv_obj_t *s_cam_face_boxes[CAM_FACE_MAX];
+static lv_obj_t *s_cam_face_label = NULL;
+static uint32_t s_face_seq = 0;             // 已经画上去的检测结果
+#endif
+
+// 一种模式从开始到切走的统计
+typedef struct {
+    bsp_camera_mode_t mode;
+    uint32_t frames;
+    uint64_t bytes;                     // 摄像头给的帧一共多少字节 JPEG模式就是照片大小
+    uint64_t busy_us;                   // 取到帧之后处理它花的时间 解码 拷贝 推预览
+    int64_t t0;
+} camera_run_t;
+
+// LVGL预览的帧交接 帧缓冲交给LVGL后由它来还给驱动
+// s_cam_pending: 已经设成图片源、还没画过的帧 s_cam_shown: 屏幕上正在显示的帧
+// 新帧画完(刷新的最后一块交给SPI)之后才把旧帧还回去 LVGL画图时读的一定是驱动不会再写的缓冲
+// 还没来得及画就来了更新的帧 没画过的那帧直接还掉 不白画
+static camera_fb_t *s_cam_pending = NULL;
+static camera_fb_t *s_cam_shown = NULL;
+static uint32_t s_cam_rendered = 0;
+static uint32_t s_cam_skipped = 0;
+static SemaphoreHandle_t s_cam_released = NULL;
+
+// JPEG模式交给LVGL的是解好的预览缓冲 不是驱动的帧
+static void camera_fb_release(camera_fb_t *frame)
+{
+    if (!cam_jpeg_release(frame)) {
+        esp_camera_fb_return(frame);
+    }
+}
+
+static void camera_rendered(void *arg)
+{
+    if (s_cam_pending == NULL) {
+        return;
+    }
+    if (s_cam_shown) {
+        camera_fb_release(s_cam_shown);
+    }
+    s_cam_shown = s_cam_pending;
+    s_cam_pending = NULL;
+    s_cam_rendered++;
+}
+
+static void camera_show_frame(void *arg)
+{
+    camera_fb_t *frame = arg;
+    if (img_camera == NULL) {
+        camera_fb_release(frame);
+        return;
+    }
+    if (s_cam_pending) {
+        camera_fb_release(s_cam_pending);
+        s_cam_skipped++;
+    }
+    s_cam_pending = frame;
+    img_camera_dsc.data = frame->buf;
+    lv_img_set_src(img_camera, &img_camera_dsc);
+    lv_obj_invalidate(img_camera); // 同一个dsc换了数据 要自己标脏
+}
+
+// 退出前把LVGL手里的帧都还给驱动 摄像头任务等它做完才能去初始化
+static void camera_release_frames(void *arg)
+{
+    bsp_display_set_rendered_cb(NULL, NULL);
+    lv_img_set_src(img_camera, NULL);
+    if (s_cam_pending) {
+        camera_fb_release(s_cam_pending);
+        s_cam_pending = NULL;
+    }
+    if (s_cam_shown) {
+        camera_fb_release(s_cam_shown);
+        s_cam_shown = NULL;
+    }
+    xSemaphoreGive(s_cam_released);
+}
+
+static void camera_mode_label(void *arg)
+{
+    if (s_cam_mode_label) {
+        lv_label_set_text(s_cam_mode_label, bsp_camera_get_mode() == BSP_CAMERA_JPEG ? "JPG" : "RGB");
+    }
+}
+
+static void camera_run_begin(camera_run_t *run)
+{
+    memset(run, 0, sizeof(*run));
+    run->mode = bsp_camera_get_mode();
+    run->t0 = esp_timer_get_time();
+    if (run->mode == BSP_CAMERA_JPEG) {
+        cam_jpeg_init();
+    }
+    ui_post_call(camera_mode_label, NULL);
+}
+
+// 每种模式的帧大小 帧率和处理一帧占的CPU
+static void camera_run_log(const camera_run_t *run)
+{
+    float sec = (esp_timer_get_time() - run->t0) / 1e6f;
+    if (run->frames == 0 || sec <= 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "camera mode %s: %lu frames, %.1f fps, %.1f KB/frame, %.1f ms/frame busy (%.0f%% of core 1)",
+             run->mode == BSP_CAMERA_JPEG ? "jpeg" : "rgb565", (unsigned long)run->frames, run->frames / sec,
+             run->bytes / 1024.0 / run->frames, run->busy_us / 1000.0 / run->frames, run->busy_us / 1e4 / sec);
+    if (run->mode == BSP_CAMERA_JPEG) {
+        cam_jpeg_stats_t js;
+        cam_jpeg_get_stats(&js);
+        ESP_LOGI(TAG, "jpeg preview: %ux%u at 1/%d, %lu decoded, %lu failed, %lu busy, %.1f ms/frame (max %.1f ms), %.0f%% CPU",
+                 js.src_w, js.src_h, 1 << js.scale, (unsigned long)js.decoded, (unsigned long)js.failed,
+                 (unsigned long)js.busy, js.decoded ? js.decode_us / 1000.0 / js.decoded : 0.0,
+                 js.max_decode_us / 1000.0, js.decode_us / 1e4 / sec);
+    }
+}
+
+// 在摄像头任务里停掉驱动 帧都收回来才能deinit
+static void camera_pause(bool direct)
+{
+    if (!direct && ui_post_call(camera_release_frames, NULL)) {
+        xSemaphoreTake(s_cam_released, portMAX_DELAY);
+    }
+    esp_camera_deinit();
+}
+
+static void camera_resume(bool direct, bsp_camera_mode_t want)
+{
+    esp_err_t err = bsp_camera_init_mode(want);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "camera %s mode unavailable: %s", want == BSP_CAMERA_JPEG ? "jpeg" : "rgb565", esp_err_to_name(err));
+    }
+    s_cam_mode = bsp_camera_get_mode();
+    if (s_cam_mode != BSP_CAMERA_JPEG) {
+        cam_jpeg_deinit();
+    }
+    cam_motion_reset(); // 重新初始化后曝光会变 背景重学
+    cam_zoom_reapply(); // 传感器的窗口也回到了默认
+    if (!direct) {
+        ui_lock(0);
+        bsp_display_set_rendered_cb(camera_rendered, NULL);
+        ui_unlock();
+    }
+}
+
+// 切换RGB565和JPEG
+static void camera_switch_mode(bool direct)
+{
+    camera_pause(direct);
+    camera_resume(direct, bsp_camera_get_mode() == BSP_CAMERA_JPEG ? BSP_CAMERA_RGB565 : BSP_CAMERA_JPEG);
+}
+
+// 预览停下来 拍到按BOOT为止 再按原来的模式接着预览
+static void camera_timelapse(bool direct)
+{
+    bsp_camera_mode_t mode = bsp_camera_get_mode();
+    camera_pause(direct);
+    dvp_pwdn(1);
+    cam_timelapse_stats_t ts;
+    if (cam_timelapse_run(mode, &ts) == ESP_OK && ts.frames + ts.failed) {
+        float mah_day = ts.avg_ma * 24;
+        ESP_LOGI(TAG, "timelapse: %lu frames, %lu failed, %lu late, wake to saved avg %.0f ms (max %.0f ms), awake %.1f%%",
+                 (unsigned long)ts.frames, (unsigned long)ts.failed, (unsigned long)ts.late,
+                 ts.frames ? ts.wake_us / 1000.0 / ts.frames : 0.0, ts.max_wake_us / 1000.0,
+                 ts.awake_us * 100.0 / LV_MAX(ts.awake_us + ts.sleep_us, 1));
+        ESP_LOGI(TAG, "timelapse power (estimated): %.1f mA avg, %.3f mAh/frame, %.0f mAh/day",
+                 ts.avg_ma, ts.avg_ma * CONFIG_APP_TIMELAPSE_INTERVAL_S / 3600.0, mah_day);
+    }
+    camera_resume(direct, mode);
+}
+
+#if CONFIG_APP_CAPTURE_HIRES
+// 大分辨率拍照 每段的耗时 退出时打出累计的
+typedef struct {
+    uint32_t shots;
+    uint32_t failed;
+    uint64_t to_hires_us;               // 停预览 按大分辨率初始化
+    uint64_t settle_us;                 // 等自动曝光的那几帧
+    uint64_t save_us;
+    uint64_t back_us;                   // 按QVGA重新初始化 回到预览
+    uint32_t max_total_us;              // 按下后到预览回来
+} camera_hires_stats_t;
+
+static camera_hires_stats_t s_hires;
+
+// RGB565预览用QVGA 正好是屏幕大小 拍照时才把传感器切到CAMERA_HIRES_FRAMESIZE拍一张
+// 驱动按初始化时的分辨率分配帧缓冲 不能只改传感器的窗口 要整个重新初始化 切回来也是
+static void camera_capture_hires(bool direct)
+{
+    int64_t t0 = esp_timer_get_time();
+    camera_pause(direct);
+    esp_err_t err = bsp_camera_init_mode(BSP_CAMERA_RGB565_HI);
+    int64_t t1 = esp_timer_get_time();
+    camera_fb_t *frame = NULL;
+    if (err == ESP_OK) {
+        // 刚上电曝光不对 前几帧扔掉
+        for (int i = 0; i <= CONFIG_APP_CAPTURE_HIRES_SETTLE; i++) {
+            if (frame) {
+                esp_camera_fb_return(frame);
+            }
+            frame = esp_camera_fb_get();
+            if (frame == NULL) {
+                break;
+            }
+        }
+    }
+    int64_t t2 = esp_timer_get_time();
+    char path[128] = "";
+    bool ok = frame && cam_capture_save(frame, path, sizeof(path)) == ESP_OK;
+    int64_t t3 = esp_timer_get_time();
+    int w = frame ? frame->width : 0, h = frame ? frame->height : 0;
+    if (frame) {
+        esp_camera_fb_return(frame);
+    }
+    if (err == ESP_OK) {
+        esp_camera_deinit();
+    }
+    camera_resume(direct, BSP_CAMERA_RGB565);
+    int64_t t4 = esp_timer_get_time();
+
+    uint32_t total = (uint32_t)(t4 - t0);
+    s_hires.shots++;
+    s_hires.failed += !ok;
+    s_hires.to_hires_us += t1 - t0;
+    s_hires.settle_us += t2 - t1;
+    s_hires.save_us += t3 - t2;
+    s_hires.back_us += t4 - t3;
+    if (total > s_hires.max_total_us) {
+        s_hires.max_total_us = total;
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "hi-res capture failed: %s", err != ESP_OK ? esp_err_to_name(err) : "no frame");
+    }
+    ESP_LOGI(TAG, "hi-res %dx%d %s: switch %.0f ms + settle %.0f ms + save %.0f ms + back %.0f ms = %.0f ms",
+             w, h, path, (t1 - t0) / 1000.0, (t2 - t1) / 1000.0, (t3 - t2) / 1000.0, (t4 - t3) / 1000.0, total / 1000.0);
+}
+#endif
+
+// 录像时每秒刷新一次 帧率 丢帧和写盘速度
+static void camera_rec_label(void *arg)
+{
+    if (s_cam_rec_label == NULL) {
+        return;
+    }
+    if (!cam_avi_active()) {
+        lv_label_set_text(s_cam_rec_label, "REC");
+        return;
+    }
+    cam_avi_stats_t st;
+    cam_avi_get_stats(&st);
+    float sec = st.duration_us / 1e6f;
+    char text[48];
+    snprintf(text, sizeof(text), LV_SYMBOL_STOP " %.1ffps %lu drop %luKB/s", sec > 0 ? (st.frames - 1) / sec : 0.0f,
+             (unsigned long)st.dropped, sec > 0 ? (unsigned long)(st.bytes / 1024 / sec) : 0UL);
+    lv_label_set_text(s_cam_rec_label, text);
+}
+
+// 录像固定用QVGA的JPEG 不是JPEG模式先切过去
+static void camera_record_start(bool direct)
+{
+    s_rec_prev_mode = bsp_camera_get_mode();
+    if (s_rec_prev_mode != BSP_CAMERA_JPEG) {
+        camera_pause(direct);
+        camera_resume(direct, BSP_CAMERA_JPEG);
+    }
+    if (bsp_camera_get_mode() != BSP_CAMERA_JPEG) {
+        ESP_LOGW(TAG, "recording needs a JPEG sensor");
+        return;
+    }
+    sensor_t *sensor = esp_camera_sensor_get();
+    sensor->set_framesize(sensor, FRAMESIZE_QVGA);
+    cam_motion_reset();
+    s_rec_seen = 0;
+    if (cam_avi_start(320, 240) == ESP_OK) {
+        ui_post_call(camera_rec_label, NULL);
+        return;
+    }
+    sensor->set_framesize(sensor, CAMERA_JPEG_FRAMESIZE);
+    if (s_rec_prev_mode != BSP_CAMERA_JPEG) {
+        camera_pause(direct);
+        camera_resume(direct, s_rec_prev_mode);
+    }
+}
+
+static void camera_record_stop(bool direct)
+{
+    s_motion_rec = false;
+    cam_avi_stop();
+    cam_avi_stats_t st;
+    cam_avi_get_stats(&st);
+    float sec = st.duration_us / 1e6f;
+    ESP_LOGI(TAG, "recording: %lu frames, %.1f fps, %lu dropped, %.1f s, %lu KB at %.0f KB/s, write %.0f KB/s (max %.1f ms), ring peak %lu KB",
+             (unsigned long)st.frames, sec > 0 ? (st.frames - 1) / sec : 0.0f, (unsigned long)st.dropped, sec,
+             (unsigned long)(st.bytes / 1024), sec > 0 ? st.bytes / 1024.0 / sec : 0.0,
+             st.write_us ? st.bytes * 1e6 / 1024.0 / st.write_us : 0.0, st.max_write_us / 1000.0,
+             (unsigned long)st.ring_peak / 1024);
+    sensor_t *sensor = esp_camera_sensor_get();
+    sensor->set_framesize(sensor, CAMERA_JPEG_FRAMESIZE);
+    cam_motion_reset();
+    if (cam_stream_active()) {
+        // 还在直播 要切回去的模式交给直播停的时候切
+        if (s_rec_prev_mode != BSP_CAMERA_JPEG) {
+            s_live_prev_mode = s_rec_prev_mode;
+        }
+    } else if (s_rec_prev_mode != BSP_CAMERA_JPEG) {
+        camera_pause(direct);
+        camera_resume(direct, s_rec_prev_mode);
+    }
+    ui_post_call(camera_rec_label, NULL);
+}
+
+// 直播时每秒刷新一次 地址 观看人数 发出去的帧率和字节数
+static void camera_live_label(void *arg)
+{
+    static cam_stream_stats_t s_prev;
+    static int64_t s_t_prev;
+    if (s_cam_live_label == NULL) {
+        return;
+    }
+    if (!cam_stream_active()) {
+        lv_label_set_text(s_cam_live_label, "LIVE");
+        s_t_prev = 0;
+        return;
+    }
+    cam_stream_stats_t st;
+    cam_stream_get_stats(&st);
+    int64_t now = esp_timer_get_time();
+    float sec = (now - s_t_prev) / 1e6f;
+    if (s_t_prev == 0 || st.sent < s_prev.sent) {
+        sec = 0;
+    }
+    char ip[16];
+    if (!wifi_svc_get_ip(ip, sizeof(ip))) {
+        strlcpy(ip, "no ip", sizeof(ip));
+    }
+    char text[64];
+    snprintf(text, sizeof(text), "%s %lu " LV_SYMBOL_EYE_OPEN " %.1ffps %luKB/s", ip, (unsigned long)st.clients,
+             sec > 0 && st.clients ? (st.sent - s_prev.sent) / sec / st.clients : 0.0f,
+             sec > 0 ? (unsigned long)((st.bytes - s_prev.bytes) / 1024 / sec) : 0UL);
+    lv_label_set_text(s_cam_live_label, text);
+    s_prev = st;
+    s_t_prev = now;
+}
+
+// 直播要JPEG 不是JPEG模式先切过去 录像时已经是JPEG了
+static void camera_live_start(bool direct)
+{
+    char ip[16];
+    if (!wifi_svc_get_ip(ip, sizeof(ip))) {
+        ESP_LOGW(TAG, "streaming needs WiFi, connect in WLAN settings first");
+        return;
+    }
+    s_live_prev_mode = bsp_camera_get_mode();
+    if (s_live_prev_mode != BSP_CAMERA_JPEG) {
+        camera_pause(direct);
+        camera_resume(direct, BSP_CAMERA_JPEG);
+    }
+    if (bsp_camera_get_mode() == BSP_CAMERA_JPEG && cam_stream_start() == ESP_OK) {
+        ESP_LOGI(TAG, "streaming at http://%s:%d/stream", ip, CONFIG_APP_STREAM_PORT);
+        ui_post_call(camera_live_label, NULL);
+        return;
+    }
+    ESP_LOGW(TAG, "streaming needs a JPEG sensor");
+    if (s_live_prev_mode != bsp_camera_get_mode()) {
+        camera_pause(direct);
+        camera_resume(direct, s_live_prev_mode);
+    }
+}
+
+static void camera_live_stop(bool direct)
+{
+    cam_stream_stop();
+    cam_stream_stats_t st;
+    cam_stream_get_stats(&st);
+    ESP_LOGI(TAG, "streaming: %lu viewers (%lu rejected), %lu frames copied (%.2f ms each), %lu skipped, %lu too big",
+             (unsigned long)st.connections, (unsigned long)st.rejected, (unsigned long)st.published,
+             st.published ? st.copy_us / 1000.0 / st.published : 0.0, (unsigned long)st.skipped, (unsigned long)st.oversized);
+    ESP_LOGI(TAG, "streaming: %lu frames sent, %lu KB, %.1f ms/frame send (max %.1f ms)", (unsigned long)st.sent,
+             (unsigned long)(st.bytes / 1024), st.sent ? st.send_us / 1000.0 / st.sent : 0.0, st.max_send_us / 1000.0);
+    if (cam_avi_active()) {
+        if (s_live_prev_mode != BSP_CAMERA_JPEG) {
+            s_rec_prev_mode = s_live_prev_mode;
+        }
+    } else if (s_live_prev_mode != BSP_CAMERA_JPEG) {
+        camera_pause(direct);
+        camera_resume(direct, s_live_prev_mode);
+    }
+    ui_post_call(camera_live_label, NULL);
+}
+
+// 移动侦测开着时每秒刷新一次 在动的块数和每帧分析的耗时 有动静时前面加个点
+static void camera_motion_label(void *arg)
+{
+    if (s_cam_motion_label == NULL) {
+        return;
+    }
+    if (!cam_motion_active()) {
+        lv_label_set_text(s_cam_motion_label, "MOT");
+        return;
+    }
+    cam_motion_stats_t st;
+    cam_motion_get_stats(&st);
+    char text[40];
+    snprintf(text, sizeof(text), "%s%lu %.2fms", cam_motion_moving() ? LV_SYMBOL_BULLET : "",
+             (unsigned long)st.last_blocks,
+             st.frames ? (st.analyse_us + st.downsample_us) / 1000.0f / st.frames : 0.0f);
+    lv_label_set_text(s_cam_motion_label, text);
+}
+
+static void camera_motion_toggle(void)
+{
+    if (!cam_motion_active()) {
+        cam_motion_start();
+        ui_post_call(camera_motion_label, NULL);
+        return;
+    }
+    cam_motion_stop();
+    cam_motion_stats_t st;
+    cam_motion_get_stats(&st);
+    ESP_LOGI(TAG, "motion: %lu frames analysed, %lu skipped busy, %lu with motion, %lu triggers, "
+             "%.2f ms/frame downsample + %.2f ms/frame analyse (max %.2f ms)",
+             (unsigned long)st.frames, (unsigned long)st.busy, (unsigned long)st.motion_frames,
+             (unsigned long)st.triggers, st.frames ? st.downsample_us / 1000.0 / st.frames : 0.0,
+             st.frames ? st.analyse_us / 1000.0 / st.frames : 0.0, st.max_analyse_us / 1000.0);
+    ui_post_call(camera_motion_label, NULL);
+}
+
+// 侦测到动静 按配置拍一张或者开始录像 侦测开的录像画面静下来就停
+static void camera_motion_poll(void)
+{
+    if (!cam_motion_active()) {
+        return;
+    }
+    bool trigger = cam_motion_take_trigger();
+#if CONFIG_APP_MOTION_RECORD
+    if (trigger && !cam_avi_active()) {
+        s_rec_requested = true;
+        s_motion_rec = true;
+    } else if (s_motion_rec && cam_avi_active() && !cam_motion_moving()) {
+        s_rec_requested = true;
+    }
+#else
+    if (trigger) {
+        s_capture_requests++;
+    }
+#endif
+}
+
+#if CONFIG_APP_CAMERA_FACE
+// 在LVGL任务里挪框 多出来的藏起来 直通预览时不叠加这些框
+static void camera_face_boxes(void *arg)
+{
+    if (s_cam_face_boxes[0] == NULL) {
+        return;
+    }
+    cam_face_result_t r;
+    cam_face_get_result(&r);
+    for (int i = 0; i < CAM_FACE_MAX; i++) {
+        if (i < r.count && cam_face_active()) {
+            lv_obj_set_pos(s_cam_face_boxes[i], r.box[i].x, r.box[i].y);
+            lv_obj_set_size(s_cam_face_boxes[i], r.box[i].w, r.box[i].h);
+            lv_obj_clear_flag(s_cam_face_boxes[i], LV_OBJ_FLAG_HIDDEN);
+        } else {
+            lv_obj_add_flag(s_cam_face_boxes[i], LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+}
+
+// 每秒一次的检测帧率 预览帧率和PSRAM 摄像头任务算好了传进来
+static char s_face_text[64];
+
+static void camera_face_label(void *arg)
+{
+    if (s_cam_face_label == NULL) {
+        return;
+    }
+    if (!cam_face_active()) {
+        lv_obj_add_flag(s_cam_face_label, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    lv_label_set_text(s_cam_face_label, s_face_text);
+    lv_obj_clear_flag(s_cam_face_label, LV_OBJ_FLAG_HIDDEN);
+}
+
+// 上一秒的计数 算检测 预览帧率和估算的PSRAM流量
+typedef struct {
+    int64_t t;
+    uint32_t rendered;
+    uint32_t detected;
+    uint64_t cam_bytes;
+    uint64_t src_bytes;
+} camera_face_mark_t;
+
+static void camera_face_tick(camera_face_mark_t *mark, uint64_t cam_bytes, bool direct)
+{
+    int64_t now = esp_timer_get_time();
+    if (mark->t && now - mark->t < 1000000) {
+        return;
+    }
+    cam_face_stats_t st;
+    cam_face_get_stats(&st);
+    uint32_t rendered = s_cam_rendered;
+    if (direct) {
+        bsp_preview_stats_t ps;
+        bsp_display_get_preview_stats(&ps);
+        rendered = ps.frames;
+    }
+    // 刚打开或者切过模式(run.bytes从0算) 这一秒只记起点
+    if (mark->t && cam_bytes >= mark->cam_bytes) {
+        float sec = (now - mark->t) / 1e6f;
+        // 摄像头DMA写一遍 预览读一遍(直通时拷进DMA带区) 取样读隔行的缓存行 模型自己的读写算不出来 看实测的
+        uint64_t bytes = (cam_bytes - mark->cam_bytes) + (uint64_t)(rendered - mark->rendered) * 320 * 240 * 2 +
+                         (st.src_bytes - mark->src_bytes);
+        snprintf(s_face_text, sizeof(s_face_text), "det %.1f view %.1f fps PSRAM %.1f/%.1f MB/s",
+                 (st.frames - mark->detected) / sec, (rendered - mark->rendered) / sec, bytes / sec / 1048576,
+                 st.probe_kbps_busy / 1024.0f);
+        ui_post_call(camera_face_label, NULL);
+    }
+    mark->t = now;
+    mark->rendered = rendered;
+    mark->detected = st.frames;
+    mark->cam_bytes = cam_bytes;
+    mark->src_bytes = st.src_bytes;
+}
+
+static void camera_face_toggle(void)
+{
+    if (!cam_face_active()) {
+        if (cam_face_start() == ESP_OK) {
+            s_face_seq = 0;
+            snprintf(s_face_text, sizeof(s_face_text), "face ...");
+        }
+        ui_post_call(camera_face_label, NULL);
+        return;
+    }
+    cam_face_stop();
+    cam_face_stats_t st;
+    cam_face_get_stats(&st);
+    float sec = (esp_timer_get_time() - st.t0) / 1e6f;
+    ESP_LOGI(TAG, "face: %lu frames detected (%.1f fps), %lu of %lu offered skipped busy, %lu faces, "
+             "%.2f ms/frame sample + %.1f ms/frame infer (max %.1f ms), input in %s",
+             (unsigned long)st.frames, sec > 0 ? st.frames / sec : 0.0f, (unsigned long)st.busy,
+             (unsigned long)st.offered, (unsigned long)st.faces, st.offered ? st.sample_us / 1000.0 / st.offered : 0.0,
+             st.frames ? st.infer_us / 1000.0 / st.frames : 0.0, st.max_infer_us / 1000.0,
+             st.in_internal ? "internal RAM" : "PSRAM");
+    ESP_LOGI(TAG, "face PSRAM copy throughput: %.1f MB/s before detecting, %.1f MB/s while detecting",
+             st.probe_kbps_first / 1024.0, st.probe_kbps_busy / 1024.0);
+    ui_post_call(camera_face_boxes, NULL);
+    ui_post_call(camera_face_label, NULL);
+}
+
+// 有新的检测结果才去挪框
+static void camera_face_poll(void)
+{
+    if (!cam_face_active()) {
+        return;
+    }
+    cam_face_result_t r;
+    cam_face_get_result(&r);
+    if (r.seq != s_face_seq) {
+        s_face_seq = r.seq;
+        ui_post_call(camera_face_boxes, NULL);
+    }
+}
+#endif
+
+// 每一档的预览帧率 换档时和退出时打
+static void camera_zoom_log(const char *why)
+{
+    cam_zoom_stats_t zs;
+    cam_zoom_get_stats(&zs);
+    if (zs.switches == 0 && zs.pans == 0) {
+        return;
+    }
+    ESP_LOGI(TAG, "zoom %s: 1x %.1f fps (%lu frames), 2x %.1f fps (%lu frames), %lu switches, %lu pans, "
+             "%.2f ms/write, %lu failed",
+             why, zs.us[0] ? zs.frames[0] * 1e6 / zs.us[0] : 0.0, (unsigned long)zs.frames[0],
+             zs.us[1] ? zs.frames[1] * 1e6 / zs.us[1] : 0.0, (unsigned long)zs.frames[1], (unsigned long)zs.switches,
+             (unsigned long)zs.pans, zs.switches + zs.pans ? zs.write_us / 1000.0 / (zs.switches + zs.pans) : 0.0,
+             (unsigned long)zs.failed);
+}
+
+// 一帧: 拍照 连拍 JPEG解码 推预览 frame最后要么还了要么交给了LVGL
+static void camera_handle_frame(camera_fb_t *frame, bool direct)
+{
+    // 如果请求拍照 拷一份交给写盘任务 预览不等SD卡
+    if (s_burst_requested)
+    {
+        s_burst_requested = false;
+        cam_capture_burst_begin(CAM_CAPTURE_BURST);
+    }
+    if (cam_capture_burst_active())
+    {
+        // 连拍时只管拷帧 不推预览 尽量跟上摄像头的帧率
+        cam_capture_burst_frame(frame);
+        esp_camera_fb_return(frame);
+        return;
+    }
+    if (s_capture_served != s_capture_requests)
+    {
+        s_capture_served++;
+        if (!cam_capture_submit(frame)) {
+            ESP_LOGW(TAG, "Capture dropped, %d frames still being saved", CAM_CAPTURE_SLOTS);
+        }
+    }
+    // 没人在看时马上返回 不拷
+    cam_stream_frame(frame);
+#if CONFIG_APP_INTERCOM
+    intercom_video_frame(frame);
+#endif
+    if (cam_avi_active())
+    {
+        cam_avi_frame(frame);
+        if (s_rec_seen++ & 1) {
+            esp_camera_fb_return(frame);
+            return;
+        }
+    }
+    if (frame->format == PIXFORMAT_JPEG)
+    {
+        // 解进预览缓冲 驱动的帧马上还回去
+        camera_fb_t *view = cam_jpeg_view(frame);
+        esp_camera_fb_return(frame);
+        if (view == NULL) {
+            return;
+        }
+        frame = view;
+    }
+    // 只在侦测任务空着的时候缩一份亮度 马上返回
+    cam_motion_frame(frame);
+#if CONFIG_APP_CAMERA_FACE
+    cam_face_frame(frame);
+#endif
+    if (direct)
+    {
+        bsp_display_preview_frame(frame->buf, frame->width, frame->height);
+        camera_fb_release(frame);
+    }
+    else if (!ui_post_call(camera_show_frame, frame))
+    {
+        // 帧交给LVGL 由它画完下一帧后归还 投递失败才自己还
+        camera_fb_release(frame);
+    }
+}
+
+// 在LVGL任务里退出摄像头界面 帧缓冲已经还给驱动 不能再让lv_img引用
+static void camera_exit(void *arg)
+{
+    lv_img_set_src(img_camera, NULL);
+    ui_screen_leave(4);
+    idle_mgr_inhibit(false);
+    pm_ctl_set(PM_CLIENT_CAMERA, false);
+}
+
+static void task_process_camera(void *arg)
+{
+    // 扫码刚用过 摄像头还没关 开着的是灰度
+    if (bsp_camera_get_mode() != s_cam_mode) {
+        esp_camera_deinit();
+        bsp_camera_init_mode(s_cam_mode);
+        s_cam_mode = bsp_camera_get_mode();
+        ui_post_call(camera_mode_label, NULL);
+    }
+    cam_capture_start();
+    cam_zoom_reset();
+    s_zoom_logged = 0;
+    s_capture_served = s_capture_requests; // 上次没来得及拍的不算
+    s_burst_requested = false;
+    uint32_t frames = 0;
+    int64_t t0 = esp_timer_get_time();
+    bsp_disp_flush_stats_t fl0;
+    bsp_display_get_flush_stats(BSP_DISP_RENDER_PARTIAL, &fl0);
+#if CONFIG_APP_CAMERA_DIRECT_PREVIEW
+    bool direct = bsp_display_preview_begin(s_cam_overlays, 7) == ESP_OK;
+#else
+    bool direct = false;
+#endif
+    if (!direct) {
+        if (s_cam_released == NULL) {
+            s_cam_released = xSemaphoreCreateBinary();
+        }
+        s_cam_rendered = 0;
+        s_cam_skipped = 0;
+        ui_lock(0);
+        bsp_display_set_rendered_cb(camera_rendered, NULL);
+        ui_unlock();
+    }
+
+    camera_run_t run;
+    camera_run_begin(&run);
+    int64_t t_rec_label = 0;
+    int64_t t_motion_label = 0;
+    int64_t t_last_frame = 0, gap_avg = 0;
+    uint32_t skipped_seen = 0;
+#if CONFIG_APP_CAMERA_FACE
+    camera_face_mark_t face_mark = { 0 };
+#endif
+    while (icon_flag == 4)
+    {
+        // 连拍没拍完不切 槽位里的帧格式要一样才好算帧率
+        if (s_cam_mode_requested && !cam_capture_burst_active())
+        {
+            s_cam_mode_requested = false;
+            camera_run_log(&run);
+            camera_switch_mode(direct);
+            camera_run_begin(&run);
+        }
+        if (s_rec_requested && !cam_capture_burst_active())
+        {
+            s_rec_requested = false;
+            if (cam_avi_active()) {
+                camera_record_stop(direct);
+            } else {
+                camera_record_start(direct);
+            }
+        }
+        if (s_motion_requested)
+        {
+            s_motion_requested = false;
+            camera_motion_toggle();
+        }
+        camera_motion_poll();
+#if CONFIG_APP_CAMERA_FACE
+        if (s_face_requested)
+        {
+            s_face_requested = false;
+            camera_face_toggle();
+            face_mark.t = 0;
+        }
+        if (cam_face_active())
+        {
+            camera_face_poll();
+            camera_face_tick(&face_mark, run.bytes, direct);
+        }
+#endif
+        if (s_live_requested && !cam_capture_burst_active())
+        {
+            s_live_requested = false;
+            if (cam_stream_active()) {
+                camera_live_stop(direct);
+            } else {
+                camera_live_start(direct);
+            }
+        }
+        if (cam_avi_active() || cam_stream_active())
+        {
+            // 录像和直播时不切模式也不开始延时摄影
+            s_cam_mode_requested = false;
+            s_timelapse_requested = false;
+            if (esp_timer_get_time() - t_rec_label > 1000000) {
+                t_rec_label = esp_timer_get_time();
+                if (cam_avi_active()) {
+                    ui_post_call(camera_rec_label, NULL);
+                }
+                if (cam_stream_active()) {
+                    ui_post_call(camera_live_label, NULL);
+                }
+            }
+        }
+        if (cam_motion_active() && esp_timer_get_time() - t_motion_label > 1000000)
+        {
+            t_motion_label = esp_timer_get_time();
+            ui_post_call(camera_motion_label, NULL);
+        }
+#if CONFIG_APP_CAPTURE_HIRES
+        // RGB565模式的单拍走大分辨率 JPEG本来就是大分辨率 录像直播时不切
+        if (s_capture_served != s_capture_requests && bsp_camera_get_mode() == BSP_CAMERA_RGB565 &&
+            !cam_capture_burst_active() && !cam_avi_active() && !cam_stream_active())
+        {
+            s_capture_served = s_capture_requests; // 切换期间多按的几下合成一张
+            camera_run_log(&run);
+            camera_capture_hires(direct);
+            camera_run_begin(&run);
+        }
+#endif
+        if (s_timelapse_requested && !cam_capture_burst_active())
+        {
+            s_timelapse_requested = false;
+            camera_run_log(&run);
+            camera_timelapse(direct);
+            camera_run_begin(&run);
+        }
+        int zoom_step = cam_zoom_step();
+        if (cam_zoom_poll() && zoom_step != s_zoom_logged)
+        {
+            s_zoom_logged = zoom_step;
+            camera_zoom_log(zoom_step ? "-> 2x" : "-> 1x");
+        }
+        camera_fb_t *frame = esp_camera_fb_get();
+        SYS_TRACE_MARK("cam_fb", frame ? frame->len / 1024 : 0);    // VSYNC在驱动里跟不到 拿到帧的时刻代替
+        if(!frame)
+        {
+            ESP_LOGE(TAG, "Camera get failed");
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+            continue;
+        }
+        int64_t t1 = esp_timer_get_time();
+        run.bytes += frame->len;
+        // 帧缓冲是DMA写进PSRAM的 隔得比平时久一半或者预览跳了帧 就是PSRAM带宽不够了
+        psram_bw_add(PSRAM_BW_SRC_CAMERA, frame->len);
+        int64_t gap = t_last_frame ? t1 - t_last_frame : 0;
+        psram_bw_rt(PSRAM_BW_RT_CAMERA, (gap_avg && gap > gap_avg * 3 / 2) || s_cam_skipped != skipped_seen);
+        gap_avg = gap_avg ? (gap_avg * 7 + gap) / 8 : gap;
+        t_last_frame = t1;
+        skipped_seen = s_cam_skipped;
+        camera_handle_frame(frame, direct);
+        run.busy_us += esp_timer_get_time() - t1;
+        run.frames++;
+        frames++;
+    }
+    if (cam_avi_active()) {
+        camera_record_stop(direct);
+    }
+    if (cam_stream_active()) {
+        camera_live_stop(direct);
+    }
+    if (cam_motion_active()) {
+        camera_motion_toggle();
+    }
+#if CONFIG_APP_CAMERA_FACE
+    if (cam_face_active()) {
+        camera_face_toggle();
+    }
+#endif
+    camera_run_log(&run);
+    camera_zoom_log("on exit");
+// 退出任务把原本的东西放进btn中
+
+    // 两种预览方式的帧率和每帧拷贝次数 LVGL路径按它重画的像素数折算
+    float sec = (esp_timer_get_time() - t0) / 1e6f;
+    if (direct)
+    {
+        bsp_preview_stats_t st;
+        bsp_display_preview_end();
+        bsp_display_get_preview_stats(&st);
+        ESP_LOGI(TAG, "camera preview (direct): %lu frames, %.1f fps, %.2f copies/frame, %.1f ms/frame push, %lu overlay px/frame",
+                 (unsigned long)st.frames, st.wall_us ? st.frames * 1e6 / st.wall_us : 0.0,
+                 st.frames ? (double)st.copy_bytes / st.frames / (BSP_LCD_H_RES * BSP_LCD_V_RES * 2) : 0.0,
+                 st.frames ? st.push_us / 1000.0 / st.frames : 0.0, st.frames ? (unsigned long)(st.blend_px / st.frames) : 0UL);
+    }
+    else
+    {
+        // 帧都还回去才能去初始化摄像头
+        if (ui_post_call(camera_release_frames, NULL)) {
+            xSemaphoreTake(s_cam_released, portMAX_DELAY);
+        }
+        if (frames) {
+            bsp_disp_flush_stats_t fl1;
+            bsp_display_get_flush_stats(BSP_DISP_RENDER_PARTIAL, &fl1);
+            ESP_LOGI(TAG, "camera preview (lvgl): %lu frames, %.1f fps, %lu rendered (%.1f fps), %lu skipped, %.2f copies/frame, %d fbs",
+                     (unsigned long)frames, sec > 0 ? frames / sec : 0.0f, (unsigned long)s_cam_rendered,
+                     sec > 0 ? s_cam_rendered / sec : 0.0f, (unsigned long)s_cam_skipped,
+                     (double)(fl1.px_rendered - fl0.px_rendered) / frames / (BSP_LCD_H_RES * BSP_LCD_V_RES), CAMERA_FB_COUNT);
+        }
+    }
+
+#if CONFIG_APP_CAPTURE_HIRES
+    if (s_hires.shots) {
+        uint32_t n = s_hires.shots;
+        ESP_LOGI(TAG, "hi-res capture: %lu shots, %lu failed, avg switch %.0f ms, settle %.0f ms, save %.0f ms, "
+                 "back to preview %.0f ms, max total %.0f ms",
+                 (unsigned long)n, (unsigned long)s_hires.failed, s_hires.to_hires_us / 1000.0 / n,
+                 s_hires.settle_us / 1000.0 / n, s_hires.save_us / 1000.0 / n, s_hires.back_us / 1000.0 / n,
+                 s_hires.max_total_us / 1000.0);
+        memset(&s_hires, 0, sizeof(s_hires));
+    }
+#endif
+    cam_capture_stop(); // 还在排队的照片写完
+    cam_capture_stats_t cs;
+    cam_capture_get_stats(&cs);
+    if (cs.queued + cs.dropped) {
+        ESP_LOGI(TAG, "capture: %lu saved, %lu failed, %lu dropped, max depth %lu, avg %.1f ms to disk (max %.1f ms), copy %.1f ms",
+                 (unsigned long)cs.saved, (unsigned long)cs.failed, (unsigned long)cs.dropped, (unsigned long)cs.max_depth,
+                 cs.saved ? cs.latency_us / 1000.0 / cs.saved : 0.0, cs.max_latency_us / 1000.0,
+                 cs.queued ? cs.copy_us / 1000.0 / cs.queued : 0.0);
+        if (cs.bursts) {
+            ESP_LOGI(TAG, "burst: %lu bursts, %lu frames, %lu dropped, last %.1f fps", (unsigned long)cs.bursts,
+                     (unsigned long)cs.burst_frames, (unsigned long)cs.burst_dropped, cs.last_burst_fps);
+        }
+    }
+    cam_jpeg_deinit(); // 预览缓冲上面都已经收回来了
+    ui_post_call(camera_exit, NULL); // 隐藏摄像头画布 摄像头等app_res过一会再关
+
+    vTaskDelete(NULL);
+
+}
+
+// 返回主界面按钮事件处理函数
+//lvgl任务，如果在这这里面删除，可能上面会的task_camera还在运行，导致冲突崩溃
+
+static void btn_camback_cb(lv_event_t *e)
+{
+    icon_flag = 0;
+}
+// 拍摄界面按钮处理函数
+static void btn_capture_cb(lv_event_t *e)
+{
+    s_capture_requests++;
+}
+
+// 长按拍照键连拍
+static void btn_capture_long_cb(lv_event_t *e)
+{
+    s_burst_requested = true;
+}
+
+// RGB565和JPEG来回切 摄像头任务里去做
+static void btn_cam_mode_cb(lv_event_t *e)
+{
+    s_cam_mode_requested = true;
+}
+
+// 开始延时摄影 按BOOT键结束
+static void btn_timelapse_cb(lv_event_t *e)
+{
+    s_timelapse_requested = true;
+}
+
+// 开始/停止录像
+static void btn_record_cb(lv_event_t *e)
+{
+    s_rec_requested = true;
+}
+
+// 开始/停止直播
+static void btn_live_cb(lv_event_t *e)
+{
+    s_live_requested = true;
+}
+
+// 打开/关闭移动侦测
+static void btn_motion_cb(lv_event_t *e)
+{
+    s_motion_requested = true;
+}
+
+#if CONFIG_APP_CAMERA_FACE
+// 长按移动侦测按钮 打开/关闭人脸检测
+static void btn_face_cb(lv_event_t *e)
+{
+    s_face_requested = true;
+}
+#endif
+
+// 双指张开合拢换档 2x时单指拖动平移 只记请求 寄存器在摄像头任务里写
+static void camera_zoom_touch_cb(lv_event_t *e)
+{
+    if (lv_event_get_code(e) == LV_EVENT_RELEASED) {
+        s_pinch_d0 = 0;
+        s_pinch_skip = false;
+        return;
+    }
+    lv_point_t pt[2];
+    if (bsp_touch_get_points(pt, 2) >= 2) {
+        int32_t dx = pt[0].x - pt[1].x, dy = pt[0].y - pt[1].y;
+        int64_t d = LV_MAX((int64_t)dx * dx + (int64_t)dy * dy, 1); // 比距离的平方 不开方
+        const int64_t pct2 = CAM_ZOOM_PINCH_PCT * CAM_ZOOM_PINCH_PCT;
+        if (s_pinch_d0 == 0) {
+            s_pinch_d0 = d;
+        } else if (d * 10000 >= s_pinch_d0 * pct2 || d * pct2 <= s_pinch_d0 * 10000) {
+            // 一档换完从这个距离重新算 来回捏可以连着换
+            cam_zoom_request(d > s_pinch_d0 ? cam_zoom_step() + 1 : cam_zoom_step() - 1);
+            s_pinch_d0 = d;
+        }
+        s_pinch_skip = true;
+        return;
+    }
+    lv_point_t vect;
+    lv_indev_get_vect(lv_indev_get_act(), &vect);
+    if (s_pinch_skip) {
+        s_pinch_skip = false;
+        s_pinch_d0 = 0;
+        return;
+    }
+    if (cam_zoom_step() > 0 && (vect.x || vect.y)) {
+        cam_zoom_pan(vect.x, vect.y);
+    }
+}
+
+// 预览图像 返回键和拍照键
+static void camera_build(lv_obj_t *root)
+{
+    img_camera = lv_img_create(root);
+    lv_obj_set_pos(img_camera, 0, 0);
+    lv_obj_set_size(img_camera, 320, 240);
+    lv_obj_add_flag(img_camera, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(img_camera, camera_zoom_touch_cb, LV_EVENT_PRESSING, NULL);
+    lv_obj_add_event_cb(img_camera, camera_zoom_touch_cb, LV_EVENT_RELEASED, NULL);
+#if CONFIG_APP_CAMERA_FACE
+    // 人脸框 盖在预览上 在按钮下面 不挡点击
+    for (int i = 0; i < CAM_FACE_MAX; i++) {
+        lv_obj_t *box = lv_obj_create(root);
+        lv_obj_set_style_bg_opa(box, LV_OPA_TRANSP, 0);
+        lv_obj_set_style_border_color(box, lv_color_hex(0x30e030), 0);
+        lv_obj_set_style_border_width(box, 2, 0);
+        lv_obj_set_style_radius(box, 0, 0);
+        lv_obj_set_style_pad_all(box, 0, 0);
+        lv_obj_clear_flag(box, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(box, LV_OBJ_FLAG_HIDDEN);
+        s_cam_face_boxes[i] = box;
+    }
+#endif
+
+    // 创建返回按钮
+    lv_obj_t *btn_back = lv_btn_create(root);
+    lv_obj_align(btn_back, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_camback_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
+    s_cam_overlays[0] = btn_back;
+
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    // 创建拍摄按钮
+    lv_obj_t *btn_capture = lv_btn_create(root);
+    lv_obj_align(btn_capture, LV_ALIGN_BOTTOM_MID, 0, -6);
+    lv_obj_set_size(btn_capture, 56, 56);
+    lv_obj_add_style(btn_capture, ui_style(UI_STYLE_CAPTURE), LV_STATE_DEFAULT);
+    lv_obj_add_style(btn_capture, ui_style(UI_STYLE_CAPTURE_PRESSED), LV_STATE_PRESSED);
+    lv_obj_clear_flag(btn_capture, LV_OBJ_FLAG_CHECKABLE);
+    lv_obj_add_event_cb(btn_capture, btn_capture_cb, LV_EVENT_SHORT_CLICKED, NULL);
+    lv_obj_add_event_cb(btn_capture, btn_capture_long_cb, LV_EVENT_LONG_PRESSED, NULL);
+    s_cam_overlays[1] = btn_capture;
+
+    lv_obj_t *label_capture = lv_label_create(btn_capture);
+
+    lv_label_set_text(label_capture, LV_SYMBOL_LOOP); // 循环符号
+    lv_obj_set_style_text_font(label_capture, &lv_font_montserrat_20, 0);
+    lv_obj_set_style_text_color(label_capture, lv_color_hex(0xffffff), 0);
+    lv_obj_center(label_capture);
+
+    // 创建模式按钮 RGB565预览/JPEG拍照
+    lv_obj_t *btn_mode = lv_btn_create(root);
+    lv_obj_align(btn_mode, LV_ALIGN_TOP_RIGHT, 0, 0);
+    lv_obj_add_style(btn_mode, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_mode, btn_cam_mode_cb, LV_EVENT_CLICKED, NULL);
+    s_cam_overlays[2] = btn_mode;
+
+    s_cam_mode_label = lv_label_create(btn_mode);
+    lv_label_set_text(s_cam_mode_label, s_cam_mode == BSP_CAMERA_JPEG ? "JPG" : "RGB");
+    lv_obj_add_style(s_cam_mode_label, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_center(s_cam_mode_label);
+
+    // 创建延时摄影按钮
+    lv_obj_t *btn_tl = lv_btn_create(root);
+    lv_obj_align(btn_tl, LV_ALIGN_BOTTOM_RIGHT, 0, -18);
+    lv_obj_add_style(btn_tl, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_tl, btn_timelapse_cb, LV_EVENT_CLICKED, NULL);
+    s_cam_overlays[3] = btn_tl;
+
+    lv_obj_t *label_tl = lv_label_create(btn_tl);
+    lv_label_set_text(label_tl, LV_SYMBOL_VIDEO);
+    lv_obj_add_style(label_tl, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_center(label_tl);
+
+    // 创建录像按钮 录的时候显示帧率 丢帧和写盘速度
+    lv_obj_t *btn_rec = lv_btn_create(root);
+    lv_obj_align(btn_rec, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_add_style(btn_rec, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_set_width(btn_rec, LV_SIZE_CONTENT);
+    lv_obj_add_event_cb(btn_rec, btn_record_cb, LV_EVENT_CLICKED, NULL);
+    s_cam_overlays[4] = btn_rec;
+
+    s_cam_rec_label = lv_label_create(btn_rec);
+    lv_label_set_text(s_cam_rec_label, "REC");
+    lv_obj_add_style(s_cam_rec_label, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_set_style_text_font(s_cam_rec_label, &lv_font_montserrat_14, 0);
+    lv_obj_center(s_cam_rec_label);
+
+    // 创建直播按钮 直播时显示地址 观看人数 帧率和流量
+    lv_obj_t *btn_live = lv_btn_create(root);
+    lv_obj_align(btn_live, LV_ALIGN_BOTTOM_LEFT, 0, -18);
+    lv_obj_add_style(btn_live, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_set_width(btn_live, LV_SIZE_CONTENT);
+    lv_obj_add_event_cb(btn_live, btn_live_cb, LV_EVENT_CLICKED, NULL);
+    s_cam_overlays[5] = btn_live;
+
+    s_cam_live_label = lv_label_create(btn_live);
+    lv_label_set_text(s_cam_live_label, "LIVE");
+    lv_obj_add_style(s_cam_live_label, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_set_style_text_font(s_cam_live_label, &lv_font_montserrat_14, 0);
+    lv_obj_center(s_cam_live_label);
+
+    // 创建移动侦测按钮 开着时显示在动的块数和每帧耗时
+    lv_obj_t *btn_motion = lv_btn_create(root);
+    lv_obj_align(btn_motion, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_motion, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_set_width(btn_motion, LV_SIZE_CONTENT);
+#if CONFIG_APP_CAMERA_FACE
+    lv_obj_add_event_cb(btn_motion, btn_motion_cb, LV_EVENT_SHORT_CLICKED, NULL);
+    lv_obj_add_event_cb(btn_motion, btn_face_cb, LV_EVENT_LONG_PRESSED, NULL);
+#else
+    lv_obj_add_event_cb(btn_motion, btn_motion_cb, LV_EVENT_CLICKED, NULL);
+#endif
+    s_cam_overlays[6] = btn_motion;
+
+    s_cam_motion_label = lv_label_create(btn_motion);
+    lv_label_set_text(s_cam_motion_label, "MOT");
+    lv_obj_add_style(s_cam_motion_label, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_set_style_text_font(s_cam_motion_label, &lv_font_montserrat_14, 0);
+    lv_obj_center(s_cam_motion_label);
+#if CONFIG_APP_CAMERA_FACE
+
+    // 人脸检测开着时的检测帧率 预览帧率 估算的PSRAM流量和实测的余量
+    s_cam_face_label = lv_label_create(root);
+    lv_obj_set_style_text_font(s_cam_face_label, &lv_font_montserrat_14, 0);
+    lv_obj_set_style_text_color(s_cam_face_label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_bg_color(s_cam_face_label, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_bg_opa(s_cam_face_label, LV_OPA_50, 0);
+    lv_obj_align(s_cam_face_label, LV_ALIGN_TOP_MID, 0, 44);
+    lv_obj_add_flag(s_cam_face_label, LV_OBJ_FLAG_HIDDEN);
+#endif
+}
+
+// 摄像头初始化 传感器没有JPEG时退回RGB565 也算开好了
+static esp_err_t camera_res_up(void)
+{
+    esp_err_t err = bsp_camera_init_mode(s_cam_res_mode);
+    return err == ESP_ERR_NOT_SUPPORTED ? ESP_OK : err;
+}
+
+// 摄像头任务早就退了 帧也都收回来了
+static void camera_res_down(void)
+{
+    if (esp_camera_sensor_get()) {
+        esp_camera_deinit();
+    }
+    dvp_pwdn(1); // 摄像头进入掉电模式
+}
+
+static const app_res_ops_t s_camera_res = {
+    .up = camera_res_up,
+    .down = camera_res_down,
+};
+
+static const ui_screen_desc_t s_camera_screen = {
+    .name = "camera",
+    .bg_color = 0xcccccc,
+    .res = APP_RES_BIT(APP_RES_CAMERA),
+    .psram_kb = 1024, // 帧缓冲和拍照的一份拷贝
+    .build = camera_build,
+};
+
+// 进入摄像头应用 摄像头在ui_screen_enter里打开
+static void camera_event_handler(lv_event_t *e)
+{
+    s_cam_mode_requested = false;
+    s_timelapse_requested = false;
+    s_rec_requested = false;
+    s_live_requested = false;
+    s_motion_requested = false;
+#if CONFIG_APP_CAMERA_FACE
+    s_face_requested = false;
+#endif
+    s_cam_res_mode = s_cam_mode;
+    icon_in_obj = ui_screen_enter(4, &s_camera_screen);
+    idle_mgr_inhibit(true); // 看预览录像都不碰屏幕 不调暗
+    pm_ctl_set(PM_CLIENT_CAMERA, true); // 也不降频
+
+    icon_flag = 4; // 标记已经进入第四个应用
+
+    task_plan_create(TASK_CAM_VIEW, task_process_camera, NULL, NULL);
+}
+
+// 第一次打开前 开关摄像头交给app_res
+static void camera_init(void)
+{
+    app_res_register(APP_RES_CAMERA, &s_camera_res);
+}
+
+void app_camera_res_mode(bsp_camera_mode_t mode)
+{
+    s_cam_res_mode = mode;
+    app_res_register(APP_RES_CAMERA, &s_camera_res); // 扫码可能比相机先打开
+}
+
+// 录像开着文件 交给相机任务走正常的停止流程 传感器和模式也恢复原样 等不到就直接停
+static void camera_sd_removed(void)
+{
+    if (cam_avi_active()) {
+        s_rec_requested = true;
+        for (int i = 0; i < APP_SD_PULL_STOP_MS / 50 && cam_avi_active(); i++) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
+        if (cam_avi_active()) {
+            cam_avi_stop();
+        }
+    }
+}
+
+const app_mod_t app_mod_camera = {
+    .name = "camera",
+    .id = 4,
+    .color = 0xd8b010,
+    .icon = "img_camera_icon",
+    .init = camera_init,
+    .open = camera_event_handler,
+    .back = btn_camback_cb,
+    .sd_removed = camera_sd_removed,
+};
@@ -0,0 +1,711 @@
+#include "app_mod.h"
+#include "ui_perf.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "pic_cache.h"
+#include "pic_thumb.h"
+#include "ui_vgrid.h"
+#include "ui_slide.h"
+#include "sd_fs.h"
+#include "media_type.h"
+#include "media_lib.h"
+#include "esp32_s3_szp.h"
+#include "boot.h"
+#include "file_iterator.h"
+#include "gallery_index.h"
+#include "ui_vlist.h"
+#include "net_pic.h"
+#include <time.h>
+
+static const char *TAG = "app_gallery";
+
+/******************************** 第7个图标 图库设置 应用程序***********************************************************************************/
+lv_obj_t *pic_title_label;
+lv_obj_t *btn_pic_back;
+lv_obj_t *img_in_obj;
+static char g_img_path[128];
+static char g_lv_img_path[140];
+static const lv_img_dsc_t *s_pic_img;  // img_in_obj正在显示的缓存图片
+
+#define LVGL_STDIO_DRIVE SD_FS_DRIVE   // 带预读的SD盘符 关掉时是stdio的"A:"
+
+static void set_img_src_from_fs_path(const char *fs_path)
+{
+    if (!fs_path || fs_path[0] == '\0') {
+        return;
+    }
+    /* Build LVGL path with stdio drive letter so LVGL can open the file */
+    // 先换上新图再放掉旧的 解码好的图在缓存里 重画不用再读SD卡
+    const lv_img_dsc_t *img = pic_cache_acquire(fs_path);
+    if (img) {
+        lv_img_set_src(img_in_obj, img);
+    } else {
+        lv_snprintf(g_lv_img_path, sizeof(g_lv_img_path), LVGL_STDIO_DRIVE "%s", fs_path);
+        lv_img_set_src(img_in_obj, g_lv_img_path);
+    }
+    pic_cache_release(s_pic_img);
+    s_pic_img = img;
+}
+
+static file_iterator_instance_t *img_file_iterator = NULL;
+#define PIC_PREFETCH_DEPTH 2    // 前后各预取几张
+#define PIC_GRID_COLS      3
+#define PIC_GRID_CELL_H    80   // 96x72的缩略图加上间隙
+#define PIC_DAY_ROW_H      36
+
+// 目录里的图片 .thumbs目录和其他文件不算 按拍摄时刻新的在前 翻页和网格都按这个顺序 每项是img_file_iterator里的下标
+static int *s_pics = NULL;
+static int64_t *s_pic_when = NULL;      // 和s_pics一一对应 拍摄时刻 见gallery_index.h
+static int s_pic_count = 0;
+static int s_pic_pos = 0;
+static lv_obj_t *s_pic_root = NULL;
+static lv_obj_t *s_pic_grid = NULL;     // 缩略图网格 第一次切换时才创建
+static lv_obj_t *s_pic_slide = NULL;    // 正在放的幻灯片
+static lv_obj_t *s_pic_play_label = NULL;
+
+// 按天分组 s_pics里同一天的连在一起 点标题弹出日期列表跳过去
+typedef struct {
+    int first;          // 这天最新的一张在s_pics里的位置
+    int count;
+    int64_t when;
+} pic_day_t;
+static pic_day_t *s_days = NULL;
+static int s_day_count = 0;
+static lv_obj_t *s_pic_days = NULL;
+#if CONFIG_APP_NET_PIC
+static lv_obj_t *s_pic_net = NULL;      // 网络相框 开着时翻页和播放都归它
+static lv_timer_t *s_pic_net_timer = NULL;
+#endif
+
+typedef struct {
+    int64_t when;
+    int index;
+} pic_order_t;
+
+static bool pic_is_image(const char *name)
+{
+    return media_type_name(name) == MEDIA_TYPE_IMAGE;
+}
+
+// 新的在前 同一秒的按名字 后面带_n序号的是后拍的
+static int pic_order_cmp(const void *a, const void *b)
+{
+    const pic_order_t *pa = a;
+    const pic_order_t *pb = b;
+    if (pa->when != pb->when) {
+        return pa->when < pb->when ? 1 : -1;
+    }
+    return -strcmp(file_iterator_get_name_from_index(img_file_iterator, pa->index),
+                   file_iterator_get_name_from_index(img_file_iterator, pb->index));
+}
+
+static int pic_day_key(int64_t when)
+{
+    time_t t = (time_t)when;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+static void pic_days_build(void)
+{
+    s_day_count = 0;
+    s_days = malloc((s_pic_count ? s_pic_count : 1) * sizeof(pic_day_t));
+    if (s_days == NULL) {
+        return;
+    }
+    int last = -1;
+    for (int i = 0; i < s_pic_count; i++) {
+        int key = pic_day_key(s_pic_when[i]);
+        if (key != last) {
+            s_days[s_day_count++] = (pic_day_t){.first = i, .when = s_pic_when[i]};
+            last = key;
+        }
+        s_days[s_day_count - 1].count++;
+    }
+}
+
+// 先挑出图片 再查索引拿拍摄时刻排序 目录不用再扫一遍
+static void pic_list_build(void)
+{
+    free(s_pics);
+    free(s_pic_when);
+    free(s_days);
+    s_pics = NULL;
+    s_pic_when = NULL;
+    s_days = NULL;
+    s_day_count = 0;
+    s_pic_count = 0;
+    s_pic_pos = 0;
+    if (img_file_iterator->count == 0) {
+        return;
+    }
+    s_pics = malloc(img_file_iterator->count * sizeof(int));
+    s_pic_when = calloc(img_file_iterator->count, sizeof(int64_t));
+    const char **names = malloc(img_file_iterator->count * sizeof(char *));
+    pic_order_t *order = malloc(img_file_iterator->count * sizeof(pic_order_t));
+    if (s_pics == NULL || s_pic_when == NULL || names == NULL || order == NULL) {
+        free(s_pics);
+        free(s_pic_when);
+        free(names);
+        free(order);
+        s_pics = NULL;
+        s_pic_when = NULL;
+        return;
+    }
+    for (size_t i = 0; i < img_file_iterator->count; i++) {
+        const char *name = file_iterator_get_name_from_index(img_file_iterator, i);
+        if (name && pic_is_image(name)) {
+            names[s_pic_count] = name;
+            s_pics[s_pic_count++] = i;
+        }
+    }
+    gallery_index_lookup(img_file_iterator->directory_path, names, s_pic_count, s_pic_when);
+    for (int i = 0; i < s_pic_count; i++) {
+        order[i] = (pic_order_t){.when = s_pic_when[i], .index = s_pics[i]};
+    }
+    qsort(order, s_pic_count, sizeof(pic_order_t), pic_order_cmp);
+    for (int i = 0; i < s_pic_count; i++) {
+        s_pics[i] = order[i].index;
+        s_pic_when[i] = order[i].when;
+    }
+    free(names);
+    free(order);
+    pic_days_build();
+}
+
+// 第pos张在哪一天
+static int pic_day_of(int pos)
+{
+    int lo = 0;
+    int hi = s_day_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (s_days[mid].first <= pos) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// 标题显示当前这张的拍摄时刻
+static void pic_title_update(void)
+{
+    if (s_pic_count == 0) {
+        lv_label_set_text(pic_title_label, "图片浏览器");
+        return;
+    }
+    time_t t = (time_t)s_pic_when[s_pic_pos];
+    struct tm tm;
+    localtime_r(&t, &tm);
+    lv_label_set_text_fmt(pic_title_label, "%04d-%02d-%02d %02d:%02d", tm.tm_year + 1900, tm.tm_mon + 1,
+                          tm.tm_mday, tm.tm_hour, tm.tm_min);
+}
+
+static bool pic_path(int pos, char *path, size_t len)
+{
+    int n = file_iterator_get_full_path_from_index(img_file_iterator, s_pics[pos], path, len);
+    return n > 0 && n < (int)len;
+}
+
+// 当前这张显示出来后 让预取任务把前后几张先解好 下一张比上一张优先
+static void pic_prefetch_neighbours(int pos)
+{
+    static char paths[PIC_PREFETCH_MAX][PIC_CACHE_PATH_LEN];
+    const char *list[PIC_PREFETCH_MAX];
+    int n = 0;
+    for (int d = 1; d <= PIC_PREFETCH_DEPTH && n + 2 <= PIC_PREFETCH_MAX; d++) {
+        int near[2] = {(pos + d) % s_pic_count, (pos - d % s_pic_count + s_pic_count) % s_pic_count};
+        for (int k = 0; k < 2; k++) {
+            if (near[k] == pos || (k == 1 && near[1] == near[0])) {
+                continue; // 图片太少时绕回来了
+            }
+            if (pic_path(near[k], paths[n], sizeof(paths[n]))) {
+                list[n] = paths[n];
+                n++;
+            }
+        }
+    }
+    pic_cache_prefetch(list, n);
+}
+
+// 显示第pos张 超出范围的绕回来
+static void pic_show(int pos)
+{
+    if (s_pic_count == 0) {
+        return;
+    }
+    s_pic_pos = (pos % s_pic_count + s_pic_count) % s_pic_count;
+    ESP_LOGI(TAG, "Current Image Index: %d", s_pic_pos);
+    if (!pic_path(s_pic_pos, g_img_path, sizeof(g_img_path))) {
+        ESP_LOGE(TAG, "Failed to get full image path for index %d", s_pic_pos);
+        return;
+    }
+    ui_lock(0);
+    set_img_src_from_fs_path(g_img_path);
+    lv_obj_align(img_in_obj, LV_ALIGN_CENTER, 0, 10);
+    pic_title_update();
+    ui_unlock();
+    pic_prefetch_neighbours(s_pic_pos);
+}
+
+#if CONFIG_APP_NET_PIC
+static void pic_net_changed_cb(lv_event_t *e)
+{
+    int count = net_pic_count(s_pic_net);
+    if (count == 0) {
+        lv_label_set_text(pic_title_label, "网络相框");
+        return;
+    }
+    lv_label_set_text_fmt(pic_title_label, "网络 %d/%d", net_pic_get_index(s_pic_net) + 1, count);
+}
+
+// 幻灯片 下一张下好了才翻 网慢时多停一会
+static void pic_net_timer_cb(lv_timer_t *t)
+{
+    int next = net_pic_get_index(s_pic_net) + 1;
+    if (net_pic_count(s_pic_net) > 1 && net_pic_state(s_pic_net, next) == NET_PIC_READY) {
+        net_pic_show(s_pic_net, next);
+    }
+}
+
+static void pic_net_play(bool on)
+{
+    if (s_pic_net_timer) {
+        lv_timer_del(s_pic_net_timer);
+        s_pic_net_timer = NULL;
+    }
+    if (on) {
+        s_pic_net_timer = lv_timer_create(pic_net_timer_cb, UI_SLIDE_INTERVAL_MS, NULL);
+    }
+    lv_label_set_text_static(s_pic_play_label, on ? LV_SYMBOL_PAUSE : LV_SYMBOL_PLAY);
+}
+
+static void pic_net_stop(void)
+{
+    if (s_pic_net == NULL) {
+        return;
+    }
+    pic_net_play(false);
+    lv_obj_del(s_pic_net);
+    s_pic_net = NULL;
+    lv_obj_clear_flag(img_in_obj, LV_OBJ_FLAG_HIDDEN);
+    pic_title_update();
+}
+#else
+static void pic_net_stop(void)
+{
+}
+#endif
+
+static void btn_pic_back_cb(lv_event_t *e)
+{
+    ui_screen_leave(7);
+    icon_flag = 0;
+}
+
+static bool pic_slide_path(int index, char *path, size_t len)
+{
+    return index < s_pic_count && pic_path(index, path, len);
+}
+
+// 停在幻灯片正放的那张 回到单张浏览
+static void pic_slide_stop(void)
+{
+    if (s_pic_slide == NULL) {
+        return;
+    }
+    int index = ui_slide_get_index(s_pic_slide);
+    lv_obj_del(s_pic_slide);
+    s_pic_slide = NULL;
+    lv_label_set_text_static(s_pic_play_label, LV_SYMBOL_PLAY);
+    pic_show(index);
+}
+
+static void pic_slide_click_cb(lv_event_t *e)
+{
+    pic_slide_stop();
+}
+
+static void btn_pic_play_cb(lv_event_t *e)
+{
+#if CONFIG_APP_NET_PIC
+    if (s_pic_net) {
+        pic_net_play(s_pic_net_timer == NULL);
+        return;
+    }
+#endif
+    if (s_pic_slide) {
+        pic_slide_stop();
+        return;
+    }
+    if (s_pic_count < 2) {
+        return;
+    }
+    if (s_pic_grid) {
+        lv_obj_add_flag(s_pic_grid, LV_OBJ_FLAG_HIDDEN);
+    }
+    s_pic_slide = ui_slide_create(s_pic_root, 320, 200, s_pic_count, s_pic_pos, pic_slide_path);
+    lv_obj_align(s_pic_slide, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_move_background(s_pic_slide); // 翻页和播放键留在上面
+    lv_obj_add_event_cb(s_pic_slide, pic_slide_click_cb, LV_EVENT_CLICKED, NULL);
+    lv_label_set_text_static(s_pic_play_label, LV_SYMBOL_PAUSE);
+}
+
+static void btn_img_prev_next_cb(lv_event_t *e)
+{
+    bool is_next = (bool)lv_event_get_user_data(e);
+#if CONFIG_APP_NET_PIC
+    if (s_pic_net) {
+        net_pic_show(s_pic_net, net_pic_get_index(s_pic_net) + (is_next ? 1 : -1));
+        return;
+    }
+#endif
+    pic_slide_stop();
+    ESP_LOGI(TAG, "%s Image", is_next ? "Next" : "Previous");
+    pic_show(s_pic_pos + (is_next ? 1 : -1));
+}
+
+// 缩略图做好了 格子这期间可能已经滚去显示别的了
+static void pic_thumb_ready(int slot, int tag, const lv_img_dsc_t *thumb)
+{
+    if (s_pic_grid == NULL || ui_vgrid_get_cell_index(s_pic_grid, slot) != tag) {
+        return;
+    }
+    lv_obj_t *img = ui_vgrid_get_cell_img(s_pic_grid, slot);
+    lv_img_set_src(img, thumb);
+    lv_obj_center(img);
+    lv_obj_invalidate(img);
+}
+
+// 格子换了内容 先清掉旧图 再让缩略图任务去读或生成 格子号就是缩略图的slot
+static void pic_grid_bind(lv_obj_t *grid, int cell, int index, lv_obj_t *img)
+{
+    lv_img_set_src(img, NULL);
+    if (index < 0) {
+        pic_thumb_cancel(cell);
+        return;
+    }
+    pic_thumb_request(cell, index, img_file_iterator->directory_path,
+                      file_iterator_get_name_from_index(img_file_iterator, s_pics[index]), pic_thumb_ready);
+}
+
+static void pic_grid_select(lv_obj_t *grid, int index)
+{
+    lv_obj_add_flag(grid, LV_OBJ_FLAG_HIDDEN);
+    pic_show(index);
+}
+
+static void btn_pic_grid_cb(lv_event_t *e)
+{
+    pic_net_stop();
+    pic_slide_stop();
+    if (s_pic_grid == NULL) {
+        s_pic_grid = ui_vgrid_create(s_pic_root, 320, 200, PIC_GRID_COLS, PIC_GRID_CELL_H, pic_grid_bind, pic_grid_select);
+        if (s_pic_grid == NULL) {
+            return;
+        }
+        lv_obj_align(s_pic_grid, LV_ALIGN_TOP_LEFT, 0, 40);
+        lv_obj_set_style_radius(s_pic_grid, 0, 0);
+        lv_obj_set_style_border_width(s_pic_grid, 0, 0);
+        ui_vgrid_set_count(s_pic_grid, s_pic_count);
+    } else if (!lv_obj_has_flag(s_pic_grid, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_add_flag(s_pic_grid, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    lv_obj_clear_flag(s_pic_grid, LV_OBJ_FLAG_HIDDEN);
+    ui_vgrid_scroll_to(s_pic_grid, s_pic_pos);
+}
+
+static void pic_day_text(int index, char *buf, size_t len)
+{
+    time_t t = (time_t)s_days[index].when;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    snprintf(buf, len, "%04d-%02d-%02d   %d", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, s_days[index].count);
+}
+
+// 跳到那天最新的一张 网格开着就滚过去
+static void pic_day_select(lv_obj_t *list, int index)
+{
+    lv_obj_add_flag(list, LV_OBJ_FLAG_HIDDEN);
+    pic_slide_stop();
+    pic_show(s_days[index].first);
+    if (s_pic_grid && !lv_obj_has_flag(s_pic_grid, LV_OBJ_FLAG_HIDDEN)) {
+        ui_vgrid_scroll_to(s_pic_grid, s_pic_pos);
+    }
+}
+
+// 点标题 弹出或收起日期列表
+static void pic_title_click_cb(lv_event_t *e)
+{
+    pic_net_stop();
+    if (s_day_count == 0) {
+        return;
+    }
+    if (s_pic_days == NULL) {
+        s_pic_days = ui_vlist_create(s_pic_root, 320, 200, PIC_DAY_ROW_H, pic_day_text, pic_day_select);
+        if (s_pic_days == NULL) {
+            return;
+        }
+        lv_obj_align(s_pic_days, LV_ALIGN_TOP_LEFT, 0, 40);
+    } else if (!lv_obj_has_flag(s_pic_days, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_add_flag(s_pic_days, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    pic_slide_stop();
+    ui_vlist_set_count(s_pic_days, s_day_count);
+    ui_vlist_set_selected(s_pic_days, pic_day_of(s_pic_pos), true);
+    lv_obj_clear_flag(s_pic_days, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_foreground(s_pic_days);
+}
+
+#if CONFIG_APP_NET_PIC
+// 切到网络相框 或者回到SD卡
+static void btn_pic_net_cb(lv_event_t *e)
+{
+    if (s_pic_net) {
+        pic_net_stop();
+        return;
+    }
+    pic_slide_stop();
+    if (s_pic_grid) {
+        lv_obj_add_flag(s_pic_grid, LV_OBJ_FLAG_HIDDEN);
+    }
+    if (s_pic_days) {
+        lv_obj_add_flag(s_pic_days, LV_OBJ_FLAG_HIDDEN);
+    }
+    lv_obj_add_flag(img_in_obj, LV_OBJ_FLAG_HIDDEN);
+    s_pic_net = net_pic_create(s_pic_root, 320, 200);
+    lv_obj_align(s_pic_net, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_text_font(s_pic_net, &font_alipuhui20, 0);
+    lv_obj_move_background(s_pic_net); // 翻页和播放键留在上面
+    lv_obj_add_event_cb(s_pic_net, pic_net_changed_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_event_send(s_pic_net, LV_EVENT_VALUE_CHANGED, NULL);
+}
+#endif
+
+static void app_pic_browser(lv_obj_t *root){
+    // 创建下一张图片按钮
+    lv_obj_t *btn_next_pic = lv_btn_create(root);
+    lv_obj_set_size(btn_next_pic, 30, 30);
+    lv_obj_set_style_radius(btn_next_pic, 15, LV_STATE_DEFAULT);
+    lv_obj_clear_flag(btn_next_pic, LV_OBJ_FLAG_CHECKABLE); // 取消检查属性
+    lv_obj_align(btn_next_pic, LV_ALIGN_BOTTOM_RIGHT, -10, -10);
+
+    lv_obj_add_style(btn_next_pic, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_next_pic, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_next_pic, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_next_pic, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_next_pic, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+    
+    lv_obj_t *label_next = lv_label_create(btn_next_pic);
+    lv_label_set_text_static(label_next, LV_SYMBOL_NEXT);
+    lv_obj_set_style_text_font(label_next, &lv_font_montserrat_24, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(label_next, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(label_next);
+    lv_obj_set_user_data(btn_next_pic, (void *)label_next);
+    lv_obj_add_event_cb(btn_next_pic, btn_img_prev_next_cb, LV_EVENT_CLICKED, (void *)true);
+
+    // 创建上一张图片按钮
+    lv_obj_t *btn_prev_pic = lv_btn_create(root);
+    lv_obj_set_size(btn_prev_pic, 30, 30);
+    lv_obj_set_style_radius(btn_prev_pic, 15, LV_STATE_DEFAULT);
+    lv_obj_clear_flag(btn_prev_pic, LV_OBJ_FLAG_CHECKABLE); // 取消检查属性
+    lv_obj_align(btn_prev_pic, LV_ALIGN_BOTTOM_LEFT, 10, -10);
+
+    lv_obj_add_style(btn_prev_pic, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_prev_pic, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_prev_pic, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_prev_pic, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_prev_pic, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+    
+    lv_obj_t *label_prev = lv_label_create(btn_prev_pic);
+    lv_label_set_text_static(label_prev, LV_SYMBOL_PREV);
+    lv_obj_set_style_text_font(label_prev, &lv_font_montserrat_24, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(label_prev, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(label_prev);
+    lv_obj_set_user_data(btn_prev_pic, (void *)label_prev);
+    lv_obj_add_event_cb(btn_prev_pic, btn_img_prev_next_cb, LV_EVENT_CLICKED, (void *)false);
+
+    // 幻灯片 播放/停止
+    lv_obj_t *btn_play = lv_btn_create(root);
+    lv_obj_set_size(btn_play, 30, 30);
+    lv_obj_set_style_radius(btn_play, 15, LV_STATE_DEFAULT);
+    lv_obj_clear_flag(btn_play, LV_OBJ_FLAG_CHECKABLE);
+    lv_obj_align(btn_play, LV_ALIGN_BOTTOM_MID, 0, -10);
+
+    lv_obj_add_style(btn_play, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_play, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_play, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_play, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_play, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+
+    s_pic_play_label = lv_label_create(btn_play);
+    lv_label_set_text_static(s_pic_play_label, LV_SYMBOL_PLAY);
+    lv_obj_set_style_text_font(s_pic_play_label, &lv_font_montserrat_24, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(s_pic_play_label, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(s_pic_play_label);
+    lv_obj_add_event_cb(btn_play, btn_pic_play_cb, LV_EVENT_CLICKED, NULL);
+
+#if CONFIG_APP_NET_PIC
+    // 网络相框 开/关
+    lv_obj_t *btn_net = lv_btn_create(root);
+    lv_obj_set_size(btn_net, 30, 30);
+    lv_obj_set_style_radius(btn_net, 15, LV_STATE_DEFAULT);
+    lv_obj_clear_flag(btn_net, LV_OBJ_FLAG_CHECKABLE);
+    lv_obj_align(btn_net, LV_ALIGN_BOTTOM_MID, 60, -10);
+
+    lv_obj_add_style(btn_net, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_net, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_net, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_net, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_net, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+
+    lv_obj_t *label_net = lv_label_create(btn_net);
+    lv_label_set_text_static(label_net, LV_SYMBOL_WIFI);
+    lv_obj_set_style_text_font(label_net, &lv_font_montserrat_24, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(label_net, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(label_net);
+    lv_obj_add_event_cb(btn_net, btn_pic_net_cb, LV_EVENT_CLICKED, NULL);
+#endif
+}
+
+// 标题栏 返回键 图片和前后翻页键
+static void pic_build(lv_obj_t *root)
+{
+    //创建标题背景
+    lv_obj_t *pic_title = lv_obj_create(root);
+    lv_obj_add_style(pic_title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(pic_title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(pic_title, lv_color_hex(0x808080), 0);
+    // 显示标题
+    pic_title_label = lv_label_create(pic_title);
+    lv_label_set_text(pic_title_label, "图片浏览器");
+    lv_obj_set_style_text_color(pic_title_label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(pic_title_label, &font_alipuhui20, 0);
+    lv_obj_align(pic_title_label, LV_ALIGN_CENTER, 0, 0);
+    lv_obj_add_flag(pic_title_label, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_ext_click_area(pic_title_label, 10);
+    lv_obj_add_event_cb(pic_title_label, pic_title_click_cb, LV_EVENT_CLICKED, NULL);
+
+    // 显示后退按钮
+    btn_pic_back = lv_btn_create(pic_title);
+    lv_obj_align(btn_pic_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_pic_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_set_style_bg_opa(btn_pic_back, LV_OPA_60, LV_PART_MAIN);
+    lv_obj_set_style_shadow_opa(btn_pic_back, LV_OPA_60, LV_PART_MAIN);
+    lv_obj_add_event_cb(btn_pic_back, btn_pic_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
+
+    lv_obj_t *label_back = lv_label_create(btn_pic_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    // 切换缩略图网格
+    lv_obj_t *btn_pic_grid = lv_btn_create(pic_title);
+    lv_obj_align(btn_pic_grid, LV_ALIGN_RIGHT_MID, 0, 0);
+    lv_obj_add_style(btn_pic_grid, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_pic_grid, btn_pic_grid_cb, LV_EVENT_CLICKED, NULL);
+
+    lv_obj_t *label_grid = lv_label_create(btn_pic_grid);
+    lv_label_set_text(label_grid, LV_SYMBOL_LIST);
+    lv_obj_add_style(label_grid, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_center(label_grid);
+
+
+    // 创建图片对象
+    s_pic_root = root;
+    img_in_obj = lv_img_create(root);
+    lv_obj_align(img_in_obj, LV_ALIGN_CENTER, 0, 10);
+    app_pic_browser(root);
+}
+
+// 离开时停掉还没做的缩略图 已经显示的留着
+static void pic_leave(lv_obj_t *root)
+{
+    pic_net_stop();
+    if (s_pic_slide) {
+        lv_obj_del(s_pic_slide);
+        s_pic_slide = NULL;
+        lv_label_set_text_static(s_pic_play_label, LV_SYMBOL_PLAY);
+    }
+    for (int i = 0; i < PIC_THUMB_SLOTS; i++) {
+        pic_thumb_cancel(i);
+    }
+}
+
+static void pic_evicted(void)
+{
+    img_in_obj = NULL;
+    s_pic_root = NULL;
+    s_pic_grid = NULL;
+    s_pic_days = NULL;
+    s_pic_slide = NULL;
+    s_pic_play_label = NULL;
+#if CONFIG_APP_NET_PIC
+    s_pic_net = NULL;
+    s_pic_net_timer = NULL;
+#endif
+    pic_cache_release(s_pic_img);
+    s_pic_img = NULL;
+    pic_thumb_release_all();
+}
+
+static const ui_screen_desc_t s_pic_screen = {
+    .name = "gallery",
+    .bg_color = 0xffffff,
+    .psram_kb = 512, // 缩略图和解码出来的整张图
+    .build = pic_build,
+    .leave = pic_leave,
+    .evicted = pic_evicted,
+};
+
+static void pic_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(7, &s_pic_screen);
+    // 每次进入重新扫描 拍照后新增的图片才能看到
+    if (img_file_iterator != NULL) {
+        media_lib_iterator_free(img_file_iterator);
+        img_file_iterator = NULL;
+    }
+    // 确保文件迭代器存在 开机刚结束时SD卡可能还在挂载
+    if (img_file_iterator == NULL) {
+        boot_wait(BOOT_BIT(BOOT_STAGE_SD), BOOT_SD_WAIT_MS);
+        img_file_iterator = media_lib_iterator(SD_MOUNT_POINT "/photo", MEDIA_TYPE_IMAGE);
+        if (img_file_iterator == NULL) {
+            img_file_iterator = file_iterator_new(SD_MOUNT_POINT "/photo");
+        }
+        assert(img_file_iterator != NULL);
+    }
+    pic_list_build();
+    // 每次进入先显示单张 网格回到隐藏 重新绑定新的文件列表
+    if (s_pic_grid) {
+        lv_obj_add_flag(s_pic_grid, LV_OBJ_FLAG_HIDDEN);
+        ui_vgrid_set_count(s_pic_grid, s_pic_count);
+    }
+    if (s_pic_days) {
+        lv_obj_add_flag(s_pic_days, LV_OBJ_FLAG_HIDDEN);
+    }
+    // 显示最新的一张（使用完整路径）
+    if (s_pic_count > 0) {
+        pic_show(0);
+    } else {
+        ui_lock(0);
+        pic_title_update();
+        ui_unlock();
+        ESP_LOGW(TAG, "No images found in %s/photo", SD_MOUNT_POINT);
+    }
+    icon_flag = 7; // 标记已经进入第7个应用
+} 
+
+const app_mod_t app_mod_gallery = {
+    .name = "gallery",
+    .id = 7,
+    .color = 0x3c8dbc,
+    .icon = "img_pic_icon",
+    .open = pic_event_handler,
+    .back = btn_pic_back_cb,
+};
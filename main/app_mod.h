@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 应用模块 ****************************/
+// 每个应用一个源文件app_xxx.c 只导出一个app_mod_t 主界面按app_ui.c里的表依次排图标
+// 表里有哪些应用由Kconfig的CONFIG_APP_MOD_xxx决定 关掉的不编进去 图标和语音命令也没有
+// init在第一次打开之前调一次 播放器 外设注册这些开机时不碰
+// 这个头文件只给app_ui.c和各应用的源文件用 其他模块还是走app_ui.h
+
+typedef struct {
+    const char *name;
+    int id;                             // icon_flag和ui_screen的id 1开始
+    uint32_t color;                     // 图标背景色
+    const char *icon;                   // assets分区里的图 NULL或者没烧时显示symbol
+    const char *symbol;
+    void (*init)(void);                 // 第一次打开前 可为NULL
+    lv_event_cb_t open;                 // 点图标 语音打开时e为NULL
+    lv_event_cb_t back;                 // 语音说退出 和点返回键一样 可为NULL
+    void (*sd_removed)(void);           // 拔卡 在热插拔任务里 只对打开过的调 可为NULL
+} app_mod_t;
+
+#define APP_SD_PULL_STOP_MS     3000    // 拔卡时等录像和播放停下的最长时间
+
+extern const app_mod_t app_mod_att;
+extern const app_mod_t app_mod_music;
+extern const app_mod_t app_mod_sdcard;
+extern const app_mod_t app_mod_camera;
+extern const app_mod_t app_mod_wifi;
+extern const app_mod_t app_mod_bt;
+extern const app_mod_t app_mod_gallery;
+extern const app_mod_t app_mod_sysmon;
+extern const app_mod_t app_mod_tuner;
+extern const app_mod_t app_mod_scan;
+extern const app_mod_t app_mod_bench;
+
+LV_FONT_DECLARE(font_alipuhui20);
+
+extern lv_obj_t *main_obj;              // 主界面
+extern lv_obj_t *icon_in_obj;           // 应用界面
+extern int icon_flag;                   // 标记现在进入哪个应用 在主界面时为0
+
+// 启动WiFi服务 第一次会初始化协议栈 以后直接返回 连上以后主页时钟对时 在app_ui.c
+esp_err_t app_wifi_open(void);
+
+#if CONFIG_APP_MOD_CAMERA
+#include "esp32_s3_szp.h"
+// 摄像头的开关回调在app_camera.c 别的应用用摄像头前调 没打开过相机也会注册好 已经开着的模式不对要自己切
+void app_camera_res_mode(bsp_camera_mode_t mode);
+#endif
+
+#if CONFIG_APP_MOD_MUSIC
+void music_play_file(const char *path); // 文件浏览器里点了音乐 在app_music.c
+void music_play_playlist(const char *path); // 文件浏览器里点了.m3u/.m3u8
+#endif
@@ -0,0 +1,1809 @@
+#include "app_mod.h"
+#include "app_ui.h"
+#include "task_plan.h"
+#include "audio_player.h"
+#include "audio_pcm.h"
+#include "audio_vis.h"
+#include "audio_eq.h"
+#include "flac_mc.h"
+#include "music_index.h"
+#include "music_resume.h"
+#include "music_order.h"
+#include "music_lyrics.h"
+#include "ui_vlist.h"
+#include "ui_perf.h"
+#include "ui_msg.h"
+#include "evt_bus.h"
+#include "imu_gesture.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "net_radio.h"
+#include "multiroom.h"
+#include "media_type.h"
+#include "media_lib.h"
+#include "playlist.h"
+#include "audio_lat.h"
+#include "fd_pool.h"
+#include "pm_ctl.h"
+#include "esp32_s3_szp.h"
+#include "freertos/semphr.h"
+#include "boot.h"
+#include "file_iterator.h"
+#include "esp_heap_caps.h"
+#include "flash_log.h"
+
+static const char *TAG = "app_music";
+
+/*********************  第2个图标   音乐播放器 *********************************************************************************************/
+static audio_player_config_t player_config = {0};
+static uint8_t g_sys_volume = VOLUME_DEFAULT;
+static file_iterator_instance_t *file_iterator = NULL;
+// 音乐目录里的音频文件 列表序号 -> file_iterator里的下标 目录里别的文件(播放列表 缓存)不进列表 表放PSRAM
+static int *s_tracks = NULL;
+static int s_track_count = 0;
+static volatile int s_dir_index = 0;
+// 本模块内的播放器初始化幂等保护
+static bool s_audio_player_ready = false;
+static bool s_gesture_muted;           // 扣下静音的 翻回来才放出声 换曲时播放器的解除静音也不管用
+// 用户主动停止播放的标志，用于在回调中区分“曲目自然结束”与“退出界面主动停止”
+static volatile bool s_user_stop_pending = false;
+// 播放器进入IDLE时由回调置位 用于同步等待停止完成
+static EventGroupHandle_t s_player_events = NULL;
+#define PLAYER_EVT_IDLE     BIT0
+#define PLAYER_STOP_TIMEOUT_MS 2000
+// 开机音乐：事件组与标志
+extern EventGroupHandle_t my_event_group;
+// extern const int START_MUSIC_COMPLETED;
+static bool g_boot_playing = false;
+// 无缝切歌：预取任务与预取的下一首序号（-1 表示没有预取）
+static TaskHandle_t s_prefetch_task = NULL;
+static volatile int s_prefetch_index = -1;
+static SemaphoreHandle_t s_prefetch_mux;    // 预取入队和切歌互斥 入队和播放请求进播放器的先后才对得上
+static volatile uint32_t s_prefetch_gen;    // 切歌一次加一 预取开始时记下 入队前对不上就作废
+#define MUSIC_PREFETCH_BYTES (256 * 1024) // 距离文件末尾多少字节时预取下一首
+#define MUSIC_CROSSFADE_MS   0            // 相邻曲目交叉淡化时长 0:无缝衔接 例如3000开启3秒淡入淡出
+#define MUSIC_WAV_DIRECT_BYTES  (32 * 1024)  // WAV直通的读卡块大小 放内部RAM 可被DMA访问
+// 断点续播：当前播放是否来自file_iterator 以及开机读到的待恢复位置
+static volatile bool s_resume_track = false;
+static int s_resume_index = -1;
+static uint32_t s_resume_pos_ms = 0;
+// 播放列表：曲目来自打开的.m3u 序号在这里 不来自file_iterator 不记录断点
+static volatile bool s_playlist_on = false;
+static volatile int s_pl_index = 0;
+// 网络电台：正在播放电台流时结束后不自动切到下一首本地曲目
+static volatile bool s_radio_playing = false;
+#define MUSIC_RADIO_URL "http://icecast.omroep.nl/radio1-bb-mp3" // 长按曲目按键播放的电台
+
+// 当前曲目按键 点击后弹出虚拟列表 列表只在弹出时存在
+static lv_obj_t *music_track_label;
+static lv_obj_t *music_list_panel;
+static lv_obj_t *music_source_label;    // 列表上方的切换按键 列表弹出时才有
+lv_obj_t *music_list;
+#define MUSIC_LIST_ROW_H 30
+static void music_list_set_selected(int index);
+static void music_track_changed(const evt_t *ev);
+#if CONFIG_APP_IMU_GESTURE
+static void music_gesture(const evt_t *ev);
+#endif
+static void music_list_close(void);
+static esp_err_t music_stop_and_wait(uint32_t timeout_ms);
+lv_obj_t *label_play_pause;
+lv_obj_t *btn_play_pause;
+lv_obj_t *volume_slider;
+
+// 播放进度条 范围0~1000 定时器从播放器读取当前位置
+static lv_obj_t *progress_slider;
+static lv_obj_t *label_elapsed;
+static lv_obj_t *label_duration;
+static lv_timer_t *s_progress_timer = NULL;
+#define PROGRESS_RANGE 1000
+
+// 频谱显示 每个频段一个矩形 定时器按LVGL刷新周期取分析结果
+static lv_obj_t *vis_bars[AUDIO_VIS_BANDS];
+static lv_obj_t *vis_cont;
+static lv_timer_t *s_vis_timer = NULL;
+#define VIS_HEIGHT 20
+
+// 歌词 和频谱同一个位置 这首有歌词时盖住频谱
+#if CONFIG_APP_MUSIC_LYRICS
+static lv_obj_t *music_lyric_label;
+static void music_lyric_changed(const evt_t *ev);
+#endif
+
+lv_obj_t *music_title_label;
+lv_obj_t *btn_music_back;
+
+
+/******************************** 曲目表 ********************************/
+// 音乐目录的迭代器或者打开的播放列表 上一首下一首 随机和列表都只按序号取
+
+// 按扩展名表挑出音频文件 媒体库给的迭代器已经只有音频 自己列目录时什么都有
+static void track_map_build(void)
+{
+    heap_caps_free(s_tracks);
+    s_track_count = 0;
+    s_tracks = heap_caps_malloc((file_iterator->count ? file_iterator->count : 1) * sizeof(int), MALLOC_CAP_SPIRAM);
+    assert(s_tracks != NULL);
+    for (size_t i = 0; i < file_iterator->count; i++)
+    {
+        const char *name = file_iterator_get_name_from_index(file_iterator, i);
+        if (name && media_type_name(name) == MEDIA_TYPE_AUDIO)
+        {
+            s_tracks[s_track_count++] = i;
+        }
+    }
+    ESP_LOGI(TAG, "%d of %d files in the music dir are tracks", s_track_count, (int)file_iterator->count);
+}
+
+// 音乐目录列表第index首的文件名
+static const char *track_dir_name(int index)
+{
+    if (file_iterator == NULL || index < 0 || index >= s_track_count)
+    {
+        return NULL;
+    }
+    return file_iterator_get_name_from_index(file_iterator, s_tracks[index]);
+}
+
+static int track_count(void)
+{
+    return s_playlist_on ? playlist_count() : s_track_count;
+}
+
+static int track_get_index(void)
+{
+    return s_playlist_on ? s_pl_index : s_dir_index;
+}
+
+static void track_set_index(int index)
+{
+    if (s_playlist_on)
+    {
+        s_pl_index = index;
+    }
+    else
+    {
+        s_dir_index = index;
+    }
+}
+
+static bool track_path(int index, char *out, size_t len)
+{
+    if (s_playlist_on)
+    {
+        return playlist_path(index, out, len);
+    }
+    return index >= 0 && index < s_track_count &&
+           file_iterator_get_full_path_from_index(file_iterator, s_tracks[index], out, len) != 0;
+}
+
+// 取得当前播放状态 供断点保存任务定期调用
+static bool music_resume_fill(music_resume_t *state)
+{
+    audio_player_state_t player_state = audio_player_get_state();
+    if (!s_resume_track || file_iterator == NULL ||
+        (player_state != AUDIO_PLAYER_STATE_PLAYING && player_state != AUDIO_PLAYER_STATE_PAUSE))
+    {
+        return false;
+    }
+    int index = s_dir_index;
+    const char *name = track_dir_name(index);
+    if (name == NULL)
+    {
+        return false;
+    }
+    audio_player_position_t pos;
+    audio_player_get_position(&pos);
+    state->index = index;
+    state->position_ms = pos.position_ms;
+    strlcpy(state->name, name, sizeof(state->name));
+    return true;
+}
+
+// 暂停/退出时保存当前位置
+static void music_checkpoint(void)
+{
+    music_resume_t state;
+    if (music_resume_fill(&state))
+    {
+        music_resume_checkpoint(&state);
+    }
+}
+
+// 切歌时保存新的曲目
+static void music_checkpoint_track(int index, uint32_t position_ms)
+{
+    if (s_playlist_on)
+    {
+        return; // 断点只记音乐目录里的曲目
+    }
+    const char *name = track_dir_name(index);
+    if (name == NULL)
+    {
+        return;
+    }
+    music_resume_t state = {.index = index, .position_ms = position_ms};
+    strlcpy(state.name, name, sizeof(state.name));
+    music_resume_checkpoint(&state);
+}
+
+// 开机后恢复上次的曲目 先按保存的序号校验文件名 目录有变化时再按文件名查找
+static void music_resume_restore(void)
+{
+    music_resume_t state;
+    if (file_iterator == NULL || !music_resume_get(&state))
+    {
+        return;
+    }
+    int index = -1;
+    const char *name = track_dir_name(state.index);
+    if (name && strcmp(name, state.name) == 0)
+    {
+        index = state.index;
+    }
+    else
+    {
+        for (int i = 0; i < s_track_count; i++)
+        {
+            name = track_dir_name(i);
+            if (name && strcmp(name, state.name) == 0)
+            {
+                index = i;
+                break;
+            }
+        }
+    }
+    if (index < 0)
+    {
+        ESP_LOGW(TAG, "resume track '%s' not found", state.name);
+        return;
+    }
+    s_dir_index = index;
+    s_resume_index = index;
+    s_resume_pos_ms = state.position_ms;
+    ESP_LOGI(TAG, "resume index %d at %lu ms", index, (unsigned long)state.position_ms);
+}
+
+// 按索引里的响度增益设这首的音量 不在音乐目录 索引里没有或还没估计完的按原样播放
+static void music_track_gain(const char *path)
+{
+    int gain = 0;
+#if CONFIG_APP_MUSIC_LOUDNESS
+    music_meta_t meta;
+    const char *name = strrchr(path, '/');
+    if (name && strncmp(path, MUSIC_INDEX_DIR "/", sizeof(MUSIC_INDEX_DIR)) == 0 &&
+        music_index_lookup(name + 1, &meta) &&
+        (meta.gain_src == MUSIC_GAIN_TAG || meta.gain_src == MUSIC_GAIN_SCAN))
+    {
+        gain = meta.gain_cdb;
+    }
+#endif
+    ESP_LOGI(TAG, "track gain %.2f dB", gain / 100.0f);
+    audio_pcm_set_track_gain(gain);
+}
+
+static void prefetch_lock(void)
+{
+    if (s_prefetch_mux)
+    {
+        xSemaphoreTake(s_prefetch_mux, portMAX_DELAY);
+    }
+}
+
+static void prefetch_unlock(void)
+{
+    if (s_prefetch_mux)
+    {
+        xSemaphoreGive(s_prefetch_mux);
+    }
+}
+
+// 播放指定序号的音乐
+static void play_index(int index)
+{
+    ESP_LOGI(TAG, "play_index(%d)", index);
+    multiroom_stop(); // 本机放歌就不再跟别的房间
+
+    char filename[PLAYLIST_PATH_LEN];
+    if (!track_path(index, filename, sizeof(filename)))
+    {
+        ESP_LOGE(TAG, "unable to retrieve filename");
+        return;
+    }
+
+    FILE *fp = fopen(filename, "rb");
+    if (fp)
+    {
+        ESP_LOGI(TAG, "Playing '%s'", filename);
+        // 用户切歌时作废已预取的下一首（播放器会关闭它） 正在打开的预取看到代数变了自己扔掉
+        prefetch_lock();
+        s_prefetch_gen++;
+        s_prefetch_index = -1;
+        s_radio_playing = false;
+        music_track_gain(filename);
+#if CONFIG_APP_MUSIC_LYRICS
+        music_lyrics_load(filename);
+#endif
+        audio_lat_mark(AUDIO_LAT_OPEN);
+        audio_player_play(fp);
+        prefetch_unlock();
+        music_order_commit(index);
+        audio_pcm_flush();     // 丢弃上一首还在缓冲里的数据 立即切歌
+        s_resume_track = !s_playlist_on;
+        // 开机后第一次播放上次的曲目 从断点继续
+        uint32_t start_ms = (index == s_resume_index) ? s_resume_pos_ms : 0;
+        s_resume_index = -1;
+        if (start_ms)
+        {
+            audio_player_seek(start_ms);
+        }
+        music_checkpoint_track(index, start_ms);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "unable to open index %d, filename '%s'", index, filename);
+    }
+}
+
+// 预取任务：在当前曲目快结束时打开下一首并预读第一块stdio缓冲，SD卡的fopen不阻塞解码任务
+// 只打开文件和装缓冲 解码器读文件头还是在切过去时由播放器做 那时读的已经在内存里
+static void music_prefetch_task(void *arg)
+{
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (g_boot_playing || s_user_stop_pending || file_iterator == NULL || track_count() == 0)
+        {
+            continue;
+        }
+
+        uint32_t gen = s_prefetch_gen;
+        int index = music_order_peek_next(track_get_index(), false);
+        char filename[PLAYLIST_PATH_LEN];
+        if (!track_path(index, filename, sizeof(filename)))
+        {
+            continue;
+        }
+
+        FILE *fp = fopen(filename, "rb");
+        if (fp == NULL)
+        {
+            ESP_LOGW(TAG, "prefetch open failed: %s", filename);
+            continue;
+        }
+        // 读一个字节再退回，让stdio缓冲区提前装入文件头，切歌时解码器无需等待SD卡
+        int c = fgetc(fp);
+        if (c != EOF)
+        {
+            ungetc(c, fp);
+        }
+
+        // 打开的时候用户切了歌 这一首是按旧的曲目算的
+        prefetch_lock();
+        bool queued = gen == s_prefetch_gen;
+        if (queued)
+        {
+            s_prefetch_index = index;
+            queued = audio_player_queue_next(fp) == ESP_OK;
+            if (!queued)
+            {
+                s_prefetch_index = -1;
+            }
+        }
+        prefetch_unlock();
+        if (queued)
+        {
+            ESP_LOGI(TAG, "prefetched index %d '%s'", index, filename);
+        }
+        else
+        {
+            fclose(fp);
+        }
+    }
+}
+
+// 设置声音处理函数
+static esp_err_t _audio_player_mute_fn(AUDIO_PLAYER_MUTE_SETTING setting)
+{
+    esp_err_t ret = ESP_OK;
+    // 先设软件静音 缓冲里的曲尾照常播 最后一小段渐弱 等它播完出了DMA再关硬件
+    if (setting == AUDIO_PLAYER_MUTE)
+    {
+        audio_pcm_set_mute(true);
+        audio_pcm_drain(500);
+        vTaskDelay(pdMS_TO_TICKS(audio_pcm_output_delay_us() / 1000) + 1);
+    }
+    // 判断是否需要静音 硬件静音只在曲目开始/结束时切换
+    bsp_codec_mute_set(setting == AUDIO_PLAYER_MUTE ? true : false);
+    // 解除静音后写进来的数据在送数任务里渐强 开头无爆音 硬件音量保持参考值不再写I2C
+    audio_pcm_set_volume(g_sys_volume);
+    audio_pcm_set_mute(setting == AUDIO_PLAYER_MUTE || s_gesture_muted);
+    if (setting == AUDIO_PLAYER_UNMUTE)
+    {
+        audio_lat_mark(AUDIO_LAT_UNMUTE);
+    }
+    ret = ESP_OK;
+
+    return ret;
+}
+
+// 播放音乐函数 播放音乐的时候 会不断进入
+static esp_err_t _audio_player_write_fn(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+
+    ret = audio_pcm_write(audio_buffer, len, bytes_written, timeout_ms); // 写入PCM环形缓冲 由送数任务写I2S
+
+    return ret;
+}
+
+// WAV文件不解码 大块PCM直接写I2S
+static esp_err_t _audio_player_direct_write_fn(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    return audio_pcm_write_direct(audio_buffer, len, bytes_written, timeout_ms);
+}
+
+// 设置采样率 播放的时候进入一次
+static esp_err_t _audio_player_std_clock(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    esp_err_t ret = ESP_OK;
+
+    audio_lat_mark(AUDIO_LAT_FORMAT);
+    ret = audio_pcm_set_fs(rate, bits_cfg, ch); // 如果播放的音乐固定是16000采样率 这里可以不用打开 如果采样率未知 把这里打开
+    audio_lat_mark(AUDIO_LAT_CODEC);
+    return ret;
+}
+
+// 回调函数 播放器每次动作都会进入
+static void _audio_player_callback(audio_player_cb_ctx_t *ctx)
+{
+    FLOG("audio event %d", ctx->audio_event); // 每首歌好几次 不走串口
+    switch (ctx->audio_event)
+    {
+        //IDLE态太多地方会进来了，STOP态才是用户主动停止播放
+        //播放完成也会进来
+        //点击暂停才是pause态
+    case AUDIO_PLAYER_CALLBACK_EVENT_IDLE:
+    { // 播放完一首歌 进入这个case
+        FLOG("audio idle, boot %d stop %d radio %d", g_boot_playing, s_user_stop_pending, s_radio_playing);
+        pm_ctl_set(PM_CLIENT_AUDIO, false); // 接着播下一首会再拿
+
+        // 若是开机音乐播放结束，置位事件并不继续自动播放
+        if (g_boot_playing && my_event_group)
+        {
+            g_boot_playing = false;
+            xEventGroupSetBits(my_event_group, START_MUSIC_COMPLETED);
+            break;
+        }
+
+        // 如果是用户主动停止（退出音乐界面），不进行自动下一首，也不触碰UI
+        if (s_user_stop_pending)
+        {
+            s_user_stop_pending = false;
+            s_radio_playing = false;
+            break;
+        }
+
+        // 电台流断开 不接着播放本地曲目
+        if (s_radio_playing)
+        {
+            s_radio_playing = false;
+            break;
+        }
+
+        // 普通模式：按播放顺序自动播放下一首
+        int index = music_order_peek_next(track_get_index(), false);
+        track_set_index(index);
+        ESP_LOGI(TAG, "playing index '%d'", index);
+        play_index(index);
+        evt_bus_publish(EVT_MUSIC_TRACK, index, 0); // 界面的事由订阅者在LVGL任务里做
+        break;
+    }
+    case AUDIO_PLAYER_CALLBACK_EVENT_PREFETCH_NEXT: // 当前曲目即将结束 通知预取任务打开下一首
+        if (s_prefetch_task)
+        {
+            xTaskNotifyGive(s_prefetch_task);
+        }
+        break;
+    case AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT: // 无缝切到了预取的下一首
+    {
+        int index = s_prefetch_index;
+        if (index < 0)
+        {
+            break; // 用户主动切歌 不是预取
+        }
+        s_prefetch_index = -1;
+        track_set_index(index);
+        music_order_commit(index);
+        char filename[PLAYLIST_PATH_LEN];
+        if (track_path(index, filename, sizeof(filename)))
+        {
+            music_track_gain(filename); // 在解码任务里 下一首的PCM还没写进来
+#if CONFIG_APP_MUSIC_LYRICS
+            music_lyrics_load(filename);
+#endif
+        }
+        music_checkpoint_track(index, 0);
+        ESP_LOGI(TAG, "gapless playing index '%d'", index);
+        evt_bus_publish(EVT_MUSIC_TRACK, index, 0);
+        break;
+    }
+    case AUDIO_PLAYER_CALLBACK_EVENT_PLAYING: // 正在播放音乐
+        audio_lat_mark(AUDIO_LAT_DECODE);
+        ESP_LOGI(TAG, "AUDIO_PLAYER_REQUEST_PLAY");
+        pa_en(1); // 打开音频功放
+        pm_ctl_set(PM_CLIENT_AUDIO, true); // 解码要全速
+        break;
+    case AUDIO_PLAYER_CALLBACK_EVENT_SEEK_DONE: // 解码器已跳转 丢掉缓冲中旧位置的音频
+        audio_pcm_flush();
+        break;
+    case AUDIO_PLAYER_CALLBACK_EVENT_PAUSE: // 正在暂停音乐
+        ESP_LOGI(TAG, "AUDIO_PLAYER_REQUEST_PAUSE");
+        audio_pcm_pause(); // 停着不写 缓冲取空不是欠载
+        pa_en(0); // 关闭音频功放
+        pm_ctl_set(PM_CLIENT_AUDIO, false);
+        music_checkpoint();
+        break;
+    default:
+        break;
+    }
+
+    // IDLE处理完(包括消费s_user_stop_pending)之后再通知等待停止的任务
+    if (ctx->audio_event == AUDIO_PLAYER_CALLBACK_EVENT_IDLE && s_player_events)
+    {
+        xEventGroupSetBits(s_player_events, PLAYER_EVT_IDLE);
+    }
+}
+
+// mp3播放器初始化
+void mp3_player_init(void)
+{
+#if BOOT_SOUND_MODE == BOOT_SOUND_PCM
+    // 主界面不再等开机音 开机音还在直接写I2S时先等它播完 最多几秒
+    xEventGroupWaitBits(my_event_group, START_MUSIC_COMPLETED, pdFALSE, pdFALSE, pdMS_TO_TICKS(BOOT_PCM_TIMEOUT_MS));
+#endif
+    // 音乐目录在SD卡上 播放需要音频芯片 开机阶段可能还没完成
+    boot_wait(BOOT_BIT(BOOT_STAGE_SD) | BOOT_BIT(BOOT_STAGE_CODEC), BOOT_SD_WAIT_MS);
+    // 确保文件迭代器存在
+    if (file_iterator == NULL) {
+        // 媒体库里有就不用再列一遍目录 只有音乐文件
+        file_iterator = media_lib_iterator(SD_MOUNT_POINT "/music", MEDIA_TYPE_AUDIO);
+        if (file_iterator == NULL) {
+            file_iterator = file_iterator_new(SD_MOUNT_POINT "/music");
+        }
+        assert(file_iterator != NULL);
+        track_map_build();
+        music_order_init(s_track_count); // 随机播放的排列表
+        music_resume_start(music_resume_fill); // 读出上次的断点 启动定期保存
+        music_resume_restore();
+    }
+
+    // 初始化音频播放（避免重复初始化）
+    if (!s_audio_player_ready) {
+        ESP_ERROR_CHECK(audio_pcm_init(AUDIO_PCM_RING_MS_DEFAULT)); // 解码器与I2S之间的PCM缓冲
+        audio_vis_start(); // 频谱分析任务 在核0上运行
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+        const task_plan_t *mc = task_plan_get(TASK_FLAC_MC);
+        flac_mc_start(mc->core, mc->prio, mc->stack); // 起不来就都在解码任务里还原
+#endif
+        audio_eq_init();   // 均衡器 读出上次选择的预设
+        player_config.mute_fn = _audio_player_mute_fn;
+        player_config.write_fn = _audio_player_write_fn;
+        player_config.clk_set_fn = _audio_player_std_clock;
+        player_config.priority = task_plan_get(TASK_AUDIO_PLAYER)->prio;
+        player_config.coreID = task_plan_get(TASK_AUDIO_PLAYER)->core;
+        player_config.prefetch_bytes = MUSIC_PREFETCH_BYTES;
+        player_config.crossfade_ms = MUSIC_CROSSFADE_MS;
+        player_config.fade_core_id = task_plan_get(TASK_AUDIO_FADE)->core; // 下一首在另一个核上解码 优先级和播放任务一样
+        player_config.mix_fn = audio_pcm_crossfade_mix;
+        player_config.direct_write_fn = _audio_player_direct_write_fn;
+        player_config.direct_buf_bytes = MUSIC_WAV_DIRECT_BYTES;
+
+        if (s_player_events == NULL)
+        {
+            s_player_events = xEventGroupCreate();
+            assert(s_player_events != NULL);
+        }
+
+        if (s_prefetch_mux == NULL)
+        {
+            s_prefetch_mux = xSemaphoreCreateMutex();
+            assert(s_prefetch_mux != NULL);
+        }
+        if (s_prefetch_task == NULL)
+        {
+            task_plan_create(TASK_MUSIC_PREFETCH, music_prefetch_task, NULL, &s_prefetch_task);
+        }
+#if CONFIG_APP_MUSIC_LYRICS
+        music_lyrics_start();
+#endif
+
+        esp_err_t err = audio_player_new(player_config);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+            ESP_ERROR_CHECK(err);
+        }
+        ESP_ERROR_CHECK(audio_player_callback_register(_audio_player_callback, NULL));
+        evt_bus_subscribe(EVT_MUSIC_TRACK, music_track_changed, EVT_BUS_UI);
+#if CONFIG_APP_MUSIC_LYRICS
+        evt_bus_subscribe(EVT_MUSIC_LYRIC, music_lyric_changed, EVT_BUS_UI);
+#endif
+#if CONFIG_APP_IMU_GESTURE
+        evt_bus_subscribe(EVT_GESTURE, music_gesture, EVT_BUS_UI);
+#endif
+        //初始化变量set
+        s_audio_player_ready = true;
+    }
+}
+
+// 播放SPIFFS中的MP3文件；用于开机音乐
+void app_play_boot_mp3(const char *filepath)
+{
+    // 仅初始化一次
+    static bool s_player_inited = false;
+    if (!s_player_inited)
+    {
+        mp3_player_init();
+        s_player_inited = true;
+    }
+
+    FILE *fp = fd_pool_fopen(filepath, "rb");
+    if (!fp)
+    {
+        ESP_LOGE(TAG, "boot mp3 open failed: %s", filepath);
+        // 如果打开失败，直接置位事件，避免系统卡住
+        if (my_event_group)
+        {
+            xEventGroupSetBits(my_event_group, START_MUSIC_COMPLETED);
+        }
+        return;
+    }
+
+    g_boot_playing = true; // 在回调中依据该标志于播放结束置事件位
+    audio_pcm_set_track_gain(0);
+    audio_player_play(fp);
+}
+
+// 播放暂停按钮 事件处理函数
+static void btn_play_pause_cb(lv_event_t *event)
+{
+    lv_obj_t *btn = lv_event_get_target(event);
+    lv_obj_t *lab = (lv_obj_t *)btn->user_data;
+
+    audio_player_state_t state = audio_player_get_state();
+    printf("state=%d\n", state);
+    if (state == AUDIO_PLAYER_STATE_IDLE)
+    {
+        audio_lat_start("play");
+        ui_lock(0);
+        lv_label_set_text_static(lab, LV_SYMBOL_PAUSE);
+        ui_unlock();
+        int index = track_get_index();
+        ESP_LOGI(TAG, "playing index '%d'", index);
+        play_index(index);
+    }
+    else if (state == AUDIO_PLAYER_STATE_PAUSE)
+    {
+        audio_lat_start("resume");
+        ui_lock(0);
+        lv_label_set_text_static(lab, LV_SYMBOL_PAUSE);
+        ui_unlock();
+        audio_player_resume();
+    }
+    else if (state == AUDIO_PLAYER_STATE_PLAYING)
+    {
+        ui_lock(0);
+        lv_label_set_text_static(lab, LV_SYMBOL_PLAY);
+        ui_unlock();
+        audio_player_pause();
+    }
+}
+
+// 切到上一首或下一首 正在播放就接着播 按键和语音共用
+static void music_step(bool is_next)
+{
+    int index = track_get_index();
+
+    if (is_next)
+    {
+        ESP_LOGI(TAG, "btn next");
+        index = music_order_peek_next(index, true);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "btn prev");
+        index = music_order_prev(index);
+    }
+    track_set_index(index);
+    // 修改当前的音乐名称
+    music_list_set_selected(index);
+    // 执行音乐事件
+    audio_player_state_t state = audio_player_get_state();
+    printf("prev_next_state=%d\n", state);
+    if (state == AUDIO_PLAYER_STATE_IDLE)
+    {
+        // Nothing to do
+    }
+    else if (state == AUDIO_PLAYER_STATE_PAUSE)
+    { // 如果当前正在暂停歌曲
+        ESP_LOGI(TAG, "playing index '%d'", index);
+        play_index(index);
+        audio_player_pause();
+    }
+    else if (state == AUDIO_PLAYER_STATE_PLAYING)
+    { // 如果当前正在播放歌曲
+        // 播放歌曲
+        audio_lat_start(is_next ? "next" : "prev");
+        ESP_LOGI(TAG, "playing index '%d'", index);
+        play_index(index);
+    }
+}
+
+// 上一首 下一首 按键事件处理函数
+static void btn_prev_next_cb(lv_event_t *event)
+{
+    music_step((bool)event->user_data);
+}
+
+// 播放模式图标 列表循环/单曲循环/随机
+static const char *music_order_symbol(music_order_mode_t mode)
+{
+    switch (mode)
+    {
+    case MUSIC_ORDER_REPEAT_ONE:
+        return LV_SYMBOL_REFRESH;
+    case MUSIC_ORDER_SHUFFLE:
+        return LV_SYMBOL_SHUFFLE;
+    default:
+        return LV_SYMBOL_LOOP;
+    }
+}
+
+// 播放模式按键 依次切换三种模式
+static void btn_order_cb(lv_event_t *event)
+{
+    lv_obj_t *lab = (lv_obj_t *)event->user_data;
+    music_order_mode_t mode = (music_order_get_mode() + 1) % MUSIC_ORDER_MAX;
+    music_order_set_mode(mode, track_get_index());
+    lv_label_set_text_static(lab, music_order_symbol(mode));
+    ESP_LOGI(TAG, "play order %d", mode);
+}
+
+// 速度按键 依次切换几档 有声书和播客用 变速不变调
+static void btn_speed_cb(lv_event_t *event)
+{
+    static const int speeds[] = {100, 125, 150, 200, 75};
+    static const char *const texts[] = {"1x", "1.25x", "1.5x", "2x", "0.75x"};
+    lv_obj_t *lab = (lv_obj_t *)event->user_data;
+    int i = 0;
+    while (i < 4 && speeds[i] != audio_pcm_get_speed())
+    {
+        i++;
+    }
+    i = (i + 1) % 5;
+    audio_pcm_set_speed(speeds[i]);
+    lv_label_set_text_static(lab, texts[i]);
+    ESP_LOGI(TAG, "speed %d%%", speeds[i]);
+}
+
+// 音量调节滑动条 事件处理函数
+static void volume_slider_cb(lv_event_t *event)
+{
+    lv_obj_t *slider = lv_event_get_target(event);
+    int volume = lv_slider_get_value(slider); // 获取slider的值
+    audio_pcm_set_volume(volume);             // 软件音量 拖动时不占用I2C总线
+    g_sys_volume = volume;                    // 把声音赋值给g_sys_volume保存
+    ESP_LOGI(TAG, "volume '%d'", volume);
+}
+
+// 音乐列表 点击事件处理函数
+static void music_list_select_cb(lv_obj_t *list, int index)
+{
+    ESP_LOGI(TAG, "switching index to '%d'", index);
+    track_set_index(index);
+    music_list_close();
+    music_list_set_selected(index);
+
+    audio_player_state_t state = audio_player_get_state();
+    if (state == AUDIO_PLAYER_STATE_PAUSE)
+    { // 如果当前正在暂停歌曲
+        play_index(index);
+        audio_player_pause();
+    }
+    else if (state == AUDIO_PLAYER_STATE_PLAYING)
+    { // 如果当前正在播放歌曲
+        audio_lat_start("list");
+        play_index(index);
+    }
+}
+
+// 毫秒转成 m:ss
+static void format_mmss(char *buf, size_t size, uint32_t ms)
+{
+    uint32_t sec = ms / 1000;
+    snprintf(buf, size, "%lu:%02lu", (unsigned long)(sec / 60), (unsigned long)(sec % 60));
+}
+
+// 定时刷新播放进度 拖动进度条时不覆盖用户的位置
+// 频谱刷新 只在有新结果时改高度
+static void vis_timer_cb(lv_timer_t *timer)
+{
+    audio_vis_frame_t frame;
+    if (lv_obj_has_flag(vis_cont, LV_OBJ_FLAG_HIDDEN) || !audio_vis_get(&frame))
+    {
+        return;
+    }
+    for (int b = 0; b < AUDIO_VIS_BANDS; b++)
+    {
+        lv_coord_t h = 1 + frame.bands[b] * (VIS_HEIGHT - 1) / 100;
+        if (lv_obj_get_height(vis_bars[b]) != h)
+        {
+            lv_obj_set_height(vis_bars[b], h);
+        }
+    }
+}
+
+static void progress_timer_cb(lv_timer_t *timer)
+{
+    audio_player_position_t pos;
+    if (audio_player_get_position(&pos) != ESP_OK)
+    {
+        return;
+    }
+    char buf[16];
+    if (!lv_obj_has_state(progress_slider, LV_STATE_PRESSED))
+    {
+        int value = pos.duration_ms ? (int)((uint64_t)pos.position_ms * PROGRESS_RANGE / pos.duration_ms) : 0;
+        lv_slider_set_value(progress_slider, value > PROGRESS_RANGE ? PROGRESS_RANGE : value, LV_ANIM_OFF);
+        format_mmss(buf, sizeof(buf), pos.position_ms);
+        lv_label_set_text(label_elapsed, buf);
+    }
+    format_mmss(buf, sizeof(buf), pos.duration_ms);
+    lv_label_set_text(label_duration, buf);
+}
+
+// 进度条事件 拖动时预览时间 松手时跳转
+static void progress_slider_cb(lv_event_t *event)
+{
+    audio_player_position_t pos;
+    audio_player_get_position(&pos);
+    uint32_t target = (uint64_t)lv_slider_get_value(progress_slider) * pos.duration_ms / PROGRESS_RANGE;
+
+    if (lv_event_get_code(event) == LV_EVENT_VALUE_CHANGED)
+    {
+        char buf[16];
+        format_mmss(buf, sizeof(buf), target);
+        lv_label_set_text(label_elapsed, buf);
+        return;
+    }
+
+    // LV_EVENT_RELEASED
+    audio_player_state_t state = audio_player_get_state();
+    if (pos.duration_ms && (state == AUDIO_PLAYER_STATE_PLAYING || state == AUDIO_PLAYER_STATE_PAUSE))
+    {
+        ESP_LOGI(TAG, "seek to %lu ms", (unsigned long)target);
+        audio_player_seek(target);
+    }
+}
+
+// 列表第index行的文字 有索引时显示标题和时长 只对可见行调用
+static void music_track_text(int index, char *buf, size_t len)
+{
+    char path[PLAYLIST_PATH_LEN];
+    const char *file_name = NULL;
+    bool indexed = true; // 索引只管音乐目录下直接的文件 按文件名查
+    if (s_playlist_on)
+    {
+        file_name = playlist_path(index, path, sizeof(path)) ? strrchr(path, '/') + 1 : NULL;
+        indexed = file_name && (size_t)(file_name - path) == sizeof(MUSIC_INDEX_DIR) &&
+                  strncmp(path, MUSIC_INDEX_DIR "/", sizeof(MUSIC_INDEX_DIR)) == 0;
+    }
+    else
+    {
+        file_name = track_dir_name(index);
+    }
+    if (NULL == file_name)
+    {
+        buf[0] = 0;
+        return;
+    }
+    music_meta_t meta;
+    if (!indexed || !music_index_lookup(file_name, &meta))
+    {
+        strlcpy(buf, file_name, len);
+        return;
+    }
+    const char *title = meta.title[0] ? meta.title : file_name;
+    if (meta.duration_ms)
+    {
+        uint32_t sec = meta.duration_ms / 1000;
+        snprintf(buf, len, "%s (%lu:%02lu)", title, (unsigned long)(sec / 60), (unsigned long)(sec % 60));
+    }
+    else
+    {
+        strlcpy(buf, title, len);
+    }
+}
+
+static void music_list_apply_selected(void *arg)
+{
+    int index = (int)(intptr_t)arg;
+    if (music_track_label)
+    {
+        char text[UI_VLIST_TEXT_LEN];
+        music_track_text(index, text, sizeof(text));
+        lv_label_set_text(music_track_label, text);
+    }
+    if (music_list)
+    {
+        ui_vlist_set_selected(music_list, index, true);
+    }
+}
+
+// 当前曲目变化 更新按键文字 列表打开时同步高亮并滚动到该行
+// 播放器回调和索引任务里也会调用 统一投递给LVGL任务
+static void music_list_set_selected(int index)
+{
+    ui_post_call(music_list_apply_selected, (void *)(intptr_t)index);
+}
+
+// 自动换到下一首 EVT_MUSIC_TRACK 在LVGL任务里 修改当前播放的音乐名称（仅在音乐界面存在时）
+static void music_track_changed(const evt_t *ev)
+{
+    if (icon_flag == 2)
+    {
+        music_list_apply_selected((void *)(intptr_t)ev->a);
+    }
+}
+
+#if CONFIG_APP_MUSIC_LYRICS
+// 歌词换行 EVT_MUSIC_LYRIC 在LVGL任务里 只改这一行 有歌词时频谱不显示也不分析
+static void music_lyric_changed(const evt_t *ev)
+{
+    if (icon_flag != 2 || music_lyric_label == NULL)
+    {
+        return; // 界面不在 进来时music_lyrics_refresh再发一次
+    }
+    int line = (int)ev->a;
+    bool on = line != MUSIC_LYRICS_OFF;
+    if (on)
+    {
+        char buf[MUSIC_LYRICS_LINE_LEN];
+        if (!music_lyrics_line(ev->b, line, buf, sizeof(buf)))
+        {
+            return; // 表又换了 后面还有新表的事件
+        }
+        lv_label_set_text(music_lyric_label, buf);
+    }
+    if (on == lv_obj_has_flag(music_lyric_label, LV_OBJ_FLAG_HIDDEN))
+    {
+        if (on)
+        {
+            lv_obj_clear_flag(music_lyric_label, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_add_flag(vis_cont, LV_OBJ_FLAG_HIDDEN);
+        }
+        else
+        {
+            lv_obj_add_flag(music_lyric_label, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_clear_flag(vis_cont, LV_OBJ_FLAG_HIDDEN);
+        }
+        audio_vis_set_enabled(!on);
+    }
+}
+#endif
+
+#if CONFIG_APP_IMU_GESTURE
+// 甩一下下一首(音乐界面开着时) 扣下静音 翻回来恢复 EVT_GESTURE 在LVGL任务里
+static void music_gesture(const evt_t *ev)
+{
+    switch (ev->a)
+    {
+    case IMU_GESTURE_SHAKE:
+        ai_next_music();
+        break;
+    case IMU_GESTURE_FACE_DOWN:
+        if (!s_gesture_muted && audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING)
+        {
+            s_gesture_muted = true;
+            audio_pcm_set_mute(true);
+        }
+        break;
+    case IMU_GESTURE_FACE_UP:
+        if (s_gesture_muted)
+        {
+            s_gesture_muted = false;
+            audio_pcm_set_mute(false);
+        }
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+static void music_list_close(void)
+{
+    if (music_list_panel)
+    {
+        lv_obj_del_async(music_list_panel); // 可能在列表自身的事件中调用
+        music_list_panel = NULL;
+        music_list = NULL;
+    }
+}
+
+// 点到列表外的半透明背景时关闭列表
+static void music_list_panel_cb(lv_event_t *e)
+{
+    if (lv_event_get_target(e) == music_list_panel)
+    {
+        music_list_close();
+    }
+}
+
+// 长按曲目按键 播放网络电台
+static void btn_radio_cb(lv_event_t *e)
+{
+    if (music_play_radio(MUSIC_RADIO_URL) == ESP_OK && music_track_label)
+    {
+        lv_label_set_text(music_track_label, MUSIC_RADIO_URL);
+        lv_label_set_text_static(label_play_pause, LV_SYMBOL_PAUSE);
+    }
+}
+
+// 多房间开始前把本机播放器停下 audio_pcm交给多房间的接收任务
+static void music_multiroom_prepare(void)
+{
+    music_checkpoint();
+    music_stop_and_wait(PLAYER_STOP_TIMEOUT_MS);
+    s_radio_playing = false;
+    audio_pcm_set_track_gain(0);
+    audio_pcm_set_volume(g_sys_volume);
+    pm_ctl_set(PM_CLIENT_AUDIO, true); // 播放器的回调不会来 自己拿住
+    lv_label_set_text_static(label_play_pause, LV_SYMBOL_PLAY);
+}
+
+// 多房间开不起来 曲目栏上说一声 原因在日志里
+static void music_multiroom_fail(const char *text)
+{
+    ESP_LOGW(TAG, "multiroom: %s", text);
+    if (music_track_label)
+    {
+        lv_label_set_text_static(music_track_label, text);
+    }
+}
+
+// 长按播放模式键 把当前曲目广播给别的房间 本机同步放 再长按停下
+static void btn_multiroom_send_cb(lv_event_t *e)
+{
+    if (multiroom_role() == MULTIROOM_SENDER)
+    {
+        multiroom_stop();
+        pm_ctl_set(PM_CLIENT_AUDIO, false);
+        music_list_apply_selected((void *)(intptr_t)track_get_index());
+        return;
+    }
+    char path[PLAYLIST_PATH_LEN];
+    const char *ext = NULL;
+    if (track_count() && track_path(track_get_index(), path, sizeof(path)))
+    {
+        ext = strrchr(path, '.');
+    }
+    if (ext == NULL || strcasecmp(ext, ".mp3") != 0)
+    {
+        music_multiroom_fail("多房间只能发MP3");
+        return;
+    }
+    music_multiroom_prepare();
+    if (multiroom_send(path) != ESP_OK)
+    {
+        pm_ctl_set(PM_CLIENT_AUDIO, false);
+        music_multiroom_fail("多房间发送失败");
+        return;
+    }
+    if (music_track_label)
+    {
+        lv_label_set_text_fmt(music_track_label, "多房间 %s", strrchr(path, '/') + 1);
+    }
+}
+
+// 长按速度键 跟着别的房间放 再长按停下
+static void btn_multiroom_listen_cb(lv_event_t *e)
+{
+    if (multiroom_role() == MULTIROOM_LISTENER)
+    {
+        multiroom_stop();
+        pm_ctl_set(PM_CLIENT_AUDIO, false);
+        music_list_apply_selected((void *)(intptr_t)track_get_index());
+        return;
+    }
+    music_multiroom_prepare();
+    if (multiroom_listen() != ESP_OK)
+    {
+        pm_ctl_set(PM_CLIENT_AUDIO, false);
+        music_multiroom_fail("多房间接收失败");
+        return;
+    }
+    if (music_track_label)
+    {
+        lv_label_set_text(music_track_label, "多房间 等待发送端");
+    }
+}
+
+// 换曲目来源 path为NULL回到音乐目录 正在放的先停下 预取和自动下一首都按序号取
+static esp_err_t music_use_playlist(const char *path)
+{
+    music_checkpoint();
+    music_stop_and_wait(PLAYER_STOP_TIMEOUT_MS);
+    esp_err_t ret = path ? playlist_open(path) : ESP_OK;
+    s_playlist_on = path && ret == ESP_OK;
+    if (!s_playlist_on)
+    {
+        playlist_close();
+    }
+    s_pl_index = 0;
+    s_resume_index = -1;
+    prefetch_lock();
+    s_prefetch_gen++;
+    s_prefetch_index = -1;
+    prefetch_unlock();
+    music_order_init(track_count());
+    ESP_LOGI(TAG, "tracks from %s: %d", s_playlist_on ? path : "music dir", track_count());
+    return ret;
+}
+
+// 列表上方的按键 在音乐目录和收藏列表之间切换
+static void music_source_btn_cb(lv_event_t *e)
+{
+    esp_err_t ret = music_use_playlist(s_playlist_on ? NULL : PLAYLIST_FAVORITES);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "unable to open %s: %s", PLAYLIST_FAVORITES, esp_err_to_name(ret));
+    }
+    music_list_close();
+    lv_label_set_text_static(label_play_pause, LV_SYMBOL_PLAY);
+    lv_obj_clear_state(btn_play_pause, LV_STATE_CHECKED);
+    music_list_set_selected(track_get_index());
+}
+
+// 长按列表里的曲目 在音乐目录里是加进收藏 在播放列表里是删掉 都只往列表文件末尾追加一行
+static void music_list_long_cb(lv_obj_t *list, int index)
+{
+    if (s_playlist_on)
+    {
+        if (playlist_remove(index) != ESP_OK)
+        {
+            return;
+        }
+        int count = track_count();
+        int cur = s_pl_index;
+        cur = index < cur ? cur - 1 : cur;
+        s_pl_index = cur >= count && count > 0 ? count - 1 : cur;
+        music_order_init(count);
+        ui_vlist_set_count(list, count);
+        ui_vlist_set_selected(list, s_pl_index, false);
+        return;
+    }
+    char path[PLAYLIST_PATH_LEN];
+    if (track_path(index, path, sizeof(path)) && playlist_append(PLAYLIST_FAVORITES, path) == ESP_OK)
+    {
+        lv_label_set_text_static(music_source_label, "已加入收藏");
+    }
+}
+
+// 弹出音乐列表 只创建可见的几行 曲目再多打开也是常数时间
+static void music_list_open(lv_event_t *e)
+{
+    if (music_list_panel || file_iterator == NULL)
+    {
+        return;
+    }
+    music_list_panel = lv_obj_create(icon_in_obj);
+    lv_obj_set_size(music_list_panel, 320, 240);
+    lv_obj_center(music_list_panel);
+    lv_obj_set_style_radius(music_list_panel, 0, 0);
+    lv_obj_set_style_border_width(music_list_panel, 0, 0);
+    lv_obj_set_style_bg_color(music_list_panel, lv_color_black(), 0);
+    lv_obj_set_style_bg_opa(music_list_panel, LV_OPA_50, 0);
+    lv_obj_clear_flag(music_list_panel, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_text_font(music_list_panel, &font_alipuhui20, 0);
+    lv_obj_add_event_cb(music_list_panel, music_list_panel_cb, LV_EVENT_CLICKED, NULL);
+
+    // 列表上方切换音乐目录和收藏列表
+    lv_obj_t *btn = lv_btn_create(music_list_panel);
+    lv_obj_set_size(btn, 280, 36);
+    lv_obj_align(btn, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_add_event_cb(btn, music_source_btn_cb, LV_EVENT_CLICKED, NULL);
+    music_source_label = lv_label_create(btn);
+    lv_label_set_text_static(music_source_label, s_playlist_on ? "返回音乐目录" : "收藏的歌");
+    lv_obj_center(music_source_label);
+
+    music_list = ui_vlist_create(music_list_panel, 280, 180, MUSIC_LIST_ROW_H, music_track_text, music_list_select_cb);
+    if (music_list == NULL)
+    {
+        music_list_close();
+        return;
+    }
+    lv_obj_align(music_list, LV_ALIGN_BOTTOM_MID, 0, 0);
+    ui_vlist_set_long_press_cb(music_list, music_list_long_cb);
+    ui_vlist_set_count(music_list, track_count());
+    ui_vlist_set_selected(music_list, track_get_index(), true);
+}
+
+static void music_index_refresh(void *arg)
+{
+    if (icon_flag != 2 || music_track_label == NULL || file_iterator == NULL)
+    {
+        return;
+    }
+    // 标题和时长已更新 重新取可见行的文字
+    if (music_list)
+    {
+        ui_vlist_refresh(music_list);
+    }
+    music_list_set_selected(track_get_index());
+}
+
+// 后台索引完成 如果正在音乐界面就刷新列表 在索引任务里调用
+static void music_index_done_cb(int count)
+{
+    ui_post_call(music_index_refresh, NULL);
+}
+
+// 启动音乐元数据索引
+void music_index_init(void)
+{
+    music_index_start(music_index_done_cb);
+}
+
+// 播放器界面的控件 只在第一次进入时创建 定时器在music_enter里开
+static void music_ui(lv_obj_t *root)
+{
+
+    /* 创建播放暂停控制按键 */
+    /*
+    CHECKABLE：按钮内部会在每次点击或编码器确认时自动切换 LV_STATE_CHECKED 开关态，
+    并触发一次 LV_EVENT_VALUE_CHANGED。适合开关类/切换类控件（如播放↔暂停、开↔关）。
+    CLICKABLE：仅表示可点击，事件序列是 PRESSED/RELEASED/CLICKED，
+    需要你自己维护是否“选中”。如果用它做播放/暂停，必须在回调里手动切换状态并管理样式。
+    这里要自动切换播放/暂停，所以用 CHECKABLE 更简洁。
+    */
+    btn_play_pause = lv_btn_create(root);
+    lv_obj_align(btn_play_pause, LV_ALIGN_CENTER, 0, 40);
+    lv_obj_set_size(btn_play_pause, 50, 50);
+    lv_obj_set_style_radius(btn_play_pause, 25, LV_STATE_DEFAULT);
+    lv_obj_add_flag(btn_play_pause, LV_OBJ_FLAG_CHECKABLE);
+    //获得焦点时不显示描边
+    lv_obj_add_style(btn_play_pause, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_play_pause, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+
+    label_play_pause = lv_label_create(btn_play_pause);
+
+    lv_label_set_text_static(label_play_pause, LV_SYMBOL_PLAY);
+    lv_obj_center(label_play_pause);
+
+    lv_obj_set_user_data(btn_play_pause, (void *)label_play_pause);
+    //对 CHECKABLE 按钮，切换开关态时只发一次 VALUE_CHANGED，不会收到多次 PRESS/RELEASE 组合，回调更干净
+    lv_obj_add_event_cb(btn_play_pause, btn_play_pause_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    /* 创建上一首控制按键 */
+    lv_obj_t *btn_play_prev = lv_btn_create(root);
+    lv_obj_set_size(btn_play_prev, 50, 50);
+    lv_obj_set_style_radius(btn_play_prev, 25, LV_STATE_DEFAULT);
+    lv_obj_clear_flag(btn_play_prev, LV_OBJ_FLAG_CHECKABLE);
+    lv_obj_align_to(btn_play_prev, btn_play_pause, LV_ALIGN_OUT_LEFT_MID, -40, 0);
+
+    lv_obj_add_style(btn_play_prev, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_play_prev, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_play_prev, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_play_prev, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_play_prev, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+
+    lv_obj_t *label_prev = lv_label_create(btn_play_prev);
+    lv_label_set_text_static(label_prev, LV_SYMBOL_PREV);
+    lv_obj_set_style_text_font(label_prev, &lv_font_montserrat_24, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(label_prev, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(label_prev);
+    lv_obj_set_user_data(btn_play_prev, (void *)label_prev);
+    lv_obj_add_event_cb(btn_play_prev, btn_prev_next_cb, LV_EVENT_CLICKED, (void *)false);
+
+    /* 创建下一首控制按键 */
+    lv_obj_t *btn_play_next = lv_btn_create(root);
+    lv_obj_set_size(btn_play_next, 50, 50);
+    lv_obj_set_style_radius(btn_play_next, 25, LV_STATE_DEFAULT);
+    lv_obj_clear_flag(btn_play_next, LV_OBJ_FLAG_CHECKABLE);
+    lv_obj_align_to(btn_play_next, btn_play_pause, LV_ALIGN_OUT_RIGHT_MID, 40, 0);
+
+    lv_obj_add_style(btn_play_next, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_play_next, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_play_next, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_play_next, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_play_next, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+
+    lv_obj_t *label_next = lv_label_create(btn_play_next);
+    lv_label_set_text_static(label_next, LV_SYMBOL_NEXT);
+    lv_obj_set_style_text_font(label_next, &lv_font_montserrat_24, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(label_next, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(label_next);
+    lv_obj_set_user_data(btn_play_next, (void *)label_next);
+    lv_obj_add_event_cb(btn_play_next, btn_prev_next_cb, LV_EVENT_CLICKED, (void *)true);
+
+    /* 创建声音调节滑动条 */
+    volume_slider = lv_slider_create(root);
+    lv_obj_set_size(volume_slider, 200, 10);
+    lv_obj_set_ext_click_area(volume_slider, 15);
+    lv_obj_align(volume_slider, LV_ALIGN_BOTTOM_MID, 0, -20);
+    lv_slider_set_range(volume_slider, 0, 100);
+    lv_slider_set_value(volume_slider, g_sys_volume, LV_ANIM_ON);
+    lv_obj_add_event_cb(volume_slider, volume_slider_cb, LV_EVENT_VALUE_CHANGED, NULL);
+
+    lv_obj_t *lab_vol_min = lv_label_create(root);
+    lv_label_set_text_static(lab_vol_min, LV_SYMBOL_VOLUME_MID);
+    lv_obj_set_style_text_font(lab_vol_min, &lv_font_montserrat_20, LV_STATE_DEFAULT);
+    lv_obj_align_to(lab_vol_min, volume_slider, LV_ALIGN_OUT_LEFT_MID, -10, 0);
+
+    lv_obj_t *lab_vol_max = lv_label_create(root);
+    lv_label_set_text_static(lab_vol_max, LV_SYMBOL_VOLUME_MAX);
+    lv_obj_set_style_text_font(lab_vol_max, &lv_font_montserrat_20, LV_STATE_DEFAULT);
+    lv_obj_align_to(lab_vol_max, volume_slider, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
+
+    /* 创建播放进度条 */
+    progress_slider = lv_slider_create(root);
+    lv_obj_set_size(progress_slider, 200, 6);
+    lv_obj_set_ext_click_area(progress_slider, 12);
+    lv_obj_align(progress_slider, LV_ALIGN_CENTER, 0, 6);
+    lv_slider_set_range(progress_slider, 0, PROGRESS_RANGE);
+    lv_obj_add_event_cb(progress_slider, progress_slider_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_obj_add_event_cb(progress_slider, progress_slider_cb, LV_EVENT_RELEASED, NULL);
+
+    label_elapsed = lv_label_create(root);
+    lv_label_set_text(label_elapsed, "0:00");
+    lv_obj_set_style_text_font(label_elapsed, &lv_font_montserrat_14, LV_STATE_DEFAULT);
+    lv_obj_align_to(label_elapsed, progress_slider, LV_ALIGN_OUT_LEFT_MID, -8, 0);
+
+    label_duration = lv_label_create(root);
+    lv_label_set_text(label_duration, "0:00");
+    lv_obj_set_style_text_font(label_duration, &lv_font_montserrat_14, LV_STATE_DEFAULT);
+    lv_obj_align_to(label_duration, progress_slider, LV_ALIGN_OUT_RIGHT_MID, 8, 0);
+
+    /* 创建频谱显示 在曲目按键和进度条之间 */
+    lv_obj_t *vis = vis_cont = lv_obj_create(root);
+    lv_obj_set_size(vis, 200, VIS_HEIGHT);
+    lv_obj_align(vis, LV_ALIGN_TOP_MID, 0, 102);
+    lv_obj_set_style_pad_all(vis, 0, 0);
+    lv_obj_set_style_border_width(vis, 0, 0);
+    lv_obj_set_style_bg_opa(vis, LV_OPA_TRANSP, 0);
+    lv_obj_clear_flag(vis, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICKABLE);
+    for (int b = 0; b < AUDIO_VIS_BANDS; b++)
+    {
+        vis_bars[b] = lv_obj_create(vis);
+        lv_obj_set_size(vis_bars[b], 200 / AUDIO_VIS_BANDS - 2, 1);
+        lv_obj_align(vis_bars[b], LV_ALIGN_BOTTOM_LEFT, b * (200 / AUDIO_VIS_BANDS) + 1, 0);
+        lv_obj_set_style_radius(vis_bars[b], 0, 0);
+        lv_obj_set_style_border_width(vis_bars[b], 0, 0);
+        lv_obj_set_style_bg_color(vis_bars[b], lv_color_hex(0x30a830), 0);
+        lv_obj_clear_flag(vis_bars[b], LV_OBJ_FLAG_CLICKABLE);
+    }
+#if CONFIG_APP_MUSIC_LYRICS
+    // 字体行高28 底下的留白压在进度条上面
+    music_lyric_label = lv_label_create(root);
+    lv_obj_set_width(music_lyric_label, 200);
+    lv_label_set_long_mode(music_lyric_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_style_text_font(music_lyric_label, &font_alipuhui20, 0);
+    lv_obj_set_style_text_align(music_lyric_label, LV_TEXT_ALIGN_CENTER, 0);
+    lv_obj_align(music_lyric_label, LV_ALIGN_TOP_MID, 0, 98);
+    lv_label_set_text_static(music_lyric_label, "");
+    lv_obj_add_flag(music_lyric_label, LV_OBJ_FLAG_HIDDEN);
+#endif
+
+    /* 创建当前曲目按键 点击弹出音乐列表 */
+    lv_obj_t *btn_track = lv_btn_create(root);
+    lv_obj_set_size(btn_track, 200, 40);
+    lv_obj_align(btn_track, LV_ALIGN_TOP_MID, 0, 60);
+    lv_obj_set_style_bg_color(btn_track, lv_color_white(), LV_STATE_DEFAULT);
+    lv_obj_set_style_border_width(btn_track, 1, LV_STATE_DEFAULT);
+    lv_obj_set_style_border_color(btn_track, lv_palette_main(LV_PALETTE_GREY), LV_STATE_DEFAULT);
+    lv_obj_set_style_shadow_width(btn_track, 0, LV_STATE_DEFAULT);
+    lv_obj_add_event_cb(btn_track, music_list_open, LV_EVENT_SHORT_CLICKED, NULL);
+    lv_obj_add_event_cb(btn_track, btn_radio_cb, LV_EVENT_LONG_PRESSED, NULL);
+
+    music_track_label = lv_label_create(btn_track);
+    lv_obj_set_width(music_track_label, 180);
+    lv_label_set_long_mode(music_track_label, LV_LABEL_LONG_DOT);
+    lv_obj_set_style_text_font(music_track_label, &font_alipuhui20, 0);
+    lv_obj_set_style_text_color(music_track_label, lv_color_make(0, 0, 0), 0);
+    lv_obj_center(music_track_label);
+
+    /* 创建播放模式按键 */
+    lv_obj_t *btn_order = lv_btn_create(root);
+    lv_obj_set_size(btn_order, 40, 40);
+    lv_obj_set_style_radius(btn_order, 20, LV_STATE_DEFAULT);
+    lv_obj_align_to(btn_order, btn_track, LV_ALIGN_OUT_RIGHT_MID, 8, 0);
+    lv_obj_add_style(btn_order, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_order, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_order, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_order, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_order, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+
+    lv_obj_t *label_order = lv_label_create(btn_order);
+    lv_label_set_text_static(label_order, music_order_symbol(music_order_get_mode()));
+    lv_obj_set_style_text_font(label_order, &lv_font_montserrat_20, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(label_order, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(label_order);
+    lv_obj_add_event_cb(btn_order, btn_order_cb, LV_EVENT_SHORT_CLICKED, (void *)label_order);
+    lv_obj_add_event_cb(btn_order, btn_multiroom_send_cb, LV_EVENT_LONG_PRESSED, NULL);
+
+    /* 创建播放速度按键 */
+    lv_obj_t *btn_speed = lv_btn_create(root);
+    lv_obj_set_size(btn_speed, 40, 40);
+    lv_obj_set_style_radius(btn_speed, 20, LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_all(btn_speed, 0, LV_STATE_DEFAULT);
+    lv_obj_align_to(btn_speed, btn_track, LV_ALIGN_OUT_LEFT_MID, -8, 0);
+    lv_obj_add_style(btn_speed, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_speed, ui_style(UI_STYLE_BTN_NO_OUTLINE), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_speed, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUS_KEY);
+    lv_obj_add_style(btn_speed, ui_style(UI_STYLE_BTN_BG), LV_STATE_FOCUSED);
+    lv_obj_add_style(btn_speed, ui_style(UI_STYLE_BTN_BG), LV_STATE_DEFAULT);
+
+    lv_obj_t *label_speed = lv_label_create(btn_speed);
+    lv_label_set_text_static(label_speed, "1x");
+    lv_obj_set_style_text_font(label_speed, &lv_font_montserrat_14, LV_STATE_DEFAULT);
+    lv_obj_set_style_text_color(label_speed, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
+    lv_obj_center(label_speed);
+    lv_obj_add_event_cb(btn_speed, btn_speed_cb, LV_EVENT_SHORT_CLICKED, (void *)label_speed);
+    lv_obj_add_event_cb(btn_speed, btn_multiroom_listen_cb, LV_EVENT_LONG_PRESSED, NULL);
+}
+
+// 每次进入 开进度和频谱刷新 按钮回到停止状态 显示当前曲目
+static void music_enter(lv_obj_t *root)
+{
+    s_progress_timer = lv_timer_create(progress_timer_cb, 500, NULL);
+    s_vis_timer = lv_timer_create(vis_timer_cb, AUDIO_VIS_PERIOD_MS, NULL);
+    audio_vis_set_enabled(!lv_obj_has_flag(vis_cont, LV_OBJ_FLAG_HIDDEN)); // 上次的歌词还盖着 等刷新
+    // 退出时已经停止播放 缓存的界面可能还停在暂停键和上次的进度
+    lv_obj_clear_state(btn_play_pause, LV_STATE_CHECKED);
+    lv_label_set_text_static(label_play_pause, LV_SYMBOL_PLAY);
+    lv_slider_set_value(volume_slider, g_sys_volume, LV_ANIM_OFF);
+    lv_slider_set_value(progress_slider, 0, LV_ANIM_OFF);
+    lv_label_set_text(label_elapsed, "0:00");
+    music_list_set_selected(track_get_index()); // 恢复上次的曲目
+#if CONFIG_APP_MUSIC_LYRICS
+    music_lyrics_refresh();
+#endif
+}
+
+static void music_leave(lv_obj_t *root)
+{
+    if (s_progress_timer)
+    {
+        lv_timer_del(s_progress_timer);
+        s_progress_timer = NULL;
+    }
+    if (s_vis_timer)
+    {
+        lv_timer_del(s_vis_timer);
+        s_vis_timer = NULL;
+    }
+    audio_vis_set_enabled(false);
+    if (music_list_panel)
+    {
+        // 不能用异步删除 隐藏后界面可能马上被回收
+        lv_obj_del(music_list_panel);
+        music_list_panel = NULL;
+        music_list = NULL;
+    }
+}
+
+// 界面被回收 回调里不能再碰这些控件
+static void music_evicted(void)
+{
+    music_track_label = NULL;
+#if CONFIG_APP_MUSIC_LYRICS
+    music_lyric_label = NULL;
+#endif
+    music_list_panel = NULL;
+    music_list = NULL;
+}
+
+// 返回主界面按钮事件处理函数
+static void btn_music_back_cb(lv_event_t *e)
+{
+    ui_screen_leave(2);
+    music_checkpoint(); // 停止前保存当前位置
+    // 标记用户主动停止，回调中不自动下一首、不触碰已删除的UI
+    s_user_stop_pending = true;
+    // 不删除播放任务，仅停止播放，避免后续从SD直接播放时访问已释放的队列
+    // audio_player_delete();
+    audio_player_stop();
+    audio_pcm_flush();
+    multiroom_stop();
+    icon_flag = 0;
+}
+
+// 标题栏 返回键和播放器控件
+static void music_build(lv_obj_t *root)
+{
+    // 创建标题背景
+    lv_obj_t *music_title = lv_obj_create(root);
+    lv_obj_add_style(music_title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(music_title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(music_title, lv_color_hex(0xf87c30), 0);
+    // 显示标题
+    music_title_label = lv_label_create(music_title);
+    lv_label_set_text(music_title_label, "音乐播放器");
+    lv_obj_set_style_text_color(music_title_label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(music_title_label, &font_alipuhui20, 0);
+    lv_obj_align(music_title_label, LV_ALIGN_CENTER, 0, 0);
+    // 创建后退按钮
+    btn_music_back = lv_btn_create(music_title);
+    lv_obj_align(btn_music_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_music_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_music_back, btn_music_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
+
+    lv_obj_t *label_back = lv_label_create(btn_music_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    music_ui(root); // 音乐播放器界面
+}
+
+static const ui_screen_desc_t s_music_screen = {
+    .name = "music",
+    .bg_color = 0xffffff,
+    .res = APP_RES_BIT(APP_RES_AUDIO),
+    .psram_kb = 256, // 解码和重采样的缓冲
+    .build = music_build,
+    .enter = music_enter,
+    .leave = music_leave,
+    .evicted = music_evicted,
+};
+
+// 进入音乐播放应用
+// 播放器在第一次打开前由app_mod的init建好
+static void music_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(2, &s_music_screen);
+    icon_flag = 2; // 标记已经进入第二个应用
+}
+
+// 停止播放并等待播放器回到IDLE 等待时间就是真正停止所需的时间
+static esp_err_t music_stop_and_wait(uint32_t timeout_ms)
+{
+    // 先清标志再看状态 状态检查之后才到来的IDLE也不会漏掉
+    xEventGroupClearBits(s_player_events, PLAYER_EVT_IDLE);
+    if (audio_player_get_state() == AUDIO_PLAYER_STATE_IDLE)
+    {
+        return ESP_OK;
+    }
+    s_user_stop_pending = true; // 标记为用户主动停止，避免回调中自动下一首
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = audio_player_stop();
+    if (ret == ESP_OK)
+    {
+        audio_pcm_flush(); // 丢掉缓冲中的尾巴 静音前的drain不必等它播完
+        EventBits_t bits = xEventGroupWaitBits(s_player_events, PLAYER_EVT_IDLE, pdTRUE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+        ret = (bits & PLAYER_EVT_IDLE) ? ESP_OK : ESP_ERR_TIMEOUT;
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "player stop failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    s_user_stop_pending = false; // 曲目恰好自然结束时回调没有消费这个标志
+    audio_lat_mark(AUDIO_LAT_STOPPED);
+    ESP_LOGI(TAG, "player stopped in %lld us", esp_timer_get_time() - start);
+    return ESP_OK;
+}
+
+// 播放网络电台 流通过FILE*交给播放器 与本地文件走同一个MP3解码器
+esp_err_t music_play_radio(const char *url)
+{
+    mp3_player_init();
+    multiroom_stop();
+    music_checkpoint();
+    s_resume_track = false;
+    music_stop_and_wait(PLAYER_STOP_TIMEOUT_MS); // 旧的电台流在播放器fclose时断开
+    FILE *fp = net_radio_open(url);
+    if (fp == NULL)
+    {
+        return ESP_FAIL;
+    }
+    s_radio_playing = true;
+    audio_pcm_set_track_gain(0);
+#if CONFIG_APP_MUSIC_LYRICS
+    music_lyrics_load(NULL);
+#endif
+    ESP_LOGI(TAG, "Playing radio '%s'", url);
+    esp_err_t ret = audio_player_play(fp);
+    if (ret != ESP_OK)
+    {
+        s_radio_playing = false;
+        fclose(fp);
+    }
+    return ret;
+}
+
+// 直接按文件路径播放（用于从SD文件浏览器跳转）
+void music_play_file(const char *filepath)
+{
+    if (!filepath || !*filepath)
+    {
+        ESP_LOGE(TAG, "music_play_file: invalid path");
+        return;
+    }
+    audio_lat_start("file");
+    // 确保播放器已初始化（幂等），避免在删除后直接播放造成队列悬空
+    mp3_player_init();
+    FILE *fp = fd_pool_fopen(filepath, "rb");
+    if (fp)
+    {
+        
+        multiroom_stop();
+        music_checkpoint();
+        s_resume_track = false; // 文件浏览器播放的文件不记录断点
+        s_radio_playing = false;
+        music_stop_and_wait(PLAYER_STOP_TIMEOUT_MS); // 停止当前播放 等真正停下来
+        ESP_LOGI(TAG, "Playing '%s'", filepath);
+        music_track_gain(filepath);
+#if CONFIG_APP_MUSIC_LYRICS
+        music_lyrics_load(filepath);
+#endif
+        audio_lat_mark(AUDIO_LAT_OPEN);
+        audio_player_play(fp);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "music_play_file: unable to open '%s'", filepath);
+    }
+}
+
+// 文件浏览器里点了.m3u 换成这个列表从第一首放起
+void music_play_playlist(const char *path)
+{
+    audio_lat_start("playlist");
+    mp3_player_init();
+    esp_err_t ret = music_use_playlist(path);
+    if (ret != ESP_OK || track_count() == 0)
+    {
+        ESP_LOGE(TAG, "music_play_playlist: nothing to play in '%s': %s", path, esp_err_to_name(ret));
+        return;
+    }
+    s_radio_playing = false;
+    play_index(track_get_index());
+    music_list_set_selected(track_get_index());
+}
+
+/******************************** 语音控制  ******************************/
+static bool ai_music_ready(void)
+{
+    if (icon_flag != 2 || file_iterator == NULL) {
+        ESP_LOGI(TAG, "voice: music player not open");
+        return false;
+    }
+    return true;
+}
+
+// 播放暂停键是CHECKABLE 选中表示正在播放 语音改了状态也要跟着改
+static void ai_play_label(bool playing)
+{
+    lv_label_set_text_static(label_play_pause, playing ? LV_SYMBOL_PAUSE : LV_SYMBOL_PLAY);
+    if (playing) {
+        lv_obj_add_state(btn_play_pause, LV_STATE_CHECKED);
+    } else {
+        lv_obj_clear_state(btn_play_pause, LV_STATE_CHECKED);
+    }
+}
+
+void ai_play(void)
+{
+    if (!ai_music_ready()) {
+        return;
+    }
+    audio_player_state_t state = audio_player_get_state();
+    if (state == AUDIO_PLAYER_STATE_IDLE) {
+        play_index(track_get_index());
+    } else if (state == AUDIO_PLAYER_STATE_PAUSE) {
+        audio_player_resume();
+    }
+    ai_play_label(true);
+}
+
+void ai_pause(void)
+{
+    if (ai_music_ready() && audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING) {
+        audio_player_pause();
+        ai_play_label(false);
+    }
+}
+
+void ai_resume(void)
+{
+    if (ai_music_ready() && audio_player_get_state() == AUDIO_PLAYER_STATE_PAUSE) {
+        audio_player_resume();
+        ai_play_label(true);
+    }
+}
+
+void ai_prev_music(void)
+{
+    if (ai_music_ready()) {
+        music_step(false);
+    }
+}
+
+void ai_next_music(void)
+{
+    if (ai_music_ready()) {
+        music_step(true);
+    }
+}
+
+#define AI_VOLUME_STEP  10
+
+void ai_seek(uint32_t position_ms)
+{
+    if (!ai_music_ready()) {
+        return;
+    }
+    audio_player_position_t pos;
+    audio_player_state_t state = audio_player_get_state();
+    if (audio_player_get_position(&pos) != ESP_OK || !pos.duration_ms ||
+        (state != AUDIO_PLAYER_STATE_PLAYING && state != AUDIO_PLAYER_STATE_PAUSE)) {
+        return;
+    }
+    position_ms = position_ms > pos.duration_ms ? pos.duration_ms : position_ms;
+    ESP_LOGI(TAG, "seek to %lu ms", (unsigned long)position_ms);
+    audio_player_seek(position_ms);
+}
+
+void ai_volume_set(int volume)
+{
+    volume = volume < 0 ? 0 : volume > 100 ? 100 : volume;
+    audio_pcm_set_volume(volume);
+    g_sys_volume = volume;
+    if (icon_flag == 2 && volume_slider) {
+        lv_slider_set_value(volume_slider, volume, LV_ANIM_ON);
+    }
+    ESP_LOGI(TAG, "volume %d", volume);
+}
+
+static void ai_volume_step(int step)
+{
+    ai_volume_set(g_sys_volume + step);
+}
+
+void ai_volume_up(void)
+{
+    ai_volume_step(AI_VOLUME_STEP);
+}
+
+void ai_volume_down(void)
+{
+    ai_volume_step(-AI_VOLUME_STEP);
+}
+
+void ai_play_file(const char *path)
+{
+    music_play_file(path);
+    if (icon_flag == 2 && file_iterator) {
+        ai_play_label(true);
+    }
+}
+
+// 本地文件在卡上 电台不用停
+static void music_sd_removed(void)
+{
+    if (s_audio_player_ready && !s_radio_playing) {
+        music_stop_and_wait(APP_SD_PULL_STOP_MS);
+    }
+}
+
+const app_mod_t app_mod_music = {
+    .name = "music",
+    .id = 2,
+    .color = 0xf87c30,
+    .icon = "img_music_icon",
+    .init = mp3_player_init,
+    .open = music_event_handler,
+    .back = btn_music_back_cb,
+    .sd_removed = music_sd_removed,
+};
@@ -0,0 +1,180 @@
+#include <string.h>
+#include "app_res.h"
+#include "task_plan.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "app_res";
+
+static const char *const s_names[APP_RES_COUNT] = {
+    [APP_RES_CAMERA] = "camera",
+    [APP_RES_WIFI] = "wifi",
+    [APP_RES_BT] = "bt",
+    [APP_RES_AUDIO] = "audio",
+};
+
+typedef struct {
+    const app_res_ops_t *ops;
+    esp_timer_handle_t linger;
+    app_res_stats_t stats;
+} res_t;
+
+static res_t s_res[APP_RES_COUNT];
+static SemaphoreHandle_t s_mutex;       // up和down不会同时跑 holders和on也在它里面改
+static TaskHandle_t s_task;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;  // 只护着统计 给get_stats用
+
+// 关掉的活放到app_res任务里 esp_timer任务里不能等摄像头停
+static void linger_cb(void *arg)
+{
+    xTaskNotify(s_task, APP_RES_BIT((int)(uintptr_t)arg), eSetBits);
+}
+
+static void res_task(void *arg)
+{
+    while (1)
+    {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+        for (int i = 0; i < APP_RES_COUNT; i++)
+        {
+            res_t *r = &s_res[i];
+            if (!(bits & APP_RES_BIT(i)))
+            {
+                continue;
+            }
+            xSemaphoreTake(s_mutex, portMAX_DELAY);
+            if (r->stats.holders == 0 && r->stats.on)
+            {
+                int64_t t0 = esp_timer_get_time();
+                if (r->ops && r->ops->down)
+                {
+                    r->ops->down();
+                }
+                portENTER_CRITICAL(&s_lock);
+                r->stats.on = false;
+                r->stats.downs++;
+                portEXIT_CRITICAL(&s_lock);
+                ESP_LOGI(TAG, "%s off in %lu us", r->stats.name, (unsigned long)(esp_timer_get_time() - t0));
+            }
+            xSemaphoreGive(s_mutex);
+        }
+    }
+}
+
+esp_err_t app_res_init(void)
+{
+    if (s_mutex)
+    {
+        return ESP_OK;
+    }
+    s_mutex = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_mutex, ESP_ERR_NO_MEM, TAG, "no mutex");
+    for (int i = 0; i < APP_RES_COUNT; i++)
+    {
+        s_res[i].stats.name = s_names[i];
+        const esp_timer_create_args_t args = {
+            .callback = linger_cb,
+            .arg = (void *)(uintptr_t)i,
+            .name = "app_res",
+        };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_res[i].linger), TAG, "create timer");
+    }
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_APP_RES, res_task, NULL, &s_task) == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "no task");
+    return ESP_OK;
+}
+
+void app_res_register(app_res_t res, const app_res_ops_t *ops)
+{
+    if (res < APP_RES_COUNT)
+    {
+        s_res[res].ops = ops;
+    }
+}
+
+esp_err_t app_res_acquire(uint32_t mask)
+{
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < APP_RES_COUNT && s_mutex; i++)
+    {
+        res_t *r = &s_res[i];
+        if (!(mask & APP_RES_BIT(i)))
+        {
+            continue;
+        }
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        esp_timer_stop(r->linger); // 没在等也没关系
+        portENTER_CRITICAL(&s_lock);
+        r->stats.holders++;
+        r->stats.reuses += r->stats.holders == 1 && r->stats.on;
+        portEXIT_CRITICAL(&s_lock);
+        if (!r->stats.on)
+        {
+            int64_t t0 = esp_timer_get_time();
+            esp_err_t err = r->ops && r->ops->up ? r->ops->up() : ESP_OK;
+            uint32_t us = esp_timer_get_time() - t0;
+            portENTER_CRITICAL(&s_lock);
+            r->stats.on = err == ESP_OK;
+            r->stats.ups += err == ESP_OK;
+            r->stats.failed += err != ESP_OK;
+            r->stats.up_us += us;
+            if (us > r->stats.up_us_max)
+            {
+                r->stats.up_us_max = us;
+            }
+            portEXIT_CRITICAL(&s_lock);
+            if (err != ESP_OK)
+            {
+                ESP_LOGW(TAG, "%s up failed: %s", r->stats.name, esp_err_to_name(err));
+                ret = err;
+            }
+        }
+        xSemaphoreGive(s_mutex);
+    }
+    return ret;
+}
+
+void app_res_release(uint32_t mask)
+{
+    for (int i = 0; i < APP_RES_COUNT && s_mutex; i++)
+    {
+        res_t *r = &s_res[i];
+        if (!(mask & APP_RES_BIT(i)))
+        {
+            continue;
+        }
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        if (r->stats.holders == 0)
+        {
+            ESP_LOGW(TAG, "%s released more than acquired", r->stats.name);
+        }
+        else
+        {
+            portENTER_CRITICAL(&s_lock);
+            r->stats.holders--;
+            portEXIT_CRITICAL(&s_lock);
+            if (r->stats.holders == 0 && r->stats.on && r->ops && r->ops->down)
+            {
+                esp_timer_start_once(r->linger, APP_RES_LINGER_MS * 1000ULL);
+            }
+        }
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+void app_res_get_stats(app_res_t res, app_res_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (res >= APP_RES_COUNT)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_res[res].stats;
+    portEXIT_CRITICAL(&s_lock);
+}
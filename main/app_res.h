@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 应用用的外设 ****************************/
+// 应用界面在ui_screen_desc_t里写上要用哪些外设 进入时ui_screen按引用计数拿 退出时还
+// 第一个人拿的时候同步调up 最后一个人还了以后过APP_RES_LINGER_MS才在后台任务里调down
+// 这期间又有人拿就什么都不做 来回切应用不用每次重新初始化摄像头
+// up和down由管这个外设的模块注册 没注册的只记谁在用
+// app_res_acquire和app_res_release在哪个任务里调都行 down在app_res任务里 可以阻塞
+
+typedef enum {
+    APP_RES_CAMERA,
+    APP_RES_WIFI,
+    APP_RES_BT,
+    APP_RES_AUDIO,
+    APP_RES_COUNT,
+} app_res_t;
+
+#define APP_RES_BIT(r)          (1u << (r))
+#define APP_RES_LINGER_MS       3000    // 最后一个人还了以后多久才关
+
+typedef struct {
+    esp_err_t (*up)(void);              // 可为NULL
+    void (*down)(void);                 // 可为NULL 一直开着
+} app_res_ops_t;
+
+typedef struct {
+    const char *name;
+    uint8_t holders;
+    bool on;
+    uint32_t ups;
+    uint32_t downs;
+    uint32_t reuses;                    // 还没关就又有人要 省掉的up
+    uint32_t failed;                    // up失败
+    uint32_t up_us_max;
+    uint64_t up_us;
+} app_res_stats_t;
+
+esp_err_t app_res_init(void);           // 界面起来之前
+void app_res_register(app_res_t res, const app_res_ops_t *ops);    // ops要一直有效
+esp_err_t app_res_acquire(uint32_t mask);   // 失败的那个也算拿了 照样要还
+void app_res_release(uint32_t mask);
+void app_res_get_stats(app_res_t res, app_res_stats_t *stats);
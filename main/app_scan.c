@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <string.h>
+#include "app_mod.h"
+#include "task_plan.h"
+#include "ui_msg.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "cam_qr.h"
+#include "idle_mgr.h"
+#include "pm_ctl.h"
+#include "wifi_svc.h"
+#include "esp32_s3_szp.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+static const char *TAG = "app_scan";
+
+/******************************** 第10个图标 扫码 应用程序 ***********************************************************************************/
+// 传感器出灰度 取帧任务在核0 每帧查表展开成RGB565推给LVGL 同一帧的中间一块交给核1上的识别任务
+// 预览两块缓冲轮流用 上一块还没换上去就跳过这一帧的预览 不会写LVGL正在用的那块
+// WiFi的码不经过密码键盘 直接连
+#define SCAN_W              CAM_QR_SRC_W
+#define SCAN_H              CAM_QR_SRC_H
+#define SCAN_COLOR          0x2c3e50
+
+static lv_obj_t *s_scan_img = NULL;
+static lv_obj_t *s_scan_text = NULL;
+static lv_obj_t *s_scan_cost = NULL;
+static lv_img_dsc_t s_scan_dsc = {
+    .header.cf = LV_IMG_CF_TRUE_COLOR,
+    .header.w = SCAN_W,
+    .header.h = SCAN_H,
+    .data_size = SCAN_W * SCAN_H * 2,
+};
+static uint16_t *s_view[2];
+static volatile bool s_swap_pending = false;
+static uint16_t s_gray_lut[256];        // 亮度到RGB565 已经按LV_COLOR_16_SWAP换好字节
+static cam_qr_result_t s_result;        // 取帧任务写 界面任务读 s_result_shown管着
+static volatile bool s_result_shown = true;
+static char s_wifi_ssid[33];
+
+static void scan_lut_init(void)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        uint16_t c = (i >> 3) << 11 | (i >> 2) << 5 | (i >> 3);
+#if LV_COLOR_16_SWAP
+        c = c >> 8 | c << 8;
+#endif
+        s_gray_lut[i] = c;
+    }
+}
+
+// 在LVGL任务里 换上刚展开好的那块
+static void scan_show(void *arg)
+{
+    if (s_scan_img)
+    {
+        s_scan_dsc.data = (const uint8_t *)s_view[(intptr_t)arg];
+        lv_img_set_src(s_scan_img, &s_scan_dsc);
+        lv_obj_invalidate(s_scan_img);
+    }
+    s_swap_pending = false;
+}
+
+static void scan_show_result(void *arg)
+{
+    if (s_scan_text)
+    {
+        if (s_wifi_ssid[0])
+        {
+            lv_label_set_text_fmt(s_scan_text, "WLAN: %s ...", s_wifi_ssid);
+        }
+        else
+        {
+            lv_label_set_text(s_scan_text, s_result.text);
+        }
+        lv_label_set_text_fmt(s_scan_cost, "%lu ms (seen %lu ms, decode %lu ms%s)",
+                              (unsigned long)s_result.latency_us / 1000, (unsigned long)s_result.acquire_us / 1000,
+                              (unsigned long)s_result.decode_us / 1000, s_result.full ? ", full" : "");
+    }
+    s_result_shown = true;
+}
+
+static void scan_wifi_result(void *arg)
+{
+    if (s_scan_text && s_wifi_ssid[0])
+    {
+        lv_label_set_text_fmt(s_scan_text, "WLAN: %s %s", s_wifi_ssid, arg ? "OK" : "failed");
+    }
+}
+
+static void scan_wifi_listener(const wifi_svc_event_t *ev)
+{
+    if (ev->type == WIFI_SVC_EV_STATE && (ev->state == WIFI_SVC_CONNECTED || ev->state == WIFI_SVC_FAILED))
+    {
+        ui_post_call(scan_wifi_result, ev->state == WIFI_SVC_CONNECTED ? (void *)1 : NULL);
+    }
+}
+
+// WiFi的码直接连 别的只显示
+static void scan_handle_result(void)
+{
+    char pass[65];
+    s_wifi_ssid[0] = '\0';
+    if (cam_qr_parse_wifi(s_result.text, s_wifi_ssid, sizeof(s_wifi_ssid), pass, sizeof(pass)))
+    {
+        ESP_LOGI(TAG, "WiFi code for \"%s\"", s_wifi_ssid);
+        wifi_svc_subscribe(scan_wifi_listener); // 监听槽只有几个 离开时退订
+        if (app_wifi_open() != ESP_OK || wifi_svc_connect(s_wifi_ssid, pass) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "WiFi connect not started");
+        }
+    }
+    ESP_LOGI(TAG, "scanned %u bytes in %lu ms (first seen %lu ms ago, decode %lu ms)", (unsigned)s_result.len,
+             (unsigned long)s_result.latency_us / 1000, (unsigned long)s_result.acquire_us / 1000,
+             (unsigned long)s_result.decode_us / 1000);
+}
+
+static void scan_exit(void *arg)
+{
+    lv_img_set_src(s_scan_img, NULL);
+    for (int i = 0; i < 2; i++)
+    {
+        heap_caps_free(s_view[i]);
+        s_view[i] = NULL;
+    }
+    wifi_svc_unsubscribe(scan_wifi_listener); // 连接结果不等了 服务自己会接着连
+    ui_screen_leave(10);
+    idle_mgr_inhibit(false);
+    pm_ctl_set(PM_CLIENT_CAMERA, false);
+}
+
+static void task_scan_view(void *arg)
+{
+    // 摄像头可能还开着相机应用的模式 没过APP_RES_LINGER_MS没关
+    if (bsp_camera_get_mode() != BSP_CAMERA_GRAY)
+    {
+        esp_camera_deinit();
+        if (bsp_camera_init_mode(BSP_CAMERA_GRAY) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "camera has no grayscale mode");
+        }
+    }
+    cam_qr_start();
+    int back = 0;
+    uint32_t frames = 0, shown = 0;
+    int64_t t0 = esp_timer_get_time();
+    while (icon_flag == 10)
+    {
+        camera_fb_t *frame = esp_camera_fb_get();
+        if (!frame)
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        frames++;
+        cam_qr_frame(frame);
+        if (!s_swap_pending && frame->format == PIXFORMAT_GRAYSCALE && frame->len >= SCAN_W * SCAN_H)
+        {
+            uint16_t *dst = s_view[back];
+            for (int i = 0; i < SCAN_W * SCAN_H; i++)
+            {
+                dst[i] = s_gray_lut[frame->buf[i]];
+            }
+            s_swap_pending = true;
+            if (ui_post_call(scan_show, (void *)(intptr_t)back))
+            {
+                back ^= 1;
+                shown++;
+            }
+            else
+            {
+                s_swap_pending = false;
+            }
+        }
+        esp_camera_fb_return(frame);
+        if (s_result_shown && cam_qr_take_result(&s_result))
+        {
+            scan_handle_result();
+            s_result_shown = false;
+            if (!ui_post_call(scan_show_result, NULL))
+            {
+                s_result_shown = true;
+            }
+        }
+    }
+    cam_qr_stats_t st;
+    cam_qr_get_stats(&st);
+    cam_qr_stop();
+    float sec = (esp_timer_get_time() - t0) / 1e6f;
+    ESP_LOGI(TAG, "scan: %lu frames (%.1f fps, %lu shown), %lu analysed (%lu full, %lu busy), %lu seen / %lu decoded / %lu failed, "
+             "copy %.1f ms, identify %.1f ms, decode %.1f ms per frame, latency last %lu ms max %lu ms",
+             (unsigned long)frames, sec > 0 ? frames / sec : 0.0f, (unsigned long)shown, (unsigned long)st.frames,
+             (unsigned long)st.full_frames, (unsigned long)st.busy, (unsigned long)st.seen, (unsigned long)st.decoded,
+             (unsigned long)st.failed, st.frames ? st.copy_us / 1000.0 / st.frames : 0.0,
+             st.frames ? st.identify_us / 1000.0 / st.frames : 0.0, st.frames ? st.decode_us / 1000.0 / st.frames : 0.0,
+             (unsigned long)st.latency_us_last / 1000, (unsigned long)st.latency_us_max / 1000);
+    while (s_swap_pending || !s_result_shown)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10)); // 投出去的还没执行 缓冲先别放
+    }
+    ui_post_call(scan_exit, NULL); // 摄像头等app_res过一会再关
+    vTaskDelete(NULL);
+}
+
+static void btn_scan_back_cb(lv_event_t *e)
+{
+    icon_flag = 0;
+}
+
+static void scan_build(lv_obj_t *root)
+{
+    s_scan_img = lv_img_create(root);
+    lv_obj_set_pos(s_scan_img, 0, 0);
+    lv_obj_set_size(s_scan_img, SCAN_W, SCAN_H);
+
+    // 识别的范围
+    lv_obj_t *roi = lv_obj_create(root);
+    lv_obj_set_size(roi, CAM_QR_ROI, CAM_QR_ROI);
+    lv_obj_center(roi);
+    lv_obj_set_style_bg_opa(roi, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_color(roi, lv_color_hex(0x30a830), 0);
+    lv_obj_set_style_border_width(roi, 2, 0);
+    lv_obj_set_style_radius(roi, 0, 0);
+    lv_obj_clear_flag(roi, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+
+    lv_obj_t *btn_back = lv_btn_create(root);
+    lv_obj_align(btn_back, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_scan_back_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT);
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    /* 解出来的内容 */
+    s_scan_text = lv_label_create(root);
+    lv_obj_set_width(s_scan_text, SCAN_W - 12);
+    lv_label_set_long_mode(s_scan_text, LV_LABEL_LONG_DOT);
+    lv_obj_set_style_max_height(s_scan_text, 60, 0);
+    lv_obj_set_style_text_font(s_scan_text, &lv_font_montserrat_14, 0);
+    lv_obj_set_style_text_color(s_scan_text, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_bg_color(s_scan_text, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_bg_opa(s_scan_text, LV_OPA_60, 0);
+    lv_obj_set_style_pad_all(s_scan_text, 4, 0);
+    lv_obj_align(s_scan_text, LV_ALIGN_BOTTOM_MID, 0, -4);
+    lv_label_set_text_static(s_scan_text, "");
+
+    /* 这一次从出帧到解出来 */
+    s_scan_cost = lv_label_create(root);
+    lv_obj_set_style_text_font(s_scan_cost, &lv_font_montserrat_14, 0);
+    lv_obj_set_style_text_color(s_scan_cost, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_bg_color(s_scan_cost, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_bg_opa(s_scan_cost, LV_OPA_60, 0);
+    lv_obj_align(s_scan_cost, LV_ALIGN_TOP_RIGHT, -4, 4);
+    lv_label_set_text_static(s_scan_cost, "");
+}
+
+static void scan_evicted(void)
+{
+    s_scan_img = NULL;
+    s_scan_text = NULL;
+    s_scan_cost = NULL;
+}
+
+static const ui_screen_desc_t s_scan_screen = {
+    .name = "scan",
+    .bg_color = 0x000000,
+    .res = APP_RES_BIT(APP_RES_CAMERA),
+    .psram_kb = 768, // 两块预览 帧缓冲和quirc的图像
+    .build = scan_build,
+    .evicted = scan_evicted,
+};
+
+static void scan_event_handler(lv_event_t *e)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        s_view[i] = heap_caps_calloc(1, SCAN_W * SCAN_H * 2, MALLOC_CAP_SPIRAM);
+    }
+    if (!s_view[0] || !s_view[1])
+    {
+        ESP_LOGE(TAG, "no memory for preview");
+        heap_caps_free(s_view[0]);
+        heap_caps_free(s_view[1]);
+        s_view[0] = s_view[1] = NULL;
+        return;
+    }
+    app_camera_res_mode(BSP_CAMERA_GRAY);
+    icon_in_obj = ui_screen_enter(10, &s_scan_screen);
+    lv_label_set_text_static(s_scan_text, "");
+    lv_label_set_text_static(s_scan_cost, "");
+    s_swap_pending = false;
+    s_result_shown = true;
+    idle_mgr_inhibit(true);
+    pm_ctl_set(PM_CLIENT_CAMERA, true);
+    icon_flag = 10;
+    task_plan_create(TASK_SCAN_VIEW, task_scan_view, NULL, NULL);
+}
+
+static void scan_init(void)
+{
+    scan_lut_init();
+}
+
+const app_mod_t app_mod_scan = {
+    .name = "scan",
+    .id = 10,
+    .color = SCAN_COLOR,
+    .symbol = LV_SYMBOL_EYE_OPEN,
+    .init = scan_init,
+    .open = scan_event_handler,
+    .back = btn_scan_back_cb,
+};
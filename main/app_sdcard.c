@@ -0,0 +1,1462 @@
+#include "app_mod.h"
+#include "task_plan.h"
+#include "ui_vlist.h"
+#include "ui_perf.h"
+#include "ui_msg.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "ui_gif.h"
+#include "ui_avi.h"
+#include "ui_zoom.h"
+#include "sd_fs.h"
+#include "sd_dir_cache.h"
+#include "media_type.h"
+#include "sd_sort.h"
+#include "media_lib.h"
+#include "media_search.h"
+#include "sd_job.h"
+#include "ff.h"
+#include "esp32_s3_szp.h"
+#include "boot.h"
+#include <sys/stat.h>
+#include <time.h>
+
+static const char *TAG = "app_sdcard";
+
+/******************************** 第3个图标 SD卡 应用程序***************************************************************************/
+lv_obj_t *sdcard_title;     // SD卡页面标题背景
+lv_obj_t *sdcard_label;     // SD卡页面标题
+lv_obj_t *sdcard_file_list; // SD卡文件列表
+
+extern sdmmc_card_t *sdmmc_card;
+static void image_view_back(void);
+static void gif_view_back(void);
+static bool sd_ops_back(void);
+static void sd_bar_update(void);
+static bool sd_search_back(void);
+static void sd_search_run(void);
+struct file_path_info
+{
+    uint8_t path_index;  // 在第几级目录
+    char path_now[512];  // 当前文件路径
+    char path_back[512]; // 上级文件路径
+};
+struct file_path_info file_path_info;
+
+// 函数声明
+esp_err_t list_sdcard_files(char *path);
+static void file_list_select_cb(lv_obj_t *list, int index);
+
+// 返回主界面按钮事件处理函数
+static void btn_sdback_cb(lv_event_t *e)
+{
+    //图片查看模式下返回文件列表替换原本的文件返回
+
+    /* 检查是否在图片查看模式 */
+    lv_obj_t *img_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
+    if (img_container != NULL) {
+        /* 在图片查看模式，返回文件列表 */
+        image_view_back();
+        return;
+    }
+    lv_obj_t *gif_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
+    if (gif_container != NULL) {
+        /* 在GIF查看模式，返回文件列表 */
+        gif_view_back();
+        return;
+    }
+    if (sd_ops_back())
+    {
+        return; // 先关改名面板 退出多选
+    }
+    
+    if (file_path_info.path_index == 0)
+    { // 如果当前是根目录
+        // 保持SD卡全局挂载，不在此卸载
+        ui_screen_leave(3); // 回到主界面
+        icon_flag = 0;
+    }
+    else
+    {
+        ui_vlist_set_count(sdcard_file_list, 0);                     // 清除当前列表
+        esp_err_t ret = list_sdcard_files(file_path_info.path_back); // 列出上一级目录文件
+        if (ret == ESP_OK)
+        {                                                              // 如果成功列出目录
+            strcpy(file_path_info.path_now, file_path_info.path_back); // 刚刚进入的这个目录路径 变成当前路径
+            file_path_info.path_index--;                               // 目录级数索引退一级
+            // 计算再向下退一级的目录路径
+            char *slash = strrchr(file_path_info.path_back, '/'); // 从后往前查找字符'/'
+            if (slash != NULL)
+            {                  // 如果查找到
+                *slash = '\0'; // 替换为NULL 表示字符串结束
+            }
+            ESP_LOGI(TAG, "path_index: %d", file_path_info.path_index);
+            ESP_LOGI(TAG, "path_now: %s", file_path_info.path_now);
+            ESP_LOGI(TAG, "path_back: %s", file_path_info.path_back);
+        }
+    }
+}
+
+#define SD_LIST_ROW_H           40  // 文件列表的行高 图标是24号字
+#define SD_LIST_FIRST_BATCH     8   // 第一批凑够一屏就发 马上能看到东西
+#define SD_LIST_BATCH           64  // 之后每批这么多条
+
+// 读出来的目录项 记录格式和目录缓存的一样 见sd_dir_cache.h
+typedef struct
+{
+    char *names;
+    size_t size;
+    size_t used;
+} sd_names_t;
+
+// 后台任务读出来的一批 first的那批让列表清空重来
+typedef struct
+{
+    uint32_t gen;
+    bool first;
+    sd_names_t names;
+} sd_list_batch_t;
+
+// 文件列表显示的目录 列表只有几行对象 滚到哪一项就从这里取 只在LVGL任务里访问
+typedef struct
+{
+    uint32_t gen;
+    sd_names_t names;
+    uint32_t *offs; // 每一项在names里的位置
+    size_t indexed; // names里前面这么多字节已经建了索引
+    int count;
+    int cap;
+    sd_sort_key_t *keys; // 名字的排序键 和offs一一对应
+    uint32_t *view;      // 排序或者筛选以后 列表第i行是第view[i]项
+    int keyed;           // 前面这么多项已经算了键
+    int shown;           // 列表里的行数
+    bool sorted;         // view有效 否则按卡上的顺序直接显示
+    uint8_t *marks;      // 多选选中的项 和offs一一对应
+    int marked;
+} sd_list_model_t;
+
+typedef struct
+{
+    uint32_t gen;
+    char path[512];
+} sd_list_req_t;
+
+static sd_list_model_t s_sd_model;
+static sd_sort_mode_t s_sd_sort = SD_SORT_FAT;
+static bool s_sd_media_only = false;
+static lv_obj_t *s_sd_sort_label = NULL;
+static QueueHandle_t s_sd_list_queue = NULL;
+static volatile uint32_t s_sd_list_gen = 0; // 每列一个目录加一 后台任务和LVGL任务看到不一样就扔掉手上的
+static bool s_sd_searching = false;         // 列表显示的是搜索结果 不是path_now
+
+static bool sd_names_append(sd_names_t *n, const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+    if (n->used + len > n->size)
+    {
+        size_t size = n->size ? n->size * 2 : 1024;
+        while (size < n->used + len)
+        {
+            size *= 2;
+        }
+        char *p = realloc(n->names, size);
+        if (p == NULL)
+        {
+            return false;
+        }
+        n->names = p;
+        n->size = size;
+    }
+    memcpy(n->names + n->used, data, len);
+    n->used += len;
+    return true;
+}
+
+static bool sd_names_add(sd_names_t *n, int type, uint32_t size, uint32_t mtime, const char *name)
+{
+    char buf[SD_DIR_REC_HDR + 256];
+    size_t len = strlcpy(buf + SD_DIR_REC_HDR, name, sizeof(buf) - SD_DIR_REC_HDR) + SD_DIR_REC_HDR + 1;
+    buf[0] = (char)type;
+    for (int i = 0; i < 4; i++)
+    {
+        buf[1 + i] = size >> (8 * i);
+        buf[5 + i] = mtime >> (8 * i);
+    }
+    return sd_names_append(n, buf, LV_MIN(len, sizeof(buf)));
+}
+
+// 列表第index行是第几项
+static int sd_model_item(int index)
+{
+    return s_sd_model.sorted ? (int)s_sd_model.view[index] : index;
+}
+
+// 列表第index行的记录
+static const char *sd_model_rec(int index)
+{
+    return s_sd_model.names.names + s_sd_model.offs[sd_model_item(index)];
+}
+
+static const char *sd_model_name(int index)
+{
+    return sd_dir_rec_name(sd_model_rec(index));
+}
+
+static int sd_model_type(int index)
+{
+    return sd_dir_rec_type(sd_model_rec(index));
+}
+
+static void sd_model_free(void)
+{
+    free(s_sd_model.names.names);
+    free(s_sd_model.offs);
+    free(s_sd_model.keys);
+    free(s_sd_model.view);
+    free(s_sd_model.marks);
+    memset(&s_sd_model, 0, sizeof(s_sd_model));
+}
+
+static void sd_list_text(int index, char *buf, size_t len)
+{
+    strlcpy(buf, sd_model_name(index), len);
+}
+
+static const char *sd_list_icon(int index)
+{
+    static const char *const symbols[] = {
+        LV_SYMBOL_FILE, LV_SYMBOL_AUDIO, LV_SYMBOL_VIDEO, LV_SYMBOL_IMAGE, LV_SYMBOL_IMAGE, LV_SYMBOL_DIRECTORY,
+        LV_SYMBOL_LIST,
+    };
+    if (s_sd_model.marked && s_sd_model.marks[sd_model_item(index)])
+    {
+        return LV_SYMBOL_OK;
+    }
+    return symbols[sd_model_type(index)];
+}
+
+// 给新接上的记录建索引 滚动时按项号直接找到名字
+static bool sd_model_index(void)
+{
+    while (s_sd_model.indexed < s_sd_model.names.used)
+    {
+        if (s_sd_model.count == s_sd_model.cap)
+        {
+            int cap = s_sd_model.cap ? s_sd_model.cap * 2 : 256;
+            uint32_t *offs = realloc(s_sd_model.offs, cap * sizeof(uint32_t));
+            if (offs)
+            {
+                s_sd_model.offs = offs;
+            }
+            uint32_t *view = offs ? realloc(s_sd_model.view, cap * sizeof(uint32_t)) : NULL;
+            if (view)
+            {
+                s_sd_model.view = view;
+            }
+            sd_sort_key_t *keys = view ? realloc(s_sd_model.keys, cap * sizeof(sd_sort_key_t)) : NULL;
+            if (keys)
+            {
+                s_sd_model.keys = keys;
+            }
+            uint8_t *marks = keys ? realloc(s_sd_model.marks, cap) : NULL;
+            if (marks == NULL)
+            {
+                return false;
+            }
+            s_sd_model.marks = marks;
+            s_sd_model.cap = cap;
+        }
+        const char *rec = s_sd_model.names.names + s_sd_model.indexed;
+        s_sd_model.marks[s_sd_model.count] = 0;
+        s_sd_model.offs[s_sd_model.count++] = s_sd_model.indexed;
+        s_sd_model.indexed += SD_DIR_REC_HDR + strlen(sd_dir_rec_name(rec)) + 1;
+    }
+    return true;
+}
+
+// 按当前的排序和筛选重新排一遍 只动下标表 返回false表示是按卡上顺序追加的 列表不用整个重绑
+static bool sd_model_arrange(void)
+{
+    s_sd_model.sorted = s_sd_sort != SD_SORT_FAT || s_sd_media_only;
+    if (!s_sd_model.sorted)
+    {
+        s_sd_model.shown = s_sd_model.count;
+        return false;
+    }
+    int64_t t0 = esp_timer_get_time();
+    sd_sort_keys(s_sd_model.names.names, s_sd_model.offs, s_sd_model.keyed, s_sd_model.count, s_sd_model.keys);
+    s_sd_model.keyed = s_sd_model.count;
+    s_sd_model.shown = sd_sort_view(s_sd_model.names.names, s_sd_model.offs, s_sd_model.keys, s_sd_model.count,
+                                    s_sd_sort, s_sd_media_only, s_sd_model.view);
+    ESP_LOGD(TAG, "%d entries sorted by %s in %lld us", s_sd_model.count, sd_sort_mode_name(s_sd_sort),
+             esp_timer_get_time() - t0);
+    return true;
+}
+
+// 在LVGL任务里收一批 第一批换掉上一个目录 之后的接在后面 列表只重新绑定露出来的行
+static void sd_fill_batch(void *arg)
+{
+    sd_list_batch_t *batch = arg;
+    if (batch->gen != s_sd_list_gen || !lv_obj_is_valid(sdcard_file_list) ||
+        (!batch->first && s_sd_model.gen != batch->gen))
+    {
+        goto done; // 已经去列别的目录了 或者已经退出了SD卡应用
+    }
+    if (batch->first)
+    {
+        sd_model_free();
+        s_sd_model.gen = batch->gen;
+        s_sd_model.names = batch->names; // 第一批直接拿过来
+        batch->names.names = NULL;
+        ui_vlist_set_count(sdcard_file_list, 0);
+    }
+    else if (!sd_names_append(&s_sd_model.names, batch->names.names, batch->names.used))
+    {
+        ESP_LOGW(TAG, "out of memory, file list truncated");
+        goto done;
+    }
+    if (!sd_model_index())
+    {
+        ESP_LOGW(TAG, "out of memory, file list truncated");
+    }
+    if (sd_model_arrange())
+    {
+        ui_vlist_set_count(sdcard_file_list, s_sd_model.shown); // 新来的可能插在任何位置
+    }
+    else
+    {
+        ui_vlist_grow(sdcard_file_list, s_sd_model.shown);
+    }
+    if (batch->first)
+    {
+        sd_bar_update(); // 换了目录 选中的没了
+    }
+done:
+    free(batch->names.names);
+    free(batch);
+}
+
+static bool sd_list_post(sd_list_batch_t *batch)
+{
+    if (!ui_post_call(sd_fill_batch, batch))
+    {
+        free(batch->names.names);
+        free(batch);
+        return false;
+    }
+    return true;
+}
+
+// 后台读目录 一批一批交给LVGL任务 中途要列别的目录就扔掉这个 读完整个放进目录缓存
+static void sd_list_task(void *arg)
+{
+    static sd_list_req_t s_req;
+    static char s_fpath[sizeof(s_req.path) + 4];
+    static FF_DIR s_dir;
+    static FILINFO s_fno;
+    sd_list_req_t *req = &s_req;
+    for (;;)
+    {
+        xQueueReceive(s_sd_list_queue, req, portMAX_DELAY);
+        int64_t t0 = esp_timer_get_time();
+        int64_t t_first = 0;
+        uint32_t cache_gen = sd_dir_cache_gen();
+        if (!bsp_sdcard_fatfs_path(req->path, s_fpath, sizeof(s_fpath)) || f_opendir(&s_dir, s_fpath) != FR_OK)
+        {
+            ESP_LOGE(TAG, "Failed to open directory %s.", req->path);
+            continue;
+        }
+        uint32_t entries = 0;
+        bool first = true;
+        bool stale = false;
+        bool complete = false;
+        bool cacheable = true;
+        sd_names_t all = {0};           // 给目录缓存的整份
+        sd_list_batch_t *batch = NULL;
+        while (!stale)
+        {
+            if (batch == NULL)
+            {
+                batch = calloc(1, sizeof(sd_list_batch_t));
+                if (batch == NULL)
+                {
+                    break;
+                }
+                batch->gen = req->gen;
+            }
+            int count = 0;
+            int want = first ? SD_LIST_FIRST_BATCH : SD_LIST_BATCH;
+            bool end = false;
+            while (count < want)
+            { // 读取目录中的文件
+                if (f_readdir(&s_dir, &s_fno) != FR_OK || s_fno.fname[0] == '\0')
+                {
+                    end = true;
+                    break;
+                }
+                int file_type_flag;
+                if (s_fno.fattrib & AM_DIR)
+                { // 如果是文件夹
+                    file_type_flag = SD_DIR_TYPE_DIR;
+                }
+                else
+                { // 如果是常规文件 按扩展名显示图标
+                    file_type_flag = media_type_name(s_fno.fname);
+                }
+                if (!sd_names_add(&batch->names, file_type_flag, (uint32_t)s_fno.fsize,
+                                  (uint32_t)s_fno.fdate << 16 | s_fno.ftime, s_fno.fname))
+                {
+                    ESP_LOGW(TAG, "out of memory, list of %s truncated", req->path);
+                    end = true;
+                    cacheable = false; // 不完整 不放进缓存
+                    break;
+                }
+                count++;
+            }
+            stale = req->gen != s_sd_list_gen;
+            if (stale)
+            {
+                break;
+            }
+            entries += count;
+            batch->first = first;
+            if (cacheable && (all.used + batch->names.used > SD_DIR_CACHE_BUDGET ||
+                              !sd_names_append(&all, batch->names.names, batch->names.used)))
+            {
+                cacheable = false; // 比缓存预算还大 不缓存了
+                free(all.names);
+                memset(&all, 0, sizeof(all));
+            }
+            bool posted = sd_list_post(batch);
+            batch = NULL;
+            if (!posted || end)
+            {
+                complete = posted && end;
+                break;
+            }
+            if (first)
+            {
+                t_first = esp_timer_get_time();
+                first = false;
+            }
+        }
+        if (batch)
+        {
+            free(batch->names.names);
+            free(batch);
+        }
+        f_closedir(&s_dir);
+        if (complete && cacheable)
+        {
+            sd_dir_cache_put(req->path, cache_gen, all.names ? all.names : "", all.used);
+        }
+        free(all.names);
+        if (!stale)
+        {
+            ESP_LOGI(TAG, "%s: %lu entries, first screen after %lld ms, all in %lld ms", req->path,
+                     (unsigned long)entries, ((t_first ? t_first : esp_timer_get_time()) - t0) / 1000,
+                     (esp_timer_get_time() - t0) / 1000);
+        }
+    }
+}
+
+// 列出SD卡中的文件 目录缓存里有就直接用 否则只检查是不是目录就返回 读目录在后台任务里 读出一批就给LVGL任务加一批
+// 可以在后台任务里调用 也可以在LVGL的事件回调里调用 都不占LVGL锁
+esp_err_t list_sdcard_files(char *path)
+{
+    // 缓存里有的直接当成完整的一批交给LVGL任务 不碰SD卡
+    sd_list_batch_t *hit = calloc(1, sizeof(sd_list_batch_t));
+    // 目录缓存里没有 媒体库里有也一样 只是子目录都排在前面
+    if (hit && (sd_dir_cache_get(path, &hit->names.names, &hit->names.used) ||
+                media_lib_dir_recs(path, &hit->names.names, &hit->names.used)))
+    {
+        hit->names.size = hit->names.used;
+        hit->gen = ++s_sd_list_gen; // 后台还在读的旧目录作废
+        hit->first = true;
+        return sd_list_post(hit) ? ESP_OK : ESP_FAIL;
+    }
+    free(hit);
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+    {
+        ESP_LOGE(TAG, "Failed to open directory %s.", path);
+        return ESP_FAIL;
+    }
+    if (s_sd_list_queue == NULL)
+    {
+        s_sd_list_queue = xQueueCreate(1, sizeof(sd_list_req_t));
+        if (s_sd_list_queue == NULL ||
+            task_plan_create(TASK_SD_LIST, sd_list_task, NULL, NULL) != pdPASS)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    // 队列只留最新的请求 还没开始读的旧目录直接被盖掉
+    sd_list_req_t req;
+    req.gen = ++s_sd_list_gen;
+    strlcpy(req.path, path, sizeof(req.path));
+    xQueueOverwrite(s_sd_list_queue, &req);
+    return ESP_OK;
+}
+
+//================================ 图片查看器 ===========================================
+static void image_viewer_ui(const char *filepath)
+{
+    /* 隐藏文件列表，在其位置显示图片 */
+    ui_lock(0);
+    if (sdcard_file_list) {
+        //用隐藏功能，退出时世界删除该flag和对象
+        lv_obj_add_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
+    }
+    
+    /* 创建图片显示容器 - 替换文件列表位置 */
+    lv_obj_t *img_container = lv_obj_create(icon_in_obj);
+    lv_obj_set_size(img_container, 320, 200);
+    lv_obj_align(img_container, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_border_width(img_container, 0, 0);
+    lv_obj_set_style_bg_color(img_container, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_pad_all(img_container, 0, 0);
+    lv_obj_clear_flag(img_container, LV_OBJ_FLAG_SCROLLABLE); // 拖动只给图片平移用
+    lv_obj_set_user_data(icon_in_obj, (void *)img_container);
+    
+    /* 创建图片对象 单指拖动 双指缩放 双击切换适应屏幕和1:1 */
+    lv_obj_t *img = ui_zoom_create(img_container, 320, 200, filepath);
+    lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
+    ui_unlock();
+}
+static void img_view_file(const char *filepath)
+{
+    if (!filepath || !*filepath)
+    {
+        ESP_LOGE(TAG, "imgview_file: invalid path");
+        return;
+    }
+    ESP_LOGE(TAG, "imgview_file: %s", filepath);
+    image_viewer_ui(filepath); // 隐藏文件列表并显示图片
+}
+
+/* 返回文件列表视图 */
+static void image_view_back(void)
+{
+    ui_lock(0);
+    /* 获取并删除图片容器 */
+    lv_obj_t *img_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
+    if (img_container) {
+        lv_obj_del(img_container);
+        lv_obj_set_user_data(icon_in_obj, NULL);
+    }
+    /* 显示文件列表 */
+    if (sdcard_file_list) {
+        lv_obj_clear_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
+    }
+    ui_unlock();
+}
+//================================ ======== ===========================================
+//================================ GIF查看器 ===========================================
+
+static void gif_viewer_ui(const char *filepath)
+{
+    /* 隐藏文件列表，在其位置显示图片 */
+    ui_lock(0);
+    if (sdcard_file_list) {
+        //用隐藏功能，退出时世界删除该flag和对象
+        lv_obj_add_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
+    }
+    
+    /* 创建图片显示容器 - 替换文件列表位置 */
+    lv_obj_t *gif_container = lv_obj_create(icon_in_obj);
+    lv_obj_set_size(gif_container, 320, 200);
+    lv_obj_align(gif_container, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_border_width(gif_container, 0, 0);
+    lv_obj_set_style_bg_color(gif_container, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_pad_all(gif_container, 0, 0);
+    lv_obj_set_user_data(icon_in_obj, (void *)gif_container);
+    
+    /* 创建图片对象 */
+    lv_obj_t *gif = ui_gif_create(gif_container);
+    //后面用的
+    ui_gif_set_src(gif, filepath);
+    lv_obj_align(gif, LV_ALIGN_CENTER, 0, 0);
+    ui_unlock();
+}
+static void gif_view_file(const char *filepath)
+{
+    if (!filepath || !*filepath)
+    {
+        ESP_LOGE(TAG, "gifview_file: invalid path");
+        return;
+    }
+    ESP_LOGE(TAG, "gifview_file: %s", filepath);
+    gif_viewer_ui(filepath); // 隐藏文件列表并显示图片
+}
+
+/* 返回文件列表视图 */
+static void gif_view_back(void)
+{
+    ui_lock(0);
+    /* 获取并删除图片容器 */
+    lv_obj_t *gif_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
+    if (gif_container) {
+        lv_obj_del(gif_container);
+        lv_obj_set_user_data(icon_in_obj, NULL);
+    }
+    /* 显示文件列表 */
+    if (sdcard_file_list) {
+        lv_obj_clear_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
+    }
+    ui_unlock();
+}
+//================================ ======= ===========================================
+//================================ 视频播放 ===========================================
+
+// 和图片一样放在替换文件列表的容器里 返回键走image_view_back删掉容器 控件删了播放任务自己退出
+static void video_view_file(const char *filepath)
+{
+    ui_lock(0);
+    if (sdcard_file_list) {
+        lv_obj_add_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
+    }
+    lv_obj_t *video_container = lv_obj_create(icon_in_obj);
+    lv_obj_set_size(video_container, 320, 200);
+    lv_obj_align(video_container, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_border_width(video_container, 0, 0);
+    lv_obj_set_style_radius(video_container, 0, 0);
+    lv_obj_set_style_bg_color(video_container, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_pad_all(video_container, 0, 0);
+    lv_obj_clear_flag(video_container, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_user_data(icon_in_obj, (void *)video_container);
+
+    lv_obj_t *video = ui_avi_create(video_container, 320, 200, filepath);
+    if (video) {
+        lv_obj_center(video);
+    } else {
+        lv_obj_t *label = lv_label_create(video_container);
+        lv_label_set_text(label, LV_SYMBOL_WARNING " not an MJPEG AVI");
+        lv_obj_set_style_text_color(label, lv_color_hex(0xffffff), 0);
+        lv_obj_center(label);
+    }
+    ui_unlock();
+}
+//================================ ======= ===========================================
+
+//================================ 文件操作 ===========================================
+// 长按一行进入多选 之后点一下就是选中/取消 底下出一条操作栏
+// 复制和剪切先记下选中的完整路径 到了目标目录点粘贴才交给sd_job 删除要确认 改名只对一项
+// 作业在后台任务里做 进度投递回来显示在操作栏 可以随时停
+
+#define SD_BAR_H                40
+
+typedef struct
+{
+    sd_job_op_t op;      // SD_JOB_COPY或者SD_JOB_MOVE
+    sd_names_t paths;    // 以0结尾的完整路径一个接一个
+    int count;
+} sd_clip_t;
+
+static sd_clip_t s_sd_clip;
+static lv_obj_t *s_sd_bar = NULL;
+static lv_obj_t *s_sd_bar_sel = NULL;   // 选中时的几个按键
+static lv_obj_t *s_sd_bar_paste = NULL;
+static lv_obj_t *s_sd_bar_label = NULL;
+static lv_obj_t *s_sd_bar_prog = NULL;
+static lv_obj_t *s_sd_bar_rename = NULL; // 只选了一项才显示
+static lv_obj_t *s_sd_rename = NULL;    // 改名的输入面板
+static int s_sd_jobs = 0;              // 交出去还没做完的作业 只在LVGL任务里动
+
+static void sd_marks_clear(void)
+{
+    if (s_sd_model.marked)
+    {
+        memset(s_sd_model.marks, 0, s_sd_model.count);
+        s_sd_model.marked = 0;
+        ui_vlist_refresh(sdcard_file_list);
+    }
+}
+
+static void sd_mark_toggle(int index)
+{
+    int item = sd_model_item(index);
+    s_sd_model.marks[item] ^= 1;
+    s_sd_model.marked += s_sd_model.marks[item] ? 1 : -1;
+    ui_vlist_refresh(sdcard_file_list);
+    sd_bar_update();
+}
+
+static void file_list_long_cb(lv_obj_t *list, int index)
+{
+    if (s_sd_searching)
+    {
+        return; // 结果散在各个目录 不做批量操作
+    }
+    sd_mark_toggle(index);
+}
+
+// 选中项的完整路径交给fn
+static void sd_marks_each(void (*fn)(const char *path, void *arg), void *arg)
+{
+    char path[sizeof(file_path_info.path_now) + 256];
+    for (int i = 0; i < s_sd_model.count; i++)
+    {
+        if (s_sd_model.marks[i])
+        {
+            snprintf(path, sizeof(path), "%s/%s", file_path_info.path_now,
+                     sd_dir_rec_name(s_sd_model.names.names + s_sd_model.offs[i]));
+            fn(path, arg);
+        }
+    }
+}
+
+// 作业做完 在LVGL任务里 重新列当前目录 目录缓存已经作废了
+static void sd_job_finished(void *arg)
+{
+    s_sd_jobs--;
+    if (icon_flag == 3 && lv_obj_is_valid(sdcard_file_list) && s_sd_searching)
+    {
+        sd_search_run();
+    }
+    else if (icon_flag == 3 && lv_obj_is_valid(sdcard_file_list))
+    {
+        list_sdcard_files(file_path_info.path_now);
+    }
+    sd_bar_update();
+}
+
+// 在作业任务里 只投递
+static void sd_job_progress_cb(const sd_job_progress_t *p, void *arg)
+{
+    lv_obj_t *label = s_sd_bar_label;
+    lv_obj_t *bar = s_sd_bar_prog;
+    if (p->finished)
+    {
+        if (label)
+        {
+            ui_post_text(label, "%s %s", sd_job_op_name(p->op),
+                         p->cancelled ? "stopped" : p->err != ESP_OK ? "failed" : "done");
+        }
+        ui_post_call(sd_job_finished, NULL);
+        return;
+    }
+    uint32_t pct = p->bytes ? (uint32_t)(p->bytes_done * 100 / p->bytes)
+                            : p->files ? p->files_done * 100 / p->files : 0;
+    if (label)
+    {
+        ui_post_text(label, "%s %lu/%lu", sd_job_op_name(p->op), (unsigned long)p->files_done,
+                     (unsigned long)p->files);
+    }
+    if (bar)
+    {
+        ui_post_bar(bar, 0, pct);
+    }
+}
+
+static void sd_job_start(sd_job_t *job)
+{
+    if (sd_job_submit(job, sd_job_progress_cb, NULL) == ESP_OK)
+    {
+        s_sd_jobs++;
+        sd_marks_clear();
+        if (s_sd_bar_label)
+        {
+            lv_label_set_text(s_sd_bar_label, "...");
+            lv_bar_set_value(s_sd_bar_prog, 0, LV_ANIM_OFF);
+        }
+    }
+    sd_bar_update();
+}
+
+static void sd_clip_add(const char *path, void *arg)
+{
+    if (sd_names_append(&s_sd_clip.paths, path, strlen(path) + 1))
+    {
+        s_sd_clip.count++;
+    }
+}
+
+static void sd_clip_take(sd_job_op_t op)
+{
+    free(s_sd_clip.paths.names);
+    memset(&s_sd_clip, 0, sizeof(s_sd_clip));
+    s_sd_clip.op = op;
+    sd_marks_each(sd_clip_add, NULL);
+    sd_marks_clear();
+    sd_bar_update();
+}
+
+static void sd_copy_btn_cb(lv_event_t *e)
+{
+    sd_clip_take(SD_JOB_COPY);
+}
+
+static void sd_cut_btn_cb(lv_event_t *e)
+{
+    sd_clip_take(SD_JOB_MOVE);
+}
+
+static void sd_paste_btn_cb(lv_event_t *e)
+{
+    sd_job_t *job = sd_job_new(s_sd_clip.op, file_path_info.path_now);
+    for (size_t off = 0; job && off < s_sd_clip.paths.used; off += strlen(s_sd_clip.paths.names + off) + 1)
+    {
+        sd_job_add(job, s_sd_clip.paths.names + off);
+    }
+    if (job)
+    {
+        sd_job_start(job);
+    }
+    // 剪切的粘贴一次就没了 复制的可以再贴
+    if (s_sd_clip.op == SD_JOB_MOVE)
+    {
+        free(s_sd_clip.paths.names);
+        memset(&s_sd_clip, 0, sizeof(s_sd_clip));
+        sd_bar_update();
+    }
+}
+
+static void sd_job_add_cb(const char *path, void *arg)
+{
+    sd_job_add(arg, path);
+}
+
+static void sd_delete_confirm_cb(lv_event_t *e)
+{
+    lv_obj_t *mbox = lv_event_get_current_target(e);
+    if (lv_msgbox_get_active_btn(mbox) == 0)
+    {
+        sd_job_t *job = sd_job_new(SD_JOB_DELETE, NULL);
+        if (job)
+        {
+            sd_marks_each(sd_job_add_cb, job);
+            sd_job_start(job);
+        }
+    }
+    lv_msgbox_close(mbox);
+}
+
+static void sd_delete_btn_cb(lv_event_t *e)
+{
+    static const char *btns[] = {"OK", "Cancel", ""};
+    char text[32];
+    lv_snprintf(text, sizeof(text), "Delete %d item(s)?", s_sd_model.marked);
+    lv_obj_t *mbox = lv_msgbox_create(NULL, LV_SYMBOL_TRASH, text, btns, false);
+    lv_obj_add_event_cb(mbox, sd_delete_confirm_cb, LV_EVENT_VALUE_CHANGED, NULL);
+    lv_obj_center(mbox);
+}
+
+static void sd_rename_close(void)
+{
+    if (s_sd_rename)
+    {
+        lv_obj_del(s_sd_rename);
+        s_sd_rename = NULL;
+    }
+}
+
+static void sd_rename_kb_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_READY)
+    {
+        lv_obj_t *ta = lv_keyboard_get_textarea(lv_event_get_target(e));
+        const char *name = lv_textarea_get_text(ta);
+        sd_job_t *job = name[0] ? sd_job_new(SD_JOB_RENAME, name) : NULL;
+        if (job)
+        {
+            sd_marks_each(sd_job_add_cb, job);
+            sd_job_start(job);
+        }
+    }
+    if (code == LV_EVENT_READY || code == LV_EVENT_CANCEL)
+    {
+        sd_rename_close();
+    }
+}
+
+// 盖在文件列表上 上面输入框 下面键盘 名字用选中那项的原名
+static void sd_rename_btn_cb(lv_event_t *e)
+{
+    if (s_sd_model.marked != 1 || s_sd_rename)
+    {
+        return;
+    }
+    const char *name = "";
+    for (int i = 0; i < s_sd_model.count; i++)
+    {
+        if (s_sd_model.marks[i])
+        {
+            name = sd_dir_rec_name(s_sd_model.names.names + s_sd_model.offs[i]);
+        }
+    }
+    s_sd_rename = lv_obj_create(icon_in_obj);
+    lv_obj_set_size(s_sd_rename, 320, 200);
+    lv_obj_align(s_sd_rename, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_pad_all(s_sd_rename, 0, 0);
+    lv_obj_set_style_border_width(s_sd_rename, 0, 0);
+    lv_obj_clear_flag(s_sd_rename, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_t *ta = lv_textarea_create(s_sd_rename);
+    lv_textarea_set_one_line(ta, true);
+    lv_textarea_set_max_length(ta, 128);
+    lv_textarea_set_text(ta, name);
+    lv_obj_set_width(ta, 310);
+    lv_obj_align(ta, LV_ALIGN_TOP_MID, 0, 4);
+    lv_obj_add_state(ta, LV_STATE_FOCUSED);
+    lv_obj_t *kb = lv_keyboard_create(s_sd_rename);
+    lv_obj_set_size(kb, 320, 150);
+    lv_obj_align(kb, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_keyboard_set_textarea(kb, ta);
+    lv_obj_add_event_cb(kb, sd_rename_kb_cb, LV_EVENT_ALL, NULL);
+}
+
+// 叉: 作业在跑就停掉 否则清掉选中和剪贴板
+static void sd_close_btn_cb(lv_event_t *e)
+{
+    if (s_sd_jobs > 0)
+    {
+        sd_job_cancel();
+        return;
+    }
+    sd_marks_clear();
+    free(s_sd_clip.paths.names);
+    memset(&s_sd_clip, 0, sizeof(s_sd_clip));
+    sd_bar_update();
+}
+
+static bool sd_ops_back(void)
+{
+    if (s_sd_rename)
+    {
+        sd_rename_close();
+        return true;
+    }
+    if (s_sd_model.marked)
+    {
+        sd_marks_clear();
+        sd_bar_update();
+        return true;
+    }
+    return sd_search_back();
+}
+
+static lv_obj_t *sd_bar_btn(lv_obj_t *parent, const char *symbol, lv_event_cb_t cb)
+{
+    lv_obj_t *btn = lv_btn_create(parent);
+    lv_obj_add_style(btn, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_set_size(btn, 52, SD_BAR_H - 6);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text_static(label, symbol);
+    lv_obj_add_style(label, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_set_style_text_font(label, &lv_font_montserrat_20, 0);
+    lv_obj_center(label);
+    return btn;
+}
+
+static lv_obj_t *sd_bar_row(lv_obj_t *parent)
+{
+    lv_obj_t *row = lv_obj_create(parent);
+    lv_obj_remove_style_all(row);
+    lv_obj_set_size(row, LV_SIZE_CONTENT, LV_PCT(100));
+    lv_obj_set_flex_flow(row, LV_FLEX_FLOW_ROW);
+    lv_obj_set_flex_align(row, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    lv_obj_set_style_pad_column(row, 4, 0);
+    return row;
+}
+
+// 文件列表下面的操作栏 和列表一起建
+static void sd_bar_create(void)
+{
+    s_sd_bar = lv_obj_create(icon_in_obj);
+    lv_obj_set_size(s_sd_bar, 320, SD_BAR_H);
+    lv_obj_align(s_sd_bar, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    lv_obj_set_style_radius(s_sd_bar, 0, 0);
+    lv_obj_set_style_border_width(s_sd_bar, 0, 0);
+    lv_obj_set_style_pad_hor(s_sd_bar, 4, 0);
+    lv_obj_set_style_pad_ver(s_sd_bar, 0, 0);
+    lv_obj_set_style_bg_color(s_sd_bar, lv_color_hex(0x008b8b), 0);
+    lv_obj_clear_flag(s_sd_bar, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_flex_flow(s_sd_bar, LV_FLEX_FLOW_ROW);
+    lv_obj_set_flex_align(s_sd_bar, LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+
+    s_sd_bar_sel = sd_bar_row(s_sd_bar);
+    sd_bar_btn(s_sd_bar_sel, LV_SYMBOL_COPY, sd_copy_btn_cb);
+    sd_bar_btn(s_sd_bar_sel, LV_SYMBOL_CUT, sd_cut_btn_cb);
+    sd_bar_btn(s_sd_bar_sel, LV_SYMBOL_TRASH, sd_delete_btn_cb);
+    s_sd_bar_rename = sd_bar_btn(s_sd_bar_sel, LV_SYMBOL_EDIT, sd_rename_btn_cb);
+    s_sd_bar_paste = sd_bar_btn(s_sd_bar, LV_SYMBOL_PASTE, sd_paste_btn_cb);
+
+    s_sd_bar_label = lv_label_create(s_sd_bar);
+    lv_obj_set_flex_grow(s_sd_bar_label, 1);
+    lv_obj_set_style_text_font(s_sd_bar_label, &lv_font_montserrat_14, 0);
+    lv_obj_set_style_text_color(s_sd_bar_label, lv_color_hex(0xffffff), 0);
+    lv_label_set_text(s_sd_bar_label, "");
+    s_sd_bar_prog = lv_bar_create(s_sd_bar);
+    lv_obj_set_size(s_sd_bar_prog, 90, 8);
+    lv_bar_set_range(s_sd_bar_prog, 0, 100);
+
+    sd_bar_btn(s_sd_bar, LV_SYMBOL_CLOSE, sd_close_btn_cb);
+    sd_bar_update();
+}
+
+static void sd_show(lv_obj_t *obj, bool show)
+{
+    if (show)
+    {
+        lv_obj_clear_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    }
+    else
+    {
+        lv_obj_add_flag(obj, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+// 按现在有没有选中 剪贴板 作业决定操作栏露不露 露什么 列表让出底下一条
+static void sd_bar_update(void)
+{
+    if (s_sd_bar == NULL || !lv_obj_is_valid(sdcard_file_list))
+    {
+        return;
+    }
+    bool sel = s_sd_model.marked > 0 && s_sd_jobs == 0;
+    bool paste = !sel && s_sd_clip.count > 0 && s_sd_jobs == 0;
+    bool show = sel || paste || s_sd_jobs > 0;
+    sd_show(s_sd_bar, show);
+    sd_show(s_sd_bar_sel, sel);
+    sd_show(s_sd_bar_rename, s_sd_model.marked == 1);
+    sd_show(s_sd_bar_paste, paste);
+    sd_show(s_sd_bar_label, !sel);
+    sd_show(s_sd_bar_prog, s_sd_jobs > 0);
+    if (paste)
+    {
+        lv_label_set_text_fmt(s_sd_bar_label, "%d %s", s_sd_clip.count,
+                              s_sd_clip.op == SD_JOB_MOVE ? "to move" : "to copy");
+    }
+    lv_coord_t h = show ? 200 - SD_BAR_H : 200;
+    if (lv_obj_get_height(sdcard_file_list) != h)
+    {
+        lv_obj_set_height(sdcard_file_list, h);
+        lv_obj_update_layout(sdcard_file_list);
+        ui_vlist_refresh(sdcard_file_list);
+    }
+}
+//================================ ======== ===========================================
+
+// 按类型打开一个文件 路径是/sdcard下的完整路径
+static void sd_open_file(const char *path, int cls)
+{
+    if (cls == MEDIA_TYPE_AUDIO || cls == MEDIA_TYPE_PLAYLIST)
+    {
+#if CONFIG_APP_MOD_MUSIC
+        if (cls == MEDIA_TYPE_PLAYLIST)
+        {
+            music_play_playlist(path);
+        }
+        else
+        {
+            music_play_file(path);
+        }
+#endif
+    }
+    else if (cls == MEDIA_TYPE_IMAGE)
+    {
+        ESP_LOGI(TAG, "Image file selected: %s", path);
+        /* 使用LVGL FS接口访问图片 */
+        char lv_img_path[140];
+        lv_snprintf(lv_img_path, sizeof(lv_img_path), SD_FS_DRIVE "%s", path);
+        img_view_file(lv_img_path); // 查看图片
+    }
+    else if (cls == MEDIA_TYPE_VIDEO)
+    {
+        ESP_LOGI(TAG, "Video file selected: %s", path);
+        video_view_file(path);
+    }
+    else if (cls == MEDIA_TYPE_GIF)
+    {
+        ESP_LOGI(TAG, "GIF file selected: %s", path);
+        char lv_gif_path[140];
+        lv_snprintf(lv_gif_path, sizeof(lv_gif_path), "A:%s", path);
+        gif_view_file(lv_gif_path);
+    }
+}
+
+//================================ 文件名搜索 ===========================================
+// 标题栏的Find打开 输入框盖在标题上 下面出键盘 每改一个字查一次媒体库的三元组索引(见media_search.h)
+// 结果是全卡的文件 借文件列表的模型显示 排序和筛选照样用 点一项按完整路径打开
+// 键盘的确定收起键盘看全部结果 点输入框再出来 返回键退出搜索回到原来的目录
+
+#define SD_SEARCH_MAX           500     // 再多也翻不过来 该多打几个字了
+#define SD_SEARCH_KB_H          120
+
+static lv_obj_t *s_sd_search_ta = NULL;
+static lv_obj_t *s_sd_search_kb = NULL;
+static lv_obj_t *s_sd_search_hint = NULL;
+static uint32_t *s_sd_found = NULL;     // 结果的文件编号 和模型里的项一一对应
+
+// 按输入框里的字重查 换掉模型 后台还在读的目录作废
+static void sd_search_run(void)
+{
+    if (s_sd_found == NULL)
+    {
+        s_sd_found = malloc(SD_SEARCH_MAX * sizeof(uint32_t));
+        if (s_sd_found == NULL)
+        {
+            return;
+        }
+    }
+    const char *q = lv_textarea_get_text(s_sd_search_ta);
+    int64_t t0 = esp_timer_get_time();
+    int n = q[0] ? media_search_query(q, s_sd_found, SD_SEARCH_MAX) : 0;
+    int64_t t1 = esp_timer_get_time();
+    sd_model_free();
+    s_sd_model.gen = ++s_sd_list_gen;
+    char rec[SD_DIR_REC_HDR + 256];
+    int kept = 0;
+    for (int i = 0; i < n; i++)
+    {
+        size_t len = media_lib_file_rec(s_sd_found[i], rec, sizeof(rec));
+        if (len && sd_names_append(&s_sd_model.names, rec, len))
+        {
+            s_sd_found[kept++] = s_sd_found[i];
+        }
+    }
+    sd_model_index();
+    sd_model_arrange();
+    ui_vlist_set_count(sdcard_file_list, 0); // 先清空 滚动位置回到顶上
+    ui_vlist_set_count(sdcard_file_list, s_sd_model.shown);
+    const char *hint = n < 0 ? "Indexing..." : q[0] && s_sd_model.shown == 0 ? "No match" : "";
+    lv_label_set_text_static(s_sd_search_hint, hint);
+    sd_show(s_sd_search_hint, hint[0] != '\0');
+    ESP_LOGD(TAG, "search \"%s\": %d hits, query %lld us, list %lld us", q, n, t1 - t0,
+             esp_timer_get_time() - t1);
+}
+
+static void sd_search_ta_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_VALUE_CHANGED)
+    {
+        sd_search_run();
+    }
+    else if (code == LV_EVENT_CLICKED)
+    {
+        sd_show(s_sd_search_kb, true);
+    }
+}
+
+static void sd_search_kb_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_READY || code == LV_EVENT_CANCEL)
+    {
+        sd_show(s_sd_search_kb, false);
+    }
+}
+
+static void sd_search_btn_cb(lv_event_t *e)
+{
+    if (s_sd_searching || s_sd_rename || s_sd_jobs > 0 || !lv_obj_is_valid(sdcard_file_list))
+    {
+        return;
+    }
+    sd_marks_clear();
+    sd_bar_update();
+    s_sd_searching = true;
+    sd_show(sdcard_label, false);
+
+    s_sd_search_ta = lv_textarea_create(sdcard_title);
+    lv_textarea_set_one_line(s_sd_search_ta, true);
+    lv_textarea_set_max_length(s_sd_search_ta, MEDIA_SEARCH_QUERY_MAX);
+    lv_textarea_set_placeholder_text(s_sd_search_ta, "Find");
+    lv_obj_set_size(s_sd_search_ta, 158, 36);
+    lv_obj_set_style_pad_ver(s_sd_search_ta, 6, 0);
+    lv_obj_set_style_text_font(s_sd_search_ta, &lv_font_montserrat_14, 0);
+    lv_obj_align(s_sd_search_ta, LV_ALIGN_LEFT_MID, 62, 0);
+    lv_obj_add_state(s_sd_search_ta, LV_STATE_FOCUSED);
+    lv_obj_add_event_cb(s_sd_search_ta, sd_search_ta_cb, LV_EVENT_ALL, NULL);
+
+    s_sd_search_hint = lv_label_create(icon_in_obj);
+    lv_obj_set_style_text_font(s_sd_search_hint, &lv_font_montserrat_14, 0);
+    lv_obj_set_style_text_color(s_sd_search_hint, lv_color_hex(0x808080), 0);
+    lv_obj_align(s_sd_search_hint, LV_ALIGN_TOP_MID, 0, 60);
+
+    s_sd_search_kb = lv_keyboard_create(icon_in_obj);
+    lv_obj_set_size(s_sd_search_kb, 320, SD_SEARCH_KB_H);
+    lv_obj_align(s_sd_search_kb, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_keyboard_set_textarea(s_sd_search_kb, s_sd_search_ta);
+    lv_obj_add_event_cb(s_sd_search_kb, sd_search_kb_cb, LV_EVENT_ALL, NULL);
+    sd_search_run();
+}
+
+// 返回键先退出搜索 列回原来的目录
+static bool sd_search_back(void)
+{
+    if (!s_sd_searching)
+    {
+        return false;
+    }
+    s_sd_searching = false;
+    lv_obj_del(s_sd_search_ta);
+    lv_obj_del(s_sd_search_kb);
+    lv_obj_del(s_sd_search_hint);
+    s_sd_search_ta = s_sd_search_kb = s_sd_search_hint = NULL;
+    free(s_sd_found);
+    s_sd_found = NULL;
+    sd_show(sdcard_label, true);
+    ui_vlist_set_count(sdcard_file_list, 0);
+    list_sdcard_files(file_path_info.path_now);
+    return true;
+}
+
+// 结果里点了一项 按编号拼回完整路径打开 媒体库刚换表的话编号可能已经对不上 重查一遍
+static void sd_search_open(int index)
+{
+    char path[sizeof(file_path_info.path_now)];
+    uint32_t id = s_sd_found[sd_model_item(index)];
+    if (!media_search_ready() || !media_lib_file_path(id, path, sizeof(path)))
+    {
+        sd_search_run();
+        return;
+    }
+    sd_show(s_sd_search_kb, false);
+    sd_open_file(path, sd_model_type(index));
+}
+//================================ ========== ===========================================
+
+// 文件点击 事件处理函数,点击列表项：进入子目录或保持原目录
+static void file_list_select_cb(lv_obj_t *list, int index)
+{
+    if (s_sd_model.marked)
+    {
+        sd_mark_toggle(index); // 多选时点一下是选中
+        return;
+    }
+    if (s_sd_searching)
+    {
+        sd_search_open(index);
+        return;
+    }
+    // 点的是第几项 文件名从列表的内容里取
+    const char *file_name = sd_model_name(index);
+    int cls = sd_model_type(index); // 目录和扩展名列目录时就分好了 不用再stat
+    ESP_LOGI(TAG, "file name: %s", file_name);
+    // 列出 SD 卡中的文件
+    strcpy(file_path_info.path_back, file_path_info.path_now); // 保存上一级目录
+    strcat(file_path_info.path_now, "/");
+    strcat(file_path_info.path_now, file_name);
+    if (cls != MEDIA_TYPE_OTHER)
+    { // 目录或者能打开的文件
+        if (cls == SD_DIR_TYPE_DIR)
+        {                                   // 如果是目录
+            ui_vlist_set_count(sdcard_file_list, 0); // 清除当前列表
+            // 列出子目录内容 并打印路径状态
+            esp_err_t ret = list_sdcard_files(file_path_info.path_now);
+            if (ret == ESP_OK)
+            {                                // 如果成功列出了目录
+                file_path_info.path_index++; // 表示进入到下一集目录
+                ESP_LOGI(TAG, "path_index: %d", file_path_info.path_index);
+                ESP_LOGI(TAG, "path_now: %s", file_path_info.path_now);
+                ESP_LOGI(TAG, "path_back: %s", file_path_info.path_back);
+            }
+            return;
+        }
+
+        sd_open_file(file_path_info.path_now, cls); // 打开文件不进目录 下面还原路径
+    }
+    // 如果没有成功进入目录
+    strcpy(file_path_info.path_now, file_path_info.path_back); // 没有列出新的列表 还原当前路径
+    // 还原再向下退一级的目录路径
+    char *slash = strrchr(file_path_info.path_back, '/'); // 从后往前查找字符'/'
+    if (slash != NULL)
+    {                  // 如果查找到
+        *slash = '\0'; // 替换为NULL 表示字符串结束
+    }
+    ESP_LOGI(TAG, "path_index: %d", file_path_info.path_index);
+    ESP_LOGI(TAG, "path_now: %s", file_path_info.path_now);
+    ESP_LOGI(TAG, "path_back: %s", file_path_info.path_back);
+}
+
+// 换了排序或者筛选 手上的记录重新排一遍回到顶上 不读卡
+static void sd_list_rearrange(void)
+{
+    if (!lv_obj_is_valid(sdcard_file_list))
+    {
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    sd_model_arrange();
+    ESP_LOGI(TAG, "file list: %d of %d entries by %s%s, %lld us", s_sd_model.shown, s_sd_model.count,
+             sd_sort_mode_name(s_sd_sort), s_sd_media_only ? ", media only" : "", esp_timer_get_time() - t0);
+    ui_vlist_set_count(sdcard_file_list, 0); // 先清空 滚动位置回到顶上
+    ui_vlist_set_count(sdcard_file_list, s_sd_model.shown);
+}
+
+static void sd_sort_btn_cb(lv_event_t *e)
+{
+    s_sd_sort = (s_sd_sort + 1) % SD_SORT_COUNT;
+    lv_label_set_text_static(s_sd_sort_label, sd_sort_mode_name(s_sd_sort));
+    sd_list_rearrange();
+}
+
+static void sd_filter_btn_cb(lv_event_t *e)
+{
+    s_sd_media_only = lv_obj_has_state(lv_event_get_target(e), LV_STATE_CHECKED);
+    sd_list_rearrange();
+}
+
+// 标题栏右边的小按键 样子和返回键一样 只是窄一点
+static lv_obj_t *sd_title_btn(lv_coord_t x, const char *text, lv_event_cb_t cb)
+{
+    lv_obj_t *btn = lv_btn_create(sdcard_title);
+    lv_obj_add_style(btn, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_set_width(btn, 50);
+    lv_obj_align(btn, LV_ALIGN_RIGHT_MID, x, 0);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text_static(label, text);
+    lv_obj_add_style(label, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_set_style_text_font(label, &lv_font_montserrat_14, 0);
+    lv_obj_set_style_text_color(label, lv_color_hex(0xffd700), LV_STATE_CHECKED);
+    lv_obj_center(label);
+    return btn;
+}
+
+// 创建SD卡应用的返回按钮和文件列表 在LVGL任务里执行
+static void sdcard_list_create(void *arg)
+{
+    if (icon_flag != 3 || sdcard_file_list != NULL)
+    {
+        return; // 缓存的界面里已经有了
+    }
+    // 创建返回按钮
+    lv_obj_t *btn_back = lv_btn_create(sdcard_title);
+    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_sdback_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
+
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    // 排序和只看媒体文件 都只重排手上的记录
+    lv_obj_t *btn_sort = sd_title_btn(-50, sd_sort_mode_name(s_sd_sort), sd_sort_btn_cb);
+    s_sd_sort_label = lv_obj_get_child(btn_sort, 0);
+    lv_obj_t *btn_filter = sd_title_btn(0, LV_SYMBOL_IMAGE, sd_filter_btn_cb);
+    sd_title_btn(-100, "Find", sd_search_btn_cb);
+    lv_obj_align(sdcard_label, LV_ALIGN_LEFT_MID, 62, 0); // 给右边三个按键让地方
+    lv_obj_add_flag(btn_filter, LV_OBJ_FLAG_CHECKABLE);
+    if (s_sd_media_only)
+    {
+        lv_obj_add_state(btn_filter, LV_STATE_CHECKED);
+    }
+
+    // 创建文件列表,全屏宽度、设置字号 只有几行对象 几千个文件的目录也不会多占内存
+    sdcard_file_list = ui_vlist_create(icon_in_obj, 320, 200, SD_LIST_ROW_H, sd_list_text, file_list_select_cb);
+    if (sdcard_file_list == NULL)
+    {
+        return;
+    }
+    lv_obj_align(sdcard_file_list, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_border_width(sdcard_file_list, 0, 0);
+    lv_obj_set_style_text_font(sdcard_file_list, &font_alipuhui20, 0);
+    ui_vlist_set_icons(sdcard_file_list, sd_list_icon, &lv_font_montserrat_24);
+    ui_vlist_set_long_press_cb(sdcard_file_list, file_list_long_cb);
+    sd_bar_create();
+}
+
+static void sdcard_exit(void *arg)
+{
+    ui_screen_leave(3);
+    icon_flag = 0;
+}
+
+// SD卡处理任务--后台任务：等待挂载、显示容量、构建文件列表）
+static void task_process_sdcard(void *arg)
+{
+    // 等开机的SD卡挂载阶段结束 不再直接看sdmmc_card
+    boot_wait(BOOT_BIT(BOOT_STAGE_SD), BOOT_SD_WAIT_MS);
+    if (!bsp_sdcard_mounted())
+    { // 如果没有挂载成功 开机后拔插过的话看现在的状态
+        ESP_LOGE(TAG, "SD card is not mounted.");
+        ui_post_text(sdcard_label, "SD卡未挂载");
+        vTaskDelay(1000 / portTICK_PERIOD_MS); // 给上面一点显示的时间
+        ui_post_call(sdcard_exit, NULL);
+    }
+    else
+    { // 已挂载
+        // 终端显示SD卡信息
+        sdmmc_card_print_info(stdout, sdmmc_card);
+        // 液晶屏标题栏显示SD卡容量
+        ui_post_text(sdcard_label, "SD: %lluGB",
+                     (((uint64_t)sdmmc_card->csd.capacity) * sdmmc_card->csd.sector_size) >> 30);
+        ui_post_call(sdcard_list_create, NULL);
+        // 列出 SD 卡中的文件 列表行也是投递过去的 排在上面的创建之后
+        file_path_info.path_index = 0;                   // 表示当前在根目录
+        strcpy(file_path_info.path_now, SD_MOUNT_POINT); // 装入当前路径
+        list_sdcard_files(file_path_info.path_now);      // 列出当前目录文件
+    }
+
+    vTaskDelete(NULL);
+}
+
+// 标题栏 返回键和文件列表要等SD卡挂载后由sdcard_list_create创建
+static void sdcard_build(lv_obj_t *root)
+{
+    // 创建标题背景
+    sdcard_title = lv_obj_create(root);
+    lv_obj_add_style(sdcard_title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(sdcard_title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(sdcard_title, lv_color_hex(0x008b8b), 0);
+    // 显示标题
+    sdcard_label = lv_label_create(sdcard_title);
+    lv_obj_set_style_text_color(sdcard_label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(sdcard_label, &font_alipuhui20, 0);
+    lv_obj_align(sdcard_label, LV_ALIGN_CENTER, 0, 0);
+}
+
+static void sdcard_enter(lv_obj_t *root)
+{
+    lv_label_set_text(sdcard_label, "TF卡扫描中...");
+}
+
+static void sdcard_evicted(void)
+{
+    sdcard_title = NULL;
+    sdcard_label = NULL;
+    sdcard_file_list = NULL;
+    s_sd_sort_label = NULL;
+    s_sd_bar = s_sd_bar_sel = s_sd_bar_paste = s_sd_bar_label = s_sd_bar_prog = s_sd_bar_rename = NULL;
+    s_sd_rename = NULL;
+    s_sd_search_ta = s_sd_search_kb = s_sd_search_hint = NULL;
+    s_sd_searching = false;
+    free(s_sd_found);
+    s_sd_found = NULL;
+    sd_model_free();
+}
+
+static const ui_screen_desc_t s_sdcard_screen = {
+    .name = "sdcard",
+    .bg_color = 0xffffff,
+    .build = sdcard_build,
+    .enter = sdcard_enter,
+    .evicted = sdcard_evicted,
+};
+
+// 进入SD卡应用程序,进入应用时的 UI 场景搭建与任务启动
+static void sdcard_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(3, &s_sdcard_screen);
+    icon_flag = 3; // 标记已经进入第三个应用
+    // 启动后台任务 task_process_sdcard
+    task_plan_create(TASK_SD_BROWSE, task_process_sdcard, NULL, NULL);
+}
+
+const app_mod_t app_mod_sdcard = {
+    .name = "sdcard",
+    .id = 3,
+    .color = 0x008b8b,
+    .icon = "img_sd_icon",
+    .open = sdcard_event_handler,
+    .back = btn_sdback_cb,
+};
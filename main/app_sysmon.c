@@ -0,0 +1,70 @@
+#include "app_mod.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "ui_sysmon.h"
+
+/******************************** 第8个图标 系统监视 应用程序***********************************************************************************/
+static void btn_sysmon_back_cb(lv_event_t *e)
+{
+    ui_screen_leave(8);
+    icon_flag = 0;
+}
+
+static void sysmon_build(lv_obj_t *root)
+{
+    lv_obj_t *title = lv_obj_create(root);
+    lv_obj_add_style(title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(title, lv_color_hex(0x607d8b), 0);
+    lv_obj_t *label = lv_label_create(title);
+    lv_label_set_text(label, "系统监视");
+    lv_obj_set_style_text_color(label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
+
+    lv_obj_t *btn_back = lv_btn_create(title);
+    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_sysmon_back_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT);
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    ui_sysmon_build(root);
+}
+
+static void sysmon_enter(lv_obj_t *root)
+{
+    ui_sysmon_start();
+}
+
+static void sysmon_leave(lv_obj_t *root)
+{
+    ui_sysmon_stop();
+}
+
+static const ui_screen_desc_t s_sysmon_screen = {
+    .name = "sysmon",
+    .bg_color = 0xffffff,
+    .build = sysmon_build,
+    .enter = sysmon_enter,
+    .leave = sysmon_leave,
+    .evicted = ui_sysmon_evicted,
+};
+
+static void sysmon_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(8, &s_sysmon_screen);
+    icon_flag = 8;
+}
+
+// 没有图片 用符号
+const app_mod_t app_mod_sysmon = {
+    .name = "sysmon",
+    .id = 8,
+    .color = 0x607d8b,
+    .symbol = LV_SYMBOL_SETTINGS,
+    .open = sysmon_event_handler,
+    .back = btn_sysmon_back_cb,
+};
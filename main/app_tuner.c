@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include "app_mod.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "audio_tuner.h"
+#include "esp_rom_sys.h"
+
+/******************************** 第9个图标 调音器 应用程序***********************************************************************************/
+#define TUNER_SPEC_W        (TUNER_BANDS * 9)
+#define TUNER_SPEC_H        70
+#define TUNER_IN_TUNE       5           // 音分在这以内算准 条变绿
+
+static lv_obj_t *s_note_label = NULL;
+static lv_obj_t *s_freq_label = NULL;
+static lv_obj_t *s_cents_bar = NULL;
+static lv_obj_t *s_level_bar = NULL;
+static lv_obj_t *s_level_label = NULL;
+static lv_obj_t *s_cost_label = NULL;
+static lv_obj_t *s_spec_bars[TUNER_BANDS];
+static lv_timer_t *s_tuner_timer = NULL;
+static tuner_result_t s_shown;
+
+static void btn_tuner_back_cb(lv_event_t *e)
+{
+    ui_screen_leave(9);
+    icon_flag = 0;
+}
+
+static void tuner_show_cost(void)
+{
+    tuner_stats_t st;
+    audio_tuner_get_stats(&st);
+    uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+    lv_label_set_text_fmt(s_cost_label, "block %lu us (fft %lu, yin %lu) max %lu us  load %lu.%lu%%",
+                          (unsigned long)(st.cycles_avg / mhz), (unsigned long)(st.fft_cycles_avg / mhz),
+                          (unsigned long)(st.yin_cycles_avg / mhz), (unsigned long)(st.cycles_max / mhz),
+                          (unsigned long)(st.load_permille / 10), (unsigned long)(st.load_permille % 10));
+}
+
+// 只在有新的一块时改控件 频谱高度没变的不碰 免得整块重画
+static void tuner_timer_cb(lv_timer_t *timer)
+{
+    if (!audio_tuner_get(&s_shown))
+    {
+        return;
+    }
+    const tuner_result_t *r = &s_shown;
+    if (r->voiced)
+    {
+        lv_label_set_text_fmt(s_note_label, "%s%d", audio_tuner_note_name(r->note), r->note / 12 - 1);
+        int dhz = (int)(r->f0 * 10.0f + 0.5f);
+        lv_label_set_text_fmt(s_freq_label, "%d.%d Hz  %+d cents", dhz / 10, dhz % 10, r->cents);
+        lv_bar_set_value(s_cents_bar, r->cents, LV_ANIM_OFF);
+        int c = r->cents < 0 ? -r->cents : r->cents;
+        lv_obj_set_style_bg_color(s_cents_bar, lv_color_hex(c <= TUNER_IN_TUNE ? 0x30a830 : 0xe67e22), LV_PART_INDICATOR);
+    }
+    else
+    {
+        lv_label_set_text_static(s_note_label, "--");
+        lv_label_set_text_static(s_freq_label, "");
+        lv_bar_set_value(s_cents_bar, 0, LV_ANIM_OFF);
+    }
+
+    lv_bar_set_value(s_level_bar, TUNER_RANGE_DB + r->rms_cdb / 100, LV_ANIM_OFF);
+    int rms = -r->rms_cdb / 10, hold = -r->hold_cdb / 10; // 都不大于0 按正的十分之一dB拆
+    lv_label_set_text_fmt(s_level_label, "RMS -%d.%d dB  peak -%d.%d dB", rms / 10, rms % 10, hold / 10, hold % 10);
+
+    for (int b = 0; b < TUNER_BANDS; b++)
+    {
+        lv_coord_t h = 1 + (TUNER_RANGE_DB + r->bands[b]) * (TUNER_SPEC_H - 1) / TUNER_RANGE_DB;
+        if (lv_obj_get_height(s_spec_bars[b]) != h)
+        {
+            lv_obj_set_height(s_spec_bars[b], h);
+        }
+    }
+    tuner_show_cost();
+}
+
+static void tuner_build(lv_obj_t *root)
+{
+    lv_obj_t *title = lv_obj_create(root);
+    lv_obj_add_style(title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(title, lv_color_hex(0xe67e22), 0);
+    lv_obj_t *label = lv_label_create(title);
+    lv_label_set_text(label, "调音器");
+    lv_obj_set_style_text_color(label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
+
+    lv_obj_t *btn_back = lv_btn_create(title);
+    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_tuner_back_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT);
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    /* 音名 频率和音分 */
+    s_note_label = lv_label_create(root);
+    lv_obj_set_style_text_font(s_note_label, &lv_font_montserrat_24, 0);
+    lv_obj_align(s_note_label, LV_ALIGN_TOP_LEFT, 14, 46);
+    lv_label_set_text_static(s_note_label, "--");
+    s_freq_label = lv_label_create(root);
+    lv_obj_set_style_text_font(s_freq_label, &lv_font_montserrat_20, 0);
+    lv_obj_align(s_freq_label, LV_ALIGN_TOP_LEFT, 90, 48);
+    lv_label_set_text_static(s_freq_label, "");
+
+    /* 偏差条 中间是准 */
+    s_cents_bar = lv_bar_create(root);
+    lv_obj_set_size(s_cents_bar, 292, 12);
+    lv_obj_align(s_cents_bar, LV_ALIGN_TOP_MID, 0, 80);
+    lv_bar_set_mode(s_cents_bar, LV_BAR_MODE_SYMMETRICAL);
+    lv_bar_set_range(s_cents_bar, -50, 50);
+    lv_bar_set_value(s_cents_bar, 0, LV_ANIM_OFF);
+    lv_obj_t *mark = lv_obj_create(root);
+    lv_obj_set_size(mark, 2, 18);
+    lv_obj_align(mark, LV_ALIGN_TOP_MID, 0, 77);
+    lv_obj_set_style_border_width(mark, 0, 0);
+    lv_obj_set_style_radius(mark, 0, 0);
+    lv_obj_set_style_bg_color(mark, lv_color_hex(0x000000), 0);
+    lv_obj_clear_flag(mark, LV_OBJ_FLAG_CLICKABLE);
+
+    /* 电平 条是RMS 峰值保持在下面的文字里 */
+    s_level_bar = lv_bar_create(root);
+    lv_obj_set_size(s_level_bar, 292, 8);
+    lv_obj_align(s_level_bar, LV_ALIGN_TOP_MID, 0, 102);
+    lv_bar_set_range(s_level_bar, 0, TUNER_RANGE_DB);
+    lv_obj_set_style_bg_color(s_level_bar, lv_color_hex(0x2196f3), LV_PART_INDICATOR);
+    s_level_label = lv_label_create(root);
+    lv_obj_set_style_text_font(s_level_label, &lv_font_montserrat_14, 0);
+    lv_obj_align(s_level_label, LV_ALIGN_TOP_LEFT, 14, 112);
+    lv_label_set_text_static(s_level_label, "");
+
+    /* 频谱 */
+    lv_obj_t *spec = lv_obj_create(root);
+    lv_obj_set_size(spec, TUNER_SPEC_W, TUNER_SPEC_H);
+    lv_obj_align(spec, LV_ALIGN_TOP_MID, 0, 134);
+    lv_obj_set_style_pad_all(spec, 0, 0);
+    lv_obj_set_style_border_width(spec, 0, 0);
+    lv_obj_set_style_bg_opa(spec, LV_OPA_TRANSP, 0);
+    lv_obj_clear_flag(spec, LV_OBJ_FLAG_SCROLLABLE | LV_OBJ_FLAG_CLICKABLE);
+    for (int b = 0; b < TUNER_BANDS; b++)
+    {
+        s_spec_bars[b] = lv_obj_create(spec);
+        lv_obj_set_size(s_spec_bars[b], TUNER_SPEC_W / TUNER_BANDS - 2, 1);
+        lv_obj_align(s_spec_bars[b], LV_ALIGN_BOTTOM_LEFT, b * (TUNER_SPEC_W / TUNER_BANDS) + 1, 0);
+        lv_obj_set_style_radius(s_spec_bars[b], 0, 0);
+        lv_obj_set_style_border_width(s_spec_bars[b], 0, 0);
+        lv_obj_set_style_bg_color(s_spec_bars[b], lv_color_hex(0xe67e22), 0);
+        lv_obj_clear_flag(s_spec_bars[b], LV_OBJ_FLAG_CLICKABLE);
+    }
+
+    /* 每块分析的耗时 */
+    s_cost_label = lv_label_create(root);
+    lv_obj_set_style_text_font(s_cost_label, &lv_font_montserrat_14, 0);
+    lv_obj_set_style_text_color(s_cost_label, lv_color_hex(0x808080), 0);
+    lv_obj_align(s_cost_label, LV_ALIGN_BOTTOM_MID, 0, -6);
+    lv_label_set_text_static(s_cost_label, "");
+}
+
+// 进来接上麦克风 录音占着时在频率那里提示 界面照样打开
+static void tuner_enter(lv_obj_t *root)
+{
+    s_shown.seq = 0;
+    if (audio_tuner_start() != ESP_OK)
+    {
+        lv_label_set_text_static(s_freq_label, "mic busy");
+        return;
+    }
+    s_tuner_timer = lv_timer_create(tuner_timer_cb, TUNER_UI_PERIOD_MS, NULL);
+}
+
+static void tuner_leave(lv_obj_t *root)
+{
+    if (s_tuner_timer)
+    {
+        lv_timer_del(s_tuner_timer);
+        s_tuner_timer = NULL;
+    }
+    audio_tuner_stop();
+}
+
+static void tuner_evicted(void)
+{
+    s_note_label = NULL;
+    s_freq_label = NULL;
+    s_cents_bar = NULL;
+    s_level_bar = NULL;
+    s_level_label = NULL;
+    s_cost_label = NULL;
+}
+
+static const ui_screen_desc_t s_tuner_screen = {
+    .name = "tuner",
+    .bg_color = 0xffffff,
+    .build = tuner_build,
+    .enter = tuner_enter,
+    .leave = tuner_leave,
+    .evicted = tuner_evicted,
+};
+
+static void tuner_event_handler(lv_event_t *e)
+{
+    icon_in_obj = ui_screen_enter(9, &s_tuner_screen);
+    icon_flag = 9;
+}
+
+// 没有图片 用符号
+const app_mod_t app_mod_tuner = {
+    .name = "tuner",
+    .id = 9,
+    .color = 0xe67e22,
+    .symbol = LV_SYMBOL_AUDIO,
+    .open = tuner_event_handler,
+    .back = btn_tuner_back_cb,
+};
@@ -1,25 +1,34 @@
 #include "app_ui.h"
-#include "audio_player.h"
+#include "app_mod.h"
+#include "task_plan.h"
+#include "ui_perf.h"
+#include "ui_msg.h"
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "ui_layer.h"
+#include "ui_marquee.h"
+#include "pic_rgb565.h"
+#include "ui_gif.h"
+#include "ui_clock.h"
+#include "sd_hotplug.h"
+#include "idle_mgr.h"
+#include "imu_log.h"
+#include "voice_memo.h"
+#include "wifi_svc.h"
+#include "time_sync.h"
+#include "evt_bus.h"
 #include "esp32_s3_szp.h"
-#include "file_iterator.h"
-#include "string.h"
-#include <dirent.h>
-#include "bt/ble_hidd_demo.h"
-#include "esp_wifi.h"
-#include "freertos/event_groups.h"
-#include "esp_event.h"
-#include <sys/stat.h>
+#include "boot.h"
+#include "boot_anim.h"
+#include "alarm.h"
+#include "asset_part.h"
+#include <string.h>
+#include <stdio.h>
 #include <time.h>
 #include <sys/time.h>
-#include "esp_netif_sntp.h"
-#include "esp_sntp.h"
-#include <ctype.h>
-#include "img_converters.h"  // 位于 esp32-camera 组件
-static void set_img_src_from_fs_path(const char *fs_path);
 static const char *TAG = "app_ui";
 // #define LV_USE_GIF 1
-#define START_GIF_PATH "A:/sdcard/tanglong.gif"
-LV_FONT_DECLARE(font_alipuhui20);
+#define START_GIF_PATH "A:" BOOT_ANIM_GIF_PATH
 
 lv_obj_t *main_obj;        // 主界面
 lv_obj_t *main_text_label; // 主界面 欢迎语
@@ -37,14 +46,27 @@ lv_obj_t *tanglong_img;
 // // 开机界面
 void lv_gui_start(void)
 {
-    lvgl_port_lock(0);
+    ui_lock(0);
+    ui_msg_init(); // 后台任务的界面更新从这里开始被取出执行
+    ui_theme_init(); // 共享样式只建这一次
+    pic_rgb565_decoder_init(); // 拍照存的.rgb565 文件管理器里也能直接打开
     // 显示logo
 
     // LV_IMG_DECLARE(tanglong)
 
-    tanglong_img = lv_gif_create(lv_scr_act());        // 创建图片对象
-    lv_gif_set_src(tanglong_img, START_GIF_PATH);           // 设置图片对象的图片源
-    lv_obj_align(tanglong_img, LV_ALIGN_CENTER, 0, 0); // 设置图片位置为屏幕正中心
+#if CONFIG_APP_BOOT_ANIM_FLASH
+    tanglong_img = boot_anim_create(lv_scr_act());     // 已经转换进flash的开机动画 不用等SD卡
+    if (tanglong_img) {
+        lv_obj_set_style_bg_color(lv_scr_act(), lv_color_hex(BOOT_ANIM_BG), 0); // 和转换时透明处合成的颜色一致
+    }
+#endif
+    if (tanglong_img == NULL && boot_ready(BOOT_STAGE_SD)) {
+        tanglong_img = ui_gif_create(lv_scr_act());        // 创建图片对象 解码在后台任务里
+        ui_gif_set_src(tanglong_img, START_GIF_PATH);           // 设置图片对象的图片源
+    }
+    if (tanglong_img) {
+        lv_obj_align(tanglong_img, LV_ALIGN_CENTER, 0, 0); // 设置图片位置为屏幕正中心
+    }
     // lv_img_set_pivot(tanglong_img, 60, 60); // 设置图片围绕自己的中心位置旋转
 
     // // 设置旋转动画
@@ -56,2424 +78,597 @@ void lv_gui_start(void)
     // lv_anim_set_time(&a, 200); // 设置转一圈的周期是200毫秒
     // lv_anim_set_repeat_count(&a, 5); // 设置旋转5次
     // lv_anim_start(&a); // 动画开始
-    lvgl_port_unlock();
+    ui_unlock();
 }
 
-/******************************** 第1个图标 姿态传感器 应用程序*************************************************************************************/
-lv_obj_t *label_x; // x角度值
-lv_obj_t *label_y; // y角度值
-lv_obj_t *label_z; // z角度值
-lv_obj_t *x_bar;   // x角度bar
-lv_obj_t *y_bar;   // y角度bar
-lv_obj_t *z_bar;   // z角度bar
-
-lv_obj_t *att_label; // 标题栏文字
+/******************************** 主页时钟  ******************************/
+lv_obj_t *date_label;
+lv_obj_t *time_label;
 
-lv_timer_t *my_lv_timer;
+time_t now;
+struct tm timeinfo;
 
-lv_obj_t *btn_att_back; // att姿态应用 后退按钮
+static lv_timer_t *s_clock_timer;  // 只在主界面露着而且背光亮着时有
 
-// 返回主界面按钮事件处理函数
-static void btn_att_back_cb(lv_event_t *e)
-{
-    lv_timer_del(my_lv_timer);
-    qmi8658_close();         // 关闭芯片运行
-    lv_obj_del(icon_in_obj); // 删除画布
-    icon_flag = 0;
-}
-
-// 定时更新姿态角度值
-void att_update_cb(lv_timer_t *timer)
+// 更新时间函数 时钟只重画变了的数字 日期过了零点才改
+void value_update_cb(lv_timer_t *timer)
 {
-    t_sQMI8658 QMI8658;
-    int att_x, att_y, att_z;
-    // 获取XYZ角度
-    qmi8658_fetch_angleFromAcc(&QMI8658);
-    att_x = round(QMI8658.AngleX); // 四舍五入
-    att_y = round(QMI8658.AngleY); // 四舍五入
-    att_z = round(QMI8658.AngleZ); // 四舍五入
-    // 更新角度值
-    lv_label_set_text_fmt(label_x, "X: %d", att_x);
-    lv_label_set_text_fmt(label_y, "Y: %d", att_y);
-    lv_label_set_text_fmt(label_z, "Z: %d", att_z);
-    // 更新角度bar
-    lv_bar_set_start_value(x_bar, att_x - 10, LV_ANIM_OFF);
-    lv_bar_set_value(x_bar, att_x + 10, LV_ANIM_OFF);
-    lv_bar_set_start_value(y_bar, att_y - 10, LV_ANIM_OFF);
-    lv_bar_set_value(y_bar, att_y + 10, LV_ANIM_OFF);
-    lv_bar_set_start_value(z_bar, att_z - 10, LV_ANIM_OFF);
-    lv_bar_set_value(z_bar, att_z + 10, LV_ANIM_OFF);
-
-    // 判断运动状态
-    uint8_t status = qmi8658_fetch_motion();
-    if (status & 0x20) // 判断是否发生Any-Motion
+    static int s_date_key = -1;
+    static time_sync_source_t s_shown_source = TIME_SYNC_NONE;
+    // 更新日期 星期 时分秒
+    time(&now);
+    localtime_r(&now, &timeinfo);
+    ui_clock_set(time_label, &timeinfo);
+    int date_key = timeinfo.tm_year * 400 + timeinfo.tm_yday;
+    if (date_key != s_date_key)
     {
-        lv_label_set_text(att_label, "运动或震动");
+        s_date_key = date_key;
+        lv_label_set_text_fmt(date_label, "%d年%02d月%02d日", timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
     }
-    else if (status & 0x40) // 判断是否发生No-Motion
+    // 断电后用的是保存的时间 对上时以前显示成灰色
+    time_sync_source_t source = time_sync_source();
+    if (timer == NULL || source != s_shown_source)
     {
-        lv_label_set_text(att_label, "静止");
+        s_shown_source = source;
+        lv_color_t color = lv_color_hex(source == TIME_SYNC_SAVED ? 0x808080 : 0xffffff);
+        ui_clock_set_color(time_label, color);
+        lv_obj_set_style_text_color(date_label, color, 0);
     }
-    else if (status & 0x80) // 判断是否发生Significant-Motion
+    // 下一次对准下一秒刚过 不会因为定时器的漂移晚将近一秒 也不会一秒里跑两次
+    if (timer)
     {
-        lv_label_set_text(att_label, "剧烈运动");
-    }
-}
-
-// 姿态监测处理任务
-static void task_process_att(void *arg)
-{
-    esp_err_t ret = qmi8658_init();
-    if (ret != ESP_OK)
-    { // 如果传感器初始化不成功
-        // 液晶屏提醒用户 传感器错误
-        lvgl_port_lock(0);
-        lv_obj_t *label = lv_label_create(icon_in_obj);
-        lv_label_set_text(label, "QMI8658传感器错误...");
-        lv_obj_set_style_text_color(label, lv_color_hex(0x000000), 0);
-        lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
-        lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
-        lvgl_port_unlock();
-        vTaskDelay(1000 / portTICK_PERIOD_MS); // 提示词保留1秒
-        lvgl_port_lock(0);
-        lv_obj_del(icon_in_obj); // 删除画布 回到主界面
-        lvgl_port_unlock();
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        lv_timer_set_period(timer, 1000 - tv.tv_usec / 1000 + 5);
     }
-    else
-    { // 传感器初始化成功
-        lvgl_port_lock(0);
-        // 显示x角度值
-        label_x = lv_label_create(icon_in_obj);
-        lv_label_set_text(label_x, "X:");
-        lv_obj_set_style_text_color(label_x, lv_color_hex(0x000000), 0);
-        lv_obj_set_style_text_font(label_x, &lv_font_montserrat_20, 0);
-        lv_obj_align(label_x, LV_ALIGN_TOP_LEFT, 20, 60);
-        // 显示x角度bar
-        x_bar = lv_bar_create(icon_in_obj);
-        lv_obj_set_size(x_bar, 200, 25);
-        lv_obj_align(x_bar, LV_ALIGN_TOP_LEFT, 80, 60);
-        lv_bar_set_mode(x_bar, LV_BAR_MODE_RANGE);
-        lv_bar_set_range(x_bar, -101, 101);
-        lv_bar_set_start_value(x_bar, -10, LV_ANIM_OFF);
-        lv_bar_set_value(x_bar, 10, LV_ANIM_OFF);
-
-        // 显示y角度值
-        label_y = lv_label_create(icon_in_obj);
-        lv_label_set_text(label_y, "Y:");
-        lv_obj_set_style_text_color(label_y, lv_color_hex(0x000000), 0);
-        lv_obj_set_style_text_font(label_y, &lv_font_montserrat_20, 0);
-        lv_obj_align(label_y, LV_ALIGN_TOP_LEFT, 20, 120);
-        // 显示y角度bar
-        y_bar = lv_bar_create(icon_in_obj);
-        lv_obj_set_size(y_bar, 200, 25);
-        lv_obj_align(y_bar, LV_ALIGN_TOP_LEFT, 80, 120);
-        lv_bar_set_mode(y_bar, LV_BAR_MODE_RANGE);
-        lv_bar_set_range(y_bar, -101, 101);
-        lv_bar_set_start_value(y_bar, -10, LV_ANIM_OFF);
-        lv_bar_set_value(y_bar, 10, LV_ANIM_OFF);
-
-        // 显示z角度值
-        label_z = lv_label_create(icon_in_obj);
-        lv_label_set_text(label_z, "Z:");
-        lv_obj_set_style_text_color(label_z, lv_color_hex(0x000000), 0);
-        lv_obj_set_style_text_font(label_z, &lv_font_montserrat_20, 0);
-        lv_obj_align(label_z, LV_ALIGN_TOP_LEFT, 20, 180);
-        // 显示z角度bar
-        z_bar = lv_bar_create(icon_in_obj);
-        lv_obj_set_size(z_bar, 200, 25);
-        lv_obj_align(z_bar, LV_ALIGN_TOP_LEFT, 80, 180);
-        lv_bar_set_mode(z_bar, LV_BAR_MODE_RANGE);
-        lv_bar_set_range(z_bar, -101, 101);
-        lv_bar_set_start_value(z_bar, -10, LV_ANIM_OFF);
-        lv_bar_set_value(z_bar, 10, LV_ANIM_OFF);
-
-        lvgl_port_unlock();
-
-        // 创建一个lv_timer 用于更新角度
-        my_lv_timer = lv_timer_create(att_update_cb, 200, NULL);
-    }
-
-    vTaskDelete(NULL);
-}
-
-static void att_event_handler(lv_event_t *e)
-{
-    // 创建一个界面
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0xffffff));
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    icon_in_obj = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(icon_in_obj, &style, 0);
-
-    // 创建标题背景
-    lv_obj_t *att_title = lv_obj_create(icon_in_obj);
-    lv_obj_set_size(att_title, 320, 40);
-    lv_obj_set_style_pad_all(att_title, 0, 0); // 设置间隙
-    lv_obj_align(att_title, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_obj_set_style_bg_color(att_title, lv_color_hex(0x30a830), 0);
-    // 显示标题
-    att_label = lv_label_create(att_title);
-    lv_label_set_text(att_label, "运动监测");
-    lv_obj_set_style_text_color(att_label, lv_color_hex(0xffffff), 0);
-    lv_obj_set_style_text_font(att_label, &font_alipuhui20, 0);
-    lv_obj_align(att_label, LV_ALIGN_CENTER, 0, 0);
-    // 创建后退按钮
-    btn_att_back = lv_btn_create(att_title);
-    lv_obj_align(btn_att_back, LV_ALIGN_LEFT_MID, 0, 0);
-    lv_obj_set_size(btn_att_back, 60, 30);
-    lv_obj_set_style_border_width(btn_att_back, 0, 0);                          // 设置边框宽度
-    lv_obj_set_style_pad_all(btn_att_back, 0, 0);                               // 设置间隙
-    lv_obj_set_style_bg_opa(btn_att_back, LV_OPA_TRANSP, LV_PART_MAIN);         // 背景透明
-    lv_obj_set_style_shadow_opa(btn_att_back, LV_OPA_TRANSP, LV_PART_MAIN);     // 阴影透明
-    lv_obj_add_event_cb(btn_att_back, btn_att_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
-
-    lv_obj_t *label_back = lv_label_create(btn_att_back);
-    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
-    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_back, lv_color_hex(0xffffff), 0);
-    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
-
-    icon_flag = 1; // 标记已经进入第一个应用
-    xTaskCreatePinnedToCore(task_process_att, "task_process_att", 2 * 1024, NULL, 5, NULL, 1);
 }
 
-/*********************  第2个图标   音乐播放器 *********************************************************************************************/
-static audio_player_config_t player_config = {0};
-static uint8_t g_sys_volume = VOLUME_DEFAULT;
-static file_iterator_instance_t *file_iterator = NULL;
-// 本模块内的播放器初始化幂等保护
-static bool s_audio_player_ready = false;
-// 用户主动停止播放的标志，用于在回调中区分“曲目自然结束”与“退出界面主动停止”
-static volatile bool s_user_stop_pending = false;
-// 开机音乐：事件组与标志
-extern EventGroupHandle_t my_event_group;
-// extern const int START_MUSIC_COMPLETED;
-static bool g_boot_playing = false;
-
-lv_obj_t *music_list;
-lv_obj_t *label_play_pause;
-lv_obj_t *btn_play_pause;
-lv_obj_t *volume_slider;
-
-lv_obj_t *music_title_label;
-lv_obj_t *btn_music_back;
-
-
-// 播放指定序号的音乐
-static void play_index(int index)
+// 看不见时钟就不要定时器 省下每秒一次的唤醒 回来时马上补一次 在LVGL任务里执行
+// 对时以前的欢迎语跑马灯也一样停
+static void clock_timer_update(void *arg)
 {
-    ESP_LOGI(TAG, "play_index(%d)", index);
-
-    char filename[128];
-    int retval = file_iterator_get_full_path_from_index(file_iterator, index, filename, sizeof(filename));
-    if (retval == 0)
+    bool visible = ui_screen_home_visible() && idle_mgr_state() != IDLE_OFF;
+    if (main_text_label)
     {
-        ESP_LOGE(TAG, "unable to retrieve filename");
-        return;
+        ui_marquee_pause(main_text_label, !visible);
     }
-
-    FILE *fp = fopen(filename, "rb");
-    if (fp)
+    bool want = time_label != NULL && visible;
+    if (want && s_clock_timer == NULL)
     {
-        ESP_LOGI(TAG, "Playing '%s'", filename);
-        audio_player_play(fp);
+        value_update_cb(NULL);
+        s_clock_timer = lv_timer_create(value_update_cb, 1000, NULL);
+        lv_timer_ready(s_clock_timer); // 第一次马上对齐到秒
     }
-    else
+    else if (!want && s_clock_timer)
     {
-        ESP_LOGE(TAG, "unable to open index %d, filename '%s'", index, filename);
+        lv_timer_del(s_clock_timer);
+        s_clock_timer = NULL;
     }
 }
 
-// 设置声音处理函数
-static esp_err_t _audio_player_mute_fn(AUDIO_PLAYER_MUTE_SETTING setting)
+static void clock_home_cb(bool visible)
 {
-    esp_err_t ret = ESP_OK;
-    // 判断是否需要静音
-    bsp_codec_mute_set(setting == AUDIO_PLAYER_MUTE ? true : false);
-    // 如果不是静音 设置音量
-    if (setting == AUDIO_PLAYER_UNMUTE)
-    {
-        bsp_codec_volume_set(g_sys_volume, NULL);
-    }
-    ret = ESP_OK;
-
-    return ret;
+    clock_timer_update(NULL);
 }
 
-// 播放音乐函数 播放音乐的时候 会不断进入
-static esp_err_t _audio_player_write_fn(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+// 背光开关了 EVT_IDLE 在LVGL任务里
+static void clock_idle_cb(const evt_t *ev)
 {
-    esp_err_t ret = ESP_OK;
-
-    ret = bsp_i2s_write(audio_buffer, len, bytes_written, timeout_ms);
-
-    return ret;
+    clock_timer_update(NULL);
 }
 
-// 设置采样率 播放的时候进入一次
-static esp_err_t _audio_player_std_clock(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
-{
-    esp_err_t ret = ESP_OK;
+/******************************** 闹钟设置  ******************************/
+// 长按主页时钟弹出来 时 分 开关 每天还是只响一次
+static lv_obj_t *s_alarm_panel = NULL;
+static lv_obj_t *s_alarm_hour;
+static lv_obj_t *s_alarm_min;
+static lv_obj_t *s_alarm_on;
+static lv_obj_t *s_alarm_daily;
 
-    ret = bsp_codec_set_fs(rate, bits_cfg, ch); // 如果播放的音乐固定是16000采样率 这里可以不用打开 如果采样率未知 把这里打开
-    return ret;
-}
-
-// 回调函数 播放器每次动作都会进入
-static void _audio_player_callback(audio_player_cb_ctx_t *ctx)
+static void alarm_panel_close_cb(lv_event_t *e)
 {
-    ESP_LOGI(TAG, "ctx->audio_event = %d", ctx->audio_event);
-    switch (ctx->audio_event)
-    {
-        //IDLE态太多地方会进来了，STOP态才是用户主动停止播放
-        //播放完成也会进来
-        //点击暂停才是pause态
-    case AUDIO_PLAYER_CALLBACK_EVENT_IDLE:
-    { // 播放完一首歌 进入这个case
-        ESP_LOGI(TAG, "AUDIO_PLAYER_REQUEST_IDLE");
-
-        // 若是开机音乐播放结束，置位事件并不继续自动播放
-        if (g_boot_playing && my_event_group)
-        {
-            g_boot_playing = false;
-            xEventGroupSetBits(my_event_group, START_MUSIC_COMPLETED);
-            break;
-        }
-
-        // 如果是用户主动停止（退出音乐界面），不进行自动下一首，也不触碰UI
-        if (s_user_stop_pending)
-        {
-            s_user_stop_pending = false;
-            break;
-        }
-
-        // 普通模式：自动播放下一首
-        file_iterator_next(file_iterator);
-        int index = file_iterator_get_index(file_iterator);
-        ESP_LOGI(TAG, "playing index '%d'", index);
-        play_index(index);
-        // 修改当前播放的音乐名称（仅在音乐界面存在时）
-        if (icon_flag == 2 && music_list)
-        {
-            lvgl_port_lock(0);
-            lv_dropdown_set_selected(music_list, index);
-            lvgl_port_unlock();
-        }
-        break;
-    }
-    case AUDIO_PLAYER_CALLBACK_EVENT_PLAYING: // 正在播放音乐
-        ESP_LOGI(TAG, "AUDIO_PLAYER_REQUEST_PLAY");
-        pa_en(1); // 打开音频功放
-        break;
-    case AUDIO_PLAYER_CALLBACK_EVENT_PAUSE: // 正在暂停音乐
-        ESP_LOGI(TAG, "AUDIO_PLAYER_REQUEST_PAUSE");
-        pa_en(0); // 关闭音频功放
-        break;
-    default:
-        break;
-    }
+    lv_obj_del(s_alarm_panel);
+    s_alarm_panel = NULL;
 }
 
-// mp3播放器初始化
-void mp3_player_init(void)
+static void alarm_panel_save_cb(lv_event_t *e)
 {
-    // 确保文件迭代器存在
-    if (file_iterator == NULL) {
-        file_iterator = file_iterator_new(SD_MOUNT_POINT "/music");
-        assert(file_iterator != NULL);
-    }
-
-    // 初始化音频播放（避免重复初始化）
-    if (!s_audio_player_ready) {
-        player_config.mute_fn = _audio_player_mute_fn;
-        player_config.write_fn = _audio_player_write_fn;
-        player_config.clk_set_fn = _audio_player_std_clock;
-        player_config.priority = 6;
-        player_config.coreID = 1;
-
-        esp_err_t err = audio_player_new(player_config);
-        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-            ESP_ERROR_CHECK(err);
-        }
-        ESP_ERROR_CHECK(audio_player_callback_register(_audio_player_callback, NULL));
-        //初始化变量set
-        s_audio_player_ready = true;
+    alarm_cfg_t cfg = {
+        .enabled = lv_obj_has_state(s_alarm_on, LV_STATE_CHECKED),
+        .hour = lv_roller_get_selected(s_alarm_hour),
+        .minute = lv_roller_get_selected(s_alarm_min),
+        .days = lv_obj_has_state(s_alarm_daily, LV_STATE_CHECKED) ? 0x7f : 0,
+    };
+    if (alarm_set(&cfg) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "alarm not saved");
     }
+    alarm_panel_close_cb(e);
 }
 
-// 播放SPIFFS中的MP3文件；用于开机音乐
-void app_play_boot_mp3(const char *filepath)
+static lv_obj_t *alarm_roller_create(lv_obj_t *parent, int count, int selected)
 {
-    // 仅初始化一次
-    static bool s_player_inited = false;
-    if (!s_player_inited)
+    static char opts[60 * 3];
+    char *p = opts;
+    for (int i = 0; i < count; i++)
     {
-        mp3_player_init();
-        s_player_inited = true;
+        p += sprintf(p, i ? "\n%02d" : "%02d", i);
     }
-
-    FILE *fp = fopen(filepath, "rb");
-    if (!fp)
-    {
-        ESP_LOGE(TAG, "boot mp3 open failed: %s", filepath);
-        // 如果打开失败，直接置位事件，避免系统卡住
-        if (my_event_group)
-        {
-            xEventGroupSetBits(my_event_group, START_MUSIC_COMPLETED);
-        }
-        return;
-    }
-
-    g_boot_playing = true; // 在回调中依据该标志于播放结束置事件位
-    audio_player_play(fp);
+    lv_obj_t *roller = lv_roller_create(parent);
+    lv_obj_add_style(roller, ui_style(UI_STYLE_ROLLER), 0);
+    lv_obj_set_style_bg_opa(roller, LV_OPA_50, LV_PART_SELECTED);
+    lv_roller_set_options(roller, opts, LV_ROLLER_MODE_INFINITE); // 选项会拷走 缓冲可以接着用
+    lv_roller_set_visible_row_count(roller, 3);
+    lv_roller_set_selected(roller, selected, LV_ANIM_OFF);
+    lv_obj_set_width(roller, 70);
+    lv_obj_set_style_text_font(roller, &lv_font_montserrat_20, 0);
+    return roller;
 }
 
-// 按钮样式相关定义
-typedef struct
-{
-    lv_style_t style_bg;                // 按钮背景样式
-    lv_style_t style_focus_no_outline; // 按钮聚焦无边框样式
-} button_style_t;
-
-static button_style_t g_btn_styles;
-
-button_style_t *ui_button_styles(void)
+static lv_obj_t *alarm_panel_btn(lv_obj_t *parent, const char *text, lv_event_cb_t cb, lv_align_t align)
 {
-    return &g_btn_styles;
+    lv_obj_t *btn = lv_btn_create(parent);
+    lv_obj_set_width(btn, 90);
+    lv_obj_align(btn, align, 0, 0);
+    lv_obj_add_event_cb(btn, cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text(label, text);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_center(label);
+    return btn;
 }
 
-// 按钮样式初始化
-static void ui_button_style_init(void)
+static void alarm_panel_open_cb(lv_event_t *e)
 {
-    /*Init the style for the default state*/
-    lv_style_init(&g_btn_styles.style_focus_no_outline);
-    lv_style_set_outline_width(&g_btn_styles.style_focus_no_outline, 0);
-
-    lv_style_init(&g_btn_styles.style_bg);
-    lv_style_set_bg_opa(&g_btn_styles.style_bg, LV_OPA_100);
-    lv_style_set_bg_color(&g_btn_styles.style_bg, lv_color_make(255, 255, 255));
-    lv_style_set_shadow_width(&g_btn_styles.style_bg, 0);
-}
-
-// 播放暂停按钮 事件处理函数
-static void btn_play_pause_cb(lv_event_t *event)
-{
-    lv_obj_t *btn = lv_event_get_target(event);
-    lv_obj_t *lab = (lv_obj_t *)btn->user_data;
-
-    audio_player_state_t state = audio_player_get_state();
-    printf("state=%d\n", state);
-    if (state == AUDIO_PLAYER_STATE_IDLE)
+    if (s_alarm_panel)
     {
-        lvgl_port_lock(0);
-        lv_label_set_text_static(lab, LV_SYMBOL_PAUSE);
-        lvgl_port_unlock();
-        int index = file_iterator_get_index(file_iterator);
-        ESP_LOGI(TAG, "playing index '%d'", index);
-        play_index(index);
+        return;
     }
-    else if (state == AUDIO_PLAYER_STATE_PAUSE)
+    alarm_cfg_t cfg;
+    alarm_get(&cfg);
+    s_alarm_panel = lv_obj_create(lv_layer_top());
+    lv_obj_set_size(s_alarm_panel, 300, 220);
+    lv_obj_center(s_alarm_panel);
+    lv_obj_clear_flag(s_alarm_panel, LV_OBJ_FLAG_SCROLLABLE);
+
+    s_alarm_hour = alarm_roller_create(s_alarm_panel, 24, cfg.hour);
+    lv_obj_align(s_alarm_hour, LV_ALIGN_TOP_LEFT, 0, 0);
+    s_alarm_min = alarm_roller_create(s_alarm_panel, 60, cfg.minute);
+    lv_obj_align_to(s_alarm_min, s_alarm_hour, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
+
+    s_alarm_on = lv_switch_create(s_alarm_panel);
+    lv_obj_align(s_alarm_on, LV_ALIGN_TOP_RIGHT, 0, 10);
+    if (cfg.enabled)
     {
-        lvgl_port_lock(0);
-        lv_label_set_text_static(lab, LV_SYMBOL_PAUSE);
-        lvgl_port_unlock();
-        audio_player_resume();
+        lv_obj_add_state(s_alarm_on, LV_STATE_CHECKED);
     }
-    else if (state == AUDIO_PLAYER_STATE_PLAYING)
+    s_alarm_daily = lv_checkbox_create(s_alarm_panel);
+    lv_checkbox_set_text(s_alarm_daily, "每天");
+    lv_obj_set_style_text_font(s_alarm_daily, &font_alipuhui20, 0);
+    lv_obj_align(s_alarm_daily, LV_ALIGN_TOP_RIGHT, 0, 60);
+    if (cfg.days)
     {
-        lvgl_port_lock(0);
-        lv_label_set_text_static(lab, LV_SYMBOL_PLAY);
-        lvgl_port_unlock();
-        audio_player_pause();
+        lv_obj_add_state(s_alarm_daily, LV_STATE_CHECKED);
     }
+
+    alarm_panel_btn(s_alarm_panel, "取消", alarm_panel_close_cb, LV_ALIGN_BOTTOM_LEFT);
+    alarm_panel_btn(s_alarm_panel, "保存", alarm_panel_save_cb, LV_ALIGN_BOTTOM_RIGHT);
 }
 
-// 上一首 下一首 按键事件处理函数
-static void btn_prev_next_cb(lv_event_t *event)
+// 主页左上角的欢迎语换成日期时间 在LVGL任务里执行 开机有时间就直接建 没有的话第一次对时以后建
+static void time_labels_create(void *arg)
 {
-    bool is_next = (bool)event->user_data;
-
-    if (is_next)
+    if (time_label != NULL || !time_sync_valid())
     {
-        ESP_LOGI(TAG, "btn next");
-        file_iterator_next(file_iterator);
-    }
-    else
-    {
-        ESP_LOGI(TAG, "btn prev");
-        file_iterator_prev(file_iterator);
+        return;
     }
-    // 修改当前的音乐名称
-    int index = file_iterator_get_index(file_iterator);
-    lvgl_port_lock(0);
-    lv_dropdown_set_selected(music_list, index);
-    // lv_obj_t *label_title = (lv_obj_t *) music_list->user_data;
-    // lv_label_set_text_static(label_title, file_iterator_get_name_from_index(file_iterator, index));
-    lvgl_port_unlock();
-    // 执行音乐事件
-    audio_player_state_t state = audio_player_get_state();
-    printf("prev_next_state=%d\n", state);
-    if (state == AUDIO_PLAYER_STATE_IDLE)
+    // 显示时间  小时:分钟:秒钟 用缓存的数字字形
+    time_label = ui_clock_create(main_obj, &font_alipuhui20);
+    if (time_label == NULL)
     {
-        // Nothing to do
-    }
-    else if (state == AUDIO_PLAYER_STATE_PAUSE)
-    { // 如果当前正在暂停歌曲
-        ESP_LOGI(TAG, "playing index '%d'", index);
-        play_index(index);
-        audio_player_pause();
-    }
-    else if (state == AUDIO_PLAYER_STATE_PLAYING)
-    { // 如果当前正在播放歌曲
-        // 播放歌曲
-        ESP_LOGI(TAG, "playing index '%d'", index);
-        play_index(index);
+        return;
     }
-}
+    lv_obj_del(main_text_label); // 删除主页的欢迎语
+    main_text_label = NULL;
+    // 显示年月日
+    date_label = lv_label_create(main_obj);
+    lv_obj_set_style_text_font(date_label, &font_alipuhui20, 0);
+    lv_obj_align(date_label, LV_ALIGN_TOP_LEFT, 10, 5);
 
-// 音量调节滑动条 事件处理函数
-static void volume_slider_cb(lv_event_t *event)
-{
-    lv_obj_t *slider = lv_event_get_target(event);
-    int volume = lv_slider_get_value(slider); // 获取slider的值
-    bsp_codec_volume_set(volume, NULL);       // 设置声音大小
-    g_sys_volume = volume;                    // 把声音赋值给g_sys_volume保存
-    ESP_LOGI(TAG, "volume '%d'", volume);
+    value_update_cb(NULL);
+    lv_obj_align_to(time_label, date_label, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
+    lv_obj_add_flag(time_label, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(time_label, alarm_panel_open_cb, LV_EVENT_LONG_PRESSED, NULL); // 有了时间才能设闹钟
+
+    // 每秒更新一次时间 进了应用或者熄屏就停
+    clock_timer_update(NULL);
 }
 
-// 音乐列表 点击事件处理函数
-static void music_list_cb(lv_event_t *event)
+// 对上时了 EVT_TIME_SYNCED 在LVGL任务里
+static void time_synced(const evt_t *ev)
 {
-    uint16_t index = lv_dropdown_get_selected(music_list);
-    ESP_LOGI(TAG, "switching index to '%d'", index);
-    file_iterator_set_index(file_iterator, index);
-
-    audio_player_state_t state = audio_player_get_state();
-    lv_obj_set_style_text_font(music_list, &font_alipuhui20, 0);
-    lv_obj_set_style_text_font(music_list, &font_alipuhui20, LV_PART_SELECTED);
-    
-    if (state == AUDIO_PLAYER_STATE_PAUSE)
-    { // 如果当前正在暂停歌曲
-        play_index(index);
-        audio_player_pause();
-    }
-    else if (state == AUDIO_PLAYER_STATE_PLAYING)
-    { // 如果当前正在播放歌曲
-        play_index(index);
-    }
+    time_labels_create(NULL);
 }
 
-static int classify_extension_ci(const char *ext);
-// 音乐名称加入列表
-static void build_file_list(lv_obj_t *music_list)
+// WiFi应用和开机自动连接共用 WiFi应用关掉了也照样对时
+esp_err_t app_wifi_open(void)
 {
-    lvgl_port_lock(0);
-    lv_dropdown_clear_options(music_list);
-    lvgl_port_unlock();
-
-    for (size_t i = 0; i < file_iterator->count; i++)
+    esp_err_t err = wifi_svc_start();
+    if (err == ESP_OK)
     {
-        const char *file_name = file_iterator_get_name_from_index(file_iterator, i);
-        if (NULL != file_name)
-        {
-            lvgl_port_lock(0);
-            // lv_dropdown_add_option(music_list, file_name, i); // 添加音乐名称到列表中
-            const char *ext = strrchr(file_name, '.');
-            if (ext!= NULL)
-            {
-                ext++; // 指向扩展名的第一个字符
-                if (classify_extension_ci(ext) == 1)
-                {
-                    lv_dropdown_add_option(music_list, file_name, i); // 添加音乐名称到列表中
-                }
-                lvgl_port_unlock();
-            }
-        }
+        time_sync_start(); // 不阻塞 连上网以后lwip后台对时
     }
-    lvgl_port_lock(0);
-    lv_dropdown_set_selected(music_list, 0); // 选择列表中的第一个
-    lvgl_port_unlock();
+    return err;
 }
 
-// 播放器界面初始化
-void music_ui(void)
+static void wifi_auto_task(void *arg)
 {
-    lvgl_port_lock(0);
-
-    ui_button_style_init(); // 初始化按键风格
-
-    /* 创建播放暂停控制按键 */
-    /*
-    CHECKABLE：按钮内部会在每次点击或编码器确认时自动切换 LV_STATE_CHECKED 开关态，
-    并触发一次 LV_EVENT_VALUE_CHANGED。适合开关类/切换类控件（如播放↔暂停、开↔关）。
-    CLICKABLE：仅表示可点击，事件序列是 PRESSED/RELEASED/CLICKED，
-    需要你自己维护是否“选中”。如果用它做播放/暂停，必须在回调里手动切换状态并管理样式。
-    这里要自动切换播放/暂停，所以用 CHECKABLE 更简洁。
-    */
-    btn_play_pause = lv_btn_create(icon_in_obj);
-    lv_obj_align(btn_play_pause, LV_ALIGN_CENTER, 0, 40);
-    lv_obj_set_size(btn_play_pause, 50, 50);
-    lv_obj_set_style_radius(btn_play_pause, 25, LV_STATE_DEFAULT);
-    lv_obj_add_flag(btn_play_pause, LV_OBJ_FLAG_CHECKABLE);
-    //获得焦点时不显示描边
-    lv_obj_add_style(btn_play_pause, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_play_pause, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUSED);
-
-    label_play_pause = lv_label_create(btn_play_pause);
-
-    lv_label_set_text_static(label_play_pause, LV_SYMBOL_PLAY);
-    lv_obj_center(label_play_pause);
-
-    lv_obj_set_user_data(btn_play_pause, (void *)label_play_pause);
-    //对 CHECKABLE 按钮，切换开关态时只发一次 VALUE_CHANGED，不会收到多次 PRESS/RELEASE 组合，回调更干净
-    lv_obj_add_event_cb(btn_play_pause, btn_play_pause_cb, LV_EVENT_VALUE_CHANGED, NULL);
-
-    /* 创建上一首控制按键 */
-    lv_obj_t *btn_play_prev = lv_btn_create(icon_in_obj);
-    lv_obj_set_size(btn_play_prev, 50, 50);
-    lv_obj_set_style_radius(btn_play_prev, 25, LV_STATE_DEFAULT);
-    lv_obj_clear_flag(btn_play_prev, LV_OBJ_FLAG_CHECKABLE);
-    lv_obj_align_to(btn_play_prev, btn_play_pause, LV_ALIGN_OUT_LEFT_MID, -40, 0);
-
-    lv_obj_add_style(btn_play_prev, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_play_prev, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_play_prev, &ui_button_styles()->style_bg, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_play_prev, &ui_button_styles()->style_bg, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_play_prev, &ui_button_styles()->style_bg, LV_STATE_DEFAULT);
-
-    lv_obj_t *label_prev = lv_label_create(btn_play_prev);
-    lv_label_set_text_static(label_prev, LV_SYMBOL_PREV);
-    lv_obj_set_style_text_font(label_prev, &lv_font_montserrat_24, LV_STATE_DEFAULT);
-    lv_obj_set_style_text_color(label_prev, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
-    lv_obj_center(label_prev);
-    lv_obj_set_user_data(btn_play_prev, (void *)label_prev);
-    lv_obj_add_event_cb(btn_play_prev, btn_prev_next_cb, LV_EVENT_CLICKED, (void *)false);
-
-    /* 创建下一首控制按键 */
-    lv_obj_t *btn_play_next = lv_btn_create(icon_in_obj);
-    lv_obj_set_size(btn_play_next, 50, 50);
-    lv_obj_set_style_radius(btn_play_next, 25, LV_STATE_DEFAULT);
-    lv_obj_clear_flag(btn_play_next, LV_OBJ_FLAG_CHECKABLE);
-    lv_obj_align_to(btn_play_next, btn_play_pause, LV_ALIGN_OUT_RIGHT_MID, 40, 0);
-
-    lv_obj_add_style(btn_play_next, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_play_next, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_play_next, &ui_button_styles()->style_bg, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_play_next, &ui_button_styles()->style_bg, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_play_next, &ui_button_styles()->style_bg, LV_STATE_DEFAULT);
-
-    lv_obj_t *label_next = lv_label_create(btn_play_next);
-    lv_label_set_text_static(label_next, LV_SYMBOL_NEXT);
-    lv_obj_set_style_text_font(label_next, &lv_font_montserrat_24, LV_STATE_DEFAULT);
-    lv_obj_set_style_text_color(label_next, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
-    lv_obj_center(label_next);
-    lv_obj_set_user_data(btn_play_next, (void *)label_next);
-    lv_obj_add_event_cb(btn_play_next, btn_prev_next_cb, LV_EVENT_CLICKED, (void *)true);
-
-    /* 创建声音调节滑动条 */
-    volume_slider = lv_slider_create(icon_in_obj);
-    lv_obj_set_size(volume_slider, 200, 10);
-    lv_obj_set_ext_click_area(volume_slider, 15);
-    lv_obj_align(volume_slider, LV_ALIGN_BOTTOM_MID, 0, -20);
-    lv_slider_set_range(volume_slider, 0, 100);
-    lv_slider_set_value(volume_slider, g_sys_volume, LV_ANIM_ON);
-    lv_obj_add_event_cb(volume_slider, volume_slider_cb, LV_EVENT_VALUE_CHANGED, NULL);
-
-    lv_obj_t *lab_vol_min = lv_label_create(icon_in_obj);
-    lv_label_set_text_static(lab_vol_min, LV_SYMBOL_VOLUME_MID);
-    lv_obj_set_style_text_font(lab_vol_min, &lv_font_montserrat_20, LV_STATE_DEFAULT);
-    lv_obj_align_to(lab_vol_min, volume_slider, LV_ALIGN_OUT_LEFT_MID, -10, 0);
-
-    lv_obj_t *lab_vol_max = lv_label_create(icon_in_obj);
-    lv_label_set_text_static(lab_vol_max, LV_SYMBOL_VOLUME_MAX);
-    lv_obj_set_style_text_font(lab_vol_max, &lv_font_montserrat_20, LV_STATE_DEFAULT);
-    lv_obj_align_to(lab_vol_max, volume_slider, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
-
-    /* 创建音乐列表 */
-    music_list = lv_dropdown_create(icon_in_obj);
-    lv_dropdown_clear_options(music_list);
-    lv_dropdown_set_options_static(music_list, "扫描中...");
-    // lv_obj_set_style_text_font(music_list, &font_alipuhui20, LV_STATE_ANY);
-    lv_obj_set_style_text_font(music_list, &font_alipuhui20, 0);
-    lv_obj_set_style_text_font(music_list, &font_alipuhui20, LV_PART_SELECTED);
-    
-    lv_obj_set_width(music_list, 200);
-    lv_obj_align(music_list, LV_ALIGN_TOP_MID, 0, 60);
-    lv_obj_add_event_cb(music_list, music_list_cb, LV_EVENT_VALUE_CHANGED, NULL);
-
-    build_file_list(music_list);
-
-    /* 为下拉框的弹出列表设置中文字体（下拉列表对象与主对象分离，需单独设置） */
-    lv_dropdown_open(music_list);
-    lv_obj_t *ddlist = lv_dropdown_get_list(music_list);
-    if (ddlist)
+    if (app_wifi_open() == ESP_OK && wifi_svc_autoconnect() == ESP_ERR_NOT_FOUND)
     {
-        lv_obj_set_style_text_font(ddlist, &font_alipuhui20, 0);
-        lv_obj_set_style_text_font(ddlist, &font_alipuhui20, LV_PART_SELECTED);
+        ESP_LOGI(TAG, "no saved WLAN");
     }
-    lv_dropdown_close(music_list);
-
-    lvgl_port_unlock();
-}
-
-// 返回主界面按钮事件处理函数
-static void btn_music_back_cb(lv_event_t *e)
-{
-    lv_obj_del(icon_in_obj);
-    // 标记用户主动停止，回调中不自动下一首、不触碰已删除的UI
-    s_user_stop_pending = true;
-    // 不删除播放任务，仅停止播放，避免后续从SD直接播放时访问已释放的队列
-    // audio_player_delete();
-    audio_player_stop();
-    icon_flag = 0;
-}
-
-// 进入音乐播放应用
-static void music_event_handler(lv_event_t *e)
-{
-    // 初始化mp3播放器
-    mp3_player_init();
-    // 创建一个界面对象
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0xffffff));
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    icon_in_obj = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(icon_in_obj, &style, 0);
-
-    // 创建标题背景
-    lv_obj_t *music_title = lv_obj_create(icon_in_obj);
-    lv_obj_set_size(music_title, 320, 40);
-    lv_obj_set_style_pad_all(music_title, 0, 0); // 设置间隙
-    lv_obj_align(music_title, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_obj_set_style_bg_color(music_title, lv_color_hex(0xf87c30), 0);
-    // 显示标题
-    music_title_label = lv_label_create(music_title);
-    lv_label_set_text(music_title_label, "音乐播放器");
-    lv_obj_set_style_text_color(music_title_label, lv_color_hex(0xffffff), 0);
-    lv_obj_set_style_text_font(music_title_label, &font_alipuhui20, 0);
-    lv_obj_align(music_title_label, LV_ALIGN_CENTER, 0, 0);
-    // 创建后退按钮
-    btn_music_back = lv_btn_create(music_title);
-    lv_obj_align(btn_music_back, LV_ALIGN_LEFT_MID, 0, 0);
-    lv_obj_set_size(btn_music_back, 60, 30);
-    lv_obj_set_style_border_width(btn_music_back, 0, 0);                            // 设置边框宽度
-    lv_obj_set_style_pad_all(btn_music_back, 0, 0);                                 // 设置间隙
-    lv_obj_set_style_bg_opa(btn_music_back, LV_OPA_TRANSP, LV_PART_MAIN);           // 背景透明
-    lv_obj_set_style_shadow_opa(btn_music_back, LV_OPA_TRANSP, LV_PART_MAIN);       // 阴影透明
-    lv_obj_add_event_cb(btn_music_back, btn_music_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
-
-    lv_obj_t *label_back = lv_label_create(btn_music_back);
-    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
-    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_back, lv_color_hex(0xffffff), 0);
-    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
-
-    icon_flag = 2; // 标记已经进入第二个应用
-
-    music_ui(); // 音乐播放器界面
+    vTaskDelete(NULL);
 }
 
-/******************************** 第3个图标 SD卡 应用程序***************************************************************************/
-lv_obj_t *sdcard_title;     // SD卡页面标题背景
-lv_obj_t *sdcard_label;     // SD卡页面标题
-lv_obj_t *sdcard_file_list; // SD卡文件列表
-
-extern sdmmc_card_t *sdmmc_card;
-static void image_view_back(void);
-static void gif_view_back(void);
-struct file_path_info
-{
-    uint8_t path_index;  // 在第几级目录
-    char path_now[512];  // 当前文件路径
-    char path_back[512]; // 上级文件路径
+void app_wifi_autoconnect(void)
+{
+    task_plan_create(TASK_WIFI_AUTO, wifi_auto_task, NULL, NULL);
+}
+
+/******************************** 应用表  ******************************/
+// 主界面的图标按这个顺序排 Kconfig里关掉的应用没有图标 后面的往前挪
+static const app_mod_t *const s_apps[] = {
+#if CONFIG_APP_MOD_ATT
+    &app_mod_att,
+#endif
+#if CONFIG_APP_MOD_MUSIC
+    &app_mod_music,
+#endif
+#if CONFIG_APP_MOD_SDCARD
+    &app_mod_sdcard,
+#endif
+#if CONFIG_APP_MOD_CAMERA
+    &app_mod_camera,
+#endif
+#if CONFIG_APP_MOD_WIFI
+    &app_mod_wifi,
+#endif
+#if CONFIG_APP_MOD_BT
+    &app_mod_bt,
+#endif
+#if CONFIG_APP_MOD_GALLERY
+    &app_mod_gallery,
+#endif
+#if CONFIG_APP_MOD_SYSMON
+    &app_mod_sysmon,
+#endif
+#if CONFIG_APP_MOD_TUNER
+    &app_mod_tuner,
+#endif
+#if CONFIG_APP_MOD_SCAN
+    &app_mod_scan,
+#endif
+#if CONFIG_APP_MOD_BENCH
+    &app_mod_bench,
+#endif
 };
-struct file_path_info file_path_info;
 
-// 函数声明
-esp_err_t list_sdcard_files(char *path);
-static void file_list_btn_cb(lv_event_t *e);
+#define APP_COUNT   (sizeof(s_apps) / sizeof(s_apps[0]))
 
-// 返回主界面按钮事件处理函数
-static void btn_sdback_cb(lv_event_t *e)
-{
-    //图片查看模式下返回文件列表替换原本的文件返回
+static bool s_app_inited[UI_SCREEN_MAX];    // 按id 已经调过init 只在LVGL任务里改
 
-    /* 检查是否在图片查看模式 */
-    lv_obj_t *img_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
-    if (img_container != NULL) {
-        /* 在图片查看模式，返回文件列表 */
-        image_view_back();
-        return;
-    }
-    lv_obj_t *gif_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
-    if (gif_container != NULL) {
-        /* 在GIF查看模式，返回文件列表 */
-        gif_view_back();
-        return;
-    }
-    
-    if (file_path_info.path_index == 0)
-    { // 如果当前是根目录
-        // 保持SD卡全局挂载，不在此卸载
-        lv_obj_del(icon_in_obj); // 回到主界面
-    }
-    else
-    {
-        lv_obj_clean(sdcard_file_list);                              // 清除当前列表
-        esp_err_t ret = list_sdcard_files(file_path_info.path_back); // 列出上一级目录文件
-        if (ret == ESP_OK)
-        {                                                              // 如果成功列出目录
-            strcpy(file_path_info.path_now, file_path_info.path_back); // 刚刚进入的这个目录路径 变成当前路径
-            file_path_info.path_index--;                               // 目录级数索引退一级
-            // 计算再向下退一级的目录路径
-            char *slash = strrchr(file_path_info.path_back, '/'); // 从后往前查找字符'/'
-            if (slash != NULL)
-            {                  // 如果查找到
-                *slash = '\0'; // 替换为NULL 表示字符串结束
-            }
-            ESP_LOGI(TAG, "path_index: %d", file_path_info.path_index);
-            ESP_LOGI(TAG, "path_now: %s", file_path_info.path_now);
-            ESP_LOGI(TAG, "path_back: %s", file_path_info.path_back);
+static const app_mod_t *app_find(int id)
+{
+    for (int i = 0; i < APP_COUNT; i++) {
+        if (s_apps[i]->id == id) {
+            return s_apps[i];
         }
     }
+    return NULL;
 }
 
-// 扩展名分类：0-其他 1-音乐 2-视频 3-图片,只传入扩展名
-static int classify_extension_ci(const char *ext)
+// 第一次打开前初始化它自己的东西 以后直接进
+static void app_open(const app_mod_t *app, lv_event_t *e)
 {
-    // 没有或者其他
-    if (!ext || !*ext)
-        return 0;
-    char buf[8] = {0};
-    size_t n = 0;
-    // 转小写
-    while (ext[n] && n < sizeof(buf) - 1)
-    {
-        buf[n] = (char)tolower((unsigned char)ext[n]);
-        n++;
+    if (!s_app_inited[app->id]) {
+        if (app->init) {
+            int64_t t0 = esp_timer_get_time();
+            app->init();
+            ESP_LOGI(TAG, "%s init in %lld us", app->name, esp_timer_get_time() - t0);
+        }
+        s_app_inited[app->id] = true;
     }
-    if (!strcmp(buf, "mp3") || !strcmp(buf, "wav")|| !strcmp(buf, "flac"))
-        return 1;
-    if (!strcmp(buf, "mp4") || !strcmp(buf, "avi"))
-        return 2;
-    if (!strcmp(buf, "jpg") || !strcmp(buf, "jpeg") || !strcmp(buf, "png") || !strcmp(buf, "bmp"))
-        return 3;
-    if (!strcmp(buf, "gif"))
-        return 4;
-    return 0;
+    app->open(e);
 }
 
-// 列出SD卡中的文件,扫描目录并且填充LVGL列表
-esp_err_t list_sdcard_files(char *path)
+static void app_icon_event_handler(lv_event_t *e)
 {
-    esp_err_t ret;
-    DIR *dir;
-    struct dirent *ent;
-    lv_obj_t *btn;
-    if ((dir = opendir(path)) != NULL)
-    { // 打开目录
-        while ((ent = readdir(dir)) != NULL)
-        { // 读取目录中的文件
-            /* 常规文件处理 */
-            if (ent->d_type == DT_REG)
-            { // 如果是常规文件
-                int file_type_flag = 0;
-                const char *extension = strrchr(ent->d_name, '.'); // 从后往前 找到字符'.'
-                if (extension != NULL)
-                {                // 如果找到了'.'
-                    extension++; // 跳过点
-                    file_type_flag = classify_extension_ci(extension);
-                }
-                lvgl_port_lock(0);
-                switch (file_type_flag)
-                {
-                case 1:
-                    btn = lv_list_add_btn(sdcard_file_list, LV_SYMBOL_AUDIO, (const char *)ent->d_name); // 显示音乐文件图标
-                    break;
-                case 2:
-                    btn = lv_list_add_btn(sdcard_file_list, LV_SYMBOL_VIDEO, (const char *)ent->d_name); // 显示视频文件图标
-                    break;
-                case 3:
-                    btn = lv_list_add_btn(sdcard_file_list, LV_SYMBOL_IMAGE, (const char *)ent->d_name); // 显示图片文件图标
-                    break;
-                case 4:
-                    btn = lv_list_add_btn(sdcard_file_list, LV_SYMBOL_IMAGE, (const char *)ent->d_name); // 显示GIF文件图标
-                    break;
-                default:
-                    btn = lv_list_add_btn(sdcard_file_list, LV_SYMBOL_FILE, (const char *)ent->d_name); // 显示普通文件图标
-                    break;
-                }
-                // 图标字体是在这里设置的
-                lv_obj_t *icon = lv_obj_get_child(btn, 0);                          // 获取图标指针
-                lv_obj_set_style_text_font(icon, &lv_font_montserrat_24, 0);        // 修改图标的字体
-                lv_obj_add_event_cb(btn, file_list_btn_cb, LV_EVENT_CLICKED, NULL); // 添加点击回调函数
-                lvgl_port_unlock();
-            }
-            /* 文件夹处理 */
-            else if (ent->d_type == DT_DIR)
-            { // 如果是文件夹
-                lvgl_port_lock(0);
-                btn = lv_list_add_btn(sdcard_file_list, LV_SYMBOL_DIRECTORY, (const char *)ent->d_name);
-                lv_obj_t *icon = lv_obj_get_child(btn, 0);                          // 获取图标指针
-                lv_obj_set_style_text_font(icon, &lv_font_montserrat_24, 0);        // 修改图标的字体
-                lv_obj_add_event_cb(btn, file_list_btn_cb, LV_EVENT_CLICKED, NULL); // 添加点击回调函数
-                lvgl_port_unlock();
-            }
-        }
-        closedir(dir);
-        ret = ESP_OK;
-    }
-    else
-    {
-        ESP_LOGE(TAG, "Failed to open directory %s.", path);
-        ret = ESP_FAIL;
-    }
-    return ret;
+    app_open(lv_event_get_user_data(e), e);
 }
 
-// 直接按文件路径播放（用于从SD文件浏览器跳转）
-static void play_file(const char *filepath)
+/******************************** SD卡拔插  ******************************/
+// EVT_SD 热插拔任务里调用 卸卡前把还开着卡上文件的录像和本地播放停掉
+static void app_sd_hotplug(const evt_t *ev)
 {
-    if (!filepath || !*filepath)
-    {
-        ESP_LOGE(TAG, "play_file: invalid path");
+    if (ev->a != SD_HOTPLUG_REMOVED) {
         return;
     }
-    // 确保播放器已初始化（幂等），避免在删除后直接播放造成队列悬空
-    mp3_player_init();
-    FILE *fp = fopen(filepath, "rb");
-    if (fp)
-    {
-        
-        audio_player_stop(); // 停止当前播放
-        s_user_stop_pending = true; // 标记为用户主动停止，避免回调中自动下一首 
-        vTaskDelay(100 / portTICK_PERIOD_MS); // 给停止操作一点时间
-        ESP_LOGI(TAG, "Playing '%s'", filepath);
-        audio_player_play(fp);
-    }
-    else
-    {
-        ESP_LOGE(TAG, "play_file: unable to open '%s'", filepath);
+    for (int i = 0; i < APP_COUNT; i++) {
+        if (s_app_inited[s_apps[i]->id] && s_apps[i]->sd_removed) {
+            s_apps[i]->sd_removed();
+        }
     }
-}
-//================================ 图片查看器 ===========================================
-static void image_viewer_ui(const char *filepath)
-{
-    /* 隐藏文件列表，在其位置显示图片 */
-    lvgl_port_lock(0);
-    if (sdcard_file_list) {
-        //用隐藏功能，退出时世界删除该flag和对象
-        lv_obj_add_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
+    if (imu_log_active()) {
+        imu_log_stop(); // 写不进去了 只是把任务和缓冲收掉
     }
-    
-    /* 创建图片显示容器 - 替换文件列表位置 */
-    lv_obj_t *img_container = lv_obj_create(icon_in_obj);
-    lv_obj_set_size(img_container, 320, 200);
-    lv_obj_align(img_container, LV_ALIGN_TOP_LEFT, 0, 40);
-    lv_obj_set_style_border_width(img_container, 0, 0);
-    lv_obj_set_style_bg_color(img_container, lv_color_hex(0xffffff), 0);
-    lv_obj_set_style_pad_all(img_container, 0, 0);
-    lv_obj_set_user_data(icon_in_obj, (void *)img_container);
-    
-    /* 创建图片对象 */
-    lv_obj_t *img = lv_img_create(img_container);
-    //后面用的
-    lv_img_set_src(img, filepath);
-    lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
-    lvgl_port_unlock();
-}
-static void img_view_file(const char *filepath)
-{
-    if (!filepath || !*filepath)
-    {
-        ESP_LOGE(TAG, "imgview_file: invalid path");
-        return;
+#if CONFIG_APP_VOICE_MEMO
+    if (voice_memo_active()) {
+        voice_memo_stop(); // 提示条由它的定时器自己收掉
     }
-    ESP_LOGE(TAG, "imgview_file: %s", filepath);
-    image_viewer_ui(filepath); // 隐藏文件列表并显示图片
+#endif
 }
 
-/* 返回文件列表视图 */
-static void image_view_back(void)
-{
-    lvgl_port_lock(0);
-    /* 获取并删除图片容器 */
-    lv_obj_t *img_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
-    if (img_container) {
-        lv_obj_del(img_container);
-        lv_obj_set_user_data(icon_in_obj, NULL);
-    }
-    /* 显示文件列表 */
-    if (sdcard_file_list) {
-        lv_obj_clear_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
-    }
-    lvgl_port_unlock();
-}
-//================================ ======== ===========================================
-//================================ GIF查看器 ===========================================
 
-static void gif_viewer_ui(const char *filepath)
-{
-    /* 隐藏文件列表，在其位置显示图片 */
-    lvgl_port_lock(0);
-    if (sdcard_file_list) {
-        //用隐藏功能，退出时世界删除该flag和对象
-        lv_obj_add_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
-    }
-    
-    /* 创建图片显示容器 - 替换文件列表位置 */
-    lv_obj_t *gif_container = lv_obj_create(icon_in_obj);
-    lv_obj_set_size(gif_container, 320, 200);
-    lv_obj_align(gif_container, LV_ALIGN_TOP_LEFT, 0, 40);
-    lv_obj_set_style_border_width(gif_container, 0, 0);
-    lv_obj_set_style_bg_color(gif_container, lv_color_hex(0xffffff), 0);
-    lv_obj_set_style_pad_all(gif_container, 0, 0);
-    lv_obj_set_user_data(icon_in_obj, (void *)gif_container);
-    
-    /* 创建图片对象 */
-    lv_obj_t *gif = lv_gif_create(gif_container);
-    //后面用的
-    lv_gif_set_src(gif, filepath);
-    lv_obj_align(gif, LV_ALIGN_CENTER, 0, 0);
-    lvgl_port_unlock();
-}
-static void gif_view_file(const char *filepath)
+
+/******************************** 语音控制  ******************************/
+// 以下由语音识别任务交给LVGL任务执行 音乐命令只在音乐界面里有效 打开应用只在主界面有效
+static lv_obj_t *s_voice_tip = NULL;
+
+// 唤醒后在最上层提示 也算一次活动 熄屏时会把屏幕点亮
+void ai_gui_in(void)
 {
-    if (!filepath || !*filepath)
-    {
-        ESP_LOGE(TAG, "gifview_file: invalid path");
+    lv_disp_trig_activity(NULL);
+    if (s_voice_tip) {
         return;
     }
-    ESP_LOGE(TAG, "gifview_file: %s", filepath);
-    gif_viewer_ui(filepath); // 隐藏文件列表并显示图片
+    s_voice_tip = lv_label_create(lv_layer_top());
+    lv_obj_set_style_text_font(s_voice_tip, &font_alipuhui20, 0);
+    lv_obj_set_style_text_color(s_voice_tip, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_bg_color(s_voice_tip, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_bg_opa(s_voice_tip, LV_OPA_70, 0);
+    lv_obj_set_style_pad_all(s_voice_tip, 6, 0);
+    lv_obj_set_style_radius(s_voice_tip, 6, 0);
+    lv_label_set_text(s_voice_tip, "请说命令");
+    lv_obj_align(s_voice_tip, LV_ALIGN_BOTTOM_MID, 0, -10);
 }
 
-/* 返回文件列表视图 */
-static void gif_view_back(void)
+void ai_gui_out(void)
 {
-    lvgl_port_lock(0);
-    /* 获取并删除图片容器 */
-    lv_obj_t *gif_container = (lv_obj_t *)lv_obj_get_user_data(icon_in_obj);
-    if (gif_container) {
-        lv_obj_del(gif_container);
-        lv_obj_set_user_data(icon_in_obj, NULL);
+    if (s_voice_tip) {
+        lv_obj_del(s_voice_tip);
+        s_voice_tip = NULL;
     }
-    /* 显示文件列表 */
-    if (sdcard_file_list) {
-        lv_obj_clear_flag(sdcard_file_list, LV_OBJ_FLAG_HIDDEN);
-    }
-    lvgl_port_unlock();
 }
-//================================ ======= ===========================================
 
-// 文件点击 事件处理函数,点击列表项：进入子目录或保持原目录
-static void file_list_btn_cb(lv_event_t *e)
+#if !CONFIG_APP_MOD_MUSIC
+// 没编音乐应用 语音和遥控器的音乐命令只记一下
+static void ai_no_music(void)
 {
-    const char *file_name = NULL; // 当前文件名称
-    // 获取点击的按钮名称 即文件名称
-    file_name = lv_list_get_btn_text(lv_obj_get_parent(e->target), e->target);
-    ESP_LOGI(TAG, "file name: %s", file_name);
-    // 列出 SD 卡中的文件
-    struct stat st;                                            // 获取文件状态信息结构体
-    strcpy(file_path_info.path_back, file_path_info.path_now); // 保存上一级目录
-    strcat(file_path_info.path_now, "/");
-    strcat(file_path_info.path_now, file_name);
-    if (stat(file_path_info.path_now, &st) == 0)
-    { // 如果成功获取到状态信息
-        if (S_ISDIR(st.st_mode))
-        {                                   // 如果是目录
-            lv_obj_clean(sdcard_file_list); // 清除当前列表
-            // 列出子目录内容 并打印路径状态
-            esp_err_t ret = list_sdcard_files(file_path_info.path_now);
-            if (ret == ESP_OK)
-            {                                // 如果成功列出了目录
-                file_path_info.path_index++; // 表示进入到下一集目录
-                ESP_LOGI(TAG, "path_index: %d", file_path_info.path_index);
-                ESP_LOGI(TAG, "path_now: %s", file_path_info.path_now);
-                ESP_LOGI(TAG, "path_back: %s", file_path_info.path_back);
-            }
-            return;
-        }
-
-        // 如果是音乐文件：播放选中歌曲
-        const char *ext = strrchr(file_name, '.');
-        if (ext)
-        {
-            ext++;
-            int cls = classify_extension_ci(ext);
-            if (cls == 1)
-            {
-                play_file(file_path_info.path_now);
-                // 还原路径信息 因为没有进入目录
-                strcpy(file_path_info.path_now, file_path_info.path_back); // 刚刚进入的这个目录路径 变成当前路径
-                char *slash = strrchr(file_path_info.path_back, '/'); // 从后往前查找字符'/'
-                if (slash != NULL)
-                {                  // 如果查找到
-                    *slash = '\0'; // 替换为NULL 表示字符串结束
-                }
-                return;
-            }
-            else if (cls == 3)
-            {
-                ESP_LOGI(TAG, "Image file selected: %s", file_path_info.path_now);
-                /* 使用LVGL FS接口访问图片 */
-                char lv_img_path[140];
-                lv_snprintf(lv_img_path, sizeof(lv_img_path), "A:%s", file_path_info.path_now);
-                img_view_file(lv_img_path); // 查看图片
-
-                // 还原路径信息 因为没有进入目录
-                strcpy(file_path_info.path_now, file_path_info.path_back); // 刚刚进入的这个目录路径 变成当前路径
-                char *slash = strrchr(file_path_info.path_back, '/'); // 从后往前查找字符'/'
-                if (slash != NULL)
-                {                  // 如果查找到
-                    *slash = '\0'; // 替换为NULL 表示字符串结束
-                }
-                return;
-            }
-            else if(cls ==4){
-                ESP_LOGI(TAG, "GIF file selected: %s", file_path_info.path_now);
-                /* 使用LVGL FS接口访问图片 */
-                char lv_gif_path[140];
-                lv_snprintf(lv_gif_path, sizeof(lv_gif_path), "A:%s", file_path_info.path_now);
-                gif_view_file(lv_gif_path); // 查看图片
-
-                // 还原路径信息 因为没有进入目录
-                strcpy(file_path_info.path_now, file_path_info.path_back); // 刚刚进入的这个目录路径 变成当前路径
-                char *slash = strrchr(file_path_info.path_back, '/'); // 从后往前查找字符'/'
-                if (slash != NULL)
-                {                  // 如果查找到
-                    *slash = '\0'; // 替换为NULL 表示字符串结束
-                }
-                return;
-            }
-        }
-
-        
-        // 如果是图片文件 可以在这里添加查看功能
-    }
-    // 如果没有成功进入目录
-    strcpy(file_path_info.path_now, file_path_info.path_back); // 没有列出新的列表 还原当前路径
-    // 还原再向下退一级的目录路径
-    char *slash = strrchr(file_path_info.path_back, '/'); // 从后往前查找字符'/'
-    if (slash != NULL)
-    {                  // 如果查找到
-        *slash = '\0'; // 替换为NULL 表示字符串结束
-    }
-    ESP_LOGI(TAG, "path_index: %d", file_path_info.path_index);
-    ESP_LOGI(TAG, "path_now: %s", file_path_info.path_now);
-    ESP_LOGI(TAG, "path_back: %s", file_path_info.path_back);
+    ESP_LOGI(TAG, "voice: music app not built");
 }
 
-// SD卡处理任务--后台任务：挂载设备、显示容量、构建文件列表）
-static void task_process_sdcard(void *arg)
+void ai_play(void)
 {
-    // 改为仅检测是否已在系统启动时挂载
-    if (sdmmc_card == NULL)
-    { // 如果没有挂载成功
-        ESP_LOGE(TAG, "SD card is not mounted.");
-        lvgl_port_lock(0);
-        lv_label_set_text(sdcard_label, "SD卡未挂载");
-        lvgl_port_unlock();
-        vTaskDelay(1000 / portTICK_PERIOD_MS); // 给上面一点显示的时间
-        lvgl_port_lock(0);
-        lv_obj_del(icon_in_obj);
-        lvgl_port_unlock();
-    }
-    else
-    { // 已挂载
-        // 终端显示SD卡信息
-        sdmmc_card_print_info(stdout, sdmmc_card);
-        // 液晶屏标题栏显示SD卡容量
-        lvgl_port_lock(0);
-        lv_label_set_text_fmt(sdcard_label, "SD: %lluGB",
-                              (((uint64_t)sdmmc_card->csd.capacity) * sdmmc_card->csd.sector_size) >> 30);
-        lvgl_port_unlock();
-
-        // 创建返回按钮
-        lvgl_port_lock(0);
-        lv_obj_t *btn_back = lv_btn_create(sdcard_title);
-        lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
-        lv_obj_set_size(btn_back, 60, 30);
-        lv_obj_set_style_border_width(btn_back, 0, 0);                        // 设置边框宽度
-        lv_obj_set_style_pad_all(btn_back, 0, 0);                             // 设置间隙
-        lv_obj_set_style_bg_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);       // 背景透明
-        lv_obj_set_style_shadow_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);   // 阴影透明
-        lv_obj_add_event_cb(btn_back, btn_sdback_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
-
-        lv_obj_t *label_back = lv_label_create(btn_back);
-        lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
-        lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-        lv_obj_set_style_text_color(label_back, lv_color_hex(0xffffff), 0);
-        lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
-
-        // 创建文件列表,全屏宽度、隐藏滚动条、设置字号
-        sdcard_file_list = lv_list_create(icon_in_obj);
-        lv_obj_set_size(sdcard_file_list, 320, 200);
-        lv_obj_align(sdcard_file_list, LV_ALIGN_TOP_LEFT, 0, 40);
-        lv_obj_set_style_border_width(sdcard_file_list, 0, 0);
-        lv_obj_set_style_text_font(sdcard_file_list, &font_alipuhui20, 0);
-        lv_obj_set_scrollbar_mode(sdcard_file_list, LV_SCROLLBAR_MODE_OFF); // 隐藏wifi_list滚动条
-        lvgl_port_unlock();
-        // 列出 SD 卡中的文件
-        file_path_info.path_index = 0;                   // 表示当前在根目录
-        strcpy(file_path_info.path_now, SD_MOUNT_POINT); // 装入当前路径
-        list_sdcard_files(file_path_info.path_now);      // 列出当前目录文件
-    }
-
-    vTaskDelete(NULL);
+    ai_no_music();
 }
 
-// 进入SD卡应用程序,进入应用时的 UI 场景搭建与任务启动
-static void sdcard_event_handler(lv_event_t *e)
+void ai_pause(void)
 {
-    // 创建一个界面对象,容器
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0xffffff));
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    icon_in_obj = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(icon_in_obj, &style, 0);
-
-    // 创建标题背景
-    sdcard_title = lv_obj_create(icon_in_obj);
-    lv_obj_set_size(sdcard_title, 320, 40);
-    lv_obj_set_style_pad_all(sdcard_title, 0, 0); // 设置间隙
-    lv_obj_align(sdcard_title, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_obj_set_style_bg_color(sdcard_title, lv_color_hex(0x008b8b), 0);
-    // 显示标题
-    sdcard_label = lv_label_create(sdcard_title);
-    lv_label_set_text(sdcard_label, "TF卡扫描中...");
-    lv_obj_set_style_text_color(sdcard_label, lv_color_hex(0xffffff), 0);
-    lv_obj_set_style_text_font(sdcard_label, &font_alipuhui20, 0);
-    lv_obj_align(sdcard_label, LV_ALIGN_CENTER, 0, 0);
-
-    icon_flag = 3; // 标记已经进入第三个应用
-    // 启动后台任务 task_process_sdcard
-    xTaskCreatePinnedToCore(task_process_sdcard, "task_process_sdcard", 3 * 1024, NULL, 5, NULL, 1);
+    ai_no_music();
 }
 
-/******************************** 第4个图标 摄像头 应用程序 *****************************************************************************/
-lv_obj_t *img_camera;
-
-// 摄像头图像
-lv_img_dsc_t img_camera_dsc = {
-    .header.cf = LV_IMG_CF_TRUE_COLOR,
-    .header.always_zero = 0,
-    .header.reserved = 0,
-    .header.w = 320,
-    .header.h = 240,
-    .data_size = 240 * 320 * 2,
-};
-
-// 摄像头处理任务
-static volatile bool s_capture_requested = false;
-
-static bool save_frame_as_bmp(const char *path, const camera_fb_t *frame)
+void ai_resume(void)
 {
-    if (!frame) return false;
-
-    uint8_t *bmp_buf = NULL;
-    size_t bmp_len = 0;
-    bool ret = fmt2bmp(frame->buf,
-                             frame->len,
-                             frame->width,
-                             frame->height,
-                             frame->format,   // 这里传 PIXFORMAT_RGB565
-                             &bmp_buf,
-                             &bmp_len
-                            );
-    if (!ret) {
-        ESP_LOGE(TAG, "fmt2bmp failed");
-        return false;
-    }
-
-    FILE *f = fopen(path, "wb");
-    if (!f) {
-        ESP_LOGE(TAG, "Open bmp fail %s", path);
-        free(bmp_buf);
-        return false;
-    }
-    fwrite(bmp_buf, 1, bmp_len, f);
-    fclose(f);
-    free(bmp_buf);
-    return true;
+    ai_no_music();
 }
 
-static void task_process_camera(void *arg)
+void ai_prev_music(void)
 {
-    while (icon_flag == 4)
-    {
-        camera_fb_t *frame = esp_camera_fb_get();
-        if(!frame)
-        {
-            ESP_LOGE(TAG, "Camera get failed");
-            vTaskDelay(10 / portTICK_PERIOD_MS);
-            continue;
-        }
-        // 如果请求拍照 则保存当前帧为图片
-        if (s_capture_requested)
-        {
-            s_capture_requested = false;
-            char path[128];
-            time_t now = time(NULL);
-            sniprintf(path,sizeof(path),"%s/photo/pic_%02d%02d_%02d%02d%02d.bmp",
-                    SD_MOUNT_POINT,
-                      localtime(&now)->tm_mon + 1,
-                      localtime(&now)->tm_mday,
-                      localtime(&now)->tm_hour,
-                      localtime(&now)->tm_min,
-                      localtime(&now)->tm_sec);
-
-            if (!save_frame_as_bmp(path, frame)) {
-                ESP_LOGE(TAG, "Save BMP failed");
-            } else {
-                ESP_LOGI(TAG, "Picture saved to %s", path);
-            }
-        }
-        img_camera_dsc.data = frame->buf;
-        lvgl_port_lock(0);
-        lv_img_set_src(img_camera, &img_camera_dsc);
-        lvgl_port_unlock();
-        esp_camera_fb_return(frame);
-
-    }
-// 退出任务把原本的东西放进btn中
-
-    esp_camera_deinit(); // 取消初始化摄像头
-    lvgl_port_lock(0);
-    lv_obj_del(icon_in_obj); // 删除摄像头画布
-    lvgl_port_unlock();
-    dvp_pwdn(1); // 摄像头进入掉电模式
-
-    vTaskDelete(NULL);
-
+    ai_no_music();
 }
 
-// 返回主界面按钮事件处理函数
-//lvgl任务，如果在这这里面删除，可能上面会的task_camera还在运行，导致冲突崩溃
-
-static void btn_camback_cb(lv_event_t *e)
+void ai_next_music(void)
 {
-    icon_flag = 0;
-}
-// 拍摄界面按钮处理函数
-static void btn_capture_cb(lv_event_t *e)
-{
-    s_capture_requested = true;
+    ai_no_music();
 }
 
-// 进入摄像头应用
-static void camera_event_handler(lv_event_t *e)
+void ai_seek(uint32_t position_ms)
 {
-    bsp_camera_init(); // 摄像头初始化
-    // 创建一个界面对象
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0xcccccc));
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    icon_in_obj = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(icon_in_obj, &style, 0);
-
-    img_camera = lv_img_create(icon_in_obj);
-    lv_obj_set_pos(img_camera, 0, 0);
-    lv_obj_set_size(img_camera, 320, 240);
-
-    // 创建返回按钮
-    lv_obj_t *btn_back = lv_btn_create(icon_in_obj);
-    lv_obj_align(btn_back, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_obj_set_size(btn_back, 60, 30);
-    lv_obj_set_style_border_width(btn_back, 0, 0);                         // 设置边框宽度
-    lv_obj_set_style_pad_all(btn_back, 0, 0);                              // 设置间隙
-    lv_obj_set_style_bg_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);        // 背景透明
-    lv_obj_set_style_shadow_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);    // 阴影透明
-    lv_obj_add_event_cb(btn_back, btn_camback_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
-
-    lv_obj_t *label_back = lv_label_create(btn_back);
-    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
-    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_back, lv_color_hex(0xffffff), 0);
-    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
-
-    // 创建拍摄按钮
-    static lv_style_t style_cap;
-    static lv_style_t style_cap_pr;
-    static bool style_cap_inited = false;
-    if (!style_cap_inited)
-    {
-        style_cap_inited = true;
-        lv_style_init(&style_cap);
-        lv_style_set_radius(&style_cap, 25);
-        lv_style_set_bg_color(&style_cap, lv_color_hex(0x000000));
-        lv_style_set_bg_opa(&style_cap, LV_OPA_40);
-        lv_style_set_border_width(&style_cap, 2);
-        lv_style_set_border_color(&style_cap, lv_color_hex(0xffffff));
-        lv_style_set_shadow_width(&style_cap, 12);
-        lv_style_set_shadow_color(&style_cap, lv_color_hex(0x000000));
-        lv_style_set_shadow_opa(&style_cap, LV_OPA_40);
-
-        lv_style_init(&style_cap_pr);
-        lv_style_set_bg_color(&style_cap_pr, lv_color_hex(0xffffff));
-        lv_style_set_bg_opa(&style_cap_pr, LV_OPA_60);
-        lv_style_set_border_color(&style_cap_pr, lv_color_hex(0x000000));
-    }
-
-    lv_obj_t *btn_capture = lv_btn_create(icon_in_obj);
-    lv_obj_align(btn_capture, LV_ALIGN_BOTTOM_MID, 0, -6);
-    lv_obj_set_size(btn_capture, 56, 56);
-    lv_obj_add_style(btn_capture, &style_cap, LV_STATE_DEFAULT);
-    lv_obj_add_style(btn_capture, &style_cap_pr, LV_STATE_PRESSED);
-    lv_obj_clear_flag(btn_capture, LV_OBJ_FLAG_CHECKABLE);
-    lv_obj_add_event_cb(btn_capture, btn_capture_cb, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *label_capture = lv_label_create(btn_capture);
-
-    lv_label_set_text(label_capture, LV_SYMBOL_LOOP); // 循环符号
-    lv_obj_set_style_text_font(label_capture, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_capture, lv_color_hex(0xffffff), 0);
-    lv_obj_center(label_capture);
-
-    icon_flag = 4; // 标记已经进入第四个应用
-
-    xTaskCreatePinnedToCore(task_process_camera, "task_process_camera", 4 * 1024, NULL, 5, NULL, 1);
+    ai_no_music();
 }
 
-/******************************** 第5个图标 WiFi设置 应用程序*****************************************************************************/
-
-lv_obj_t *wifi_scan_page;     // wifi扫描页面 obj
-lv_obj_t *wifi_password_page; // wifi密码页面 obj
-lv_obj_t *wifi_connect_page;  // wifi连接页面 obj
-lv_obj_t *obj_scan_title;     // wifi扫描页面标题
-lv_obj_t *label_wifi_scan;    // wif扫描页面 label
-lv_obj_t *wifi_list;          // wifi列表  list
-lv_obj_t *label_wifi_connect; // wifi连接页面label
-lv_obj_t *ta_pass_text;       // 密码输入文本框 textarea
-lv_obj_t *roller_num;         // 数字roller
-lv_obj_t *roller_letter_low;  // 小写字母roller
-lv_obj_t *roller_letter_up;   // 大写字母roller
-lv_obj_t *label_wifi_name;    // wifi名称label
-
-#define DEFAULT_SCAN_LIST_SIZE 5 // 最大扫描wifi个数
-
-// wifi事件组
-static EventGroupHandle_t s_wifi_event_group = NULL;
-// wifi事件
-#define WIFI_CONNECTED_BIT BIT0
-#define WIFI_FAIL_BIT BIT1
-#define WIFI_START_BIT BIT2
-#define WIFI_GET_SNTP_BIT BIT3
-// wifi最大重连次数
-#define EXAMPLE_ESP_MAXIMUM_RETRY 3
-
-// wifi账号队列
-static QueueHandle_t xQueueWifiAccount = NULL;
-// 队列要传输的内容
-typedef struct
-{
-    char wifi_ssid[32];     // 获取wifi名称
-    char wifi_password[64]; // 获取wifi密码
-    char back_flag;         // 是否退出
-} wifi_account_t;
-
-// 密码roller的遮罩显示效果
-static void mask_event_cb(lv_event_t *e)
+void ai_volume_set(int volume)
 {
-    lv_event_code_t code = lv_event_get_code(e);
-    lv_obj_t *obj = lv_event_get_target(e);
-
-    static int16_t mask_top_id = -1;
-    static int16_t mask_bottom_id = -1;
-
-    if (code == LV_EVENT_COVER_CHECK)
-    {
-        lv_event_set_cover_res(e, LV_COVER_RES_MASKED);
-    }
-    else if (code == LV_EVENT_DRAW_MAIN_BEGIN)
-    {
-        /* add mask */
-        const lv_font_t *font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
-        lv_coord_t line_space = lv_obj_get_style_text_line_space(obj, LV_PART_MAIN);
-        lv_coord_t font_h = lv_font_get_line_height(font);
-
-        lv_area_t roller_coords;
-        lv_obj_get_coords(obj, &roller_coords);
-
-        lv_area_t rect_area;
-        rect_area.x1 = roller_coords.x1;
-        rect_area.x2 = roller_coords.x2;
-        rect_area.y1 = roller_coords.y1;
-        rect_area.y2 = roller_coords.y1 + (lv_obj_get_height(obj) - font_h - line_space) / 2;
-
-        lv_draw_mask_fade_param_t *fade_mask_top = lv_mem_buf_get(sizeof(lv_draw_mask_fade_param_t));
-        lv_draw_mask_fade_init(fade_mask_top, &rect_area, LV_OPA_TRANSP, rect_area.y1, LV_OPA_COVER, rect_area.y2);
-        mask_top_id = lv_draw_mask_add(fade_mask_top, NULL);
-
-        rect_area.y1 = rect_area.y2 + font_h + line_space - 1;
-        rect_area.y2 = roller_coords.y2;
-
-        lv_draw_mask_fade_param_t *fade_mask_bottom = lv_mem_buf_get(sizeof(lv_draw_mask_fade_param_t));
-        lv_draw_mask_fade_init(fade_mask_bottom, &rect_area, LV_OPA_COVER, rect_area.y1, LV_OPA_TRANSP, rect_area.y2);
-        mask_bottom_id = lv_draw_mask_add(fade_mask_bottom, NULL);
-    }
-    else if (code == LV_EVENT_DRAW_POST_END)
-    {
-        lv_draw_mask_fade_param_t *fade_mask_top = lv_draw_mask_remove_id(mask_top_id);
-        lv_draw_mask_fade_param_t *fade_mask_bottom = lv_draw_mask_remove_id(mask_bottom_id);
-        lv_draw_mask_free_param(fade_mask_top);
-        lv_draw_mask_free_param(fade_mask_bottom);
-        lv_mem_buf_release(fade_mask_top);
-        lv_mem_buf_release(fade_mask_bottom);
-        mask_top_id = -1;
-        mask_bottom_id = -1;
-    }
+    ai_no_music();
 }
 
-// 数字键 处理函数
-static void btn_num_cb(lv_event_t *e)
+void ai_volume_up(void)
 {
-    lv_event_code_t code = lv_event_get_code(e);
-
-    if (code == LV_EVENT_CLICKED)
-    {
-        ESP_LOGI(TAG, "Btn-Num Clicked");
-        char buf[2]; // 接收roller的值
-        lv_roller_get_selected_str(roller_num, buf, sizeof(buf));
-        lv_textarea_add_text(ta_pass_text, buf);
-    }
+    ai_no_music();
 }
 
-// 小写字母确认键 处理函数
-static void btn_letter_low_cb(lv_event_t *e)
+void ai_volume_down(void)
 {
-    lv_event_code_t code = lv_event_get_code(e);
-
-    if (code == LV_EVENT_CLICKED)
-    {
-        ESP_LOGI(TAG, "Btn-Letter-Low Clicked");
-        char buf[2]; // 接收roller的值
-        lv_roller_get_selected_str(roller_letter_low, buf, sizeof(buf));
-        lv_textarea_add_text(ta_pass_text, buf);
-    }
+    ai_no_music();
 }
 
-// 大写字母确认键 处理函数
-static void btn_letter_up_cb(lv_event_t *e)
+void ai_play_file(const char *path)
 {
-    lv_event_code_t code = lv_event_get_code(e);
-
-    if (code == LV_EVENT_CLICKED)
-    {
-        ESP_LOGI(TAG, "Btn-Letter-Up Clicked");
-        char buf[2]; // 接收roller的值
-        lv_roller_get_selected_str(roller_letter_up, buf, sizeof(buf));
-        lv_textarea_add_text(ta_pass_text, buf);
-    }
+    ai_no_music();
 }
+#endif
 
-static void lv_wifi_connect(void)
-{
-    lv_obj_del(wifi_password_page); // 删除密码输入界面
-
-    // 创建一个面板对象
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_radius(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    wifi_connect_page = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(wifi_connect_page, &style, 0);
-
-    // 绘制label提示
-    label_wifi_connect = lv_label_create(wifi_connect_page);
-    lv_label_set_text(label_wifi_connect, "WLAN连接中...");
-    lv_obj_set_style_text_font(label_wifi_connect, &font_alipuhui20, 0);
-    lv_obj_align(label_wifi_connect, LV_ALIGN_CENTER, 0, -50);
-}
+// 录音时右上角一直显示时长 哪个界面都在 停了或者卡拔了自己消失
+static lv_obj_t *s_memo_label = NULL;
+static lv_timer_t *s_memo_timer = NULL;
 
-// WiFi连接按钮 处理函数
-static void btn_connect_cb(lv_event_t *e)
+static void memo_label_close(void)
 {
-    lv_event_code_t code = lv_event_get_code(e);
-
-    if (code == LV_EVENT_CLICKED)
-    {
-        ESP_LOGI(TAG, "OK Clicked");
-        const char *wifi_ssid = lv_label_get_text(label_wifi_name);
-        const char *wifi_password = lv_textarea_get_text(ta_pass_text);
-        if (*wifi_password != '\0') // 判断是否为空字符串
-        {
-            wifi_account_t wifi_account;
-            strcpy(wifi_account.wifi_ssid, wifi_ssid);
-            strcpy(wifi_account.wifi_password, wifi_password);
-            ESP_LOGI(TAG, "connected to ap SSID:%s password:%s",
-                     wifi_account.wifi_ssid, wifi_account.wifi_password);
-            wifi_account.back_flag = 0; // 正常连接
-            lv_wifi_connect();          // 显示wifi连接界面
-            // 发送WiFi账号密码信息到队列
-            xQueueSend(xQueueWifiAccount, &wifi_account, portMAX_DELAY);
-        }
+    if (s_memo_timer) {
+        lv_timer_del(s_memo_timer);
+        s_memo_timer = NULL;
     }
-}
-
-// 删除密码按钮
-static void btn_del_cb(lv_event_t *e)
-{
-    lv_event_code_t code = lv_event_get_code(e);
-
-    if (code == LV_EVENT_CLICKED)
-    {
-        ESP_LOGI(TAG, "Clicked");
-        lv_textarea_del_char(ta_pass_text);
+    if (s_memo_label) {
+        lv_obj_del(s_memo_label);
+        s_memo_label = NULL;
     }
 }
 
-// 返回按钮
-static void btn_back_cb(lv_event_t *e)
+static void memo_timer_cb(lv_timer_t *timer)
 {
-    lv_event_code_t code = lv_event_get_code(e);
-
-    if (code == LV_EVENT_CLICKED)
-    {
-        ESP_LOGI(TAG, "btn_back Clicked");
-        lv_obj_del(wifi_password_page); // 删除密码输入界面
+    if (!voice_memo_active()) {
+        memo_label_close();
+        return;
     }
+    voice_memo_stats_t st;
+    voice_memo_get_stats(&st);
+    uint32_t s = st.samples / VOICE_MEMO_RATE;
+    lv_label_set_text_fmt(s_memo_label, "REC %lu:%02lu:%02lu", (unsigned long)(s / 3600),
+                          (unsigned long)(s / 60 % 60), (unsigned long)(s % 60));
 }
 
-// 进入输入密码界面
-static void list_btn_cb(lv_event_t *e)
+void ai_memo_start(void)
 {
-    // 获取点击到的WiFi名称
-    const char *wifi_name = NULL;
-    lv_event_code_t code = lv_event_get_code(e);
-    lv_obj_t *obj = lv_event_get_target(e);
-    if (code == LV_EVENT_CLICKED)
-    {
-        wifi_name = lv_list_get_btn_text(wifi_list, obj);
-        ESP_LOGI(TAG, "WLAN Name: %s", wifi_name);
+    if (voice_memo_active() || voice_memo_start() != ESP_OK) {
+        return;
     }
-
-    // 创建密码输入页面
-    wifi_password_page = lv_obj_create(lv_scr_act());
-    lv_obj_set_size(wifi_password_page, 320, 240);
-    lv_obj_set_style_border_width(wifi_password_page, 0, 0); // 设置边框宽度
-    lv_obj_set_style_pad_all(wifi_password_page, 0, 0);      // 设置间隙
-    lv_obj_set_style_radius(wifi_password_page, 0, 0);       // 设置圆角
-
-    // 创建返回按钮
-    lv_obj_t *btn_back = lv_btn_create(wifi_password_page);
-    lv_obj_align(btn_back, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_obj_set_size(btn_back, 60, 40);
-    lv_obj_set_style_border_width(btn_back, 0, 0);                      // 设置边框宽度
-    lv_obj_set_style_pad_all(btn_back, 0, 0);                           // 设置间隙
-    lv_obj_set_style_bg_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);     // 背景透明
-    lv_obj_set_style_shadow_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN); // 阴影透明
-    lv_obj_add_event_cb(btn_back, btn_back_cb, LV_EVENT_ALL, NULL);     // 添加按键处理函数
-
-    lv_obj_t *label_back = lv_label_create(btn_back);
-    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
-    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_back, lv_color_hex(0x000000), 0);
-    lv_obj_align(label_back, LV_ALIGN_TOP_LEFT, 10, 10);
-
-    // 显示选中的wifi名称
-    label_wifi_name = lv_label_create(wifi_password_page);
-    lv_obj_set_style_text_font(label_wifi_name, &lv_font_montserrat_20, 0);
-    lv_label_set_text(label_wifi_name, wifi_name);
-    lv_obj_align(label_wifi_name, LV_ALIGN_TOP_MID, 0, 10);
-
-    // 创建密码输入框
-    ta_pass_text = lv_textarea_create(wifi_password_page);
-    lv_obj_set_style_text_font(ta_pass_text, &lv_font_montserrat_20, 0);
-    lv_textarea_set_one_line(ta_pass_text, true);               // 一行显示
-    lv_textarea_set_password_mode(ta_pass_text, false);         // 是否使用密码输入显示模式
-    lv_textarea_set_placeholder_text(ta_pass_text, "password"); // 设置提醒词
-    lv_obj_set_width(ta_pass_text, 150);                        // 宽度
-    lv_obj_align(ta_pass_text, LV_ALIGN_TOP_LEFT, 10, 40);      // 位置
-    lv_obj_add_state(ta_pass_text, LV_STATE_FOCUSED);           // 显示光标
-
-    // 创建“连接按钮”
-    lv_obj_t *btn_connect = lv_btn_create(wifi_password_page);
-    lv_obj_align(btn_connect, LV_ALIGN_TOP_LEFT, 170, 40);
-    lv_obj_set_width(btn_connect, 65);                                    // 宽度
-    lv_obj_add_event_cb(btn_connect, btn_connect_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    lv_obj_t *label_ok = lv_label_create(btn_connect);
-    lv_label_set_text(label_ok, "OK");
-    lv_obj_set_style_text_font(label_ok, &lv_font_montserrat_20, 0);
-    lv_obj_center(label_ok);
-
-    // 创建“删除按钮”
-    lv_obj_t *btn_del = lv_btn_create(wifi_password_page);
-    lv_obj_align(btn_del, LV_ALIGN_TOP_LEFT, 245, 40);
-    lv_obj_set_width(btn_del, 65);                                // 宽度
-    lv_obj_add_event_cb(btn_del, btn_del_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    lv_obj_t *label_del = lv_label_create(btn_del);
-    lv_label_set_text(label_del, LV_SYMBOL_BACKSPACE);
-    lv_obj_set_style_text_font(label_del, &lv_font_montserrat_20, 0);
-    lv_obj_center(label_del);
-
-    // 创建roller样式
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_bg_color(&style, lv_color_black());
-    lv_style_set_text_color(&style, lv_color_white());
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_radius(&style, 0);
-
-    // 创建"数字"roller
-    const char *opts_num = "0\n1\n2\n3\n4\n5\n6\n7\n8\n9";
-
-    roller_num = lv_roller_create(wifi_password_page);
-    lv_obj_add_style(roller_num, &style, 0);
-    lv_obj_set_style_bg_opa(roller_num, LV_OPA_50, LV_PART_SELECTED);
-
-    lv_roller_set_options(roller_num, opts_num, LV_ROLLER_MODE_INFINITE);
-    lv_roller_set_visible_row_count(roller_num, 3);     // 显示3行
-    lv_roller_set_selected(roller_num, 5, LV_ANIM_OFF); // 默认选择
-    lv_obj_set_width(roller_num, 90);
-    lv_obj_set_style_text_font(roller_num, &lv_font_montserrat_20, 0);
-    lv_obj_align(roller_num, LV_ALIGN_BOTTOM_LEFT, 15, -53);
-    lv_obj_add_event_cb(roller_num, mask_event_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    // 创建"数字"roller 的确认键
-    lv_obj_t *btn_num_ok = lv_btn_create(wifi_password_page);
-    lv_obj_align(btn_num_ok, LV_ALIGN_BOTTOM_LEFT, 15, -10);         // 位置
-    lv_obj_set_width(btn_num_ok, 90);                                // 宽度
-    lv_obj_add_event_cb(btn_num_ok, btn_num_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    lv_obj_t *label_num_ok = lv_label_create(btn_num_ok);
-    lv_label_set_text(label_num_ok, LV_SYMBOL_OK);
-    lv_obj_set_style_text_font(label_num_ok, &lv_font_montserrat_20, 0);
-    lv_obj_center(label_num_ok);
-
-    // 创建"小写字母"roller
-    const char *opts_letter_low = "a\nb\nc\nd\ne\nf\ng\nh\ni\nj\nk\nl\nm\nn\no\np\nq\nr\ns\nt\nu\nv\nw\nx\ny\nz";
-
-    roller_letter_low = lv_roller_create(wifi_password_page);
-    lv_obj_add_style(roller_letter_low, &style, 0);
-    lv_obj_set_style_bg_opa(roller_letter_low, LV_OPA_50, LV_PART_SELECTED);            // 设置选中项的透明度
-    lv_roller_set_options(roller_letter_low, opts_letter_low, LV_ROLLER_MODE_INFINITE); // 循环滚动模式
-    lv_roller_set_visible_row_count(roller_letter_low, 3);
-    lv_roller_set_selected(roller_letter_low, 15, LV_ANIM_OFF); //
-    lv_obj_set_width(roller_letter_low, 90);
-    lv_obj_set_style_text_font(roller_letter_low, &lv_font_montserrat_20, 0);
-    lv_obj_align(roller_letter_low, LV_ALIGN_BOTTOM_LEFT, 115, -53);
-    lv_obj_add_event_cb(roller_letter_low, mask_event_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    // 创建"小写字母"roller的确认键
-    lv_obj_t *btn_letter_low_ok = lv_btn_create(wifi_password_page);
-    lv_obj_align(btn_letter_low_ok, LV_ALIGN_BOTTOM_LEFT, 115, -10);
-    lv_obj_set_width(btn_letter_low_ok, 90);                                       // 宽度
-    lv_obj_add_event_cb(btn_letter_low_ok, btn_letter_low_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    lv_obj_t *label_letter_low_ok = lv_label_create(btn_letter_low_ok);
-    lv_label_set_text(label_letter_low_ok, LV_SYMBOL_OK);
-    lv_obj_set_style_text_font(label_letter_low_ok, &lv_font_montserrat_20, 0);
-    lv_obj_center(label_letter_low_ok);
-
-    // 创建"大写字母"roller
-    const char *opts_letter_up = "A\nB\nC\nD\nE\nF\nG\nH\nI\nJ\nK\nL\nM\nN\nO\nP\nQ\nR\nS\nT\nU\nV\nW\nX\nY\nZ";
-
-    roller_letter_up = lv_roller_create(wifi_password_page);
-    lv_obj_add_style(roller_letter_up, &style, 0);
-    lv_obj_set_style_bg_opa(roller_letter_up, LV_OPA_50, LV_PART_SELECTED);           // 设置选中项的透明度
-    lv_roller_set_options(roller_letter_up, opts_letter_up, LV_ROLLER_MODE_INFINITE); // 循环滚动模式
-    lv_roller_set_visible_row_count(roller_letter_up, 3);
-    lv_roller_set_selected(roller_letter_up, 15, LV_ANIM_OFF);
-    lv_obj_set_width(roller_letter_up, 90);
-    lv_obj_set_style_text_font(roller_letter_up, &lv_font_montserrat_20, 0);
-    lv_obj_align(roller_letter_up, LV_ALIGN_BOTTOM_LEFT, 215, -53);
-    lv_obj_add_event_cb(roller_letter_up, mask_event_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    // 创建"大写字母"roller的确认键
-    lv_obj_t *btn_letter_up_ok = lv_btn_create(wifi_password_page);
-    lv_obj_align(btn_letter_up_ok, LV_ALIGN_BOTTOM_LEFT, 215, -10);
-    lv_obj_set_width(btn_letter_up_ok, 90);
-    lv_obj_add_event_cb(btn_letter_up_ok, btn_letter_up_cb, LV_EVENT_ALL, NULL); // 事件处理函数
-
-    lv_obj_t *label_letter_up_ok = lv_label_create(btn_letter_up_ok);
-    lv_label_set_text(label_letter_up_ok, LV_SYMBOL_OK);
-    lv_obj_set_style_text_font(label_letter_up_ok, &lv_font_montserrat_20, 0);
-    lv_obj_center(label_letter_up_ok);
+    s_memo_label = lv_label_create(lv_layer_top());
+    lv_obj_set_style_text_color(s_memo_label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_bg_color(s_memo_label, lv_color_hex(0xc00000), 0);
+    lv_obj_set_style_bg_opa(s_memo_label, LV_OPA_80, 0);
+    lv_obj_set_style_pad_all(s_memo_label, 4, 0);
+    lv_obj_set_style_radius(s_memo_label, 4, 0);
+    lv_label_set_text(s_memo_label, "REC 0:00:00");
+    lv_obj_align(s_memo_label, LV_ALIGN_TOP_RIGHT, -6, 6);
+    s_memo_timer = lv_timer_create(memo_timer_cb, 1000, NULL);
 }
 
-lv_obj_t *date_label;
-lv_obj_t *time_label;
-
-time_t now;
-struct tm timeinfo;
-
-// 更新时间函数
-void value_update_cb(lv_timer_t *timer)
-{
-    // 更新日期 星期 时分秒
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    lv_label_set_text_fmt(time_label, "%02d:%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-    lv_label_set_text_fmt(date_label, "%d年%02d月%02d日", timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
-}
-
-// 获得日期时间 任务函数
-static void get_time_task(void *pvParameters)
+void ai_memo_stop(void)
 {
-    xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-
-    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG("cn.pool.ntp.org");
-    esp_netif_sntp_init(&config);
-    // wait for time to be set
-    int retry = 0;
-    // const int retry_count = 6;
-    while (esp_netif_sntp_sync_wait(2000 / portTICK_PERIOD_MS) == ESP_ERR_TIMEOUT)
-    {
-        ESP_LOGI(TAG, "Waiting for system time to be set... (%d)", retry++);
+    if (voice_memo_active()) {
+        voice_memo_stop();
     }
-
-    esp_netif_sntp_deinit();
-    // 设置时区
-    setenv("TZ", "CST-8", 1);
-    tzset();
-    // 获取系统时间
-    time(&now);
-    localtime_r(&now, &timeinfo);
-
-    lvgl_port_lock(0);
-    lv_obj_del(main_text_label); // 删除主页的欢迎语
-    // 显示年月日
-    date_label = lv_label_create(main_obj);
-    lv_obj_set_style_text_font(date_label, &font_alipuhui20, 0);
-    lv_obj_set_style_text_color(date_label, lv_color_hex(0xffffff), 0);
-    lv_label_set_text_fmt(date_label, "%d年%02d月%02d日", timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
-    lv_obj_align(date_label, LV_ALIGN_TOP_LEFT, 10, 5);
-
-    // 显示时间  小时:分钟:秒钟
-    time_label = lv_label_create(main_obj);
-    lv_obj_set_style_text_font(time_label, &font_alipuhui20, 0);
-    lv_obj_set_style_text_color(time_label, lv_color_hex(0xffffff), 0);
-    lv_label_set_text_fmt(time_label, "%02d:%02d:%02d", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-    lv_obj_align_to(time_label, date_label, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
-    lvgl_port_unlock();
-
-    xEventGroupSetBits(s_wifi_event_group, WIFI_GET_SNTP_BIT);
-
-    lv_timer_create(value_update_cb, 1000, NULL); // 创建一个lv_timer 每秒更新一次时间
-
-    vTaskDelete(NULL);
+    memo_label_close();
 }
 
-// 网络连接 事件处理函数
-static void event_handler(void *arg, esp_event_base_t event_base,
-                          int32_t event_id, void *event_data)
+// 和点主界面上的图标一样 已经在某个应用里就不理
+static void ai_open(int id)
 {
-    static int s_retry_num = 0;
-
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
-    {
-        xEventGroupSetBits(s_wifi_event_group, WIFI_START_BIT);
-    }
-    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
-    {
-        if (s_retry_num < EXAMPLE_ESP_MAXIMUM_RETRY)
-        {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "retry to connect to the AP");
-        }
-        else
-        {
-            xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-        }
-        ESP_LOGI(TAG, "connect to the AP fail");
-    }
-    else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
-    {
-        ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    if (icon_flag != 0) {
+        ESP_LOGI(TAG, "voice: app %d is open, say exit first", icon_flag);
+        return;
     }
-}
-
-esp_event_handler_instance_t instance_any_id;
-esp_event_handler_instance_t instance_got_ip;
-esp_netif_t *sta_netif = NULL;
-
-// 扫描附近wifi
-static void wifi_scan(wifi_ap_record_t ap_info[], uint16_t *ap_number)
-{
-    s_wifi_event_group = xEventGroupCreate();
-
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    sta_netif = esp_netif_create_default_wifi_sta();
-    assert(sta_netif);
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &event_handler,
-                                                        NULL,
-                                                        &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &event_handler,
-                                                        NULL,
-                                                        &instance_got_ip));
-
-    uint16_t ap_count = 0;
-
-    memset(ap_info, 0, *ap_number * sizeof(wifi_ap_record_t));
-
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    esp_wifi_scan_start(NULL, true);
-
-    ESP_LOGI(TAG, "Max AP number ap_info can hold = %u", *ap_number);
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&ap_count));              // 获取扫描到的wifi数量
-    ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(ap_number, ap_info)); // 获取真实的获取到wifi数量和信息
-    ESP_LOGI(TAG, "Total APs scanned = %u, actual AP number ap_info holds = %u", ap_count, *ap_number);
-}
-
-// 清除wifi初始化内容
-static void wifiset_deinit(void)
-{
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &instance_got_ip));
-    esp_err_t err = esp_wifi_stop();
-    if (err == ESP_ERR_WIFI_NOT_INIT)
-    {
+    const app_mod_t *app = app_find(id);
+    if (app == NULL) {
+        ESP_LOGI(TAG, "voice: app %d not built", id);
         return;
     }
-    ESP_ERROR_CHECK(err);
-    ESP_ERROR_CHECK(esp_wifi_deinit());
-    ESP_ERROR_CHECK(esp_wifi_clear_default_wifi_driver_and_handlers(sta_netif));
-    esp_netif_destroy(sta_netif);
-    sta_netif = NULL;
-    ESP_ERROR_CHECK(esp_event_loop_delete_default());
+    app_open(app, NULL);
 }
 
-// WIFI连接任务
-static void wifi_connect(void *arg)
+int ai_app_id(const char *name)
 {
-    wifi_account_t wifi_account;
-
-    while (true)
-    {
-        // 如果收到wifi账号队列消息
-        if (xQueueReceive(xQueueWifiAccount, &wifi_account, portMAX_DELAY))
-        {
-            if (wifi_account.back_flag == 1)
-            {          // 退出任务标志
-                break; // 跳出while循环
-            }
-
-            wifi_config_t wifi_config = {
-                .sta = {
-                    .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-                    .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
-                    .sae_h2e_identifier = "",
-                },
-            };
-            strcpy((char *)wifi_config.sta.ssid, wifi_account.wifi_ssid);
-            strcpy((char *)wifi_config.sta.password, wifi_account.wifi_password);
-            ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-            esp_wifi_connect();
-            /* Waiting until either the connection is established (WIFI_CONNECTED_BIT) or connection failed for the maximum
-             * number of re-tries (WIFI_FAIL_BIT). The bits are set by event_handler() (see above) */
-            EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                                   WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                                   pdFALSE,
-                                                   pdFALSE,
-                                                   portMAX_DELAY);
-
-            /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually
-             * happened. */
-            if (bits & WIFI_CONNECTED_BIT)
-            {
-                ESP_LOGI(TAG, "connected to ap SSID:%s password:%s", wifi_config.sta.ssid, wifi_config.sta.password);
-                lvgl_port_lock(0);
-                lv_label_set_text(label_wifi_connect, "WLAN 连接成功");
-                lvgl_port_unlock();
-                vTaskDelay(1000 / portTICK_PERIOD_MS); // 给上面的显示一点时间
-                lvgl_port_lock(0);
-                lv_obj_del(wifi_connect_page); // 删除此页面
-                lv_obj_del(wifi_scan_page);    // 删除此页面
-                lvgl_port_unlock();
-                vQueueDelete(xQueueWifiAccount);                                                     // 删除队列
-                icon_flag = 0;                                                                       // 标记回到主界面
-                xTaskCreatePinnedToCore(get_time_task, "get_time_task", 2 * 1024, NULL, 5, NULL, 0); // 创建获取时间任务
-                break;                                                                               // 跳出while循环删除任务
-            }
-            else if (bits & WIFI_FAIL_BIT)
-            {
-                ESP_LOGI(TAG, "Failed to connect to SSID:%s, password:%s", wifi_config.sta.ssid, wifi_config.sta.password);
-                lvgl_port_lock(0);
-                lv_label_set_text(label_wifi_connect, "WLAN 连接失败");
-                lvgl_port_unlock();
-                vTaskDelay(1000 / portTICK_PERIOD_MS); // 给上面的显示一点时间
-                lvgl_port_lock(0);
-                lv_obj_del(wifi_connect_page); // 删除此页面
-                lvgl_port_unlock();
-                xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT); // 清除此事件标志位
-            }
-            else
-            {
-                ESP_LOGE(TAG, "UNEXPECTED EVENT");
-                lvgl_port_lock(0);
-                lv_label_set_text(label_wifi_connect, "WLAN 连接异常");
-                lvgl_port_unlock();
-                vTaskDelay(1000 / portTICK_PERIOD_MS); // 给上面的显示一点时间
-                lvgl_port_lock(0);
-                lv_obj_del(wifi_connect_page); // 删除此页面
-                lv_obj_del(wifi_scan_page);    // 删除此页面
-                lvgl_port_unlock();
-                wifiset_deinit(); // 清除wifi初始化
-            }
+    for (int i = 0; i < APP_COUNT; i++) {
+        if (strcmp(s_apps[i]->name, name) == 0) {
+            return s_apps[i]->id;
         }
     }
-    vTaskDelete(NULL);
+    return 0;
 }
 
-// 返回主界面按钮事件处理函数
-static void btn_backmain_cb(lv_event_t *e)
+void ai_open_app(int id)
 {
-    ESP_LOGI(TAG, "btn_backmain Clicked");
-
-    // // 删除wifi扫描界面
-    lvgl_port_lock(0);
-    lv_obj_del(wifi_scan_page);
-    lvgl_port_unlock();
-
-    // 通知wifi_connect任务退出
-    wifi_account_t wifi_account;
-    wifi_account.back_flag = 1;
-    xQueueSend(xQueueWifiAccount, &wifi_account, portMAX_DELAY);
-
-    wifiset_deinit();                // 清除wifi扫描痕迹
-    vQueueDelete(xQueueWifiAccount); // 删除队列
-    icon_flag = 0;
+    ai_open(id);
 }
 
-// wifi连接
-void app_wifi_connect(void *arg)
+void ai_open_icon1(void)
 {
-    vTaskDelay(200 / portTICK_PERIOD_MS);
-    // 扫描WLAN信息
-    wifi_ap_record_t ap_info[DEFAULT_SCAN_LIST_SIZE]; // 记录扫描到的wifi信息
-    uint16_t ap_number = DEFAULT_SCAN_LIST_SIZE;
-    wifi_scan(ap_info, &ap_number); // 扫描附近wifi
-
-    lvgl_port_lock(0);
-    // 修改标题
-    lv_label_set_text_fmt(label_wifi_scan, "%d WLAN", ap_number);
-
-    // 创建返回按钮
-    lv_obj_t *btn_back = lv_btn_create(obj_scan_title);
-    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
-    lv_obj_set_size(btn_back, 60, 30);
-    lv_obj_set_style_border_width(btn_back, 0, 0);                          // 设置边框宽度
-    lv_obj_set_style_pad_all(btn_back, 0, 0);                               // 设置间隙
-    lv_obj_set_style_bg_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);         // 背景透明
-    lv_obj_set_style_shadow_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);     // 阴影透明
-    lv_obj_add_event_cb(btn_back, btn_backmain_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
-
-    lv_obj_t *label_back = lv_label_create(btn_back);
-    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
-    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_back, lv_color_hex(0xffffff), 0);
-    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
-
-    // 创建wifi信息列表
-    wifi_list = lv_list_create(wifi_scan_page);
-    lv_obj_set_size(wifi_list, 320, 200);
-    lv_obj_align(wifi_list, LV_ALIGN_TOP_LEFT, 0, 40);
-    lv_obj_set_style_border_width(wifi_list, 0, 0);
-    lv_obj_set_style_text_font(wifi_list, &font_alipuhui20, 0);
-    lv_obj_set_scrollbar_mode(wifi_list, LV_SCROLLBAR_MODE_OFF); // 隐藏wifi_list滚动条
-    // 显示wifi信息
-    lv_obj_t *btn;
-    for (int i = 0; i < ap_number; i++)
-    {
-        ESP_LOGI(TAG, "SSID \t\t%s", ap_info[i].ssid); // 终端输出wifi名称
-        ESP_LOGI(TAG, "RSSI \t\t%d", ap_info[i].rssi); // 终端输出wifi信号质量
-        // 添加wifi列表
-        btn = lv_list_add_btn(wifi_list, LV_SYMBOL_WIFI, (const char *)ap_info[i].ssid);
-        lv_obj_add_event_cb(btn, list_btn_cb, LV_EVENT_CLICKED, NULL); // 添加点击回调函数
-    }
-    lvgl_port_unlock();
-
-    // 创建wifi连接任务
-    xQueueWifiAccount = xQueueCreate(2, sizeof(wifi_account_t));
-    xTaskCreatePinnedToCore(wifi_connect, "wifi_connect", 4 * 1024, NULL, 5, NULL, 1); // 创建wifi连接任务
-    vTaskDelete(NULL);
+    ai_open(1);
 }
 
-//  任务函数
-static void wifiset_tips_task(void *pvParameters)
+void ai_open_icon2(void)
 {
-    // 显示扫描情况
-    lvgl_port_lock(0);
-    label_wifi_scan = lv_label_create(wifi_scan_page);
-    lv_label_set_text(label_wifi_scan, "WLAN 已连接");
-    lv_obj_set_style_text_color(label_wifi_scan, lv_color_hex(0x000000), 0);
-    lv_obj_set_style_text_font(label_wifi_scan, &font_alipuhui20, 0);
-    lv_obj_align(label_wifi_scan, LV_ALIGN_CENTER, 0, -50);
-    lvgl_port_unlock();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
-    lvgl_port_lock(0);
-    lv_obj_del(wifi_scan_page);
-    lvgl_port_unlock();
-
-    vTaskDelete(NULL);
+    ai_open(2);
 }
 
-// 进入WIFI设置应用
-static void wifiset_event_handler(lv_event_t *e)
+void ai_open_icon3(void)
 {
-    // 创建一个界面对象
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0xFFFFFF));
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    wifi_scan_page = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(wifi_scan_page, &style, 0);
-
-    // 判断wifi是否已连接
-    int isconnect_flag = 1;
-    if (s_wifi_event_group != NULL) // 如果创建了此事件组
-    {
-        // 查看是否已经连接wifi
-        EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, 10);
-        if (bits & WIFI_CONNECTED_BIT)
-        { // 如果已经连接到wifi
-            xTaskCreatePinnedToCore(wifiset_tips_task, "wifiset_tips_task", 2048, NULL, 5, NULL, 0);
-        }
-        else
-        {
-            isconnect_flag = 0;
-        }
-    }
-    if (s_wifi_event_group == NULL || isconnect_flag == 0) // 没有连接到wifi
-    {
-        // 创建标题背景
-        obj_scan_title = lv_obj_create(wifi_scan_page);
-        lv_obj_set_size(obj_scan_title, 320, 40);
-        lv_obj_set_style_pad_all(obj_scan_title, 0, 0); // 设置间隙
-        lv_obj_align(obj_scan_title, LV_ALIGN_TOP_LEFT, 0, 0);
-        lv_obj_set_style_bg_color(obj_scan_title, lv_color_hex(0x008b8b), 0);
-        // 显示扫描情况
-        label_wifi_scan = lv_label_create(obj_scan_title);
-        lv_label_set_text(label_wifi_scan, "WLAN扫描中...");
-        lv_obj_set_style_text_color(label_wifi_scan, lv_color_hex(0xffffff), 0);
-        lv_obj_set_style_text_font(label_wifi_scan, &font_alipuhui20, 0);
-        lv_obj_align(label_wifi_scan, LV_ALIGN_CENTER, 0, 0);
-
-        icon_flag = 5; // 标记已经进入第5个应用
-
-        xTaskCreatePinnedToCore(app_wifi_connect, "app_wifi_connect", 4 * 1024, NULL, 5, NULL, 0);
-    }
+    ai_open(3);
 }
 
-/******************************** 第6个图标 蓝牙设置 应用程序***********************************************************************************/
-lv_obj_t *ble_label;
-lv_obj_t *btn_ble_back;
-
-// 返回主界面按钮事件处理函数
-static void btn_ble_back_cb(lv_event_t *e)
+void ai_open_icon4(void)
 {
-    bt_hid_end();
-    lv_obj_del(icon_in_obj);
-    icon_flag = 0;
+    ai_open(4);
 }
 
-// 进入蓝牙设置应用
-static void btset_event_handler(lv_event_t *e)
+void ai_open_icon5(void)
 {
-    // 创建一个界面对象
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0xffffff));
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    icon_in_obj = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(icon_in_obj, &style, 0);
-
-    // 创建标题背景
-    lv_obj_t *ble_title = lv_obj_create(icon_in_obj);
-    lv_obj_set_size(ble_title, 320, 40);
-    lv_obj_set_style_pad_all(ble_title, 0, 0); // 设置间隙
-    lv_obj_align(ble_title, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_obj_set_style_bg_color(ble_title, lv_color_hex(0xb87fa8), 0);
-    // 显示标题
-    ble_label = lv_label_create(ble_title);
-    lv_label_set_text(ble_label, "蓝牙控制器");
-    lv_obj_set_style_text_color(ble_label, lv_color_hex(0xffffff), 0);
-    lv_obj_set_style_text_font(ble_label, &font_alipuhui20, 0);
-    lv_obj_align(ble_label, LV_ALIGN_CENTER, 0, 0);
-    // 创建后退按钮
-    btn_ble_back = lv_btn_create(ble_title);
-    lv_obj_align(btn_ble_back, LV_ALIGN_LEFT_MID, 0, 0);
-    lv_obj_set_size(btn_ble_back, 60, 30);
-    lv_obj_set_style_border_width(btn_ble_back, 0, 0);                          // 设置边框宽度
-    lv_obj_set_style_pad_all(btn_ble_back, 0, 0);                               // 设置间隙
-    lv_obj_set_style_bg_opa(btn_ble_back, LV_OPA_TRANSP, LV_PART_MAIN);         // 背景透明
-    lv_obj_set_style_shadow_opa(btn_ble_back, LV_OPA_TRANSP, LV_PART_MAIN);     // 阴影透明
-    lv_obj_add_event_cb(btn_ble_back, btn_ble_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
-
-    lv_obj_t *label_back = lv_label_create(btn_ble_back);
-    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
-    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_back, lv_color_hex(0xffffff), 0);
-    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
-
-    app_hid_ctrl();
-
-    icon_flag = 6; // 标记已经进入第6个应用
+    ai_open(5);
 }
 
-/******************************** 第7个图标 图库设置 应用程序***********************************************************************************/
-lv_obj_t *pic_title_label;
-lv_obj_t *btn_pic_back;
-lv_obj_t *img_in_obj;
-static char g_img_path[128];
-static char g_lv_img_path[140];
-
-#define LVGL_STDIO_DRIVE "A:"
-
-static void set_img_src_from_fs_path(const char *fs_path)
+void ai_open_icon6(void)
 {
-    if (!fs_path || fs_path[0] == '\0') {
-        return;
-    }
-    /* Build LVGL path with stdio drive letter so LVGL can open the file */
-    lv_snprintf(g_lv_img_path, sizeof(g_lv_img_path), LVGL_STDIO_DRIVE "%s", fs_path);
-    lv_img_set_src(img_in_obj, g_lv_img_path);
+    ai_open(6);
 }
 
-static file_iterator_instance_t *img_file_iterator = NULL;
-
-static void btn_pic_back_cb(lv_event_t *e)
+// 退出 和点标题栏的返回键一样 SD卡里是回上一级
+// WLAN页面的返回要和连接任务配合 只能点返回键
+void ai_tuichu(void)
 {
-    lv_obj_del(icon_in_obj);
-    icon_flag = 0;
+    const app_mod_t *app = app_find(icon_flag);
+    if (app == NULL || app->back == NULL) {
+        ESP_LOGI(TAG, "voice: nothing to exit on screen %d", icon_flag);
+        return;
+    }
+    app->back(NULL);
 }
 
-static void btn_img_prev_next_cb(lv_event_t *e)
-{
-    bool is_next = (bool)lv_event_get_user_data(e);
-    if (is_next)
-    {
-        ESP_LOGI(TAG, "Next Image");
-        file_iterator_next(img_file_iterator);
 
-    }
-    else
-    {
-        ESP_LOGI(TAG, "Previous Image");
-        file_iterator_prev(img_file_iterator);
 
-    }
-    int index = file_iterator_get_index(img_file_iterator);
-    ESP_LOGI(TAG, "Current Image Index: %d", index);
-    if (file_iterator_get_full_path_from_index(img_file_iterator, index, g_img_path, sizeof(g_img_path))) {
-        lvgl_port_lock(0);
-        set_img_src_from_fs_path(g_img_path);
-        lv_obj_align(img_in_obj, LV_ALIGN_CENTER, 0, 10);
-        lvgl_port_unlock();
-    } else {
-        ESP_LOGE(TAG, "Failed to get full image path for index %d", index);
-    }
+/******************************** 主界面  ******************************/
+static const char *const s_perf_names[UI_PERF_SCREENS] = {
+    "main", "att", "music", "sdcard", "camera", "wifi", "bt", "gallery", "sysmon",
+};
 
+static int perf_current_screen(void)
+{
+    return icon_flag;
 }
-void app_pic_browser(void){
-    lvgl_port_lock(0);
-    ui_button_style_init(); // 初始化按键风格
-    // 创建下一张图片按钮
-    lv_obj_t *btn_next_pic = lv_btn_create(icon_in_obj);
-    lv_obj_set_size(btn_next_pic, 30, 30);
-    lv_obj_set_style_radius(btn_next_pic, 15, LV_STATE_DEFAULT);
-    lv_obj_clear_flag(btn_next_pic, LV_OBJ_FLAG_CHECKABLE); // 取消检查属性
-    lv_obj_align(btn_next_pic, LV_ALIGN_BOTTOM_RIGHT, -10, -10);
-
-    lv_obj_add_style(btn_next_pic, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_next_pic, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_next_pic, &ui_button_styles()->style_bg, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_next_pic, &ui_button_styles()->style_bg, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_next_pic, &ui_button_styles()->style_bg, LV_STATE_DEFAULT);
-    
-    lv_obj_t *label_next = lv_label_create(btn_next_pic);
-    lv_label_set_text_static(label_next, LV_SYMBOL_NEXT);
-    lv_obj_set_style_text_font(label_next, &lv_font_montserrat_24, LV_STATE_DEFAULT);
-    lv_obj_set_style_text_color(label_next, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
-    lv_obj_center(label_next);
-    lv_obj_set_user_data(btn_next_pic, (void *)label_next);
-    lv_obj_add_event_cb(btn_next_pic, btn_img_prev_next_cb, LV_EVENT_CLICKED, (void *)true);
-
-    // 创建上一张图片按钮
-    lv_obj_t *btn_prev_pic = lv_btn_create(icon_in_obj);
-    lv_obj_set_size(btn_prev_pic, 30, 30);
-    lv_obj_set_style_radius(btn_prev_pic, 15, LV_STATE_DEFAULT);
-    lv_obj_clear_flag(btn_prev_pic, LV_OBJ_FLAG_CHECKABLE); // 取消检查属性
-    lv_obj_align(btn_prev_pic, LV_ALIGN_BOTTOM_LEFT, 10, -10);
-
-    lv_obj_add_style(btn_prev_pic, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_prev_pic, &ui_button_styles()->style_focus_no_outline, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_prev_pic, &ui_button_styles()->style_bg, LV_STATE_FOCUS_KEY);
-    lv_obj_add_style(btn_prev_pic, &ui_button_styles()->style_bg, LV_STATE_FOCUSED);
-    lv_obj_add_style(btn_prev_pic, &ui_button_styles()->style_bg, LV_STATE_DEFAULT);
-    
-    lv_obj_t *label_prev = lv_label_create(btn_prev_pic);
-    lv_label_set_text_static(label_prev, LV_SYMBOL_PREV);
-    lv_obj_set_style_text_font(label_prev, &lv_font_montserrat_24, LV_STATE_DEFAULT);
-    lv_obj_set_style_text_color(label_prev, lv_color_make(0, 0, 0), LV_STATE_DEFAULT);
-    lv_obj_center(label_prev);
-    lv_obj_set_user_data(btn_prev_pic, (void *)label_prev);
-    lv_obj_add_event_cb(btn_prev_pic, btn_img_prev_next_cb, LV_EVENT_CLICKED, (void *)false);
-    lvgl_port_unlock();
 
+// 长按右上角的蓝牙/wifi符号 打开或关闭性能浮层
+static void perf_overlay_event_handler(lv_event_t *e)
+{
+    ui_perf_overlay_toggle();
 }
 
-static void pic_event_handler(lv_event_t *e)
+// 图标从assets分区里拿 分区没烧或者没有这张图时显示一个符号 点击照常
+static void app_icon_set(lv_obj_t *img, const app_mod_t *app)
 {
-    // 创建一个界面对象
-    static lv_style_t style;
-    img_file_iterator = NULL; // 初始化文件迭代器指针
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0xffffff));
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
-    icon_in_obj = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(icon_in_obj, &style, 0);
-    //创建标题背景
-    lv_obj_t *pic_title = lv_obj_create(icon_in_obj);
-    lv_obj_set_size(pic_title, 320, 40);
-    lv_obj_set_style_pad_all(pic_title, 0, 0); // 设置间隙
-    lv_obj_align(pic_title, LV_ALIGN_TOP_LEFT, 0, 0);
-    lv_obj_set_style_bg_color(pic_title, lv_color_hex(0x808080), 0);
-    // 显示标题
-    pic_title_label = lv_label_create(pic_title);
-    lv_label_set_text(pic_title_label, "图片浏览器");
-    lv_obj_set_style_text_color(pic_title_label, lv_color_hex(0xffffff), 0);
-    lv_obj_set_style_text_font(pic_title_label, &font_alipuhui20, 0);
-    lv_obj_align(pic_title_label, LV_ALIGN_CENTER, 0, 0);
-
-    // 显示后退按钮
-    btn_pic_back = lv_btn_create(pic_title);
-    lv_obj_align(btn_pic_back, LV_ALIGN_LEFT_MID, 0, 0);
-    lv_obj_set_size(btn_pic_back, 60, 30);
-    lv_obj_set_style_border_width(btn_pic_back, 0, 0);                          // 设置边框宽度
-    lv_obj_set_style_pad_all(btn_pic_back, 0, 0);                               //
-    lv_obj_set_style_bg_opa(btn_pic_back, LV_OPA_60, LV_PART_MAIN);         // 背景透明
-    lv_obj_set_style_shadow_opa(btn_pic_back, LV_OPA_60, LV_PART_MAIN);     // 阴影透明
-    lv_obj_add_event_cb(btn_pic_back, btn_pic_back_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
-
-    lv_obj_t *label_back = lv_label_create(btn_pic_back);
-    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左
-    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
-    lv_obj_set_style_text_color(label_back, lv_color_hex(0xffffff), 0);
-    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
-
-    // 确保文件迭代器存在
-    if (img_file_iterator == NULL) {
-        img_file_iterator = file_iterator_new(SD_MOUNT_POINT "/photo");
-        assert(img_file_iterator != NULL);
-    }
-    // 创建图片对象
-    img_in_obj = lv_img_create(icon_in_obj);
-    lv_obj_align(img_in_obj, LV_ALIGN_CENTER, 0, 10);
-
-    // 显示第一张图片（使用完整路径）
-    if (img_file_iterator->count > 0) {
-        int index = file_iterator_get_index(img_file_iterator);
-        if (!file_iterator_get_full_path_from_index(img_file_iterator, index, g_img_path, sizeof(g_img_path))) {
-            ESP_LOGE(TAG, "Failed to get full image path for initial index %d", index);
-        } else {
-            ESP_LOGI(TAG, "Initial image path: %s", g_img_path);
-            lvgl_port_lock(0);
-            set_img_src_from_fs_path(g_img_path);
-            lvgl_port_unlock();
-        }
-    } else {
-        ESP_LOGW(TAG, "No images found in %s/photo", SD_MOUNT_POINT);
+    const lv_img_dsc_t *dsc = app->icon ? asset_part_img(app->icon) : NULL;
+    if (dsc) {
+        lv_img_set_src(img, dsc);
+        return;
     }
-    icon_flag = 7; // 标记已经进入第7个应用
-    app_pic_browser();
-} 
-
-
+    lv_obj_set_style_text_font(img, &lv_font_montserrat_20, 0);
+    lv_obj_set_style_text_color(img, lv_color_hex(0xffffff), 0);
+    lv_img_set_src(img, app->symbol ? app->symbol : LV_SYMBOL_IMAGE);
+}
 
-/******************************** 主界面  ******************************/
-extern const lv_img_dsc_t img_pic_icon;
 void lv_main_page(void)
 {
-    lvgl_port_lock(0);
+    ui_perf_init(s_perf_names, UI_PERF_SCREENS, perf_current_screen);
+    evt_bus_subscribe(EVT_SD, app_sd_hotplug, EVT_BUS_DIRECT);
+    ui_lock(0);
 
-    lv_obj_del(tanglong_img); // 删除开机logo
+    if (tanglong_img) {
+        lv_obj_del(tanglong_img); // 删除开机logo SD卡挂载慢时没有显示logo
+        tanglong_img = NULL;
+    }
     // 创建主界面基本对象
     lv_obj_set_style_bg_color(lv_scr_act(), lv_color_hex(0x000000), 0); // 修改背景为黑色
 
-    static lv_style_t style;
-    lv_style_init(&style);
-    lv_style_set_radius(&style, 10);
-    lv_style_set_bg_opa(&style, LV_OPA_COVER);
-    lv_style_set_bg_color(&style, lv_color_hex(0x00BFFF));
-    lv_style_set_bg_grad_color(&style, lv_color_hex(0x00BF00));
-    lv_style_set_bg_grad_dir(&style, LV_GRAD_DIR_VER);
-    lv_style_set_border_width(&style, 0);
-    lv_style_set_pad_all(&style, 0);
-    lv_style_set_width(&style, 320);
-    lv_style_set_height(&style, 240);
-
     main_obj = lv_obj_create(lv_scr_act());
-    lv_obj_add_style(main_obj, &style, 0);
+    lv_obj_add_style(main_obj, ui_style(UI_STYLE_MAIN), 0);
     // 允许主页纵向滚动，并按页吸附
     lv_obj_set_scroll_dir(main_obj, LV_DIR_VER);
     lv_obj_set_scrollbar_mode(main_obj, LV_SCROLLBAR_MODE_AUTO);
@@ -2485,110 +680,40 @@ void lv_main_page(void)
     lv_obj_set_style_text_color(sylbom_label, lv_color_hex(0xffffff), 0);
     lv_label_set_text(sylbom_label, LV_SYMBOL_BLUETOOTH " " LV_SYMBOL_WIFI); // 显示蓝牙和wifi图标
     lv_obj_align_to(sylbom_label, main_obj, LV_ALIGN_TOP_RIGHT, -10, 10);
+    lv_obj_add_flag(sylbom_label, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(sylbom_label, perf_overlay_event_handler, LV_EVENT_LONG_PRESSED, NULL);
+#if CONFIG_APP_UI_PERF_OVERLAY
+    ui_perf_overlay_show(true);
+#endif
 
     // 显示左上角欢迎语
-    main_text_label = lv_label_create(main_obj);
+    // 跑马灯只画一次字 见ui_marquee.h
+    main_text_label = ui_marquee_create(main_obj);
     lv_obj_set_style_text_font(main_text_label, &font_alipuhui20, 0);
-    lv_label_set_long_mode(main_text_label, LV_LABEL_LONG_SCROLL_CIRCULAR); /*Circular scroll*/
     lv_obj_set_width(main_text_label, 280);
-    lv_label_set_text(main_text_label, "欢迎使用立创实战派开发板");
+    ui_marquee_set_text(main_text_label, "欢迎使用立创实战派开发板");
     lv_obj_align_to(main_text_label, main_obj, LV_ALIGN_TOP_LEFT, 8, 5);
+    ui_screen_set_home_cb(clock_home_cb);
+    evt_bus_subscribe(EVT_IDLE, clock_idle_cb, EVT_BUS_UI);
+    evt_bus_subscribe(EVT_TIME_SYNCED, time_synced, EVT_BUS_UI);
+    time_labels_create(NULL); // 复位前或者NVS里有时间 不等对时直接显示时钟
+
+    // 应用图标共用一个样式 背景色各自设置 一行三个 第三行要下滑才看得到
+    lv_style_t *btn_style = ui_style(UI_STYLE_APP_ICON);
+    for (int i = 0; i < APP_COUNT; i++) {
+        const app_mod_t *app = s_apps[i];
+        lv_obj_t *icon = lv_btn_create(main_obj);
+        lv_obj_add_style(icon, btn_style, 0);
+        lv_obj_set_style_bg_color(icon, lv_color_hex(app->color), 0);
+        lv_obj_set_pos(icon, 15 + i % 3 * 105, 50 + i / 3 * 97);
+        lv_obj_add_event_cb(icon, app_icon_event_handler, LV_EVENT_CLICKED, (void *)app);
+
+        lv_obj_t *img = lv_img_create(icon);
+        app_icon_set(img, app);
+        lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
+
+        ui_layer_add(icon); // 图标按钮不会变 滚动时画快照 见ui_layer.h
+    }
 
-    // 设置应用图标style
-    static lv_style_t btn_style;
-    lv_style_init(&btn_style);
-    lv_style_set_radius(&btn_style, 16);
-    lv_style_set_bg_opa(&btn_style, LV_OPA_COVER);
-    lv_style_set_text_color(&btn_style, lv_color_hex(0xffffff));
-    lv_style_set_border_width(&btn_style, 0);
-    lv_style_set_pad_all(&btn_style, 5);
-    lv_style_set_width(&btn_style, 80);
-    lv_style_set_height(&btn_style, 80);
-
-    // 创建第1个应用图标
-    lv_obj_t *icon1 = lv_btn_create(main_obj);
-    lv_obj_add_style(icon1, &btn_style, 0);
-    lv_obj_set_style_bg_color(icon1, lv_color_hex(0x30a830), 0);
-    lv_obj_set_pos(icon1, 15, 50);
-    lv_obj_add_event_cb(icon1, att_event_handler, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *img1 = lv_img_create(icon1);
-    LV_IMG_DECLARE(img_att_icon);
-    lv_img_set_src(img1, &img_att_icon);
-    lv_obj_align(img1, LV_ALIGN_CENTER, 0, 0);
-
-    // 创建第2个应用图标
-    lv_obj_t *icon2 = lv_btn_create(main_obj);
-    lv_obj_add_style(icon2, &btn_style, 0);
-    lv_obj_set_style_bg_color(icon2, lv_color_hex(0xf87c30), 0);
-    lv_obj_set_pos(icon2, 120, 50);
-    lv_obj_add_event_cb(icon2, music_event_handler, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *img2 = lv_img_create(icon2);
-    LV_IMG_DECLARE(img_music_icon);
-    lv_img_set_src(img2, &img_music_icon);
-    lv_obj_align(img2, LV_ALIGN_CENTER, 0, 0);
-
-    // 创建第3个应用图标
-    lv_obj_t *icon3 = lv_btn_create(main_obj);
-    lv_obj_add_style(icon3, &btn_style, 0);
-    lv_obj_set_style_bg_color(icon3, lv_color_hex(0x008b8b), 0);
-    lv_obj_set_pos(icon3, 225, 50);
-    lv_obj_add_event_cb(icon3, sdcard_event_handler, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *img3 = lv_img_create(icon3);
-    LV_IMG_DECLARE(img_sd_icon);
-    lv_img_set_src(img3, &img_sd_icon);
-    lv_obj_align(img3, LV_ALIGN_CENTER, 0, 0);
-
-    // 创建第4个应用图标
-    lv_obj_t *icon4 = lv_btn_create(main_obj);
-    lv_obj_add_style(icon4, &btn_style, 0);
-    lv_obj_set_style_bg_color(icon4, lv_color_hex(0xd8b010), 0);
-    lv_obj_set_pos(icon4, 15, 147);
-    lv_obj_add_event_cb(icon4, camera_event_handler, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *img4 = lv_img_create(icon4);
-    LV_IMG_DECLARE(img_camera_icon);
-    lv_img_set_src(img4, &img_camera_icon);
-    lv_obj_align(img4, LV_ALIGN_CENTER, 0, 0);
-
-    // 创建第5个应用图标
-    lv_obj_t *icon5 = lv_btn_create(main_obj);
-    lv_obj_add_style(icon5, &btn_style, 0);
-    lv_obj_set_style_bg_color(icon5, lv_color_hex(0xcd5c5c), 0);
-    lv_obj_set_pos(icon5, 120, 147);
-    lv_obj_add_event_cb(icon5, wifiset_event_handler, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *img5 = lv_img_create(icon5);
-    LV_IMG_DECLARE(img_wifiset_icon);
-    lv_img_set_src(img5, &img_wifiset_icon);
-    lv_obj_align(img5, LV_ALIGN_CENTER, 0, 0);
-
-    // 创建第6个应用图标
-    lv_obj_t *icon6 = lv_btn_create(main_obj);
-    lv_obj_add_style(icon6, &btn_style, 0);
-    lv_obj_set_style_bg_color(icon6, lv_color_hex(0xb87fa8), 0);
-    lv_obj_set_pos(icon6, 225, 147);
-    lv_obj_add_event_cb(icon6, btset_event_handler, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *img6 = lv_img_create(icon6);
-    LV_IMG_DECLARE(img_btset_icon);
-    lv_img_set_src(img6, &img_btset_icon);
-    lv_obj_align(img6, LV_ALIGN_CENTER, 0, 0);
-
-    // 创建第7个应用图标（位于第三行，需下滑可见）
-    lv_obj_t *icon7 = lv_btn_create(main_obj);
-    lv_obj_add_style(icon7, &btn_style, 0);
-    lv_obj_set_style_bg_color(icon7, lv_color_hex(0x3c8dbc), 0);
-    lv_obj_set_pos(icon7, 15, 244); // 第三行起始位置（超过 240 高度）
-
-    lv_obj_add_event_cb(icon7, pic_event_handler, LV_EVENT_CLICKED, NULL);
-
-    lv_obj_t *img7 = lv_img_create(icon7);
-    LV_IMG_DECLARE(img_pic_icon);
-    lv_img_set_src(img7, &img_pic_icon);
-    lv_obj_align(img7, LV_ALIGN_CENTER, 0, 0);
-
-    lvgl_port_unlock();
+    ui_unlock();
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+#include "esp_err.h"
 
 /*********************** 开机界面 ****************************/
 // 开机界面
@@ -12,7 +14,10 @@ void lv_main_page(void);
 
 /*********************** 音乐播放器 ****************************/
 void mp3_player_init(void);
-void music_ui(void);
+void music_index_init(void);  // 后台建立音乐元数据索引
+esp_err_t music_play_radio(const char *url);  // 播放网络电台(HTTP/ICY MP3流)
+
+void app_wifi_autoconnect(void); // 主界面出来以后调用 有保存的AP就在后台直连
 
 void ai_gui_in(void);
 void ai_gui_out(void);
@@ -24,6 +29,11 @@ void ai_prev_music(void);
 void ai_next_music(void);
 void ai_volume_up(void);
 void ai_volume_down(void);
+void ai_seek(uint32_t position_ms);    // 当前曲目跳到 超过时长就到结尾
+void ai_volume_set(int volume);         // 0~100
+void ai_play_file(const char *path);    // 按路径放一首 音乐应用没打开也行 和文件浏览器里点一样
+void ai_memo_start(void);
+void ai_memo_stop(void);
 
 
 
@@ -34,4 +44,6 @@ void ai_open_icon4(void);
 void ai_open_icon5(void);
 void ai_open_icon6(void);
 void ai_tuichu(void);
+int ai_app_id(const char *name);        // 按应用名找id 没编进去返回0 哪个任务都能调
+void ai_open_app(int id);               // 和语音打开一样 已经在某个应用里就不理
 
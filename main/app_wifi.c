@@ -0,0 +1,594 @@
+#include "app_mod.h"
+#include "task_plan.h"
+#include "ui_msg.h"
+#include "ui_theme.h"
+#include "wifi_svc.h"
+#include "ota_update.h"
+#include "file_server.h"
+#include "esp32_s3_szp.h"
+#include "esp_app_desc.h"
+
+static const char *TAG = "app_wifi";
+
+/******************************** 第5个图标 WiFi设置 应用程序*****************************************************************************/
+
+lv_obj_t *wifi_scan_page;     // wifi扫描页面 obj
+lv_obj_t *wifi_password_page; // wifi密码页面 obj
+lv_obj_t *wifi_connect_page;  // wifi连接页面 obj
+lv_obj_t *obj_scan_title;     // wifi扫描页面标题
+lv_obj_t *label_wifi_scan;    // wif扫描页面 label
+lv_obj_t *wifi_list;          // wifi列表  list
+lv_obj_t *label_wifi_connect; // wifi连接页面label
+lv_obj_t *ta_pass_text;       // 密码输入文本框 textarea
+lv_obj_t *roller_num;         // 数字roller
+lv_obj_t *roller_letter_low;  // 小写字母roller
+lv_obj_t *roller_letter_up;   // 大写字母roller
+lv_obj_t *label_wifi_name;    // wifi名称label
+
+static volatile bool s_wifi_connecting = false; // 连接页等着这次连接的结果
+
+static void wifi_connect_result(void *arg);
+
+// 数字键 处理函数
+static void btn_num_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (code == LV_EVENT_CLICKED)
+    {
+        ESP_LOGI(TAG, "Btn-Num Clicked");
+        char buf[2]; // 接收roller的值
+        lv_roller_get_selected_str(roller_num, buf, sizeof(buf));
+        lv_textarea_add_text(ta_pass_text, buf);
+    }
+}
+
+// 小写字母确认键 处理函数
+static void btn_letter_low_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (code == LV_EVENT_CLICKED)
+    {
+        ESP_LOGI(TAG, "Btn-Letter-Low Clicked");
+        char buf[2]; // 接收roller的值
+        lv_roller_get_selected_str(roller_letter_low, buf, sizeof(buf));
+        lv_textarea_add_text(ta_pass_text, buf);
+    }
+}
+
+// 大写字母确认键 处理函数
+static void btn_letter_up_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (code == LV_EVENT_CLICKED)
+    {
+        ESP_LOGI(TAG, "Btn-Letter-Up Clicked");
+        char buf[2]; // 接收roller的值
+        lv_roller_get_selected_str(roller_letter_up, buf, sizeof(buf));
+        lv_textarea_add_text(ta_pass_text, buf);
+    }
+}
+
+static void lv_wifi_connect(void)
+{
+    lv_obj_del(wifi_password_page); // 删除密码输入界面
+
+    // 创建一个面板对象
+    wifi_connect_page = lv_obj_create(lv_scr_act());
+    lv_obj_add_style(wifi_connect_page, ui_style(UI_STYLE_PAGE), 0);
+
+    // 绘制label提示
+    label_wifi_connect = lv_label_create(wifi_connect_page);
+    lv_label_set_text(label_wifi_connect, "WLAN连接中...");
+    lv_obj_set_style_text_font(label_wifi_connect, &font_alipuhui20, 0);
+    lv_obj_align(label_wifi_connect, LV_ALIGN_CENTER, 0, -50);
+}
+
+// WiFi连接按钮 处理函数
+static void btn_connect_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (code == LV_EVENT_CLICKED)
+    {
+        ESP_LOGI(TAG, "OK Clicked");
+        const char *wifi_ssid = lv_label_get_text(label_wifi_name);
+        const char *wifi_password = lv_textarea_get_text(ta_pass_text);
+        if (*wifi_password != '\0') // 判断是否为空字符串
+        {
+            char ssid[33];
+            char password[65];
+            strlcpy(ssid, wifi_ssid, sizeof(ssid));
+            strlcpy(password, wifi_password, sizeof(password));
+            ESP_LOGI(TAG, "connect to ap SSID:%s", ssid);
+            lv_wifi_connect(); // 显示wifi连接界面 密码页跟着删掉
+            s_wifi_connecting = true;
+            if (wifi_svc_connect(ssid, password) != ESP_OK)
+            {
+                s_wifi_connecting = false;
+                wifi_connect_result(NULL);
+            }
+        }
+    }
+}
+
+// 删除密码按钮
+static void btn_del_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (code == LV_EVENT_CLICKED)
+    {
+        ESP_LOGI(TAG, "Clicked");
+        lv_textarea_del_char(ta_pass_text);
+    }
+}
+
+// 返回按钮
+static void btn_back_cb(lv_event_t *e)
+{
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (code == LV_EVENT_CLICKED)
+    {
+        ESP_LOGI(TAG, "btn_back Clicked");
+        lv_obj_del(wifi_password_page); // 删除密码输入界面
+    }
+}
+
+// 进入输入密码界面
+static void list_btn_cb(lv_event_t *e)
+{
+    // 获取点击到的WiFi名称
+    const char *wifi_name = NULL;
+    lv_event_code_t code = lv_event_get_code(e);
+    lv_obj_t *obj = lv_event_get_target(e);
+    if (code == LV_EVENT_CLICKED)
+    {
+        wifi_name = lv_list_get_btn_text(wifi_list, obj);
+        ESP_LOGI(TAG, "WLAN Name: %s", wifi_name);
+    }
+
+    // 创建密码输入页面
+    wifi_password_page = lv_obj_create(lv_scr_act());
+    lv_obj_set_size(wifi_password_page, 320, 240);
+    lv_obj_set_style_border_width(wifi_password_page, 0, 0); // 设置边框宽度
+    lv_obj_set_style_pad_all(wifi_password_page, 0, 0);      // 设置间隙
+    lv_obj_set_style_radius(wifi_password_page, 0, 0);       // 设置圆角
+
+    // 创建返回按钮
+    lv_obj_t *btn_back = lv_btn_create(wifi_password_page);
+    lv_obj_align(btn_back, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_size(btn_back, 60, 40);
+    lv_obj_set_style_border_width(btn_back, 0, 0);                      // 设置边框宽度
+    lv_obj_set_style_pad_all(btn_back, 0, 0);                           // 设置间隙
+    lv_obj_set_style_bg_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN);     // 背景透明
+    lv_obj_set_style_shadow_opa(btn_back, LV_OPA_TRANSP, LV_PART_MAIN); // 阴影透明
+    lv_obj_add_event_cb(btn_back, btn_back_cb, LV_EVENT_ALL, NULL);     // 添加按键处理函数
+
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
+    lv_obj_set_style_text_font(label_back, &lv_font_montserrat_20, 0);
+    lv_obj_set_style_text_color(label_back, lv_color_hex(0x000000), 0);
+    lv_obj_align(label_back, LV_ALIGN_TOP_LEFT, 10, 10);
+
+    // 显示选中的wifi名称
+    label_wifi_name = lv_label_create(wifi_password_page);
+    lv_obj_set_style_text_font(label_wifi_name, &lv_font_montserrat_20, 0);
+    lv_label_set_text(label_wifi_name, wifi_name);
+    lv_obj_align(label_wifi_name, LV_ALIGN_TOP_MID, 0, 10);
+
+    // 创建密码输入框
+    ta_pass_text = lv_textarea_create(wifi_password_page);
+    lv_obj_set_style_text_font(ta_pass_text, &lv_font_montserrat_20, 0);
+    lv_textarea_set_one_line(ta_pass_text, true);               // 一行显示
+    lv_textarea_set_password_mode(ta_pass_text, false);         // 是否使用密码输入显示模式
+    lv_textarea_set_placeholder_text(ta_pass_text, "password"); // 设置提醒词
+    lv_obj_set_width(ta_pass_text, 150);                        // 宽度
+    lv_obj_align(ta_pass_text, LV_ALIGN_TOP_LEFT, 10, 40);      // 位置
+    lv_obj_add_state(ta_pass_text, LV_STATE_FOCUSED);           // 显示光标
+
+    // 创建“连接按钮”
+    lv_obj_t *btn_connect = lv_btn_create(wifi_password_page);
+    lv_obj_align(btn_connect, LV_ALIGN_TOP_LEFT, 170, 40);
+    lv_obj_set_width(btn_connect, 65);                                    // 宽度
+    lv_obj_add_event_cb(btn_connect, btn_connect_cb, LV_EVENT_ALL, NULL); // 事件处理函数
+
+    lv_obj_t *label_ok = lv_label_create(btn_connect);
+    lv_label_set_text(label_ok, "OK");
+    lv_obj_set_style_text_font(label_ok, &lv_font_montserrat_20, 0);
+    lv_obj_center(label_ok);
+
+    // 创建“删除按钮”
+    lv_obj_t *btn_del = lv_btn_create(wifi_password_page);
+    lv_obj_align(btn_del, LV_ALIGN_TOP_LEFT, 245, 40);
+    lv_obj_set_width(btn_del, 65);                                // 宽度
+    lv_obj_add_event_cb(btn_del, btn_del_cb, LV_EVENT_ALL, NULL); // 事件处理函数
+
+    lv_obj_t *label_del = lv_label_create(btn_del);
+    lv_label_set_text(label_del, LV_SYMBOL_BACKSPACE);
+    lv_obj_set_style_text_font(label_del, &lv_font_montserrat_20, 0);
+    lv_obj_center(label_del);
+
+    // 创建"数字"roller
+    const char *opts_num = "0\n1\n2\n3\n4\n5\n6\n7\n8\n9";
+
+    roller_num = lv_roller_create(wifi_password_page);
+    lv_obj_add_style(roller_num, ui_style(UI_STYLE_ROLLER), 0);
+    lv_obj_set_style_bg_opa(roller_num, LV_OPA_50, LV_PART_SELECTED);
+
+    lv_roller_set_options(roller_num, opts_num, LV_ROLLER_MODE_INFINITE);
+    lv_roller_set_visible_row_count(roller_num, 3);     // 显示3行
+    lv_roller_set_selected(roller_num, 5, LV_ANIM_OFF); // 默认选择
+    lv_obj_set_width(roller_num, 90);
+    lv_obj_set_style_text_font(roller_num, &lv_font_montserrat_20, 0);
+    lv_obj_align(roller_num, LV_ALIGN_BOTTOM_LEFT, 15, -53);
+    ui_roller_fade(roller_num);  // 上下两段渐隐
+
+    // 创建"数字"roller 的确认键
+    lv_obj_t *btn_num_ok = lv_btn_create(wifi_password_page);
+    lv_obj_align(btn_num_ok, LV_ALIGN_BOTTOM_LEFT, 15, -10);         // 位置
+    lv_obj_set_width(btn_num_ok, 90);                                // 宽度
+    lv_obj_add_event_cb(btn_num_ok, btn_num_cb, LV_EVENT_ALL, NULL); // 事件处理函数
+
+    lv_obj_t *label_num_ok = lv_label_create(btn_num_ok);
+    lv_label_set_text(label_num_ok, LV_SYMBOL_OK);
+    lv_obj_set_style_text_font(label_num_ok, &lv_font_montserrat_20, 0);
+    lv_obj_center(label_num_ok);
+
+    // 创建"小写字母"roller
+    const char *opts_letter_low = "a\nb\nc\nd\ne\nf\ng\nh\ni\nj\nk\nl\nm\nn\no\np\nq\nr\ns\nt\nu\nv\nw\nx\ny\nz";
+
+    roller_letter_low = lv_roller_create(wifi_password_page);
+    lv_obj_add_style(roller_letter_low, ui_style(UI_STYLE_ROLLER), 0);
+    lv_obj_set_style_bg_opa(roller_letter_low, LV_OPA_50, LV_PART_SELECTED);            // 设置选中项的透明度
+    lv_roller_set_options(roller_letter_low, opts_letter_low, LV_ROLLER_MODE_INFINITE); // 循环滚动模式
+    lv_roller_set_visible_row_count(roller_letter_low, 3);
+    lv_roller_set_selected(roller_letter_low, 15, LV_ANIM_OFF); //
+    lv_obj_set_width(roller_letter_low, 90);
+    lv_obj_set_style_text_font(roller_letter_low, &lv_font_montserrat_20, 0);
+    lv_obj_align(roller_letter_low, LV_ALIGN_BOTTOM_LEFT, 115, -53);
+    ui_roller_fade(roller_letter_low);  // 上下两段渐隐
+
+    // 创建"小写字母"roller的确认键
+    lv_obj_t *btn_letter_low_ok = lv_btn_create(wifi_password_page);
+    lv_obj_align(btn_letter_low_ok, LV_ALIGN_BOTTOM_LEFT, 115, -10);
+    lv_obj_set_width(btn_letter_low_ok, 90);                                       // 宽度
+    lv_obj_add_event_cb(btn_letter_low_ok, btn_letter_low_cb, LV_EVENT_ALL, NULL); // 事件处理函数
+
+    lv_obj_t *label_letter_low_ok = lv_label_create(btn_letter_low_ok);
+    lv_label_set_text(label_letter_low_ok, LV_SYMBOL_OK);
+    lv_obj_set_style_text_font(label_letter_low_ok, &lv_font_montserrat_20, 0);
+    lv_obj_center(label_letter_low_ok);
+
+    // 创建"大写字母"roller
+    const char *opts_letter_up = "A\nB\nC\nD\nE\nF\nG\nH\nI\nJ\nK\nL\nM\nN\nO\nP\nQ\nR\nS\nT\nU\nV\nW\nX\nY\nZ";
+
+    roller_letter_up = lv_roller_create(wifi_password_page);
+    lv_obj_add_style(roller_letter_up, ui_style(UI_STYLE_ROLLER), 0);
+    lv_obj_set_style_bg_opa(roller_letter_up, LV_OPA_50, LV_PART_SELECTED);           // 设置选中项的透明度
+    lv_roller_set_options(roller_letter_up, opts_letter_up, LV_ROLLER_MODE_INFINITE); // 循环滚动模式
+    lv_roller_set_visible_row_count(roller_letter_up, 3);
+    lv_roller_set_selected(roller_letter_up, 15, LV_ANIM_OFF);
+    lv_obj_set_width(roller_letter_up, 90);
+    lv_obj_set_style_text_font(roller_letter_up, &lv_font_montserrat_20, 0);
+    lv_obj_align(roller_letter_up, LV_ALIGN_BOTTOM_LEFT, 215, -53);
+    ui_roller_fade(roller_letter_up);  // 上下两段渐隐
+
+    // 创建"大写字母"roller的确认键
+    lv_obj_t *btn_letter_up_ok = lv_btn_create(wifi_password_page);
+    lv_obj_align(btn_letter_up_ok, LV_ALIGN_BOTTOM_LEFT, 215, -10);
+    lv_obj_set_width(btn_letter_up_ok, 90);
+    lv_obj_add_event_cb(btn_letter_up_ok, btn_letter_up_cb, LV_EVENT_ALL, NULL); // 事件处理函数
+
+    lv_obj_t *label_letter_up_ok = lv_label_create(btn_letter_up_ok);
+    lv_label_set_text(label_letter_up_ok, LV_SYMBOL_OK);
+    lv_obj_set_style_text_font(label_letter_up_ok, &lv_font_montserrat_20, 0);
+    lv_obj_center(label_letter_up_ok);
+}
+
+
+static void wifi_app_listener(const wifi_svc_event_t *ev);
+
+// 连接结果显示一秒后关页面 在lv_timer里执行
+static void wifi_connect_close(lv_timer_t *timer)
+{
+    bool ok = timer->user_data != NULL;
+    if (lv_obj_is_valid(wifi_connect_page))
+    {
+        lv_obj_del(wifi_connect_page); // 删除此页面
+    }
+    if (ok && icon_flag == 5)
+    {
+        wifi_svc_unsubscribe(wifi_app_listener);
+        if (lv_obj_is_valid(wifi_scan_page))
+        {
+            lv_obj_del(wifi_scan_page); // 删除此页面
+        }
+        icon_flag = 0; // 标记回到主界面
+    }
+}
+
+// 在LVGL任务里执行
+static void wifi_connect_result(void *arg)
+{
+    if (!lv_obj_is_valid(label_wifi_connect))
+    {
+        return;
+    }
+    lv_label_set_text(label_wifi_connect, arg ? "WLAN 连接成功" : "WLAN 连接失败");
+    lv_timer_t *timer = lv_timer_create(wifi_connect_close, 1000, arg); // 给上面的显示一点时间
+    lv_timer_set_repeat_count(timer, 1);
+}
+
+// 按扫描结果重建列表 在LVGL任务里执行 每扫完一个信道来一次
+static void wifi_list_refresh(void *arg)
+{
+    if (icon_flag != 5 || !lv_obj_is_valid(wifi_list))
+    {
+        return;
+    }
+    wifi_svc_ap_t aps[WIFI_SVC_SCAN_MAX];
+    int n = wifi_svc_scan_results(aps, WIFI_SVC_SCAN_MAX);
+    if (arg)
+    {
+        lv_label_set_text_fmt(label_wifi_scan, "%d WLAN", n); // 扫完了
+    }
+    else
+    {
+        lv_label_set_text_fmt(label_wifi_scan, "WLAN扫描中... %d", n);
+    }
+    lv_obj_clean(wifi_list);
+    for (int i = 0; i < n; i++)
+    {
+        lv_obj_t *btn = lv_list_add_btn(wifi_list, LV_SYMBOL_WIFI, aps[i].ssid);
+        lv_obj_add_event_cb(btn, list_btn_cb, LV_EVENT_CLICKED, NULL); // 添加点击回调函数
+    }
+}
+
+// 在WiFi服务任务里 界面的事都转给LVGL任务
+static void wifi_app_listener(const wifi_svc_event_t *ev)
+{
+    if (ev->type == WIFI_SVC_EV_SCAN_UPDATE || ev->type == WIFI_SVC_EV_SCAN_DONE)
+    {
+        ui_post_call(wifi_list_refresh, ev->type == WIFI_SVC_EV_SCAN_DONE ? (void *)1 : NULL);
+    }
+    else if (s_wifi_connecting && (ev->state == WIFI_SVC_CONNECTED || ev->state == WIFI_SVC_FAILED))
+    {
+        s_wifi_connecting = false;
+        ui_post_call(wifi_connect_result, ev->state == WIFI_SVC_CONNECTED ? (void *)1 : NULL);
+    }
+}
+
+// 返回主界面按钮事件处理函数 WiFi服务留着 连着的网不断
+static void btn_backmain_cb(lv_event_t *e)
+{
+    ESP_LOGI(TAG, "btn_backmain Clicked");
+
+    wifi_svc_unsubscribe(wifi_app_listener);
+    s_wifi_connecting = false;
+    lv_obj_del(wifi_scan_page); // 删除wifi扫描界面
+    icon_flag = 0;
+}
+
+// 第一次进应用时初始化协议栈要一点时间 放在任务里 列表随扫描结果出来
+static void app_wifi_connect(void *arg)
+{
+    if (app_wifi_open() == ESP_OK)
+    {
+        wifi_svc_subscribe(wifi_app_listener);
+        wifi_svc_scan();
+    }
+    vTaskDelete(NULL);
+}
+
+//  任务函数
+static void wifiset_tips_show(void *arg)
+{
+    // 显示扫描情况
+    label_wifi_scan = lv_label_create(wifi_scan_page);
+    lv_label_set_text(label_wifi_scan, arg ? (const char *)arg : "WLAN 已连接");
+    lv_obj_set_style_text_color(label_wifi_scan, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(label_wifi_scan, &font_alipuhui20, 0);
+    lv_obj_align(label_wifi_scan, LV_ALIGN_CENTER, 0, -50);
+}
+
+static void wifiset_tips_task(void *pvParameters)
+{
+    ui_post_call(wifiset_tips_show, pvParameters);
+    vTaskDelay(500 / portTICK_PERIOD_MS);
+    ui_post_del(wifi_scan_page);
+
+    vTaskDelete(NULL);
+}
+
+/*********************** 已连接页面 固件升级 ****************************/
+static lv_obj_t *s_ota_label;   // 升级进度
+static lv_timer_t *s_ota_timer;
+
+#if CONFIG_APP_OTA
+// 每500毫秒刷新一次进度 下载和写flash的速度分开算
+static void ota_progress_cb(lv_timer_t *timer)
+{
+    ota_update_stats_t st;
+    ota_update_get_stats(&st);
+    uint32_t net = st.net_us ? st.bytes * 1000000ULL / 1024 / st.net_us : 0;
+    uint32_t wr = st.write_us ? st.bytes * 1000000ULL / 1024 / st.write_us : 0;
+    switch (st.state)
+    {
+    case OTA_UPDATE_CONNECTING:
+        lv_label_set_text(s_ota_label, "连接服务器...");
+        break;
+    case OTA_UPDATE_DOWNLOADING:
+        lv_label_set_text_fmt(s_ota_label, "%lu%% %luKB\n下载 %luKB/s 写入 %luKB/s",
+                              (unsigned long)(st.total ? st.bytes * 100ULL / st.total : 0),
+                              (unsigned long)st.bytes / 1024, (unsigned long)net, (unsigned long)wr);
+        break;
+    case OTA_UPDATE_VERIFYING:
+        lv_label_set_text(s_ota_label, "校验固件...");
+        break;
+    case OTA_UPDATE_DONE:
+        lv_label_set_text_fmt(s_ota_label, "升级完成 %s\n下载 %luKB/s 写入 %luKB/s 重启中", st.version,
+                              (unsigned long)net, (unsigned long)wr);
+        break;
+    case OTA_UPDATE_FAILED:
+        lv_label_set_text_fmt(s_ota_label, "升级失败\n%s", esp_err_to_name(st.error));
+        break;
+    default:
+        break;
+    }
+}
+
+static void btn_ota_cb(lv_event_t *e)
+{
+    if (ota_update_start(true) == ESP_OK && s_ota_timer == NULL)
+    {
+        s_ota_timer = lv_timer_create(ota_progress_cb, 500, NULL);
+    }
+    ota_progress_cb(NULL);
+}
+#endif
+
+static void btn_wifi_info_back_cb(lv_event_t *e)
+{
+    if (s_ota_timer)
+    {
+        lv_timer_del(s_ota_timer); // 升级在后台接着跑
+        s_ota_timer = NULL;
+    }
+    lv_obj_del(wifi_scan_page);
+    icon_flag = 0;
+}
+
+// 连着网时进应用 显示地址和固件版本 可以在这里升级
+static void wifi_info_build(void)
+{
+    lv_obj_t *title = lv_obj_create(wifi_scan_page);
+    lv_obj_add_style(title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(title, lv_color_hex(0x008b8b), 0);
+    lv_obj_t *label = lv_label_create(title);
+    lv_label_set_text(label, "WLAN 已连接");
+    lv_obj_set_style_text_color(label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
+
+    lv_obj_t *btn_back = lv_btn_create(title);
+    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_wifi_info_back_cb, LV_EVENT_CLICKED, NULL);
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT);
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    char ip[16];
+    if (!wifi_svc_get_ip(ip, sizeof(ip)))
+    {
+        strlcpy(ip, "-", sizeof(ip));
+    }
+    char url[40] = "";
+#if CONFIG_APP_FILE_SERVER
+    file_server_url(url, sizeof(url)); // 浏览器打开这个往卡里传文件
+#endif
+    lv_obj_t *info = lv_label_create(wifi_scan_page);
+    lv_label_set_text_fmt(info, "IP %s\n固件 %s\n%s", ip, esp_app_get_description()->version, url);
+    lv_obj_set_style_text_color(info, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(info, &font_alipuhui20, 0);
+    lv_obj_align(info, LV_ALIGN_TOP_LEFT, 10, 50);
+
+#if CONFIG_APP_OTA
+    s_ota_label = lv_label_create(wifi_scan_page);
+    lv_label_set_text(s_ota_label, "");
+    lv_obj_set_style_text_color(s_ota_label, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_text_font(s_ota_label, &font_alipuhui20, 0);
+    lv_obj_align(s_ota_label, LV_ALIGN_TOP_LEFT, 10, 135);
+    if (CONFIG_APP_OTA_URL[0])
+    {
+        lv_obj_t *btn_ota = lv_btn_create(wifi_scan_page);
+        lv_obj_align(btn_ota, LV_ALIGN_BOTTOM_MID, 0, -10);
+        lv_obj_add_event_cb(btn_ota, btn_ota_cb, LV_EVENT_CLICKED, NULL);
+        lv_obj_t *label_ota = lv_label_create(btn_ota);
+        lv_label_set_text(label_ota, "固件升级");
+        lv_obj_set_style_text_font(label_ota, &font_alipuhui20, 0);
+        lv_obj_center(label_ota);
+        // 离开页面时升级还在跑 回来接着显示进度
+        ota_update_stats_t st;
+        ota_update_get_stats(&st);
+        if (st.state != OTA_UPDATE_IDLE)
+        {
+            s_ota_timer = lv_timer_create(ota_progress_cb, 500, NULL);
+            ota_progress_cb(NULL);
+        }
+    }
+#else
+    (void)s_ota_label;
+#endif
+    icon_flag = 5;
+}
+
+// 进入WIFI设置应用
+static void wifiset_event_handler(lv_event_t *e)
+{
+    // 创建一个界面对象
+    wifi_scan_page = lv_obj_create(lv_scr_act());
+    lv_obj_add_style(wifi_scan_page, ui_style(UI_STYLE_SCREEN), 0);
+
+    // 开机自动连接或者掉线重连还在进行 等它的结果
+    wifi_svc_state_t state = wifi_svc_state();
+    if (state == WIFI_SVC_CONNECTING || state == WIFI_SVC_RECONNECTING)
+    {
+        task_plan_create(TASK_WIFI_TIPS, wifiset_tips_task, "WLAN 连接中", NULL);
+        return;
+    }
+    if (state == WIFI_SVC_CONNECTED) // 如果已经连接到wifi
+    {
+        wifi_info_build();
+        return;
+    }
+    // 创建标题背景
+    obj_scan_title = lv_obj_create(wifi_scan_page);
+    lv_obj_add_style(obj_scan_title, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(obj_scan_title, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(obj_scan_title, lv_color_hex(0x008b8b), 0);
+    // 显示扫描情况
+    label_wifi_scan = lv_label_create(obj_scan_title);
+    lv_label_set_text(label_wifi_scan, "WLAN扫描中...");
+    lv_obj_set_style_text_color(label_wifi_scan, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(label_wifi_scan, &font_alipuhui20, 0);
+    lv_obj_align(label_wifi_scan, LV_ALIGN_CENTER, 0, 0);
+
+    // 创建返回按钮 不用等扫描
+    lv_obj_t *btn_back = lv_btn_create(obj_scan_title);
+    lv_obj_align(btn_back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(btn_back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_add_event_cb(btn_back, btn_backmain_cb, LV_EVENT_CLICKED, NULL); // 添加按键处理函数
+
+    lv_obj_t *label_back = lv_label_create(btn_back);
+    lv_label_set_text(label_back, LV_SYMBOL_LEFT); // 按键上显示左箭头符号
+    lv_obj_add_style(label_back, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(label_back, LV_ALIGN_CENTER, -10, 0);
+
+    // 创建wifi信息列表 扫到一个信道填一次
+    wifi_list = lv_list_create(wifi_scan_page);
+    lv_obj_set_size(wifi_list, 320, 200);
+    lv_obj_align(wifi_list, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_border_width(wifi_list, 0, 0);
+    lv_obj_set_style_text_font(wifi_list, &font_alipuhui20, 0);
+    lv_obj_set_scrollbar_mode(wifi_list, LV_SCROLLBAR_MODE_OFF); // 隐藏wifi_list滚动条
+
+    icon_flag = 5; // 标记已经进入第5个应用
+
+    task_plan_create(TASK_WIFI_CONNECT, app_wifi_connect, NULL, NULL);
+}
+
+// 页面不走ui_screen 连接任务还在跑时只能点返回键 语音不能退出
+const app_mod_t app_mod_wifi = {
+    .name = "wifi",
+    .id = 5,
+    .color = 0xcd5c5c,
+    .icon = "img_wifiset_icon",
+    .open = wifiset_event_handler,
+};
@@ -0,0 +1,185 @@
+#include <string.h>
+#include "asset_part.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "asset_part";
+
+_Static_assert(sizeof(asset_part_hdr_t) == 16, "asset header layout");
+_Static_assert(sizeof(asset_part_entry_t) == 36, "asset entry layout");
+
+#define ASSET_RLE_RUN   0x80
+
+static struct {
+    const uint8_t *map;
+    esp_partition_mmap_handle_t map_handle;
+    const asset_part_entry_t *entries;
+    uint16_t count;
+    lv_img_dsc_t dsc[ASSET_PART_MAX];   // 压缩的data在解开之前是NULL
+    bool failed[ASSET_PART_MAX];        // 解不开过 不再试
+} s_assets;
+
+static asset_part_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool hdr_valid(const asset_part_hdr_t *h, uint32_t part_size)
+{
+    return h->magic == ASSET_PART_MAGIC && h->version == ASSET_PART_VERSION && h->count &&
+           h->count <= ASSET_PART_MAX && h->data_bytes <= part_size - sizeof(*h) &&
+           h->count * sizeof(asset_part_entry_t) <= h->data_bytes;
+}
+
+static bool entry_valid(const asset_part_entry_t *e, const asset_part_hdr_t *h)
+{
+    uint32_t end = sizeof(*h) + h->data_bytes;
+    return e->name[ASSET_PART_NAME_MAX - 1] == '\0' && e->offset <= end && e->size <= end - e->offset &&
+           e->size <= e->raw_size && e->header.w && e->header.h;
+}
+
+// 解开一张图 out正好raw_size字节 数据不对返回false
+static bool rle_decode(const uint8_t *in, uint32_t in_len, uint8_t *out, uint32_t out_len)
+{
+    const uint8_t *end = in + in_len;
+    uint32_t o = 0;
+    while (in < end)
+    {
+        uint8_t c = *in++;
+        uint32_t n = (c & ~ASSET_RLE_RUN) + 1;
+        if (n > out_len - o || in + ((c & ASSET_RLE_RUN) ? 1 : n) > end)
+        {
+            return false;
+        }
+        if (c & ASSET_RLE_RUN)
+        {
+            memset(out + o, *in++, n);
+        }
+        else
+        {
+            memcpy(out + o, in, n);
+            in += n;
+        }
+        o += n;
+    }
+    return o == out_len;
+}
+
+// 第一次用压缩的图时调 解到PSRAM里 以后描述直接指着它
+static bool asset_decode(int i)
+{
+    const asset_part_entry_t *e = &s_assets.entries[i];
+    int64_t t0 = esp_timer_get_time();
+    uint8_t *buf = heap_caps_malloc(e->raw_size, MALLOC_CAP_SPIRAM);
+    if (buf == NULL || !rle_decode(s_assets.map + e->offset, e->size, buf, e->raw_size))
+    {
+        ESP_LOGE(TAG, "%s: %s", e->name, buf ? "bad data" : "no PSRAM");
+        heap_caps_free(buf);
+        s_assets.failed[i] = true;
+        return false;
+    }
+    s_assets.dsc[i].data = buf;
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.decodes++;
+    s_stats.decode_us += us;
+    if (us > s_stats.decode_max_us)
+    {
+        s_stats.decode_max_us = us;
+    }
+    s_stats.cached += e->raw_size;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%s: %lu -> %lu bytes in %lu us", e->name, (unsigned long)e->size, (unsigned long)e->raw_size,
+             (unsigned long)us);
+    return true;
+}
+
+esp_err_t asset_part_init(void)
+{
+    ESP_RETURN_ON_FALSE(s_assets.map == NULL, ESP_ERR_INVALID_STATE, TAG, "already mapped");
+    int64_t t0 = esp_timer_get_time();
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           ASSET_PART_PARTITION);
+    ESP_RETURN_ON_FALSE(part, ESP_ERR_NOT_FOUND, TAG, "no %s partition, icons will be symbols", ASSET_PART_PARTITION);
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, (const void **)&s_assets.map,
+                                           &s_assets.map_handle), TAG, "mmap failed");
+    const asset_part_hdr_t *h = (const asset_part_hdr_t *)s_assets.map;
+    if (!hdr_valid(h, part->size) || esp_rom_crc32_le(0, s_assets.map + sizeof(*h), h->data_bytes) != h->crc)
+    {
+        esp_partition_munmap(s_assets.map_handle);
+        s_assets.map = NULL;
+        ESP_LOGW(TAG, "%s partition holds no images, flash it with the app", ASSET_PART_PARTITION);
+        return ESP_ERR_INVALID_CRC;
+    }
+    s_assets.entries = (const asset_part_entry_t *)(s_assets.map + sizeof(*h));
+    uint32_t packed = 0, raw = 0;
+    for (int i = 0; i < h->count; i++)
+    {
+        const asset_part_entry_t *e = &s_assets.entries[i];
+        if (!entry_valid(e, h))
+        {
+            break; // 后面的不用 前面的照常
+        }
+        s_assets.dsc[i].header = e->header;
+        s_assets.dsc[i].data_size = e->raw_size;
+        s_assets.dsc[i].data = e->size == e->raw_size ? s_assets.map + e->offset : NULL;
+        s_assets.count = i + 1;
+        packed += e->size;
+        raw += e->raw_size;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.mapped = true;
+    s_stats.images = s_assets.count;
+    s_stats.bytes = sizeof(*h) + h->data_bytes;
+    s_stats.packed = packed;
+    s_stats.raw = raw;
+    s_stats.map_us = esp_timer_get_time() - t0;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%u images, %lu KB mapped and checked in %lu us, pixels %lu%% of raw", s_assets.count,
+             (unsigned long)s_stats.bytes / 1024, (unsigned long)s_stats.map_us,
+             (unsigned long)(raw ? (uint64_t)packed * 100 / raw : 0));
+    return ESP_OK;
+}
+
+const lv_img_dsc_t *asset_part_img(const char *name)
+{
+    const lv_img_dsc_t *dsc = NULL;
+    // 索引按名字排好 图少 直接二分
+    int lo = 0, hi = (int)s_assets.count - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        int c = strncmp(name, s_assets.entries[mid].name, ASSET_PART_NAME_MAX);
+        if (c == 0)
+        {
+            if (s_assets.dsc[mid].data || (!s_assets.failed[mid] && asset_decode(mid)))
+            {
+                dsc = &s_assets.dsc[mid];
+            }
+            break;
+        }
+        if (c < 0)
+        {
+            hi = mid - 1;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.lookups++;
+    s_stats.misses += dsc == NULL;
+    portEXIT_CRITICAL(&s_lock);
+    return dsc;
+}
+
+void asset_part_get_stats(asset_part_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+
+/*********************** flash里的图片资源 ****************************/
+// 主界面的图标和logo以前编进程序 每张图的每种颜色深度都在.c里 换个图标就要重编重烧整个程序
+// 现在构建时由tools/asset_pack把LVGL字节序的像素打包写进assets分区 和程序分开烧
+// 带透明的图拆成RGB565A8再RLE压缩 第一次用时解开放进PSRAM 以后一直用这份 LVGL直接混合不用逐像素转换
+// 主界面滚动时每帧不再读flash 压缩了不划算的图原样放 lv_img_dsc_t的data直接指着映射的flash
+// 分区是空的或者CRC不对时 asset_part_img返回NULL 界面换成符号图标
+// 分区里: 文件头 | 按名字排好的索引 | 像素 格式见tools/asset_pack/asset_pack.py
+// asset_part_img只在LVGL任务里或持有LVGL锁时用 和LVGL自己的图片一样不加锁
+
+#define ASSET_PART_PARTITION    "assets"
+#define ASSET_PART_MAGIC        0x31545341      // "AST1"
+#define ASSET_PART_VERSION      2
+#define ASSET_PART_MAX          32              // 最多这么多张图 描述放在内部RAM
+#define ASSET_PART_NAME_MAX     20
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t data_bytes;                // 文件头之后的字节数
+    uint32_t crc;                       // 文件头之后全部数据的CRC32
+} asset_part_hdr_t;
+
+typedef struct {
+    char name[ASSET_PART_NAME_MAX];     // lv_img_dsc_t的变量名 补0
+    uint32_t offset;                    // 像素相对分区开头
+    uint32_t size;                      // 分区里的字节数
+    uint32_t raw_size;                  // 解开以后 和size一样就是没压缩
+    lv_img_header_t header;             // cf是解开以后的格式
+} asset_part_entry_t;
+
+typedef struct {
+    bool mapped;
+    uint32_t images;
+    uint32_t bytes;                     // 分区里用了的
+    uint32_t packed;                    // 所有图在分区里的字节数
+    uint32_t raw;                       // 解开以后
+    uint32_t map_us;                    // 开机映射和校验花的时间
+    uint32_t lookups;
+    uint32_t misses;                    // 分区里没有或者解不开 换成了符号
+    uint32_t decodes;                   // 第一次用时解开的图
+    uint64_t decode_us;
+    uint32_t decode_max_us;
+    uint32_t cached;                    // PSRAM里解开的字节数
+} asset_part_stats_t;
+
+esp_err_t asset_part_init(void);        // LVGL起来之前调 失败了界面照常 图标换成符号
+// 按lv_img_dsc_t的变量名找 压缩的第一次在这里解开 返回的描述一直有效 没有返回NULL
+const lv_img_dsc_t *asset_part_img(const char *name);
+void asset_part_get_stats(asset_part_stats_t *stats);
@@ -0,0 +1,258 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "attitude.h"
+#include "task_plan.h"
+#include "imu.h"
+#include "esp32_s3_szp.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "attitude";
+
+#define ATT_DEG         57.29578f
+#define ATT_GYR_RAD     (1.0f / IMU_GYR_LSB_PER_DPS / ATT_DEG)  // 陀螺仪读数到弧度每秒
+#define ATT_DT          (1.0f / IMU_ODR_HZ)
+
+static float s_q[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+static float s_bias[3];                 // 积分项 就是估出来的陀螺仪零偏 弧度每秒
+static bool s_inited;                   // 第一个样本按重力直接把姿态摆正
+static int64_t s_t_last;
+static int64_t s_t_start;
+static uint32_t s_start_cursor;
+static volatile bool s_reset;
+static volatile bool s_running;
+static int s_users;                     // 和imu_start一样配对 最后一个停才停
+static attitude_t s_out;
+static atomic_uint s_seq;
+static volatile bool s_published;       // 这次开始以后发布过
+static attitude_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task;
+static attitude_cb_t s_listener;
+static int64_t s_listener_us;           // 两次通知的最短间隔
+static int64_t s_notified_us;
+
+// 只看重力 横滚和俯仰直接定下来 航向从0开始
+static void attitude_from_acc(float ax, float ay, float az)
+{
+    float roll = atan2f(ay, az) * 0.5f;
+    float pitch = atan2f(-ax, sqrtf(ay * ay + az * az)) * 0.5f;
+    float cr = cosf(roll), sr = sinf(roll);
+    float cp = cosf(pitch), sp = sinf(pitch);
+    s_q[0] = cr * cp;
+    s_q[1] = sr * cp;
+    s_q[2] = cr * sp;
+    s_q[3] = -sr * sp;
+    memset(s_bias, 0, sizeof(s_bias));
+}
+
+// 一步Mahony 陀螺仪弧度每秒 加速度任意刻度 dt秒
+static void mahony_update(float gx, float gy, float gz, float ax, float ay, float az, float dt, float kp)
+{
+    float *q = s_q;
+    float n = ax * ax + ay * ay + az * az;
+    if (n > 0.0f)
+    {
+        float r = 1.0f / sqrtf(n);
+        ax *= r;
+        ay *= r;
+        az *= r;
+        // 按现在的姿态 重力在传感器坐标里应该在哪 和量到的叉乘就是要转过去的误差
+        float vx = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+        float vy = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+        float vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+        s_bias[0] += ATTITUDE_KI * ex * dt;
+        s_bias[1] += ATTITUDE_KI * ey * dt;
+        s_bias[2] += ATTITUDE_KI * ez * dt;
+        gx += kp * ex + s_bias[0];
+        gy += kp * ey + s_bias[1];
+        gz += kp * ez + s_bias[2];
+    }
+    float h = 0.5f * dt;
+    float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+    q[0] += (-qx * gx - qy * gy - qz * gz) * h;
+    q[1] += (qw * gx + qy * gz - qz * gy) * h;
+    q[2] += (qw * gy - qx * gz + qz * gx) * h;
+    q[3] += (qw * gz + qx * gy - qy * gx) * h;
+    float r = 1.0f / sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    q[0] *= r;
+    q[1] *= r;
+    q[2] *= r;
+    q[3] *= r;
+}
+
+// 返回这个样本的间隔是不是不对
+static bool attitude_update(const imu_sample_t *s)
+{
+    float ax = s->acc[0], ay = s->acc[1], az = s->acc[2];
+    if (!s_inited)
+    {
+        attitude_from_acc(ax, ay, az);
+        s_inited = true;
+        s_t_last = s->t_us;
+        s_t_start = s->t_us;
+        return false;
+    }
+    // 两批之间按读出时刻推的时间会抖 差得太多就按标称间隔
+    float dt = (s->t_us - s_t_last) * 1e-6f;
+    s_t_last = s->t_us;
+    bool gap = dt < ATT_DT * 0.5f || dt > ATT_DT * 2.0f;
+    if (gap)
+    {
+        dt = ATT_DT;
+    }
+    float kp = s->t_us - s_t_start < ATTITUDE_SETTLE_MS * 1000 ? ATTITUDE_KP * 10.0f : ATTITUDE_KP;
+    mahony_update(s->gyr[0] * ATT_GYR_RAD, s->gyr[1] * ATT_GYR_RAD, s->gyr[2] * ATT_GYR_RAD, ax, ay, az, dt, kp);
+    return gap;
+}
+
+static void attitude_publish(int64_t t_us)
+{
+    const float *q = s_q;
+    attitude_t a;
+    memcpy(a.q, q, sizeof(a.q));
+    a.gravity[0] = 2.0f * (q[1] * q[3] - q[0] * q[2]);
+    a.gravity[1] = 2.0f * (q[0] * q[1] + q[2] * q[3]);
+    a.gravity[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+    a.roll = atan2f(2.0f * (q[0] * q[1] + q[2] * q[3]), 1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2])) * ATT_DEG;
+    float sp = 2.0f * (q[0] * q[2] - q[3] * q[1]);
+    a.pitch = asinf(sp > 1.0f ? 1.0f : sp < -1.0f ? -1.0f : sp) * ATT_DEG;
+    a.yaw = atan2f(2.0f * (q[0] * q[3] + q[1] * q[2]), 1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3])) * ATT_DEG;
+    memcpy(a.gyro_corr, s_bias, sizeof(a.gyro_corr));
+    a.t_us = t_us;
+
+    atomic_fetch_add_explicit(&s_seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    s_out = a;
+    atomic_fetch_add_explicit(&s_seq, 1, memory_order_release);
+    s_published = true;
+}
+
+static void attitude_task(void *arg)
+{
+    static imu_sample_t s_batch[QMI8658_FIFO_SAMPLES];
+    uint32_t cursor = 0;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_running)
+        {
+            continue;
+        }
+        if (s_reset)
+        {
+            s_reset = false;
+            s_inited = false;
+            cursor = s_start_cursor;
+        }
+        int total = 0;
+        int gaps = 0;
+        int n;
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        while ((n = imu_read(&cursor, s_batch, QMI8658_FIFO_SAMPLES)) > 0)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                gaps += attitude_update(&s_batch[i]);
+            }
+            total += n;
+        }
+        uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+        if (total == 0 || !s_inited)
+        {
+            continue;
+        }
+        attitude_publish(s_t_last);
+        attitude_cb_t cb = s_listener;
+        int64_t now = esp_timer_get_time();
+        if (cb && now - s_notified_us >= s_listener_us)
+        {
+            s_notified_us = now;
+            cb();
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.updates += total;
+        s_stats.batches++;
+        s_stats.cycles += cycles;
+        s_stats.gaps += gaps;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+esp_err_t attitude_start(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool first = s_users++ == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!first)
+    {
+        return ESP_OK; // 正在解算 不从头收敛
+    }
+    if (s_task == NULL)
+    {
+        ESP_RETURN_ON_FALSE(task_plan_create(TASK_ATTITUDE, attitude_task, NULL, &s_task) == pdPASS,
+                            ESP_ERR_NO_MEM, TAG, "task create failed");
+    }
+    s_published = false; // 上次的结果不要了
+    s_start_cursor = imu_head();
+    s_reset = true;
+    s_running = true;
+    return imu_add_listener(s_task);
+}
+
+void attitude_stop(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool last = s_users > 0 && --s_users == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!last)
+    {
+        return;
+    }
+    imu_remove_listener(s_task);
+    s_running = false;
+}
+
+void attitude_set_listener(attitude_cb_t cb, uint32_t min_interval_ms)
+{
+    s_listener_us = min_interval_ms * 1000LL;
+    s_notified_us = 0;
+    s_listener = cb;
+}
+
+bool attitude_get(attitude_t *out)
+{
+    if (!s_published)
+    {
+        return false;
+    }
+    unsigned s1, s2 = 0;
+    do
+    {
+        s1 = atomic_load_explicit(&s_seq, memory_order_acquire);
+        if (s1 & 1)
+        {
+            continue;
+        }
+        *out = s_out;
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&s_seq, memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+    return true;
+}
+
+void attitude_get_stats(attitude_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 姿态解算 ****************************/
+// 陀螺仪和加速度融合 Mahony互补滤波 每个FIFO样本都更新一次 跟采样任务的ODR一样快
+// 陀螺仪积分给出快速的转动 加速度量出来的重力方向慢慢纠正漂移 积分项顺带估出陀螺仪的零偏
+// 全部单精度 用四元数 只有出欧拉角时才算atan2f/asinf 一批样本算完才发布一次
+// 发布用序号锁: 写的时候序号是奇数 读的人读到前后序号一样而且是偶数才算数 不用锁
+
+#define ATTITUDE_KP             1.0f    // 按重力纠正的比例增益 大了跟加速度跟得紧 小了更平滑
+#define ATTITUDE_KI             0.02f   // 积分增益 估陀螺仪零偏
+#define ATTITUDE_SETTLE_MS      500     // 刚开始用大增益收敛 这段时间以后回到正常
+
+typedef struct {
+    float q[4];                         // w x y z 传感器坐标到地面坐标
+    float roll;                         // 度
+    float pitch;
+    float yaw;                          // 没有磁力计 只是相对开始时的方向 会慢慢漂
+    float gravity[3];                   // 传感器坐标里的重力方向 单位向量
+    float gyro_corr[3];                 // 估出来的零偏修正 弧度每秒 加到陀螺仪读数上
+    int64_t t_us;                       // 最后一个样本的时刻
+} attitude_t;
+
+typedef struct {
+    uint32_t updates;                   // 滤波更新的次数 一个样本一次
+    uint32_t batches;
+    uint64_t cycles;                    // 更新花的CPU周期
+    uint32_t gaps;                      // 样本间隔不对 按标称间隔算的
+} attitude_stats_t;
+
+// 发布以后在解算任务里调 不超过设的频率 界面要刷就自己post到LVGL任务 不用开定时器去问
+typedef void (*attitude_cb_t)(void);
+
+esp_err_t attitude_start(void);         // imu_start之后调用 从头开始收敛 已经在解算就只记一个用的人
+void attitude_stop(void);               // 和attitude_start配对
+bool attitude_get(attitude_t *out);     // 还没有结果返回false
+void attitude_set_listener(attitude_cb_t cb, uint32_t min_interval_ms);    // NULL取消
+void attitude_get_stats(attitude_stats_t *stats);
@@ -0,0 +1,115 @@
+#include <string.h>
+#include "audio_adpcm.h"
+
+static const int16_t s_step[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t s_index_adj[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+void audio_adpcm_init(audio_adpcm_t *st)
+{
+    st->index = 0;
+}
+
+// 和解码器算出一样的预测值 误差不会越积越大
+static inline uint8_t adpcm_encode(int *pred, int *index, int sample)
+{
+    int step = s_step[*index];
+    int diff = sample - *pred;
+    uint8_t nib = 0;
+    if (diff < 0) {
+        nib = 8;
+        diff = -diff;
+    }
+    int vpdiff = step >> 3;
+    if (diff >= step) {
+        nib |= 4;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nib |= 2;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        nib |= 1;
+        vpdiff += step;
+    }
+    int p = (nib & 8) ? *pred - vpdiff : *pred + vpdiff;
+    *pred = p < -32768 ? -32768 : p > 32767 ? 32767 : p;
+    int i = *index + s_index_adj[nib & 7];
+    *index = i < 0 ? 0 : i > 88 ? 88 : i;
+    return nib;
+}
+
+// 和编码器一样更新预测值和步长
+static inline int16_t adpcm_decode(int *pred, int *index, uint8_t nib)
+{
+    int step = s_step[*index];
+    int vpdiff = step >> 3;
+    if (nib & 4) {
+        vpdiff += step;
+    }
+    if (nib & 2) {
+        vpdiff += step >> 1;
+    }
+    if (nib & 1) {
+        vpdiff += step >> 2;
+    }
+    int p = (nib & 8) ? *pred - vpdiff : *pred + vpdiff;
+    *pred = p < -32768 ? -32768 : p > 32767 ? 32767 : p;
+    int i = *index + s_index_adj[nib & 7];
+    *index = i < 0 ? 0 : i > 88 ? 88 : i;
+    return (int16_t)*pred;
+}
+
+size_t audio_adpcm_encode_frame(audio_adpcm_t *st, const int16_t *pcm, size_t n, uint8_t *out)
+{
+    int pred = pcm[0];
+    int index = st->index;
+    out[0] = (uint8_t)pred;
+    out[1] = (uint8_t)(pred >> 8);
+    out[2] = (uint8_t)index;
+    out[3] = 0;
+    uint8_t *p = out + 4;
+    size_t i = 1;
+    for (; i + 1 < n; i += 2) {
+        uint8_t lo = adpcm_encode(&pred, &index, pcm[i]);
+        uint8_t hi = adpcm_encode(&pred, &index, pcm[i + 1]);
+        *p++ = lo | (hi << 4);
+    }
+    if (i < n) {
+        *p++ = adpcm_encode(&pred, &index, pcm[i]);
+    }
+    st->index = index;
+    return p - out;
+}
+
+void audio_adpcm_encode_block(audio_adpcm_t *st, const int16_t *pcm, uint8_t *out)
+{
+    audio_adpcm_encode_frame(st, pcm, ADPCM_BLOCK_SAMPLES, out);
+}
+
+void audio_adpcm_decode_frame(const uint8_t *in, int16_t *pcm, size_t n)
+{
+    int pred = (int16_t)(in[0] | in[1] << 8);
+    int index = in[2] > 88 ? 88 : in[2];
+    const uint8_t *p = in + 4;
+    pcm[0] = (int16_t)pred;
+    size_t i = 1;
+    for (; i + 1 < n; i += 2, p++) {
+        pcm[i] = adpcm_decode(&pred, &index, *p & 0x0f);
+        pcm[i + 1] = adpcm_decode(&pred, &index, *p >> 4);
+    }
+    if (i < n) {
+        pcm[i] = adpcm_decode(&pred, &index, *p & 0x0f);
+    }
+}
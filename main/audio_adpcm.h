@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*********************** IMA ADPCM编码 ****************************/
+// 单声道16位PCM压到4位 和WAV的IMA ADPCM(格式0x0011)一样按块编 块与块之间只带步长下标
+// 每块开头存第一个样本和步长下标 后面每字节两个样本 低4位在前 块坏了只影响这一块
+// 一个样本几十个周期 16k的录音不到1%的CPU
+// 块长也可以自己定(对讲一包一块) 解码不用跨块的状态 丢了一块下一块照样解
+
+#define ADPCM_BLOCK_BYTES       256
+#define ADPCM_BLOCK_SAMPLES     ((ADPCM_BLOCK_BYTES - 4) * 2 + 1)   // 505 头里一个 后面每字节两个
+#define ADPCM_WAV_FORMAT        0x0011
+#define ADPCM_FRAME_BYTES(n)    (4 + (n) / 2)   // n个样本一块的字节数 n是偶数时最后半个字节空着
+
+typedef struct {
+    int index;                  // 步长表下标 0..88 跨块保留 收敛快一点
+} audio_adpcm_t;
+
+void audio_adpcm_init(audio_adpcm_t *st);
+// 编一整块 pcm正好ADPCM_BLOCK_SAMPLES个 out正好ADPCM_BLOCK_BYTES字节
+void audio_adpcm_encode_block(audio_adpcm_t *st, const int16_t *pcm, uint8_t *out);
+// n个样本编成一块 out要ADPCM_FRAME_BYTES(n)字节 返回写了多少
+size_t audio_adpcm_encode_frame(audio_adpcm_t *st, const int16_t *pcm, size_t n, uint8_t *out);
+// 解一块 in是ADPCM_FRAME_BYTES(n)字节 步长下标在块头里
+void audio_adpcm_decode_frame(const uint8_t *in, int16_t *pcm, size_t n);
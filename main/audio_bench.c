@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include "audio_bench.h"
+#include "task_plan.h"
+#include "audio_player.h"
+#include "boot.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "audio_bench";
+
+#define AUDIO_BENCH_PATH_LEN    (sizeof(AUDIO_BENCH_DIR) + 256)
+
+esp_err_t audio_bench_run(const char *dir)
+{
+    DIR *d = opendir(dir);
+    ESP_RETURN_ON_FALSE(d, ESP_ERR_NOT_FOUND, TAG, "cannot open %s", dir);
+
+    static char path[AUDIO_BENCH_PATH_LEN];
+    int files = 0;
+    struct dirent *de;
+
+    // CPU %是实时播放时解码占核0的比例 和语音 频谱这些同时跑时剩多少看它
+    ESP_LOGI(TAG, "%-24s %-5s %6s %8s %10s %8s %8s %8s %8s %6s %8s %8s", "file", "codec", "rate", "frames",
+             "cyc/frame", "p50 us", "p99 us", "max us", "x RT", "CPU %", "int KB", "psram KB");
+    while ((de = readdir(d)) != NULL && files < AUDIO_BENCH_MAX_FILES)
+    {
+        if (de->d_type != DT_REG || de->d_name[0] == '.')
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+        FILE *fp = fopen(path, "rb");
+        if (fp == NULL)
+        {
+            continue;
+        }
+
+        audio_player_bench_result_t r;
+        esp_err_t ret = audio_player_benchmark(fp, &r);   // 会关闭fp
+        if (ret == ESP_ERR_NOT_SUPPORTED)
+        {
+            continue;   // 不是音频文件
+        }
+        files++;
+        ESP_LOGI(TAG, "%-24.24s %-5s %6lu %8lu %10llu %8lu %8lu %8lu %8.1f %6.1f %8u %8u%s", de->d_name,
+                 r.codec ? r.codec : "?", (unsigned long)r.sample_rate, (unsigned long)r.frames,
+                 (unsigned long long)(r.frames ? r.total_cycles / r.frames : 0),
+                 (unsigned long)r.p50_us, (unsigned long)r.p99_us, (unsigned long)r.max_us, r.realtime,
+                 r.realtime > 0 ? 100.0f / r.realtime : 0.0f,
+                 (unsigned)(r.heap_internal_peak / 1024), (unsigned)(r.heap_psram_peak / 1024),
+                 ret == ESP_OK ? "" : "  (decode error)");
+        vTaskDelay(1);
+    }
+    closedir(d);
+    ESP_LOGI(TAG, "%d files benchmarked", files);
+    return ESP_OK;
+}
+
+static void audio_bench_task(void *arg)
+{
+    boot_wait(BOOT_BIT(BOOT_STAGE_SD), BOOT_WAIT_FOREVER);
+    if (boot_ready(BOOT_STAGE_SD))
+    {
+        audio_bench_run(AUDIO_BENCH_DIR);
+    }
+    vTaskDelete(NULL);
+}
+
+// 钉在核0 周期计数器是每个核自己的 迁核会让单帧计数失真
+esp_err_t audio_bench_start(void)
+{
+    BaseType_t ok = task_plan_create(TASK_AUDIO_BENCH, audio_bench_task, NULL, NULL);
+    return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
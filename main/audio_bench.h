@@ -0,0 +1,14 @@
+#pragma once
+
+#include "esp_err.h"
+
+
+/*********************** 解码器基准测试 ****************************/
+// 把目录里的MP3/WAV/FLAC逐个完整解码一遍 输出丢弃 打印每个文件的耗时表
+// 每帧周期数 p50/p99单帧耗时 实时倍数 峰值堆占用 用来比较各解码器和优化前后
+
+#define AUDIO_BENCH_DIR         "/sdcard/bench"
+#define AUDIO_BENCH_MAX_FILES   32
+
+esp_err_t audio_bench_run(const char *dir);     // 在调用者任务里同步执行 可能要几十秒
+esp_err_t audio_bench_start(void);              // 等SD卡挂载后在后台任务里跑AUDIO_BENCH_DIR
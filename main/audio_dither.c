@@ -0,0 +1,68 @@
+#include "audio_dither.h"
+#include "esp_cpu.h"
+
+// 每路一个不同的非零种子
+void audio_dither_init(audio_dither_t *d)
+{
+    static const uint32_t seeds[DITHER_LANES] = { 0x9e3779b9, 0x7f4a7c15, 0x85ebca6b, 0xc2b2ae35 };
+    for (int k = 0; k < DITHER_LANES; k++) {
+        d->seed[k] = seeds[k];
+    }
+    d->cycles = 0;
+    d->samples = 0;
+}
+
+static inline uint32_t xorshift32(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// 两个16位均匀数相加是±65535的三角分布 加0x8000做舍入 移到16位
+// 先各自右移8位再相加 不会溢出 24位样本的低8位本来就是0
+static inline uint32_t dither_one(int32_t s, uint32_t r)
+{
+    int32_t n = (int32_t)(r & 0xffff) + (int32_t)(r >> 16) - 0xffff + 0x8000;
+    int32_t v = ((s >> 8) + (n >> 8)) >> 8;
+    v = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+    return (uint16_t)v;
+}
+
+size_t audio_dither_s32_to_s16(audio_dither_t *d, void *out, const void *in, size_t samples)
+{
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    // 输入输出用同一种字 原地处理时编译器不会把写回提到读之前
+    const int32_t *src = in;
+    uint32_t *dst = out;
+    uint32_t r0 = d->seed[0], r1 = d->seed[1], r2 = d->seed[2], r3 = d->seed[3];
+    size_t i = 0;
+    for (; i + DITHER_LANES <= samples; i += DITHER_LANES) {
+        int32_t a = src[i], b = src[i + 1], c = src[i + 2], e = src[i + 3];
+        r0 = xorshift32(r0);
+        r1 = xorshift32(r1);
+        r2 = xorshift32(r2);
+        r3 = xorshift32(r3);
+        // 小端 前一个样本在低16位
+        dst[i / 2] = dither_one(a, r0) | (dither_one(b, r1) << 16);
+        dst[i / 2 + 1] = dither_one(c, r2) | (dither_one(e, r3) << 16);
+    }
+    for (; i < samples; i++) {
+        int32_t a = src[i];
+        r0 = xorshift32(r0);
+        uint32_t v = dither_one(a, r0);
+        if (i & 1) {
+            dst[i / 2] = (dst[i / 2] & 0xffff) | (v << 16);
+        } else {
+            dst[i / 2] = (dst[i / 2] & 0xffff0000) | v;
+        }
+    }
+    d->seed[0] = r0;
+    d->seed[1] = r1;
+    d->seed[2] = r2;
+    d->seed[3] = r3;
+    d->cycles += esp_cpu_get_cycle_count() - c0;
+    d->samples += samples;
+    return samples * sizeof(int16_t);
+}
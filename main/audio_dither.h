@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/*********************** 32位转16位的TPDF抖动 ****************************/
+// 24/32位PCM必须降到16位输出时用 左对齐的32位容器 加±1LSB三角分布噪声后舍入到16位 截断失真变成平坦的底噪
+// 噪声每个样本用一个xorshift32 高低16位相加即是三角分布 四路各自一个种子 互不依赖
+// 一次四个样本 两个16位结果拼成一个字写回 可以原地处理 输出占输入的前一半
+
+#define DITHER_LANES    4
+
+typedef struct {
+    uint32_t seed[DITHER_LANES];
+    uint64_t cycles;                    // 累计CPU周期
+    uint64_t samples;                   // 累计样本数
+} audio_dither_t;
+
+void audio_dither_init(audio_dither_t *d);
+// in是左对齐的32位样本 out可以和in是同一块缓冲 返回输出字节数
+size_t audio_dither_s32_to_s16(audio_dither_t *d, void *out, const void *in, size_t samples);
@@ -0,0 +1,374 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "audio_eq.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "dsps_biquad.h"
+#include "dsps_biquad_gen.h"
+
+static const char *TAG = "audio_eq";
+
+#define EQ_NVS_NAMESPACE    "audio_eq"
+#define EQ_NVS_SELECTED     "sel"
+#define EQ_STATS_PERIOD_S   10
+
+// 10段 31Hz~16kHz 倍频程分布 两端用架式滤波
+#define EQ_BANDS_INIT(g0, g1, g2, g3, g4, g5, g6, g7, g8, g9) { \
+    { AUDIO_EQ_LOW_SHELF,  31,    0.707f, g0 }, \
+    { AUDIO_EQ_PEAK,       62,    1.41f,  g1 }, \
+    { AUDIO_EQ_PEAK,       125,   1.41f,  g2 }, \
+    { AUDIO_EQ_PEAK,       250,   1.41f,  g3 }, \
+    { AUDIO_EQ_PEAK,       500,   1.41f,  g4 }, \
+    { AUDIO_EQ_PEAK,       1000,  1.41f,  g5 }, \
+    { AUDIO_EQ_PEAK,       2000,  1.41f,  g6 }, \
+    { AUDIO_EQ_PEAK,       4000,  1.41f,  g7 }, \
+    { AUDIO_EQ_PEAK,       8000,  1.41f,  g8 }, \
+    { AUDIO_EQ_HIGH_SHELF, 16000, 0.707f, g9 }, \
+}
+
+static const audio_eq_preset_t s_builtin[] = {
+    { "Flat",   EQ_BANDS_INIT(0, 0, 0, 0, 0, 0, 0, 0, 0, 0) },
+    { "Bass",   EQ_BANDS_INIT(6, 5, 4, 2, 0, 0, 0, 0, 0, 0) },
+    { "Treble", EQ_BANDS_INIT(0, 0, 0, 0, 0, 0, 2, 4, 5, 6) },
+    { "Vocal",  EQ_BANDS_INIT(-2, -2, -1, 1, 3, 4, 3, 1, 0, -1) },
+    { "Rock",   EQ_BANDS_INIT(4, 3, 1, -1, -2, -1, 1, 3, 4, 4) },
+};
+#define EQ_BUILTIN_COUNT (int)(sizeof(s_builtin) / sizeof(s_builtin[0]))
+
+// 一组可以直接交给解码任务使用的系数
+typedef struct {
+    float coef[AUDIO_EQ_BANDS][5];      // b0 b1 b2 a1 a2
+    uint8_t band_map[AUDIO_EQ_BANDS];   // 参与计算的频段 跳过增益为0的频段
+    uint8_t count;
+    float preamp;                       // 预留余量 防止提升后削波
+} eq_coefs_t;
+
+static audio_eq_preset_t s_current;
+static int s_selected = 0;
+static uint32_t s_rate = 44100;
+static int s_channels = 2;
+
+// 双缓冲 UI任务算好后切换下标 解码任务在下一块开始时取用
+static eq_coefs_t s_coefs[2];
+static volatile int s_coefs_active = 0;
+static volatile bool s_coefs_dirty = false;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_update_mutex = NULL; // UI调整和采样率变化可能同时重算系数
+
+static volatile int s_coefs_used = 0;      // 解码任务正在用的一组 只由解码任务修改
+// 以下只在解码任务中访问
+static float s_delay[AUDIO_EQ_BANDS][4];
+static float s_work[AUDIO_EQ_BLOCK_FRAMES * 2];
+
+static audio_eq_stats_t s_stats;
+static uint64_t s_cycles_sum = 0;
+static uint64_t s_frames_sum = 0;
+static uint32_t s_report_frames = 0;
+
+// RBJ峰值滤波 esp-dsp的peakingEQ没有增益参数 这里自己算
+static void eq_gen_peak(float *c, float f, float gain_db, float q)
+{
+    float A = powf(10.0f, gain_db / 40.0f);
+    float w0 = 2.0f * (float)M_PI * f;
+    float alpha = sinf(w0) / (2.0f * q);
+    float cw = cosf(w0);
+    float a0 = 1.0f + alpha / A;
+    c[0] = (1.0f + alpha * A) / a0;
+    c[1] = (-2.0f * cw) / a0;
+    c[2] = (1.0f - alpha * A) / a0;
+    c[3] = (-2.0f * cw) / a0;
+    c[4] = (1.0f - alpha / A) / a0;
+}
+
+// 按当前设置和采样率计算系数 写入解码任务没有在用的那一组
+// 先撤销未取走的更新 保证写入期间解码任务不会切换到这一组
+static void eq_update_coefs(void)
+{
+    if (s_update_mutex == NULL)
+    {
+        return; // 未初始化 保持直通
+    }
+    xSemaphoreTake(s_update_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&s_lock);
+    s_coefs_dirty = false;
+    int next = s_coefs_used ^ 1;
+    audio_eq_preset_t cur = s_current;
+    uint32_t rate = s_rate;
+    portEXIT_CRITICAL(&s_lock);
+
+    eq_coefs_t *c = &s_coefs[next];
+    float max_gain = 0.0f;
+    c->count = 0;
+    for (int b = 0; b < AUDIO_EQ_BANDS; b++)
+    {
+        const audio_eq_band_t *band = &cur.bands[b];
+        float f = (float)band->freq / (float)rate;
+        if (fabsf(band->gain_db) < 0.05f || f >= 0.49f)
+        {
+            continue; // 平直或超过奈奎斯特频率的频段不参与计算
+        }
+        float *k = c->coef[c->count];
+        switch (band->type)
+        {
+        case AUDIO_EQ_LOW_SHELF:
+            dsps_biquad_gen_lowShelf_f32(k, f, band->gain_db, band->q);
+            break;
+        case AUDIO_EQ_HIGH_SHELF:
+            dsps_biquad_gen_highShelf_f32(k, f, band->gain_db, band->q);
+            break;
+        default:
+            eq_gen_peak(k, f, band->gain_db, band->q);
+            break;
+        }
+        c->band_map[c->count++] = b;
+        if (band->gain_db > max_gain)
+        {
+            max_gain = band->gain_db;
+        }
+    }
+    c->preamp = powf(10.0f, -max_gain / 20.0f) / 32768.0f;
+
+    portENTER_CRITICAL(&s_lock);
+    s_coefs_active = next;
+    s_coefs_dirty = true;
+    s_stats.active_bands = c->count;
+    portEXIT_CRITICAL(&s_lock);
+    xSemaphoreGive(s_update_mutex);
+}
+
+void audio_eq_process(int16_t *pcm, size_t frames)
+{
+    if (s_coefs_dirty)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_coefs_used = s_coefs_active;
+        s_coefs_dirty = false;
+        portEXIT_CRITICAL(&s_lock);
+        memset(s_delay, 0, sizeof(s_delay)); // 系数变化后清空延迟线 避免不稳定
+    }
+    const eq_coefs_t *c = &s_coefs[s_coefs_used];
+    if (c->count == 0)
+    {
+        return; // 全部平直 直通
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    const int ch = s_channels;
+    for (size_t pos = 0; pos < frames; pos += AUDIO_EQ_BLOCK_FRAMES)
+    {
+        size_t n = frames - pos < AUDIO_EQ_BLOCK_FRAMES ? frames - pos : AUDIO_EQ_BLOCK_FRAMES;
+        int16_t *p = pcm + pos * ch;
+        size_t samples = n * ch;
+        for (size_t i = 0; i < samples; i++)
+        {
+            s_work[i] = p[i] * c->preamp;
+        }
+        for (int b = 0; b < c->count; b++)
+        {
+            float *k = (float *)c->coef[b];
+            float *w = s_delay[c->band_map[b]];
+            if (ch == 2)
+            {
+                dsps_biquad_sf32(s_work, s_work, n, k, w);
+            }
+            else
+            {
+                dsps_biquad_f32(s_work, s_work, n, k, w);
+            }
+        }
+        for (size_t i = 0; i < samples; i++)
+        {
+            float v = s_work[i] * 32768.0f;
+            p[i] = v >= 32767.0f ? 32767 : (v <= -32768.0f ? -32768 : (int16_t)v);
+        }
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    s_cycles_sum += cycles;
+    s_frames_sum += frames;
+    s_stats.frames += frames;
+    s_stats.cycles_per_frame = (uint32_t)(s_cycles_sum / s_frames_sum);
+    s_stats.load_permille = (uint32_t)((uint64_t)s_stats.cycles_per_frame * s_rate / (esp_rom_get_cpu_ticks_per_us() * 1000));
+    if (s_stats.frames - s_report_frames >= s_rate * EQ_STATS_PERIOD_S)
+    {
+        s_report_frames = s_stats.frames;
+        ESP_LOGI(TAG, "%d bands: %lu cycles/frame, load %lu.%lu%% at %lu Hz", c->count,
+                 (unsigned long)s_stats.cycles_per_frame, (unsigned long)(s_stats.load_permille / 10),
+                 (unsigned long)(s_stats.load_permille % 10), (unsigned long)s_rate);
+    }
+}
+
+void audio_eq_set_rate(uint32_t rate, int channels)
+{
+    if (rate == 0 || (rate == s_rate && channels == s_channels))
+    {
+        return;
+    }
+    s_rate = rate;
+    s_channels = channels;
+    s_stats.rate = rate;
+    s_cycles_sum = 0;
+    s_frames_sum = 0;
+    eq_update_coefs();
+}
+
+static esp_err_t eq_load_user(int slot, audio_eq_preset_t *preset)
+{
+    nvs_handle_t nvs;
+    char key[8];
+    snprintf(key, sizeof(key), "p%d", slot);
+    ESP_RETURN_ON_ERROR(nvs_open(EQ_NVS_NAMESPACE, NVS_READONLY, &nvs), TAG, "no eq presets");
+    size_t len = sizeof(*preset);
+    esp_err_t ret = nvs_get_blob(nvs, key, preset, &len);
+    nvs_close(nvs);
+    if (ret == ESP_OK && len != sizeof(*preset))
+    {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    return ret;
+}
+
+esp_err_t audio_eq_init(void)
+{
+    if (s_update_mutex)
+    {
+        return ESP_OK;
+    }
+    s_update_mutex = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_update_mutex, ESP_ERR_NO_MEM, TAG, "no memory");
+    s_current = s_builtin[0];
+    s_selected = 0;
+
+    nvs_handle_t nvs;
+    uint8_t sel = 0;
+    if (nvs_open(EQ_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK)
+    {
+        nvs_get_u8(nvs, EQ_NVS_SELECTED, &sel);
+        nvs_close(nvs);
+    }
+    if (sel && audio_eq_select(sel) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "preset %d unavailable, using flat", sel);
+    }
+    eq_update_coefs();
+    ESP_LOGI(TAG, "preset %d '%s'", s_selected, s_current.name);
+    return ESP_OK;
+}
+
+int audio_eq_builtin_count(void)
+{
+    return EQ_BUILTIN_COUNT;
+}
+
+const char *audio_eq_preset_name(int index)
+{
+    static audio_eq_preset_t user; // 只在UI任务里调用
+    if (index >= 0 && index < EQ_BUILTIN_COUNT)
+    {
+        return s_builtin[index].name;
+    }
+    if (index >= EQ_BUILTIN_COUNT && index < EQ_BUILTIN_COUNT + AUDIO_EQ_USER_PRESETS &&
+        eq_load_user(index - EQ_BUILTIN_COUNT, &user) == ESP_OK)
+    {
+        user.name[sizeof(user.name) - 1] = 0;
+        return user.name;
+    }
+    return NULL;
+}
+
+esp_err_t audio_eq_select(int index)
+{
+    audio_eq_preset_t preset;
+    if (index >= 0 && index < EQ_BUILTIN_COUNT)
+    {
+        preset = s_builtin[index];
+    }
+    else
+    {
+        ESP_RETURN_ON_FALSE(index < EQ_BUILTIN_COUNT + AUDIO_EQ_USER_PRESETS, ESP_ERR_INVALID_ARG, TAG, "bad preset %d", index);
+        ESP_RETURN_ON_ERROR(eq_load_user(index - EQ_BUILTIN_COUNT, &preset), TAG, "load preset %d", index);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_current = preset;
+    portEXIT_CRITICAL(&s_lock);
+    s_selected = index;
+    eq_update_coefs();
+
+    nvs_handle_t nvs;
+    if (nvs_open(EQ_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        if (nvs_set_u8(nvs, EQ_NVS_SELECTED, (uint8_t)index) == ESP_OK)
+        {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    return ESP_OK;
+}
+
+int audio_eq_selected(void)
+{
+    return s_selected;
+}
+
+esp_err_t audio_eq_set_band(int band, float gain_db)
+{
+    ESP_RETURN_ON_FALSE(band >= 0 && band < AUDIO_EQ_BANDS, ESP_ERR_INVALID_ARG, TAG, "bad band %d", band);
+    if (gain_db > AUDIO_EQ_GAIN_MAX_DB)
+    {
+        gain_db = AUDIO_EQ_GAIN_MAX_DB;
+    }
+    if (gain_db < -AUDIO_EQ_GAIN_MAX_DB)
+    {
+        gain_db = -AUDIO_EQ_GAIN_MAX_DB;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_current.bands[band].gain_db = gain_db;
+    portEXIT_CRITICAL(&s_lock);
+    eq_update_coefs();
+    return ESP_OK;
+}
+
+esp_err_t audio_eq_save_user(int slot, const char *name)
+{
+    ESP_RETURN_ON_FALSE(slot >= 0 && slot < AUDIO_EQ_USER_PRESETS, ESP_ERR_INVALID_ARG, TAG, "bad slot %d", slot);
+    audio_eq_preset_t preset;
+    audio_eq_get(&preset);
+    strlcpy(preset.name, name, sizeof(preset.name));
+
+    nvs_handle_t nvs;
+    char key[8];
+    snprintf(key, sizeof(key), "p%d", slot);
+    ESP_RETURN_ON_ERROR(nvs_open(EQ_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs_open failed");
+    esp_err_t ret = nvs_set_blob(nvs, key, &preset, sizeof(preset));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (ret == ESP_OK)
+    {
+        s_current = preset;
+        s_selected = EQ_BUILTIN_COUNT + slot;
+    }
+    return ret;
+}
+
+void audio_eq_get(audio_eq_preset_t *preset)
+{
+    portENTER_CRITICAL(&s_lock);
+    *preset = s_current;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void audio_eq_get_stats(audio_eq_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+
+/*********************** 参数均衡器 ****************************/
+// 级联双二阶滤波 用esp-dsp的dsps_biquad_sf32(立体声)/dsps_biquad_f32(单声道)
+// 在解码输出缓冲上原地处理 分块转换为浮点 不做逐帧分配
+// 增益为0的频段直接跳过 全部为0时整个均衡器直通
+
+#define AUDIO_EQ_BANDS          10      // 频段数
+#define AUDIO_EQ_GAIN_MAX_DB    12.0f   // 单频段增益范围 ±12dB
+#define AUDIO_EQ_BLOCK_FRAMES   256     // 每次转换为浮点处理的帧数
+#define AUDIO_EQ_USER_PRESETS   4       // NVS中可保存的用户预设数
+
+typedef enum {
+    AUDIO_EQ_PEAK = 0,                  // 峰值(钟形)
+    AUDIO_EQ_LOW_SHELF,                 // 低架
+    AUDIO_EQ_HIGH_SHELF,                // 高架
+} audio_eq_type_t;
+
+typedef struct {
+    uint8_t type;                       // audio_eq_type_t
+    uint16_t freq;                      // 中心/转折频率(Hz)
+    float q;
+    float gain_db;
+} audio_eq_band_t;
+
+typedef struct {
+    char name[16];
+    audio_eq_band_t bands[AUDIO_EQ_BANDS];
+} audio_eq_preset_t;
+
+typedef struct {
+    uint32_t rate;                      // 当前采样率
+    uint8_t active_bands;               // 增益不为0的频段数
+    uint32_t frames;                    // 累计处理的帧数
+    uint32_t cycles_per_frame;          // 平均每个立体声帧的CPU周期
+    uint32_t load_permille;             // 按当前采样率折算的单核占用千分比
+} audio_eq_stats_t;
+
+esp_err_t audio_eq_init(void);                          // 从NVS读出上次选择的预设
+void audio_eq_set_rate(uint32_t rate, int channels);    // 输出格式变化时由PCM层调用 重新计算系数
+void audio_eq_process(int16_t *pcm, size_t frames);     // 在解码任务中原地处理16位PCM
+
+int audio_eq_builtin_count(void);                       // 内置预设数 序号之后是用户预设
+const char *audio_eq_preset_name(int index);
+esp_err_t audio_eq_select(int index);                   // 选择预设并记住选择
+int audio_eq_selected(void);
+esp_err_t audio_eq_set_band(int band, float gain_db);   // 调整当前设置中的一个频段
+esp_err_t audio_eq_save_user(int slot, const char *name); // 把当前设置存为用户预设
+void audio_eq_get(audio_eq_preset_t *preset);           // 取当前设置
+void audio_eq_get_stats(audio_eq_stats_t *stats);
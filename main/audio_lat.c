@@ -0,0 +1,210 @@
+#include <string.h>
+#include "audio_lat.h"
+#include "esp32_s3_szp.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "audio_lat";
+
+#define LAT_REPORT_DELAY_MS     20      // 走完以后过这么久再打印 不占送数任务的时间
+
+static const char *const s_names[AUDIO_LAT_STAGES] = {
+    "input", "stopped", "open", "decode", "format", "codec", "unmute", "pcm", "i2s", "dma",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool s_armed;           // 正在计时
+static bool s_reporting;                // 已经定了打印 还没打印
+static int64_t s_t[AUDIO_LAT_STAGES];   // 各站的时刻 0是没经过
+static const char *s_what;
+static audio_lat_stats_t s_stats;
+static esp_timer_handle_t s_report_timer;
+
+// 在中断里也要用 按字比较 DMA缓冲都是4字节对齐的
+static IRAM_ATTR bool lat_nonzero(const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    size_t i = 0;
+    if (((uintptr_t)p & 3) == 0)
+    {
+        for (; i + 4 <= len; i += 4)
+        {
+            if (*(const uint32_t *)(p + i))
+            {
+                return true;
+            }
+        }
+    }
+    for (; i < len; i++)
+    {
+        if (p[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// I2S发送中断 非零数据交给I2S以后才开始看
+static IRAM_ATTR void lat_on_sent(const void *buf, size_t size)
+{
+    if (!s_armed)
+    {
+        return;
+    }
+    portENTER_CRITICAL_ISR(&s_lock);
+    bool want = s_armed && s_t[AUDIO_LAT_I2S] && !s_t[AUDIO_LAT_DMA];
+    portEXIT_CRITICAL_ISR(&s_lock);
+    if (want && lat_nonzero(buf, size))
+    {
+        int64_t now = esp_timer_get_time();
+        portENTER_CRITICAL_ISR(&s_lock);
+        s_t[AUDIO_LAT_DMA] = now;
+        portEXIT_CRITICAL_ISR(&s_lock);
+    }
+}
+
+// 在esp_timer任务里 按时间先后打印每一站
+static void lat_report(void *arg)
+{
+    int64_t t[AUDIO_LAT_STAGES];
+    portENTER_CRITICAL(&s_lock);
+    if (!s_reporting)
+    {
+        portEXIT_CRITICAL(&s_lock);
+        return; // 打印之前又点了一次 这一趟让给新的
+    }
+    memcpy(t, s_t, sizeof(t));
+    const char *what = s_what;
+    s_reporting = false;
+    s_armed = false;
+    bool done = t[AUDIO_LAT_DMA] != 0;
+    uint32_t total = done ? (uint32_t)(t[AUDIO_LAT_DMA] - t[AUDIO_LAT_INPUT]) : 0;
+    if (done)
+    {
+        s_stats.runs++;
+        s_stats.sum_us += total;
+        s_stats.min_us = (s_stats.min_us == 0 || total < s_stats.min_us) ? total : s_stats.min_us;
+        s_stats.max_us = total > s_stats.max_us ? total : s_stats.max_us;
+        for (int i = 0; i < AUDIO_LAT_STAGES; i++)
+        {
+            s_stats.last_us[i] = t[i] ? (uint32_t)(t[i] - t[AUDIO_LAT_INPUT]) : 0;
+        }
+    }
+    else
+    {
+        s_stats.timeouts++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (done)
+    {
+        ESP_LOGI(TAG, "%s: %.1f ms to sound", what, total / 1000.0f);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "%s: no sound within %d ms", what, AUDIO_LAT_TIMEOUT_MS);
+    }
+    int64_t prev = t[AUDIO_LAT_INPUT];
+    bool shown[AUDIO_LAT_STAGES] = {[AUDIO_LAT_INPUT] = true};
+    while (1)
+    {
+        int next = -1;
+        for (int i = 0; i < AUDIO_LAT_STAGES; i++)
+        {
+            if (!shown[i] && t[i] && (next < 0 || t[i] < t[next]))
+            {
+                next = i;
+            }
+        }
+        if (next < 0)
+        {
+            break;
+        }
+        shown[next] = true;
+        ESP_LOGI(TAG, "  %-8s %8.1f ms  +%.1f ms", s_names[next], (t[next] - t[AUDIO_LAT_INPUT]) / 1000.0f,
+                 (t[next] - prev) / 1000.0f);
+        prev = t[next];
+    }
+}
+
+void audio_lat_start(const char *what)
+{
+#if CONFIG_APP_AUDIO_LATENCY
+    if (s_report_timer == NULL)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = lat_report,
+            .name = "audio_lat",
+        };
+        if (esp_timer_create(&args, &s_report_timer) != ESP_OK)
+        {
+            return;
+        }
+        bsp_i2s_set_sent_cb(lat_on_sent);
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_armed && !s_reporting)
+    {
+        s_stats.timeouts++; // 上一趟还没出声又点了
+    }
+    memset(s_t, 0, sizeof(s_t));
+    s_t[AUDIO_LAT_INPUT] = now;
+    s_what = what;
+    s_reporting = false;
+    s_armed = true;
+    portEXIT_CRITICAL(&s_lock);
+#endif
+}
+
+void audio_lat_mark(audio_lat_stage_t stage)
+{
+    if (!s_armed || stage >= AUDIO_LAT_STAGES)
+    {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_armed && !s_t[stage])
+    {
+        s_t[stage] = now;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void audio_lat_i2s(const void *buf, size_t len)
+{
+    if (!s_armed)
+    {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    bool report = false;
+    portENTER_CRITICAL(&s_lock);
+    if (!s_reporting && (s_t[AUDIO_LAT_DMA] || now - s_t[AUDIO_LAT_INPUT] > AUDIO_LAT_TIMEOUT_MS * 1000LL))
+    {
+        s_reporting = true;
+        report = true;
+    }
+    bool want = !s_t[AUDIO_LAT_I2S];
+    portEXIT_CRITICAL(&s_lock);
+    if (report)
+    {
+        esp_timer_stop(s_report_timer);
+        esp_timer_start_once(s_report_timer, LAT_REPORT_DELAY_MS * 1000);
+    }
+    else if (want && lat_nonzero(buf, len))
+    {
+        audio_lat_mark(AUDIO_LAT_I2S);
+    }
+}
+
+void audio_lat_get_stats(audio_lat_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+
+/*********************** 点击到出声的延迟 ****************************/
+// 按键或列表点击时开始计时 路上每一站第一次经过时记下时刻 到含第一个非零采样的DMA描述符发完为止
+// DMA发完由I2S发送中断报过来 之后codec的DAC还有几个采样的群延迟 不计在内
+// 走完一趟在esp_timer任务里按时间先后打印每一站距起点和距上一站的时间 看停旧曲 开文件 重开codec 解除静音各占多少
+// CONFIG_APP_AUDIO_LATENCY关掉时audio_lat_start什么都不做 其他几个只比较一个标志
+
+#define AUDIO_LAT_TIMEOUT_MS    5000    // 超过这么久没出声 这一趟作废
+
+typedef enum {
+    AUDIO_LAT_INPUT,                    // 按键或列表点击 计时起点
+    AUDIO_LAT_STOPPED,                  // 上一首停下来了
+    AUDIO_LAT_OPEN,                     // 文件打开了 交给播放器
+    AUDIO_LAT_DECODE,                   // 播放器进入播放状态 开始解码
+    AUDIO_LAT_FORMAT,                   // 解出第一帧 开始按它的格式设采样率
+    AUDIO_LAT_CODEC,                    // 采样率设好 格式变了时包括重开codec
+    AUDIO_LAT_UNMUTE,                   // 播放器解除静音
+    AUDIO_LAT_PCM,                      // 第一次写PCM缓冲
+    AUDIO_LAT_I2S,                      // 第一块非零数据交给I2S
+    AUDIO_LAT_DMA,                      // 含第一个非零采样的DMA描述符发完
+    AUDIO_LAT_STAGES,
+} audio_lat_stage_t;
+
+typedef struct {
+    uint32_t runs;                      // 走完的趟数
+    uint32_t timeouts;                  // 没走完就作废的
+    uint32_t last_us[AUDIO_LAT_STAGES]; // 最近走完的一趟 各站距起点 0是没经过
+    uint32_t min_us;                    // 点击到出声
+    uint32_t max_us;
+    uint64_t sum_us;
+} audio_lat_stats_t;
+
+void audio_lat_start(const char *what);         // what是静态字符串 打印时用
+void audio_lat_mark(audio_lat_stage_t stage);   // 这一趟里只记第一次
+void audio_lat_i2s(const void *buf, size_t len);    // 写I2S之前调用 数据里有非零采样时记AUDIO_LAT_I2S
+void audio_lat_get_stats(audio_lat_stats_t *stats);
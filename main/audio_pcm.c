@@ -0,0 +1,1293 @@
+#include "audio_pcm.h"
+#include "task_plan.h"
+#include "audio_resample.h"
+#include "audio_tstretch.h"
+#include "audio_vis.h"
+#include "audio_eq.h"
+#include "audio_dither.h"
+#include "audio_lat.h"
+#include "sys_trace.h"
+#include "psram_bw.h"
+#include "telemetry.h"
+#include "esp32_s3_szp.h"
+#include "esp_heap_caps.h"
+#include "freertos/ringbuf.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "dsps_mulc.h"
+#include "dsps_add.h"
+#include <math.h>
+
+static const char *TAG = "audio_pcm";
+
+static RingbufHandle_t s_ring = NULL;
+static StaticRingbuffer_t s_ring_struct;     // 控制块放内部RAM
+static uint8_t *s_ring_storage = NULL;       // 数据区放PSRAM
+static size_t s_ring_size = 0;
+
+static volatile bool s_streaming = false;    // 解码器正在持续写入
+static volatile bool s_feeding = false;      // 送数任务正在写I2S
+static volatile uint32_t s_write_pos = 0;    // 写进缓冲的总字节数 回绕 只在写锁里改
+static volatile uint32_t s_read_pos = 0;     // 送数任务取出的总字节数
+static volatile uint32_t s_flush_pos = 0;    // flush时写到的位置 读到这之前的都丢掉
+static SemaphoreHandle_t s_write_mux;        // 写入和flush互斥 flush记下的位置就是缓冲里的全部数据
+static volatile size_t s_inflight = 0;       // 送数任务取出来还没写进DMA的字节数
+
+static audio_pcm_stats_t s_stats;
+
+// 重采样 只在解码任务中使用
+static uint32_t s_output_rate = AUDIO_PCM_OUTPUT_RATE;
+static bool s_clock_trim = false;           // 采样率相同也经过重采样 步长可以微调
+static audio_resample_t s_resample;
+static bool s_resample_active = false;
+static int16_t *s_resample_buf = NULL;
+static size_t s_resample_tail = 0;          // s_resample_buf里还没写进缓冲的帧 从s_resample_tail_at开始
+static size_t s_resample_tail_at = 0;
+#define RESAMPLE_OUT_FRAMES  1024
+
+// 变速 在重采样之前 只在解码任务中使用 原速时不经过也不占内存
+static volatile int s_speed = 100;          // 由UI设置
+static volatile bool s_stretch_reset = false;   // 换曲或跳转 下次写入时清空
+static audio_tstretch_t s_stretch;
+static bool s_stretch_on = false;
+static bool s_stretch_failed = false;       // 内存不够 换格式之前不再试
+static int16_t *s_stretch_buf = NULL;
+static size_t s_stretch_tail = 0;           // s_stretch_buf里还没交给重采样的帧 从s_stretch_tail_at开始
+static size_t s_stretch_tail_at = 0;
+static volatile bool s_tail_drop = false;   // flush过 上一首没写完的尾巴不要了
+static uint32_t s_decode_rate = 0;          // 解码输出的采样率
+#define STRETCH_OUT_FRAMES   1024
+
+// 软件音量 Q15增益 在解码任务中原地作用于PCM
+static volatile int32_t s_gain_target = 0;  // 目标增益 由UI设置
+static int32_t s_gain_now = 0;              // 当前增益 只在解码任务中修改
+static int32_t s_gain_volume = 32767;       // 音量对应的增益 音源也按它
+static int32_t s_gain_track = 4096;         // 这首曲目的响度增益 Q12 可以大于1
+static int32_t s_gain_music = 32767;        // 音乐的增益 音量乘响度增益 满了就是直通
+static volatile bool s_soft_mute = true;
+// 静音在送数任务里按写入位置做 缓冲里已有的照常播 到这个位置前渐弱或从这里渐强
+static volatile uint32_t s_mute_pos = 0;    // 最近一次静音或解除静音时写到的位置
+static volatile bool s_mute_after = true;   // s_mute_pos之后是不是静音
+static bool s_mute_before = true;           // s_mute_pos之前是不是静音 只在送数任务里改
+static portMUX_TYPE s_mute_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_bits = 16;               // 经过各级处理和codec上的位宽
+static bool s_dither_on = false;            // 解码出来是32位 进来时先抖动降到16位
+static audio_dither_t s_dither;
+static int s_channels = 2;
+static uint32_t s_codec_rate = 0;           // 重采样以后codec上的采样率
+static audio_pcm_tap_fn_t s_tap = NULL;
+static int s_volume = 100;
+
+// 混音音源 除了入队和设增益都只在送数任务里用
+#define MIX_SRC_BUF_FRAMES  256
+typedef struct {
+    const int16_t *pcm;
+    size_t frames;
+    uint32_t rate;
+    audio_pcm_prompt_done_t done;
+    void *arg;
+    int64_t t_queued;
+} pcm_clip_t;
+
+typedef struct {
+    QueueHandle_t q;
+    pcm_clip_t clip;
+    bool on;                                // clip正在放
+    size_t pos;                             // clip已经用掉的帧
+    audio_resample_t rs;
+    bool rs_on;
+    int16_t buf[MIX_SRC_BUF_FRAMES];        // 转到codec采样率的一块
+    size_t buf_len;
+    size_t buf_pos;
+    volatile int32_t gain;                  // Q15 乘在总音量上
+} mix_src_t;
+
+// 这个音源响着时音乐压到多少 Q15
+static const int32_t s_src_duck[AUDIO_PCM_SRC_COUNT] = {
+    [AUDIO_PCM_SRC_VOICE] = AUDIO_PCM_PROMPT_DUCK,
+    [AUDIO_PCM_SRC_UI] = AUDIO_PCM_UI_DUCK,
+    [AUDIO_PCM_SRC_CALL] = AUDIO_PCM_CALL_DUCK,
+};
+
+static mix_src_t s_src[AUDIO_PCM_SRC_COUNT] = { [0 ... AUDIO_PCM_SRC_COUNT - 1] = { .gain = 32767 } };
+static int32_t s_duck_now = 32767;          // 音乐现在的压低增益 按块渐变
+// 一个周期的输出 音乐先拷进来再混 对齐16字节 PIE一次取128位
+static int32_t s_period[AUDIO_PCM_MIX_PERIOD_FRAMES * 2] __attribute__((aligned(16)));
+static int16_t s_mix_tmp[AUDIO_PCM_MIX_PERIOD_FRAMES * 2] __attribute__((aligned(16)));   // 一个音源铺成codec的声道数
+static bool s_prompt_unmuted = false;       // 没放歌时为音源打开过硬件静音
+static int64_t s_prompt_tail_us = 0;        // 垫的最后一块从喇叭出完的时刻
+
+static size_t ring_fill(void)
+{
+    UBaseType_t waiting = 0;
+    vRingbufferGetInfo(s_ring, NULL, NULL, NULL, NULL, &waiting);
+    return waiting;
+}
+
+static TickType_t ms_to_ticks(uint32_t timeout_ms)
+{
+    return (timeout_ms == portMAX_DELAY) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
+
+// 写I2S 写进去的部分交给取样回调
+static esp_err_t pcm_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    size_t written = 0;
+    audio_lat_i2s(audio_buffer, len); // 写之前记 大块写入返回前前面的DMA描述符可能已经发完
+    esp_err_t ret = bsp_i2s_write(audio_buffer, len, &written, timeout_ms);
+    audio_pcm_tap_fn_t tap = s_tap;
+    if (tap && written)
+    {
+        tap(audio_buffer, written, s_codec_rate, s_channels, s_bits);
+    }
+    if (bytes_written)
+    {
+        *bytes_written = written;
+    }
+    return ret;
+}
+
+static bool src_pending(const mix_src_t *s)
+{
+    return s->on || uxQueueMessagesWaiting(s->q) > 0;
+}
+
+static bool mix_pending(void)
+{
+    for (int i = 0; i < AUDIO_PCM_SRC_COUNT; i++)
+    {
+        if (src_pending(&s_src[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void src_end(mix_src_t *s, bool played)
+{
+    if (s->clip.done)
+    {
+        s->clip.done(s->clip.arg);
+    }
+    if (played)
+    {
+        s_stats.prompts++;
+    }
+    else
+    {
+        s_stats.prompt_dropped++;
+    }
+    s->on = false;
+}
+
+// 取下一段 采样率和codec不一样时准备好重采样器
+static bool src_next(mix_src_t *s, uint32_t rate)
+{
+    while (xQueueReceive(s->q, &s->clip, 0) == pdTRUE)
+    {
+        s->on = true;
+        s->pos = 0;
+        if (s->clip.rate != rate)
+        {
+            if (s->rs_on && s->rs.in_rate == s->clip.rate && s->rs.out_rate == rate)
+            {
+                audio_resample_reset(&s->rs);
+            }
+            else
+            {
+                if (s->rs_on)
+                {
+                    audio_resample_deinit(&s->rs);
+                }
+                s->rs_on = audio_resample_init(&s->rs, s->clip.rate, rate, 1) == ESP_OK;
+            }
+            if (!s->rs_on)
+            {
+                src_end(s, false);
+                continue;
+            }
+        }
+        uint32_t wait = esp_timer_get_time() - s->clip.t_queued;
+        if (wait > s_stats.prompt_wait_max_us)
+        {
+            s_stats.prompt_wait_max_us = wait;
+        }
+        return true;
+    }
+    return false;
+}
+
+// 取下一块转好采样率的 都放完了返回false
+static bool src_fill(mix_src_t *s, uint32_t rate)
+{
+    for (;;)
+    {
+        if (!s->on && !src_next(s, rate))
+        {
+            return false;
+        }
+        size_t left = s->clip.frames - s->pos;
+        size_t out;
+        if (s->clip.rate == rate)
+        {
+            out = left < MIX_SRC_BUF_FRAMES ? left : MIX_SRC_BUF_FRAMES;
+            memcpy(s->buf, s->clip.pcm + s->pos, out * sizeof(int16_t));
+            s->pos += out;
+        }
+        else
+        {
+            size_t used = 0;
+            out = audio_resample_process(&s->rs, s->clip.pcm + s->pos, left, s->buf, MIX_SRC_BUF_FRAMES, &used);
+            s->pos += used;
+        }
+        if (out)
+        {
+            s->buf_len = out;
+            s->buf_pos = 0;
+            return true;
+        }
+        src_end(s, true);
+    }
+}
+
+// 饱和相加 acc和in都对齐16字节时整8个样本的部分用PIE的ee.vadds.s16 剩下的逐个加
+// dsps_add_s16没对齐时走的版本不饱和 所以自己判断
+static void mix_sat_s16(int16_t *acc, const int16_t *in, size_t n)
+{
+    size_t i = 0;
+#if dsps_add_s16_aes3_enabled
+    if ((((uintptr_t)acc | (uintptr_t)in) & 15) == 0 && n >= 8)
+    {
+        i = n & ~(size_t)7;
+        dsps_add_s16(acc, in, acc, i, 1, 1, 1, 0);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        int32_t m = acc[i] + in[i];
+        acc[i] = m > 32767 ? 32767 : m < -32768 ? -32768 : m;
+    }
+}
+
+// 音乐压低 目标变了每AUDIO_PCM_FADE_BLOCK帧走AUDIO_PCM_DUCK_STEP 块内增益不变
+static void duck_apply(void *buf, size_t frames, int ch, uint32_t bits, int32_t target)
+{
+    for (size_t i = 0; i < frames; i += AUDIO_PCM_FADE_BLOCK)
+    {
+        size_t n = frames - i < AUDIO_PCM_FADE_BLOCK ? frames - i : AUDIO_PCM_FADE_BLOCK;
+        if (s_duck_now < target)
+        {
+            s_duck_now = s_duck_now + AUDIO_PCM_DUCK_STEP < target ? s_duck_now + AUDIO_PCM_DUCK_STEP : target;
+        }
+        else if (s_duck_now > target)
+        {
+            s_duck_now = s_duck_now - AUDIO_PCM_DUCK_STEP > target ? s_duck_now - AUDIO_PCM_DUCK_STEP : target;
+        }
+        if (s_duck_now == 32767)
+        {
+            continue;
+        }
+        if (bits == 16)
+        {
+            int16_t *p = (int16_t *)buf + i * ch;
+            dsps_mulc_s16(p, p, n * ch, (int16_t)s_duck_now, 1, 1);
+        }
+        else
+        {
+            int32_t *p = (int32_t *)buf + i * ch;
+            for (size_t k = 0; k < n * ch; k++)
+            {
+                p[k] = (int32_t)(((int64_t)p[k] * s_duck_now) >> 15);
+            }
+        }
+    }
+}
+
+// 一个音源按总音量乘自己的增益加到buf上 返回混了多少帧
+static size_t src_mix(mix_src_t *s, void *buf, size_t frames, int ch, uint32_t bits, uint32_t rate)
+{
+    size_t done = 0;
+    int32_t g = (s_gain_volume * s->gain) >> 15;
+    while (done < frames)
+    {
+        if (s->buf_pos == s->buf_len && !src_fill(s, rate))
+        {
+            break;
+        }
+        size_t n = frames - done < s->buf_len - s->buf_pos ? frames - done : s->buf_len - s->buf_pos;
+        const int16_t *p = s->buf + s->buf_pos;
+        if (bits == 16)
+        {
+            // 先铺到s_mix_tmp里和buf同样的位置 整个周期一起饱和相加
+            int16_t *t = s_mix_tmp + done * ch;
+            for (size_t i = 0; i < n; i++)
+            {
+                int16_t v = (p[i] * g) >> 15;
+                for (int c = 0; c < ch; c++)
+                {
+                    t[i * ch + c] = v;
+                }
+            }
+        }
+        else
+        {
+            int32_t *o = (int32_t *)buf + done * ch;
+            for (size_t i = 0; i < n; i++)
+            {
+                int64_t v = (int64_t)(p[i] * g) << 1;
+                for (int c = 0; c < ch; c++)
+                {
+                    int64_t m = (int64_t)o[i * ch + c] + v;
+                    o[i * ch + c] = m > INT32_MAX ? INT32_MAX : m < INT32_MIN ? INT32_MIN : m;
+                }
+            }
+        }
+        s->buf_pos += n;
+        done += n;
+    }
+    if (bits == 16 && done)
+    {
+        mix_sat_s16(buf, s_mix_tmp, done * ch);
+    }
+    s_stats.prompt_frames += done;
+    return done;
+}
+
+// 一个周期: 有音源响着就把音乐按最低的那个压低增益渐变过去 再把各音源加上去
+// buf是s_period 音乐已经在里面 没放歌时是静音
+static void mix_period(void *buf, size_t frames, int ch, uint32_t bits, uint32_t rate)
+{
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    int32_t duck = 32767;
+    bool any = false;
+    for (int i = 0; i < AUDIO_PCM_SRC_COUNT; i++)
+    {
+        if (src_pending(&s_src[i]))
+        {
+            any = true;
+            duck = s_src_duck[i] < duck ? s_src_duck[i] : duck;
+        }
+    }
+    if (!any && s_duck_now == 32767)
+    {
+        return;
+    }
+    duck_apply(buf, frames, ch, bits, duck);
+    for (int i = 0; i < AUDIO_PCM_SRC_COUNT; i++)
+    {
+        if (src_pending(&s_src[i]))
+        {
+            src_mix(&s_src[i], buf, frames, ch, bits, rate);
+        }
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    s_stats.mix_periods++;
+    s_stats.mix_cycles += cycles;
+    if (cycles > s_stats.mix_cycles_max)
+    {
+        s_stats.mix_cycles_max = cycles;
+    }
+}
+
+// 没放歌 codec还是上次的格式 没设置过就是开机的默认格式 硬件静音着的话先打开
+static void mix_idle(void)
+{
+    uint32_t rate = s_codec_rate ? s_codec_rate : CODEC_DEFAULT_SAMPLE_RATE;
+    int ch = s_codec_rate ? s_channels : CODEC_DEFAULT_CHANNEL;
+    uint32_t bits = s_codec_rate ? s_bits : CODEC_DEFAULT_BIT_WIDTH;
+    size_t frame_bytes = ch * (bits == 16 ? sizeof(int16_t) : sizeof(int32_t));
+    if (!s_prompt_unmuted && s_soft_mute)
+    {
+        bsp_codec_mute_set(false);
+        s_prompt_unmuted = true;
+    }
+    memset(s_period, 0, AUDIO_PCM_MIX_PERIOD_FRAMES * frame_bytes);
+    mix_period(s_period, AUDIO_PCM_MIX_PERIOD_FRAMES, ch, bits, rate);
+    size_t len = AUDIO_PCM_MIX_PERIOD_FRAMES * frame_bytes;
+    for (size_t done = 0; done < len;)
+    {
+        size_t written = 0;
+        esp_err_t ret = pcm_i2s_write((uint8_t *)s_period + done, len - done, &written, AUDIO_PCM_WRITE_TIMEOUT_MS);
+        done += written;
+        if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT)
+        {
+            break;
+        }
+    }
+    s_prompt_tail_us = esp_timer_get_time() + (int64_t)BSP_I2S_DMA_DESC_NUM * BSP_I2S_DMA_FRAME_NUM * 1000000 / rate;
+}
+
+// flush之前写进来的还没丢完
+static bool flush_pending(void)
+{
+    return (int32_t)(s_flush_pos - s_read_pos) > 0;
+}
+
+// 从环形缓冲取一个周期拷进s_period 缓冲绕回时分两次取 flush要丢的取出来直接还回去
+// 只有第一次取会等 返回拷进来的字节数
+static size_t period_gather(TickType_t wait)
+{
+    size_t frame_bytes = s_channels * (s_bits == 16 ? sizeof(int16_t) : sizeof(int32_t));
+    size_t want = AUDIO_PCM_MIX_PERIOD_FRAMES * frame_bytes;
+    size_t got = 0;
+    while (got < want)
+    {
+        size_t len = 0;
+        void *data = xRingbufferReceiveUpTo(s_ring, &len, wait, want - got);
+        if (data == NULL)
+        {
+            break;
+        }
+        wait = 0;
+        s_feeding = true;
+        // 只丢弃flush时已在缓冲里的数据 之后写入的新数据照常播放
+        size_t drop = 0;
+        if (flush_pending())
+        {
+            uint32_t stale = s_flush_pos - s_read_pos;
+            drop = (len < stale) ? len : stale;
+        }
+        memcpy((uint8_t *)s_period + got, (uint8_t *)data + drop, len - drop);
+        got += len - drop;
+        s_read_pos += len;
+        vRingbufferReturnItem(s_ring, data);
+    }
+    return got;
+}
+
+// 音乐的静音 pos是这一块第一个字节的写入位置 s_mute_pos之前AUDIO_PCM_GAIN_RAMP_FRAMES帧渐弱 之后这么多帧渐强
+// 音源在这之后才混进来 不受影响
+static void mute_apply(void *buf, size_t frames, int ch, uint32_t bits, uint32_t pos)
+{
+    portENTER_CRITICAL(&s_mute_lock);
+    uint32_t mute_pos = s_mute_pos;
+    bool after = s_mute_after;
+    portEXIT_CRITICAL(&s_mute_lock);
+    size_t frame_bytes = ch * (bits == 16 ? sizeof(int16_t) : sizeof(int32_t));
+    if (s_mute_before == after)
+    {
+        if (after)
+        {
+            memset(buf, 0, frames * frame_bytes);
+        }
+        return;
+    }
+
+    const int32_t ramp = AUDIO_PCM_GAIN_RAMP_FRAMES;
+    int32_t d = (int32_t)(mute_pos - pos) / (int32_t)frame_bytes;  // 离渐变点的帧数 正的是还没到
+    for (size_t i = 0; i < frames; i++, d--)
+    {
+        int32_t g;
+        if (d > 0)
+        {
+            g = s_mute_before ? 0 : (after && d <= ramp) ? 32767 * (d - 1) / ramp : 32767;
+        }
+        else
+        {
+            g = after ? 0 : (-d < ramp) ? 32767 * (1 - d) / ramp : 32767;
+        }
+        if (g == 32767)
+        {
+            continue;
+        }
+        if (bits == 16)
+        {
+            int16_t *p = (int16_t *)buf + i * ch;
+            for (int c = 0; c < ch; c++)
+            {
+                p[c] = (int16_t)((p[c] * g) >> 15);
+            }
+        }
+        else
+        {
+            int32_t *p = (int32_t *)buf + i * ch;
+            for (int c = 0; c < ch; c++)
+            {
+                p[c] = (int32_t)(((int64_t)p[c] * g) >> 15);
+            }
+        }
+    }
+    if (d <= -ramp)
+    {
+        s_mute_before = after;
+    }
+}
+
+// 送数任务 每次从环形缓冲取一个周期 混上其他音源写到I2S 写满DMA前阻塞 节拍由I2S定
+static void audio_pcm_feed_task(void *arg)
+{
+    while (1)
+    {
+        bool mixing = mix_pending();
+        // 待机时I2S关着 等久一点 不然每秒叫醒CPU五十次 歌的数据来了照样马上醒
+        size_t len = period_gather(mixing ? 0 : pdMS_TO_TICKS(bsp_audio_in_standby() ? AUDIO_PCM_STANDBY_POLL_MS : 20));
+        if (len == 0 && mixing)
+        {
+            s_feeding = false;
+            mix_idle(); // 写满DMA前会阻塞 不会空转
+            continue;
+        }
+        if (len == 0)
+        {
+            s_feeding = false;
+            if (s_prompt_unmuted && esp_timer_get_time() >= s_prompt_tail_us)
+            {
+                // 音源从喇叭出完了 播放器还停着就恢复静音
+                if (s_soft_mute)
+                {
+                    bsp_codec_mute_set(true);
+                }
+                s_prompt_unmuted = false;
+            }
+            s_duck_now = 32767;
+            if (s_streaming)
+            {
+                // 解码器还在播放但缓冲被取空 记一次欠载
+                s_stats.underruns++;
+                s_streaming = false;
+                psram_bw_rt(PSRAM_BW_RT_AUDIO, true);
+                ESP_LOGW(TAG, "underrun #%lu", (unsigned long)s_stats.underruns);
+            }
+            continue;
+        }
+
+        if (s_streaming)
+        {
+            // 缓冲不到四分之一 解码器供不上了 PSRAM那边要让一让
+            psram_bw_rt(PSRAM_BW_RT_AUDIO, ring_fill() < s_ring_size / 4);
+        }
+        size_t frame_bytes = s_channels * (s_bits == 16 ? sizeof(int16_t) : sizeof(int32_t));
+        mute_apply(s_period, len / frame_bytes, s_channels, s_bits, s_read_pos - len);
+        if (mixing && len < AUDIO_PCM_MIX_PERIOD_FRAMES * frame_bytes)
+        {
+            // 音乐不够一个周期 音源不能跟着断 后面垫静音
+            memset((uint8_t *)s_period + len, 0, AUDIO_PCM_MIX_PERIOD_FRAMES * frame_bytes - len);
+            len = AUDIO_PCM_MIX_PERIOD_FRAMES * frame_bytes;
+        }
+        mix_period(s_period, len / frame_bytes, s_channels, s_bits, s_codec_rate);
+        // 有超时的写入 被打断时把剩余部分写完 解码器的flush请求可以在两次写之间生效
+        size_t done = 0;
+        s_inflight = len;
+        while (done < len && !flush_pending())
+        {
+            size_t written = 0;
+            esp_err_t ret = pcm_i2s_write((uint8_t *)s_period + done, len - done, &written, AUDIO_PCM_WRITE_TIMEOUT_MS);
+            done += written;
+            s_inflight = len - done;
+            if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT)
+            {
+                break; // codec未打开等错误 丢弃这一块
+            }
+        }
+        s_inflight = 0;
+        s_feeding = false;
+    }
+}
+
+// 创建环形缓冲与送数任务
+// 遥测在esp_timer任务里读
+static uint32_t tlm_fill(void *arg)
+{
+    return s_ring_size ? (uint64_t)ring_fill() * 100 / s_ring_size : 0;
+}
+
+static uint32_t tlm_underruns(void *arg)
+{
+    return s_stats.underruns;
+}
+
+esp_err_t audio_pcm_init(uint32_t ring_ms)
+{
+    if (s_ring)
+    {
+        return ESP_OK;
+    }
+    if (ring_ms == 0)
+    {
+        ring_ms = AUDIO_PCM_RING_MS_DEFAULT;
+    }
+
+    // 按48kHz 32bit 双声道计算 并向下对齐到4字节
+    s_ring_size = ((size_t)AUDIO_PCM_RING_MAX_RATE * 2 * 4 * ring_ms / 1000) & ~3U;
+    s_ring_storage = heap_caps_malloc(s_ring_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(s_ring_storage, ESP_ERR_NO_MEM, TAG, "no mem for pcm ring");
+
+    s_write_mux = xSemaphoreCreateMutex();
+    s_ring = s_write_mux ? xRingbufferCreateStatic(s_ring_size, RINGBUF_TYPE_BYTEBUF, s_ring_storage, &s_ring_struct) : NULL;
+    if (s_ring == NULL)
+    {
+        heap_caps_free(s_ring_storage);
+        s_ring_storage = NULL;
+        if (s_write_mux)
+        {
+            vSemaphoreDelete(s_write_mux);
+            s_write_mux = NULL;
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.ring_size = s_ring_size;
+    s_stats.period_frames = AUDIO_PCM_MIX_PERIOD_FRAMES;
+    audio_dither_init(&s_dither);
+    for (int i = 0; i < AUDIO_PCM_SRC_COUNT; i++)
+    {
+        s_src[i].q = xQueueCreate(AUDIO_PCM_PROMPT_QUEUE, sizeof(pcm_clip_t));
+        ESP_RETURN_ON_FALSE(s_src[i].q, ESP_ERR_NO_MEM, TAG, "no mem for mix queue");
+    }
+
+    BaseType_t ok = task_plan_create(TASK_AUDIO_PCM_FEED, audio_pcm_feed_task, NULL, NULL);
+    ESP_RETURN_ON_FALSE(ok == pdPASS, ESP_ERR_NO_MEM, TAG, "create feed task failed");
+
+    telemetry_add("pcm_fill_pct", TELEMETRY_GAUGE, tlm_fill, NULL);
+    telemetry_add("pcm_underruns", TELEMETRY_COUNTER, tlm_underruns, NULL);
+    ESP_LOGI(TAG, "pcm ring %u bytes (%lu ms)", s_ring_size, (unsigned long)ring_ms);
+    return ESP_OK;
+}
+
+// 写入环形缓冲 分块写入 超时后返回实际写入的字节数
+static esp_err_t ring_write(const void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    const uint8_t *p = audio_buffer;
+    size_t chunk_max = s_ring_size / 4;
+    size_t done = 0;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = ms_to_ticks(timeout_ms);
+
+    s_streaming = true;
+    s_stats.writes++;
+    while (done < len)
+    {
+        size_t n = len - done;
+        if (n > chunk_max)
+        {
+            n = chunk_max;
+        }
+        TickType_t wait = portMAX_DELAY;
+        if (timeout != portMAX_DELAY)
+        {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            wait = (elapsed < timeout) ? (timeout - elapsed) : 0;
+        }
+        // 拿着写锁只试不等 缓冲满了放开锁再等 flush不会被卡住
+        xSemaphoreTake(s_write_mux, portMAX_DELAY);
+        bool sent = xRingbufferSend(s_ring, p + done, n, 0) == pdTRUE;
+        if (sent)
+        {
+            s_write_pos += n;
+        }
+        xSemaphoreGive(s_write_mux);
+        if (sent)
+        {
+            done += n;
+            continue;
+        }
+        if (wait == 0)
+        {
+            s_stats.timeouts++;
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    size_t fill = ring_fill();
+    if (fill > s_stats.high_water)
+    {
+        s_stats.high_water = fill;
+    }
+
+    if (bytes_written)
+    {
+        *bytes_written = done;
+    }
+    return (done == len) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+// 音量0~100映射为Q15增益 曲线与codec硬件音量一致
+static int32_t volume_to_gain(int volume)
+{
+    if (volume <= 0)
+    {
+        return 0;
+    }
+    if (volume >= 100)
+    {
+        return 32767;
+    }
+    float db = (volume - 100) * AUDIO_PCM_VOL_DB_RANGE / 100.0f;
+    return (int32_t)(32767.0f * powf(10.0f, db / 20.0f));
+}
+
+// 响度增益并进音量的系数里 增益级还是一次常数乘法 放大时最多到满幅
+static void gain_update(void)
+{
+    int32_t g = (s_gain_volume * s_gain_track) >> 12;
+    s_gain_music = g > 32767 ? 32767 : g;
+    s_gain_target = s_gain_music;
+}
+
+void audio_pcm_set_volume(int volume)
+{
+    s_volume = volume;
+    s_gain_volume = volume_to_gain(volume);
+    gain_update();
+}
+
+void audio_pcm_set_track_gain(int gain_cdb)
+{
+    s_gain_track = (int32_t)(4096.0f * powf(10.0f, gain_cdb / 2000.0f));
+    gain_update();
+}
+
+// 拿着写锁记位置 这之前写进来的照常播 送数任务在这个位置上渐变
+void audio_pcm_set_mute(bool mute)
+{
+    if (s_write_mux)
+    {
+        xSemaphoreTake(s_write_mux, portMAX_DELAY);
+    }
+    portENTER_CRITICAL(&s_mute_lock);
+    s_soft_mute = mute;
+    s_mute_pos = s_write_pos;
+    s_mute_after = mute;
+    portEXIT_CRITICAL(&s_mute_lock);
+    if (s_write_mux)
+    {
+        xSemaphoreGive(s_write_mux);
+    }
+}
+
+// 增益级 先做短渐变 剩下的部分用esp-dsp的常数乘法
+static void apply_gain(void *buf, size_t len, uint32_t bits)
+{
+    int32_t target = s_gain_target;
+    if (s_gain_now == 32767 && target == 32767)
+    {
+        return; // 满增益直通
+    }
+
+    const int ch = s_channels;
+    if (bits == 16)
+    {
+        int16_t *p = buf;
+        size_t frames = len / (ch * sizeof(int16_t));
+        size_t i = 0;
+        if (s_gain_now != target)
+        {
+            size_t ramp = frames < AUDIO_PCM_GAIN_RAMP_FRAMES ? frames : AUDIO_PCM_GAIN_RAMP_FRAMES;
+            int32_t start = s_gain_now;
+            for (; i < ramp; i++)
+            {
+                int32_t g = start + (target - start) * (int32_t)(i + 1) / (int32_t)ramp;
+                for (int c = 0; c < ch; c++)
+                {
+                    p[ch * i + c] = (int16_t)((p[ch * i + c] * g) >> 15);
+                }
+            }
+            s_gain_now = target;
+        }
+        if (i < frames)
+        {
+            dsps_mulc_s16(p + ch * i, p + ch * i, (frames - i) * ch, (int16_t)target, 1, 1);
+        }
+    }
+    else
+    {
+        // 24/32位数据按32位容器处理
+        int32_t *p = buf;
+        size_t samples = len / sizeof(int32_t);
+        for (size_t i = 0; i < samples; i++)
+        {
+            int32_t g = target;
+            if (s_gain_now != target && i < AUDIO_PCM_GAIN_RAMP_FRAMES * ch)
+            {
+                g = s_gain_now + (target - s_gain_now) * (int32_t)(i / ch + 1) / AUDIO_PCM_GAIN_RAMP_FRAMES;
+            }
+            p[i] = (int32_t)(((int64_t)p[i] * g) >> 15);
+        }
+        s_gain_now = target;
+    }
+}
+
+// 均衡器 频谱取样 音量 都在调用者的缓冲上原地处理 返回处理完的字节数
+// 要抖动时音量先在32位上乘 小音量不多丢分辨率 再降到16位交给均衡器和频谱
+static size_t pcm_process(void *audio_buffer, size_t len)
+{
+    if (s_dither_on)
+    {
+        apply_gain(audio_buffer, len, 32);
+        len = audio_dither_s32_to_s16(&s_dither, audio_buffer, audio_buffer, len / sizeof(int32_t));
+    }
+    if (s_bits == 16)
+    {
+        size_t frames = len / (sizeof(int16_t) * s_channels);
+        audio_eq_process(audio_buffer, frames);    // 均衡器原地处理解码输出
+        audio_vis_tap(audio_buffer, frames);       // 频谱显示取音量调节前的数据
+    }
+    if (!s_dither_on)
+    {
+        apply_gain(audio_buffer, len, s_bits);
+    }
+    return len;
+}
+
+// 在解码任务里按UI设的速度开关变速级 回原速时缓冲里不到一个搜索窗的尾巴丢掉
+static bool stretch_prepare(void)
+{
+    int speed = s_speed;
+    if (speed == 100 || s_bits != 16 || s_stretch_failed)
+    {
+        s_stretch_on = false;
+        return false;
+    }
+    if (s_stretch.buf == NULL || s_stretch.rate != s_decode_rate || s_stretch.channels != s_channels)
+    {
+        audio_tstretch_deinit(&s_stretch);
+        if (s_stretch_buf == NULL)
+        {
+            s_stretch_buf = heap_caps_malloc(STRETCH_OUT_FRAMES * TSTRETCH_MAX_CH * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+        }
+        if (s_stretch_buf == NULL || audio_tstretch_init(&s_stretch, s_decode_rate, s_channels) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "time stretch unavailable at %lu Hz", (unsigned long)s_decode_rate);
+            s_stretch_failed = true;
+            return false;
+        }
+        s_stretch_on = false;
+    }
+    if (s_stretch.speed != speed)
+    {
+        audio_tstretch_set_speed(&s_stretch, speed);
+    }
+    if (!s_stretch_on || s_stretch_reset)
+    {
+        audio_tstretch_reset(&s_stretch);
+        s_stretch_reset = false;
+        s_stretch_on = true;
+    }
+    return true;
+}
+
+// 重采样输出里还没写进缓冲的先写 写不完的留到下次
+static esp_err_t resample_flush(uint32_t timeout_ms)
+{
+    if (s_resample_tail == 0)
+    {
+        return ESP_OK;
+    }
+    const int ch = s_channels;
+    size_t written = 0;
+    esp_err_t ret = ring_write(s_resample_buf + s_resample_tail_at * ch, s_resample_tail * ch * sizeof(int16_t),
+                               &written, timeout_ms);
+    written /= ch * sizeof(int16_t);
+    s_resample_tail_at += written;
+    s_resample_tail -= written;
+    return ret;
+}
+
+// 有重采样时转换到固定输出采样率 否则直接写环形缓冲 in_used按输入帧汇报
+// 重采样器吃进去的输入退不回来 输出写不完就留着尾巴 下次先写尾巴 写完了才吃新的
+static esp_err_t resample_write(const int16_t *in, size_t in_frames, size_t *in_used, uint32_t timeout_ms)
+{
+    const int ch = s_channels;
+    size_t used_total = 0;
+    esp_err_t ret = ESP_OK;
+
+    if (!s_resample_active)
+    {
+        size_t written = 0;
+        ret = ring_write(in, in_frames * ch * sizeof(int16_t), &written, timeout_ms);
+        used_total = written / (ch * sizeof(int16_t));
+    }
+    else
+    {
+        ret = resample_flush(timeout_ms);
+    }
+    while (ret == ESP_OK && s_resample_active && used_total < in_frames)
+    {
+        size_t used = 0;
+        size_t out = audio_resample_process(&s_resample, in + used_total * ch, in_frames - used_total,
+                                            s_resample_buf, RESAMPLE_OUT_FRAMES, &used);
+        used_total += used;
+        if (out)
+        {
+            s_resample_tail_at = 0;
+            s_resample_tail = out;
+            ret = resample_flush(timeout_ms);
+        }
+        else if (used == 0)
+        {
+            break;
+        }
+    }
+    if (in_used)
+    {
+        *in_used = used_total;
+    }
+    return ret;
+}
+
+// 变速和重采样上次没写完的尾巴 先写变速的 它经过重采样时会先把重采样的尾巴写掉
+static esp_err_t tail_flush(uint32_t timeout_ms)
+{
+    if (s_tail_drop)
+    {
+        s_tail_drop = false;
+        s_stretch_tail = 0;
+        s_resample_tail = 0;
+        return ESP_OK;
+    }
+    if (s_stretch_tail == 0)
+    {
+        return resample_flush(timeout_ms);
+    }
+    size_t used = 0;
+    esp_err_t ret = resample_write(s_stretch_buf + s_stretch_tail_at * s_channels, s_stretch_tail, &used, timeout_ms);
+    s_stretch_tail_at += used;
+    s_stretch_tail -= used;
+    return (ret == ESP_OK && s_stretch_tail) ? ESP_ERR_TIMEOUT : ret;
+}
+
+// 处理好的数据 变速以后再重采样到固定输出采样率
+static esp_err_t pcm_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    if (s_ring == NULL)
+    {
+        return pcm_i2s_write(audio_buffer, len, bytes_written, timeout_ms);
+    }
+    bool stretch = stretch_prepare();
+    // 尾巴对应的输入已经汇报写完了 不先写掉就会少一段
+    esp_err_t ret = tail_flush(timeout_ms);
+    if (ret == ESP_OK && !stretch && !s_resample_active)
+    {
+        return ring_write(audio_buffer, len, bytes_written, timeout_ms);
+    }
+
+    const int ch = s_channels;
+    const int16_t *in = audio_buffer;
+    size_t in_frames = len / (sizeof(int16_t) * ch);
+    size_t used_total = 0;
+
+    if (ret == ESP_OK && !stretch)
+    {
+        ret = resample_write(in, in_frames, &used_total, timeout_ms);
+    }
+    while (ret == ESP_OK && stretch && used_total < in_frames)
+    {
+        size_t used = 0;
+        size_t out = audio_tstretch_process(&s_stretch, in + used_total * ch, in_frames - used_total,
+                                            s_stretch_buf, STRETCH_OUT_FRAMES, &used);
+        used_total += used;
+        if (out)
+        {
+            s_stretch_tail_at = 0;
+            s_stretch_tail = out;
+            ret = tail_flush(timeout_ms);
+        }
+        else if (used == 0)
+        {
+            break;
+        }
+    }
+
+    if (bytes_written)
+    {
+        // 按输入字节数汇报 播放器据此做流控
+        *bytes_written = used_total * ch * sizeof(int16_t);
+    }
+    return ret;
+}
+
+// 写入PCM数据
+esp_err_t audio_pcm_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    SYS_TRACE_END("decode");    // 播放器每解出一帧调一次 跟踪里两次之间算解码
+    audio_lat_mark(AUDIO_LAT_PCM);
+    esp_err_t ret = pcm_write(audio_buffer, pcm_process(audio_buffer, len), bytes_written, timeout_ms);
+    if (bytes_written && s_dither_on)
+    {
+        *bytes_written *= 2; // 播放器按它写进来的32位字节数流控
+    }
+    SYS_TRACE_BEGIN("decode");
+    return ret;
+}
+
+// WAV直通 播放器从SD卡读出的大块PCM直接写I2S 不再复制进环形缓冲
+// 先等环形缓冲里之前的数据播完保证顺序 需要重采样时仍走环形缓冲
+esp_err_t audio_pcm_write_direct(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    if (s_resample_active || (s_speed != 100 && s_bits == 16))
+    {
+        return audio_pcm_write(audio_buffer, len, bytes_written, timeout_ms);
+    }
+    audio_lat_mark(AUDIO_LAT_PCM);
+    if (s_ring && (ring_fill() > 0 || s_feeding))
+    {
+        audio_pcm_drain(1000);
+    }
+
+    len = pcm_process(audio_buffer, len);
+    esp_err_t ret = pcm_i2s_write(audio_buffer, len, bytes_written, timeout_ms);
+    if (bytes_written && s_dither_on)
+    {
+        *bytes_written *= 2;
+    }
+    s_stats.direct_writes++;
+    s_stats.direct_bytes += bytes_written ? *bytes_written : 0;
+    return ret;
+}
+
+// 等待缓冲中的数据全部送到I2S
+esp_err_t audio_pcm_drain(uint32_t timeout_ms)
+{
+    if (s_ring == NULL)
+    {
+        return ESP_OK;
+    }
+    s_streaming = false; // 播放结束时取空缓冲不算欠载
+
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = ms_to_ticks(timeout_ms);
+    while (ring_fill() > 0 || s_feeding)
+    {
+        if (timeout != portMAX_DELAY && (xTaskGetTickCount() - start) >= timeout)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(5));
+    }
+    return ESP_OK;
+}
+
+// 丢弃缓冲中尚未播放的数据 由送数任务完成丢弃
+void audio_pcm_flush(void)
+{
+    if (s_ring == NULL)
+    {
+        return;
+    }
+    // 拿着写锁记位置 正在写的一块要么全算进去要么全不算
+    xSemaphoreTake(s_write_mux, portMAX_DELAY);
+    s_streaming = false;
+    s_flush_pos = s_write_pos;
+    xSemaphoreGive(s_write_mux);
+    s_stretch_reset = true;
+    s_tail_drop = true;
+}
+
+// 播放器暂停时不再写入 缓冲里剩的照常播完 取空了不记欠载
+void audio_pcm_pause(void)
+{
+    s_streaming = false;
+}
+
+void audio_pcm_set_output_rate(uint32_t rate)
+{
+    s_output_rate = rate;
+}
+
+void audio_pcm_set_clock_trim(bool on)
+{
+    s_clock_trim = on;
+}
+
+// 重采样器只在解码任务里用 所以也要在写数据的任务里调用
+void audio_pcm_set_rate_trim(int ppm)
+{
+    if (s_resample_active)
+    {
+        audio_resample_set_trim(&s_resample, ppm);
+    }
+}
+
+// 现在写进来的第一个采样还要多久出声 环形缓冲 送数任务手里的一块 DMA里的 加重采样的半个窗口
+// DMA写满以后每发完一个描述符才写进一块 按平均少半个描述符算
+uint32_t audio_pcm_output_delay_us(void)
+{
+    uint32_t rate = s_codec_rate;
+    if (rate == 0 || s_ring == NULL)
+    {
+        return 0;
+    }
+    size_t frame_bytes = s_channels * (s_bits == 16 ? sizeof(int16_t) : sizeof(int32_t));
+    uint64_t frames = (ring_fill() + s_inflight) / frame_bytes;
+    frames += BSP_I2S_DMA_DESC_NUM * BSP_I2S_DMA_FRAME_NUM - BSP_I2S_DMA_FRAME_NUM / 2;
+    if (s_resample_active)
+    {
+        frames += RESAMPLE_TAPS / 2;
+    }
+    return (uint32_t)(frames * 1000000 / rate);
+}
+
+// 等缓冲播完后再设置采样率 保证切换前的数据按原采样率播放
+// 固定输出采样率时codec保持不变 改为配置重采样器
+esp_err_t audio_pcm_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    int channels = (ch == I2S_SLOT_MODE_MONO) ? 1 : 2;
+    // 上一种格式没写完的尾巴先写进去 写不进去就丢 之后都按新格式算
+    tail_flush(1000);
+    s_stretch_tail = 0;
+    s_resample_tail = 0;
+    // 32位原样送codec 要重采样 变速或者关了高解析度时抖动到16位 这些级只处理16位
+    uint32_t out_rate = s_output_rate ? s_output_rate : rate;
+    bool resample = out_rate != rate || s_clock_trim;
+    bool dither = bits_cfg == 32 && (!AUDIO_PCM_HIRES || s_speed != 100 || resample);
+    s_dither_on = dither;
+    s_stats.hires_bits = bits_cfg > 16 ? bits_cfg : 0;
+    bits_cfg = dither ? 16 : bits_cfg;
+    s_bits = bits_cfg;
+    s_channels = channels;
+    s_decode_rate = rate;
+    s_stretch_failed = false;
+    s_stretch_reset = true;
+    audio_vis_set_format(rate, channels);
+    audio_eq_set_rate(rate, channels);
+
+    if (resample && bits_cfg == 16)
+    {
+        if (!s_resample_active || s_resample.in_rate != rate || s_resample.out_rate != out_rate ||
+            s_resample.channels != channels)
+        {
+            audio_pcm_drain(1000);
+            if (s_resample_active)
+            {
+                audio_resample_deinit(&s_resample);
+                s_resample_active = false;
+            }
+            if (s_resample_buf == NULL)
+            {
+                s_resample_buf = heap_caps_malloc(RESAMPLE_OUT_FRAMES * RESAMPLE_MAX_CH * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+            }
+            if (s_resample_buf && audio_resample_init(&s_resample, rate, out_rate, channels) == ESP_OK)
+            {
+                s_resample_active = true;
+                s_stats.resample_in = rate;
+                s_stats.resample_out = out_rate;
+            }
+        }
+        else
+        {
+            audio_resample_reset(&s_resample);
+            audio_resample_set_trim(&s_resample, 0);
+        }
+        if (s_resample_active)
+        {
+            s_codec_rate = out_rate;
+            return bsp_codec_set_fs(out_rate, bits_cfg, ch); // 格式未变时不会访问codec
+        }
+        ESP_LOGW(TAG, "resampler unavailable, fall back to %lu Hz", (unsigned long)rate);
+    }
+
+    // 跟随音源采样率 或者非16位数据(重采样只支持16位)
+    audio_pcm_drain(1000);
+    if (s_resample_active)
+    {
+        audio_resample_deinit(&s_resample);
+        s_resample_active = false;
+        s_stats.resample_in = 0;
+        s_stats.resample_out = 0;
+    }
+    s_codec_rate = rate;
+    return bsp_codec_set_fs(rate, bits_cfg, ch);
+}
+
+void audio_pcm_set_tap(audio_pcm_tap_fn_t tap)
+{
+    s_tap = tap;
+}
+
+int audio_pcm_get_volume(void)
+{
+    return s_volume;
+}
+
+// 失败时不调用done
+esp_err_t audio_pcm_play(audio_pcm_src_t src, const int16_t *pcm, size_t frames, uint32_t rate,
+                         audio_pcm_prompt_done_t done, void *arg)
+{
+    ESP_RETURN_ON_FALSE(src < AUDIO_PCM_SRC_COUNT, ESP_ERR_INVALID_ARG, TAG, "bad source %d", src);
+    ESP_RETURN_ON_FALSE(s_src[src].q && pcm && frames && rate, ESP_ERR_INVALID_STATE, TAG, "mixer not ready");
+    pcm_clip_t p = {
+        .pcm = pcm,
+        .frames = frames,
+        .rate = rate,
+        .done = done,
+        .arg = arg,
+        .t_queued = esp_timer_get_time(),
+    };
+    if (xQueueSend(s_src[src].q, &p, 0) != pdTRUE)
+    {
+        s_stats.prompt_dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_pcm_prompt(const int16_t *pcm, size_t frames, uint32_t rate, audio_pcm_prompt_done_t done, void *arg)
+{
+    return audio_pcm_play(AUDIO_PCM_SRC_VOICE, pcm, frames, rate, done, arg);
+}
+
+void audio_pcm_set_src_volume(audio_pcm_src_t src, int volume)
+{
+    if (src < AUDIO_PCM_SRC_COUNT)
+    {
+        s_src[src].gain = volume_to_gain(volume);
+    }
+}
+
+bool audio_pcm_prompt_busy(void)
+{
+    return s_src[AUDIO_PCM_SRC_VOICE].q && src_pending(&s_src[AUDIO_PCM_SRC_VOICE]);
+}
+
+void audio_pcm_get_stats(audio_pcm_stats_t *stats)
+{
+    *stats = s_stats;
+    stats->fill = s_ring ? ring_fill() : 0;
+    if (s_resample_active)
+    {
+        stats->resample_cycles = s_resample.cycles;
+        stats->resample_frames = s_resample.frames_out;
+    }
+    stats->stretch_speed = s_stretch_on ? s_stretch.speed : 100;
+    stats->stretch_cycles = s_stretch.cycles;
+    stats->stretch_frames = s_stretch.frames_out;
+    stats->dither_on = s_dither_on;
+    stats->dither_cycles = s_dither.cycles;
+    stats->dither_samples = s_dither.samples;
+}
+
+void audio_pcm_set_speed(int speed)
+{
+    speed = speed < TSTRETCH_SPEED_MIN ? TSTRETCH_SPEED_MIN : speed;
+    s_speed = speed > TSTRETCH_SPEED_MAX ? TSTRETCH_SPEED_MAX : speed;
+}
+
+int audio_pcm_get_speed(void)
+{
+    return s_speed;
+}
+
+// 交叉淡入淡出混音 在解码任务中对16位立体声数据调用
+// 每AUDIO_PCM_FADE_BLOCK帧用一组等功率增益 块内用esp-dsp做乘法 相加要饱和
+// 等功率的中段两边增益都是0.707 和最大到1.41倍满幅 不饱和会绕回去出爆音
+void audio_pcm_crossfade_mix(int16_t *out, const int16_t *in, size_t frames, uint32_t fade_pos, uint32_t fade_len)
+{
+    int16_t scaled[AUDIO_PCM_FADE_BLOCK * 2] __attribute__((aligned(16)));
+    for (size_t i = 0; i < frames; i += AUDIO_PCM_FADE_BLOCK)
+    {
+        size_t n = frames - i < AUDIO_PCM_FADE_BLOCK ? frames - i : AUDIO_PCM_FADE_BLOCK;
+        uint32_t pos = fade_pos + i + n / 2;
+        float t = pos >= fade_len ? 1.0f : (float)pos / (float)fade_len;
+        int16_t g_in = (int16_t)(sinf(t * (float)M_PI_2) * 32767.0f);
+        int16_t g_out = (int16_t)(cosf(t * (float)M_PI_2) * 32767.0f);
+
+        dsps_mulc_s16(out + 2 * i, out + 2 * i, n * 2, g_out, 1, 1);
+        dsps_mulc_s16(in + 2 * i, scaled, n * 2, g_in, 1, 1);
+        mix_sat_s16(out + 2 * i, scaled, n * 2);
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/i2s_std.h"
+#include "sdkconfig.h"
+
+
+/*********************** PCM输出环形缓冲 ****************************/
+// 解码器 -> 变速 -> 重采样 -> 环形缓冲(PSRAM) -> 送数任务 -> bsp_i2s_write
+// 解码任务只往环形缓冲里写，SD卡卡顿或LVGL锁竞争不会直接造成I2S欠载
+// 送数任务每次取AUDIO_PCM_MIX_PERIOD_FRAMES帧音乐 把语音提示 按键音这些音源混进去再写 音乐不用停
+// 每个音源一个队列 各有增益 响着时按音源表把音乐压低 增益按块渐变 16位用PIE饱和相加
+// 24位FLAC和24/32位WAV解码成左对齐的32位 默认按32位原样送到ES8311
+// 关掉CONFIG_APP_AUDIO_HIRES 或者这首开始时要重采样或变速 写进来时先加TPDF抖动降到16位 见audio_dither.h
+
+#define AUDIO_PCM_RING_MS_DEFAULT   200     // 默认缓冲时长(ms)
+#define AUDIO_PCM_RING_MAX_RATE     48000   // 按最高采样率计算缓冲大小
+#define AUDIO_PCM_MIX_PERIOD_FRAMES 256     // 送数任务每次取的帧数 48kHz时5.3ms 32位立体声2KB
+#define AUDIO_PCM_WRITE_TIMEOUT_MS  50      // 送数任务单次写I2S的超时
+#define AUDIO_PCM_STANDBY_POLL_MS   500     // 待机时没有数据 多久看一次有没有提示音要混
+#define AUDIO_PCM_OUTPUT_RATE       0       // 固定输出采样率 0:跟随音源 48000/16000:重采样到固定采样率
+#ifdef CONFIG_APP_AUDIO_HIRES
+#define AUDIO_PCM_HIRES             1       // 32位数据原样输出
+#else
+#define AUDIO_PCM_HIRES             0
+#endif
+#define AUDIO_PCM_GAIN_RAMP_FRAMES  256     // 音量/静音渐变的帧数 约5ms
+#define AUDIO_PCM_VOL_DB_RANGE      50.0f   // 音量0~100对应-50~0dB 与esp_codec_dev默认曲线一致
+#define AUDIO_PCM_FADE_BLOCK        64      // 交叉淡化时增益保持不变的帧数
+#define AUDIO_PCM_PROMPT_QUEUE      16      // 每个音源排队的片段
+#define AUDIO_PCM_PROMPT_DUCK       11626   // 提示音响着时音乐的Q15增益 约-9dB
+#define AUDIO_PCM_UI_DUCK           23198   // 按键音响着时 约-3dB
+#define AUDIO_PCM_CALL_DUCK         5193    // 对讲时 约-16dB
+#define AUDIO_PCM_DUCK_STEP         1024    // 压低和恢复时每AUDIO_PCM_FADE_BLOCK帧走的Q15增益 -9dB约21块
+
+typedef enum {
+    AUDIO_PCM_SRC_VOICE,    // 语音提示 TTS
+    AUDIO_PCM_SRC_UI,       // 按键音 短音效
+    AUDIO_PCM_SRC_CALL,     // 对讲收到的声音 一包一段接着放
+    AUDIO_PCM_SRC_COUNT,
+} audio_pcm_src_t;
+
+typedef struct {
+    size_t   ring_size;     // 环形缓冲总字节数
+    size_t   fill;          // 当前缓冲的字节数
+    size_t   high_water;    // 缓冲最高水位(字节)
+    uint32_t underruns;     // 播放过程中缓冲被取空的次数
+    uint32_t writes;        // 解码器写入次数
+    uint32_t timeouts;      // 写入超时(缓冲满)次数
+    uint32_t resample_in;   // 当前重采样输入采样率 0表示未重采样
+    uint32_t resample_out;  // 当前重采样输出采样率
+    uint64_t resample_cycles;   // 重采样累计CPU周期
+    uint64_t resample_frames;   // 重采样累计输出帧数
+    uint32_t direct_writes;     // WAV直通写I2S的次数
+    uint64_t direct_bytes;      // WAV直通写I2S的字节数
+    uint32_t prompts;           // 放完的片段 所有音源一起算
+    uint32_t prompt_dropped;    // 队列满或格式不支持丢掉的
+    uint64_t prompt_frames;     // 混进去的帧数 按codec采样率
+    uint32_t prompt_wait_max_us;    // 排进队列到开始出声 不含DMA队列
+    uint32_t period_frames;     // 一个周期的帧数
+    uint32_t mix_periods;       // 做过混音的周期 没有音源也没在恢复压低的不算
+    uint64_t mix_cycles;        // 混音累计CPU周期 除以mix_periods是每周期的开销
+    uint32_t mix_cycles_max;
+    uint32_t stretch_speed;     // 现在的速度 百分比 100是没经过变速
+    uint64_t stretch_cycles;    // 变速累计CPU周期
+    uint64_t stretch_frames;    // 变速累计输出帧数
+    uint32_t hires_bits;        // 这首解码出来的位宽 16位曲目是0
+    bool     dither_on;         // 这首抖动到16位输出
+    uint64_t dither_cycles;     // 抖动累计CPU周期
+    uint64_t dither_samples;    // 抖动累计样本数
+} audio_pcm_stats_t;
+
+// 片段放完(或丢掉)时在送数任务里调用 可以释放pcm 不能阻塞
+typedef void (*audio_pcm_prompt_done_t)(void *arg);
+
+// 写到I2S的数据 写完以后交出去 rate是codec上现在的采样率 在送数任务或解码任务里调用 不能阻塞
+typedef void (*audio_pcm_tap_fn_t)(const void *pcm, size_t len, uint32_t rate, int channels, uint32_t bits);
+
+esp_err_t audio_pcm_init(uint32_t ring_ms);  // 创建环形缓冲与送数任务 可重复调用
+esp_err_t audio_pcm_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms); // 写入PCM数据
+esp_err_t audio_pcm_write_direct(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms); // 大块PCM不经环形缓冲直接写I2S
+esp_err_t audio_pcm_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch); // 等缓冲播完后再设置采样率
+esp_err_t audio_pcm_drain(uint32_t timeout_ms); // 等待缓冲中的数据全部送到I2S
+void audio_pcm_flush(void);                     // 丢弃缓冲中尚未播放的数据
+void audio_pcm_pause(void);                     // 解码器暂停 之后取空缓冲不算欠载 再写入时恢复
+void audio_pcm_set_output_rate(uint32_t rate);  // 设置固定输出采样率 0为跟随音源 下次设置采样率时生效
+void audio_pcm_set_clock_trim(bool on);         // 采样率相同也经过重采样 下次设置采样率时生效 跟别的设备对时钟用
+void audio_pcm_set_rate_trim(int ppm);          // 微调重采样步长 正的放得快一点 在写数据的任务里调用
+uint32_t audio_pcm_output_delay_us(void);       // 现在写进来的数据还要多久到codec 毫秒级的估计
+void audio_pcm_set_volume(int volume);          // 软件音量 0~100 不访问I2C
+void audio_pcm_set_mute(bool mute);             // 软件静音 之前写进来的照常播 在那个位置上渐变无爆音
+void audio_pcm_set_speed(int speed);            // 播放速度 百分比75~200 变速不变调 100不经过变速
+int audio_pcm_get_speed(void);
+void audio_pcm_set_track_gain(int gain_cdb);    // 曲目的响度归一化增益 0.01dB 乘在音乐的音量上 音源不受影响 换曲时设
+void audio_pcm_set_tap(audio_pcm_tap_fn_t tap); // 回声消除取播放参考用 NULL取消
+int audio_pcm_get_volume(void);                 // 最近一次audio_pcm_set_volume的值
+// 音源片段: 单声道16位 同一个音源按顺序一段接一段放 不同音源同时响 放歌时混进音乐 没放歌时送数任务自己垫静音写出去
+// pcm在done回调之前要一直有效 done可以为NULL 任何任务里都能调用 不阻塞
+esp_err_t audio_pcm_play(audio_pcm_src_t src, const int16_t *pcm, size_t frames, uint32_t rate,
+                         audio_pcm_prompt_done_t done, void *arg);
+esp_err_t audio_pcm_prompt(const int16_t *pcm, size_t frames, uint32_t rate, audio_pcm_prompt_done_t done, void *arg); // AUDIO_PCM_SRC_VOICE
+void audio_pcm_set_src_volume(audio_pcm_src_t src, int volume); // 音源自己的音量 0~100 乘在总音量上 默认100
+bool audio_pcm_prompt_busy(void);               // 还有没放完的语音提示
+void audio_pcm_get_stats(audio_pcm_stats_t *stats);
+void audio_pcm_crossfade_mix(int16_t *out, const int16_t *in, size_t frames, uint32_t fade_pos, uint32_t fade_len); // 交叉淡化混音 作为audio_player的mix_fn
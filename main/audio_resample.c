@@ -0,0 +1,160 @@
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "audio_resample.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "dsps_dotprod.h"
+
+static const char *TAG = "resample";
+
+#define RESAMPLE_GAIN   0.9f   // 留出插值过冲的余量 dsps_dotprod_s16输出不饱和
+
+// 生成多相系数 Blackman窗sinc 每个相位单独归一化保证直流增益一致
+static void resample_build_coef(audio_resample_t *rs)
+{
+    float fc = 0.9f; // 截止频率 相对输入奈奎斯特
+    if (rs->out_rate < rs->in_rate) {
+        fc *= (float)rs->out_rate / rs->in_rate; // 降采样时压低截止频率防止混叠
+    }
+
+    float taps[RESAMPLE_TAPS];
+    for (int p = 0; p < RESAMPLE_PHASES; p++) {
+        float frac = (float)p / RESAMPLE_PHASES;
+        float sum = 0;
+        for (int k = 0; k < RESAMPLE_TAPS; k++) {
+            float x = k - (RESAMPLE_TAPS / 2 - 1) - frac;
+            float s = (x == 0.0f) ? 1.0f : sinf(M_PI * fc * x) / (M_PI * fc * x);
+            float w = 0;
+            if (fabsf(x) < RESAMPLE_TAPS / 2) {
+                float a = 2.0f * M_PI * x / RESAMPLE_TAPS;
+                w = 0.42f + 0.5f * cosf(a) + 0.08f * cosf(2 * a);
+            }
+            taps[k] = s * w;
+            sum += taps[k];
+        }
+        for (int k = 0; k < RESAMPLE_TAPS; k++) {
+            rs->coef[p * RESAMPLE_TAPS + k] = (int16_t)lrintf(taps[k] / sum * RESAMPLE_GAIN * 32767.0f);
+        }
+    }
+}
+
+esp_err_t audio_resample_init(audio_resample_t *rs, uint32_t in_rate, uint32_t out_rate, int channels)
+{
+    ESP_RETURN_ON_FALSE(in_rate && out_rate && channels > 0 && channels <= RESAMPLE_MAX_CH,
+                        ESP_ERR_INVALID_ARG, TAG, "bad args");
+    esp_err_t ret = ESP_OK;
+    memset(rs, 0, sizeof(*rs));
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->channels = channels;
+    rs->step = (uint32_t)(((uint64_t)in_rate << 16) / out_rate);
+    rs->step0 = rs->step;
+
+    // 系数和历史缓冲都在卷积内循环里 放内部RAM 16字节对齐
+    rs->coef = heap_caps_aligned_alloc(16, RESAMPLE_PHASES * RESAMPLE_TAPS * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    ESP_GOTO_ON_FALSE(rs->coef, ESP_ERR_NO_MEM, err, TAG, "no mem for coef");
+    for (int c = 0; c < channels; c++) {
+        rs->hist[c] = heap_caps_aligned_alloc(16, (RESAMPLE_TAPS + RESAMPLE_BLOCK) * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+        ESP_GOTO_ON_FALSE(rs->hist[c], ESP_ERR_NO_MEM, err, TAG, "no mem for history");
+    }
+
+    resample_build_coef(rs);
+    audio_resample_reset(rs);
+    ESP_LOGI(TAG, "%lu -> %lu Hz, %d ch", (unsigned long)in_rate, (unsigned long)out_rate, channels);
+    return ESP_OK;
+
+err:
+    audio_resample_deinit(rs);
+    return ret;
+}
+
+void audio_resample_deinit(audio_resample_t *rs)
+{
+    if (rs->coef) {
+        heap_caps_free(rs->coef);
+    }
+    for (int c = 0; c < RESAMPLE_MAX_CH; c++) {
+        if (rs->hist[c]) {
+            heap_caps_free(rs->hist[c]);
+        }
+    }
+    memset(rs, 0, sizeof(*rs));
+}
+
+void audio_resample_reset(audio_resample_t *rs)
+{
+    // 预填半个窗口的静音 输出从第一个输入采样开始
+    rs->hist_len = RESAMPLE_TAPS / 2 - 1;
+    rs->pos = 0;
+    for (int c = 0; c < rs->channels; c++) {
+        memset(rs->hist[c], 0, (RESAMPLE_TAPS + RESAMPLE_BLOCK) * sizeof(int16_t));
+    }
+}
+
+void audio_resample_set_trim(audio_resample_t *rs, int ppm)
+{
+    rs->step = (uint32_t)((int64_t)rs->step0 + (int64_t)rs->step0 * ppm / 1000000);
+}
+
+size_t audio_resample_process(audio_resample_t *rs, const int16_t *in, size_t in_frames,
+                              int16_t *out, size_t out_frames, size_t *in_used)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    const int ch = rs->channels;
+    size_t used = 0;
+    size_t produced = 0;
+
+    while (produced < out_frames) {
+        // 把输入拆成每声道的历史缓冲
+        size_t space = RESAMPLE_TAPS + RESAMPLE_BLOCK - rs->hist_len;
+        size_t n = in_frames - used;
+        if (n > space) {
+            n = space;
+        }
+        for (size_t i = 0; i < n; i++) {
+            for (int c = 0; c < ch; c++) {
+                rs->hist[c][rs->hist_len + i] = in[(used + i) * ch + c];
+            }
+        }
+        rs->hist_len += n;
+        used += n;
+
+        // 历史缓冲里凑够一个窗口就输出一帧
+        bool progress = false;
+        while (produced < out_frames && (int)(rs->pos >> 16) + RESAMPLE_TAPS <= rs->hist_len) {
+            int base = rs->pos >> 16;
+            const int16_t *coef = rs->coef + (((rs->pos & 0xffff) * RESAMPLE_PHASES) >> 16) * RESAMPLE_TAPS;
+            for (int c = 0; c < ch; c++) {
+                dsps_dotprod_s16(&rs->hist[c][base], coef, &out[produced * ch + c], RESAMPLE_TAPS, 0);
+            }
+            rs->pos += rs->step;
+            produced++;
+            progress = true;
+        }
+
+        // 丢掉已经用不到的历史
+        int drop = rs->pos >> 16;
+        if (drop > 0) {
+            if (drop > rs->hist_len) {
+                drop = rs->hist_len;
+            }
+            for (int c = 0; c < ch; c++) {
+                memmove(rs->hist[c], rs->hist[c] + drop, (rs->hist_len - drop) * sizeof(int16_t));
+            }
+            rs->hist_len -= drop;
+            rs->pos -= (uint32_t)drop << 16;
+        }
+
+        if (!progress && used >= in_frames) {
+            break; // 输入用完 等下一次调用
+        }
+    }
+
+    rs->cycles += esp_cpu_get_cycle_count() - start;
+    rs->frames_out += produced;
+    *in_used = used;
+    return produced;
+}
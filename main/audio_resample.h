@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+
+/*********************** 多相FIR重采样 ****************************/
+// 16位交错PCM 任意采样率比 用esp-dsp的dsps_dotprod_s16做每个相位的点积
+
+#define RESAMPLE_TAPS       16      // 每个相位的抽头数(dsps_dotprod_s16要求>=4)
+#define RESAMPLE_PHASES     128     // 相位数 小数位置量化到1/128个采样
+#define RESAMPLE_MAX_CH     2
+#define RESAMPLE_BLOCK      512     // 每次处理的输入帧数
+
+typedef struct {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t step;                      // 输入步长 in_rate/out_rate Q16.16
+    uint32_t step0;                     // 没有微调时的步长
+    uint32_t pos;                       // 相对历史缓冲起点的读位置 Q16.16
+    int channels;
+    int16_t *coef;                      // [RESAMPLE_PHASES][RESAMPLE_TAPS]
+    int16_t *hist[RESAMPLE_MAX_CH];     // 每声道历史缓冲 RESAMPLE_TAPS + RESAMPLE_BLOCK
+    int hist_len;                       // 历史缓冲有效帧数
+    uint64_t cycles;                    // 累计CPU周期
+    uint64_t frames_out;                // 累计输出帧数
+} audio_resample_t;
+
+esp_err_t audio_resample_init(audio_resample_t *rs, uint32_t in_rate, uint32_t out_rate, int channels);
+void audio_resample_deinit(audio_resample_t *rs);
+void audio_resample_reset(audio_resample_t *rs);    // 清空历史 换曲时调用
+// 按ppm微调步长 正的消耗输入更快 跟别的时钟对齐用 分辨率是步长的一个LSB 同采样率时约15ppm
+void audio_resample_set_trim(audio_resample_t *rs, int ppm);
+// 处理交错PCM 返回输出帧数 *in_used返回消耗的输入帧数 输出缓冲满时提前返回
+size_t audio_resample_process(audio_resample_t *rs, const int16_t *in, size_t in_frames,
+                              int16_t *out, size_t out_frames, size_t *in_used);
@@ -0,0 +1,177 @@
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include "audio_tstretch.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "dsps_dotprod.h"
+
+static const char *TAG = "tstretch";
+
+esp_err_t audio_tstretch_init(audio_tstretch_t *ts, uint32_t rate, int channels)
+{
+    ESP_RETURN_ON_FALSE(rate && rate <= TSTRETCH_MAX_RATE && channels > 0 && channels <= TSTRETCH_MAX_CH,
+                        ESP_ERR_INVALID_ARG, TAG, "bad args");
+    memset(ts, 0, sizeof(*ts));
+    ts->rate = rate;
+    ts->channels = channels;
+    ts->hop = rate * TSTRETCH_HOP_MS / 1000 / TSTRETCH_DEC * TSTRETCH_DEC;
+    ts->seek = rate * TSTRETCH_SEEK_MS / 1000 / TSTRETCH_DEC * TSTRETCH_DEC;
+
+    // 单声道和淡入窗在相关和淡化的内循环里 放内部RAM 交错的原始数据只在淡化时读一次 放PSRAM
+    ts->mono = heap_caps_aligned_alloc(16, TSTRETCH_BUF_FRAMES * sizeof(float), MALLOC_CAP_INTERNAL);
+    ts->fade = heap_caps_malloc(ts->hop * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    ts->buf = heap_caps_malloc(TSTRETCH_BUF_FRAMES * channels * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (ts->mono == NULL || ts->fade == NULL || ts->buf == NULL) {
+        audio_tstretch_deinit(ts);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // 升余弦 淡入淡出两条加起来是1
+    for (int i = 0; i < ts->hop; i++) {
+        float s = sinf(M_PI / 2 * (i + 0.5f) / ts->hop);
+        ts->fade[i] = (int16_t)lrintf(s * s * 32767.0f);
+    }
+    audio_tstretch_set_speed(ts, 100);
+    audio_tstretch_reset(ts);
+    ESP_LOGI(TAG, "%lu Hz, %d ch, hop %d, seek %d", (unsigned long)rate, channels, ts->hop, ts->seek);
+    return ESP_OK;
+}
+
+void audio_tstretch_deinit(audio_tstretch_t *ts)
+{
+    if (ts->mono) {
+        heap_caps_free(ts->mono);
+    }
+    if (ts->fade) {
+        heap_caps_free(ts->fade);
+    }
+    if (ts->buf) {
+        heap_caps_free(ts->buf);
+    }
+    memset(ts, 0, sizeof(*ts));
+}
+
+void audio_tstretch_reset(audio_tstretch_t *ts)
+{
+    ts->len = 0;
+    ts->tmpl = 0;
+    ts->nom = ts->step;
+}
+
+void audio_tstretch_set_speed(audio_tstretch_t *ts, int speed)
+{
+    speed = speed < TSTRETCH_SPEED_MIN ? TSTRETCH_SPEED_MIN : speed;
+    speed = speed > TSTRETCH_SPEED_MAX ? TSTRETCH_SPEED_MAX : speed;
+    ts->speed = speed;
+    ts->step = (uint32_t)(((uint64_t)ts->hop << 16) * speed / 100);
+}
+
+// 在名义位置附近找和模板最像的起点 比较xy*|xy|/yy 和归一化互相关同序 不用开方
+static int tstretch_seek(const audio_tstretch_t *ts, int nom)
+{
+    const float *t = ts->mono + ts->tmpl;
+    int lo = nom - ts->seek > 0 ? nom - ts->seek : 0;
+    int hi = nom + ts->seek;
+    int best = lo;
+    float best_score = -INFINITY;
+    float xy, yy;
+
+    for (int p = lo; p <= hi; p += TSTRETCH_DEC) {
+        dsps_dotprode_f32(t, ts->mono + p, &xy, ts->hop / TSTRETCH_DEC, TSTRETCH_DEC, TSTRETCH_DEC);
+        dsps_dotprode_f32(ts->mono + p, ts->mono + p, &yy, ts->hop / TSTRETCH_DEC, TSTRETCH_DEC, TSTRETCH_DEC);
+        float score = xy * fabsf(xy) / (yy + 1e-9f);
+        if (score > best_score) {
+            best_score = score;
+            best = p;
+        }
+    }
+
+    int coarse = best;
+    best_score = -INFINITY;
+    for (int p = coarse - TSTRETCH_DEC + 1; p < coarse + TSTRETCH_DEC; p++) {
+        if (p < lo || p > hi) {
+            continue;
+        }
+        dsps_dotprod_f32(t, ts->mono + p, &xy, ts->hop);
+        dsps_dotprod_f32(ts->mono + p, ts->mono + p, &yy, ts->hop);
+        float score = xy * fabsf(xy) / (yy + 1e-9f);
+        if (score > best_score) {
+            best_score = score;
+            best = p;
+        }
+    }
+    return best;
+}
+
+size_t audio_tstretch_process(audio_tstretch_t *ts, const int16_t *in, size_t in_frames,
+                              int16_t *out, size_t out_frames, size_t *in_used)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    const int ch = ts->channels;
+    const float norm = 1.0f / (32768.0f * ch);
+    size_t used = 0;
+    size_t produced = 0;
+
+    while (1) {
+        // 新输入接到缓冲后面 顺便转成单声道
+        size_t n = in_frames - used;
+        if (n > (size_t)(TSTRETCH_BUF_FRAMES - ts->len)) {
+            n = TSTRETCH_BUF_FRAMES - ts->len;
+        }
+        memcpy(ts->buf + ts->len * ch, in + used * ch, n * ch * sizeof(int16_t));
+        for (size_t i = 0; i < n; i++) {
+            int sum = 0;
+            for (int c = 0; c < ch; c++) {
+                sum += in[(used + i) * ch + c];
+            }
+            ts->mono[ts->len + i] = sum * norm;
+        }
+        ts->len += n;
+        used += n;
+
+        // 模板和整个搜索范围都在缓冲里才能出一段
+        int nom = ts->nom >> 16;
+        int need = nom + ts->seek + ts->hop;
+        if (ts->tmpl + ts->hop > need) {
+            need = ts->tmpl + ts->hop;
+        }
+        if (ts->len < need || produced + ts->hop > out_frames) {
+            break;
+        }
+
+        int p = tstretch_seek(ts, nom);
+        const int16_t *a = ts->buf + ts->tmpl * ch;
+        const int16_t *b = ts->buf + p * ch;
+        int16_t *o = out + produced * ch;
+        for (int i = 0; i < ts->hop; i++) {
+            int32_t w = ts->fade[i];
+            for (int c = 0; c < ch; c++) {
+                o[i * ch + c] = (int16_t)((a[i * ch + c] * (32767 - w) + b[i * ch + c] * w) >> 15);
+            }
+        }
+        produced += ts->hop;
+        ts->tmpl = p + ts->hop;
+        ts->nom += ts->step;
+
+        // 丢掉模板和下一次搜索都用不到的部分
+        int drop = (int)(ts->nom >> 16) - ts->seek;
+        if (drop > ts->tmpl) {
+            drop = ts->tmpl;
+        }
+        if (drop > 0) {
+            memmove(ts->buf, ts->buf + drop * ch, (ts->len - drop) * ch * sizeof(int16_t));
+            memmove(ts->mono, ts->mono + drop, (ts->len - drop) * sizeof(float));
+            ts->len -= drop;
+            ts->tmpl -= drop;
+            ts->nom -= (uint32_t)drop << 16;
+        }
+    }
+
+    ts->frames_out += produced;
+    ts->cycles += esp_cpu_get_cycle_count() - start;
+    *in_used = used;
+    return produced;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+
+/*********************** WSOLA变速不变调 ****************************/
+// 16位交错PCM 输出每次前进一个合成步长 输入按速度前进 在附近找和上一段接得最像的位置再交叉淡化
+// 相似度用单声道浮点的归一化互相关 先隔TSTRETCH_DEC个采样粗找 再在粗找结果附近逐个采样细找 都用esp-dsp的点积
+// 适合语音 音乐在2倍附近会有点颤
+
+#define TSTRETCH_SPEED_MIN  75      // 速度 百分比 100为原速
+#define TSTRETCH_SPEED_MAX  200
+#define TSTRETCH_HOP_MS     10      // 合成步长 也是交叉淡化的长度
+#define TSTRETCH_SEEK_MS    8       // 在名义位置前后找这么远
+#define TSTRETCH_DEC        4       // 粗找时的采样间隔
+#define TSTRETCH_MAX_RATE   48000
+#define TSTRETCH_MAX_CH     2
+#define TSTRETCH_BUF_FRAMES 3072    // 输入缓冲 48kHz 2倍速时要2*步长+2*搜索范围 再留一块新输入
+
+typedef struct {
+    uint32_t rate;
+    int channels;
+    int hop;                            // 合成步长 帧
+    int seek;                           // 搜索范围 帧
+    uint32_t step;                      // 分析步长 hop*速度 Q16.16
+    int speed;
+    int16_t *buf;                       // 交错输入 TSTRETCH_BUF_FRAMES帧
+    float *mono;                        // 同样位置的单声道 算相关用
+    int16_t *fade;                      // 淡入窗 Q15 hop个
+    int len;                            // 缓冲里的帧数
+    int tmpl;                           // 上一段的自然延续 下一段要和它接上
+    uint32_t nom;                       // 下一段的名义位置 Q16.16
+    uint64_t cycles;                    // 累计CPU周期
+    uint64_t frames_out;                // 累计输出帧数
+} audio_tstretch_t;
+
+esp_err_t audio_tstretch_init(audio_tstretch_t *ts, uint32_t rate, int channels);
+void audio_tstretch_deinit(audio_tstretch_t *ts);
+void audio_tstretch_reset(audio_tstretch_t *ts);    // 清空缓冲 换曲和跳转时调用
+void audio_tstretch_set_speed(audio_tstretch_t *ts, int speed);
+// 处理交错PCM 返回输出帧数 *in_used返回消耗的输入帧数 输出缓冲满时提前返回
+size_t audio_tstretch_process(audio_tstretch_t *ts, const int16_t *in, size_t in_frames,
+                              int16_t *out, size_t out_frames, size_t *in_used);
@@ -0,0 +1,370 @@
+#include <math.h>
+#include <string.h>
+#include "audio_tuner.h"
+#include "audio_vis.h"
+#include "voice_cmd.h"
+#include "task_plan.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "dsps_fft2r.h"
+#include "dsps_dotprod.h"
+
+static const char *TAG = "audio_tuner";
+
+#define TUNER_RING          4096        // 2的幂 比一块多留两百毫秒 分析慢一点也不会被盖掉
+#define TUNER_TAU_MIN       (TUNER_RATE / TUNER_F0_MAX_HZ)
+#define TUNER_TAU_MAX       (TUNER_RATE / TUNER_F0_MIN_HZ)
+#define TUNER_YIN_W         (TUNER_FFT_N - TUNER_TAU_MAX)
+#define TUNER_HOLD_DECAY    64          // 保持时间过了每块落0.64dB 约20dB/s
+#define TUNER_CDB_MIN       (-TUNER_RANGE_DB * 100)
+
+_Static_assert(TUNER_FFT_N <= AUDIO_FFT_TABLE_N, "FFT table too small");
+_Static_assert(TUNER_HOP * 2 <= TUNER_FFT_N, "hop larger than half a block");
+
+static TaskHandle_t s_task = NULL;
+static volatile bool s_running = false;
+static volatile bool s_stopping = false;
+
+// 送数任务单写 分析任务读最新的一块
+static int16_t s_ring[TUNER_RING];
+static volatile uint32_t s_head = 0;
+
+static float s_window[TUNER_FFT_N];
+static float s_x[TUNER_FFT_N];
+static float s_fft[TUNER_FFT_N * 2] __attribute__((aligned(16)));
+static float s_cmnd[TUNER_TAU_MAX + 1];
+static uint16_t s_band_edge[TUNER_BANDS + 1];
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static tuner_result_t s_result;
+static tuner_stats_t s_stats;
+static uint64_t s_cycles_sum = 0;
+static uint64_t s_fft_sum = 0;
+static uint64_t s_yin_sum = 0;
+
+static const char *const s_note_names[12] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+
+// 在送数任务里 两路取平均拷进环 跨过一个跳步叫醒分析任务
+static void tuner_tap(const int16_t *mic, size_t frames, int stride)
+{
+    if (!s_running)
+    {
+        return;
+    }
+    uint32_t head = s_head;
+    uint32_t start = head;
+    for (size_t i = 0; i < frames; i++, mic += stride)
+    {
+        s_ring[head & (TUNER_RING - 1)] = (mic[0] + mic[1]) >> 1;
+        head++;
+    }
+    s_head = head;
+    if (head / TUNER_HOP != start / TUNER_HOP)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static int16_t db_cdb(float db)
+{
+    float v = db * 100.0f;
+    return v <= TUNER_CDB_MIN ? TUNER_CDB_MIN : v >= 0.0f ? 0 : (int16_t)v;
+}
+
+// 加窗 FFT 每个频段取最大的bin
+static void tuner_spectrum(tuner_result_t *r)
+{
+    for (int i = 0; i < TUNER_FFT_N; i++)
+    {
+        s_fft[2 * i] = s_x[i] * s_window[i];
+        s_fft[2 * i + 1] = 0.0f;
+    }
+    dsps_fft2r_fc32(s_fft, TUNER_FFT_N);
+    dsps_bit_rev_fc32(s_fft, TUNER_FFT_N);
+
+    // 汉宁窗增益0.5 满幅正弦的单边谱峰值约为N/4
+    const float norm = 16.0f / ((float)TUNER_FFT_N * TUNER_FFT_N);
+    for (int b = 0; b < TUNER_BANDS; b++)
+    {
+        float p = 0.0f;
+        for (int k = s_band_edge[b]; k < s_band_edge[b + 1]; k++)
+        {
+            float re = s_fft[2 * k], im = s_fft[2 * k + 1];
+            float m = re * re + im * im;
+            p = m > p ? m : p;
+        }
+        r->bands[b] = db_cdb(10.0f * log10f(p * norm + 1e-12f)) / 100;
+    }
+}
+
+// YIN 返回false是没找到基音 s_x已经按峰值归一化 能量的浮点误差和电平无关
+static bool tuner_yin(tuner_result_t *r)
+{
+    float e0 = 0.0f;
+    for (int i = 0; i < TUNER_YIN_W; i++)
+    {
+        e0 += s_x[i] * s_x[i];
+    }
+    float et = e0;
+    float sum = 0.0f;
+    s_cmnd[0] = 1.0f;
+    for (int t = 1; t <= TUNER_TAU_MAX; t++)
+    {
+        et += s_x[t + TUNER_YIN_W - 1] * s_x[t + TUNER_YIN_W - 1] - s_x[t - 1] * s_x[t - 1];
+        float cross;
+        dsps_dotprod_f32(s_x, s_x + t, &cross, TUNER_YIN_W);
+        float d = e0 + et - 2.0f * cross;
+        d = d > 0.0f ? d : 0.0f;
+        sum += d;
+        s_cmnd[t] = sum > 0.0f ? d * t / sum : 1.0f;
+    }
+
+    int tau = 0;
+    for (int t = TUNER_TAU_MIN; t < TUNER_TAU_MAX; t++)
+    {
+        if (s_cmnd[t] < TUNER_YIN_THRESHOLD)
+        {
+            while (t + 1 < TUNER_TAU_MAX && s_cmnd[t + 1] < s_cmnd[t])
+            {
+                t++; // 走到谷底
+            }
+            tau = t;
+            break;
+        }
+    }
+    if (tau == 0)
+    {
+        return false;
+    }
+    float a = s_cmnd[tau - 1], b = s_cmnd[tau], c = s_cmnd[tau + 1];
+    float den = a - 2.0f * b + c;
+    float shift = den > 0.0f ? 0.5f * (a - c) / den : 0.0f;
+    r->f0 = (float)TUNER_RATE / (tau + shift);
+    r->clarity = 1.0f - b;
+    float semis = 12.0f * log2f(r->f0 / TUNER_A4_HZ);
+    int n = (int)lroundf(semis);
+    r->note = 69 + n;
+    r->cents = (int)lroundf((semis - n) * 100.0f);
+    r->cents = r->cents > 49 ? 49 : r->cents;
+    return true;
+}
+
+// 取环里到end为止的一块 算电平 频谱 基音
+static void tuner_analyze(uint32_t end, tuner_result_t *r, uint32_t *fft_cycles, uint32_t *yin_cycles)
+{
+    float sum_sq = 0.0f, peak = 0.0f;
+    for (int i = 0; i < TUNER_FFT_N; i++)
+    {
+        float x = s_ring[(end - TUNER_FFT_N + i) & (TUNER_RING - 1)] * (1.0f / 32768.0f);
+        float m = fabsf(x);
+        sum_sq += x * x;
+        peak = m > peak ? m : peak;
+        s_x[i] = x;
+    }
+    r->rms_cdb = db_cdb(10.0f * log10f(sum_sq / TUNER_FFT_N + 1e-12f));
+    r->peak_cdb = db_cdb(20.0f * log10f(peak + 1e-9f));
+
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    tuner_spectrum(r);
+    uint32_t c1 = esp_cpu_get_cycle_count();
+    *fft_cycles = c1 - c0;
+
+    r->voiced = false;
+    if (r->rms_cdb > TUNER_GATE_DB * 100)
+    {
+        float g = 1.0f / peak;
+        for (int i = 0; i < TUNER_FFT_N; i++)
+        {
+            s_x[i] *= g;
+        }
+        r->voiced = tuner_yin(r);
+    }
+    *yin_cycles = esp_cpu_get_cycle_count() - c1;
+}
+
+static void tuner_account(uint32_t cycles, uint32_t fft, uint32_t yin, uint32_t budget)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.blocks++;
+    s_cycles_sum += cycles;
+    s_fft_sum += fft;
+    s_yin_sum += yin;
+    s_stats.cycles_avg = (uint32_t)(s_cycles_sum / s_stats.blocks);
+    s_stats.fft_cycles_avg = (uint32_t)(s_fft_sum / s_stats.blocks);
+    s_stats.yin_cycles_avg = (uint32_t)(s_yin_sum / s_stats.blocks);
+    s_stats.cycles_max = cycles > s_stats.cycles_max ? cycles : s_stats.cycles_max;
+    s_stats.load_permille = (uint32_t)((uint64_t)s_stats.cycles_avg * 1000 / budget);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void audio_tuner_task(void *arg)
+{
+    const uint32_t budget = (uint32_t)((uint64_t)TUNER_HOP * 1000000 / TUNER_RATE) * esp_rom_get_cpu_ticks_per_us();
+    tuner_result_t r = {
+        .rms_cdb = TUNER_CDB_MIN,
+        .peak_cdb = TUNER_CDB_MIN,
+        .hold_cdb = TUNER_CDB_MIN,
+    };
+    uint32_t last = 0;
+    uint32_t last_report = 0;
+    int64_t hold_us = 0;
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (s_stopping)
+        {
+            s_stopping = false;
+            memset(&r, 0, sizeof(r)); // 下次打开从头数 跳块也不和这次比
+            r.rms_cdb = r.peak_cdb = r.hold_cdb = TUNER_CDB_MIN;
+            last = 0;
+            continue;
+        }
+        uint32_t end = s_head / TUNER_HOP * TUNER_HOP;
+        if (end < TUNER_FFT_N || end == last)
+        {
+            continue;
+        }
+        if (last && end - last > TUNER_HOP)
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_stats.overruns += (end - last) / TUNER_HOP - 1;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        last = end;
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        uint32_t fft, yin;
+        tuner_analyze(end, &r, &fft, &yin);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+        int64_t now = esp_timer_get_time();
+        if (r.peak_cdb >= r.hold_cdb)
+        {
+            r.hold_cdb = r.peak_cdb;
+            hold_us = now;
+        }
+        else if (now - hold_us > TUNER_PEAK_HOLD_MS * 1000LL)
+        {
+            r.hold_cdb = r.hold_cdb - TUNER_HOLD_DECAY > r.peak_cdb ? r.hold_cdb - TUNER_HOLD_DECAY : r.peak_cdb;
+        }
+        r.seq++;
+        portENTER_CRITICAL(&s_lock);
+        s_result = r;
+        portEXIT_CRITICAL(&s_lock);
+        tuner_account(cycles, fft, yin, budget);
+
+        if (s_stats.blocks - last_report >= TUNER_STATS_PERIOD_S * TUNER_RATE / TUNER_HOP)
+        {
+            last_report = s_stats.blocks;
+            tuner_stats_t st;
+            audio_tuner_get_stats(&st);
+            ESP_LOGI(TAG, "block %d: avg %lu cycles (fft %lu, yin %lu), max %lu, load %lu.%lu%%, %lu overruns",
+                     TUNER_FFT_N, (unsigned long)st.cycles_avg, (unsigned long)st.fft_cycles_avg,
+                     (unsigned long)st.yin_cycles_avg, (unsigned long)st.cycles_max,
+                     (unsigned long)(st.load_permille / 10), (unsigned long)(st.load_permille % 10),
+                     (unsigned long)st.overruns);
+        }
+    }
+}
+
+// 第一次打开时建表和任务 以后只是接上和断开麦克风
+static esp_err_t tuner_init(void)
+{
+    if (s_task)
+    {
+        return ESP_OK;
+    }
+    esp_err_t ret = dsps_fft2r_init_fc32(NULL, AUDIO_FFT_TABLE_N);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "fft init failed: %d", ret);
+        return ret;
+    }
+    for (int i = 0; i < TUNER_FFT_N; i++)
+    {
+        s_window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (TUNER_FFT_N - 1));
+    }
+    // 频段按对数分布在TUNER_BAND_LO_HZ ~ 奈奎斯特 每段至少一个bin
+    const float lo = (float)TUNER_BAND_LO_HZ * TUNER_FFT_N / TUNER_RATE;
+    const int bins = TUNER_FFT_N / 2;
+    s_band_edge[0] = (uint16_t)lroundf(lo);
+    for (int b = 1; b <= TUNER_BANDS; b++)
+    {
+        int e = (int)lroundf(lo * powf(bins / lo, (float)b / TUNER_BANDS));
+        if (e <= s_band_edge[b - 1])
+        {
+            e = s_band_edge[b - 1] + 1;
+        }
+        s_band_edge[b] = e > bins ? bins : e;
+    }
+    BaseType_t ok = task_plan_create(TASK_AUDIO_TUNER, audio_tuner_task, NULL, &s_task);
+    return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t audio_tuner_start(void)
+{
+    if (s_running)
+    {
+        return ESP_OK;
+    }
+    esp_err_t ret = tuner_init();
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_result, 0, sizeof(s_result));
+    s_result.rms_cdb = s_result.peak_cdb = s_result.hold_cdb = TUNER_CDB_MIN;
+    portEXIT_CRITICAL(&s_lock);
+    s_running = true;
+    ret = voice_cmd_set_mic_tap(tuner_tap);
+    if (ret != ESP_OK)
+    {
+        s_running = false;
+        ESP_LOGW(TAG, "microphones not available");
+    }
+    return ret;
+}
+
+void audio_tuner_stop(void)
+{
+    if (!s_running)
+    {
+        return;
+    }
+    voice_cmd_set_mic_tap(NULL);
+    s_running = false;
+    s_stopping = true;
+    xTaskNotifyGive(s_task); // 环里剩下的不再分析
+}
+
+bool audio_tuner_running(void)
+{
+    return s_running;
+}
+
+bool audio_tuner_get(tuner_result_t *out)
+{
+    uint32_t seq = out->seq;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_result;
+    portEXIT_CRITICAL(&s_lock);
+    return out->seq != seq;
+}
+
+void audio_tuner_get_stats(tuner_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+const char *audio_tuner_note_name(int note)
+{
+    return s_note_names[((note % 12) + 12) % 12];
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 调音器/音频分析 ****************************/
+// 麦克风由语音识别的送数任务读 它每读一块转到16k后交一份过来(voice_cmd_set_mic_tap) 两路取平均进环
+// 送数任务在核0 这里只拷贝 攒够TUNER_HOP个样本通知核1上的分析任务
+// 每块取最新的TUNER_FFT_N个样本 算RMS和峰值 加汉宁窗做FFT按对数频段出频谱 再用YIN找基音
+// YIN的差分函数d(t) = 两段能量之和 - 2*互相关 能量用前缀和 互相关用dsps_dotprod_f32
+// 累计均值归一化后取第一个低于TUNER_YIN_THRESHOLD的谷 抛物线插值到小数延迟 再换算成音名和音分
+// 界面按TUNER_UI_PERIOD_MS取结果 分析比界面刷得快 界面只看最新的一块
+// 每块的CPU周期 其中FFT和YIN各多少 占一个跳步时长的千分比都记下来
+// 麦克风的接口同时只给一个人 录音的时候打不开
+
+#define TUNER_RATE              16000
+#define TUNER_FFT_N             1024    // 64ms 最低音60Hz时也有将近4个周期
+#define TUNER_HOP               512     // 每32ms分析一次
+#define TUNER_BANDS             32      // 频谱的频段数 对数分布
+#define TUNER_BAND_LO_HZ        50
+#define TUNER_RANGE_DB          80      // 频谱和电平显示的动态范围
+#define TUNER_F0_MIN_HZ         60      // YIN找的范围 低音吉他的E1(41Hz)要把FFT_N再加大
+#define TUNER_F0_MAX_HZ         1600
+#define TUNER_YIN_THRESHOLD     0.15f
+#define TUNER_GATE_DB           (-60)   // 比这小的不找基音
+#define TUNER_A4_HZ             440.0f
+#define TUNER_UI_PERIOD_MS      50      // 界面最多每秒刷20次
+#define TUNER_PEAK_HOLD_MS      1000    // 峰值保持这么久再回落
+#define TUNER_STATS_PERIOD_S    10
+
+typedef struct {
+    uint32_t seq;                       // 第几块 界面看变没变
+    int8_t bands[TUNER_BANDS];          // 各频段 dBFS -TUNER_RANGE_DB~0
+    int16_t rms_cdb;                    // 电平 百分之一dBFS 满幅正弦是-301
+    int16_t peak_cdb;                   // 这一块的峰值
+    int16_t hold_cdb;                   // 峰值保持
+    bool voiced;                        // 找到了基音
+    float f0;                           // Hz
+    float clarity;                      // 1减去谷底的值 越接近1越像单音
+    int note;                           // MIDI音号 A4是69
+    int cents;                          // 离最近的音差多少音分 -50~49
+} tuner_result_t;
+
+typedef struct {
+    uint32_t blocks;
+    uint32_t overruns;                  // 分析跟不上 跳过的块
+    uint32_t cycles_avg;                // 每块 全部
+    uint32_t cycles_max;
+    uint32_t fft_cycles_avg;            // 其中加窗 FFT和频段
+    uint32_t yin_cycles_avg;            // 其中YIN
+    uint32_t load_permille;             // 占一个跳步时长的千分比
+} tuner_stats_t;
+
+esp_err_t audio_tuner_start(void);      // 接上麦克风开始分析 录音中或者送数任务没起来返回ESP_ERR_INVALID_STATE
+void audio_tuner_stop(void);            // 等这一块分析完
+bool audio_tuner_running(void);
+bool audio_tuner_get(tuner_result_t *out);  // 取最新结果 seq比上次新返回true
+void audio_tuner_get_stats(tuner_stats_t *stats);
+const char *audio_tuner_note_name(int note);    // 不带八度 "C#"这样的
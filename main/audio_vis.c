@@ -0,0 +1,213 @@
+#include <math.h>
+#include <string.h>
+#include "audio_vis.h"
+#include "task_plan.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "dsps_fft2r.h"
+
+static const char *TAG = "audio_vis";
+
+#define VIS_TAP_LEN         (AUDIO_VIS_FFT_N * 2)   // 抽取数据环形缓冲 2的幂
+#define VIS_STATS_PERIOD_S  10                      // 打印CPU占用的间隔
+
+static TaskHandle_t s_task = NULL;
+static volatile bool s_enabled = false;
+
+// 抽取数据 解码任务单写 分析任务只读最新的FFT_N个点 偶尔读到半帧对显示无影响
+static int16_t s_tap[VIS_TAP_LEN];
+static volatile uint32_t s_tap_pos = 0;
+static volatile uint32_t s_decim = 4;
+static volatile int s_channels = 2;
+static uint32_t s_decim_phase = 0;
+
+static float s_window[AUDIO_VIS_FFT_N];
+static float s_fft[AUDIO_VIS_FFT_N * 2];
+static uint16_t s_band_edge[AUDIO_VIS_BANDS + 1];  // 频段起始bin
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_vis_frame_t s_frame;
+static bool s_frame_new = false;
+static audio_vis_stats_t s_stats;
+static uint64_t s_cycles_sum = 0;
+
+void audio_vis_set_format(uint32_t rate, int channels)
+{
+    uint32_t d = rate / AUDIO_VIS_TAP_RATE;
+    s_decim = d ? d : 1;
+    s_channels = channels;
+}
+
+void audio_vis_tap(const int16_t *pcm, size_t frames)
+{
+    if (!s_enabled)
+    {
+        return;
+    }
+    const int ch = s_channels;
+    const uint32_t decim = s_decim;
+    uint32_t pos = s_tap_pos;
+    size_t i = s_decim_phase;
+    for (; i < frames; i += decim)
+    {
+        int32_t v = pcm[i * ch];
+        if (ch == 2)
+        {
+            v = (v + pcm[i * 2 + 1]) >> 1;
+        }
+        s_tap[pos & (VIS_TAP_LEN - 1)] = (int16_t)v;
+        pos++;
+    }
+    s_decim_phase = i - frames;
+    s_tap_pos = pos;
+}
+
+static uint8_t db_to_level(float power)
+{
+    // power是归一化到满幅正弦为1的能量
+    float db = 10.0f * log10f(power + 1e-12f);
+    float v = (db + AUDIO_VIS_RANGE_DB) * (100.0f / AUDIO_VIS_RANGE_DB);
+    return v <= 0.0f ? 0 : (v >= 100.0f ? 100 : (uint8_t)v);
+}
+
+// 一次分析 加窗->FFT->按频段求能量 结果做快升慢降
+static void vis_analyze(audio_vis_frame_t *out)
+{
+    uint32_t end = s_tap_pos;
+    float sum_sq = 0.0f;
+    for (int i = 0; i < AUDIO_VIS_FFT_N; i++)
+    {
+        float x = s_tap[(end - AUDIO_VIS_FFT_N + i) & (VIS_TAP_LEN - 1)] * (1.0f / 32768.0f);
+        sum_sq += x * x;
+        s_fft[2 * i] = x * s_window[i];
+        s_fft[2 * i + 1] = 0.0f;
+    }
+    dsps_fft2r_fc32(s_fft, AUDIO_VIS_FFT_N);
+    dsps_bit_rev_fc32(s_fft, AUDIO_VIS_FFT_N);
+
+    // 汉宁窗增益0.5 满幅正弦的单边谱峰值约为N/4
+    const float norm = 16.0f / ((float)AUDIO_VIS_FFT_N * AUDIO_VIS_FFT_N);
+    for (int b = 0; b < AUDIO_VIS_BANDS; b++)
+    {
+        float p = 0.0f;
+        for (int k = s_band_edge[b]; k < s_band_edge[b + 1]; k++)
+        {
+            float re = s_fft[2 * k], im = s_fft[2 * k + 1];
+            float m = re * re + im * im;
+            p = m > p ? m : p;
+        }
+        uint8_t v = db_to_level(p * norm);
+        out->bands[b] = v >= out->bands[b] ? v : (out->bands[b] > 4 ? out->bands[b] - 4 : 0);
+    }
+
+    // 正弦RMS为1/sqrt(2) 乘2后满幅为0dB
+    out->level = db_to_level(2.0f * sum_sq / AUDIO_VIS_FFT_N);
+    out->peak = out->level >= out->peak ? out->level : (out->peak > 1 ? out->peak - 1 : 0);
+}
+
+static void audio_vis_task(void *arg)
+{
+    audio_vis_frame_t frame = {0};
+    const uint32_t budget = AUDIO_VIS_PERIOD_MS * 1000 * esp_rom_get_cpu_ticks_per_us();
+    TickType_t last_wake = xTaskGetTickCount();
+    uint32_t last_report = 0;
+
+    while (1)
+    {
+        if (!s_enabled)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            last_wake = xTaskGetTickCount();
+            memset(&frame, 0, sizeof(frame));
+            continue;
+        }
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(AUDIO_VIS_PERIOD_MS));
+
+        uint32_t start = esp_cpu_get_cycle_count();
+        vis_analyze(&frame);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+        portENTER_CRITICAL(&s_lock);
+        s_frame = frame;
+        s_frame_new = true;
+        portEXIT_CRITICAL(&s_lock);
+
+        s_stats.frames++;
+        s_cycles_sum += cycles;
+        s_stats.cycles_avg = (uint32_t)(s_cycles_sum / s_stats.frames);
+        if (cycles > s_stats.cycles_max)
+        {
+            s_stats.cycles_max = cycles;
+        }
+        s_stats.load_permille = (uint32_t)((uint64_t)s_stats.cycles_avg * 1000 / budget);
+
+        if (s_stats.frames - last_report >= VIS_STATS_PERIOD_S * 1000 / AUDIO_VIS_PERIOD_MS)
+        {
+            last_report = s_stats.frames;
+            ESP_LOGI(TAG, "fft %d: avg %lu cycles, max %lu, load %lu.%lu%%", AUDIO_VIS_FFT_N,
+                     (unsigned long)s_stats.cycles_avg, (unsigned long)s_stats.cycles_max,
+                     (unsigned long)(s_stats.load_permille / 10), (unsigned long)(s_stats.load_permille % 10));
+        }
+    }
+}
+
+esp_err_t audio_vis_start(void)
+{
+    if (s_task)
+    {
+        return ESP_OK;
+    }
+    esp_err_t ret = dsps_fft2r_init_fc32(NULL, AUDIO_FFT_TABLE_N);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "fft init failed: %d", ret);
+        return ret;
+    }
+
+    for (int i = 0; i < AUDIO_VIS_FFT_N; i++)
+    {
+        s_window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / (AUDIO_VIS_FFT_N - 1));
+    }
+    // 频段按对数分布在bin 1 ~ N/2 每段至少一个bin
+    const int bins = AUDIO_VIS_FFT_N / 2;
+    s_band_edge[0] = 1;
+    for (int b = 1; b <= AUDIO_VIS_BANDS; b++)
+    {
+        int e = (int)lroundf(powf((float)bins, (float)b / AUDIO_VIS_BANDS));
+        if (e <= s_band_edge[b - 1])
+        {
+            e = s_band_edge[b - 1] + 1;
+        }
+        s_band_edge[b] = e > bins ? bins : e;
+    }
+
+    BaseType_t ok = task_plan_create(TASK_AUDIO_VIS, audio_vis_task, NULL, &s_task);
+    return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void audio_vis_set_enabled(bool enabled)
+{
+    s_enabled = enabled;
+    if (enabled && s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+bool audio_vis_get(audio_vis_frame_t *frame)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool fresh = s_frame_new;
+    *frame = s_frame;
+    s_frame_new = false;
+    portEXIT_CRITICAL(&s_lock);
+    return fresh;
+}
+
+void audio_vis_get_stats(audio_vis_stats_t *stats)
+{
+    *stats = s_stats;
+}
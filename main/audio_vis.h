@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 频谱/电平显示 ****************************/
+// 解码任务在PCM路径上抽取一路降采样的单声道数据(只做拷贝)
+// 分析任务运行在不做解码的核上 每个LVGL刷新周期做一次FFT 得到频段能量和电平
+
+#define AUDIO_VIS_FFT_N         256                             // FFT点数
+#define AUDIO_VIS_BANDS         16                              // 显示的频段数 对数分布
+#define AUDIO_VIS_TAP_RATE      11025                           // 抽取后的采样率 约等于 只看5kHz以下
+#define AUDIO_VIS_PERIOD_MS     CONFIG_LV_DISP_DEF_REFR_PERIOD  // 分析和刷新周期 不快于LVGL刷新
+#define AUDIO_VIS_RANGE_DB      60.0f                           // 显示的动态范围
+#define AUDIO_FFT_TABLE_N       1024                            // esp-dsp的FFT旋转因子表全程序一张 第一次初始化定下大小 按用到的最大点数建
+
+typedef struct {
+    uint8_t bands[AUDIO_VIS_BANDS];     // 各频段 0~100
+    uint8_t level;                      // 整体电平 0~100
+    uint8_t peak;                       // 峰值电平 缓慢回落
+} audio_vis_frame_t;
+
+typedef struct {
+    uint32_t frames;                    // 已完成的分析次数
+    uint32_t cycles_avg;                // 每次分析的平均CPU周期
+    uint32_t cycles_max;
+    uint32_t load_permille;             // 占所在核的CPU千分比 按分析周期计算
+} audio_vis_stats_t;
+
+esp_err_t audio_vis_start(void);                        // 初始化FFT表并创建分析任务 可重复调用
+void audio_vis_set_enabled(bool enabled);               // 界面显示时打开 关闭后分析任务不占CPU
+void audio_vis_set_format(uint32_t rate, int channels); // 输出格式变化时由PCM层调用
+void audio_vis_tap(const int16_t *pcm, size_t frames);  // 在解码任务中调用 16位PCM
+bool audio_vis_get(audio_vis_frame_t *frame);           // 取最新结果 有更新返回true
+void audio_vis_get_stats(audio_vis_stats_t *stats);
@@ -0,0 +1,507 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bench_suite.h"
+#include "task_plan.h"
+#include "lcd_bench.h"
+#include "sd_writer.h"
+#include "i2c_bus.h"
+#include "ui_perf.h"
+#include "pm_ctl.h"
+#include "idle_mgr.h"
+#include "app_res.h"
+#include "app_mod.h"
+#include "esp32_s3_szp.h"
+#include "audio_player.h"
+#include "ff.h"
+#include "esp_app_desc.h"
+#include "esp_chip_info.h"
+#include "esp_flash.h"
+#include "esp_mac.h"
+#include "esp_psram.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "bench_suite";
+
+// main/CMakeLists.txt在配置时算好 menuconfig改了会重新配置
+#ifndef BENCH_SDKCONFIG_SHA256
+#define BENCH_SDKCONFIG_SHA256  ""
+#endif
+
+#define BENCH_TMP_FILE          BENCH_DIR "/.suite.tmp"
+#define BENCH_CHUNK             (32 * 1024)
+#define BENCH_REPORT_LEN        4096
+
+static bench_result_t s_results[BENCH_MAX_RESULTS];
+static int s_count;
+static bench_suite_cb_t s_cb;
+static void *s_cb_arg;
+static volatile bool s_running;
+static volatile bool s_cancel;
+static bench_suite_stats_t s_stats;
+
+static void add(const char *name, float value, const char *unit, bool higher_better, esp_err_t err)
+{
+    if (s_count >= BENCH_MAX_RESULTS)
+    {
+        return;
+    }
+    bench_result_t *r = &s_results[s_count++];
+    r->name = name;
+    r->unit = unit;
+    r->value = err == ESP_OK ? value : 0;
+    r->higher_better = higher_better;
+    r->err = err;
+    ESP_LOGI(TAG, "%-20s %10.2f %s%s", name, r->value, unit, err == ESP_OK ? "" : "  (skipped)");
+    if (s_cb)
+    {
+        s_cb(r, s_cb_arg);
+    }
+}
+
+static float mb_per_s(uint64_t bytes, int64_t us)
+{
+    return us > 0 ? bytes / (float)us : 0;     // 字节每微秒就是MB/s
+}
+
+/******************************** SD卡 ********************************/
+// 写走sd_writer 和拍照录像一样 从打开算到关闭写完 读直接用FATFS 不经过stdio的缓冲
+static void test_sd(uint8_t *buf)
+{
+    const uint32_t total = BENCH_SD_MB * 1024 * 1024;
+    if (!bsp_sdcard_mounted())
+    {
+        add("sd_write", 0, "MB/s", true, ESP_ERR_INVALID_STATE);
+        add("sd_read", 0, "MB/s", true, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    for (int i = 0; i < BENCH_CHUNK; i++)
+    {
+        buf[i] = i * 7;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_FAIL;
+    sd_writer_t *w = sd_writer_open(BENCH_TMP_FILE, total);
+    if (w)
+    {
+        err = ESP_OK;
+        for (uint32_t n = 0; n < total && err == ESP_OK; n += BENCH_CHUNK)
+        {
+            err = sd_writer_write(w, buf, BENCH_CHUNK);
+        }
+        if (err == ESP_OK)
+        {
+            err = sd_writer_close(w);
+        }
+        else
+        {
+            sd_writer_abort(w);
+        }
+    }
+    add("sd_write", mb_per_s(total, esp_timer_get_time() - t0), "MB/s", true, err);
+    if (err != ESP_OK)
+    {
+        add("sd_read", 0, "MB/s", true, err);
+        return;
+    }
+
+    static FIL fil;
+    char fpath[64];
+    err = ESP_FAIL;
+    uint32_t got = 0;
+    t0 = esp_timer_get_time();
+    if (bsp_sdcard_fatfs_path(BENCH_TMP_FILE, fpath, sizeof(fpath)) && f_open(&fil, fpath, FA_READ) == FR_OK)
+    {
+        UINT br;
+        while (f_read(&fil, buf, BENCH_CHUNK, &br) == FR_OK && br > 0)
+        {
+            got += br;
+        }
+        f_close(&fil);
+        err = got == total ? ESP_OK : ESP_FAIL;
+    }
+    add("sd_read", mb_per_s(got, esp_timer_get_time() - t0), "MB/s", true, err);
+    unlink(BENCH_TMP_FILE);
+}
+
+/******************************** 屏幕 ********************************/
+// 整屏纯色直接发给屏 不经过LVGL 测的是SPI链路本身 每次单独拿锁 不让界面的持锁告警报出来
+static void test_lcd_fill(uint8_t *buf)
+{
+    int64_t us = 0;
+    for (int i = 0; i < BENCH_LCD_FILLS; i++)
+    {
+        if (!ui_lock(1000))
+        {
+            add("lcd_fill", 0, "fps", true, ESP_ERR_TIMEOUT);
+            return;
+        }
+        int64_t t0 = esp_timer_get_time();
+        lcd_set_color((i & 1) ? 0xffff : 0x0000);
+        us += esp_timer_get_time() - t0;
+        ui_unlock();
+    }
+    if (ui_lock(1000))
+    {
+        lv_obj_invalidate(lv_scr_act());   // 界面下一帧整屏重画盖掉
+        ui_unlock();
+    }
+    const uint64_t bytes = (uint64_t)BENCH_LCD_FILLS * BSP_LCD_H_RES * BSP_LCD_V_RES * 2;
+    add("lcd_fill", us > 0 ? BENCH_LCD_FILLS * 1e6f / us : 0, "fps", true, ESP_OK);
+    add("lcd_fill_bw", mb_per_s(bytes, us), "MB/s", true, ESP_OK);
+}
+
+// 场景用lcd_bench的 缓冲高度和渲染模式不动 报告里记着 链路吞吐按刷屏统计里SPI忙的时间算
+static void test_lvgl(uint8_t *buf)
+{
+    static const char *const names[LCD_BENCH_SCENES] = { "lvgl_fill", "lvgl_widgets", "lvgl_label" };
+    const bsp_disp_render_mode_t mode = bsp_display_get_render_mode();
+    bsp_disp_flush_stats_t a, b;
+    float fps[LCD_BENCH_SCENES];
+
+    bsp_display_get_flush_stats(mode, &a);
+    esp_err_t err = lcd_bench_scenes(NULL, fps);
+    bsp_display_get_flush_stats(mode, &b);
+    for (int i = 0; i < LCD_BENCH_SCENES; i++)
+    {
+        add(names[i], fps[i], "fps", true, err);
+    }
+    add("lcd_flush_bw", mb_per_s(b.bytes - a.bytes, b.busy_us - a.busy_us), "MB/s", true, err);
+}
+
+/******************************** 解码 ********************************/
+static void test_decode(const char *path, const char *rt_name, const char *p99_name)
+{
+    audio_player_bench_result_t r = {0};
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    FILE *fp = fopen(path, "rb");
+    if (fp)
+    {
+        err = audio_player_benchmark(fp, &r);   // 会关闭fp
+    }
+    add(rt_name, r.realtime, "x", true, err);
+    add(p99_name, r.p99_us, "us", false, err);
+}
+
+static void test_mp3(uint8_t *buf)
+{
+    test_decode(BENCH_REF_MP3, "mp3_decode_rt", "mp3_frame_p99");
+}
+
+static void test_flac(uint8_t *buf)
+{
+    test_decode(BENCH_REF_FLAC, "flac_decode_rt", "flac_frame_p99");
+}
+
+/******************************** 摄像头 ********************************/
+// 和扫码一样先借摄像头 开着别的模式就切到RGB565 还的时候app_res过一会再关
+static void test_camera(uint8_t *buf)
+{
+#if CONFIG_APP_MOD_CAMERA
+    app_camera_res_mode(BSP_CAMERA_RGB565);
+    esp_err_t err = app_res_acquire(APP_RES_BIT(APP_RES_CAMERA));
+    if (err == ESP_OK && bsp_camera_get_mode() != BSP_CAMERA_RGB565)
+    {
+        esp_camera_deinit();
+        err = bsp_camera_init_mode(BSP_CAMERA_RGB565);
+    }
+    int frames = 0;
+    int64_t t0 = 0;
+    for (int i = 0; err == ESP_OK && i < BENCH_CAM_FRAMES + 5; i++)
+    {
+        if (i == 5)
+        {
+            t0 = esp_timer_get_time();
+        }
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (fb == NULL)
+        {
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        esp_camera_fb_return(fb);
+        frames += i >= 5;
+    }
+    int64_t us = esp_timer_get_time() - t0;
+    app_res_release(APP_RES_BIT(APP_RES_CAMERA));
+    add("camera_fps", us > 0 ? frames * 1e6f / us : 0, "fps", true, err);
+#else
+    add("camera_fps", 0, "fps", true, ESP_ERR_NOT_SUPPORTED);
+#endif
+}
+
+/******************************** I2C ********************************/
+// 读IMU的WHO_AM_I 一个寄存器一个字节 从排队到拿到结果 和别的设备的传输一样走i2c_bus的调度
+static void test_i2c(uint8_t *buf)
+{
+    const uint8_t reg = QMI8658_WHO_AM_I;
+    uint8_t id;
+    int64_t total = 0, max = 0;
+    esp_err_t err = ESP_OK;
+    for (int i = 0; i < BENCH_I2C_XFERS && err == ESP_OK; i++)
+    {
+        int64_t t0 = esp_timer_get_time();
+        err = i2c_bus_write_read(I2C_BUS_IMU, &reg, 1, &id, 1);
+        int64_t us = esp_timer_get_time() - t0;
+        total += us;
+        max = us > max ? us : max;
+    }
+    add("i2c_xfer_avg", (float)total / BENCH_I2C_XFERS, "us", false, err);
+    add("i2c_xfer_max", max, "us", false, err);
+}
+
+/******************************** PSRAM ********************************/
+static int64_t copy_time(uint8_t *dst, size_t dst_step, const uint8_t *src, size_t src_step)
+{
+    int64_t t0 = esp_timer_get_time();
+    for (int rep = 0; rep < 4; rep++)
+    {
+        for (size_t off = 0; off < BENCH_MEMCPY_KB * 1024; off += BENCH_CHUNK)
+        {
+            memcpy(dst + (off & dst_step), src + (off & src_step), BENCH_CHUNK);
+        }
+    }
+    return esp_timer_get_time() - t0;
+}
+
+// 内部RAM那块的步长掩码是0 每次都拷到同一个地方
+static void test_psram(uint8_t *internal)
+{
+    const size_t len = BENCH_MEMCPY_KB * 1024;
+    const uint64_t bytes = 4ull * len;
+    uint8_t *a = heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+    uint8_t *b = heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+    esp_err_t err = a && b ? ESP_OK : ESP_ERR_NO_MEM;
+    int64_t pp = 0, ip = 0, pi = 0;
+    if (err == ESP_OK)
+    {
+        memset(a, 0x5a, len);
+        pp = copy_time(b, SIZE_MAX, a, SIZE_MAX);
+        ip = copy_time(a, SIZE_MAX, internal, 0);
+        pi = copy_time(internal, 0, b, SIZE_MAX);
+    }
+    heap_caps_free(a);
+    heap_caps_free(b);
+    add("psram_to_psram", mb_per_s(bytes, pp), "MB/s", true, err);
+    add("sram_to_psram", mb_per_s(bytes, ip), "MB/s", true, err);
+    add("psram_to_sram", mb_per_s(bytes, pi), "MB/s", true, err);
+}
+
+/******************************** 报告 ********************************/
+static int json_str(char *out, size_t len, const char *key, const char *val)
+{
+    // 版本号 项目名这些都是编译时的常量 不会有引号和反斜杠
+    return snprintf(out, len, "\"%s\": \"%s\"", key, val);
+}
+
+static size_t report_build(char *out, size_t len, uint32_t ms)
+{
+    const esp_app_desc_t *app = esp_app_get_description();
+    char elf[65], mac_s[18], when[24] = "";
+    uint8_t mac[6];
+    esp_chip_info_t chip;
+    uint32_t flash = 0;
+    int width, khz;
+    esp_app_get_elf_sha256(elf, sizeof(elf));
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(mac_s, sizeof(mac_s), "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    esp_chip_info(&chip);
+    esp_flash_get_size(NULL, &flash);
+    bsp_sdcard_get_bus(&width, &khz);
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    if (tm.tm_year >= 2020 - 1900)
+    {
+        strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &tm);
+    }
+
+    size_t n = 0;
+#define OUT(...) n += snprintf(out + n, n < len ? len - n : 0, __VA_ARGS__)
+#define STR(k, v) n += json_str(out + n, n < len ? len - n : 0, k, v)
+    OUT("{\n  \"format\": %d,\n  ", BENCH_SUITE_VERSION);
+    STR("time", when);
+    OUT(",\n  \"uptime_s\": %lld,\n  \"duration_ms\": %lu,\n", esp_timer_get_time() / 1000000, (unsigned long)ms);
+    OUT("  \"firmware\": {");
+    STR("project", app->project_name);
+    OUT(", ");
+    STR("version", app->version);
+    OUT(", ");
+    STR("idf", app->idf_ver);
+    OUT(", \"built\": \"%s %s\", ", app->date, app->time);
+    STR("elf_sha256", elf);
+    OUT(", ");
+    STR("sdkconfig_sha256", BENCH_SDKCONFIG_SHA256);
+    OUT("},\n  \"device\": {");
+    STR("mac", mac_s);
+    OUT(", \"chip_rev\": %u, \"cores\": %u, \"cpu_mhz\": %d, \"flash_kb\": %lu, \"psram_kb\": %u, ",
+        chip.revision, chip.cores, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, (unsigned long)(flash / 1024),
+        (unsigned)(esp_psram_get_size() / 1024));
+    OUT("\"sd_bus_width\": %d, \"sd_khz\": %d, \"lcd_buf_lines\": %d, \"lcd_mode\": %d},\n", width, khz,
+        bsp_display_get_draw_buf_height(), (int)bsp_display_get_render_mode());
+    OUT("  \"results\": [");
+    for (int i = 0; i < s_count; i++)
+    {
+        const bench_result_t *r = &s_results[i];
+        OUT("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"higher_better\": %s, ", i ? "," : "", r->name, r->unit,
+            r->higher_better ? "true" : "false");
+        if (r->err == ESP_OK)
+        {
+            OUT("\"value\": %.3f}", r->value);
+        }
+        else
+        {
+            OUT("\"value\": null, \"skipped\": \"%s\"}", esp_err_to_name(r->err));
+        }
+    }
+    OUT("\n  ]\n}\n");
+#undef OUT
+#undef STR
+    return n;
+}
+
+static esp_err_t report_save(uint32_t ms)
+{
+    ESP_RETURN_ON_FALSE(bsp_sdcard_mounted(), ESP_ERR_INVALID_STATE, TAG, "no sd card");
+    char *buf = heap_caps_malloc(BENCH_REPORT_LEN, MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(buf, ESP_ERR_NO_MEM, TAG, "no memory for report");
+    size_t n = report_build(buf, BENCH_REPORT_LEN, ms);
+    if (n >= BENCH_REPORT_LEN)
+    {
+        heap_caps_free(buf);
+        ESP_LOGE(TAG, "report needs %u bytes", (unsigned)n);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    char path[48];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    snprintf(path, sizeof(path), "%s/report_%02d%02d_%02d%02d%02d.json", BENCH_DIR, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    esp_err_t err = ESP_FAIL;
+    sd_writer_t *w = sd_writer_open(path, n);
+    if (w)
+    {
+        err = sd_writer_write(w, buf, n);
+        if (err == ESP_OK)
+        {
+            err = sd_writer_close(w);
+        }
+        else
+        {
+            sd_writer_abort(w);
+        }
+    }
+    heap_caps_free(buf);
+    ESP_RETURN_ON_ERROR(err, TAG, "write %s failed", path);
+    strlcpy(s_stats.last_report, path, sizeof(s_stats.last_report));
+    ESP_LOGI(TAG, "saved %s", path);
+    return ESP_OK;
+}
+
+/******************************** 任务 ********************************/
+// 顺序固定 改了要加BENCH_SUITE_VERSION SD卡放最后 前面读参考文件时卡上没有刚写完的大文件在刷
+// buf是32KB的DMA内存 SD卡读写和内部RAM那边的拷贝共用
+static void (*const s_tests[])(uint8_t *buf) = {
+    test_psram, test_i2c, test_lcd_fill, test_lvgl, test_mp3, test_flac, test_camera, test_sd,
+};
+
+static void bench_suite_task(void *arg)
+{
+    // 跑的时候频率锁在最高 不调暗不熄屏 结果才稳定
+    pm_ctl_set(PM_CLIENT_CAMERA, true);
+    idle_mgr_inhibit(true);
+    int64_t t0 = esp_timer_get_time();
+    uint8_t *buf = heap_caps_malloc(BENCH_CHUNK, MALLOC_CAP_DMA);
+    if (buf == NULL)
+    {
+        ESP_LOGE(TAG, "no memory for buffer");
+        s_cancel = true;
+    }
+    else if (bsp_sdcard_mounted() && mkdir(BENCH_DIR, 0775) != 0)
+    {
+        struct stat st;
+        if (stat(BENCH_DIR, &st) != 0)
+        {
+            ESP_LOGW(TAG, "mkdir %s failed", BENCH_DIR);
+        }
+    }
+
+    for (int i = 0; !s_cancel && i < sizeof(s_tests) / sizeof(s_tests[0]); i++)
+    {
+        s_tests[i](buf);
+        vTaskDelay(pdMS_TO_TICKS(50));  // 界面把结果画出来
+    }
+    heap_caps_free(buf);
+    uint32_t ms = (esp_timer_get_time() - t0) / 1000;
+    idle_mgr_inhibit(false);
+    pm_ctl_set(PM_CLIENT_CAMERA, false);
+
+    s_stats.runs++;
+    s_stats.last_ms = ms;
+    s_stats.last_results = s_count;
+    s_stats.last_skipped = 0;
+    for (int i = 0; i < s_count; i++)
+    {
+        s_stats.last_skipped += s_results[i].err != ESP_OK;
+    }
+    s_stats.last_report[0] = '\0';
+    if (s_cancel)
+    {
+        s_stats.cancelled++;
+        ESP_LOGW(TAG, "cancelled after %d results", s_count);
+    }
+    else
+    {
+        report_save(ms);
+    }
+    if (s_cb)
+    {
+        s_cb(NULL, s_cb_arg);
+    }
+    s_running = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t bench_suite_start(bench_suite_cb_t cb, void *arg)
+{
+    ESP_RETURN_ON_FALSE(!s_running, ESP_ERR_INVALID_STATE, TAG, "already running");
+    s_running = true;
+    s_cancel = false;
+    s_count = 0;
+    s_cb = cb;
+    s_cb_arg = arg;
+    ESP_LOGI(TAG, "suite v%d, firmware %s, sdkconfig %.16s", BENCH_SUITE_VERSION, esp_app_get_description()->version,
+             BENCH_SDKCONFIG_SHA256);
+    if (task_plan_create(TASK_BENCH_SUITE, bench_suite_task, NULL, NULL) != pdPASS)
+    {
+        s_running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void bench_suite_cancel(void)
+{
+    s_cancel = true;
+}
+
+bool bench_suite_running(void)
+{
+    return s_running;
+}
+
+void bench_suite_get_stats(bench_suite_stats_t *stats)
+{
+    *stats = s_stats;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+
+/*********************** 整机基准套件 ****************************/
+// 基准测试应用里点开始 按固定顺序跑一遍:
+//   SD卡顺序写读 LCD整屏填充 LVGL标准场景和刷屏吞吐 MP3/FLAC解码 摄像头帧率 I2C一笔传输的延迟 PSRAM拷贝带宽
+// 跑的时候锁住最高频率 不进空闲 结果写成卡上/bench/report_MMDD_HHMMSS.json
+// 报告带固件版本 ELF和sdkconfig的哈希 同一份配置的报告才能直接比 tools/bench_compare比较两份报告找退步
+// 解码只测固定的参考文件/bench/ref.mp3和ref.flac 换了文件结果没法比 所以报告里带文件大小 没有就记跳过
+// 测项和单位改了要加BENCH_SUITE_VERSION 比较工具只比版本相同的
+
+#define BENCH_SUITE_VERSION     1
+#define BENCH_DIR               "/sdcard/bench"
+#define BENCH_REF_MP3           BENCH_DIR "/ref.mp3"
+#define BENCH_REF_FLAC          BENCH_DIR "/ref.flac"
+#define BENCH_MAX_RESULTS       24
+#define BENCH_SD_MB             8       // 顺序写读的临时文件
+#define BENCH_LCD_FILLS         20
+#define BENCH_CAM_FRAMES        30      // 先丢几帧等曝光稳定
+#define BENCH_I2C_XFERS         200
+#define BENCH_MEMCPY_KB         256     // PSRAM这边的大小 远大于32KB的cache 内部RAM那边32KB一块轮着用
+
+typedef struct {
+    const char *name;                   // 字符串常量 报告里的键
+    const char *unit;
+    float value;
+    bool higher_better;                 // 比较工具按它判断退步的方向
+    esp_err_t err;                      // 不是ESP_OK时value没意义 报告里记成跳过
+} bench_result_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t cancelled;
+    uint32_t last_ms;
+    uint32_t last_results;
+    uint32_t last_skipped;
+    char last_report[48];               // 空的是没存上
+} bench_suite_stats_t;
+
+// 每出一个结果在跑测试的任务里调一次 r在下一次开始之前一直有效
+typedef void (*bench_suite_cb_t)(const bench_result_t *r, void *arg);
+
+// 在后台任务里跑 已经在跑返回ESP_ERR_INVALID_STATE done在全部跑完或者取消后调一次 r为NULL
+esp_err_t bench_suite_start(bench_suite_cb_t cb, void *arg);
+void bench_suite_cancel(void);          // 当前这一项跑完就停 不写报告
+bool bench_suite_running(void);
+void bench_suite_get_stats(bench_suite_stats_t *stats);
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include "boot.h"
+#include "task_plan.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+static const char *TAG = "boot";
+
+static const char *const s_stage_name[BOOT_STAGE_MAX] = {
+    "i2c", "lvgl", "spiffs", "sdcard", "codec", "ui",
+};
+
+static StaticEventGroup_t s_events_buf;
+static EventGroupHandle_t s_events = NULL;
+static int64_t s_begin_us[BOOT_STAGE_MAX];
+static int64_t s_done_us[BOOT_STAGE_MAX];
+static esp_err_t s_result[BOOT_STAGE_MAX];
+
+typedef struct {
+    boot_stage_t stage;
+    EventBits_t deps;
+    boot_stage_fn_t fn;
+} boot_job_t;
+
+static boot_job_t s_jobs[BOOT_STAGE_MAX];   // 任务参数 每个阶段一份
+
+void boot_init(void)
+{
+    if (s_events)
+    {
+        return;
+    }
+    for (int i = 0; i < BOOT_STAGE_MAX; i++)
+    {
+        s_result[i] = ESP_ERR_INVALID_STATE;
+    }
+    s_events = xEventGroupCreateStatic(&s_events_buf);
+}
+
+void boot_stage_begin(boot_stage_t stage)
+{
+    s_begin_us[stage] = esp_timer_get_time();
+}
+
+// 全部阶段完成后打印每个阶段的耗时和完成时刻 时刻从上电开始计算
+static void boot_log_summary(void)
+{
+    for (int i = 0; i < BOOT_STAGE_MAX; i++)
+    {
+        ESP_LOGI(TAG, "%-7s %s %5lld ms, ready at %5lld ms", s_stage_name[i],
+                 s_result[i] == ESP_OK ? "ok  " : "FAIL",
+                 (s_done_us[i] - s_begin_us[i]) / 1000, s_done_us[i] / 1000);
+    }
+}
+
+void boot_stage_done(boot_stage_t stage, esp_err_t result)
+{
+    s_done_us[stage] = esp_timer_get_time();
+    if (s_begin_us[stage] == 0)
+    {
+        s_begin_us[stage] = s_done_us[stage]; // 没有调用begin 只记完成时刻
+    }
+    s_result[stage] = result;
+    ESP_LOGI(TAG, "%s %s in %lld ms (%lld ms since power on)", s_stage_name[stage],
+             result == ESP_OK ? "ready" : esp_err_to_name(result),
+             (s_done_us[stage] - s_begin_us[stage]) / 1000, s_done_us[stage] / 1000);
+
+    EventBits_t bits = xEventGroupSetBits(s_events, BOOT_BIT(stage));
+    if ((bits & (BOOT_BIT(BOOT_STAGE_MAX) - 1)) == (BOOT_BIT(BOOT_STAGE_MAX) - 1))
+    {
+        boot_log_summary();
+    }
+}
+
+bool boot_wait(EventBits_t bits, uint32_t timeout_ms)
+{
+    TickType_t ticks = (timeout_ms == BOOT_WAIT_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    EventBits_t got = xEventGroupWaitBits(s_events, bits, pdFALSE, pdTRUE, ticks);
+    return (got & bits) == bits;
+}
+
+bool boot_ready(boot_stage_t stage)
+{
+    return (xEventGroupGetBits(s_events) & BOOT_BIT(stage)) && s_result[stage] == ESP_OK;
+}
+
+esp_err_t boot_stage_result(boot_stage_t stage)
+{
+    return s_result[stage];
+}
+
+static void boot_stage_task(void *arg)
+{
+    const boot_job_t *job = arg;
+
+    boot_wait(job->deps, BOOT_WAIT_FOREVER);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    bool deps_ok = true;
+    for (int i = 0; i < BOOT_STAGE_MAX; i++)
+    {
+        if ((job->deps & BOOT_BIT(i)) && s_result[i] != ESP_OK)
+        {
+            ESP_LOGW(TAG, "%s skipped, %s failed", s_stage_name[job->stage], s_stage_name[i]);
+            deps_ok = false;
+        }
+    }
+
+    boot_stage_begin(job->stage);
+    if (deps_ok)
+    {
+        ret = job->fn();
+    }
+    boot_stage_done(job->stage, ret);
+    vTaskDelete(NULL);
+}
+
+esp_err_t boot_stage_spawn(boot_stage_t stage, EventBits_t deps, boot_stage_fn_t fn, BaseType_t core)
+{
+    boot_job_t *job = &s_jobs[stage];
+    job->stage = stage;
+    job->deps = deps;
+    job->fn = fn;
+
+    char name[configMAX_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "boot_%s", s_stage_name[stage]);
+    const task_plan_t *plan = task_plan_get(TASK_BOOT_STAGE);
+    BaseType_t ok = xTaskCreatePinnedToCore(boot_stage_task, name, plan->stack, job, plan->prio, NULL, core);
+    if (ok != pdPASS)
+    {
+        boot_stage_done(stage, ESP_ERR_NO_MEM); // 等待者不会因此卡死
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
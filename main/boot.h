@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+
+/*********************** 开机流程编排 ****************************/
+// 每个初始化阶段完成后置位自己的就绪位 依赖它的模块只等自己需要的位
+// 主界面不再等开机音乐播完 各阶段的开始/完成时间记录下来 全部完成时打印汇总
+// 互不依赖的阶段(SD卡 SPIFFS 音频芯片)各在自己的任务里同时进行
+
+typedef enum {
+    BOOT_STAGE_I2C = 0,     // I2C总线与IO扩展芯片
+    BOOT_STAGE_LVGL,        // 液晶屏与LVGL
+    BOOT_STAGE_SPIFFS,      // SPIFFS文件系统
+    BOOT_STAGE_SD,          // SD卡挂载
+    BOOT_STAGE_CODEC,       // 音频芯片与I2S
+    BOOT_STAGE_UI,          // 主界面建立完成 可以操作
+    BOOT_STAGE_MAX
+} boot_stage_t;
+
+#define BOOT_BIT(stage)         ((EventBits_t)1 << (stage))
+#define BOOT_WAIT_FOREVER       UINT32_MAX
+#define BOOT_SD_WAIT_MS         3000    // 应用等待SD卡挂载的最长时间
+
+typedef esp_err_t (*boot_stage_fn_t)(void);
+
+void boot_init(void);                                       // app_main最开始调用 创建就绪事件组
+void boot_stage_begin(boot_stage_t stage);                  // 记录阶段开始时间
+void boot_stage_done(boot_stage_t stage, esp_err_t result); // 失败也算完成 等待者用boot_ready判断结果
+bool boot_wait(EventBits_t bits, uint32_t timeout_ms);      // 等待一组阶段全部完成 超时返回false
+bool boot_ready(boot_stage_t stage);                        // 阶段已完成并且成功 不阻塞
+esp_err_t boot_stage_result(boot_stage_t stage);            // 阶段结果 未完成返回ESP_ERR_INVALID_STATE
+// 在单独的任务里执行一个阶段 先等deps中的阶段完成 依赖失败时不执行 直接记为ESP_ERR_INVALID_STATE
+esp_err_t boot_stage_spawn(boot_stage_t stage, EventBits_t deps, boot_stage_fn_t fn, BaseType_t core);
@@ -0,0 +1,425 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "boot_anim.h"
+#include "mem_pool.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "src/extra/libs/gif/gifdec.h"
+
+static const char *TAG = "boot_anim";
+
+#define ANIM_FILE_MAX       (4 * 1024 * 1024)
+#define ANIM_MIN_DELAY_MS   10
+#define ANIM_RUN_MIN        3           // 至少这么多个相同的颜色才编成重复
+#define ANIM_TOKEN_MAX      0x7fff
+#define ANIM_TOKEN_RUN      0x8000
+#define ANIM_ALIGN_UP(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+static struct {
+    const uint8_t *map;
+    esp_partition_mmap_handle_t map_handle;
+    const boot_anim_hdr_t *hdr;
+    const boot_anim_frame_t *frames;
+    lv_obj_t *img;
+    lv_img_dsc_t dsc;
+    uint16_t *fb;
+    lv_timer_t *timer;
+    uint16_t index;
+    uint32_t last_show;
+    uint32_t shown;
+    int64_t apply_us;
+} s_anim;
+
+static const esp_partition_t *anim_partition(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, BOOT_ANIM_PARTITION);
+}
+
+static bool hdr_valid(const boot_anim_hdr_t *h, uint32_t part_size)
+{
+    return h->magic == BOOT_ANIM_MAGIC && h->width && h->height && h->frames && h->frames <= BOOT_ANIM_MAX_FRAMES &&
+           h->data_size <= part_size - sizeof(*h) &&
+           h->index_offset + h->frames * sizeof(boot_anim_frame_t) <= sizeof(*h) + h->data_size;
+}
+
+/************ 播放 ************/
+// 把一帧的RLE展开到帧缓冲里它的矩形 行尾自动换到下一行
+static void rle_apply(const uint16_t *in, uint16_t *fb, int stride, const boot_anim_frame_t *f)
+{
+    uint16_t *row = fb + f->y * stride + f->x;
+    uint32_t left = (uint32_t)f->w * f->h;
+    int x = 0;
+    while (left)
+    {
+        uint16_t t = *in++;
+        uint32_t cnt = LV_MIN(t & ANIM_TOKEN_MAX, left);
+        bool run = t & ANIM_TOKEN_RUN;
+        uint16_t c = run ? *in++ : 0;
+        left -= cnt;
+        while (cnt)
+        {
+            int k = LV_MIN(cnt, (uint32_t)(f->w - x));
+            if (run)
+            {
+                for (int i = 0; i < k; i++)
+                {
+                    row[x + i] = c;
+                }
+            }
+            else
+            {
+                memcpy(row + x, in, k * sizeof(uint16_t));
+                in += k;
+            }
+            x += k;
+            cnt -= k;
+            if (x == f->w)
+            {
+                x = 0;
+                row += stride;
+            }
+        }
+    }
+}
+
+static void anim_show(uint16_t index)
+{
+    const boot_anim_frame_t *f = &s_anim.frames[index];
+    s_anim.index = index;
+    s_anim.last_show = lv_tick_get();
+    if (f->w == 0)
+    {
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    rle_apply((const uint16_t *)(s_anim.map + f->offset), s_anim.fb, s_anim.hdr->width, f);
+    s_anim.apply_us += esp_timer_get_time() - t0;
+    s_anim.shown++;
+    lv_area_t a = {f->x, f->y, f->x + f->w - 1, f->y + f->h - 1};
+    lv_area_move(&a, s_anim.img->coords.x1, s_anim.img->coords.y1);
+    lv_img_cache_invalidate_src(&s_anim.dsc);
+    lv_obj_invalidate_area(s_anim.img, &a);
+}
+
+static void anim_timer_cb(lv_timer_t *t)
+{
+    const boot_anim_frame_t *f = &s_anim.frames[s_anim.index];
+    if (lv_tick_elaps(s_anim.last_show) < LV_MAX(f->delay_ms, ANIM_MIN_DELAY_MS))
+    {
+        return;
+    }
+    // 第一帧存的是整张 回到开头直接覆盖
+    anim_show(s_anim.index + 1 < s_anim.hdr->frames ? s_anim.index + 1 : 0);
+}
+
+static void anim_unmap(void)
+{
+    if (s_anim.map)
+    {
+        esp_partition_munmap(s_anim.map_handle);
+        s_anim.map = NULL;
+        s_anim.hdr = NULL;
+        s_anim.frames = NULL;
+    }
+}
+
+static void anim_delete_cb(lv_event_t *e)
+{
+    if (s_anim.shown)
+    {
+        ESP_LOGI(TAG, "%lu frames shown, avg %lu us to apply", (unsigned long)s_anim.shown,
+                 (unsigned long)(s_anim.apply_us / s_anim.shown));
+    }
+    lv_timer_del(s_anim.timer);
+    mem_pool_free(s_anim.fb);
+    anim_unmap();
+    memset(&s_anim, 0, sizeof(s_anim));
+}
+
+// 映射整个分区 文件头和CRC都对才用
+static bool anim_map(void)
+{
+    const esp_partition_t *part = anim_partition();
+    if (part == NULL)
+    {
+        return false;
+    }
+    if (esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, (const void **)&s_anim.map, &s_anim.map_handle) != ESP_OK)
+    {
+        s_anim.map = NULL;
+        return false;
+    }
+    const boot_anim_hdr_t *h = (const boot_anim_hdr_t *)s_anim.map;
+    if (!hdr_valid(h, part->size) || esp_rom_crc32_le(0, s_anim.map + sizeof(*h), h->data_size) != h->crc)
+    {
+        anim_unmap();
+        return false;
+    }
+    s_anim.hdr = h;
+    s_anim.frames = (const boot_anim_frame_t *)(s_anim.map + h->index_offset);
+    return true;
+}
+
+lv_obj_t *boot_anim_create(lv_obj_t *parent)
+{
+    if (s_anim.img || !anim_map())
+    {
+        return NULL;
+    }
+    uint32_t bytes = (uint32_t)s_anim.hdr->width * s_anim.hdr->height * sizeof(uint16_t);
+    s_anim.fb = mem_pool_alloc(MEM_POOL_MEDIA, bytes);
+    if (s_anim.fb == NULL)
+    {
+        anim_unmap();
+        return NULL;
+    }
+    s_anim.dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    s_anim.dsc.header.w = s_anim.hdr->width;
+    s_anim.dsc.header.h = s_anim.hdr->height;
+    s_anim.dsc.data_size = bytes;
+    s_anim.dsc.data = (const uint8_t *)s_anim.fb;
+    s_anim.img = lv_img_create(parent);
+    lv_obj_add_event_cb(s_anim.img, anim_delete_cb, LV_EVENT_DELETE, NULL);
+    anim_show(0);
+    lv_img_set_src(s_anim.img, &s_anim.dsc);
+    s_anim.timer = lv_timer_create(anim_timer_cb, ANIM_MIN_DELAY_MS, NULL);
+    return s_anim.img;
+}
+
+/************ 转换 ************/
+// n个像素编成RLE 写进out(单位16位) 放不下返回0
+static uint32_t rle_encode(const uint16_t *px, uint32_t n, uint16_t *out, uint32_t cap)
+{
+    uint32_t o = 0;
+    uint32_t i = 0;
+    while (i < n)
+    {
+        uint32_t run = 1;
+        while (i + run < n && run < ANIM_TOKEN_MAX && px[i + run] == px[i])
+        {
+            run++;
+        }
+        if (run >= ANIM_RUN_MIN)
+        {
+            if (o + 2 > cap)
+            {
+                return 0;
+            }
+            out[o++] = ANIM_TOKEN_RUN | run;
+            out[o++] = px[i];
+            i += run;
+            continue;
+        }
+        // 原样的一段 到下一处够长的重复为止
+        uint32_t start = i;
+        while (i < n && i - start < ANIM_TOKEN_MAX &&
+               !(i + 2 < n && px[i] == px[i + 1] && px[i] == px[i + 2]))
+        {
+            i++;
+        }
+        uint32_t lit = i - start;
+        if (o + 1 + lit > cap)
+        {
+            return 0;
+        }
+        out[o++] = lit;
+        memcpy(&out[o], &px[start], lit * sizeof(uint16_t));
+        o += lit;
+    }
+    return o;
+}
+
+// 和上一帧不同的像素的外接矩形 完全一样返回false
+static bool diff_rect(const uint16_t *a, const uint16_t *b, int w, int h, lv_area_t *r)
+{
+    r->x1 = w;
+    r->y1 = h;
+    r->x2 = -1;
+    r->y2 = -1;
+    for (int y = 0; y < h; y++)
+    {
+        const uint16_t *ra = a + y * w;
+        const uint16_t *rb = b + y * w;
+        if (memcmp(ra, rb, w * sizeof(uint16_t)) == 0)
+        {
+            continue;
+        }
+        int x0 = 0;
+        int x1 = w - 1;
+        while (ra[x0] == rb[x0])
+        {
+            x0++;
+        }
+        while (ra[x1] == rb[x1])
+        {
+            x1--;
+        }
+        r->x1 = LV_MIN(r->x1, x0);
+        r->x2 = LV_MAX(r->x2, x1);
+        r->y1 = LV_MIN(r->y1, y);
+        r->y2 = y;
+    }
+    return r->x2 >= 0;
+}
+
+// gifdec的画布是每像素3字节: LVGL字节序的RGB565加透明度 透明的地方换成背景色
+static void canvas_to_rgb565(const uint8_t *canvas, uint16_t *out, uint32_t n)
+{
+    lv_color_t bg = lv_color_hex(BOOT_ANIM_BG);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const uint8_t *p = canvas + i * LV_IMG_PX_SIZE_ALPHA_BYTE;
+        out[i] = p[2] ? (p[0] | (p[1] << 8)) : bg.full;
+    }
+}
+
+static uint8_t *load_file(const char *path, const struct stat *st)
+{
+    if (st->st_size <= 13 || st->st_size > ANIM_FILE_MAX)
+    {
+        return NULL;
+    }
+    FILE *f = fopen(path, "rb");
+    uint8_t *data = f ? heap_caps_malloc(st->st_size + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    bool ok = data && fread(data, 1, st->st_size, f) == (size_t)st->st_size;
+    if (f)
+    {
+        fclose(f);
+    }
+    if (!ok)
+    {
+        heap_caps_free(data);
+        return NULL;
+    }
+    data[st->st_size] = ';';
+    return data;
+}
+
+// 逐帧解码合成 和上一帧比出变化的矩形 RLE编码后排在out里 返回总字节数 失败返回0
+static uint32_t anim_encode(gd_GIF *gif, uint8_t *out, uint32_t cap, boot_anim_hdr_t *hdr)
+{
+    uint32_t px = (uint32_t)gif->width * gif->height;
+    uint16_t *cur = heap_caps_malloc(px * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint16_t *prev = heap_caps_malloc(px * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint16_t *lin = heap_caps_malloc(px * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    boot_anim_frame_t *frames = calloc(BOOT_ANIM_MAX_FRAMES, sizeof(*frames));
+    uint32_t pos = sizeof(*hdr);
+    uint16_t n = 0;
+    bool ok = cur && prev && lin && frames;
+    while (ok)
+    {
+        uint32_t rw_before = gif->f_rw_p;
+        int res = gd_get_frame(gif);
+        if (res < 0 || (res > 0 && n >= BOOT_ANIM_MAX_FRAMES))
+        {
+            ok = false;
+            break;
+        }
+        if (res == 0 || (n > 0 && gif->f_rw_p < rw_before))
+        {
+            break;                      // 放完一遍
+        }
+        gd_render_frame(gif, gif->canvas);
+        canvas_to_rgb565(gif->canvas, cur, px);
+
+        lv_area_t r = {0, 0, gif->width - 1, gif->height - 1};
+        boot_anim_frame_t *f = &frames[n];
+        f->offset = pos;
+        f->delay_ms = gif->gce.delay * 10;
+        if (n == 0 || diff_rect(cur, prev, gif->width, gif->height, &r))
+        {
+            f->x = r.x1;
+            f->y = r.y1;
+            f->w = lv_area_get_width(&r);
+            f->h = lv_area_get_height(&r);
+            for (int y = 0; y < f->h; y++)
+            {
+                memcpy(lin + y * f->w, cur + (f->y + y) * gif->width + f->x, f->w * sizeof(uint16_t));
+            }
+            uint32_t words = rle_encode(lin, (uint32_t)f->w * f->h, (uint16_t *)(out + pos), (cap - pos) / sizeof(uint16_t));
+            ok = words > 0;
+            pos += words * sizeof(uint16_t);
+        }
+        uint16_t *t = prev;
+        prev = cur;
+        cur = t;
+        n++;
+    }
+    pos = ANIM_ALIGN_UP(pos, 4);
+    uint32_t index_bytes = n * sizeof(boot_anim_frame_t);
+    ok = ok && n > 0 && pos + index_bytes <= cap;
+    if (ok)
+    {
+        memcpy(out + pos, frames, index_bytes);
+        hdr->magic = BOOT_ANIM_MAGIC;
+        hdr->width = gif->width;
+        hdr->height = gif->height;
+        hdr->frames = n;
+        hdr->index_offset = pos;
+        hdr->data_size = pos + index_bytes - sizeof(*hdr);
+        hdr->crc = esp_rom_crc32_le(0, out + sizeof(*hdr), hdr->data_size);
+    }
+    heap_caps_free(cur);
+    heap_caps_free(prev);
+    heap_caps_free(lin);
+    free(frames);
+    return ok ? sizeof(*hdr) + hdr->data_size : 0;
+}
+
+esp_err_t boot_anim_update(const char *gif_path)
+{
+    const esp_partition_t *part = anim_partition();
+    ESP_RETURN_ON_FALSE(part, ESP_ERR_NOT_FOUND, TAG, "no %s partition", BOOT_ANIM_PARTITION);
+    ESP_RETURN_ON_FALSE(s_anim.map == NULL, ESP_ERR_INVALID_STATE, TAG, "animation is playing");
+    struct stat st;
+    ESP_RETURN_ON_FALSE(stat(gif_path, &st) == 0, ESP_ERR_NOT_FOUND, TAG, "no %s", gif_path);
+
+    boot_anim_hdr_t hdr;
+    ESP_RETURN_ON_ERROR(esp_partition_read(part, 0, &hdr, sizeof(hdr)), TAG, "read header failed");
+    if (hdr_valid(&hdr, part->size) && hdr.src_size == (uint32_t)st.st_size && hdr.src_mtime == (uint32_t)st.st_mtime)
+    {
+        return ESP_OK;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    uint8_t *file = load_file(gif_path, &st);
+    gd_GIF *gif = file ? gd_open_gif_data(file) : NULL;
+    uint8_t *out = gif ? heap_caps_malloc(part->size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    memset(&hdr, 0, sizeof(hdr));
+    uint32_t total = out ? anim_encode(gif, out, part->size, &hdr) : 0;
+    if (gif)
+    {
+        gd_close_gif(gif);
+    }
+    heap_caps_free(file);
+
+    esp_err_t ret = total ? ESP_OK : ESP_FAIL;
+    if (ret == ESP_OK)
+    {
+        // 先写数据再写文件头 中途断电下次开机文件头无效 重新转换
+        hdr.src_size = st.st_size;
+        hdr.src_mtime = st.st_mtime;
+        ret = esp_partition_erase_range(part, 0, ANIM_ALIGN_UP(total, part->erase_size));
+        if (ret == ESP_OK)
+        {
+            ret = esp_partition_write(part, sizeof(hdr), out + sizeof(hdr), total - sizeof(hdr));
+        }
+        if (ret == ESP_OK)
+        {
+            ret = esp_partition_write(part, 0, &hdr, sizeof(hdr));
+        }
+    }
+    heap_caps_free(out);
+    ESP_RETURN_ON_FALSE(total, ESP_FAIL, TAG, "%s: decode failed or does not fit in %lu KB", gif_path, (unsigned long)part->size / 1024);
+    ESP_RETURN_ON_ERROR(ret, TAG, "flash write failed");
+    ESP_LOGI(TAG, "%s: %u frames %ux%u -> %lu KB in flash (%.1f%% of RGB565), %lld ms", gif_path, hdr.frames, hdr.width, hdr.height,
+             (unsigned long)total / 1024, 100.0 * total / ((double)hdr.frames * hdr.width * hdr.height * 2),
+             (esp_timer_get_time() - t0) / 1000);
+    return ESP_OK;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+
+/*********************** flash里的开机动画 ****************************/
+// SD卡上的开机GIF转换一次 存进分区表里的bootanim分区 之后开机直接从映射的flash里放
+// 不用等SD卡挂载 也没有LZW解码 每帧只把和上一帧不同的矩形按RLE展开到RGB565帧缓冲里
+// 分区里: 文件头 | 每帧的RLE数据 | 帧索引 文件头最后写 转换一半断电下次会重新转
+// RLE是16位一个单位 最高位1: 后面一个颜色重复(低15位)次 最高位0: 后面跟(低15位)个原样的颜色
+
+#define BOOT_ANIM_GIF_PATH      "/sdcard/tanglong.gif"
+#define BOOT_ANIM_PARTITION     "bootanim"
+#define BOOT_ANIM_MAGIC         0x314e4142      // "BAN1"
+#define BOOT_ANIM_MAX_FRAMES    512
+#define BOOT_ANIM_BG            0x000000        // GIF透明的地方 转换时合成到这个颜色上
+
+typedef struct {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+    uint16_t frames;
+    uint16_t reserved;
+    uint32_t src_size;                  // 源GIF的大小和修改时间 对不上就重新转换
+    uint32_t src_mtime;
+    uint32_t index_offset;              // 帧索引相对分区开头
+    uint32_t data_size;                 // 文件头之后的字节数
+    uint32_t crc;                       // 文件头之后全部数据的CRC32
+} boot_anim_hdr_t;
+
+typedef struct {
+    uint32_t offset;                    // RLE数据相对分区开头
+    uint16_t x;                         // 和上一帧不同的矩形 w为0表示和上一帧一样
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint16_t delay_ms;
+    uint16_t reserved;
+} boot_anim_frame_t;
+
+// 分区里有能用的动画就创建一个开始循环播放的图片 没有返回NULL 持有LVGL锁时调用 删掉对象就停止并解除映射
+lv_obj_t *boot_anim_create(lv_obj_t *parent);
+// 源GIF变了(或者还没转过)就重新转换写进分区 没变直接返回ESP_OK 在后台任务里调用 动画正在放时不写
+esp_err_t boot_anim_update(const char *gif_path);
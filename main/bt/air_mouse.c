@@ -0,0 +1,219 @@
+#include <math.h>
+#include <string.h>
+#include "air_mouse.h"
+#include "task_plan.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp32_s3_szp.h"
+#include "imu.h"
+#include "attitude.h"
+#include "idle_mgr.h"
+#include "hid_sched.h"
+
+static const char *TAG = "air_mouse";
+
+#define AIR_BATCH       32
+#define AIR_DEG         57.29578f
+
+static TaskHandle_t s_task;
+static volatile bool s_want;
+static volatile uint8_t s_buttons;
+static bool s_active;                   // 下面这些只在自己的任务里用
+static bool s_own_imu;                  // imu_start和attitude_start过 关的时候要配对停掉
+static uint32_t s_cursor;
+static float s_fx, s_fy;                // 不满一个计数的余数
+static float s_h[3] = {1.0f, 0.0f, 0.0f};   // 水平横轴 绕它转是上下
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static air_mouse_stats_t s_stats;
+
+static void mouse_release(void)
+{
+    attitude_stop();
+    imu_stop();
+    idle_mgr_imu_released();
+    s_own_imu = false;
+}
+
+static bool mouse_open(void)
+{
+    // 别的模块开着IMU就跟着用 开关配对 不会把它们的停掉
+    if ((!imu_running() && qmi8658_init() != ESP_OK) || imu_start() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "IMU not available");
+        idle_mgr_imu_released();
+        return false;
+    }
+    s_own_imu = true;
+    if (attitude_start() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "attitude not available");
+        mouse_release();
+        return false;
+    }
+    imu_set_low_latency(true);
+    s_cursor = imu_head();
+    s_fx = s_fy = 0.0f;
+    if (imu_add_listener(s_task) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "no IMU listener slot");
+        imu_set_low_latency(false);
+        mouse_release();
+        return false;
+    }
+    return true;
+}
+
+static void mouse_close(void)
+{
+    imu_remove_listener(s_task);
+    imu_set_low_latency(false);
+    if (s_own_imu)
+    {
+        mouse_release();
+    }
+    hid_sched_mouse(0, 0, 0, esp_timer_get_time()); // 按着的键松开
+}
+
+// 重力方向和指向前方的轴叉乘得到水平横轴 几乎竖着指的时候叉乘太小 沿用上一次的
+static void update_axes(const float *g)
+{
+    float f[3] = {0};
+    f[AIR_MOUSE_FWD_AXIS] = 1.0f;
+    float h[3] = {g[1] * f[2] - g[2] * f[1], g[2] * f[0] - g[0] * f[2], g[0] * f[1] - g[1] * f[0]};
+    float n = sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+    if (n > 0.3f)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            s_h[i] = h[i] / n;
+        }
+    }
+}
+
+static inline float deadzone(float v)
+{
+    return fabsf(v) < AIR_MOUSE_DEADZONE_DPS ? 0.0f : v;
+}
+
+static void mouse_process(void)
+{
+    static imu_sample_t buf[AIR_BATCH];
+    attitude_t att;
+    if (!attitude_get(&att))
+    {
+        s_cursor = imu_head(); // 姿态还没收敛 不知道哪边是上
+        return;
+    }
+    update_axes(att.gravity);
+    const float dt = 1.0f / IMU_ODR_HZ;
+    int n;
+    while ((n = imu_read(&s_cursor, buf, AIR_BATCH)) > 0)
+    {
+        int64_t t0 = esp_timer_get_time();
+        int64_t t_first = 0;
+        for (int i = 0; i < n; i++)
+        {
+            float w[3];
+            for (int k = 0; k < 3; k++)
+            {
+                w[k] = (float)buf[i].gyr[k] / IMU_GYR_LSB_PER_DPS + att.gyro_corr[k] * AIR_DEG;
+            }
+            float g = deadzone(w[0] * att.gravity[0] + w[1] * att.gravity[1] + w[2] * att.gravity[2]);
+            float h = deadzone(w[0] * s_h[0] + w[1] * s_h[1] + w[2] * s_h[2]);
+            if (g != 0.0f || h != 0.0f)
+            {
+                t_first = t_first ? t_first : buf[i].t_us;
+                s_fx -= g * dt * AIR_MOUSE_GAIN; // 从上往下看顺时针转 光标往右
+                s_fy -= h * dt * AIR_MOUSE_GAIN; // 往上抬 光标往上
+            }
+        }
+        int dx = (int)s_fx;
+        int dy = (int)s_fy;
+        s_fx -= dx;
+        s_fy -= dy;
+        if (dx || dy)
+        {
+            hid_sched_mouse(dx, dy, s_buttons, t_first);
+        }
+        int64_t t1 = esp_timer_get_time();
+        uint32_t us = t1 - t0;
+        uint32_t age = t1 - buf[0].t_us;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.batches++;
+        s_stats.samples += n;
+        s_stats.moves += dx || dy;
+        s_stats.proc_us += us;
+        s_stats.proc_max_us = us > s_stats.proc_max_us ? us : s_stats.proc_max_us;
+        s_stats.age_us += age;
+        s_stats.age_max_us = age > s_stats.age_max_us ? age : s_stats.age_max_us;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static void air_task(void *arg)
+{
+    for (;;)
+    {
+        // IMU每发布一批通知一次 开关也靠通知
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        bool want = s_want;
+        if (want && !s_active)
+        {
+            s_active = mouse_open();
+            s_want = s_active;
+        }
+        else if (!want && s_active)
+        {
+            mouse_close();
+            s_active = false;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.active = s_active;
+        portEXIT_CRITICAL(&s_lock);
+        if (s_active)
+        {
+            mouse_process();
+        }
+    }
+}
+
+esp_err_t air_mouse_start(void)
+{
+    if (s_task == NULL && task_plan_create(TASK_AIR_MOUSE, air_task, NULL, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_want = true;
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void air_mouse_stop(void)
+{
+    s_want = false;
+    s_buttons = 0;
+    if (s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void air_mouse_buttons(uint8_t buttons)
+{
+    s_buttons = buttons;
+    hid_sched_mouse(0, 0, buttons, esp_timer_get_time());
+}
+
+bool air_mouse_active(void)
+{
+    return s_want;
+}
+
+void air_mouse_get_stats(air_mouse_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
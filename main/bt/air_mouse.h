@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 空中鼠标 ****************************/
+// 陀螺仪的转速换成BLE鼠标的相对位移 传感器到HID报告不经过LVGL
+// 自己的任务在core 0上挂在IMU采样任务后面 每来一批样本积分一次 攒够一个计数就交给hid_sched
+// hid_sched按连接间隔合并成报告 间隔到了马上发 不等下一批
+// IMU开低延迟模式 FIFO水位约5ms 没有INT线时每个tick(10ms)读一次 样本等待加I2C加排队不超过20ms
+// 转速按姿态解算的重力方向分解: 绕竖直方向转是左右 绕水平横轴转是上下 拿在手里怎么斜都一样
+// 零偏用姿态解算估出来的修正 再加一个死区 放着不动光标不会漂
+
+#define AIR_MOUSE_GAIN          12.0f   // 转一度走多少个计数
+#define AIR_MOUSE_DEADZONE_DPS  2.0f    // 低于这个转速当作手抖
+#define AIR_MOUSE_FWD_AXIS      1       // 传感器的哪个轴指向前方 0 X 1 Y 2 Z
+
+#define AIR_MOUSE_BTN_LEFT      0x01
+#define AIR_MOUSE_BTN_RIGHT     0x02
+
+typedef struct {
+    bool active;
+    uint32_t batches;                   // 处理的样本批数
+    uint32_t samples;
+    uint32_t moves;                     // 交给hid_sched的非零位移
+    uint64_t proc_us;                   // 处理样本花的时间
+    uint32_t proc_max_us;
+    uint64_t age_us;                    // 处理时一批里最早样本已经过去的时间 加起来
+    uint32_t age_max_us;
+} air_mouse_stats_t;
+
+esp_err_t air_mouse_start(void);        // 不阻塞 IMU没开的话后台打开
+void air_mouse_stop(void);              // 不阻塞 是自己打开的IMU就关掉
+void air_mouse_buttons(uint8_t buttons);    // 界面上的左右键
+bool air_mouse_active(void);
+void air_mouse_get_stats(air_mouse_stats_t *stats);
@@ -0,0 +1,375 @@
+#include <string.h>
+#include "ble_remote.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_gatts_api.h"
+#include "esp_gatt_common_api.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_hidd_prf_api.h"
+#include "audio_player.h"
+#include "audio_pcm.h"
+#include "app_ui.h"
+#include "ui_msg.h"
+#include "telemetry.h"
+
+static const char *TAG = "ble_remote";
+
+#define RMT_CMD_MAX     8               // 最长的命令
+#define RMT_PKT_MAX     (sizeof(ble_remote_batch_t) + BLE_REMOTE_BATCH_MAX * sizeof(ble_remote_sample_t))
+
+enum {
+    RMT_IDX_SVC,
+    RMT_IDX_CMD_CHAR,
+    RMT_IDX_CMD_VAL,
+    RMT_IDX_TLM_CHAR,
+    RMT_IDX_TLM_VAL,
+    RMT_IDX_TLM_CCC,
+    RMT_IDX_NB,
+};
+
+/* LSB <--------------------------------------------------------------------------------> MSB */
+static const uint8_t s_svc_uuid[16] = {
+    0x00, 0xc1, 0xb2, 0xa7, 0x03, 0x8d, 0x1e, 0x9c, 0x2c, 0x4f, 0x1f, 0x5b, 0x01, 0x00, 0x4a, 0x6e,
+};
+static const uint8_t s_cmd_uuid[16] = {
+    0x00, 0xc1, 0xb2, 0xa7, 0x03, 0x8d, 0x1e, 0x9c, 0x2c, 0x4f, 0x1f, 0x5b, 0x02, 0x00, 0x4a, 0x6e,
+};
+static const uint8_t s_tlm_uuid[16] = {
+    0x00, 0xc1, 0xb2, 0xa7, 0x03, 0x8d, 0x1e, 0x9c, 0x2c, 0x4f, 0x1f, 0x5b, 0x03, 0x00, 0x4a, 0x6e,
+};
+static const uint16_t s_primary_uuid = ESP_GATT_UUID_PRI_SERVICE;
+static const uint16_t s_char_decl_uuid = ESP_GATT_UUID_CHAR_DECLARE;
+static const uint16_t s_ccc_uuid = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
+static const uint8_t s_prop_write = ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
+static const uint8_t s_prop_notify = ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static uint8_t s_ccc_val[2];
+
+static const esp_gatts_attr_db_t s_db[RMT_IDX_NB] = {
+    [RMT_IDX_SVC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&s_primary_uuid, ESP_GATT_PERM_READ,
+                                           sizeof(s_svc_uuid), sizeof(s_svc_uuid), (uint8_t *)s_svc_uuid}},
+    [RMT_IDX_CMD_CHAR] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&s_char_decl_uuid, ESP_GATT_PERM_READ,
+                                                1, 1, (uint8_t *)&s_prop_write}},
+    [RMT_IDX_CMD_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_128, (uint8_t *)s_cmd_uuid, ESP_GATT_PERM_WRITE_ENCRYPTED,
+                                               RMT_CMD_MAX, 0, NULL}},
+    [RMT_IDX_TLM_CHAR] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&s_char_decl_uuid, ESP_GATT_PERM_READ,
+                                                1, 1, (uint8_t *)&s_prop_notify}},
+    [RMT_IDX_TLM_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_128, (uint8_t *)s_tlm_uuid, ESP_GATT_PERM_READ_ENCRYPTED,
+                                               RMT_PKT_MAX, 0, NULL}},
+    [RMT_IDX_TLM_CCC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&s_ccc_uuid,
+                                               ESP_GATT_PERM_READ_ENCRYPTED | ESP_GATT_PERM_WRITE_ENCRYPTED,
+                                               sizeof(s_ccc_val), sizeof(s_ccc_val), s_ccc_val}},
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_remote_stats_t s_stats;
+static esp_gatt_if_t s_gatts_if = ESP_GATT_IF_NONE;
+static uint16_t s_handles[RMT_IDX_NB];
+static volatile bool s_connected;
+static volatile bool s_congested;
+static volatile uint16_t s_conn_id;
+static volatile uint16_t s_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+static uint16_t s_period_ms = CONFIG_APP_BLE_TELEMETRY_MS;
+static uint8_t s_batch_cfg = CONFIG_APP_BLE_TELEMETRY_BATCH;
+static esp_timer_handle_t s_timer;
+
+// 下面这些只在esp_timer任务里用
+static uint8_t s_pkt[RMT_PKT_MAX];
+static uint8_t s_count;
+static uint8_t s_seq;
+static telemetry_cpu_t s_cpu;
+static uint32_t s_underruns_prev;
+
+static uint8_t batch_size(void)
+{
+    int room = ((int)s_mtu - 3 - (int)sizeof(ble_remote_batch_t)) / (int)sizeof(ble_remote_sample_t);
+    room = room < 1 ? 1 : room > BLE_REMOTE_BATCH_MAX ? BLE_REMOTE_BATCH_MAX : room;
+    return s_batch_cfg && s_batch_cfg < room ? s_batch_cfg : room;
+}
+
+static void batch_send(uint8_t count)
+{
+    ble_remote_batch_t *hdr = (ble_remote_batch_t *)s_pkt;
+    audio_player_position_t pos = {0};
+    audio_player_get_position(&pos);
+    audio_player_state_t state = audio_player_get_state();
+    hdr->seq = s_seq++;
+    hdr->count = count;
+    hdr->period_ms = s_period_ms;
+    hdr->play_state = state == AUDIO_PLAYER_STATE_PLAYING ? 1 : state == AUDIO_PLAYER_STATE_PAUSE ? 2 : 0;
+    hdr->volume = audio_pcm_get_volume();
+    hdr->position_ms = pos.position_ms;
+    uint16_t len = sizeof(*hdr) + count * sizeof(ble_remote_sample_t);
+    bool sent = s_connected && !s_congested &&
+                esp_ble_gatts_send_indicate(s_gatts_if, s_conn_id, s_handles[RMT_IDX_TLM_VAL], len, s_pkt, false) == ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    if (sent)
+    {
+        s_stats.notifies++;
+        s_stats.bytes += len;
+    }
+    else
+    {
+        s_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void sample_cb(void *arg)
+{
+    int64_t t0 = esp_timer_get_time();
+    ble_remote_sample_t *smp = (ble_remote_sample_t *)(s_pkt + sizeof(ble_remote_batch_t)) + s_count;
+    audio_pcm_stats_t pcm;
+    audio_pcm_get_stats(&pcm);
+    smp->heap_int_kb = heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024;
+    smp->heap_int_block_kb = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) / 1024;
+    smp->heap_psram_kb = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024;
+    for (int i = 0; i < 2; i++)
+    {
+        smp->cpu[i] = (telemetry_cpu_load(&s_cpu, i) + 5) / 10;
+    }
+    smp->audio_fill = pcm.ring_size ? (uint64_t)pcm.fill * 100 / pcm.ring_size : 0;
+    uint32_t underruns = pcm.underruns - s_underruns_prev;
+    smp->underruns = underruns > 255 ? 255 : underruns;
+    s_underruns_prev = pcm.underruns;
+    // MTU可能刚刚变小 装不下就先发掉
+    if (++s_count >= batch_size())
+    {
+        batch_send(s_count);
+        s_count = 0;
+    }
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.samples++;
+    s_stats.sample_max_us = us > s_stats.sample_max_us ? us : s_stats.sample_max_us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void tlm_stop(void)
+{
+    if (s_timer)
+    {
+        esp_timer_stop(s_timer);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.subscribed = false;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void tlm_start(void)
+{
+    tlm_stop();
+    s_count = 0;
+    memset(&s_cpu, 0, sizeof(s_cpu));
+    if (esp_timer_start_periodic(s_timer, (uint64_t)s_period_ms * 1000) != ESP_OK)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.subscribed = true;
+    s_stats.period_ms = s_period_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void remote_play(void *arg)
+{
+    ai_play();
+}
+
+static void remote_pause(void *arg)
+{
+    ai_pause();
+}
+
+static void remote_resume(void *arg)
+{
+    ai_resume();
+}
+
+static void remote_next(void *arg)
+{
+    ai_next_music();
+}
+
+static void remote_prev(void *arg)
+{
+    ai_prev_music();
+}
+
+static void remote_seek(void *arg)
+{
+    ai_seek((uintptr_t)arg);
+}
+
+static void remote_volume(void *arg)
+{
+    ai_volume_set((uintptr_t)arg);
+}
+
+static void remote_volume_up(void *arg)
+{
+    ai_volume_up();
+}
+
+static void remote_volume_down(void *arg)
+{
+    ai_volume_down();
+}
+
+// 在BTC任务里解析 要动界面的交给LVGL任务
+static bool cmd_handle(const uint8_t *v, uint16_t len)
+{
+    if (len == 0)
+    {
+        return false;
+    }
+    switch (v[0])
+    {
+    case BLE_REMOTE_CMD_PLAY:
+        return len == 1 && ui_post_call(remote_play, NULL);
+    case BLE_REMOTE_CMD_PAUSE:
+        return len == 1 && ui_post_call(remote_pause, NULL);
+    case BLE_REMOTE_CMD_RESUME:
+        return len == 1 && ui_post_call(remote_resume, NULL);
+    case BLE_REMOTE_CMD_NEXT:
+        return len == 1 && ui_post_call(remote_next, NULL);
+    case BLE_REMOTE_CMD_PREV:
+        return len == 1 && ui_post_call(remote_prev, NULL);
+    case BLE_REMOTE_CMD_SEEK: {
+        if (len != 5)
+        {
+            return false;
+        }
+        uint32_t ms = v[1] | v[2] << 8 | v[3] << 16 | (uint32_t)v[4] << 24;
+        return ui_post_call(remote_seek, (void *)(uintptr_t)ms);
+    }
+    case BLE_REMOTE_CMD_VOLUME:
+        return len == 2 && v[1] <= 100 && ui_post_call(remote_volume, (void *)(uintptr_t)v[1]);
+    case BLE_REMOTE_CMD_VOLUME_UP:
+        return len == 1 && ui_post_call(remote_volume_up, NULL);
+    case BLE_REMOTE_CMD_VOLUME_DOWN:
+        return len == 1 && ui_post_call(remote_volume_down, NULL);
+    case BLE_REMOTE_CMD_PERIOD: {
+        uint16_t ms = len == 4 ? v[1] | v[2] << 8 : 0;
+        if (ms < BLE_REMOTE_PERIOD_MIN || v[3] > BLE_REMOTE_BATCH_MAX)
+        {
+            return false;
+        }
+        s_period_ms = ms;
+        s_batch_cfg = v[3];
+        if (s_stats.subscribed)
+        {
+            tlm_start();
+        }
+        ESP_LOGI(TAG, "telemetry every %u ms, batch %u", ms, v[3]);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static void gatts_cb(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if, esp_ble_gatts_cb_param_t *param)
+{
+    switch (event)
+    {
+    case ESP_GATTS_REG_EVT:
+        if (param->reg.status == ESP_GATT_OK)
+        {
+            s_gatts_if = gatts_if;
+            esp_ble_gatts_create_attr_tab(s_db, gatts_if, RMT_IDX_NB, 0);
+        }
+        break;
+    case ESP_GATTS_CREAT_ATTR_TAB_EVT:
+        if (param->add_attr_tab.status == ESP_GATT_OK && param->add_attr_tab.num_handle == RMT_IDX_NB)
+        {
+            memcpy(s_handles, param->add_attr_tab.handles, sizeof(s_handles));
+            esp_ble_gatts_start_service(s_handles[RMT_IDX_SVC]);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "create attr table failed, status 0x%x", param->add_attr_tab.status);
+        }
+        break;
+    case ESP_GATTS_CONNECT_EVT:
+        s_conn_id = param->connect.conn_id;
+        s_mtu = ESP_GATT_DEF_BLE_MTU_SIZE;
+        s_congested = false;
+        s_connected = true;
+        break;
+    case ESP_GATTS_DISCONNECT_EVT:
+        s_connected = false;
+        tlm_stop();
+        break;
+    case ESP_GATTS_MTU_EVT:
+        s_mtu = param->mtu.mtu;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.mtu = param->mtu.mtu;
+        portEXIT_CRITICAL(&s_lock);
+        break;
+    case ESP_GATTS_CONGEST_EVT:
+        s_congested = param->congest.congested;
+        break;
+    case ESP_GATTS_WRITE_EVT:
+        if (param->write.is_prep)
+        {
+            break;
+        }
+        if (param->write.handle == s_handles[RMT_IDX_TLM_CCC] && param->write.len == 2)
+        {
+            if (param->write.value[0] & 0x01)
+            {
+                tlm_start();
+            }
+            else
+            {
+                tlm_stop();
+            }
+        }
+        else if (param->write.handle == s_handles[RMT_IDX_CMD_VAL])
+        {
+            bool ok = cmd_handle(param->write.value, param->write.len);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.commands += ok;
+            s_stats.rejected += !ok;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t ble_remote_attach(void)
+{
+    if (s_timer == NULL)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = sample_cb,
+            .name = "ble_tlm",
+        };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "create timer");
+    }
+    s_gatts_if = ESP_GATT_IF_NONE;
+    memset(s_handles, 0, sizeof(s_handles));
+    // 遥测一批能装满就用大一点的MTU 客户端请求交换时生效
+    esp_ble_gatt_set_local_mtu(RMT_PKT_MAX + 3);
+    return esp_hidd_add_gatts_app(BLE_REMOTE_APP_ID, gatts_cb);
+}
+
+void ble_remote_detach(void)
+{
+    s_connected = false;
+    tlm_stop();
+    s_gatts_if = ESP_GATT_IF_NONE;
+}
+
+void ble_remote_get_stats(ble_remote_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    stats->period_ms = s_period_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
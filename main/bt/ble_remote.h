@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** BLE遥控和遥测服务 ****************************/
+// 和HID挂在同一个协议栈上的自定义GATT服务 手机应用不用Wi-Fi就能控制音乐播放器和看性能计数
+// 命令特征(写) 第一个字节是操作码 后面的参数都是小端 交给LVGL任务执行 和语音命令走同一套ai_*接口
+// 遥测特征(通知) 按周期采样 攒够一批打包成一个通知 订阅了才采 没人订阅不花时间
+// 通知前面是批头 后面跟count个定长的样本 一批装多少看协商的MTU
+// 读写都要加密 和HID一样用绑定的密钥
+// 连接拥塞的时候遥测让路 这一批丢掉 HID报告不受影响
+
+#define BLE_REMOTE_APP_ID       0x00a5  // 不能和HID(0x1812)与电池(0x180f)的重复
+#define BLE_REMOTE_BATCH_MAX    16      // 一个通知最多装的样本
+#define BLE_REMOTE_PERIOD_MIN   20      // 客户端能设的最短采样周期 ms
+
+// 服务 6e4a0001-5b1f-4f2c-9c1e-8d03a7b2c100 命令 ...0002 遥测 ...0003
+
+enum {
+    BLE_REMOTE_CMD_PLAY = 0x01,
+    BLE_REMOTE_CMD_PAUSE = 0x02,
+    BLE_REMOTE_CMD_RESUME = 0x03,
+    BLE_REMOTE_CMD_NEXT = 0x04,
+    BLE_REMOTE_CMD_PREV = 0x05,
+    BLE_REMOTE_CMD_SEEK = 0x06,         // u32 位置ms
+    BLE_REMOTE_CMD_VOLUME = 0x07,       // u8 0~100
+    BLE_REMOTE_CMD_VOLUME_UP = 0x08,
+    BLE_REMOTE_CMD_VOLUME_DOWN = 0x09,
+    BLE_REMOTE_CMD_PERIOD = 0x10,       // u16 采样周期ms u8 每批样本数 0为按MTU装满
+};
+
+// 通知的批头 一批里的样本都是同一个周期采的 批头加一个样本正好20字节 默认MTU也装得下
+typedef struct __attribute__((packed)) {
+    uint8_t seq;                        // 每个通知加一 手机端看有没有丢
+    uint8_t count;
+    uint16_t period_ms;
+    uint8_t play_state;                 // 0 停 1 播放 2 暂停 采最后一个样本时的
+    uint8_t volume;
+    uint32_t position_ms;
+} ble_remote_batch_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t heap_int_kb;               // 内部RAM剩余
+    uint16_t heap_int_block_kb;         // 内部RAM最大连续块
+    uint16_t heap_psram_kb;
+    uint8_t cpu[2];                     // 两个核这个周期的占用 百分比
+    uint8_t audio_fill;                 // PCM环形缓冲 百分比
+    uint8_t underruns;                  // 这个周期里缓冲取空的次数 封顶255
+} ble_remote_sample_t;
+
+typedef struct {
+    bool subscribed;
+    uint16_t period_ms;
+    uint16_t mtu;
+    uint32_t commands;                  // 执行了的命令
+    uint32_t rejected;                  // 操作码或者长度不对
+    uint32_t samples;
+    uint32_t notifies;
+    uint64_t bytes;                     // 通知的净荷
+    uint32_t dropped;                   // 拥塞或者发送失败丢掉的批
+    uint32_t sample_max_us;             // 采一个样本最长的时间
+} ble_remote_stats_t;
+
+esp_err_t ble_remote_attach(void);      // 起协议栈时在esp_hidd_register_callbacks之前调用
+void ble_remote_detach(void);           // 关协议栈之前调用 停采样
+void ble_remote_get_stats(ble_remote_stats_t *stats);
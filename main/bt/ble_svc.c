@@ -0,0 +1,342 @@
+#include <string.h>
+#include "ble_svc.h"
+#include "task_plan.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_hidd_prf_api.h"
+#include "hid_sched.h"
+#include "ble_remote.h"
+
+static const char *TAG = "ble_svc";
+
+// iPhone加密过程中不接受连接参数更新 所以参数由hid_sched在加密完成后申请
+// iPhone加密没完成就会写报告的CCCD 它的权限是加密写 报GATT_INSUF_ENCRYPTION可以不管
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ble_svc_stats_t s_stats;
+static bool s_want_adv;                 // 应用开着 没连的时候要广播
+static bool s_adv_ready;                // 广播数据设好了
+static bool s_classic_released;
+static bool s_linked;                   // 链路连着 不管加密没有
+static uint16_t s_conn_id;
+static int64_t s_conn_t0;
+
+static uint8_t s_service_uuid128[] = {
+    /* LSB <--------------------------------------------------------------------------------> MSB */
+    //first uuid, 16bit, [12],[13] is the value
+    0xfb, 0x34, 0x9b, 0x5f, 0x80, 0x00, 0x00, 0x80, 0x00, 0x10, 0x00, 0x00, 0x12, 0x18, 0x00, 0x00,
+};
+
+static esp_ble_adv_data_t s_adv_data = {
+    .set_scan_rsp = false,
+    .include_name = true,
+    .include_txpower = true,
+    .min_interval = 0x0006, // 从机希望的连接间隔 单位1.25ms
+    .max_interval = 0x0010,
+    .appearance = 0x03c0,   // HID Generic
+    .service_uuid_len = sizeof(s_service_uuid128),
+    .p_service_uuid = s_service_uuid128,
+    .flag = 0x6,
+};
+
+static esp_ble_adv_params_t s_adv_params = {
+    .adv_int_min = 0x20,
+    .adv_int_max = 0x30,
+    .adv_type = ADV_TYPE_IND,
+    .own_addr_type = BLE_ADDR_TYPE_PUBLIC,
+    .channel_map = ADV_CHNL_ALL,
+    .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
+};
+
+static void set_state(ble_svc_state_t state)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.state = state;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 应用开着 协议栈空着 广播数据也好了才开始广播
+static void adv_update(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool start = s_want_adv && s_adv_ready && !s_linked && s_stats.state == BLE_SVC_IDLE;
+    bool stop = !s_want_adv && s_stats.state == BLE_SVC_ADVERTISING;
+    portEXIT_CRITICAL(&s_lock);
+    if (start)
+    {
+        esp_ble_gap_start_advertising(&s_adv_params);
+    }
+    else if (stop)
+    {
+        esp_ble_gap_stop_advertising();
+    }
+}
+
+static void hidd_event_cb(esp_hidd_cb_event_t event, esp_hidd_cb_param_t *param)
+{
+    switch (event)
+    {
+    case ESP_HIDD_EVENT_REG_FINISH:
+        if (param->init_finish.state == ESP_HIDD_INIT_OK)
+        {
+            esp_ble_gap_set_device_name(BLE_SVC_DEVICE_NAME);
+            esp_ble_gap_config_adv_data(&s_adv_data);
+        }
+        break;
+    case ESP_HIDD_EVENT_BLE_CONNECT:
+        portENTER_CRITICAL(&s_lock);
+        s_conn_id = param->connect.conn_id;
+        s_conn_t0 = esp_timer_get_time();
+        s_linked = true;
+        s_stats.state = BLE_SVC_IDLE; // 连上广播就停了 加密完成才算CONNECTED
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "connected, conn_id %u", param->connect.conn_id);
+        break;
+    case ESP_HIDD_EVENT_BLE_DISCONNECT:
+        hid_sched_disconnected();
+        portENTER_CRITICAL(&s_lock);
+        s_linked = false;
+        s_stats.state = BLE_SVC_IDLE;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "disconnected");
+        adv_update();
+        break;
+    case ESP_HIDD_EVENT_BLE_REPORT_SENT_EVT:
+        hid_sched_sent(param->report_sent.status);
+        break;
+    case ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT:
+        ESP_LOG_BUFFER_HEX(TAG, param->led_write.data, param->led_write.length);
+        break;
+    default:
+        break;
+    }
+}
+
+static void gap_event_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    switch (event)
+    {
+    case ESP_GAP_BLE_ADV_DATA_SET_COMPLETE_EVT:
+        portENTER_CRITICAL(&s_lock);
+        s_adv_ready = true;
+        portEXIT_CRITICAL(&s_lock);
+        adv_update();
+        break;
+    case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+        if (param->adv_start_cmpl.status == ESP_BT_STATUS_SUCCESS)
+        {
+            set_state(BLE_SVC_ADVERTISING);
+            adv_update(); // 广播开起来之前应用可能已经关了
+        }
+        break;
+    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+        portENTER_CRITICAL(&s_lock);
+        if (s_stats.state == BLE_SVC_ADVERTISING)
+        {
+            s_stats.state = BLE_SVC_IDLE;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        adv_update();
+        break;
+    case ESP_GAP_BLE_SEC_REQ_EVT:
+        esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+        break;
+    case ESP_GAP_BLE_AUTH_CMPL_EVT: {
+        const esp_ble_auth_cmpl_t *auth = &param->ble_security.auth_cmpl;
+        if (!auth->success)
+        {
+            ESP_LOGE(TAG, "pairing failed, reason 0x%x", auth->fail_reason);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.auth_failed++;
+            portEXIT_CRITICAL(&s_lock);
+            break;
+        }
+        int bonded = esp_ble_get_bond_device_num();
+        portENTER_CRITICAL(&s_lock);
+        uint16_t conn_id = s_conn_id;
+        s_stats.state = BLE_SVC_CONNECTED;
+        s_stats.connects++;
+        s_stats.secure_ms = (esp_timer_get_time() - s_conn_t0) / 1000;
+        s_stats.bonded = bonded > 0 ? bonded : 0;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "encrypted %02x:%02x:%02x:%02x:%02x:%02x (addr type %d), %d bonded", auth->bd_addr[0],
+                 auth->bd_addr[1], auth->bd_addr[2], auth->bd_addr[3], auth->bd_addr[4], auth->bd_addr[5],
+                 auth->addr_type, bonded);
+        hid_sched_connected(conn_id, auth->bd_addr);
+        break;
+    }
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+        hid_sched_conn_params(param);
+        break;
+    default:
+        break;
+    }
+}
+
+static esp_err_t stack_start(void)
+{
+    esp_err_t ret = ESP_OK;
+    if (!s_classic_released)
+    {
+        // 只用BLE 经典蓝牙的内存开机后还一次
+        ESP_RETURN_ON_ERROR(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT), TAG, "release classic bt");
+        s_classic_released = true;
+    }
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_bt_controller_init(&bt_cfg), TAG, "controller init");
+    ESP_GOTO_ON_ERROR(esp_bt_controller_enable(ESP_BT_MODE_BLE), err_ctrl, TAG, "controller enable");
+    ESP_GOTO_ON_ERROR(esp_bluedroid_init(), err_ctrl_en, TAG, "bluedroid init");
+    ESP_GOTO_ON_ERROR(esp_bluedroid_enable(), err_bd, TAG, "bluedroid enable");
+    ESP_GOTO_ON_ERROR(esp_hidd_profile_init(), err_bd_en, TAG, "hid profile init");
+    esp_ble_gap_register_callback(gap_event_cb);
+#if CONFIG_APP_BLE_REMOTE
+    if (ble_remote_attach() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "remote service not added"); // HID照样能用
+    }
+#endif
+    esp_hidd_register_callbacks(hidd_event_cb);
+
+    // 绑定 没有输入输出能力 两边都分发加密和身份密钥 Bluedroid存进NVS
+    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_BOND;
+    esp_ble_io_cap_t iocap = ESP_IO_CAP_NONE;
+    uint8_t key_size = 16;
+    uint8_t init_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    uint8_t rsp_key = ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(uint8_t));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &iocap, sizeof(uint8_t));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(uint8_t));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_INIT_KEY, &init_key, sizeof(uint8_t));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_SET_RSP_KEY, &rsp_key, sizeof(uint8_t));
+    return ESP_OK;
+
+err_bd_en:
+    esp_bluedroid_disable();
+err_bd:
+    esp_bluedroid_deinit();
+err_ctrl_en:
+    esp_bt_controller_disable();
+err_ctrl:
+    esp_bt_controller_deinit();
+    return ret;
+}
+
+static void start_task(void *arg)
+{
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = stack_start();
+    int bonded = err == ESP_OK ? esp_ble_get_bond_device_num() : 0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.state = err == ESP_OK ? BLE_SVC_IDLE : BLE_SVC_OFF;
+    s_stats.starts += err == ESP_OK;
+    s_stats.start_ms = (esp_timer_get_time() - t0) / 1000;
+    s_stats.bonded = bonded > 0 ? bonded : 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "stack up in %lu ms, %d bonded", (unsigned long)s_stats.start_ms, bonded);
+        adv_update(); // 广播数据一般还没设好 设好了会再来
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t ble_svc_open(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    ble_svc_state_t state = s_stats.state;
+    s_want_adv = state != BLE_SVC_RELEASED;
+    s_stats.opens++;
+    if (state == BLE_SVC_OFF)
+    {
+        s_stats.state = BLE_SVC_STARTING;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (state == BLE_SVC_RELEASED)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (state != BLE_SVC_OFF)
+    {
+        adv_update();
+        return ESP_OK;
+    }
+    if (task_plan_create(TASK_BLE_START, start_task, NULL, NULL) != pdPASS)
+    {
+        set_state(BLE_SVC_OFF);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void ble_svc_close(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_want_adv = false;
+    portEXIT_CRITICAL(&s_lock);
+#if CONFIG_APP_BLE_RESIDENT
+    adv_update();
+#else
+    ble_svc_disable(false);
+#endif
+}
+
+esp_err_t ble_svc_disable(bool release_mem)
+{
+    portENTER_CRITICAL(&s_lock);
+    ble_svc_state_t state = s_stats.state;
+    s_want_adv = false;
+    portEXIT_CRITICAL(&s_lock);
+    if (state == BLE_SVC_STARTING)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (state != BLE_SVC_OFF && state != BLE_SVC_RELEASED)
+    {
+        hid_sched_disconnected();
+#if CONFIG_APP_BLE_REMOTE
+        ble_remote_detach();
+#endif
+        esp_hidd_profile_deinit();
+        vTaskDelay(pdMS_TO_TICKS(10)); // 让删服务的事件先跑完
+        esp_bluedroid_disable();
+        esp_bluedroid_deinit();
+        esp_bt_controller_disable();
+        esp_bt_controller_deinit();
+        portENTER_CRITICAL(&s_lock);
+        s_adv_ready = false;
+        s_linked = false;
+        s_stats.state = BLE_SVC_OFF;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    if (release_mem && state != BLE_SVC_RELEASED)
+    {
+        ESP_RETURN_ON_ERROR(esp_bt_controller_mem_release(ESP_BT_MODE_BTDM), TAG, "release controller memory");
+        set_state(BLE_SVC_RELEASED);
+        ESP_LOGI(TAG, "controller memory released");
+    }
+    return ESP_OK;
+}
+
+ble_svc_state_t ble_svc_state(void)
+{
+    return s_stats.state;
+}
+
+const char *ble_svc_state_name(ble_svc_state_t state)
+{
+    static const char *names[] = {"off", "starting", "idle", "advertising", "connected", "released"};
+    return state < sizeof(names) / sizeof(names[0]) ? names[state] : "?";
+}
+
+void ble_svc_get_stats(ble_svc_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 常驻的BLE服务 ****************************/
+// 第一次进蓝牙应用时在后台起控制器和Bluedroid 注册HID 以后离开应用不再拆 再进来马上能用
+// 进应用开始广播 离开停广播 已经连着的主机留着 按键调度那边没有按键会换成长间隔 不怎么费电
+// 配对是绑定的 Bluedroid自己把密钥存在NVS里 重启以后主机重连直接用存的密钥加密 不用再配对
+// CONFIG_APP_BLE_RESIDENT关掉时离开应用整个协议栈关掉 和以前一样
+// ble_svc_disable(true)关掉以后还把控制器的内存还给堆 这次开机就不能再开蓝牙了
+
+#define BLE_SVC_DEVICE_NAME     "HID"
+
+typedef enum {
+    BLE_SVC_OFF,                        // 协议栈没起
+    BLE_SVC_STARTING,                   // 后台在起
+    BLE_SVC_IDLE,                       // 起来了 不广播也没连
+    BLE_SVC_ADVERTISING,
+    BLE_SVC_CONNECTED,                  // 加密完成 可以发报告
+    BLE_SVC_RELEASED,                   // 控制器内存已经还了
+} ble_svc_state_t;
+
+typedef struct {
+    ble_svc_state_t state;
+    uint32_t starts;                    // 起协议栈的次数 常驻的话只有一次
+    uint32_t start_ms;                  // 最近一次起协议栈花的时间
+    uint32_t opens;                     // 进应用的次数
+    uint32_t connects;                  // 加密完成的连接
+    uint32_t secure_ms;                 // 最近一次从连上到加密完成 有绑定的话很快
+    uint32_t auth_failed;
+    uint32_t bonded;                    // NVS里绑定的设备数
+} ble_svc_stats_t;
+
+esp_err_t ble_svc_open(void);           // 进应用 不阻塞 没起就后台起 起来以后开始广播
+void ble_svc_close(void);               // 离开应用 停广播 不常驻的话关协议栈
+esp_err_t ble_svc_disable(bool release_mem);    // 整个关掉 release_mem为真连控制器内存也还掉
+ble_svc_state_t ble_svc_state(void);
+const char *ble_svc_state_name(ble_svc_state_t state);
+void ble_svc_get_stats(ble_svc_stats_t *stats);
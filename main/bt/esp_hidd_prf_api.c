@@ -43,9 +43,22 @@ esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks)
         return hidd_status;
     }
 
+    if(hidd_extra_app_id() != 0) {
+        hidd_status = esp_ble_gatts_app_register(hidd_extra_app_id());
+    }
+
     return hidd_status;
 }
 
+esp_err_t esp_hidd_add_gatts_app(uint16_t app_id, esp_gatts_cb_t cb)
+{
+    if(cb == NULL || app_id == 0 || app_id == HIDD_APP_ID || app_id == BATTRAY_APP_ID) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hidd_set_extra_app(app_id, cb);
+    return ESP_OK;
+}
+
 esp_err_t esp_hidd_profile_init(void)
 {
      if (hidd_le_env.enabled) {
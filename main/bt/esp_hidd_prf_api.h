@@ -9,6 +9,7 @@
 
 #include "esp_bt_defs.h"
 #include "esp_gatt_defs.h"
+#include "esp_gatts_api.h"
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -23,6 +24,7 @@ typedef enum {
     ESP_HIDD_EVENT_BLE_DISCONNECT,
     ESP_HIDD_EVENT_BLE_VENDOR_REPORT_WRITE_EVT,
     ESP_HIDD_EVENT_BLE_LED_REPORT_WRITE_EVT,
+    ESP_HIDD_EVENT_BLE_REPORT_SENT_EVT,     // 输入报告的通知已经交给链路层
 } esp_hidd_cb_event_t;
 
 /// HID config status
@@ -106,6 +108,14 @@ typedef union {
         uint8_t length;
         uint8_t *data;
     } led_write;
+
+    /**
+     * @brief ESP_HIDD_EVENT_BLE_REPORT_SENT_EVT
+     */
+    struct hidd_report_sent_evt_param {
+        uint16_t conn_id;
+        esp_gatt_status_t status;
+    } report_sent;
 } esp_hidd_cb_param_t;
 
 
@@ -129,6 +139,19 @@ typedef void (*esp_hidd_event_cb_t) (esp_hidd_cb_event_t event, esp_hidd_cb_para
  */
 esp_err_t esp_hidd_register_callbacks(esp_hidd_event_cb_t callbacks);
 
+/**
+ *
+ * @brief           再挂一个GATT应用 和HID共用协议栈唯一的GATTS回调 只收发给它自己gatts_if的事件
+ *                  要在esp_hidd_register_callbacks之前调用 重新起协议栈时会跟着HID一起注册
+ *
+ * @param[in]       app_id: 不能是0 也不能和HID与电池服务的重复
+ * @param[in]       cb: GATTS事件回调
+ *
+ * @return          ESP_OK - success, other - failed
+ *
+ */
+esp_err_t esp_hidd_add_gatts_app(uint16_t app_id, esp_gatts_cb_t cb);
+
 /**
  *
  * @brief           This function is called to initialize hid device profile
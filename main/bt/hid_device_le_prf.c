@@ -192,8 +192,9 @@ enum
 
 #define HI_UINT16(a) (((a) >> 8) & 0xFF)
 #define LO_UINT16(a) ((a) & 0xFF)
-#define PROFILE_NUM            1
+#define PROFILE_NUM            2
 #define PROFILE_APP_IDX        0
+#define PROFILE_EXTRA_IDX      1    // 和HID一起挂的自定义服务
 
 struct gatts_profile_inst {
     esp_gatts_cb_t gatts_cb;
@@ -560,6 +561,12 @@ void esp_hidd_prf_cb_hdl(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
             break;
         }
         case ESP_GATTS_CONF_EVT: {
+            if(gatts_if == hidd_le_env.gatt_if && hidd_le_env.hidd_cb != NULL) {
+                esp_hidd_cb_param_t cb_param = {0};
+                cb_param.report_sent.conn_id = param->conf.conn_id;
+                cb_param.report_sent.status = param->conf.status;
+                (hidd_le_env.hidd_cb)(ESP_HIDD_EVENT_BLE_REPORT_SENT_EVT, &cb_param);
+            }
             break;
         }
         case ESP_GATTS_CREATE_EVT:
@@ -684,7 +691,9 @@ static struct gatts_profile_inst heart_rate_profile_tab[PROFILE_NUM] = {
         .gatts_cb = esp_hidd_prf_cb_hdl,
         .gatts_if = ESP_GATT_IF_NONE,       /* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
     },
-
+    [PROFILE_EXTRA_IDX] = {
+        .gatts_if = ESP_GATT_IF_NONE,
+    },
 };
 
 static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_if,
@@ -693,7 +702,10 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
     /* If event is register event, store the gatts_if for each profile */
     if (event == ESP_GATTS_REG_EVT) {
         if (param->reg.status == ESP_GATT_OK) {
-            heart_rate_profile_tab[PROFILE_APP_IDX].gatts_if = gatts_if;
+            // 自定义服务的app_id单独记 其他的照旧都算HID的
+            int idx = heart_rate_profile_tab[PROFILE_EXTRA_IDX].gatts_cb &&
+                      param->reg.app_id == heart_rate_profile_tab[PROFILE_EXTRA_IDX].app_id ? PROFILE_EXTRA_IDX : PROFILE_APP_IDX;
+            heart_rate_profile_tab[idx].gatts_if = gatts_if;
         } else {
             ESP_LOGI(HID_LE_PRF_TAG, "Reg app failed, app_id %04x, status %d\n",
                     param->reg.app_id,
@@ -723,6 +735,18 @@ esp_err_t hidd_register_cb(void)
 	return status;
 }
 
+void hidd_set_extra_app(uint16_t app_id, esp_gatts_cb_t cb)
+{
+    heart_rate_profile_tab[PROFILE_EXTRA_IDX].app_id = app_id;
+    heart_rate_profile_tab[PROFILE_EXTRA_IDX].gatts_cb = cb;
+    heart_rate_profile_tab[PROFILE_EXTRA_IDX].gatts_if = ESP_GATT_IF_NONE;
+}
+
+uint16_t hidd_extra_app_id(void)
+{
+    return heart_rate_profile_tab[PROFILE_EXTRA_IDX].gatts_cb ? heart_rate_profile_tab[PROFILE_EXTRA_IDX].app_id : 0;
+}
+
 void hidd_set_attr_value(uint16_t handle, uint16_t val_len, const uint8_t *value)
 {
     hidd_inst_t *hidd_inst = &hidd_le_env.hidd_inst;
@@ -0,0 +1,346 @@
+#include <string.h>
+#include "hid_sched.h"
+#include "esp_hidd_prf_api.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "hid_sched";
+
+#define SCHED_INFLIGHT          4       // 交给协议栈还没CONF的 只用来算延迟
+
+typedef struct {
+    uint8_t state;                      // 按着的键 0是都松开了
+    int64_t t_in;
+} sched_item_t;
+
+typedef struct {
+    int64_t t_in;
+    bool mouse;
+} sched_inflight_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static hid_sched_stats_t s_stats;
+static esp_timer_handle_t s_flush_timer;
+static esp_timer_handle_t s_idle_timer;
+
+// 下面的都在s_lock里改
+static bool s_conn;
+static uint16_t s_conn_id;
+static esp_bd_addr_t s_bda;
+static int64_t s_conn_t0;
+static sched_item_t s_queue[HID_SCHED_QUEUE];
+static int s_head;
+static int s_count;
+static uint8_t s_last;                  // 最后一个排进队或者发出去的状态
+static int64_t s_next_us;               // 这之前不发下一个
+static sched_inflight_t s_inflight[SCHED_INFLIGHT];
+static int s_if_head;
+static int s_if_count;
+static int32_t s_mdx;                   // 还没发的鼠标位移
+static int32_t s_mdy;
+static uint8_t s_mbtn;
+static uint8_t s_mbtn_sent;
+static int64_t s_mt_in;                 // 没发的位移里最早的样本时刻 0表示没有
+
+static int64_t interval_us(void)
+{
+    // 还不知道间隔时按最短的算 宁可多发不要拖
+    return (s_stats.interval ? s_stats.interval : HID_SCHED_FAST_MIN) * 1250;
+}
+
+static void timer_restart(esp_timer_handle_t timer, int64_t us)
+{
+    esp_timer_stop(timer);
+    esp_timer_start_once(timer, us > 0 ? us : 1);
+}
+
+static void request_params(bool fast)
+{
+    esp_ble_conn_update_params_t p = {
+        .min_int = fast ? HID_SCHED_FAST_MIN : HID_SCHED_SLOW_MIN,
+        .max_int = fast ? HID_SCHED_FAST_MAX : HID_SCHED_SLOW_MAX,
+        .latency = fast ? 0 : HID_SCHED_SLOW_LATENCY,
+        .timeout = HID_SCHED_TIMEOUT,
+    };
+    portENTER_CRITICAL(&s_lock);
+    bool conn = s_conn;
+    memcpy(p.bda, s_bda, sizeof(p.bda));
+    s_stats.fast = fast;
+    portEXIT_CRITICAL(&s_lock);
+    if (conn && esp_ble_gap_update_conn_params(&p) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "conn params update not sent");
+    }
+}
+
+static inline int8_t clamp8(int32_t v)
+{
+    return v > 127 ? 127 : v < -127 ? -127 : v;
+}
+
+static inline bool mouse_pending(void)
+{
+    return s_mdx || s_mdy || s_mbtn != s_mbtn_sent;
+}
+
+static void inflight_push(int64_t t_in, bool mouse)
+{
+    if (s_if_count == SCHED_INFLIGHT)
+    {
+        s_if_head = (s_if_head + 1) % SCHED_INFLIGHT; // 很久没CONF 丢掉最老的
+        s_if_count--;
+    }
+    s_inflight[(s_if_head + s_if_count++) % SCHED_INFLIGHT] = (sched_inflight_t){t_in, mouse};
+}
+
+// 到点了就发一个 按键队头优先 没有按键发攒着的鼠标位移 后面还有的话定时器等下一个间隔
+static void pump(void)
+{
+    int64_t now = esp_timer_get_time();
+    int kind = 0; // 1按键 2鼠标
+    uint8_t state = 0;
+    int8_t mx = 0, my = 0;
+    uint16_t conn_id = 0;
+    int64_t wait = 0;
+    portENTER_CRITICAL(&s_lock);
+    if (s_conn && (s_count > 0 || mouse_pending()))
+    {
+        if (now >= s_next_us)
+        {
+            conn_id = s_conn_id;
+            s_next_us = now + interval_us();
+            if (s_count > 0)
+            {
+                sched_item_t it = s_queue[s_head];
+                s_head = (s_head + 1) % HID_SCHED_QUEUE;
+                s_count--;
+                state = it.state;
+                kind = 1;
+                inflight_push(it.t_in, false);
+                s_stats.sent++;
+            }
+            else
+            {
+                mx = clamp8(s_mdx);
+                my = clamp8(s_mdy);
+                s_mdx -= mx;
+                s_mdy -= my;
+                state = s_mbtn;
+                s_mbtn_sent = s_mbtn;
+                kind = 2;
+                inflight_push(s_mt_in, true);
+                s_mt_in = mouse_pending() ? now : 0; // 剩下的算成这一刻的
+                s_stats.mouse_reports++;
+            }
+        }
+        wait = s_count > 0 || mouse_pending() ? s_next_us - now : 0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (kind == 1)
+    {
+        esp_hidd_send_consumer_value(conn_id, state, state != 0);
+    }
+    else if (kind == 2)
+    {
+        esp_hidd_send_mouse_value(conn_id, state, mx, my);
+    }
+    if (wait > 0)
+    {
+        timer_restart(s_flush_timer, wait);
+    }
+}
+
+static void flush_cb(void *arg)
+{
+    pump();
+}
+
+static void idle_cb(void *arg)
+{
+    request_params(false);
+}
+
+void hid_sched_connected(uint16_t conn_id, const esp_bd_addr_t bda)
+{
+    if (s_flush_timer == NULL)
+    {
+        const esp_timer_create_args_t flush_args = {.callback = flush_cb, .name = "hid_flush"};
+        const esp_timer_create_args_t idle_args = {.callback = idle_cb, .name = "hid_idle"};
+        if (esp_timer_create(&flush_args, &s_flush_timer) != ESP_OK ||
+            esp_timer_create(&idle_args, &s_idle_timer) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "no timers, reports not scheduled");
+            return;
+        }
+    }
+    esp_gap_conn_params_t cur = {0};
+    esp_ble_get_current_conn_params((uint8_t *)bda, &cur);
+    portENTER_CRITICAL(&s_lock);
+    s_conn = true;
+    s_conn_id = conn_id;
+    memcpy(s_bda, bda, sizeof(s_bda));
+    s_conn_t0 = esp_timer_get_time();
+    s_head = s_count = s_if_head = s_if_count = 0;
+    s_last = 0;
+    s_mdx = s_mdy = 0;
+    s_mbtn = s_mbtn_sent = 0;
+    s_mt_in = 0;
+    s_next_us = 0;
+    s_stats.interval = cur.interval;
+    s_stats.latency = cur.latency;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "connected, interval %u x 1.25 ms, latency %u", cur.interval, cur.latency);
+    request_params(true);
+    timer_restart(s_idle_timer, HID_SCHED_IDLE_MS * 1000LL);
+}
+
+void hid_sched_disconnected(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_conn)
+    {
+        s_stats.connected_us += esp_timer_get_time() - s_conn_t0;
+    }
+    s_conn = false;
+    s_count = s_if_count = 0;
+    s_stats.interval = 0;
+    s_stats.latency = 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (s_flush_timer)
+    {
+        esp_timer_stop(s_flush_timer);
+        esp_timer_stop(s_idle_timer);
+    }
+}
+
+void hid_sched_consumer(uint8_t key_cmd, bool pressed)
+{
+    uint8_t state = pressed ? key_cmd : 0;
+    int64_t now = esp_timer_get_time();
+    bool queued = false;
+    bool wake = false;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.inputs++;
+    if (s_conn && state == s_last)
+    {
+        s_stats.coalesced++;
+    }
+    else if (s_conn) // 没连或者还没加密的和原来一样不发
+    {
+        if (s_count == HID_SCHED_QUEUE)
+        {
+            s_queue[(s_head + s_count - 1) % HID_SCHED_QUEUE] = (sched_item_t){state, now};
+            s_stats.overflow++;
+        }
+        else
+        {
+            s_queue[(s_head + s_count++) % HID_SCHED_QUEUE] = (sched_item_t){state, now};
+        }
+        s_stats.deferred += s_count > 1 || now < s_next_us;
+        s_last = state;
+        queued = true;
+        wake = !s_stats.fast;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!queued)
+    {
+        return;
+    }
+    pump();
+    if (wake)
+    {
+        request_params(true);
+    }
+    timer_restart(s_idle_timer, HID_SCHED_IDLE_MS * 1000LL);
+}
+
+void hid_sched_mouse(int dx, int dy, uint8_t buttons, int64_t t_sample)
+{
+    bool queued = false;
+    bool wake = false;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.mouse_inputs++;
+    if (s_conn && (dx || dy || buttons != s_mbtn))
+    {
+        s_mdx += dx;
+        s_mdy += dy;
+        s_mbtn = buttons;
+        if (s_mt_in == 0)
+        {
+            s_mt_in = t_sample;
+        }
+        queued = true;
+        wake = !s_stats.fast;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!queued)
+    {
+        return;
+    }
+    pump();
+    if (wake)
+    {
+        request_params(true);
+    }
+    timer_restart(s_idle_timer, HID_SCHED_IDLE_MS * 1000LL);
+}
+
+void hid_sched_sent(esp_gatt_status_t status)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (s_if_count > 0)
+    {
+        sched_inflight_t it = s_inflight[s_if_head];
+        uint32_t us = now - it.t_in;
+        s_if_head = (s_if_head + 1) % SCHED_INFLIGHT;
+        s_if_count--;
+        if (status == ESP_GATT_OK && it.mouse)
+        {
+            s_stats.mouse_done++;
+            s_stats.mouse_latency_us += us;
+            s_stats.mouse_latency_max_us = us > s_stats.mouse_latency_max_us ? us : s_stats.mouse_latency_max_us;
+        }
+        else if (status == ESP_GATT_OK)
+        {
+            s_stats.done++;
+            s_stats.latency_us += us;
+            s_stats.latency_max_us = us > s_stats.latency_max_us ? us : s_stats.latency_max_us;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void hid_sched_conn_params(const esp_ble_gap_cb_param_t *param)
+{
+    const struct ble_update_conn_params_evt_param *p = &param->update_conn_params;
+    portENTER_CRITICAL(&s_lock);
+    if (p->status == ESP_BT_STATUS_SUCCESS)
+    {
+        s_stats.param_updates++;
+        if (s_conn)
+        {
+            s_stats.interval = p->conn_int;
+            s_stats.latency = p->latency;
+        }
+    }
+    else
+    {
+        s_stats.param_failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "conn params status %d, interval %u x 1.25 ms, latency %u, timeout %u", p->status, p->conn_int,
+             p->latency, p->timeout);
+}
+
+void hid_sched_get_stats(hid_sched_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    if (s_conn)
+    {
+        stats->connected_us += esp_timer_get_time() - s_conn_t0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_bt_defs.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gatt_defs.h"
+
+
+/*********************** BLE HID报告调度 ****************************/
+// 按键只报状态变化 按住时LVGL每个周期的PRESSING不再各发一个通知 和上一个一样的直接合并掉
+// 不同的状态按顺序排队 每个连接间隔最多发一个 主机在一个连接事件里只会收到最新的一个 不会积压
+// 上一个发出去已经过了一个间隔的 新的马上发 不等定时器 按下去的第一个报告没有额外延迟
+// 配对加密完成后申请短连接间隔 一段时间没有按键换成长间隔加从机延迟 省主机和自己的电
+// 又有按键先照常发 同时申请回短间隔 从机延迟下外设在下一个连接事件就能发 不用等从机延迟跳过的那些
+// iPhone加密过程中不接受参数更新 所以只在加密完成以后申请
+//
+// 鼠标的位移先累加 和排队的按键一样每个连接间隔最多发一个报告 一个报告装不下的留到下一个
+// 按键状态排在前面先发 鼠标报告里的按钮状态也只在变了的时候才单独发
+// 延迟从LVGL按键事件算到协议栈报告通知已经交给链路层(GATTS CONF) 上空中还要等到下一个连接事件 最多一个间隔
+
+#define HID_SCHED_QUEUE         8       // 排队的不同状态 满了覆盖最后一个
+#define HID_SCHED_IDLE_MS       3000    // 这么久没有按键换成长间隔
+#define HID_SCHED_FAST_MIN      6       // 7.5ms 单位1.25ms
+#define HID_SCHED_FAST_MAX      12      // 15ms
+#define HID_SCHED_SLOW_MIN      24      // 30ms
+#define HID_SCHED_SLOW_MAX      40      // 50ms
+#define HID_SCHED_SLOW_LATENCY  4       // 长间隔时没数据可以跳过的连接事件
+#define HID_SCHED_TIMEOUT       400     // 监督超时 单位10ms
+
+typedef struct {
+    uint32_t inputs;                    // hid_sched_consumer的次数 包括重复的
+    uint32_t coalesced;                 // 和上一个状态一样 没发
+    uint32_t overflow;                  // 队列满了覆盖掉的
+    uint32_t sent;                      // 交给协议栈的通知
+    uint32_t deferred;                  // 等到下一个连接间隔才发的
+    uint32_t done;                      // 协议栈报告交给链路层的
+    uint64_t latency_us;                // 按键到交给链路层 done个加起来
+    uint32_t latency_max_us;
+    uint64_t connected_us;              // 加密连着的总时间 算通知频率
+    uint16_t interval;                  // 现在的连接间隔 单位1.25ms 没连是0
+    uint16_t latency;                   // 现在的从机延迟
+    bool fast;                          // 现在申请的是短间隔
+    uint32_t mouse_inputs;              // hid_sched_mouse的次数
+    uint32_t mouse_reports;
+    uint32_t mouse_done;
+    uint64_t mouse_latency_us;          // 采样时刻到交给链路层 mouse_done个加起来
+    uint32_t mouse_latency_max_us;
+    uint32_t param_updates;             // 协商下来的
+    uint32_t param_failed;
+} hid_sched_stats_t;
+
+void hid_sched_connected(uint16_t conn_id, const esp_bd_addr_t bda);   // 加密完成 可以发报告了
+void hid_sched_disconnected(void);      // 断开或者关蓝牙 丢掉排队的
+void hid_sched_consumer(uint8_t key_cmd, bool pressed);     // 多媒体键的状态 不阻塞 哪个任务都能调
+// 鼠标相对位移和按钮 t_sample是这段位移里最早那个传感器样本的时刻 用来算延迟
+void hid_sched_mouse(int dx, int dy, uint8_t buttons, int64_t t_sample);
+void hid_sched_sent(esp_gatt_status_t status);  // GATTS CONF事件里调用
+void hid_sched_conn_params(const esp_ble_gap_cb_param_t *param);   // ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT里调用
+void hid_sched_get_stats(hid_sched_stats_t *stats);
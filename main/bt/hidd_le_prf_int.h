@@ -331,5 +331,9 @@ void hidd_get_attr_value(uint16_t handle, uint16_t *length, uint8_t **value);
 
 esp_err_t hidd_register_cb(void);
 
+void hidd_set_extra_app(uint16_t app_id, esp_gatts_cb_t cb);
+
+uint16_t hidd_extra_app_id(void);
+
 
 #endif  ///__HID_DEVICE_LE_PRF__
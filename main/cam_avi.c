@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "cam_avi.h"
+#include "task_plan.h"
+#include "esp32_s3_szp.h"
+#include "sd_writer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lvgl.h"
+
+static const char *TAG = "cam_avi";
+
+#define AVI_HEADER_BYTES    512         // 头用JUNK补满一个扇区 movi的数据从扇区边界开始
+#define AVI_MOVI_OFFSET     (AVI_HEADER_BYTES - 4)  // 'movi'四个字母所在的位置 idx1的偏移从这里算
+
+typedef struct {
+    uint32_t offset;                    // 块头相对'movi'的偏移
+    uint32_t size;
+} avi_index_t;
+
+static sd_writer_t *s_writer;
+static char s_path[128];
+static uint16_t s_width;
+static uint16_t s_height;
+static uint8_t *s_ring;
+static uint8_t *s_block;                // 拼文件头和idx1用
+static avi_index_t *s_index;
+static uint32_t s_head;                 // 环的写入和写盘 都是一直往上加的字节数
+static uint32_t s_tail;
+static uint32_t s_movi_bytes;           // 已经排进环的movi数据 就是下一块的偏移
+static uint32_t s_max_chunk;
+static int64_t s_t_first;
+static int64_t s_t_last;
+static volatile bool s_stopping;
+static volatile bool s_write_failed;
+static bool s_active;
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_done;
+static cam_avi_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void put16(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static uint8_t *put_fourcc(uint8_t *p, const char *cc, uint32_t size)
+{
+    memcpy(p, cc, 4);
+    put32(p + 4, size);
+    return p + 8;
+}
+
+// RIFF hdrl(avih strl(strh strf)) JUNK LIST movi 停止时按实际帧数再写一遍
+static void avi_build_header(uint8_t *h, uint32_t frames, uint32_t us_per_frame, uint32_t riff_size)
+{
+    memset(h, 0, AVI_HEADER_BYTES);
+    uint32_t fps1000 = us_per_frame ? 1000000000ULL / us_per_frame : 15000;
+    uint8_t *p = h;
+    p = put_fourcc(p, "RIFF", riff_size);
+    memcpy(p, "AVI ", 4);
+    p += 4;
+    p = put_fourcc(p, "LIST", 4 + 64 + 12 + 64 + 48);
+    memcpy(p, "hdrl", 4);
+    p += 4;
+
+    p = put_fourcc(p, "avih", 56);
+    put32(p + 0, us_per_frame);
+    put32(p + 4, (uint64_t)s_max_chunk * fps1000 / 1000);
+    put32(p + 12, 0x10);                // AVIF_HASINDEX
+    put32(p + 16, frames);
+    put32(p + 24, 1);                   // 一路视频
+    put32(p + 28, s_max_chunk);
+    put32(p + 32, s_width);
+    put32(p + 36, s_height);
+    p += 56;
+
+    p = put_fourcc(p, "LIST", 4 + 64 + 48);
+    memcpy(p, "strl", 4);
+    p += 4;
+    p = put_fourcc(p, "strh", 56);
+    memcpy(p + 0, "vids", 4);
+    memcpy(p + 4, "MJPG", 4);
+    put32(p + 20, 1000);                // scale 帧率是rate/scale
+    put32(p + 24, fps1000);
+    put32(p + 32, frames);
+    put32(p + 36, s_max_chunk);
+    put32(p + 40, 0xFFFFFFFF);          // quality 默认
+    put16(p + 52, s_width);
+    put16(p + 54, s_height);
+    p += 56;
+    p = put_fourcc(p, "strf", 40);
+    put32(p + 0, 40);
+    put32(p + 4, s_width);
+    put32(p + 8, s_height);
+    put16(p + 12, 1);
+    put16(p + 14, 24);
+    memcpy(p + 16, "MJPG", 4);
+    put32(p + 20, s_width * s_height * 3);
+    p += 40;
+
+    // 剩下的补JUNK 最后12字节是movi的LIST头
+    uint32_t junk = AVI_HEADER_BYTES - 12 - (p - h) - 8;
+    p = put_fourcc(p, "JUNK", junk);
+    p += junk;
+    p = put_fourcc(p, "LIST", s_movi_bytes);     // s_movi_bytes里已经算了'movi'
+    memcpy(p, "movi", 4);
+}
+
+static void ring_write(uint32_t pos, const uint8_t *src, uint32_t n)
+{
+    uint32_t off = pos % CAM_AVI_RING_BYTES;
+    uint32_t first = LV_MIN(n, CAM_AVI_RING_BYTES - off);
+    memcpy(s_ring + off, src, first);
+    memcpy(s_ring, src + first, n - first);
+}
+
+static void avi_task(void *arg)
+{
+    for (;;)
+    {
+        portENTER_CRITICAL(&s_lock);
+        uint32_t avail = s_head - s_tail;
+        portEXIT_CRITICAL(&s_lock);
+        bool stopping = s_stopping;
+        // 平时只写整块 停止时才写最后不满的一块
+        if (avail < CAM_AVI_WRITE_BYTES && !(stopping && avail))
+        {
+            if (stopping)
+            {
+                break;
+            }
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+            continue;
+        }
+        // 环里的数据直接交给写卡模块 回绕的话分两段
+        uint32_t n = LV_MIN(avail, CAM_AVI_WRITE_BYTES);
+        uint32_t off = s_tail % CAM_AVI_RING_BYTES;
+        uint32_t first = LV_MIN(n, CAM_AVI_RING_BYTES - off);
+        int64_t t0 = esp_timer_get_time();
+        bool ok = !s_write_failed && sd_writer_write(s_writer, s_ring + off, first) == ESP_OK &&
+                  sd_writer_write(s_writer, s_ring, n - first) == ESP_OK;
+        uint32_t us = esp_timer_get_time() - t0;
+        if (!ok && !s_write_failed)
+        {
+            ESP_LOGE(TAG, "write failed at %lu bytes", (unsigned long)s_stats.bytes);
+            s_write_failed = true;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_tail += n;
+        if (ok)
+        {
+            s_stats.bytes += n;
+            s_stats.write_us += us;
+            if (us > s_stats.max_write_us)
+            {
+                s_stats.max_write_us = us;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void avi_free(void)
+{
+    heap_caps_free(s_ring);
+    heap_caps_free(s_block);
+    heap_caps_free(s_index);
+    s_ring = NULL;
+    s_block = NULL;
+    s_index = NULL;
+    if (s_done)
+    {
+        vSemaphoreDelete(s_done);
+        s_done = NULL;
+    }
+}
+
+esp_err_t cam_avi_start(uint16_t width, uint16_t height)
+{
+    ESP_RETURN_ON_FALSE(!s_active, ESP_ERR_INVALID_STATE, TAG, "already recording");
+    s_ring = heap_caps_malloc(CAM_AVI_RING_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_block = heap_caps_malloc(CAM_AVI_WRITE_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_index = heap_caps_malloc(CAM_AVI_MAX_FRAMES * sizeof(avi_index_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_done = xSemaphoreCreateBinary();
+    if (!s_ring || !s_block || !s_index || !s_done)
+    {
+        avi_free();
+        ESP_LOGE(TAG, "recorder buffers alloc failed");
+        return ESP_ERR_NO_MEM;
+    }
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    snprintf(s_path, sizeof(s_path), "%s/vid_%02d%02d_%02d%02d%02d.avi", PHOTO_SAVE_PATH, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    // 预分配 录的时候FATFS不再查找空簇
+    int64_t t0 = esp_timer_get_time();
+    s_writer = sd_writer_open(s_path, CAM_AVI_PREALLOC_BYTES);
+    if (s_writer == NULL)
+    {
+        avi_free();
+        ESP_LOGE(TAG, "open %s failed", s_path);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "%s: opened with %d MB preallocated in %lu ms", s_path, CONFIG_APP_AVI_PREALLOC_MB,
+             (unsigned long)(esp_timer_get_time() - t0) / 1000);
+
+    s_width = width;
+    s_height = height;
+    s_head = 0;
+    s_tail = 0;
+    s_movi_bytes = 4;                   // 'movi'本身
+    s_max_chunk = 0;
+    s_stopping = false;
+    s_write_failed = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+    avi_build_header(s_block, 0, 0, 0);
+    if (sd_writer_write(s_writer, s_block, AVI_HEADER_BYTES) != ESP_OK ||
+        task_plan_create(TASK_CAM_AVI, avi_task, NULL, &s_task) != pdPASS)
+    {
+        sd_writer_abort(s_writer);
+        s_writer = NULL;
+        avi_free();
+        ESP_LOGE(TAG, "start %s failed", s_path);
+        return ESP_FAIL;
+    }
+    s_active = true;
+    return ESP_OK;
+}
+
+bool cam_avi_active(void)
+{
+    return s_active;
+}
+
+bool cam_avi_frame(const camera_fb_t *frame)
+{
+    if (!s_active || frame->format != PIXFORMAT_JPEG)
+    {
+        return false;
+    }
+    uint32_t len = frame->len;
+    uint32_t chunk = 8 + len + (len & 1);
+    portENTER_CRITICAL(&s_lock);
+    uint32_t used = s_head - s_tail;
+    bool fits = !s_write_failed && s_stats.frames < CAM_AVI_MAX_FRAMES && used + chunk <= CAM_AVI_RING_BYTES;
+    if (!fits)
+    {
+        s_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!fits)
+    {
+        return false;
+    }
+
+    uint8_t hdr[8];
+    memcpy(hdr, "00dc", 4);
+    put32(hdr + 4, len);
+    uint32_t pos = s_head;
+    ring_write(pos, hdr, 8);
+    ring_write(pos + 8, frame->buf, len);
+    if (len & 1)
+    {
+        ring_write(pos + 8 + len, (const uint8_t *)"", 1);
+    }
+    avi_index_t *idx = &s_index[s_stats.frames];
+    idx->offset = s_movi_bytes;
+    idx->size = len;
+    s_movi_bytes += chunk;
+    s_max_chunk = LV_MAX(s_max_chunk, len);
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_head = pos + chunk;
+    if (s_stats.frames++ == 0)
+    {
+        s_t_first = now;
+    }
+    s_t_last = now;
+    s_stats.duration_us = s_t_last - s_t_first;
+    if (used + chunk > s_stats.ring_peak)
+    {
+        s_stats.ring_peak = used + chunk;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (used + chunk >= CAM_AVI_WRITE_BYTES)
+    {
+        xTaskNotifyGive(s_task);
+    }
+    return true;
+}
+
+esp_err_t cam_avi_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_active, ESP_ERR_INVALID_STATE, TAG, "not recording");
+    s_stopping = true;
+    xTaskNotifyGive(s_task);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    s_active = false;
+
+    // idx1跟在movi后面 分块拼进块缓冲写
+    uint32_t frames = s_stats.frames;
+    bool ok = !s_write_failed;
+    uint8_t *p = s_block;
+    p = put_fourcc(p, "idx1", frames * 16);
+    for (uint32_t i = 0; ok && i < frames; i++)
+    {
+        memcpy(p, "00dc", 4);
+        put32(p + 4, 0x10);             // AVIIF_KEYFRAME 每帧都是完整的JPEG
+        put32(p + 8, s_index[i].offset);
+        put32(p + 12, s_index[i].size);
+        p += 16;
+        if (p + 16 > s_block + CAM_AVI_WRITE_BYTES || i + 1 == frames)
+        {
+            ok = sd_writer_write(s_writer, s_block, p - s_block) == ESP_OK;
+            p = s_block;
+        }
+    }
+    if (ok && frames == 0)
+    {
+        ok = sd_writer_write(s_writer, s_block, 8) == ESP_OK;
+    }
+    uint32_t file_size = AVI_MOVI_OFFSET + s_movi_bytes + 8 + frames * 16;
+    uint32_t us_per_frame = frames > 1 ? s_stats.duration_us / (frames - 1) : 0;
+    avi_build_header(s_block, frames, us_per_frame, file_size - 8);
+    ok = ok && sd_writer_write_at(s_writer, 0, s_block, AVI_HEADER_BYTES) == ESP_OK;
+    // 关闭时截掉预分配多出来的 也会报告目录变了 录的时候列过目录的话 大小还是预分配的
+    ok = sd_writer_close(s_writer) == ESP_OK && ok;
+    s_writer = NULL;
+    avi_free();
+    ESP_LOGI(TAG, "%s: %lu frames, %lu KB %s", s_path, (unsigned long)frames, (unsigned long)file_size / 1024,
+             ok ? "saved" : "incomplete");
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+void cam_avi_get_stats(cam_avi_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
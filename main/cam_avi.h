@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+
+
+/*********************** MJPEG录像 ****************************/
+// 摄像头的JPEG帧原样当作AVI的00dc块 取帧任务只把块拷进PSRAM里的环形缓冲
+// core 0上的写盘任务攒够一块就交给写卡模块(sd_writer) 它按整块从DMA缓冲写
+// 开始录就预分配 FATFS提前把簇链好 录的时候不再查找空簇 停止时补上idx1和头 截掉多余的
+// 环里放不下的帧丢掉计数 不会卡住取帧
+
+#define CAM_AVI_RING_BYTES      (CONFIG_APP_AVI_RING_KB * 1024)
+#define CAM_AVI_WRITE_BYTES     (CONFIG_APP_AVI_WRITE_KB * 1024)
+#define CAM_AVI_PREALLOC_BYTES  (CONFIG_APP_AVI_PREALLOC_MB * 1024 * 1024)
+#define CAM_AVI_MAX_FRAMES      (CONFIG_APP_AVI_MAX_SECONDS * 30)   // idx1表按30fps留
+
+typedef struct {
+    uint32_t frames;                    // 录进去的
+    uint32_t dropped;                   // 环满了或者超过最大帧数丢掉的
+    uint64_t bytes;                     // 写进文件的
+    uint64_t write_us;                  // 交给写卡模块花的时间 两块缓冲都在写时包括等待
+    uint32_t max_write_us;              // 最慢的一次
+    uint32_t ring_peak;                 // 环里最多积压的字节
+    int64_t duration_us;                // 第一帧到最后一帧
+} cam_avi_stats_t;
+
+esp_err_t cam_avi_start(uint16_t width, uint16_t height);  // 在PHOTO_SAVE_PATH下新建vid_MMDD_HHMMSS.avi
+bool cam_avi_active(void);
+bool cam_avi_frame(const camera_fb_t *frame);   // 取帧任务里调用 只收JPEG 拷完就返回
+esp_err_t cam_avi_stop(void);           // 把环里的写完 补索引和头 会阻塞
+void cam_avi_get_stats(cam_avi_stats_t *stats); // 录的时候也可以调用 看实时的数字
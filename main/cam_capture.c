@@ -0,0 +1,419 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "cam_capture.h"
+#include "task_plan.h"
+#include "pic_rgb565.h"
+#include "esp32_s3_szp.h"
+#include "lcd_draw.h"
+#include "sd_writer.h"
+#include "gallery_index.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "cam_capture";
+
+#define CAPTURE_QUIT        (-1)
+#define CAPTURE_BMP_ROWS    16          // 320宽时一块15KB 正好30个扇区
+#define CAPTURE_BMP_OFFSET  512         // 文件头补到一个扇区
+
+#if CONFIG_APP_CAMERA_SAVE_RGB565
+#define CAPTURE_EXT PIC_RGB565_EXT
+#else
+#define CAPTURE_EXT "bmp"
+#endif
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+    pixformat_t format;
+    time_t when;
+    int64_t t_submit;
+} capture_slot_t;
+
+static capture_slot_t s_slots[CAM_CAPTURE_SLOTS];
+static QueueHandle_t s_free_q;          // 空槽位的下标
+static QueueHandle_t s_write_q;         // 等着写盘的下标 CAPTURE_QUIT让任务退出
+static SemaphoreHandle_t s_done;
+static bool s_running;
+static int s_burst_left;                // 这次连拍还要几帧
+static int s_burst_got;
+static int s_burst_dropped;
+static int64_t s_burst_t0;              // 第一帧和最近一帧拷进来的时刻
+static int64_t s_burst_t1;
+static cam_capture_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// JPEG模式的帧本身就是文件 原样写
+static bool save_raw(const char *path, const capture_slot_t *slot)
+{
+    sd_writer_t *w = sd_writer_open(path, slot->len);
+    if (w == NULL)
+    {
+        return false;
+    }
+    if (sd_writer_write(w, slot->buf, slot->len) != ESP_OK)
+    {
+        sd_writer_abort(w);
+        return false;
+    }
+    return sd_writer_close(w) == ESP_OK;
+}
+
+#if !CONFIG_APP_CAMERA_SAVE_RGB565
+static void put16(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+// 24位BMP 按CAPTURE_BMP_ROWS行一块转成BGR888交给写卡模块 不用先在PSRAM里拼一整张
+// 写卡模块在写上一块的时候这里接着转下一块
+static bool save_bmp(const char *path, const capture_slot_t *slot)
+{
+    const uint32_t w = slot->width;
+    const uint32_t h = slot->height;
+    const uint32_t row_bytes = (w * 3 + 3) & ~3u;
+    uint8_t *chunk = heap_caps_malloc(row_bytes * CAPTURE_BMP_ROWS, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    sd_writer_t *f = chunk ? sd_writer_open(path, CAPTURE_BMP_OFFSET + row_bytes * h) : NULL;
+    if (f == NULL)
+    {
+        heap_caps_free(chunk);
+        return false;
+    }
+
+    memset(chunk, 0, CAPTURE_BMP_OFFSET);
+    chunk[0] = 'B';
+    chunk[1] = 'M';
+    put32(chunk + 2, CAPTURE_BMP_OFFSET + row_bytes * h);
+    put32(chunk + 10, CAPTURE_BMP_OFFSET);
+    put32(chunk + 14, 40);
+    put32(chunk + 18, w);
+    put32(chunk + 22, h);                       // 正数 从最下面一行开始 哪个看图软件都认
+    put16(chunk + 26, 1);
+    put16(chunk + 28, 24);
+    put32(chunk + 34, row_bytes * h);
+    put32(chunk + 38, 2835);                    // 72 DPI
+    put32(chunk + 42, 2835);
+    bool ok = sd_writer_write(f, chunk, CAPTURE_BMP_OFFSET) == ESP_OK;
+
+    // 源帧在内存里 倒着取行不花什么 文件还是顺序写
+    const uint16_t *px = (const uint16_t *)slot->buf;
+    for (uint32_t y = 0; ok && y < h; y += CAPTURE_BMP_ROWS)
+    {
+        uint32_t rows = LV_MIN(CAPTURE_BMP_ROWS, h - y);
+        for (uint32_t r = 0; r < rows; r++)
+        {
+            uint8_t *dst = chunk + r * row_bytes;
+            lcd_draw_to_bgr888(dst, px + (h - 1 - y - r) * w, w);
+            memset(dst + w * 3, 0, row_bytes - w * 3);
+        }
+        ok = sd_writer_write(f, chunk, rows * row_bytes) == ESP_OK;
+    }
+    heap_caps_free(chunk);
+    if (!ok)
+    {
+        sd_writer_abort(f);
+        return false;
+    }
+    return sd_writer_close(f) == ESP_OK;
+}
+#endif
+
+// pic_MMDD_HHMMSS 同一秒已经有了就加_1 _2...
+static void capture_path(char *path, size_t len, time_t when, const char *ext)
+{
+    struct tm tm;
+    localtime_r(&when, &tm);
+    struct stat st;
+    for (int seq = 0; seq < 100; seq++)
+    {
+        char suffix[8] = "";
+        if (seq)
+        {
+            snprintf(suffix, sizeof(suffix), "_%d", seq);
+        }
+        snprintf(path, len, "%s/pic_%02d%02d_%02d%02d%02d%s.%s", PHOTO_SAVE_PATH, tm.tm_mon + 1, tm.tm_mday,
+                 tm.tm_hour, tm.tm_min, tm.tm_sec, suffix, ext);
+        if (stat(path, &st) != 0)
+        {
+            return;
+        }
+    }
+}
+
+// 按帧的格式编码写盘 path返回文件名
+static bool capture_write(const capture_slot_t *slot, char *path, size_t len)
+{
+    if (slot->format == PIXFORMAT_JPEG)
+    {
+        capture_path(path, len, slot->when, "jpg");
+        return save_raw(path, slot);
+    }
+    capture_path(path, len, slot->when, CAPTURE_EXT);
+#if CONFIG_APP_CAMERA_SAVE_RGB565
+    // 帧缓冲已经是LVGL的字节序 加个头直接写
+    return pic_rgb565_save(path, slot->buf, slot->width, slot->height) == ESP_OK;
+#else
+    return save_bmp(path, slot);
+#endif
+}
+
+static void capture_task(void *arg)
+{
+    int idx;
+    while (xQueueReceive(s_write_q, &idx, portMAX_DELAY) == pdTRUE && idx != CAPTURE_QUIT)
+    {
+        capture_slot_t *slot = &s_slots[idx];
+        char path[128];
+        bool ok = capture_write(slot, path, sizeof(path));  // 写卡模块会报告目录变了
+        if (ok)
+        {
+            gallery_index_add(path, slot->when);
+        }
+        uint32_t us = (uint32_t)(esp_timer_get_time() - slot->t_submit);
+        xQueueSend(s_free_q, &idx, 0);
+        portENTER_CRITICAL(&s_lock);
+        if (ok)
+        {
+            s_stats.saved++;
+            s_stats.bytes += slot->len;
+            s_stats.latency_us += us;
+            if (us > s_stats.max_latency_us)
+            {
+                s_stats.max_latency_us = us;
+            }
+        }
+        else
+        {
+            s_stats.failed++;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        if (ok)
+        {
+            ESP_LOGI(TAG, "Picture saved to %s, %lu ms after capture", path, (unsigned long)us / 1000);
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Save picture failed: %s", path);
+        }
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void capture_free(void)
+{
+    for (int i = 0; i < CAM_CAPTURE_SLOTS; i++)
+    {
+        heap_caps_free(s_slots[i].buf);
+        s_slots[i].buf = NULL;
+    }
+    if (s_free_q)
+    {
+        vQueueDelete(s_free_q);
+        s_free_q = NULL;
+    }
+    if (s_write_q)
+    {
+        vQueueDelete(s_write_q);
+        s_write_q = NULL;
+    }
+    if (s_done)
+    {
+        vSemaphoreDelete(s_done);
+        s_done = NULL;
+    }
+}
+
+esp_err_t cam_capture_start(void)
+{
+    if (s_running)
+    {
+        return ESP_OK;
+    }
+    s_free_q = xQueueCreate(CAM_CAPTURE_SLOTS, sizeof(int));
+    s_write_q = xQueueCreate(CAM_CAPTURE_SLOTS + 1, sizeof(int));
+    s_done = xSemaphoreCreateBinary();
+    bool ok = s_free_q && s_write_q && s_done;
+    for (int i = 0; ok && i < CAM_CAPTURE_SLOTS; i++)
+    {
+        s_slots[i].buf = heap_caps_malloc(CAM_CAPTURE_FRAME_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ok = s_slots[i].buf != NULL;
+        if (ok)
+        {
+            xQueueSend(s_free_q, &i, 0);
+        }
+    }
+    if (ok && task_plan_create(TASK_CAM_CAPTURE, capture_task, NULL, NULL) != pdPASS)
+    {
+        ok = false;
+    }
+    if (!ok)
+    {
+        capture_free();
+    }
+    ESP_RETURN_ON_FALSE(ok, ESP_ERR_NO_MEM, TAG, "capture slots alloc failed");
+    s_running = true;
+    return ESP_OK;
+}
+
+void cam_capture_stop(void)
+{
+    if (!s_running)
+    {
+        return;
+    }
+    int quit = CAPTURE_QUIT;
+    xQueueSend(s_write_q, &quit, portMAX_DELAY);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    capture_free();
+    s_running = false;
+    s_burst_left = 0;
+}
+
+bool cam_capture_submit(const camera_fb_t *frame)
+{
+    int idx;
+    if (!s_running || frame->len > CAM_CAPTURE_FRAME_BYTES || xQueueReceive(s_free_q, &idx, 0) != pdTRUE)
+    {
+        if (frame->len > CAM_CAPTURE_FRAME_BYTES)
+        {
+            ESP_LOGW(TAG, "frame of %u bytes does not fit a slot", (unsigned)frame->len);
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.dropped++;
+        portEXIT_CRITICAL(&s_lock);
+        return false;
+    }
+    int64_t t0 = esp_timer_get_time();
+    capture_slot_t *slot = &s_slots[idx];
+    memcpy(slot->buf, frame->buf, frame->len);
+    slot->len = frame->len;
+    slot->width = frame->width;
+    slot->height = frame->height;
+    slot->format = frame->format;
+    slot->when = time(NULL);
+    slot->t_submit = t0;
+    xQueueSend(s_write_q, &idx, 0);
+    uint32_t depth = uxQueueMessagesWaiting(s_write_q);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.queued++;
+    s_stats.copy_us += esp_timer_get_time() - t0;
+    if (depth > s_stats.max_depth)
+    {
+        s_stats.max_depth = depth;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+esp_err_t cam_capture_save(const camera_fb_t *frame, char *path, size_t len)
+{
+    // 直接从驱动的帧写 不占槽位
+    capture_slot_t slot = {
+        .buf = frame->buf,
+        .len = frame->len,
+        .width = frame->width,
+        .height = frame->height,
+        .format = frame->format,
+        .when = time(NULL),
+    };
+    char buf[128];
+    if (path == NULL)
+    {
+        path = buf;
+        len = sizeof(buf);
+    }
+    bool ok = capture_write(&slot, path, len);
+    if (ok)
+    {
+        gallery_index_add(path, slot.when);
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (ok)
+    {
+        s_stats.saved++;
+        s_stats.bytes += frame->len;
+    }
+    else
+    {
+        s_stats.failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_RETURN_ON_FALSE(ok, ESP_FAIL, TAG, "Save picture failed: %s", path);
+    return ESP_OK;
+}
+
+void cam_capture_burst_begin(int frames)
+{
+    if (s_burst_left > 0 || frames <= 0)
+    {
+        return;
+    }
+    s_burst_left = frames;
+    s_burst_got = 0;
+    s_burst_dropped = 0;
+}
+
+bool cam_capture_burst_active(void)
+{
+    return s_burst_left > 0;
+}
+
+void cam_capture_burst_frame(const camera_fb_t *frame)
+{
+    if (s_burst_left <= 0)
+    {
+        return;
+    }
+    if (cam_capture_submit(frame))
+    {
+        s_burst_t1 = esp_timer_get_time();
+        if (s_burst_got++ == 0)
+        {
+            s_burst_t0 = s_burst_t1;
+        }
+    }
+    else
+    {
+        s_burst_dropped++;
+    }
+    if (--s_burst_left > 0)
+    {
+        return;
+    }
+    // 帧率按拷进来的第一帧到最后一帧算 丢掉的帧也占了时间 所以是实际存下来的节奏
+    float fps = (s_burst_got > 1 && s_burst_t1 > s_burst_t0) ? (s_burst_got - 1) * 1e6f / (s_burst_t1 - s_burst_t0) : 0.0f;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bursts++;
+    s_stats.burst_frames += s_burst_got;
+    s_stats.burst_dropped += s_burst_dropped;
+    s_stats.last_burst_fps = fps;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "burst: %d/%d frames at %.1f fps, %d dropped", s_burst_got, s_burst_got + s_burst_dropped, fps,
+             s_burst_dropped);
+}
+
+void cam_capture_get_stats(cam_capture_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
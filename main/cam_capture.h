@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+
+
+/*********************** 后台保存照片 ****************************/
+// 拍照时预览任务只把帧拷进一个PSRAM槽位就继续取下一帧 core 0上的写盘任务再编码写SD卡
+// 槽位都在排队时再拍会被丢掉并计数 不会卡住预览
+// 写完记录从按下到落盘的时间 同一秒拍的多张文件名后面加序号
+// JPEG模式的帧原样存成.jpg 比槽位大的帧存不下 按丢掉计
+// 连拍: 槽位就是预先分配好的环 接下来N帧每帧都拷进去 写盘任务在后面慢慢写 没空槽位的帧算丢掉
+
+#define CAM_CAPTURE_SLOTS       CONFIG_APP_CAPTURE_SLOTS
+#define CAM_CAPTURE_BURST       CONFIG_APP_CAPTURE_BURST_FRAMES
+#define CAM_CAPTURE_FRAME_BYTES (320 * 240 * 2)     // QVGA RGB565 和bsp_camera_init里的配置一致 JPEG帧也得装得下
+
+typedef struct {
+    uint32_t queued;
+    uint32_t saved;
+    uint32_t failed;                    // 编码或写盘失败的
+    uint32_t dropped;                   // 没有空槽位丢掉的
+    uint32_t max_depth;                 // 最多同时排队的帧数
+    uint64_t bytes;                     // 存下来的帧一共多少字节 编码前
+    uint64_t latency_us;                // 拷进槽位到文件关闭
+    uint32_t max_latency_us;
+    uint64_t copy_us;                   // 预览任务里拷帧花的时间
+    uint32_t bursts;
+    uint32_t burst_frames;              // 连拍拷进槽位的帧
+    uint32_t burst_dropped;             // 连拍时没有空槽位丢掉的帧
+    float last_burst_fps;               // 最近一次连拍实际的帧率
+} cam_capture_stats_t;
+
+esp_err_t cam_capture_start(void);      // 进入摄像头时调用 分配槽位 启动写盘任务
+void cam_capture_stop(void);            // 等排着的都写完再释放 会阻塞 不要在LVGL任务里调用
+bool cam_capture_submit(const camera_fb_t *frame);  // 拷一份排队 马上返回 frame可以立刻还给驱动
+esp_err_t cam_capture_save(const camera_fb_t *frame, char *path, size_t len);  // 在调用的任务里直接写完才返回 不用先start path可以为NULL
+// 连拍 下面三个都只在取帧的任务里调用
+void cam_capture_burst_begin(int frames);
+bool cam_capture_burst_active(void);
+void cam_capture_burst_frame(const camera_fb_t *frame);    // 连拍进行中每取到一帧调用一次
+void cam_capture_get_stats(cam_capture_stats_t *stats);
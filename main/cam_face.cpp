@@ -0,0 +1,223 @@
+#include <string.h>
+#include <list>
+#include <new>
+#include "cam_face.h"
+extern "C" {
+#include "task_plan.h"
+}
+#include "human_face_detect.hpp"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "cam_face";
+
+#define FACE_PROBE_BYTES    (CAM_FACE_PROBE_KB * 1024)
+
+static HumanFaceDetect *s_detect;
+static uint8_t *s_rgb;                  // 取帧任务写 检测任务读 s_busy管着谁在用
+static uint8_t *s_probe;                // 测吞吐用 前一半拷到后一半
+static volatile bool s_busy;
+static volatile bool s_stopping;
+static bool s_active;
+static uint32_t s_frame_no;
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_done;
+static cam_face_result_t s_result;
+static cam_face_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 超过缓存大小的PSRAM到PSRAM拷贝 这一刻别人(摄像头DMA 预览 推理)没占走的带宽
+static uint32_t face_probe(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    memcpy(s_probe + FACE_PROBE_BYTES, s_probe, FACE_PROBE_BYTES);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    // 读一遍写一遍
+    return us ? (uint32_t)(2ULL * FACE_PROBE_BYTES * 1000000 / 1024 / us) : 0;
+}
+
+static void face_task(void *arg)
+{
+    while (!s_stopping)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_busy)
+        {
+            continue;
+        }
+        int64_t t0 = esp_timer_get_time();
+        dl::image::img_t img = {
+            .data = s_rgb,
+            .width = CAM_FACE_W,
+            .height = CAM_FACE_H,
+            .pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888,
+        };
+        std::list<dl::detect::result_t> &res = s_detect->run(img);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+
+        cam_face_result_t r = {};
+        for (const auto &f : res)
+        {
+            if (r.count >= CAM_FACE_MAX)
+            {
+                break;
+            }
+            // 取样时缩了一半 放回原始帧的坐标
+            cam_face_box_t *b = &r.box[r.count++];
+            b->x = f.box[0] * 2;
+            b->y = f.box[1] * 2;
+            b->w = (f.box[2] - f.box[0]) * 2;
+            b->h = (f.box[3] - f.box[1]) * 2;
+            b->score = (uint8_t)(f.score * 100);
+        }
+        // 第一帧检测完再测一次 之后不测 每次要搬2*CAM_FACE_PROBE_KB的PSRAM 结果只有这个任务写
+        uint32_t kbps = s_result.seq == 0 ? face_probe() : 0;
+        portENTER_CRITICAL(&s_lock);
+        if (kbps)
+        {
+            s_stats.probe_kbps_busy = kbps;
+        }
+        r.seq = s_result.seq + 1;
+        s_result = r;
+        s_stats.frames++;
+        s_stats.faces += r.count;
+        s_stats.infer_us += us;
+        if (us > s_stats.max_infer_us)
+        {
+            s_stats.max_infer_us = us;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        s_busy = false;
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void face_free(void)
+{
+    delete s_detect;
+    s_detect = nullptr;
+    heap_caps_free(s_rgb);
+    heap_caps_free(s_probe);
+    s_rgb = nullptr;
+    s_probe = nullptr;
+    if (s_done)
+    {
+        vSemaphoreDelete(s_done);
+        s_done = nullptr;
+    }
+}
+
+esp_err_t cam_face_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_active, ESP_ERR_INVALID_STATE, TAG, "already running");
+    // 57.6KB 推理时要反复读 能放内部RAM就不去和摄像头抢PSRAM
+    size_t rgb_bytes = CAM_FACE_W * CAM_FACE_H * 3;
+    s_rgb = (uint8_t *)heap_caps_malloc(rgb_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    bool internal = s_rgb != nullptr;
+    if (!internal)
+    {
+        s_rgb = (uint8_t *)heap_caps_malloc(rgb_bytes, MALLOC_CAP_SPIRAM);
+    }
+    s_probe = (uint8_t *)heap_caps_malloc(FACE_PROBE_BYTES * 2, MALLOC_CAP_SPIRAM);
+    s_done = xSemaphoreCreateBinary();
+    s_detect = new (std::nothrow) HumanFaceDetect();
+    if (!s_rgb || !s_probe || !s_done || !s_detect)
+    {
+        face_free();
+        ESP_LOGE(TAG, "face detect alloc failed");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(s_probe, 0x5a, FACE_PROBE_BYTES * 2);
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(&s_result, 0, sizeof(s_result));
+    s_stats.in_internal = internal;
+    s_stats.probe_kbps_first = face_probe(); // 推理还没开始 只有摄像头和预览在用
+    s_stats.t0 = esp_timer_get_time();
+    s_busy = false;
+    s_stopping = false;
+    s_frame_no = 0;
+    if (task_plan_create(TASK_CAM_FACE, face_task, NULL, &s_task) != pdPASS)
+    {
+        face_free();
+        return ESP_ERR_NO_MEM;
+    }
+    s_active = true;
+    return ESP_OK;
+}
+
+void cam_face_stop(void)
+{
+    if (!s_active)
+    {
+        return;
+    }
+    s_active = false;
+    s_stopping = true;
+    xTaskNotifyGive(s_task);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    face_free();
+}
+
+bool cam_face_active(void)
+{
+    return s_active;
+}
+
+void cam_face_frame(const camera_fb_t *frame)
+{
+    if (!s_active || frame->format != PIXFORMAT_RGB565 || frame->width != CAM_FACE_SRC_W ||
+        frame->height != CAM_FACE_SRC_H || ++s_frame_no % CAM_FACE_EVERY)
+    {
+        return;
+    }
+    if (s_busy)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.offered++;
+        s_stats.busy++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    // 隔行隔点取 摄像头的RGB565高字节在前
+    uint8_t *dst = s_rgb;
+    for (int y = 0; y < CAM_FACE_H; y++)
+    {
+        const uint8_t *src = frame->buf + 2 * y * CAM_FACE_SRC_W * 2;
+        for (int x = 0; x < CAM_FACE_W; x++, src += 4)
+        {
+            uint16_t c = src[0] << 8 | src[1];
+            *dst++ = (c >> 8 & 0xf8) | c >> 13;
+            *dst++ = (c >> 3 & 0xfc) | (c >> 9 & 0x03);
+            *dst++ = (c << 3 & 0xf8) | (c >> 2 & 0x07);
+        }
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.offered++;
+    s_stats.sample_us += us;
+    s_stats.src_bytes += CAM_FACE_H * CAM_FACE_SRC_W * 2; // 隔行读 每行的缓存行都要过一遍
+    portEXIT_CRITICAL(&s_lock);
+    s_busy = true;
+    xTaskNotifyGive(s_task);
+}
+
+void cam_face_get_result(cam_face_result_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_result;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void cam_face_get_stats(cam_face_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
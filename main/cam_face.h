@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************** 人脸检测 ****************************/
+// ESP-DL的量化人脸检测模型(human_face_detect 两级 MSR+MNP) 跑在核0的低优先级任务上 预览照样在核1
+// 取帧任务每CAM_FACE_EVERY帧 检测任务空着的话隔点取样成160x120的RGB888 放内部RAM 不够才放PSRAM
+// 模型自己的缓冲在PSRAM 推理和摄像头DMA LVGL读帧抢PSRAM 所以记带宽:
+//   估算的每秒流量(摄像头写 预览读 取样读)和实测的 开始检测前和第一帧检测完各拷一次CAM_FACE_PROBE_KB PSRAM测吞吐
+// 框是原始帧的坐标 画成LVGL的空心方框 不改帧缓冲
+
+#define CAM_FACE_SRC_W          320
+#define CAM_FACE_SRC_H          240
+#define CAM_FACE_W              (CAM_FACE_SRC_W / 2)
+#define CAM_FACE_H              (CAM_FACE_SRC_H / 2)
+#define CAM_FACE_EVERY          CONFIG_APP_CAMERA_FACE_EVERY
+#define CAM_FACE_MAX            4       // 最多报几个框
+#define CAM_FACE_PROBE_KB       128     // 两倍于数据缓存 测到的不是缓存
+
+typedef struct {
+    int16_t x, y, w, h;                 // 320x240上的
+    uint8_t score;                      // 百分比
+} cam_face_box_t;
+
+typedef struct {
+    uint32_t seq;                       // 每次检测完加一 取结果的看它变没变
+    uint8_t count;
+    cam_face_box_t box[CAM_FACE_MAX];
+} cam_face_result_t;
+
+typedef struct {
+    uint32_t offered;                   // 轮到检测的帧
+    uint32_t frames;                    // 真的检测了的
+    uint32_t busy;                      // 轮到了但上一帧还没检测完
+    uint32_t faces;                     // 累计框数
+    uint64_t sample_us;                 // 取帧任务里取样
+    uint64_t infer_us;                  // 检测任务里推理
+    uint32_t max_infer_us;
+    uint64_t src_bytes;                 // 取样读了多少PSRAM
+    bool in_internal;                   // 取样缓冲在内部RAM
+    uint32_t probe_kbps_first;          // 开始检测前测的PSRAM吞吐 KB/s
+    uint32_t probe_kbps_busy;           // 第一帧检测完测的 0是还没测
+    int64_t t0;
+} cam_face_stats_t;
+
+esp_err_t cam_face_start(void);         // 加载模型 启动检测任务
+void cam_face_stop(void);               // 等手上这帧检测完 会阻塞
+bool cam_face_active(void);
+void cam_face_frame(const camera_fb_t *frame);  // 取帧任务里调用 只收320x240的RGB565
+void cam_face_get_result(cam_face_result_t *out);
+void cam_face_get_stats(cam_face_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
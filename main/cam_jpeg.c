@@ -0,0 +1,133 @@
+#include <string.h>
+#include "cam_jpeg.h"
+#include "pic_jpeg.h"
+#include "mem_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+static const char *TAG = "cam_jpeg";
+
+static camera_fb_t s_views[CAM_JPEG_VIEWS];
+static bool s_busy[CAM_JPEG_VIEWS];
+static void *s_work;
+static cam_jpeg_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t cam_jpeg_init(void)
+{
+    if (s_work)
+    {
+        return ESP_OK;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    // tjpgd的工作区每个MCU都要访问 放内部RAM
+    s_work = mem_pool_alloc(MEM_POOL_DECODER, PIC_JPEG_WORK_SIZE);
+    bool ok = s_work != NULL;
+    for (int i = 0; ok && i < CAM_JPEG_VIEWS; i++)
+    {
+        camera_fb_t *v = &s_views[i];
+        v->buf = mem_pool_alloc(MEM_POOL_MEDIA, CAM_JPEG_VIEW_W * CAM_JPEG_VIEW_H * 2);
+        v->len = CAM_JPEG_VIEW_W * CAM_JPEG_VIEW_H * 2;
+        v->width = CAM_JPEG_VIEW_W;
+        v->height = CAM_JPEG_VIEW_H;
+        v->format = PIXFORMAT_RGB565;
+        s_busy[i] = false;
+        ok = v->buf != NULL;
+    }
+    if (!ok)
+    {
+        cam_jpeg_deinit();
+    }
+    ESP_RETURN_ON_FALSE(ok, ESP_ERR_NO_MEM, TAG, "preview buffers alloc failed");
+    return ESP_OK;
+}
+
+void cam_jpeg_deinit(void)
+{
+    for (int i = 0; i < CAM_JPEG_VIEWS; i++)
+    {
+        mem_pool_free(s_views[i].buf);
+        s_views[i].buf = NULL;
+    }
+    mem_pool_free(s_work);
+    s_work = NULL;
+}
+
+camera_fb_t *cam_jpeg_view(const camera_fb_t *jpg)
+{
+    if (s_work == NULL)
+    {
+        return NULL;
+    }
+    int idx = -1;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < CAM_JPEG_VIEWS; i++)
+    {
+        if (!s_busy[i])
+        {
+            s_busy[i] = true;
+            idx = i;
+            break;
+        }
+    }
+    if (idx < 0)
+    {
+        s_stats.busy++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (idx < 0)
+    {
+        return NULL;
+    }
+
+    camera_fb_t *v = &s_views[idx];
+    pic_jpeg_info_t info;
+    bool ok = pic_jpeg_decode_frame(jpg->buf, jpg->len, v->width, v->height, (lv_color_t *)v->buf, s_work, &info);
+    portENTER_CRITICAL(&s_lock);
+    if (ok)
+    {
+        s_stats.decoded++;
+        s_stats.decode_us += info.decode_us;
+        if (info.decode_us > s_stats.max_decode_us)
+        {
+            s_stats.max_decode_us = info.decode_us;
+        }
+        s_stats.jpeg_bytes += jpg->len;
+        s_stats.src_w = info.src_w;
+        s_stats.src_h = info.src_h;
+        s_stats.scale = info.scale;
+    }
+    else
+    {
+        s_stats.failed++;
+        s_busy[idx] = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!ok)
+    {
+        return NULL;
+    }
+    v->timestamp = jpg->timestamp;
+    return v;
+}
+
+bool cam_jpeg_release(camera_fb_t *fb)
+{
+    if (fb < s_views || fb >= s_views + CAM_JPEG_VIEWS)
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_busy[fb - s_views] = false;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+void cam_jpeg_get_stats(cam_jpeg_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+
+
+/*********************** JPEG模式的预览 ****************************/
+// 摄像头输出JPEG时 每帧用tjpgd按1/2 1/4 1/8缩小解进一块320x240的RGB565预览缓冲
+// 预览缓冲包成camera_fb_t 后面的直通预览和LVGL帧交接照旧 还的时候先问cam_jpeg_release
+// 缓冲数要比LVGL同时拿着的帧(待画和在显示)多一块 解码的时候才总有空的
+
+#define CAM_JPEG_VIEWS      3
+#define CAM_JPEG_VIEW_W     320
+#define CAM_JPEG_VIEW_H     240
+
+typedef struct {
+    uint32_t decoded;
+    uint32_t failed;                    // 坏帧或者源图比预览还小
+    uint32_t busy;                      // 没有空的预览缓冲跳过的
+    uint64_t decode_us;
+    uint32_t max_decode_us;
+    uint64_t jpeg_bytes;                // 解过的JPEG帧一共多少字节
+    uint16_t src_w;                     // 最近一帧的原尺寸和缩小倍数
+    uint16_t src_h;
+    uint8_t scale;
+} cam_jpeg_stats_t;
+
+esp_err_t cam_jpeg_init(void);          // 分配预览缓冲 统计清零
+void cam_jpeg_deinit(void);             // 预览缓冲都还回来之后调用
+camera_fb_t *cam_jpeg_view(const camera_fb_t *jpg);    // 解不出来或者没有空缓冲返回NULL jpg可以马上还给驱动
+bool cam_jpeg_release(camera_fb_t *fb); // fb是预览缓冲就收回来返回true 否则是驱动的帧 返回false
+void cam_jpeg_get_stats(cam_jpeg_stats_t *stats);
@@ -0,0 +1,247 @@
+#include <string.h>
+#include "cam_motion.h"
+#include "task_plan.h"
+#include "lcd_draw.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "cam_motion";
+
+#define MOTION_SRC_W        320
+#define MOTION_SRC_H        240
+#define MOTION_WARMUP       8           // 刚开始或者重置后 自动曝光还在调 这几帧只学背景
+#define MOTION_GRID_W       (CAM_MOTION_W / CAM_MOTION_BLOCK_W)
+#define MOTION_BLOCK_PX     (CAM_MOTION_BLOCK_W * CAM_MOTION_BLOCK_H)
+
+static uint8_t *s_luma;                 // 取帧任务写 侦测任务读 s_busy管着谁在用
+static uint8_t *s_bg;
+static volatile bool s_busy;
+static volatile bool s_stopping;
+static volatile bool s_reset;
+static bool s_active;
+static uint32_t s_learned;              // 背景学了几帧
+static int64_t s_t_motion;              // 最近一次有动静
+static int64_t s_t_trigger;
+static bool s_trigger;
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_done;
+static cam_motion_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 背景向当前帧靠近 shift越大跟得越慢
+static void bg_follow(uint8_t *bg, const uint8_t *cur, int shift)
+{
+    for (int y = 0; y < CAM_MOTION_BLOCK_H; y++)
+    {
+        for (int x = 0; x < CAM_MOTION_BLOCK_W; x++)
+        {
+            int d = cur[x] - bg[x];
+            // 差不到2^shift的也要挪一格 不然背景永远追不上
+            bg[x] += d > 0 ? ((d >> shift) | 1) : d < 0 ? -((-d >> shift) | 1) : 0;
+        }
+        bg += CAM_MOTION_W;
+        cur += CAM_MOTION_W;
+    }
+}
+
+// 返回在动的块数 顺便更新背景
+static uint32_t motion_analyse(void)
+{
+    uint32_t limit = CONFIG_APP_MOTION_PIXEL_DIFF * MOTION_BLOCK_PX;
+    uint32_t moving = 0;
+    for (int b = 0; b < CAM_MOTION_BLOCKS; b++)
+    {
+        int off = (b / MOTION_GRID_W) * CAM_MOTION_BLOCK_H * CAM_MOTION_W + (b % MOTION_GRID_W) * CAM_MOTION_BLOCK_W;
+        uint32_t sad = 0;
+        for (int y = 0; y < CAM_MOTION_BLOCK_H; y++)
+        {
+            sad += lcd_draw_sad8(s_luma + off + y * CAM_MOTION_W, s_bg + off + y * CAM_MOTION_W, CAM_MOTION_BLOCK_W);
+        }
+        bool move = sad > limit;
+        moving += move;
+        bg_follow(s_bg + off, s_luma + off, move ? 5 : 3);
+    }
+    return moving;
+}
+
+static void motion_task(void *arg)
+{
+    while (!s_stopping)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_busy)
+        {
+            continue;
+        }
+        int64_t t0 = esp_timer_get_time();
+        if (s_reset)
+        {
+            s_reset = false;
+            s_learned = 0;
+        }
+        uint32_t moving = 0;
+        if (s_learned == 0)
+        {
+            memcpy(s_bg, s_luma, CAM_MOTION_W * CAM_MOTION_H);
+        }
+        else
+        {
+            moving = motion_analyse();
+        }
+        bool warm = s_learned >= MOTION_WARMUP;
+        if (!warm)
+        {
+            s_learned++;
+        }
+        bool motion = warm && moving >= CONFIG_APP_MOTION_MIN_BLOCKS;
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        bool fired = false;
+
+        portENTER_CRITICAL(&s_lock);
+        s_stats.frames++;
+        s_stats.last_blocks = moving;
+        s_stats.analyse_us += us;
+        if (us > s_stats.max_analyse_us)
+        {
+            s_stats.max_analyse_us = us;
+        }
+        if (motion)
+        {
+            s_stats.motion_frames++;
+            s_t_motion = t0;
+            // 一直在动的话保持时间内只触发一次
+            if (s_stats.triggers == 0 || t0 - s_t_trigger >= CAM_MOTION_HOLD_US)
+            {
+                s_t_trigger = t0;
+                s_trigger = true;
+                s_stats.triggers++;
+                fired = true;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+        if (fired)
+        {
+            ESP_LOGD(TAG, "motion: %lu/%d blocks", (unsigned long)moving, CAM_MOTION_BLOCKS);
+        }
+        s_busy = false;
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void motion_free(void)
+{
+    heap_caps_free(s_luma);
+    heap_caps_free(s_bg);
+    s_luma = NULL;
+    s_bg = NULL;
+    if (s_done)
+    {
+        vSemaphoreDelete(s_done);
+        s_done = NULL;
+    }
+}
+
+esp_err_t cam_motion_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_active, ESP_ERR_INVALID_STATE, TAG, "already running");
+    // 一共不到10KB 放内部RAM 逐字节读写比PSRAM快得多
+    s_luma = heap_caps_malloc(CAM_MOTION_W * CAM_MOTION_H, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_bg = heap_caps_malloc(CAM_MOTION_W * CAM_MOTION_H, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_done = xSemaphoreCreateBinary();
+    if (!s_luma || !s_bg || !s_done)
+    {
+        motion_free();
+        ESP_LOGE(TAG, "motion buffers alloc failed");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_busy = false;
+    s_stopping = false;
+    s_reset = false;
+    s_learned = 0;
+    s_trigger = false;
+    s_t_motion = 0;
+    if (task_plan_create(TASK_CAM_MOTION, motion_task, NULL, &s_task) != pdPASS)
+    {
+        motion_free();
+        return ESP_ERR_NO_MEM;
+    }
+    s_active = true;
+    return ESP_OK;
+}
+
+void cam_motion_stop(void)
+{
+    if (!s_active)
+    {
+        return;
+    }
+    s_active = false;
+    s_stopping = true;
+    xTaskNotifyGive(s_task);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    motion_free();
+}
+
+bool cam_motion_active(void)
+{
+    return s_active;
+}
+
+void cam_motion_reset(void)
+{
+    s_reset = true;
+}
+
+void cam_motion_frame(const camera_fb_t *frame)
+{
+    if (!s_active || frame->format != PIXFORMAT_RGB565 || frame->width != MOTION_SRC_W || frame->height != MOTION_SRC_H)
+    {
+        return;
+    }
+    if (s_busy)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.busy++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    lcd_draw_luma4(s_luma, (const uint16_t *)frame->buf, MOTION_SRC_W, MOTION_SRC_H);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.downsample_us += us;
+    portEXIT_CRITICAL(&s_lock);
+    s_busy = true;
+    xTaskNotifyGive(s_task);
+}
+
+bool cam_motion_take_trigger(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool t = s_trigger;
+    s_trigger = false;
+    portEXIT_CRITICAL(&s_lock);
+    return t;
+}
+
+bool cam_motion_moving(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    int64_t t = s_t_motion;
+    portEXIT_CRITICAL(&s_lock);
+    return t && esp_timer_get_time() - t < CAM_MOTION_HOLD_US;
+}
+
+void cam_motion_get_stats(cam_motion_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+
+
+/*********************** 移动侦测 ****************************/
+// 取帧任务把预览帧(RGB565 320x240)缩成80x60的亮度 只在侦测任务空着的时候缩 忙的话这帧跳过 不拖慢预览
+// core 0上的任务把亮度分成10x10个块 每块8x6 跟背景算绝对差之和 平均每像素差超过阈值的块算在动
+// 背景是滑动平均 不动的块跟得快 动的块跟得慢 慢慢挪进画面的东西最后会变成背景
+// 动的块够多就算有动静 调用方取触发去拍照或者录像 保持时间内只触发一次
+
+#define CAM_MOTION_W            80
+#define CAM_MOTION_H            60
+#define CAM_MOTION_BLOCK_W      8
+#define CAM_MOTION_BLOCK_H      6
+#define CAM_MOTION_BLOCKS       ((CAM_MOTION_W / CAM_MOTION_BLOCK_W) * (CAM_MOTION_H / CAM_MOTION_BLOCK_H))
+#define CAM_MOTION_HOLD_US      (CONFIG_APP_MOTION_HOLD_S * 1000000LL)
+
+typedef struct {
+    uint32_t frames;                    // 分析过的帧
+    uint32_t busy;                      // 上一帧还没分析完跳过的
+    uint32_t motion_frames;             // 有动静的帧
+    uint32_t triggers;
+    uint32_t last_blocks;               // 最近一帧在动的块数
+    uint64_t downsample_us;             // 取帧任务里缩亮度花的时间
+    uint64_t analyse_us;                // 侦测任务里算差和更新背景的时间
+    uint32_t max_analyse_us;
+} cam_motion_stats_t;
+
+esp_err_t cam_motion_start(void);       // 分配亮度和背景 启动侦测任务
+void cam_motion_stop(void);             // 等手上这帧分析完 会阻塞
+bool cam_motion_active(void);
+void cam_motion_reset(void);            // 换了模式或者分辨率 背景重新学
+void cam_motion_frame(const camera_fb_t *frame);    // 取帧任务里调用 只收320x240的RGB565
+bool cam_motion_take_trigger(void);     // 有新的触发返回true 一次触发只给一次
+bool cam_motion_moving(void);           // 保持时间内还有动静
+void cam_motion_get_stats(cam_motion_stats_t *stats);
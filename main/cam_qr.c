@@ -0,0 +1,329 @@
+#include <string.h>
+#include "cam_qr.h"
+#include "task_plan.h"
+#include "quirc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "cam_qr";
+
+#define QR_ROI_X            ((CAM_QR_SRC_W - CAM_QR_ROI) / 2)
+#define QR_ROI_Y            ((CAM_QR_SRC_H - CAM_QR_ROI) / 2)
+
+static struct quirc *s_q[2];            // [0]缩小的 [1]原分辨率 各有各的图像缓冲 不用来回resize
+static struct quirc_code *s_code;       // 4KB 和数据一起放PSRAM 不占识别任务的栈
+static struct quirc_data *s_data;
+static volatile bool s_busy;            // 取帧任务写了图像 识别任务还没做完
+static volatile bool s_stopping;
+static volatile bool s_want_full;
+static int s_cur;                       // 这一帧用的是哪个
+static int64_t s_frame_us;
+static uint32_t s_frame_no;
+static bool s_active;
+static int64_t s_first_seen_us;         // 0是现在没看到
+static uint32_t s_unseen;
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_done;
+static cam_qr_result_t s_result;
+static bool s_result_new;
+static int64_t s_result_us;
+static cam_qr_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 解出来了 和上一个一样而且没隔多久就不报
+static void qr_deliver(int64_t now, uint32_t decode_us)
+{
+    size_t len = s_data->payload_len < CAM_QR_TEXT_MAX - 1 ? s_data->payload_len : CAM_QR_TEXT_MAX - 1;
+    uint32_t latency = (uint32_t)(now - s_frame_us);
+    uint32_t acquire = (uint32_t)(now - s_first_seen_us);
+    portENTER_CRITICAL(&s_lock);
+    bool repeat = len == s_result.len && memcmp(s_result.text, s_data->payload, len) == 0 &&
+                  now - s_result_us < CAM_QR_REPEAT_MS * 1000LL;
+    if (repeat)
+    {
+        s_stats.repeats++;
+    }
+    else
+    {
+        memcpy(s_result.text, s_data->payload, len);
+        s_result.text[len] = '\0';
+        s_result.len = len;
+        s_result.full = s_cur;
+        s_result.latency_us = latency;
+        s_result.acquire_us = acquire;
+        s_result.decode_us = decode_us;
+        s_result_new = true;
+        s_stats.latency_us_last = latency;
+        s_stats.acquire_us_last = acquire;
+        if (latency > s_stats.latency_us_max)
+        {
+            s_stats.latency_us_max = latency;
+        }
+    }
+    s_result_us = now;
+    s_stats.decoded++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void qr_task(void *arg)
+{
+    while (!s_stopping)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_busy)
+        {
+            continue;
+        }
+        struct quirc *q = s_q[s_cur];
+        int64_t t0 = esp_timer_get_time();
+        quirc_end(q);
+        int64_t t1 = esp_timer_get_time();
+        int n = quirc_count(q);
+        bool got = false;
+        for (int i = 0; i < n && !got; i++)
+        {
+            quirc_extract(q, i, s_code);
+            quirc_decode_error_t err = quirc_decode(s_code, s_data);
+            if (err == QUIRC_ERROR_DATA_ECC)
+            {
+                quirc_flip(s_code); // 镜像的码
+                err = quirc_decode(s_code, s_data);
+            }
+            got = err == QUIRC_SUCCESS;
+        }
+        int64_t t2 = esp_timer_get_time();
+
+        if (n)
+        {
+            if (s_first_seen_us == 0)
+            {
+                s_first_seen_us = s_frame_us;
+            }
+            s_unseen = 0;
+        }
+        else if (s_first_seen_us && ++s_unseen >= CAM_QR_LOST_FRAMES)
+        {
+            s_first_seen_us = 0;
+        }
+        if (got)
+        {
+            qr_deliver(t2, (uint32_t)(t2 - t0));
+            s_first_seen_us = 0; // 下一个码重新算
+        }
+        else if (n && s_cur == 0)
+        {
+            s_want_full = true; // 码太小 缩了以后模块糊在一起
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.frames++;
+        s_stats.full_frames += s_cur;
+        s_stats.seen += n > 0;
+        s_stats.failed += n > 0 && !got;
+        s_stats.identify_us += t1 - t0;
+        s_stats.decode_us += t2 - t1;
+        portEXIT_CRITICAL(&s_lock);
+        s_busy = false;
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void qr_free(void)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (s_q[i])
+        {
+            quirc_destroy(s_q[i]);
+            s_q[i] = NULL;
+        }
+    }
+    heap_caps_free(s_code);
+    heap_caps_free(s_data);
+    s_code = NULL;
+    s_data = NULL;
+    if (s_done)
+    {
+        vSemaphoreDelete(s_done);
+        s_done = NULL;
+    }
+}
+
+esp_err_t cam_qr_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_active, ESP_ERR_INVALID_STATE, TAG, "already running");
+    s_q[0] = quirc_new();
+    s_q[1] = quirc_new();
+    s_code = heap_caps_malloc(sizeof(*s_code), MALLOC_CAP_SPIRAM);
+    s_data = heap_caps_malloc(sizeof(*s_data), MALLOC_CAP_SPIRAM);
+    s_done = xSemaphoreCreateBinary();
+    if (!s_q[0] || !s_q[1] || !s_code || !s_data || !s_done ||
+        quirc_resize(s_q[0], CAM_QR_ROI / 2, CAM_QR_ROI / 2) < 0 || quirc_resize(s_q[1], CAM_QR_ROI, CAM_QR_ROI) < 0)
+    {
+        qr_free();
+        ESP_LOGE(TAG, "quirc alloc failed");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(&s_result, 0, sizeof(s_result));
+    s_result_new = false;
+    s_busy = false;
+    s_stopping = false;
+    s_want_full = false;
+    s_first_seen_us = 0;
+    s_unseen = 0;
+    if (task_plan_create(TASK_CAM_QR, qr_task, NULL, &s_task) != pdPASS)
+    {
+        qr_free();
+        return ESP_ERR_NO_MEM;
+    }
+    s_active = true;
+    return ESP_OK;
+}
+
+void cam_qr_stop(void)
+{
+    if (!s_active)
+    {
+        return;
+    }
+    s_active = false;
+    s_stopping = true;
+    xTaskNotifyGive(s_task);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    qr_free();
+}
+
+bool cam_qr_active(void)
+{
+    return s_active;
+}
+
+void cam_qr_frame(const camera_fb_t *frame)
+{
+    if (!s_active || frame->format != PIXFORMAT_GRAYSCALE || frame->width != CAM_QR_SRC_W || frame->height != CAM_QR_SRC_H)
+    {
+        return;
+    }
+    if (s_busy)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.busy++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    int full = s_want_full || ++s_frame_no % CAM_QR_FULL_EVERY == 0;
+    s_want_full = false;
+    const uint8_t *src = frame->buf + QR_ROI_Y * CAM_QR_SRC_W + QR_ROI_X;
+    uint8_t *dst = quirc_begin(s_q[full], NULL, NULL);
+    if (full)
+    {
+        for (int y = 0; y < CAM_QR_ROI; y++)
+        {
+            memcpy(dst + y * CAM_QR_ROI, src + y * CAM_QR_SRC_W, CAM_QR_ROI);
+        }
+    }
+    else
+    {
+        // 2x2取平均 比隔点取噪声小
+        for (int y = 0; y < CAM_QR_ROI / 2; y++)
+        {
+            const uint8_t *r0 = src + 2 * y * CAM_QR_SRC_W;
+            const uint8_t *r1 = r0 + CAM_QR_SRC_W;
+            for (int x = 0; x < CAM_QR_ROI / 2; x++)
+            {
+                *dst++ = (r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1] + 2) >> 2;
+            }
+        }
+    }
+    s_cur = full;
+    s_frame_us = (int64_t)frame->timestamp.tv_sec * 1000000 + frame->timestamp.tv_usec;
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.copy_us += us;
+    portEXIT_CRITICAL(&s_lock);
+    s_busy = true;
+    xTaskNotifyGive(s_task);
+}
+
+bool cam_qr_take_result(cam_qr_result_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool got = s_result_new;
+    if (got)
+    {
+        *out = s_result;
+        s_result_new = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return got;
+}
+
+void cam_qr_get_stats(cam_qr_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 读一个字段的值到下一个没转义的分号 dst为NULL只跳过
+static const char *wifi_field(const char *p, char *dst, size_t len)
+{
+    size_t n = 0;
+    while (*p && *p != ';')
+    {
+        if (*p == '\\' && p[1])
+        {
+            p++;
+        }
+        if (dst && n + 1 < len)
+        {
+            dst[n++] = *p;
+        }
+        p++;
+    }
+    if (dst)
+    {
+        dst[n] = '\0';
+    }
+    return *p ? p + 1 : p;
+}
+
+bool cam_qr_parse_wifi(const char *text, char *ssid, size_t ssid_len, char *pass, size_t pass_len)
+{
+    if (strncmp(text, "WIFI:", 5) != 0)
+    {
+        return false;
+    }
+    ssid[0] = '\0';
+    pass[0] = '\0';
+    const char *p = text + 5;
+    while (*p && *p != ';')
+    {
+        const char *colon = strchr(p, ':');
+        if (colon == NULL)
+        {
+            break;
+        }
+        size_t klen = colon - p;
+        if (klen == 1 && p[0] == 'S')
+        {
+            p = wifi_field(colon + 1, ssid, ssid_len);
+        }
+        else if (klen == 1 && p[0] == 'P')
+        {
+            p = wifi_field(colon + 1, pass, pass_len);
+        }
+        else
+        {
+            p = wifi_field(colon + 1, NULL, 0); // T H 和WPA3那些用不上
+        }
+    }
+    return ssid[0] != '\0';
+}
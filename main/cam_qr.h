@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+
+
+/*********************** 扫码 ****************************/
+// 传感器出QVGA灰度 不用再从RGB565算亮度 取帧任务把中间CAM_QR_ROI见方的一块直接拷进quirc的图像缓冲
+// 只在识别任务空着时拷 忙的话这帧跳过 预览照样每帧都推
+// 识别任务在核1 界面在核0 用quirc找定位图案 取样 纠错
+// 平时2x2取平均缩成120x120 找得快; 缩小后看到了码却解不出来 或者每CAM_QR_FULL_EVERY帧 下一帧用原分辨率
+// 传感器开了水平镜像 解不出来时翻过来再解一次
+// 同样的内容CAM_QR_REPEAT_MS里只报一次
+// 耗时: 帧的时间戳(驱动收完这一帧 esp_timer)到解出来 和第一次看到定位图案到解出来 拷贝 定位 解码各多少
+
+#define CAM_QR_SRC_W            320
+#define CAM_QR_SRC_H            240
+#define CAM_QR_ROI              240
+#define CAM_QR_FULL_EVERY       4
+#define CAM_QR_REPEAT_MS        3000
+#define CAM_QR_LOST_FRAMES      10      // 这么多帧没看到定位图案 下次看到重新算第一次
+#define CAM_QR_TEXT_MAX         512
+
+typedef struct {
+    char text[CAM_QR_TEXT_MAX];         // 末尾补0 二进制内容里有0的话以len为准
+    size_t len;
+    bool full;                          // 原分辨率解出来的
+    uint32_t latency_us;                // 帧时间戳到解出来
+    uint32_t acquire_us;                // 第一次看到到解出来
+    uint32_t decode_us;                 // 这一帧在识别任务里花的
+} cam_qr_result_t;
+
+typedef struct {
+    uint32_t frames;                    // 分析过的帧
+    uint32_t full_frames;               // 其中原分辨率的
+    uint32_t busy;                      // 上一帧还没分析完跳过的
+    uint32_t seen;                      // 看到定位图案的帧
+    uint32_t decoded;
+    uint32_t failed;                    // 看到了解不出来的
+    uint32_t repeats;                   // 和上一个一样 没报的
+    uint64_t copy_us;                   // 取帧任务里拷贝和缩小
+    uint64_t identify_us;               // 找定位图案
+    uint64_t decode_us;                 // 取样和纠错
+    uint32_t latency_us_last;
+    uint32_t latency_us_max;
+    uint32_t acquire_us_last;
+} cam_qr_stats_t;
+
+esp_err_t cam_qr_start(void);           // 分配quirc 启动识别任务
+void cam_qr_stop(void);                 // 等手上这帧分析完 会阻塞
+bool cam_qr_active(void);
+void cam_qr_frame(const camera_fb_t *frame);    // 取帧任务里调用 只收320x240灰度
+bool cam_qr_take_result(cam_qr_result_t *out);  // 有新结果返回true
+void cam_qr_get_stats(cam_qr_stats_t *stats);
+// "WIFI:T:WPA;S:名字;P:密码;;" 字段顺序随意 \转义 没有S返回false 开放网络密码是空串
+bool cam_qr_parse_wifi(const char *text, char *ssid, size_t ssid_len, char *pass, size_t pass_len);
@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cam_stream.h"
+#include "task_plan.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lvgl.h"
+
+static const char *TAG = "cam_stream";
+
+#define STREAM_BOUNDARY     "frame"
+#define STREAM_SEND_TIMEOUT 2           // 秒 客户端卡死时它的任务最多在send里等这么久
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t seq;
+    int refs;                           // 当前最新帧占一个 每个正在发它的客户端占一个
+    struct timeval timestamp;
+} stream_slot_t;
+
+typedef struct {
+    bool used;
+    bool ready;                         // 到点了 在等新帧
+    httpd_req_t *req;                   // 异步请求 任务结束时complete
+    SemaphoreHandle_t wake;             // 来了新帧 跟着服务一起建和删 客户端任务退了再give也没事
+    int64_t interval_us;
+} stream_client_t;
+
+static httpd_handle_t s_server;
+static stream_slot_t s_slots[CAM_STREAM_SLOTS];
+static stream_slot_t *s_latest;
+static stream_client_t s_clients[CAM_STREAM_MAX_CLIENTS];
+static uint32_t s_seq;
+static volatile bool s_stopping;
+static cam_stream_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char s_index_html[] =
+    "<!DOCTYPE html><html><head><meta name=\"viewport\" content=\"width=device-width\"><title>camera</title></head>"
+    "<body style=\"margin:0;background:#000\"><img src=\"/stream\" style=\"width:100%\"></body></html>";
+
+static void slot_put(stream_slot_t *slot)
+{
+    portENTER_CRITICAL(&s_lock);
+    slot->refs--;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 拿最新的一帧 比last新才给 拿到的要slot_put
+static stream_slot_t *slot_get_newer(uint32_t last)
+{
+    stream_slot_t *slot = NULL;
+    portENTER_CRITICAL(&s_lock);
+    if (s_latest && s_latest->seq != last)
+    {
+        slot = s_latest;
+        slot->refs++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return slot;
+}
+
+// 一段: 分隔头 JPEG 换行 JPEG直接从槽位发
+static esp_err_t stream_send_part(httpd_req_t *req, const stream_slot_t *slot)
+{
+    char head[128];
+    int n = snprintf(head, sizeof(head),
+                     "--" STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %lu\r\nX-Timestamp: %lld.%06ld\r\n\r\n",
+                     (unsigned long)slot->len, (long long)slot->timestamp.tv_sec, (long)slot->timestamp.tv_usec);
+    esp_err_t err = httpd_resp_send_chunk(req, head, n);
+    if (err == ESP_OK)
+    {
+        err = httpd_resp_send_chunk(req, (const char *)slot->buf, slot->len);
+    }
+    if (err == ESP_OK)
+    {
+        err = httpd_resp_send_chunk(req, "\r\n", 2);
+    }
+    return err;
+}
+
+static void stream_client_task(void *arg)
+{
+    stream_client_t *c = arg;
+    httpd_req_t *req = c->req;
+    httpd_resp_set_type(req, "multipart/x-mixed-replace;boundary=" STREAM_BOUNDARY);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    uint32_t last = 0;
+    uint32_t sent = 0;
+    int64_t t_start = esp_timer_get_time();
+    int64_t next = t_start;
+    esp_err_t err = ESP_OK;
+    while (!s_stopping && err == ESP_OK)
+    {
+        // 按帧率上限节拍 没到点不拿帧 这段时间来的帧都算跳过
+        int64_t wait = next - esp_timer_get_time();
+        if (wait > 1000)
+        {
+            vTaskDelay(pdMS_TO_TICKS(wait / 1000) + 1);
+        }
+        stream_slot_t *slot = slot_get_newer(last);
+        if (slot == NULL)
+        {
+            portENTER_CRITICAL(&s_lock);
+            c->ready = true;
+            portEXIT_CRITICAL(&s_lock);
+            xSemaphoreTake(c->wake, pdMS_TO_TICKS(1000));
+            continue;
+        }
+        portENTER_CRITICAL(&s_lock);
+        c->ready = false;
+        portEXIT_CRITICAL(&s_lock);
+
+        int64_t t0 = esp_timer_get_time();
+        last = slot->seq;
+        err = stream_send_part(req, slot);
+        uint32_t len = slot->len;
+        slot_put(slot);
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        if (err != ESP_OK)
+        {
+            break;
+        }
+        sent++;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.sent++;
+        s_stats.bytes += len;
+        s_stats.send_us += us;
+        if (us > s_stats.max_send_us)
+        {
+            s_stats.max_send_us = us;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        // 发得比间隔还慢的客户端不补 从现在起再等一个间隔
+        next = LV_MAX(next + c->interval_us, t0);
+    }
+    if (err == ESP_OK)
+    {
+        httpd_resp_send_chunk(req, NULL, 0);
+    }
+    float sec = (esp_timer_get_time() - t_start) / 1e6f;
+    ESP_LOGI(TAG, "client %d: %lu frames in %.1f s (%.1f fps)%s", httpd_req_to_sockfd(req), (unsigned long)sent, sec,
+             sec > 0 ? sent / sec : 0.0f, err == ESP_OK ? "" : ", disconnected");
+    httpd_req_async_handler_complete(req);
+
+    portENTER_CRITICAL(&s_lock);
+    c->ready = false;
+    c->used = false;
+    s_stats.clients--;
+    portEXIT_CRITICAL(&s_lock);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t index_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html");
+    return httpd_resp_send(req, s_index_html, HTTPD_RESP_USE_STRLEN);
+}
+
+// 在httpd任务里只占一个客户端位置 转成异步请求交给自己的任务 httpd马上能接下一个
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+    // ?fps=N 可以把这个客户端压得比上限更低
+    int fps = CAM_STREAM_MAX_FPS;
+    char query[32];
+    char value[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK)
+    {
+        int want = atoi(value);
+        if (want > 0 && want < fps)
+        {
+            fps = want;
+        }
+    }
+
+    stream_client_t *c = NULL;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < CAM_STREAM_MAX_CLIENTS && !s_stopping; i++)
+    {
+        if (!s_clients[i].used)
+        {
+            c = &s_clients[i];
+            c->used = true;
+            c->ready = false;
+            c->interval_us = 1000000 / fps;
+            s_stats.clients++;
+            s_stats.connections++;
+            break;
+        }
+    }
+    if (c == NULL)
+    {
+        s_stats.rejected++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (c == NULL)
+    {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "too many viewers", HTTPD_RESP_USE_STRLEN);
+    }
+
+    esp_err_t err = httpd_req_async_handler_begin(req, &c->req);
+    if (err == ESP_OK &&
+        task_plan_create(TASK_CAM_STREAM, stream_client_task, c, NULL) != pdPASS)
+    {
+        httpd_req_async_handler_complete(c->req);
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        c->used = false;
+        s_stats.clients--;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGW(TAG, "stream client: %s", esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void stream_free(void)
+{
+    for (int i = 0; i < CAM_STREAM_SLOTS; i++)
+    {
+        heap_caps_free(s_slots[i].buf);
+    }
+    memset(s_slots, 0, sizeof(s_slots));
+    s_latest = NULL;
+    for (int i = 0; i < CAM_STREAM_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].wake)
+        {
+            vSemaphoreDelete(s_clients[i].wake);
+            s_clients[i].wake = NULL;
+        }
+    }
+}
+
+esp_err_t cam_stream_start(void)
+{
+    ESP_RETURN_ON_FALSE(s_server == NULL, ESP_ERR_INVALID_STATE, TAG, "already streaming");
+    for (int i = 0; i < CAM_STREAM_SLOTS; i++)
+    {
+        s_slots[i].buf = heap_caps_malloc(CAM_STREAM_FRAME_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (s_slots[i].buf == NULL)
+        {
+            stream_free();
+            ESP_LOGE(TAG, "stream slots alloc failed");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    memset(s_clients, 0, sizeof(s_clients));
+    for (int i = 0; i < CAM_STREAM_MAX_CLIENTS; i++)
+    {
+        s_clients[i].wake = xSemaphoreCreateBinary();
+        if (s_clients[i].wake == NULL)
+        {
+            stream_free();
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_seq = 0;
+    s_stopping = false;
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_APP_STREAM_PORT;
+    config.core_id = task_plan_get(TASK_HTTPD)->core;
+    config.task_priority = task_plan_get(TASK_HTTPD)->prio;
+    config.max_open_sockets = CAM_STREAM_MAX_CLIENTS + 2;   // 多留两个给首页和被拒的
+    config.lru_purge_enable = true;
+    config.send_wait_timeout = STREAM_SEND_TIMEOUT;
+    esp_err_t err = httpd_start(&s_server, &config);
+    if (err != ESP_OK)
+    {
+        s_server = NULL;
+        stream_free();
+        ESP_LOGE(TAG, "httpd start failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    static const httpd_uri_t uris[] = {
+        {.uri = "/", .method = HTTP_GET, .handler = index_handler},
+        {.uri = "/stream", .method = HTTP_GET, .handler = stream_handler},
+    };
+    for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        httpd_register_uri_handler(s_server, &uris[i]);
+    }
+    ESP_LOGI(TAG, "streaming on port %d, up to %d viewers at %d fps", CONFIG_APP_STREAM_PORT, CAM_STREAM_MAX_CLIENTS,
+             CAM_STREAM_MAX_FPS);
+    return ESP_OK;
+}
+
+bool cam_stream_active(void)
+{
+    return s_server != NULL;
+}
+
+bool cam_stream_frame(const camera_fb_t *frame)
+{
+    if (s_server == NULL || frame->format != PIXFORMAT_JPEG)
+    {
+        return false;
+    }
+    // 挑一个谁都没在用的槽位 槽位比客户端多两个 一定有
+    stream_slot_t *slot = NULL;
+    bool want = false;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < CAM_STREAM_MAX_CLIENTS; i++)
+    {
+        want |= s_clients[i].used && s_clients[i].ready;
+    }
+    if (s_stats.clients && !want)
+    {
+        s_stats.skipped++;
+    }
+    for (int i = 0; i < CAM_STREAM_SLOTS && want; i++)
+    {
+        if (s_slots[i].refs == 0)
+        {
+            slot = &s_slots[i];
+            slot->refs = 1;             // 拷完就变成最新帧的那一个引用
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (slot == NULL)
+    {
+        return false;
+    }
+    if (frame->len > CAM_STREAM_FRAME_BYTES)
+    {
+        slot_put(slot);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.oversized++;
+        portEXIT_CRITICAL(&s_lock);
+        return false;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    memcpy(slot->buf, frame->buf, frame->len);
+    slot->len = frame->len;
+    slot->timestamp = frame->timestamp;
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+
+    SemaphoreHandle_t wake[CAM_STREAM_MAX_CLIENTS];
+    int n = 0;
+    portENTER_CRITICAL(&s_lock);
+    if (++s_seq == 0)
+    {
+        s_seq = 1;                      // 0留给客户端表示还没发过
+    }
+    slot->seq = s_seq;
+    stream_slot_t *old = s_latest;
+    s_latest = slot;
+    if (old)
+    {
+        old->refs--;
+    }
+    for (int i = 0; i < CAM_STREAM_MAX_CLIENTS; i++)
+    {
+        if (s_clients[i].used && s_clients[i].ready)
+        {
+            wake[n++] = s_clients[i].wake;
+        }
+    }
+    s_stats.published++;
+    s_stats.copy_us += us;
+    portEXIT_CRITICAL(&s_lock);
+    for (int i = 0; i < n; i++)
+    {
+        xSemaphoreGive(wake[i]);
+    }
+    return true;
+}
+
+void cam_stream_stop(void)
+{
+    if (s_server == NULL)
+    {
+        return;
+    }
+    // 先让客户端任务都退出 它们complete了异步请求才能停httpd
+    s_stopping = true;
+    for (;;)
+    {
+        portENTER_CRITICAL(&s_lock);
+        uint32_t clients = s_stats.clients;
+        portEXIT_CRITICAL(&s_lock);
+        if (clients == 0)
+        {
+            break;
+        }
+        for (int i = 0; i < CAM_STREAM_MAX_CLIENTS; i++)
+        {
+            xSemaphoreGive(s_clients[i].wake);
+        }
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    httpd_stop(s_server);
+    s_server = NULL;
+    stream_free();
+}
+
+void cam_stream_get_stats(cam_stream_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+
+
+/*********************** 局域网MJPEG直播 ****************************/
+// 浏览器打开 http://<ip>/ 看 /stream 是multipart/x-mixed-replace 每一段是一张摄像头给的JPEG
+// 取帧任务只把帧拷进一个PSRAM槽位 所有客户端都从这个槽位直接send 不再各拷一份
+// 槽位带引用计数 客户端发完才放 槽位比客户端多两个 取帧任务总有空槽位 不会等网络
+// 每个客户端一个core 0上的任务 按自己的帧率上限节拍 发得慢的只拿最新的那帧 中间的直接跳过
+// 没有客户端在等帧的时候连拷贝都省掉
+
+#define CAM_STREAM_MAX_CLIENTS  CONFIG_APP_STREAM_MAX_CLIENTS
+#define CAM_STREAM_SLOTS        (CAM_STREAM_MAX_CLIENTS + 2)
+#define CAM_STREAM_FRAME_BYTES  (CONFIG_APP_STREAM_FRAME_KB * 1024)
+#define CAM_STREAM_MAX_FPS      CONFIG_APP_STREAM_MAX_FPS
+
+typedef struct {
+    uint32_t clients;                   // 现在连着的
+    uint32_t connections;               // 一共连过的
+    uint32_t rejected;                  // 客户端满了或者正在停 没接的
+    uint32_t published;                 // 拷进槽位的帧
+    uint32_t skipped;                   // 有客户端连着但都还在发或者没到点 没拷的帧
+    uint32_t oversized;                 // 比槽位大丢掉的
+    uint32_t sent;                      // 发出去的帧 所有客户端加起来
+    uint64_t bytes;                     // 发出去的JPEG字节
+    uint64_t copy_us;                   // 取帧任务里拷帧花的时间
+    uint64_t send_us;                   // 客户端任务花在发一帧上的时间
+    uint32_t max_send_us;
+} cam_stream_stats_t;
+
+esp_err_t cam_stream_start(void);       // 起HTTP服务 要先连上WiFi
+bool cam_stream_active(void);
+bool cam_stream_frame(const camera_fb_t *frame);    // 取帧任务里调用 只收JPEG 拷完就返回 frame可以马上还给驱动
+void cam_stream_stop(void);             // 断开所有客户端再停服务 会阻塞 不要在LVGL任务里调用
+void cam_stream_get_stats(cam_stream_stats_t *stats);
@@ -0,0 +1,134 @@
+#include <string.h>
+#include "cam_timelapse.h"
+#include "cam_capture.h"
+#include "esp_camera.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "cam_timelapse";
+
+#define TIMELAPSE_STOP_GPIO     GPIO_NUM_0      // 板子上的BOOT键 外部上拉 按下是低
+
+static bool stop_pressed(void)
+{
+    return gpio_get_level(TIMELAPSE_STOP_GPIO) == 0;
+}
+
+// 上电 取一帧 写盘 断电 t_saved是文件关闭的时刻
+static bool timelapse_shot(bsp_camera_mode_t mode, char *path, size_t len, int64_t *t_saved)
+{
+    // ESP_ERR_NOT_SUPPORTED是退回了RGB565 摄像头还是起来了
+    esp_err_t err = bsp_camera_init_mode(mode);
+    if (err != ESP_OK && err != ESP_ERR_NOT_SUPPORTED)
+    {
+        *t_saved = esp_timer_get_time();
+        dvp_pwdn(1);
+        return false;
+    }
+    camera_fb_t *frame = NULL;
+    for (int i = 0; i <= CAM_TIMELAPSE_SETTLE; i++)
+    {
+        if (frame)
+        {
+            esp_camera_fb_return(frame);
+        }
+        frame = esp_camera_fb_get();
+        if (frame == NULL)
+        {
+            break;
+        }
+    }
+    bool ok = frame && cam_capture_save(frame, path, len) == ESP_OK;
+    *t_saved = esp_timer_get_time();
+    if (frame)
+    {
+        esp_camera_fb_return(frame);
+    }
+    esp_camera_deinit();
+    dvp_pwdn(1);
+    return ok;
+}
+
+esp_err_t cam_timelapse_run(bsp_camera_mode_t mode, cam_timelapse_stats_t *stats)
+{
+    const gpio_config_t io = {
+        .pin_bit_mask = BIT64(TIMELAPSE_STOP_GPIO),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io), TAG, "boot key config failed");
+    ESP_RETURN_ON_ERROR(gpio_wakeup_enable(TIMELAPSE_STOP_GPIO, GPIO_INTR_LOW_LEVEL), TAG, "gpio wakeup failed");
+    esp_sleep_enable_gpio_wakeup();
+
+    memset(stats, 0, sizeof(*stats));
+    const int64_t interval = CAM_TIMELAPSE_INTERVAL_MS * 1000LL;
+    int64_t t_start = esp_timer_get_time();
+    int64_t due = t_start;
+    ESP_LOGI(TAG, "timelapse every %d s, press BOOT to stop", CONFIG_APP_TIMELAPSE_INTERVAL_S);
+    bsp_display_backlight_off();
+
+    while (!stop_pressed())
+    {
+        int64_t t_wake = esp_timer_get_time();
+        char path[128];
+        int64_t t_saved = t_wake;
+        bool ok = timelapse_shot(mode, path, sizeof(path), &t_saved);
+        uint32_t us = t_saved - t_wake;
+        if (ok)
+        {
+            stats->frames++;
+            stats->wake_us += us;
+            if (us > stats->max_wake_us)
+            {
+                stats->max_wake_us = us;
+            }
+            ESP_LOGI(TAG, "#%lu %s, %lu ms after wake", (unsigned long)stats->frames, path, (unsigned long)us / 1000);
+        }
+        else
+        {
+            stats->failed++;
+        }
+
+        // 下一个还没过去的时刻 醒着太久错过的算晚
+        due += interval;
+        while (due <= esp_timer_get_time())
+        {
+            due += interval;
+            stats->late++;
+        }
+        int64_t t_sleep = esp_timer_get_time();
+        stats->awake_us += t_sleep - t_wake;
+        esp_sleep_enable_timer_wakeup(due - t_sleep);
+        // 日志没发完就睡会吐乱码
+        fflush(stdout);
+        esp_light_sleep_start();
+        stats->sleep_us += esp_timer_get_time() - t_sleep;
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO)
+        {
+            break;
+        }
+    }
+
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_TIMER);
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+    gpio_wakeup_disable(TIMELAPSE_STOP_GPIO);
+    bsp_display_backlight_on();
+    // 等BOOT松开 不然回到预览马上又被当成按下
+    while (stop_pressed())
+    {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+
+    uint64_t total = stats->awake_us + stats->sleep_us;
+    if (total)
+    {
+        stats->avg_ma = (stats->awake_us * (float)CONFIG_APP_TIMELAPSE_ACTIVE_MA +
+                         stats->sleep_us * (float)CONFIG_APP_TIMELAPSE_SLEEP_MA) / total;
+    }
+    return ESP_OK;
+}
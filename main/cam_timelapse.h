@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp32_s3_szp.h"
+#include "sdkconfig.h"
+
+
+/*********************** 延时摄影 ****************************/
+// 每个间隔: 摄像头上电 丢掉几帧等曝光稳定 取一帧同步写SD卡 摄像头断电 浅睡到下一个时刻
+// 时刻按开始时间加整数个间隔算 睡眠期间背光关掉 按BOOT键唤醒并结束
+// 板子测不了电流 每帧的平均电流用实测的醒着和睡着的时间乘Kconfig里的两个电流估算
+
+#define CAM_TIMELAPSE_INTERVAL_MS   (CONFIG_APP_TIMELAPSE_INTERVAL_S * 1000)
+#define CAM_TIMELAPSE_SETTLE        CONFIG_APP_TIMELAPSE_SETTLE_FRAMES
+
+typedef struct {
+    uint32_t frames;                    // 存下来的
+    uint32_t failed;                    // 摄像头起不来 取不到帧或者写盘失败
+    uint32_t late;                      // 醒来干活超过了一个间隔 跳过的时刻
+    uint64_t wake_us;                   // 醒来到文件关闭
+    uint32_t max_wake_us;
+    uint64_t awake_us;                  // 醒着的总时间 包括写盘之后断电收尾
+    uint64_t sleep_us;
+    float avg_ma;                       // 估算的平均电流
+} cam_timelapse_stats_t;
+
+// 在摄像头任务里调用 进来时摄像头已经deinit 一直拍到按下BOOT才返回 返回时摄像头是断电的
+esp_err_t cam_timelapse_run(bsp_camera_mode_t mode, cam_timelapse_stats_t *stats);
@@ -0,0 +1,199 @@
+#include <string.h>
+#include "cam_zoom.h"
+#include "esp_camera.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "cam_zoom";
+
+#define ZOOM_MAX_X          (CAM_ZOOM_ARRAY_W - CAM_ZOOM_OUT_W)
+#define ZOOM_MAX_Y          (CAM_ZOOM_ARRAY_H - CAM_ZOOM_OUT_H)
+
+static volatile int s_want_step;
+static volatile int s_pan_dx, s_pan_dy;         // 还没写进传感器的拖动
+static volatile bool s_dirty = true;            // 要重写寄存器
+static int s_step = -1;                         // 传感器上现在的档 -1是默认的
+static int s_win_x = ZOOM_MAX_X / 2, s_win_y = ZOOM_MAX_Y / 2;
+static int64_t s_t_step;
+static cam_zoom_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int zoom_reg(sensor_t *s, int reg, int val)
+{
+    return s->set_reg(s, reg, 0xff, val);
+}
+
+// 感光区上开窗 GC0308的窗口高宽寄存器比实际多8
+static int zoom_window(sensor_t *s, int x, int y, int w, int h)
+{
+    int ret = zoom_reg(s, 0xfe, 0x00);
+    ret |= zoom_reg(s, 0x05, y >> 8);
+    ret |= zoom_reg(s, 0x06, y & 0xff);
+    ret |= zoom_reg(s, 0x07, x >> 8);
+    ret |= zoom_reg(s, 0x08, x & 0xff);
+    ret |= zoom_reg(s, 0x09, (h + 8) >> 8);
+    ret |= zoom_reg(s, 0x0a, (h + 8) & 0xff);
+    ret |= zoom_reg(s, 0x0b, (w + 8) >> 8);
+    ret |= zoom_reg(s, 0x0c, (w + 8) & 0xff);
+    return ret;
+}
+
+// 抽样比例 0x11是不抽 0x22是行列各1/2 后面再裁出输出大小
+static int zoom_subsample(sensor_t *s, bool half)
+{
+    int ret = s->set_reg(s, 0x53, 0x80, half ? 0x80 : 0x00);
+    ret |= zoom_reg(s, 0x54, half ? 0x22 : 0x11);
+    ret |= zoom_reg(s, 0x46, half ? 0x80 : 0x00);
+    ret |= zoom_reg(s, 0x47, 0x00);
+    ret |= zoom_reg(s, 0x48, 0x00);
+    ret |= zoom_reg(s, 0x49, CAM_ZOOM_OUT_H >> 8);
+    ret |= zoom_reg(s, 0x4a, CAM_ZOOM_OUT_H & 0xff);
+    ret |= zoom_reg(s, 0x4b, CAM_ZOOM_OUT_W >> 8);
+    ret |= zoom_reg(s, 0x4c, CAM_ZOOM_OUT_W & 0xff);
+    return ret;
+}
+
+bool cam_zoom_supported(void)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    return s && s->id.PID == GC0308_PID && s->pixformat != PIXFORMAT_JPEG && s->status.framesize == FRAMESIZE_QVGA;
+}
+
+void cam_zoom_request(int step)
+{
+    if (step < 0 || step >= CAM_ZOOM_STEPS)
+    {
+        return;
+    }
+    s_want_step = step;
+    s_dirty = true;
+}
+
+void cam_zoom_pan(int dx, int dy)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_pan_dx += dx;
+    s_pan_dy += dy;
+    portEXIT_CRITICAL(&s_lock);
+    s_dirty = true;
+}
+
+int cam_zoom_step(void)
+{
+    return s_want_step;
+}
+
+static void zoom_count_step(int64_t now)
+{
+    if (s_step >= 0)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.us[s_step] += now - s_t_step;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    s_t_step = now;
+}
+
+bool cam_zoom_poll(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (s_step >= 0)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.frames[s_step]++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    if (!s_dirty)
+    {
+        return false;
+    }
+    s_dirty = false;
+    sensor_t *s = esp_camera_sensor_get();
+    if (!cam_zoom_supported())
+    {
+        return false; // JPEG或者别的传感器 请求留着也没用
+    }
+    portENTER_CRITICAL(&s_lock);
+    int dx = s_pan_dx, dy = s_pan_dy;
+    s_pan_dx = s_pan_dy = 0;
+    portEXIT_CRITICAL(&s_lock);
+    int step = s_want_step;
+    // 开了水平镜像 感光区的x和屏幕反着 拖的方向是画面跟着手走 窗口往反方向挪
+    s_win_x += s->status.hmirror ? dx : -dx;
+    s_win_y -= dy;
+    s_win_x = s_win_x < 0 ? 0 : s_win_x > ZOOM_MAX_X ? ZOOM_MAX_X : s_win_x;
+    s_win_y = s_win_y < 0 ? 0 : s_win_y > ZOOM_MAX_Y ? ZOOM_MAX_Y : s_win_y;
+    if (step == s_step && (step == 0 || (dx == 0 && dy == 0)))
+    {
+        return false; // 1x没有平移
+    }
+
+    int ret;
+    if (step == 0)
+    {
+        ret = zoom_window(s, 0, 0, CAM_ZOOM_ARRAY_W, CAM_ZOOM_ARRAY_H);
+        ret |= zoom_subsample(s, true);
+    }
+    else if (step == s_step)
+    {
+        ret = zoom_window(s, s_win_x, s_win_y, CAM_ZOOM_OUT_W, CAM_ZOOM_OUT_H);
+    }
+    else
+    {
+        ret = zoom_subsample(s, false);
+        ret |= zoom_window(s, s_win_x, s_win_y, CAM_ZOOM_OUT_W, CAM_ZOOM_OUT_H);
+    }
+    int64_t t1 = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_stats.write_us += t1 - now;
+    s_stats.failed += ret != 0;
+    if (step != s_step)
+    {
+        s_stats.switches += s_step >= 0;
+    }
+    else
+    {
+        s_stats.pans++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (ret)
+    {
+        ESP_LOGW(TAG, "sensor window write failed");
+    }
+    if (step != s_step)
+    {
+        zoom_count_step(now);
+        s_step = step;
+    }
+    return true;
+}
+
+void cam_zoom_reapply(void)
+{
+    zoom_count_step(esp_timer_get_time());
+    s_step = -1;
+    s_dirty = true;
+}
+
+void cam_zoom_reset(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_pan_dx = s_pan_dy = 0;
+    portEXIT_CRITICAL(&s_lock);
+    s_want_step = 0;
+    s_step = -1;
+    s_win_x = ZOOM_MAX_X / 2;
+    s_win_y = ZOOM_MAX_Y / 2;
+    s_dirty = true;
+    s_t_step = esp_timer_get_time();
+}
+
+void cam_zoom_get_stats(cam_zoom_stats_t *stats)
+{
+    zoom_count_step(esp_timer_get_time());
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 传感器裁剪变焦 ****************************/
+// 不在LVGL里缩放 改GC0308的输出窗口 出来的帧已经是320x240 CPU不用动像素
+// GC0308没有任意比例的缩放器 esp32-camera也没给它实现set_res_raw 直接写寄存器:
+//   1x: 整个640x480的感光区 行列各1/2抽样 再裁出320x240
+//   2x: 不抽样 感光区里开一个320x240的窗口 窗口起点就是平移
+// 双指张开合拢换档 2x时单指拖动平移 都只记下请求 在取帧任务里写寄存器
+// 每一档记帧数和时间 换档和退出时报帧率
+
+#define CAM_ZOOM_ARRAY_W        640
+#define CAM_ZOOM_ARRAY_H        480
+#define CAM_ZOOM_OUT_W          320
+#define CAM_ZOOM_OUT_H          240
+#define CAM_ZOOM_STEPS          2       // 1x 2x
+#define CAM_ZOOM_PINCH_PCT      130     // 两指距离变到开始时的这么多(或者倒数)算一档
+
+typedef struct {
+    uint32_t frames[CAM_ZOOM_STEPS];    // 每一档收到的帧
+    uint64_t us[CAM_ZOOM_STEPS];        // 每一档待了多久
+    uint32_t switches;
+    uint32_t pans;                      // 写过窗口起点的次数 拖动时合并
+    uint64_t write_us;                  // 写寄存器花的时间
+    uint32_t failed;                    // 写寄存器出错
+} cam_zoom_stats_t;
+
+bool cam_zoom_supported(void);          // 现在的传感器能这样变焦 摄像头初始化以后调
+void cam_zoom_request(int step);        // 任何任务里调 0是1x
+void cam_zoom_pan(int dx, int dy);      // 屏幕上拖动的像素 任何任务里调 只在2x时有用
+int cam_zoom_step(void);
+// 取帧任务里每帧调一次 有请求就写寄存器 返回true是这一帧以后换了档或者挪了窗口
+bool cam_zoom_poll(void);
+void cam_zoom_reapply(void);            // 摄像头重新初始化以后 寄存器回到了默认 按现在的档重写
+void cam_zoom_reset(void);              // 退出相机 回到1x 统计清零
+void cam_zoom_get_stats(cam_zoom_stats_t *stats);
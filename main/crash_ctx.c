@@ -0,0 +1,216 @@
+#include <stdlib.h>
+#include <string.h>
+#include "crash_ctx.h"
+#include "ui_perf.h"
+#include "flash_log.h"
+#include "esp_core_dump.h"
+#include "esp_partition.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+
+#if CONFIG_APP_CRASH_CTX
+
+static const char *TAG = "crash_ctx";
+
+#define CRASH_CTX_LEASE_MS      (3 * CONFIG_APP_TELEMETRY_PERIOD_MS)
+
+typedef struct {
+    const char *name;
+    SemaphoreHandle_t lock;
+    TaskHandle_t holder;                // 上一次看到的
+} watch_t;
+
+// 只有esp_timer任务写 转储时原样带走
+static COREDUMP_DRAM_ATTR crash_ctx_snap_t s_snap;
+static uint32_t s_cursor;               // 遥测环的游标
+static watch_t s_watch[CRASH_CTX_LOCKS];
+static int s_nwatch = 1;                // 第0个是LVGL锁
+static esp_timer_handle_t s_timer;
+static const esp_partition_t *s_part;
+static size_t s_dump_off;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static crash_ctx_stats_t s_stats;
+
+static void snap_locks(uint32_t now_ms)
+{
+    crash_ctx_lock_t *l = &s_snap.lock[0];
+    ui_lock_site_t h;
+    if (ui_lock_get_holder(&h))
+    {
+        l->func = h.func;
+        l->line = h.line;
+        memcpy(l->holder, h.task, sizeof(l->holder));
+        l->since_ms = now_ms - h.max_us / 1000;
+    }
+    else
+    {
+        l->func = NULL;
+        l->line = 0;
+        l->holder[0] = '\0';
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    int n = s_nwatch;
+    portEXIT_CRITICAL(&s_lock);
+    for (int i = 1; i < n; i++)
+    {
+        l = &s_snap.lock[i];
+        l->name = s_watch[i].name;
+        TaskHandle_t t = xSemaphoreGetMutexHolder(s_watch[i].lock);
+        if (t != s_watch[i].holder)
+        {
+            s_watch[i].holder = t;
+            l->since_ms = now_ms;
+            strlcpy(l->holder, t ? pcTaskGetName(t) : "", sizeof(l->holder));
+        }
+    }
+    s_snap.locks = n;
+}
+
+// 续租约 抄名字和新采的行 看一遍锁 esp_timer任务里 不阻塞
+static void snap_cb(void *arg)
+{
+    int64_t t0 = esp_timer_get_time();
+    telemetry_lease(CRASH_CTX_LEASE_MS);
+
+    int count = telemetry_count();
+    for (int i = s_snap.metrics; i < count; i++)
+    {
+        strlcpy(s_snap.names[i], telemetry_name(i), sizeof(s_snap.names[i]));
+        s_snap.kinds[i] = telemetry_kind(i);
+    }
+    s_snap.metrics = count;
+
+    // 先读到栈上 读的时候被覆盖的行不会弄脏环里最旧的一行
+    telemetry_row_t row;
+    int rows = 0;
+    while (telemetry_read(&s_cursor, &row, 1) == 1)
+    {
+        s_snap.row[s_snap.head % CRASH_CTX_ROWS] = row;
+        s_snap.head++;
+        rows++;
+    }
+    uint32_t now_ms = t0 / 1000;
+    snap_locks(now_ms);
+    s_snap.t_ms = now_ms;
+
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.snaps++;
+    s_stats.rows += rows;
+    s_stats.max_us = us > s_stats.max_us ? us : s_stats.max_us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 上次死机留下的转储 校验过才算
+static void dump_check(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, NULL);
+    if (s_part == NULL)
+    {
+        ESP_LOGW(TAG, "no coredump partition"); // OTA升上来的机器还是旧分区表
+        return;
+    }
+    size_t addr;
+    size_t size;
+    if (esp_core_dump_image_get(&addr, &size) != ESP_OK)
+    {
+        return;
+    }
+    if (esp_core_dump_image_check() != ESP_OK)
+    {
+        ESP_LOGW(TAG, "core dump of %u bytes is corrupt", (unsigned)size);
+        return;
+    }
+    esp_core_dump_summary_t *sum = calloc(1, sizeof(*sum));
+    if (sum && esp_core_dump_get_summary(sum) == ESP_OK)
+    {
+        strlcpy(s_stats.dump_task, sum->exc_task, sizeof(s_stats.dump_task));
+        s_stats.dump_pc = sum->exc_pc;
+    }
+    free(sum);
+    s_dump_off = addr - s_part->address;
+    s_stats.dump_size = size;
+    s_stats.dump = true;
+    ESP_LOGW(TAG, "core dump from the last crash: %u bytes, task %s, pc 0x%08lx, GET /api/coredump",
+             (unsigned)size, s_stats.dump_task, (unsigned long)s_stats.dump_pc);
+    FLOG("coredump: %lu bytes, pc 0x%08lx", (uint32_t)size, s_stats.dump_pc);
+}
+
+esp_err_t crash_ctx_init(void)
+{
+    if (s_timer)
+    {
+        return ESP_OK;
+    }
+    dump_check();
+
+    memset(&s_snap, 0, sizeof(s_snap));
+    s_snap.magic = CRASH_CTX_MAGIC;
+    s_snap.version = CRASH_CTX_VERSION;
+    s_snap.rows = CRASH_CTX_ROWS;
+    s_snap.period_ms = CONFIG_APP_TELEMETRY_PERIOD_MS;
+    s_snap.lock[0].name = "lvgl";
+    s_cursor = telemetry_head();
+
+    const esp_timer_create_args_t args = {
+        .callback = snap_cb,
+        .name = "crash_ctx",
+        .skip_unhandled_events = true,
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "create timer");
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(s_timer, (uint64_t)CONFIG_APP_TELEMETRY_PERIOD_MS * 1000), TAG, "start timer");
+    telemetry_lease(CRASH_CTX_LEASE_MS);
+    ESP_LOGI(TAG, "keeping %d telemetry rows (%u bytes) for the core dump", CRASH_CTX_ROWS, (unsigned)sizeof(s_snap));
+    return ESP_OK;
+}
+
+void crash_ctx_watch_lock(const char *name, SemaphoreHandle_t lock)
+{
+    bool full;
+    portENTER_CRITICAL(&s_lock);
+    full = s_nwatch >= CRASH_CTX_LOCKS;
+    if (!full)
+    {
+        s_watch[s_nwatch].name = name;
+        s_watch[s_nwatch].lock = lock;
+        s_nwatch++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (full)
+    {
+        ESP_LOGW(TAG, "no slot for lock %s", name);
+    }
+}
+
+size_t crash_ctx_dump_size(void)
+{
+    return s_stats.dump ? s_stats.dump_size : 0;
+}
+
+esp_err_t crash_ctx_dump_read(size_t off, void *buf, size_t len)
+{
+    ESP_RETURN_ON_FALSE(s_stats.dump && off + len <= s_stats.dump_size, ESP_ERR_INVALID_ARG, TAG, "read past dump");
+    return esp_partition_read(s_part, s_dump_off + off, buf, len);
+}
+
+esp_err_t crash_ctx_dump_erase(void)
+{
+    ESP_RETURN_ON_ERROR(esp_core_dump_image_erase(), TAG, "erase failed");
+    s_stats.dump = false;
+    s_stats.dump_size = 0;
+    ESP_LOGI(TAG, "core dump erased");
+    return ESP_OK;
+}
+
+void crash_ctx_get_stats(crash_ctx_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
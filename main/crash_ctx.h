@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "telemetry.h"
+#include "sdkconfig.h"
+
+
+/*********************** 死机现场 ****************************/
+// panic和中断看门狗复位时IDF把核心转储(ELF格式 各任务的TCB和栈)写进coredump分区 下次开机在这里报一声
+// 光有栈分不清是逻辑错还是被饿死的 所以每个遥测周期把遥测环里新采的行抄进s_snap 留最近CRASH_CTX_ROWS行
+//   CPU 堆 PCM缓冲 内存池 刷新耗时 各模块注册了的列都在 再加上登记过的锁现在谁拿着 从哪一次看到开始拿着
+// s_snap用COREDUMP_DRAM_ATTR放在转储会带上的那段内部RAM里 跟转储一起写进flash 死的时候不用另外做事
+// 为了一直有行可抄 一直续着遥测的租约 每个周期多采一行
+// 下载: GET /api/coredump 清掉: DELETE /api/coredump 或者parttool.py读coredump分区
+// 主机端: espcoredump.py info_corefile -t raw -c coredump.bin <ELF> 看栈
+//         tools/crash_ctx/crash_ctx_decode.py coredump.bin <ELF> 按CRASH_CTX_MAGIC找出s_snap 打成表
+// 欠压 断电和任务看门狗(默认只打印不复位)没有转储
+
+#define CRASH_CTX_MAGIC         0x58544343      // "CCTX"
+#define CRASH_CTX_VERSION       1
+#define CRASH_CTX_ROWS          CONFIG_APP_CRASH_CTX_ROWS
+#define CRASH_CTX_LOCKS         8       // 第0个是LVGL锁 由ui_perf记持有者
+
+typedef struct {
+    const char *name;                   // 字符串常量的地址 解码时从ELF取
+    const char *func;                   // LVGL锁是拿锁的函数 别的锁是NULL
+    int32_t line;
+    char holder[16];                    // 没人拿是空串
+    uint32_t since_ms;                  // LVGL锁是拿到的时刻 别的锁是第一次看到这个持有者的时刻
+} crash_ctx_lock_t;
+
+// 转储里的格式 全部小端 改了要加CRASH_CTX_VERSION 同步改解码脚本
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t rows;                      // CRASH_CTX_ROWS
+    uint16_t metrics;                   // 抄了名字的列数
+    uint16_t locks;
+    uint32_t period_ms;
+    uint32_t head;                      // 下一行写到row[head % rows]
+    uint32_t t_ms;                      // 最后一次抄的时刻
+    char names[TELEMETRY_MAX_METRICS][TELEMETRY_NAME_LEN];
+    uint8_t kinds[TELEMETRY_MAX_METRICS];
+    crash_ctx_lock_t lock[CRASH_CTX_LOCKS];
+    telemetry_row_t row[CRASH_CTX_ROWS];
+} crash_ctx_snap_t;
+
+typedef struct {
+    bool dump;                          // 分区里有上次的转储
+    uint32_t dump_size;
+    char dump_task[16];                 // 死在哪个任务
+    uint32_t dump_pc;
+    uint32_t snaps;                     // 抄了几次
+    uint32_t rows;                      // 抄进来的行
+    uint32_t max_us;                    // 抄一次最长
+} crash_ctx_stats_t;
+
+#if CONFIG_APP_CRASH_CTX
+esp_err_t crash_ctx_init(void);         // telemetry_init以后调 看上次的转储 开始抄
+void crash_ctx_watch_lock(const char *name, SemaphoreHandle_t lock);   // name要是字符串常量 满了不记
+size_t crash_ctx_dump_size(void);       // 没有转储是0
+esp_err_t crash_ctx_dump_read(size_t off, void *buf, size_t len);      // 原样读 给下载用
+esp_err_t crash_ctx_dump_erase(void);
+void crash_ctx_get_stats(crash_ctx_stats_t *stats);
+#endif
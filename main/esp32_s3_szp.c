@@ -1,7 +1,28 @@
 #include <stdio.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "esp32_s3_szp.h"
+#include "freertos/semphr.h"
 #include "lvgl.h"
 #include "src/extra/lv_extra.h"
+#include "lcd_draw.h"
+#include "sd_fs.h"
+#include "fd_pool.h"
+#include "sd_dir_cache.h"
+#include "media_lib.h"
+#include "mem_pool.h"
+#include "ui_mem.h"
+#include "task_plan.h"
+#include "i2c_bus.h"
+#include "pm_ctl.h"
+#include "idle_mgr.h"
+#include "sys_trace.h"
+#include "psram_bw.h"
+#include "diskio_sdmmc.h"
+#include "esp_lcd_panel_commands.h"
+#include "driver/gpio.h"
+#include "esp_rom_sys.h"
+#include "esp_sleep.h"
 
 static const char *TAG = "esp32_s3_szp";
 
@@ -18,8 +39,9 @@ esp_err_t bsp_i2c_init(void)
         .master.clk_speed = BSP_I2C_FREQ_HZ
     };
     i2c_param_config(BSP_I2C_NUM, &i2c_conf);
+    ESP_RETURN_ON_ERROR(i2c_driver_install(BSP_I2C_NUM, i2c_conf.mode, 0, 0, 0), TAG, "i2c driver install");
 
-    return i2c_driver_install(BSP_I2C_NUM, i2c_conf.mode, 0, 0, 0);
+    return i2c_bus_start(); // 以后的传输都排队给一个任务做 触摸优先
 }
 /***************************  I2C ↑  *******************************************/
 /*******************************************************************************/
@@ -31,7 +53,7 @@ esp_err_t bsp_i2c_init(void)
 // 读取QMI8658寄存器的值
 esp_err_t qmi8658_register_read(uint8_t reg_addr, uint8_t *data, size_t len)
 {
-    return i2c_master_write_read_device(BSP_I2C_NUM, QMI8658_SENSOR_ADDR,  &reg_addr, 1, data, len, 1000 / portTICK_PERIOD_MS);
+    return i2c_bus_write_read(I2C_BUS_IMU, &reg_addr, 1, data, len);
 }
 
 // 给QMI8658的寄存器写值
@@ -39,7 +61,7 @@ esp_err_t qmi8658_register_write_byte(uint8_t reg_addr, uint8_t data)
 {
     uint8_t write_buf[2] = {reg_addr, data};
 
-    return i2c_master_write_to_device(BSP_I2C_NUM, QMI8658_SENSOR_ADDR, write_buf, sizeof(write_buf), 1000 / portTICK_PERIOD_MS);
+    return i2c_bus_write(I2C_BUS_IMU, write_buf, sizeof(write_buf));
 }
 
 // 初始化qmi8658
@@ -89,8 +111,8 @@ esp_err_t qmi8658_init(void)
 
     qmi8658_register_write_byte(QMI8658_CTRL1, 0x40); // CTRL1 设置地址自动增加
     qmi8658_register_write_byte(QMI8658_CTRL7, 0x03); // CTRL7 允许加速度和陀螺仪
-    qmi8658_register_write_byte(QMI8658_CTRL2, 0x95); // CTRL2 设置ACC 4g 250Hz
-    qmi8658_register_write_byte(QMI8658_CTRL3, 0xd5); // CTRL3 设置GRY 512dps 250Hz 
+    qmi8658_register_write_byte(QMI8658_CTRL2, 0x90 | QMI8658_ODR_CODE); // CTRL2 设置ACC 4g ODR见QMI8658_ODR_CODE
+    qmi8658_register_write_byte(QMI8658_CTRL3, 0xd0 | QMI8658_ODR_CODE); // CTRL3 设置GRY 512dps
 
     qmi8658_register_write_byte(QMI8658_CTRL8, 0x0E); // CTRL7 允许Any-Motion No-Motion and Significant-Motion
 
@@ -103,6 +125,16 @@ void qmi8658_close(void)
     qmi8658_register_write_byte(QMI8658_CTRL1, 0x01); // 关闭芯片运行
 }
 
+// 空闲时只靠运动检测叫醒 陀螺仪关掉 加速度降到低功耗21Hz 运动引擎的配置不用重写
+esp_err_t qmi8658_motion_only(void)
+{
+    ESP_RETURN_ON_ERROR(qmi8658_register_write_byte(QMI8658_CTRL7, 0x00), TAG, "sensor disable failed"); // 改ODR前先关传感器
+    qmi8658_register_write_byte(QMI8658_CTRL2, 0x1D); // CTRL2 设置ACC 4g 低功耗21Hz
+    qmi8658_register_write_byte(QMI8658_CTRL8, 0x0E); // CTRL8 允许Any-Motion No-Motion and Significant-Motion
+    qmi8658_register_write_byte(QMI8658_CTRL1, 0x40); // CTRL1 打开芯片 地址自动增加
+    return qmi8658_register_write_byte(QMI8658_CTRL7, 0x01); // CTRL7 只允许加速度
+}
+
 // 读取加速度和陀螺仪寄存器值
 void qmi8658_Read_AccAndGry(t_sQMI8658 *p)
 {
@@ -126,17 +158,23 @@ void qmi8658_Read_AccAndGry(t_sQMI8658 *p)
 
 // 获取XYZ轴的倾角值
 void qmi8658_fetch_angleFromAcc(t_sQMI8658 *p)
+{
+    qmi8658_Read_AccAndGry(p); // 读取加速度和陀螺仪的寄存器值
+    qmi8658_calc_angleFromAcc(p);
+}
+
+// 根据加速度 计算倾角值
+void qmi8658_calc_angleFromAcc(t_sQMI8658 *p)
 {
     float temp;
 
-    qmi8658_Read_AccAndGry(p); // 读取加速度和陀螺仪的寄存器值
-    // 根据寄存器值 计算倾角值 并把弧度转换成角度
-    temp = (float)p->acc_x / sqrt( ((float)p->acc_y * (float)p->acc_y + (float)p->acc_z * (float)p->acc_z) );
-    p->AngleX = atan(temp)*57.29578f; // 180/π=57.29578
-    temp = (float)p->acc_y / sqrt( ((float)p->acc_x * (float)p->acc_x + (float)p->acc_z * (float)p->acc_z) );
-    p->AngleY = atan(temp)*57.29578f; // 180/π=57.29578
-    temp = sqrt( ((float)p->acc_x * (float)p->acc_x + (float)p->acc_y * (float)p->acc_y) ) / (float)p->acc_z;
-    p->AngleZ = atan(temp)*57.29578f; // 180/π=57.29578
+    // 根据寄存器值 计算倾角值 并把弧度转换成角度 单精度 S3的FPU直接算
+    temp = (float)p->acc_x / sqrtf( ((float)p->acc_y * (float)p->acc_y + (float)p->acc_z * (float)p->acc_z) );
+    p->AngleX = atanf(temp)*57.29578f; // 180/π=57.29578
+    temp = (float)p->acc_y / sqrtf( ((float)p->acc_x * (float)p->acc_x + (float)p->acc_z * (float)p->acc_z) );
+    p->AngleY = atanf(temp)*57.29578f; // 180/π=57.29578
+    temp = sqrtf( ((float)p->acc_x * (float)p->acc_x + (float)p->acc_y * (float)p->acc_y) ) / (float)p->acc_z;
+    p->AngleZ = atanf(temp)*57.29578f; // 180/π=57.29578
 }
 
 // 获取Motion状态
@@ -147,6 +185,66 @@ uint8_t qmi8658_fetch_motion(void)
     return status;
 }
 
+// CTRL9命令 等STATUSINT的CmdDone置位 再回ACK
+static esp_err_t qmi8658_ctrl9(uint8_t cmd)
+{
+    ESP_RETURN_ON_ERROR(qmi8658_register_write_byte(QMI8658_CTRL9, cmd), TAG, "ctrl9 write failed");
+    uint8_t status = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        if (qmi8658_register_read(QMI8658_STATUSINT, &status, 1) == ESP_OK && (status & 0x80))
+        {
+            return qmi8658_register_write_byte(QMI8658_CTRL9, 0x00); // CTRL_CMD_ACK
+        }
+        esp_rom_delay_us(100);
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+#define QMI8658_FIFO_CTRL_VAL   0x0A    // 64组 流模式 满了丢最旧的
+
+// 打开FIFO 加速度和陀螺仪每次采样一组12字节进FIFO
+esp_err_t qmi8658_fifo_enable(uint8_t watermark)
+{
+    ESP_RETURN_ON_ERROR(qmi8658_register_write_byte(QMI8658_FIFO_WTM_TH, watermark), TAG, "fifo wtm failed");
+    ESP_RETURN_ON_ERROR(qmi8658_register_write_byte(QMI8658_FIFO_CTRL, QMI8658_FIFO_CTRL_VAL), TAG, "fifo ctrl failed");
+    ESP_RETURN_ON_ERROR(qmi8658_ctrl9(0x04), TAG, "fifo reset failed"); // CTRL_CMD_RST_FIFO
+    // INT2开推挽输出 FIFO中断选INT2 地址自动增加不变
+    uint8_t ctrl1 = BSP_IMU_INT != GPIO_NUM_NC ? 0x50 : 0x40;
+    return qmi8658_register_write_byte(QMI8658_CTRL1, ctrl1);
+}
+
+void qmi8658_fifo_disable(void)
+{
+    qmi8658_register_write_byte(QMI8658_FIFO_CTRL, 0x00); // Bypass
+    qmi8658_register_write_byte(QMI8658_CTRL1, 0x40);
+}
+
+int qmi8658_fifo_read(int16_t (*samples)[6], int max, bool *overflow)
+{
+    // FIFO_SMPL_CNT和FIFO_STATUS挨着 一次读 低10位是字数 一个字2字节
+    uint8_t st[2];
+    if (qmi8658_register_read(QMI8658_FIFO_SMPL_CNT, st, 2) != ESP_OK)
+    {
+        return -1;
+    }
+    *overflow = st[1] & 0x20;
+    int n = (((st[1] & 0x03) << 8 | st[0]) * 2) / QMI8658_SAMPLE_BYTES;
+    n = n < max ? n : max;
+    if (n == 0)
+    {
+        return 0;
+    }
+    // 请求读FIFO之后 FIFO_DATA连着读就是一组接一组 读完退出读模式
+    esp_err_t ret = qmi8658_ctrl9(0x05); // CTRL_CMD_REQ_FIFO
+    if (ret == ESP_OK)
+    {
+        ret = qmi8658_register_read(QMI8658_FIFO_DATA, (uint8_t *)samples, n * QMI8658_SAMPLE_BYTES);
+    }
+    qmi8658_register_write_byte(QMI8658_FIFO_CTRL, QMI8658_FIFO_CTRL_VAL);
+    return ret == ESP_OK ? n : -1;
+}
+
 /***************************  姿态传感器 QMI8658 ↑  ****************************/
 /*******************************************************************************/
 
@@ -157,7 +255,7 @@ uint8_t qmi8658_fetch_motion(void)
 // 读取PCA9557寄存器的值
 esp_err_t pca9557_register_read(uint8_t reg_addr, uint8_t *data, size_t len)
 {
-    return i2c_master_write_read_device(BSP_I2C_NUM, PCA9557_SENSOR_ADDR,  &reg_addr, 1, data, len, 1000 / portTICK_PERIOD_MS);
+    return i2c_bus_write_read(I2C_BUS_IOEXP, &reg_addr, 1, data, len);
 }
 
 // 给PCA9557的寄存器写值
@@ -165,30 +263,55 @@ esp_err_t pca9557_register_write_byte(uint8_t reg_addr, uint8_t data)
 {
     uint8_t write_buf[2] = {reg_addr, data};
 
-    return i2c_master_write_to_device(BSP_I2C_NUM, PCA9557_SENSOR_ADDR, write_buf, sizeof(write_buf), 1000 / portTICK_PERIOD_MS);
+    return i2c_bus_write(I2C_BUS_IOEXP, write_buf, sizeof(write_buf));
 }
 
+// 输出口的影子 改引脚只按它算好写一次 不用每次先读回来
+// 锁保证算和写是一起的 两个任务同时改不同的脚不会互相覆盖
+static uint8_t s_pca_out;
+static SemaphoreHandle_t s_pca_lock;
+static StaticSemaphore_t s_pca_lock_buf;
+
 // 初始化PCA9557 IO扩展芯片
 void pca9557_init(void)
 {
+    if (s_pca_lock == NULL)
+    {
+        s_pca_lock = xSemaphoreCreateMutexStatic(&s_pca_lock_buf);
+    }
     // 写入控制引脚默认值 DVP_PWDN=1  PA_EN = 0  LCD_CS = 1
-    pca9557_register_write_byte(PCA9557_OUTPUT_PORT, 0x05);  
+    s_pca_out = 0x05;
+    pca9557_register_write_byte(PCA9557_OUTPUT_PORT, s_pca_out);  
     // 把PCA9557芯片的IO1 IO1 IO2设置为输出 其它引脚保持默认的输入
     pca9557_register_write_byte(PCA9557_CONFIGURATION_PORT, 0xf8); 
 }
 
-// 设置PCA9557芯片的某个IO引脚输出高低电平
-esp_err_t pca9557_set_output_state(uint8_t gpio_bit, uint8_t level)
+// 一次改mask里的几个引脚 levels里对应的位是新电平 和现在一样就不写
+esp_err_t pca9557_set_outputs(uint8_t mask, uint8_t levels)
 {
-    uint8_t data;
-    esp_err_t res = ESP_FAIL;
+    esp_err_t res = ESP_OK;
 
-    pca9557_register_read(PCA9557_OUTPUT_PORT, &data, 1);
-    res = pca9557_register_write_byte(PCA9557_OUTPUT_PORT, SET_BITS(data, gpio_bit, level));
+    xSemaphoreTake(s_pca_lock, portMAX_DELAY);
+    uint8_t data = (s_pca_out & ~mask) | (levels & mask);
+    if (data != s_pca_out)
+    {
+        res = pca9557_register_write_byte(PCA9557_OUTPUT_PORT, data);
+        if (res == ESP_OK)
+        {
+            s_pca_out = data; // 写失败影子不变 下次还会再写
+        }
+    }
+    xSemaphoreGive(s_pca_lock);
 
     return res;
 }
 
+// 设置PCA9557芯片的某个IO引脚输出高低电平
+esp_err_t pca9557_set_output_state(uint8_t gpio_bit, uint8_t level)
+{
+    return pca9557_set_outputs(gpio_bit, level ? gpio_bit : 0);
+}
+
 // 控制 PCA9557_LCD_CS 引脚输出高低电平 参数0输出低电平 参数1输出高电平 
 void lcd_cs(uint8_t level)
 {
@@ -233,8 +356,15 @@ esp_err_t bsp_display_brightness_init(void)
         .duty_resolution = LEDC_TIMER_10_BIT,
         .timer_num = 0,
         .freq_hz = 5000,
+#if CONFIG_APP_PM_LIGHT_SLEEP
+        .clk_cfg = LEDC_USE_RC_FAST_CLK // APB在浅睡时停 背光会灭
+#else
         .clk_cfg = LEDC_AUTO_CLK
+#endif
     };
+#if CONFIG_APP_PM_LIGHT_SLEEP
+    esp_sleep_pd_config(ESP_PD_DOMAIN_RC_FAST, ESP_PD_OPTION_ON);
+#endif
 
     ESP_ERROR_CHECK(ledc_timer_config(&LCD_backlight_timer));
     ESP_ERROR_CHECK(ledc_channel_config(&LCD_backlight_channel));
@@ -282,76 +412,7 @@ static lv_disp_t *disp;      // 指向液晶屏
 static lv_indev_t *disp_indev = NULL; // 指向触摸屏
 
 //=================================================================================================
-// LVGL 文件系统：将 SD FATFS 映射为盘符 S:
-// static lv_fs_res_t sd_fs_open(lv_fs_drv_t *drv, void *file_p, const char *path, lv_fs_mode_t mode)
-// {
-//     LV_UNUSED(drv);
-//     const char *flags = (mode == LV_FS_MODE_WR) ? "wb" : (mode == (LV_FS_MODE_WR | LV_FS_MODE_RD) ? "rb+" : "rb");
-
-//     char real_path[256];
-//     if (path && path[0] == '/') {
-//         snprintf(real_path, sizeof(real_path), "%s%s", SD_MOUNT_POINT, path);
-//     } else {
-//         snprintf(real_path, sizeof(real_path), "%s/%s", SD_MOUNT_POINT, path ? path : "");
-//     }
-
-//     FILE *f = fopen(real_path, flags);
-//     if (!f) {
-//         ESP_LOGE(TAG, "sd_fs_open failed: %s", real_path);
-//         return LV_FS_RES_NOT_EX;
-//     }
-//     *(FILE **)file_p = f;
-//     return LV_FS_RES_OK;
-// }
-
-// static lv_fs_res_t sd_fs_close(lv_fs_drv_t *drv, void *file_p)
-// {
-//     LV_UNUSED(drv);
-//     FILE *f = (FILE *)file_p;
-//     fclose(f);
-//     return LV_FS_RES_OK;
-// }
-
-// static lv_fs_res_t sd_fs_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br)
-// {
-//     LV_UNUSED(drv);
-//     FILE *f = (FILE *)file_p;
-//     size_t n = fread(buf, 1, btr, f);
-//     if (br) *br = (uint32_t)n;
-//     return ferror(f) ? LV_FS_RES_FS_ERR : LV_FS_RES_OK;
-// }
-
-// static lv_fs_res_t sd_fs_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos, lv_fs_whence_t whence)
-// {
-//     LV_UNUSED(drv);
-//     FILE *f = (FILE *)file_p;
-//     int origin = (whence == LV_FS_SEEK_SET) ? SEEK_SET : (whence == LV_FS_SEEK_CUR ? SEEK_CUR : SEEK_END);
-//     return fseek(f, (long)pos, origin) == 0 ? LV_FS_RES_OK : LV_FS_RES_FS_ERR;
-// }
-
-// static lv_fs_res_t sd_fs_tell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p)
-// {
-//     LV_UNUSED(drv);
-//     FILE *f = (FILE *)file_p;
-//     long p = ftell(f);
-//     if (p < 0) return LV_FS_RES_FS_ERR;
-//     *pos_p = (uint32_t)p;
-//     return LV_FS_RES_OK;
-// }
-
-// static void lv_fs_register_sd(void)
-// {
-//     static lv_fs_drv_t drv;
-//     lv_fs_drv_init(&drv);
-//     drv.letter = 'S';                 // 使用 "S:" 作为盘符
-//     drv.open_cb = sd_fs_open;
-//     drv.close_cb = sd_fs_close;
-//     drv.read_cb = sd_fs_read;
-//     drv.seek_cb = sd_fs_seek;
-//     drv.tell_cb = sd_fs_tell;
-//     // 如需写能力可添加 drv.write_cb
-//     lv_fs_drv_register(&drv);
-// }
+// LVGL 文件系统：SD卡的盘符 S: 在sd_fs.c里 带预读缓冲
 
 // //=================================================================================================
 
@@ -451,7 +512,7 @@ esp_err_t bsp_display_new(void)
         .quadwp_io_num = GPIO_NUM_NC,
         .quadhd_io_num = GPIO_NUM_NC,
         //.max_transfer_sz = BSP_LCD_H_RES * BSP_LCD_V_RES * sizeof(uint16_t),
-        .max_transfer_sz = BSP_LCD_H_RES * 40 * sizeof(uint16_t),
+        .max_transfer_sz = BSP_LCD_H_RES * BSP_LCD_DRAW_BUF_MAX_HEIGHT * sizeof(uint16_t), // 一块绘图缓冲一次发完
     };
     ESP_RETURN_ON_ERROR(spi_bus_initialize(BSP_LCD_SPI_NUM, &buscfg, SPI_DMA_CH_AUTO), TAG, "SPI init failed");
     // 液晶屏控制IO初始化
@@ -481,6 +542,13 @@ esp_err_t bsp_display_new(void)
     esp_lcd_panel_invert_color(panel_handle, true); // 颜色反转
     esp_lcd_panel_swap_xy(panel_handle, true);  // 显示翻转 
     esp_lcd_panel_mirror(panel_handle, true, false); // 镜像
+    if (BSP_LCD_TE != GPIO_NUM_NC)
+    {
+        esp_lcd_panel_io_tx_param(io_handle, LCD_CMD_TEON, (uint8_t[]) { 0x00 }, 1); // TE只在场消隐时输出
+    }
+#if CONFIG_APP_LCD_VSYNC
+    bsp_display_set_vsync(true); // 刷新等TE再发 失败就照常不同步
+#endif
 
     return ret;
 
@@ -509,160 +577,1185 @@ esp_err_t bsp_lcd_init(void)
     return  ret;
 }
 
-// 液晶屏初始化+添加LVGL接口
-static lv_disp_t *bsp_display_lcd_init(void)
+/******************************* 渲染模式 ****************************************/
+// PARTIAL: esp_lvgl_port默认方式 LVGL在两块20行的DMA缓冲里分块渲染 整屏重画要发12次
+// DIRECT:  LVGL直接画在PSRAM里的整帧上 一帧画完后只把合并过的脏矩形经DMA中转缓冲发给ST7789
+//          中转缓冲就是PARTIAL模式的那两块 直接模式下LVGL不用它们 不多占DMA内存
+static bsp_disp_render_mode_t s_render_mode = BSP_DISP_RENDER_PARTIAL;
+static lv_disp_draw_buf_t *s_partial_buf;       // esp_lvgl_port分配的双缓冲
+static lv_disp_draw_buf_t s_direct_buf;         // 包着s_frame的整帧缓冲
+static lv_color_t *s_frame = NULL;              // PSRAM整帧 第一次切到DIRECT时分配
+static SemaphoreHandle_t s_bounce_sem;          // 空闲的中转缓冲数 SPI传完一块就还一块
+static SemaphoreHandle_t s_flush_done_sem;      // PARTIAL模式一块传完 唤醒在wait_cb里等待的LVGL任务
+static portMUX_TYPE s_xfer_lock = portMUX_INITIALIZER_UNLOCKED;
+static int s_xfer_inflight = 0;                 // 已排队未传完的draw_bitmap数
+static int64_t s_xfer_since;                    // 链路从空闲变忙的时刻
+static bsp_disp_refresh_cb_t s_refresh_cb = NULL;
+static bsp_disp_rendered_cb_t s_rendered_cb = NULL;
+static void *s_rendered_arg;
+static bsp_disp_tee_cb_t s_tee_cb = NULL;
+static int64_t s_refr_start_us;                 // 本次刷新开始渲染的时刻
+static uint64_t s_refr_wait0;                   // 开始时的wait_us 结束时相减得到本次等待
+static uint64_t s_refr_busy0;                   // 上次刷新结束时的busy_us
+static bsp_disp_flush_stats_t s_flush_stats[BSP_DISP_RENDER_MAX];
+static int s_draw_buf_lines = BSP_LCD_DRAW_BUF_HEIGHT;
+
+static volatile bool s_preview_active = false;   // 摄像头直通预览中 LVGL的刷新不发到屏幕
+static bool s_rot_swapped = false;                // 转了90/270 LVGL的宽高对调 整帧一行是BSP_LCD_V_RES
+static bsp_rotate_stats_t s_rotate_stats;
+static volatile bool s_overlay_dirty = false;    // 预览中LVGL有重画 叠加层要重新截图
+static SemaphoreHandle_t s_preview_sem;          // 预览用的两块中转缓冲
+
+#define LCD_MERGE_SLACK_PX      (BSP_LCD_H_RES * 4)    // 合并两个矩形最多多发这么多像素 换一次窗口要发CASET/RASET/RAMWR
+
+/******************************* 帧同步 ****************************************/
+// ST7789按自己的节奏从显存扫描到玻璃上 写入和扫描交叉时上下两半是不同的帧 就是撕裂
+// 打开后每次刷新的第一块都等到TE信号(场消隐开始)才发 SPI写整屏比扫描快 写指针一直在扫描线前面
+// 板子上TE没接时用定时器按帧率模拟 只能让帧节奏均匀 不能和扫描对齐
+#define LCD_FRAME_HZ            60          // ST7789复位后FRCTRL2的默认帧率
+#define LCD_FRAME_US            (1000000 / LCD_FRAME_HZ)
+#define LCD_VSYNC_SLACK_US      1000        // 边沿刚过不到这么久 还在消隐期里 直接发不用等下一次
+
+static bool s_vsync_on = false;
+static bool s_vsync_ready = false;          // TE中断或模拟定时器已经建好
+static SemaphoreHandle_t s_vsync_sem;
+static esp_timer_handle_t s_vsync_timer;    // 没接TE时的模拟
+static volatile uint32_t s_te_edges;
+static volatile int64_t s_te_last_us;
+static bool s_vsync_pending;                // 这次刷新还没有等过同步
+static volatile bool s_vsync_last;          // 这次刷新的最后一块已经排队 它传完就是一帧结束
+static uint32_t s_vsync_frame_edge;         // 开始发送时的边沿计数
+static uint32_t s_render_edge;              // 开始渲染时的边沿计数
+static bsp_vsync_stats_t s_vsync_stats;
+
+static void IRAM_ATTR lcd_te_isr(void *arg)
 {
-    /* 初始化液晶屏 */
-    bsp_display_new(); // 液晶屏驱动初始化
-    lcd_set_color(0xffff); // 设置整屏背景白色
-    esp_lcd_panel_disp_on_off(panel_handle, true); // 打开液晶屏显示
-
-    /* 液晶屏添加LVGL接口 */
-    ESP_LOGD(TAG, "Add LCD screen");
-    const lvgl_port_display_cfg_t disp_cfg = {
-        .io_handle = io_handle,
-        .panel_handle = panel_handle,
-        .buffer_size = BSP_LCD_H_RES * BSP_LCD_DRAW_BUF_HEIGHT,   // LVGL缓存大小 
-        .double_buffer = true, // 是否开启双缓存
-        .hres = BSP_LCD_H_RES, // 液晶屏的宽
-        .vres = BSP_LCD_V_RES, // 液晶屏的高
-        .monochrome = false,  // 是否单色显示器
-        /* Rotation的值必须和液晶屏初始化里面设置的 翻转 和 镜像 一样 */
-        .rotation = {
-            .swap_xy = true,  // 是否翻转
-            .mirror_x = true, // x方向是否镜像
-            .mirror_y = false, // y方向是否镜像
-        },
-        .flags = {
-            .buff_dma = true,  // 是否使用DMA 注意：dma与spiram不能同时为true
-            .buff_spiram = false, // 是否使用PSRAM 注意：dma与spiram不能同时为true
-        }
-    };
-
-    return lvgl_port_add_disp(&disp_cfg);
+    BaseType_t woken = pdFALSE;
+    SYS_TRACE_ISR_ENTER("lcd_te");
+    s_te_edges++;
+    s_te_last_us = esp_timer_get_time();
+    xSemaphoreGiveFromISR(s_vsync_sem, &woken);
+    SYS_TRACE_ISR_EXIT("lcd_te");
+    if (woken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
 }
 
-// 触摸屏初始化
-esp_err_t bsp_touch_new(esp_lcd_touch_handle_t *ret_touch)
+static void lcd_te_timer_cb(void *arg)
 {
-    /* Initialize touch */
-    esp_lcd_touch_config_t tp_cfg = {
-        .x_max = BSP_LCD_V_RES,
-        .y_max = BSP_LCD_H_RES,
-        .rst_gpio_num = GPIO_NUM_NC, // Shared with LCD reset
-        .int_gpio_num = GPIO_NUM_NC, 
-        .levels = {
-            .reset = 0,
-            .interrupt = 0,
-        },
-        .flags = {
-            .swap_xy = 1,
-            .mirror_x = 1,
-            .mirror_y = 0,
-        },
-    };
-    esp_lcd_panel_io_handle_t tp_io_handle = NULL;
-    esp_lcd_panel_io_i2c_config_t tp_io_config = ESP_LCD_TOUCH_IO_I2C_FT5x06_CONFIG();
-
-    ESP_RETURN_ON_ERROR(esp_lcd_new_panel_io_i2c((esp_lcd_i2c_bus_handle_t)BSP_I2C_NUM, &tp_io_config, &tp_io_handle), TAG, "");
-    ESP_ERROR_CHECK(esp_lcd_touch_new_i2c_ft5x06(tp_io_handle, &tp_cfg, ret_touch));
+    s_te_edges++;
+    s_te_last_us = esp_timer_get_time();
+    xSemaphoreGive(s_vsync_sem);
+}
 
+static esp_err_t lcd_vsync_init(void)
+{
+    s_vsync_sem = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(s_vsync_sem, ESP_ERR_NO_MEM, TAG, "no memory for vsync semaphore");
+    if (BSP_LCD_TE != GPIO_NUM_NC)
+    {
+        const gpio_config_t io = {
+            .pin_bit_mask = BIT64(BSP_LCD_TE),
+            .mode = GPIO_MODE_INPUT,
+            .intr_type = GPIO_INTR_POSEDGE,
+        };
+        ESP_RETURN_ON_ERROR(gpio_config(&io), TAG, "TE gpio config failed");
+        esp_err_t ret = gpio_install_isr_service(0);
+        ESP_RETURN_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, TAG, "gpio isr service failed");
+        ESP_RETURN_ON_ERROR(gpio_isr_handler_add(BSP_LCD_TE, lcd_te_isr, NULL), TAG, "TE isr add failed");
+        ESP_LOGI(TAG, "vsync on TE gpio %d", BSP_LCD_TE);
+    }
+    else
+    {
+        const esp_timer_create_args_t args = {
+            .callback = lcd_te_timer_cb,
+            .name = "lcd_vsync",
+        };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_vsync_timer), TAG, "vsync timer create failed");
+        ESP_RETURN_ON_ERROR(esp_timer_start_periodic(s_vsync_timer, LCD_FRAME_US), TAG, "vsync timer start failed");
+        ESP_LOGI(TAG, "no TE pin, vsync emulated at %d Hz", LCD_FRAME_HZ);
+    }
+    s_vsync_ready = true;
     return ESP_OK;
 }
 
-// 触摸屏初始化+添加LVGL接口
-static lv_indev_t *bsp_display_indev_init(lv_disp_t *disp)
+// 在发一帧的第一块之前调用 LVGL任务或摄像头任务里
+static void lcd_vsync_wait(void)
 {
-    /* 初始化触摸屏 */
-    ESP_ERROR_CHECK(bsp_touch_new(&tp));
-    assert(tp);
-
-    /* 添加LVGL接口 */
-    const lvgl_port_touch_cfg_t touch_cfg = {
-        .disp = disp,
-        .handle = tp,
-    };
-
-    return lvgl_port_add_touch(&touch_cfg);
+    int64_t t0 = esp_timer_get_time();
+    uint32_t since_render = s_te_edges - s_render_edge;
+    if (since_render > 1)
+    {
+        s_vsync_stats.dropped += since_render - 1;  // 渲染没赶上 这些扫描还是上一帧
+    }
+    xSemaphoreTake(s_vsync_sem, 0);                 // 之前的边沿不算
+    if (t0 - s_te_last_us > LCD_VSYNC_SLACK_US &&
+        xSemaphoreTake(s_vsync_sem, pdMS_TO_TICKS(2 * LCD_FRAME_US / 1000 + 1)) != pdTRUE)
+    {
+        s_vsync_stats.timeouts++;
+    }
+    s_vsync_stats.wait_us += esp_timer_get_time() - t0;
+    s_vsync_stats.frames++;
+    s_vsync_frame_edge = s_te_edges;
+    s_vsync_last = false;
 }
 
-
-
-
-// 开发板显示初始化
-void bsp_lvgl_start(void)
+// 一帧的最后一块传完 中间又来过边沿 说明扫描追上了写入
+static void lcd_vsync_frame_done(void)
 {
-    /* 初始化LVGL */
-    lvgl_port_cfg_t lvgl_cfg = ESP_LVGL_PORT_INIT_CONFIG();
-    lvgl_cfg.task_stack = 12288; // bump LVGL task stack to handle GIF decode
-    lvgl_port_init(&lvgl_cfg);
-    
-    // 额外组件初始化 SDIO / PNG / GIF 等
-    lv_extra_init();
-
-    // /* 将 SD FATFS 注册为 LVGL 盘符 S: */
-    //     lv_fs_register_sd();
-
-    // /* 将 SPIFFS 注册为 LVGL 盘符 P: */
-    // lv_fs_register_spiffs();
-
-    /* 初始化液晶屏 并添加LVGL接口 */
-    disp = bsp_display_lcd_init();
-
-    /* 初始化触摸屏 并添加LVGL接口 */
-    disp_indev = bsp_display_indev_init(disp);
-
-    /* 打开液晶屏背光 */
-    bsp_display_backlight_on();
-
+    s_vsync_last = false;
+    if (s_te_edges != s_vsync_frame_edge)
+    {
+        s_vsync_stats.late++;
+    }
 }
 
+esp_err_t bsp_display_set_vsync(bool on)
+{
+    if (on && !s_vsync_ready)
+    {
+        ESP_RETURN_ON_ERROR(lcd_vsync_init(), TAG, "vsync init failed");
+    }
+    s_vsync_on = on;
+    return ESP_OK;
+}
 
+bool bsp_display_get_vsync(void)
+{
+    return s_vsync_on;
+}
 
+void bsp_display_get_vsync_stats(bsp_vsync_stats_t *stats)
+{
+    *stats = s_vsync_stats;
+    stats->te_edges = s_te_edges;
+}
 
+// 统计SPI链路忙的时间 在draw_bitmap之前调用 传输完成中断可能在它返回前就来了
+static void lcd_xfer_begin(void)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_xfer_lock);
+    if (s_xfer_inflight++ == 0)
+    {
+        s_xfer_since = now;
+    }
+    portEXIT_CRITICAL(&s_xfer_lock);
+}
 
-
-// 显示图片
-void lcd_draw_pictrue(int x_start, int y_start, int x_end, int y_end, const unsigned char *gImage)
+// 摄像头直接draw_bitmap也会进传输完成回调 没有计数过的传输不算
+static void lcd_xfer_end_from_isr(void)
 {
-    // 分配内存 分配了需要的字节大小 且指定在外部SPIRAM中分配
-    size_t pixels_byte_size = (x_end - x_start)*(y_end - y_start) * 2;
-    uint16_t *pixels = (uint16_t *)heap_caps_malloc(pixels_byte_size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-    if (NULL == pixels)
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&s_xfer_lock);
+    if (s_xfer_inflight > 0 && --s_xfer_inflight == 0)
     {
-        ESP_LOGE(TAG, "Memory for bitmap is not enough");
-        return;
+        s_flush_stats[s_render_mode].busy_us += now - s_xfer_since;
+        if (s_vsync_last)
+        {
+            lcd_vsync_frame_done();
+        }
     }
-    memcpy(pixels, gImage, pixels_byte_size);  // 把图片数据拷贝到内存
-    esp_lcd_panel_draw_bitmap(panel_handle, x_start, y_start, x_end, y_end, (uint16_t *)pixels); // 显示整张图片数据
-    heap_caps_free(pixels);  // 释放内存
+    portEXIT_CRITICAL_ISR(&s_xfer_lock);
 }
 
-// 设置液晶屏颜色
-void lcd_set_color(uint16_t color)
+// 替代esp_lvgl_port注册的传输完成回调 在中断里通知LVGL 这块缓冲可以重新画了
+static bool lcd_color_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
 {
-    // 分配内存 这里分配了液晶屏一行数据需要的大小
-    uint16_t *buffer = (uint16_t *)heap_caps_malloc(BSP_LCD_H_RES * sizeof(uint16_t), MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-    
-    if (NULL == buffer)
+    BaseType_t woken = pdFALSE;
+    if (s_preview_active)
     {
-        ESP_LOGE(TAG, "Memory for bitmap is not enough");
+        xSemaphoreGiveFromISR(s_preview_sem, &woken);
+        return woken == pdTRUE;
+    }
+    SYS_TRACE_ISR_ENTER("lcd_spi");
+    lcd_xfer_end_from_isr();
+    if (s_render_mode == BSP_DISP_RENDER_DIRECT)
+    {
+        xSemaphoreGiveFromISR(s_bounce_sem, &woken);
     }
     else
     {
-        for (size_t i = 0; i < BSP_LCD_H_RES; i++) // 给缓存中放入颜色数据
-        {
-            buffer[i] = color;
-        }
-        for (int y = 0; y < 240; y++) // 显示整屏颜色
-        {
-            esp_lcd_panel_draw_bitmap(panel_handle, 0, y, 320, y+1, buffer);
-        }
-        free(buffer); // 释放内存
+        lv_disp_flush_ready((lv_disp_drv_t *)user_ctx);
+        xSemaphoreGiveFromISR(s_flush_done_sem, &woken);
     }
+    SYS_TRACE_ISR_EXIT("lcd_spi");
+    return woken == pdTRUE;
 }
-/***************    LCD显示屏 ↑   *************************/
-/***********************************************************/
+
+// PARTIAL模式 只排队不等待 返回后LVGL马上去画另一块缓冲 两者在时间上重叠
+static void lcd_flush_partial(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    if (s_preview_active)
+    {
+        s_overlay_dirty = true;
+        lv_disp_flush_ready(drv);
+        return;
+    }
+    bsp_disp_flush_stats_t *st = &s_flush_stats[BSP_DISP_RENDER_PARTIAL];
+    st->transfers++;
+    st->bytes += lv_area_get_size(area) * sizeof(lv_color_t);
+    if (s_vsync_pending)
+    {
+        s_vsync_pending = false;
+        lcd_vsync_wait();
+    }
+    if (s_tee_cb && !s_rot_swapped)
+    {
+        s_tee_cb(area, color_map, lv_area_get_width(area));
+    }
+    lcd_xfer_begin();
+    if (s_vsync_on && lv_disp_flush_is_last(drv))
+    {
+        s_vsync_last = true;    // 已经算上了这一块 链路空下来时它一定传完了
+    }
+    SYS_TRACE_BEGIN("flush band");
+    esp_lcd_panel_draw_bitmap(panel_handle, area->x1, area->y1, area->x2 + 1, area->y2 + 1, color_map);
+    SYS_TRACE_END("flush band");
+}
+
+// LVGL两块缓冲都画好、上一块还没传完时在这里循环等待
+// 阻塞在信号量上让出CPU 而不是空转 等待的时间就是渲染没能和传输重叠的部分
+static void lcd_flush_wait(lv_disp_drv_t *drv)
+{
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_flush_done_sem, pdMS_TO_TICKS(10));
+    s_flush_stats[s_render_mode].wait_us += esp_timer_get_time() - t0;
+}
+
+// 取出这一帧没被LVGL合并掉的脏区域 再把合并后浪费不大的两两合并
+static int lcd_merge_dirty(lv_disp_t *d, lv_area_t *out)
+{
+    int n = 0;
+    for (int i = 0; i < d->inv_p; i++)
+    {
+        if (!d->inv_area_joined[i])
+        {
+            out[n++] = d->inv_areas[i];
+        }
+    }
+
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (int i = 0; i < n; i++)
+        {
+            for (int j = i + 1; j < n; j++)
+            {
+                lv_area_t u;
+                _lv_area_join(&u, &out[i], &out[j]);
+                if (lv_area_get_size(&u) <= lv_area_get_size(&out[i]) + lv_area_get_size(&out[j]) + LCD_MERGE_SLACK_PX)
+                {
+                    out[i] = u;
+                    out[j--] = out[--n];
+                    merged = true;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+// 直接模式下每个脏区域画完都会调用一次 area总是整屏 只在最后一次统一发送
+static void lcd_flush_direct(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    if (s_preview_active)
+    {
+        s_overlay_dirty = true;
+        lv_disp_flush_ready(drv);
+        return;
+    }
+    if (!lv_disp_flush_is_last(drv))
+    {
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
+    bsp_disp_flush_stats_t *st = &s_flush_stats[BSP_DISP_RENDER_DIRECT];
+    lv_area_t dirty[LV_INV_BUF_SIZE];
+    int n = lcd_merge_dirty(_lv_refr_get_disp_refreshing(), dirty);
+    lv_color_t *bounce[2] = { s_partial_buf->buf1, s_partial_buf->buf2 };
+    const int stride = lv_disp_get_hor_res(disp);   // 竖屏时整帧按240一行排
+    int k = 0;
+    if (s_vsync_pending && n > 0)
+    {
+        s_vsync_pending = false;
+        lcd_vsync_wait();
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        const lv_area_t *a = &dirty[i];
+        int w = lv_area_get_width(a);
+        if (s_tee_cb && !s_rot_swapped)
+        {
+            s_tee_cb(a, color_map + a->y1 * stride + a->x1, stride);
+        }
+        int rows_max = s_partial_buf->size / w;
+        for (int y = a->y1; y <= a->y2; y += rows_max)
+        {
+            int rows = LV_MIN(rows_max, a->y2 - y + 1);
+            int64_t t0 = esp_timer_get_time();
+            xSemaphoreTake(s_bounce_sem, portMAX_DELAY);   // 等这块中转缓冲上一次的传输结束
+            st->wait_us += esp_timer_get_time() - t0;
+            lv_color_t *dst = bounce[k];
+            k ^= 1;
+            const lv_color_t *src = color_map + y * stride + a->x1;
+            for (int r = 0; r < rows; r++)
+            {
+                memcpy(dst + r * w, src + r * stride, w * sizeof(lv_color_t));
+            }
+            lcd_xfer_begin();
+            if (s_vsync_on && i == n - 1 && y + rows > a->y2)
+            {
+                s_vsync_last = true;
+            }
+            SYS_TRACE_BEGIN("flush band");
+            esp_lcd_panel_draw_bitmap(panel_handle, a->x1, y, a->x2 + 1, y + rows, dst);
+            SYS_TRACE_END("flush band");
+            st->transfers++;
+            st->bytes += (uint64_t)w * rows * sizeof(lv_color_t);
+            psram_bw_add(PSRAM_BW_SRC_LCD, w * rows * sizeof(lv_color_t));  // 整帧在PSRAM里 拷去中转缓冲
+        }
+    }
+    // 脏矩形都已经复制到中转缓冲 LVGL可以接着在整帧上画
+    lv_disp_flush_ready(drv);
+}
+
+static void lcd_render_start(lv_disp_drv_t *drv)
+{
+    SYS_TRACE_BEGIN("render");
+    ui_mem_render(true);
+    s_refr_start_us = esp_timer_get_time();
+    s_refr_wait0 = s_flush_stats[s_render_mode].wait_us;
+    s_vsync_pending = s_vsync_on;
+    s_render_edge = s_te_edges;
+}
+
+static void lcd_monitor(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+    SYS_TRACE_END("render");
+    ui_mem_render(false); // 这次的临时缓冲接着就全放掉
+    bsp_disp_flush_stats_t *st = &s_flush_stats[s_render_mode];
+    if (s_refresh_cb)
+    {
+        // 最后一块的传输在这之后才结束 传输时间按两次刷新之间链路忙的时间算
+        uint32_t total_us = esp_timer_get_time() - s_refr_start_us;
+        uint32_t wait_us = st->wait_us - s_refr_wait0;
+        uint64_t busy = st->busy_us;
+        s_refresh_cb(total_us, wait_us, busy - s_refr_busy0);
+        s_refr_busy0 = busy;
+    }
+    st->refreshes++;
+    st->refr_ms_total += time;
+    if (time > st->refr_ms_max)
+    {
+        st->refr_ms_max = time;
+    }
+    st->px_rendered += px;
+    if (s_rendered_cb)
+    {
+        s_rendered_cb(s_rendered_arg);
+    }
+}
+
+static void lcd_render_init(lv_disp_t *d)
+{
+    s_bounce_sem = xSemaphoreCreateCounting(2, 2);
+    s_flush_done_sem = xSemaphoreCreateBinary();
+    lvgl_port_lock(0);
+    s_partial_buf = d->driver->draw_buf;
+    d->driver->flush_cb = lcd_flush_partial;
+    d->driver->wait_cb = lcd_flush_wait;
+    d->driver->monitor_cb = lcd_monitor;
+    d->driver->render_start_cb = lcd_render_start;
+    lcd_draw_install(d);
+    const esp_lcd_panel_io_callbacks_t cbs = {
+        .on_color_trans_done = lcd_color_trans_done,
+    };
+    esp_lcd_panel_io_register_event_callbacks(io_handle, &cbs, d->driver);
+    lvgl_port_unlock();
+}
+
+// 等已经排队的传输全部结束 之后才能换缓冲和回调 调用者持有LVGL锁
+static void lcd_wait_idle(lv_disp_drv_t *drv)
+{
+    while (drv->draw_buf->flushing)
+    {
+        vTaskDelay(1);
+    }
+    if (s_render_mode == BSP_DISP_RENDER_DIRECT)
+    {
+        xSemaphoreTake(s_bounce_sem, portMAX_DELAY);
+        xSemaphoreTake(s_bounce_sem, portMAX_DELAY);
+        xSemaphoreGive(s_bounce_sem);
+        xSemaphoreGive(s_bounce_sem);
+    }
+}
+
+// 运行时切换渲染模式 切换后整屏重画一次 DIRECT模式的整帧内容要先完整画好
+esp_err_t bsp_display_set_render_mode(bsp_disp_render_mode_t mode)
+{
+    ESP_RETURN_ON_FALSE(disp && s_bounce_sem && mode < BSP_DISP_RENDER_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid render mode");
+    if (mode == s_render_mode)
+    {
+        return ESP_OK;
+    }
+    if (mode == BSP_DISP_RENDER_DIRECT && s_frame == NULL)
+    {
+        s_frame = heap_caps_malloc(BSP_LCD_H_RES * BSP_LCD_V_RES * sizeof(lv_color_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_RETURN_ON_FALSE(s_frame, ESP_ERR_NO_MEM, TAG, "no PSRAM for the frame buffer");
+        lv_disp_draw_buf_init(&s_direct_buf, s_frame, NULL, BSP_LCD_H_RES * BSP_LCD_V_RES);
+    }
+
+    lvgl_port_lock(0);
+    lv_disp_drv_t *drv = disp->driver;
+    lcd_wait_idle(drv);
+    s_render_mode = mode;
+    bool direct = mode == BSP_DISP_RENDER_DIRECT;
+    drv->draw_buf = direct ? &s_direct_buf : s_partial_buf;
+    drv->direct_mode = direct;
+    drv->flush_cb = direct ? lcd_flush_direct : lcd_flush_partial;
+    lv_area_t full = { 0, 0, BSP_LCD_H_RES - 1, BSP_LCD_V_RES - 1 };
+    _lv_inv_area(disp, &full);
+    lvgl_port_unlock();
+
+    ESP_LOGI(TAG, "render mode: %s", direct ? "direct (PSRAM frame)" : "partial");
+    return ESP_OK;
+}
+
+bsp_disp_render_mode_t bsp_display_get_render_mode(void)
+{
+    return s_render_mode;
+}
+
+// 转屏不动像素 在两帧之间改ST7789的MADCTL(行列交换和镜像) 之后整屏重画一次 平时每帧没有额外开销
+// MADCTL由esp_lvgl_port的drv_update_cb按创建时的swap/mirror算出来写 触摸坐标LVGL自己按rotated换算
+// 已经排队的传输要先等完 不然后半块会按新的方向写进显存
+esp_err_t bsp_display_set_rotation(lv_disp_rot_t rot)
+{
+    ESP_RETURN_ON_FALSE(disp && s_bounce_sem && rot <= LV_DISP_ROT_270, ESP_ERR_INVALID_ARG, TAG, "invalid rotation");
+    if (s_preview_active)
+    {
+        return ESP_ERR_INVALID_STATE;   // 预览帧在摄像头任务里直接发 中途换方向会撕一帧 不打日志 转屏的人下次再试
+    }
+    if (rot == lv_disp_get_rotation(disp))
+    {
+        return ESP_OK;
+    }
+
+    lvgl_port_lock(0);
+    int64_t t0 = esp_timer_get_time();
+    lcd_wait_idle(disp->driver);
+    s_rot_swapped = rot == LV_DISP_ROT_90 || rot == LV_DISP_ROT_270;
+    lv_disp_set_rotation(disp, rot);    // 改界面尺寸 作废整屏 写MADCTL
+    uint32_t us = esp_timer_get_time() - t0;
+    lvgl_port_unlock();
+
+    s_rotate_stats.switches++;
+    s_rotate_stats.last_us = us;
+    if (us > s_rotate_stats.max_us)
+    {
+        s_rotate_stats.max_us = us;
+    }
+    ESP_LOGI(TAG, "rotation: %d degrees (%lu us)", rot * 90, (unsigned long)us);
+    return ESP_OK;
+}
+
+lv_disp_rot_t bsp_display_get_rotation(void)
+{
+    return disp ? lv_disp_get_rotation(disp) : LV_DISP_ROT_NONE;
+}
+
+void bsp_display_get_rotate_stats(bsp_rotate_stats_t *stats)
+{
+    *stats = s_rotate_stats;
+}
+
+// ST7789进睡眠以后显存还在 接口也能写 只是不扫描 SLPIN和SLPOUT之间要隔120ms SLPOUT后5ms才能发别的命令
+static bool s_disp_asleep;
+static int64_t s_disp_slp_us;           // 上一次SLPIN或SLPOUT
+
+esp_err_t bsp_display_sleep(bool sleep)
+{
+    ESP_RETURN_ON_FALSE(disp && io_handle, ESP_ERR_INVALID_STATE, TAG, "display not started");
+    if (sleep == s_disp_asleep)
+    {
+        return ESP_OK;
+    }
+    int64_t gap = esp_timer_get_time() - s_disp_slp_us;
+    if (gap < 120000)
+    {
+        esp_rom_delay_us(120000 - gap); // 刚醒又睡才会走到 平时不等
+    }
+
+    lvgl_port_lock(0);
+    if (sleep)
+    {
+        // 作废的区域照常攒着 醒来只画变了的
+        lv_timer_pause(disp->refr_timer);
+        if (disp_indev && disp_indev->driver->read_timer)
+        {
+            lv_timer_pause(disp_indev->driver->read_timer);
+        }
+        lcd_wait_idle(disp->driver);
+    }
+    esp_err_t ret = esp_lcd_panel_io_tx_param(io_handle, sleep ? LCD_CMD_SLPIN : LCD_CMD_SLPOUT, NULL, 0);
+    s_disp_slp_us = esp_timer_get_time();
+    if (!sleep)
+    {
+        esp_rom_delay_us(5000);
+        lv_timer_resume(disp->refr_timer);
+        if (disp_indev && disp_indev->driver->read_timer)
+        {
+            lv_timer_resume(disp_indev->driver->read_timer);
+            lv_timer_ready(disp_indev->driver->read_timer); // 叫醒它的手指可能还按着
+        }
+    }
+    s_disp_asleep = sleep;
+    lvgl_port_unlock();
+    if (!sleep)
+    {
+        lvgl_port_task_wake();
+    }
+    return ret;
+}
+
+// 改绘图缓冲行数 先释放旧的再分配 避免新旧同时占用内部RAM
+// 新的分配失败时按原来的行数重新分配回去
+esp_err_t bsp_display_set_draw_buf_height(int lines)
+{
+    ESP_RETURN_ON_FALSE(disp && s_partial_buf && lines > 0 && lines <= BSP_LCD_DRAW_BUF_MAX_HEIGHT, ESP_ERR_INVALID_ARG, TAG, "invalid draw buffer height");
+    if (lines == s_draw_buf_lines)
+    {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    lvgl_port_lock(0);
+    lcd_wait_idle(disp->driver);
+    free(s_partial_buf->buf1);
+    free(s_partial_buf->buf2);
+
+    int try_lines[2] = { lines, s_draw_buf_lines };
+    lv_color_t *buf1 = NULL, *buf2 = NULL;
+    for (int t = 0; t < 2; t++)
+    {
+        size_t bytes = BSP_LCD_H_RES * try_lines[t] * sizeof(lv_color_t);
+        buf1 = heap_caps_malloc(bytes, MALLOC_CAP_DMA);
+        buf2 = heap_caps_malloc(bytes, MALLOC_CAP_DMA);
+        if (buf1 && buf2)
+        {
+            s_draw_buf_lines = try_lines[t];
+            break;
+        }
+        free(buf1);
+        free(buf2);
+        buf1 = buf2 = NULL;
+        ret = ESP_ERR_NO_MEM;
+    }
+    // 连原来的大小都分配不到 esp_lvgl_port创建时已经占到过 正常不会发生
+    assert(buf1 && buf2);
+    lv_disp_draw_buf_init(s_partial_buf, buf1, buf2, BSP_LCD_H_RES * s_draw_buf_lines);
+    lv_area_t full = { 0, 0, BSP_LCD_H_RES - 1, BSP_LCD_V_RES - 1 };
+    _lv_inv_area(disp, &full);
+    lvgl_port_unlock();
+
+    ESP_LOGI(TAG, "draw buffer: %d lines%s", s_draw_buf_lines, ret == ESP_OK ? "" : " (requested size did not fit)");
+    return ret;
+}
+
+// 在LVGL任务里每次刷新结束时调用 传NULL取消
+void bsp_display_set_refresh_cb(bsp_disp_refresh_cb_t cb)
+{
+    s_refr_busy0 = s_flush_stats[s_render_mode].busy_us;
+    s_refresh_cb = cb;
+}
+
+// 在LVGL任务里每次刷新画完时调用 传NULL取消 要在持有LVGL锁时设置
+void bsp_display_set_rendered_cb(bsp_disp_rendered_cb_t cb, void *arg)
+{
+    s_rendered_arg = arg;
+    s_rendered_cb = cb;
+}
+
+void bsp_display_set_tee_cb(bsp_disp_tee_cb_t cb)
+{
+    s_tee_cb = cb;
+}
+
+int bsp_display_get_draw_buf_height(void)
+{
+    return s_draw_buf_lines;
+}
+
+void bsp_display_get_flush_stats(bsp_disp_render_mode_t mode, bsp_disp_flush_stats_t *stats)
+{
+    if (mode < BSP_DISP_RENDER_MAX)
+    {
+        *stats = s_flush_stats[mode];
+    }
+}
+
+/******************************* 摄像头直通预览 ****************************************/
+// 相机帧从PSRAM按带复制到DMA中转缓冲后直接发给屏幕 每帧只有这一次CPU拷贝
+// LVGL照常处理触摸和控件状态 但它的刷新不再发往屏幕
+// 叠加的控件按带alpha的快照只在自己的矩形里混合 控件有变化时LVGL会刷新 那时重新截图
+#define PREVIEW_BAND_LINES      20
+#define PREVIEW_MAX_OVERLAYS    8
+
+typedef struct
+{
+    lv_obj_t *obj;
+    lv_img_dsc_t *snap;     // TRUE_COLOR_ALPHA 控件隐藏时为NULL
+    lv_area_t area;         // 快照在屏幕上的位置 含阴影等外扩部分
+} preview_overlay_t;
+
+static preview_overlay_t s_overlays[PREVIEW_MAX_OVERLAYS];
+static int s_overlay_num = 0;
+static lv_color_t *s_preview_band[2];
+static bsp_preview_stats_t s_preview_stats;
+static int64_t s_preview_begin_us;
+
+static void preview_free_snapshots(void)
+{
+    for (int i = 0; i < s_overlay_num; i++)
+    {
+        if (s_overlays[i].snap)
+        {
+            lv_snapshot_free(s_overlays[i].snap);
+            s_overlays[i].snap = NULL;
+        }
+    }
+}
+
+static void preview_take_snapshots(void)
+{
+    lvgl_port_lock(0);
+    s_overlay_dirty = false;
+    preview_free_snapshots();
+    for (int i = 0; i < s_overlay_num; i++)
+    {
+        preview_overlay_t *ov = &s_overlays[i];
+        if (lv_obj_has_flag(ov->obj, LV_OBJ_FLAG_HIDDEN))
+        {
+            continue;
+        }
+        ov->snap = lv_snapshot_take(ov->obj, LV_IMG_CF_TRUE_COLOR_ALPHA);
+        if (ov->snap)
+        {
+            // 和lv_snapshot_take取的范围一致
+            lv_coord_t ext = _lv_obj_get_ext_draw_size(ov->obj);
+            lv_obj_get_coords(ov->obj, &ov->area);
+            ov->area.x1 -= ext;
+            ov->area.y1 -= ext;
+            ov->area.x2 = ov->area.x1 + ov->snap->header.w - 1;
+            ov->area.y2 = ov->area.y1 + ov->snap->header.h - 1;
+        }
+    }
+    s_preview_stats.snapshots++;
+    lvgl_port_unlock();
+}
+
+// 把一个叠加层和band里的相机像素混合 只处理两者相交的部分
+static void preview_blend(const preview_overlay_t *ov, lv_color_t *band, int y0, int rows, int w)
+{
+    const lv_area_t *a = &ov->area;
+    int ys = LV_MAX(a->y1, y0), ye = LV_MIN(a->y2, y0 + rows - 1);
+    int xs = LV_MAX(a->x1, 0), xe = LV_MIN(a->x2, w - 1);
+    if (ys > ye || xs > xe)
+    {
+        return;
+    }
+    const int sw = ov->snap->header.w;
+    for (int y = ys; y <= ye; y++)
+    {
+        const uint8_t *sp = ov->snap->data + ((y - a->y1) * sw + (xs - a->x1)) * LV_IMG_PX_SIZE_ALPHA_BYTE;
+        lv_color_t *dp = band + (y - y0) * w + xs;
+        for (int x = xs; x <= xe; x++, sp += LV_IMG_PX_SIZE_ALPHA_BYTE, dp++)
+        {
+            lv_opa_t opa = sp[LV_IMG_PX_SIZE_ALPHA_BYTE - 1];
+            if (opa <= LV_OPA_MIN)
+            {
+                continue;
+            }
+            lv_color_t c;
+            memcpy(&c, sp, sizeof(c));
+            *dp = opa >= LV_OPA_MAX ? c : lv_color_mix(c, *dp, opa);
+        }
+        s_preview_stats.blend_px += xe - xs + 1;
+    }
+}
+
+// 开始预览 overlays是要叠加在画面上的控件 比如返回和拍照按钮
+esp_err_t bsp_display_preview_begin(lv_obj_t *const *overlays, int count)
+{
+    ESP_RETURN_ON_FALSE(disp && count >= 0 && count <= PREVIEW_MAX_OVERLAYS, ESP_ERR_INVALID_ARG, TAG, "invalid preview overlays");
+    if (s_preview_active)
+    {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_FALSE(!s_rot_swapped, ESP_ERR_INVALID_STATE, TAG, "preview needs a landscape rotation");
+    if (s_preview_sem == NULL)
+    {
+        s_preview_sem = xSemaphoreCreateCounting(2, 2);
+        ESP_RETURN_ON_FALSE(s_preview_sem, ESP_ERR_NO_MEM, TAG, "no memory for preview semaphore");
+    }
+    // LVGL自己的绘图缓冲预览时还在用 不能拿来中转
+    size_t bytes = BSP_LCD_H_RES * PREVIEW_BAND_LINES * sizeof(lv_color_t);
+    for (int i = 0; i < 2; i++)
+    {
+        s_preview_band[i] = heap_caps_malloc(bytes, MALLOC_CAP_DMA);
+    }
+    if (!s_preview_band[0] || !s_preview_band[1])
+    {
+        free(s_preview_band[0]);
+        free(s_preview_band[1]);
+        s_preview_band[0] = s_preview_band[1] = NULL;
+        ESP_LOGE(TAG, "no DMA memory for preview bands");
+        return ESP_ERR_NO_MEM;
+    }
+
+    lvgl_port_lock(0);
+    lcd_wait_idle(disp->driver);
+    for (int i = 0; i < count; i++)
+    {
+        s_overlays[i].obj = overlays[i];
+        s_overlays[i].snap = NULL;
+    }
+    s_overlay_num = count;
+    s_overlay_dirty = true;
+    memset(&s_preview_stats, 0, sizeof(s_preview_stats));
+    s_preview_begin_us = esp_timer_get_time();
+    s_preview_active = true;
+    lvgl_port_unlock();
+    return ESP_OK;
+}
+
+// 推一帧RGB565 和屏幕同样的字节序 由摄像头任务调用
+esp_err_t bsp_display_preview_frame(const void *pixels, int w, int h)
+{
+    ESP_RETURN_ON_FALSE(s_preview_active && pixels, ESP_ERR_INVALID_STATE, TAG, "preview not started");
+    if (s_overlay_dirty)
+    {
+        preview_take_snapshots();
+    }
+
+    if (s_vsync_on)
+    {
+        s_render_edge = s_vsync_frame_edge;  // 相机任务没有渲染开始的时刻 用上一帧开始发送时的计数
+        lcd_vsync_wait();
+    }
+    int64_t t0 = esp_timer_get_time();
+    const lv_color_t *src = pixels;
+    const int cw = LV_MIN(w, BSP_LCD_H_RES);
+    const int ch = LV_MIN(h, BSP_LCD_V_RES);
+    int k = 0;
+    for (int y = 0; y < ch; y += PREVIEW_BAND_LINES)
+    {
+        int rows = LV_MIN(PREVIEW_BAND_LINES, ch - y);
+        xSemaphoreTake(s_preview_sem, portMAX_DELAY);
+        lv_color_t *dst = s_preview_band[k];
+        k ^= 1;
+        if (cw == w)
+        {
+            memcpy(dst, src + y * w, rows * w * sizeof(lv_color_t));
+        }
+        else
+        {
+            for (int r = 0; r < rows; r++)
+            {
+                memcpy(dst + r * cw, src + (y + r) * w, cw * sizeof(lv_color_t));
+            }
+        }
+        s_preview_stats.copy_bytes += rows * cw * sizeof(lv_color_t);
+        for (int i = 0; i < s_overlay_num; i++)
+        {
+            if (s_overlays[i].snap)
+            {
+                preview_blend(&s_overlays[i], dst, y, rows, cw);
+            }
+        }
+        esp_lcd_panel_draw_bitmap(panel_handle, 0, y, cw, y + rows, dst);
+    }
+    if (s_vsync_on)
+    {
+        lcd_vsync_frame_done(); // 最后一块刚排队 近似按排完的时刻算
+    }
+    s_preview_stats.frames++;
+    s_preview_stats.push_us += esp_timer_get_time() - t0;
+    return ESP_OK;
+}
+
+// 结束预览 等最后两块发完 LVGL整屏重画接管屏幕
+void bsp_display_preview_end(void)
+{
+    if (!s_preview_active)
+    {
+        return;
+    }
+    xSemaphoreTake(s_preview_sem, portMAX_DELAY);
+    xSemaphoreTake(s_preview_sem, portMAX_DELAY);
+    xSemaphoreGive(s_preview_sem);
+    xSemaphoreGive(s_preview_sem);
+
+    lvgl_port_lock(0);
+    s_preview_stats.wall_us = esp_timer_get_time() - s_preview_begin_us;
+    s_preview_active = false;
+    preview_free_snapshots();
+    s_overlay_num = 0;
+    lv_area_t full = { 0, 0, BSP_LCD_H_RES - 1, BSP_LCD_V_RES - 1 };
+    _lv_inv_area(disp, &full);
+    lvgl_port_unlock();
+
+    for (int i = 0; i < 2; i++)
+    {
+        free(s_preview_band[i]);
+        s_preview_band[i] = NULL;
+    }
+}
+
+void bsp_display_get_preview_stats(bsp_preview_stats_t *stats)
+{
+    *stats = s_preview_stats;
+    if (s_preview_active)
+    {
+        stats->wall_us = esp_timer_get_time() - s_preview_begin_us;
+    }
+}
+
+// 液晶屏初始化+添加LVGL接口
+static lv_disp_t *bsp_display_lcd_init(void)
+{
+    /* 初始化液晶屏 */
+    bsp_display_new(); // 液晶屏驱动初始化
+    lcd_set_color(0xffff); // 设置整屏背景白色
+    esp_lcd_panel_disp_on_off(panel_handle, true); // 打开液晶屏显示
+
+    /* 液晶屏添加LVGL接口 */
+    ESP_LOGD(TAG, "Add LCD screen");
+    const lvgl_port_display_cfg_t disp_cfg = {
+        .io_handle = io_handle,
+        .panel_handle = panel_handle,
+        .buffer_size = BSP_LCD_H_RES * BSP_LCD_DRAW_BUF_HEIGHT,   // LVGL缓存大小 
+        .double_buffer = true, // 是否开启双缓存
+        .hres = BSP_LCD_H_RES, // 液晶屏的宽
+        .vres = BSP_LCD_V_RES, // 液晶屏的高
+        .monochrome = false,  // 是否单色显示器
+        /* Rotation的值必须和液晶屏初始化里面设置的 翻转 和 镜像 一样 */
+        .rotation = {
+            .swap_xy = true,  // 是否翻转
+            .mirror_x = true, // x方向是否镜像
+            .mirror_y = false, // y方向是否镜像
+        },
+        .flags = {
+            .buff_dma = true,  // 是否使用DMA 注意：dma与spiram不能同时为true
+            .buff_spiram = false, // 是否使用PSRAM 注意：dma与spiram不能同时为true
+        }
+    };
+
+    lv_disp_t *d = lvgl_port_add_disp(&disp_cfg);
+    if (d)
+    {
+        lcd_render_init(d);
+    }
+    return d;
+}
+
+// 触摸屏初始化
+// 不经过LVGL和触摸驱动 直接读FT5x06的TD_STATUS 闹钟快速开机时屏幕和LVGL都还没起来
+// 触摸芯片和屏幕共用电源 深度睡眠时一直在跑 不用初始化
+bool bsp_touch_pressed_raw(void)
+{
+    uint8_t reg = 0x02, n = 0;
+    if (i2c_bus_write_read(I2C_BUS_TOUCH, &reg, 1, &n, 1) != ESP_OK)
+    {
+        return false;
+    }
+    n &= 0x0f;
+    return n > 0 && n <= 5; // 芯片没准备好时读出来是0x0f
+}
+
+esp_err_t bsp_touch_new(esp_lcd_touch_handle_t *ret_touch)
+{
+    /* Initialize touch */
+    esp_lcd_touch_config_t tp_cfg = {
+        .x_max = BSP_LCD_V_RES,
+        .y_max = BSP_LCD_H_RES,
+        .rst_gpio_num = GPIO_NUM_NC, // Shared with LCD reset
+        .int_gpio_num = GPIO_NUM_NC, 
+        .levels = {
+            .reset = 0,
+            .interrupt = 0,
+        },
+        .flags = {
+            .swap_xy = 1,
+            .mirror_x = 1,
+            .mirror_y = 0,
+        },
+    };
+    esp_lcd_panel_io_handle_t tp_io_handle = NULL;
+
+    ESP_RETURN_ON_ERROR(i2c_bus_new_touch_io(&tp_io_handle), TAG, ""); // 读触摸走总线调度 排在最前面
+    ESP_ERROR_CHECK(esp_lcd_touch_new_i2c_ft5x06(tp_io_handle, &tp_cfg, ret_touch));
+
+    return ESP_OK;
+}
+
+static lv_point_t s_touch_pt[BSP_TOUCH_POINTS];
+static uint8_t s_touch_cnt;
+
+// 以前LVGL每30ms读一次触摸 没人碰屏幕也一直占着I2C
+// 接了INT就只在中断来过或者还按着的时候读 没接就按手指在不在调读的间隔
+static volatile bool s_touch_irq;
+static volatile int64_t s_touch_irq_us;     // 手指落下那一下的中断时间
+static int64_t s_touch_last_us;             // 上一次读回调
+static int64_t s_touch_active_us;           // 最后一次读到按着
+static uint32_t s_touch_period_ms;
+static bsp_touch_stats_t s_touch_stats;
+static bsp_touch_irq_cb_t s_touch_irq_cb;
+
+static void IRAM_ATTR touch_int_isr(void *arg)
+{
+    SYS_TRACE_ISR_ENTER("touch");
+    if (!s_touch_irq)
+    {
+        s_touch_irq_us = esp_timer_get_time();
+        s_touch_irq = true;
+    }
+    bsp_touch_irq_cb_t cb = s_touch_irq_cb;
+    if (cb)
+    {
+        cb();
+    }
+    SYS_TRACE_ISR_EXIT("touch");
+}
+
+void bsp_touch_set_irq_cb(bsp_touch_irq_cb_t cb)
+{
+    s_touch_irq_cb = cb;
+}
+
+static esp_err_t touch_int_init(void)
+{
+    if (BSP_TOUCH_INT == GPIO_NUM_NC)
+    {
+        ESP_LOGI(TAG, "no touch INT pin, polling every %d ms touched and %d ms idle", BSP_TOUCH_FAST_MS, BSP_TOUCH_IDLE_MS);
+        return ESP_OK;
+    }
+    // FT5x06按着的时候INT是低
+    const gpio_config_t io = {
+        .pin_bit_mask = BIT64(BSP_TOUCH_INT),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io), TAG, "touch int gpio config failed");
+    esp_err_t ret = gpio_install_isr_service(0);
+    ESP_RETURN_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, TAG, "gpio isr service failed");
+    ESP_RETURN_ON_ERROR(gpio_isr_handler_add(BSP_TOUCH_INT, touch_int_isr, NULL), TAG, "touch isr add failed");
+#if CONFIG_APP_PM_LIGHT_SLEEP
+    gpio_wakeup_enable(BSP_TOUCH_INT, GPIO_INTR_LOW_LEVEL); // 浅睡时手指一落下就醒 不用等下一次读
+    esp_sleep_enable_gpio_wakeup();
+#endif
+    s_touch_stats.irq = true;
+    ESP_LOGI(TAG, "touch on INT gpio %d", BSP_TOUCH_INT);
+    return ESP_OK;
+}
+
+// 按着的时候读得快 拖动跟手 松开一会儿以后慢下来 有INT的时候一直快 反正不来中断不读
+static void touch_set_period(lv_indev_drv_t *indev_drv, int64_t now)
+{
+    uint32_t ms = BSP_TOUCH_FAST_MS;
+    if (!s_touch_stats.irq && now - s_touch_active_us > BSP_TOUCH_IDLE_AFTER_MS * 1000LL)
+    {
+        ms = BSP_TOUCH_IDLE_MS;
+    }
+    if (ms != s_touch_period_ms && indev_drv->read_timer)
+    {
+        lv_timer_set_period(indev_drv->read_timer, ms);
+        s_touch_period_ms = ms;
+    }
+}
+
+// 代替esp_lvgl_port的读触摸回调 一次读出两个点 第一个照常交给LVGL 都记下来给双指手势用
+static void bsp_touchpad_read(lv_indev_drv_t *indev_drv, lv_indev_data_t *data)
+{
+    int64_t now = esp_timer_get_time();
+    bool was_pressed = s_touch_cnt > 0;
+    if (!was_pressed && s_touch_last_us) {
+        s_touch_stats.idle_us += now - s_touch_last_us;
+    }
+    int64_t prev_us = s_touch_last_us;
+    s_touch_last_us = now;
+
+    // 没按着也没来过中断 屏幕上不会有新东西 用上次的结果
+    if (s_touch_stats.irq && !was_pressed && !s_touch_irq) {
+        s_touch_stats.skipped++;
+        data->state = LV_INDEV_STATE_RELEASED;
+        return;
+    }
+    s_touch_irq = false;
+
+    uint16_t x[BSP_TOUCH_POINTS];
+    uint16_t y[BSP_TOUCH_POINTS];
+    uint8_t cnt = 0;
+    esp_lcd_touch_read_data(tp);
+    bool pressed = esp_lcd_touch_get_coordinates(tp, x, y, NULL, &cnt, BSP_TOUCH_POINTS);
+    s_touch_cnt = pressed ? cnt : 0;
+    for (int i = 0; i < s_touch_cnt; i++) {
+        s_touch_pt[i].x = x[i];
+        s_touch_pt[i].y = y[i];
+    }
+
+    int64_t done = esp_timer_get_time();
+    s_touch_stats.reads++;
+    s_touch_stats.idle_reads += !was_pressed;
+    if (s_touch_cnt > 0 && !was_pressed) {
+        // 有INT从中断算起 没有就不知道手指什么时候落下的 记和上一次读的间隔 是最坏的情况
+        int64_t since = s_touch_stats.irq ? s_touch_irq_us : (prev_us ? prev_us : now);
+        uint32_t lat = done - since;
+        s_touch_stats.presses++;
+        s_touch_stats.latency_us += lat;
+        s_touch_stats.latency_max_us = lat > s_touch_stats.latency_max_us ? lat : s_touch_stats.latency_max_us;
+        pm_ctl_touch_wake(lat);
+        idle_mgr_kick();
+    }
+    if (s_touch_cnt > 0) {
+        pm_ctl_ui_busy();
+        s_touch_active_us = done;
+        data->point = s_touch_pt[0];
+        data->state = LV_INDEV_STATE_PRESSED;
+    } else {
+        data->state = LV_INDEV_STATE_RELEASED;
+    }
+    touch_set_period(indev_drv, done);
+}
+
+void bsp_touch_get_stats(bsp_touch_stats_t *stats)
+{
+    *stats = s_touch_stats;
+}
+
+uint8_t bsp_touch_get_points(lv_point_t *points, uint8_t max)
+{
+    uint8_t n = s_touch_cnt < max ? s_touch_cnt : max;
+    memcpy(points, s_touch_pt, n * sizeof(lv_point_t));
+    return n;
+}
+
+// 触摸屏初始化+添加LVGL接口
+static lv_indev_t *bsp_display_indev_init(lv_disp_t *disp)
+{
+    /* 初始化触摸屏 */
+    ESP_ERROR_CHECK(bsp_touch_new(&tp));
+    assert(tp);
+
+    /* 添加LVGL接口 */
+    const lvgl_port_touch_cfg_t touch_cfg = {
+        .disp = disp,
+        .handle = tp,
+    };
+
+    lv_indev_t *indev = lvgl_port_add_touch(&touch_cfg);
+    if (indev) {
+        indev->driver->read_cb = bsp_touchpad_read;
+        ESP_ERROR_CHECK(touch_int_init());
+        s_touch_active_us = esp_timer_get_time(); // 开机先按快的读 没人碰再慢下来
+        touch_set_period(indev->driver, s_touch_active_us);
+    }
+    return indev;
+}
+
+
+
+
+// 开发板显示初始化
+void bsp_lvgl_start(void)
+{
+    /* 初始化LVGL */
+    lvgl_port_cfg_t lvgl_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    const task_plan_t *plan = task_plan_get(TASK_LVGL);
+    lvgl_cfg.task_priority = plan->prio;
+    lvgl_cfg.task_stack = plan->stack;
+    lvgl_cfg.task_affinity = plan->core; // 和触摸 网络在一个核上 媒体解码全在核1
+    lvgl_port_init(&lvgl_cfg);
+    
+    // 额外组件初始化 SDIO / PNG / GIF 等
+    lv_extra_init();
+
+    /* 将 SD FATFS 注册为 LVGL 盘符 S: */
+#if CONFIG_APP_SD_FS_READAHEAD_KB > 0
+    fd_pool_init();
+    sd_fs_register();
+#endif
+
+    // /* 将 SPIFFS 注册为 LVGL 盘符 P: */
+    // lv_fs_register_spiffs();
+
+    /* 初始化液晶屏 并添加LVGL接口 */
+    disp = bsp_display_lcd_init();
+
+    /* 初始化触摸屏 并添加LVGL接口 */
+    disp_indev = bsp_display_indev_init(disp);
+
+    /* 打开液晶屏背光 */
+    bsp_display_backlight_on();
+
+#if CONFIG_APP_DISPLAY_DIRECT_MODE
+    bsp_display_set_render_mode(BSP_DISP_RENDER_DIRECT);
+#endif
+
+}
+
+
+
+
+
+
+// 显示图片
+void lcd_draw_pictrue(int x_start, int y_start, int x_end, int y_end, const unsigned char *gImage)
+{
+    // 整屏以内的从媒体池拿一块PSRAM 不用每张图都在堆里切一次
+    size_t pixels_byte_size = (x_end - x_start)*(y_end - y_start) * 2;
+    uint16_t *pixels = (uint16_t *)mem_pool_alloc(MEM_POOL_MEDIA, pixels_byte_size);
+    if (NULL == pixels)
+    {
+        ESP_LOGE(TAG, "Memory for bitmap is not enough");
+        return;
+    }
+    memcpy(pixels, gImage, pixels_byte_size);  // 把图片数据拷贝到内存
+    esp_lcd_panel_draw_bitmap(panel_handle, x_start, y_start, x_end, y_end, (uint16_t *)pixels); // 显示整张图片数据
+    mem_pool_free(pixels);  // 还回去
+}
+
+// 设置液晶屏颜色 开机时LVGL还没接管屏幕
+void lcd_set_color(uint16_t color)
+{
+    // 一块DMA内存里放几十行同样的颜色 整屏只发几次 不用每行一次还要SPI驱动自己拷贝
+    const int lines = 40;   // 不能超过SPI总线的max_transfer_sz BSP_LCD_DRAW_BUF_MAX_HEIGHT行
+    uint16_t *buffer = (uint16_t *)heap_caps_malloc(BSP_LCD_H_RES * lines * sizeof(uint16_t), MALLOC_CAP_DMA);
+    
+    if (NULL == buffer)
+    {
+        ESP_LOGE(TAG, "Memory for bitmap is not enough");
+    }
+    else
+    {
+        lcd_draw_fill16(buffer, color, BSP_LCD_H_RES * lines); // 给缓存中放入颜色数据
+        for (int y = 0; y < BSP_LCD_V_RES; y += lines) // 显示整屏颜色 每次发的内容一样 共用一块缓冲
+        {
+            esp_lcd_panel_draw_bitmap(panel_handle, 0, y, BSP_LCD_H_RES, y + lines, buffer);
+        }
+        // 颜色数据是排队发送的 发一个命令会先等前面的传完 之后才能释放缓冲
+        esp_lcd_panel_io_tx_param(io_handle, LCD_CMD_NOP, NULL, 0);
+        free(buffer); // 释放内存
+    }
+}
+/***************    LCD显示屏 ↑   *************************/
+/***********************************************************/
 
 
 
@@ -672,12 +1765,11 @@ void lcd_set_color(uint16_t color)
 // 定义lcd显示队列句柄
 static QueueHandle_t xQueueLCDFrame = NULL;
 
-// 摄像头硬件初始化
-void bsp_camera_init(void)
-{
-    dvp_pwdn(0); // 打开摄像头
+static bsp_camera_mode_t s_camera_mode = BSP_CAMERA_RGB565;
 
-    camera_config_t config;
+static esp_err_t camera_start(bsp_camera_mode_t mode)
+{
+    camera_config_t config = {0};
     config.ledc_channel = LEDC_CHANNEL_1;  // LEDC通道选择  用于生成XCLK时钟 但是S3不用
     config.ledc_timer = LEDC_TIMER_1; // LEDC timer选择  用于生成XCLK时钟 但是S3不用
     config.pin_d0 = CAMERA_PIN_D0;
@@ -698,12 +1790,32 @@ void bsp_camera_init(void)
     config.pin_pwdn = CAMERA_PIN_PWDN;
     config.pin_reset = CAMERA_PIN_RESET;
     config.xclk_freq_hz = XCLK_FREQ_HZ;
-    // config.pixel_format = PIXFORMAT_JPEG;   // 改为摄像头直接输出 JPEG
 
-    config.pixel_format = PIXFORMAT_RGB565;
-    config.frame_size = FRAMESIZE_QVGA;
-    config.jpeg_quality = JPEG_QUALITY;
-    config.fb_count = CAMERA_FB_COUNT;
+    if (mode == BSP_CAMERA_JPEG)
+    {
+        config.pixel_format = PIXFORMAT_JPEG;   // 摄像头直接输出 JPEG
+        config.frame_size = CAMERA_JPEG_FRAMESIZE;
+        config.jpeg_quality = CAMERA_JPEG_QUALITY;
+    }
+    else if (mode == BSP_CAMERA_GRAY)
+    {
+        config.pixel_format = PIXFORMAT_GRAYSCALE; // 一个像素一个字节 帧缓冲减半
+        config.frame_size = FRAMESIZE_QVGA;
+        config.jpeg_quality = JPEG_QUALITY;
+    }
+    else if (mode == BSP_CAMERA_RGB565_HI)
+    {
+        config.pixel_format = PIXFORMAT_RGB565;
+        config.frame_size = CAMERA_HIRES_FRAMESIZE;
+        config.jpeg_quality = JPEG_QUALITY;
+    }
+    else
+    {
+        config.pixel_format = PIXFORMAT_RGB565;
+        config.frame_size = FRAMESIZE_QVGA;
+        config.jpeg_quality = JPEG_QUALITY;
+    }
+    config.fb_count = mode == BSP_CAMERA_RGB565_HI ? 1 : CAMERA_FB_COUNT; // VGA一块就600KB
     config.fb_location = CAMERA_FB_IN_PSRAM;
     config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
 
@@ -712,14 +1824,47 @@ void bsp_camera_init(void)
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Camera init failed with error 0x%x", err);
-        return;
+        return err;
     }
 
     sensor_t *s = esp_camera_sensor_get(); // 获取摄像头型号
+    camera_sensor_info_t *info = esp_camera_sensor_get_info(&s->id);
+    if (mode == BSP_CAMERA_JPEG && (info == NULL || !info->support_jpeg))
+    {
+        ESP_LOGW(TAG, "sensor %s has no JPEG output", info ? info->name : "?");
+        esp_camera_deinit();
+        return ESP_ERR_NOT_SUPPORTED;
+    }
 
     if (s->id.PID == GC0308_PID) {
         s->set_hmirror(s, 1);  // 这里控制摄像头镜像 写1镜像 写0不镜像
     }
+    s_camera_mode = mode;
+    return ESP_OK;
+}
+
+// 摄像头硬件初始化
+esp_err_t bsp_camera_init_mode(bsp_camera_mode_t mode)
+{
+    dvp_pwdn(0); // 打开摄像头
+
+    esp_err_t err = camera_start(mode);
+    if (err != ESP_OK && mode == BSP_CAMERA_JPEG)
+    {
+        // 传感器不支持或者大分辨率的帧缓冲分配不下 还能用RGB565预览
+        return camera_start(BSP_CAMERA_RGB565) == ESP_OK ? ESP_ERR_NOT_SUPPORTED : ESP_FAIL;
+    }
+    return err;
+}
+
+void bsp_camera_init(void)
+{
+    bsp_camera_init_mode(BSP_CAMERA_RGB565);
+}
+
+bsp_camera_mode_t bsp_camera_get_mode(void)
+{
+    return s_camera_mode;
 }
 
 int camera_lcd_flag = 0;
@@ -766,30 +1911,201 @@ void app_camera_lcd(void)
 /***********************************************************/
 /***************    SPIFFS文件系统 ↓   *********************/
 
+static bsp_spiffs_stats_t s_spiffs_stats;
+
+#if CONFIG_APP_STORAGE_LITTLEFS
+#define SPIFFS_OLD_BASE         "/spiffs_old"
+#define SPIFFS_MIGRATE_MAX      32
+
+typedef struct {
+    char name[64];
+    uint8_t *data;
+    size_t len;
+} spiffs_migrate_file_t;
+
+static esp_err_t littlefs_register(bool format)
+{
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = SPIFFS_BASE,
+        .partition_label = SPIFFS_LABEL,
+        .format_if_mount_failed = format,
+        .dont_mount = false,
+    };
+    return esp_vfs_littlefs_register(&conf);
+}
+
+// 分区里还是SPIFFS 文件先读进PSRAM 格式化成LittleFS再写回去 一共不到1MB
+static esp_err_t spiffs_migrate(void)
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = SPIFFS_OLD_BASE,
+        .partition_label = SPIFFS_LABEL,
+        .max_files = 1,
+        .format_if_mount_failed = false,
+    };
+    ESP_RETURN_ON_ERROR(esp_vfs_spiffs_register(&conf), TAG, "no SPIFFS to migrate either");
+    spiffs_migrate_file_t *files = heap_caps_calloc(SPIFFS_MIGRATE_MAX, sizeof(*files), MALLOC_CAP_SPIRAM);
+    int n = 0;
+    esp_err_t ret = files ? ESP_OK : ESP_ERR_NO_MEM;
+    DIR *dir = files ? opendir(SPIFFS_OLD_BASE) : NULL;
+    struct dirent *de;
+    while (dir && ret == ESP_OK && n < SPIFFS_MIGRATE_MAX && (de = readdir(dir)) != NULL)
+    {
+        char path[96];
+        struct stat st;
+        snprintf(path, sizeof(path), SPIFFS_OLD_BASE "/%s", de->d_name);
+        if (stat(path, &st) != 0 || st.st_size <= 0)
+        {
+            continue;
+        }
+        spiffs_migrate_file_t *f = &files[n];
+        f->data = heap_caps_malloc(st.st_size, MALLOC_CAP_SPIRAM);
+        FILE *fp = f->data ? fopen(path, "rb") : NULL;
+        if (fp == NULL || fread(f->data, 1, st.st_size, fp) != (size_t)st.st_size)
+        {
+            ret = ESP_FAIL;
+        }
+        if (fp)
+        {
+            fclose(fp);
+        }
+        strlcpy(f->name, de->d_name, sizeof(f->name));
+        f->len = st.st_size;
+        n++;
+    }
+    if (dir)
+    {
+        closedir(dir);
+    }
+    esp_vfs_spiffs_unregister(SPIFFS_LABEL);
+
+    // 读全了才格式化 读不全宁可挂载失败 等重新烧录
+    if (ret == ESP_OK)
+    {
+        ret = littlefs_register(true);
+    }
+    for (int i = 0; i < n && ret == ESP_OK; i++)
+    {
+        char path[96];
+        snprintf(path, sizeof(path), SPIFFS_BASE "/%s", files[i].name);
+        FILE *fp = fopen(path, "wb");
+        if (fp == NULL || fwrite(files[i].data, 1, files[i].len, fp) != files[i].len)
+        {
+            ret = ESP_FAIL;
+        }
+        if (fp)
+        {
+            fclose(fp);
+        }
+    }
+    for (int i = 0; i < n; i++)
+    {
+        heap_caps_free(files[i].data);
+    }
+    heap_caps_free(files);
+    if (ret == ESP_OK)
+    {
+        s_spiffs_stats.migrated = true;
+        s_spiffs_stats.migrated_files = n;
+        ESP_LOGW(TAG, "storage migrated from SPIFFS to LittleFS, %d files", n);
+    }
+    return ret;
+}
+#endif
+
 esp_err_t bsp_spiffs_mount(void)
 {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t ret_val;
+    size_t total = 0, used = 0;
+#if CONFIG_APP_STORAGE_LITTLEFS
+    s_spiffs_stats.littlefs = true;
+    ret_val = littlefs_register(false);
+    if (ret_val != ESP_OK) {
+        ret_val = spiffs_migrate();
+    }
+    ESP_ERROR_CHECK(ret_val);
+    ret_val = esp_littlefs_info(SPIFFS_LABEL, &total, &used);
+#else
     esp_vfs_spiffs_conf_t conf = {
         .base_path = SPIFFS_BASE,
-        .partition_label = "storage",
-        .max_files = 5,
+        .partition_label = SPIFFS_LABEL,
+        .max_files = SPIFFS_MAX_FILES,
         .format_if_mount_failed = false,
     };
 
-    esp_err_t ret_val = esp_vfs_spiffs_register(&conf);
+    ret_val = esp_vfs_spiffs_register(&conf);
 
     ESP_ERROR_CHECK(ret_val);
 
-    size_t total = 0, used = 0;
     ret_val = esp_spiffs_info(conf.partition_label, &total, &used);
+#endif
+    s_spiffs_stats.mount_us = (uint32_t)(esp_timer_get_time() - t0);
+    s_spiffs_stats.total = total;
+    s_spiffs_stats.used = used;
     if (ret_val != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get SPIFFS partition information (%s)", esp_err_to_name(ret_val));
+        ESP_LOGE(TAG, "Failed to get storage partition information (%s)", esp_err_to_name(ret_val));
     } else {
-        ESP_LOGI(TAG, "Partition size: total: %d, used: %d", total, used);
+        ESP_LOGI(TAG, "Partition size: total: %d, used: %d, %s mounted in %lu ms", total, used,
+                 s_spiffs_stats.littlefs ? "LittleFS" : "SPIFFS", (unsigned long)s_spiffs_stats.mount_us / 1000);
     }
 
     return ret_val;
 }
 
+// 开机要读的就是这些文件 按目录顺序每个从头读到尾
+esp_err_t bsp_spiffs_bench(void)
+{
+    DIR *dir = opendir(SPIFFS_BASE);
+    ESP_RETURN_ON_FALSE(dir, ESP_ERR_INVALID_STATE, TAG, "storage not mounted");
+    uint8_t *buf = heap_caps_malloc(SPIFFS_BENCH_BUF, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (buf == NULL) {
+        closedir(dir);
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t files = 0, open_us = 0, read_us = 0;
+    uint64_t bytes = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        char path[96];
+        snprintf(path, sizeof(path), SPIFFS_BASE "/%s", de->d_name);
+        int64_t t0 = esp_timer_get_time();
+        FILE *fp = fopen(path, "rb");
+        int64_t t1 = esp_timer_get_time();
+        if (fp == NULL) {
+            continue; // LittleFS的子目录
+        }
+        size_t n, len = 0;
+        while ((n = fread(buf, 1, SPIFFS_BENCH_BUF, fp)) > 0) {
+            len += n;
+        }
+        fclose(fp);
+        int64_t t2 = esp_timer_get_time();
+        ESP_LOGI(TAG, "storage read %s: %u bytes, open %.1f ms, %.0f KB/s", de->d_name, (unsigned)len,
+                 (t1 - t0) / 1000.0, t2 > t1 ? len * 1e6 / 1024 / (t2 - t1) : 0.0);
+        files++;
+        bytes += len;
+        open_us += t1 - t0;
+        read_us += t2 - t1;
+    }
+    closedir(dir);
+    free(buf);
+    s_spiffs_stats.files = files;
+    s_spiffs_stats.bytes = bytes;
+    s_spiffs_stats.open_us = open_us;
+    s_spiffs_stats.read_us = read_us;
+    ESP_LOGI(TAG, "storage (%s): mount %.1f ms, %lu files %lu KB read at %.0f KB/s, open %.1f ms avg",
+             s_spiffs_stats.littlefs ? "LittleFS" : "SPIFFS", s_spiffs_stats.mount_us / 1000.0, (unsigned long)files,
+             (unsigned long)(bytes / 1024), read_us ? bytes * 1e6 / 1024 / read_us : 0.0,
+             files ? open_us / 1000.0 / files : 0.0);
+    return ESP_OK;
+}
+
+void bsp_spiffs_get_stats(bsp_spiffs_stats_t *stats)
+{
+    *stats = s_spiffs_stats;
+}
+
 /***************    SPIFFS文件系统 ↑  *********************/
 /**********************************************************/
 
@@ -797,35 +2113,114 @@ esp_err_t bsp_spiffs_mount(void)
 /***********************************************************/
 /*********************    SD卡  ↓   *********************/
 sdmmc_card_t *sdmmc_card = NULL;
+static int s_sd_width = 0;
+static sdmmc_cid_t s_sd_cid;            // 上一次挂上的卡 重新挂卡时看是不是换了一张
+static bool s_sd_cid_valid = false;
 
-// 挂载SD卡
-esp_err_t bsp_sdcard_mount(void)
+// 按指定线数和频率挂载SD卡
+esp_err_t bsp_sdcard_mount_bus(int width, int freq_khz)
 {
-    ESP_LOGI(TAG, "Mounting SD card");
+    ESP_RETURN_ON_FALSE(width == 1 || width == SD_BUS_WIDTH, ESP_ERR_NOT_SUPPORTED, TAG, "%d-bit SD bus not wired", width);
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
         .format_if_mount_failed = false,  // 加载不成功是否需要格式化
-        .max_files = 5,                   // 最大文件数
+        .max_files = SD_MAX_FILES,        // 最大文件数 每个预先分配一个FIL
         .allocation_unit_size = 8 * 1024
     };
 
     sdmmc_host_t sdmmc_host = SDMMC_HOST_DEFAULT(); // SDMMC主机接口配置
+    sdmmc_host.max_freq_khz = freq_khz; // 高速要卡也支持 驱动切换失败会停在默认频率
     sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT(); // SDMMC插槽配置
-    slot_config.width = 1;  // 设置为1线SD模式
+    slot_config.width = width;
     slot_config.clk = SD_CLK_IO; 
     slot_config.cmd = SD_CMD_IO;
     slot_config.d0 = SD_DAT0_IO;
+#if SD_BUS_WIDTH == 4
+    slot_config.d1 = SD_DAT1_IO;
+    slot_config.d2 = SD_DAT2_IO;
+    slot_config.d3 = SD_DAT3_IO;
+#endif
+#if SD_CD_IO >= 0
+    slot_config.cd = SD_CD_IO; // 没插卡时驱动直接返回ESP_ERR_NOT_FOUND
+#endif
     slot_config.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP; // 打开内部上拉电阻
 
-    ESP_LOGI(TAG, "Mounting filesystem Starting");
-
     esp_err_t ret = esp_vfs_fat_sdmmc_mount(SD_MOUNT_POINT, &sdmmc_host, &slot_config, &mount_config, &sdmmc_card);
+    if (ret == ESP_OK)
+    {
+        s_sd_width = width;
+        ESP_LOGI(TAG, "SD card mounted: %d-bit, %d kHz", width, sdmmc_card->real_freq_khz);
+        if (s_sd_cid_valid && memcmp(&s_sd_cid, &sdmmc_card->cid, sizeof(s_sd_cid)) != 0)
+        {
+            ESP_LOGI(TAG, "a different SD card, dropping cached directories");
+            sd_dir_cache_clear();
+        }
+        s_sd_cid = sdmmc_card->cid;
+        s_sd_cid_valid = true;
+        media_lib_rescan(); // 开机第一次挂载时媒体库还没启动 什么也不做
+    }
+    else
+    {
+        sdmmc_card = NULL;
+    }
+    return ret;
+}
 
+// 挂载SD卡
+esp_err_t bsp_sdcard_mount(void)
+{
+    ESP_LOGI(TAG, "Mounting SD card");
+    esp_err_t ret = bsp_sdcard_mount_bus(SD_BUS_WIDTH, SD_BUS_FREQ_KHZ);
+    if (ret != ESP_OK && (SD_BUS_WIDTH != 1 || SD_BUS_FREQ_KHZ != SDMMC_FREQ_DEFAULT))
+    {
+        // 飞线接触不好或者卡不认4线/高速 退回原来的1线20MHz
+        ESP_LOGW(TAG, "SD mount at %d-bit %d kHz failed (%s), retrying 1-bit", SD_BUS_WIDTH, SD_BUS_FREQ_KHZ,
+                 esp_err_to_name(ret));
+        ret = bsp_sdcard_mount_bus(1, SDMMC_FREQ_DEFAULT);
+    }
     return ret;
 }
 
 esp_err_t bsp_sdcard_unmount(void)
 {
-    return esp_vfs_fat_sdcard_unmount(SD_MOUNT_POINT, sdmmc_card);
+    // 先停下媒体库的后台扫卡 卸了以后FATFS的卷就释放了
+    // 缓存的目录先不用 挂回来是同一张卡的话 媒体库核对过没变的再拿出来用 换了卡才全丢
+    media_lib_clear();
+    sd_dir_cache_hold();
+    fd_pool_flush(SD_MOUNT_POINT); // 留着的空闲句柄先关
+    esp_err_t ret = esp_vfs_fat_sdcard_unmount(SD_MOUNT_POINT, sdmmc_card);
+    if (ret == ESP_OK)
+    {
+        sdmmc_card = NULL;
+        s_sd_width = 0;
+    }
+    else
+    {
+        media_lib_rescan(); // 还挂着 媒体库重新走一遍
+    }
+    return ret;
+}
+
+bool bsp_sdcard_mounted(void)
+{
+    return sdmmc_card != NULL;
+}
+
+// VFS路径换成FATFS的路径 /sdcard/a -> 0:/a 直接用f_readdir 顺便拿到文件大小
+bool bsp_sdcard_fatfs_path(const char *path, char *out, size_t len)
+{
+    size_t n = strlen(SD_MOUNT_POINT);
+    if (sdmmc_card == NULL || strncmp(path, SD_MOUNT_POINT, n) != 0 || (path[n] != '\0' && path[n] != '/'))
+    {
+        return false;
+    }
+    snprintf(out, len, "%u:%s", (unsigned)ff_diskio_get_pdrv_card(sdmmc_card), path[n] ? path + n : "/");
+    return true;
+}
+
+void bsp_sdcard_get_bus(int *width, int *freq_khz)
+{
+    *width = sdmmc_card ? s_sd_width : 0;
+    *freq_khz = sdmmc_card ? sdmmc_card->real_freq_khz : 0;
 }
 /**********************    SD卡 ↑  ************************/
 /**********************************************************/
@@ -841,6 +2236,61 @@ static esp_codec_dev_handle_t record_dev_handle;  // microphone句柄
 static i2s_chan_handle_t i2s_tx_chan = NULL; // 发送通道
 static i2s_chan_handle_t i2s_rx_chan = NULL; // 接收通道
 static const audio_codec_data_if_t *i2s_data_if = NULL;  /* Codec data interface */
+static bsp_i2s_sent_cb_t s_i2s_sent_cb = NULL;           // DMA描述符发完时在中断里调用
+static bool i2s_tx_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx);
+
+// 待机时两个通道都关掉 通道开着驱动就拿着APB的电源锁 芯片进不了浅睡
+// 读麦克风的在bsp_get_feed_data里等 要出声的(写I2S 改格式 预装)直接把通道打开
+#define I2S_EVT_RUNNING     BIT0
+static SemaphoreHandle_t s_i2s_standby_mux;
+static EventGroupHandle_t s_i2s_evt;
+static volatile bool s_i2s_standby;
+
+// 持有s_i2s_standby_mux 关通道会等正在读写的那一次退出 格式切换时codec自己开关过的 这里报错不管
+static void i2s_standby_set(bool on)
+{
+    if (on == s_i2s_standby)
+    {
+        return;
+    }
+    if (on)
+    {
+        xEventGroupClearBits(s_i2s_evt, I2S_EVT_RUNNING);
+        s_i2s_standby = true;
+        i2s_channel_disable(i2s_tx_chan);
+        i2s_channel_disable(i2s_rx_chan);
+    }
+    else
+    {
+        i2s_channel_enable(i2s_tx_chan);
+        i2s_channel_enable(i2s_rx_chan);
+        s_i2s_standby = false;
+        xEventGroupSetBits(s_i2s_evt, I2S_EVT_RUNNING);
+    }
+}
+
+esp_err_t bsp_audio_standby(bool on)
+{
+    ESP_RETURN_ON_FALSE(s_i2s_standby_mux, ESP_ERR_INVALID_STATE, TAG, "audio not started");
+    xSemaphoreTake(s_i2s_standby_mux, portMAX_DELAY);
+    i2s_standby_set(on);
+    xSemaphoreGive(s_i2s_standby_mux);
+    return ESP_OK;
+}
+
+bool bsp_audio_in_standby(void)
+{
+    return s_i2s_standby;
+}
+
+// 要出声的路径先调
+static void i2s_standby_leave(void)
+{
+    if (s_i2s_standby)
+    {
+        bsp_audio_standby(false);
+    }
+}
 
 
 // I2S总线初始化
@@ -855,6 +2305,9 @@ esp_err_t bsp_audio_init(void)
     /* Setup I2S peripheral */
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(BSP_I2S_NUM, I2S_ROLE_MASTER);
     chan_cfg.auto_clear = true; // Auto clear the legacy data in the DMA buffer
+    // WAV直通时解码任务在两次读卡之间没有环形缓冲兜底 加大DMA缓冲 96kHz/32位时约40ms
+    chan_cfg.dma_desc_num = BSP_I2S_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = BSP_I2S_DMA_FRAME_NUM;
     ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &i2s_tx_chan, &i2s_rx_chan));
 
     /* Setup I2S channels */
@@ -872,6 +2325,11 @@ esp_err_t bsp_audio_init(void)
 
     if (i2s_tx_chan != NULL) {
         ESP_GOTO_ON_ERROR(i2s_channel_init_std_mode(i2s_tx_chan, &std_cfg_default), err, TAG, "I2S channel initialization failed");
+        // 回调只能在通道关闭时注册 开机音和延迟测量共用这一个
+        const i2s_event_callbacks_t cbs = {
+            .on_sent = i2s_tx_on_sent,
+        };
+        ESP_GOTO_ON_ERROR(i2s_channel_register_event_callback(i2s_tx_chan, &cbs, NULL), err, TAG, "I2S callback failed");
         ESP_GOTO_ON_ERROR(i2s_channel_enable(i2s_tx_chan), err, TAG, "I2S enabling failed");
     }
     if (i2s_rx_chan != NULL) {
@@ -888,6 +2346,10 @@ esp_err_t bsp_audio_init(void)
     if (i2s_data_if == NULL) {   
         goto err;
     }   
+    s_i2s_standby_mux = xSemaphoreCreateMutex();
+    s_i2s_evt = xEventGroupCreate();
+    ESP_GOTO_ON_FALSE(s_i2s_standby_mux && s_i2s_evt, ESP_ERR_NO_MEM, err, TAG, "standby sync alloc failed");
+    xEventGroupSetBits(s_i2s_evt, I2S_EVT_RUNNING);
 
     return ESP_OK;
 
@@ -913,11 +2375,7 @@ esp_codec_dev_handle_t bsp_audio_codec_speaker_init(void)
 
     const audio_codec_gpio_if_t *gpio_if = audio_codec_new_gpio();
 
-    audio_codec_i2c_cfg_t i2c_cfg = {
-        .port = BSP_I2C_NUM,
-        .addr = ES8311_CODEC_DEFAULT_ADDR,
-    };
-    const audio_codec_ctrl_if_t *i2c_ctrl_if = audio_codec_new_i2c_ctrl(&i2c_cfg);
+    const audio_codec_ctrl_if_t *i2c_ctrl_if = i2c_bus_new_codec_ctrl(I2C_BUS_CODEC_OUT); // 调音量排在触摸后面
     assert(i2c_ctrl_if);
 
     esp_codec_dev_hw_gain_t gain = {
@@ -958,11 +2416,7 @@ esp_codec_dev_handle_t bsp_audio_codec_microphone_init(void)
     }
     assert(i2s_data_if);
 
-    audio_codec_i2c_cfg_t i2c_cfg = {
-        .port = BSP_I2C_NUM,
-        .addr = 0x82,
-    };
-    const audio_codec_ctrl_if_t *i2c_ctrl_if = audio_codec_new_i2c_ctrl(&i2c_cfg);
+    const audio_codec_ctrl_if_t *i2c_ctrl_if = i2c_bus_new_codec_ctrl(I2C_BUS_CODEC_IN);
     assert(i2c_ctrl_if);
 
     es7210_codec_cfg_t es7210_cfg = {
@@ -980,8 +2434,19 @@ esp_codec_dev_handle_t bsp_audio_codec_microphone_init(void)
     return esp_codec_dev_new(&codec_es7210_dev_cfg);
 }
 
-// 设置采样率
-esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+// 当前已打开的播放/录音格式 格式不变时不重新打开codec
+static esp_codec_dev_sample_info_t s_play_fs;
+static esp_codec_dev_sample_info_t s_record_fs;
+static bool s_play_opened = false;
+static bool s_record_opened = false;
+
+static bool codec_fs_equal(const esp_codec_dev_sample_info_t *a, const esp_codec_dev_sample_info_t *b)
+{
+    return a->sample_rate == b->sample_rate && a->channel == b->channel && a->bits_per_sample == b->bits_per_sample;
+}
+
+// 设置播放采样率 只在格式真正变化时关闭重开ES8311 不影响录音通路
+esp_err_t bsp_speaker_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
 {
     esp_err_t ret = ESP_OK;
 
@@ -990,20 +2455,81 @@ esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
         .channel = ch,
         .bits_per_sample = bits_cfg,
     };
-    
-    if (play_dev_handle) {
+
+    if (play_dev_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    i2s_standby_leave();
+    if (s_play_opened && codec_fs_equal(&fs, &s_play_fs)) {
+        return ESP_OK;
+    }
+
+    if (s_play_opened) {
         ret = esp_codec_dev_close(play_dev_handle);
     }
-    if (record_dev_handle) {
-        ret |= esp_codec_dev_close(record_dev_handle);
-        ret |= esp_codec_dev_set_in_gain(record_dev_handle, CODEC_DEFAULT_ADC_VOLUME);
+    ret |= esp_codec_dev_open(play_dev_handle, &fs);
+    s_play_opened = (ret == ESP_OK);
+    s_play_fs = fs;
+    ESP_LOGI(TAG, "speaker fs: %lu Hz, %lu bit, %d ch", (unsigned long)rate, (unsigned long)bits_cfg, ch);
+    return ret;
+}
+
+// 设置录音采样率 只在格式真正变化时关闭重开ES7210
+static esp_err_t bsp_microphone_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    esp_err_t ret = ESP_OK;
+
+    esp_codec_dev_sample_info_t fs = {
+        .sample_rate = rate,
+        .channel = ch,
+        .bits_per_sample = bits_cfg,
+    };
+
+    if (record_dev_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_record_opened && codec_fs_equal(&fs, &s_record_fs)) {
+        return ESP_OK;
+    }
+
+    if (s_record_opened) {
+        ret = esp_codec_dev_close(record_dev_handle);
+    }
+    ret |= esp_codec_dev_set_in_gain(record_dev_handle, CODEC_DEFAULT_ADC_VOLUME);
+    ret |= esp_codec_dev_open(record_dev_handle, &fs);
+    s_record_opened = (ret == ESP_OK);
+    s_record_fs = fs;
+    return ret;
+}
+
+// 录音现在的采样率 播放把共用时钟改掉以后就不是16k了 没打开时是0
+uint32_t bsp_microphone_get_rate(void)
+{
+    return s_record_opened ? s_record_fs.sample_rate : 0;
+}
+
+// 设置采样率
+// 播放和录音共用一组I2S时钟 只有播放格式变化才需要把录音设备同步过去
+esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    esp_err_t ret = ESP_OK;
+
+    esp_codec_dev_sample_info_t fs = {
+        .sample_rate = rate,
+        .channel = ch,
+        .bits_per_sample = bits_cfg,
+    };
+
+    if (s_play_opened && codec_fs_equal(&fs, &s_play_fs)) {
+        return ESP_OK; // 格式未变 不产生任何I2C通信
     }
 
     if (play_dev_handle) {
-        ret |= esp_codec_dev_open(play_dev_handle, &fs);
+        ret = bsp_speaker_set_fs(rate, bits_cfg, ch);
     }
-    if (record_dev_handle) {
-        ret |= esp_codec_dev_open(record_dev_handle, &fs);
+    if (record_dev_handle && s_record_fs.sample_rate != rate) {
+        // 录音只关心采样率是否和共用时钟一致 位宽和声道变化不重开
+        ret |= bsp_microphone_set_fs(rate, bits_cfg, ch);
     }
     return ret;
 }
@@ -1017,18 +2543,49 @@ esp_err_t bsp_codec_init(void)
     record_dev_handle = bsp_audio_codec_microphone_init();
     assert((record_dev_handle) && "record_dev_handle not initialized");
 
-    bsp_codec_set_fs(CODEC_DEFAULT_SAMPLE_RATE, CODEC_DEFAULT_BIT_WIDTH, CODEC_DEFAULT_CHANNEL);
-    esp_codec_dev_set_out_vol(play_dev_handle, VOLUME_DEFAULT);
+    bsp_speaker_set_fs(CODEC_DEFAULT_SAMPLE_RATE, CODEC_DEFAULT_BIT_WIDTH, CODEC_DEFAULT_CHANNEL);
+    bsp_microphone_set_fs(CODEC_DEFAULT_SAMPLE_RATE, CODEC_DEFAULT_BIT_WIDTH, CODEC_DEFAULT_CHANNEL);
+    esp_codec_dev_set_out_vol(play_dev_handle, CODEC_HW_VOLUME_REF);
 
     return ESP_OK;
 }
 
+static bsp_i2s_write_stats_t s_i2s_write_stats;
+
+void bsp_i2s_get_write_stats(bsp_i2s_write_stats_t *stats)
+{
+    *stats = s_i2s_write_stats;
+}
+
 // 播放音乐
+// 直接写I2S发送通道 超时返回ESP_ERR_TIMEOUT 并如实给出已写入的字节数
 esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
 {
     esp_err_t ret = ESP_OK;
-    ret = esp_codec_dev_write(play_dev_handle, audio_buffer, len);
-    *bytes_written = len;
+    size_t written = 0;
+
+    if (i2s_tx_chan == NULL || !s_play_opened) {
+        *bytes_written = 0;
+        return ESP_ERR_INVALID_STATE;
+    }
+    i2s_standby_leave();
+
+    int64_t start = esp_timer_get_time();
+    ret = i2s_channel_write(i2s_tx_chan, audio_buffer, len, &written, timeout_ms);
+    uint32_t cost = (uint32_t)(esp_timer_get_time() - start);
+
+    s_i2s_write_stats.writes++;
+    s_i2s_write_stats.last_us = cost;
+    s_i2s_write_stats.total_us += cost;
+    s_i2s_write_stats.total_bytes += written;
+    if (cost > s_i2s_write_stats.max_us) {
+        s_i2s_write_stats.max_us = cost;
+    }
+    if (ret == ESP_ERR_TIMEOUT) {
+        s_i2s_write_stats.timeouts++;
+    }
+
+    *bytes_written = written;
     return ret;
 }
 
@@ -1055,6 +2612,51 @@ int bsp_get_feed_channel(void)
     return ADC_I2S_CHANNEL;
 }
 
+// ES7210按TDM出四路 I2S按两个32位声道收 每帧两个字 低半字在前
+// w0 = ch1<<16 | ch0  w1 = ch3<<16 | ch2  麦克风是1和3 参考是0
+// 按字读写 两帧拼成三个字 比按半字一个个搬少一半的访存 写的位置总在读过的后面 可以原地
+typedef uint32_t __attribute__((may_alias)) feed_word_t;
+
+void bsp_feed_pack(const int16_t *raw, const int16_t *ref, int16_t *out, int frames)
+{
+    const feed_word_t *in = (const feed_word_t *)raw;
+    feed_word_t *o = (feed_word_t *)out;
+    int i = 0;
+    if (ref) {
+        for (; i + 1 < frames; i += 2, in += 4, o += 3) {
+            uint32_t a0 = in[0], a1 = in[1], b0 = in[2], b1 = in[3];
+            o[0] = (a0 >> 16) | (a1 & 0xffff0000);
+            o[1] = (uint16_t)ref[i] | (b0 & 0xffff0000);
+            o[2] = (b1 >> 16) | ((uint32_t)ref[i + 1] << 16);
+        }
+    } else {
+        for (; i + 1 < frames; i += 2, in += 4, o += 3) {
+            uint32_t a0 = in[0], a1 = in[1], b0 = in[2], b1 = in[3];
+            o[0] = (a0 >> 16) | (a1 & 0xffff0000);
+            o[1] = (a0 & 0xffff) | (b0 & 0xffff0000);
+            o[2] = (b1 >> 16) | (b0 << 16);
+        }
+    }
+    if (i < frames) { // 单数帧的最后一帧
+        const int16_t *f = (const int16_t *)in;
+        int16_t *d = (int16_t *)o;
+        int16_t r = ref ? ref[i] : f[0];
+        d[0] = f[1];
+        d[1] = f[3];
+        d[2] = r;
+    }
+}
+
+// 只要两路麦克风 每帧一个字
+void bsp_feed_pick_mics(const int16_t *raw, int16_t *out, int frames)
+{
+    const feed_word_t *in = (const feed_word_t *)raw;
+    feed_word_t *o = (feed_word_t *)out;
+    for (int i = 0; i < frames; i++) {
+        o[i] = (in[2 * i] >> 16) | (in[2 * i + 1] & 0xffff0000);
+    }
+}
+
 // 把I2S数据重新排布成模型需要的顺序
 esp_err_t bsp_get_feed_data(bool is_get_raw_channel, int16_t *buffer, int buffer_len)
 {
@@ -1062,15 +2664,13 @@ esp_err_t bsp_get_feed_data(bool is_get_raw_channel, int16_t *buffer, int buffer
     
     int audio_chunksize = buffer_len / (sizeof(int16_t) * ADC_I2S_CHANNEL);
 
+    if (s_i2s_standby) {
+        xEventGroupWaitBits(s_i2s_evt, I2S_EVT_RUNNING, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
     ret = esp_codec_dev_read(record_dev_handle, (void *)buffer, buffer_len);
     
     if (!is_get_raw_channel) {
-        for (int i = 0; i < audio_chunksize; i++) {
-            int16_t ref = buffer[4 * i + 0];
-            buffer[3 * i + 0] = buffer[4 * i + 1];
-            buffer[3 * i + 1] = buffer[4 * i + 3];
-            buffer[3 * i + 2] = ref;
-        }
+        bsp_feed_pack(buffer, NULL, buffer, audio_chunksize);
     }
 
     return ret;
@@ -1086,43 +2686,119 @@ static const char err_reason[][30] = {"input param is invalid",
                                       "operation timeout"
                                      };
 
+// 开机音DMA发送完成计数 在I2S中断里递减 减到0表示最后一块已经送出
+static volatile size_t s_boot_pcm_left = 0;
+
+static IRAM_ATTR bool boot_pcm_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    size_t left = s_boot_pcm_left;
+    if (left == 0)
+    {
+        return false;
+    }
+    if (event->size < left)
+    {
+        s_boot_pcm_left = left - event->size;
+        return false;
+    }
+    s_boot_pcm_left = 0;
+    BaseType_t woken = pdFALSE;
+    xEventGroupSetBitsFromISR(my_event_group, START_MUSIC_COMPLETED, &woken);
+    return woken == pdTRUE;
+}
+
+// event->data指向刚发完的描述符的缓冲指针 回调返回以后auto_clear才清零 这时还能看到发出去的数据
+static IRAM_ATTR bool i2s_tx_on_sent(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+    SYS_TRACE_ISR_ENTER("i2s_tx");
+    bsp_i2s_sent_cb_t cb = s_i2s_sent_cb;
+    if (cb)
+    {
+        cb(*(void **)event->data, event->size);
+    }
+    bool woken = boot_pcm_on_sent(handle, event, user_ctx);
+    SYS_TRACE_ISR_EXIT("i2s_tx");
+    return woken;
+}
+
+void bsp_i2s_set_sent_cb(bsp_i2s_sent_cb_t cb)
+{
+    s_i2s_sent_cb = cb;
+}
+
+// 关掉发送通道把开头预装进DMA缓冲 再打开 第一帧就是有效数据 剩下的由调用方直接写I2S
+// 发完len字节时在I2S中断里置START_MUSIC_COMPLETED 闹钟的快速开机也走这里
+esp_err_t bsp_pcm_preload(const uint8_t *data, size_t len, uint32_t rate, i2s_slot_mode_t ch, size_t *preloaded)
+{
+    size_t bytes_write = 0;
+
+    ESP_RETURN_ON_FALSE(i2s_tx_chan && s_play_opened, ESP_ERR_INVALID_STATE, TAG, "codec not ready");
+    i2s_standby_leave();
+    ESP_RETURN_ON_ERROR(bsp_codec_set_fs(rate, BOOT_PCM_BIT_WIDTH, ch), TAG, "set fs failed");
+
+    // 预装要在通道关闭时做 发送回调初始化时已经注册 音乐播放时s_boot_pcm_left为0 开机音那部分直接返回
+    ESP_RETURN_ON_ERROR(i2s_channel_disable(i2s_tx_chan), TAG, "disable tx failed");
+    s_boot_pcm_left = len;
+    xEventGroupClearBits(my_event_group, START_MUSIC_COMPLETED);
+
+    esp_err_t ret = i2s_channel_preload_data(i2s_tx_chan, data, len, &bytes_write);
+    *preloaded = bytes_write;
+    ESP_RETURN_ON_ERROR(i2s_channel_enable(i2s_tx_chan), TAG, "enable tx failed");
+    ESP_RETURN_ON_ERROR(ret, TAG, "preload failed");
+
+    pa_en(1); // 打开音频输出
+    return ESP_OK;
+}
+
+void bsp_pcm_preload_stop(void)
+{
+    s_boot_pcm_left = 0;
+    pa_en(0);
+}
+
+// 播放内嵌在固件里的PCM开机音 不经过解码器
+static esp_err_t boot_pcm_play(const uint8_t *data, size_t len)
+{
+    size_t bytes_write = 0;
+
+    ESP_RETURN_ON_ERROR(bsp_pcm_preload(data, len, BOOT_PCM_SAMPLE_RATE, I2S_SLOT_MODE_STEREO, &bytes_write), TAG, "preload");
+    data += bytes_write; // 跳过已预装的部分
+    len -= bytes_write;
+    if (len)
+    {
+        esp_err_t ret = i2s_channel_write(i2s_tx_chan, data, len, &bytes_write, portMAX_DELAY);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "[music] i2s write failed, %s", err_reason[ret == ESP_ERR_TIMEOUT]);
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
+
 void power_music_task(void *pvParameters)
 {
-    // esp_err_t ret = ESP_OK;
-    // size_t bytes_write = 0;
-    // uint8_t *data_ptr = (uint8_t *)music_pcm_start;
-    
-    // /* (Optional) Disable TX channel and preload the data before enabling the TX channel,
-    //  * so that the valid data can be transmitted immediately */
-    // ESP_ERROR_CHECK(i2s_channel_disable(i2s_tx_chan));
-    // ESP_ERROR_CHECK(i2s_channel_preload_data(i2s_tx_chan, data_ptr, music_pcm_end - data_ptr, &bytes_write));
-    // data_ptr += bytes_write;  // Move forward the data pointer
-
-    // /* Enable the TX channel */
-    // ESP_ERROR_CHECK(i2s_channel_enable(i2s_tx_chan));
-    
-    // pa_en(1);  // 打开音频输出
-    // /* Write music to earphone */
-    // ret = i2s_channel_write(i2s_tx_chan, data_ptr, music_pcm_end - data_ptr, &bytes_write, portMAX_DELAY);
-    // if (ret != ESP_OK) {
-    //     /* Since we set timeout to 'portMAX_DELAY' in 'i2s_channel_write'
-    //         so you won't reach here unless you set other timeout value,
-    //         if timeout detected, it means write operation failed. */
-    //     ESP_LOGE(TAG, "[music] i2s write failed, %s", err_reason[ret == ESP_ERR_TIMEOUT]);
-    //     abort();
-    // }
-    // if (bytes_write > 0) {
-    //     ESP_LOGI(TAG, "[music] i2s music played, %d bytes are written.", bytes_write);
-    // } else {
-    //     ESP_LOGE(TAG, "[music] i2s music play failed.");
-    //     abort();
-    // }
-
-    // pa_en(0);  // 关闭音频输出
-    // xEventGroupSetBits(my_event_group, START_MUSIC_COMPLETED);
+#if BOOT_SOUND_MODE == BOOT_SOUND_PCM
+    size_t len = music_pcm_end - music_pcm_start;
+    esp_err_t ret = boot_pcm_play(music_pcm_start, len);
+    if (ret == ESP_OK)
+    {
+        // 完成位由DMA发送完成中断置位 这里只负责之后关闭功放
+        EventBits_t bits = xEventGroupWaitBits(my_event_group, START_MUSIC_COMPLETED, pdFALSE, pdFALSE,
+                                               pdMS_TO_TICKS(BOOT_PCM_TIMEOUT_MS));
+        if (!(bits & START_MUSIC_COMPLETED))
+        {
+            ESP_LOGW(TAG, "[music] boot sound did not complete");
+        }
+        ESP_LOGI(TAG, "[music] boot sound played, %u bytes", len);
+    }
+    bsp_pcm_preload_stop(); // 关闭音频输出
+    xEventGroupSetBits(my_event_group, START_MUSIC_COMPLETED);
+#else
     // 使用SPIFFS中的MP3作为开机音乐，播放结束由播放器回调置位事件
     extern void app_play_boot_mp3(const char *filepath);
     app_play_boot_mp3(SPIFFS_BASE "/windows_xp.mp3");
+#endif
     vTaskDelete(NULL);
 }
 
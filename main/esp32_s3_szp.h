@@ -5,6 +5,7 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 #include "driver/i2c.h"
 #include "driver/spi_master.h"
 #include "driver/ledc.h"
@@ -24,6 +25,9 @@
 #include "driver/i2s_std.h"
 
 #include "esp_spiffs.h"
+#if CONFIG_APP_STORAGE_LITTLEFS
+#include "esp_littlefs.h"
+#endif
 #include "esp_vfs_fat.h"
 #include "sdmmc_cmd.h"
 #include "driver/sdmmc_host.h"
@@ -35,7 +39,7 @@
 #define BSP_I2C_SCL           (GPIO_NUM_2)   // SCL引脚
 
 #define BSP_I2C_NUM           (0)            // I2C外设
-#define BSP_I2C_FREQ_HZ       100000         // 100kHz
+#define BSP_I2C_FREQ_HZ       (CONFIG_APP_I2C_FREQ_KHZ * 1000) // 默认400kHz
 
 esp_err_t bsp_i2c_init(void);   // 初始化I2C接口
 /***************************  I2C ↑  *******************************************/
@@ -45,6 +49,20 @@ esp_err_t bsp_i2c_init(void);   // 初始化I2C接口
 /*******************************************************************************/
 /***************************  姿态传感器 QMI8658 ↓   ****************************/
 #define  QMI8658_SENSOR_ADDR       0x6A   // QMI8658 I2C地址
+#if defined(CONFIG_APP_IMU_INT_GPIO) && CONFIG_APP_IMU_INT_GPIO >= 0
+#define BSP_IMU_INT           (CONFIG_APP_IMU_INT_GPIO)  // QMI8658的INT2 FIFO到水位时拉高 飞线接到的GPIO
+#else
+#define BSP_IMU_INT           (GPIO_NUM_NC)             // 板子上没有引出INT 按水位的时间间隔去读
+#endif
+#define QMI8658_FIFO_SAMPLES  64     // FIFO_CTRL里选的深度 每组是加速度和陀螺仪各3轴
+#define QMI8658_SAMPLE_BYTES  12
+#if CONFIG_APP_IMU_ODR_HZ >= 896
+#define QMI8658_ODR_CODE      0x03   // CTRL2/CTRL3的ODR档 0011约896Hz
+#elif CONFIG_APP_IMU_ODR_HZ >= 448
+#define QMI8658_ODR_CODE      0x04   // 0100约448Hz
+#else
+#define QMI8658_ODR_CODE      0x05   // 0101约224Hz
+#endif
 
 // QMI8658寄存器地址
 enum qmi8658_reg
@@ -128,10 +146,18 @@ typedef struct{
 	float AngleZ;
 }t_sQMI8658;
 
+esp_err_t qmi8658_register_read(uint8_t reg_addr, uint8_t *data, size_t len);
+esp_err_t qmi8658_register_write_byte(uint8_t reg_addr, uint8_t data);
 esp_err_t qmi8658_init(void);  // QMI8658初始化
 void qmi8658_close(void); // 关闭芯片运行
+esp_err_t qmi8658_motion_only(void); // 只开加速度 低功耗ODR 运动检测照常 qmi8658_init之后调用
 void qmi8658_fetch_angleFromAcc(t_sQMI8658 *p);  // 获取倾角
+void qmi8658_calc_angleFromAcc(t_sQMI8658 *p);   // 只按p里已有的加速度算倾角 不读芯片
 uint8_t qmi8658_fetch_motion(void); // 获取运动状态
+esp_err_t qmi8658_fifo_enable(uint8_t watermark); // FIFO流模式 攒够watermark组置水位标志 有INT线时拉INT2
+void qmi8658_fifo_disable(void);
+// FIFO里的数据一次读出来 最多max组 返回读到几组 出错返回-1 overflow是否溢出丢过数据
+int qmi8658_fifo_read(int16_t (*samples)[6], int max, bool *overflow);
 
 /***************************  姿态传感器 QMI8658 ↑  ****************************/
 /*******************************************************************************/
@@ -171,6 +197,7 @@ uint8_t qmi8658_fetch_motion(void); // 获取运动状态
 #define SET_BITS(_m, _s, _v)  ((_v) ? (_m)|((_s)) : (_m)&~((_s)))
 
 void pca9557_init(void);
+esp_err_t pca9557_set_outputs(uint8_t mask, uint8_t levels);    // 几个引脚一起改 只写一次
 void lcd_cs(uint8_t level);
 void pa_en(uint8_t level);
 void dvp_pwdn(uint8_t level);
@@ -196,8 +223,18 @@ void dvp_pwdn(uint8_t level);
 #define BSP_LCD_DC            (GPIO_NUM_39)
 #define BSP_LCD_RST           (GPIO_NUM_NC)
 #define BSP_LCD_BACKLIGHT     (GPIO_NUM_42)  
+#if defined(CONFIG_APP_LCD_TE_GPIO) && CONFIG_APP_LCD_TE_GPIO >= 0
+#define BSP_LCD_TE            (CONFIG_APP_LCD_TE_GPIO)  // ST7789的TE输出 飞线接到的GPIO
+#else
+#define BSP_LCD_TE            (GPIO_NUM_NC)             // 板子上没有引出TE
+#endif
 
+#ifdef CONFIG_APP_LCD_DRAW_BUF_HEIGHT
+#define BSP_LCD_DRAW_BUF_HEIGHT    (CONFIG_APP_LCD_DRAW_BUF_HEIGHT)  // 开机时的绘图缓冲行数
+#else
 #define BSP_LCD_DRAW_BUF_HEIGHT    (20)
+#endif
+#define BSP_LCD_DRAW_BUF_MAX_HEIGHT (120)   // 运行时可调的上限 SPI单次传输按这个大小配置
 
 esp_err_t bsp_display_brightness_init(void);
 esp_err_t bsp_display_brightness_set(int brightness_percent);
@@ -207,6 +244,108 @@ esp_err_t bsp_lcd_init(void);
 void lcd_set_color(uint16_t color);
 void lcd_draw_pictrue(int x_start, int y_start, int x_end, int y_end, const unsigned char *gImage);
 void bsp_lvgl_start(void);
+
+#define BSP_TOUCH_POINTS      2     // LVGL只用第一个点 第二个点留给双指缩放
+#if defined(CONFIG_APP_TOUCH_INT_GPIO) && CONFIG_APP_TOUCH_INT_GPIO >= 0
+#define BSP_TOUCH_INT         (CONFIG_APP_TOUCH_INT_GPIO)  // FT5x06的INT 飞线接到的GPIO
+#else
+#define BSP_TOUCH_INT         (GPIO_NUM_NC)                // 板子上没有引出INT 按快慢两档轮询
+#endif
+#define BSP_TOUCH_FAST_MS     (CONFIG_APP_TOUCH_FAST_MS)   // 按着的时候多久读一次
+#define BSP_TOUCH_IDLE_MS     (CONFIG_APP_TOUCH_IDLE_MS)   // 没接INT 松开一会儿以后多久读一次
+#define BSP_TOUCH_IDLE_AFTER_MS 1000                       // 松开多久算没人碰
+// LVGL最近一次读到的触点 屏幕坐标 返回点数 在LVGL任务里(控件事件回调里)调用
+uint8_t bsp_touch_get_points(lv_point_t *points, uint8_t max);
+bool bsp_touch_pressed_raw(void);   // 直接读触摸芯片有没有按着 LVGL没起来时用
+
+typedef struct {
+    bool irq;                       // 接了INT
+    uint32_t reads;                 // 走I2C读触摸的次数
+    uint32_t idle_reads;            // 其中读之前是松开的 读了大多也是白读
+    uint32_t skipped;               // 接了INT 没来中断没有读
+    uint64_t idle_us;               // 松开的总时间 除idle_reads就是空闲时每秒几次
+    uint32_t presses;
+    uint64_t latency_us;            // 手指落下到LVGL拿到按下 没接INT时是最坏情况
+    uint32_t latency_max_us;
+} bsp_touch_stats_t;
+
+void bsp_touch_get_stats(bsp_touch_stats_t *stats);
+// 接了INT时每次触摸中断里调用 LVGL停着读触摸时用它叫醒 回调要放IRAM 不能阻塞
+typedef void (*bsp_touch_irq_cb_t)(void);
+void bsp_touch_set_irq_cb(bsp_touch_irq_cb_t cb);
+
+typedef enum {
+    BSP_DISP_RENDER_PARTIAL = 0,    // 20行双缓冲在DMA内存 分块渲染分块发送
+    BSP_DISP_RENDER_DIRECT,         // 整帧在PSRAM 只发送合并后的脏矩形
+    BSP_DISP_RENDER_MAX,
+} bsp_disp_render_mode_t;
+
+typedef struct {
+    uint32_t refreshes;             // LVGL刷新次数
+    uint32_t refr_ms_total;         // 渲染加发送的总耗时
+    uint32_t refr_ms_max;           // 最慢的一次刷新
+    uint32_t transfers;             // esp_lcd_panel_draw_bitmap调用次数
+    uint64_t bytes;                 // 发往屏幕的字节数
+    uint64_t px_rendered;           // LVGL重画的像素数
+    uint64_t busy_us;               // SPI链路上至少有一块在传输的时间
+    uint64_t wait_us;               // 渲染停下来等传输的时间 busy_us减去它就是和渲染重叠的部分
+} bsp_disp_flush_stats_t;
+
+typedef void (*bsp_disp_refresh_cb_t)(uint32_t total_us, uint32_t wait_us, uint32_t flush_us);   // 一次刷新的总耗时 等传输的时间 链路忙的时间
+void bsp_display_set_refresh_cb(bsp_disp_refresh_cb_t cb);
+// 一次刷新的所有区域都画完、最后一块已经交给SPI时在LVGL任务里调用 这之后本次刷新不会再读任何图片源
+typedef void (*bsp_disp_rendered_cb_t)(void *arg);
+void bsp_display_set_rendered_cb(bsp_disp_rendered_cb_t cb, void *arg);
+// 发往屏幕的每块像素在LVGL任务里先给它看一眼 px是区域左上角 stride是一行隔多少像素 屏幕镜像用 要快
+typedef void (*bsp_disp_tee_cb_t)(const lv_area_t *area, const lv_color_t *px, int stride);
+void bsp_display_set_tee_cb(bsp_disp_tee_cb_t cb);
+esp_err_t bsp_display_set_render_mode(bsp_disp_render_mode_t mode);    // 运行时切换 DIRECT要150KB PSRAM
+bsp_disp_render_mode_t bsp_display_get_render_mode(void);
+esp_err_t bsp_display_set_draw_buf_height(int lines);                  // 重新分配PARTIAL模式的两块DMA绘图缓冲
+int bsp_display_get_draw_buf_height(void);
+void bsp_display_get_flush_stats(bsp_disp_render_mode_t mode, bsp_disp_flush_stats_t *stats);   // 两种模式分开累计
+
+typedef struct {
+    uint32_t switches;
+    uint32_t last_us;               // 等传输排空加改MADCTL 不含接着的整屏重画
+    uint32_t max_us;
+} bsp_rotate_stats_t;
+
+// 改屏幕的MADCTL转屏 刷新路径上不转像素 LVGL锁可重入 在LVGL任务里也能调
+// 90/270时LVGL的宽高对调 界面要按父对象大小排 镜像的tee不再调用 预览中不能转 竖屏时不能开预览
+esp_err_t bsp_display_set_rotation(lv_disp_rot_t rot);
+lv_disp_rot_t bsp_display_get_rotation(void);
+void bsp_display_get_rotate_stats(bsp_rotate_stats_t *stats);
+// 待机用 true: 停LVGL的刷新和读触摸 等传输排空 屏幕进睡眠 显存里的画面留着
+// false: 屏幕出睡眠 恢复刷新 只画睡着时作废的区域 约5ms 背光归调用者
+esp_err_t bsp_display_sleep(bool sleep);
+
+typedef struct {
+    uint32_t te_edges;              // 收到的TE边沿 没接TE时是模拟定时器的次数
+    uint32_t frames;                // 等过同步再发的帧
+    uint32_t dropped;               // 渲染太慢 屏幕重复扫描旧画面的次数
+    uint32_t late;                  // 一帧还没发完就来了下一个边沿 可能撕裂
+    uint32_t timeouts;              // 等了两帧也没有边沿 TE没接好
+    uint64_t wait_us;               // 刷新停下来等同步的总时间
+} bsp_vsync_stats_t;
+
+esp_err_t bsp_display_set_vsync(bool on);   // 每次刷新先等TE 第一次打开时建立TE中断或模拟定时器
+bool bsp_display_get_vsync(void);
+void bsp_display_get_vsync_stats(bsp_vsync_stats_t *stats);
+
+typedef struct {
+    uint32_t frames;                // 推到屏幕的相机帧数
+    uint64_t wall_us;               // 预览开始到现在(或结束)的时间 frames除以它就是帧率
+    uint64_t push_us;               // 拷贝和排队发送的时间
+    uint64_t copy_bytes;            // CPU拷贝的字节数 除以frames和帧大小就是每帧拷贝次数
+    uint64_t blend_px;              // 叠加层混合的像素数
+    uint32_t snapshots;             // 叠加层重新截图的次数
+} bsp_preview_stats_t;
+
+esp_err_t bsp_display_preview_begin(lv_obj_t *const *overlays, int count);  // 摄像头直通预览 overlays最多6个
+esp_err_t bsp_display_preview_frame(const void *pixels, int w, int h);     // RGB565 在摄像头任务里调用
+void bsp_display_preview_end(void);
+void bsp_display_get_preview_stats(bsp_preview_stats_t *stats);
 /***************    LCD显示屏 ↑   *************************/
 /***********************************************************/
 
@@ -234,13 +373,34 @@ void bsp_lvgl_start(void);
 #define CAMERA_PIN_VSYNC 3
 #define CAMERA_PIN_HREF 46
 #define CAMERA_PIN_PCLK 7
-#define CAMERA_FB_COUNT 2
+#define CAMERA_FB_COUNT CONFIG_APP_CAMERA_FB_COUNT  // LVGL预览要占住正在显示和等着显示的两块
 
 #define JPEG_QUALITY 5
+#define CAMERA_JPEG_QUALITY CONFIG_APP_CAMERA_JPEG_QUALITY  // JPEG模式 数字越小画质越好文件越大
+#if CONFIG_APP_CAMERA_JPEG_UXGA
+#define CAMERA_JPEG_FRAMESIZE FRAMESIZE_UXGA
+#elif CONFIG_APP_CAMERA_JPEG_XGA
+#define CAMERA_JPEG_FRAMESIZE FRAMESIZE_XGA
+#elif CONFIG_APP_CAMERA_JPEG_SVGA
+#define CAMERA_JPEG_FRAMESIZE FRAMESIZE_SVGA
+#else
+#define CAMERA_JPEG_FRAMESIZE FRAMESIZE_VGA
+#endif
+
+#define CAMERA_HIRES_FRAMESIZE FRAMESIZE_VGA   // GC0308最大就是VGA RGB565再大一帧就放不下了
 
 #define XCLK_FREQ_HZ 24000000
 
-void bsp_camera_init(void);
+typedef enum {
+    BSP_CAMERA_RGB565 = 0,          // QVGA RGB565 直接就是屏幕的像素
+    BSP_CAMERA_JPEG,                // 传感器压好的JPEG 分辨率按配置 预览要解码
+    BSP_CAMERA_GRAY,                // QVGA 只有亮度 扫码用 预览要自己展开成RGB565
+    BSP_CAMERA_RGB565_HI,           // CAMERA_HIRES_FRAMESIZE的RGB565 只拍一张用 一块帧缓冲
+} bsp_camera_mode_t;
+
+void bsp_camera_init(void);                                 // 等于bsp_camera_init_mode(BSP_CAMERA_RGB565)
+esp_err_t bsp_camera_init_mode(bsp_camera_mode_t mode);     // 传感器不支持JPEG时退回RGB565 返回ESP_ERR_NOT_SUPPORTED
+bsp_camera_mode_t bsp_camera_get_mode(void);
 void app_camera_lcd(void);
 
 #endif
@@ -252,9 +412,30 @@ void app_camera_lcd(void);
 
 /***********************************************************/
 /***************    SPIFFS文件系统 ↓   *********************/
+// storage分区 开机音 闹钟铃声这些 挂在SPIFFS_BASE 后端按配置是SPIFFS或者LittleFS 路径不变
+// LittleFS挂不上而分区里是SPIFFS(只升级了程序) 用SPIFFS读出来放进PSRAM 格式化成LittleFS再写回去
 #define SPIFFS_BASE             "/spiffs"
+#define SPIFFS_LABEL            "storage"
+#define SPIFFS_MAX_FILES        CONFIG_APP_SPIFFS_MAX_FILES    // 只对SPIFFS LittleFS不限
+#define SPIFFS_BENCH_BUF        4096    // 读速度测试每次读多少
+
+typedef struct {
+    bool littlefs;
+    bool migrated;                  // 这次开机从SPIFFS搬过来的
+    uint32_t migrated_files;
+    uint32_t mount_us;              // 含迁移
+    size_t total;
+    size_t used;
+    // bsp_spiffs_bench的结果
+    uint32_t files;
+    uint64_t bytes;
+    uint32_t open_us;               // 所有文件打开的总时间
+    uint32_t read_us;               // 顺序读完的总时间
+} bsp_spiffs_stats_t;
 
 esp_err_t bsp_spiffs_mount(void);
+esp_err_t bsp_spiffs_bench(void);   // 把分区里的文件都顺序读一遍 记吞吐 会阻塞
+void bsp_spiffs_get_stats(bsp_spiffs_stats_t *stats);
 
 /***************    SPIFFS文件系统 ↑  *********************/
 /**********************************************************/
@@ -267,11 +448,35 @@ esp_err_t bsp_spiffs_mount(void);
 #define SD_CMD_IO      (48) 
 #define SD_CLK_IO      (47)
 #define SD_DAT0_IO     (21)
+// 板子只引出了DAT0 DAT1~3飞线或者换板后在menuconfig里填 填齐了才能用4线
+#if defined(CONFIG_APP_SD_4BIT) && CONFIG_APP_SD_DAT1_GPIO >= 0 && CONFIG_APP_SD_DAT2_GPIO >= 0 && CONFIG_APP_SD_DAT3_GPIO >= 0
+#define SD_DAT1_IO     (CONFIG_APP_SD_DAT1_GPIO)
+#define SD_DAT2_IO     (CONFIG_APP_SD_DAT2_GPIO)
+#define SD_DAT3_IO     (CONFIG_APP_SD_DAT3_GPIO)
+#define SD_BUS_WIDTH   4
+#else
+#define SD_BUS_WIDTH   1
+#endif
+#if defined(CONFIG_APP_SD_CD_GPIO) && CONFIG_APP_SD_CD_GPIO >= 0
+#define SD_CD_IO       (CONFIG_APP_SD_CD_GPIO)  // 卡座的检测开关 低电平是有卡
+#else
+#define SD_CD_IO       (-1)
+#endif
+#if CONFIG_APP_SD_HIGHSPEED
+#define SD_BUS_FREQ_KHZ    SDMMC_FREQ_HIGHSPEED    // 卡不支持高速时驱动自己留在20MHz
+#else
+#define SD_BUS_FREQ_KHZ    SDMMC_FREQ_DEFAULT
+#endif
 
 #define SD_MOUNT_POINT     "/sdcard"
+#define SD_MAX_FILES       CONFIG_APP_SD_MAX_FILES // 同时开着的文件 只读的图片走fd_pool共用句柄
 #define PHOTO_SAVE_PATH  SD_MOUNT_POINT"/photo"
-esp_err_t bsp_sdcard_mount(void); // 挂载SD卡
-esp_err_t bsp_sdcard_unmount(void); // 卸载SD卡
+esp_err_t bsp_sdcard_mount(void); // 挂载SD卡 按配置的线数和频率 失败时退回1线20MHz再试一次
+esp_err_t bsp_sdcard_mount_bus(int width, int freq_khz); // 指定线数和频率挂载 不退回 基准测试用
+esp_err_t bsp_sdcard_unmount(void); // 卸载SD卡 目录缓存先留着 挂回同一张卡后逐个核对
+bool bsp_sdcard_mounted(void);
+void bsp_sdcard_get_bus(int *width, int *freq_khz); // 现在挂载用的线数和实际时钟 没挂载时都是0
+bool bsp_sdcard_fatfs_path(const char *path, char *out, size_t len); // /sdcard开头的路径换成FATFS的 没挂载返回false
 /**********************    SD卡 ↑  *********************/
 /**********************************************************/
 
@@ -285,6 +490,7 @@ esp_err_t bsp_sdcard_unmount(void); // 卸载SD卡
 #define ADC_I2S_CHANNEL 4
 
 #define VOLUME_DEFAULT    60        // 默认声音大小 0~100
+#define CODEC_HW_VOLUME_REF  100    // codec硬件音量固定参考值 实际音量由PCM软件增益调节
 
 #define CODEC_DEFAULT_SAMPLE_RATE          (16000)
 #define CODEC_DEFAULT_BIT_WIDTH            (16)
@@ -292,6 +498,8 @@ esp_err_t bsp_sdcard_unmount(void); // 卸载SD卡
 #define CODEC_DEFAULT_CHANNEL              (2)
 
 #define BSP_I2S_NUM                  I2S_NUM_1
+#define BSP_I2S_DMA_DESC_NUM         8       // DMA描述符个数
+#define BSP_I2S_DMA_FRAME_NUM        480     // 每个描述符的帧数 32位立体声时8个共30KB
 
 #define GPIO_I2S_LRCK       (GPIO_NUM_13)
 #define GPIO_I2S_MCLK       (GPIO_NUM_38)
@@ -300,19 +508,51 @@ esp_err_t bsp_sdcard_unmount(void); // 卸载SD卡
 #define GPIO_I2S_DOUT       (GPIO_NUM_45)
 #define GPIO_PWR_CTRL       (GPIO_NUM_NC)
 
+// I2S写入统计
+typedef struct {
+    uint32_t writes;        // 写入次数
+    uint32_t timeouts;      // 超时(部分写入)次数
+    uint32_t last_us;       // 最近一次写入耗时
+    uint32_t max_us;        // 最长一次写入耗时
+    uint64_t total_us;      // 累计写入耗时
+    uint64_t total_bytes;   // 累计写入字节数
+} bsp_i2s_write_stats_t;
+
 esp_err_t bsp_codec_init(void);
+void bsp_i2s_get_write_stats(bsp_i2s_write_stats_t *stats);
 esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+// 每个DMA描述符发完时在I2S中断里调用 buf是刚发出去的数据 回调要放IRAM 不能阻塞
+typedef void (*bsp_i2s_sent_cb_t)(const void *buf, size_t size);
+void bsp_i2s_set_sent_cb(bsp_i2s_sent_cb_t cb);
 esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
+// 16位PCM 开头预装进DMA再开通道 *preloaded是预装了多少 剩下的用bsp_i2s_write写 全部发完置START_MUSIC_COMPLETED
+esp_err_t bsp_pcm_preload(const uint8_t *data, size_t len, uint32_t rate, i2s_slot_mode_t ch, size_t *preloaded);
+void bsp_pcm_preload_stop(void);        // 不等发完 关功放
+// 待机时关掉I2S两个通道 读麦克风的阻塞到醒来 写I2S 改格式 预装会自己把通道打开
+esp_err_t bsp_audio_standby(bool on);
+bool bsp_audio_in_standby(void);
 esp_err_t bsp_speaker_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
+uint32_t bsp_microphone_get_rate(void);
 esp_err_t bsp_codec_mute_set(bool enable);
 esp_err_t bsp_codec_volume_set(int volume, int *volume_set);
 
 int bsp_get_feed_channel(void);
 esp_err_t bsp_get_feed_data(bool is_get_raw_channel, int16_t *buffer, int buffer_len);
+// 四路原始数据排成AFE要的 麦克风1 麦克风2 参考 ref为NULL时参考用第0路 out可以就是raw 都要4字节对齐
+void bsp_feed_pack(const int16_t *raw, const int16_t *ref, int16_t *out, int frames);
+void bsp_feed_pick_mics(const int16_t *raw, int16_t *out, int frames); // 只取两路麦克风 可以原地
 
 #define START_MUSIC_COMPLETED            BIT0
 #define WIFI_SET_START                   BIT1
 void power_music_task(void *pvParameters);
 
+// 开机音来源 PCM:固件内嵌的sword.pcm 用I2S预装直接播放  MP3:SPIFFS中的windows_xp.mp3 需要启动解码器
+#define BOOT_SOUND_PCM                   0
+#define BOOT_SOUND_MP3                   1
+#define BOOT_SOUND_MODE                  BOOT_SOUND_PCM
+#define BOOT_PCM_SAMPLE_RATE             16000   // sword.pcm 16kHz 16位 双声道
+#define BOOT_PCM_BIT_WIDTH               16
+#define BOOT_PCM_TIMEOUT_MS              10000   // 等待DMA送完的最长时间
+
 /*********************    音频 ↑   *************************/
 /***********************************************************/
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include <string.h>
+#include "evt_bus.h"
+#include "ui_msg.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "evt_bus";
+
+typedef struct {
+    evt_id_t id;
+    evt_bus_mode_t mode;
+    evt_cb_t cb;                        // NULL是空位
+} sub_t;
+
+typedef struct {
+    evt_t ev;
+    evt_cb_t cb;                        // 退订了就清成NULL 取出来时跳过
+} slot_t;
+
+static sub_t s_subs[EVT_BUS_MAX_SUBS];
+static slot_t s_slots[EVT_BUS_SLOTS];
+static uint32_t s_head;                 // 下一个要送的
+static uint32_t s_tail;                 // 下一个空槽
+static bool s_kicked;                   // 已经投递过bus_drain 还没跑完
+static evt_bus_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 在LVGL任务里 一直取到槽空为止 取的过程中新发布的也在这一轮送掉
+static void bus_drain(void *arg)
+{
+    while (1)
+    {
+        slot_t slot;
+        portENTER_CRITICAL(&s_lock);
+        if (s_head == s_tail)
+        {
+            s_kicked = false;
+            portEXIT_CRITICAL(&s_lock);
+            return;
+        }
+        slot = s_slots[s_head++ & (EVT_BUS_SLOTS - 1)];
+        portEXIT_CRITICAL(&s_lock);
+        if (slot.cb == NULL)
+        {
+            continue;
+        }
+        uint32_t us = esp_timer_get_time() - slot.ev.t_us;
+        slot.cb(&slot.ev);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.deferred++;
+        s_stats.delay_us += us;
+        if (us > s_stats.max_delay_us)
+        {
+            s_stats.max_delay_us = us;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+esp_err_t evt_bus_subscribe(evt_id_t id, evt_cb_t cb, evt_bus_mode_t mode)
+{
+    if (id >= EVT_COUNT || cb == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < EVT_BUS_MAX_SUBS; i++)
+    {
+        if (s_subs[i].cb == NULL)
+        {
+            s_subs[i] = (sub_t){ .id = id, .mode = mode, .cb = cb };
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "no room for a subscriber of event %d", id);
+    }
+    return ret;
+}
+
+void evt_bus_unsubscribe(evt_id_t id, evt_cb_t cb)
+{
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < EVT_BUS_MAX_SUBS; i++)
+    {
+        if (s_subs[i].id == id && s_subs[i].cb == cb)
+        {
+            s_subs[i].cb = NULL;
+        }
+    }
+    for (uint32_t i = s_head; i != s_tail; i++)
+    {
+        slot_t *slot = &s_slots[i & (EVT_BUS_SLOTS - 1)];
+        if (slot->ev.id == id && slot->cb == cb)
+        {
+            slot->cb = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void evt_bus_publish(evt_id_t id, uint32_t a, uint32_t b)
+{
+    const evt_t ev = { .id = id, .a = a, .b = b, .t_us = esp_timer_get_time() };
+    evt_cb_t direct[EVT_BUS_MAX_SUBS];
+    int n = 0;
+    bool kick = false;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.published++;
+    for (int i = 0; i < EVT_BUS_MAX_SUBS; i++)
+    {
+        const sub_t *sub = &s_subs[i];
+        if (sub->cb == NULL || sub->id != id)
+        {
+            continue;
+        }
+        if (sub->mode == EVT_BUS_DIRECT)
+        {
+            direct[n++] = sub->cb;
+        }
+        else if (s_tail - s_head < EVT_BUS_SLOTS)
+        {
+            s_slots[s_tail++ & (EVT_BUS_SLOTS - 1)] = (slot_t){ .ev = ev, .cb = sub->cb };
+            if (s_tail - s_head > s_stats.max_pending)
+            {
+                s_stats.max_pending = s_tail - s_head;
+            }
+            kick |= !s_kicked;
+            s_kicked = true;
+        }
+        else
+        {
+            s_stats.dropped++;
+        }
+    }
+    s_stats.direct += n;
+    portEXIT_CRITICAL(&s_lock);
+
+    // 在锁外调 订阅者可以阻塞 也可以再发布
+    for (int i = 0; i < n; i++)
+    {
+        direct[i](&ev);
+    }
+    if (kick && !ui_post_call(bus_drain, NULL))
+    {
+        // 界面队列还没起来或者满了 槽里的留给下一次发布再投递
+        portENTER_CRITICAL(&s_lock);
+        s_kicked = false;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+void evt_bus_get_stats(evt_bus_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
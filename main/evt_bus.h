@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 模块间的事件 ****************************/
+// 发布的人不用知道谁在听 订阅表和排队的槽都是静态的 发布时不分配内存
+// EVT_BUS_DIRECT 在发布者的任务里同步调 调完publish才返回 拔卡这种要等别人收尾的用它
+// EVT_BUS_UI 先放进槽里 再投递一次ui_post_call 在LVGL任务里按发布顺序调 可以直接碰控件
+// 解码 网络 传感器这些任务只管发布 界面的事在UI订阅者里做
+// 不能在中断里发布 要等结果的同步(开机音乐放完之类)还是用事件组
+
+#define EVT_BUS_MAX_SUBS        16
+#define EVT_BUS_SLOTS           16      // 还没送到LVGL任务的事件 必须是2的幂
+
+typedef enum {
+    EVT_SD,                             // a: sd_hotplug_event_t
+    EVT_IDLE,                           // a: idle_state_t 背光状态变了
+    EVT_TIME_SYNCED,                    // a: time_sync_source_t 系统时间对上了
+    EVT_MUSIC_TRACK,                    // a: 播放列表里的序号 自动换到了下一首
+    EVT_MUSIC_LYRIC,                    // a: 歌词行号(int) 见music_lyrics.h b: 歌词表的代数
+    EVT_GESTURE,                        // a: imu_gesture_t b: 手势开始到发布的毫秒
+    EVT_MOTION,                         // 空闲管理读到Any-Motion 在它的任务里 动着时最多IDLE_POLL_MS一次
+    EVT_COUNT,
+} evt_id_t;
+
+typedef struct {
+    evt_id_t id;
+    uint32_t a;
+    uint32_t b;
+    int64_t t_us;                       // 发布的时间
+} evt_t;
+
+typedef enum {
+    EVT_BUS_DIRECT,
+    EVT_BUS_UI,
+} evt_bus_mode_t;
+
+typedef void (*evt_cb_t)(const evt_t *ev);
+
+typedef struct {
+    uint32_t published;
+    uint32_t direct;                    // 在发布者任务里调的次数
+    uint32_t deferred;                  // 在LVGL任务里调的次数
+    uint32_t dropped;                   // 槽满了没送到的
+    uint32_t max_pending;               // 同时排着的最多个数
+    uint32_t max_delay_us;              // 发布到UI订阅者被调的最长时间
+    uint64_t delay_us;                  // 和deferred一起算平均
+} evt_bus_stats_t;
+
+esp_err_t evt_bus_subscribe(evt_id_t id, evt_cb_t cb, evt_bus_mode_t mode);
+void evt_bus_unsubscribe(evt_id_t id, evt_cb_t cb);    // 还在槽里没送到的也不送了
+void evt_bus_publish(evt_id_t id, uint32_t a, uint32_t b);
+void evt_bus_get_stats(evt_bus_stats_t *stats);
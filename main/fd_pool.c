@@ -0,0 +1,323 @@
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "fd_pool.h"
+#include "crash_ctx.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "fd_pool";
+
+struct fd_pool_file {
+    char *path;                         // NULL是空槽
+    int fd;
+    uint16_t refs;
+    uint32_t size;
+    time_t mtime;
+    int64_t last_use;                   // 最后一个引用放掉的时间
+};
+
+static struct fd_pool_file s_slot[FD_POOL_SLOTS];
+static SemaphoreHandle_t s_mutex;
+static esp_timer_handle_t s_timer;
+static fd_pool_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool too_many(int err)
+{
+    return err == ENFILE || err == EMFILE;
+}
+
+// 持有s_mutex时调
+static void slot_close(struct fd_pool_file *s)
+{
+    close(s->fd);
+    free(s->path);
+    s->path = NULL;
+    s->fd = -1;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.open_fds--;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 关掉最久没用的空闲句柄 没有空闲的返回false
+static bool evict_lru(void)
+{
+    struct fd_pool_file *lru = NULL;
+    for (int i = 0; i < FD_POOL_SLOTS; i++)
+    {
+        struct fd_pool_file *s = &s_slot[i];
+        if (s->path && s->refs == 0 && (lru == NULL || s->last_use < lru->last_use))
+        {
+            lru = s;
+        }
+    }
+    if (lru == NULL)
+    {
+        return false;
+    }
+    slot_close(lru);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.evicted++;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+static void arm_timer(int64_t now)
+{
+    int64_t first = 0;
+    for (int i = 0; i < FD_POOL_SLOTS; i++)
+    {
+        if (s_slot[i].path && s_slot[i].refs == 0 && (first == 0 || s_slot[i].last_use < first))
+        {
+            first = s_slot[i].last_use;
+        }
+    }
+    if (first && !esp_timer_is_active(s_timer))
+    {
+        int64_t wait = first + FD_POOL_IDLE_MS * 1000LL - now;
+        esp_timer_start_once(s_timer, wait > 1000 ? wait : 1000);
+    }
+}
+
+static void idle_timer_cb(void *arg)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < FD_POOL_SLOTS; i++)
+    {
+        struct fd_pool_file *s = &s_slot[i];
+        if (s->path && s->refs == 0 && now - s->last_use >= FD_POOL_IDLE_MS * 1000LL)
+        {
+            slot_close(s);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.expired++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+    arm_timer(now);
+    xSemaphoreGive(s_mutex);
+}
+
+esp_err_t fd_pool_init(void)
+{
+    if (s_mutex)
+    {
+        return ESP_OK;
+    }
+    s_mutex = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_mutex, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+#if CONFIG_APP_CRASH_CTX
+    crash_ctx_watch_lock("fd_pool", s_mutex);
+#endif
+    const esp_timer_create_args_t args = {
+        .callback = idle_timer_cb,
+        .name = "fd_pool",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "timer create failed");
+    for (int i = 0; i < FD_POOL_SLOTS; i++)
+    {
+        s_slot[i].fd = -1;
+    }
+    return ESP_OK;
+}
+
+fd_pool_file_t *fd_pool_open(const char *path)
+{
+    if (s_mutex == NULL || path == NULL)
+    {
+        return NULL;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.opens++;
+    portEXIT_CRITICAL(&s_lock);
+
+    struct fd_pool_file *hit = NULL, *empty = NULL;
+    for (int i = 0; i < FD_POOL_SLOTS; i++)
+    {
+        struct fd_pool_file *s = &s_slot[i];
+        if (s->path == NULL)
+        {
+            empty = empty ? empty : s;
+        }
+        else if (strcmp(s->path, path) == 0)
+        {
+            hit = s;
+        }
+    }
+    struct stat st;
+    if (hit && hit->refs == 0)
+    {
+        // 空闲的时候文件可能被删了或者重写了 FATFS的FIL不会知道
+        if (stat(path, &st) == 0 && (uint32_t)st.st_size == hit->size && st.st_mtime == hit->mtime)
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_stats.reused++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        else
+        {
+            slot_close(hit);
+            empty = hit;
+            hit = NULL;
+            portENTER_CRITICAL(&s_lock);
+            s_stats.stale++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+    else if (hit)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.shared++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+
+    if (hit == NULL)
+    {
+        if (empty == NULL && evict_lru())
+        {
+            for (int i = 0; i < FD_POOL_SLOTS && empty == NULL; i++)
+            {
+                empty = s_slot[i].path ? NULL : &s_slot[i];
+            }
+        }
+        int fd = -1;
+        char *dup = empty ? strdup(path) : NULL;
+        if (dup)
+        {
+            fd = open(path, O_RDONLY);
+            while (fd < 0 && too_many(errno) && evict_lru())
+            {
+                portENTER_CRITICAL(&s_lock);
+                s_stats.retries++;
+                portEXIT_CRITICAL(&s_lock);
+                fd = open(path, O_RDONLY);
+            }
+        }
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            free(dup);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.failed++;
+            portEXIT_CRITICAL(&s_lock);
+            xSemaphoreGive(s_mutex);
+            if (empty == NULL)
+            {
+                ESP_LOGW(TAG, "all %d slots in use, %s not opened", FD_POOL_SLOTS, path);
+            }
+            return NULL;
+        }
+        hit = empty;
+        hit->path = dup;
+        hit->fd = fd;
+        hit->size = st.st_size;
+        hit->mtime = st.st_mtime;
+        portENTER_CRITICAL(&s_lock);
+        if (++s_stats.open_fds > s_stats.max_fds)
+        {
+            s_stats.max_fds = s_stats.open_fds;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    hit->refs++;
+    uint32_t refs = 0;
+    for (int i = 0; i < FD_POOL_SLOTS; i++)
+    {
+        refs += s_slot[i].refs;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (refs > s_stats.max_refs)
+    {
+        s_stats.max_refs = refs;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    xSemaphoreGive(s_mutex);
+    return hit;
+}
+
+int fd_pool_pread(fd_pool_file_t *f, void *buf, size_t len, uint32_t off)
+{
+    // 共用的fd不动它的读写位置 FATFS的pread在卷锁里自己定位再恢复
+    return pread(f->fd, buf, len, off);
+}
+
+uint32_t fd_pool_size(const fd_pool_file_t *f)
+{
+    return f->size;
+}
+
+void fd_pool_close(fd_pool_file_t *f)
+{
+    if (f == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (f->refs && --f->refs == 0)
+    {
+        f->last_use = esp_timer_get_time();
+        arm_timer(f->last_use);
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+FILE *fd_pool_fopen(const char *path, const char *mode)
+{
+    FILE *f = fopen(path, mode);
+    if (f || !too_many(errno) || s_mutex == NULL)
+    {
+        return f;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    bool freed = false;
+    while (evict_lru())
+    {
+        freed = true;
+    }
+    xSemaphoreGive(s_mutex);
+    if (!freed)
+    {
+        return NULL;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.retries++;
+    portEXIT_CRITICAL(&s_lock);
+    return fopen(path, mode);
+}
+
+void fd_pool_flush(const char *prefix)
+{
+    if (s_mutex == NULL)
+    {
+        return;
+    }
+    size_t n = prefix ? strlen(prefix) : 0;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (int i = 0; i < FD_POOL_SLOTS; i++)
+    {
+        struct fd_pool_file *s = &s_slot[i];
+        if (s->path && s->refs == 0 && strncmp(s->path, prefix ? prefix : "", n) == 0)
+        {
+            slot_close(s);
+        }
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+void fd_pool_get_stats(fd_pool_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
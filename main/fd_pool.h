@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 文件句柄池 ****************************/
+// FATFS挂载时按max_files预先分配FIL 满了fopen就返回ENFILE 图片 音乐 视频 缩略图同时开文件时容易撞上
+// 只读的文件从这里拿句柄: 同一个文件同时被几处读 共用一个POSIX fd 各自用pread带偏移读 互不影响
+// 没人用的句柄先留着 过FD_POOL_IDLE_MS关掉 再打开同一个文件时核对大小和修改时间没变就直接用
+// 槽位满了或者fopen撞到上限 按最久没用的顺序关空闲句柄腾地方
+// 要写的文件和交给别的库的FILE用fd_pool_fopen 它不进池子 只是撞上限时先关空闲句柄再试一次
+
+#define FD_POOL_SLOTS           CONFIG_APP_FD_POOL_SLOTS
+#define FD_POOL_IDLE_MS         3000
+
+typedef struct fd_pool_file fd_pool_file_t;
+
+typedef struct {
+    uint32_t opens;                     // fd_pool_open调用
+    uint32_t shared;                    // 文件已经有人开着 共用
+    uint32_t reused;                    // 用了留着的空闲句柄
+    uint32_t stale;                     // 空闲句柄对应的文件变了 重开
+    uint32_t evicted;                   // 为腾地方关掉的空闲句柄
+    uint32_t expired;                   // 空闲超时关掉的
+    uint32_t retries;                   // 撞到上限后关空闲句柄重试
+    uint32_t failed;
+    uint32_t open_fds;                  // 池子现在开着的fd
+    uint32_t max_fds;                   // 开着的fd最多时
+    uint32_t max_refs;                  // 同一时刻的引用最多时
+} fd_pool_stats_t;
+
+esp_err_t fd_pool_init(void);
+fd_pool_file_t *fd_pool_open(const char *path);         // 只读 失败返回NULL
+int fd_pool_pread(fd_pool_file_t *f, void *buf, size_t len, uint32_t off);
+uint32_t fd_pool_size(const fd_pool_file_t *f);
+void fd_pool_close(fd_pool_file_t *f);                  // 放掉引用 句柄留着等超时
+FILE *fd_pool_fopen(const char *path, const char *mode);
+void fd_pool_flush(const char *prefix);                 // 关掉路径以prefix开头的空闲句柄 卸卡 删文件前调
+void fd_pool_get_stats(fd_pool_stats_t *stats);
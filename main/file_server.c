@@ -0,0 +1,735 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "file_server.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "ff.h"
+#include "esp32_s3_szp.h"
+#include "sd_writer.h"
+#include "sd_dir_cache.h"
+#include "media_lib.h"
+#include "media_type.h"
+#include "wifi_svc.h"
+#include "telemetry.h"
+#include "task_plan.h"
+#include "flash_log.h"
+#include "crash_ctx.h"
+#include "sys_trace.h"
+#include "web_dash.h"
+#include "screen_mirror.h"
+
+static const char *TAG = "file_server";
+
+#define SERVER_CTRL_PORT        32769   // 默认的32768给直播的httpd了
+#define SERVER_RECV_RETRY       3       // 连着超时这么多次算断了
+#define SERVER_OUT_LEN          2048    // 列目录拼JSON的缓冲 满了发一段
+#define SERVER_TLM_ROWS         8       // 遥测一次从环形缓冲拷的行
+
+static httpd_handle_t s_server;
+static bool s_starting;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static file_server_stats_t s_stats;
+
+// 处理函数都在httpd自己的一个任务里一个接一个跑 这些大结构放静态区 不占它的栈
+static FF_DIR s_dir;
+static FILINFO s_fno;
+static FIL s_fil;
+static char s_path[FILE_SERVER_PATH_LEN];
+static char s_fpath[FILE_SERVER_PATH_LEN + 8];
+static char s_out[SERVER_OUT_LEN];
+static size_t s_out_used;
+static telemetry_row_t s_tlm_rows[SERVER_TLM_ROWS];
+
+static const char s_index_html[] =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\">"
+    "<meta name=\"viewport\" content=\"width=device-width\"><title>SD</title></head><body>"
+    "<h3 id=\"d\"></h3><input type=\"file\" id=\"f\" multiple> <button onclick=\"up()\">上传</button>"
+    "<div id=\"p\"></div><ul id=\"l\"></ul><script>"
+    "var dir='';"
+    "function ls(d){dir=d;document.getElementById('d').textContent='/sdcard'+(d||'/');"
+    "fetch('/api/list?dir='+encodeURIComponent(d)).then(r=>r.json()).then(a=>{"
+    "var l=document.getElementById('l');l.innerHTML='';"
+    "if(d)a.unshift({n:'..',t:5});"
+    "a.forEach(e=>{var i=document.createElement('li'),x=document.createElement('a');"
+    "x.textContent=e.n+(e.t==5?'/':'  ('+(e.s>>10)+' KB)');"
+    "if(e.t==5)x.href='javascript:void 0',x.onclick=()=>ls(e.n=='..'?d.replace(/\\/[^/]*$/,''):d+'/'+e.n);"
+    "else x.href='/sd'+d.split('/').map(encodeURIComponent).join('/')+'/'+encodeURIComponent(e.n);"
+    "i.appendChild(x);l.appendChild(i);});});}"
+    "async function up(){var fs=document.getElementById('f').files,p=document.getElementById('p');"
+    "for(var f of fs){var t=Date.now();p.textContent=f.name+' ...';"
+    "var r=await fetch('/sd'+dir.split('/').map(encodeURIComponent).join('/')+'/'+encodeURIComponent(f.name),"
+    "{method:'PUT',body:f});"
+    "p.textContent=f.name+(r.ok?' '+(f.size/1048.576/(Date.now()-t+1)).toFixed(2)+' MB/s':' 失败 '+r.status);}"
+    "ls(dir);}"
+    "ls('');</script></body></html>";
+
+static int hex_val(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// 浏览器把中文文件名编成%XX 解回UTF-8 len用完截断返回false
+static bool url_decode(const char *in, size_t in_len, char *out, size_t len)
+{
+    size_t o = 0;
+    for (size_t i = 0; i < in_len && in[i]; i++)
+    {
+        char c = in[i];
+        if (c == '%' && i + 2 < in_len && hex_val(in[i + 1]) >= 0 && hex_val(in[i + 2]) >= 0)
+        {
+            c = hex_val(in[i + 1]) << 4 | hex_val(in[i + 2]);
+            i += 2;
+        }
+        if (o + 1 >= len)
+        {
+            return false;
+        }
+        out[o++] = c;
+    }
+    out[o] = '\0';
+    return true;
+}
+
+// rel是卡上的相对路径 /开头或者空 拼成/sdcard下的VFS路径放进s_path
+// 不让..跳出去 也不认反斜杠 末尾的/去掉
+static bool make_path(const char *rel, size_t rel_len)
+{
+    size_t n = strlen(SD_MOUNT_POINT);
+    memcpy(s_path, SD_MOUNT_POINT, n);
+    if (!url_decode(rel, rel_len, s_path + n, sizeof(s_path) - n) || strchr(s_path, '\\') != NULL ||
+        (s_path[n] != '\0' && s_path[n] != '/'))
+    {
+        return false;
+    }
+    for (const char *p = s_path + n; (p = strstr(p, "..")) != NULL; p += 2)
+    {
+        if (p[-1] == '/' && (p[2] == '/' || p[2] == '\0'))
+        {
+            return false;
+        }
+    }
+    size_t len = strlen(s_path);
+    while (len > n && s_path[len - 1] == '/')
+    {
+        s_path[--len] = '\0';
+    }
+    return true;
+}
+
+// /sd/后面那段 到?为止
+static bool uri_path(httpd_req_t *req)
+{
+    const char *rel = req->uri + 3;
+    const char *q = strchr(rel, '?');
+    return make_path(rel, q ? (size_t)(q - rel) : strlen(rel));
+}
+
+static esp_err_t send_error(httpd_req_t *req, httpd_err_code_t code, const char *msg)
+{
+    httpd_resp_send_err(req, code, msg);
+    return ESP_OK;  // 错误已经回给客户端了 连接还能接着用
+}
+
+// 上传出错时请求体可能还剩很多没收 不让httpd把它读完 直接断开
+static esp_err_t upload_error(httpd_req_t *req, httpd_err_code_t code, const char *msg)
+{
+    httpd_resp_send_err(req, code, msg);
+    return ESP_FAIL;
+}
+
+static esp_err_t index_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html; charset=utf-8");
+    return httpd_resp_send(req, s_index_html, sizeof(s_index_html) - 1);
+}
+
+static esp_err_t out_flush(httpd_req_t *req)
+{
+    esp_err_t err = s_out_used ? httpd_resp_send_chunk(req, s_out, s_out_used) : ESP_OK;
+    s_out_used = 0;
+    return err;
+}
+
+static esp_err_t out_put(httpd_req_t *req, const char *s, size_t len)
+{
+    while (len > 0)
+    {
+        if (s_out_used == sizeof(s_out))
+        {
+            ESP_RETURN_ON_ERROR(out_flush(req), TAG, "send failed");
+        }
+        size_t n = sizeof(s_out) - s_out_used;
+        n = n < len ? n : len;
+        memcpy(s_out + s_out_used, s, n);
+        s_out_used += n;
+        s += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+// 一条目录记录转成JSON 名字里的引号 反斜杠 控制字符转义
+static esp_err_t out_rec(httpd_req_t *req, const char *rec, bool first)
+{
+    char buf[48];
+    ESP_RETURN_ON_ERROR(out_put(req, first ? "{\"n\":\"" : ",{\"n\":\"", first ? 6 : 7), TAG, "send failed");
+    for (const char *p = sd_dir_rec_name(rec); *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            buf[0] = '\\';
+            buf[1] = *p;
+            ESP_RETURN_ON_ERROR(out_put(req, buf, 2), TAG, "send failed");
+        }
+        else if ((uint8_t)*p < 0x20)
+        {
+            int n = snprintf(buf, sizeof(buf), "\\u%04x", (uint8_t)*p);
+            ESP_RETURN_ON_ERROR(out_put(req, buf, n), TAG, "send failed");
+        }
+        else
+        {
+            ESP_RETURN_ON_ERROR(out_put(req, p, 1), TAG, "send failed");
+        }
+    }
+    int n = snprintf(buf, sizeof(buf), "\",\"t\":%d,\"s\":%lu}", sd_dir_rec_type(rec),
+                     (unsigned long)sd_dir_rec_size(rec));
+    return out_put(req, buf, n);
+}
+
+// 缓存和媒体库都没有 自己读卡 拼成目录缓存的记录格式 读完放进缓存
+static bool dir_read(char **recs, size_t *len)
+{
+    uint32_t gen = sd_dir_cache_gen();
+    if (!bsp_sdcard_fatfs_path(s_path, s_fpath, sizeof(s_fpath)) || f_opendir(&s_dir, s_fpath) != FR_OK)
+    {
+        return false;
+    }
+    size_t cap = 0, used = 0;
+    char *buf = NULL;
+    bool ok = true;
+    while (f_readdir(&s_dir, &s_fno) == FR_OK && s_fno.fname[0] != '\0')
+    {
+        size_t need = SD_DIR_REC_HDR + strlen(s_fno.fname) + 1;
+        if (used + need > cap)
+        {
+            size_t ncap = cap ? cap * 2 : 4096;
+            ncap = ncap < used + need ? used + need : ncap;
+            char *nbuf = heap_caps_realloc(buf, ncap, MALLOC_CAP_SPIRAM);
+            if (nbuf == NULL)
+            {
+                ok = false;
+                break;
+            }
+            buf = nbuf;
+            cap = ncap;
+        }
+        uint32_t size = s_fno.fsize;
+        uint32_t mtime = (uint32_t)s_fno.fdate << 16 | s_fno.ftime;
+        char *r = buf + used;
+        r[0] = s_fno.fattrib & AM_DIR ? SD_DIR_TYPE_DIR : media_type_name(s_fno.fname);
+        for (int i = 0; i < 4; i++)
+        {
+            r[1 + i] = size >> (8 * i);
+            r[5 + i] = mtime >> (8 * i);
+        }
+        strcpy(r + SD_DIR_REC_HDR, s_fno.fname);
+        used += need;
+    }
+    f_closedir(&s_dir);
+    if (!ok)
+    {
+        free(buf);
+        return false;
+    }
+    sd_dir_cache_put(s_path, gen, buf ? buf : "", used);
+    *recs = buf;
+    *len = used;
+    return true;
+}
+
+static esp_err_t list_handler(httpd_req_t *req)
+{
+    char query[FILE_SERVER_PATH_LEN], dir[FILE_SERVER_PATH_LEN] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK)
+    {
+        httpd_query_key_value(query, "dir", dir, sizeof(dir));
+    }
+    if (!bsp_sdcard_mounted())
+    {
+        return send_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no SD card");
+    }
+    if (!make_path(dir, strlen(dir)))
+    {
+        return send_error(req, HTTPD_400_BAD_REQUEST, "bad path");
+    }
+    char *recs = NULL;
+    size_t len = 0;
+    bool cached = sd_dir_cache_get(s_path, &recs, &len) || media_lib_dir_recs(s_path, &recs, &len);
+    if (!cached && !dir_read(&recs, &len))
+    {
+        return send_error(req, HTTPD_404_NOT_FOUND, "no such directory");
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.lists++;
+    s_stats.list_cached += cached;
+    portEXIT_CRITICAL(&s_lock);
+
+    httpd_resp_set_type(req, "application/json");
+    s_out_used = 0;
+    esp_err_t err = out_put(req, "[", 1);
+    bool first = true;
+    for (size_t off = 0; err == ESP_OK && off + SD_DIR_REC_HDR < len; off += SD_DIR_REC_HDR + strlen(recs + off + SD_DIR_REC_HDR) + 1)
+    {
+        err = out_rec(req, recs + off, first);
+        first = false;
+    }
+    free(recs);
+    if (err == ESP_OK)
+    {
+        err = out_put(req, "]", 1);
+    }
+    if (err == ESP_OK)
+    {
+        err = out_flush(req);
+    }
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : err;
+}
+
+// 遥测从since以后的行 不带since给环形缓冲里所有的 每次请求续租约 客户端轮询就一直在采
+static esp_err_t telemetry_handler(httpd_req_t *req)
+{
+    char query[32], val[12];
+    uint32_t cursor = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", val, sizeof(val)) == ESP_OK)
+    {
+        cursor = strtoul(val, NULL, 10);
+    }
+    telemetry_lease(TELEMETRY_LEASE_MS);
+
+    char buf[48];
+    httpd_resp_set_type(req, "application/json");
+    s_out_used = 0;
+    int count = telemetry_count();
+    int n = snprintf(buf, sizeof(buf), "{\"period_ms\":%lu,\"names\":[", (unsigned long)telemetry_period_ms());
+    esp_err_t err = out_put(req, buf, n);
+    for (int i = 0; err == ESP_OK && i < count; i++)
+    {
+        n = snprintf(buf, sizeof(buf), "%s\"%s\"", i ? "," : "", telemetry_name(i));
+        err = out_put(req, buf, n);
+    }
+    if (err == ESP_OK)
+    {
+        err = out_put(req, "],\"kinds\":\"", 11);
+    }
+    for (int i = 0; err == ESP_OK && i < count; i++)
+    {
+        err = out_put(req, telemetry_kind(i) == TELEMETRY_COUNTER ? "c" : "g", 1);
+    }
+    if (err == ESP_OK)
+    {
+        err = out_put(req, "\",\"rows\":[", 10);
+    }
+    bool first = true;
+    int rows;
+    while (err == ESP_OK && (rows = telemetry_read(&cursor, s_tlm_rows, SERVER_TLM_ROWS)) > 0)
+    {
+        for (int r = 0; err == ESP_OK && r < rows; r++)
+        {
+            const telemetry_row_t *row = &s_tlm_rows[r];
+            n = snprintf(buf, sizeof(buf), "%s[%lu,%lu", first ? "" : ",", (unsigned long)row->seq,
+                         (unsigned long)row->t_ms);
+            err = out_put(req, buf, n);
+            first = false;
+            for (int i = 0; err == ESP_OK && i < row->count; i++)
+            {
+                n = snprintf(buf, sizeof(buf), ",%lu", (unsigned long)row->v[i]);
+                err = out_put(req, buf, n);
+            }
+            if (err == ESP_OK)
+            {
+                err = out_put(req, "]", 1);
+            }
+        }
+    }
+    if (err == ESP_OK)
+    {
+        n = snprintf(buf, sizeof(buf), "],\"next\":%lu}", (unsigned long)cursor);
+        err = out_put(req, buf, n);
+    }
+    if (err == ESP_OK)
+    {
+        err = out_flush(req);
+    }
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : err;
+}
+
+static const char *content_type(const char *path)
+{
+    static const struct {
+        const char *ext;
+        const char *type;
+    } types[] = {
+        {".jpg", "image/jpeg"}, {".jpeg", "image/jpeg"}, {".png", "image/png"}, {".gif", "image/gif"},
+        {".bmp", "image/bmp"},  {".mp3", "audio/mpeg"},  {".wav", "audio/wav"}, {".avi", "video/x-msvideo"},
+        {".txt", "text/plain"},
+    };
+    const char *dot = strrchr(path, '.');
+    for (int i = 0; dot && i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        if (strcasecmp(dot, types[i].ext) == 0)
+        {
+            return types[i].type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+#if CONFIG_APP_FLASH_LOG
+// 整个applog分区原样发出去 用tools/flash_log/flash_log_decode.py和这次构建的ELF解 还在RAM环里的要等下一批
+static esp_err_t log_handler(httpd_req_t *req)
+{
+    size_t size = flash_log_size();
+    if (size == 0)
+    {
+        return send_error(req, HTTPD_404_NOT_FOUND, "no log partition");
+    }
+    flash_log_flush();
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"applog.bin\"");
+    esp_err_t err = ESP_OK;
+    for (size_t off = 0; err == ESP_OK && off < size; off += SERVER_OUT_LEN)
+    {
+        err = flash_log_read(off, s_out, SERVER_OUT_LEN);
+        err = err == ESP_OK ? httpd_resp_send_chunk(req, s_out, SERVER_OUT_LEN) : err;
+    }
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : err;
+}
+#endif
+
+#if CONFIG_APP_CRASH_CTX
+// 上次死机的转储原样发出去 espcoredump.py -t raw看栈 tools/crash_ctx/crash_ctx_decode.py看死前的遥测 DELETE清掉
+static esp_err_t coredump_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_DELETE)
+    {
+        esp_err_t err = crash_ctx_dump_erase();
+        return err == ESP_OK ? httpd_resp_sendstr(req, "erased\n")
+                             : send_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+    }
+    size_t size = crash_ctx_dump_size();
+    if (size == 0)
+    {
+        return send_error(req, HTTPD_404_NOT_FOUND, "no core dump");
+    }
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"coredump.bin\"");
+    esp_err_t err = ESP_OK;
+    for (size_t off = 0; err == ESP_OK && off < size; off += SERVER_OUT_LEN)
+    {
+        size_t len = size - off < SERVER_OUT_LEN ? size - off : SERVER_OUT_LEN;
+        err = crash_ctx_dump_read(off, s_out, len);
+        err = err == ESP_OK ? httpd_resp_send_chunk(req, s_out, len) : err;
+    }
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : err;
+}
+#endif
+
+#if CONFIG_APP_SYS_TRACE
+static esp_err_t trace_out(const void *data, size_t len, void *arg)
+{
+    return httpd_resp_send_chunk(arg, data, len);
+}
+
+// ?start开始记 不带参数停下 把Perfetto能开的JSON发回去 ?save停下存到卡上 回文件名
+static esp_err_t trace_handler(httpd_req_t *req)
+{
+    char query[16] = "";
+    httpd_req_get_url_query_str(req, query, sizeof(query));
+    esp_err_t err;
+    if (strcmp(query, "start") == 0)
+    {
+        err = sys_trace_start();
+        return err == ESP_OK ? httpd_resp_sendstr(req, "tracing\n")
+                             : send_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+    }
+    if (strcmp(query, "save") == 0)
+    {
+        err = sys_trace_save(s_path, sizeof(s_path));
+        return err == ESP_OK ? httpd_resp_sendstr(req, s_path)
+                             : send_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, esp_err_to_name(err));
+    }
+    sys_trace_stop();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.json\"");
+    err = sys_trace_export(trace_out, req);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        return send_error(req, HTTPD_404_NOT_FOUND, "no trace, start with ?start");
+    }
+    return err == ESP_OK ? httpd_resp_send_chunk(req, NULL, 0) : err;
+}
+#endif
+
+static esp_err_t download_handler(httpd_req_t *req)
+{
+    if (!uri_path(req))
+    {
+        return send_error(req, HTTPD_400_BAD_REQUEST, "bad path");
+    }
+    if (!bsp_sdcard_fatfs_path(s_path, s_fpath, sizeof(s_fpath)) || f_open(&s_fil, s_fpath, FA_READ) != FR_OK)
+    {
+        return send_error(req, HTTPD_404_NOT_FOUND, "no such file");
+    }
+    // 整扇区读进内部RAM FATFS直接DMA过去 不经过它自己的扇区缓冲
+    uint8_t *buf = heap_caps_malloc(FILE_SERVER_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    if (buf == NULL)
+    {
+        buf = heap_caps_malloc(FILE_SERVER_CHUNK, MALLOC_CAP_DEFAULT);
+    }
+    if (buf == NULL)
+    {
+        f_close(&s_fil);
+        return send_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+    }
+    httpd_resp_set_type(req, content_type(s_path));
+    int64_t t0 = esp_timer_get_time();
+    uint64_t bytes = 0;
+    esp_err_t err = ESP_OK;
+    UINT br = 0;
+    do
+    {
+        if (f_read(&s_fil, buf, FILE_SERVER_CHUNK, &br) != FR_OK)
+        {
+            err = ESP_FAIL;
+            break;
+        }
+        err = br ? httpd_resp_send_chunk(req, (const char *)buf, br) : ESP_OK;
+        bytes += br;
+    } while (err == ESP_OK && br == FILE_SERVER_CHUNK);
+    f_close(&s_fil);
+    heap_caps_free(buf);
+    if (err == ESP_OK)
+    {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.downloads += err == ESP_OK;
+    s_stats.download_bytes += bytes;
+    s_stats.download_us += us;
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+// 上一级目录没有就一级一级建 新建的目录报告给目录缓存
+static void make_parents(void)
+{
+    size_t n = strlen(SD_MOUNT_POINT);
+    for (char *p = strchr(s_path + n + 1, '/'); p != NULL; p = strchr(p + 1, '/'))
+    {
+        *p = '\0';
+        if (bsp_sdcard_fatfs_path(s_path, s_fpath, sizeof(s_fpath)) && f_mkdir(s_fpath) == FR_OK)
+        {
+            sd_dir_cache_changed(s_path);
+        }
+        *p = '/';
+    }
+}
+
+static esp_err_t upload_handler(httpd_req_t *req)
+{
+    if (!uri_path(req) || strlen(s_path) <= strlen(SD_MOUNT_POINT))
+    {
+        return upload_error(req, HTTPD_400_BAD_REQUEST, "bad path");
+    }
+    if (!bsp_sdcard_mounted())
+    {
+        return upload_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no SD card");
+    }
+    make_parents();
+    size_t remain = req->content_len;
+    sd_writer_t *w = sd_writer_open(s_path, remain);
+    if (w == NULL)
+    {
+        return upload_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, "open failed");
+    }
+    int64_t t0 = esp_timer_get_time();
+    uint64_t recv_us = 0;
+    uint32_t timeouts = 0;
+    int retry = 0;
+    bool ok = true;
+    while (remain > 0)
+    {
+        // 直接收进写卡的块缓冲 收多少提交多少 块满了sd_writer自己交给写盘任务
+        size_t room = 0;
+        uint8_t *dst = sd_writer_reserve(w, &room);
+        if (dst == NULL)
+        {
+            ok = false;
+            break;
+        }
+        int64_t r0 = esp_timer_get_time();
+        int r = httpd_req_recv(req, (char *)dst, room < remain ? room : remain);
+        recv_us += esp_timer_get_time() - r0;
+        if (r == HTTPD_SOCK_ERR_TIMEOUT && ++retry <= SERVER_RECV_RETRY)
+        {
+            timeouts++;
+            continue;
+        }
+        if (r <= 0 || sd_writer_commit(w, r) != ESP_OK)
+        {
+            ok = false;
+            break;
+        }
+        retry = 0;
+        remain -= r;
+    }
+    uint32_t size = sd_writer_size(w);
+    if (ok)
+    {
+        ok = sd_writer_close(w) == ESP_OK;
+    }
+    else
+    {
+        sd_writer_abort(w);
+    }
+    uint32_t us = esp_timer_get_time() - t0;
+    uint32_t kbps = us ? (uint64_t)size * 1000000 / 1024 / us : 0;
+    portENTER_CRITICAL(&s_lock);
+    if (ok)
+    {
+        s_stats.uploads++;
+        s_stats.last_upload_kbps = kbps;
+    }
+    else
+    {
+        s_stats.upload_failed++;
+    }
+    s_stats.upload_bytes += size;
+    s_stats.upload_us += us;
+    s_stats.recv_us += recv_us;
+    s_stats.recv_timeouts += timeouts;
+    portEXIT_CRITICAL(&s_lock);
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "%s: upload failed after %lu bytes", s_path, (unsigned long)size);
+        return upload_error(req, HTTPD_500_INTERNAL_SERVER_ERROR, "upload failed");
+    }
+    ESP_LOGI(TAG, "%s: %lu KB in %lu ms, %lu KB/s", s_path, (unsigned long)size / 1024, (unsigned long)us / 1000,
+             (unsigned long)kbps);
+    httpd_resp_set_status(req, "201 Created");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static void server_open(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool busy = s_starting || s_server != NULL;
+    s_starting = true;
+    portEXIT_CRITICAL(&s_lock);
+    if (busy)
+    {
+        return;
+    }
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_APP_FILE_SERVER_PORT;
+    config.ctrl_port = SERVER_CTRL_PORT;
+    config.core_id = task_plan_get(TASK_HTTPD)->core;
+    config.task_priority = task_plan_get(TASK_HTTPD)->prio;
+    config.stack_size = task_plan_get(TASK_HTTPD)->stack;
+    config.lru_purge_enable = true;
+    config.max_uri_handlers = 14;
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    httpd_handle_t server = NULL;
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "httpd start failed: %s", esp_err_to_name(err));
+        portENTER_CRITICAL(&s_lock);
+        s_starting = false;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    static const httpd_uri_t uris[] = {
+        {.uri = "/", .method = HTTP_GET, .handler = index_handler},
+        {.uri = "/api/list", .method = HTTP_GET, .handler = list_handler},
+        {.uri = "/api/telemetry", .method = HTTP_GET, .handler = telemetry_handler},
+#if CONFIG_APP_FLASH_LOG
+        {.uri = "/api/log", .method = HTTP_GET, .handler = log_handler},
+#endif
+#if CONFIG_APP_CRASH_CTX
+        {.uri = "/api/coredump", .method = HTTP_GET, .handler = coredump_handler},
+        {.uri = "/api/coredump", .method = HTTP_DELETE, .handler = coredump_handler},
+#endif
+#if CONFIG_APP_SYS_TRACE
+        {.uri = "/api/trace", .method = HTTP_GET, .handler = trace_handler},
+#endif
+        {.uri = "/sd/*", .method = HTTP_GET, .handler = download_handler},
+        {.uri = "/sd/*", .method = HTTP_PUT, .handler = upload_handler},
+    };
+    for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        httpd_register_uri_handler(server, &uris[i]);
+    }
+#if CONFIG_APP_WEB_DASH
+    web_dash_register(server);
+#endif
+#if CONFIG_APP_SCREEN_MIRROR
+    screen_mirror_register(server);
+#endif
+    portENTER_CRITICAL(&s_lock);
+    s_server = server;
+    s_starting = false;
+    s_stats.running = true;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "file server on port %d", CONFIG_APP_FILE_SERVER_PORT);
+}
+
+// 在WiFi服务任务里 只管第一次连上 以后掉线重连httpd不用动
+static void wifi_listener(const wifi_svc_event_t *ev)
+{
+    if (ev->type == WIFI_SVC_EV_STATE && ev->state == WIFI_SVC_CONNECTED)
+    {
+        server_open();
+    }
+}
+
+esp_err_t file_server_start(void)
+{
+    ESP_RETURN_ON_ERROR(wifi_svc_subscribe(wifi_listener), TAG, "subscribe failed");
+    if (wifi_svc_connected())
+    {
+        server_open();
+    }
+    return ESP_OK;
+}
+
+bool file_server_url(char *url, size_t len)
+{
+    char ip[16];
+    if (s_server == NULL || !wifi_svc_get_ip(ip, sizeof(ip)))
+    {
+        return false;
+    }
+    snprintf(url, len, "http://%s:%d/", ip, CONFIG_APP_FILE_SERVER_PORT);
+    return true;
+}
+
+void file_server_get_stats(file_server_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
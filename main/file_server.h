@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 局域网文件传输 ****************************/
+// 浏览器打开 http://<ip>:CONFIG_APP_FILE_SERVER_PORT/ 往SD卡上传音乐和照片 也能列目录和下载
+// 上传是PUT /sd/<路径> 请求体就是文件内容 不用multipart 不用解析边界
+// GET /api/log 下载flash里的二进制日志分区(见flash_log.h)
+// GET /api/coredump 下载上次死机的核心转储 DELETE清掉(见crash_ctx.h)
+// socket直接收进SD卡大块写的缓冲 lwip的pbuf到DMA缓冲只拷这一次 中间没有别的缓冲 写满一块交给写盘任务 接着收下一块
+// Content-Length拿来预分配 簇是连续的 写卡不用来回找空簇
+// 列目录先用目录缓存 再用媒体库 都没有才读卡 读完放进目录缓存
+// 上传完由sd_writer报告目录变了 目录缓存和媒体库自己作废 下次进音乐和相册就能看到
+// WiFi连上就起 掉线重连不用管 httpd监听的是所有地址
+
+#define FILE_SERVER_CHUNK       (16 * 1024) // 下载时一次从卡上读的
+#define FILE_SERVER_PATH_LEN    256
+
+typedef struct {
+    bool running;
+    uint32_t uploads;                   // 完整收完写完的
+    uint32_t upload_failed;             // 断开 超时 写卡出错
+    uint64_t upload_bytes;
+    uint64_t upload_us;                 // 上传从第一个字节到关文件
+    uint64_t recv_us;                   // 其中花在等socket上的
+    uint32_t recv_timeouts;             // 收的时候超时又接着等的
+    uint32_t last_upload_kbps;          // 最近一个上传的速度
+    uint32_t downloads;
+    uint64_t download_bytes;
+    uint64_t download_us;
+    uint32_t lists;
+    uint32_t list_cached;               // 从目录缓存或者媒体库拿的 没有读卡
+} file_server_stats_t;
+
+esp_err_t file_server_start(void);      // 等WiFi连上再起服务 已经连着就马上起 可以多次调用
+bool file_server_url(char *url, size_t len);   // 浏览器要打开的地址 没起来返回false
+void file_server_get_stats(file_server_stats_t *stats);
@@ -0,0 +1,315 @@
+#include <string.h>
+#include <time.h>
+#include "flash_log.h"
+
+#if CONFIG_APP_FLASH_LOG
+#include "task_plan.h"
+#include "esp_partition.h"
+#include "esp_app_desc.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "flash_log";
+
+#define RING_MASK           (FLASH_LOG_RING_WORDS - 1)
+#define RING_MAGIC          0x474E4952  // "RING"
+#define REC_WORDS           3           // 记录头 格式串 时刻
+#define SECTOR              4096
+#define STAGE_BYTES         1024        // 攒够这么多写一次flash
+
+_Static_assert((FLASH_LOG_RING_WORDS & RING_MASK) == 0, "APP_FLASH_LOG_RING_KB must be a power of two");
+
+// 复位不清零 开机时magic对得上 游标也合理才认
+typedef struct {
+    uint32_t magic;
+    uint32_t head;                      // 生产者占到的位置 一直往上加 取下标时与掩码
+    uint32_t tail;                      // 后台取到的位置
+    uint32_t words[FLASH_LOG_RING_WORDS];
+} flash_log_ring_t;
+
+static __NOINIT_ATTR flash_log_ring_t s_ring;
+static bool s_ready;
+static uint32_t s_dropped;              // 生产者原子加 后台读
+static uint32_t s_lost_reported;
+static const esp_partition_t *s_part;
+static uint32_t s_nsect;
+static uint32_t s_sector;               // 正在写的扇区
+static uint32_t s_off;                  // 这个扇区已经写进flash的字节
+static uint32_t s_seq;
+static char s_sha[17];
+static uint8_t s_stage[STAGE_BYTES];    // 内部RAM 写flash时cache关着也能读
+static uint32_t s_staged;
+static TaskHandle_t s_task;
+static flash_log_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void IRAM_ATTR flash_log_write(const char *fmt, const uint32_t *args, uint32_t n)
+{
+    if (!s_ready)
+    {
+        return;
+    }
+    n = n > FLASH_LOG_MAX_ARGS ? FLASH_LOG_MAX_ARGS : n;
+    uint32_t need = REC_WORDS + n;
+    uint32_t head = __atomic_load_n(&s_ring.head, __ATOMIC_RELAXED);
+    do
+    {
+        if (head + need - __atomic_load_n(&s_ring.tail, __ATOMIC_ACQUIRE) > FLASH_LOG_RING_WORDS)
+        {
+            __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&s_ring.head, &head, head + need, true, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_RELAXED));
+    s_ring.words[(head + 1) & RING_MASK] = (uint32_t)fmt;
+    s_ring.words[(head + 2) & RING_MASK] = (uint32_t)esp_timer_get_time();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        s_ring.words[(head + REC_WORDS + i) & RING_MASK] = args[i];
+    }
+    // 记录头最后写 后台看到它才取这一条
+    __atomic_store_n(&s_ring.words[head & RING_MASK],
+                     (uint32_t)FLASH_LOG_TAG << 24 | (uint32_t)esp_cpu_get_core_id() << 8 | n, __ATOMIC_RELEASE);
+}
+
+static void count_error(esp_err_t err)
+{
+    if (err != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.errors++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+// 擦下一个扇区 写扇区头 最旧的日志就这样没了
+static esp_err_t sector_open(void)
+{
+    s_sector = (s_sector + 1) % s_nsect;
+    s_off = 0;
+    ESP_RETURN_ON_ERROR(esp_partition_erase_range(s_part, s_sector * SECTOR, SECTOR), TAG, "erase failed");
+    flash_log_sector_t h = {
+        .magic = FLASH_LOG_MAGIC,
+        .seq = ++s_seq,
+        .boot = s_stats.boot,
+    };
+    memcpy(h.elf_sha, s_sha, sizeof(h.elf_sha));
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_part, s_sector * SECTOR, &h, sizeof(h)), TAG, "write failed");
+    s_off = sizeof(h);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.erases++;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+static esp_err_t stage_flush(void)
+{
+    if (s_staged == 0)
+    {
+        return ESP_OK;
+    }
+    esp_err_t err = esp_partition_write(s_part, s_sector * SECTOR + s_off, s_stage, s_staged);
+    s_off += s_staged;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += s_staged;
+    portEXIT_CRITICAL(&s_lock);
+    s_staged = 0;
+    return err;
+}
+
+// 一条记录不跨扇区 放不下就先把暂存的写了 开下一个扇区
+static void stage_put(const uint32_t *rec, uint32_t words)
+{
+    uint32_t bytes = words * 4;
+    if (s_off + s_staged + bytes > SECTOR)
+    {
+        count_error(stage_flush());
+        count_error(sector_open());
+    }
+    if (s_staged + bytes > STAGE_BYTES)
+    {
+        count_error(stage_flush());
+    }
+    memcpy(s_stage + s_staged, rec, bytes);
+    s_staged += bytes;
+}
+
+static void put_special(uint32_t id, uint32_t n, uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t rec[REC_WORDS + 3] = {
+        (uint32_t)FLASH_LOG_TAG << 24 | (uint32_t)esp_cpu_get_core_id() << 8 | n,
+        id, (uint32_t)esp_timer_get_time(), a, b, c,
+    };
+    stage_put(rec, REC_WORDS + n);
+}
+
+static void put_time(void)
+{
+    int64_t now = esp_timer_get_time();
+    put_special(FLASH_LOG_ID_TIME, 3, (uint32_t)now, (uint32_t)(now >> 32), (uint32_t)time(NULL));
+}
+
+// 从tail往后取已经提交的记录放进暂存 碰到还没写完的就停 取过的清零
+// recover时是上次开机留下的 写了一半的那条和后面的都不要了
+static uint32_t ring_drain(bool recover)
+{
+    uint32_t tail = s_ring.tail;
+    uint32_t head = __atomic_load_n(&s_ring.head, __ATOMIC_ACQUIRE);
+    uint32_t rec[REC_WORDS + FLASH_LOG_MAX_ARGS];
+    uint32_t count = 0;
+    while (tail != head)
+    {
+        uint32_t hdr = __atomic_load_n(&s_ring.words[tail & RING_MASK], __ATOMIC_ACQUIRE);
+        uint32_t n = hdr & 0xff;
+        if (hdr >> 24 != FLASH_LOG_TAG || n > FLASH_LOG_MAX_ARGS || head - tail < REC_WORDS + n)
+        {
+            tail = recover ? head : tail;
+            break;
+        }
+        for (uint32_t i = 0; i < REC_WORDS + n; i++)
+        {
+            rec[i] = s_ring.words[(tail + i) & RING_MASK];
+            s_ring.words[(tail + i) & RING_MASK] = 0;
+        }
+        stage_put(rec, REC_WORDS + n);
+        tail += REC_WORDS + n;
+        count++;
+    }
+    __atomic_store_n(&s_ring.tail, tail, __ATOMIC_RELEASE);
+    return count;
+}
+
+static void flush_batch(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint32_t fill = __atomic_load_n(&s_ring.head, __ATOMIC_ACQUIRE) - s_ring.tail;
+    uint32_t dropped = __atomic_load_n(&s_dropped, __ATOMIC_RELAXED);
+    put_time();
+    if (dropped != s_lost_reported)
+    {
+        put_special(FLASH_LOG_ID_LOST, 1, dropped - s_lost_reported, 0, 0);
+        s_lost_reported = dropped;
+    }
+    uint32_t n = ring_drain(false);
+    count_error(stage_flush());
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.records += n;
+    s_stats.flushes++;
+    s_stats.ring_peak = fill > s_stats.ring_peak ? fill : s_stats.ring_peak;
+    s_stats.max_flush_us = us > s_stats.max_flush_us ? us : s_stats.max_flush_us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 写flash时cache关着 两个核都会停一下 所以攒一批再写 环快满了才提前
+static void flash_log_task(void *arg)
+{
+    int64_t last = esp_timer_get_time();
+    for (;;)
+    {
+        bool asked = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FLASH_LOG_POLL_MS)) > 0;
+        uint32_t fill = __atomic_load_n(&s_ring.head, __ATOMIC_ACQUIRE) - s_ring.tail;
+        int64_t now = esp_timer_get_time();
+        if (fill && (asked || fill >= FLASH_LOG_RING_WORDS / 4 || now - last >= FLASH_LOG_FLUSH_MS * 1000LL))
+        {
+            flush_batch();
+            last = now;
+        }
+    }
+}
+
+// 找seq最大的扇区 接着它往后写 开机序号也从它接着数
+static void partition_scan(void)
+{
+    bool found = false;
+    uint32_t boot = 0;
+    s_sector = s_nsect - 1;
+    for (uint32_t i = 0; i < s_nsect; i++)
+    {
+        flash_log_sector_t h;
+        if (esp_partition_read(s_part, i * SECTOR, &h, sizeof(h)) == ESP_OK && h.magic == FLASH_LOG_MAGIC &&
+            (!found || (int32_t)(h.seq - s_seq) > 0))
+        {
+            found = true;
+            s_seq = h.seq;
+            s_sector = i;
+            boot = h.boot;
+        }
+    }
+    s_stats.boot = boot + 1;
+}
+
+esp_err_t flash_log_init(void)
+{
+    if (s_ready)
+    {
+        return ESP_OK;
+    }
+    int64_t t0 = esp_timer_get_time();
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASH_LOG_PARTITION);
+    ESP_RETURN_ON_FALSE(s_part, ESP_ERR_NOT_FOUND, TAG, "no %s partition", FLASH_LOG_PARTITION);
+    s_nsect = s_part->size / SECTOR;
+    ESP_RETURN_ON_FALSE(s_nsect >= 2, ESP_ERR_INVALID_SIZE, TAG, "partition too small");
+    esp_app_get_elf_sha256(s_sha, sizeof(s_sha));
+    partition_scan();
+
+    // 只有这几种复位RAM还在 上电和掉电的环是随机数
+    esp_reset_reason_t why = esp_reset_reason();
+    bool keep = s_ring.magic == RING_MAGIC && s_ring.head - s_ring.tail <= FLASH_LOG_RING_WORDS &&
+                (why == ESP_RST_PANIC || why == ESP_RST_INT_WDT || why == ESP_RST_TASK_WDT || why == ESP_RST_WDT ||
+                 why == ESP_RST_SW);
+    ESP_RETURN_ON_ERROR(sector_open(), TAG, "unable to open a log sector");
+    if (keep)
+    {
+        s_stats.recovered = ring_drain(true);
+    }
+    put_special(FLASH_LOG_ID_BOOT, 2, s_stats.boot, why, 0);
+    put_time();
+    count_error(stage_flush());
+    memset(&s_ring, 0, sizeof(s_ring));
+    s_ring.magic = RING_MAGIC;
+    s_ready = true;
+    s_stats.ready = true;
+    ESP_LOGI(TAG, "boot %lu, %lu records recovered, sector %lu of %lu, %lld us", (unsigned long)s_stats.boot,
+             (unsigned long)s_stats.recovered, (unsigned long)s_sector, (unsigned long)s_nsect,
+             esp_timer_get_time() - t0);
+    if (task_plan_create(TASK_FLASH_LOG, flash_log_task, NULL, &s_task) != pdPASS)
+    {
+        ESP_LOGW(TAG, "no flush task, records stay in RAM");
+    }
+    return ESP_OK;
+}
+
+void flash_log_flush(void)
+{
+    if (s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+size_t flash_log_size(void)
+{
+    return s_part ? s_part->size : 0;
+}
+
+esp_err_t flash_log_read(size_t off, void *buf, size_t len)
+{
+    ESP_RETURN_ON_FALSE(s_part, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    return esp_partition_read(s_part, off, buf, len);
+}
+
+void flash_log_get_stats(flash_log_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    stats->dropped = __atomic_load_n(&s_dropped, __ATOMIC_RELAXED);
+}
+#endif
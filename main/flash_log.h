@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** flash里的二进制日志 ****************************/
+// 出厂的机器不接串口 ESP_LOGI全都白打 热路径上的printf还实打实地花时间
+// FLOG只记格式串的地址和最多FLASH_LOG_MAX_ARGS个32位参数 不格式化 格式串留在程序的rodata里
+// 写进内部RAM里的环: 比较交换占一段位置 填参数 最后写记录头算提交 不加锁 几十个指令 中断里也能用
+// 后台任务攒一批整块追加到applog分区 分区写满了从最旧的扇区擦掉重来
+// 环放在复位不清零的RAM里 死机 看门狗 esp_restart以后下次开机先把环里没写进flash的补上 崩溃前最后几条不丢
+// 主机端用同一次构建的ELF把地址换回格式串再格式化 见tools/flash_log/flash_log_decode.py
+// 只能记整数 %s只认程序里的字符串常量(解码时按地址从ELF里取) 浮点和64位参数不支持
+//
+// 分区格式 全部小端 每个扇区单独成段:
+//   扇区头 flash_log_sector_t 之后记录一条接一条 全是0xFF的字是扇区里的空白
+//   记录: 字0 记录头 高8位FLASH_LOG_TAG 位8是记录时的核 低8位参数个数
+//         字1 格式串地址 或者下面几个特殊编号
+//         字2 esp_timer的低32位(微秒) 靠TIME记录展开
+//         之后是参数
+//   FLASH_LOG_ID_BOOT: 开机 参数是开机序号和esp_reset_reason 之前的记录属于上一次开机
+//   FLASH_LOG_ID_TIME: 每批写flash前一条 参数是esp_timer的低32位 高32位和time()
+//   FLASH_LOG_ID_LOST: 环满了丢的条数 自上一条LOST以来
+
+#define FLASH_LOG_PARTITION     "applog"
+#define FLASH_LOG_MAGIC         0x31474C46      // "FLG1"
+#define FLASH_LOG_TAG           0xB1
+#define FLASH_LOG_MAX_ARGS      6
+#define FLASH_LOG_RING_WORDS    (CONFIG_APP_FLASH_LOG_RING_KB * 256)
+#define FLASH_LOG_FLUSH_MS      (CONFIG_APP_FLASH_LOG_FLUSH_S * 1000)
+#define FLASH_LOG_POLL_MS       500     // 后台多久看一次环 超过四分之一满就不等FLASH_LOG_FLUSH_MS
+
+#define FLASH_LOG_ID_BOOT       1
+#define FLASH_LOG_ID_TIME       2
+#define FLASH_LOG_ID_LOST       3
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;                       // 每开一个扇区加一 最大的是最新的
+    uint32_t boot;                      // 开这个扇区时的开机序号
+    uint32_t reserved;
+    char elf_sha[16];                   // 写这个扇区的程序 ELF的SHA256前16个十六进制字符
+} flash_log_sector_t;
+
+typedef struct {
+    bool ready;
+    uint32_t boot;
+    uint32_t records;                   // 写进flash的 不算特殊记录
+    uint32_t recovered;                 // 开机从上次的环里补的
+    uint32_t dropped;                   // 环满了丢的
+    uint32_t ring_peak;                 // 环里最多积压的字数
+    uint32_t flushes;
+    uint32_t erases;
+    uint64_t bytes;
+    uint32_t max_flush_us;              // 最慢的一批 包括擦扇区
+    uint32_t errors;
+} flash_log_stats_t;
+
+#if CONFIG_APP_FLASH_LOG
+// 参数都转成uint32_t 指针要自己转 多了的编不过 printf检查格式串但不会执行
+#define FLOG(fmt, ...) do {                                                             \
+        const uint32_t _flog_args[] = {0, ##__VA_ARGS__};                               \
+        _Static_assert(sizeof(_flog_args) / 4 <= FLASH_LOG_MAX_ARGS + 1, "FLOG: too many args"); \
+        if (0) printf(fmt, ##__VA_ARGS__);                                              \
+        flash_log_write(fmt, _flog_args + 1, sizeof(_flog_args) / 4 - 1);               \
+    } while (0)
+#else
+#define FLOG(fmt, ...) do { if (0) printf(fmt, ##__VA_ARGS__); } while (0)
+#endif
+
+esp_err_t flash_log_init(void);         // 开机尽早调 先补上次的环 再写开机记录 之后才能FLOG
+void flash_log_write(const char *fmt, const uint32_t *args, uint32_t n);
+void flash_log_flush(void);             // 叫后台马上写一批 不等
+size_t flash_log_size(void);            // 分区大小 没有分区是0
+esp_err_t flash_log_read(size_t off, void *buf, size_t len);   // 原样读分区 给下载用
+void flash_log_get_stats(flash_log_stats_t *stats);
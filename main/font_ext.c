@@ -0,0 +1,358 @@
+#include <string.h>
+#include "font_ext.h"
+#include "esp_partition.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "font_ext";
+
+LV_FONT_DECLARE(font_alipuhui20);
+
+#define EXT_NONE        0xffff
+#define EXT_BUCKETS     (FONT_EXT_CACHE_GLYPHS * 2)
+#define EXT_MAX_PX      (31 * 31)
+
+#define REC_CP(r)       ((uint32_t)(r) & 0x3ffff)
+#define REC_ADV(r)      ((uint32_t)((r) >> 18) & 0x3ff)
+#define REC_W(r)        ((uint32_t)((r) >> 28) & 0x1f)
+#define REC_H(r)        ((uint32_t)((r) >> 33) & 0x1f)
+#define REC_SIZE(r)     ((uint32_t)((r) >> 50))
+
+typedef struct {
+    uint32_t cp;
+    uint16_t prev;                      // LRU链表 头是最近用过的
+    uint16_t next;
+    uint16_t hnext;                     // 同一个桶里的下一个
+} ext_slot_t;
+
+static struct {
+    const uint8_t *map;
+    esp_partition_mmap_handle_t map_handle;
+    const font_ext_hdr_t *hdr;
+    const uint8_t *index;
+    const uint32_t *blocks;
+    const uint8_t *bitmaps;
+    uint8_t *cache;                     // PSRAM 每个字形一个FONT_EXT_SLOT_BYTES的格子
+    ext_slot_t slots[FONT_EXT_CACHE_GLYPHS];
+    uint16_t buckets[EXT_BUCKETS];
+    uint16_t head;
+    uint16_t tail;
+    uint16_t used;
+    uint32_t last_cp;                   // 画一个字先问描述再要字形 第二次不用再二分
+    int32_t last_pos;
+} s_ext;
+
+static font_ext_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint64_t ext_rec(int32_t pos)
+{
+    uint64_t r;
+    memcpy(&r, s_ext.index + pos * sizeof(r), sizeof(r));
+    return r;
+}
+
+static inline int ext_signed6(uint32_t v)
+{
+    return (int)(v & 0x3f) - ((v & 0x20) ? 64 : 0);
+}
+
+// 在映射的索引上二分 找不到返回-1
+static int32_t ext_find(uint32_t cp)
+{
+    if (cp == s_ext.last_cp)
+    {
+        return s_ext.last_pos;
+    }
+    int32_t lo = 0, hi = (int32_t)s_ext.hdr->count - 1, pos = -1;
+    while (lo <= hi)
+    {
+        int32_t mid = (lo + hi) / 2;
+        uint32_t c = REC_CP(ext_rec(mid));
+        if (c == cp)
+        {
+            pos = mid;
+            break;
+        }
+        if (c < cp)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    s_ext.last_cp = cp;
+    s_ext.last_pos = pos;
+    return pos;
+}
+
+// 这一组的起始位置加上组里前面几个的字节数
+static const uint8_t *ext_glyph_data(int32_t pos)
+{
+    uint32_t ofs = s_ext.blocks[pos / FONT_EXT_BLOCK];
+    for (int32_t i = pos - pos % FONT_EXT_BLOCK; i < pos; i++)
+    {
+        ofs += REC_SIZE(ext_rec(i));
+    }
+    return s_ext.bitmaps + ofs;
+}
+
+// 零的游程展开成每像素一个半字节 和上一行异或回来 再按LVGL的4bpp两个像素一个字节排好
+// 数据不够(分区坏了)剩下的当0 不会读出这个字形
+static void ext_decode(const uint8_t *in, uint32_t size, uint8_t *out, uint32_t w, uint32_t h)
+{
+    static uint8_t px[EXT_MAX_PX];
+    uint32_t total = w * h, n = 0, i = 0, nibbles = size * 2;
+    while (n < total && i < nibbles)
+    {
+        uint8_t v = (in[i / 2] >> ((i & 1) ? 0 : 4)) & 0x0f;
+        i++;
+        if (v)
+        {
+            px[n++] = v;
+            continue;
+        }
+        uint32_t run = 1;
+        if (i < nibbles)
+        {
+            run += (in[i / 2] >> ((i & 1) ? 0 : 4)) & 0x0f;
+            i++;
+        }
+        run = run > total - n ? total - n : run;
+        memset(px + n, 0, run);
+        n += run;
+    }
+    memset(px + n, 0, total - n);
+    for (uint32_t k = w; k < total; k++)
+    {
+        px[k] ^= px[k - w];
+    }
+    for (uint32_t k = 0; k < total; k += 2)
+    {
+        out[k / 2] = (px[k] << 4) | (k + 1 < total ? px[k + 1] : 0);
+    }
+}
+
+/************ LRU ************/
+static void lru_unlink(uint16_t s)
+{
+    ext_slot_t *e = &s_ext.slots[s];
+    if (e->prev != EXT_NONE)
+    {
+        s_ext.slots[e->prev].next = e->next;
+    }
+    else
+    {
+        s_ext.head = e->next;
+    }
+    if (e->next != EXT_NONE)
+    {
+        s_ext.slots[e->next].prev = e->prev;
+    }
+    else
+    {
+        s_ext.tail = e->prev;
+    }
+}
+
+static void lru_push_front(uint16_t s)
+{
+    ext_slot_t *e = &s_ext.slots[s];
+    e->prev = EXT_NONE;
+    e->next = s_ext.head;
+    if (s_ext.head != EXT_NONE)
+    {
+        s_ext.slots[s_ext.head].prev = s;
+    }
+    s_ext.head = s;
+    if (s_ext.tail == EXT_NONE)
+    {
+        s_ext.tail = s;
+    }
+}
+
+static void hash_remove(uint16_t s)
+{
+    uint16_t *p = &s_ext.buckets[s_ext.slots[s].cp % EXT_BUCKETS];
+    while (*p != EXT_NONE && *p != s)
+    {
+        p = &s_ext.slots[*p].hnext;
+    }
+    if (*p == s)
+    {
+        *p = s_ext.slots[s].hnext;
+    }
+}
+
+static uint16_t cache_find(uint32_t cp)
+{
+    uint16_t s = s_ext.buckets[cp % EXT_BUCKETS];
+    while (s != EXT_NONE && s_ext.slots[s].cp != cp)
+    {
+        s = s_ext.slots[s].hnext;
+    }
+    return s;
+}
+
+// 满了就把最久没用的那个格子让出来
+static uint16_t cache_take(uint32_t cp)
+{
+    uint16_t s;
+    if (s_ext.used < FONT_EXT_CACHE_GLYPHS)
+    {
+        s = s_ext.used++;
+    }
+    else
+    {
+        s = s_ext.tail;
+        lru_unlink(s);
+        hash_remove(s);
+    }
+    ext_slot_t *e = &s_ext.slots[s];
+    e->cp = cp;
+    e->hnext = s_ext.buckets[cp % EXT_BUCKETS];
+    s_ext.buckets[cp % EXT_BUCKETS] = s;
+    lru_push_front(s);
+    return s;
+}
+
+/************ LVGL字体接口 ************/
+static bool ext_get_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc, uint32_t letter, uint32_t letter_next)
+{
+    if (s_ext.hdr == NULL)
+    {
+        return false;
+    }
+    int32_t pos = ext_find(letter);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.lookups++;
+    s_stats.not_found += pos < 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (pos < 0)
+    {
+        return false;
+    }
+    // 外挂的字没有字距 都是生僻字 原来的字距表里也几乎没有
+    uint64_t r = ext_rec(pos);
+    dsc->adv_w = (REC_ADV(r) + (1 << 3)) >> 4;
+    dsc->box_w = REC_W(r);
+    dsc->box_h = REC_H(r);
+    dsc->ofs_x = ext_signed6(r >> 38);
+    dsc->ofs_y = ext_signed6(r >> 44);
+    dsc->bpp = s_ext.hdr->bpp;
+    dsc->is_placeholder = false;
+    return true;
+}
+
+static const uint8_t *ext_get_glyph_bitmap(const lv_font_t *font, uint32_t letter)
+{
+    if (s_ext.hdr == NULL || s_ext.cache == NULL)
+    {
+        return NULL;
+    }
+    int32_t pos = ext_find(letter);
+    if (pos < 0)
+    {
+        return NULL;
+    }
+    uint16_t s = cache_find(letter);
+    if (s != EXT_NONE)
+    {
+        lru_unlink(s);
+        lru_push_front(s);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.hits++;
+        portEXIT_CRITICAL(&s_lock);
+        return s_ext.cache + s * FONT_EXT_SLOT_BYTES;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    uint64_t r = ext_rec(pos);
+    s = cache_take(letter);
+    uint8_t *out = s_ext.cache + s * FONT_EXT_SLOT_BYTES;
+    ext_decode(ext_glyph_data(pos), REC_SIZE(r), out, REC_W(r), REC_H(r));
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.decodes++;
+    s_stats.decode_us += us;
+    s_stats.decode_max_us = us > s_stats.decode_max_us ? us : s_stats.decode_max_us;
+    s_stats.cached = s_ext.used;
+    portEXIT_CRITICAL(&s_lock);
+    return out;
+}
+
+lv_font_t font_alipuhui20_ext = {
+    .get_glyph_dsc = ext_get_glyph_dsc,
+    .get_glyph_bitmap = ext_get_glyph_bitmap,
+    .subpx = LV_FONT_SUBPX_NONE,
+    .underline_position = -1,
+    .underline_thickness = 1,
+};
+
+static bool hdr_valid(const font_ext_hdr_t *h, uint32_t part_size)
+{
+    uint32_t blocks = (h->count + FONT_EXT_BLOCK - 1) / FONT_EXT_BLOCK;
+    return h->magic == FONT_EXT_MAGIC && h->version == FONT_EXT_VERSION && h->header_bytes == sizeof(*h) &&
+           h->bpp == 4 && h->count && h->block_offset == sizeof(*h) + h->count * sizeof(uint64_t) &&
+           h->bitmap_offset == h->block_offset + blocks * sizeof(uint32_t) &&
+           h->bitmap_offset <= part_size && h->bitmap_bytes <= part_size - h->bitmap_offset &&
+           h->line_height == font_alipuhui20.line_height && h->base_line == font_alipuhui20.base_line;
+}
+
+esp_err_t font_ext_init(void)
+{
+    ESP_RETURN_ON_FALSE(s_ext.map == NULL, ESP_ERR_INVALID_STATE, TAG, "already mapped");
+    int64_t t0 = esp_timer_get_time();
+    font_alipuhui20_ext.line_height = font_alipuhui20.line_height;
+    font_alipuhui20_ext.base_line = font_alipuhui20.base_line;
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           FONT_EXT_PARTITION);
+    ESP_RETURN_ON_FALSE(part, ESP_ERR_NOT_FOUND, TAG, "no %s partition, rare glyphs will be boxes", FONT_EXT_PARTITION);
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, (const void **)&s_ext.map,
+                                           &s_ext.map_handle), TAG, "mmap failed");
+    const font_ext_hdr_t *h = (const font_ext_hdr_t *)s_ext.map;
+    if (!hdr_valid(h, part->size))
+    {
+        esp_partition_munmap(s_ext.map_handle);
+        s_ext.map = NULL;
+        ESP_LOGW(TAG, "%s partition holds no glyphs for this font, flash it with the app", FONT_EXT_PARTITION);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    s_ext.cache = heap_caps_malloc(FONT_EXT_CACHE_GLYPHS * FONT_EXT_SLOT_BYTES, MALLOC_CAP_SPIRAM);
+    if (s_ext.cache == NULL)
+    {
+        esp_partition_munmap(s_ext.map_handle);
+        s_ext.map = NULL;
+        ESP_LOGE(TAG, "no PSRAM for the glyph cache");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(s_ext.buckets, 0xff, sizeof(s_ext.buckets));
+    s_ext.head = s_ext.tail = EXT_NONE;
+    s_ext.last_cp = UINT32_MAX;
+    s_ext.index = s_ext.map + h->header_bytes;
+    s_ext.blocks = (const uint32_t *)(s_ext.map + h->block_offset);
+    s_ext.bitmaps = s_ext.map + h->bitmap_offset;
+    s_ext.hdr = h;
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.mapped = true;
+    s_stats.glyphs = h->count;
+    s_stats.bytes = h->bitmap_offset + h->bitmap_bytes;
+    s_stats.map_us = esp_timer_get_time() - t0;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%lu glyphs, %lu KB mapped in %lu us, %d KB cache", (unsigned long)h->count,
+             (unsigned long)s_stats.bytes / 1024, (unsigned long)s_stats.map_us,
+             FONT_EXT_CACHE_GLYPHS * FONT_EXT_SLOT_BYTES / 1024);
+    return ESP_OK;
+}
+
+void font_ext_get_stats(font_ext_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
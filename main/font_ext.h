@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+
+/*********************** flash里的外挂字形 ****************************/
+// font_alipuhui20编进程序的只有GB2312 CJK前面的符号 和源代码字符串里用到的字 由tools/font_subset在构建时拆出来
+// 剩下两万多个字形构建时写进fonts分区 和程序分开烧 编进去的字体fallback指向这里 LVGL找不到就来问
+// 整个分区映射进来 索引按码位排好 直接在flash上二分 不拷贝
+// 字形和上一行异或再压零的游程 用到时解开放进PSRAM里的LRU 文件名和网络电台名里的生僻字反复画不用每次都解
+// 分区是空的或者格式不对 和以前缺字一样画方框 编进去的字不受影响
+// 只在LVGL任务里或持有LVGL锁时用 和LVGL自己的字体一样不加锁
+
+#define FONT_EXT_PARTITION      "fonts"
+#define FONT_EXT_MAGIC          0x31584641      // "AFX1"
+#define FONT_EXT_VERSION        1
+#define FONT_EXT_BLOCK          32              // 每这么多个字形记一个起始位置
+#define FONT_EXT_SLOT_BYTES     512             // 解开的一个字形最大 31x31的4bpp
+#define FONT_EXT_CACHE_GLYPHS   CONFIG_APP_FONT_EXT_CACHE_GLYPHS
+
+// 分区开头 后面是count条u64索引 每FONT_EXT_BLOCK个一个u32起始位置 压缩的字形
+// 索引的位: 0-17码位 18-27 adv_w 28-32 box_w 33-37 box_h 38-43 ofs_x 44-49 ofs_y 50-63压缩后的字节数
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_bytes;
+    uint32_t count;
+    uint32_t block_offset;              // 相对分区开头
+    uint32_t bitmap_offset;
+    uint32_t bitmap_bytes;
+    uint16_t line_height;               // 要和编进去的字体一样
+    int16_t base_line;
+    uint8_t bpp;
+    uint8_t reserved[3];
+} font_ext_hdr_t;
+
+typedef struct {
+    bool mapped;
+    uint32_t glyphs;                    // 分区里的字形
+    uint32_t bytes;                     // 分区里用了的
+    uint32_t map_us;                    // 开机映射和检查花的时间
+    uint32_t lookups;                   // 编进去的字体里没有 来这里找的
+    uint32_t not_found;                 // 分区里也没有 画方框
+    uint32_t hits;                      // 要字形时缓存里有
+    uint32_t decodes;
+    uint64_t decode_us;
+    uint32_t decode_max_us;
+    uint32_t cached;                    // 缓存里现在的字形
+} font_ext_stats_t;
+
+extern lv_font_t font_alipuhui20_ext;   // 编进去的字体的fallback 不直接用
+
+esp_err_t font_ext_init(void);          // LVGL起来之前调 失败了字体照常用 只是缺字
+void font_ext_get_stats(font_ext_stats_t *stats);
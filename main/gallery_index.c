@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "gallery_index.h"
+#include "sd_dir_cache.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "gallery_index";
+
+#define GI_CAPS     (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define GI_PATH_LEN 160
+
+static SemaphoreHandle_t s_mutex;       // 追加和读 重写互斥 拍照任务和LVGL任务都会来
+static gallery_index_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void index_lock(void)
+{
+    if (s_mutex == NULL)
+    {
+        s_mutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+}
+
+static void index_unlock(void)
+{
+    xSemaphoreGive(s_mutex);
+}
+
+static void count_error(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.errors++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static bool index_path(char *out, size_t len, const char *dir)
+{
+    int n = snprintf(out, len, "%s/" GALLERY_INDEX_NAME, dir);
+    return n > 0 && n < (int)len;
+}
+
+static bool rec_fill(gallery_index_rec_t *rec, const char *name, int64_t when)
+{
+    size_t n = strlen(name);
+    if (n == 0 || n >= sizeof(rec->name))
+    {
+        return false;
+    }
+    memset(rec, 0, sizeof(*rec));
+    memcpy(rec->name, name, n);
+    rec->when = when;
+    return true;
+}
+
+// 追加n条 文件不存在先写头 末尾有掉电写了一半的先截掉
+static esp_err_t index_append(const char *file, const gallery_index_rec_t *recs, int n)
+{
+    const gallery_index_hdr_t hdr = {.magic = GALLERY_INDEX_MAGIC, .version = GALLERY_INDEX_VERSION};
+    struct stat st;
+    bool fresh = stat(file, &st) != 0 || st.st_size < (off_t)sizeof(hdr);
+    if (!fresh)
+    {
+        off_t tail = (st.st_size - sizeof(hdr)) % sizeof(gallery_index_rec_t);
+        if (tail && truncate(file, st.st_size - tail) != 0)
+        {
+            fresh = true;   // 截不了就整个重来
+        }
+    }
+    FILE *f = fopen(file, fresh ? "wb" : "ab");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "open %s failed", file);
+    bool ok = (!fresh || fwrite(&hdr, sizeof(hdr), 1, f) == 1) &&
+              fwrite(recs, sizeof(*recs), n, f) == (size_t)n;
+    ok = fclose(f) == 0 && ok;
+    sd_dir_cache_changed(file);
+    ESP_RETURN_ON_FALSE(ok, ESP_FAIL, TAG, "write %s failed", file);
+    return ESP_OK;
+}
+
+static esp_err_t index_rewrite(const char *file, const gallery_index_rec_t *recs, int n)
+{
+    FILE *f = fopen(file, "wb");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "open %s failed", file);
+    const gallery_index_hdr_t hdr = {.magic = GALLERY_INDEX_MAGIC, .version = GALLERY_INDEX_VERSION};
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 && fwrite(recs, sizeof(*recs), n, f) == (size_t)n;
+    ok = fclose(f) == 0 && ok;
+    sd_dir_cache_changed(file);
+    ESP_RETURN_ON_FALSE(ok, ESP_FAIL, TAG, "write %s failed", file);
+    return ESP_OK;
+}
+
+esp_err_t gallery_index_add(const char *path, time_t when)
+{
+    const char *slash = strrchr(path, '/');
+    ESP_RETURN_ON_FALSE(slash && slash > path, ESP_ERR_INVALID_ARG, TAG, "bad path %s", path);
+    gallery_index_rec_t rec;
+    if (!rec_fill(&rec, slash + 1, when))
+    {
+        return ESP_ERR_INVALID_SIZE;    // 名字太长 查的时候stat
+    }
+    char dir[GI_PATH_LEN];
+    char file[GI_PATH_LEN];
+    size_t dlen = slash - path;
+    ESP_RETURN_ON_FALSE(dlen < sizeof(dir), ESP_ERR_INVALID_SIZE, TAG, "path too long");
+    memcpy(dir, path, dlen);
+    dir[dlen] = '\0';
+    ESP_RETURN_ON_FALSE(index_path(file, sizeof(file), dir), ESP_ERR_INVALID_SIZE, TAG, "path too long");
+
+    index_lock();
+    esp_err_t err = index_append(file, &rec, 1);
+    index_unlock();
+    portENTER_CRITICAL(&s_lock);
+    if (err == ESP_OK)
+    {
+        s_stats.appends++;
+    }
+    else
+    {
+        s_stats.errors++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+// 整个文件读进PSRAM 头不对返回NULL 半条的尾巴不算 *torn告诉调用的要重写
+static gallery_index_rec_t *index_read(const char *file, int *count, bool *torn)
+{
+    *count = 0;
+    *torn = false;
+    struct stat st;
+    gallery_index_hdr_t hdr;
+    if (stat(file, &st) != 0)
+    {
+        return NULL;
+    }
+    FILE *f = fopen(file, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    gallery_index_rec_t *recs = NULL;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || hdr.magic != GALLERY_INDEX_MAGIC ||
+        hdr.version != GALLERY_INDEX_VERSION)
+    {
+        *torn = true;
+        goto out;
+    }
+    size_t body = st.st_size - sizeof(hdr);
+    int n = body / sizeof(gallery_index_rec_t);
+    *torn = body % sizeof(gallery_index_rec_t) != 0;
+    if (n == 0)
+    {
+        goto out;
+    }
+    recs = heap_caps_malloc(n * sizeof(*recs), GI_CAPS);
+    if (recs == NULL)
+    {
+        ESP_LOGW(TAG, "no memory for %d records", n);
+        goto out;
+    }
+    n = fread(recs, sizeof(*recs), n, f);
+    for (int i = 0; i < n; i++)
+    {
+        recs[i].name[GALLERY_INDEX_NAME_LEN - 1] = '\0';
+    }
+    *count = n;
+out:
+    fclose(f);
+    return recs;
+}
+
+static const gallery_index_rec_t *s_sort_recs;  // qsort的比较函数用 持有s_mutex时才设
+
+// 按名字排 同名的后写的在后
+static int order_cmp(const void *a, const void *b)
+{
+    uint32_t ia = *(const uint32_t *)a;
+    uint32_t ib = *(const uint32_t *)b;
+    int c = strcmp(s_sort_recs[ia].name, s_sort_recs[ib].name);
+    return c ? c : (ia < ib ? -1 : ia > ib);
+}
+
+// 同名里最后写的那条 没有返回-1
+static int order_find(const gallery_index_rec_t *recs, const uint32_t *order, int n, const char *name)
+{
+    int lo = 0;
+    int hi = n;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (strcmp(recs[order[mid]].name, name) <= 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo > 0 && strcmp(recs[order[lo - 1]].name, name) == 0 ? (int)order[lo - 1] : -1;
+}
+
+esp_err_t gallery_index_lookup(const char *dir, const char *const *names, int count, int64_t *when)
+{
+    char file[GI_PATH_LEN];
+    char path[GI_PATH_LEN];
+    ESP_RETURN_ON_FALSE(index_path(file, sizeof(file), dir), ESP_ERR_INVALID_SIZE, TAG, "path too long");
+    int64_t t0 = esp_timer_get_time();
+
+    index_lock();
+    int n = 0;
+    bool torn = false;
+    gallery_index_rec_t *recs = index_read(file, &n, &torn);
+    uint32_t *order = n ? heap_caps_malloc(n * sizeof(uint32_t), GI_CAPS) : NULL;
+    uint8_t *used = n ? heap_caps_calloc(n, 1, GI_CAPS) : NULL;
+    if (n && (order == NULL || used == NULL))
+    {
+        n = 0;  // 内存不够 当没有索引 全部stat
+    }
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    s_sort_recs = recs;
+    qsort(order, n, sizeof(uint32_t), order_cmp);
+
+    // 索引里没有的攒起来一次追加
+    gallery_index_rec_t *add = heap_caps_malloc((count ? count : 1) * sizeof(*add), GI_CAPS);
+    int nadd = 0;
+    int hits = 0;
+    int live = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int k = order_find(recs, order, n, names[i]);
+        if (k >= 0)
+        {
+            when[i] = recs[k].when;
+            live += !used[k];
+            used[k] = 1;
+            hits++;
+            continue;
+        }
+        struct stat st;
+        when[i] = 0;
+        int len = snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        if (len > 0 && len < (int)sizeof(path) && stat(path, &st) == 0)
+        {
+            when[i] = st.st_mtime;
+        }
+        if (add && rec_fill(&add[nadd], names[i], when[i]))
+        {
+            nadd++;
+        }
+    }
+
+    // 过期的(删掉的照片 同名旧记录)多了 或者文件坏了 用现在的全部重写 否则只追加缺的
+    int stale = n - live;
+    esp_err_t err = ESP_OK;
+    bool compact = torn || (stale >= GALLERY_INDEX_COMPACT && stale * 2 > n);
+    if (compact && add)
+    {
+        gallery_index_rec_t *all = heap_caps_malloc((count ? count : 1) * sizeof(*all), GI_CAPS);
+        int m = 0;
+        for (int i = 0; all && i < count; i++)
+        {
+            m += rec_fill(&all[m], names[i], when[i]);
+        }
+        err = all ? index_rewrite(file, all, m) : ESP_ERR_NO_MEM;
+        heap_caps_free(all);
+    }
+    else if (nadd)
+    {
+        err = index_append(file, add, nadd);
+    }
+    s_sort_recs = NULL;
+    index_unlock();
+
+    heap_caps_free(add);
+    heap_caps_free(used);
+    heap_caps_free(order);
+    heap_caps_free(recs);
+    if (err != ESP_OK)
+    {
+        count_error();
+    }
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.records = n;
+    s_stats.lookups++;
+    s_stats.hits += hits;
+    s_stats.misses += count - hits;
+    s_stats.compactions += compact && err == ESP_OK;
+    if (us > s_stats.max_lookup_us)
+    {
+        s_stats.max_lookup_us = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%s: %d photos, %d indexed, %d stat'ed, %d stale%s, %lu us", dir, count, hits, count - hits,
+             stale, compact ? " (rewritten)" : "", (unsigned long)us);
+    return ESP_OK;
+}
+
+void gallery_index_get_stats(gallery_index_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
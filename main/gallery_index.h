@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 照片拍摄时刻索引 ****************************/
+// 文件名pic_MMDD_HHMMSS里没有年份 目录顺序也不是拍摄顺序 图库要按时间排就得另记
+// 每个照片目录下一个小文件 每拍一张追加一条 {拍摄时的time() 文件名} 进图库时整个读进来按名字查 不用挨个stat
+// 索引里没有的(电脑拷进来的 索引建立前拍的)用文件修改时间 查完顺手追加进去 下次就不用stat了
+// 同名的以最后一条为准 删掉的照片留下的记录查的时候数出来 多过一半就整个重写一遍
+// 掉电写了半条的 追加前按记录长度截掉
+
+#define GALLERY_INDEX_NAME      ".gallery"
+#define GALLERY_INDEX_MAGIC     0x58444947      // "GIDX"
+#define GALLERY_INDEX_VERSION   1
+#define GALLERY_INDEX_NAME_LEN  32              // 比这长的名字不记 每次查都stat
+#define GALLERY_INDEX_COMPACT   32              // 过期记录至少这么多才重写
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} gallery_index_hdr_t;
+
+typedef struct {
+    int64_t when;                               // 拍摄时的time()
+    char name[GALLERY_INDEX_NAME_LEN];          // 目录里的文件名 补0
+} gallery_index_rec_t;
+
+typedef struct {
+    uint32_t appends;                           // 拍照追加的
+    uint32_t records;                           // 最近一次读到的记录数
+    uint32_t lookups;
+    uint32_t hits;                              // 索引里有的 累计
+    uint32_t misses;                            // 退回去stat的 累计
+    uint32_t compactions;
+    uint32_t errors;
+    uint32_t max_lookup_us;
+} gallery_index_stats_t;
+
+// 照片写完关掉以后调 索引放在path所在的目录
+esp_err_t gallery_index_add(const char *path, time_t when);
+// dir下count个文件名的拍摄时刻填进when 没有索引也能用 全部退回修改时间
+esp_err_t gallery_index_lookup(const char *dir, const char *const *names, int count, int64_t *when);
+void gallery_index_get_stats(gallery_index_stats_t *stats);
@@ -0,0 +1,211 @@
+#include <string.h>
+#include "heap_audit.h"
+#include "ui_screen.h"
+#include "lvgl.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#if CONFIG_HEAP_TRACING_STANDALONE
+#include "esp_heap_trace.h"
+#endif
+
+static const char *TAG = "heap_audit";
+
+#define AUDIT_HEAPS     3
+
+static const uint32_t s_caps[AUDIT_HEAPS] = {MALLOC_CAP_INTERNAL, MALLOC_CAP_DMA, MALLOC_CAP_SPIRAM};
+static const char *const s_heap_names[AUDIT_HEAPS] = {"internal", "dma", "psram"};
+
+typedef struct {
+    uint32_t free[AUDIT_HEAPS];
+    uint32_t largest[AUDIT_HEAPS];
+} snapshot_t;
+
+typedef struct {
+    const char *name;
+    bool cold;                          // 这一圈重建过 只当基准
+    bool has_base;
+    snapshot_t enter;
+    snapshot_t base;                    // 上一次退出稳定以后
+} screen_audit_t;
+
+static screen_audit_t s_screens[UI_SCREEN_MAX];
+static lv_timer_t *s_settle;
+static int s_pending = -1;              // 退出了还在等收尾的界面
+static heap_audit_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_HEAP_TRACING_STANDALONE
+static heap_trace_record_t s_records[CONFIG_APP_HEAP_AUDIT_RECORDS];
+static bool s_trace_ready;
+#endif
+
+static void snapshot_take(snapshot_t *s)
+{
+    for (int i = 0; i < AUDIT_HEAPS; i++)
+    {
+        s->free[i] = heap_caps_get_free_size(s_caps[i]);
+        s->largest[i] = heap_caps_get_largest_free_block(s_caps[i]);
+    }
+}
+
+static void trace_start(void)
+{
+#if CONFIG_HEAP_TRACING_STANDALONE
+    if (!s_trace_ready)
+    {
+        s_trace_ready = heap_trace_init_standalone(s_records, CONFIG_APP_HEAP_AUDIT_RECORDS) == ESP_OK;
+    }
+    if (s_trace_ready)
+    {
+        heap_trace_start(HEAP_TRACE_LEAKS); // 清掉上一圈的记录
+    }
+#endif
+}
+
+static void trace_stop(void)
+{
+#if CONFIG_HEAP_TRACING_STANDALONE
+    if (s_trace_ready)
+    {
+        heap_trace_stop();
+    }
+#endif
+}
+
+// 这一圈里分配了还没释放的 地址用addr2line对回源码
+static void trace_dump(void)
+{
+#if CONFIG_HEAP_TRACING_STANDALONE
+    if (!s_trace_ready)
+    {
+        return;
+    }
+    size_t count = heap_trace_get_count();
+    int shown = 0;
+    for (size_t i = 0; i < count && shown < HEAP_AUDIT_DUMP_MAX; i++)
+    {
+        heap_trace_record_t r;
+        if (heap_trace_get(i, &r) != ESP_OK || r.address == NULL)
+        {
+            continue;
+        }
+        ESP_LOGW(TAG, "  %u bytes at %p allocated by %p", (unsigned)r.size, r.address, r.alloced_by[0]);
+        shown++;
+    }
+    if (count > (size_t)shown)
+    {
+        ESP_LOGW(TAG, "  %u of %u outstanding shown", shown, (unsigned)count);
+    }
+#else
+    ESP_LOGW(TAG, "  enable CONFIG_HEAP_TRACING_STANDALONE to see the allocating call sites");
+#endif
+}
+
+static void settle(int id)
+{
+    trace_stop();
+    screen_audit_t *a = &s_screens[id];
+    snapshot_t now;
+    snapshot_take(&now);
+    for (int i = 0; i < AUDIT_HEAPS; i++)
+    {
+        ESP_LOGD(TAG, "%s: %s %+ld bytes while open", a->name, s_heap_names[i],
+                 (long)now.free[i] - (long)a->enter.free[i]);
+    }
+
+    if (a->has_base && !a->cold)
+    {
+        bool grew = false;
+        int32_t worst = 0;
+        for (int i = 0; i < AUDIT_HEAPS; i++)
+        {
+            int32_t d_free = (int32_t)(now.free[i] - a->base.free[i]);
+            int32_t d_largest = (int32_t)(now.largest[i] - a->base.largest[i]);
+            if (d_free < -HEAP_AUDIT_SLACK || d_largest < -HEAP_AUDIT_SLACK)
+            {
+                grew = true;
+                ESP_LOGW(TAG, "%s: %s free %+ld, largest block %+ld since last exit", a->name, s_heap_names[i],
+                         (long)d_free, (long)d_largest);
+            }
+            worst = d_free < worst ? d_free : worst;
+        }
+        if (grew)
+        {
+            trace_dump();
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.cycles++;
+        s_stats.flagged += grew;
+        if (worst < s_stats.worst_delta)
+        {
+            s_stats.worst_delta = worst;
+            s_stats.worst_id = id;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    a->base = now;
+    a->has_base = true;
+}
+
+static void settle_cb(lv_timer_t *t)
+{
+    s_settle = NULL; // 只跑一次 LVGL自己删
+    int id = s_pending;
+    s_pending = -1;
+    if (id >= 0)
+    {
+        settle(id);
+    }
+}
+
+void heap_audit_enter(int id, const char *name, bool cold)
+{
+    if (id <= 0 || id >= UI_SCREEN_MAX)
+    {
+        return;
+    }
+    // 上一个还没等到收尾就进了下一个 马上结算
+    if (s_settle)
+    {
+        lv_timer_del(s_settle);
+        s_settle = NULL;
+    }
+    if (s_pending >= 0)
+    {
+        int pending = s_pending;
+        s_pending = -1;
+        settle(pending);
+    }
+    screen_audit_t *a = &s_screens[id];
+    a->name = name;
+    a->cold = cold;
+    snapshot_take(&a->enter);
+    trace_start();
+}
+
+void heap_audit_leave(int id)
+{
+    if (id <= 0 || id >= UI_SCREEN_MAX)
+    {
+        return;
+    }
+    s_pending = id;
+    if (s_settle == NULL)
+    {
+        s_settle = lv_timer_create(settle_cb, HEAP_AUDIT_SETTLE_MS, NULL);
+        lv_timer_set_repeat_count(s_settle, 1);
+    }
+    else
+    {
+        lv_timer_reset(s_settle);
+    }
+}
+
+void heap_audit_get_stats(heap_audit_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
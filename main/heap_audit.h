@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/*********************** 进出应用的内存检查 ****************************/
+// 调试用 每次进出界面记下内部RAM DMA PSRAM三种堆的剩余和最大块
+// 退出后等一会(后台任务收尾)再记 和这个界面上一次退出时比 没重建的进出一圈不该少内存
+// 第一次进入和被回收后重建的那次只当基准 隐藏的界面本来就占着内存
+// 开了CONFIG_HEAP_TRACING_STANDALONE 进入时开始记分配 退出时列出还没释放的和分配它的地址
+// 只在LVGL任务里调
+
+#define HEAP_AUDIT_SETTLE_MS    1000    // 退出后等这么久再记
+#define HEAP_AUDIT_SLACK        512     // 少于这么多不算
+#define HEAP_AUDIT_DUMP_MAX     16      // 最多列出这么多条没释放的
+
+typedef struct {
+    uint32_t cycles;                    // 比过的进出
+    uint32_t flagged;                   // 其中少了内存的
+    int32_t worst_delta;                // 最多少了多少字节 负数
+    int worst_id;
+} heap_audit_stats_t;
+
+void heap_audit_enter(int id, const char *name, bool cold);
+void heap_audit_leave(int id);
+void heap_audit_get_stats(heap_audit_stats_t *stats);
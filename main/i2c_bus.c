@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_bus.h"
+#include "task_plan.h"
+#include "esp32_s3_szp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "driver/i2c.h"
+#include "esp_lcd_panel_io_interface.h"
+#include "esp_lcd_touch_ft5x06.h"
+#include "es8311_codec.h"
+#include "esp_codec_dev_types.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "i2c_bus";
+
+typedef enum {
+    PRIO_HIGH,
+    PRIO_NORMAL,
+    PRIO_LOW,
+    PRIO_COUNT,
+} bus_prio_t;
+
+typedef struct {
+    const char *name;
+    uint8_t addr;                       // 7位地址
+    bus_prio_t prio;
+} bus_dev_t;
+
+static const bus_dev_t s_devs[I2C_BUS_DEV_COUNT] = {
+    [I2C_BUS_TOUCH] = {"touch", ESP_LCD_TOUCH_IO_I2C_FT5x06_ADDRESS, PRIO_HIGH},
+    [I2C_BUS_IMU] = {"imu", QMI8658_SENSOR_ADDR, PRIO_NORMAL},
+    [I2C_BUS_IOEXP] = {"ioexp", PCA9557_SENSOR_ADDR, PRIO_NORMAL},
+    [I2C_BUS_CODEC_OUT] = {"es8311", ES8311_CODEC_DEFAULT_ADDR >> 1, PRIO_LOW},
+    [I2C_BUS_CODEC_IN] = {"es7210", 0x82 >> 1, PRIO_LOW},
+};
+
+typedef struct {
+    uint8_t dev;
+    uint8_t wlen;
+    uint16_t rlen;
+    const uint8_t *w;
+    uint8_t *r;
+    uint8_t data[I2C_BUS_ASYNC_MAX];    // 异步写拷在这里
+    SemaphoreHandle_t done;             // 异步写是NULL
+    esp_err_t *err;
+    int64_t t_queued;
+} bus_req_t;
+
+static QueueHandle_t s_queue[PRIO_COUNT];
+static SemaphoreHandle_t s_pending;     // 三个队列里一共排着几笔
+static TaskHandle_t s_worker;
+static i2c_bus_stats_t s_stats[I2C_BUS_DEV_COUNT];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_err_t bus_xfer(const bus_req_t *req)
+{
+    uint8_t addr = s_devs[req->dev].addr;
+    TickType_t ticks = pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS);
+    if (req->rlen)
+    {
+        return i2c_master_write_read_device(BSP_I2C_NUM, addr, req->w, req->wlen, req->r, req->rlen, ticks);
+    }
+    return i2c_master_write_to_device(BSP_I2C_NUM, addr, req->w, req->wlen, ticks);
+}
+
+static esp_err_t bus_run(const bus_req_t *req)
+{
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = bus_xfer(req);
+    int64_t t1 = esp_timer_get_time();
+    uint32_t xfer = t1 - t0;
+    uint32_t wait = req->t_queued ? t0 - req->t_queued : 0;
+    i2c_bus_stats_t *st = &s_stats[req->dev];
+    portENTER_CRITICAL(&s_lock);
+    st->transfers++;
+    st->errors += err != ESP_OK;
+    st->async += req->done == NULL && req->t_queued;
+    st->xfer_us += xfer;
+    st->xfer_max_us = xfer > st->xfer_max_us ? xfer : st->xfer_max_us;
+    st->wait_us += wait;
+    st->wait_max_us = wait > st->wait_max_us ? wait : st->wait_max_us;
+    portEXIT_CRITICAL(&s_lock);
+    return err;
+}
+
+static void bus_task(void *arg)
+{
+    for (;;)
+    {
+        xSemaphoreTake(s_pending, portMAX_DELAY);
+        bus_req_t req;
+        // 每做完一笔都从最高的队列重新看 低优先级的只在上面都空了才轮到
+        for (int p = 0; p < PRIO_COUNT; p++)
+        {
+            if (xQueueReceive(s_queue[p], &req, 0) == pdTRUE)
+            {
+                if (req.w == NULL)
+                {
+                    req.w = req.data;
+                }
+                esp_err_t err = bus_run(&req);
+                if (req.done)
+                {
+                    *req.err = err;
+                    xSemaphoreGive(req.done);
+                }
+                else if (err != ESP_OK)
+                {
+                    ESP_LOGW(TAG, "%s: async write failed: %s", s_devs[req.dev].name, esp_err_to_name(err));
+                }
+                break;
+            }
+        }
+    }
+}
+
+esp_err_t i2c_bus_start(void)
+{
+    if (s_worker)
+    {
+        return ESP_OK;
+    }
+    for (int p = 0; p < PRIO_COUNT; p++)
+    {
+        s_queue[p] = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(bus_req_t));
+        ESP_RETURN_ON_FALSE(s_queue[p], ESP_ERR_NO_MEM, TAG, "no mem for queue");
+    }
+    s_pending = xSemaphoreCreateCounting(I2C_BUS_QUEUE_LEN * PRIO_COUNT, 0);
+    ESP_RETURN_ON_FALSE(s_pending, ESP_ERR_NO_MEM, TAG, "no mem for semaphore");
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_I2C_BUS, bus_task, NULL, &s_worker) == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "create task");
+    return ESP_OK;
+}
+
+// 调度任务起来以前直接传
+static esp_err_t bus_submit(bus_req_t *req)
+{
+    if (s_worker == NULL)
+    {
+        return bus_run(req);
+    }
+    StaticSemaphore_t sem_buf;
+    esp_err_t err = ESP_FAIL;
+    req->done = xSemaphoreCreateBinaryStatic(&sem_buf);
+    req->err = &err;
+    req->t_queued = esp_timer_get_time();
+    // 每笔最多I2C_BUS_TIMEOUT_MS 排在前面的做完一定轮到 不用超时
+    xQueueSend(s_queue[s_devs[req->dev].prio], req, portMAX_DELAY);
+    xSemaphoreGive(s_pending);
+    xSemaphoreTake(req->done, portMAX_DELAY);
+    vSemaphoreDelete(req->done);
+    return err;
+}
+
+esp_err_t i2c_bus_write_read(i2c_bus_dev_t dev, const uint8_t *w, size_t wlen, uint8_t *r, size_t rlen)
+{
+    ESP_RETURN_ON_FALSE(dev < I2C_BUS_DEV_COUNT && wlen <= UINT8_MAX && rlen && rlen <= UINT16_MAX, ESP_ERR_INVALID_ARG,
+                        TAG, "bad transfer");
+    bus_req_t req = {.dev = dev, .w = w, .wlen = wlen, .r = r, .rlen = rlen};
+    return bus_submit(&req);
+}
+
+esp_err_t i2c_bus_write(i2c_bus_dev_t dev, const uint8_t *w, size_t wlen)
+{
+    ESP_RETURN_ON_FALSE(dev < I2C_BUS_DEV_COUNT && wlen && wlen <= UINT8_MAX, ESP_ERR_INVALID_ARG, TAG, "bad transfer");
+    bus_req_t req = {.dev = dev, .w = w, .wlen = wlen};
+    return bus_submit(&req);
+}
+
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t dev, const uint8_t *w, size_t wlen)
+{
+    ESP_RETURN_ON_FALSE(dev < I2C_BUS_DEV_COUNT && wlen && wlen <= I2C_BUS_ASYNC_MAX, ESP_ERR_INVALID_ARG, TAG,
+                        "bad transfer");
+    bus_req_t req = {.dev = dev, .wlen = wlen};
+    memcpy(req.data, w, wlen);
+    if (s_worker == NULL)
+    {
+        req.w = req.data;
+        return bus_run(&req);
+    }
+    req.t_queued = esp_timer_get_time();
+    req.w = NULL; // 出队的是一份拷贝 做之前再指向里面的data
+    if (xQueueSend(s_queue[s_devs[dev].prio], &req, 0) != pdTRUE)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats[dev].dropped++;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(s_pending);
+    return ESP_OK;
+}
+
+const char *i2c_bus_dev_name(i2c_bus_dev_t dev)
+{
+    return dev < I2C_BUS_DEV_COUNT ? s_devs[dev].name : "";
+}
+
+void i2c_bus_get_stats(i2c_bus_dev_t dev, i2c_bus_stats_t *stats)
+{
+    if (dev >= I2C_BUS_DEV_COUNT)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats[dev];
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/************ 触摸的面板IO ************/
+// FT5x06的配置是8位命令 读就是先写寄存器地址再读
+typedef struct {
+    esp_lcd_panel_io_t base;
+} touch_io_t;
+
+static esp_err_t touch_rx_param(esp_lcd_panel_io_t *io, int lcd_cmd, void *param, size_t param_size)
+{
+    uint8_t reg = lcd_cmd;
+    return i2c_bus_write_read(I2C_BUS_TOUCH, &reg, 1, param, param_size);
+}
+
+static esp_err_t touch_tx_param(esp_lcd_panel_io_t *io, int lcd_cmd, const void *param, size_t param_size)
+{
+    uint8_t buf[1 + I2C_BUS_ASYNC_MAX];
+    ESP_RETURN_ON_FALSE(param_size <= I2C_BUS_ASYNC_MAX, ESP_ERR_INVALID_SIZE, TAG, "touch write too long");
+    buf[0] = lcd_cmd;
+    if (param_size)
+    {
+        memcpy(buf + 1, param, param_size);
+    }
+    return i2c_bus_write(I2C_BUS_TOUCH, buf, 1 + param_size);
+}
+
+static esp_err_t touch_tx_color(esp_lcd_panel_io_t *io, int lcd_cmd, const void *color, size_t color_size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static esp_err_t touch_del(esp_lcd_panel_io_t *io)
+{
+    free(io);
+    return ESP_OK;
+}
+
+static esp_err_t touch_register_cbs(esp_lcd_panel_io_t *io, const esp_lcd_panel_io_callbacks_t *cbs, void *user_ctx)
+{
+    return ESP_OK; // 没有颜色数据 不会有传输完成
+}
+
+esp_err_t i2c_bus_new_touch_io(esp_lcd_panel_io_handle_t *ret_io)
+{
+    touch_io_t *io = calloc(1, sizeof(*io));
+    ESP_RETURN_ON_FALSE(io, ESP_ERR_NO_MEM, TAG, "no mem for touch io");
+    io->base.rx_param = touch_rx_param;
+    io->base.tx_param = touch_tx_param;
+    io->base.tx_color = touch_tx_color;
+    io->base.del = touch_del;
+    io->base.register_event_callbacks = touch_register_cbs;
+    *ret_io = &io->base;
+    return ESP_OK;
+}
+
+/************ 音频芯片的控制接口 ************/
+typedef struct {
+    audio_codec_ctrl_if_t base;
+    i2c_bus_dev_t dev;
+} codec_ctrl_t;
+
+static int codec_open(const audio_codec_ctrl_if_t *ctrl, void *cfg, int cfg_size)
+{
+    return ESP_CODEC_DEV_OK;
+}
+
+static bool codec_is_open(const audio_codec_ctrl_if_t *ctrl)
+{
+    return true;
+}
+
+// 寄存器地址两个字节的高位在前 和组件里新驱动的写法一样
+static int codec_reg_bytes(uint8_t *out, int reg, int reg_len)
+{
+    if (reg_len > 1)
+    {
+        out[0] = reg >> 8;
+        out[1] = reg & 0xff;
+        return 2;
+    }
+    out[0] = reg & 0xff;
+    return 1;
+}
+
+static int codec_read_reg(const audio_codec_ctrl_if_t *ctrl, int reg, int reg_len, void *data, int data_len)
+{
+    const codec_ctrl_t *c = (const codec_ctrl_t *)ctrl;
+    uint8_t w[2];
+    int n = codec_reg_bytes(w, reg, reg_len);
+    esp_err_t err = i2c_bus_write_read(c->dev, w, n, data, data_len);
+    return err == ESP_OK ? ESP_CODEC_DEV_OK : ESP_CODEC_DEV_READ_FAIL;
+}
+
+static int codec_write_reg(const audio_codec_ctrl_if_t *ctrl, int reg, int reg_len, void *data, int data_len)
+{
+    const codec_ctrl_t *c = (const codec_ctrl_t *)ctrl;
+    uint8_t w[2 + I2C_BUS_ASYNC_MAX];
+    if (data_len > I2C_BUS_ASYNC_MAX)
+    {
+        return ESP_CODEC_DEV_NOT_SUPPORT;
+    }
+    int n = codec_reg_bytes(w, reg, reg_len);
+    memcpy(w + n, data, data_len);
+    esp_err_t err = i2c_bus_write(c->dev, w, n + data_len);
+    return err == ESP_OK ? ESP_CODEC_DEV_OK : ESP_CODEC_DEV_WRITE_FAIL;
+}
+
+static int codec_close(const audio_codec_ctrl_if_t *ctrl)
+{
+    return ESP_CODEC_DEV_OK;
+}
+
+const audio_codec_ctrl_if_t *i2c_bus_new_codec_ctrl(i2c_bus_dev_t dev)
+{
+    codec_ctrl_t *c = calloc(1, sizeof(*c)); // audio_codec_delete_ctrl_if用free释放
+    if (c == NULL)
+    {
+        return NULL;
+    }
+    c->base.open = codec_open;
+    c->base.is_open = codec_is_open;
+    c->base.read_reg = codec_read_reg;
+    c->base.write_reg = codec_write_reg;
+    c->base.close = codec_close;
+    c->dev = dev;
+    return &c->base;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_lcd_panel_io.h"
+#include "audio_codec_ctrl_if.h"
+
+
+/*********************** I2C总线调度 ****************************/
+// 触摸 IMU IO扩展 两个音频芯片共用一条I2C 以前各个任务直接调驱动 谁先拿到锁谁先传
+// 现在所有传输排进三个优先级的队列 由一个任务按优先级一笔一笔做 触摸最先 音频芯片最后
+// 正在传的一笔打断不了 最多等一笔 音量调节排再多也不会挡住触摸
+// 同步的调用等自己那笔做完 异步写把数据拷进队列马上返回 只能写几个字节
+// 每个设备记传输次数 出错次数 排队和传输的耗时
+// 触摸和音频芯片的驱动是组件里的 给它们造了走这里的面板IO和控制接口
+
+typedef enum {
+    I2C_BUS_TOUCH,
+    I2C_BUS_IMU,
+    I2C_BUS_IOEXP,
+    I2C_BUS_CODEC_OUT,
+    I2C_BUS_CODEC_IN,
+    I2C_BUS_DEV_COUNT,
+} i2c_bus_dev_t;
+
+#define I2C_BUS_TIMEOUT_MS      50      // 一笔传输最长 以前是1000ms
+#define I2C_BUS_QUEUE_LEN       8       // 每个优先级
+#define I2C_BUS_ASYNC_MAX       8       // 异步写最多几个字节
+
+typedef struct {
+    uint32_t transfers;
+    uint32_t errors;
+    uint32_t async;                     // 其中异步写的
+    uint32_t dropped;                   // 异步写队列满丢掉的
+    uint64_t xfer_us;
+    uint32_t xfer_max_us;
+    uint64_t wait_us;                   // 在队列里等的时间
+    uint32_t wait_max_us;
+} i2c_bus_stats_t;
+
+esp_err_t i2c_bus_start(void);          // 驱动装好以后调 起调度任务
+esp_err_t i2c_bus_write_read(i2c_bus_dev_t dev, const uint8_t *w, size_t wlen, uint8_t *r, size_t rlen);
+esp_err_t i2c_bus_write(i2c_bus_dev_t dev, const uint8_t *w, size_t wlen);
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t dev, const uint8_t *w, size_t wlen);
+esp_err_t i2c_bus_new_touch_io(esp_lcd_panel_io_handle_t *ret_io);    // 给esp_lcd_touch_new_i2c_ft5x06
+const audio_codec_ctrl_if_t *i2c_bus_new_codec_ctrl(i2c_bus_dev_t dev); // 给es8311_codec_new和es7210_codec_new
+const char *i2c_bus_dev_name(i2c_bus_dev_t dev);
+void i2c_bus_get_stats(i2c_bus_dev_t dev, i2c_bus_stats_t *stats);
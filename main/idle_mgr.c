@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <string.h>
+#include "idle_mgr.h"
+#include "task_plan.h"
+#include "imu.h"
+#include "ui_msg.h"
+#include "ui_perf.h"
+#include "evt_bus.h"
+#include "imu_gesture.h"
+#include "standby.h"
+#include "esp32_s3_szp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "idle_mgr";
+
+#define IDLE_DIM_MA     (CONFIG_APP_IDLE_ON_MA - CONFIG_APP_IDLE_BACKLIGHT_MA * (100 - IDLE_DIM_PERCENT) / 100)
+
+static idle_state_t s_state = IDLE_ON;
+static bool s_motion_ok;                // 芯片初始化好了 可以读运动状态
+static int s_inhibit;
+static idle_mgr_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task;
+static lv_obj_t *s_shield;              // 熄屏时盖在最上层 吃掉点亮屏幕的那一下触摸
+static volatile bool s_raised;          // 手势认出了举起 下次醒来算运动
+
+static void shield_event_cb(lv_event_t *e)
+{
+    // 按下时背光已经亮了 松手再删 删早了下面的控件会收到这次按压
+    lv_obj_del_async(s_shield);
+    s_shield = NULL;
+}
+
+// 以下两个在LVGL任务里执行
+static void shield_show(void *arg)
+{
+    if (s_shield)
+    {
+        return;
+    }
+    s_shield = lv_obj_create(lv_layer_top());
+    lv_obj_remove_style_all(s_shield);
+    lv_obj_set_size(s_shield, LV_PCT(100), LV_PCT(100));
+    lv_obj_add_flag(s_shield, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(s_shield, shield_event_cb, LV_EVENT_RELEASED, NULL);
+}
+
+static void shield_hide(void *arg)
+{
+    // 触摸叫醒的还按着 留给它自己松手时删
+    if (s_shield && !lv_obj_has_state(s_shield, LV_STATE_PRESSED))
+    {
+        lv_obj_del(s_shield);
+        s_shield = NULL;
+    }
+}
+
+// 有没有动过 姿态界面开着就看采样任务的计数 不然自己读STATUS1 读了就清
+static bool motion_seen(uint32_t *events)
+{
+    if (imu_running())
+    {
+        uint32_t ev = imu_motion_events();
+        bool moved = ev != *events;
+        *events = ev;
+        return moved;
+    }
+    if (!s_motion_ok)
+    {
+        return false;
+    }
+    uint8_t status = 0;
+    if (qmi8658_register_read(QMI8658_STATUS1, &status, 1) != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.i2c_errors++;
+        portEXIT_CRITICAL(&s_lock);
+        return false;
+    }
+    return status & 0x20; // Any-Motion
+}
+
+static void idle_enter(idle_state_t next, int64_t now, uint32_t inactive_ms, bool motion)
+{
+    idle_state_t prev = s_state;
+    s_state = next;
+#if CONFIG_APP_STANDBY
+    if (next != IDLE_OFF)
+    {
+        standby_wake(motion ? STANDBY_WAKE_MOTION : STANDBY_WAKE_UI); // 屏幕先出睡眠 再开背光
+    }
+#endif
+    switch (next)
+    {
+    case IDLE_DIM:
+        bsp_display_brightness_set(IDLE_DIM_PERCENT);
+        break;
+    case IDLE_OFF:
+        bsp_display_backlight_off();
+        ui_post_call(shield_show, NULL);
+        break;
+    case IDLE_ON:
+        bsp_display_backlight_on();
+        break;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (next == IDLE_DIM)
+    {
+        s_stats.dims++;
+    }
+    else if (next == IDLE_OFF)
+    {
+        s_stats.offs++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    evt_bus_publish(EVT_IDLE, next, 0);
+    if (next != IDLE_ON)
+    {
+        return;
+    }
+    // 触摸的时刻LVGL记着 运动只知道是这次读到的
+    uint32_t wake_us = esp_timer_get_time() - now + (motion ? 0 : inactive_ms * 1000);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.wakes++;
+    s_stats.motion_wakes += motion;
+    s_stats.wake_us_total += wake_us;
+    if (wake_us > s_stats.wake_us_max)
+    {
+        s_stats.wake_us_max = wake_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (prev == IDLE_OFF)
+    {
+        ui_post_call(shield_hide, NULL);
+        ESP_LOGI(TAG, "woken by %s in %lu us", motion ? "motion" : "touch", (unsigned long)wake_us);
+    }
+}
+
+static void idle_account(uint32_t ms)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_state == IDLE_ON)
+    {
+        s_stats.on_ms += ms;
+    }
+    else if (s_state == IDLE_DIM)
+    {
+        s_stats.dim_ms += ms;
+    }
+    else
+    {
+        s_stats.off_ms += ms;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void idle_task(void *arg)
+{
+    // 手势开着的话芯片已经在跑FIFO了 运动状态看采样任务的
+    s_motion_ok = imu_running() || (qmi8658_init() == ESP_OK && qmi8658_motion_only() == ESP_OK);
+    if (!s_motion_ok)
+    {
+        ESP_LOGW(TAG, "QMI8658 not available, idle on touch only");
+    }
+    uint32_t events = imu_motion_events();
+    int64_t t_last = esp_timer_get_time();
+    uint32_t wait_ms = IDLE_POLL_MS;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+        bool motion = motion_seen(&events);
+        if (motion)
+        {
+            evt_bus_publish(EVT_MOTION, 0, 0);
+        }
+#if CONFIG_APP_IMU_GESTURE
+        if (imu_gesture_active() && s_state != IDLE_ON)
+        {
+            motion = false; // 暗着只认举起 桌子震一下不亮
+        }
+#endif
+        motion |= s_raised;
+        s_raised = false;
+        int64_t now = esp_timer_get_time();
+        idle_account((now - t_last) / 1000);
+        t_last = now;
+
+        ui_lock(0);
+        if (motion || s_inhibit)
+        {
+            lv_disp_trig_activity(NULL);
+        }
+        uint32_t inactive = lv_disp_get_inactive_time(NULL);
+        ui_unlock();
+
+        idle_state_t next = inactive >= IDLE_OFF_MS ? IDLE_OFF : inactive >= IDLE_DIM_MS ? IDLE_DIM : IDLE_ON;
+        if (next != s_state)
+        {
+            idle_enter(next, now, inactive, motion);
+        }
+        // 亮着就睡到该调暗的时候 多给1个tick 醒来时一定过了
+        wait_ms = IDLE_POLL_MS;
+        if (s_state == IDLE_ON && inactive < IDLE_DIM_MS)
+        {
+            wait_ms = IDLE_DIM_MS - inactive + portTICK_PERIOD_MS;
+            wait_ms = wait_ms > IDLE_ON_POLL_MS ? IDLE_ON_POLL_MS : wait_ms;
+        }
+    }
+}
+
+#if CONFIG_APP_IMU_GESTURE
+// 在手势任务里
+static void idle_gesture(const evt_t *ev)
+{
+    if (ev->a == IMU_GESTURE_RAISE)
+    {
+        s_raised = true;
+        xTaskNotifyGive(s_task);
+    }
+}
+#endif
+
+esp_err_t idle_mgr_start(void)
+{
+    if (s_task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_IDLE_MGR, idle_task, NULL, &s_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+#if CONFIG_APP_IMU_GESTURE
+    evt_bus_subscribe(EVT_GESTURE, idle_gesture, EVT_BUS_DIRECT);
+#endif
+    return ESP_OK;
+}
+
+void idle_mgr_inhibit(bool on)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_inhibit += on ? 1 : -1;
+    if (s_inhibit < 0)
+    {
+        s_inhibit = 0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void idle_mgr_imu_released(void)
+{
+    if (imu_running())
+    {
+        return; // 还有别的模块在用
+    }
+    if (s_task && s_motion_ok)
+    {
+        qmi8658_motion_only();
+    }
+    else
+    {
+        qmi8658_close(); // 关闭芯片运行
+    }
+}
+
+void idle_mgr_kick(void)
+{
+    if (s_task && s_state != IDLE_ON)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+idle_state_t idle_mgr_state(void)
+{
+    return s_state;
+}
+
+void idle_mgr_get_stats(idle_mgr_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    uint64_t total = stats->on_ms + stats->dim_ms + stats->off_ms;
+    if (total)
+    {
+        stats->avg_ma = (stats->on_ms * CONFIG_APP_IDLE_ON_MA + stats->dim_ms * IDLE_DIM_MA +
+                         stats->off_ms * CONFIG_APP_IDLE_OFF_MA) / total;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 空闲管理 ****************************/
+// 没人碰屏幕 机器也没动 过一会儿背光调暗 再过一会儿关背光
+// 动的判断用QMI8658的运动引擎: 平时芯片只开加速度 低功耗21Hz 陀螺仪关着 读STATUS1看Any-Motion
+// 姿态界面开着时芯片归采样任务 改看它读到的Any-Motion次数
+// 开了姿态手势(imu_gesture)采样任务一直在 调暗和熄屏时只有举起的手势和触摸能叫醒 亮着时还是动了就算活动
+// 板子没引出INT1 调暗和熄屏时按IDLE_POLL_MS去读一个字节 叫醒的延迟多出最多这么久
+// 亮着时睡到该调暗的时刻 最多IDLE_ON_POLL_MS看一次运动 运动状态位一直留着不会漏 只是晚一点算活动
+// 调暗和熄屏时触摸按下直接叫醒任务 不等下一次
+// 触摸和运动都算LVGL的活动(lv_disp_trig_activity) 只看一个不活动时间 熄屏后第一下触摸只点亮 不点到下面的控件
+// 降频和浅睡归pm_ctl 熄屏以后停屏幕和I2S的待机归standby 这里只管背光
+
+#define IDLE_POLL_MS            100
+#define IDLE_ON_POLL_MS         1000
+#define IDLE_DIM_MS             (CONFIG_APP_IDLE_DIM_S * 1000)
+#define IDLE_OFF_MS             (CONFIG_APP_IDLE_OFF_S * 1000)
+#define IDLE_DIM_PERCENT        CONFIG_APP_IDLE_DIM_PERCENT
+
+typedef enum {
+    IDLE_ON = 0,
+    IDLE_DIM,
+    IDLE_OFF,                           // 背光关了
+} idle_state_t;
+
+typedef struct {
+    uint32_t dims;
+    uint32_t offs;
+    uint32_t wakes;                     // 从调暗或熄屏回来
+    uint32_t motion_wakes;              // 其中是拿起来叫醒的 剩下的是触摸 开了手势只有举起算
+    uint32_t wake_us_max;               // 活动到背光恢复 运动的话从读到状态位算起
+    uint64_t wake_us_total;
+    uint64_t on_ms;                     // 各状态待的时间
+    uint64_t dim_ms;
+    uint64_t off_ms;
+    uint32_t avg_ma;                    // 按Kconfig里的电流和待的时间估的平均电流
+    uint32_t i2c_errors;
+} idle_mgr_stats_t;
+
+esp_err_t idle_mgr_start(void);         // LVGL起来以后调用 芯片在任务里初始化
+void idle_mgr_inhibit(bool on);         // 摄像头这种不碰屏幕也在用的界面 进入时true 退出时false 可以嵌套
+void idle_mgr_imu_released(void);       // imu_stop后调用 代替qmi8658_close 芯片回到只测运动 还有人在用就不动
+void idle_mgr_kick(void);               // 触摸新按下时调 调暗或熄屏着就马上叫醒任务
+idle_state_t idle_mgr_state(void);
+void idle_mgr_get_stats(idle_mgr_stats_t *stats);
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "imu.h"
+#include "task_plan.h"
+#include "esp32_s3_szp.h"
+#include "sys_trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "imu";
+
+#define IMU_WINDOW      (IMU_RING - QMI8658_FIFO_SAMPLES)   // 读取任务下一次最多写这么多 再往前的读者不能碰
+
+static imu_sample_t s_ring[IMU_RING];
+static atomic_uint s_head;
+static atomic_uint s_motion;
+static atomic_uint s_any_motion;         // 出现过Any-Motion的读取次数
+static volatile bool s_running;
+static int s_users;                     // imu_start了还没imu_stop的 最后一个停了才真停
+static imu_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task;
+static TaskHandle_t s_listeners[IMU_MAX_LISTENERS];
+static uint32_t s_next_ts;              // 下一组样本的芯片采样计数
+static bool s_ts_valid;                 // 开FIFO以后还没有对上芯片的计数
+static SemaphoreHandle_t s_stopped;
+static volatile bool s_lowlat;
+static int s_wtm;                       // FIFO现在的水位
+
+static void IRAM_ATTR imu_int_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    SYS_TRACE_ISR_ENTER("imu");
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    SYS_TRACE_ISR_EXIT("imu");
+    portYIELD_FROM_ISR(woken);
+}
+
+// 芯片的TIMESTAMP是24位的采样计数 读FIFO之后读 这时可能又采了一组
+// 没溢出就不会丢 样本按上一批接着编号 溢出了才按芯片的计数重新对齐 差出来的就是丢的
+static uint32_t imu_timestamp(const uint8_t *ts, int n, bool overflow, uint32_t *lost)
+{
+    uint32_t chip = ts[0] | ts[1] << 8 | ts[2] << 16;
+    *lost = 0;
+    if (!s_ts_valid)
+    {
+        s_ts_valid = true;
+        return chip - (n - 1);
+    }
+    if (!overflow)
+    {
+        return s_next_ts;
+    }
+    uint32_t expect = s_next_ts + n - 1;
+    int32_t d = (int32_t)(((chip - expect) & 0xFFFFFF) << 8) >> 8; // 按24位的差展开到32位
+    uint32_t first = expect + d - (n - 1);
+    if ((int32_t)(first - s_next_ts) > 0)
+    {
+        *lost = first - s_next_ts;
+        return first;
+    }
+    return s_next_ts;
+}
+
+// 一次把FIFO读空 样本的时刻从读完的时刻按ODR往前推
+static void imu_burst(void)
+{
+    static int16_t s_raw[QMI8658_FIFO_SAMPLES][6];
+    bool overflow = false;
+    int64_t t0 = esp_timer_get_time();
+    int n = qmi8658_fifo_read(s_raw, QMI8658_FIFO_SAMPLES, &overflow);
+    int64_t t1 = esp_timer_get_time();
+    // STATUS1后面紧接着就是TIMESTAMP的三个字节 一次读
+    uint8_t st[4] = {0};
+    uint32_t lost = 0;
+    if (n >= 0)
+    {
+        qmi8658_register_read(QMI8658_STATUS1, st, sizeof(st));
+    }
+    uint8_t motion = st[0];
+    unsigned head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    if (n > 0)
+    {
+        uint32_t ts = imu_timestamp(&st[1], n, overflow, &lost);
+        for (int i = 0; i < n; i++)
+        {
+            imu_sample_t *s = &s_ring[(head + i) % IMU_RING];
+            s->t_us = t1 - (int64_t)(n - 1 - i) * 1000000 / IMU_ODR_HZ;
+            s->ts = ts + i;
+            memcpy(s->acc, &s_raw[i][0], sizeof(s->acc));
+            memcpy(s->gyr, &s_raw[i][3], sizeof(s->gyr));
+        }
+        s_next_ts = ts + n;
+        atomic_store_explicit(&s_head, head + n, memory_order_release);
+        for (int i = 0; i < IMU_MAX_LISTENERS; i++)
+        {
+            TaskHandle_t listener = s_listeners[i];
+            if (listener)
+            {
+                xTaskNotifyGive(listener);
+            }
+        }
+    }
+    atomic_fetch_or_explicit(&s_motion, motion, memory_order_relaxed);
+    if (motion & 0x20)
+    {
+        atomic_fetch_add_explicit(&s_any_motion, 1, memory_order_relaxed);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    if (n < 0)
+    {
+        s_stats.errors++;
+    }
+    else
+    {
+        s_stats.bursts++;
+        s_stats.samples += n;
+        s_stats.overflows += overflow;
+        s_stats.lost += lost;
+        s_stats.i2c_us += t1 - t0;
+        if ((uint32_t)n > s_stats.max_burst)
+        {
+            s_stats.max_burst = n;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void imu_task(void *arg)
+{
+    for (;;)
+    {
+        if (!s_running)
+        {
+            xSemaphoreGive(s_stopped);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        // 有INT线就等水位中断 超时兜底 没有的话就是按攒满水位的时间醒 低延迟时每个tick醒
+        int wtm = s_lowlat ? IMU_LOWLAT_WTM : IMU_WATERMARK;
+        TickType_t wait = pdMS_TO_TICKS(wtm * 1000 / IMU_ODR_HZ);
+        wait = wait > 0 ? wait : 1;
+        ulTaskNotifyTake(pdTRUE, BSP_IMU_INT != GPIO_NUM_NC ? wait * 2 : wait);
+        if (s_running)
+        {
+            imu_burst();
+        }
+        if (s_running && wtm != s_wtm && qmi8658_fifo_enable(wtm) == ESP_OK)
+        {
+            // 刚读空 重开FIFO只丢读完这一下新采的 计数重新对齐
+            s_wtm = wtm;
+            s_ts_valid = false;
+        }
+    }
+}
+
+static esp_err_t imu_open(void)
+{
+    if (s_task == NULL)
+    {
+        s_stopped = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(s_stopped, ESP_ERR_NO_MEM, TAG, "no memory");
+        ESP_RETURN_ON_FALSE(task_plan_create(TASK_IMU, imu_task, NULL, &s_task) == pdPASS,
+                            ESP_ERR_NO_MEM, TAG, "task create failed");
+        if (BSP_IMU_INT != GPIO_NUM_NC)
+        {
+            const gpio_config_t io = {
+                .pin_bit_mask = BIT64(BSP_IMU_INT),
+                .mode = GPIO_MODE_INPUT,
+                .intr_type = GPIO_INTR_POSEDGE,
+            };
+            ESP_RETURN_ON_ERROR(gpio_config(&io), TAG, "int gpio config failed");
+            esp_err_t ret = gpio_install_isr_service(0);
+            ESP_RETURN_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, TAG, "gpio isr service failed");
+            ESP_RETURN_ON_ERROR(gpio_isr_handler_add(BSP_IMU_INT, imu_int_isr, NULL), TAG, "int isr add failed");
+        }
+    }
+    ESP_RETURN_ON_ERROR(qmi8658_fifo_enable(IMU_WATERMARK), TAG, "fifo enable failed");
+    s_wtm = IMU_WATERMARK;
+    xSemaphoreTake(s_stopped, 0);
+    s_ts_valid = false;
+    s_running = true;
+    xTaskNotifyGive(s_task);
+    ESP_LOGI(TAG, "FIFO watermark %d samples, %s", IMU_WATERMARK, BSP_IMU_INT != GPIO_NUM_NC ? "INT2" : "polled");
+    return ESP_OK;
+}
+
+esp_err_t imu_start(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool first = s_users++ == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!first)
+    {
+        return ESP_OK; // 已经在读了 别的模块开的
+    }
+    esp_err_t ret = imu_open();
+    if (ret != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_users--;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    return ret;
+}
+
+void imu_stop(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool last = s_users > 0 && --s_users == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!last || s_task == NULL || !s_running)
+    {
+        return;
+    }
+    s_running = false;
+    xTaskNotifyGive(s_task);
+    // 正在读的话等这一次读完 最多一次FIFO的I2C时间
+    xSemaphoreTake(s_stopped, pdMS_TO_TICKS(200));
+    qmi8658_fifo_disable();
+}
+
+uint32_t imu_head(void)
+{
+    return atomic_load_explicit(&s_head, memory_order_acquire);
+}
+
+int imu_read(uint32_t *cursor, imu_sample_t *out, int max)
+{
+    unsigned head = atomic_load_explicit(&s_head, memory_order_acquire);
+    unsigned from = *cursor;
+    if (head - from > IMU_WINDOW)
+    {
+        from = head - IMU_WINDOW;
+    }
+    int n = head - from;
+    n = n < max ? n : max;
+    for (int i = 0; i < n; i++)
+    {
+        out[i] = s_ring[(from + i) % IMU_RING];
+    }
+    // 拷的时候读取任务可能又发布了 前面被覆盖的扔掉
+    unsigned now = atomic_load_explicit(&s_head, memory_order_acquire);
+    int lost = now - from > IMU_WINDOW ? (int)(now - IMU_WINDOW - from) : 0;
+    lost = lost < n ? lost : n;
+    if (lost > 0)
+    {
+        memmove(out, out + lost, (n - lost) * sizeof(*out));
+        n -= lost;
+        from += lost;
+    }
+    *cursor = from + n;
+    return n;
+}
+
+bool imu_latest(imu_sample_t *out)
+{
+    uint32_t cursor = imu_head();
+    if (cursor == 0)
+    {
+        return false;
+    }
+    cursor--;
+    return imu_read(&cursor, out, 1) == 1;
+}
+
+uint8_t imu_motion(void)
+{
+    return atomic_exchange_explicit(&s_motion, 0, memory_order_relaxed);
+}
+
+uint32_t imu_motion_events(void)
+{
+    return atomic_load_explicit(&s_any_motion, memory_order_relaxed);
+}
+
+bool imu_running(void)
+{
+    return s_running;
+}
+
+void imu_set_low_latency(bool on)
+{
+    s_lowlat = on;
+    if (s_task)
+    {
+        xTaskNotifyGive(s_task); // 马上按新的水位和间隔
+    }
+}
+
+esp_err_t imu_add_listener(TaskHandle_t task)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < IMU_MAX_LISTENERS; i++)
+    {
+        if (s_listeners[i] == NULL || s_listeners[i] == task)
+        {
+            s_listeners[i] = task;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+void imu_remove_listener(TaskHandle_t task)
+{
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < IMU_MAX_LISTENERS; i++)
+    {
+        if (s_listeners[i] == task)
+        {
+            s_listeners[i] = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void imu_get_stats(imu_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+/*********************** 姿态传感器采样服务 ****************************/
+// QMI8658开FIFO 芯片自己按ODR攒数据 攒够水位的组数core 0上的任务一次全读出来 I2C不再在LVGL任务里跑
+// 接了INT2就等水位中断 没接就按攒满水位的时间去读
+// 读出来的样本放进一个环 生产者只有读取任务 发布靠一个一直往上加的计数 读的人各自拿游标 不用锁
+// 运动状态(STATUS1)也是每读一次FIFO顺便读 界面取的时候拿到这段时间出现过的所有状态位
+// 紧跟着的TIMESTAMP给每组样本编上芯片的采样计数 FIFO溢出丢了多少从计数的跳变看得出来
+// ODR由CONFIG_APP_IMU_ODR_HZ选 896Hz要把I2C开到400kHz 100kHz的总线一秒只够搬四百多组
+
+#define IMU_ODR_HZ              CONFIG_APP_IMU_ODR_HZ   // 加速度和陀螺仪一起开 都按陀螺仪的ODR
+#define IMU_WATERMARK           CONFIG_APP_IMU_FIFO_WTM
+#define IMU_BURST_MS            (IMU_WATERMARK * 1000 / IMU_ODR_HZ)
+#define IMU_RING                256     // 读的人最多落后IMU_RING减一次FIFO那么多组
+#define IMU_ACC_LSB_PER_G       8192    // ±4g
+#define IMU_GYR_LSB_PER_DPS     64      // ±512dps
+#define IMU_MAX_LISTENERS       5   // 姿态解算 记录 空中鼠标 手势 计步
+#define IMU_LOWLAT_WTM          (IMU_ODR_HZ / 200 > 1 ? IMU_ODR_HZ / 200 : 1)   // 低延迟时的水位 大约5ms一批
+
+typedef struct {
+    int64_t t_us;                       // 按读出的时刻和ODR往前推的采样时刻
+    uint32_t ts;                        // 芯片的采样计数 连着的样本差1
+    int16_t acc[3];
+    int16_t gyr[3];
+} imu_sample_t;
+
+typedef struct {
+    uint32_t bursts;                    // 读FIFO的次数
+    uint32_t samples;
+    uint32_t max_burst;
+    uint32_t overflows;                 // 读晚了FIFO满过 丢了旧数据
+    uint32_t lost;                      // 溢出时按芯片的采样计数算出来丢的组数
+    uint32_t errors;
+    uint64_t i2c_us;                    // 读FIFO花在I2C上的时间
+} imu_stats_t;
+
+// 几个模块可以一起用 各自配对调imu_start/imu_stop 第一个开FIFO 最后一个停的才真关
+// 还没在读(imu_running为false)才要先qmi8658_init 在读时再初始化会把FIFO复位掉
+esp_err_t imu_start(void);
+void imu_stop(void);                    // 真停时等读取任务停下 关掉FIFO 之后才能qmi8658_close
+uint32_t imu_head(void);                // 一共发布过多少组 新的读者从这里开始
+// 从*cursor开始拷 最多max组 落后太多已经被覆盖的跳过 返回拷了几组 *cursor往前走
+int imu_read(uint32_t *cursor, imu_sample_t *out, int max);
+bool imu_latest(imu_sample_t *out);     // 最新的一组 还没有数据返回false
+uint8_t imu_motion(void);               // 上次取之后出现过的STATUS1位 取完清零
+uint32_t imu_motion_events(void);       // 读到Any-Motion的次数 只增不减 不和imu_motion抢状态位
+bool imu_running(void);                 // 正在读FIFO 这时STATUS1归采样任务读
+void imu_get_stats(imu_stats_t *stats);
+// 低延迟模式 水位降到IMU_LOWLAT_WTM 没有INT线的话每个tick读一次 空中鼠标这种要跟手的用 I2C忙得多
+void imu_set_low_latency(bool on);
+esp_err_t imu_add_listener(TaskHandle_t task);  // 每发布一批通知这个任务 最多IMU_MAX_LISTENERS个
+void imu_remove_listener(TaskHandle_t task);
@@ -0,0 +1,339 @@
+#include <math.h>
+#include <string.h>
+#include "imu_gesture.h"
+#include "task_plan.h"
+#include "imu.h"
+#include "evt_bus.h"
+#include "esp32_s3_szp.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if CONFIG_APP_IMU_GESTURE
+
+static const char *TAG = "imu_gesture";
+
+#define G_ACC           (1.0f / IMU_ACC_LSB_PER_G)
+#define G_GYR           (1.0f / IMU_GYR_LSB_PER_DPS)
+#define G_DT_US         (1000000 / IMU_ODR_HZ)
+#define G_ALPHA         (1.0f / (IMU_ODR_HZ * 0.08f))   // 重力低通 时间常数80ms
+#define G_MS(ms)        ((int64_t)(ms) * 1000)
+
+typedef enum {
+    FACE_OTHER,
+    FACE_UP,
+    FACE_DOWN,
+} face_t;
+
+// 只在自己的任务里用
+static float s_g[3];                    // 低通出来的重力 g
+static bool s_inited;
+static int64_t s_t_last;
+// 甩
+static bool s_armed = true;             // 动态加速度回落过 下一次超过才算新的峰
+static int s_peaks;
+static int s_peak_axis;
+static bool s_peak_pos;
+static int64_t s_peak_t;
+static int64_t s_shake_t0;
+static int64_t s_shake_holdoff;
+// 扣下
+static bool s_down;
+static int64_t s_flip_t0;               // z最近一次过零
+static bool s_z_neg;
+// 静止和举起
+static int64_t s_still_t0;              // 这次停着从什么时候开始 动着是0
+static bool s_rest;                     // 放着停够了 rest_g是那时的重力
+static float s_rest_g[3];
+static bool s_moving;                   // 放着以后动了 在收集这一段的特征
+static int64_t s_move_t0;
+static float s_move_peak;               // 这一段最大的动态加速度
+
+static TaskHandle_t s_task;
+static volatile bool s_active;
+static int64_t s_start_us;
+static imu_gesture_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_names[IMU_GESTURE_COUNT] = {"shake", "face down", "face up", "raise"};
+
+const char *imu_gesture_name(imu_gesture_t g)
+{
+    return g < IMU_GESTURE_COUNT ? s_names[g] : "?";
+}
+
+static void gesture_fire(imu_gesture_t g, int64_t t0, int64_t t_decided)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t latency_ms = (now - t0) / 1000;
+    uint32_t lag_us = now > t_decided ? now - t_decided : 0;
+    evt_bus_publish(EVT_GESTURE, g, latency_ms);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.count[g]++;
+    s_stats.latency_ms_total += latency_ms;
+    if (latency_ms > s_stats.latency_ms_max)
+    {
+        s_stats.latency_ms_max = latency_ms;
+    }
+    s_stats.lag_us_total += lag_us;
+    if (lag_us > s_stats.lag_us_max)
+    {
+        s_stats.lag_us_max = lag_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%s, %lu ms from onset", s_names[g], (unsigned long)latency_ms);
+}
+
+static void gesture_reset(const float *a, int64_t t)
+{
+    memcpy(s_g, a, sizeof(s_g));
+    s_armed = true;
+    s_peaks = 0;
+    s_still_t0 = 0;
+    s_rest = false;
+    s_moving = false;
+    s_z_neg = a[2] < 0.0f;
+    s_flip_t0 = t;
+    s_inited = true;
+}
+
+static void shake_update(const float *d, float dyn, int64_t t)
+{
+    if (dyn < GESTURE_SHAKE_G * 0.5f)
+    {
+        s_armed = true;
+        return;
+    }
+    if (!s_armed || dyn < GESTURE_SHAKE_G)
+    {
+        return;
+    }
+    s_armed = false;
+    int axis = 0;
+    for (int i = 1; i < 3; i++)
+    {
+        if (fabsf(d[i]) > fabsf(d[axis]))
+        {
+            axis = i;
+        }
+    }
+    bool pos = d[axis] > 0.0f;
+    if (s_peaks == 0 || t - s_peak_t > G_MS(GESTURE_SHAKE_GAP_MS) || axis != s_peak_axis)
+    {
+        s_peaks = 1;
+        s_shake_t0 = t;
+    }
+    else if (pos != s_peak_pos)
+    {
+        s_peaks++;
+    }
+    s_peak_axis = axis;
+    s_peak_pos = pos;
+    s_peak_t = t;
+    if (s_peaks >= GESTURE_SHAKE_PEAKS && t >= s_shake_holdoff)
+    {
+        gesture_fire(IMU_GESTURE_SHAKE, s_shake_t0, t);
+        s_shake_holdoff = t + G_MS(GESTURE_SHAKE_HOLDOFF_MS);
+        s_peaks = 0;
+    }
+}
+
+static face_t face_of(const float *g)
+{
+    return g[2] > GESTURE_FACE_Z ? FACE_UP : g[2] < -GESTURE_FACE_Z ? FACE_DOWN : FACE_OTHER;
+}
+
+static void flip_update(bool still, int64_t t)
+{
+    bool neg = s_g[2] < 0.0f;
+    if (neg != s_z_neg)
+    {
+        s_z_neg = neg;
+        s_flip_t0 = t; // 翻的过程从z过零算起
+    }
+    if (!s_down)
+    {
+        if (still && t - s_still_t0 >= G_MS(GESTURE_FLIP_HOLD_MS) && face_of(s_g) == FACE_DOWN)
+        {
+            s_down = true;
+            gesture_fire(IMU_GESTURE_FACE_DOWN, s_flip_t0, t);
+        }
+    }
+    else if (!neg && t - s_flip_t0 >= G_MS(GESTURE_FLIP_HOLD_MS))
+    {
+        // 拿起来看就算翻回来了 不用再平放停稳
+        s_down = false;
+        gesture_fire(IMU_GESTURE_FACE_UP, s_flip_t0, t);
+    }
+}
+
+// 放着以后动了一下又停住 这一段是不是举起来看屏幕
+static bool raise_decide(uint32_t dur_ms, float peak, const float *g0, const float *g1)
+{
+    if (dur_ms > GESTURE_RAISE_MAX_MS)
+    {
+        return false; // 慢慢挪的 或者拿着走
+    }
+    if (peak > GESTURE_SHAKE_G)
+    {
+        return false; // 甩或者碰撞
+    }
+    float n0 = sqrtf(g0[0] * g0[0] + g0[1] * g0[1] + g0[2] * g0[2]);
+    float n1 = sqrtf(g1[0] * g1[0] + g1[1] * g1[1] + g1[2] * g1[2]);
+    if (n0 < 0.5f || n1 < 0.5f)
+    {
+        return false; // 在掉落
+    }
+    float z1 = g1[2] / n1;
+    if (z1 < GESTURE_RAISE_Z)
+    {
+        return false; // 最后屏幕没朝上 装口袋 侧着放
+    }
+    float cosv = (g0[0] * g1[0] + g0[1] * g1[1] + g0[2] * g1[2]) / (n0 * n1);
+    if (cosv > cosf(GESTURE_RAISE_DEG / 57.29578f))
+    {
+        return false; // 转得太少 只是碰了一下
+    }
+    // 本来平放着屏幕朝上 最后也几乎平的 是挪了个地方
+    return !(g0[2] / n0 > GESTURE_FACE_Z && z1 > GESTURE_FACE_Z);
+}
+
+static void raise_update(bool still, float dyn, int64_t t)
+{
+    if (!still)
+    {
+        if (s_rest && !s_moving)
+        {
+            s_moving = true;
+            s_move_t0 = t;
+            s_move_peak = 0.0f;
+        }
+        if (s_moving && dyn > s_move_peak)
+        {
+            s_move_peak = dyn;
+        }
+        return;
+    }
+    int64_t held = t - s_still_t0;
+    if (s_moving && held >= G_MS(GESTURE_SETTLE_MS))
+    {
+        s_moving = false;
+        s_rest = false; // 要再放够GESTURE_REST_MS才认下一次
+        uint32_t dur_ms = (s_still_t0 - s_move_t0) / 1000;
+        if (!s_down && raise_decide(dur_ms, s_move_peak, s_rest_g, s_g))
+        {
+            gesture_fire(IMU_GESTURE_RAISE, s_move_t0, t);
+        }
+        else
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_stats.rejected++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+    if (!s_moving && held >= G_MS(GESTURE_REST_MS))
+    {
+        s_rest = true;
+        memcpy(s_rest_g, s_g, sizeof(s_rest_g)); // 一直放着就一直跟着 慢慢倾斜不会攒成一次举起
+    }
+}
+
+// 返回这个样本前面是不是断了
+static bool gesture_sample(const imu_sample_t *s)
+{
+    float a[3] = {s->acc[0] * G_ACC, s->acc[1] * G_ACC, s->acc[2] * G_ACC};
+    int64_t t = s->t_us;
+    bool gap = s_inited && (t - s_t_last > 4 * G_DT_US || t < s_t_last);
+    s_t_last = t;
+    if (!s_inited || gap)
+    {
+        gesture_reset(a, t);
+        return gap;
+    }
+    float d[3];
+    for (int i = 0; i < 3; i++)
+    {
+        s_g[i] += (a[i] - s_g[i]) * G_ALPHA;
+        d[i] = a[i] - s_g[i];
+    }
+    float dyn = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    float gx = s->gyr[0] * G_GYR, gy = s->gyr[1] * G_GYR, gz = s->gyr[2] * G_GYR;
+    bool still = dyn < GESTURE_STILL_G && gx * gx + gy * gy + gz * gz < GESTURE_STILL_DPS * GESTURE_STILL_DPS;
+    if (!still)
+    {
+        s_still_t0 = 0;
+    }
+    else if (s_still_t0 == 0)
+    {
+        s_still_t0 = t;
+    }
+
+    shake_update(d, dyn, t);
+    flip_update(still, t);
+    raise_update(still, dyn, t);
+    return false;
+}
+
+static void gesture_task(void *arg)
+{
+    static imu_sample_t s_batch[QMI8658_FIFO_SAMPLES];
+    uint32_t cursor = imu_head();
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        int total = 0;
+        int gaps = 0;
+        int n;
+        while ((n = imu_read(&cursor, s_batch, QMI8658_FIFO_SAMPLES)) > 0)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                gaps += gesture_sample(&s_batch[i]);
+            }
+            total += n;
+        }
+        uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.samples += total;
+        s_stats.gaps += gaps;
+        s_stats.cycles += cycles;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+esp_err_t imu_gesture_start(void)
+{
+    ESP_RETURN_ON_FALSE(s_task == NULL, ESP_ERR_INVALID_STATE, TAG, "already started");
+    if (!imu_running())
+    {
+        ESP_RETURN_ON_ERROR(qmi8658_init(), TAG, "QMI8658 not available");
+    }
+    ESP_RETURN_ON_ERROR(imu_start(), TAG, "imu start failed"); // 一直不停 用的人里一直有这一个
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_IMU_GESTURE, gesture_task, NULL, &s_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+    ESP_RETURN_ON_ERROR(imu_add_listener(s_task), TAG, "no IMU listener slot");
+    s_start_us = esp_timer_get_time();
+    s_active = true;
+    ESP_LOGI(TAG, "running at %d Hz", IMU_ODR_HZ);
+    return ESP_OK;
+}
+
+bool imu_gesture_active(void)
+{
+    return s_active;
+}
+
+void imu_gesture_get_stats(imu_gesture_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    int64_t span = s_active ? esp_timer_get_time() - s_start_us : 0;
+    stats->cpu_permille = span > 0 ? stats->cycles * 1000 / ((uint64_t)span * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ) : 0;
+}
+
+#endif
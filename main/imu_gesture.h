@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 姿态手势 ****************************/
+// 一直开着IMU的FIFO 一个低优先级任务按ODR逐个样本看 认出来的手势发EVT_GESTURE 谁要用谁订阅
+// 加速度低通出重力 减掉重力是动态加速度 另外看陀螺仪的模长 都是单精度 一个样本几十次乘加
+// 甩: 动态加速度超过GESTURE_SHAKE_G 沿同一个轴来回反向 GESTURE_SHAKE_PEAKS次 两次之间不超过GESTURE_SHAKE_GAP_MS
+// 扣下: 停稳GESTURE_FLIP_HOLD_MS 重力在屏幕法线(z)上是负的 翻回来(z转正)持续同样久发FACE_UP
+// 举起: 静止GESTURE_REST_MS算放着 然后动 再停稳GESTURE_SETTLE_MS 这一段的特征
+//       (用时 最大动态加速度 重力转过的角度 最后屏幕朝哪)过一棵很小的决策树 见raise_decide
+// 延迟从手势开始的那个样本算到发布 包含手势本身要等的时间 另外记判定的样本到发布的时间 就是FIFO攒批的延迟
+// CPU按这个任务花的周期和开始以后过的时间算 千分之几
+
+#define GESTURE_SHAKE_G         1.2f    // 动态加速度 g
+#define GESTURE_SHAKE_PEAKS     4
+#define GESTURE_SHAKE_GAP_MS    300
+#define GESTURE_SHAKE_HOLDOFF_MS 1000   // 甩完一次这么久不再认 甩的余波不算第二次
+#define GESTURE_STILL_DPS       20.0f   // 陀螺仪模长低于这个 动态加速度低于GESTURE_STILL_G算停着 手拿着的抖动也算
+#define GESTURE_STILL_G         0.15f
+#define GESTURE_FLIP_HOLD_MS    400
+#define GESTURE_FACE_Z          0.8f    // 重力在z上超过这么多算平放
+#define GESTURE_REST_MS         1000
+#define GESTURE_SETTLE_MS       150
+#define GESTURE_RAISE_MAX_MS    1500
+#define GESTURE_RAISE_DEG       30.0f
+#define GESTURE_RAISE_Z         0.35f   // 举起来以后屏幕至少这么朝上 重力在z上的分量
+
+typedef enum {
+    IMU_GESTURE_SHAKE,
+    IMU_GESTURE_FACE_DOWN,
+    IMU_GESTURE_FACE_UP,                // 扣下以后翻回来
+    IMU_GESTURE_RAISE,
+    IMU_GESTURE_COUNT,
+} imu_gesture_t;
+
+typedef struct {
+    uint32_t count[IMU_GESTURE_COUNT];
+    uint32_t rejected;                  // 放着以后动过 决策树没认成举起的
+    uint32_t samples;
+    uint32_t gaps;                      // IMU被别人停过又开 或者丢了样本 手势状态从头来
+    uint32_t latency_ms_max;            // 手势开始到发布
+    uint64_t latency_ms_total;          // 除以各手势的次数之和
+    uint32_t lag_us_max;                // 判定的样本到发布
+    uint64_t lag_us_total;
+    uint64_t cycles;
+    uint32_t cpu_permille;              // 开始以后这个任务占一个核的千分之几
+} imu_gesture_stats_t;
+
+#if CONFIG_APP_IMU_GESTURE
+// LVGL起来以后 空闲管理之前调 芯片在这里初始化 IMU从此一直开着
+esp_err_t imu_gesture_start(void);
+bool imu_gesture_active(void);
+const char *imu_gesture_name(imu_gesture_t g);
+void imu_gesture_get_stats(imu_gesture_stats_t *stats);
+#endif
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "imu_log.h"
+#include "task_plan.h"
+#include "imu.h"
+#include "esp32_s3_szp.h"
+#include "sd_writer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "imu_log";
+
+#define LOG_WRITE_BYTES     SD_WRITER_BLOCK
+
+_Static_assert(sizeof(imu_log_header_t) == 64, "imu_log_header_t layout");
+_Static_assert(sizeof(imu_log_rec_t) == 16, "imu_log_rec_t layout");
+_Static_assert(QMI8658_FIFO_SAMPLES <= 255, "count is one byte");
+
+static sd_writer_t *s_writer;
+static char s_path[64];
+static uint8_t *s_ring;
+static uint32_t s_head;                 // 环的写入和写盘 都是一直往上加的字节数
+static uint32_t s_tail;
+static uint32_t s_cursor;               // 采样环里的游标
+static uint32_t s_next_seen;            // 下一组应该是这个编号 算丢了多少
+static uint32_t s_next_file;            // 文件里下一组应该是这个编号 记录头里的lost按它算
+static bool s_started;
+static int64_t s_t_start;
+static volatile bool s_stopping;        // 收集任务最后收一次就退出
+static volatile bool s_flush;           // 写盘任务把不满一块的也写掉再退出
+static volatile bool s_write_failed;
+static bool s_active;
+static TaskHandle_t s_collect_task;
+static TaskHandle_t s_write_task;
+static SemaphoreHandle_t s_collected;
+static SemaphoreHandle_t s_done;
+static SemaphoreHandle_t s_api_lock;    // 界面和热插拔任务都可能来停
+static imu_log_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void ring_write(uint32_t pos, const void *src, uint32_t n)
+{
+    uint32_t off = pos % IMU_LOG_RING_BYTES;
+    uint32_t first = n < IMU_LOG_RING_BYTES - off ? n : IMU_LOG_RING_BYTES - off;
+    memcpy(s_ring + off, src, first);
+    memcpy(s_ring, (const uint8_t *)src + first, n - first);
+}
+
+// 一段编号连续的样本拼成一条记录放进环 放不下整条丢掉
+static void put_record(const imu_sample_t *s, int count)
+{
+    static int16_t s_data[QMI8658_FIFO_SAMPLES][6];
+    uint32_t bytes = sizeof(imu_log_rec_t) + count * QMI8658_SAMPLE_BYTES;
+    portENTER_CRITICAL(&s_lock);
+    uint32_t used = s_head - s_tail;
+    bool fits = used + bytes <= IMU_LOG_RING_BYTES;
+    if (!fits)
+    {
+        s_stats.lost_buf += count;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!fits)
+    {
+        return;
+    }
+
+    uint32_t lost = s_started ? s->ts - s_next_file : 0;
+    imu_log_rec_t rec = {
+        .type = IMU_LOG_REC_SAMPLES,
+        .count = count,
+        .lost = lost > 0xFFFF ? 0xFFFF : lost,
+        .ts = s->ts,
+        .t_us = s->t_us,
+    };
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(&s_data[i][0], s[i].acc, sizeof(s[i].acc));
+        memcpy(&s_data[i][3], s[i].gyr, sizeof(s[i].gyr));
+    }
+    uint32_t pos = s_head;
+    ring_write(pos, &rec, sizeof(rec));
+    ring_write(pos + sizeof(rec), s_data, count * QMI8658_SAMPLE_BYTES);
+    s_next_file = s[count - 1].ts + 1;
+
+    portENTER_CRITICAL(&s_lock);
+    s_head = pos + bytes;
+    s_stats.samples += count;
+    s_stats.records++;
+    if (used + bytes > s_stats.ring_peak)
+    {
+        s_stats.ring_peak = used + bytes;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (used + bytes >= LOG_WRITE_BYTES)
+    {
+        xTaskNotifyGive(s_write_task);
+    }
+}
+
+// 从采样环里把新的都拷出来 编号断开的地方另起一条记录
+static void collect(void)
+{
+    static imu_sample_t s_batch[QMI8658_FIFO_SAMPLES];
+    int n;
+    uint32_t from = s_cursor;
+    while ((n = imu_read(&s_cursor, s_batch, QMI8658_FIFO_SAMPLES)) > 0)
+    {
+        uint32_t skipped = s_cursor - from - n;    // 落后太多 采样环已经覆盖掉的
+        uint32_t gaps = 0;
+        int i = 0;
+        while (i < n)
+        {
+            if (s_started && s_batch[i].ts != s_next_seen)
+            {
+                gaps += s_batch[i].ts - s_next_seen;
+            }
+            int j = i + 1;
+            while (j < n && s_batch[j].ts == s_batch[j - 1].ts + 1)
+            {
+                j++;
+            }
+            put_record(&s_batch[i], j - i);
+            s_next_seen = s_batch[j - 1].ts + 1;
+            s_started = true;
+            i = j;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.lost_ring += skipped;
+        s_stats.lost_fifo += gaps > skipped ? gaps - skipped : 0;
+        s_stats.duration_us = s_batch[n - 1].t_us - s_t_start;
+        portEXIT_CRITICAL(&s_lock);
+        from = s_cursor;
+    }
+}
+
+static void collect_task(void *arg)
+{
+    while (!s_stopping)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IMU_BURST_MS * 4));
+        collect();
+    }
+    collect();
+    xSemaphoreGive(s_collected);
+    vTaskDelete(NULL);
+}
+
+static void write_task(void *arg)
+{
+    for (;;)
+    {
+        portENTER_CRITICAL(&s_lock);
+        uint32_t avail = s_head - s_tail;
+        portEXIT_CRITICAL(&s_lock);
+        bool flush = s_flush;
+        // 平时只写整块 停止时才写最后不满的一块
+        if (avail < LOG_WRITE_BYTES && !(flush && avail))
+        {
+            if (flush)
+            {
+                break;
+            }
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500));
+            continue;
+        }
+        // 环里的数据直接交给写卡模块 回绕的话分两段
+        uint32_t n = avail < LOG_WRITE_BYTES ? avail : LOG_WRITE_BYTES;
+        uint32_t off = s_tail % IMU_LOG_RING_BYTES;
+        uint32_t first = n < IMU_LOG_RING_BYTES - off ? n : IMU_LOG_RING_BYTES - off;
+        int64_t t0 = esp_timer_get_time();
+        bool ok = !s_write_failed && sd_writer_write(s_writer, s_ring + off, first) == ESP_OK &&
+                  sd_writer_write(s_writer, s_ring, n - first) == ESP_OK;
+        uint32_t us = esp_timer_get_time() - t0;
+        if (!ok && !s_write_failed)
+        {
+            ESP_LOGE(TAG, "write failed at %llu bytes", (unsigned long long)s_stats.bytes);
+            s_write_failed = true;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_tail += n;
+        if (ok)
+        {
+            s_stats.bytes += n;
+            if (us > s_stats.max_write_us)
+            {
+                s_stats.max_write_us = us;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void log_free(void)
+{
+    heap_caps_free(s_ring);
+    s_ring = NULL;
+    if (s_collected)
+    {
+        vSemaphoreDelete(s_collected);
+        s_collected = NULL;
+    }
+    if (s_done)
+    {
+        vSemaphoreDelete(s_done);
+        s_done = NULL;
+    }
+}
+
+static esp_err_t log_open(void)
+{
+    if (mkdir(IMU_LOG_DIR, 0775) != 0)
+    {
+        struct stat st;
+        ESP_RETURN_ON_FALSE(stat(IMU_LOG_DIR, &st) == 0, ESP_FAIL, TAG, "mkdir %s failed", IMU_LOG_DIR);
+    }
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    snprintf(s_path, sizeof(s_path), "%s/imu_%02d%02d_%02d%02d%02d.bin", IMU_LOG_DIR, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    int64_t t0 = esp_timer_get_time();
+    s_writer = sd_writer_open(s_path, IMU_LOG_PREALLOC_BYTES);
+    ESP_RETURN_ON_FALSE(s_writer, ESP_FAIL, TAG, "open %s failed", s_path);
+    ESP_LOGI(TAG, "%s: %d Hz, opened with %d MB preallocated in %lu ms", s_path, IMU_ODR_HZ,
+             CONFIG_APP_IMU_LOG_PREALLOC_MB, (unsigned long)(esp_timer_get_time() - t0) / 1000);
+
+    imu_log_header_t h = {
+        .magic = IMU_LOG_MAGIC,
+        .version = IMU_LOG_VERSION,
+        .header_bytes = sizeof(imu_log_header_t),
+        .odr_hz = IMU_ODR_HZ,
+        .acc_lsb_per_g = IMU_ACC_LSB_PER_G,
+        .gyr_lsb_per_dps = IMU_GYR_LSB_PER_DPS,
+        .sample_bytes = QMI8658_SAMPLE_BYTES,
+        .start_us = esp_timer_get_time(),
+        .start_unix = now,
+    };
+    return sd_writer_write(s_writer, &h, sizeof(h));
+}
+
+esp_err_t imu_log_start(void)
+{
+    if (s_api_lock == NULL)
+    {
+        s_api_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(s_api_lock, ESP_ERR_NO_MEM, TAG, "no memory");
+    }
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (s_active)
+    {
+        goto out;
+    }
+    ret = ESP_ERR_NO_MEM;
+    s_ring = heap_caps_malloc(IMU_LOG_RING_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_collected = xSemaphoreCreateBinary();
+    s_done = xSemaphoreCreateBinary();
+    if (!s_ring || !s_collected || !s_done)
+    {
+        ESP_LOGE(TAG, "logger buffers alloc failed");
+        log_free();
+        goto out;
+    }
+    ret = log_open();
+    if (ret != ESP_OK)
+    {
+        if (s_writer)
+        {
+            sd_writer_abort(s_writer);
+            s_writer = NULL;
+        }
+        log_free();
+        goto out;
+    }
+
+    s_head = 0;
+    s_tail = 0;
+    s_started = false;
+    s_stopping = false;
+    s_flush = false;
+    s_write_failed = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_t_start = esp_timer_get_time();
+    s_cursor = imu_head();              // 从现在开始 之前的不要
+    ret = ESP_FAIL;
+    if (task_plan_create(TASK_IMU_LOG_WR, write_task, NULL, &s_write_task) != pdPASS)
+    {
+        sd_writer_abort(s_writer);
+        s_writer = NULL;
+        log_free();
+        goto out;
+    }
+    if (task_plan_create(TASK_IMU_LOG, collect_task, NULL, &s_collect_task) != pdPASS)
+    {
+        s_flush = true;
+        xTaskNotifyGive(s_write_task);
+        xSemaphoreTake(s_done, portMAX_DELAY);
+        sd_writer_abort(s_writer);
+        s_writer = NULL;
+        log_free();
+        goto out;
+    }
+    imu_add_listener(s_collect_task);
+    s_active = true;
+    ret = ESP_OK;
+out:
+    xSemaphoreGive(s_api_lock);
+    return ret;
+}
+
+bool imu_log_active(void)
+{
+    return s_active;
+}
+
+esp_err_t imu_log_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_api_lock, ESP_ERR_INVALID_STATE, TAG, "not logging");
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    if (!s_active)
+    {
+        xSemaphoreGive(s_api_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    imu_remove_listener(s_collect_task);
+    s_stopping = true;
+    xTaskNotifyGive(s_collect_task);
+    xSemaphoreTake(s_collected, portMAX_DELAY);
+    s_flush = true;
+    xTaskNotifyGive(s_write_task);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    s_active = false;
+
+    // 环已经写空 结束记录直接交给写卡模块
+    imu_log_rec_t rec = {
+        .type = IMU_LOG_REC_END,
+        .ts = s_next_file,
+        .t_us = esp_timer_get_time(),
+    };
+    imu_log_end_t end = {
+        .samples = s_stats.samples,
+        .lost_fifo = s_stats.lost_fifo,
+        .lost_ring = s_stats.lost_ring,
+        .lost_buf = s_stats.lost_buf,
+    };
+    bool ok = !s_write_failed && sd_writer_write(s_writer, &rec, sizeof(rec)) == ESP_OK &&
+              sd_writer_write(s_writer, &end, sizeof(end)) == ESP_OK;
+    ok = sd_writer_close(s_writer) == ESP_OK && ok;
+    s_writer = NULL;
+    log_free();
+    ESP_LOGI(TAG, "%s: %lu samples in %lu records, %llu KB, lost %lu fifo / %lu ring / %lu buffer, ring peak %lu KB%s",
+             s_path, (unsigned long)s_stats.samples, (unsigned long)s_stats.records,
+             (unsigned long long)(s_stats.bytes / 1024), (unsigned long)s_stats.lost_fifo,
+             (unsigned long)s_stats.lost_ring, (unsigned long)s_stats.lost_buf,
+             (unsigned long)(s_stats.ring_peak / 1024), ok ? "" : ", write failed");
+    xSemaphoreGive(s_api_lock);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+void imu_log_get_stats(imu_log_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
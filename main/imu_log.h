@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 姿态传感器原始数据记录 ****************************/
+// 做振动分析用 采样任务读出来的每一组加速度和陀螺仪原样记到卡上 按FIFO的速率 一组不少
+// 收集任务每批通知一次 从采样环里按自己的游标拷出来 拼成记录放进PSRAM里的环 不碰卡
+// 写盘任务攒够一块交给写卡模块(sd_writer) 它的两块缓冲轮着从扇区边界整块写
+// 卡偶尔卡住几百毫秒也只是环里多积压一些 环放不下才丢 丢的组数按原因分开计
+// 样本编号用QMI8658的TIMESTAMP(芯片的采样计数) 不是主机读的时刻 有没有丢一看编号就知道
+//
+// 文件格式 全部小端 解码脚本见tools/imu_log/imu_log_decode.py:
+//   imu_log_header_t 64字节
+//   之后是一条接一条的记录 每条先是imu_log_rec_t 16字节
+//     IMU_LOG_REC_SAMPLES: 后面count组 每组12字节 int16 ax ay az gx gy gz 编号从ts起连续
+//     IMU_LOG_REC_END:     停止时写 后面是imu_log_end_t 没有它说明没正常停止 前面的记录照样能读
+//   加速度除以acc_lsb_per_g是g 陀螺仪除以gyr_lsb_per_dps是度每秒
+
+#define IMU_LOG_DIR             SD_MOUNT_POINT"/imu"
+#define IMU_LOG_MAGIC           "QIMU"
+#define IMU_LOG_VERSION         1
+#define IMU_LOG_RING_BYTES      (CONFIG_APP_IMU_LOG_RING_KB * 1024)
+#define IMU_LOG_PREALLOC_BYTES  (CONFIG_APP_IMU_LOG_PREALLOC_MB * 1024 * 1024)
+
+typedef enum {
+    IMU_LOG_REC_SAMPLES = 1,
+    IMU_LOG_REC_END = 2,
+} imu_log_rec_type_t;
+
+typedef struct __attribute__((packed)) {
+    char magic[4];                      // IMU_LOG_MAGIC
+    uint16_t version;
+    uint16_t header_bytes;              // 这个头的大小 记录从这里开始
+    uint16_t odr_hz;                    // 标称ODR
+    uint16_t acc_lsb_per_g;
+    uint16_t gyr_lsb_per_dps;
+    uint16_t sample_bytes;              // 12
+    int64_t start_us;                   // 开始时的esp_timer
+    int64_t start_unix;                 // 开始时的time() 没对过时间就是开机以来的秒数
+    uint8_t reserved[32];
+} imu_log_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;                       // imu_log_rec_type_t
+    uint8_t count;                      // 样本组数 END是0
+    uint16_t lost;                      // 这条和上一条之间没进文件的组数 超过65535记65535
+    uint32_t ts;                        // 第一组的芯片采样计数 已经展开成32位
+    int64_t t_us;                       // 第一组的时刻 esp_timer
+} imu_log_rec_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t samples;                   // 写进文件的组数
+    uint32_t lost_fifo;                 // 芯片FIFO溢出丢的 采样任务读晚了
+    uint32_t lost_ring;                 // 采样环里被覆盖的 收集任务读晚了
+    uint32_t lost_buf;                  // PSRAM环满了丢的 卡写得太慢
+} imu_log_end_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t records;
+    uint32_t lost_fifo;
+    uint32_t lost_ring;
+    uint32_t lost_buf;
+    uint64_t bytes;                     // 交给写卡模块的
+    uint32_t ring_peak;                 // 环里最多积压的字节
+    uint32_t max_write_us;              // 最慢的一次写 两块缓冲都在写时包括等待
+    int64_t duration_us;
+} imu_log_stats_t;
+
+esp_err_t imu_log_start(void);          // imu_start之后调用 在IMU_LOG_DIR下新建imu_MMDD_HHMMSS.bin
+bool imu_log_active(void);
+esp_err_t imu_log_stop(void);           // 把环里的写完 补上结束记录 会阻塞 imu_stop之前调用
+void imu_log_get_stats(imu_log_stats_t *stats); // 记录的时候也可以调用
@@ -0,0 +1,919 @@
+#include <stdlib.h>
+#include <string.h>
+#include "intercom.h"
+#include "audio_adpcm.h"
+#include "audio_pcm.h"
+#include "voice_cmd.h"
+#include "pic_jpeg.h"
+#include "ui_msg.h"
+#include "task_plan.h"
+#include "wifi_svc.h"
+#include "lvgl.h"
+#include "lwip/sockets.h"
+#include "esp_wifi.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#if CONFIG_APP_INTERCOM
+
+static const char *TAG = "intercom";
+
+#define IC_MAGIC        0x4349  // "IC"
+#define IC_PKT_HELLO    1
+#define IC_PKT_PING     2
+#define IC_PKT_PONG     3
+#define IC_PKT_AUDIO    4
+#define IC_PKT_REPORT   5
+#define IC_PKT_VIDEO    6
+#define IC_AUDIO_BYTES  ADPCM_FRAME_BYTES(INTERCOM_FRAME_SAMPLES)
+#define IC_FRAME_US     (INTERCOM_FRAME_MS * 1000)
+#define IC_TICK_MS      50      // 收包超时 定时发的包按这个粒度
+#define IC_FILTER       16      // 抖动和延迟的一阶滤波
+#define IC_VIDEO_BURST  8       // 连着发这么多片让一个tick 声音的包能插进WiFi的队列
+#define IC_TOS_VOICE    0xb8    // DSCP EF WMM按语音排
+#define IC_TOS_VIDEO    0x88    // DSCP AF41 按视频排
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t session;                   // 每次开机随机取 对方重启了能认出来
+} ic_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    ic_hdr_t h;
+    int64_t t1;                         // 发ping的本地时刻 pong原样带回来
+    int64_t t2;                         // pong: 对方收到ping时的时钟
+} ic_ping_t;
+
+typedef struct __attribute__((packed)) {
+    ic_hdr_t h;
+    uint32_t seq;
+    int64_t cap_us;                     // 发送端时钟上第一个样本的录音时刻
+    uint8_t data[IC_AUDIO_BYTES];
+} ic_audio_t;
+
+typedef struct __attribute__((packed)) {
+    ic_hdr_t h;
+    uint32_t video_rx;                  // 收端开机以后的累计 发送端看和上一次的差
+    uint32_t video_incomplete;
+} ic_report_t;
+
+typedef struct __attribute__((packed)) {
+    ic_hdr_t h;
+    uint32_t frame;
+    int64_t cap_us;                     // 发送端时钟上的出帧时刻
+    uint32_t len;                       // 整帧字节数
+    uint32_t off;                       // 这一片在帧里的位置 INTERCOM_VIDEO_FRAG的整数倍
+    uint8_t data[];
+} ic_video_t;
+
+#define IC_VIDEO_PKT    (sizeof(ic_video_t) + INTERCOM_VIDEO_FRAG)
+
+// 识别任务攒够一包交给发送任务
+typedef struct {
+    int64_t cap_us;
+    int16_t pcm[INTERCOM_FRAME_SAMPLES];
+} ic_tx_frame_t;
+
+typedef struct {
+    bool used;
+    uint32_t seq;
+    int64_t cap_us;
+    uint8_t data[IC_AUDIO_BYTES];
+} ic_slot_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static intercom_stats_t s_stats;
+static int s_sock = -1;                 // 声音和控制
+static int s_vsock = -1;                // 画面
+static uint32_t s_session;
+static uint32_t s_cfg_peer;             // Kconfig里写的对方 网络字节序 0是自动
+static volatile uint32_t s_peer_ip;     // 网络字节序 0是还没有对方
+static volatile uint32_t s_peer_session;
+static int64_t s_last_rx;               // 最后一次收到对方的包 只在网络任务里用
+static volatile bool s_in_call;
+static QueueHandle_t s_tx_q;
+static TaskHandle_t s_vtx_task;
+// 时钟 只在网络任务里写
+static int64_t s_clk_rtt[INTERCOM_CLOCK_WINDOW];
+static int64_t s_clk_off[INTERCOM_CLOCK_WINDOW];
+static int s_clk_n;
+static int s_clk_pos;
+static volatile int64_t s_offset;       // 对方时钟减本地
+static volatile bool s_clock_ok;
+static uint32_t s_rep_rx;               // 对方上一次报的累计
+static uint32_t s_rep_inc;
+static bool s_rep_have;
+// 录音 只在识别任务里用
+static ic_tx_frame_t s_acc;
+static size_t s_acc_n;
+// 抖动缓冲 s_lock管着
+static ic_slot_t s_jb[INTERCOM_JB_SLOTS];
+static bool s_jb_started;               // 定下了从哪个序号放
+static bool s_playing;                  // 混音器里在一段接一段地放
+static uint32_t s_play_seq;             // 下一个要放的
+static uint32_t s_max_seq;              // 收到过的最大序号
+static int s_target = 1;                // 目标深度 包数
+static uint8_t s_buf_busy;              // 排在混音器里的播放缓冲 按位
+static int64_t s_transit;               // 上一包的到达减录音 算抖动用
+static int64_t s_jitter;
+// 播放 只在送数任务里用
+static int16_t s_play_pcm[INTERCOM_PLAY_AHEAD][INTERCOM_FRAME_SAMPLES];
+static int16_t s_last_pcm[INTERCOM_FRAME_SAMPLES];
+static int s_conceal;                   // 连着补了几段
+static int64_t s_m2e;
+// 画面发送
+static uint8_t *s_vtx_buf;              // PSRAM 摄像头任务拷进来 发送任务发完清s_vtx_busy
+static volatile size_t s_vtx_len;
+static volatile int64_t s_vtx_cap;
+static volatile bool s_vtx_busy;
+static int64_t s_vtx_last;
+static volatile int s_fps = INTERCOM_VIDEO_FPS;
+// 画中画 两块轮着解 显示着的那块解码任务不碰
+static uint16_t *s_pip_buf[2];
+static int64_t s_pip_cap[2];
+static volatile int s_pip_shown = 1;
+static volatile bool s_pip_pending;     // 解好了等LVGL任务换上去
+static lv_obj_t *s_pip;
+static lv_img_dsc_t s_pip_dsc;
+static int64_t s_pip_draw_cap;          // 换上去的那帧的出帧时刻 画完算镜头到屏 LVGL任务里用
+static int64_t s_g2g;
+
+#define STAT_ADD(field, n)  do { portENTER_CRITICAL(&s_lock); s_stats.field += (n); portEXIT_CRITICAL(&s_lock); } while (0)
+
+static void ic_hdr(ic_hdr_t *h, uint8_t type)
+{
+    h->magic = IC_MAGIC;
+    h->type = type;
+    h->flags = 0;
+    h->session = s_session;
+}
+
+static bool ic_sendto(int sock, const void *pkt, size_t len, uint32_t ip, uint16_t port)
+{
+    struct sockaddr_in to = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = ip,
+    };
+    return ip && sendto(sock, pkt, len, MSG_DONTWAIT, (struct sockaddr *)&to, sizeof(to)) == (int)len;
+}
+
+static bool ic_send(const void *pkt, size_t len)
+{
+    return ic_sendto(s_sock, pkt, len, s_peer_ip, INTERCOM_PORT);
+}
+
+// 滤波以后的值和最大值 第一次直接取
+static void ic_latency(int64_t *filt, int64_t us, uint32_t *ms, uint32_t *max_ms)
+{
+    *filt = *filt ? *filt + (us - *filt) / IC_FILTER : us;
+    portENTER_CRITICAL(&s_lock);
+    *ms = *filt / 1000;
+    if (us / 1000 > *max_ms)
+    {
+        *max_ms = us / 1000;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/*********************** 声音发送 ****************************/
+
+// 在识别任务里 一块512帧左右 切成20ms一包 rec_t是这一块最后一个样本的时刻
+static void ic_afe_tap(const int16_t *pcm, size_t frames, int64_t rec_t)
+{
+    for (size_t i = 0; i < frames;)
+    {
+        if (s_acc_n == 0)
+        {
+            s_acc.cap_us = rec_t - (int64_t)(frames - i) * 1000000 / INTERCOM_RATE;
+        }
+        size_t n = frames - i < INTERCOM_FRAME_SAMPLES - s_acc_n ? frames - i : INTERCOM_FRAME_SAMPLES - s_acc_n;
+        memcpy(s_acc.pcm + s_acc_n, pcm + i, n * sizeof(int16_t));
+        s_acc_n += n;
+        i += n;
+        if (s_acc_n == INTERCOM_FRAME_SAMPLES)
+        {
+            s_acc_n = 0;
+            if (xQueueSend(s_tx_q, &s_acc, 0) != pdTRUE)
+            {
+                STAT_ADD(audio_tx_dropped, 1);
+            }
+        }
+    }
+}
+
+static void ic_tx_task(void *arg)
+{
+    ic_tx_frame_t f;
+    ic_audio_t a;
+    audio_adpcm_t st;
+    audio_adpcm_init(&st);
+    uint32_t seq = 0;
+    for (;;)
+    {
+        xQueueReceive(s_tx_q, &f, portMAX_DELAY);
+        if (!s_in_call)
+        {
+            continue;
+        }
+        ic_hdr(&a.h, IC_PKT_AUDIO);
+        a.seq = seq++;
+        a.cap_us = f.cap_us;
+        audio_adpcm_encode_frame(&st, f.pcm, INTERCOM_FRAME_SAMPLES, a.data);
+        if (ic_send(&a, sizeof(a)))
+        {
+            STAT_ADD(audio_tx, 1);
+        }
+        else
+        {
+            STAT_ADD(audio_tx_dropped, 1);
+        }
+    }
+}
+
+/*********************** 抖动缓冲和播放 ****************************/
+
+// s_lock里调 停下来 在混音器里的几段放完就不再接
+static void jb_reset_locked(void)
+{
+    for (int i = 0; i < INTERCOM_JB_SLOTS; i++)
+    {
+        s_jb[i].used = false;
+    }
+    s_jb_started = false;
+    s_playing = false;
+}
+
+// 一段放完 在送数任务里 解下一包接上 这里不能阻塞
+static void ic_play_done(void *arg)
+{
+    int b = (int)(intptr_t)arg;
+    int16_t *pcm = s_play_pcm[b];
+    uint8_t data[IC_AUDIO_BYTES];
+    int64_t cap = 0;
+    bool got = false;
+    bool lost = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_playing)
+    {
+        ic_slot_t *sl = &s_jb[s_play_seq & (INTERCOM_JB_SLOTS - 1)];
+        got = sl->used && sl->seq == s_play_seq;
+        lost = !got && (int32_t)(s_max_seq - s_play_seq) > 0;
+        if (got)
+        {
+            memcpy(data, sl->data, sizeof(data));
+            cap = sl->cap_us;
+            sl->used = false;
+            s_play_seq++;
+            // 攒多了丢一包 延迟追回到目标附近
+            if ((int32_t)(s_max_seq - s_play_seq) + 1 > s_target + INTERCOM_JB_SLACK)
+            {
+                s_jb[s_play_seq & (INTERCOM_JB_SLOTS - 1)].used = false;
+                s_play_seq++;
+                s_stats.audio_skipped++;
+            }
+        }
+        else if (lost)
+        {
+            s_play_seq++;
+            s_stats.audio_lost++;
+        }
+        else
+        {
+            s_playing = false;          // 欠载 攒够目标深度再从网络任务里开始
+            s_stats.underruns++;
+        }
+        int32_t depth = (int32_t)(s_max_seq - s_play_seq) + 1;
+        s_stats.depth_ms = depth > 0 ? depth * INTERCOM_FRAME_MS : 0;
+    }
+    bool play = s_playing;
+    if (!play)
+    {
+        s_buf_busy &= ~(1 << b);
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!play)
+    {
+        s_conceal = 0;
+        return;
+    }
+
+    if (got)
+    {
+        audio_adpcm_decode_frame(data, pcm, INTERCOM_FRAME_SAMPLES);
+        memcpy(s_last_pcm, pcm, sizeof(s_last_pcm));
+        s_conceal = 0;
+    }
+    else if (s_conceal++ == 0)
+    {
+        for (int i = 0; i < INTERCOM_FRAME_SAMPLES; i++)
+        {
+            pcm[i] = s_last_pcm[i] >> 1;
+        }
+    }
+    else
+    {
+        memset(pcm, 0, INTERCOM_FRAME_SAMPLES * sizeof(int16_t));
+    }
+    if (got && s_clock_ok)
+    {
+        int64_t ear = esp_timer_get_time() + (INTERCOM_PLAY_AHEAD - 1) * IC_FRAME_US + audio_pcm_output_delay_us();
+        ic_latency(&s_m2e, ear - (cap - s_offset), &s_stats.m2e_ms, &s_stats.m2e_max_ms);
+    }
+    if (audio_pcm_play(AUDIO_PCM_SRC_CALL, pcm, INTERCOM_FRAME_SAMPLES, INTERCOM_RATE, ic_play_done, arg) != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_buf_busy &= ~(1 << b);
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+// 攒够了 先排几段静音 之后每段放完的回调去取包 解码只在送数任务里做
+static void ic_play_start(void)
+{
+    for (int b = 0; b < INTERCOM_PLAY_AHEAD; b++)
+    {
+        memset(s_play_pcm[b], 0, sizeof(s_play_pcm[b]));
+        if (audio_pcm_play(AUDIO_PCM_SRC_CALL, s_play_pcm[b], INTERCOM_FRAME_SAMPLES, INTERCOM_RATE,
+                           ic_play_done, (void *)(intptr_t)b) != ESP_OK)
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_buf_busy &= ~(1 << b);
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+}
+
+// 在网络任务里 按序号放进槽 更新抖动估计和目标深度
+static void ic_audio_rx(const ic_audio_t *a, int64_t rx_us)
+{
+    int64_t transit = rx_us - a->cap_us;    // 两边时钟不同 只看前后两包的差
+    bool start = false;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.audio_rx++;
+    if (s_jb_started)
+    {
+        int64_t d = transit - s_transit;
+        s_jitter += ((d < 0 ? -d : d) - s_jitter) / IC_FILTER;
+    }
+    s_transit = transit;
+    int32_t rel = (int32_t)(a->seq - s_play_seq);
+    if (!s_jb_started || rel >= INTERCOM_JB_SLOTS)
+    {
+        // 第一包 或者断了很久 从这一包重新攒
+        jb_reset_locked();
+        s_jb_started = true;
+        s_play_seq = a->seq;
+        s_max_seq = a->seq;
+        rel = 0;
+    }
+    if (rel < 0)
+    {
+        s_stats.audio_late++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    ic_slot_t *sl = &s_jb[a->seq & (INTERCOM_JB_SLOTS - 1)];
+    sl->used = true;
+    sl->seq = a->seq;
+    sl->cap_us = a->cap_us;
+    memcpy(sl->data, a->data, sizeof(sl->data));
+    if ((int32_t)(a->seq - s_max_seq) > 0)
+    {
+        s_max_seq = a->seq;
+    }
+    int64_t target_us = 2 * s_jitter + IC_FRAME_US;
+    if (target_us < INTERCOM_JITTER_MIN_MS * 1000LL)
+    {
+        target_us = INTERCOM_JITTER_MIN_MS * 1000LL;
+    }
+    if (target_us > INTERCOM_JITTER_MAX_MS * 1000LL)
+    {
+        target_us = INTERCOM_JITTER_MAX_MS * 1000LL;
+    }
+    s_target = (target_us + IC_FRAME_US - 1) / IC_FRAME_US;
+    s_stats.jitter_us = s_jitter;
+    s_stats.target_ms = s_target * INTERCOM_FRAME_MS;
+    int32_t depth = (int32_t)(s_max_seq - s_play_seq) + 1;
+    if (!s_playing && s_buf_busy == 0 && depth >= s_target)
+    {
+        start = true;
+        s_playing = true;
+        s_buf_busy = (1 << INTERCOM_PLAY_AHEAD) - 1;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (start)
+    {
+        ic_play_start();
+    }
+}
+
+/*********************** 画面 ****************************/
+
+static void ic_fps_adjust(bool congested)
+{
+    portENTER_CRITICAL(&s_lock);
+    int fps = congested ? s_fps / 2 : s_fps + 1;
+    s_fps = fps < INTERCOM_VIDEO_MIN_FPS ? INTERCOM_VIDEO_MIN_FPS : fps > INTERCOM_VIDEO_FPS ? INTERCOM_VIDEO_FPS : fps;
+    s_stats.video_fps = s_fps;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void intercom_video_frame(const camera_fb_t *frame)
+{
+    if (!s_in_call || s_vtx_task == NULL || frame->format != PIXFORMAT_JPEG)
+    {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (now - s_vtx_last < 1000000 / s_fps)
+    {
+        return;
+    }
+    s_vtx_last = now;
+    if (s_vtx_busy || frame->len > INTERCOM_VIDEO_MAX)
+    {
+        STAT_ADD(video_tx_dropped, 1);
+        return;
+    }
+    memcpy(s_vtx_buf, frame->buf, frame->len);
+    s_vtx_len = frame->len;
+    s_vtx_cap = (int64_t)frame->timestamp.tv_sec * 1000000 + frame->timestamp.tv_usec;
+    s_vtx_busy = true;
+    xTaskNotifyGive(s_vtx_task);
+}
+
+// 一帧切片发 发不出去就丢掉剩下的 帧率减半
+static void ic_vtx_task(void *arg)
+{
+    ic_video_t *v = malloc(IC_VIDEO_PKT);
+    uint32_t frame = 0;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        size_t len = s_vtx_len;
+        bool ok = v != NULL;
+        int k = 0;
+        for (size_t off = 0; ok && off < len; off += INTERCOM_VIDEO_FRAG)
+        {
+            size_t n = len - off < INTERCOM_VIDEO_FRAG ? len - off : INTERCOM_VIDEO_FRAG;
+            ic_hdr(&v->h, IC_PKT_VIDEO);
+            v->frame = frame;
+            v->cap_us = s_vtx_cap;
+            v->len = len;
+            v->off = off;
+            memcpy(v->data, s_vtx_buf + off, n);
+            ok = ic_sendto(s_vsock, v, sizeof(*v) + n, s_peer_ip, INTERCOM_PORT + 1);
+            if (++k % IC_VIDEO_BURST == 0)
+            {
+                vTaskDelay(1);
+            }
+        }
+        frame++;
+        if (ok)
+        {
+            STAT_ADD(video_tx, 1);
+        }
+        else
+        {
+            STAT_ADD(video_tx_dropped, 1);
+            ic_fps_adjust(true);
+        }
+        s_vtx_busy = false;
+    }
+}
+
+// 在LVGL任务里 画中画画完了 这一帧从出帧到进显存
+static void ic_pip_draw_cb(lv_event_t *e)
+{
+    if (s_pip_draw_cap == 0 || !s_clock_ok)
+    {
+        return;
+    }
+    int64_t g2g = esp_timer_get_time() - (s_pip_draw_cap - s_offset);
+    s_pip_draw_cap = 0;
+    ic_latency(&s_g2g, g2g, &s_stats.g2g_ms, &s_stats.g2g_max_ms);
+}
+
+static void ic_pip_show(void *arg)
+{
+    int idx = (int)(intptr_t)arg;
+    if (s_in_call)
+    {
+        if (s_pip == NULL)
+        {
+            s_pip_dsc.header.always_zero = 0;
+            s_pip_dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+            s_pip_dsc.header.w = INTERCOM_PIP_W;
+            s_pip_dsc.header.h = INTERCOM_PIP_H;
+            s_pip_dsc.data_size = INTERCOM_PIP_W * INTERCOM_PIP_H * sizeof(lv_color_t);
+            s_pip = lv_img_create(lv_layer_top());
+            lv_obj_align(s_pip, LV_ALIGN_TOP_RIGHT, -4, 4);
+            lv_obj_add_event_cb(s_pip, ic_pip_draw_cb, LV_EVENT_DRAW_POST_END, NULL);
+        }
+        s_pip_shown = idx;
+        s_pip_dsc.data = (const uint8_t *)s_pip_buf[idx];
+        lv_img_set_src(s_pip, &s_pip_dsc);
+        lv_obj_invalidate(s_pip);       // 同一个dsc换了数据 要自己标脏
+        s_pip_draw_cap = s_pip_cap[idx];
+        STAT_ADD(video_shown, 1);
+    }
+    s_pip_pending = false;
+}
+
+static void ic_pip_hide(void *arg)
+{
+    if (s_pip)
+    {
+        lv_obj_del(s_pip);
+        s_pip = NULL;
+    }
+}
+
+// 核1 收片拼帧 拼齐了解进没在显示的那块
+static void ic_vrx_task(void *arg)
+{
+    uint8_t *pkt = malloc(IC_VIDEO_PKT);
+    uint8_t *jpg = heap_caps_malloc(INTERCOM_VIDEO_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    void *work = heap_caps_malloc(PIC_JPEG_WORK_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    for (int i = 0; i < 2; i++)
+    {
+        s_pip_buf[i] = heap_caps_malloc(INTERCOM_PIP_W * INTERCOM_PIP_H * sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+    }
+    if (pkt == NULL || jpg == NULL || work == NULL || s_pip_buf[0] == NULL || s_pip_buf[1] == NULL)
+    {
+        ESP_LOGE(TAG, "no mem for video receive, audio only");
+        vTaskDelete(NULL);
+    }
+    const ic_video_t *v = (const ic_video_t *)pkt;
+    uint32_t session = 0;
+    uint32_t cur = 0;
+    uint32_t len = 0;
+    int64_t cap = 0;
+    uint64_t got = 0, need = 0;
+    bool have = false;                  // 在拼cur这一帧
+    bool done = false;                  // cur已经拼齐 后来的重复片不再管
+    for (;;)
+    {
+        int n = recv(s_vsock, pkt, IC_VIDEO_PKT, 0);
+        if (n <= (int)sizeof(ic_video_t) || v->h.magic != IC_MAGIC || v->h.type != IC_PKT_VIDEO || !s_in_call ||
+            v->h.session != s_peer_session)
+        {
+            continue;
+        }
+        size_t dn = n - sizeof(ic_video_t);
+        if (v->len == 0 || v->len > INTERCOM_VIDEO_MAX || v->off % INTERCOM_VIDEO_FRAG || v->off + dn > v->len ||
+            dn > INTERCOM_VIDEO_FRAG)
+        {
+            continue;
+        }
+        if (v->h.session != session)
+        {
+            session = v->h.session;     // 对方重启过 帧号重新算
+            have = false;
+        }
+        if (!have || v->frame != cur)
+        {
+            if (have && (int32_t)(v->frame - cur) < 0)
+            {
+                continue;               // 上一帧迟到的片
+            }
+            if (have && !done)
+            {
+                STAT_ADD(video_incomplete, 1);
+            }
+            have = true;
+            done = false;
+            cur = v->frame;
+            len = v->len;
+            cap = v->cap_us;
+            got = 0;
+            int frags = (len + INTERCOM_VIDEO_FRAG - 1) / INTERCOM_VIDEO_FRAG;
+            need = frags == 64 ? UINT64_MAX : (1ULL << frags) - 1;
+        }
+        if (done || v->len != len)
+        {
+            continue;
+        }
+        memcpy(jpg + v->off, v->data, dn);
+        got |= 1ULL << (v->off / INTERCOM_VIDEO_FRAG);
+        if (got != need)
+        {
+            continue;
+        }
+        done = true;
+        STAT_ADD(video_rx, 1);
+        if (s_pip_pending)
+        {
+            STAT_ADD(video_dropped, 1);
+            continue;
+        }
+        int idx = s_pip_shown ^ 1;
+        pic_jpeg_info_t info;
+        if (!pic_jpeg_decode_frame(jpg, len, INTERCOM_PIP_W, INTERCOM_PIP_H, (lv_color_t *)s_pip_buf[idx], work, &info))
+        {
+            STAT_ADD(video_dropped, 1);
+            continue;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.decode_us = info.decode_us;
+        portEXIT_CRITICAL(&s_lock);
+        s_pip_cap[idx] = cap;
+        s_pip_pending = true;
+        if (!ui_post_call(ic_pip_show, (void *)(intptr_t)idx))
+        {
+            s_pip_pending = false;
+            STAT_ADD(video_dropped, 1);
+        }
+    }
+}
+
+/*********************** 控制 ****************************/
+
+// 往返最快的那次两个方向最对称 它的时钟差最准
+static void ic_clock_sample(int64_t t1, int64_t t2, int64_t t3)
+{
+    int64_t rtt = t3 - t1;
+    if (rtt < 0 || rtt > INTERCOM_TIMEOUT_MS * 1000LL)
+    {
+        return;
+    }
+    s_clk_rtt[s_clk_pos] = rtt;
+    s_clk_off[s_clk_pos] = t2 - (t1 + t3) / 2;
+    s_clk_pos = (s_clk_pos + 1) % INTERCOM_CLOCK_WINDOW;
+    if (s_clk_n < INTERCOM_CLOCK_WINDOW)
+    {
+        s_clk_n++;
+    }
+    int best = 0;
+    for (int i = 1; i < s_clk_n; i++)
+    {
+        if (s_clk_rtt[i] < s_clk_rtt[best])
+        {
+            best = i;
+        }
+    }
+    s_offset = s_clk_off[best];
+    s_clock_ok = true;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.clock_offset_us = s_clk_off[best];
+    s_stats.rtt_us = s_clk_rtt[best];
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 对方报的画面收得怎么样 有不全的帧就是路上堵了
+static void ic_report_rx(const ic_report_t *r)
+{
+    uint32_t rx = r->video_rx - s_rep_rx;
+    uint32_t inc = r->video_incomplete - s_rep_inc;
+    s_rep_rx = r->video_rx;
+    s_rep_inc = r->video_incomplete;
+    if (!s_rep_have)
+    {
+        s_rep_have = true;
+        return;
+    }
+    if (inc)
+    {
+        ic_fps_adjust(true);
+    }
+    else if (rx)
+    {
+        ic_fps_adjust(false);
+    }
+}
+
+static void ic_call_begin(void)
+{
+    s_clk_n = 0;
+    s_clk_pos = 0;
+    s_clock_ok = false;
+    s_rep_have = false;
+    s_m2e = 0;
+    s_g2g = 0;
+    portENTER_CRITICAL(&s_lock);
+    s_fps = INTERCOM_VIDEO_FPS;
+    s_stats.video_fps = s_fps;
+    s_stats.calls++;
+    s_stats.in_call = true;
+    portEXIT_CRITICAL(&s_lock);
+    s_in_call = true;
+    esp_wifi_set_ps(WIFI_PS_NONE);  // 省电时收包要等信标 多几十到上百毫秒
+    if (voice_cmd_set_afe_tap(ic_afe_tap) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "AFE output not available, receive only");
+    }
+    struct in_addr a = {.s_addr = s_peer_ip};
+    ESP_LOGI(TAG, "call with %s", inet_ntoa(a));
+}
+
+static void ic_call_end(void)
+{
+    s_in_call = false;
+    voice_cmd_set_afe_tap(NULL);
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    portENTER_CRITICAL(&s_lock);
+    jb_reset_locked();
+    s_stats.in_call = false;
+    portEXIT_CRITICAL(&s_lock);
+    ui_post_call(ic_pip_hide, NULL);
+    s_last_rx = 0;
+    s_peer_ip = s_cfg_peer;
+    ESP_LOGI(TAG, "call ended");
+}
+
+static void ic_handle(const uint8_t *pkt, int n, uint32_t ip, int64_t now)
+{
+    const ic_hdr_t *h = (const ic_hdr_t *)pkt;
+    if (n < (int)sizeof(ic_hdr_t) || h->magic != IC_MAGIC || h->session == s_session)
+    {
+        return;                         // 自己的广播也会收到
+    }
+    if (s_peer_ip == 0 && (h->type == IC_PKT_HELLO || h->type == IC_PKT_PING))
+    {
+        s_peer_ip = ip;                 // 自动接听
+    }
+    if (ip != s_peer_ip)
+    {
+        return;                         // 通话中别人的招呼不理
+    }
+    if (h->session != s_peer_session)
+    {
+        s_peer_session = h->session;    // 对方重启了 序号重新来
+        portENTER_CRITICAL(&s_lock);
+        jb_reset_locked();
+        portEXIT_CRITICAL(&s_lock);
+    }
+    s_last_rx = now;
+    switch (h->type)
+    {
+    case IC_PKT_PING:
+        if (n == sizeof(ic_ping_t))
+        {
+            ic_ping_t p = *(const ic_ping_t *)pkt;
+            ic_hdr(&p.h, IC_PKT_PONG);
+            p.t2 = now;
+            ic_send(&p, sizeof(p));
+        }
+        break;
+    case IC_PKT_PONG:
+        if (n == sizeof(ic_ping_t))
+        {
+            const ic_ping_t *p = (const ic_ping_t *)pkt;
+            ic_clock_sample(p->t1, p->t2, now);
+        }
+        break;
+    case IC_PKT_AUDIO:
+        if (n == sizeof(ic_audio_t) && s_in_call)
+        {
+            ic_audio_rx((const ic_audio_t *)pkt, now);
+        }
+        break;
+    case IC_PKT_REPORT:
+        if (n == sizeof(ic_report_t))
+        {
+            ic_report_rx((const ic_report_t *)pkt);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static int ic_bind(uint16_t port, int tos)
+{
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s < 0)
+    {
+        return -1;
+    }
+    struct sockaddr_in a = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    setsockopt(s, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+    if (bind(s, (struct sockaddr *)&a, sizeof(a)) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+// 等连上WiFi开两个端口 然后在这里收声音和控制包 定时发招呼 ping和画面报告
+static void ic_net_task(void *arg)
+{
+    while (!wifi_svc_wait_connected(60000))
+    {
+    }
+    s_sock = ic_bind(INTERCOM_PORT, IC_TOS_VOICE);
+    s_vsock = ic_bind(INTERCOM_PORT + 1, IC_TOS_VIDEO);
+    if (s_sock < 0 || s_vsock < 0)
+    {
+        ESP_LOGE(TAG, "cannot bind UDP %d/%d", INTERCOM_PORT, INTERCOM_PORT + 1);
+        vTaskDelete(NULL);
+    }
+    int on = 1;
+    setsockopt(s_sock, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+    struct timeval tv = {.tv_sec = 0, .tv_usec = IC_TICK_MS * 1000};
+    setsockopt(s_sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (task_plan_create(TASK_INTERCOM_TX, ic_tx_task, NULL, NULL) != pdPASS ||
+        task_plan_create(TASK_INTERCOM_VTX, ic_vtx_task, NULL, &s_vtx_task) != pdPASS ||
+        task_plan_create(TASK_INTERCOM_VRX, ic_vrx_task, NULL, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "create tasks failed");
+    }
+    ESP_LOGI(TAG, "listening on UDP %d/%d, %s", INTERCOM_PORT, INTERCOM_PORT + 1,
+             s_cfg_peer ? "calling " CONFIG_APP_INTERCOM_PEER : "answering any board");
+
+    uint8_t pkt[sizeof(ic_audio_t) + 16];
+    int64_t last_hello = 0, last_ping = 0, last_report = 0;
+    for (;;)
+    {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(s_sock, pkt, sizeof(pkt), 0, (struct sockaddr *)&from, &from_len);
+        int64_t now = esp_timer_get_time();
+        if (n > 0)
+        {
+            ic_handle(pkt, n, from.sin_addr.s_addr, now);
+        }
+
+        bool live = s_peer_ip && s_last_rx && now - s_last_rx < INTERCOM_TIMEOUT_MS * 1000LL;
+        if (live && !s_in_call)
+        {
+            ic_call_begin();
+        }
+        else if (!live && s_in_call)
+        {
+            ic_call_end();
+        }
+        if (s_peer_ip == 0 && now - last_hello >= INTERCOM_HELLO_MS * 1000LL)
+        {
+            last_hello = now;
+            ic_hdr_t h;
+            ic_hdr(&h, IC_PKT_HELLO);
+            ic_sendto(s_sock, &h, sizeof(h), htonl(INADDR_BROADCAST), INTERCOM_PORT);
+        }
+        if (s_peer_ip && now - last_ping >= INTERCOM_PING_MS * 1000LL)
+        {
+            last_ping = now;
+            ic_ping_t p = {.t1 = now};
+            ic_hdr(&p.h, IC_PKT_PING);
+            ic_send(&p, sizeof(p));
+        }
+        if (s_in_call && now - last_report >= INTERCOM_REPORT_MS * 1000LL)
+        {
+            last_report = now;
+            ic_report_t r;
+            ic_hdr(&r.h, IC_PKT_REPORT);
+            portENTER_CRITICAL(&s_lock);
+            r.video_rx = s_stats.video_rx;
+            r.video_incomplete = s_stats.video_incomplete;
+            portEXIT_CRITICAL(&s_lock);
+            ic_send(&r, sizeof(r));
+        }
+    }
+}
+
+esp_err_t intercom_start(void)
+{
+    ESP_RETURN_ON_FALSE(s_tx_q == NULL, ESP_ERR_INVALID_STATE, TAG, "already started");
+    if (CONFIG_APP_INTERCOM_PEER[0])
+    {
+        s_cfg_peer = inet_addr(CONFIG_APP_INTERCOM_PEER);
+        ESP_RETURN_ON_FALSE(s_cfg_peer != IPADDR_NONE, ESP_ERR_INVALID_ARG, TAG, "bad peer %s", CONFIG_APP_INTERCOM_PEER);
+    }
+    s_peer_ip = s_cfg_peer;
+    s_session = esp_random();
+    s_vtx_buf = heap_caps_malloc(INTERCOM_VIDEO_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(s_vtx_buf, ESP_ERR_NO_MEM, TAG, "no mem for video");
+    s_tx_q = xQueueCreate(INTERCOM_TX_QUEUE, sizeof(ic_tx_frame_t));
+    ESP_RETURN_ON_FALSE(s_tx_q, ESP_ERR_NO_MEM, TAG, "no mem for queue");
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_INTERCOM_NET, ic_net_task, NULL, NULL) == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "create task failed");
+    return ESP_OK;
+}
+
+bool intercom_in_call(void)
+{
+    return s_in_call;
+}
+
+void intercom_get_stats(intercom_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
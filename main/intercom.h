@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_camera.h"
+#include "sdkconfig.h"
+
+
+/*********************** 板子之间对讲 UDP ****************************/
+// 声音: 识别任务取出来的AFE输出(已经按喇叭的参考消过回声) 攒成INTERCOM_FRAME_MS一包 IMA ADPCM 20ms是164字节
+//       包头带序号和发送端时钟上的录音时刻 收到的按序号放进抖动缓冲的槽
+//       播放由混音器推: AUDIO_PCM_SRC_CALL里一直排着INTERCOM_PLAY_AHEAD段 放完一段的回调里解下一包接上
+//       轮到的包没到: 后面有包算丢了 上一包减半重放一次 再丢就静音 往后走
+//                     后面也没有算欠载 停下来重新攒到目标深度再放 多攒出来的延迟由下面追回去
+//       目标深度是RFC3550到达抖动估计的两倍加一包 在INTERCOM_JITTER_MIN_MS~MAX之间 攒得比目标多INTERCOM_JB_SLACK包就丢一包
+// 画面: 摄像头页开着而且是JPEG模式时 每帧最多INTERCOM_VIDEO_FPS 走另一个端口 按INTERCOM_VIDEO_FRAG分片
+//       发送任务还没发完上一帧就丢这一帧 sendto发不出去或者对方报有不全的帧 帧率减半 报得干净再一帧一帧加回来
+//       收端拼齐一帧在核1解成INTERCOM_PIP_W x H 顶层右上角画中画 上一帧还没显示就丢
+// 对方: CONFIG_APP_INTERCOM_PEER写了IP就只找它 空着就每INTERCOM_HELLO_MS广播一次招呼 听到别人的招呼就接通
+// 时钟: 双方互相ping 对方时钟差取窗口里往返最快那次
+//       嘴到耳 = 这段排进混音器的时刻+前面排着的+输出延迟 - 换到本地时钟的对方录音时刻 不含两边I2S DMA里的一块
+//       镜头到屏 = 画中画画完 - 换到本地时钟的对方出帧时刻 不含LCD传输
+// WiFi连上才开端口 INTERCOM_TIMEOUT_MS没收到对方的包就挂断 接着等招呼
+
+#define INTERCOM_PORT           CONFIG_APP_INTERCOM_PORT        // 声音和控制 画面是下一个端口
+#define INTERCOM_RATE           16000
+#define INTERCOM_FRAME_MS       20
+#define INTERCOM_FRAME_SAMPLES  (INTERCOM_RATE * INTERCOM_FRAME_MS / 1000)
+#define INTERCOM_JB_SLOTS       32      // 抖动缓冲的槽 必须是2的幂 640ms
+#define INTERCOM_JITTER_MIN_MS  40
+#define INTERCOM_JITTER_MAX_MS  CONFIG_APP_INTERCOM_JITTER_MAX_MS
+#define INTERCOM_JB_SLACK       2
+#define INTERCOM_PLAY_AHEAD     3       // 混音器里排着的段数
+#define INTERCOM_TX_QUEUE       6       // 识别任务到发送任务 满了丢
+#define INTERCOM_VIDEO_FPS      CONFIG_APP_INTERCOM_VIDEO_FPS
+#define INTERCOM_VIDEO_MIN_FPS  2
+#define INTERCOM_VIDEO_FRAG     1400    // 一片JPEG的字节 加包头不超过以太网MTU
+#define INTERCOM_VIDEO_MAX      (64 * INTERCOM_VIDEO_FRAG)      // 一帧最多64片 收端按位记
+#define INTERCOM_PIP_W          160
+#define INTERCOM_PIP_H          120
+#define INTERCOM_HELLO_MS       1000
+#define INTERCOM_PING_MS        500
+#define INTERCOM_REPORT_MS      1000
+#define INTERCOM_CLOCK_WINDOW   16      // 时钟差取这么多次ping里往返最快的 8秒
+#define INTERCOM_TIMEOUT_MS     3000
+
+typedef struct {
+    bool in_call;
+    uint32_t calls;
+    uint32_t audio_tx;
+    uint32_t audio_tx_dropped;          // 发送队列满 或者sendto失败
+    uint32_t audio_rx;
+    uint32_t audio_lost;                // 轮到时没到 后面的到了 重放或者静音补上
+    uint32_t audio_late;                // 已经轮过去才到 丢掉
+    uint32_t audio_skipped;             // 攒多了为追延迟丢的
+    uint32_t underruns;                 // 缓冲空了停下重新攒的次数
+    uint32_t jitter_us;                 // 到达抖动估计
+    uint32_t target_ms;                 // 抖动缓冲现在的目标深度
+    uint32_t depth_ms;                  // 现在缓冲着的
+    uint32_t m2e_ms;                    // 嘴到耳 一阶滤波
+    uint32_t m2e_max_ms;
+    uint32_t video_tx;
+    uint32_t video_tx_dropped;          // 上一帧还在发 太大 或者发不出去
+    uint32_t video_fps;                 // 现在的发送帧率上限
+    uint32_t video_rx;                  // 拼齐的帧
+    uint32_t video_incomplete;          // 分片不全的
+    uint32_t video_shown;
+    uint32_t video_dropped;             // 解码失败 或者上一帧还没显示
+    uint32_t decode_us;                 // 最近一帧
+    uint32_t g2g_ms;                    // 镜头到屏 一阶滤波
+    uint32_t g2g_max_ms;
+    int64_t clock_offset_us;            // 对方时钟减本地
+    uint32_t rtt_us;                    // 窗口里最快的往返
+} intercom_stats_t;
+
+#if CONFIG_APP_INTERCOM
+esp_err_t intercom_start(void);         // 语音识别起来以后调 等WiFi连上在任务里开端口
+bool intercom_in_call(void);
+void intercom_video_frame(const camera_fb_t *frame);    // 摄像头任务每帧调 没在通话 不到时候或者在发就马上返回
+void intercom_get_stats(intercom_stats_t *stats);
+#endif
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include "lcd_bench.h"
+#include "task_plan.h"
+#include "esp32_s3_szp.h"
+#include "lcd_draw.h"
+#include "boot.h"
+#include "lvgl.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "lcd_bench";
+
+static const int s_heights[] = { 10, 20, 40, 60, 120 };
+
+typedef struct
+{
+    const char *name;
+    void (*setup)(lv_obj_t *scr);
+    void (*step)(lv_obj_t *scr, int frame);     // 改一点内容 让下一帧有东西要画
+} lcd_scene_t;
+
+static lv_obj_t *s_label;
+
+// 整屏纯色 每帧换颜色 全屏重画里最便宜的情况
+static void scene_fill_setup(lv_obj_t *scr)
+{
+    lv_obj_set_style_bg_opa(scr, LV_OPA_COVER, 0);
+}
+
+static void scene_fill_step(lv_obj_t *scr, int frame)
+{
+    lv_obj_set_style_bg_color(scr, (frame & 1) ? lv_color_hex(0x203040) : lv_color_hex(0x402030), 0);
+}
+
+// 渐变背景加一屏文字和按钮 接近应用界面的整屏重画
+static void scene_widgets_setup(lv_obj_t *scr)
+{
+    lv_obj_set_style_bg_opa(scr, LV_OPA_COVER, 0);
+    lv_obj_set_style_bg_color(scr, lv_color_hex(0x102040), 0);
+    lv_obj_set_style_bg_grad_color(scr, lv_color_hex(0x408060), 0);
+    lv_obj_set_style_bg_grad_dir(scr, LV_GRAD_DIR_VER, 0);
+    for (int i = 0; i < 8; i++)
+    {
+        lv_obj_t *btn = lv_btn_create(scr);
+        lv_obj_set_size(btn, 140, 24);
+        lv_obj_set_pos(btn, (i & 1) ? 170 : 10, 10 + (i / 2) * 30);
+        lv_obj_t *l = lv_label_create(btn);
+        lv_label_set_text_fmt(l, "Button %d", i);
+        lv_obj_center(l);
+    }
+    lv_obj_t *txt = lv_label_create(scr);
+    lv_obj_set_width(txt, 300);
+    lv_obj_set_pos(txt, 10, 135);
+    lv_label_set_long_mode(txt, LV_LABEL_LONG_WRAP);
+    lv_label_set_text(txt, "The quick brown fox jumps over the lazy dog. 0123456789 "
+                           "The quick brown fox jumps over the lazy dog. 0123456789 "
+                           "The quick brown fox jumps over the lazy dog.");
+}
+
+static void scene_widgets_step(lv_obj_t *scr, int frame)
+{
+    lv_obj_invalidate(scr);
+}
+
+// 只有一小块文字在变 局部刷新
+static void scene_label_setup(lv_obj_t *scr)
+{
+    lv_obj_set_style_bg_opa(scr, LV_OPA_COVER, 0);
+    s_label = lv_label_create(scr);
+    lv_obj_center(s_label);
+}
+
+static void scene_label_step(lv_obj_t *scr, int frame)
+{
+    lv_label_set_text_fmt(s_label, "frame %03d", frame);
+}
+
+static const lcd_scene_t s_scenes[LCD_BENCH_SCENES] = {
+    { "fill",    scene_fill_setup,    scene_fill_step },
+    { "widgets", scene_widgets_setup, scene_widgets_step },
+    { "label",   scene_label_setup,   scene_label_step },
+};
+
+// 调用者持有LVGL锁 返回帧率
+static float scene_fps(lv_disp_t *d, const lcd_scene_t *sc)
+{
+    lv_obj_t *scr = lv_obj_create(NULL);
+    sc->setup(scr);
+    lv_scr_load(scr);
+    lv_refr_now(d);     // 切屏的整屏重画不计入
+
+    int64_t t0 = esp_timer_get_time();
+    for (int f = 0; f < LCD_BENCH_FRAMES; f++)
+    {
+        sc->step(scr, f);
+        lv_refr_now(d);
+    }
+    // 最后一块还在SPI上 等它发完才算一帧结束
+    while (d->driver->draw_buf->flushing)
+    {
+        vTaskDelay(1);
+    }
+    int64_t us = esp_timer_get_time() - t0;
+
+    lv_obj_del(scr);
+    return us > 0 ? LCD_BENCH_FRAMES * 1e6f / us : 0;
+}
+
+esp_err_t lcd_bench_scenes(const char **names, float *fps)
+{
+    lv_disp_t *d = lv_disp_get_default();
+    ESP_RETURN_ON_FALSE(d, ESP_ERR_INVALID_STATE, TAG, "display not started");
+    lvgl_port_lock(0);
+    lv_obj_t *old = lv_scr_act();
+    for (int i = 0; i < LCD_BENCH_SCENES; i++)
+    {
+        if (names)
+        {
+            names[i] = s_scenes[i].name;
+        }
+        fps[i] = scene_fps(d, &s_scenes[i]);
+    }
+    lv_scr_load(old);
+    lvgl_port_unlock();
+    return ESP_OK;
+}
+
+esp_err_t lcd_bench_run(void)
+{
+    lv_disp_t *d = lv_disp_get_default();
+    ESP_RETURN_ON_FALSE(d, ESP_ERR_INVALID_STATE, TAG, "display not started");
+
+    const int orig_lines = bsp_display_get_draw_buf_height();
+    const bsp_disp_render_mode_t orig_mode = bsp_display_get_render_mode();
+    ESP_RETURN_ON_ERROR(bsp_display_set_render_mode(BSP_DISP_RENDER_PARTIAL), TAG, "cannot switch to partial mode");
+
+    // 当前缓冲占用按计算值 换高度后和它比较内部RAM剩余 得到实测占用
+    const size_t orig_bytes = 2 * BSP_LCD_H_RES * orig_lines * sizeof(lv_color_t);
+    const size_t free0 = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
+    ESP_LOGI(TAG, "%5s %9s %10s %8s %8s %8s", "lines", "DRAM KB", "free KB", "fill", "widgets", "label");
+    for (int h = 0; h < sizeof(s_heights) / sizeof(s_heights[0]); h++)
+    {
+        if (bsp_display_set_draw_buf_height(s_heights[h]) != ESP_OK)
+        {
+            ESP_LOGW(TAG, "%5d  does not fit in DMA-capable RAM", s_heights[h]);
+            continue;
+        }
+        size_t free_now = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        float fps[LCD_BENCH_SCENES];
+        lcd_bench_scenes(NULL, fps);
+
+        ESP_LOGI(TAG, "%5d %9.1f %10.1f %8.1f %8.1f %8.1f", s_heights[h], ((double)free0 + orig_bytes - free_now) / 1024,
+                 free_now / 1024.0, fps[0], fps[1], fps[2]);
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+
+    bsp_display_set_draw_buf_height(orig_lines);
+    bsp_display_set_render_mode(orig_mode);
+    ESP_LOGI(TAG, "fps over %d frames per scene, restored %d lines", LCD_BENCH_FRAMES, orig_lines);
+    return ESP_OK;
+}
+
+/*********************** blend加速对比 ****************************/
+typedef struct
+{
+    float fps;
+    float blend_ms;         // 每帧花在blend上的时间
+    uint32_t fallbacks;     // 每帧交给LVGL的blend次数
+} draw_result_t;
+
+static lv_obj_t *s_list;
+static int s_list_dir = -1;
+
+// 当前屏幕整屏重画 开机后就是主界面
+static void draw_main_step(lv_obj_t *scr)
+{
+    lv_obj_invalidate(scr);
+}
+
+// 和SD卡文件列表一样的按钮列表 每帧滚一点 到头就反过来
+static lv_obj_t *draw_list_create(void)
+{
+    lv_obj_t *scr = lv_obj_create(NULL);
+    s_list = lv_list_create(scr);
+    lv_obj_set_size(s_list, 320, 200);
+    lv_obj_align(s_list, LV_ALIGN_BOTTOM_MID, 0, 0);
+    for (int i = 0; i < 40; i++)
+    {
+        char name[24];
+        snprintf(name, sizeof(name), "IMG_%04d.bmp", i);
+        lv_list_add_btn(s_list, (i % 5) ? LV_SYMBOL_IMAGE : LV_SYMBOL_DIRECTORY, name);
+    }
+    return scr;
+}
+
+static void draw_list_step(lv_obj_t *scr)
+{
+    lv_coord_t y = lv_obj_get_scroll_y(s_list);
+    if ((s_list_dir < 0 && lv_obj_get_scroll_bottom(s_list) <= 0) || (s_list_dir > 0 && y <= 0))
+    {
+        s_list_dir = -s_list_dir;
+    }
+    lv_obj_scroll_by(s_list, 0, s_list_dir * 8, LV_ANIM_OFF);
+}
+
+// 调用者持有LVGL锁
+static draw_result_t draw_measure(lv_disp_t *d, lv_obj_t *scr, void (*step)(lv_obj_t *scr), bool accel)
+{
+    lcd_draw_set_accel(accel);
+    lv_obj_invalidate(scr);
+    lv_refr_now(d);
+    lcd_draw_reset_stats();
+
+    int64_t t0 = esp_timer_get_time();
+    for (int f = 0; f < LCD_BENCH_FRAMES; f++)
+    {
+        step(scr);
+        lv_refr_now(d);
+    }
+    while (d->driver->draw_buf->flushing)
+    {
+        vTaskDelay(1);
+    }
+    int64_t us = esp_timer_get_time() - t0;
+
+    lcd_draw_stats_t st;
+    lcd_draw_get_stats(&st);
+    draw_result_t r = {
+        .fps = us > 0 ? LCD_BENCH_FRAMES * 1e6f / us : 0,
+        .blend_ms = st.cycles / (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000.0f) / LCD_BENCH_FRAMES,
+        .fallbacks = st.fallbacks / LCD_BENCH_FRAMES,
+    };
+    return r;
+}
+
+static void draw_log(const char *name, const draw_result_t *off, const draw_result_t *on)
+{
+    ESP_LOGI(TAG, "%-6s %7.1f %7.1f %9.2f %9.2f %7lu %7lu", name, off->fps, on->fps, off->blend_ms, on->blend_ms,
+             (unsigned long)off->fallbacks, (unsigned long)on->fallbacks);
+}
+
+esp_err_t lcd_bench_draw_run(void)
+{
+    lv_disp_t *d = lv_disp_get_default();
+    ESP_RETURN_ON_FALSE(d, ESP_ERR_INVALID_STATE, TAG, "display not started");
+    const bool orig = lcd_draw_get_accel();
+    draw_result_t off, on;
+
+    ESP_LOGI(TAG, "%-6s %7s %7s %9s %9s %7s %7s", "scene", "fps off", "fps on", "blend off", "blend on", "fb off", "fb on");
+    lvgl_port_lock(0);
+    lv_obj_t *old = lv_scr_act();
+    off = draw_measure(d, old, draw_main_step, false);
+    on = draw_measure(d, old, draw_main_step, true);
+    draw_log("main", &off, &on);
+
+    lv_obj_t *scr = draw_list_create();
+    lv_scr_load(scr);
+    off = draw_measure(d, scr, draw_list_step, false);
+    on = draw_measure(d, scr, draw_list_step, true);
+    draw_log("list", &off, &on);
+    lv_scr_load(old);
+    lv_obj_del(scr);
+
+    lcd_draw_set_accel(orig);
+    lvgl_port_unlock();
+    ESP_LOGI(TAG, "blend in ms per frame, fb = blends left to LVGL per frame, %d frames per run", LCD_BENCH_FRAMES);
+    return ESP_OK;
+}
+
+static void lcd_bench_draw_task(void *arg)
+{
+    boot_wait(BOOT_BIT(BOOT_STAGE_UI), BOOT_WAIT_FOREVER);  // 要测的是主界面
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    lcd_bench_draw_run();
+    vTaskDelete(NULL);
+}
+
+esp_err_t lcd_bench_draw_start(void)
+{
+    BaseType_t ok = task_plan_create(TASK_LCD_DRAW_BENCH, lcd_bench_draw_task, NULL, NULL);
+    return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static void lcd_bench_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(2000));    // 让开机界面先起来
+    lcd_bench_run();
+    vTaskDelete(NULL);
+}
+
+esp_err_t lcd_bench_start(void)
+{
+    BaseType_t ok = task_plan_create(TASK_LCD_BENCH, lcd_bench_task, NULL, NULL);
+    return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
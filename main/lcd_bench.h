@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esp_err.h"
+
+
+/*********************** 显示基准测试 ****************************/
+// 依次把绘图缓冲设为 10/20/40/60/120 行 每种高度下跑几个标准场景
+// 打印帧率和绘图缓冲实际占用的内部DRAM 用数据来选 CONFIG_APP_LCD_DRAW_BUF_HEIGHT
+// 测试期间占着LVGL锁 画面是测试场景 结束后恢复原来的屏幕和缓冲高度
+
+#define LCD_BENCH_FRAMES     30      // 每个场景刷新的帧数
+#define LCD_BENCH_SCENES     3       // 整屏纯色 整屏控件 一小块文字
+
+esp_err_t lcd_bench_run(void);       // 在调用者任务里同步执行 大约十几秒
+esp_err_t lcd_bench_start(void);     // 在后台任务里跑一次
+// 不改缓冲高度和渲染模式 把标准场景各跑一遍 names可以为NULL 两个数组都是LCD_BENCH_SCENES个 给bench_suite用
+esp_err_t lcd_bench_scenes(const char **names, float *fps);
+
+// 主界面整屏重画和一个滚动的文件列表 分别在关掉和打开lcd_draw加速时各跑一遍
+// 打印帧率、每帧blend耗时和没有被加速的blend次数 测试期间占着LVGL锁
+esp_err_t lcd_bench_draw_run(void);
+esp_err_t lcd_bench_draw_start(void);   // 等主界面建好后在后台任务里跑一次
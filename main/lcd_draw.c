@@ -0,0 +1,382 @@
+#include <string.h>
+#include "lcd_draw.h"
+#include "src/draw/sw/lv_draw_sw.h"
+#include "dsps_mem.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "lcd_draw";
+
+#if LV_COLOR_DEPTH != 16
+#error "lcd_draw only handles RGB565"
+#endif
+
+// 缓冲里的像素是交换过字节序的 算之前换回来
+#if LV_COLOR_16_SWAP
+#define PX_IN(v)    __builtin_bswap16(v)
+#define PX_OUT(v)   __builtin_bswap16(v)
+#else
+#define PX_IN(v)    (v)
+#define PX_OUT(v)   (v)
+#endif
+
+// 绿色挪到高半字 红蓝留在低半字 每个通道上面都空出5位 乘5位alpha不会溢出到隔壁
+#define PX_SPREAD_MASK  0x07E0F81Fu
+
+static bool s_accel = CONFIG_APP_LCD_DRAW_ACCEL;
+static lcd_draw_stats_t s_stats;
+
+static inline uint32_t px_spread(uint16_t v)
+{
+    uint32_t x = PX_IN(v);
+    return (x | (x << 16)) & PX_SPREAD_MASK;
+}
+
+static inline uint16_t px_pack(uint32_t x)
+{
+    x &= PX_SPREAD_MASK;
+    return PX_OUT((uint16_t)(x | (x >> 16)));
+}
+
+// fg_a是已经乘过a的前景 a是0~32
+static inline uint16_t px_mix(uint32_t fg_a, uint16_t bg, uint32_t a)
+{
+    return px_pack((fg_a + px_spread(bg) * (32 - a)) >> 5);
+}
+
+// 一个像素展开成BGR888 低24位依次是B G R 5位和6位的通道用自己的高位补满8位 白还是白
+static inline uint32_t px_bgr(uint16_t v)
+{
+    uint32_t x = PX_IN(v);
+    uint32_t r = x >> 11;
+    uint32_t g = (x >> 5) & 0x3F;
+    uint32_t b = x & 0x1F;
+    return ((b << 3) | (b >> 2)) | (((g << 2) | (g >> 4)) << 8) | (((r << 3) | (r >> 2)) << 16);
+}
+
+void lcd_draw_to_bgr888(uint8_t *dst, const uint16_t *src, size_t n)
+{
+    // 4个像素正好12字节 对齐时拼成3个32位字写 不对齐的话逐字节
+    if (((uintptr_t)dst & 3) == 0)
+    {
+        uint32_t *d32 = (uint32_t *)dst;
+        while (n >= 4)
+        {
+            uint32_t p0 = px_bgr(src[0]);
+            uint32_t p1 = px_bgr(src[1]);
+            uint32_t p2 = px_bgr(src[2]);
+            uint32_t p3 = px_bgr(src[3]);
+            d32[0] = p0 | (p1 << 24);
+            d32[1] = (p1 >> 8) | (p2 << 16);
+            d32[2] = (p2 >> 16) | (p3 << 8);
+            d32 += 3;
+            src += 4;
+            n -= 4;
+        }
+        dst = (uint8_t *)d32;
+    }
+    while (n--)
+    {
+        uint32_t p = px_bgr(*src++);
+        dst[0] = p;
+        dst[1] = p >> 8;
+        dst[2] = p >> 16;
+        dst += 3;
+    }
+}
+
+// 亮度 Y = 0.299R + 0.587G + 0.114B 系数按5/6/5位通道折好 结果放大了256倍
+static inline uint32_t px_luma256(uint16_t v)
+{
+    uint32_t x = PX_IN(v);
+    return (x >> 11) * 630 + ((x >> 5) & 0x3F) * 608 + (x & 0x1F) * 241;
+}
+
+void lcd_draw_luma4(uint8_t *dst, const uint16_t *src, int w, int h)
+{
+    // 每个4x4的格子取中间2x2四个像素 两行各读一个32位字
+    int dw = w / 4;
+    for (int y = 0; y < h / 4; y++)
+    {
+        const uint32_t *r0 = (const uint32_t *)(src + (y * 4 + 1) * w + 2);
+        const uint32_t *r1 = (const uint32_t *)(src + (y * 4 + 2) * w + 2);
+        for (int x = 0; x < dw; x++)
+        {
+            uint32_t a = r0[x * 2];
+            uint32_t b = r1[x * 2];
+            uint32_t sum = px_luma256(a) + px_luma256(a >> 16) + px_luma256(b) + px_luma256(b >> 16);
+            *dst++ = sum >> 10;
+        }
+    }
+}
+
+uint32_t lcd_draw_sad8(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    // 一个32位字拆成奇偶两半 每个字节放进16位的格子 加256再减不会借到隔壁
+    // 第8位就是谁大 按它挑出大的和小的相减 两路差加在一起累加 最多128个字再合并 不会溢出
+    uint32_t sum = 0;
+    const uint32_t *a32 = (const uint32_t *)a;
+    const uint32_t *b32 = (const uint32_t *)b;
+    while (n >= 4)
+    {
+        size_t words = LV_MIN(n / 4, 128);
+        uint32_t acc = 0;
+        n -= words * 4;
+        while (words--)
+        {
+            uint32_t x = *a32++;
+            uint32_t y = *b32++;
+            uint32_t xe = x & 0x00FF00FF;
+            uint32_t ye = y & 0x00FF00FF;
+            uint32_t xo = (x >> 8) & 0x00FF00FF;
+            uint32_t yo = (y >> 8) & 0x00FF00FF;
+            uint32_t ge = (((xe + 0x01000100) - ye) >> 8 & 0x00010001) * 0xFFFF;
+            uint32_t go = (((xo + 0x01000100) - yo) >> 8 & 0x00010001) * 0xFFFF;
+            acc += ((xe & ge) | (ye & ~ge)) - ((ye & ge) | (xe & ~ge));
+            acc += ((xo & go) | (yo & ~go)) - ((yo & go) | (xo & ~go));
+        }
+        sum += (acc & 0xFFFF) + (acc >> 16);
+    }
+    a = (const uint8_t *)a32;
+    b = (const uint8_t *)b32;
+    while (n--)
+    {
+        int d = *a++ - *b++;
+        sum += d < 0 ? -d : d;
+    }
+    return sum;
+}
+
+void lcd_draw_fill16(uint16_t *dst, uint16_t color, size_t n)
+{
+    if (n && ((uintptr_t)dst & 2))
+    {
+        *dst++ = color;
+        n--;
+    }
+    uint32_t pair = color | ((uint32_t)color << 16);
+    uint32_t *d32 = (uint32_t *)dst;
+    while (n >= 16)
+    {
+        d32[0] = pair; d32[1] = pair; d32[2] = pair; d32[3] = pair;
+        d32[4] = pair; d32[5] = pair; d32[6] = pair; d32[7] = pair;
+        d32 += 8;
+        n -= 16;
+    }
+    while (n >= 2)
+    {
+        *d32++ = pair;
+        n -= 2;
+    }
+    if (n)
+    {
+        *(uint16_t *)d32 = color;
+    }
+}
+
+void lcd_draw_mix16(uint16_t *dst, const uint16_t *fg, const uint16_t *bg, size_t n, uint32_t a)
+{
+    if (a >= 32)
+    {
+        if (dst != fg)
+        {
+            memmove(dst, fg, n * sizeof(uint16_t));
+        }
+        return;
+    }
+    if (a == 0)
+    {
+        if (dst != bg)
+        {
+            memmove(dst, bg, n * sizeof(uint16_t));
+        }
+        return;
+    }
+    uint32_t b = 32 - a;
+    while (n >= 4)
+    {
+        uint16_t d0 = px_pack((px_spread(fg[0]) * a + px_spread(bg[0]) * b) >> 5);
+        uint16_t d1 = px_pack((px_spread(fg[1]) * a + px_spread(bg[1]) * b) >> 5);
+        uint16_t d2 = px_pack((px_spread(fg[2]) * a + px_spread(bg[2]) * b) >> 5);
+        uint16_t d3 = px_pack((px_spread(fg[3]) * a + px_spread(bg[3]) * b) >> 5);
+        dst[0] = d0; dst[1] = d1; dst[2] = d2; dst[3] = d3;
+        dst += 4;
+        fg += 4;
+        bg += 4;
+        n -= 4;
+    }
+    while (n--)
+    {
+        *dst++ = px_pack((px_spread(*fg++) * a + px_spread(*bg++) * b) >> 5);
+    }
+}
+
+static void fill_cover(lv_color_t *dest, lv_coord_t stride, lv_coord_t w, lv_coord_t h, lv_color_t color)
+{
+    lcd_draw_fill16(&dest->full, color.full, w);
+    for (lv_coord_t y = 1; y < h; y++)
+    {
+        dsps_memcpy(dest + y * stride, dest, w * sizeof(lv_color_t));
+    }
+}
+
+static void fill_opa(lv_color_t *dest, lv_coord_t stride, lv_coord_t w, lv_coord_t h, lv_color_t color, lv_opa_t opa)
+{
+    uint32_t a = (opa + 4) >> 3;
+    uint32_t fg_a = px_spread(color.full) * a;
+    for (lv_coord_t y = 0; y < h; y++)
+    {
+        uint16_t *d = &dest[y * stride].full;
+        for (lv_coord_t x = 0; x < w; x++)
+        {
+            d[x] = px_mix(fg_a, d[x], a);
+        }
+    }
+}
+
+// 文字和圆角边缘 遮罩每个像素不同 全覆盖和全透明的像素最多 先挑出来
+static void fill_mask(lv_color_t *dest, lv_coord_t stride, lv_coord_t w, lv_coord_t h, lv_color_t color, lv_opa_t opa,
+                      const lv_opa_t *mask, lv_coord_t mask_stride)
+{
+    uint32_t fg = px_spread(color.full);
+    for (lv_coord_t y = 0; y < h; y++)
+    {
+        uint16_t *d = &dest[y * stride].full;
+        const lv_opa_t *m = mask + y * mask_stride;
+        for (lv_coord_t x = 0; x < w; x++)
+        {
+            uint32_t o = opa >= LV_OPA_MAX ? m[x] : (m[x] * opa) >> 8;
+            if (o <= LV_OPA_MIN)
+            {
+                continue;
+            }
+            if (o >= LV_OPA_MAX)
+            {
+                d[x] = color.full;
+                continue;
+            }
+            uint32_t a = (o + 4) >> 3;
+            d[x] = px_mix(fg * a, d[x], a);
+        }
+    }
+}
+
+static void map_cover(lv_color_t *dest, lv_coord_t stride, lv_coord_t w, lv_coord_t h, const lv_color_t *src, lv_coord_t src_stride)
+{
+    for (lv_coord_t y = 0; y < h; y++)
+    {
+        dsps_memcpy(dest + y * stride, src + y * src_stride, w * sizeof(lv_color_t));
+    }
+}
+
+static void map_opa(lv_color_t *dest, lv_coord_t stride, lv_coord_t w, lv_coord_t h, const lv_color_t *src, lv_coord_t src_stride,
+                    lv_opa_t opa)
+{
+    uint32_t a = (opa + 4) >> 3;
+    for (lv_coord_t y = 0; y < h; y++)
+    {
+        uint16_t *d = &dest[y * stride].full;
+        const lv_color_t *s = src + y * src_stride;
+        for (lv_coord_t x = 0; x < w; x++)
+        {
+            d[x] = px_mix(px_spread(s[x].full) * a, d[x], a);
+        }
+    }
+}
+
+// 坐标换算和 lv_draw_sw_blend_basic 一样 能加速的情况自己画 其余原样交回去
+static void lcd_draw_blend(lv_draw_ctx_t *draw_ctx, const lv_draw_sw_blend_dsc_t *dsc)
+{
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    const lv_opa_t *mask = dsc->mask_buf;
+    if (mask && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP)
+    {
+        return;
+    }
+    if (dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER)
+    {
+        mask = NULL;
+    }
+
+    lv_disp_t *disp = _lv_refr_get_disp_refreshing();
+    lv_area_t area;
+    if (!s_accel || disp->driver->set_px_cb || disp->driver->screen_transp || dsc->blend_mode != LV_BLEND_MODE_NORMAL ||
+        (mask && (dsc->src_buf || disp->driver->antialiasing == 0)) ||
+        !_lv_area_intersect(&area, dsc->blend_area, draw_ctx->clip_area) || lv_area_get_width(&area) < LCD_DRAW_MIN_ROW_PX)
+    {
+        lv_draw_sw_blend_basic(draw_ctx, dsc);
+        s_stats.fallbacks++;
+        s_stats.cycles += esp_cpu_get_cycle_count() - c0;
+        return;
+    }
+
+    lv_coord_t stride = lv_area_get_width(draw_ctx->buf_area);
+    lv_color_t *dest = (lv_color_t *)draw_ctx->buf + stride * (area.y1 - draw_ctx->buf_area->y1) + (area.x1 - draw_ctx->buf_area->x1);
+    lv_coord_t w = lv_area_get_width(&area);
+    lv_coord_t h = lv_area_get_height(&area);
+
+    if (dsc->src_buf)
+    {
+        lv_coord_t src_stride = lv_area_get_width(dsc->blend_area);
+        const lv_color_t *src = dsc->src_buf + src_stride * (area.y1 - dsc->blend_area->y1) + (area.x1 - dsc->blend_area->x1);
+        if (dsc->opa >= LV_OPA_MAX)
+        {
+            map_cover(dest, stride, w, h, src, src_stride);
+            s_stats.copies++;
+        }
+        else
+        {
+            map_opa(dest, stride, w, h, src, src_stride, dsc->opa);
+            s_stats.blends++;
+        }
+    }
+    else if (mask)
+    {
+        lv_coord_t mask_stride = lv_area_get_width(dsc->mask_area);
+        mask += mask_stride * (area.y1 - dsc->mask_area->y1) + (area.x1 - dsc->mask_area->x1);
+        fill_mask(dest, stride, w, h, dsc->color, dsc->opa, mask, mask_stride);
+        s_stats.blends++;
+    }
+    else if (dsc->opa >= LV_OPA_MAX)
+    {
+        fill_cover(dest, stride, w, h, dsc->color);
+        s_stats.fills++;
+    }
+    else
+    {
+        fill_opa(dest, stride, w, h, dsc->color, dsc->opa);
+        s_stats.blends++;
+    }
+    s_stats.pixels += (uint32_t)w * h;
+    s_stats.cycles += esp_cpu_get_cycle_count() - c0;
+}
+
+void lcd_draw_install(lv_disp_t *disp)
+{
+    // 没有开GPU时draw_ctx就是软件渲染器的 只换掉它的blend
+    lv_draw_sw_ctx_t *ctx = (lv_draw_sw_ctx_t *)disp->driver->draw_ctx;
+    ctx->blend = lcd_draw_blend;
+    ESP_LOGI(TAG, "RGB565 blend installed, accel %s", s_accel ? "on" : "off");
+}
+
+void lcd_draw_set_accel(bool on)
+{
+    s_accel = on;
+}
+
+bool lcd_draw_get_accel(void)
+{
+    return s_accel;
+}
+
+// 统计只在LVGL任务里改 读的时候要持有LVGL锁
+void lcd_draw_get_stats(lcd_draw_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void lcd_draw_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl.h"
+
+
+/*********************** RGB565绘图加速 ****************************/
+// 替换LVGL软件渲染器的blend 也就是所有填充、图片拷贝和半透明叠加最后都要走的那一步
+// 不透明的整行拷贝用esp-dsp的dsps_memcpy S3上是PIE的128位读写
+// 纯色填充先用32位写好第一行 其余行从第一行拷贝
+// 半透明填充、抗锯齿文字边缘和半透明图片 把RGB565拆进一个32位字里三个通道一起算 alpha精度5位
+// 混合模式、带遮罩的图片、关掉抗锯齿等情况交给LVGL原来的实现
+
+#define LCD_DRAW_MIN_ROW_PX     8       // 比这窄的区域交给LVGL原来的实现 省掉准备开销
+
+typedef struct {
+    uint32_t fills;                     // 加速路径处理的次数
+    uint32_t copies;
+    uint32_t blends;                    // 半透明和带遮罩的
+    uint32_t fallbacks;                 // 交给LVGL的
+    uint64_t pixels;                    // 加速路径写过的像素
+    uint64_t cycles;                    // 所有blend调用的CPU周期 包括交给LVGL的
+} lcd_draw_stats_t;
+
+void lcd_draw_install(lv_disp_t *disp); // 持有LVGL锁时调用
+void lcd_draw_set_accel(bool on);       // 关掉后全部走LVGL原来的实现 用来对比
+bool lcd_draw_get_accel(void);
+void lcd_draw_get_stats(lcd_draw_stats_t *stats);
+void lcd_draw_reset_stats(void);
+void lcd_draw_fill16(uint16_t *dst, uint16_t color, size_t n);  // 连续n个像素填同一个值
+// dst = fg * a / 32 + bg * (32 - a) / 32 a是0~32 三个通道在一个32位字里一起算 dst可以就是fg或bg
+void lcd_draw_mix16(uint16_t *dst, const uint16_t *fg, const uint16_t *bg, size_t n, uint32_t a);
+// LVGL字节序的RGB565转成BMP用的BGR888 dst要3n字节 4字节对齐时一次写12字节
+void lcd_draw_to_bgr888(uint8_t *dst, const uint16_t *src, size_t n);
+// w x h的RGB565缩成(w/4) x (h/4)的8位亮度 每格取中间2x2平均 w要是偶数
+void lcd_draw_luma4(uint8_t *dst, const uint16_t *src, int w, int h);
+// 两段8位数据的绝对差之和 4字节对齐时一次比4个字节
+uint32_t lcd_draw_sad8(const uint8_t *a, const uint8_t *b, size_t n);
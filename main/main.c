@@ -1,7 +1,85 @@
 #include <stdio.h>
 #include "esp32_s3_szp.h"
 #include "app_ui.h"
+#include "audio_pcm.h"
+#include "audio_player.h"
+#include "flac_mc.h"
+#include "boot.h"
+#include "boot_anim.h"
+#include "audio_bench.h"
+#include "lcd_bench.h"
+#include "sd_bench.h"
+#include "ui_perf.h"
+#include "ui_msg.h"
+#include "ui_screen.h"
+#include "pic_cache.h"
+#include "pic_thumb.h"
+#include "ui_gif.h"
+#include "ui_avi.h"
+#include "ui_zoom.h"
+#include "ui_clock.h"
+#include "sd_fs.h"
+#include "fd_pool.h"
+#include "sd_dir_cache.h"
+#include "media_lib.h"
+#include "media_search.h"
+#include "gallery_index.h"
+#include "sd_writer.h"
+#include "sd_job.h"
+#include "sd_hotplug.h"
+#include "imu.h"
+#include "attitude.h"
+#include "imu_gesture.h"
+#include "pedometer.h"
+#include "ui_orient.h"
+#include "imu_log.h"
+#include "idle_mgr.h"
+#include "standby.h"
+#include "pm_ctl.h"
+#include "font_ext.h"
+#include "asset_part.h"
+#include "ui_layer.h"
+#include "ui_trans.h"
+#include "app_res.h"
+#include "evt_bus.h"
+#include "voice_cmd.h"
+#include "voice_ref.h"
+#include "voice_bench.h"
+#include "voice_tts.h"
+#include "voice_memo.h"
+#include "voice_vocab.h"
+#include "wifi_fast.h"
+#include "wifi_svc.h"
+#include "multiroom.h"
+#include "intercom.h"
+#include "music_lyrics.h"
+#include "crash_ctx.h"
+#include "alarm.h"
+#include "time_sync.h"
+#include "ota_update.h"
+#include "file_server.h"
+#include "web_dash.h"
+#include "screen_mirror.h"
+#include "mqtt_svc.h"
+#include "bt/hid_sched.h"
+#include "bt/ble_svc.h"
+#include "bt/air_mouse.h"
+#include "bt/ble_remote.h"
+#include "telemetry.h"
+#include "ui_sysmon.h"
+#include "mem_pool.h"
+#include "ui_mem.h"
+#include "heap_audit.h"
+#include "flash_log.h"
+#include "sys_trace.h"
+#include "bench_suite.h"
+#include "psram_bw.h"
+#include "task_plan.h"
+#include "i2c_bus.h"
+#include "ui_slide.h"
+#include "net_pic.h"
 #include "nvs_flash.h"
+#include "driver/uart.h"
 #include <esp_system.h>
 
 
@@ -29,19 +107,961 @@ void displayMemoryUsage() {
     ESP_LOGI(TAG, "DRAM Used: %.2f%%", dramUsagePercentage);
     ESP_LOGI(TAG, "PSRAM Total: %zu bytes, Used: %zu bytes, Free: %zu bytes, PSRAM_Largest_block: %zu bytes", totalPSRAM, usedPSRAM, freePSRAM, PSRAM_largest_block);
     ESP_LOGI(TAG, "PSRAM Used: %.2f%%", psramUsagePercentage);
+
+    audio_pcm_stats_t pcm;
+    audio_pcm_get_stats(&pcm);
+    ESP_LOGI(TAG, "PCM ring: %zu/%zu bytes, high water: %zu, underruns: %lu, timeouts: %lu",
+             pcm.fill, pcm.ring_size, pcm.high_water, (unsigned long)pcm.underruns, (unsigned long)pcm.timeouts);
+    if (pcm.resample_in) {
+        ESP_LOGI(TAG, "Resample %lu -> %lu Hz: %.1f cycles/frame", (unsigned long)pcm.resample_in, (unsigned long)pcm.resample_out,
+                 pcm.resample_frames ? (double)pcm.resample_cycles / pcm.resample_frames : 0.0);
+    }
+    if (pcm.stretch_frames) {
+        ESP_LOGI(TAG, "Time stretch at %lu%%: %.1f cycles/frame", (unsigned long)pcm.stretch_speed,
+                 (double)pcm.stretch_cycles / pcm.stretch_frames);
+    }
+    if (pcm.hires_bits) {
+        ESP_LOGI(TAG, "Hi-res %lu bit: %s, dither %.1f cycles/sample", (unsigned long)pcm.hires_bits,
+                 pcm.dither_on ? "dithered to 16 bit" : "native",
+                 pcm.dither_samples ? (double)pcm.dither_cycles / pcm.dither_samples : 0.0);
+    }
+    if (pcm.prompts || pcm.prompt_dropped) {
+        ESP_LOGI(TAG, "Prompts: %lu played, %lu dropped, %.1f s mixed, queued->sound max %lu ms",
+                 (unsigned long)pcm.prompts, (unsigned long)pcm.prompt_dropped,
+                 pcm.resample_out ? (double)pcm.prompt_frames / pcm.resample_out : (double)pcm.prompt_frames / 16000,
+                 (unsigned long)pcm.prompt_wait_max_us / 1000);
+    }
+    if (pcm.mix_periods) {
+        ESP_LOGI(TAG, "Mix: %lu periods of %lu frames, avg %llu / max %lu cycles per period",
+                 (unsigned long)pcm.mix_periods, (unsigned long)pcm.period_frames,
+                 pcm.mix_cycles / pcm.mix_periods, (unsigned long)pcm.mix_cycles_max);
+    }
+#if CONFIG_APP_MUSIC_LYRICS
+    music_lyrics_stats_t ly;
+    music_lyrics_get_stats(&ly);
+    if (ly.loads || ly.errors) {
+        ESP_LOGI(TAG, "Lyrics: %lu loaded (last %lu us), %lu without .lrc, %lu errors, %lu lines now, %lu lookups, %lu line changes",
+                 (unsigned long)ly.loads, (unsigned long)ly.parse_us, (unsigned long)ly.missing, (unsigned long)ly.errors,
+                 (unsigned long)ly.lines, (unsigned long)ly.lookups, (unsigned long)ly.changes);
+    }
+#endif
+
+    for (int m = 0; m < BSP_DISP_RENDER_MAX; m++) {
+        bsp_disp_flush_stats_t fl;
+        bsp_display_get_flush_stats(m, &fl);
+        if (fl.refreshes) {
+            ESP_LOGI(TAG, "LCD %s%s: %lu refreshes, avg %.1f ms, max %lu ms, %.1f transfers, %.1f KB per refresh",
+                     m == BSP_DISP_RENDER_DIRECT ? "direct" : "partial", m == bsp_display_get_render_mode() ? " (active)" : "",
+                     (unsigned long)fl.refreshes, (double)fl.refr_ms_total / fl.refreshes, (unsigned long)fl.refr_ms_max,
+                     (double)fl.transfers / fl.refreshes, (double)fl.bytes / fl.refreshes / 1024);
+            if (fl.busy_us) {
+                // 重叠率: 传输时间里有多少被渲染盖住了 链路速率和80MHz的理论值比较
+                ESP_LOGI(TAG, "LCD %s SPI: busy %.1f%% of refresh time, %.1f%% overlapped with rendering, %.1f Mbit/s",
+                         m == BSP_DISP_RENDER_DIRECT ? "direct" : "partial",
+                         fl.refr_ms_total ? 100.0 * fl.busy_us / (fl.refr_ms_total * 1000.0) : 0.0,
+                         fl.wait_us < fl.busy_us ? 100.0 * (fl.busy_us - fl.wait_us) / fl.busy_us : 0.0,
+                         8.0 * fl.bytes / fl.busy_us);
+            }
+        }
+    }
+    if (bsp_display_get_vsync()) {
+        bsp_vsync_stats_t vs;
+        bsp_display_get_vsync_stats(&vs);
+        ESP_LOGI(TAG, "LCD vsync: %lu frames on %lu TE edges, %lu dropped, %lu late, %lu timeouts, avg wait %.1f ms",
+                 (unsigned long)vs.frames, (unsigned long)vs.te_edges, (unsigned long)vs.dropped, (unsigned long)vs.late,
+                 (unsigned long)vs.timeouts, vs.frames ? vs.wait_us / 1000.0 / vs.frames : 0.0);
+    }
+    bsp_touch_stats_t tc;
+    bsp_touch_get_stats(&tc);
+    if (tc.reads) {
+        ESP_LOGI(TAG, "Touch%s: %lu reads, %lu skipped, idle %.1f reads/s, %lu presses, latency avg %.1f ms max %.1f ms",
+                 tc.irq ? " (INT)" : " (polled)", (unsigned long)tc.reads, (unsigned long)tc.skipped,
+                 tc.idle_us ? tc.idle_reads * 1e6 / tc.idle_us : 0.0, (unsigned long)tc.presses,
+                 tc.presses ? tc.latency_us / 1000.0 / tc.presses : 0.0, tc.latency_max_us / 1000.0);
+    }
+    ui_perf_log();
+    ui_screen_log();
+    pic_cache_stats_t pc;
+    pic_cache_get_stats(&pc);
+    if (pc.hits + pc.misses) {
+        ESP_LOGI(TAG, "Photo cache: %lu hits, %lu misses, %lu prefetched, %lu waits, %lu JPEG streamed, %lu evicted, %lu uncacheable, %lu entries %lu KB, avg decode %.1f ms",
+                 (unsigned long)pc.hits, (unsigned long)pc.misses, (unsigned long)pc.prefetched, (unsigned long)pc.waits, (unsigned long)pc.streamed,
+                 (unsigned long)pc.evictions, (unsigned long)pc.uncacheable, (unsigned long)pc.entries, (unsigned long)pc.bytes / 1024,
+                 pc.misses + pc.prefetched ? pc.decode_us / 1000.0 / (pc.misses + pc.prefetched) : 0.0);
+    }
+    pic_thumb_stats_t pt;
+    pic_thumb_get_stats(&pt);
+    if (pt.requests) {
+        ESP_LOGI(TAG, "Thumbnails: %lu requests, %lu loaded (avg %.1f ms), %lu generated (avg %.1f ms), %lu failed, %lu canceled",
+                 (unsigned long)pt.requests, (unsigned long)pt.loaded, pt.loaded ? pt.load_us / 1000.0 / pt.loaded : 0.0,
+                 (unsigned long)pt.generated, pt.generated ? pt.gen_us / 1000.0 / pt.generated : 0.0, (unsigned long)pt.failed,
+                 (unsigned long)pt.canceled);
+    }
+    ui_gif_stats_t gs;
+    ui_gif_get_stats(&gs);
+    if (gs.players) {
+        ESP_LOGI(TAG, "GIF: %lu decoded (avg %.1f ms), %lu shown, %lu late, %lu cached (%lu KB), %lu streamed, %.1f fps, decode %.1f%% CPU",
+                 (unsigned long)gs.decoded, gs.decoded ? gs.decode_us / 1000.0 / gs.decoded : 0.0, (unsigned long)gs.shown,
+                 (unsigned long)gs.late, (unsigned long)gs.cached, (unsigned long)gs.cache_bytes / 1024, (unsigned long)gs.streamed,
+                 gs.fps, gs.cpu);
+    }
+    ui_avi_stats_t as;
+    ui_avi_get_stats(&as);
+    if (as.players) {
+        ESP_LOGI(TAG, "Video: %lu opened, %lu frames, %lu shown, %lu skipped, %lu dropped, %lu failed, decode avg %.1f ms (max %.1f ms), read %.0f KB/s",
+                 (unsigned long)as.players, (unsigned long)as.frames, (unsigned long)as.shown, (unsigned long)as.skipped,
+                 (unsigned long)as.dropped, (unsigned long)as.failed, as.decoded ? as.decode_us / 1000.0 / as.decoded : 0.0,
+                 as.max_decode_us / 1000.0, as.read_us ? as.bytes * 1e6 / 1024.0 / as.read_us : 0.0);
+    }
+    ui_zoom_stats_t zs;
+    ui_zoom_get_stats(&zs);
+    if (zs.opened + zs.failed) {
+        ESP_LOGI(TAG, "Zoom viewer: %lu opened (avg load %.1f ms), %lu failed, %lu renders avg %.2f ms, max %.2f ms",
+                 (unsigned long)zs.opened, zs.opened ? zs.load_us / 1000.0 / zs.opened : 0.0, (unsigned long)zs.failed,
+                 (unsigned long)zs.renders, zs.renders ? zs.render_us / 1000.0 / zs.renders : 0.0, zs.max_render_us / 1000.0);
+    }
+    ui_clock_stats_t ck;
+    ui_clock_get_stats(&ck);
+    if (ck.updates) {
+        ESP_LOGI(TAG, "Clock: %lu ticks, %.2f cells / %lu px dirty per tick, %lu cell draws avg %lu us max %lu us, glyphs %lu B in %lu us",
+                 (unsigned long)ck.updates, (float)ck.cells / ck.updates, (unsigned long)(ck.px / ck.updates),
+                 (unsigned long)ck.draws, (unsigned long)(ck.draws ? ck.draw_us / ck.draws : 0),
+                 (unsigned long)ck.draw_max_us, (unsigned long)ck.cache_bytes, (unsigned long)ck.cache_us);
+    }
+    ui_slide_stats_t ss;
+    ui_slide_get_stats(&ss);
+    if (ss.shows) {
+        ESP_LOGI(TAG, "Slideshow: %lu shown, %lu slides, %lu decoded (avg %.1f ms, max %.1f ms), %lu late (max %lu ms), %lu failed, fade step avg %.2f ms",
+                 (unsigned long)ss.shows, (unsigned long)ss.slides, (unsigned long)ss.decoded,
+                 ss.decoded ? ss.decode_us / 1000.0 / ss.decoded : 0.0, ss.max_decode_us / 1000.0,
+                 (unsigned long)ss.late, (unsigned long)ss.max_late_ms, (unsigned long)ss.failed,
+                 ss.fade_steps ? ss.blend_us / 1000.0 / ss.fade_steps : 0.0);
+    }
+#if CONFIG_APP_NET_PIC
+    net_pic_stats_t np;
+    net_pic_get_stats(&np);
+    if (np.loaded || np.failed) {
+        ESP_LOGI(TAG, "Net pic: %lu loaded (first rows avg %lu ms max %lu ms, done avg %lu ms max %lu ms), %lu failed, %lu unsupported, %lu cancelled, %lu reused, hits %lu / waits %lu, %llu KB, last %lu kbps",
+                 (unsigned long)np.loaded, (unsigned long)(np.loaded ? np.first_ms_total / np.loaded : 0),
+                 (unsigned long)np.first_ms_max, (unsigned long)(np.loaded ? np.load_ms_total / np.loaded : 0),
+                 (unsigned long)np.load_ms_max, (unsigned long)np.failed, (unsigned long)np.unsupported,
+                 (unsigned long)np.cancelled, (unsigned long)np.reused, (unsigned long)np.hits,
+                 (unsigned long)np.waits, (unsigned long long)np.bytes / 1024, (unsigned long)np.kbps);
+    }
+#endif
+    bsp_spiffs_stats_t sp;
+    bsp_spiffs_get_stats(&sp);
+    ESP_LOGI(TAG, "Storage: %s, mounted in %.1f ms%s, %lu/%lu KB used, last read test %lu files %.0f KB/s",
+             sp.littlefs ? "LittleFS" : "SPIFFS", sp.mount_us / 1000.0, sp.migrated ? " (migrated from SPIFFS)" : "",
+             (unsigned long)(sp.used / 1024), (unsigned long)(sp.total / 1024), (unsigned long)sp.files,
+             sp.read_us ? sp.bytes * 1e6 / 1024 / sp.read_us : 0.0);
+    sd_fs_stats_t fs;
+    sd_fs_get_stats(&fs);
+    if (fs.opened + fs.failed) {
+        ESP_LOGI(TAG, "SD fs: %lu files (avg %.1f ms, max %.1f ms), %lu failed, %lu KB, %lu reads -> %lu SD reads (%lu direct)",
+                 (unsigned long)fs.opened, fs.opened ? fs.open_us / 1000.0 / fs.opened : 0.0, fs.max_open_us / 1000.0,
+                 (unsigned long)fs.failed, (unsigned long)(fs.bytes / 1024), (unsigned long)fs.reads,
+                 (unsigned long)fs.fills, (unsigned long)fs.direct);
+    }
+    fd_pool_stats_t fp;
+    fd_pool_get_stats(&fp);
+    if (fp.opens) {
+        ESP_LOGI(TAG, "FD pool: %lu opens, %lu shared, %lu reused, %lu stale, %lu evicted, %lu expired, %lu retries, %lu failed, %lu/%d fds open (max %lu, max %lu refs)",
+                 (unsigned long)fp.opens, (unsigned long)fp.shared, (unsigned long)fp.reused, (unsigned long)fp.stale,
+                 (unsigned long)fp.evicted, (unsigned long)fp.expired, (unsigned long)fp.retries, (unsigned long)fp.failed,
+                 (unsigned long)fp.open_fds, FD_POOL_SLOTS, (unsigned long)fp.max_fds, (unsigned long)fp.max_refs);
+    }
+    sd_dir_cache_stats_t dc;
+    sd_dir_cache_get_stats(&dc);
+    if (dc.hits + dc.misses) {
+        ESP_LOGI(TAG, "Dir cache: %lu hits, %lu misses, %lu invalidated, %lu discarded, %lu restored, %lu evicted, %lu dirs %lu KB",
+                 (unsigned long)dc.hits, (unsigned long)dc.misses, (unsigned long)dc.invalidated, (unsigned long)dc.discarded,
+                 (unsigned long)dc.restored,
+                 (unsigned long)dc.evictions, (unsigned long)dc.entries, (unsigned long)dc.bytes / 1024);
+    }
+    media_lib_stats_t ml;
+    media_lib_get_stats(&ml);
+    if (ml.crawls || ml.loaded) {
+        ESP_LOGI(TAG, "Media lib: %lu dirs, %lu files (%lu media), %lu crawls (last %lu ms), %lu dirs read, %lu reused, %lu saves%s",
+                 (unsigned long)ml.dirs, (unsigned long)ml.files, (unsigned long)ml.media, (unsigned long)ml.crawls,
+                 (unsigned long)ml.last_crawl_ms, (unsigned long)ml.dirs_read, (unsigned long)ml.dirs_reused,
+                 (unsigned long)ml.saves, ml.loaded ? ", loaded from card" : "");
+    }
+    media_search_stats_t ms;
+    media_search_get_stats(&ms);
+    if (ms.files) {
+        ESP_LOGI(TAG, "Search: %lu names, %lu trigrams, %lu KB postings (%s %lu ms), %lu queries (%lu scans, avg %lu us, max %lu us), %lu candidates, %lu hits",
+                 (unsigned long)ms.files, (unsigned long)ms.trigrams, (unsigned long)ms.bytes / 1024,
+                 ms.loaded ? "loaded" : "built in", (unsigned long)ms.build_ms, (unsigned long)ms.queries,
+                 (unsigned long)ms.scans, (unsigned long)(ms.queries ? ms.query_us / ms.queries : 0),
+                 (unsigned long)ms.max_query_us, (unsigned long)ms.candidates, (unsigned long)ms.hits);
+    }
+    gallery_index_stats_t gi;
+    gallery_index_get_stats(&gi);
+    if (gi.appends || gi.lookups) {
+        ESP_LOGI(TAG, "Gallery index: %lu appends, %lu lookups (%lu records, max %lu us), %lu indexed, %lu stat'ed, %lu rewrites, %lu errors",
+                 (unsigned long)gi.appends, (unsigned long)gi.lookups, (unsigned long)gi.records,
+                 (unsigned long)gi.max_lookup_us, (unsigned long)gi.hits, (unsigned long)gi.misses,
+                 (unsigned long)gi.compactions, (unsigned long)gi.errors);
+    }
+    imu_stats_t imu;
+    imu_get_stats(&imu);
+    if (imu.bursts) {
+        ESP_LOGI(TAG, "IMU: %lu samples in %lu bursts (max %lu, avg %lu us I2C), %lu overflows (%lu lost), %lu errors",
+                 (unsigned long)imu.samples, (unsigned long)imu.bursts, (unsigned long)imu.max_burst,
+                 (unsigned long)(imu.i2c_us / imu.bursts), (unsigned long)imu.overflows, (unsigned long)imu.lost,
+                 (unsigned long)imu.errors);
+    }
+    attitude_stats_t at;
+    attitude_get_stats(&at);
+    if (at.updates) {
+        ESP_LOGI(TAG, "Attitude: %lu updates in %lu batches, %lu cycles/update, %lu gaps",
+                 (unsigned long)at.updates, (unsigned long)at.batches, (unsigned long)(at.cycles / at.updates),
+                 (unsigned long)at.gaps);
+    }
+#if CONFIG_APP_IMU_GESTURE
+    imu_gesture_stats_t ig;
+    imu_gesture_get_stats(&ig);
+    if (ig.samples) {
+        uint32_t fired = 0;
+        for (int i = 0; i < IMU_GESTURE_COUNT; i++) {
+            fired += ig.count[i];
+        }
+        ESP_LOGI(TAG, "Gesture: %lu shake, %lu face down, %lu face up, %lu raise (%lu rejected), latency avg %lu / max %lu ms, batch lag avg %lu / max %lu us, %lu cycles/sample, CPU %lu.%lu%%, %lu gaps",
+                 (unsigned long)ig.count[IMU_GESTURE_SHAKE], (unsigned long)ig.count[IMU_GESTURE_FACE_DOWN],
+                 (unsigned long)ig.count[IMU_GESTURE_FACE_UP], (unsigned long)ig.count[IMU_GESTURE_RAISE],
+                 (unsigned long)ig.rejected, (unsigned long)(fired ? ig.latency_ms_total / fired : 0),
+                 (unsigned long)ig.latency_ms_max, (unsigned long)(fired ? ig.lag_us_total / fired : 0),
+                 (unsigned long)ig.lag_us_max, (unsigned long)(ig.cycles / ig.samples),
+                 (unsigned long)ig.cpu_permille / 10, (unsigned long)ig.cpu_permille % 10, (unsigned long)ig.gaps);
+    }
+#endif
+#if CONFIG_APP_PEDOMETER
+    pedometer_stats_t pd;
+    pedometer_get_stats(&pd);
+    if (pd.wakes) {
+        pedo_day_t today;
+        pedometer_today(&today);
+        ESP_LOGI(TAG, "Steps: %lu today (walk %u min, run %u min), now %s, %lu wakes (%lu without steps), %lu saves (%lu failed), per hour: FIFO on %lu s, CPU %lu ms, ~%lu uA",
+                 (unsigned long)today.steps, today.walk_min, today.run_min, pedometer_activity_name(pedometer_activity()),
+                 (unsigned long)pd.wakes, (unsigned long)pd.false_wakes, (unsigned long)pd.saves,
+                 (unsigned long)pd.save_errors, (unsigned long)pd.active_s_per_h, (unsigned long)pd.cpu_ms_per_h,
+                 (unsigned long)pd.ua);
+    }
+#endif
+#if CONFIG_APP_UI_ORIENT
+    ui_orient_stats_t uo;
+    ui_orient_get_stats(&uo);
+    if (uo.polls) {
+        bsp_rotate_stats_t rs;
+        bsp_display_get_rotate_stats(&rs);
+        ESP_LOGI(TAG, "Orient: %lu polls (%lu register reads, %lu unsettled), %lu flips (%lu deferred), now %d deg, switch last %lu / max %lu us",
+                 (unsigned long)uo.polls, (unsigned long)uo.reg_reads, (unsigned long)uo.unsettled,
+                 (unsigned long)uo.flips, (unsigned long)uo.deferred, bsp_display_get_rotation() * 90,
+                 (unsigned long)rs.last_us, (unsigned long)rs.max_us);
+    }
+#endif
+    imu_log_stats_t il;
+    imu_log_get_stats(&il);
+    if (il.records) {
+        ESP_LOGI(TAG, "IMU log: %lu samples in %lu records, %llu KB, lost %lu fifo / %lu ring / %lu buffer, ring peak %lu KB, max write %lu ms",
+                 (unsigned long)il.samples, (unsigned long)il.records, (unsigned long long)(il.bytes / 1024),
+                 (unsigned long)il.lost_fifo, (unsigned long)il.lost_ring, (unsigned long)il.lost_buf,
+                 (unsigned long)(il.ring_peak / 1024), (unsigned long)il.max_write_us / 1000);
+    }
+    pm_ctl_stats_t pm;
+    pm_ctl_get_stats(&pm);
+    for (int i = 0; i < PM_STATE_COUNT; i++) {
+        if (pm.ms[i]) {
+            ESP_LOGI(TAG, "PM %s: %llu s, %lu acquires, ~%lu mA", pm_ctl_state_name(i), pm.ms[i] / 1000,
+                     i < PM_CLIENT_COUNT ? (unsigned long)pm.acquires[i] : 0UL, (unsigned long)pm.ma[i]);
+        }
+    }
+    ESP_LOGI(TAG, "PM: ~%lu mA avg%s, %lu touch wakes at low clock, avg %.1f / max %.1f ms",
+             (unsigned long)pm.avg_ma, pm.light_sleep ? " with light sleep" : "", (unsigned long)pm.wakes,
+             pm.wakes ? pm.wake_us_total / 1000.0 / pm.wakes : 0.0, pm.wake_us_max / 1000.0);
+#if CONFIG_APP_PSRAM_BW
+    psram_bw_stats_t bw;
+    psram_bw_get_stats(&bw);
+    if (bw.level_ms[PSRAM_BW_OK] + bw.level_ms[PSRAM_BW_BUSY] + bw.level_ms[PSRAM_BW_CRITICAL]) {
+        ESP_LOGI(TAG, "PSRAM bw: %lu%% of budget (peak %lu%%), cpu %lu KB/s%s, cam %lu KB/s, lcd %lu KB/s, "
+                 "busy %llu s, critical %llu s, risks cam %lu audio %lu, %lu yields (%lu slowed, %lu waited %llu ms, %lu timeouts)",
+                 (unsigned long)bw.util_pct, (unsigned long)bw.util_peak_pct, (unsigned long)bw.cpu_kbps,
+                 bw.hw_counters ? "" : " (no counters)", (unsigned long)bw.src_kbps[PSRAM_BW_SRC_CAMERA],
+                 (unsigned long)bw.src_kbps[PSRAM_BW_SRC_LCD], bw.level_ms[PSRAM_BW_BUSY] / 1000,
+                 bw.level_ms[PSRAM_BW_CRITICAL] / 1000, (unsigned long)bw.risks[PSRAM_BW_RT_CAMERA],
+                 (unsigned long)bw.risks[PSRAM_BW_RT_AUDIO], (unsigned long)bw.yields, (unsigned long)bw.throttled,
+                 (unsigned long)bw.waits, bw.wait_ms, (unsigned long)bw.wait_timeouts);
+    }
+#endif
+    // 和上一次打印比 每秒被叫醒几次 界面没事时应该只剩时钟和空闲管理
+    static uint32_t last_wake[3];
+    static int64_t last_wake_us;
+    int64_t wake_now = esp_timer_get_time();
+    uint32_t wake_cur[3] = {pm.idle_wakeups[0], pm.idle_wakeups[1], lvgl_port_task_wakeups()};
+    if (last_wake_us) {
+        float sec = (wake_now - last_wake_us) / 1e6f;
+        ESP_LOGI(TAG, "Wakeups/s: core0 %.1f, core1 %.1f, LVGL task %.1f", (wake_cur[0] - last_wake[0]) / sec,
+                 (wake_cur[1] - last_wake[1]) / sec, (wake_cur[2] - last_wake[2]) / sec);
+    }
+    memcpy(last_wake, wake_cur, sizeof(last_wake));
+    last_wake_us = wake_now;
+    font_ext_stats_t fe;
+    font_ext_get_stats(&fe);
+    if (fe.lookups) {
+        ESP_LOGI(TAG, "Font ext: %lu glyphs in flash (%lu KB, mapped in %lu us), %lu lookups, %lu not found, %lu hits / %lu decodes (avg %lu / max %lu us), %lu cached",
+                 (unsigned long)fe.glyphs, (unsigned long)fe.bytes / 1024, (unsigned long)fe.map_us,
+                 (unsigned long)fe.lookups, (unsigned long)fe.not_found, (unsigned long)fe.hits, (unsigned long)fe.decodes,
+                 (unsigned long)(fe.decodes ? fe.decode_us / fe.decodes : 0), (unsigned long)fe.decode_max_us,
+                 (unsigned long)fe.cached);
+    }
+    asset_part_stats_t as;
+    asset_part_get_stats(&as);
+    if (as.lookups) {
+        ESP_LOGI(TAG, "Assets: %lu images in flash (%lu KB, pixels %lu%% of raw, mapped in %lu us), %lu lookups, %lu misses, %lu decodes (avg %lu / max %lu us), %lu KB in PSRAM",
+                 (unsigned long)as.images, (unsigned long)as.bytes / 1024,
+                 (unsigned long)(as.raw ? (uint64_t)as.packed * 100 / as.raw : 0), (unsigned long)as.map_us,
+                 (unsigned long)as.lookups, (unsigned long)as.misses, (unsigned long)as.decodes,
+                 (unsigned long)(as.decodes ? as.decode_us / as.decodes : 0), (unsigned long)as.decode_max_us,
+                 (unsigned long)as.cached / 1024);
+    }
+    ui_layer_stats_t ly;
+    ui_layer_get_stats(&ly);
+    for (int k = 0; k < 2; k++) {
+        if (ly.scrolls[k] && ly.scroll_us[k]) {
+            ESP_LOGI(TAG, "Scroll (%s): %lu scrolls, %lu fps, render %lu%% of the time, %lu snapshots (%lu us, %lu KB)",
+                     k ? "snapshots" : "live", (unsigned long)ly.scrolls[k],
+                     (unsigned long)(ly.frames[k] * 1000000ULL / ly.scroll_us[k]),
+                     (unsigned long)(ly.render_us[k] * 100 / ly.scroll_us[k]), (unsigned long)ly.snapshots,
+                     (unsigned long)ly.snapshot_us, (unsigned long)ly.bytes / 1024);
+        }
+    }
+    ui_trans_stats_t tr;
+    ui_trans_get_stats(&tr);
+    if (tr.transitions && tr.anim_us && tr.frames) {
+        ESP_LOGI(TAG, "Transitions: %lu played, %lu skipped, %lu fps, %lu us render per frame, snapshot avg %lu / max %lu us",
+                 (unsigned long)tr.transitions, (unsigned long)tr.skipped,
+                 (unsigned long)(tr.frames * 1000000ULL / tr.anim_us), (unsigned long)(tr.render_us / tr.frames),
+                 (unsigned long)(tr.snapshot_us / tr.snapshots), (unsigned long)tr.snapshot_max_us);
+    }
+    for (int i = 0; i < APP_RES_COUNT; i++) {
+        app_res_stats_t rs;
+        app_res_get_stats(i, &rs);
+        if (rs.ups || rs.reuses) {
+            ESP_LOGI(TAG, "Res %s: %s, %u holders, %lu up / %lu down, %lu reused, %lu failed, up avg %lu / max %lu us",
+                     rs.name, rs.on ? "on" : "off", rs.holders, (unsigned long)rs.ups, (unsigned long)rs.downs,
+                     (unsigned long)rs.reuses, (unsigned long)rs.failed,
+                     (unsigned long)(rs.ups ? rs.up_us / rs.ups : 0), (unsigned long)rs.up_us_max);
+        }
+    }
+    evt_bus_stats_t eb;
+    evt_bus_get_stats(&eb);
+    if (eb.published) {
+        ESP_LOGI(TAG, "Events: %lu published, %lu direct, %lu deferred, %lu dropped, max %lu pending, delay avg %lu / max %lu us",
+                 (unsigned long)eb.published, (unsigned long)eb.direct, (unsigned long)eb.deferred,
+                 (unsigned long)eb.dropped, (unsigned long)eb.max_pending,
+                 (unsigned long)(eb.deferred ? eb.delay_us / eb.deferred : 0), (unsigned long)eb.max_delay_us);
+    }
+    idle_mgr_stats_t idle;
+    idle_mgr_get_stats(&idle);
+    if (idle.dims || idle.offs) {
+        ESP_LOGI(TAG, "Idle: on %llu s, dim %llu s, off %llu s, ~%lu mA avg, %lu wakes (%lu motion), avg %lu / max %lu ms",
+                 idle.on_ms / 1000, idle.dim_ms / 1000, idle.off_ms / 1000, (unsigned long)idle.avg_ma,
+                 (unsigned long)idle.wakes, (unsigned long)idle.motion_wakes,
+                 (unsigned long)(idle.wakes ? idle.wake_us_total / idle.wakes / 1000 : 0), (unsigned long)idle.wake_us_max / 1000);
+    }
+#if CONFIG_APP_STANDBY
+    standby_stats_t sb;
+    standby_get_stats(&sb);
+    if (sb.entries) {
+        ESP_LOGI(TAG, "Standby: %lu times, %llu s, %.1f wakeups/s, ~%d mA, woken by touch %lu / key %lu / motion %lu / ui %lu / client %lu, "
+                 "enter max %lu ms, resume avg %lu / max %lu ms",
+                 (unsigned long)sb.entries, sb.standby_ms / 1000, sb.standby_ms ? sb.idle_wakeups * 1000.0 / sb.standby_ms : 0.0,
+                 CONFIG_APP_PM_STANDBY_MA, (unsigned long)sb.wakes[STANDBY_WAKE_TOUCH], (unsigned long)sb.wakes[STANDBY_WAKE_KEY],
+                 (unsigned long)sb.wakes[STANDBY_WAKE_MOTION], (unsigned long)sb.wakes[STANDBY_WAKE_UI],
+                 (unsigned long)sb.wakes[STANDBY_WAKE_CLIENT], (unsigned long)sb.enter_us_max / 1000,
+                 (unsigned long)(sb.resumes ? sb.resume_us_total / sb.resumes / 1000 : 0), (unsigned long)sb.resume_us_max / 1000);
+    }
+#endif
+    voice_cmd_stats_t vc;
+    voice_cmd_get_stats(&vc);
+    if (vc.fed) {
+        ESP_LOGI(TAG, "Voice: %lu wakes, %lu commands, %lu timeouts, wake->tip avg %lu / max %lu ms, command->action avg %lu / max %lu ms",
+                 (unsigned long)vc.wakes, (unsigned long)vc.commands, (unsigned long)vc.timeouts,
+                 (unsigned long)(vc.wakes ? vc.wake_ui_us_total / vc.wakes / 1000 : 0), (unsigned long)vc.wake_ui_us_max / 1000,
+                 (unsigned long)(vc.commands ? vc.cmd_us_total / vc.commands / 1000 : 0), (unsigned long)vc.cmd_us_max / 1000);
+        ESP_LOGI(TAG, "Voice: AFE lag %lu ms (max %lu), %lu chunks fed, %lu skipped, %.0f cycles/chunk feed (pack %.0f, scalar was %lu), CPU core0 %u%% core1 %u%%, feed task %u%%, detect task %u%%",
+                 (unsigned long)vc.lag_ms, (unsigned long)vc.lag_ms_max, (unsigned long)vc.fed, (unsigned long)vc.skipped,
+                 (double)vc.feed_cycles / vc.fed, (double)vc.pack_cycles / vc.fed, (unsigned long)vc.pack_scalar_cycles, vc.core_load[0], vc.core_load[1], vc.feed_load, vc.detect_load);
+        ESP_LOGI(TAG, "Voice music on %llu s: %lu wakes, %lu commands, %lu timeouts, CPU %u%%/%u%% | off %llu s: %lu wakes, %lu commands, %lu timeouts, CPU %u%%/%u%%",
+                 vc.music_ms / 1000, (unsigned long)vc.wakes_music, (unsigned long)vc.commands_music,
+                 (unsigned long)vc.timeouts_music, vc.load_music[0], vc.load_music[1], vc.quiet_ms / 1000,
+                 (unsigned long)(vc.wakes - vc.wakes_music), (unsigned long)(vc.commands - vc.commands_music),
+                 (unsigned long)(vc.timeouts - vc.timeouts_music), vc.load_quiet[0], vc.load_quiet[1]);
+    }
+    if (vc.fed) {
+        ESP_LOGI(TAG, "Voice stages: AFE task %u%%, fetch %lu us/chunk with WakeNet / %lu without, MultiNet avg %lu / max %lu us, speech end->action avg %lu / max %lu ms, %lu false wakes",
+                 vc.afe_load, (unsigned long)vc.fetch_wn_us, (unsigned long)vc.fetch_vad_us,
+                 (unsigned long)(vc.mn_chunks ? vc.mn_us_total / vc.mn_chunks : 0), (unsigned long)vc.mn_us_max,
+                 (unsigned long)(vc.commands ? vc.eou_us_total / vc.commands / 1000 : 0), (unsigned long)vc.eou_us_max / 1000,
+                 (unsigned long)vc.false_wakes);
+    }
+#if CONFIG_APP_VOICE_GATE
+    if (vc.vad_chunks) {
+        uint64_t gate_ms = vc.gate_open_ms + vc.gate_closed_ms;
+        ESP_LOGI(TAG, "Voice gate: open %llu%% of %llu s, %lu opens (%lu without a wake), %lu chunks held back, %lu pre-roll chunks fed, VAD %lu cycles/chunk, CPU open %u%%/%u%% (always-on cost) vs gated %u%%/%u%%",
+                 gate_ms ? vc.gate_open_ms * 100 / gate_ms : 0, gate_ms / 1000, (unsigned long)vc.gate_opens,
+                 (unsigned long)vc.gate_idle_opens, (unsigned long)vc.gated, (unsigned long)vc.gate_preroll_chunks,
+                 (unsigned long)(vc.vad_cycles / vc.vad_chunks), vc.load_open[0], vc.load_open[1],
+                 vc.load_gated[0], vc.load_gated[1]);
+    }
+#endif
+#if CONFIG_APP_VOICE_VOCAB
+    voice_vocab_stats_t vv;
+    voice_vocab_get_stats(&vv);
+    if (vv.rebuilds) {
+        ESP_LOGI(TAG, "Voice vocab: %lu songs + %lu apps, %lu rebuilds (+%lu / -%lu, %lu rejected), %lu without pinyin, %lu over the limit, scan %lu ms, apply %lu us (max %lu), %lu plays, %lu missing, speech end->action avg %lu / max %lu ms",
+                 (unsigned long)vv.songs, (unsigned long)vv.apps, (unsigned long)vv.rebuilds, (unsigned long)vv.added,
+                 (unsigned long)vv.removed, (unsigned long)vv.rejected, (unsigned long)vv.no_pinyin, (unsigned long)vv.over,
+                 (unsigned long)vv.scan_ms, (unsigned long)vv.apply_us, (unsigned long)vv.apply_us_max,
+                 (unsigned long)vv.plays, (unsigned long)vv.missing,
+                 (unsigned long)(vc.dyn_commands ? vc.dyn_eou_us_total / vc.dyn_commands / 1000 : 0),
+                 (unsigned long)vc.dyn_eou_us_max / 1000);
+    }
+#endif
+#if CONFIG_APP_VOICE_BENCH
+    voice_bench_stats_t vb;
+    voice_bench_get_stats(&vb);
+    if (vb.probes[VOICE_BENCH_IDLE] || vb.probes[VOICE_BENCH_CAMERA] || vb.probes[VOICE_BENCH_GIF]) {
+        ESP_LOGI(TAG, "Voice bench: PSRAM idle %lu / camera %lu / gif %lu KB/s (min %lu / %lu / %lu), %.2f false wakes/h, %lu rows, %lu dropped, %lu write errors%s",
+                 (unsigned long)vb.psram_kbps[VOICE_BENCH_IDLE], (unsigned long)vb.psram_kbps[VOICE_BENCH_CAMERA],
+                 (unsigned long)vb.psram_kbps[VOICE_BENCH_GIF], (unsigned long)vb.psram_kbps_min[VOICE_BENCH_IDLE],
+                 (unsigned long)vb.psram_kbps_min[VOICE_BENCH_CAMERA], (unsigned long)vb.psram_kbps_min[VOICE_BENCH_GIF],
+                 voice_bench_false_per_hour(), (unsigned long)vb.rows, (unsigned long)vb.dropped,
+                 (unsigned long)vb.write_errors, vb.logging ? "" : ", no file");
+    }
+#endif
+#if CONFIG_APP_VOICE_TTS
+    voice_tts_stats_t vt;
+    voice_tts_get_stats(&vt);
+    if (vt.ready) {
+        ESP_LOGI(TAG, "Voice TTS: cache %lu KB %s in %lu ms, %lu said, %lu synthesized (first chunk max %lu ms, %.2fx realtime), %lu dropped, %lu loads (last %lu ms)",
+                 (unsigned long)vt.cache_bytes / 1024, vt.from_file ? "read" : "built", (unsigned long)vt.build_ms,
+                 (unsigned long)vt.says, (unsigned long)vt.texts, (unsigned long)vt.first_us_max / 1000,
+                 vt.synth_frames ? (double)vt.synth_us / 1e6 / ((double)vt.synth_frames / VOICE_TTS_RATE) : 0.0,
+                 (unsigned long)vt.dropped, (unsigned long)vt.loads, (unsigned long)vt.load_ms);
+    }
+#endif
+#if CONFIG_APP_VOICE_MEMO
+    voice_memo_stats_t vm;
+    voice_memo_get_stats(&vm);
+    if (vm.files) {
+        ESP_LOGI(TAG, "Voice memo%s: %llu s in %lu files, %llu KB, ring peak %lu ms, %lu dropped, %lu mic skipped, write avg %lu / max %lu us, header max %lu us, %lu cycles/block",
+                 vm.recording ? " (recording)" : "", vm.samples / VOICE_MEMO_RATE, (unsigned long)vm.files,
+                 vm.bytes / 1024, (unsigned long)(vm.ring_peak / (VOICE_MEMO_RATE / 1000)), (unsigned long)vm.dropped,
+                 (unsigned long)vm.mic_skipped, (unsigned long)(vm.writes ? vm.write_us / vm.writes : 0),
+                 (unsigned long)vm.write_max_us, (unsigned long)vm.header_max_us, (unsigned long)vm.encode_cycles);
+    }
+#endif
+    wifi_fast_stats_t wf;
+    wifi_fast_get_stats(&wf);
+    if (wf.count[WIFI_FAST_DIRECT] || wf.count[WIFI_FAST_FALLBACK] || wf.count[WIFI_FAST_FAILED] || wf.count[WIFI_FAST_MANUAL]) {
+        ESP_LOGI(TAG, "WiFi: last %s %lu ms (best %lu / worst %lu), IP at %lu ms after boot, direct %lu / fallback %lu / failed %lu / manual %lu, %lu NVS saves",
+                 wifi_fast_result_name(wf.last), (unsigned long)wf.last_us / 1000, (unsigned long)wf.best_us / 1000,
+                 (unsigned long)wf.worst_us / 1000, (unsigned long)wf.boot_ms, (unsigned long)wf.count[WIFI_FAST_DIRECT],
+                 (unsigned long)wf.count[WIFI_FAST_FALLBACK], (unsigned long)wf.count[WIFI_FAST_FAILED],
+                 (unsigned long)wf.count[WIFI_FAST_MANUAL], (unsigned long)wf.saves);
+    }
+    wifi_svc_stats_t ws;
+    wifi_svc_get_stats(&ws);
+    if (ws.state != WIFI_SVC_OFF) {
+        ESP_LOGI(TAG, "WiFi svc: %s, init %lu ms, %lu scans (last %lu ms, first AP at %lu ms), %lu connects / %lu failures, %lu drops / %lu reconnects",
+                 wifi_svc_state_name(ws.state), (unsigned long)ws.init_ms, (unsigned long)ws.scans,
+                 (unsigned long)ws.scan_ms_last, (unsigned long)ws.first_result_ms, (unsigned long)ws.connects,
+                 (unsigned long)ws.failures, (unsigned long)ws.drops, (unsigned long)ws.reconnects);
+    }
+    multiroom_stats_t mr;
+    multiroom_get_stats(&mr);
+    if (mr.role != MULTIROOM_OFF) {
+        ESP_LOGI(TAG, "Multiroom %s%s: sync %ld us (max %ld), trim %ld ppm, clock jitter %lu us, %lu played / %lu lost / %lu dropped frames, %lu resyncs, %lu rx / %lu lost packets, %lu tx / %lu errors",
+                 mr.role == MULTIROOM_SENDER ? "sender" : "listener", mr.locked ? " locked" : mr.playing ? " aligning" : "",
+                 (long)mr.sync_us, (long)mr.sync_max_us, (long)mr.trim_ppm, (unsigned long)mr.clock_jitter_us,
+                 (unsigned long)mr.frames_played, (unsigned long)mr.frames_lost, (unsigned long)mr.frames_dropped,
+                 (unsigned long)mr.resyncs, (unsigned long)mr.packets_rx, (unsigned long)mr.packets_lost,
+                 (unsigned long)mr.packets_tx, (unsigned long)mr.tx_errors);
+    }
+#if CONFIG_APP_INTERCOM
+    intercom_stats_t ic;
+    intercom_get_stats(&ic);
+    if (ic.calls) {
+        ESP_LOGI(TAG, "Intercom%s: mouth-to-ear %lu ms (max %lu), glass-to-glass %lu ms (max %lu), rtt %lu us, jitter %lu us, buffer %lu / target %lu ms, audio %lu tx (%lu dropped) / %lu rx, %lu lost, %lu late, %lu skipped, %lu underruns, video %lu tx (%lu dropped) at %lu fps / %lu rx, %lu incomplete, %lu shown, %lu dropped, decode %lu us",
+                 ic.in_call ? " in call" : "", (unsigned long)ic.m2e_ms, (unsigned long)ic.m2e_max_ms,
+                 (unsigned long)ic.g2g_ms, (unsigned long)ic.g2g_max_ms, (unsigned long)ic.rtt_us,
+                 (unsigned long)ic.jitter_us, (unsigned long)ic.depth_ms, (unsigned long)ic.target_ms,
+                 (unsigned long)ic.audio_tx, (unsigned long)ic.audio_tx_dropped, (unsigned long)ic.audio_rx,
+                 (unsigned long)ic.audio_lost, (unsigned long)ic.audio_late, (unsigned long)ic.audio_skipped,
+                 (unsigned long)ic.underruns, (unsigned long)ic.video_tx, (unsigned long)ic.video_tx_dropped,
+                 (unsigned long)ic.video_fps, (unsigned long)ic.video_rx, (unsigned long)ic.video_incomplete,
+                 (unsigned long)ic.video_shown, (unsigned long)ic.video_dropped, (unsigned long)ic.decode_us);
+    }
+#endif
+    alarm_stats_t al;
+    alarm_get_stats(&al);
+    if (al.fast_boot || al.rings || al.sleeps) {
+        ESP_LOGI(TAG, "Alarm: %s%lu ms wake to ready (app %lu ms, sound load %lu ms), sound %ld ms late, lead %lu ms, %lu awake rings, %lu sleeps (%lu early wakes), %s sound %lu Hz %lu KB",
+                 al.fast_boot ? (al.touched ? "fast boot touched, " : "fast boot, ") : "", (unsigned long)al.boot_ms,
+                 (unsigned long)al.app_ms, (unsigned long)al.load_ms, (long)al.late_ms, (unsigned long)al.lead_ms,
+                 (unsigned long)al.rings, (unsigned long)al.sleeps, (unsigned long)al.resleeps,
+                 al.sound_custom ? "custom" : "boot", (unsigned long)al.sound_rate, (unsigned long)al.sound_bytes / 1024);
+    }
+    ota_update_stats_t ou;
+    ota_update_get_stats(&ou);
+    if (ou.state != OTA_UPDATE_IDLE || ou.rolled_back) {
+        ESP_LOGI(TAG, "OTA: %s %s, %lu / %lu KB, download %lu KB/s, flash %lu KB/s (%lu blocks, max %lu us)%s",
+                 ota_update_state_name(ou.state), ou.state == OTA_UPDATE_FAILED ? esp_err_to_name(ou.error) : ou.version,
+                 (unsigned long)ou.bytes / 1024, (unsigned long)ou.total / 1024,
+                 (unsigned long)(ou.net_us ? ou.bytes * 1000000ULL / 1024 / ou.net_us : 0),
+                 (unsigned long)(ou.write_us ? ou.bytes * 1000000ULL / 1024 / ou.write_us : 0),
+                 (unsigned long)ou.blocks, (unsigned long)ou.write_max_us, ou.rolled_back ? ", last update rolled back" : "");
+    }
+    file_server_stats_t fs;
+    file_server_get_stats(&fs);
+    if (fs.running) {
+        ESP_LOGI(TAG, "File server: %lu uploads / %lu failed, %llu KB up at %lu KB/s (last %lu KB/s, %lu%% waiting on socket, %lu timeouts), %lu downloads %llu KB at %lu KB/s, %lu lists (%lu cached)",
+                 (unsigned long)fs.uploads, (unsigned long)fs.upload_failed, fs.upload_bytes / 1024,
+                 (unsigned long)(fs.upload_us ? fs.upload_bytes * 1000000 / 1024 / fs.upload_us : 0),
+                 (unsigned long)fs.last_upload_kbps, (unsigned long)(fs.upload_us ? fs.recv_us * 100 / fs.upload_us : 0),
+                 (unsigned long)fs.recv_timeouts, (unsigned long)fs.downloads, fs.download_bytes / 1024,
+                 (unsigned long)(fs.download_us ? fs.download_bytes * 1000000 / 1024 / fs.download_us : 0),
+                 (unsigned long)fs.lists, (unsigned long)fs.list_cached);
+    }
+#if CONFIG_APP_WEB_DASH
+    web_dash_stats_t wd;
+    web_dash_get_stats(&wd);
+    if (wd.connects) {
+        ESP_LOGI(TAG, "Web dash: %u watching (%lu connects), every %u ms, %lu commands (%lu rejected), %lu samples -> %lu frames (%lu key) / %llu bytes, %lu dropped, %llu%% of columns sent, sample max %lu us, mdns %s",
+                 wd.clients, (unsigned long)wd.connects, wd.period_ms, (unsigned long)wd.commands,
+                 (unsigned long)wd.rejected, (unsigned long)wd.samples, (unsigned long)wd.frames,
+                 (unsigned long)wd.key_frames, (unsigned long long)wd.bytes, (unsigned long)wd.dropped,
+                 (unsigned long long)(wd.cols_sampled ? wd.cols_sent * 100 / wd.cols_sampled : 0),
+                 (unsigned long)wd.sample_max_us, wd.mdns ? "on" : "off");
+    }
+#endif
+#if CONFIG_APP_SCREEN_MIRROR
+    screen_mirror_stats_t sm;
+    screen_mirror_get_stats(&sm);
+    if (sm.connects) {
+        ESP_LOGI(TAG, "Screen mirror: %s, %u watching (%lu connects), tee %lu blocks avg %lu us max %lu us, %lu updates / %lu chunks / %lu rects, %llu KB -> %llu KB sent (%lu%%), encode %llu ms, send wait %llu ms, %lu send failures",
+                 sm.active ? "on" : "off", sm.clients, (unsigned long)sm.connects, (unsigned long)sm.tees,
+                 (unsigned long)(sm.tees ? sm.tee_us / sm.tees : 0), (unsigned long)sm.tee_max_us,
+                 (unsigned long)sm.updates, (unsigned long)sm.chunks, (unsigned long)sm.rects,
+                 (unsigned long long)sm.raw_bytes / 1024, (unsigned long long)sm.bytes / 1024,
+                 (unsigned long)(sm.raw_bytes ? sm.bytes * 100 / sm.raw_bytes : 0),
+                 (unsigned long long)sm.encode_us / 1000, (unsigned long long)sm.send_us / 1000,
+                 (unsigned long)sm.send_failed);
+    }
+#endif
+#if CONFIG_APP_MQTT
+    mqtt_svc_stats_t mq;
+    mqtt_svc_get_stats(&mq);
+    ESP_LOGI(TAG, "MQTT: %s (%lu connects / %lu drops), %lu rows (%lu lost) -> %lu messages, %lu queued in %lu KB, %lu dropped, %lu bursts / %lu published / %llu KB (%lu failed), %lu commands (%lu rejected)",
+             mq.connected ? "connected" : "offline", (unsigned long)mq.connects, (unsigned long)mq.disconnects,
+             (unsigned long)mq.rows, (unsigned long)mq.rows_lost, (unsigned long)mq.queued,
+             (unsigned long)mq.queue_count, (unsigned long)mq.queue_bytes / 1024, (unsigned long)mq.dropped,
+             (unsigned long)mq.bursts, (unsigned long)mq.published, (unsigned long long)mq.bytes / 1024,
+             (unsigned long)mq.publish_failed, (unsigned long)mq.commands, (unsigned long)mq.rejected);
+#endif
+    ble_svc_stats_t bs;
+    ble_svc_get_stats(&bs);
+    if (bs.opens) {
+        ESP_LOGI(TAG, "BLE: %s, %lu stack starts (last %lu ms), %lu opens, %lu connects (encrypted in %lu ms), %lu auth failures, %lu bonded",
+                 ble_svc_state_name(bs.state), (unsigned long)bs.starts, (unsigned long)bs.start_ms,
+                 (unsigned long)bs.opens, (unsigned long)bs.connects, (unsigned long)bs.secure_ms,
+                 (unsigned long)bs.auth_failed, (unsigned long)bs.bonded);
+    }
+    hid_sched_stats_t hs;
+    hid_sched_get_stats(&hs);
+    if (hs.inputs || hs.connected_us) {
+        ESP_LOGI(TAG, "BLE HID: %lu inputs -> %lu reports (%lu coalesced, %lu deferred, %lu overflow), %lu.%02lu reports/s, key to link layer avg %lu us max %lu us, interval %u.%02u ms latency %u (%s, %lu updates / %lu failed)",
+                 (unsigned long)hs.inputs, (unsigned long)hs.sent, (unsigned long)hs.coalesced,
+                 (unsigned long)hs.deferred, (unsigned long)hs.overflow,
+                 (unsigned long)(hs.connected_us ? hs.sent * 1000000ULL / hs.connected_us : 0),
+                 (unsigned long)(hs.connected_us ? hs.sent * 100000000ULL / hs.connected_us % 100 : 0),
+                 (unsigned long)(hs.done ? hs.latency_us / hs.done : 0), (unsigned long)hs.latency_max_us,
+                 hs.interval * 125 / 100, hs.interval * 125 % 100, hs.latency, hs.fast ? "fast" : "slow",
+                 (unsigned long)hs.param_updates, (unsigned long)hs.param_failed);
+    }
+    air_mouse_stats_t am;
+    air_mouse_get_stats(&am);
+    if (am.batches) {
+        ESP_LOGI(TAG, "Air mouse: %s, %lu batches / %lu samples, %lu moves -> %lu reports, motion to link layer avg %lu us max %lu us, sample age avg %lu us max %lu us, proc max %lu us",
+                 am.active ? "on" : "off", (unsigned long)am.batches, (unsigned long)am.samples,
+                 (unsigned long)am.moves, (unsigned long)hs.mouse_reports,
+                 (unsigned long)(hs.mouse_done ? hs.mouse_latency_us / hs.mouse_done : 0),
+                 (unsigned long)hs.mouse_latency_max_us, (unsigned long)(am.age_us / am.batches),
+                 (unsigned long)am.age_max_us, (unsigned long)am.proc_max_us);
+    }
+#if CONFIG_APP_BLE_REMOTE
+    ble_remote_stats_t br;
+    ble_remote_get_stats(&br);
+    if (br.commands || br.rejected || br.samples) {
+        ESP_LOGI(TAG, "BLE remote: %lu commands (%lu rejected), telemetry %s every %u ms, %lu samples -> %lu notifies / %llu bytes (mtu %u), %lu dropped, sample max %lu us",
+                 (unsigned long)br.commands, (unsigned long)br.rejected, br.subscribed ? "on" : "off", br.period_ms,
+                 (unsigned long)br.samples, (unsigned long)br.notifies, (unsigned long long)br.bytes, br.mtu,
+                 (unsigned long)br.dropped, (unsigned long)br.sample_max_us);
+    }
+#endif
+    telemetry_stats_t tl;
+    telemetry_get_stats(&tl);
+    if (tl.rows) {
+        ESP_LOGI(TAG, "Telemetry: %s, %lu metrics, %lu rows in %lu leases, %lu lost by readers, sample avg %lu us max %lu us",
+                 tl.sampling ? "sampling" : "idle", (unsigned long)tl.metrics, (unsigned long)tl.rows,
+                 (unsigned long)tl.leases, (unsigned long)tl.lost, (unsigned long)(tl.sample_us / tl.rows),
+                 (unsigned long)tl.sample_max_us);
+    }
+    for (int i = 0; i < MEM_POOL_COUNT; i++) {
+        mem_pool_stats_t mp;
+        mem_pool_get_stats(i, &mp);
+        if (mp.allocs || mp.overflow || mp.failed) {
+            ESP_LOGI(TAG, "Pool %s: %u/%u x %lu bytes in use, peak %u, %lu from pool, %lu overflowed to heap, %lu failed",
+                     mp.name, mp.used, mp.blocks, (unsigned long)mp.block_size, mp.peak, (unsigned long)mp.allocs,
+                     (unsigned long)mp.overflow, (unsigned long)mp.failed);
+        }
+    }
+    ui_mem_stats_t um;
+    ui_mem_get_stats(&um);
+    for (int i = 0; i < UI_MEM_POOLS; i++) {
+        const ui_mem_pool_stats_t *p = &um.pool[i];
+        if (p->size) {
+            ESP_LOGI(TAG, "LVGL %s pool: %lu/%lu KB in %lu blocks, peak %lu KB, largest free %lu KB, frag %u%%, %lu allocs, %lu missed",
+                     i == UI_MEM_MAIN ? "main" : "fast", (unsigned long)p->used / 1024, (unsigned long)p->size / 1024,
+                     (unsigned long)p->blocks, (unsigned long)p->peak / 1024, (unsigned long)p->largest / 1024,
+                     p->frag_pct, (unsigned long)p->allocs, (unsigned long)p->misses);
+        }
+    }
+    if (um.overflow || um.failed) {
+        ESP_LOGI(TAG, "LVGL heap fallback: %lu allocs, %lu failed", (unsigned long)um.overflow, (unsigned long)um.failed);
+    }
+    mem_heap_stats_t hi, hd, hp;
+    mem_heap_get_stats(MALLOC_CAP_INTERNAL, &hi);
+    mem_heap_get_stats(MALLOC_CAP_DMA, &hd);
+    mem_heap_get_stats(MALLOC_CAP_SPIRAM, &hp);
+    ESP_LOGI(TAG, "Fragmentation: internal %u%%, DMA %u%%, PSRAM %u%%", hi.frag_pct, hd.frag_pct, hp.frag_pct);
+#if CONFIG_APP_HEAP_AUDIT
+    heap_audit_stats_t ha;
+    heap_audit_get_stats(&ha);
+    if (ha.cycles) {
+        ESP_LOGI(TAG, "Heap audit: %lu warm app cycles, %lu lost memory, worst %ld bytes (app %d)",
+                 (unsigned long)ha.cycles, (unsigned long)ha.flagged, (long)ha.worst_delta, ha.worst_id);
+    }
+#endif
+#if CONFIG_APP_CRASH_CTX
+    crash_ctx_stats_t cc;
+    crash_ctx_get_stats(&cc);
+    ESP_LOGI(TAG, "Crash ctx: %lu snapshots, %lu rows, max %lu us%s%s",
+             (unsigned long)cc.snaps, (unsigned long)cc.rows, (unsigned long)cc.max_us,
+             cc.dump ? ", core dump from task " : "", cc.dump ? cc.dump_task : "");
+#endif
+#if CONFIG_APP_FLASH_LOG
+    flash_log_stats_t fl;
+    flash_log_get_stats(&fl);
+    if (fl.ready) {
+        ESP_LOGI(TAG, "Flash log: boot %lu, %lu records (%lu recovered, %lu dropped), %lu flushes (max %lu us), %lu erases, %llu KB, ring peak %lu words, %lu errors",
+                 (unsigned long)fl.boot, (unsigned long)fl.records, (unsigned long)fl.recovered,
+                 (unsigned long)fl.dropped, (unsigned long)fl.flushes, (unsigned long)fl.max_flush_us,
+                 (unsigned long)fl.erases, fl.bytes / 1024, (unsigned long)fl.ring_peak, (unsigned long)fl.errors);
+    }
+#endif
+#if CONFIG_APP_SYS_TRACE
+    sys_trace_stats_t tr;
+    sys_trace_get_stats(&tr);
+    if (tr.running || tr.exports) {
+        ESP_LOGI(TAG, "Sys trace: %s, %lu events, %lu dropped, %lu exports (last %lu events), %llu KB, max %lu ms",
+                 tr.running ? "running" : "stopped", (unsigned long)tr.events, (unsigned long)tr.dropped,
+                 (unsigned long)tr.exports, (unsigned long)tr.exported, tr.bytes / 1024,
+                 (unsigned long)tr.max_export_ms);
+    }
+#endif
+    bench_suite_stats_t bn;
+    bench_suite_get_stats(&bn);
+    if (bn.runs) {
+        ESP_LOGI(TAG, "Bench suite: %lu runs (%lu cancelled), last %lu results (%lu skipped) in %lu ms, report %s",
+                 (unsigned long)bn.runs, (unsigned long)bn.cancelled, (unsigned long)bn.last_results,
+                 (unsigned long)bn.last_skipped, (unsigned long)bn.last_ms, bn.last_report[0] ? bn.last_report : "none");
+    }
+    for (int i = 0; i < I2C_BUS_DEV_COUNT; i++) {
+        i2c_bus_stats_t bs;
+        i2c_bus_get_stats(i, &bs);
+        if (bs.transfers == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "I2C %s: %lu transfers, %lu errors, %lu async (%lu dropped), xfer avg %lu us max %lu us, wait avg %lu us max %lu us",
+                 i2c_bus_dev_name(i), (unsigned long)bs.transfers, (unsigned long)bs.errors, (unsigned long)bs.async,
+                 (unsigned long)bs.dropped, (unsigned long)(bs.xfer_us / bs.transfers), (unsigned long)bs.xfer_max_us,
+                 (unsigned long)(bs.wait_us / bs.transfers), (unsigned long)bs.wait_max_us);
+    }
+
+    time_sync_stats_t ts;
+    time_sync_get_stats(&ts);
+    if (ts.syncs) {
+        ESP_LOGI(TAG, "Time: boot from %s, %lu SNTP syncs (first at %lu ms), last offset %lld ms %s, %lu steps, %lu NVS saves",
+                 time_sync_source_name(ts.boot_source), (unsigned long)ts.syncs, (unsigned long)ts.first_sync_ms,
+                 ts.last_offset_ms, ts.slewing ? "slewing" : "done", (unsigned long)ts.steps, (unsigned long)ts.saves);
+    }
+    voice_ref_stats_t vr;
+    voice_ref_get_stats(&vr);
+    if (vr.taps) {
+        ESP_LOGI(TAG, "Voice ref: delay %.1f ms, corr %lu%% (%lu/%lu corrected), resync %lu play / %lu mic, %lu skipped, %.1f Mcycles",
+                 vr.delay / 16.0, (unsigned long)vr.corr, (unsigned long)vr.corrections, (unsigned long)vr.estimates,
+                 (unsigned long)vr.ref_resyncs, (unsigned long)vr.mic_resyncs, (unsigned long)vr.skipped, vr.cycles / 1e6);
+    }
+    sd_hotplug_stats_t hp;
+    sd_hotplug_get_stats(&hp);
+    if (hp.removals || hp.insertions) {
+        ESP_LOGI(TAG, "SD hotplug: %lu removed, %lu inserted, %lu probes, %lu status errors",
+                 (unsigned long)hp.removals, (unsigned long)hp.insertions, (unsigned long)hp.probes,
+                 (unsigned long)hp.status_errors);
+    }
+    sd_writer_stats_t sw;
+    sd_writer_get_stats(&sw);
+    if (sw.files || sw.failed) {
+        ESP_LOGI(TAG, "SD writer: %lu files, %lu failed, %lu KB in %lu blocks (avg %lu / max %lu ms), %lu stalls, %lu syncs, %lu contiguous",
+                 (unsigned long)sw.files, (unsigned long)sw.failed, (unsigned long)(sw.bytes / 1024), (unsigned long)sw.blocks,
+                 (unsigned long)(sw.blocks ? sw.write_us / sw.blocks / 1000 : 0), (unsigned long)sw.max_write_us / 1000,
+                 (unsigned long)sw.stalls, (unsigned long)sw.syncs, (unsigned long)sw.contiguous);
+    }
+    sd_job_stats_t sj;
+    sd_job_get_stats(&sj);
+    if (sj.jobs) {
+        ESP_LOGI(TAG, "SD jobs: %lu (%lu failed, %lu cancelled), %lu copied %lu KB (avg %.0f KB/s, best %lu KB/s), %lu moved, %lu deleted",
+                 (unsigned long)sj.jobs, (unsigned long)sj.failed, (unsigned long)sj.cancelled, (unsigned long)sj.copied,
+                 (unsigned long)(sj.copy_bytes / 1024), sj.copy_us ? sj.copy_bytes * 1e6 / 1024 / sj.copy_us : 0.0,
+                 (unsigned long)sj.max_copy_kbps, (unsigned long)sj.moved, (unsigned long)sj.deleted);
+    }
+    ui_msg_stats_t um;
+    ui_msg_get_stats(&um);
+    if (um.posted) {
+        ESP_LOGI(TAG, "UI queue: %lu posted, %lu applied, %lu coalesced, %lu stale, %lu dropped, max batch %lu, max %lu us",
+                 (unsigned long)um.posted, (unsigned long)um.applied, (unsigned long)um.coalesced, (unsigned long)um.stale,
+                 (unsigned long)um.dropped, (unsigned long)um.max_batch, (unsigned long)um.max_apply_us);
+    }
+
+    audio_player_decode_stats_t dec;
+    if (audio_player_get_decode_stats(&dec) == ESP_OK && dec.core_cycles && dec.frames) {
+        // 切换 FLAC_DECODER_FAST_MEMORY 前后对比这一行即可得到IRAM/内部RAM的收益
+        ESP_LOGI(TAG, "FLAC decode: %lu frames, %llu cycles/frame, max %lu us (%s)",
+                 (unsigned long)dec.frames, (unsigned long long)(dec.core_cycles / dec.frames),
+                 (unsigned long)dec.core_max_us, dec.core_fast_mem ? "IRAM/internal RAM" : "flash/default heap");
+        if (dec.crc_frames) {
+            ESP_LOGI(TAG, "FLAC CRC: %lu frames, %lu errors, %llu cycles/frame (%.1f%% of decode)",
+                     (unsigned long)dec.crc_frames, (unsigned long)dec.crc_errors,
+                     (unsigned long long)(dec.crc_cycles / dec.crc_frames), 100.0 * dec.crc_cycles / dec.core_cycles);
+        }
+    }
+#if CONFIG_FLAC_DECODER_DUAL_CORE
+    flac_mc_stats_t mc;
+    flac_mc_get_stats(&mc);
+    if (mc.audio_us)
+    {
+        // 每秒音频每个核上解FLAC要花多少 低于100%只说明解码本身不拖后腿 读卡 重采样 I2S都不在里面
+        ESP_LOGI(TAG, "FLAC dual core: %lu frames, %lu restores on core %d, %lu inline, core0 %.1f%%, core1 %.1f%% of audio time, %lu waits avg %llu us",
+                 (unsigned long)mc.frames, (unsigned long)mc.jobs, mc.worker_core, (unsigned long)mc.inline_jobs,
+                 100.0 * mc.busy_us[0] / mc.audio_us, 100.0 * mc.busy_us[1] / mc.audio_us, (unsigned long)mc.waits,
+                 (unsigned long long)(mc.waits ? mc.wait_us / mc.waits : 0));
+    }
+#endif
+
+    bsp_i2s_write_stats_t i2s;
+    bsp_i2s_get_write_stats(&i2s);
+    ESP_LOGI(TAG, "I2S write: %lu calls, avg %lu us, max %lu us, timeouts: %lu",
+             (unsigned long)i2s.writes, (unsigned long)(i2s.writes ? i2s.total_us / i2s.writes : 0),
+             (unsigned long)i2s.max_us, (unsigned long)i2s.timeouts);
 } 
 
+// SD卡挂载阶段
+static esp_err_t boot_sdcard_stage(void)
+{
+    esp_err_t ret = bsp_sdcard_mount();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "SD card not mounted at boot. UI may show SD error.");
+    }
+#if CONFIG_APP_SD_BENCH_AT_BOOT
+    // 要反复卸载重挂 只能在这个阶段结束前跑 别的模块都还没开始用SD卡
+    if (ret == ESP_OK) {
+        ret = sd_bench_run();
+    }
+#endif
+#if CONFIG_APP_SD_HOTPLUG
+    sd_hotplug_start(); // 开机没插卡也启动 插上就挂
+#endif
+    return ret;
+}
+
 // 主界面 任务函数
 static void main_page_task(void *pvParameters)
 {
-    // 等待开机音乐播放完成
-    xEventGroupWaitBits(my_event_group, START_MUSIC_COMPLETED, pdFALSE, pdFALSE, portMAX_DELAY);
+    // 只依赖LVGL 开机音乐在后台播放 不再等它播完
+    boot_wait(BOOT_BIT(BOOT_STAGE_LVGL), BOOT_WAIT_FOREVER);
+    boot_stage_begin(BOOT_STAGE_UI);
     // 进入主界面
     lv_main_page();
+    boot_stage_done(BOOT_STAGE_UI, ESP_OK);
+    ota_update_confirm(); // 主界面出来了 新固件算启动成功 不再回滚
+    pm_ctl_ui_busy(); // 从这里开始计时 没人碰就降频
+#if CONFIG_APP_IMU_GESTURE
+    if (imu_gesture_start() != ESP_OK) { // 芯片要在空闲管理之前开好FIFO 空闲管理就不再把它切到只测运动
+        ESP_LOGW(TAG, "gestures not started");
+    }
+#endif
+#if CONFIG_APP_IDLE_MGR
+    idle_mgr_start(); // 主界面出来以后才开始计不活动的时间
+#endif
+#if CONFIG_APP_STANDBY
+    standby_start(); // 看空闲管理的熄屏
+#endif
+#if CONFIG_APP_PEDOMETER
+    pedometer_start(); // 靠空闲管理发的运动事件叫醒
+#endif
+#if CONFIG_APP_UI_ORIENT
+    ui_orient_start(); // 芯片由空闲管理或手势初始化好
+#endif
+    alarm_start(); // 熄屏久了要看空闲状态 放在空闲管理后面
+#if CONFIG_APP_WIFI_AUTOCONNECT
+    app_wifi_autoconnect(); // 时钟要靠它对时 越早越好
+#endif
+#if CONFIG_APP_FILE_SERVER
+    file_server_start(); // 只是挂上WiFi的监听 连上了才起httpd
+#endif
+#if CONFIG_APP_MQTT
+    mqtt_svc_start(); // 离线也开始攒遥测 WiFi连上才连服务器
+#endif
+#if CONFIG_APP_VOICE_CMD
+    // 命令要操作主界面 音频芯片一般早就好了
+    boot_wait(BOOT_BIT(BOOT_STAGE_CODEC), BOOT_WAIT_FOREVER);
+    bool voice_ok = boot_ready(BOOT_STAGE_CODEC) && voice_cmd_start() == ESP_OK;
+    if (boot_ready(BOOT_STAGE_CODEC) && !voice_ok) {
+        ESP_LOGW(TAG, "voice control not started");
+    }
+#if CONFIG_APP_VOICE_BENCH
+    if (voice_ok) {
+        voice_bench_start(); // 延迟和误唤醒记到/sdcard/voice 也加到性能浮层里
+    }
+#endif
+#if CONFIG_APP_VOICE_VOCAB
+    if (voice_ok) {
+        voice_vocab_start(); // 歌名和应用的命令 媒体库走完了才有歌
+    }
+#endif
+#if CONFIG_APP_VOICE_TTS
+    if (boot_ready(BOOT_STAGE_CODEC)) {
+        voice_tts_start(); // 后台等SD卡 读或合成提示语的缓存
+    }
+#endif
+#if CONFIG_APP_INTERCOM
+    if (voice_ok) {
+        intercom_start(); // 取AFE的输出 连上WiFi才开端口
+    }
+#endif
+#endif
+    // 空闲时后台扫描音乐目录 建立标题/时长索引
+    boot_wait(BOOT_BIT(BOOT_STAGE_SD), BOOT_WAIT_FOREVER);
+    media_lib_start(); // 整张卡的媒体库 比音乐索引优先级还低 开机没卡的话插上卡再走
+    if (boot_ready(BOOT_STAGE_SD)) {
+#if CONFIG_APP_MOD_MUSIC
+        music_index_init();
+#endif
+#if CONFIG_APP_BOOT_ANIM_FLASH
+        boot_anim_update(BOOT_ANIM_GIF_PATH); // 开机GIF换过或者还没转换 转进flash 下次开机用
+#endif
+    }
 
     vTaskDelete(NULL);
 }
 
+// 一行遥测 逗号分开 方便在电脑上直接存成CSV
+static void console_print_rows(uint32_t *cursor)
+{
+    static telemetry_row_t rows[4];
+    static char line[TELEMETRY_MAX_METRICS * 11 + 32];
+    int n;
+    while ((n = telemetry_read(cursor, rows, 4)) > 0) {
+        for (int r = 0; r < n; r++) {
+            int len = snprintf(line, sizeof(line), "TLM,%lu,%lu", (unsigned long)rows[r].seq, (unsigned long)rows[r].t_ms);
+            for (int i = 0; i < rows[r].count && len < sizeof(line); i++) {
+                len += snprintf(line + len, sizeof(line) - len, ",%lu", (unsigned long)rows[r].v[i]);
+            }
+            printf("%s\n", line);
+        }
+    }
+}
+
+static void console_print_header(void)
+{
+    printf("TLM,seq,t_ms");
+    for (int i = 0; i < telemetry_count(); i++) {
+        printf(",%s%s", telemetry_name(i), telemetry_kind(i) == TELEMETRY_COUNTER ? "+" : "");
+    }
+    printf("\n");
+}
+
+// 串口上按键才出数据 t 开关每个周期一行遥测 m 打一遍各模块的详细统计 p 各任务占用和栈
+// 平时阻塞在读串口上 主任务一点都不跑 CONFIG_APP_TELEMETRY_LOG_S不是0时照旧定时打详细统计
+static void console_loop(void)
+{
+    const TickType_t log_ticks = CONFIG_APP_TELEMETRY_LOG_S ? pdMS_TO_TICKS(CONFIG_APP_TELEMETRY_LOG_S * 1000) : portMAX_DELAY;
+    if (uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0) != ESP_OK) {
+        ESP_LOGW(TAG, "console rx not available");
+        for (;;) {
+            vTaskDelay(log_ticks);
+            displayMemoryUsage();
+        }
+    }
+    ESP_LOGI(TAG, "console: t = telemetry on/off, m = module stats, p = task cpu, stacks and per-core plan, "
+             "f = storage read speed");
+#if CONFIG_APP_SYS_TRACE
+    ESP_LOGI(TAG, "console: r = system trace start, again to stop and save to %s/trace", SD_MOUNT_POINT);
+#endif
+    bool stream = false;
+    uint32_t cursor = 0;
+    TickType_t last_log = xTaskGetTickCount();
+    for (;;) {
+        TickType_t wait = stream ? pdMS_TO_TICKS(telemetry_period_ms()) : log_ticks;
+        uint8_t c;
+        if (uart_read_bytes(CONFIG_ESP_CONSOLE_UART_NUM, &c, 1, wait) == 1) {
+            if (c == 't') {
+                stream = !stream;
+                if (stream) {
+                    console_print_header();
+                    cursor = telemetry_head();
+                }
+            } else if (c == 'm') {
+                displayMemoryUsage();
+            } else if (c == 'p') {
+                sysmon_log(); // 第一次只记基准
+                task_plan_log();
+            } else if (c == 'f') {
+                bsp_spiffs_bench();
+#if CONFIG_APP_SYS_TRACE
+            } else if (c == 'r') {
+                if (sys_trace_running()) {
+                    sys_trace_save(NULL, 0);
+                } else {
+                    sys_trace_start();
+                }
+#endif
+            }
+        }
+        if (stream) {
+            telemetry_lease(telemetry_period_ms() * 3); // 关了以后过三个周期自己停
+            console_print_rows(&cursor);
+        }
+        if (CONFIG_APP_TELEMETRY_LOG_S && xTaskGetTickCount() - last_log >= log_ticks) {
+            last_log = xTaskGetTickCount();
+            displayMemoryUsage();
+        }
+    }
+}
+
 // 主函数
 void app_main(void)
 {
@@ -52,26 +1072,70 @@ void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK( ret );
+    time_sync_restore(); // 主页时钟一出来就要有时间 不等连网对时
+#if CONFIG_APP_FLASH_LOG
+    flash_log_init(); // 上次死机前环里的先存进flash 之后各模块才能FLOG
+#endif
+
+    telemetry_init(); // 各模块初始化时注册自己的计数 要在它们之前
+#if CONFIG_APP_CRASH_CTX
+    crash_ctx_init(); // 报上次的转储 一直把遥测抄进转储会带走的RAM
+#endif
+    mem_pool_init(); // 解码工作区趁内部RAM还没碎先占上
+    ui_mem_init(); // LVGL的池 也要在LVGL初始化之前
+    app_res_init(); // 应用界面用的外设 界面起来之前
+    pm_ctl_init(); // 开机全速 外设起来以前把降频和浅睡设好
+    psram_bw_init(); // 后台任务的节流 摄像头和音频上报了才开始采样
+    boot_init(); // 各初始化阶段的就绪位
+    my_event_group = xEventGroupCreate();
 
-    bsp_i2c_init();  // I2C初始化
+    // I2C和IO扩展芯片很快 屏幕和音频芯片都依赖它们 放在最前面
+    boot_stage_begin(BOOT_STAGE_I2C);
+    ret = bsp_i2c_init();  // I2C初始化
     pca9557_init();  // IO扩展芯片初始化
-    bsp_lvgl_start(); // 初始化液晶屏lvgl接口
-    bsp_spiffs_mount(); // SPIFFS文件系统初始化
-    // SD卡全局挂载（开机即挂载，供全局使用）
-    if (bsp_sdcard_mount() != ESP_OK) {
-        ESP_LOGW(TAG, "SD card not mounted at boot. UI may show SD error.");
+    boot_stage_done(BOOT_STAGE_I2C, ret);
+
+    // 闹钟叫醒的 只起音频芯片和SPIFFS响铃 摸了屏幕才往下走 没人理就接着睡 不返回
+    bool alarm_boot = alarm_boot_pending();
+    if (alarm_boot) {
+        alarm_boot_run();
     }
-    bsp_codec_init(); // 音频初始化
 
+    // 互不依赖的阶段在核1上各自执行 与下面的LVGL初始化同时进行
+    boot_stage_spawn(BOOT_STAGE_SD, 0, boot_sdcard_stage, 1);        // SD卡全局挂载（开机即挂载，供全局使用）
+    if (!alarm_boot) {
+        boot_stage_spawn(BOOT_STAGE_SPIFFS, 0, bsp_spiffs_mount, 1); // SPIFFS文件系统初始化
+        boot_stage_spawn(BOOT_STAGE_CODEC, BOOT_BIT(BOOT_STAGE_I2C), bsp_codec_init, 1); // 音频初始化
+    }
+
+    boot_stage_begin(BOOT_STAGE_LVGL);
+    font_ext_init(); // 编进程序以外的字形 映射fonts分区
+    asset_part_init(); // 图标和logo 映射assets分区
+    bsp_lvgl_start(); // 初始化液晶屏lvgl接口
+    boot_stage_done(BOOT_STAGE_LVGL, ESP_OK);
+
+    // 开机logo优先从flash里放 没转换过时才用SD卡上的GIF 挂载还没完成就跳过logo 不为它推迟主界面
     lv_gui_start(); // 显示开机界面
+    task_plan_create(TASK_MAIN_PAGE, main_page_task, NULL, NULL); // 主界面在后台建立
 
-    my_event_group = xEventGroupCreate();
+#if CONFIG_APP_LCD_BENCH_AT_BOOT
+    lcd_bench_start(); // 绘图缓冲高度扫描 结果在日志里
+#endif
+
+#if CONFIG_APP_LCD_DRAW_BENCH_AT_BOOT
+    lcd_bench_draw_start(); // blend加速前后对比 结果在日志里
+#endif
 
-    xTaskCreatePinnedToCore(power_music_task, "power_music_task", 4*1024, NULL, 5, NULL, 1); // 播放开机音乐
-    xTaskCreatePinnedToCore(main_page_task, "main_page_task", 4*1024, NULL, 5, NULL, 0); // 主界面任务
+#if CONFIG_APP_AUDIO_BENCH_AT_BOOT
+    audio_bench_start(); // 解码器基准 等SD卡挂载后在后台跑
+#endif
 
-    while (true) {
-        displayMemoryUsage();
-        vTaskDelay(pdMS_TO_TICKS(5 * 1000));
+    boot_wait(BOOT_BIT(BOOT_STAGE_CODEC), BOOT_WAIT_FOREVER);
+    if (boot_ready(BOOT_STAGE_CODEC) && !alarm_boot) { // 闹钟响过了 不再放开机音
+        task_plan_create(TASK_POWER_MUSIC, power_music_task, NULL, NULL); // 播放开机音乐 不阻塞主界面
+    } else {
+        xEventGroupSetBits(my_event_group, START_MUSIC_COMPLETED);
     }
+
+    console_loop();
 }
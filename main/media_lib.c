@@ -0,0 +1,1040 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "media_lib.h"
+#include "task_plan.h"
+#include "sd_dir_cache.h"
+#include "media_search.h"
+#include "esp32_s3_szp.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "ff.h"
+#include "psram_bw.h"
+
+static const char *TAG = "media_lib";
+
+#define MEDIA_LIB_MAGIC     0x42494C4D  // "MLIB"
+#define MEDIA_LIB_VERSION   2           // 2 多了播放列表类型
+#define ML_NONE             UINT32_MAX
+#define ML_CAPS             (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dirs;
+    uint32_t files;
+    uint32_t pool;
+    uint32_t sig;
+} ml_header_t;
+
+typedef struct {
+    uint32_t parent;                    // 根目录是ML_NONE
+    uint32_t name;                      // 字符串池里的偏移
+    uint32_t mtime;                     // 和目录缓存记录里的一样 日期在高16位
+    uint32_t first_dir;
+    uint32_t ndirs;
+    uint32_t first_file;
+    uint32_t nfiles;
+    uint32_t sig;                       // 这个目录的目录项签名
+} ml_dir_t;
+
+typedef struct {
+    uint32_t dir;
+    uint32_t name;
+    uint32_t size;
+    uint32_t mtime;
+    uint8_t type;                       // media_type_t
+    uint8_t pad[3];
+} ml_file_t;
+
+typedef struct {
+    ml_dir_t *dirs;
+    ml_file_t *files;
+    char *pool;
+    uint8_t *dirty;                     // 每个目录一个 不存进文件
+    uint32_t ndirs, nfiles, pool_len;
+    uint32_t dir_cap, file_cap, pool_cap, dirty_cap;
+    uint32_t sig;
+    uint32_t *slots;                    // 按目录和文件名找文件的哈希表 不存进文件 ML_NONE是空槽
+    uint32_t slot_mask;
+    uint32_t layout;                    // 只看名字和结构的签名 见media_lib_layout
+} ml_index_t;
+
+static ml_index_t *s_live;              // 查询用的 换表和读都持有s_mutex
+static bool s_busy;                     // 后台正在走卡 这时卸卡只摘下s_live 由后台任务释放
+static bool s_full;                     // 下一轮整张卡重走
+static uint32_t s_epoch;                // 每卸一次卡加一 走到一半卸了卡的结果不要
+static media_lib_stats_t s_stats;
+static SemaphoreHandle_t s_mutex;
+static TaskHandle_t s_task;
+
+static void ml_lock(void)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+}
+
+static void ml_unlock(void)
+{
+    xSemaphoreGive(s_mutex);
+}
+
+/******************************** 表 ********************************/
+static bool grow(void **buf, uint32_t *cap, uint32_t need, size_t elem)
+{
+    if (need <= *cap)
+    {
+        return true;
+    }
+    uint32_t n = *cap ? *cap : 256;
+    while (n < need)
+    {
+        n *= 2;
+    }
+    void *p = heap_caps_realloc(*buf, (size_t)n * elem, ML_CAPS);
+    if (p == NULL)
+    {
+        return false;
+    }
+    *buf = p;
+    *cap = n;
+    return true;
+}
+
+static void index_free(ml_index_t *idx)
+{
+    if (idx)
+    {
+        heap_caps_free(idx->dirs);
+        heap_caps_free(idx->files);
+        heap_caps_free(idx->pool);
+        heap_caps_free(idx->dirty);
+        heap_caps_free(idx->slots);
+        free(idx);
+    }
+}
+
+static uint32_t pool_add(ml_index_t *idx, const char *name)
+{
+    uint32_t len = strlen(name) + 1;
+    if (!grow((void **)&idx->pool, &idx->pool_cap, idx->pool_len + len, 1))
+    {
+        return ML_NONE;
+    }
+    uint32_t off = idx->pool_len;
+    memcpy(idx->pool + off, name, len);
+    idx->pool_len += len;
+    return off;
+}
+
+// 新的目录加在最后 dirty跟着一起长
+static uint32_t dir_add(ml_index_t *idx, uint32_t parent, const char *name, uint32_t mtime)
+{
+    uint32_t n = idx->ndirs;
+    if (!grow((void **)&idx->dirs, &idx->dir_cap, n + 1, sizeof(ml_dir_t)) ||
+        !grow((void **)&idx->dirty, &idx->dirty_cap, n + 1, 1))
+    {
+        return ML_NONE;
+    }
+    uint32_t off = pool_add(idx, name);
+    if (off == ML_NONE)
+    {
+        return ML_NONE;
+    }
+    idx->dirs[n] = (ml_dir_t){.parent = parent, .name = off, .mtime = mtime};
+    idx->dirty[n] = 0;
+    idx->ndirs++;
+    return n;
+}
+
+static bool file_add(ml_index_t *idx, const ml_file_t *f, const char *name)
+{
+    if (!grow((void **)&idx->files, &idx->file_cap, idx->nfiles + 1, sizeof(ml_file_t)))
+    {
+        return false;
+    }
+    uint32_t off = pool_add(idx, name);
+    if (off == ML_NONE)
+    {
+        return false;
+    }
+    idx->files[idx->nfiles] = *f;
+    idx->files[idx->nfiles].name = off;
+    idx->nfiles++;
+    return true;
+}
+
+static uint32_t child_find(const ml_index_t *idx, uint32_t d, const char *name, size_t len)
+{
+    const ml_dir_t *dir = &idx->dirs[d];
+    for (uint32_t c = dir->first_dir; c < dir->first_dir + dir->ndirs; c++)
+    {
+        const char *n = idx->pool + idx->dirs[c].name;
+        if (strncasecmp(n, name, len) == 0 && n[len] == '\0')
+        {
+            return c;
+        }
+    }
+    return ML_NONE;
+}
+
+// VFS路径对应的目录 找不全时返回最深的那一级 exact为false
+static uint32_t dir_find(const ml_index_t *idx, const char *path, bool *exact)
+{
+    size_t n = strlen(SD_MOUNT_POINT);
+    *exact = false;
+    if (idx->ndirs == 0 || strncmp(path, SD_MOUNT_POINT, n) != 0 || (path[n] != '\0' && path[n] != '/'))
+    {
+        return ML_NONE;
+    }
+    uint32_t d = 0;
+    for (const char *p = path + n; *p;)
+    {
+        while (*p == '/')
+        {
+            p++;
+        }
+        size_t len = strcspn(p, "/");
+        if (len == 0)
+        {
+            break;
+        }
+        uint32_t c = child_find(idx, d, p, len);
+        if (c == ML_NONE)
+        {
+            return d;
+        }
+        d = c;
+        p += len;
+    }
+    *exact = true;
+    return d;
+}
+
+// 从根拼出第i个目录的VFS路径
+static bool dir_path(const ml_index_t *idx, uint32_t i, char *out, size_t len)
+{
+    uint32_t chain[MEDIA_LIB_MAX_DEPTH];
+    int depth = 0;
+    for (; idx->dirs[i].parent != ML_NONE; i = idx->dirs[i].parent)
+    {
+        if (depth == MEDIA_LIB_MAX_DEPTH)
+        {
+            return false;
+        }
+        chain[depth++] = i;
+    }
+    size_t n = strlcpy(out, SD_MOUNT_POINT, len);
+    while (depth > 0 && n < len)
+    {
+        n += snprintf(out + n, len - n, "/%s", idx->pool + idx->dirs[chain[--depth]].name);
+    }
+    return n < len;
+}
+
+static uint32_t fnv(uint32_t h, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 目录下标和不分大小写的文件名一起散列
+static uint32_t name_hash(uint32_t dir, const char *name, size_t len)
+{
+    uint32_t h = fnv(2166136261u, &dir, sizeof(dir));
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char c = name[i];
+        h = (h ^ (c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c)) * 16777619u;
+    }
+    return h;
+}
+
+// 没放进s_live之前调用 建文件名哈希表 顺便算布局签名
+// 建不起哈希表也能用 查文件时退回按目录挨个比
+static void lookup_build(ml_index_t *idx)
+{
+    uint32_t layout = 2166136261u;
+    for (uint32_t i = 0; i < idx->ndirs; i++)
+    {
+        const char *n = idx->pool + idx->dirs[i].name;
+        layout = fnv(layout, &idx->dirs[i].parent, sizeof(uint32_t));
+        layout = fnv(layout, n, strlen(n) + 1);
+    }
+    uint32_t cap = 256;
+    while (cap < idx->nfiles * 2)
+    {
+        cap *= 2;
+    }
+    idx->slots = heap_caps_malloc(cap * sizeof(uint32_t), ML_CAPS);
+    idx->slot_mask = idx->slots ? cap - 1 : 0;
+    if (idx->slots)
+    {
+        memset(idx->slots, 0xff, cap * sizeof(uint32_t));
+    }
+    for (uint32_t f = 0; f < idx->nfiles; f++)
+    {
+        const char *n = idx->pool + idx->files[f].name;
+        size_t len = strlen(n);
+        layout = fnv(layout, &idx->files[f].dir, sizeof(uint32_t));
+        layout = fnv(layout, n, len + 1);
+        if (idx->slots)
+        {
+            uint32_t s = name_hash(idx->files[f].dir, n, len) & idx->slot_mask;
+            while (idx->slots[s] != ML_NONE)
+            {
+                s = (s + 1) & idx->slot_mask;
+            }
+            idx->slots[s] = f;
+        }
+    }
+    idx->layout = layout ? layout : 1;
+}
+
+/******************************** 索引文件 ********************************/
+// 下标和偏移都检查一遍 坏了的文件不至于让查询越界
+static bool index_check(const ml_index_t *idx)
+{
+    if (idx->ndirs == 0 || idx->pool_len == 0 || idx->pool[idx->pool_len - 1] != '\0')
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < idx->ndirs; i++)
+    {
+        const ml_dir_t *d = &idx->dirs[i];
+        if ((i == 0) != (d->parent == ML_NONE) || (i && d->parent >= i) || d->name >= idx->pool_len ||
+            d->first_dir > idx->ndirs || d->ndirs > idx->ndirs - d->first_dir ||
+            d->first_file > idx->nfiles || d->nfiles > idx->nfiles - d->first_file)
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < idx->nfiles; i++)
+    {
+        if (idx->files[i].name >= idx->pool_len || idx->files[i].dir >= idx->ndirs)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static ml_index_t *index_load(void)
+{
+    FILE *fp = fopen(MEDIA_LIB_FILE, "rb");
+    if (fp == NULL)
+    {
+        return NULL;
+    }
+    ml_header_t h;
+    ml_index_t *idx = calloc(1, sizeof(ml_index_t));
+    bool ok = idx && fread(&h, sizeof(h), 1, fp) == 1 && h.magic == MEDIA_LIB_MAGIC &&
+              h.version == MEDIA_LIB_VERSION && h.dirs + h.files <= MEDIA_LIB_MAX_ENTRIES &&
+              grow((void **)&idx->dirs, &idx->dir_cap, h.dirs, sizeof(ml_dir_t)) &&
+              grow((void **)&idx->files, &idx->file_cap, h.files, sizeof(ml_file_t)) &&
+              grow((void **)&idx->pool, &idx->pool_cap, h.pool, 1) &&
+              grow((void **)&idx->dirty, &idx->dirty_cap, h.dirs, 1) &&
+              fread(idx->dirs, sizeof(ml_dir_t), h.dirs, fp) == h.dirs &&
+              fread(idx->files, sizeof(ml_file_t), h.files, fp) == h.files &&
+              fread(idx->pool, 1, h.pool, fp) == h.pool;
+    fclose(fp);
+    if (ok)
+    {
+        idx->ndirs = h.dirs;
+        idx->nfiles = h.files;
+        idx->pool_len = h.pool;
+        idx->sig = h.sig;
+        memset(idx->dirty, 0, h.dirs);
+        ok = index_check(idx);
+    }
+    if (ok)
+    {
+        lookup_build(idx);
+    }
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "%s is damaged or from another version, rebuilding", MEDIA_LIB_FILE);
+        index_free(idx);
+        return NULL;
+    }
+    return idx;
+}
+
+static bool index_save(const ml_index_t *idx)
+{
+    FILE *fp = fopen(MEDIA_LIB_FILE, "wb");
+    if (fp == NULL)
+    {
+        ESP_LOGW(TAG, "unable to write %s", MEDIA_LIB_FILE);
+        return false;
+    }
+    ml_header_t h = {
+        .magic = MEDIA_LIB_MAGIC,
+        .version = MEDIA_LIB_VERSION,
+        .dirs = idx->ndirs,
+        .files = idx->nfiles,
+        .pool = idx->pool_len,
+        .sig = idx->sig,
+    };
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+              fwrite(idx->dirs, sizeof(ml_dir_t), idx->ndirs, fp) == idx->ndirs &&
+              fwrite(idx->files, sizeof(ml_file_t), idx->nfiles, fp) == idx->nfiles &&
+              fwrite(idx->pool, 1, idx->pool_len, fp) == idx->pool_len;
+    ok = fclose(fp) == 0 && ok;
+    sd_dir_cache_changed(MEDIA_LIB_FILE);
+    return ok;
+}
+
+/******************************** 后台走卡 ********************************/
+// 持有锁时调用
+static void stats_count(const ml_index_t *idx)
+{
+    s_stats.dirs = idx->ndirs;
+    s_stats.files = idx->nfiles;
+    s_stats.media = 0;
+    for (uint32_t f = 0; f < idx->nfiles; f++)
+    {
+        s_stats.media += idx->files[f].type != MEDIA_TYPE_OTHER;
+    }
+}
+
+// 把旧表里第o个目录原样搬到新表的第i个 子目录接着排队
+static bool dir_copy(ml_index_t *idx, uint32_t i, const ml_index_t *old, uint32_t o,
+                     uint32_t **map, uint32_t *map_cap)
+{
+    const ml_dir_t *od = &old->dirs[o];
+    idx->dirs[i].sig = od->sig;
+    idx->dirs[i].first_file = idx->nfiles;
+    for (uint32_t f = od->first_file; f < od->first_file + od->nfiles; f++)
+    {
+        ml_file_t nf = old->files[f];
+        nf.dir = i;
+        if (!file_add(idx, &nf, old->pool + old->files[f].name))
+        {
+            return false;
+        }
+    }
+    idx->dirs[i].nfiles = od->nfiles;
+    idx->dirs[i].first_dir = idx->ndirs;
+    for (uint32_t c = od->first_dir; c < od->first_dir + od->ndirs; c++)
+    {
+        uint32_t n = dir_add(idx, i, old->pool + old->dirs[c].name, old->dirs[c].mtime);
+        if (n == ML_NONE || !grow((void **)map, map_cap, n + 1, sizeof(uint32_t)))
+        {
+            return false;
+        }
+        (*map)[n] = c;
+    }
+    idx->dirs[i].ndirs = od->ndirs;
+    return true;
+}
+
+// 从卡上读第i个目录 旧表里有同名的子目录就对应上 没变的话下一轮可以直接搬
+// verify时拿签名和旧表比 告诉目录缓存卸卡前缓存的这个目录还能不能用
+static bool dir_read(ml_index_t *idx, uint32_t i, const ml_index_t *old, uint32_t o,
+                     uint32_t **map, uint32_t *map_cap, bool verify)
+{
+    static char s_path[SD_DIR_CACHE_PATH_LEN];
+    static char s_fpath[SD_DIR_CACHE_PATH_LEN + 4];
+    static FF_DIR s_dir;
+    static FILINFO s_fno;
+    idx->dirs[i].first_file = idx->nfiles;
+    idx->dirs[i].first_dir = idx->ndirs;
+    if (!dir_path(idx, i, s_path, sizeof(s_path)))
+    {
+        idx->dirty[i] = 1; // 太深或者路径太长 不索引 查询时调用者自己列
+        return true;
+    }
+    if (!bsp_sdcard_fatfs_path(s_path, s_fpath, sizeof(s_fpath)) || f_opendir(&s_dir, s_fpath) != FR_OK)
+    {
+        ESP_LOGW(TAG, "unable to open %s", s_path);
+        return false;
+    }
+    bool ok = true;
+    uint32_t sig = 2166136261u;
+    while (f_readdir(&s_dir, &s_fno) == FR_OK && s_fno.fname[0] != '\0')
+    {
+        // 索引文件自己每次保存都会变 不算进去 文件名索引也是
+        if (i == 0 && (strcasecmp(s_fno.fname, MEDIA_LIB_FILE + sizeof(SD_MOUNT_POINT)) == 0 ||
+                       strcasecmp(s_fno.fname, MEDIA_SEARCH_FILE + sizeof(SD_MOUNT_POINT)) == 0))
+        {
+            continue;
+        }
+        uint32_t size = (uint32_t)s_fno.fsize;
+        uint32_t mtime = (uint32_t)s_fno.fdate << 16 | s_fno.ftime;
+        sig = fnv(sig, s_fno.fname, strlen(s_fno.fname) + 1);
+        sig = fnv(sig, &size, sizeof(size));
+        sig = fnv(sig, &mtime, sizeof(mtime));
+        sig = fnv(sig, &s_fno.fattrib, sizeof(s_fno.fattrib));
+        if (idx->ndirs + idx->nfiles >= MEDIA_LIB_MAX_ENTRIES)
+        {
+            ESP_LOGW(TAG, "more than %d entries on the card, not indexed", MEDIA_LIB_MAX_ENTRIES);
+            ok = false;
+            break;
+        }
+        if (s_fno.fattrib & AM_DIR)
+        {
+            uint32_t n = dir_add(idx, i, s_fno.fname, mtime);
+            ok = n != ML_NONE && grow((void **)map, map_cap, n + 1, sizeof(uint32_t));
+            if (ok)
+            {
+                (*map)[n] = o != ML_NONE ? child_find(old, o, s_fno.fname, strlen(s_fno.fname)) : ML_NONE;
+            }
+        }
+        else
+        {
+            ml_file_t f = {.dir = i, .size = size, .mtime = mtime, .type = media_type_name(s_fno.fname)};
+            ok = file_add(idx, &f, s_fno.fname);
+        }
+        if (!ok)
+        {
+            break;
+        }
+    }
+    f_closedir(&s_dir);
+    idx->dirs[i].nfiles = idx->nfiles - idx->dirs[i].first_file;
+    idx->dirs[i].ndirs = idx->ndirs - idx->dirs[i].first_dir;
+    idx->dirs[i].sig = sig;
+    if (verify)
+    {
+        sd_dir_cache_verify(s_path, ok && o != ML_NONE && old->dirs[o].sig == sig);
+    }
+    return ok;
+}
+
+static const char *ml_name_at(uint32_t id, void *ctx)
+{
+    const ml_index_t *idx = ctx;
+    return idx->pool + idx->files[id].name;
+}
+
+// 广度优先建一张新表 full时每个目录都重读 否则只读脏的和新出现的 其他的从旧表搬
+// 走的时候不持有锁 旧表只有这里会换掉 卸卡时摘下的旧表也由这里释放
+static void crawl(bool full)
+{
+    int64_t t0 = esp_timer_get_time();
+    ml_lock();
+    ml_index_t *old = s_live;
+    uint32_t epoch = s_epoch;
+    uint8_t *was_dirty = NULL;
+    if (old)
+    {
+        was_dirty = heap_caps_malloc(old->ndirs, ML_CAPS);
+        if (was_dirty)
+        {
+            memcpy(was_dirty, old->dirty, old->ndirs);
+            memset(old->dirty, 0, old->ndirs);
+        }
+    }
+    full = full || old == NULL || was_dirty == NULL;
+    s_busy = true;
+    ml_unlock();
+
+    ml_index_t *idx = calloc(1, sizeof(ml_index_t));
+    uint32_t *map = NULL;
+    uint32_t map_cap = 0;
+    uint32_t n_read = 0, n_reused = 0;
+    bool ok = idx && dir_add(idx, ML_NONE, "", 0) == 0 && grow((void **)&map, &map_cap, 1, sizeof(uint32_t));
+    if (ok)
+    {
+        map[0] = old ? 0 : ML_NONE;
+    }
+    for (uint32_t i = 0; ok && i < idx->ndirs; i++)
+    {
+        uint32_t o = map[i];
+        if (s_epoch != epoch)
+        {
+            ok = false; // 卡被卸了
+        }
+        else if (full || o == ML_NONE || was_dirty[o])
+        {
+            ok = dir_read(idx, i, old, o, &map, &map_cap, full);
+            n_read++;
+            psram_bw_yield(); // 空闲时的后台工作 摄像头和音频吃紧时多让一会
+        }
+        else
+        {
+            ok = dir_copy(idx, i, old, o, &map, &map_cap);
+            n_reused++;
+        }
+    }
+    if (ok)
+    {
+        idx->sig = 2166136261u;
+        for (uint32_t i = 0; i < idx->ndirs; i++)
+        {
+            idx->sig = fnv(idx->sig, &idx->dirs[i].sig, sizeof(idx->dirs[i].sig));
+        }
+        lookup_build(idx);
+    }
+
+    bool again = false;
+    bool save = false;
+    ml_lock();
+    bool live = s_epoch == epoch;
+    if (ok && live)
+    {
+        // 走的时候又报过来的改动记在旧表上 搬到新表 马上再来一轮
+        for (uint32_t i = 0; old && i < idx->ndirs; i++)
+        {
+            if (map[i] != ML_NONE && old->dirty[map[i]])
+            {
+                idx->dirty[i] = 1;
+                again = true;
+            }
+        }
+        save = old == NULL || old->sig != idx->sig;
+        s_live = idx;
+        stats_count(idx);
+        s_stats.crawls++;
+        s_stats.dirs_read += n_read;
+        s_stats.dirs_reused += n_reused;
+        s_stats.last_crawl_ms = (esp_timer_get_time() - t0) / 1000;
+    }
+    else if (live && old && was_dirty)
+    {
+        // 没走完 旧表继续用 脏标记还回去
+        for (uint32_t o = 0; o < old->ndirs; o++)
+        {
+            old->dirty[o] |= was_dirty[o];
+        }
+    }
+    ml_unlock();
+    heap_caps_free(was_dirty);
+    heap_caps_free(map);
+    if (!ok || !live)
+    {
+        index_free(idx);
+        idx = NULL;
+    }
+    if (idx || !live)
+    {
+        index_free(old);
+    }
+    if (idx)
+    {
+        ESP_LOGI(TAG, "%lu dirs, %lu files (%lu media), %lu dirs read, %lu reused, %lld ms%s",
+                 (unsigned long)idx->ndirs, (unsigned long)idx->nfiles, (unsigned long)s_stats.media,
+                 (unsigned long)n_read, (unsigned long)n_reused, (esp_timer_get_time() - t0) / 1000,
+                 save ? "" : ", unchanged");
+    }
+    if (idx && save && index_save(idx))
+    {
+        ml_lock();
+        s_stats.saves++;
+        ml_unlock();
+    }
+    // 还在s_busy里 卸卡也不会释放idx 名字直接从它的字符串池里取
+    if (idx && s_epoch == epoch)
+    {
+        media_search_rebuild(idx->layout, idx->nfiles, ml_name_at, idx);
+    }
+
+    ml_lock();
+    s_busy = false;
+    if (idx && s_epoch != epoch)
+    {
+        index_free(idx); // 存文件的时候卡被卸了
+    }
+    ml_unlock();
+    if (again)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void media_lib_task(void *arg)
+{
+    bool full = true;
+    for (;;)
+    {
+        if (s_live == NULL)
+        {
+            int64_t t0 = esp_timer_get_time();
+            uint32_t layout = 0;
+            ml_index_t *idx = index_load();
+            ml_lock();
+            if (idx && s_live == NULL)
+            {
+                s_live = idx;
+                stats_count(idx);
+                s_stats.loaded = true;
+                ESP_LOGI(TAG, "%lu dirs, %lu files loaded in %lld ms", (unsigned long)idx->ndirs,
+                         (unsigned long)idx->nfiles, (esp_timer_get_time() - t0) / 1000);
+                layout = idx->layout;
+                idx = NULL;
+            }
+            ml_unlock();
+            index_free(idx);
+            if (layout)
+            {
+                media_search_load(layout);
+            }
+        }
+        // 卡可能在别的机器上改过 开机和重新挂卡都整张卡核对一遍
+        crawl(full);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MEDIA_LIB_SETTLE_MS)) > 0)
+        {
+        }
+        ml_lock();
+        full = s_full;
+        s_full = false;
+        ml_unlock();
+    }
+}
+
+esp_err_t media_lib_start(void)
+{
+    if (s_task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_mutex == NULL)
+    {
+        s_mutex = xSemaphoreCreateMutex();
+    }
+    if (s_mutex == NULL ||
+        task_plan_create(TASK_MEDIA_LIB, media_lib_task, NULL, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void media_lib_rescan(void)
+{
+    if (s_task)
+    {
+        ml_lock();
+        s_full = true;
+        ml_unlock();
+        xTaskNotifyGive(s_task);
+    }
+}
+
+void media_lib_changed(const char *file_path)
+{
+    if (s_task == NULL || strcmp(file_path, MEDIA_LIB_FILE) == 0 || strcmp(file_path, MEDIA_SEARCH_FILE) == 0)
+    {
+        return;
+    }
+    // 文件所在的目录 新建的目录表里还没有 就记在最深的那一级上
+    char dir[SD_DIR_CACHE_PATH_LEN];
+    strlcpy(dir, file_path, sizeof(dir));
+    char *slash = strrchr(dir, '/');
+    if (slash)
+    {
+        *slash = '\0';
+    }
+    ml_lock();
+    bool exact;
+    uint32_t d = s_live ? dir_find(s_live, dir, &exact) : ML_NONE;
+    if (d != ML_NONE)
+    {
+        s_live->dirty[d] = 1;
+    }
+    ml_unlock();
+    xTaskNotifyGive(s_task);
+}
+
+void media_lib_clear(void)
+{
+    if (s_mutex == NULL)
+    {
+        return;
+    }
+    ml_lock();
+    ml_index_t *idx = s_live;
+    s_live = NULL;
+    s_epoch++;
+    bool busy = s_busy;
+    ml_unlock();
+    media_search_clear();
+    if (!busy)
+    {
+        index_free(idx);
+        return;
+    }
+    // 后台走到一半 读完手上这个目录就会停 等它停了再卸卡 摘下的表由它释放
+    for (int i = 0; i < MEDIA_LIB_STOP_MS / 10; i++)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        ml_lock();
+        busy = s_busy;
+        ml_unlock();
+        if (!busy)
+        {
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "crawl did not stop in %d ms", MEDIA_LIB_STOP_MS);
+}
+
+bool media_lib_ready(void)
+{
+    if (s_mutex == NULL)
+    {
+        return false;
+    }
+    ml_lock();
+    bool ready = s_live != NULL;
+    ml_unlock();
+    return ready;
+}
+
+/******************************** 查询 ********************************/
+// 持有锁时调用 表里有这个目录而且没有脏
+static uint32_t dir_usable(const char *dir)
+{
+    bool exact;
+    uint32_t d = s_live ? dir_find(s_live, dir, &exact) : ML_NONE;
+    return d != ML_NONE && exact && !s_live->dirty[d] ? d : ML_NONE;
+}
+
+void media_lib_iterator_free(file_iterator_instance_t *it)
+{
+    if (it == NULL)
+    {
+        return;
+    }
+    for (size_t i = 0; it->list && i < it->count; i++)
+    {
+        free(it->list[i]);
+    }
+    free(it->list);
+    free((void *)it->directory_path);
+    free(it);
+}
+
+file_iterator_instance_t *media_lib_iterator(const char *dir, media_type_t type)
+{
+    if (s_mutex == NULL)
+    {
+        return NULL;
+    }
+    file_iterator_instance_t *it = NULL;
+    ml_lock();
+    uint32_t d = dir_usable(dir);
+    if (d != ML_NONE)
+    {
+        const ml_dir_t *md = &s_live->dirs[d];
+        size_t n = 0;
+        for (uint32_t f = md->first_file; f < md->first_file + md->nfiles; f++)
+        {
+            n += s_live->files[f].type == type;
+        }
+        it = calloc(1, sizeof(file_iterator_instance_t));
+        bool ok = it && (it->list = malloc((n ? n : 1) * sizeof(char *))) && (it->directory_path = strdup(dir));
+        for (uint32_t f = md->first_file; ok && f < md->first_file + md->nfiles; f++)
+        {
+            if (s_live->files[f].type == type)
+            {
+                ok = (it->list[it->count] = strdup(s_live->pool + s_live->files[f].name)) != NULL;
+                it->count += ok;
+            }
+        }
+        if (!ok)
+        {
+            media_lib_iterator_free(it);
+            it = NULL;
+        }
+    }
+    ml_unlock();
+    return it;
+}
+
+static char *rec_put(char *p, int type, uint32_t size, uint32_t mtime, const char *name)
+{
+    *p++ = type;
+    for (int i = 0; i < 4; i++)
+    {
+        p[i] = size >> (8 * i);
+        p[4 + i] = mtime >> (8 * i);
+    }
+    p += 8;
+    size_t len = strlen(name) + 1;
+    memcpy(p, name, len);
+    return p + len;
+}
+
+bool media_lib_dir_recs(const char *dir, char **recs, size_t *len)
+{
+    if (s_mutex == NULL)
+    {
+        return false;
+    }
+    bool ok = false;
+    ml_lock();
+    uint32_t d = dir_usable(dir);
+    if (d != ML_NONE)
+    {
+        const ml_dir_t *md = &s_live->dirs[d];
+        size_t n = 0;
+        for (uint32_t c = md->first_dir; c < md->first_dir + md->ndirs; c++)
+        {
+            n += SD_DIR_REC_HDR + strlen(s_live->pool + s_live->dirs[c].name) + 1;
+        }
+        for (uint32_t f = md->first_file; f < md->first_file + md->nfiles; f++)
+        {
+            n += SD_DIR_REC_HDR + strlen(s_live->pool + s_live->files[f].name) + 1;
+        }
+        char *buf = malloc(n ? n : 1);
+        if (buf)
+        {
+            char *p = buf;
+            for (uint32_t c = md->first_dir; c < md->first_dir + md->ndirs; c++)
+            {
+                p = rec_put(p, SD_DIR_TYPE_DIR, 0, s_live->dirs[c].mtime, s_live->pool + s_live->dirs[c].name);
+            }
+            for (uint32_t f = md->first_file; f < md->first_file + md->nfiles; f++)
+            {
+                const ml_file_t *mf = &s_live->files[f];
+                p = rec_put(p, mf->type, mf->size, mf->mtime, s_live->pool + mf->name);
+            }
+            *recs = buf;
+            *len = n;
+            ok = true;
+        }
+    }
+    ml_unlock();
+    return ok;
+}
+
+uint32_t media_lib_file_id(const char *path)
+{
+    if (s_mutex == NULL)
+    {
+        return MEDIA_LIB_NO_ID;
+    }
+    const char *slash = strrchr(path, '/');
+    char dir[SD_DIR_CACHE_PATH_LEN];
+    if (slash == NULL || slash[1] == '\0' || (size_t)(slash - path) >= sizeof(dir))
+    {
+        return MEDIA_LIB_NO_ID;
+    }
+    memcpy(dir, path, slash - path);
+    dir[slash - path] = '\0';
+    const char *name = slash + 1;
+    size_t len = strlen(name);
+
+    uint32_t id = MEDIA_LIB_NO_ID;
+    ml_lock();
+    // 脏目录里已经在表里的文件编号照样能用 播放列表自己就写在音乐目录里
+    bool exact;
+    uint32_t d = s_live ? dir_find(s_live, dir, &exact) : ML_NONE;
+    d = exact ? d : ML_NONE;
+    if (d != ML_NONE && s_live->slots)
+    {
+        for (uint32_t s = name_hash(d, name, len) & s_live->slot_mask; s_live->slots[s] != ML_NONE;
+             s = (s + 1) & s_live->slot_mask)
+        {
+            const ml_file_t *mf = &s_live->files[s_live->slots[s]];
+            if (mf->dir == d && strcasecmp(s_live->pool + mf->name, name) == 0)
+            {
+                id = s_live->slots[s];
+                break;
+            }
+        }
+    }
+    else if (d != ML_NONE)
+    {
+        const ml_dir_t *md = &s_live->dirs[d];
+        for (uint32_t f = md->first_file; f < md->first_file + md->nfiles; f++)
+        {
+            if (strcasecmp(s_live->pool + s_live->files[f].name, name) == 0)
+            {
+                id = f;
+                break;
+            }
+        }
+    }
+    ml_unlock();
+    return id;
+}
+
+bool media_lib_file_path(uint32_t id, char *out, size_t len)
+{
+    if (s_mutex == NULL)
+    {
+        return false;
+    }
+    bool ok = false;
+    ml_lock();
+    if (s_live && id < s_live->nfiles && dir_path(s_live, s_live->files[id].dir, out, len))
+    {
+        size_t n = strlen(out);
+        ok = snprintf(out + n, len - n, "/%s", s_live->pool + s_live->files[id].name) < (int)(len - n);
+    }
+    ml_unlock();
+    return ok;
+}
+
+bool media_lib_file_name(uint32_t id, char *out, size_t len)
+{
+    if (s_mutex == NULL)
+    {
+        return false;
+    }
+    bool ok = false;
+    ml_lock();
+    if (s_live && id < s_live->nfiles)
+    {
+        ok = strlcpy(out, s_live->pool + s_live->files[id].name, len) < len;
+    }
+    ml_unlock();
+    return ok;
+}
+
+size_t media_lib_file_rec(uint32_t id, char *out, size_t len)
+{
+    if (s_mutex == NULL)
+    {
+        return 0;
+    }
+    size_t n = 0;
+    ml_lock();
+    if (s_live && id < s_live->nfiles)
+    {
+        const ml_file_t *mf = &s_live->files[id];
+        size_t need = SD_DIR_REC_HDR + strlen(s_live->pool + mf->name) + 1;
+        if (need <= len)
+        {
+            n = rec_put(out, mf->type, mf->size, mf->mtime, s_live->pool + mf->name) - out;
+        }
+    }
+    ml_unlock();
+    return n;
+}
+
+uint32_t media_lib_layout(void)
+{
+    if (s_mutex == NULL)
+    {
+        return 0;
+    }
+    ml_lock();
+    uint32_t layout = s_live ? s_live->layout : 0;
+    ml_unlock();
+    return layout;
+}
+
+void media_lib_get_stats(media_lib_stats_t *stats)
+{
+    if (s_mutex == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    ml_lock();
+    *stats = s_stats;
+    ml_unlock();
+}
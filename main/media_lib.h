@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "media_type.h"
+#include "file_iterator.h"
+
+
+/*********************** 整张卡的媒体库 ****************************/
+// 后台任务把整张卡的目录走一遍 记下每个目录和每个文件的名字 类型 大小 修改时间 存成卡根目录下的一个索引文件
+// 开机先读索引文件 相册 音乐 文件浏览器马上就能按目录和类型查 不用再列目录 后台再走一遍核对卡上的实际内容
+// FATFS不维护目录自己的修改时间 没法按它跳过没变的目录 好在f_readdir本身带大小和时间 不用stat 走一遍也不慢
+// 每个目录的目录项算一个签名 走完全卡签名没变就不重写索引文件
+// 本程序在卡上写文件时经sd_dir_cache_changed报过来 那个目录标成脏的 查询时不用它 歇一会儿后台只重读脏目录
+// 重新挂卡后整张卡核对时 每个目录的签名和索引文件里的比一下 告诉目录缓存卸卡前缓存的还能不能用
+// 表按广度优先排 一个目录的文件和子目录各自挨在一起 目录路径靠上一级的下标拼出来
+
+#define MEDIA_LIB_FILE          "/sdcard/.media_lib"
+#define MEDIA_LIB_MAX_ENTRIES   CONFIG_APP_MEDIA_LIB_MAX_ENTRIES    // 目录和文件加起来 超过了这次扫卡作废
+#define MEDIA_LIB_MAX_DEPTH     16
+#define MEDIA_LIB_SETTLE_MS     3000    // 最后一次改动之后等这么久再重读 录像时不会一直在扫
+#define MEDIA_LIB_STOP_MS       2000    // 卸卡时最多等后台停这么久
+#define MEDIA_LIB_NO_ID         UINT32_MAX
+
+typedef struct {
+    uint32_t dirs;
+    uint32_t files;
+    uint32_t media;                     // 认识的媒体文件
+    uint32_t crawls;
+    uint32_t dirs_read;                 // 累计从卡上重读的目录
+    uint32_t dirs_reused;               // 累计没变直接沿用的目录
+    uint32_t last_crawl_ms;
+    uint32_t saves;
+    bool loaded;                        // 开机从索引文件读到了
+} media_lib_stats_t;
+
+esp_err_t media_lib_start(void);        // 读索引文件 启动后台任务走一遍全卡
+void media_lib_rescan(void);            // 重新挂卡以后 整张卡再走一遍
+void media_lib_changed(const char *file_path);  // file_path新建 删除或者写过 目录缓存的报告顺带转过来
+void media_lib_clear(void);             // 卸卡前调用 丢掉 等后台扫卡停下 下次挂上的可能是另一张卡
+bool media_lib_ready(void);
+// dir目录下直接的type类型文件 建一个和file_iterator_new一样的迭代器 按卡上的顺序
+// 没有媒体库 目录不认识或者是脏的返回NULL 调用者自己列目录
+file_iterator_instance_t *media_lib_iterator(const char *dir, media_type_t type);
+void media_lib_iterator_free(file_iterator_instance_t *it);     // 这个和file_iterator_new建的都能释放
+// dir目录的全部目录项 格式和目录缓存的一样(见sd_dir_cache.h) 子目录在前 malloc的 调用者free
+bool media_lib_dir_recs(const char *dir, char **recs, size_t *len);
+// 文件编号是文件在表里的下标 播放列表只存编号 按编号拼回路径
+// 只要卡上的目录和文件名没变(media_lib_layout不变) 编号就一直有效 大小和时间变了不影响
+// 文件名不分大小写 按哈希表直接找 不在表里返回MEDIA_LIB_NO_ID 所在目录脏了也照样查 刚建的文件要等后台重读
+uint32_t media_lib_file_id(const char *path);
+bool media_lib_file_path(uint32_t id, char *out, size_t len);
+bool media_lib_file_name(uint32_t id, char *out, size_t len);  // 只要名字
+// 编号id的文件一条目录缓存格式的记录 写进out 返回长度 放不下或者没有返回0
+size_t media_lib_file_rec(uint32_t id, char *out, size_t len);
+uint32_t media_lib_layout(void);        // 0是还没有媒体库 每次换表重算
+void media_lib_get_stats(media_lib_stats_t *stats);
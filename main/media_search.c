@@ -0,0 +1,498 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "media_search.h"
+#include "media_lib.h"
+#include "sd_dir_cache.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "media_search";
+
+#define MS_MAGIC            0x49525454  // "TTRI"
+#define MS_VERSION          1
+#define MS_CAPS             (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define MS_NAME_MAX         256
+#define MS_MAX_BYTES        (8 * 1024 * 1024)   // 卡上的文件比这大就当坏了
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t layout;
+    uint32_t files;
+    uint32_t keys;
+    uint32_t bytes;
+} ms_header_t;
+
+typedef struct {
+    uint32_t layout;
+    uint32_t nfiles;
+    uint32_t nkeys;
+    uint32_t bytes;
+    uint32_t *keys;                     // 三元组 升序
+    uint32_t *offs;                     // nkeys+1个 第i个三元组的编号串是posts[offs[i]]到posts[offs[i+1]]
+    uint8_t *posts;
+} ms_index_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t id;
+    bool valid;
+} ms_iter_t;
+
+static ms_index_t *s_idx;
+static SemaphoreHandle_t s_mutex;       // 换索引和查询都持有
+static media_search_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void search_init(void)
+{
+    if (s_mutex == NULL)
+    {
+        s_mutex = xSemaphoreCreateMutex();
+    }
+}
+
+static void index_free(ms_index_t *idx)
+{
+    if (idx)
+    {
+        heap_caps_free(idx->keys);
+        heap_caps_free(idx->offs);
+        heap_caps_free(idx->posts);
+        free(idx);
+    }
+}
+
+// 只转ASCII的大写 别的字节原样 返回长度
+static size_t name_lower(const char *name, char *out, size_t len)
+{
+    size_t n = 0;
+    for (; name[n] && n + 1 < len; n++)
+    {
+        char c = name[n];
+        out[n] = c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static uint32_t tri_at(const char *s)
+{
+    return (uint32_t)(uint8_t)s[0] << 16 | (uint32_t)(uint8_t)s[1] << 8 | (uint8_t)s[2];
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint8_t *varint_put(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static uint32_t varint_len(uint32_t v)
+{
+    uint32_t n = 1;
+    while (v >= 0x80)
+    {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static void iter_next(ms_iter_t *it)
+{
+    if (it->p >= it->end)
+    {
+        it->valid = false;
+        return;
+    }
+    uint32_t v = 0;
+    int shift = 0;
+    uint8_t b;
+    do
+    {
+        b = *it->p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while ((b & 0x80) && it->p < it->end && shift < 32);
+    it->id += v;
+    it->valid = true;
+}
+
+static void iter_init(ms_iter_t *it, const ms_index_t *idx, uint32_t k)
+{
+    it->p = idx->posts + idx->offs[k];
+    it->end = idx->posts + idx->offs[k + 1];
+    it->id = 0;
+    iter_next(it);
+}
+
+static int key_find(const ms_index_t *idx, uint32_t tri)
+{
+    int lo = 0, hi = (int)idx->nkeys - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (idx->keys[mid] == tri)
+        {
+            return mid;
+        }
+        if (idx->keys[mid] < tri)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+static void index_publish(ms_index_t *idx, bool loaded, uint32_t build_ms)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    ms_index_t *old = s_idx;
+    s_idx = idx;
+    xSemaphoreGive(s_mutex);
+    index_free(old);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.files = idx->nfiles;
+    s_stats.trigrams = idx->nkeys;
+    s_stats.bytes = idx->bytes;
+    s_stats.loaded = loaded;
+    s_stats.build_ms = build_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void index_save(const ms_index_t *idx)
+{
+    FILE *fp = fopen(MEDIA_SEARCH_FILE, "wb");
+    if (fp == NULL)
+    {
+        ESP_LOGW(TAG, "unable to write %s", MEDIA_SEARCH_FILE);
+        return;
+    }
+    ms_header_t h = {
+        .magic = MS_MAGIC,
+        .version = MS_VERSION,
+        .layout = idx->layout,
+        .files = idx->nfiles,
+        .keys = idx->nkeys,
+        .bytes = idx->bytes,
+    };
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+              fwrite(idx->keys, sizeof(uint32_t), idx->nkeys, fp) == idx->nkeys &&
+              fwrite(idx->offs, sizeof(uint32_t), idx->nkeys + 1, fp) == idx->nkeys + 1 &&
+              fwrite(idx->posts, 1, idx->bytes, fp) == idx->bytes;
+    ok = fclose(fp) == 0 && ok;
+    sd_dir_cache_changed(MEDIA_SEARCH_FILE);
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "writing %s failed", MEDIA_SEARCH_FILE);
+    }
+}
+
+void media_search_rebuild(uint32_t layout, uint32_t nfiles, media_search_name_fn name_at, void *ctx)
+{
+    search_init();
+    if (s_mutex == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    bool same = s_idx && s_idx->layout == layout;
+    xSemaphoreGive(s_mutex);
+    if (same)
+    {
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    char name[MS_NAME_MAX];
+
+    // 每个名字的每个三元组和文件编号拼成一个数 排序后同一个三元组的编号就挨在一起 而且是升序
+    size_t npairs = 0;
+    for (uint32_t id = 0; id < nfiles; id++)
+    {
+        size_t len = strlen(name_at(id, ctx));
+        npairs += len > 2 ? len - 2 : 0;
+    }
+    uint64_t *pairs = heap_caps_malloc((npairs ? npairs : 1) * sizeof(uint64_t), MS_CAPS);
+    ms_index_t *idx = calloc(1, sizeof(ms_index_t));
+    if (pairs == NULL || idx == NULL)
+    {
+        ESP_LOGW(TAG, "no memory for %u trigrams", (unsigned)npairs);
+        heap_caps_free(pairs);
+        free(idx);
+        return;
+    }
+    size_t n = 0;
+    for (uint32_t id = 0; id < nfiles; id++)
+    {
+        size_t len = name_lower(name_at(id, ctx), name, sizeof(name));
+        for (size_t i = 0; i + 2 < len && n < npairs; i++)
+        {
+            pairs[n++] = (uint64_t)tri_at(name + i) << 32 | id;
+        }
+    }
+    qsort(pairs, n, sizeof(uint64_t), cmp_u64);
+
+    // 先数出有多少个三元组 编号串多长 再一次分配好
+    uint32_t nkeys = 0, bytes = 0, last = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i && pairs[i] == pairs[i - 1])
+        {
+            continue; // 同一个名字里重复的三元组
+        }
+        uint32_t id = (uint32_t)pairs[i];
+        if (i == 0 || pairs[i] >> 32 != pairs[i - 1] >> 32)
+        {
+            nkeys++;
+            last = 0;
+        }
+        bytes += varint_len(id - last);
+        last = id;
+    }
+    idx->layout = layout;
+    idx->nfiles = nfiles;
+    idx->nkeys = nkeys;
+    idx->bytes = bytes;
+    idx->keys = heap_caps_malloc((nkeys ? nkeys : 1) * sizeof(uint32_t), MS_CAPS);
+    idx->offs = heap_caps_malloc((nkeys + 1) * sizeof(uint32_t), MS_CAPS);
+    idx->posts = heap_caps_malloc(bytes ? bytes : 1, MS_CAPS);
+    if (idx->keys == NULL || idx->offs == NULL || idx->posts == NULL)
+    {
+        ESP_LOGW(TAG, "no memory for the index (%lu KB)", (unsigned long)(bytes + nkeys * 8) / 1024);
+        heap_caps_free(pairs);
+        index_free(idx);
+        return;
+    }
+    uint8_t *p = idx->posts;
+    uint32_t k = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i && pairs[i] == pairs[i - 1])
+        {
+            continue;
+        }
+        uint32_t id = (uint32_t)pairs[i];
+        if (i == 0 || pairs[i] >> 32 != pairs[i - 1] >> 32)
+        {
+            idx->keys[k] = pairs[i] >> 32;
+            idx->offs[k++] = p - idx->posts;
+            last = 0;
+        }
+        p = varint_put(p, id - last);
+        last = id;
+    }
+    idx->offs[nkeys] = bytes;
+    heap_caps_free(pairs);
+
+    uint32_t ms = (esp_timer_get_time() - t0) / 1000;
+    ESP_LOGI(TAG, "%lu names, %u trigrams -> %lu keys, %lu KB, built in %lu ms", (unsigned long)nfiles, (unsigned)n,
+             (unsigned long)nkeys, (unsigned long)(bytes + nkeys * 8) / 1024, (unsigned long)ms);
+    index_save(idx);
+    index_publish(idx, false, ms);
+}
+
+bool media_search_load(uint32_t layout)
+{
+    search_init();
+    FILE *fp = s_mutex ? fopen(MEDIA_SEARCH_FILE, "rb") : NULL;
+    if (fp == NULL)
+    {
+        return false;
+    }
+    int64_t t0 = esp_timer_get_time();
+    ms_header_t h;
+    ms_index_t *idx = calloc(1, sizeof(ms_index_t));
+    bool ok = idx && fread(&h, sizeof(h), 1, fp) == 1 && h.magic == MS_MAGIC && h.version == MS_VERSION &&
+              h.layout == layout && h.bytes <= MS_MAX_BYTES && h.keys <= h.bytes;
+    if (ok)
+    {
+        idx->keys = heap_caps_malloc((h.keys ? h.keys : 1) * sizeof(uint32_t), MS_CAPS);
+        idx->offs = heap_caps_malloc((h.keys + 1) * sizeof(uint32_t), MS_CAPS);
+        idx->posts = heap_caps_malloc(h.bytes ? h.bytes : 1, MS_CAPS);
+        ok = idx->keys && idx->offs && idx->posts &&
+             fread(idx->keys, sizeof(uint32_t), h.keys, fp) == h.keys &&
+             fread(idx->offs, sizeof(uint32_t), h.keys + 1, fp) == h.keys + 1 &&
+             fread(idx->posts, 1, h.bytes, fp) == h.bytes;
+    }
+    fclose(fp);
+    // 偏移和顺序都查一遍 坏了的文件不至于让查询越界
+    for (uint32_t k = 0; ok && k < h.keys; k++)
+    {
+        ok = idx->offs[k] <= idx->offs[k + 1] && (k == 0 || idx->keys[k - 1] < idx->keys[k]);
+    }
+    ok = ok && idx->offs[0] == 0 && idx->offs[h.keys] == h.bytes;
+    if (!ok)
+    {
+        index_free(idx);
+        return false;
+    }
+    idx->layout = h.layout;
+    idx->nfiles = h.files;
+    idx->nkeys = h.keys;
+    idx->bytes = h.bytes;
+    ESP_LOGI(TAG, "%lu keys, %lu KB loaded in %lld ms", (unsigned long)h.keys,
+             (unsigned long)(h.bytes + h.keys * 8) / 1024, (esp_timer_get_time() - t0) / 1000);
+    index_publish(idx, true, 0);
+    return true;
+}
+
+void media_search_clear(void)
+{
+    if (s_mutex == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    ms_index_t *idx = s_idx;
+    s_idx = NULL;
+    xSemaphoreGive(s_mutex);
+    index_free(idx);
+}
+
+bool media_search_ready(void)
+{
+    if (s_mutex == NULL)
+    {
+        return false;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    bool ready = s_idx && s_idx->layout == media_lib_layout();
+    xSemaphoreGive(s_mutex);
+    return ready;
+}
+
+// 编号id的名字里有没有q
+static bool name_has(uint32_t id, const char *q)
+{
+    char name[MS_NAME_MAX];
+    if (!media_lib_file_name(id, name, sizeof(name)))
+    {
+        return false;
+    }
+    name_lower(name, name, sizeof(name));
+    return strstr(name, q) != NULL;
+}
+
+int media_search_query(const char *query, uint32_t *ids, int max)
+{
+    if (s_mutex == NULL)
+    {
+        return -1;
+    }
+    int64_t t0 = esp_timer_get_time();
+    char q[MEDIA_SEARCH_QUERY_MAX + 1];
+    size_t qlen = name_lower(query, q, sizeof(q));
+    if (qlen == 0)
+    {
+        return 0;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    const ms_index_t *idx = s_idx;
+    if (idx == NULL || idx->layout != media_lib_layout())
+    {
+        xSemaphoreGive(s_mutex);
+        return -1; // 媒体库换了表 新索引还在建
+    }
+    int n = 0;
+    uint32_t cand = 0;
+    bool scan = qlen < 3;
+    if (scan)
+    {
+        for (uint32_t id = 0; id < idx->nfiles && n < max; id++)
+        {
+            if (name_has(id, q))
+            {
+                ids[n++] = id;
+            }
+        }
+        cand = idx->nfiles;
+    }
+    else
+    {
+        // 每个三元组的编号串 有一个不在索引里就没有结果 从最短的那串开始逐个核对其他串
+        ms_iter_t it[MEDIA_SEARCH_QUERY_MAX];
+        int nt = qlen - 2;
+        int small = 0;
+        bool none = false;
+        for (int t = 0; t < nt && !none; t++)
+        {
+            int k = key_find(idx, tri_at(q + t));
+            none = k < 0;
+            if (!none)
+            {
+                iter_init(&it[t], idx, k);
+                if (it[t].end - it[t].p < it[small].end - it[small].p)
+                {
+                    small = t;
+                }
+            }
+        }
+        for (; !none && it[small].valid && n < max; iter_next(&it[small]))
+        {
+            uint32_t id = it[small].id;
+            bool all = true;
+            for (int t = 0; t < nt && all; t++)
+            {
+                if (t == small)
+                {
+                    continue;
+                }
+                while (it[t].valid && it[t].id < id)
+                {
+                    iter_next(&it[t]);
+                }
+                none = !it[t].valid; // 有一串走完了 后面都不可能了
+                all = !none && it[t].id == id;
+            }
+            if (all && id < idx->nfiles)
+            {
+                cand++;
+                if (name_has(id, q)) // 三元组都在不一定挨着
+                {
+                    ids[n++] = id;
+                }
+            }
+        }
+    }
+    xSemaphoreGive(s_mutex);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.queries++;
+    s_stats.scans += scan;
+    s_stats.candidates += cand;
+    s_stats.hits += n;
+    s_stats.query_us += us;
+    if (us > s_stats.max_query_us)
+    {
+        s_stats.max_query_us = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return n;
+}
+
+void media_search_get_stats(media_search_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+
+/*********************** 文件名搜索 ****************************/
+// 媒体库每换一张表(名字或者目录结构变了) 后台给全卡的文件名建一份三字母索引 存在卡根目录 开机对上布局签名就直接读
+// 名字按字节转小写 每三个相邻字节是一个三元组 UTF-8的中文也照样切 查询切出来的三元组一定都在
+// 索引: 排好序的三元组表 每个带一串文件编号 编号升序存相邻的差 变长编码 一个编号多半一两个字节
+// 查询时取每个三元组的编号串求交 从最短的开始 剩下的候选再按名字核对一遍子串
+// 不够三个字节的查询没法用索引 直接把全部文件名扫一遍 几千个名字也就几毫秒
+// 编号就是media_lib的文件编号 media_lib_file_path拼回路径
+
+#define MEDIA_SEARCH_FILE       "/sdcard/.media_tri"
+#define MEDIA_SEARCH_QUERY_MAX  64
+
+typedef const char *(*media_search_name_fn)(uint32_t id, void *ctx);
+
+typedef struct {
+    uint32_t files;
+    uint32_t trigrams;                  // 不同的三元组
+    uint32_t bytes;                     // 编号串的总长
+    uint32_t build_ms;
+    bool loaded;                        // 开机从卡上读到的
+    uint32_t queries;
+    uint32_t scans;                     // 太短只能扫全部名字的
+    uint32_t candidates;                // 求交以后要核对的 累计
+    uint32_t hits;                      // 核对过的 累计
+    uint32_t max_query_us;
+    uint64_t query_us;
+} media_search_stats_t;
+
+// 媒体库后台任务里调 layout和手上的一样就什么都不做 name_at在建索引期间一直有效
+void media_search_rebuild(uint32_t layout, uint32_t nfiles, media_search_name_fn name_at, void *ctx);
+bool media_search_load(uint32_t layout);    // 读卡上的索引 布局签名对不上返回false
+void media_search_clear(void);              // 卸卡
+bool media_search_ready(void);
+// 文件名里含query(不分大小写)的文件编号 按编号顺序 最多max个 返回个数 索引还没建好或者过期返回-1
+int media_search_query(const char *query, uint32_t *ids, int max);
+void media_search_get_stats(media_search_stats_t *stats);
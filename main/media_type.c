@@ -0,0 +1,140 @@
+#include <stdbool.h>
+#include <string.h>
+#include "media_type.h"
+#include "pic_rgb565.h"
+#include "freertos/FreeRTOS.h"
+
+#define MEDIA_SLOTS         64          // 2的幂 最多登记一半 探测链保持很短
+#define MEDIA_SLOT_SHIFT    (64 - 6)
+
+typedef struct {
+    uint64_t key;                       // 0是空槽
+    uint8_t type;
+} media_slot_t;
+
+static const struct {
+    const char *ext;
+    media_type_t type;
+} s_builtin[] = {
+    {"mp3", MEDIA_TYPE_AUDIO},
+    {"wav", MEDIA_TYPE_AUDIO},
+    {"flac", MEDIA_TYPE_AUDIO},
+    {"mp4", MEDIA_TYPE_VIDEO},
+    {"avi", MEDIA_TYPE_VIDEO},
+    {"jpg", MEDIA_TYPE_IMAGE},
+    {"jpeg", MEDIA_TYPE_IMAGE},
+    {"png", MEDIA_TYPE_IMAGE},
+    {"bmp", MEDIA_TYPE_IMAGE},
+    {PIC_RGB565_EXT, MEDIA_TYPE_IMAGE},
+    {"gif", MEDIA_TYPE_GIF},
+    {"m3u", MEDIA_TYPE_PLAYLIST},
+    {"m3u8", MEDIA_TYPE_PLAYLIST},
+};
+
+static media_slot_t s_slots[MEDIA_SLOTS];
+static int s_used;
+static bool s_ready;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 转小写拼成一个数 第一个字符在最低字节 太长或者空的返回0
+static uint64_t ext_key(const char *ext)
+{
+    uint64_t key = 0;
+    for (int i = 0; ext[i]; i++)
+    {
+        if (i == MEDIA_TYPE_EXT_MAX)
+        {
+            return 0;
+        }
+        unsigned char c = ext[i];
+        if (c >= 'A' && c <= 'Z')
+        {
+            c += 'a' - 'A';
+        }
+        key |= (uint64_t)c << (8 * i);
+    }
+    return key;
+}
+
+// 乘黄金分割数取高位 相近的短字符串也能散开
+static uint32_t slot_of(uint64_t key)
+{
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> MEDIA_SLOT_SHIFT);
+}
+
+// 持有锁时调用 返回key所在的槽 没有的话是它该放的空槽
+static media_slot_t *slot_find(uint64_t key)
+{
+    uint32_t i = slot_of(key);
+    while (s_slots[i].key != 0 && s_slots[i].key != key)
+    {
+        i = (i + 1) & (MEDIA_SLOTS - 1);
+    }
+    return &s_slots[i];
+}
+
+// 持有锁时调用
+static void builtin_load(void)
+{
+    for (int i = 0; i < sizeof(s_builtin) / sizeof(s_builtin[0]); i++)
+    {
+        uint64_t key = ext_key(s_builtin[i].ext);
+        media_slot_t *slot = slot_find(key);
+        s_used += slot->key == 0;
+        slot->key = key;
+        slot->type = s_builtin[i].type;
+    }
+    s_ready = true;
+}
+
+media_type_t media_type_ext(const char *ext)
+{
+    uint64_t key = ext ? ext_key(ext) : 0;
+    if (key == 0)
+    {
+        return MEDIA_TYPE_OTHER;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (!s_ready)
+    {
+        builtin_load();
+    }
+    media_slot_t *slot = slot_find(key);
+    media_type_t type = slot->key ? slot->type : MEDIA_TYPE_OTHER;
+    portEXIT_CRITICAL(&s_lock);
+    return type;
+}
+
+media_type_t media_type_name(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    return name[0] != '.' && dot ? media_type_ext(dot + 1) : MEDIA_TYPE_OTHER;
+}
+
+esp_err_t media_type_register(const char *ext, media_type_t type)
+{
+    uint64_t key = ext_key(ext);
+    if (key == 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    if (!s_ready)
+    {
+        builtin_load();
+    }
+    media_slot_t *slot = slot_find(key);
+    if (slot->key == 0 && s_used >= MEDIA_SLOTS / 2)
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        s_used += slot->key == 0;
+        slot->key = key;
+        slot->type = type;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
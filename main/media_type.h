@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+
+/*********************** 按扩展名分媒体类型 ****************************/
+// 文件浏览器 后台列目录 相册和音乐索引都用这一张表 加一种格式只改一个地方
+// 扩展名不分大小写 最多8个字符 转小写后拼成一个64位数当键 查表是一次乘法加一两次整数比较
+// 表是开放寻址的哈希表 槽比条目多得多 多数扩展名第一个槽就命中 运行时可以再登记新的扩展名
+
+// 和SD卡目录缓存记录里的类型一致 文件浏览器按这个显示图标
+typedef enum {
+    MEDIA_TYPE_OTHER = 0,
+    MEDIA_TYPE_AUDIO = 1,
+    MEDIA_TYPE_VIDEO = 2,
+    MEDIA_TYPE_IMAGE = 3,
+    MEDIA_TYPE_GIF = 4,
+    MEDIA_TYPE_PLAYLIST = 6,            // 5是目录记录的类型 见sd_dir_cache.h
+} media_type_t;
+
+#define MEDIA_TYPE_EXT_MAX      8
+
+media_type_t media_type_ext(const char *ext);       // ext不带点 NULL或者空串是OTHER
+media_type_t media_type_name(const char *name);     // 按最后一个点后面的扩展名 隐藏文件(点开头)是OTHER
+// 登记或者改一个扩展名的类型 比如有了解码器以后加上"aac" 表满了返回ESP_ERR_NO_MEM
+esp_err_t media_type_register(const char *ext, media_type_t type);
@@ -0,0 +1,212 @@
+#include <string.h>
+#include "mem_pool.h"
+#include "telemetry.h"
+#include "esp32_s3_szp.h"
+#include "pic_jpeg.h"
+#include "pic_thumb.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "mem_pool";
+
+#define POOL_ALIGN      16              // 块按cache行对齐 DMA从PSRAM读也没问题
+#define POOL_ROUND(n)   (((n) + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1))
+
+typedef struct {
+    const char *name;
+    uint32_t caps;
+    uint32_t block_size;
+    uint16_t blocks;
+    uint8_t *base;
+    uint32_t busy;                      // 第i位是第i块在用
+    mem_pool_stats_t stats;
+} pool_t;
+
+static pool_t s_pools[MEM_POOL_COUNT] = {
+    [MEM_POOL_MEDIA] = {
+        .name = "media",
+        .caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+        .block_size = POOL_ROUND(BSP_LCD_H_RES * BSP_LCD_V_RES * 2),
+        .blocks = CONFIG_APP_MEM_MEDIA_BLOCKS,
+    },
+    [MEM_POOL_DECODER] = {
+        .name = "decoder",
+        .caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+        .block_size = POOL_ROUND(PIC_JPEG_WORK_SIZE),
+        .blocks = CONFIG_APP_MEM_DECODER_BLOCKS,
+    },
+    [MEM_POOL_UI] = {
+        .name = "ui",
+        .caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+        .block_size = POOL_ROUND(PIC_THUMB_W * PIC_THUMB_H * 2),
+        .blocks = PIC_THUMB_SLOTS + 1,  // 每个格子一块 加生成用的一块
+    },
+};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+_Static_assert(PIC_THUMB_SLOTS + 1 <= MEM_POOL_MAX_BLOCKS, "ui pool bitmap too small");
+
+// 后备内存一次分好 以后不还 分不到下次再试 这期间都走堆
+static bool pool_reserve(pool_t *p)
+{
+    if (p->base)
+    {
+        return true;
+    }
+    uint8_t *base = heap_caps_aligned_alloc(POOL_ALIGN, (size_t)p->block_size * p->blocks, p->caps);
+    if (base == NULL)
+    {
+        return false;
+    }
+    portENTER_CRITICAL(&s_lock);
+    bool first = p->base == NULL;
+    if (first)
+    {
+        p->base = base;
+        p->stats.reserved = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!first)
+    {
+        heap_caps_free(base); // 另一个任务抢先分好了
+    }
+    else
+    {
+        ESP_LOGI(TAG, "%s: %u x %lu bytes reserved", p->name, p->blocks, (unsigned long)p->block_size);
+    }
+    return true;
+}
+
+static uint32_t read_used(void *arg)
+{
+    return s_pools[(int)(uintptr_t)arg].stats.used;
+}
+
+static uint32_t read_overflow(void *arg)
+{
+    uint32_t n = 0;
+    for (int i = 0; i < MEM_POOL_COUNT; i++)
+    {
+        n += s_pools[i].stats.overflow;
+    }
+    return n;
+}
+
+static uint32_t read_frag(void *arg)
+{
+    mem_heap_stats_t h;
+    mem_heap_get_stats((uint32_t)(uintptr_t)arg, &h);
+    return h.frag_pct;
+}
+
+esp_err_t mem_pool_init(void)
+{
+    for (int i = 0; i < MEM_POOL_COUNT; i++)
+    {
+        pool_t *p = &s_pools[i];
+        p->stats.name = p->name;
+        p->stats.block_size = p->block_size;
+        p->stats.blocks = p->blocks;
+    }
+    // 内部RAM的趁还没碎先占上 PSRAM的大 用到再分
+    ESP_RETURN_ON_FALSE(pool_reserve(&s_pools[MEM_POOL_DECODER]), ESP_ERR_NO_MEM, TAG, "no internal RAM for decoder pool");
+
+    telemetry_add("pool_media", TELEMETRY_GAUGE, read_used, (void *)MEM_POOL_MEDIA);
+    telemetry_add("pool_ui", TELEMETRY_GAUGE, read_used, (void *)MEM_POOL_UI);
+    telemetry_add("pool_overflow", TELEMETRY_COUNTER, read_overflow, NULL);
+    telemetry_add("int_frag_pct", TELEMETRY_GAUGE, read_frag, (void *)MALLOC_CAP_INTERNAL);
+    telemetry_add("psram_frag_pct", TELEMETRY_GAUGE, read_frag, (void *)MALLOC_CAP_SPIRAM);
+    return ESP_OK;
+}
+
+void *mem_pool_alloc(mem_pool_id_t id, size_t size)
+{
+    if (id < 0 || id >= MEM_POOL_COUNT || size == 0)
+    {
+        return NULL;
+    }
+    pool_t *p = &s_pools[id];
+    void *ptr = NULL;
+    if (size <= p->block_size && pool_reserve(p))
+    {
+        portENTER_CRITICAL(&s_lock);
+        uint32_t idle = ~p->busy & (p->blocks < MEM_POOL_MAX_BLOCKS ? (1u << p->blocks) - 1 : UINT32_MAX);
+        if (idle)
+        {
+            int b = __builtin_ctz(idle);
+            p->busy |= 1u << b;
+            ptr = p->base + (size_t)b * p->block_size;
+            p->stats.used++;
+            p->stats.peak = p->stats.used > p->stats.peak ? p->stats.used : p->stats.peak;
+            p->stats.allocs++;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    if (ptr)
+    {
+        return ptr;
+    }
+
+    ptr = heap_caps_malloc(size, p->caps);
+    portENTER_CRITICAL(&s_lock);
+    if (ptr)
+    {
+        p->stats.overflow++;
+    }
+    else
+    {
+        p->stats.failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ptr;
+}
+
+void mem_pool_free(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < MEM_POOL_COUNT; i++)
+    {
+        pool_t *p = &s_pools[i];
+        uint8_t *u = ptr;
+        if (p->base && u >= p->base && u < p->base + (size_t)p->block_size * p->blocks)
+        {
+            uint32_t bit = 1u << ((u - p->base) / p->block_size);
+            portENTER_CRITICAL(&s_lock);
+            bool busy = p->busy & bit;
+            p->busy &= ~bit;
+            p->stats.used -= busy;
+            portEXIT_CRITICAL(&s_lock);
+            if (!busy)
+            {
+                ESP_LOGE(TAG, "%s: double free of %p", p->name, ptr);
+            }
+            return;
+        }
+    }
+    heap_caps_free(ptr);
+}
+
+void mem_pool_get_stats(mem_pool_id_t id, mem_pool_stats_t *stats)
+{
+    if (id < 0 || id >= MEM_POOL_COUNT)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_pools[id].stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void mem_heap_get_stats(uint32_t caps, mem_heap_stats_t *stats)
+{
+    stats->free = heap_caps_get_free_size(caps);
+    stats->largest = heap_caps_get_largest_free_block(caps);
+    stats->frag_pct = stats->free ? 100 - (uint64_t)stats->largest * 100 / stats->free : 0;
+}
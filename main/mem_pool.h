@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+
+/*********************** 内存分区 ****************************/
+// 大块的媒体缓冲放PSRAM 内部RAM留给DMA和每个像素都要碰的解码状态
+// 常用的几种固定大小的缓冲各有一个池 一整块后备内存切成等长的块 用位图记哪块在用
+// 整屏帧和缩略图反复申请释放 走池子PSRAM不会被切碎 要的时候总有整块
+// 解码工作区开机就在内部RAM占好 后面内部RAM再碎也解得了图
+// 池满了或者要的比块大 照原来的权限直接从堆里分 记一次溢出 调用的人不用管是哪来的
+// 释放统一用mem_pool_free 池里的还回去 其他的交给heap_caps_free
+
+typedef enum {
+    MEM_POOL_MEDIA,                     // 整屏RGB565帧 PSRAM 用到才分后备
+    MEM_POOL_DECODER,                   // tjpgd工作区 内部RAM 开机就分
+    MEM_POOL_UI,                        // 缩略图 PSRAM 用到才分后备
+    MEM_POOL_COUNT,
+} mem_pool_id_t;
+
+#define MEM_POOL_MAX_BLOCKS     32      // 位图一个uint32_t
+
+typedef struct {
+    const char *name;
+    uint32_t block_size;
+    uint16_t blocks;
+    uint16_t used;
+    uint16_t peak;
+    bool reserved;                      // 后备内存有了
+    uint32_t allocs;                    // 从池里分到的
+    uint32_t overflow;                  // 池满或者太大 从堆里分的
+    uint32_t failed;                    // 堆里也没有
+} mem_pool_stats_t;
+
+typedef struct {
+    uint32_t free;
+    uint32_t largest;                   // 最大的整块
+    uint8_t frag_pct;                   // 剩余里拼不成最大块的比例
+} mem_heap_stats_t;
+
+esp_err_t mem_pool_init(void);          // telemetry_init之后 其他模块之前
+void *mem_pool_alloc(mem_pool_id_t id, size_t size);
+void mem_pool_free(void *ptr);          // 哪来的都行 NULL不管
+void mem_pool_get_stats(mem_pool_id_t id, mem_pool_stats_t *stats);
+void mem_heap_get_stats(uint32_t caps, mem_heap_stats_t *stats);
@@ -0,0 +1,505 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mqtt_svc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_app_desc.h"
+#include "mqtt_client.h"
+#include "app_ui.h"
+#include "ui_msg.h"
+#include "wifi_svc.h"
+#include "telemetry.h"
+#include "task_plan.h"
+
+#if CONFIG_APP_MQTT
+
+static const char *TAG = "mqtt_svc";
+
+#define MQTT_ROWS_READ          8       // 一次从遥测拷的行
+#define MQTT_ROW_MAX_LEN        ((TELEMETRY_MAX_METRICS + 1) * 12 + 4)
+#define MQTT_CMD_LEN            32
+#define MQTT_SAMPLE_MS          (CONFIG_APP_MQTT_SAMPLE_S * 1000)
+#define MQTT_BURST_US           ((int64_t)CONFIG_APP_MQTT_BURST_S * 1000000)
+#define MQTT_QUEUE_LIMIT        (CONFIG_APP_MQTT_QUEUE_KB * 1024)
+
+typedef struct {
+    uint16_t len;
+    char data[];
+} mqtt_msg_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static mqtt_svc_stats_t s_stats;
+static esp_mqtt_client_handle_t s_client;
+static TaskHandle_t s_task;
+static volatile bool s_connected;
+static volatile bool s_flush_now;
+static bool s_client_started;         // 起过客户端 WiFi服务任务和开机都可能调
+static char s_base[MQTT_SVC_TOPIC_LEN];
+static char s_topic_tlm[MQTT_SVC_TOPIC_LEN];
+static char s_topic_cmd[MQTT_SVC_TOPIC_LEN];
+static char s_topic_status[MQTT_SVC_TOPIC_LEN];
+static char s_topic_schema[MQTT_SVC_TOPIC_LEN];
+static char s_schema[1024];             // 在MQTT客户端的任务里编
+
+// 下面这些只在服务任务里用
+static mqtt_msg_t *s_queue[MQTT_SVC_QUEUE_MSGS];   // PSRAM 环形 s_q_tail是最老的
+static uint32_t s_q_tail;
+static uint32_t s_q_count;
+static uint32_t s_q_bytes;
+static telemetry_row_t s_rows[MQTT_ROWS_READ];
+static uint32_t s_cursor;
+static uint32_t s_last_kept_ms;
+static bool s_have_kept;
+static char s_msg[MQTT_SVC_MSG_MAX];
+static size_t s_msg_len;
+static uint32_t s_msg_rows;
+static uint32_t s_msg_seq;
+static telemetry_row_t s_prev;          // 消息里上一行 算差值
+
+/********************************** 离线队列 **********************************/
+
+static void queue_stats(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.queue_count = s_q_count;
+    s_stats.queue_bytes = s_q_bytes;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void queue_pop(void)
+{
+    mqtt_msg_t *m = s_queue[s_q_tail];
+    s_queue[s_q_tail] = NULL;
+    s_q_tail = (s_q_tail + 1) % MQTT_SVC_QUEUE_MSGS;
+    s_q_count--;
+    s_q_bytes -= m->len;
+    heap_caps_free(m);
+}
+
+static void queue_push(const char *data, size_t len)
+{
+    uint32_t dropped = 0;
+    while (s_q_count && (s_q_count == MQTT_SVC_QUEUE_MSGS || s_q_bytes + len > MQTT_QUEUE_LIMIT))
+    {
+        queue_pop();    // 满了丢最老的 平台更关心最近的
+        dropped++;
+    }
+    mqtt_msg_t *m = heap_caps_malloc(sizeof(*m) + len, MALLOC_CAP_SPIRAM);
+    if (m)
+    {
+        m->len = len;
+        memcpy(m->data, data, len);
+        s_queue[(s_q_tail + s_q_count) % MQTT_SVC_QUEUE_MSGS] = m;
+        s_q_count++;
+        s_q_bytes += len;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.queued += m != NULL;
+    s_stats.dropped += dropped + (m == NULL);
+    portEXIT_CRITICAL(&s_lock);
+    queue_stats();
+}
+
+/********************************** 遥测编成消息 **********************************/
+
+static void msg_put(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void msg_put(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(s_msg + s_msg_len, sizeof(s_msg) - s_msg_len, fmt, ap);
+    va_end(ap);
+    s_msg_len = n > 0 && s_msg_len + n < sizeof(s_msg) ? s_msg_len + n : sizeof(s_msg) - 1;
+}
+
+static void msg_finish(void)
+{
+    if (s_msg_rows == 0)
+    {
+        return;
+    }
+    msg_put("]}");
+    queue_push(s_msg, s_msg_len);
+    s_msg_len = 0;
+    s_msg_rows = 0;
+}
+
+// 第一行放原值 后面的放和上一行的差 计数和变化慢的量表差值都很短
+static void msg_add_row(const telemetry_row_t *row)
+{
+    if (s_msg_rows && (row->count != s_prev.count || s_msg_len + MQTT_ROW_MAX_LEN >= sizeof(s_msg)))
+    {
+        msg_finish();   // 列变了或者装不下 另起一条
+    }
+    if (s_msg_rows == 0)
+    {
+        msg_put("{\"s\":%lu,\"p\":%d,\"k\":[%lu", (unsigned long)s_msg_seq++, MQTT_SAMPLE_MS,
+                (unsigned long)row->t_ms);
+        for (int i = 0; i < row->count; i++)
+        {
+            msg_put(",%lu", (unsigned long)row->v[i]);
+        }
+        msg_put("],\"d\":[");
+    }
+    else
+    {
+        msg_put("%s[%ld", s_msg_rows > 1 ? "," : "", (long)(row->t_ms - s_prev.t_ms));
+        for (int i = 0; i < row->count; i++)
+        {
+            msg_put(",%lld", (long long)row->v[i] - (long long)s_prev.v[i]);
+        }
+        msg_put("]");
+    }
+    s_prev = *row;
+    s_msg_rows++;
+}
+
+static void collect(void)
+{
+    telemetry_lease((CONFIG_APP_MQTT_BURST_S + CONFIG_APP_MQTT_SAMPLE_S) * 1000 * 2);
+    uint32_t before = s_cursor, rows = 0, lost = 0;
+    int n;
+    while ((n = telemetry_read(&s_cursor, s_rows, MQTT_ROWS_READ)) > 0)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            const telemetry_row_t *row = &s_rows[i];
+            lost += row->seq - before;
+            before = row->seq + 1;
+            // 按CONFIG_APP_MQTT_SAMPLE_S抽一行 差半个周期也算到了
+            if (s_have_kept && row->t_ms - s_last_kept_ms + telemetry_period_ms() / 2 < MQTT_SAMPLE_MS)
+            {
+                continue;
+            }
+            s_have_kept = true;
+            s_last_kept_ms = row->t_ms;
+            msg_add_row(row);
+            rows++;
+        }
+    }
+    msg_finish();   // 每次取完都收成一条 下次发的时候已经在队列里
+    portENTER_CRITICAL(&s_lock);
+    s_stats.rows += rows;
+    s_stats.rows_lost += lost;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/********************************** 发送 **********************************/
+
+static void burst(void)
+{
+    uint32_t sent = 0, failed = 0;
+    uint64_t bytes = 0;
+    while (s_q_count && s_connected)
+    {
+        mqtt_msg_t *m = s_queue[s_q_tail];
+        if (esp_mqtt_client_publish(s_client, s_topic_tlm, m->data, m->len, 1, 0) < 0)
+        {
+            failed++;
+            break;
+        }
+        bytes += m->len;
+        sent++;
+        queue_pop();
+    }
+    queue_stats();
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bursts += sent > 0;
+    s_stats.published += sent;
+    s_stats.bytes += bytes;
+    s_stats.publish_failed += failed;
+    portEXIT_CRITICAL(&s_lock);
+    if (sent)
+    {
+        ESP_LOGD(TAG, "burst of %lu messages, %lu left", (unsigned long)sent, (unsigned long)s_q_count);
+    }
+}
+
+static void mqtt_task(void *arg)
+{
+    // 环形缓冲里的行能撑多久 取的间隔不能比它长
+    const uint32_t ring_ms = TELEMETRY_RING * telemetry_period_ms() / 2;
+    const uint32_t burst_ms = CONFIG_APP_MQTT_BURST_S * 1000;
+    const uint32_t collect_ms = burst_ms < ring_ms ? burst_ms : ring_ms;
+    telemetry_lease(collect_ms * 2);
+    s_cursor = telemetry_head();
+    int64_t next_burst = esp_timer_get_time() + MQTT_BURST_US;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(collect_ms));
+        collect();
+        const int64_t now = esp_timer_get_time();
+        if (s_connected && (s_flush_now || now >= next_burst || s_q_bytes > MQTT_QUEUE_LIMIT / 2))
+        {
+            s_flush_now = false;
+            burst();
+            next_burst = now + MQTT_BURST_US;
+        }
+    }
+}
+
+/********************************** 命令 在MQTT客户端的任务里 **********************************/
+
+static void mqtt_play(void *arg)
+{
+    ai_play();
+}
+
+static void mqtt_pause(void *arg)
+{
+    ai_pause();
+}
+
+static void mqtt_resume(void *arg)
+{
+    ai_resume();
+}
+
+static void mqtt_next(void *arg)
+{
+    ai_next_music();
+}
+
+static void mqtt_prev(void *arg)
+{
+    ai_prev_music();
+}
+
+static void mqtt_seek(void *arg)
+{
+    ai_seek((uintptr_t)arg);
+}
+
+static void mqtt_volume(void *arg)
+{
+    ai_volume_set((uintptr_t)arg);
+}
+
+static void mqtt_volume_up(void *arg)
+{
+    ai_volume_up();
+}
+
+static void mqtt_volume_down(void *arg)
+{
+    ai_volume_down();
+}
+
+static void mqtt_open(void *arg)
+{
+    ai_open_app((uintptr_t)arg);
+}
+
+static void mqtt_exit(void *arg)
+{
+    ai_tuichu();
+}
+
+static bool cmd_handle(const char *cmd)
+{
+    const char *arg = strchr(cmd, ' ');
+    const uint32_t val = arg ? strtoul(arg + 1, NULL, 10) : 0;
+    if (strcmp(cmd, "flush") == 0)
+    {
+        s_flush_now = true;
+        xTaskNotifyGive(s_task);
+        return true;
+    }
+    if (strcmp(cmd, "play") == 0)
+    {
+        return ui_post_call(mqtt_play, NULL);
+    }
+    if (strcmp(cmd, "pause") == 0)
+    {
+        return ui_post_call(mqtt_pause, NULL);
+    }
+    if (strcmp(cmd, "resume") == 0)
+    {
+        return ui_post_call(mqtt_resume, NULL);
+    }
+    if (strcmp(cmd, "next") == 0)
+    {
+        return ui_post_call(mqtt_next, NULL);
+    }
+    if (strcmp(cmd, "prev") == 0)
+    {
+        return ui_post_call(mqtt_prev, NULL);
+    }
+    if (strcmp(cmd, "vol+") == 0)
+    {
+        return ui_post_call(mqtt_volume_up, NULL);
+    }
+    if (strcmp(cmd, "vol-") == 0)
+    {
+        return ui_post_call(mqtt_volume_down, NULL);
+    }
+    if (strcmp(cmd, "exit") == 0)
+    {
+        return ui_post_call(mqtt_exit, NULL);
+    }
+    if (arg && strncmp(cmd, "vol ", 4) == 0)
+    {
+        return val <= 100 && ui_post_call(mqtt_volume, (void *)(uintptr_t)val);
+    }
+    if (arg && strncmp(cmd, "seek ", 5) == 0)
+    {
+        return ui_post_call(mqtt_seek, (void *)(uintptr_t)val);
+    }
+    if (arg && strncmp(cmd, "open ", 5) == 0)
+    {
+        int id = ai_app_id(arg + 1);
+        return id > 0 && ui_post_call(mqtt_open, (void *)(uintptr_t)id);
+    }
+    return false;
+}
+
+static void schema_publish(void)
+{
+    int n = snprintf(s_schema, sizeof(s_schema), "{\"fw\":\"%s\",\"period\":%d,\"names\":[",
+                     esp_app_get_description()->version, MQTT_SAMPLE_MS);
+    const int count = telemetry_count();
+    for (int i = 0; i < count && n < sizeof(s_schema); i++)
+    {
+        n += snprintf(s_schema + n, sizeof(s_schema) - n, "%s\"%s\"", i ? "," : "", telemetry_name(i));
+    }
+    n += snprintf(s_schema + n, sizeof(s_schema) - n, "],\"kinds\":\"");
+    for (int i = 0; i < count && n < sizeof(s_schema); i++)
+    {
+        s_schema[n++] = telemetry_kind(i) == TELEMETRY_COUNTER ? 'c' : 'g';
+    }
+    n += snprintf(s_schema + n, sizeof(s_schema) - n, "\"}");
+    if (n < sizeof(s_schema))
+    {
+        esp_mqtt_client_publish(s_client, s_topic_schema, s_schema, n, 1, 1);
+    }
+}
+
+static void mqtt_event(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    esp_mqtt_event_handle_t ev = data;
+    switch ((esp_mqtt_event_id_t)id)
+    {
+    case MQTT_EVENT_CONNECTED:
+        esp_mqtt_client_subscribe(s_client, s_topic_cmd, 1);
+        esp_mqtt_client_publish(s_client, s_topic_status, "online", 0, 1, 1);
+        schema_publish();
+        s_connected = true;
+        s_flush_now = true;     // 离线时攒的马上发
+        xTaskNotifyGive(s_task);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.connected = true;
+        s_stats.connects++;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "connected, topics under %s", s_base);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        s_connected = false;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.connected = false;
+        s_stats.disconnects++;
+        portEXIT_CRITICAL(&s_lock);
+        break;
+    case MQTT_EVENT_DATA: {
+        char cmd[MQTT_CMD_LEN];
+        bool ok = ev->current_data_offset == 0 && ev->data_len == ev->total_data_len && ev->data_len < (int)sizeof(cmd);
+        if (ok)
+        {
+            memcpy(cmd, ev->data, ev->data_len);
+            cmd[ev->data_len] = '\0';
+            ok = cmd_handle(cmd);
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_stats.commands += ok;
+        s_stats.rejected += !ok;
+        portEXIT_CRITICAL(&s_lock);
+        if (!ok)
+        {
+            ESP_LOGW(TAG, "bad command, %d bytes", ev->data_len);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// 在WiFi服务任务里 第一次连上才起客户端 之后的掉线重连客户端自己管
+static void client_start(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool started = s_client_started;
+    s_client_started = true;
+    portEXIT_CRITICAL(&s_lock);
+    if (!started && esp_mqtt_client_start(s_client) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "client start failed");
+        s_client_started = false;
+    }
+}
+
+static void wifi_listener(const wifi_svc_event_t *ev)
+{
+    if (ev->type == WIFI_SVC_EV_STATE && ev->state == WIFI_SVC_CONNECTED)
+    {
+        client_start();
+    }
+}
+
+esp_err_t mqtt_svc_start(void)
+{
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(s_base, sizeof(s_base), "%s/%02x%02x%02x%02x%02x%02x", CONFIG_APP_MQTT_TOPIC, mac[0], mac[1], mac[2],
+             mac[3], mac[4], mac[5]);
+    snprintf(s_topic_tlm, sizeof(s_topic_tlm), "%s/tlm", s_base);
+    snprintf(s_topic_cmd, sizeof(s_topic_cmd), "%s/cmd", s_base);
+    snprintf(s_topic_status, sizeof(s_topic_status), "%s/status", s_base);
+    snprintf(s_topic_schema, sizeof(s_topic_schema), "%s/schema", s_base);
+
+    const task_plan_t *plan = task_plan_get(TASK_MQTT_CLIENT);
+    const esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = CONFIG_APP_MQTT_URI,
+        .session.keepalive = CONFIG_APP_MQTT_KEEPALIVE_S,
+        .session.last_will = {
+            .topic = s_topic_status,
+            .msg = "offline",
+            .qos = 1,
+            .retain = 1,
+        },
+        .network.reconnect_timeout_ms = 10000,
+        .task.priority = plan->prio,
+        .task.stack_size = plan->stack,
+        .buffer.size = 1024,
+        .buffer.out_size = MQTT_SVC_MSG_MAX + 256,
+    };
+    s_client = esp_mqtt_client_init(&cfg);
+    ESP_RETURN_ON_FALSE(s_client, ESP_ERR_NO_MEM, TAG, "client init");
+    esp_mqtt_client_register_event(s_client, MQTT_EVENT_ANY, mqtt_event, NULL);
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_MQTT_SVC, mqtt_task, NULL, &s_task) == pdPASS, ESP_ERR_NO_MEM, TAG,
+                        "create task");
+    ESP_RETURN_ON_ERROR(wifi_svc_subscribe(wifi_listener), TAG, "subscribe failed");
+    if (wifi_svc_connected())
+    {
+        client_start();
+    }
+    ESP_LOGI(TAG, "%s as %s, sample %d s, burst every %d s, queue %d KB", CONFIG_APP_MQTT_URI, s_base,
+             CONFIG_APP_MQTT_SAMPLE_S, CONFIG_APP_MQTT_BURST_S, CONFIG_APP_MQTT_QUEUE_KB);
+    return ESP_OK;
+}
+
+void mqtt_svc_get_stats(mqtt_svc_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** MQTT遥测和命令 ****************************/
+// 设备管理平台用 主题前缀是 CONFIG_APP_MQTT_TOPIC/<STA的MAC> 下面几个:
+//   status  保留消息 连上发online 遗嘱是offline
+//   schema  保留消息 连上发一次 遥测各列的名字和类型 周期 固件版本
+//   tlm     遥测 一条消息是一批行 {"s":序号,"p":行间隔ms,"k":[第一行 t和各列原值],"d":[[dt,各列差值],...]}
+//           每条消息自己带第一行的原值 丢一条不影响后面的
+//   cmd     订阅 文本命令 play pause resume next prev vol+ vol- vol <0~100> seek <ms> open <应用名> exit flush
+// 数据从遥测环形缓冲里取 每CONFIG_APP_MQTT_SAMPLE_S秒留一行 按租约一直采着
+// 取出来的先编成消息放进PSRAM里的队列 不管在不在线 满了丢最老的
+// 每CONFIG_APP_MQTT_BURST_S秒连着发一次 平时WiFi在modem sleep里 不一点点往外滴 射频醒的次数少
+// 重新连上 收到flush 队列过半 都马上发一次
+// MQTT客户端自己的任务管重连 掉线期间照样往队列里攒
+
+#define MQTT_SVC_MSG_MAX        2048    // 一条遥测消息 装不下就分成几条
+#define MQTT_SVC_QUEUE_MSGS     128     // 队列最多的条数 字节数另有CONFIG_APP_MQTT_QUEUE_KB管着
+#define MQTT_SVC_TOPIC_LEN      64
+
+typedef struct {
+    bool connected;
+    uint32_t connects;
+    uint32_t disconnects;
+    uint32_t rows;                      // 从遥测取来编进消息的行
+    uint32_t rows_lost;                 // 没取来就被环形缓冲覆盖的
+    uint32_t queued;                    // 编好放进队列的消息
+    uint32_t dropped;                   // 队列满丢掉的
+    uint32_t queue_count;               // 现在队列里的
+    uint32_t queue_bytes;
+    uint32_t bursts;
+    uint32_t published;
+    uint64_t bytes;                     // 发出去的消息体
+    uint32_t publish_failed;            // 发的时候出错 留在队列里下次再发
+    uint32_t commands;
+    uint32_t rejected;
+} mqtt_svc_stats_t;
+
+#if CONFIG_APP_MQTT
+esp_err_t mqtt_svc_start(void);         // 开机调一次 建队列和任务 WiFi连上才连服务器
+void mqtt_svc_get_stats(mqtt_svc_stats_t *stats);
+#endif
@@ -0,0 +1,886 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "multiroom.h"
+#include "audio_pcm.h"
+#include "esp32_s3_szp.h"
+#include "task_plan.h"
+#include "wifi_svc.h"
+#include "mp3dec.h"
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+static const char *TAG = "multiroom";
+
+#define MR_MAGIC        0x524d  // "MR"
+#define MR_PKT_BEACON   1
+#define MR_PKT_DATA     2
+#define MR_FLAG_END     0x01    // 信标 发送端读完了 frames是总帧数
+#define MR_PATH_LEN     256
+#define MR_READ_BUF     4096
+#define MR_QUEUE        48
+#define MR_CLOCK_MIN    2       // 攒够这么多个信标才算对上时钟
+#define MR_AIR_US       300     // 短包在空中和驱动里最快要这么久 时钟差按它补回去
+#define MR_TX_RETRY     20      // 发送队列满时每个tick重试一次
+#define MR_END_BEACONS  3
+#define MR_ERR_FILTER   32      // 同步误差的一阶滤波 约32帧
+#define MR_TRIM_PPM_MS  50      // 误差每1ms微调这么多ppm
+#define MR_LOCK_US      500     // 对齐时误差在这以内就不再补静音
+#define MR_STOP_MS      1000
+#define MR_PCM_FRAMES   1152
+#define MR_ZERO_FRAMES  256
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t session;                   // 每次开始发送随机取 换曲也换
+    uint32_t seq;                       // 这个session里的包序号 信标和数据一起排
+} mr_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    mr_hdr_t h;
+    int64_t now_us;                     // 发送端时钟 发出这一包时
+    uint32_t rate;
+    uint16_t spf;                       // 每帧采样数
+    uint8_t channels;
+    uint32_t frames;                    // 已经发出的帧数
+} mr_beacon_t;
+
+typedef struct __attribute__((packed)) {
+    mr_hdr_t h;
+    uint32_t frame;                     // 帧序号
+    int64_t pts_us;                     // 发送端时钟上这一帧第一个采样出声的时刻
+    uint16_t len;                       // 整帧字节数
+    uint16_t off;                       // 这一片在帧里的位置
+    uint8_t data[];
+} mr_data_t;
+
+#define MR_FRAG         (ESP_NOW_MAX_DATA_LEN - sizeof(mr_data_t))
+
+// 收到的包 接收回调在WiFi任务里 只拷进队列
+typedef struct {
+    int64_t rx_us;
+    uint8_t src[ESP_NOW_ETH_ALEN];
+    uint8_t len;
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+} mr_pkt_t;
+
+typedef struct {
+    bool used;
+    uint32_t frame;
+    int64_t pts;
+    uint16_t len;
+    uint8_t need;                       // 总分片数
+    uint8_t got;                        // 收到的分片 按位
+    uint8_t *data;
+} mr_slot_t;
+
+// 接收任务自己的状态 只在接收任务里用
+typedef struct {
+    uint8_t src[ESP_NOW_ETH_ALEN];      // 在跟的发送端
+    bool have_src;
+    uint32_t session;
+    bool have_session;
+    uint32_t last_seq;
+    int64_t last_rx;
+    int64_t clk[MULTIROOM_CLOCK_WINDOW];
+    int clk_n;
+    int clk_pos;
+    int64_t offset;                     // 发送端减本地
+    uint32_t rate;
+    uint16_t spf;
+    uint8_t channels;
+    bool started;                       // 定下了从哪一帧开始
+    uint32_t next;                      // 下一个要放的帧
+    uint32_t ref_frame;                 // 最近一个知道准确出声时刻的帧 没收到的帧从它推
+    int64_t ref_pts;
+    bool end;
+    uint32_t end_frame;
+    bool playing;
+    bool locked;
+    int32_t err_f;
+    HMP3Decoder mp3;
+    int16_t *pcm;                       // 一帧解码输出
+    int16_t *zero;                      // 补静音用 写之前清零 均衡器会把尾巴写进来
+    mr_slot_t slots[MULTIROOM_FRAMES];
+    uint8_t *store;
+} mr_rx_t;
+
+static const uint8_t s_bcast[ESP_NOW_ETH_ALEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile multiroom_role_t s_role = MULTIROOM_OFF;
+static multiroom_stats_t s_stats;
+static QueueHandle_t s_rx_q = NULL;
+static TaskHandle_t s_tx_task = NULL;           // 建任务时就填上 任务退出前清掉
+static TaskHandle_t s_rx_task = NULL;
+static volatile bool s_tx_stop = false;
+static volatile bool s_rx_stop = false;
+static char s_tx_path[MR_PATH_LEN];
+static uint8_t s_self[ESP_NOW_ETH_ALEN];
+static bool s_now_ready = false;
+
+#define STAT_ADD(field, n)  do { portENTER_CRITICAL(&s_lock); s_stats.field += (n); portEXIT_CRITICAL(&s_lock); } while (0)
+#define STAT_SET(field, v)  do { portENTER_CRITICAL(&s_lock); s_stats.field = (v); portEXIT_CRITICAL(&s_lock); } while (0)
+
+static void mr_push(const uint8_t *src, const uint8_t *data, int len, int64_t rx_us)
+{
+    if (s_rx_q == NULL || len < (int)sizeof(mr_hdr_t) || len > ESP_NOW_MAX_DATA_LEN)
+    {
+        return;
+    }
+    const mr_hdr_t *h = (const mr_hdr_t *)data;
+    if (h->magic != MR_MAGIC)
+    {
+        return;
+    }
+    mr_pkt_t pkt;
+    pkt.rx_us = rx_us;
+    memcpy(pkt.src, src, ESP_NOW_ETH_ALEN);
+    pkt.len = len;
+    memcpy(pkt.data, data, len);
+    xQueueSend(s_rx_q, &pkt, 0); // 满了就丢 按丢包算
+}
+
+// 在WiFi任务里 先记下收到的时刻
+static void mr_recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    int64_t now = esp_timer_get_time();
+    if (s_role != MULTIROOM_LISTENER)
+    {
+        return; // 发送端只听自己的
+    }
+    mr_push(info->src_addr, data, len, now);
+}
+
+// WiFi开起来 没连路由器时换到约定的信道 接收时关掉省电 不然会漏掉广播
+static esp_err_t mr_radio_up(void)
+{
+    ESP_RETURN_ON_ERROR(wifi_svc_start(), TAG, "wifi");
+    if (!wifi_svc_connected())
+    {
+        ESP_RETURN_ON_ERROR(esp_wifi_set_channel(MULTIROOM_CHANNEL, WIFI_SECOND_CHAN_NONE), TAG, "channel");
+    }
+    esp_wifi_set_ps(WIFI_PS_NONE);
+    if (!s_now_ready)
+    {
+        ESP_RETURN_ON_ERROR(esp_now_init(), TAG, "esp_now init");
+        ESP_RETURN_ON_ERROR(esp_now_register_recv_cb(mr_recv_cb), TAG, "recv cb");
+        esp_now_peer_info_t peer = {
+            .channel = 0, // 跟着现在的信道
+            .ifidx = WIFI_IF_STA,
+            .encrypt = false,
+        };
+        memcpy(peer.peer_addr, s_bcast, ESP_NOW_ETH_ALEN);
+        ESP_RETURN_ON_ERROR(esp_now_add_peer(&peer), TAG, "peer");
+        esp_wifi_get_mac(WIFI_IF_STA, s_self);
+        s_now_ready = true;
+    }
+    if (s_rx_q == NULL)
+    {
+        s_rx_q = xQueueCreate(MR_QUEUE, sizeof(mr_pkt_t));
+        ESP_RETURN_ON_FALSE(s_rx_q, ESP_ERR_NO_MEM, TAG, "no mem for queue");
+    }
+    return ESP_OK;
+}
+
+/*********************** 发送端 ****************************/
+
+typedef struct {
+    FILE *fp;
+    uint8_t *buf;
+    size_t pos;
+    size_t len;
+    bool eof;
+} mr_reader_t;
+
+// 缓冲里至少留want字节 不够就把剩下的挪到开头再读
+static size_t rd_need(mr_reader_t *r, size_t want)
+{
+    if (r->len - r->pos < want && !r->eof)
+    {
+        memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+        r->len -= r->pos;
+        r->pos = 0;
+        size_t n = fread(r->buf + r->len, 1, MR_READ_BUF - r->len, r->fp);
+        r->len += n;
+        r->eof = r->len < MR_READ_BUF;
+    }
+    return r->len - r->pos;
+}
+
+// 只认Layer III 返回帧长 0是不像帧头
+static size_t mp3_frame_info(const uint8_t *p, uint32_t *rate, uint16_t *spf, uint8_t *channels)
+{
+    static const uint16_t kbps[2][15] = {
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},    // MPEG1
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},        // MPEG2/2.5
+    };
+    static const uint32_t rates[3] = {44100, 48000, 32000};
+    if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0 || ((p[1] >> 1) & 3) != 1)
+    {
+        return 0;
+    }
+    int ver = (p[1] >> 3) & 3;  // 3:MPEG1 2:MPEG2 0:MPEG2.5
+    int bi = p[2] >> 4;
+    int si = (p[2] >> 2) & 3;
+    if (ver == 1 || bi == 0 || bi == 15 || si == 3)
+    {
+        return 0; // 保留值和自由码率不支持
+    }
+    bool v1 = ver == 3;
+    uint32_t sr = rates[si] >> (v1 ? 0 : ver == 2 ? 1 : 2);
+    uint32_t pad = (p[2] >> 1) & 1;
+    *rate = sr;
+    *spf = v1 ? 1152 : 576;
+    *channels = (p[3] >> 6) == 3 ? 1 : 2;
+    return (v1 ? 144000 : 72000) * kbps[v1 ? 0 : 1][bi] / sr + pad;
+}
+
+// 找下一帧 下一帧的帧头也要对得上才算 返回帧长 读完返回0
+static size_t rd_frame(mr_reader_t *r, uint32_t *rate, uint16_t *spf, uint8_t *channels)
+{
+    while (rd_need(r, 4) >= 4)
+    {
+        const uint8_t *p = r->buf + r->pos;
+        size_t len = mp3_frame_info(p, rate, spf, channels);
+        if (len == 0 || len > MULTIROOM_FRAME_MAX)
+        {
+            r->pos++;
+            continue;
+        }
+        size_t have = rd_need(r, len + 4);
+        p = r->buf + r->pos;
+        if (have < len)
+        {
+            return 0; // 文件末尾半帧
+        }
+        uint32_t r2;
+        uint16_t s2;
+        uint8_t c2;
+        if (have >= len + 4 && (mp3_frame_info(p + len, &r2, &s2, &c2) == 0 || r2 != *rate))
+        {
+            r->pos++;
+            continue;
+        }
+        return len;
+    }
+    return 0;
+}
+
+// 本机的包不经过空中 按最快的空中时间记收到时刻 和别的房间一样算时钟
+static void mr_tx(void *pkt, size_t len)
+{
+    mr_push(s_self, pkt, len, esp_timer_get_time() + MR_AIR_US);
+    esp_err_t ret = ESP_ERR_ESPNOW_NO_MEM;
+    for (int i = 0; i < MR_TX_RETRY && ret == ESP_ERR_ESPNOW_NO_MEM; i++)
+    {
+        ret = esp_now_send(s_bcast, pkt, len);
+        if (ret == ESP_ERR_ESPNOW_NO_MEM)
+        {
+            vTaskDelay(1);
+        }
+    }
+    if (ret == ESP_OK)
+    {
+        STAT_ADD(packets_tx, 1);
+    }
+    else
+    {
+        STAT_ADD(tx_errors, 1);
+    }
+}
+
+static void mr_beacon(mr_hdr_t *h, uint8_t flags, uint32_t rate, uint16_t spf, uint8_t ch, uint32_t frames)
+{
+    mr_beacon_t b = {
+        .h = *h,
+        .rate = rate,
+        .spf = spf,
+        .channels = ch,
+        .frames = frames,
+    };
+    b.h.type = MR_PKT_BEACON;
+    b.h.flags = flags;
+    b.h.seq = h->seq++;
+    b.now_us = esp_timer_get_time();
+    mr_tx(&b, sizeof(b));
+}
+
+// 按出声时刻提前MULTIROOM_LEAD_MS把每帧切成片发出去 期间每MULTIROOM_BEACON_MS插一个信标
+static void mr_tx_task(void *arg)
+{
+    mr_reader_t r = {0};
+    r.fp = fopen(s_tx_path, "rb");
+    r.buf = malloc(MR_READ_BUF);
+    uint8_t *pkt = malloc(ESP_NOW_MAX_DATA_LEN);
+    if (r.fp == NULL || r.buf == NULL || pkt == NULL)
+    {
+        ESP_LOGE(TAG, "cannot open %s", s_tx_path);
+        goto out;
+    }
+    // 跳过ID3v2标签 长度是4个7位字节
+    uint8_t id3[10];
+    if (fread(id3, 1, 10, r.fp) == 10 && memcmp(id3, "ID3", 3) == 0)
+    {
+        long skip = ((id3[6] & 0x7f) << 21) | ((id3[7] & 0x7f) << 14) | ((id3[8] & 0x7f) << 7) | (id3[9] & 0x7f);
+        fseek(r.fp, skip + 10 + ((id3[5] & 0x10) ? 10 : 0), SEEK_SET);
+    }
+    else
+    {
+        fseek(r.fp, 0, SEEK_SET);
+    }
+
+    mr_hdr_t h = {
+        .magic = MR_MAGIC,
+        .session = esp_random(),
+    };
+    uint32_t rate = 0, frame = 0;
+    uint16_t spf = 0;
+    uint8_t ch = 0;
+    uint64_t samples = 0;
+    int64_t t0 = esp_timer_get_time() + MULTIROOM_LEAD_MS * 1000LL;
+    int64_t last_beacon = 0;
+    ESP_LOGI(TAG, "sending %s session %08lx", s_tx_path, (unsigned long)h.session);
+
+    while (!s_tx_stop)
+    {
+        uint32_t fr;
+        uint16_t fs;
+        uint8_t fc;
+        size_t len = rd_frame(&r, &fr, &fs, &fc);
+        if (len == 0)
+        {
+            break;
+        }
+        if (rate == 0)
+        {
+            rate = fr;
+            spf = fs;
+            ch = fc;
+            for (int i = 0; i < MR_CLOCK_MIN; i++)
+            {
+                mr_beacon(&h, 0, rate, spf, ch, 0); // 开头先对时钟
+            }
+            last_beacon = esp_timer_get_time();
+        }
+        else if (fr != rate || fs != spf)
+        {
+            ESP_LOGW(TAG, "format changed mid-stream, stop");
+            break;
+        }
+
+        int64_t pts = t0 + (int64_t)(samples * 1000000 / rate);
+        int64_t wait = pts - MULTIROOM_LEAD_MS * 1000LL - esp_timer_get_time();
+        while (wait > 0 && !s_tx_stop)
+        {
+            vTaskDelay(pdMS_TO_TICKS(wait / 1000) ? pdMS_TO_TICKS(wait / 1000) : 1);
+            wait = pts - MULTIROOM_LEAD_MS * 1000LL - esp_timer_get_time();
+        }
+        if (esp_timer_get_time() - last_beacon >= MULTIROOM_BEACON_MS * 1000LL)
+        {
+            mr_beacon(&h, 0, rate, spf, ch, frame);
+            last_beacon = esp_timer_get_time();
+        }
+
+        mr_data_t *d = (mr_data_t *)pkt;
+        for (size_t off = 0; off < len && !s_tx_stop; off += MR_FRAG)
+        {
+            size_t n = len - off < MR_FRAG ? len - off : MR_FRAG;
+            d->h = h;
+            d->h.type = MR_PKT_DATA;
+            d->h.seq = h.seq++;
+            d->frame = frame;
+            d->pts_us = pts;
+            d->len = len;
+            d->off = off;
+            memcpy(d->data, r.buf + r.pos + off, n);
+            mr_tx(d, sizeof(*d) + n);
+        }
+        r.pos += len;
+        samples += spf;
+        frame++;
+    }
+
+    for (int i = 0; i < MR_END_BEACONS && rate; i++)
+    {
+        mr_beacon(&h, MR_FLAG_END, rate, spf, ch, frame);
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    ESP_LOGI(TAG, "sent %lu frames", (unsigned long)frame);
+
+out:
+    if (r.fp)
+    {
+        fclose(r.fp);
+    }
+    free(r.buf);
+    free(pkt);
+    s_tx_task = NULL;
+    vTaskDelete(NULL);
+}
+
+/*********************** 接收端 ****************************/
+
+static void rx_reset(mr_rx_t *rx)
+{
+    rx->started = false;
+    rx->end = false;
+    rx->locked = false;
+    rx->err_f = 0;
+    for (int i = 0; i < MULTIROOM_FRAMES; i++)
+    {
+        rx->slots[i].used = false;
+    }
+    if (rx->mp3)
+    {
+        MP3FreeDecoder(rx->mp3);
+    }
+    rx->mp3 = MP3InitDecoder();
+}
+
+// 把剩下的放完 静音 回到等发送端的状态
+static void rx_finish(mr_rx_t *rx)
+{
+    if (rx->playing)
+    {
+        audio_pcm_drain(1000);
+        audio_pcm_set_mute(true);
+        bsp_codec_mute_set(true);
+        audio_pcm_set_rate_trim(0);
+        rx->playing = false;
+    }
+    rx->locked = false;
+    rx->started = false;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.playing = false;
+    s_stats.locked = false;
+    s_stats.trim_ppm = 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 第几帧在发送端时钟上的出声时刻 从最近一个准确的推
+static int64_t rx_pts(const mr_rx_t *rx, uint32_t frame)
+{
+    return rx->ref_pts + (int64_t)(int32_t)(frame - rx->ref_frame) * rx->spf * 1000000LL / rx->rate;
+}
+
+static bool rx_session(mr_rx_t *rx, const mr_pkt_t *pkt)
+{
+    const mr_hdr_t *h = (const mr_hdr_t *)pkt->data;
+    bool same_src = rx->have_src && memcmp(rx->src, pkt->src, ESP_NOW_ETH_ALEN) == 0;
+    if (rx->have_src && !same_src && esp_timer_get_time() - rx->last_rx < MULTIROOM_TIMEOUT_MS * 1000LL)
+    {
+        return false; // 同一时间只跟一个发送端
+    }
+    if (!same_src)
+    {
+        memcpy(rx->src, pkt->src, ESP_NOW_ETH_ALEN);
+        rx->have_src = true;
+        rx->clk_n = 0; // 换了发送端 时钟重新对
+        rx->clk_pos = 0;
+    }
+    if (!rx->have_session || !same_src || h->session != rx->session)
+    {
+        if (rx->have_session)
+        {
+            rx_finish(rx);
+        }
+        rx_reset(rx);
+        rx->session = h->session;
+        rx->have_session = true;
+        rx->last_seq = h->seq;
+        ESP_LOGI(TAG, "following session %08lx", (unsigned long)h->session);
+    }
+    else if ((int32_t)(h->seq - rx->last_seq) > 0)
+    {
+        STAT_ADD(packets_lost, h->seq - rx->last_seq - 1);
+        rx->last_seq = h->seq;
+    }
+    rx->last_rx = pkt->rx_us;
+    STAT_ADD(packets_rx, 1);
+    return true;
+}
+
+static void rx_beacon(mr_rx_t *rx, const mr_pkt_t *pkt)
+{
+    const mr_beacon_t *b = (const mr_beacon_t *)pkt->data;
+    if (pkt->len < sizeof(*b) || b->rate == 0 || b->spf == 0 || b->spf > MR_PCM_FRAMES || b->channels < 1 ||
+        b->channels > 2)
+    {
+        return;
+    }
+    rx->clk[rx->clk_pos] = b->now_us - pkt->rx_us;
+    rx->clk_pos = (rx->clk_pos + 1) % MULTIROOM_CLOCK_WINDOW;
+    rx->clk_n += rx->clk_n < MULTIROOM_CLOCK_WINDOW;
+    int64_t hi = rx->clk[0], lo = rx->clk[0];
+    for (int i = 1; i < rx->clk_n; i++)
+    {
+        hi = rx->clk[i] > hi ? rx->clk[i] : hi;
+        lo = rx->clk[i] < lo ? rx->clk[i] : lo;
+    }
+    // 走得最快的那次最接近真实的时钟差 再补上最快的空中时间
+    rx->offset = hi + MR_AIR_US;
+    if (rx->rate != b->rate || rx->channels != b->channels)
+    {
+        rx_finish(rx); // 格式变了 下一帧按新格式开codec
+    }
+    rx->rate = b->rate;
+    rx->spf = b->spf;
+    rx->channels = b->channels;
+    if (b->h.flags & MR_FLAG_END)
+    {
+        rx->end = true;
+        rx->end_frame = b->frames;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.clock_offset_us = rx->offset;
+    s_stats.clock_jitter_us = (uint32_t)(hi - lo);
+    s_stats.sample_rate = rx->rate;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void rx_data(mr_rx_t *rx, const mr_pkt_t *pkt)
+{
+    const mr_data_t *d = (const mr_data_t *)pkt->data;
+    if (pkt->len <= sizeof(*d))
+    {
+        return;
+    }
+    size_t n = pkt->len - sizeof(*d);
+    if (d->len == 0 || d->len > MULTIROOM_FRAME_MAX || d->off % MR_FRAG || d->off + n > d->len)
+    {
+        return;
+    }
+    if (!rx->started)
+    {
+        rx->started = true;
+        rx->next = d->frame; // 中途加入从收到的第一帧开始
+    }
+    int32_t ahead = (int32_t)(d->frame - rx->next);
+    if (ahead < 0 || ahead >= MULTIROOM_FRAMES)
+    {
+        return; // 已经放过了 或者抖动缓冲放不下
+    }
+    rx->ref_frame = d->frame;
+    rx->ref_pts = d->pts_us;
+    mr_slot_t *s = &rx->slots[d->frame & (MULTIROOM_FRAMES - 1)];
+    if (!s->used || s->frame != d->frame)
+    {
+        s->used = true;
+        s->frame = d->frame;
+        s->pts = d->pts_us;
+        s->len = d->len;
+        s->need = (d->len + MR_FRAG - 1) / MR_FRAG;
+        s->got = 0;
+    }
+    memcpy(s->data + d->off, d->data, n);
+    s->got |= 1 << (d->off / MR_FRAG);
+}
+
+static void rx_silence(mr_rx_t *rx, uint32_t frames)
+{
+    while (frames)
+    {
+        uint32_t n = frames < MR_ZERO_FRAMES ? frames : MR_ZERO_FRAMES;
+        memset(rx->zero, 0, n * rx->channels * sizeof(int16_t));
+        audio_pcm_write(rx->zero, n * rx->channels * sizeof(int16_t), NULL, 200);
+        frames -= n;
+    }
+}
+
+// 解码一帧写出去 写之前对一下这一帧会在什么时候出声
+static void rx_output(mr_rx_t *rx, mr_slot_t *s, int64_t pts)
+{
+    if (!rx->playing)
+    {
+        audio_pcm_set_fs(rx->rate, 16, rx->channels == 1 ? I2S_SLOT_MODE_MONO : I2S_SLOT_MODE_STEREO);
+        audio_pcm_set_mute(false);
+        bsp_codec_mute_set(false);
+        rx_silence(rx, BSP_I2S_DMA_DESC_NUM * BSP_I2S_DMA_FRAME_NUM); // 先把DMA填满 延迟估计按满的算
+        rx->playing = true;
+        rx->locked = false;
+        STAT_SET(playing, true);
+    }
+
+    bool ok = false;
+    uint32_t frames = rx->spf;
+    if (s && rx->mp3 && s->got == (uint8_t)((1u << s->need) - 1))
+    {
+        uint8_t *ptr = s->data;
+        int left = s->len;
+        MP3FrameInfo fi;
+        if (MP3Decode(rx->mp3, &ptr, &left, rx->pcm, 0) == 0)
+        {
+            MP3GetLastFrameInfo(rx->mp3, &fi);
+            ok = fi.nChans == rx->channels && fi.outputSamps / fi.nChans == rx->spf;
+        }
+    }
+    if (!ok)
+    {
+        memset(rx->pcm, 0, frames * rx->channels * sizeof(int16_t));
+        STAT_ADD(frames_lost, 1);
+    }
+
+    int64_t now = esp_timer_get_time();
+    int32_t err = (int32_t)(now + audio_pcm_output_delay_us() - (pts - rx->offset));
+    int32_t frame_us = (int32_t)((int64_t)frames * 1000000 / rx->rate);
+    if (!rx->locked)
+    {
+        if (err > frame_us)
+        {
+            STAT_ADD(frames_dropped, 1); // 晚了一帧以上 丢掉追上去
+            return;
+        }
+        if (err < -MR_LOCK_US)
+        {
+            rx_silence(rx, (uint32_t)((int64_t)-err * rx->rate / 1000000));
+        }
+        rx->locked = true;
+        rx->err_f = 0;
+        audio_pcm_set_rate_trim(0);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.locked = true;
+        s_stats.sync_us = 0;
+        s_stats.trim_ppm = 0;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    else
+    {
+        rx->err_f += (err - rx->err_f) / MR_ERR_FILTER;
+        int32_t trim = rx->err_f * MR_TRIM_PPM_MS / 1000;
+        trim = trim > MULTIROOM_TRIM_MAX_PPM ? MULTIROOM_TRIM_MAX_PPM : trim < -MULTIROOM_TRIM_MAX_PPM ? -MULTIROOM_TRIM_MAX_PPM : trim;
+        int32_t mag = rx->err_f < 0 ? -rx->err_f : rx->err_f;
+        if (mag > MULTIROOM_RESYNC_MS * 1000)
+        {
+            ESP_LOGW(TAG, "sync error %ld us, realign", (long)rx->err_f);
+            rx->locked = false;
+            trim = 0;
+            STAT_ADD(resyncs, 1);
+        }
+        audio_pcm_set_rate_trim(trim); // 晚了就放快一点
+        portENTER_CRITICAL(&s_lock);
+        s_stats.locked = rx->locked;
+        s_stats.sync_us = rx->err_f;
+        s_stats.sync_max_us = mag > s_stats.sync_max_us ? mag : s_stats.sync_max_us;
+        s_stats.trim_ppm = trim;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    audio_pcm_write(rx->pcm, frames * rx->channels * sizeof(int16_t), NULL, 200);
+    STAT_ADD(frames_played, 1);
+}
+
+// 到点的帧都写出去 返回下一帧该写的本地时刻 0是还不知道
+static int64_t rx_play(mr_rx_t *rx)
+{
+    while (rx->started && rx->clk_n >= MR_CLOCK_MIN && rx->rate && !s_rx_stop)
+    {
+        if (rx->end && (int32_t)(rx->next - rx->end_frame) >= 0)
+        {
+            ESP_LOGI(TAG, "session %08lx ended", (unsigned long)rx->session);
+            rx_finish(rx);
+            rx->have_session = false;
+            return 0;
+        }
+        mr_slot_t *s = &rx->slots[rx->next & (MULTIROOM_FRAMES - 1)];
+        bool have = s->used && s->frame == rx->next;
+        int64_t pts = have ? s->pts : rx_pts(rx, rx->next);
+        int64_t due = pts - rx->offset - MULTIROOM_OUTPUT_MS * 1000LL;
+        if (esp_timer_get_time() < due)
+        {
+            return due;
+        }
+        rx_output(rx, have ? s : NULL, pts);
+        s->used = false;
+        rx->next++;
+    }
+    return 0;
+}
+
+static void mr_rx_task(void *arg)
+{
+    mr_rx_t *rx = heap_caps_calloc(1, sizeof(mr_rx_t), MALLOC_CAP_INTERNAL);
+    uint8_t *store = heap_caps_malloc(MULTIROOM_FRAMES * MULTIROOM_FRAME_MAX, MALLOC_CAP_SPIRAM);
+    int16_t *pcm = heap_caps_malloc(MR_PCM_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    int16_t *zero = heap_caps_malloc(MR_ZERO_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    if (rx == NULL || store == NULL || pcm == NULL || zero == NULL)
+    {
+        ESP_LOGE(TAG, "no memory for receiver");
+        goto out;
+    }
+    rx->store = store;
+    rx->pcm = pcm;
+    rx->zero = zero;
+    for (int i = 0; i < MULTIROOM_FRAMES; i++)
+    {
+        rx->slots[i].data = store + i * MULTIROOM_FRAME_MAX;
+    }
+    audio_pcm_set_speed(100);
+    audio_pcm_set_clock_trim(true);
+
+    mr_pkt_t pkt;
+    while (!s_rx_stop)
+    {
+        int64_t due = rx_play(rx);
+        int64_t now = esp_timer_get_time();
+        TickType_t wait = pdMS_TO_TICKS(100);
+        if (due)
+        {
+            wait = due > now ? (TickType_t)((due - now) / 1000 / portTICK_PERIOD_MS) : 0;
+        }
+        if (xQueueReceive(s_rx_q, &pkt, wait) != pdTRUE)
+        {
+            if (rx->have_session && now - rx->last_rx > MULTIROOM_TIMEOUT_MS * 1000LL)
+            {
+                ESP_LOGW(TAG, "sender lost");
+                rx_finish(rx);
+                rx->have_session = false;
+            }
+            continue;
+        }
+        do
+        {
+            const mr_hdr_t *h = (const mr_hdr_t *)pkt.data;
+            if (!rx_session(rx, &pkt))
+            {
+                continue;
+            }
+            if (h->type == MR_PKT_BEACON)
+            {
+                rx_beacon(rx, &pkt);
+            }
+            else if (h->type == MR_PKT_DATA)
+            {
+                rx_data(rx, &pkt);
+            }
+        } while (xQueueReceive(s_rx_q, &pkt, 0) == pdTRUE);
+    }
+    rx_finish(rx);
+    audio_pcm_set_clock_trim(false);
+
+out:
+    if (rx && rx->mp3)
+    {
+        MP3FreeDecoder(rx->mp3);
+    }
+    free(rx);
+    heap_caps_free(store);
+    heap_caps_free(pcm);
+    heap_caps_free(zero);
+    s_rx_task = NULL;
+    vTaskDelete(NULL);
+}
+
+/*********************** 对外接口 ****************************/
+
+static void mr_wait_exit(TaskHandle_t *task)
+{
+    for (int i = 0; *(volatile TaskHandle_t *)task && i < MR_STOP_MS / 10; i++)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+static void mr_stop_tx(void)
+{
+    s_tx_stop = true;
+    mr_wait_exit(&s_tx_task);
+    s_tx_stop = false;
+}
+
+static esp_err_t mr_start_rx(void)
+{
+    if (s_rx_task)
+    {
+        return ESP_OK;
+    }
+    xQueueReset(s_rx_q);
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_MULTIROOM_RX, mr_rx_task, NULL, &s_rx_task) == pdPASS, ESP_ERR_NO_MEM,
+                        TAG, "rx task");
+    return ESP_OK;
+}
+
+static void mr_set_role(multiroom_role_t role)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (role != s_role && role != MULTIROOM_OFF)
+    {
+        memset(&s_stats, 0, sizeof(s_stats)); // 停下以后还能看上一次的
+    }
+    s_role = role;
+    s_stats.role = role;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t multiroom_send(const char *path)
+{
+    ESP_RETURN_ON_FALSE(path && strlen(path) < MR_PATH_LEN, ESP_ERR_INVALID_ARG, TAG, "bad path");
+    if (s_role == MULTIROOM_LISTENER)
+    {
+        multiroom_stop();
+    }
+    mr_stop_tx();
+    ESP_RETURN_ON_ERROR(mr_radio_up(), TAG, "radio");
+    mr_set_role(MULTIROOM_SENDER);
+    strcpy(s_tx_path, path);
+    esp_err_t ret = mr_start_rx();
+    if (ret == ESP_OK && task_plan_create(TASK_MULTIROOM_TX, mr_tx_task, NULL, &s_tx_task) != pdPASS)
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    if (ret != ESP_OK)
+    {
+        multiroom_stop();
+    }
+    return ret;
+}
+
+esp_err_t multiroom_listen(void)
+{
+    if (s_role == MULTIROOM_LISTENER)
+    {
+        return ESP_OK;
+    }
+    multiroom_stop();
+    ESP_RETURN_ON_ERROR(mr_radio_up(), TAG, "radio");
+    mr_set_role(MULTIROOM_LISTENER);
+    esp_err_t ret = mr_start_rx();
+    if (ret != ESP_OK)
+    {
+        multiroom_stop();
+    }
+    return ret;
+}
+
+void multiroom_stop(void)
+{
+    if (s_role == MULTIROOM_OFF)
+    {
+        return;
+    }
+    mr_stop_tx();
+    s_rx_stop = true;
+    mr_wait_exit(&s_rx_task);
+    s_rx_stop = false;
+    mr_set_role(MULTIROOM_OFF);
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+}
+
+multiroom_role_t multiroom_role(void)
+{
+    return s_role;
+}
+
+void multiroom_get_stats(multiroom_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
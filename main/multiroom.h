@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 多房间同步播放 ESP-NOW ****************************/
+// 一台当发送端 从SD卡读MP3 按帧头切开 每帧带上发送端时钟的出声时刻 提前MULTIROOM_LEAD_MS分片广播
+// 发送端自己也当一个接收端 本机的包不经过空中直接进接收队列 和别的房间走同一条播放路径
+// 发送端每MULTIROOM_BEACON_MS广播一次时钟 接收端算发送时刻减收到时刻 取最近一段里最大的(单程最快的那次)当时钟差
+// 接收端把帧攒在抖动缓冲里 到了出声时刻减去MULTIROOM_OUTPUT_MS就解码写进audio_pcm 输出通路保持这么长
+// 每写一帧算它真正出声的时刻和约定时刻的差 滤波后按比例微调重采样的步长 两边晶振差几十ppm也跟得上
+// 一开始和差太多时直接补静音或者丢帧 一帧的分片不全就用一帧静音代替 时间轴不乱 丢包按包序号的空洞统计
+// 所有设备要在同一个信道上 都连同一个路由器 或者都不连(用MULTIROOM_CHANNEL)
+
+#define MULTIROOM_CHANNEL       CONFIG_APP_MULTIROOM_CHANNEL
+#define MULTIROOM_LEAD_MS       CONFIG_APP_MULTIROOM_LEAD_MS    // 发送比出声提前这么久 就是抖动缓冲的深度
+#define MULTIROOM_OUTPUT_MS     150     // 接收端环形缓冲加DMA保持的延迟 要小于环形缓冲的时长
+#define MULTIROOM_BEACON_MS     100
+#define MULTIROOM_CLOCK_WINDOW  32      // 时钟差取这么多个信标里的最大值 约3秒 晶振漂移在这段里可以不计
+#define MULTIROOM_FRAMES        64      // 抖动缓冲的帧槽 必须是2的幂 44.1kHz时1.7秒
+#define MULTIROOM_FRAME_MAX     1536    // 一帧MP3最多的字节数 320kbps 32kHz是1441
+#define MULTIROOM_RESYNC_MS     30      // 滤波后的误差超过这么多重新对齐
+#define MULTIROOM_TRIM_MAX_PPM  500     // 微调的上限 0.05%听不出音高变化
+#define MULTIROOM_TIMEOUT_MS    2000    // 接收端这么久没收到包就停下
+
+typedef enum {
+    MULTIROOM_OFF,
+    MULTIROOM_SENDER,                   // 广播本机的曲目 自己也同步放
+    MULTIROOM_LISTENER,                 // 听到发送端就跟着放
+} multiroom_role_t;
+
+typedef struct {
+    multiroom_role_t role;
+    bool playing;                       // 正在按约定时刻出声
+    bool locked;                        // 已经对齐 在用微调跟
+    uint32_t packets_tx;
+    uint32_t tx_errors;                 // esp_now_send一直忙发不出去的
+    uint32_t packets_rx;
+    uint32_t packets_lost;              // 包序号的空洞 发送端换曲以后重新算
+    uint32_t frames_played;
+    uint32_t frames_lost;               // 分片不全 放了一帧静音
+    uint32_t frames_dropped;            // 对齐时来不及放丢掉的
+    uint32_t resyncs;                   // 误差太大重新对齐的次数
+    int32_t sync_us;                    // 滤波后的同步误差 正的是比约定晚
+    int32_t sync_max_us;                // 对齐以后误差绝对值的最大值
+    int32_t trim_ppm;                   // 现在的重采样微调
+    int64_t clock_offset_us;            // 发送端时钟减本地时钟
+    uint32_t clock_jitter_us;           // 窗口里单程时间最长减最短
+    uint32_t sample_rate;
+} multiroom_stats_t;
+
+esp_err_t multiroom_send(const char *path);     // 广播这个MP3 已经在发送就换曲 接收端跟着换
+esp_err_t multiroom_listen(void);               // 当接收端 调用之前先停掉本机的播放器
+void multiroom_stop(void);                      // 等两个任务退出 最多约一秒
+multiroom_role_t multiroom_role(void);
+void multiroom_get_stats(multiroom_stats_t *stats);
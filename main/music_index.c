@@ -0,0 +1,859 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <math.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "music_index.h"
+#include "task_plan.h"
+#include "sd_dir_cache.h"
+#include "media_type.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "ff.h"
+#include "psram_bw.h"
+#include "crash_ctx.h"
+#include "sdkconfig.h"
+#if CONFIG_APP_MUSIC_LOUDNESS_SCAN
+#include "mp3dec.h"
+#endif
+
+static const char *TAG = "music_index";
+
+#define MUSIC_INDEX_MAGIC   0x5844494D  // "MIDX"
+#define MUSIC_INDEX_VERSION 2     // 2: 加了响度增益
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t record_size;
+} music_index_header_t;
+
+static music_meta_t *s_items = NULL;    // PSRAM中的索引表
+static int s_count = 0;
+static SemaphoreHandle_t s_lock = NULL;
+static volatile bool s_ready = false;
+static music_index_done_cb_t s_done_cb = NULL;
+
+/******************************** 文本编码转换 ********************************/
+static size_t utf8_put(char *out, size_t pos, size_t cap, uint32_t cp)
+{
+    char tmp[4];
+    size_t n;
+    if (cp < 0x80) {
+        tmp[0] = cp; n = 1;
+    } else if (cp < 0x800) {
+        tmp[0] = 0xC0 | (cp >> 6); tmp[1] = 0x80 | (cp & 0x3F); n = 2;
+    } else {
+        tmp[0] = 0xE0 | (cp >> 12); tmp[1] = 0x80 | ((cp >> 6) & 0x3F); tmp[2] = 0x80 | (cp & 0x3F); n = 3;
+    }
+    if (pos + n >= cap) {
+        return pos;
+    }
+    memcpy(out + pos, tmp, n);
+    return pos + n;
+}
+
+// ID3v2文本帧转UTF-8 编码0按GBK(CP936)处理 国内mp3大多如此
+static void id3_text_to_utf8(const uint8_t *data, size_t len, char *out, size_t cap)
+{
+    size_t pos = 0;
+    out[0] = 0;
+    if (len < 1) {
+        return;
+    }
+    uint8_t enc = data[0];
+    data++;
+    len--;
+
+    if (enc == 3) { // UTF-8
+        size_t n = len < cap - 1 ? len : cap - 1;
+        memcpy(out, data, n);
+        out[n] = 0;
+        return;
+    }
+    if (enc == 1 || enc == 2) { // UTF-16 带BOM / UTF-16BE
+        bool be = (enc == 2);
+        size_t i = 0;
+        if (enc == 1 && len >= 2) {
+            be = (data[0] == 0xFE && data[1] == 0xFF);
+            i = 2;
+        }
+        for (; i + 1 < len; i += 2) {
+            uint16_t c = be ? (data[i] << 8 | data[i + 1]) : (data[i + 1] << 8 | data[i]);
+            if (c == 0) {
+                break;
+            }
+            pos = utf8_put(out, pos, cap, c);
+        }
+    } else { // ISO-8859-1 或 GBK
+        for (size_t i = 0; i < len && data[i]; i++) {
+            uint32_t cp = data[i];
+            if (cp >= 0x81 && i + 1 < len) {
+                WCHAR u = ff_oem2uni((WCHAR)(cp << 8 | data[i + 1]), 936);
+                if (u) {
+                    cp = u;
+                    i++;
+                }
+            }
+            pos = utf8_put(out, pos, cap, cp);
+        }
+    }
+    out[pos] = 0;
+}
+
+/******************************** ReplayGain标签 ********************************/
+typedef struct {
+    float gain;                         // dB
+    float peak;                         // 满幅1.0 0表示没有
+    bool has_gain;
+} rg_tag_t;
+
+static void rg_parse(const char *key, const char *val, rg_tag_t *rg)
+{
+    if (strcasecmp(key, "REPLAYGAIN_TRACK_GAIN") == 0) {
+        rg->gain = strtof(val, NULL);   // "-6.23 dB"
+        rg->has_gain = true;
+    } else if (strcasecmp(key, "REPLAYGAIN_TRACK_PEAK") == 0) {
+        rg->peak = strtof(val, NULL);
+    }
+}
+
+// TXXX帧: 编码 描述\0 值 ReplayGain的描述和值都是ASCII UTF-16时两个字节或起来就是字符
+static void id3_txxx(const uint8_t *data, size_t len, rg_tag_t *rg)
+{
+    char txt[2][32];
+    bool wide = data[0] == 1 || data[0] == 2;
+    int part = 0;
+    size_t n = 0;
+    for (size_t i = 1; i + wide < len; i += 1 + wide) {
+        uint8_t c = wide ? (data[i] | data[i + 1]) : data[i];
+        if (c == 0) {
+            txt[part][n] = 0;
+            if (++part == 2) {
+                break;
+            }
+            n = 0;
+        } else if (c < 0x80 && n < sizeof(txt[0]) - 1) { // 顺带跳过BOM
+            txt[part][n++] = c;
+        }
+    }
+    if (part == 1) {
+        txt[1][n] = 0;  // 值后面没有结束符
+    }
+    if (part >= 1) {
+        rg_parse(txt[0], txt[1], rg);
+    }
+}
+
+// dB换成0.01dB 放大时按峰值留住余量 不会削波
+static int16_t gain_to_cdb(float db, float peak)
+{
+    if (db > 0 && peak > 0) {
+        float head = -20.0f * log10f(peak);
+        db = head < db ? (head > 0 ? head : 0) : db;
+    }
+    long cdb = lroundf(db * 100);
+    cdb = cdb < MUSIC_INDEX_GAIN_MIN ? MUSIC_INDEX_GAIN_MIN : cdb;
+    return cdb > MUSIC_INDEX_GAIN_MAX ? MUSIC_INDEX_GAIN_MAX : cdb;
+}
+
+/******************************** 文件头解析 ********************************/
+static uint32_t syncsafe32(const uint8_t *b)
+{
+    return (b[0] & 0x7F) << 21 | (b[1] & 0x7F) << 14 | (b[2] & 0x7F) << 7 | (b[3] & 0x7F);
+}
+
+static uint32_t be32(const uint8_t *b)
+{
+    return (uint32_t)b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
+}
+
+static uint32_t le32(const uint8_t *b)
+{
+    return (uint32_t)b[3] << 24 | b[2] << 16 | b[1] << 8 | b[0];
+}
+
+// 解析ID3v2标签 返回标签总长度 没有标签返回0
+static uint32_t parse_id3v2(FILE *fp, music_meta_t *m, rg_tag_t *rg)
+{
+    uint8_t hdr[10];
+    if (fread(hdr, 1, 10, fp) != 10 || memcmp(hdr, "ID3", 3) != 0) {
+        return 0;
+    }
+    uint8_t ver = hdr[3];
+    uint32_t tag_size = syncsafe32(hdr + 6) + 10;
+    uint32_t pos = 10;
+    uint8_t buf[256];
+
+    while (ver >= 3 && pos + 10 < tag_size && (!m->title[0] || !m->artist[0] || !rg->has_gain || rg->peak == 0)) {
+        uint8_t fh[10];
+        if (fread(fh, 1, 10, fp) != 10 || fh[0] == 0) {
+            break;
+        }
+        uint32_t fsize = (ver >= 4) ? syncsafe32(fh + 4) : be32(fh + 4);
+        pos += 10 + fsize;
+        bool is_title = memcmp(fh, "TIT2", 4) == 0;
+        bool is_artist = memcmp(fh, "TPE1", 4) == 0;
+        bool is_txxx = memcmp(fh, "TXXX", 4) == 0;
+        if ((is_title || is_artist || is_txxx) && fsize > 0) {
+            size_t n = fsize < sizeof(buf) ? fsize : sizeof(buf);
+            if (fread(buf, 1, n, fp) != n) {
+                break;
+            }
+            if (is_txxx) {
+                id3_txxx(buf, n, rg);
+            } else if (is_title) {
+                id3_text_to_utf8(buf, n, m->title, sizeof(m->title));
+            } else {
+                id3_text_to_utf8(buf, n, m->artist, sizeof(m->artist));
+            }
+            fsize -= n;
+        }
+        if (fsize && fseek(fp, fsize, SEEK_CUR) != 0) {
+            break;
+        }
+    }
+    return tag_size;
+}
+
+// MP3时长 优先用Xing/Info帧数 否则按首帧码率估算(CBR)
+static void parse_mp3(FILE *fp, uint32_t audio_start, music_meta_t *m)
+{
+    static const uint16_t bitrate_v1_l3[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+    static const uint16_t bitrate_v2_l3[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+    static const uint16_t rate_table[3] = {44100, 48000, 32000};
+
+    uint8_t buf[512];
+    fseek(fp, audio_start, SEEK_SET);
+    size_t n = fread(buf, 1, sizeof(buf), fp);
+    for (size_t i = 0; i + 4 < n; i++) {
+        if (buf[i] != 0xFF || (buf[i + 1] & 0xE0) != 0xE0) {
+            continue;
+        }
+        int ver = (buf[i + 1] >> 3) & 3;    // 3:MPEG1 2:MPEG2 0:MPEG2.5
+        int layer = (buf[i + 1] >> 1) & 3;  // 1:Layer III
+        int br_idx = buf[i + 2] >> 4;
+        int sr_idx = (buf[i + 2] >> 2) & 3;
+        if (ver == 1 || layer != 1 || br_idx == 0 || br_idx == 15 || sr_idx == 3) {
+            continue;
+        }
+        uint32_t rate = rate_table[sr_idx] >> (ver == 3 ? 0 : (ver == 2 ? 1 : 2));
+        uint32_t kbps = (ver == 3) ? bitrate_v1_l3[br_idx] : bitrate_v2_l3[br_idx];
+        bool mono = (buf[i + 3] >> 6) == 3;
+        uint32_t spf = (ver == 3) ? 1152 : 576;
+        m->sample_rate = rate;
+        m->channels = mono ? 1 : 2;
+        m->bits = 16;
+
+        // Xing/Info头在side info之后
+        size_t side = (ver == 3) ? (mono ? 17 : 32) : (mono ? 9 : 17);
+        size_t x = i + 4 + side;
+        if (x + 12 < n && (memcmp(buf + x, "Xing", 4) == 0 || memcmp(buf + x, "Info", 4) == 0) && (buf[x + 7] & 1)) {
+            uint32_t frames = be32(buf + x + 8);
+            m->duration_ms = (uint32_t)((uint64_t)frames * spf * 1000 / rate);
+        } else if (kbps) {
+            m->duration_ms = (uint32_t)((uint64_t)(m->size - audio_start - i) * 8 / kbps);
+        }
+        return;
+    }
+}
+
+// FLAC STREAMINFO与VORBIS_COMMENT
+static void parse_flac(FILE *fp, uint32_t start, music_meta_t *m, rg_tag_t *rg)
+{
+    uint8_t hdr[4];
+    fseek(fp, start + 4, SEEK_SET); // 跳过"fLaC"
+    bool last = false;
+    while (!last && fread(hdr, 1, 4, fp) == 4) {
+        last = hdr[0] & 0x80;
+        int type = hdr[0] & 0x7F;
+        uint32_t len = hdr[1] << 16 | hdr[2] << 8 | hdr[3];
+        if (type == 0 && len >= 18) { // STREAMINFO
+            uint8_t si[18];
+            if (fread(si, 1, 18, fp) != 18) {
+                return;
+            }
+            m->sample_rate = si[10] << 12 | si[11] << 4 | si[12] >> 4;
+            m->channels = ((si[12] >> 1) & 7) + 1;
+            m->bits = (((si[12] & 1) << 4) | (si[13] >> 4)) + 1;
+            uint64_t total = (uint64_t)(si[13] & 0x0F) << 32 | be32(si + 14);
+            if (m->sample_rate) {
+                m->duration_ms = (uint32_t)(total * 1000 / m->sample_rate);
+            }
+            len -= 18;
+        } else if (type == 4 && len > 8) { // VORBIS_COMMENT 小端长度
+            uint8_t l4[4];
+            if (fread(l4, 1, 4, fp) != 4) {
+                return;
+            }
+            uint32_t vlen = le32(l4);
+            if (vlen > len - 8) {
+                return; // 长度比块还大 文件坏了
+            }
+            fseek(fp, vlen, SEEK_CUR);
+            if (fread(l4, 1, 4, fp) != 4) {
+                return;
+            }
+            uint32_t ncomments = le32(l4);
+            len -= 8 + vlen;
+            char buf[160];
+            for (uint32_t c = 0; c < ncomments && len >= 4; c++) {
+                if (fread(l4, 1, 4, fp) != 4) {
+                    return;
+                }
+                uint32_t clen = le32(l4);
+                len -= 4;
+                if (clen > len) {
+                    return;
+                }
+                uint32_t rd = clen < sizeof(buf) - 1 ? clen : sizeof(buf) - 1;
+                if (fread(buf, 1, rd, fp) != rd) {
+                    return;
+                }
+                buf[rd] = 0;
+                if (clen > rd) {
+                    fseek(fp, clen - rd, SEEK_CUR);
+                }
+                len -= clen;
+                if (strncasecmp(buf, "TITLE=", 6) == 0) {
+                    strlcpy(m->title, buf + 6, sizeof(m->title));
+                } else if (strncasecmp(buf, "ARTIST=", 7) == 0) {
+                    strlcpy(m->artist, buf + 7, sizeof(m->artist));
+                } else if (strncasecmp(buf, "REPLAYGAIN_", 11) == 0 && strchr(buf, '=')) {
+                    char *eq = strchr(buf, '=');
+                    *eq = 0;
+                    rg_parse(buf, eq + 1, rg);
+                }
+            }
+        }
+        if (len && fseek(fp, len, SEEK_CUR) != 0) {
+            return;
+        }
+    }
+}
+
+// WAV fmt与data块
+static void parse_wav(FILE *fp, music_meta_t *m)
+{
+    uint8_t ck[8];
+    uint32_t byte_rate = 0;
+    fseek(fp, 12, SEEK_SET);
+    while (fread(ck, 1, 8, fp) == 8) {
+        uint32_t len = le32(ck + 4);
+        if (memcmp(ck, "fmt ", 4) == 0 && len >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, 16, fp) != 16) {
+                return;
+            }
+            m->channels = fmt[2] | fmt[3] << 8;
+            m->sample_rate = le32(fmt + 4);
+            byte_rate = le32(fmt + 8);
+            m->bits = fmt[14] | fmt[15] << 8;
+            len -= 16;
+        } else if (memcmp(ck, "data", 4) == 0) {
+            if (byte_rate) {
+                m->duration_ms = (uint32_t)((uint64_t)len * 1000 / byte_rate);
+            }
+            return;
+        }
+        if (fseek(fp, len + (len & 1), SEEK_CUR) != 0) {
+            return;
+        }
+    }
+}
+
+static void parse_file(const char *path, music_meta_t *m)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return;
+    }
+    rg_tag_t rg = {0};
+    uint32_t start = parse_id3v2(fp, m, &rg);
+    uint8_t magic[4] = {0};
+    fseek(fp, start, SEEK_SET);
+    if (fread(magic, 1, 4, fp) == 4) {
+        if (memcmp(magic, "fLaC", 4) == 0) {
+            parse_flac(fp, start, m, &rg);
+        } else if (memcmp(magic, "RIFF", 4) == 0) {
+            parse_wav(fp, m);
+        } else {
+            parse_mp3(fp, start, m);
+        }
+    }
+    fclose(fp);
+#if CONFIG_APP_MUSIC_LOUDNESS
+    if (rg.has_gain) {
+        m->gain_cdb = gain_to_cdb(rg.gain, rg.peak);
+        m->gain_src = MUSIC_GAIN_TAG;
+    }
+#endif
+}
+
+/******************************** 响度估计 ********************************/
+#if CONFIG_APP_MUSIC_LOUDNESS_SCAN
+// 不解整首 在曲子里均匀抽几段 每段几个400ms块 按BS.1770的K加权和门限算响度
+// 一首4分钟的MP3大约解5秒音频 后台任务里几百毫秒
+#define LOUD_SEGMENTS       6
+#define LOUD_SEG_BLOCKS     2
+#define LOUD_BLOCKS         (LOUD_SEGMENTS * LOUD_SEG_BLOCKS)
+#define LOUD_SEG_FRAMES     64          // 一段最多解的MP3帧 坏帧多的段不会一直解下去
+#define LOUD_SKIP_FRAMES    2           // 跳转后头几帧缺比特池 不算
+#define LOUD_IN_BUF         2048
+#define LOUD_OUT_SAMPLES    (MAX_NSAMP * MAX_NGRAN * MAX_NCHAN)
+
+typedef struct {
+    float b[2][3];                      // 两级biquad 高搁架和高通
+    float a[2][2];
+    float z[2][2][2];                   // [声道][级][状态]
+    uint32_t block_len;                 // 400ms的帧数
+    uint32_t pos;
+    float acc;
+    float blocks[LOUD_BLOCKS];          // 每块的均方 声道相加
+    int nblocks;
+    int peak;
+} loud_t;
+
+// K加权系数 按采样率算 与libebur128相同
+static void loud_init(loud_t *l, uint32_t rate)
+{
+    memset(l, 0, sizeof(*l));
+    float k = tanf(M_PI * 1681.9745f / rate);
+    float q = 0.70717524f;
+    float vh = powf(10.0f, 3.9998438f / 20);
+    float vb = powf(vh, 0.49966677f);
+    float a0 = 1 + k / q + k * k;
+    l->b[0][0] = (vh + vb * k / q + k * k) / a0;
+    l->b[0][1] = 2 * (k * k - vh) / a0;
+    l->b[0][2] = (vh - vb * k / q + k * k) / a0;
+    l->a[0][0] = 2 * (k * k - 1) / a0;
+    l->a[0][1] = (1 - k / q + k * k) / a0;
+
+    k = tanf(M_PI * 38.135471f / rate);
+    q = 0.50032704f;
+    a0 = 1 + k / q + k * k;
+    l->b[1][0] = 1;
+    l->b[1][1] = -2;
+    l->b[1][2] = 1;
+    l->a[1][0] = 2 * (k * k - 1) / a0;
+    l->a[1][1] = (1 - k / q + k * k) / a0;
+    l->block_len = rate * 2 / 5;
+}
+
+// 换到下一段 上一段没凑满的块丢掉
+static void loud_segment(loud_t *l)
+{
+    memset(l->z, 0, sizeof(l->z));
+    l->pos = 0;
+    l->acc = 0;
+}
+
+static void loud_feed(loud_t *l, const int16_t *pcm, size_t frames, int ch)
+{
+    for (size_t i = 0; i < frames && l->nblocks < LOUD_BLOCKS; i++) {
+        float sum = 0;
+        for (int c = 0; c < ch && c < 2; c++) {
+            int v = pcm[i * ch + c];
+            v = v < 0 ? -v : v;
+            l->peak = v > l->peak ? v : l->peak;
+            float x = pcm[i * ch + c] / 32768.0f;
+            for (int s = 0; s < 2; s++) {  // 转置直接II型
+                float *z = l->z[c][s];
+                float y = l->b[s][0] * x + z[0];
+                z[0] = l->b[s][1] * x - l->a[s][0] * y + z[1];
+                z[1] = l->b[s][2] * x - l->a[s][1] * y;
+                x = y;
+            }
+            sum += x * x;
+        }
+        l->acc += sum;
+        if (++l->pos == l->block_len) {
+            l->blocks[l->nblocks++] = l->acc / l->block_len;
+            l->pos = 0;
+            l->acc = 0;
+        }
+    }
+}
+
+// 先去掉-70LUFS以下的块 再去掉比平均低10LU的块 剩下的平均就是响度
+static bool loud_result(const loud_t *l, float *lufs)
+{
+    const float abs_gate = powf(10.0f, (-70 + 0.691f) / 10);
+    float sum = 0;
+    int n = 0;
+    for (int i = 0; i < l->nblocks; i++) {
+        if (l->blocks[i] > abs_gate) {
+            sum += l->blocks[i];
+            n++;
+        }
+    }
+    if (n == 0) {
+        return false;
+    }
+    float rel_gate = sum / n * 0.1f;
+    sum = 0;
+    n = 0;
+    for (int i = 0; i < l->nblocks; i++) {
+        if (l->blocks[i] > abs_gate && l->blocks[i] > rel_gate) {
+            sum += l->blocks[i];
+            n++;
+        }
+    }
+    *lufs = -0.691f + 10 * log10f(sum / n);
+    return true;
+}
+
+static void loud_mp3(FILE *fp, uint32_t start, uint32_t size, loud_t *l, uint8_t *in, int16_t *out)
+{
+    HMP3Decoder h = MP3InitDecoder();
+    if (h == NULL) {
+        return;
+    }
+    MP3FrameInfo fi;
+    for (int seg = 0; seg < LOUD_SEGMENTS; seg++) {
+        fseek(fp, start + (uint64_t)(size - start) * (2 * seg + 1) / (2 * LOUD_SEGMENTS), SEEK_SET);
+        loud_segment(l);
+        uint8_t *ptr = in;
+        int left = 0;
+        bool eof = false, refill = true;
+        for (int f = 0; f < LOUD_SEG_FRAMES && l->nblocks < (seg + 1) * LOUD_SEG_BLOCKS;) {
+            if ((refill || left < LOUD_IN_BUF / 2) && !eof) {
+                memmove(in, ptr, left);
+                ptr = in;
+                size_t n = fread(in + left, 1, LOUD_IN_BUF - left, fp);
+                eof = n < (size_t)(LOUD_IN_BUF - left);
+                left += n;
+                refill = false;
+            }
+            int sync = MP3FindSyncWord(ptr, left);
+            if (sync < 0) {
+                if (eof) {
+                    break;
+                }
+                left = 0;
+                continue;
+            }
+            ptr += sync;
+            left -= sync;
+            int err = MP3Decode(h, &ptr, &left, out, 0);
+            if (err == ERR_MP3_INDATA_UNDERFLOW) {
+                if (eof) {
+                    break;
+                }
+                refill = true;  // 一帧比剩下的长
+                continue;
+            }
+            if (err == ERR_MP3_MAINDATA_UNDERFLOW) {
+                f++;    // 跳过了这一帧
+                continue;
+            }
+            if (err) {
+                ptr++;  // 假同步字 往后再找
+                left--;
+                continue;
+            }
+            if (++f <= LOUD_SKIP_FRAMES) {
+                continue;
+            }
+            MP3GetLastFrameInfo(h, &fi);
+            if (fi.nChans > 0) {
+                loud_feed(l, out, fi.outputSamps / fi.nChans, fi.nChans);
+            }
+        }
+        psram_bw_yield();
+    }
+    MP3FreeDecoder(h);
+}
+
+// 只认16位PCM 直接读样本
+static void loud_wav(FILE *fp, const music_meta_t *m, loud_t *l, int16_t *buf)
+{
+    uint8_t ck[8];
+    int ch = m->channels;
+    if (m->bits != 16 || ch < 1 || ch > 2) {
+        return;
+    }
+    fseek(fp, 12, SEEK_SET);
+    while (fread(ck, 1, 8, fp) == 8) {
+        uint32_t len = le32(ck + 4);
+        if (memcmp(ck, "data", 4) == 0) {
+            break;
+        }
+        if (fseek(fp, len + (len & 1), SEEK_CUR) != 0) {
+            return;
+        }
+    }
+    if (memcmp(ck, "data", 4) != 0) {
+        return;
+    }
+    uint32_t data = ftell(fp);
+    uint32_t frames = le32(ck + 4) / (2 * ch);
+    size_t chunk = LOUD_OUT_SAMPLES / ch;
+    for (int seg = 0; seg < LOUD_SEGMENTS; seg++) {
+        uint32_t at = (uint64_t)frames * (2 * seg + 1) / (2 * LOUD_SEGMENTS);
+        fseek(fp, data + at * 2 * ch, SEEK_SET);
+        loud_segment(l);
+        while (l->nblocks < (seg + 1) * LOUD_SEG_BLOCKS) {
+            size_t n = fread(buf, 2 * ch, chunk, fp);
+            if (n == 0) {
+                break;
+            }
+            loud_feed(l, buf, n, ch);
+        }
+        psram_bw_yield();
+    }
+}
+
+// 没有ReplayGain标签的曲目 抽段估计响度 FLAC没有在这里解码 按原样播放
+static void loud_scan(music_meta_t *m, uint8_t *in, int16_t *out)
+{
+    char path[MUSIC_INDEX_NAME_LEN + sizeof(MUSIC_INDEX_DIR) + 2];
+    snprintf(path, sizeof(path), "%s/%s", MUSIC_INDEX_DIR, m->name);
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return; // 卡拔了 下次再试
+    }
+    uint8_t hdr[10];
+    uint32_t start = 0;
+    if (fread(hdr, 1, 10, fp) == 10 && memcmp(hdr, "ID3", 3) == 0) {
+        start = syncsafe32(hdr + 6) + 10;
+    }
+    uint8_t magic[4] = {0};
+    fseek(fp, start, SEEK_SET);
+    fread(magic, 1, 4, fp);
+
+    loud_t l;
+    loud_init(&l, m->sample_rate ? m->sample_rate : 44100);
+    if (memcmp(magic, "RIFF", 4) == 0) {
+        loud_wav(fp, m, &l, out);
+    } else if (memcmp(magic, "fLaC", 4) != 0) {
+        loud_mp3(fp, start, m->size, &l, in, out);
+    }
+    fclose(fp);
+
+    float lufs;
+    m->gain_src = MUSIC_GAIN_UNITY;
+    if (loud_result(&l, &lufs)) {
+        m->gain_cdb = gain_to_cdb(MUSIC_INDEX_REF_LUFS - lufs, l.peak / 32768.0f);
+        m->gain_src = MUSIC_GAIN_SCAN;
+    }
+}
+#endif
+
+/******************************** 缓存文件 ********************************/
+static int load_cache(void)
+{
+    FILE *fp = fopen(MUSIC_INDEX_FILE, "rb");
+    if (fp == NULL) {
+        return 0;
+    }
+    music_index_header_t h;
+    int n = 0;
+    if (fread(&h, sizeof(h), 1, fp) == 1 && h.magic == MUSIC_INDEX_MAGIC &&
+        h.version == MUSIC_INDEX_VERSION && h.record_size == sizeof(music_meta_t)) {
+        n = h.count < MUSIC_INDEX_MAX ? h.count : MUSIC_INDEX_MAX;
+        n = fread(s_items, sizeof(music_meta_t), n, fp);
+    }
+    fclose(fp);
+    return n;
+}
+
+static void save_cache(const music_meta_t *items, int count)
+{
+    if (mkdir(MUSIC_INDEX_CACHE_DIR, 0775) != 0) {
+        struct stat st;
+        if (stat(MUSIC_INDEX_CACHE_DIR, &st) != 0) {
+            ESP_LOGW(TAG, "mkdir %s failed", MUSIC_INDEX_CACHE_DIR);
+            return;
+        }
+    }
+    FILE *fp = fopen(MUSIC_INDEX_FILE, "wb");
+    if (fp == NULL) {
+        ESP_LOGW(TAG, "unable to write %s", MUSIC_INDEX_FILE);
+        return;
+    }
+    music_index_header_t h = {
+        .magic = MUSIC_INDEX_MAGIC,
+        .version = MUSIC_INDEX_VERSION,
+        .count = count,
+        .record_size = sizeof(music_meta_t),
+    };
+    fwrite(&h, sizeof(h), 1, fp);
+    fwrite(items, sizeof(music_meta_t), count, fp);
+    fclose(fp);
+    sd_dir_cache_changed(MUSIC_INDEX_FILE);
+    if (unlink(MUSIC_INDEX_OLD_FILE) == 0) {
+        sd_dir_cache_changed(MUSIC_INDEX_OLD_FILE);
+    }
+}
+
+// s_items按文件名排好序 扫描时每个文件查一次 二分查找
+static int name_cmp(const void *a, const void *b)
+{
+    return strcmp(((const music_meta_t *)a)->name, ((const music_meta_t *)b)->name);
+}
+
+static int name_key_cmp(const void *key, const void *item)
+{
+    return strcmp(key, ((const music_meta_t *)item)->name);
+}
+
+static const music_meta_t *find_locked(const music_meta_t *items, int count, const char *name)
+{
+    return bsearch(name, items, count, sizeof(music_meta_t), name_key_cmp);
+}
+
+/******************************** 后台扫描 ********************************/
+#if CONFIG_APP_MUSIC_LOUDNESS_SCAN
+// 标题都出来以后再估计响度 s_items只有这个任务改 估计完一首就换进去 播放时马上能用
+static void loud_pass(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint8_t *in = heap_caps_malloc(LOUD_IN_BUF, MALLOC_CAP_SPIRAM);
+    int16_t *out = heap_caps_malloc(LOUD_OUT_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    int scanned = 0;
+    for (int i = 0; in && out && i < s_count; i++) {
+        music_meta_t m;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        m = s_items[i];
+        xSemaphoreGive(s_lock);
+        if (m.gain_src != MUSIC_GAIN_NONE) {
+            continue;
+        }
+        loud_scan(&m, in, out);
+        if (m.gain_src == MUSIC_GAIN_NONE) {
+            break;  // 打不开 卡多半拔了
+        }
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_items[i].gain_cdb = m.gain_cdb;
+        s_items[i].gain_src = m.gain_src;
+        xSemaphoreGive(s_lock);
+        scanned++;
+    }
+    heap_caps_free(in);
+    heap_caps_free(out);
+    if (scanned) {
+        save_cache(s_items, s_count);   // 只有这个任务写s_items 读不用锁 写卡时不挡着界面查
+        ESP_LOGI(TAG, "loudness of %d tracks estimated, %lld ms", scanned, (esp_timer_get_time() - t0) / 1000);
+    }
+}
+#endif
+
+static void music_index_task(void *arg)
+{
+    int64_t t0 = esp_timer_get_time();
+    music_meta_t *scan = heap_caps_calloc(MUSIC_INDEX_MAX, sizeof(music_meta_t), MALLOC_CAP_SPIRAM);
+    DIR *dir = opendir(MUSIC_INDEX_DIR);
+    int count = 0, parsed = 0;
+
+    if (scan && dir) {
+        struct dirent *de;
+        char path[MUSIC_INDEX_NAME_LEN + sizeof(MUSIC_INDEX_DIR) + 2];
+        while ((de = readdir(dir)) != NULL && count < MUSIC_INDEX_MAX) {
+            // 封面 歌词之类的文件不用stat也不用解析
+            if (de->d_type != DT_REG || media_type_name(de->d_name) != MEDIA_TYPE_AUDIO ||
+                strlen(de->d_name) >= MUSIC_INDEX_NAME_LEN) {
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s/%s", MUSIC_INDEX_DIR, de->d_name);
+            struct stat st;
+            if (stat(path, &st) != 0) {
+                continue;
+            }
+            music_meta_t *m = &scan[count];
+
+            // 文件大小和修改时间都没变 直接沿用缓存
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            const music_meta_t *old = find_locked(s_items, s_count, de->d_name);
+            if (old && old->size == (uint32_t)st.st_size && old->mtime == (uint32_t)st.st_mtime) {
+                *m = *old;
+            }
+            xSemaphoreGive(s_lock);
+
+            if (m->name[0] == 0) {
+                strlcpy(m->name, de->d_name, sizeof(m->name));
+                m->size = st.st_size;
+                m->mtime = st.st_mtime;
+                parse_file(path, m);
+                parsed++;
+                psram_bw_yield(); // 空闲时的后台工作 摄像头和音频吃紧时多让一会
+            }
+            count++;
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+
+    if (scan) {
+        qsort(scan, count, sizeof(music_meta_t), name_cmp);
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        memcpy(s_items, scan, count * sizeof(music_meta_t));
+        s_count = count;
+        xSemaphoreGive(s_lock);
+        if (parsed || count == 0) {
+            save_cache(scan, count);
+        }
+        heap_caps_free(scan);
+    }
+
+    ESP_LOGI(TAG, "%d tracks indexed, %d parsed, %lld ms", count, parsed, (esp_timer_get_time() - t0) / 1000);
+    s_ready = true;
+    if (s_done_cb) {
+        s_done_cb(count);
+    }
+#if CONFIG_APP_MUSIC_LOUDNESS_SCAN
+    loud_pass();
+#endif
+    vTaskDelete(NULL);
+}
+
+// 加载缓存并启动后台扫描
+esp_err_t music_index_start(music_index_done_cb_t done_cb)
+{
+    if (s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    s_items = heap_caps_calloc(MUSIC_INDEX_MAX, sizeof(music_meta_t), MALLOC_CAP_SPIRAM);
+    if (s_lock == NULL || s_items == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#if CONFIG_APP_CRASH_CTX
+    crash_ctx_watch_lock("music_index", s_lock);
+#endif
+    s_done_cb = done_cb;
+    s_count = load_cache();
+    qsort(s_items, s_count, sizeof(music_meta_t), name_cmp);    // 旧版本存的缓存没排序
+    ESP_LOGI(TAG, "%d tracks loaded from cache", s_count);
+
+    BaseType_t ok = task_plan_create(TASK_MUSIC_INDEX, music_index_task, NULL, NULL);
+    return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+bool music_index_lookup(const char *name, music_meta_t *meta)
+{
+    if (s_lock == NULL) {
+        return false;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    const music_meta_t *m = find_locked(s_items, s_count, name);
+    if (m) {
+        *meta = *m;
+    }
+    xSemaphoreGive(s_lock);
+    return m != NULL;
+}
+
+bool music_index_ready(void)
+{
+    return s_ready;
+}
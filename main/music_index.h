@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 音乐元数据索引 ****************************/
+// 后台任务扫描音乐目录 解析ID3v2/FLAC/WAV头得到标题和时长
+// 结果缓存在SD卡隐藏目录的二进制文件中 下次开机直接加载 不放在音乐目录里 免得曲目列表看到它
+// 响度归一化: 先读ReplayGain标签 没有标签的MP3/WAV在标题都出来以后再抽几段按BS.1770估计
+// 播放时增益和音量合成一个系数 在PCM增益级里乘 不多花每个采样的运算
+
+#define MUSIC_INDEX_DIR         "/sdcard/music"
+#define MUSIC_INDEX_CACHE_DIR   "/sdcard/.cache"
+#define MUSIC_INDEX_FILE        MUSIC_INDEX_CACHE_DIR "/music_index"
+#define MUSIC_INDEX_OLD_FILE    MUSIC_INDEX_DIR "/.music_index"     // 以前放在这 写新缓存时删掉
+#define MUSIC_INDEX_MAX         512     // 最多索引的曲目数
+#define MUSIC_INDEX_NAME_LEN    96
+#define MUSIC_INDEX_TITLE_LEN   64
+#define MUSIC_INDEX_ARTIST_LEN  32
+#define MUSIC_INDEX_REF_LUFS    -18     // 归一化到的响度 与ReplayGain 2.0的参考一致
+#define MUSIC_INDEX_GAIN_MIN    -2400   // 增益范围 0.01dB
+#define MUSIC_INDEX_GAIN_MAX    1200
+
+typedef enum {
+    MUSIC_GAIN_NONE,                        // 还没有 估计完之前按原样播放
+    MUSIC_GAIN_TAG,                         // ReplayGain标签
+    MUSIC_GAIN_SCAN,                        // 索引时抽段估计
+    MUSIC_GAIN_UNITY,                       // 没有标签也估计不了(FLAC 静音) 按原样播放
+} music_gain_src_t;
+
+typedef struct {
+    char name[MUSIC_INDEX_NAME_LEN];        // 文件名(不含路径)
+    uint32_t size;                          // 文件大小 与mtime一起判断缓存是否有效
+    uint32_t mtime;
+    uint32_t duration_ms;                   // 时长 0表示未知
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint16_t bits;
+    int16_t gain_cdb;                       // 响度归一化增益 0.01dB 放大的已经按峰值限住不会削波
+    uint8_t gain_src;                       // music_gain_src_t
+    uint8_t reserved;
+    char title[MUSIC_INDEX_TITLE_LEN];      // UTF-8标题 为空时显示文件名
+    char artist[MUSIC_INDEX_ARTIST_LEN];
+} music_meta_t;
+
+typedef void (*music_index_done_cb_t)(int count);
+
+esp_err_t music_index_start(music_index_done_cb_t done_cb);   // 加载缓存并启动后台扫描
+bool music_index_lookup(const char *name, music_meta_t *meta); // 按文件名查询 线程安全
+bool music_index_ready(void);                                  // 后台扫描是否已完成
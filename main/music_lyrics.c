@@ -0,0 +1,412 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "music_lyrics.h"
+#include "audio_player.h"
+#include "audio_pcm.h"
+#include "evt_bus.h"
+#include "fd_pool.h"
+#include "playlist.h"
+#include "task_plan.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if CONFIG_APP_MUSIC_LYRICS
+
+static const char *TAG = "music_lyrics";
+
+#define LYRICS_UNSENT   INT32_MIN       // 换了表还没发过
+
+typedef struct {
+    uint32_t t_ms;
+    uint16_t off;                       // 文字在text里的偏移
+} lyrics_entry_t;
+
+// 一块内存: 表头 按时间排好的时间标签 .lrc原文(就地切成一行一个字符串)
+typedef struct {
+    uint32_t gen;
+    int n;
+    lyrics_entry_t *e;
+    char *text;
+} lyrics_table_t;
+
+static TaskHandle_t s_task;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static char s_pending[PLAYLIST_PATH_LEN];       // 等着读的曲目 空串是清掉
+static bool s_pending_set;
+static bool s_refresh;
+static lyrics_table_t *s_table;                 // 只有任务改 改的时候拿锁 界面取文字也拿锁
+static uint32_t s_gen;
+static int s_line = MUSIC_LYRICS_OFF;           // 最后发出去的行
+static music_lyrics_stats_t s_stats;
+
+// [mm:ss] [mm:ss.xx] [mm:ss.xxx] 小数点写成冒号的也认 必须正好到']'
+static bool lyrics_time(const char *s, const char *close, uint32_t *ms)
+{
+    char *p;
+    if (!isdigit((unsigned char)*s))
+    {
+        return false;
+    }
+    unsigned long min = strtoul(s, &p, 10);
+    if (*p != ':' || !isdigit((unsigned char)p[1]))
+    {
+        return false;
+    }
+    unsigned long sec = strtoul(p + 1, &p, 10);
+    uint32_t frac = 0;
+    int digits = 0;
+    if (*p == '.' || *p == ':')
+    {
+        for (p++; isdigit((unsigned char)*p); p++)
+        {
+            if (digits < 3)
+            {
+                frac = frac * 10 + (*p - '0');
+                digits++;
+            }
+        }
+    }
+    if (p != close)
+    {
+        return false;
+    }
+    for (; digits < 3; digits++)
+    {
+        frac *= 10;
+    }
+    *ms = (uint32_t)((min * 60 + sec) * 1000 + frac);
+    return true;
+}
+
+// 就地解析 每行的换行改成'\0' 行首的时间标签都指向这一行去掉标签后的文字
+static int lyrics_parse(char *text, size_t len, lyrics_entry_t *e, int cap, int32_t *offset)
+{
+    char *p = text;
+    char *end = text + len;
+    int n = 0;
+    if (len >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+    {
+        p += 3;
+    }
+    while (p < end)
+    {
+        char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+        {
+            eol = end;  // text[len]是多分配的那个字节
+        }
+        *eol = '\0';
+        int first = n;
+        while (*p == '[')
+        {
+            char *close = strchr(p, ']');
+            if (close == NULL)
+            {
+                break;
+            }
+            uint32_t ms;
+            if (lyrics_time(p + 1, close, &ms))
+            {
+                if (n < cap)
+                {
+                    e[n++].t_ms = ms;
+                }
+            }
+            else if (strncmp(p + 1, "offset:", 7) == 0)
+            {
+                *offset = strtol(p + 8, NULL, 10);
+            }
+            p = close + 1;
+        }
+        while (*p == ' ' || *p == '\t')
+        {
+            p++;
+        }
+        char *q = eol;
+        while (q > p && isspace((unsigned char)q[-1]))
+        {
+            *--q = '\0';        // Windows换行的\r
+        }
+        for (int i = first; i < n; i++)
+        {
+            e[i].off = (uint16_t)(p - text);
+        }
+        p = eol + 1;
+    }
+    return n;
+}
+
+// 同一时间的按文件里的顺序
+static int lyrics_cmp(const void *a, const void *b)
+{
+    const lyrics_entry_t *x = a;
+    const lyrics_entry_t *y = b;
+    if (x->t_ms != y->t_ms)
+    {
+        return x->t_ms < y->t_ms ? -1 : 1;
+    }
+    return (int)x->off - (int)y->off;
+}
+
+// 曲目换成.lrc读进来解析 没有或者不能用返回NULL
+static lyrics_table_t *lyrics_read(const char *track)
+{
+    char path[PLAYLIST_PATH_LEN];
+    strlcpy(path, track, sizeof(path) - 4);
+    char *dot = strrchr(path, '.');
+    char *slash = strrchr(path, '/');
+    if (dot == NULL || (slash && dot < slash))
+    {
+        dot = path + strlen(path);
+    }
+    strcpy(dot, ".lrc");
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        s_stats.missing++;
+        return NULL;
+    }
+    if (st.st_size <= 0 || st.st_size > MUSIC_LYRICS_MAX_BYTES)
+    {
+        ESP_LOGW(TAG, "%s: %ld bytes, skipped", path, (long)st.st_size);
+        s_stats.errors++;
+        return NULL;
+    }
+    int64_t t0 = esp_timer_get_time();
+    size_t len = st.st_size;
+    // 时间标签最短"[m:ss]"6个字节 按这个定上限 不用先数一遍
+    int cap = len / 6 + 1;
+    if (cap > MUSIC_LYRICS_MAX_LINES)
+    {
+        cap = MUSIC_LYRICS_MAX_LINES;
+    }
+    lyrics_table_t *t = heap_caps_malloc(sizeof(*t) + cap * sizeof(lyrics_entry_t) + len + 1, MALLOC_CAP_SPIRAM);
+    if (t == NULL)
+    {
+        s_stats.errors++;
+        return NULL;
+    }
+    t->e = (lyrics_entry_t *)(t + 1);
+    t->text = (char *)(t->e + cap);
+    FILE *fp = fd_pool_fopen(path, "rb");
+    size_t got = fp ? fread(t->text, 1, len, fp) : 0;
+    if (fp)
+    {
+        fclose(fp);
+    }
+    if (got != len)
+    {
+        ESP_LOGW(TAG, "%s: read %u of %u bytes", path, (unsigned)got, (unsigned)len);
+        s_stats.errors++;
+        free(t);
+        return NULL;
+    }
+    t->text[len] = '\0';
+
+    int32_t offset = 0;
+    t->n = lyrics_parse(t->text, len, t->e, cap, &offset);
+    if (t->n == 0)
+    {
+        ESP_LOGW(TAG, "%s: no time tags", path);
+        s_stats.errors++;
+        free(t);
+        return NULL;
+    }
+    for (int i = 0; offset && i < t->n; i++)
+    {
+        int64_t ms = (int64_t)t->e[i].t_ms - offset;
+        t->e[i].t_ms = ms > 0 ? (uint32_t)ms : 0;
+    }
+    qsort(t->e, t->n, sizeof(t->e[0]), lyrics_cmp);
+    s_stats.loads++;
+    s_stats.parse_us = esp_timer_get_time() - t0;
+    ESP_LOGI(TAG, "%s: %d lines, offset %ld ms, %lu us", path, t->n, (long)offset, (unsigned long)s_stats.parse_us);
+    return t;
+}
+
+static void lyrics_swap(lyrics_table_t *t)
+{
+    portENTER_CRITICAL(&s_lock);
+    lyrics_table_t *old = s_table;
+    s_table = t;
+    if (t)
+    {
+        t->gen = ++s_gen;
+    }
+    s_stats.lines = t ? t->n : 0;
+    portEXIT_CRITICAL(&s_lock);
+    free(old);
+    s_line = LYRICS_UNSENT;
+}
+
+// 最后一个不晚于ms的 一个都没有是MUSIC_LYRICS_INTRO
+static int lyrics_find(const lyrics_table_t *t, uint32_t ms)
+{
+    int lo = 0;
+    int hi = t->n;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (t->e[mid].t_ms <= ms)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+// 喇叭里正在响的曲目位置: 解码到的减掉还在PCM缓冲和I2S里的 那段按播放速度折成曲目时间
+static uint32_t lyrics_heard_ms(const audio_player_position_t *pos)
+{
+    uint32_t lag = (uint64_t)audio_pcm_output_delay_us() * audio_pcm_get_speed() / (100 * 1000);
+    return pos->position_ms > lag ? pos->position_ms - lag : 0;
+}
+
+static void lyrics_tick(bool force)
+{
+    int line = MUSIC_LYRICS_OFF;
+    if (s_table)
+    {
+        line = s_line == LYRICS_UNSENT ? MUSIC_LYRICS_INTRO : s_line;
+        audio_player_position_t pos;
+        if (audio_player_get_state() != AUDIO_PLAYER_STATE_IDLE && audio_player_get_position(&pos) == ESP_OK)
+        {
+            line = lyrics_find(s_table, lyrics_heard_ms(&pos));
+            s_stats.lookups++;
+        }
+    }
+    if (line == s_line && !force)
+    {
+        return;
+    }
+    s_line = line;
+    s_stats.changes++;
+    evt_bus_publish(EVT_MUSIC_LYRIC, (uint32_t)line, s_table ? s_table->gen : 0);
+}
+
+// 换曲时读表 有表时每MUSIC_LYRICS_POLL_MS查一次 没表就一直睡
+static void music_lyrics_task(void *arg)
+{
+    char path[PLAYLIST_PATH_LEN];
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, s_table ? pdMS_TO_TICKS(MUSIC_LYRICS_POLL_MS) : portMAX_DELAY);
+        bool load = false;
+        portENTER_CRITICAL(&s_lock);
+        if (s_pending_set)
+        {
+            memcpy(path, s_pending, sizeof(path));
+            s_pending_set = false;
+            load = true;
+        }
+        bool refresh = s_refresh;
+        s_refresh = false;
+        portEXIT_CRITICAL(&s_lock);
+        if (load)
+        {
+            lyrics_swap(path[0] ? lyrics_read(path) : NULL);
+        }
+        lyrics_tick(refresh);
+    }
+}
+
+esp_err_t music_lyrics_start(void)
+{
+    if (s_task)
+    {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_MUSIC_LYRICS, music_lyrics_task, NULL, &s_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+    return ESP_OK;
+}
+
+void music_lyrics_load(const char *track)
+{
+    if (s_task == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    strlcpy(s_pending, track ? track : "", sizeof(s_pending));
+    s_pending_set = true;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+}
+
+void music_lyrics_refresh(void)
+{
+    if (s_task == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_refresh = true;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+}
+
+bool music_lyrics_line(uint32_t gen, int line, char *buf, size_t len)
+{
+    size_t n = 0;
+    bool ok = false;
+    bool cut = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_table && s_table->gen == gen && line >= MUSIC_LYRICS_INTRO && line < s_table->n)
+    {
+        // 锁里只拷这一行 不对整行strlen
+        const char *src = line < 0 ? "" : s_table->text + s_table->e[line].off;
+        while (n + 1 < len && src[n])
+        {
+            buf[n] = src[n];
+            n++;
+        }
+        cut = src[n] != '\0';
+        ok = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!ok)
+    {
+        return false;
+    }
+    if (cut)
+    {
+        // 截断处落在多字节字符中间 这个字符不要
+        size_t k = n;
+        while (k > 0 && ((uint8_t)buf[k - 1] & 0xC0) == 0x80)
+        {
+            k--;
+        }
+        if (k > 0)
+        {
+            uint8_t lead = buf[k - 1];
+            size_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+            if (n - (k - 1) < need)
+            {
+                n = k - 1;
+            }
+        }
+    }
+    buf[n] = '\0';
+    return true;
+}
+
+void music_lyrics_get_stats(music_lyrics_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
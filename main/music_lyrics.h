@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 同步歌词 ****************************/
+// 曲目旁边同名的.lrc(UTF-8) 换曲时在后台任务里读进来 一次解析成按时间排好的表 表头 时间和文字在一块内存里
+// 一行可以带几个[mm:ss.xx] [offset:ms]整体挪(正的提前) 其它标签跳过
+// 时间不用墙钟: 取播放器解码到的采样位置 减掉PCM管线里还没到codec的那段(按播放速度折成曲目时间) 跳转 变速以后也对得上
+// 播放和暂停时每MUSIC_LYRICS_POLL_MS二分查一次 换行了才发EVT_MUSIC_LYRIC 界面在LVGL任务里只改这一行
+// 事件a是行号 MUSIC_LYRICS_INTRO还没到第一行 MUSIC_LYRICS_OFF这首没有歌词 b是表的代数 按它取文字 表已经换了就取不到
+
+#define MUSIC_LYRICS_MAX_BYTES  (32 * 1024)     // 更大的文件不读 文字偏移用16位
+#define MUSIC_LYRICS_MAX_LINES  1024            // 时间标签数 多的丢掉
+#define MUSIC_LYRICS_LINE_LEN   128             // 取一行文字的缓冲 够40个汉字
+#define MUSIC_LYRICS_POLL_MS    100
+#define MUSIC_LYRICS_INTRO      (-1)
+#define MUSIC_LYRICS_OFF        (-2)
+
+typedef struct {
+    uint32_t loads;                     // 找到并解析了的
+    uint32_t missing;                   // 曲目旁边没有.lrc
+    uint32_t errors;                    // 太大 读不出来 或者一个时间标签都没有
+    uint32_t lines;                     // 现在这首的时间标签数
+    uint32_t parse_us;                  // 最近一次 读卡加解析加排序
+    uint32_t lookups;
+    uint32_t changes;                   // 换行发出去的事件
+} music_lyrics_stats_t;
+
+#if CONFIG_APP_MUSIC_LYRICS
+esp_err_t music_lyrics_start(void);
+void music_lyrics_load(const char *track);      // 换曲时调 NULL是没有歌词(电台) 只拷路径通知任务 解码任务里也能调
+void music_lyrics_refresh(void);                // 进音乐界面时调 当前行再发一次
+bool music_lyrics_line(uint32_t gen, int line, char *buf, size_t len);     // 取事件说的那一行 表换了返回false
+void music_lyrics_get_stats(music_lyrics_stats_t *stats);
+#endif
@@ -0,0 +1,226 @@
+#include <string.h>
+#include "music_order.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_random.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "music_order";
+
+#define ORDER_NVS_NAMESPACE     "music"
+#define ORDER_NVS_KEY           "order"
+
+static int s_count = 0;
+static int32_t *s_perm = NULL;      // 播放位置 -> 曲目序号
+static int32_t *s_pos = NULL;       // 曲目序号 -> 播放位置
+static music_order_mode_t s_mode = MUSIC_ORDER_REPEAT_ALL;
+static int s_cur = -1;              // 最近一次真正开始播放的曲目
+static int s_round_next = 0;        // 这一轮放完以后下一轮的第一首 洗牌时先选好 查下一首时不用改表
+static SemaphoreHandle_t s_lock;    // 预取任务 播放器回调和按键都会来查 上面几个都在锁里读写
+
+static void order_lock(void)
+{
+    if (s_lock)
+    {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+    }
+}
+
+static void order_unlock(void)
+{
+    if (s_lock)
+    {
+        xSemaphoreGive(s_lock);
+    }
+}
+
+// Fisher-Yates洗牌 first固定放在第一位 保证当前曲目不被打断也不会马上重复
+static void order_shuffle(int first)
+{
+    for (int i = 0; i < s_count; i++)
+    {
+        s_perm[i] = i;
+    }
+    if (first >= 0 && first < s_count)
+    {
+        s_perm[first] = 0;
+        s_perm[0] = first;
+    }
+    for (int i = s_count - 1; i > 1; i--)
+    {
+        int j = 1 + (int)(esp_random() % (uint32_t)i); // 在[1, i]中选
+        int32_t t = s_perm[i];
+        s_perm[i] = s_perm[j];
+        s_perm[j] = t;
+    }
+    for (int i = 0; i < s_count; i++)
+    {
+        s_pos[s_perm[i]] = i;
+    }
+    // 下一轮的第一首不和这一轮最后一首重复
+    int last = s_perm[s_count - 1];
+    s_round_next = 0;
+    if (s_count > 1)
+    {
+        s_round_next = (int)(esp_random() % (uint32_t)(s_count - 1));
+        s_round_next += s_round_next >= last;
+    }
+}
+
+static void order_save(music_order_mode_t mode)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(ORDER_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_set_u8(nvs, ORDER_NVS_KEY, (uint8_t)mode) == ESP_OK)
+    {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+static esp_err_t order_alloc(int count)
+{
+    if (s_perm && count == s_count)
+    {
+        return ESP_OK;
+    }
+    s_cur = -1;
+    heap_caps_free(s_perm);
+    heap_caps_free(s_pos);
+    s_perm = NULL;
+    s_pos = NULL;
+    s_count = 0;
+    if (count <= 0)
+    {
+        return ESP_OK;
+    }
+
+    s_perm = heap_caps_malloc(count * sizeof(int32_t), MALLOC_CAP_SPIRAM);
+    s_pos = heap_caps_malloc(count * sizeof(int32_t), MALLOC_CAP_SPIRAM);
+    if (s_perm == NULL || s_pos == NULL)
+    {
+        heap_caps_free(s_perm);
+        heap_caps_free(s_pos);
+        s_perm = NULL;
+        s_pos = NULL;
+        s_mode = MUSIC_ORDER_REPEAT_ALL;
+        ESP_LOGE(TAG, "no memory for %d tracks", count);
+        return ESP_ERR_NO_MEM;
+    }
+    s_count = count;
+
+    nvs_handle_t nvs;
+    uint8_t mode = MUSIC_ORDER_REPEAT_ALL;
+    if (nvs_open(ORDER_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK)
+    {
+        nvs_get_u8(nvs, ORDER_NVS_KEY, &mode);
+        nvs_close(nvs);
+    }
+    s_mode = mode < MUSIC_ORDER_MAX ? (music_order_mode_t)mode : MUSIC_ORDER_REPEAT_ALL;
+    order_shuffle(-1);
+    ESP_LOGI(TAG, "%d tracks, mode %d", count, s_mode);
+    return ESP_OK;
+}
+
+esp_err_t music_order_init(int count)
+{
+    if (s_lock == NULL)
+    {
+        s_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(s_lock, ESP_ERR_NO_MEM, TAG, "no memory for lock");
+    }
+    order_lock();
+    esp_err_t ret = order_alloc(count);
+    order_unlock();
+    return ret;
+}
+
+void music_order_set_mode(music_order_mode_t mode, int current)
+{
+    order_lock();
+    if (mode >= MUSIC_ORDER_MAX || mode == s_mode)
+    {
+        order_unlock();
+        return;
+    }
+    s_mode = mode;
+    if (mode == MUSIC_ORDER_SHUFFLE && s_count)
+    {
+        order_shuffle(current);
+    }
+    order_unlock();
+    order_save(mode);
+}
+
+music_order_mode_t music_order_get_mode(void)
+{
+    order_lock();
+    music_order_mode_t mode = s_mode;
+    order_unlock();
+    return mode;
+}
+
+int music_order_peek_next(int index, bool user)
+{
+    order_lock();
+    int next = 0;
+    if (s_count && index >= 0 && index < s_count)
+    {
+        if (s_mode == MUSIC_ORDER_REPEAT_ONE && !user)
+        {
+            next = index;
+        }
+        else if (s_mode == MUSIC_ORDER_SHUFFLE)
+        {
+            int pos = s_pos[index] + 1;
+            next = pos < s_count ? s_perm[pos] : s_round_next; // 一轮结束 下一轮真开始播时才洗牌
+        }
+        else
+        {
+            next = (index + 1) % s_count;
+        }
+    }
+    order_unlock();
+    return next;
+}
+
+void music_order_commit(int index)
+{
+    order_lock();
+    if (index >= 0 && index < s_count)
+    {
+        // 上一首是这一轮最后一首 接着放的是选好的下一轮第一首 这时才重新打乱
+        if (s_mode == MUSIC_ORDER_SHUFFLE && s_cur >= 0 && s_pos[s_cur] == s_count - 1 && index == s_round_next)
+        {
+            order_shuffle(index);
+        }
+        s_cur = index;
+    }
+    order_unlock();
+}
+
+int music_order_prev(int index)
+{
+    order_lock();
+    int prev = 0;
+    if (s_count && index >= 0 && index < s_count)
+    {
+        if (s_mode == MUSIC_ORDER_SHUFFLE)
+        {
+            int pos = s_pos[index];
+            prev = s_perm[pos == 0 ? s_count - 1 : pos - 1];
+        }
+        else
+        {
+            prev = (index + s_count - 1) % s_count;
+        }
+    }
+    order_unlock();
+    return prev;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 播放顺序 顺序/单曲循环/随机 ****************************/
+// 随机模式预先生成整张卡的排列(PSRAM) 上一首/下一首都是查表 O(1)
+// 模式保存在NVS 开机后保持上次的选择
+// 查下一首不改任何状态 预取没用上也不会往前走 真正开始播放时调music_order_commit 一轮放完在那里重新打乱
+// 各个接口都在一把锁里 预取任务 播放器回调和按键可以同时调
+
+typedef enum {
+    MUSIC_ORDER_REPEAT_ALL = 0,     // 列表循环 原来的默认行为
+    MUSIC_ORDER_REPEAT_ONE,         // 单曲循环 手动切歌仍按列表顺序
+    MUSIC_ORDER_SHUFFLE,            // 随机播放 一轮全部播完后重新打乱
+    MUSIC_ORDER_MAX,
+} music_order_mode_t;
+
+esp_err_t music_order_init(int count);                              // 按曲目数分配排列表 读出保存的模式
+void music_order_set_mode(music_order_mode_t mode, int current);    // 切换模式 随机模式从current开始
+music_order_mode_t music_order_get_mode(void);
+int music_order_peek_next(int index, bool user);    // index之后播放的曲目 user为false表示自动切歌 不改状态
+void music_order_commit(int index);                 // index真正开始播放了
+int music_order_prev(int index);                // index之前播放的曲目
@@ -0,0 +1,147 @@
+#include <string.h>
+#include "music_resume.h"
+#include "task_plan.h"
+#include "nvs.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "music_resume";
+
+#define RESUME_NVS_NAMESPACE    "music"
+#define RESUME_NVS_KEY          "resume"
+
+static TaskHandle_t s_task = NULL;
+static music_resume_provider_t s_provider = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static music_resume_t s_boot;       // 开机时读到的断点
+static bool s_boot_valid = false;
+static music_resume_t s_saved;      // NVS里当前保存的内容
+static music_resume_t s_pending;    // 等待写入的内容
+static bool s_pending_valid = false;
+
+static esp_err_t resume_load(music_resume_t *state)
+{
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(RESUME_NVS_NAMESPACE, NVS_READONLY, &nvs), TAG, "no saved position");
+    size_t len = sizeof(*state);
+    esp_err_t ret = nvs_get_blob(nvs, RESUME_NVS_KEY, state, &len);
+    nvs_close(nvs);
+    if (ret == ESP_OK && len != sizeof(*state))
+    {
+        ret = ESP_ERR_INVALID_SIZE; // 结构体变化后的旧数据
+    }
+    return ret;
+}
+
+static esp_err_t resume_save(const music_resume_t *state)
+{
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(RESUME_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs_open failed");
+    esp_err_t ret = nvs_set_blob(nvs, RESUME_NVS_KEY, state, sizeof(*state));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+// 判断是否值得写入 换曲立即写 同一首歌只有位置变化足够大才写
+static bool resume_changed(const music_resume_t *a, const music_resume_t *b, uint32_t min_delta_ms)
+{
+    if (a->index != b->index || strcmp(a->name, b->name) != 0)
+    {
+        return true;
+    }
+    uint32_t delta = a->position_ms > b->position_ms ? a->position_ms - b->position_ms : b->position_ms - a->position_ms;
+    return delta >= min_delta_ms;
+}
+
+static void music_resume_task(void *arg)
+{
+    while (1)
+    {
+        // 被通知说明是暂停/切歌 超时说明是定期保存
+        bool forced = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MUSIC_RESUME_PERIOD_S * 1000)) != 0;
+
+        music_resume_t state;
+        bool valid = false;
+        if (forced)
+        {
+            portENTER_CRITICAL(&s_lock);
+            state = s_pending;
+            valid = s_pending_valid;
+            s_pending_valid = false;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        else if (s_provider)
+        {
+            valid = s_provider(&state);
+        }
+
+        if (!valid || !resume_changed(&state, &s_saved, forced ? 1000 : MUSIC_RESUME_MIN_DELTA_MS))
+        {
+            continue;
+        }
+
+        esp_err_t ret = resume_save(&state);
+        if (ret == ESP_OK)
+        {
+            s_saved = state;
+            ESP_LOGI(TAG, "saved index %ld at %lu ms", (long)state.index, (unsigned long)state.position_ms);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "save failed: %s", esp_err_to_name(ret));
+        }
+    }
+}
+
+// 读出上次的断点并启动保存任务
+esp_err_t music_resume_start(music_resume_provider_t provider)
+{
+    if (s_task)
+    {
+        return ESP_OK;
+    }
+    s_provider = provider;
+
+    memset(&s_saved, 0, sizeof(s_saved));
+    s_saved.index = -1;
+    if (resume_load(&s_boot) == ESP_OK)
+    {
+        s_boot.name[MUSIC_RESUME_NAME_LEN - 1] = 0;
+        s_boot_valid = true;
+        s_saved = s_boot;
+        ESP_LOGI(TAG, "last position: index %ld '%s' %lu ms", (long)s_boot.index, s_boot.name, (unsigned long)s_boot.position_ms);
+    }
+
+    BaseType_t ok = task_plan_create(TASK_MUSIC_RESUME, music_resume_task, NULL, &s_task);
+    return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+bool music_resume_get(music_resume_t *state)
+{
+    if (s_boot_valid)
+    {
+        *state = s_boot;
+    }
+    return s_boot_valid;
+}
+
+// 暂停/切歌时调用 只复制状态并通知任务 不在调用者的任务里写flash
+void music_resume_checkpoint(const music_resume_t *state)
+{
+    if (s_task == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_pending = *state;
+    s_pending_valid = true;
+    portEXIT_CRITICAL(&s_lock);
+    xTaskNotifyGive(s_task);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 播放位置断点续播 ****************************/
+// 当前曲目序号和播放位置保存在NVS 开机后从断点继续
+// 写入合并在后台任务中完成：暂停/切歌立即写，播放中每隔一段时间写一次，内容没变不写
+
+#define MUSIC_RESUME_NAME_LEN       96
+#define MUSIC_RESUME_PERIOD_S       15      // 播放中定期保存的间隔
+#define MUSIC_RESUME_MIN_DELTA_MS   5000    // 同一首歌位置变化小于这个值不写 减少NVS磨损
+
+typedef struct {
+    int32_t index;                          // file_iterator中的序号
+    uint32_t position_ms;                   // 播放位置
+    char name[MUSIC_RESUME_NAME_LEN];       // 文件名 目录变化后用来校验/重新定位序号
+} music_resume_t;
+
+// 定期保存时获取当前播放状态 返回false表示当前没有可保存的播放
+typedef bool (*music_resume_provider_t)(music_resume_t *state);
+
+esp_err_t music_resume_start(music_resume_provider_t provider);    // 读出上次的断点并启动保存任务
+bool music_resume_get(music_resume_t *state);                       // 取得开机时读到的断点
+void music_resume_checkpoint(const music_resume_t *state);          // 暂停/切歌时调用 尽快写入
@@ -0,0 +1,843 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "net_pic.h"
+
+#if CONFIG_APP_NET_PIC
+#include "task_plan.h"
+#include "pic_jpeg.h"
+#include "ui_gif.h"
+#include "wifi_svc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "net_pic";
+
+#define PIC_TIMER_MS        40          // LVGL这边看一眼有没有新解出来的行
+#define PIC_OFFLINE_MS      1000
+#define PIC_FEED_MAX        16384       // 源文件最多读这么多字节
+
+typedef struct {
+    int index;                          // -1是空的
+    net_pic_state_t state;
+    lv_img_dsc_t img;                   // JPEG 下载中data就已经分配 解出来的行直接显示
+    uint8_t *gif;                       // GIF的整个文件
+    size_t gif_len;
+    uint32_t version;                   // 每出一批新行加一
+} pic_slot_t;
+
+typedef struct {
+    // 两边共用 s_lock保护
+    uint8_t refs;                       // 控件和下载任务各一份 最后放手的一方释放
+    volatile bool quit;
+    bool offline;
+    bool no_list;
+    int count;                          // 地址表读好以前是0
+    int cur;                            // 正在看的 只有LVGL任务改
+    pic_slot_t slots[NET_PIC_SLOTS];
+    TaskHandle_t task;
+    lv_coord_t w;
+    lv_coord_t h;
+    // 只在下载任务里用
+    char (*urls)[NET_PIC_URL_LEN];      // PSRAM
+    esp_http_client_handle_t client;
+    bool alive;                         // 上一个响应读完了 连接还能接着用
+    char origin[NET_PIC_URL_LEN];       // 连接连着的 scheme://host:port
+    uint8_t *chunk;
+    size_t chunk_len;
+    size_t chunk_pos;
+    pic_slot_t *job;
+    int64_t t0;
+    bool first;                         // 第一行已经出来
+    // 只在LVGL任务里用
+    lv_obj_t *obj;
+    lv_obj_t *img;
+    lv_obj_t *gif;
+    lv_obj_t *label;
+    lv_timer_t *timer;
+    lv_img_dsc_t dsc;
+    int shown_index;
+    int shown_count;
+    net_pic_state_t shown_state;
+    uint32_t shown_version;
+    const uint8_t *shown_gif;
+} net_pic_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static net_pic_stats_t s_stats;
+
+static void pic_stat_add(uint32_t *field)
+{
+    portENTER_CRITICAL(&s_lock);
+    (*field)++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void slot_free(pic_slot_t *slot)
+{
+    heap_caps_free((void *)slot->img.data);
+    heap_caps_free(slot->gif);
+    memset(slot, 0, sizeof(*slot));
+    slot->index = -1;
+}
+
+static void pic_put(net_pic_t *p)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool last = --p->refs == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!last)
+    {
+        return;
+    }
+    for (int i = 0; i < NET_PIC_SLOTS; i++)
+    {
+        slot_free(&p->slots[i]);
+    }
+    if (p->client)
+    {
+        esp_http_client_cleanup(p->client);
+    }
+    heap_caps_free(p->urls);
+    heap_caps_free(p->chunk);
+    free(p);
+}
+
+// 持有s_lock 从当前张往后AHEAD张是要留着的
+static bool pic_wanted_locked(net_pic_t *p, int index)
+{
+    if (p->count == 0)
+    {
+        return false;
+    }
+    int d = (index - p->cur + p->count) % p->count;
+    return d <= NET_PIC_AHEAD;
+}
+
+static pic_slot_t *pic_slot_locked(net_pic_t *p, int index)
+{
+    for (int i = 0; i < NET_PIC_SLOTS; i++)
+    {
+        if (p->slots[i].index == index)
+        {
+            return &p->slots[i];
+        }
+    }
+    return NULL;
+}
+
+/************ 下载任务 ************/
+static void url_origin(const char *url, char *origin, size_t len)
+{
+    const char *host = strstr(url, "://");
+    host = host ? host + 3 : url;
+    size_t n = strcspn(host, "/?#") + (host - url);
+    snprintf(origin, len, "%.*s", (int)n, url);
+}
+
+// 发请求读到响应头 同一个服务器的接着用上一次的连接 服务器已经关了的重连一次
+static bool pic_open(net_pic_t *p, const char *url)
+{
+    char origin[NET_PIC_URL_LEN];
+    url_origin(url, origin, sizeof(origin));
+    bool reuse = p->client && p->alive && strcmp(origin, p->origin) == 0;
+    if (p->client == NULL)
+    {
+        esp_http_client_config_t config = {
+            .url = url,
+            .timeout_ms = NET_PIC_TIMEOUT_MS,
+            .buffer_size = NET_PIC_CHUNK,
+            .crt_bundle_attach = esp_crt_bundle_attach,
+            .keep_alive_enable = true,
+        };
+        p->client = esp_http_client_init(&config);
+        if (p->client == NULL)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        if (!reuse)
+        {
+            esp_http_client_close(p->client);
+        }
+        esp_http_client_set_url(p->client, url);
+    }
+    p->alive = false;
+    strcpy(p->origin, origin);
+    for (int tries = reuse ? 2 : 1; tries > 0; tries--)
+    {
+        if (esp_http_client_open(p->client, 0) == ESP_OK && esp_http_client_fetch_headers(p->client) >= 0)
+        {
+            int status = esp_http_client_get_status_code(p->client);
+            if (status == 200)
+            {
+                if (reuse)
+                {
+                    pic_stat_add(&s_stats.reused);
+                }
+                return true;
+            }
+            ESP_LOGW(TAG, "%s: http status %d", url, status);
+            esp_http_client_close(p->client);
+            return false;
+        }
+        esp_http_client_close(p->client);
+        reuse = false;
+    }
+    ESP_LOGW(TAG, "%s: connect failed", url);
+    return false;
+}
+
+// 响应读完了连接留着给下一张 没读完的只能关掉
+static void pic_finish(net_pic_t *p, bool drained)
+{
+    if (drained && esp_http_client_is_complete_data_received(p->client))
+    {
+        p->alive = true;
+        return;
+    }
+    esp_http_client_close(p->client);
+}
+
+// 还要不要接着下 翻走了的不要 当前张还没开始下时让位给它
+static bool pic_keep(net_pic_t *p)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool keep = !p->quit && pic_wanted_locked(p, p->job->index) &&
+                (p->job->index == p->cur || pic_slot_locked(p, p->cur) != NULL);
+    portEXIT_CRITICAL(&s_lock);
+    return keep;
+}
+
+static bool pic_fill(net_pic_t *p)
+{
+    if (!pic_keep(p))
+    {
+        return false;
+    }
+    int n = esp_http_client_read(p->client, (char *)p->chunk, NET_PIC_CHUNK);
+    if (n <= 0)
+    {
+        return false;
+    }
+    p->chunk_len = n;
+    p->chunk_pos = 0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += n;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+// tjpgd的读回调 一次要几百字节 从4KB的块里给
+static size_t pic_read(void *arg, uint8_t *buf, size_t n)
+{
+    net_pic_t *p = arg;
+    size_t done = 0;
+    while (done < n)
+    {
+        if (p->chunk_pos == p->chunk_len && !pic_fill(p))
+        {
+            break;
+        }
+        size_t k = LV_MIN(n - done, p->chunk_len - p->chunk_pos);
+        if (buf)
+        {
+            memcpy(buf + done, p->chunk + p->chunk_pos, k);
+        }
+        p->chunk_pos += k;
+        done += k;
+    }
+    return done;
+}
+
+static void pic_progress(void *arg, const lv_img_dsc_t *img, int rows)
+{
+    net_pic_t *p = arg;
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - p->t0) / 1000);
+    portENTER_CRITICAL(&s_lock);
+    p->job->img = *img;
+    p->job->version++;
+    if (rows > 0 && !p->first)
+    {
+        p->first = true;
+        s_stats.first_ms_total += ms;
+        if (ms > s_stats.first_ms_max)
+        {
+            s_stats.first_ms_max = ms;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 渐进式JPEG tjpgd不认 从文件头的段里找SOF2 EXIF太大第一块里没走到帧头的当基线的解
+static bool pic_is_progressive(const uint8_t *data, size_t len)
+{
+    size_t i = 2;
+    while (i + 4 <= len && data[i] == 0xFF)
+    {
+        uint8_t marker = data[i + 1];
+        if (marker == 0xC2)
+        {
+            return true;
+        }
+        if (marker == 0xC0 || marker == 0xC1 || marker == 0xDA)
+        {
+            return false;
+        }
+        i += 2 + (data[i + 2] << 8 | data[i + 3]);
+    }
+    return false;
+}
+
+static net_pic_state_t pic_fetch_gif(net_pic_t *p, const char *url, uint8_t **out, size_t *out_len)
+{
+    int64_t total = esp_http_client_get_content_length(p->client);
+    if (total > NET_PIC_GIF_MAX)
+    {
+        ESP_LOGW(TAG, "%s: %lld bytes, too big", url, (long long)total);
+        return NET_PIC_FAILED;
+    }
+    size_t cap = total > 0 ? total : NET_PIC_CHUNK * 16;
+    uint8_t *gif = heap_caps_malloc(cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    size_t len = 0;
+    while (gif)
+    {
+        size_t k = p->chunk_len - p->chunk_pos;
+        if (len + k > cap)
+        {
+            cap = LV_MIN(LV_MAX(cap * 2, len + k), NET_PIC_GIF_MAX);
+            uint8_t *grown = len + k <= cap ? heap_caps_realloc(gif, cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+            if (grown == NULL)
+            {
+                ESP_LOGW(TAG, "%s: too big", url);
+                break;
+            }
+            gif = grown;
+        }
+        memcpy(gif + len, p->chunk + p->chunk_pos, k);
+        len += k;
+        p->chunk_pos = p->chunk_len;
+        if (!pic_fill(p))
+        {
+            if (esp_http_client_is_complete_data_received(p->client))
+            {
+                *out = gif;
+                *out_len = len;
+                return NET_PIC_READY;
+            }
+            break;
+        }
+    }
+    heap_caps_free(gif);
+    return NET_PIC_FAILED;
+}
+
+// 下载解码一张 第一块先拿来认格式
+static void pic_fetch(net_pic_t *p, pic_slot_t *slot)
+{
+    const char *url = p->urls[slot->index];
+    p->job = slot;
+    p->t0 = esp_timer_get_time();
+    p->first = false;
+    p->chunk_len = 0;
+    p->chunk_pos = 0;
+    net_pic_state_t state = NET_PIC_FAILED;
+    bool drained = false;
+    bool unsupported = false;
+    lv_img_dsc_t img = {0};
+    uint8_t *gif = NULL;
+    size_t gif_len = 0;
+    portENTER_CRITICAL(&s_lock);
+    uint64_t bytes0 = s_stats.bytes;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (pic_open(p, url) && pic_fill(p))
+    {
+        const uint8_t *head = p->chunk;
+        if (p->chunk_len > 6 && memcmp(head, "GIF8", 4) == 0)
+        {
+            state = pic_fetch_gif(p, url, &gif, &gif_len);
+            drained = state == NET_PIC_READY;
+        }
+        else if (p->chunk_len > 2 && head[0] == 0xFF && head[1] == 0xD8)
+        {
+            bool progressive = pic_is_progressive(head, p->chunk_len);
+            if (!progressive && pic_jpeg_decode_stream(pic_read, pic_progress, p, p->w, p->h,
+                                                       (uint32_t)p->w * p->h * sizeof(lv_color_t), &img, NULL))
+            {
+                state = NET_PIC_READY;
+                // tjpgd读到EOI就停了 后面剩的读掉 连接才能接着用
+                drained = esp_http_client_flush_response(p->client, NULL) == ESP_OK;
+            }
+            unsupported = progressive;
+        }
+        else
+        {
+            unsupported = true;
+        }
+    }
+    if (p->client)
+    {
+        pic_finish(p, drained);
+    }
+
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - p->t0) / 1000);
+    const void *drop = NULL;
+    portENTER_CRITICAL(&s_lock);
+    bool cancelled = state != NET_PIC_READY && (p->quit || !pic_wanted_locked(p, slot->index) ||
+                     (slot->index != p->cur && pic_slot_locked(p, p->cur) == NULL));
+    if (state == NET_PIC_READY)
+    {
+        uint64_t bytes = s_stats.bytes - bytes0;
+        s_stats.loaded++;
+        s_stats.load_ms_total += ms;
+        s_stats.load_ms_max = LV_MAX(s_stats.load_ms_max, ms);
+        s_stats.kbps = ms ? (uint32_t)(bytes * 8 / ms) : 0;
+        slot->img = img;
+        slot->gif = gif;
+        slot->gif_len = gif_len;
+    }
+    else if (cancelled)
+    {
+        s_stats.cancelled++;
+    }
+    else if (unsupported)
+    {
+        s_stats.unsupported++;
+    }
+    else
+    {
+        s_stats.failed++;
+    }
+    // 作废的腾出来 下一轮再排 不是当前张 LVGL已经不显示它了
+    // 下到一半失败的留着已经解出来的那部分 槽被别的图占掉时再释放
+    if (cancelled)
+    {
+        drop = slot->img.data;
+        memset(slot, 0, sizeof(*slot));
+        slot->index = -1;
+    }
+    else
+    {
+        slot->state = state;
+        slot->version++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    heap_caps_free((void *)drop);
+    if (state != NET_PIC_READY && unsupported)
+    {
+        ESP_LOGW(TAG, "%s: format not supported", url);
+    }
+}
+
+// 当前张开始往后 找第一张还没排的 占一个不再要的槽
+static pic_slot_t *pic_next_job(net_pic_t *p)
+{
+    pic_slot_t *job = NULL;
+    pic_slot_t old = {0};
+    portENTER_CRITICAL(&s_lock);
+    for (int d = 0; d <= NET_PIC_AHEAD && d < p->count && job == NULL; d++)
+    {
+        int index = (p->cur + d) % p->count;
+        if (pic_slot_locked(p, index))
+        {
+            continue;
+        }
+        for (int i = 0; i < NET_PIC_SLOTS; i++)
+        {
+            pic_slot_t *slot = &p->slots[i];
+            if (slot->index < 0 || !pic_wanted_locked(p, slot->index))
+            {
+                old = *slot;
+                memset(slot, 0, sizeof(*slot));
+                slot->index = index;
+                slot->state = NET_PIC_LOADING;
+                job = slot;
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    // 不在当前张后面的 LVGL不会再显示它 锁外释放
+    heap_caps_free((void *)old.img.data);
+    heap_caps_free(old.gif);
+    return job;
+}
+
+static int pic_list_add(net_pic_t *p, int count, char *text, bool feeds);
+
+// 源 下载下来每行一个URL 不再往下展开
+static int pic_feed_add(net_pic_t *p, int count, const char *url)
+{
+    char *text = heap_caps_malloc(PIC_FEED_MAX + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (text == NULL || !pic_open(p, url))
+    {
+        heap_caps_free(text);
+        return count;
+    }
+    int len = 0;
+    int n;
+    while (len < PIC_FEED_MAX && (n = esp_http_client_read(p->client, text + len, PIC_FEED_MAX - len)) > 0)
+    {
+        len += n;
+    }
+    text[len] = '\0';
+    pic_finish(p, len < PIC_FEED_MAX);
+    count = pic_list_add(p, count, text, false);
+    heap_caps_free(text);
+    return count;
+}
+
+static int pic_list_add(net_pic_t *p, int count, char *text, bool feeds)
+{
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\r\n", &save); line && count < NET_PIC_MAX_URLS && !p->quit;
+         line = strtok_r(NULL, "\r\n", &save))
+    {
+        line += strspn(line, " \t");
+        size_t len = strcspn(line, " \t");
+        line[len] = '\0';
+        if (len == 0 || line[0] == '#' || len >= NET_PIC_URL_LEN || strncmp(line, "http", 4) != 0)
+        {
+            continue;
+        }
+        if (feeds && len > 4 && strcasecmp(line + len - 4, ".txt") == 0)
+        {
+            count = pic_feed_add(p, count, line);
+            continue;
+        }
+        strcpy(p->urls[count++], line);
+    }
+    return count;
+}
+
+// 地址表 源要联网 所以也在任务里读
+static int pic_list_load(net_pic_t *p)
+{
+    FILE *f = fopen(CONFIG_APP_NET_PIC_LIST, "r");
+    if (f == NULL)
+    {
+        ESP_LOGW(TAG, "%s: no URL list", CONFIG_APP_NET_PIC_LIST);
+        return 0;
+    }
+    char *text = heap_caps_malloc(PIC_FEED_MAX + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    size_t len = text ? fread(text, 1, PIC_FEED_MAX, f) : 0;
+    fclose(f);
+    if (text == NULL)
+    {
+        return 0;
+    }
+    text[len] = '\0';
+    int count = pic_list_add(p, 0, text, true);
+    heap_caps_free(text);
+    ESP_LOGI(TAG, "%d URLs", count);
+    return count;
+}
+
+static void pic_set_offline(net_pic_t *p, bool offline)
+{
+    portENTER_CRITICAL(&s_lock);
+    p->offline = offline;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void net_pic_task(void *arg)
+{
+    net_pic_t *p = arg;
+    int count = 0;
+    while (!p->quit)
+    {
+        if (!wifi_svc_connected())
+        {
+            pic_set_offline(p, true);
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PIC_OFFLINE_MS));
+            continue;
+        }
+        pic_set_offline(p, false);
+        if (count == 0)
+        {
+            count = pic_list_load(p);
+            portENTER_CRITICAL(&s_lock);
+            p->count = count;
+            p->no_list = count == 0;
+            if (count)
+            {
+                p->cur %= count;
+            }
+            portEXIT_CRITICAL(&s_lock);
+            if (count == 0)
+            {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);    // 翻页时再读一次 可能刚把地址表放上去
+                continue;
+            }
+        }
+        pic_slot_t *job = pic_next_job(p);
+        if (job == NULL)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        pic_fetch(p, job);
+    }
+    pic_put(p);
+    vTaskDelete(NULL);
+}
+
+/************ LVGL任务 ************/
+static void pic_label_set(net_pic_t *p, const char *text)
+{
+    if (text)
+    {
+        lv_label_set_text_static(p->label, text);
+        lv_obj_clear_flag(p->label, LV_OBJ_FLAG_HIDDEN);
+    }
+    else
+    {
+        lv_obj_add_flag(p->label, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+// 槽里有变化就换图或者重画 GIF交给ui_gif 别的时候把它删掉
+static void pic_timer_cb(lv_timer_t *t)
+{
+    net_pic_t *p = t->user_data;
+    portENTER_CRITICAL(&s_lock);
+    int count = p->count;
+    pic_slot_t *slot = pic_slot_locked(p, p->cur);
+    pic_slot_t snap = slot ? *slot : (pic_slot_t){.index = -1, .state = NET_PIC_LOADING};
+    net_pic_state_t state = p->no_list ? NET_PIC_NO_LIST : p->offline && slot == NULL ? NET_PIC_OFFLINE : snap.state;
+    portEXIT_CRITICAL(&s_lock);
+
+    bool moved = p->cur != p->shown_index;
+    bool changed = moved || count != p->shown_count || state != p->shown_state;
+    if (!changed && snap.version == p->shown_version)
+    {
+        return;
+    }
+    // cur只在这个任务里改 当前张的槽下载任务不会释放 锁外用data是安全的
+    if (snap.gif && (snap.gif != p->shown_gif || moved))
+    {
+        lv_img_set_src(p->img, NULL);
+        if (p->gif == NULL)
+        {
+            p->gif = ui_gif_create(p->obj);
+            lv_obj_center(p->gif);
+        }
+        if (!ui_gif_set_src_data(p->gif, snap.gif, snap.gif_len, "net gif"))
+        {
+            lv_obj_del(p->gif);
+            p->gif = NULL;
+        }
+    }
+    else if (snap.gif == NULL)
+    {
+        if (p->gif)
+        {
+            lv_obj_del(p->gif);
+            p->gif = NULL;
+        }
+        if (snap.img.data != p->dsc.data || moved)
+        {
+            lv_img_cache_invalidate_src(&p->dsc);
+            p->dsc = snap.img;
+            lv_img_set_src(p->img, p->dsc.data ? &p->dsc : NULL);
+        }
+        else if (snap.img.data)
+        {
+            lv_obj_invalidate(p->img);
+        }
+    }
+    p->shown_gif = snap.gif;
+    p->shown_version = snap.version;
+    if (snap.gif && p->gif == NULL)
+    {
+        state = NET_PIC_FAILED;         // ui_gif不认
+    }
+    switch (state)
+    {
+    case NET_PIC_LOADING:
+        pic_label_set(p, snap.img.data ? NULL : "加载中...");
+        break;
+    case NET_PIC_FAILED:
+        pic_label_set(p, "加载失败");
+        break;
+    case NET_PIC_NO_LIST:
+        pic_label_set(p, "没有图片地址");
+        break;
+    case NET_PIC_OFFLINE:
+        pic_label_set(p, "等待WiFi连接");
+        break;
+    default:
+        pic_label_set(p, NULL);
+        break;
+    }
+    if (changed)
+    {
+        p->shown_count = count;
+        p->shown_index = p->cur;
+        p->shown_state = state;
+        lv_event_send(p->obj, LV_EVENT_VALUE_CHANGED, NULL);
+    }
+}
+
+static void pic_event_cb(lv_event_t *e)
+{
+    net_pic_t *p = lv_event_get_user_data(e);
+    if (lv_event_get_code(e) != LV_EVENT_DELETE)
+    {
+        return;
+    }
+    lv_timer_del(p->timer);
+    lv_img_cache_invalidate_src(&p->dsc);
+    p->obj = NULL;
+    portENTER_CRITICAL(&s_lock);
+    p->quit = true;
+    portEXIT_CRITICAL(&s_lock);
+    if (p->task)
+    {
+        xTaskNotifyGive(p->task);
+    }
+    pic_put(p);
+}
+
+lv_obj_t *net_pic_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h)
+{
+    lv_obj_t *obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(obj);
+    lv_obj_set_size(obj, w, h);
+    lv_obj_set_style_bg_color(obj, lv_color_black(), 0);
+    lv_obj_set_style_bg_opa(obj, LV_OPA_COVER, 0);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_t *label = lv_label_create(obj);
+    lv_obj_set_style_text_color(label, lv_color_white(), 0);
+    lv_obj_center(label);
+
+    net_pic_t *p = calloc(1, sizeof(*p));
+    if (p)
+    {
+        p->urls = heap_caps_malloc(NET_PIC_MAX_URLS * NET_PIC_URL_LEN, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        p->chunk = heap_caps_malloc(NET_PIC_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (p == NULL || p->urls == NULL || p->chunk == NULL)
+    {
+        ESP_LOGE(TAG, "no memory");
+        lv_label_set_text_static(label, "内存不足");
+        if (p)
+        {
+            p->refs = 1;
+            pic_put(p);
+        }
+        return obj;
+    }
+    for (int i = 0; i < NET_PIC_SLOTS; i++)
+    {
+        p->slots[i].index = -1;
+    }
+    p->obj = obj;
+    p->label = label;
+    p->img = lv_img_create(obj);
+    lv_obj_center(p->img);
+    lv_obj_move_background(p->img);
+    p->w = w;
+    p->h = h;
+    p->shown_index = -1;
+    p->shown_state = NET_PIC_READY;
+    p->refs = 2;
+    if (task_plan_create(TASK_NET_PIC, net_pic_task, p, &p->task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "task start failed");
+        lv_label_set_text_static(label, "启动失败");
+        p->refs = 1;
+        pic_put(p);
+        return obj;
+    }
+    lv_obj_set_user_data(obj, p);
+    p->timer = lv_timer_create(pic_timer_cb, PIC_TIMER_MS, p);
+    lv_obj_add_event_cb(obj, pic_event_cb, LV_EVENT_DELETE, p);
+    pic_timer_cb(p->timer);
+    return obj;
+}
+
+void net_pic_show(lv_obj_t *obj, int index)
+{
+    net_pic_t *p = lv_obj_get_user_data(obj);
+    if (p == NULL)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (p->count)
+    {
+        p->cur = (index % p->count + p->count) % p->count;
+        pic_slot_t *slot = pic_slot_locked(p, p->cur);
+        if (slot && slot->state == NET_PIC_READY)
+        {
+            s_stats.hits++;
+        }
+        else
+        {
+            s_stats.waits++;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    // 槽没变的不会叫醒 在下的那张读下一块时自己看
+    xTaskNotifyGive(p->task);
+    pic_timer_cb(p->timer);
+}
+
+int net_pic_get_index(lv_obj_t *obj)
+{
+    net_pic_t *p = lv_obj_get_user_data(obj);
+    return p ? p->cur : 0;
+}
+
+int net_pic_count(lv_obj_t *obj)
+{
+    net_pic_t *p = lv_obj_get_user_data(obj);
+    if (p == NULL)
+    {
+        return 0;
+    }
+    portENTER_CRITICAL(&s_lock);
+    int count = p->count;
+    portEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+net_pic_state_t net_pic_state(lv_obj_t *obj, int index)
+{
+    net_pic_t *p = lv_obj_get_user_data(obj);
+    if (p == NULL)
+    {
+        return NET_PIC_FAILED;
+    }
+    portENTER_CRITICAL(&s_lock);
+    net_pic_state_t state = NET_PIC_LOADING;
+    if (p->no_list)
+    {
+        state = NET_PIC_NO_LIST;
+    }
+    else if (p->count)
+    {
+        pic_slot_t *slot = pic_slot_locked(p, (index % p->count + p->count) % p->count);
+        state = slot ? slot->state : p->offline ? NET_PIC_OFFLINE : NET_PIC_LOADING;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return state;
+}
+
+void net_pic_get_stats(net_pic_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+
+/*********************** 网络图片 ****************************/
+// 图库的网络相框 图片从HTTP来 地址表是CONFIG_APP_NET_PIC_LIST 一行一个图片URL
+// 以.txt结尾的那行是一个源 打开时下载下来 里面每行又是一个图片URL 相框服务给的列表直接用
+// 控件里一个lv_img 一个core 0上的任务按顺序做: 正在看的这张 后面CONFIG_APP_NET_PIC_AHEAD张
+// JPEG边下边解 tjpgd的读回调直接从HTTP连接里读 解完一行MCU就让LVGL刷出来 不等整张下完
+// 解好的RGB565留在PSRAM的槽里 翻到下一张时已经是好的 直接换指针 和本地SD卡一样快
+// 同一个服务器的图复用一个HTTP连接 不用每张都重新握手
+// GIF要整个文件 下进PSRAM再交给ui_gif 渐进式JPEG和别的格式tjpgd解不了 跳过记在unsupported里
+// 往回翻或者跳着翻到槽里没有的 正在做的作废 马上做这一张
+// 张数 当前张 下载状态变了发LV_EVENT_VALUE_CHANGED
+
+#define NET_PIC_AHEAD           CONFIG_APP_NET_PIC_AHEAD
+#define NET_PIC_SLOTS           (NET_PIC_AHEAD + 1)
+#define NET_PIC_MAX_URLS        256
+#define NET_PIC_URL_LEN         256
+#define NET_PIC_CHUNK           4096    // 一次从连接读的
+#define NET_PIC_GIF_MAX         (CONFIG_APP_NET_PIC_GIF_KB * 1024)
+#define NET_PIC_TIMEOUT_MS      8000
+
+typedef enum {
+    NET_PIC_LOADING,                    // 还在下 JPEG的话已经出来的行在显示
+    NET_PIC_READY,
+    NET_PIC_FAILED,
+    NET_PIC_NO_LIST,                    // 地址表没有或者一个URL都没有
+    NET_PIC_OFFLINE,                    // 等WiFi
+} net_pic_state_t;
+
+typedef struct {
+    uint32_t loaded;                    // 下完解好的
+    uint32_t failed;                    // 连不上 HTTP错误 解码出错
+    uint32_t unsupported;               // 渐进式JPEG和别的格式
+    uint32_t cancelled;                 // 翻走了没做完就作废的
+    uint32_t reused;                    // 接着用上一张的连接
+    uint32_t hits;                      // 翻到时已经解好的
+    uint32_t waits;                     // 翻到时还没好
+    uint64_t bytes;
+    uint32_t first_ms_max;              // 开始请求到第一行出来
+    uint64_t first_ms_total;            // 除以loaded
+    uint32_t load_ms_max;               // 开始请求到整张解好
+    uint64_t load_ms_total;
+    uint32_t kbps;                      // 最近一张的下载速度
+} net_pic_stats_t;
+
+#if CONFIG_APP_NET_PIC
+// w x h的相框 图缩到这里面居中 持有LVGL锁时调用 删掉对象就停 同时只有一个
+lv_obj_t *net_pic_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h);
+void net_pic_show(lv_obj_t *obj, int index);   // 超出范围的绕回来
+int net_pic_get_index(lv_obj_t *obj);
+int net_pic_count(lv_obj_t *obj);       // 源还在下载时是0
+net_pic_state_t net_pic_state(lv_obj_t *obj, int index);
+void net_pic_get_stats(net_pic_stats_t *stats);
+#endif
@@ -0,0 +1,502 @@
+#define _GNU_SOURCE // fopencookie
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "net_radio.h"
+#include "task_plan.h"
+#include "esp_http_client.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "net_radio";
+
+#define RADIO_CHUNK         4096    // 每次从socket读的字节数
+#define RADIO_URL_LEN       256
+#define RADIO_WAIT_MS       100     // 读写两端等待对方的单次超时 期间检查关闭标志
+#define RADIO_RATE_WINDOW_US (5 * 1000 * 1000)
+
+typedef struct {
+    char url[RADIO_URL_LEN];
+    uint8_t *buf;
+    // 绝对字节位置 缓冲中保留的是[wr - size, wr)
+    uint64_t wr;
+    uint64_t rd;
+    bool eof;                       // 接收任务已结束 不会再有新数据
+    volatile bool closing;
+    bool synced;                    // 已找到第一个MP3帧头
+    SemaphoreHandle_t data_sem;     // 写入了新数据
+    SemaphoreHandle_t space_sem;    // 读走了数据
+    SemaphoreHandle_t done_sem;     // 接收任务退出
+    // ICY元数据 每metaint字节音频后跟一个长度字节和元数据
+    int metaint;
+    int audio_left;
+    int meta_left;
+    int meta_len;
+    char meta[256];
+    // 码率统计
+    bool br_from_header;
+    int64_t rate_start_us;
+    uint32_t rate_bytes;
+    net_radio_stats_t stats;
+} radio_t;
+
+static radio_t *s_radio = NULL;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/******************************** 缓冲 ********************************/
+static size_t radio_fill(const radio_t *r)
+{
+    return (size_t)(r->wr - r->rd);
+}
+
+// 接收任务写入 缓冲满时等待 解码器回退需要的历史数据不被覆盖
+static bool radio_push(radio_t *r, const uint8_t *data, size_t len)
+{
+    while (len && !r->closing)
+    {
+        portENTER_CRITICAL(&s_lock);
+        size_t used = radio_fill(r) + NET_RADIO_HISTORY;
+        size_t space = used < NET_RADIO_BUF_SIZE ? NET_RADIO_BUF_SIZE - used : 0;
+        portEXIT_CRITICAL(&s_lock);
+        if (space == 0)
+        {
+            xSemaphoreTake(r->space_sem, pdMS_TO_TICKS(RADIO_WAIT_MS));
+            continue;
+        }
+        size_t n = len < space ? len : space;
+        size_t off = r->wr % NET_RADIO_BUF_SIZE;
+        size_t first = NET_RADIO_BUF_SIZE - off < n ? NET_RADIO_BUF_SIZE - off : n;
+        memcpy(r->buf + off, data, first);
+        memcpy(r->buf, data + first, n - first);
+        portENTER_CRITICAL(&s_lock);
+        r->wr += n;
+        r->stats.fill = radio_fill(r);
+        portEXIT_CRITICAL(&s_lock);
+        xSemaphoreGive(r->data_sem);
+        data += n;
+        len -= n;
+    }
+    return len == 0;
+}
+
+// 电台不一定从帧边界开始发送 丢掉第一个MP3帧头之前的数据 否则格式探测会失败
+static size_t radio_sync(radio_t *r, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i + 3 < len; i++)
+    {
+        if (data[i] == 0xFF && (data[i + 1] & 0xE6) == 0xE2 && (data[i + 2] >> 4) != 0x0F &&
+            (data[i + 2] & 0x0C) != 0x0C)
+        {
+            r->synced = true;
+            return i;
+        }
+        if (data[i] == 'I' && data[i + 1] == 'D' && data[i + 2] == '3')
+        {
+            r->synced = true;
+            return i;
+        }
+    }
+    return len;
+}
+
+// 解析 StreamTitle='...';
+static void radio_parse_meta(radio_t *r)
+{
+    r->meta[r->meta_len] = 0;
+    const char *p = strstr(r->meta, "StreamTitle='");
+    if (p == NULL)
+    {
+        return;
+    }
+    p += strlen("StreamTitle='");
+    const char *e = strstr(p, "';");
+    size_t n = e ? (size_t)(e - p) : strlen(p);
+    portENTER_CRITICAL(&s_lock);
+    n = n < NET_RADIO_TITLE_LEN - 1 ? n : NET_RADIO_TITLE_LEN - 1;
+    memcpy(r->stats.title, p, n);
+    r->stats.title[n] = 0;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "now playing: %s", r->stats.title);
+}
+
+// 去掉ICY元数据 剩下的音频写入缓冲
+static bool radio_feed(radio_t *r, uint8_t *data, size_t len)
+{
+    while (len)
+    {
+        if (r->metaint && r->audio_left == 0)
+        {
+            if (r->meta_left < 0)
+            {
+                r->meta_left = data[0] * 16; // 长度字节
+                r->meta_len = 0;
+                data++;
+                len--;
+            }
+            else
+            {
+                size_t n = len < (size_t)r->meta_left ? len : (size_t)r->meta_left;
+                size_t room = sizeof(r->meta) - 1 - r->meta_len;
+                memcpy(r->meta + r->meta_len, data, n < room ? n : room);
+                r->meta_len += n < room ? n : room;
+                r->meta_left -= n;
+                data += n;
+                len -= n;
+            }
+            if (r->meta_left == 0)
+            {
+                if (r->meta_len)
+                {
+                    radio_parse_meta(r);
+                }
+                r->meta_left = -1;
+                r->audio_left = r->metaint;
+            }
+            continue;
+        }
+
+        size_t n = len;
+        if (r->metaint && n > (size_t)r->audio_left)
+        {
+            n = r->audio_left;
+        }
+        uint8_t *audio = data;
+        size_t audio_len = n;
+        if (!r->synced)
+        {
+            size_t skip = radio_sync(r, audio, audio_len);
+            audio += skip;
+            audio_len -= skip;
+        }
+        if (audio_len && !radio_push(r, audio, audio_len))
+        {
+            return false;
+        }
+        r->rate_bytes += n;
+        if (r->metaint)
+        {
+            r->audio_left -= n;
+        }
+        data += n;
+        len -= n;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (now - r->rate_start_us >= RADIO_RATE_WINDOW_US)
+    {
+        // 服务器没给icy-br时用实测值
+        if (!r->br_from_header)
+        {
+            uint32_t kbps = (uint32_t)((uint64_t)r->rate_bytes * 8 * 1000 / (now - r->rate_start_us));
+            portENTER_CRITICAL(&s_lock);
+            r->stats.bitrate_kbps = kbps;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        r->rate_start_us = now;
+        r->rate_bytes = 0;
+    }
+    return true;
+}
+
+/******************************** 接收任务 ********************************/
+// 一次连接 返回true表示服务器正常结束或需要关闭 false表示出错可以重连
+static bool radio_session(radio_t *r, uint8_t *chunk, bool *got_data)
+{
+    esp_http_client_config_t config = {
+        .url = r->url,
+        .timeout_ms = 3000,
+        .buffer_size = RADIO_CHUNK,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (client == NULL)
+    {
+        return true;
+    }
+    esp_http_client_set_header(client, "Icy-MetaData", "1");
+
+    bool finished = false;
+    if (esp_http_client_open(client, 0) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "connect failed");
+        goto out;
+    }
+    esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 200)
+    {
+        ESP_LOGE(TAG, "http status %d", status);
+        finished = true;
+        goto out;
+    }
+
+    char *value = NULL;
+    r->metaint = 0;
+    if (esp_http_client_get_header(client, "icy-metaint", &value) == ESP_OK && value)
+    {
+        r->metaint = atoi(value);
+    }
+    r->audio_left = r->metaint;
+    r->meta_left = -1;
+    value = NULL;
+    if (esp_http_client_get_header(client, "icy-br", &value) == ESP_OK && value)
+    {
+        r->stats.bitrate_kbps = atoi(value);
+        r->br_from_header = r->stats.bitrate_kbps != 0;
+    }
+    value = NULL;
+    if (esp_http_client_get_header(client, "icy-name", &value) == ESP_OK && value)
+    {
+        ESP_LOGI(TAG, "station: %s", value);
+    }
+    ESP_LOGI(TAG, "connected, metaint %d, %lu kbps", r->metaint, (unsigned long)r->stats.bitrate_kbps);
+    r->rate_start_us = esp_timer_get_time();
+    r->rate_bytes = 0;
+
+    while (!r->closing)
+    {
+        int n = esp_http_client_read(client, (char *)chunk, RADIO_CHUNK);
+        if (n < 0)
+        {
+            ESP_LOGW(TAG, "read error %d", n);
+            break;
+        }
+        if (n == 0)
+        {
+            finished = esp_http_client_is_complete_data_received(client);
+            break;
+        }
+        *got_data = true;
+        if (!radio_feed(r, chunk, n))
+        {
+            break; // 正在关闭
+        }
+    }
+
+out:
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return finished || r->closing;
+}
+
+static void net_radio_task(void *arg)
+{
+    radio_t *r = arg;
+    uint8_t *chunk = malloc(RADIO_CHUNK);
+    int retries = 0;
+    while (chunk && !r->closing)
+    {
+        bool got_data = false;
+        if (radio_session(r, chunk, &got_data))
+        {
+            break;
+        }
+        retries = got_data ? 0 : retries + 1; // 收到过数据说明网络恢复过 重新计数
+        if (retries > NET_RADIO_RECONNECT_MAX)
+        {
+            ESP_LOGE(TAG, "giving up after %d retries", NET_RADIO_RECONNECT_MAX);
+            break;
+        }
+        portENTER_CRITICAL(&s_lock);
+        r->stats.reconnects++;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGW(TAG, "reconnecting (%d)", retries);
+        for (int i = 0; i < 10 && !r->closing; i++)
+        {
+            vTaskDelay(pdMS_TO_TICKS(RADIO_WAIT_MS));
+        }
+    }
+    free(chunk);
+
+    portENTER_CRITICAL(&s_lock);
+    r->eof = true;
+    portEXIT_CRITICAL(&s_lock);
+    xSemaphoreGive(r->data_sem);
+    xSemaphoreGive(r->done_sem);
+    vTaskDelete(NULL);
+}
+
+/******************************** FILE接口 ********************************/
+static ssize_t radio_read(void *cookie, char *out, size_t size)
+{
+    radio_t *r = cookie;
+    int64_t idle_since = esp_timer_get_time();
+    while (!r->closing)
+    {
+        portENTER_CRITICAL(&s_lock);
+        size_t avail = radio_fill(r);
+        bool eof = r->eof;
+        if (r->stats.buffering && (avail >= NET_RADIO_PREBUFFER || eof))
+        {
+            r->stats.buffering = false;
+        }
+        else if (!r->stats.buffering && avail == 0 && !eof)
+        {
+            r->stats.buffering = true; // 读空 重新预缓冲
+            r->stats.rebuffers++;
+        }
+        bool buffering = r->stats.buffering;
+        portEXIT_CRITICAL(&s_lock);
+
+        if (!buffering && avail)
+        {
+            size_t n = size < avail ? size : avail;
+            size_t off = r->rd % NET_RADIO_BUF_SIZE;
+            size_t first = NET_RADIO_BUF_SIZE - off < n ? NET_RADIO_BUF_SIZE - off : n;
+            memcpy(out, r->buf + off, first);
+            memcpy(out + first, r->buf, n - first);
+            portENTER_CRITICAL(&s_lock);
+            r->rd += n;
+            r->stats.fill = radio_fill(r);
+            portEXIT_CRITICAL(&s_lock);
+            xSemaphoreGive(r->space_sem);
+            return n;
+        }
+        if (eof)
+        {
+            return 0;
+        }
+        if (esp_timer_get_time() - idle_since > (int64_t)NET_RADIO_READ_TIMEOUT_MS * 1000)
+        {
+            ESP_LOGW(TAG, "no data for %d ms", NET_RADIO_READ_TIMEOUT_MS);
+            return 0;
+        }
+        xSemaphoreTake(r->data_sem, pdMS_TO_TICKS(RADIO_WAIT_MS));
+    }
+    return 0;
+}
+
+// 只能在缓冲保留的范围内移动 解码器探测格式时回到开头就在这个范围内 不支持SEEK_END
+static int radio_seek(void *cookie, off_t *offset, int whence)
+{
+    radio_t *r = cookie;
+    portENTER_CRITICAL(&s_lock);
+    int64_t target = *offset;
+    if (whence == SEEK_CUR)
+    {
+        target += (int64_t)r->rd;
+    }
+    // 接收任务只保证读位置之前NET_RADIO_HISTORY字节不被覆盖
+    int64_t oldest = r->rd > NET_RADIO_HISTORY ? (int64_t)(r->rd - NET_RADIO_HISTORY) : 0;
+    bool ok = (whence != SEEK_END) && target >= oldest && target <= (int64_t)r->wr;
+    if (ok)
+    {
+        r->rd = (uint64_t)target;
+        r->stats.fill = radio_fill(r);
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!ok)
+    {
+        errno = ESPIPE;
+        return -1;
+    }
+    *offset = (off_t)target;
+    return 0;
+}
+
+static void radio_free(radio_t *r)
+{
+    if (r->data_sem)
+    {
+        vSemaphoreDelete(r->data_sem);
+    }
+    if (r->space_sem)
+    {
+        vSemaphoreDelete(r->space_sem);
+    }
+    if (r->done_sem)
+    {
+        vSemaphoreDelete(r->done_sem);
+    }
+    heap_caps_free(r->buf);
+    free(r);
+}
+
+static int radio_close(void *cookie)
+{
+    radio_t *r = cookie;
+    r->closing = true;
+    xSemaphoreGive(r->space_sem);
+    xSemaphoreTake(r->done_sem, portMAX_DELAY); // 最长等一次http读超时
+    ESP_LOGI(TAG, "closed, %lu rebuffers, %lu reconnects", (unsigned long)r->stats.rebuffers,
+             (unsigned long)r->stats.reconnects);
+
+    portENTER_CRITICAL(&s_lock);
+    s_radio = NULL;
+    portEXIT_CRITICAL(&s_lock);
+    radio_free(r);
+    return 0;
+}
+
+FILE *net_radio_open(const char *url)
+{
+    if (url == NULL || strlen(url) >= RADIO_URL_LEN || s_radio)
+    {
+        ESP_LOGE(TAG, "bad url or stream already open");
+        return NULL;
+    }
+    radio_t *r = calloc(1, sizeof(radio_t));
+    if (r == NULL)
+    {
+        return NULL;
+    }
+    strcpy(r->url, url);
+    r->buf = heap_caps_malloc(NET_RADIO_BUF_SIZE, MALLOC_CAP_SPIRAM);
+    r->data_sem = xSemaphoreCreateBinary();
+    r->space_sem = xSemaphoreCreateBinary();
+    r->done_sem = xSemaphoreCreateBinary();
+    r->stats.size = NET_RADIO_BUF_SIZE;
+    r->stats.buffering = true;
+    if (!r->buf || !r->data_sem || !r->space_sem || !r->done_sem)
+    {
+        ESP_LOGE(TAG, "no memory for stream buffer");
+        radio_free(r);
+        return NULL;
+    }
+
+    cookie_io_functions_t io = {
+        .read = radio_read,
+        .write = NULL,
+        .seek = radio_seek,
+        .close = radio_close,
+    };
+    FILE *fp = fopencookie(r, "rb", io);
+    if (fp == NULL)
+    {
+        radio_free(r);
+        return NULL;
+    }
+
+    s_radio = r;
+    if (task_plan_create(TASK_NET_RADIO, net_radio_task, r, NULL) != pdPASS)
+    {
+        // 没有接收任务 标记结束让fclose直接返回
+        r->eof = true;
+        xSemaphoreGive(r->done_sem);
+    }
+    ESP_LOGI(TAG, "opening %s", url);
+    return fp;
+}
+
+bool net_radio_active(void)
+{
+    return s_radio != NULL;
+}
+
+void net_radio_get_stats(net_radio_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_radio)
+    {
+        *stats = s_radio->stats;
+    }
+    else
+    {
+        memset(stats, 0, sizeof(*stats));
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+
+/*********************** 网络电台 HTTP/ICY流 ****************************/
+// 后台任务用esp_http_client接收数据 去掉ICY元数据后写入PSRAM抖动缓冲
+// 对外是一个fopencookie的FILE* 直接交给audio_player_play 由现有的MP3解码器读取
+// 缓冲先攒到预缓冲水位才开始输出 读空后重新预缓冲 WiFi短暂断开时自动重连
+
+#define NET_RADIO_BUF_SIZE          (512 * 1024)    // 抖动缓冲 放PSRAM 128kbps约30秒
+#define NET_RADIO_PREBUFFER         (64 * 1024)     // 预缓冲水位 开始播放或读空后攒够这么多再输出
+#define NET_RADIO_HISTORY           (16 * 1024)     // 已读数据保留量 解码器探测格式时会回退到开头
+#define NET_RADIO_READ_TIMEOUT_MS   15000           // 缓冲一直为空超过这个时间按流结束处理
+#define NET_RADIO_RECONNECT_MAX     5               // 连续重连的次数
+#define NET_RADIO_TITLE_LEN         64
+
+typedef struct {
+    size_t fill;                            // 缓冲中未读的字节数
+    size_t size;                            // 缓冲总大小
+    bool buffering;                         // 正在预缓冲
+    uint32_t rebuffers;                     // 播放中读空重新缓冲的次数
+    uint32_t reconnects;                    // 断线重连的次数
+    uint32_t bitrate_kbps;                  // 服务器给出的码率 没有时为实测值
+    char title[NET_RADIO_TITLE_LEN];        // ICY StreamTitle
+} net_radio_stats_t;
+
+FILE *net_radio_open(const char *url);      // 连接电台 返回的FILE*被fclose时断开并释放缓冲
+bool net_radio_active(void);
+void net_radio_get_stats(net_radio_stats_t *stats);
@@ -0,0 +1,265 @@
+#include <string.h>
+#include "ota_update.h"
+#include "task_plan.h"
+#include "wifi_svc.h"
+#include "esp_ota_ops.h"
+#include "esp_app_format.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "ota_update";
+
+#define OTA_HDR_LEN         (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t))
+
+static TaskHandle_t s_task;
+static bool s_reboot;
+static int64_t s_t0;
+static ota_update_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_state_names[] = {"idle", "connecting", "downloading", "verifying", "done", "failed"};
+
+const char *ota_update_state_name(ota_update_state_t state)
+{
+    return state <= OTA_UPDATE_FAILED ? s_state_names[state] : "?";
+}
+
+static void set_state(ota_update_state_t state, esp_err_t error)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.state = state;
+    s_stats.error = error;
+    s_stats.elapsed_ms = (esp_timer_get_time() - s_t0) / 1000;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 第一块里就有应用描述 先看是不是给这块板子的固件
+static esp_err_t check_desc(const uint8_t *block)
+{
+    const esp_image_header_t *img = (const esp_image_header_t *)block;
+    const esp_app_desc_t *desc = (const esp_app_desc_t *)(block + sizeof(esp_image_header_t) +
+                                                          sizeof(esp_image_segment_header_t));
+    const esp_app_desc_t *running = esp_app_get_description();
+    ESP_RETURN_ON_FALSE(img->magic == ESP_IMAGE_HEADER_MAGIC && desc->magic_word == ESP_APP_DESC_MAGIC_WORD,
+                        ESP_ERR_IMAGE_INVALID, TAG, "not an app image");
+    ESP_RETURN_ON_FALSE(img->chip_id == CONFIG_IDF_FIRMWARE_CHIP_ID, ESP_ERR_IMAGE_INVALID, TAG, "wrong chip %d",
+                        img->chip_id);
+    ESP_RETURN_ON_FALSE(strncmp(desc->project_name, running->project_name, sizeof(desc->project_name)) == 0,
+                        ESP_ERR_IMAGE_INVALID, TAG, "image is for %.32s", desc->project_name);
+    portENTER_CRITICAL(&s_lock);
+    strlcpy(s_stats.version, desc->version, sizeof(s_stats.version));
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "new firmware %.32s, running %.32s", desc->version, running->version);
+    return ESP_OK;
+}
+
+// 读满一块或者读到结尾 返回读到的字节数 出错返回负数
+static int read_block(esp_http_client_handle_t client, uint8_t *buf)
+{
+    int fill = 0;
+    while (fill < OTA_UPDATE_BLOCK)
+    {
+        int64_t t0 = esp_timer_get_time();
+        int n = esp_http_client_read(client, (char *)buf + fill, OTA_UPDATE_BLOCK - fill);
+        uint32_t us = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.net_us += us;
+        portEXIT_CRITICAL(&s_lock);
+        if (n < 0)
+        {
+            return n;
+        }
+        if (n == 0)
+        {
+            break; // 结尾 或者连接断了 靠下面的长度判断
+        }
+        fill += n;
+    }
+    return fill;
+}
+
+static esp_err_t ota_download(uint8_t *buf)
+{
+    esp_err_t ret = ESP_OK;
+    const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+    ESP_RETURN_ON_FALSE(part, ESP_ERR_NOT_FOUND, TAG, "no OTA partition");
+    ESP_RETURN_ON_FALSE(CONFIG_APP_OTA_URL[0], ESP_ERR_INVALID_ARG, TAG, "CONFIG_APP_OTA_URL not set");
+    ESP_RETURN_ON_FALSE(wifi_svc_wait_connected(OTA_UPDATE_WIFI_MS), ESP_ERR_INVALID_STATE, TAG, "no WiFi");
+
+    esp_http_client_config_t cfg = {
+        .url = CONFIG_APP_OTA_URL,
+        .timeout_ms = OTA_UPDATE_TIMEOUT_MS,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_NO_MEM, TAG, "http client");
+    esp_ota_handle_t ota = 0;
+    ESP_GOTO_ON_ERROR(esp_http_client_open(client, 0), out, TAG, "connect");
+    int64_t len = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    ESP_GOTO_ON_FALSE(status == 200, ESP_ERR_INVALID_RESPONSE, out, TAG, "HTTP %d", status);
+    ESP_GOTO_ON_FALSE(len <= 0 || len <= part->size, ESP_ERR_INVALID_SIZE, out, TAG, "image %lld > partition %lu",
+                      len, (unsigned long)part->size);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.total = len > 0 ? len : 0;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%lld bytes into %s at 0x%lx", len, part->label, (unsigned long)part->address);
+
+    set_state(OTA_UPDATE_DOWNLOADING, ESP_OK);
+    uint32_t bytes = 0;
+    for (;;)
+    {
+        int n = read_block(client, buf);
+        ESP_GOTO_ON_FALSE(n >= 0, ESP_ERR_INVALID_RESPONSE, out, TAG, "read failed at %lu", (unsigned long)bytes);
+        if (n == 0)
+        {
+            break;
+        }
+        if (bytes == 0)
+        {
+            ESP_GOTO_ON_FALSE(n >= (int)OTA_HDR_LEN, ESP_ERR_IMAGE_INVALID, out, TAG, "short image");
+            ESP_GOTO_ON_ERROR(check_desc(buf), out, TAG, "image check");
+            // 顺序写 不先擦整个分区 每写到新扇区时才擦
+            ESP_GOTO_ON_ERROR(esp_ota_begin(part, OTA_WITH_SEQUENTIAL_WRITES, &ota), out, TAG, "ota begin");
+        }
+        int64_t t0 = esp_timer_get_time();
+        ESP_GOTO_ON_ERROR(esp_ota_write(ota, buf, n), out, TAG, "flash write");
+        uint32_t us = esp_timer_get_time() - t0;
+        bytes += n;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.bytes = bytes;
+        s_stats.blocks++;
+        s_stats.write_us += us;
+        s_stats.write_max_us = us > s_stats.write_max_us ? us : s_stats.write_max_us;
+        s_stats.elapsed_ms = (esp_timer_get_time() - s_t0) / 1000;
+        portEXIT_CRITICAL(&s_lock);
+        if (n < OTA_UPDATE_BLOCK)
+        {
+            break;
+        }
+    }
+    ESP_GOTO_ON_FALSE(bytes && esp_http_client_is_complete_data_received(client), ESP_ERR_INVALID_SIZE, out, TAG,
+                      "incomplete, %lu bytes", (unsigned long)bytes);
+
+    set_state(OTA_UPDATE_VERIFYING, ESP_OK);
+    ret = esp_ota_end(ota); // 校验整个镜像 SHA256不对返回ESP_ERR_OTA_VALIDATE_FAILED
+    ota = 0;
+    ESP_GOTO_ON_ERROR(ret, out, TAG, "image verify");
+    ESP_GOTO_ON_ERROR(esp_ota_set_boot_partition(part), out, TAG, "set boot partition");
+out:
+    if (ota)
+    {
+        esp_ota_abort(ota);
+    }
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return ret;
+}
+
+static void ota_task(void *arg)
+{
+    // 块缓冲放内部RAM 写flash时驱动不用再倒一次
+    uint8_t *buf = heap_caps_malloc(OTA_UPDATE_BLOCK, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    esp_err_t ret = buf ? ota_download(buf) : ESP_ERR_NO_MEM;
+    heap_caps_free(buf);
+    ota_update_stats_t st;
+    ota_update_get_stats(&st);
+    if (ret == ESP_OK)
+    {
+        set_state(OTA_UPDATE_DONE, ESP_OK);
+        ESP_LOGI(TAG, "%lu KB in %lu ms, download %lu KB/s, flash %lu KB/s", (unsigned long)st.bytes / 1024,
+                 (unsigned long)st.elapsed_ms, (unsigned long)(st.net_us ? st.bytes * 1000000ULL / 1024 / st.net_us : 0),
+                 (unsigned long)(st.write_us ? st.bytes * 1000000ULL / 1024 / st.write_us : 0));
+    }
+    else
+    {
+        set_state(OTA_UPDATE_FAILED, ret);
+        ESP_LOGE(TAG, "update failed: %s", esp_err_to_name(ret));
+    }
+    if (ret == ESP_OK && s_reboot)
+    {
+        vTaskDelay(pdMS_TO_TICKS(1000)); // 让界面显示一下结果
+        esp_restart();
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_task = NULL;
+    portEXIT_CRITICAL(&s_lock);
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_update_start(bool reboot)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool busy = s_task != NULL || s_stats.state == OTA_UPDATE_DONE;
+    if (!busy)
+    {
+        s_task = (TaskHandle_t)1; // 占位 任务建好前别人进不来
+        bool rolled_back = s_stats.rolled_back, pending = s_stats.pending_verify;
+        memset(&s_stats, 0, sizeof(s_stats));
+        s_stats.rolled_back = rolled_back;
+        s_stats.pending_verify = pending;
+        s_stats.state = OTA_UPDATE_CONNECTING;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_RETURN_ON_FALSE(!busy, ESP_ERR_INVALID_STATE, TAG, "update already running");
+    s_reboot = reboot;
+    s_t0 = esp_timer_get_time();
+    TaskHandle_t task;
+    if (task_plan_create(TASK_OTA, ota_task, NULL, &task) != pdPASS)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_task = NULL;
+        s_stats.state = OTA_UPDATE_FAILED;
+        s_stats.error = ESP_ERR_NO_MEM;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (s_task == (TaskHandle_t)1)
+    {
+        s_task = task;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+void ota_update_confirm(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    bool pending = esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY;
+    bool rolled_back = esp_ota_get_last_invalid_partition() != NULL;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.pending_verify = pending;
+    s_stats.rolled_back = rolled_back;
+    portEXIT_CRITICAL(&s_lock);
+    if (rolled_back)
+    {
+        ESP_LOGW(TAG, "previous update did not boot, rolled back");
+    }
+    if (pending)
+    {
+        esp_ota_mark_app_valid_cancel_rollback();
+        ESP_LOGI(TAG, "%s %.32s marked valid", running->label, esp_app_get_description()->version);
+    }
+}
+
+void ota_update_get_stats(ota_update_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    if (s_task)
+    {
+        stats->elapsed_ms = (esp_timer_get_time() - s_t0) / 1000;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
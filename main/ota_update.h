@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 固件在线升级 ****************************/
+// 分区表里两个3456KB的OTA分区轮流用 从CONFIG_APP_OTA_URL下载 边下边写进不在运行的那个分区
+// 不在PSRAM里攒整个固件 HTTP直接读进4KB的块缓冲 凑满一个扇区写一次 顺序写时驱动边写边擦
+// 第一块里的应用描述先检查 项目名和芯片对不上就不往下下载
+// 写完由esp_ota_end校验镜像的SHA256 通过才切启动分区重启
+// 开了引导程序的回滚 新固件第一次启动是待验证状态 主界面出来以后ota_update_confirm标成有效
+// 在这之前死机或者看门狗复位 下次引导回到原来的固件
+//
+// 回调和状态在升级任务里更新 界面用ota_update_get_stats定时取
+
+#define OTA_UPDATE_BLOCK        4096    // 和flash扇区一样大
+#define OTA_UPDATE_TIMEOUT_MS   10000   // HTTP读超时
+#define OTA_UPDATE_WIFI_MS      10000   // 开始时等WiFi连上
+
+typedef enum {
+    OTA_UPDATE_IDLE,
+    OTA_UPDATE_CONNECTING,              // 等WiFi 建连接 收响应头
+    OTA_UPDATE_DOWNLOADING,
+    OTA_UPDATE_VERIFYING,
+    OTA_UPDATE_DONE,                    // 写完校验过 等重启
+    OTA_UPDATE_FAILED,
+} ota_update_state_t;
+
+typedef struct {
+    ota_update_state_t state;
+    esp_err_t error;                    // FAILED时的原因
+    uint32_t total;                     // 响应头里的长度 不知道是0
+    uint32_t bytes;                     // 已写进flash的
+    uint32_t blocks;
+    uint32_t net_us;                    // 花在读网络上的时间
+    uint32_t write_us;                  // 花在esp_ota_write上的时间 含擦除
+    uint32_t write_max_us;
+    uint32_t elapsed_ms;                // 从开始到现在或者到结束
+    char version[32];                   // 新固件的版本
+    bool rolled_back;                   // 开机时发现上一个固件没通过验证
+    bool pending_verify;                // 这次启动的是还没确认的新固件
+} ota_update_stats_t;
+
+esp_err_t ota_update_start(bool reboot);    // 后台升级 reboot为真的话成功后自动重启 已经在跑返回ESP_ERR_INVALID_STATE
+void ota_update_confirm(void);          // 开机检查都过了以后调用 新固件标成有效 取消回滚
+const char *ota_update_state_name(ota_update_state_t state);
+void ota_update_get_stats(ota_update_stats_t *stats);
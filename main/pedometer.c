@@ -0,0 +1,414 @@
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "pedometer.h"
+#include "task_plan.h"
+#include "imu.h"
+#include "idle_mgr.h"
+#include "evt_bus.h"
+#include "time_sync.h"
+#include "esp32_s3_szp.h"
+#include "nvs.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if CONFIG_APP_PEDOMETER
+
+static const char *TAG = "pedometer";
+
+#define P_ACC           (1.0f / IMU_ACC_LSB_PER_G)
+#define P_MEAN_ALPHA    (1.0f / IMU_ODR_HZ)     // 1秒的均值
+#define P_LP_ALPHA      (25.0f / IMU_ODR_HZ)    // 2*pi*4Hz/ODR
+#define P_MS(ms)        ((int64_t)(ms) * 1000)
+
+// 只在自己的任务里用
+static float s_mean = 1.0f;
+static float s_lp;
+static bool s_below;                    // 过了负门限 下一次过正门限算峰
+static float s_peak;                    // 这一步到现在最大的
+static int64_t s_last_step;
+static int s_run;                       // 这一串连着的步数 到PEDO_CONFIRM才算
+static float s_interval_ms;             // 平均步间隔
+static float s_amp;                     // 平均峰值
+static int64_t s_open_us;
+static int64_t s_acct_us;               // 走跑时间算到哪了
+static uint32_t s_walk_ms;              // 今天不满一分钟的
+static uint32_t s_run_ms;
+static bool s_dirty;
+static int64_t s_saved_us;
+
+static TaskHandle_t s_task;
+static volatile bool s_motion;
+static volatile bool s_holding;         // imu_start过 在读FIFO
+static volatile pedo_activity_t s_activity;
+static pedo_day_t s_days[PEDO_DAYS];    // 0是今天
+static int64_t s_start_us;
+static pedometer_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_activity_names[] = {"still", "walk", "run"};
+
+const char *pedometer_activity_name(pedo_activity_t a)
+{
+    return a <= PEDO_RUN ? s_activity_names[a] : "?";
+}
+
+static uint32_t pedo_date(void)
+{
+    if (!time_sync_valid())
+    {
+        return 0;
+    }
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+static void pedo_load(void)
+{
+    nvs_handle_t nvs;
+    size_t len = sizeof(s_days);
+    if (nvs_open(PEDO_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK)
+    {
+        if (nvs_get_blob(nvs, PEDO_NVS_KEY, s_days, &len) != ESP_OK || len != sizeof(s_days))
+        {
+            memset(s_days, 0, sizeof(s_days));
+        }
+        nvs_close(nvs);
+    }
+}
+
+static void pedo_save(int64_t now)
+{
+    pedo_day_t days[PEDO_DAYS];
+    portENTER_CRITICAL(&s_lock);
+    memcpy(days, s_days, sizeof(days));
+    portEXIT_CRITICAL(&s_lock);
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(PEDO_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_set_blob(nvs, PEDO_NVS_KEY, days, sizeof(days));
+        if (ret == ESP_OK)
+        {
+            ret = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    s_dirty = false;
+    s_saved_us = now;
+    portENTER_CRITICAL(&s_lock);
+    if (ret == ESP_OK)
+    {
+        s_stats.saves++;
+    }
+    else
+    {
+        s_stats.save_errors++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 往后挪一天 今天从0开始
+static void pedo_shift(uint32_t date)
+{
+    portENTER_CRITICAL(&s_lock);
+    memmove(&s_days[1], &s_days[0], sizeof(s_days[0]) * (PEDO_DAYS - 1));
+    memset(&s_days[0], 0, sizeof(s_days[0]));
+    s_days[0].date = date;
+    portEXIT_CRITICAL(&s_lock);
+    s_walk_ms = s_run_ms = 0;
+}
+
+// 换天 对上时间 返回要不要马上写
+static bool pedo_check_day(void)
+{
+    uint32_t date = pedo_date();
+    if (date == 0 || date == s_days[0].date)
+    {
+        return false;
+    }
+    if (s_days[0].date != 0)
+    {
+        pedo_shift(date);
+        return true;
+    }
+    // 时间刚对上 没日期的这些算今天
+    portENTER_CRITICAL(&s_lock);
+    if (s_days[1].date == date)
+    {
+        s_days[1].steps += s_days[0].steps;
+        s_days[1].walk_min += s_days[0].walk_min;
+        s_days[1].run_min += s_days[0].run_min;
+        memmove(&s_days[0], &s_days[1], sizeof(s_days[0]) * (PEDO_DAYS - 1));
+        memset(&s_days[PEDO_DAYS - 1], 0, sizeof(s_days[0]));
+    }
+    else
+    {
+        s_days[0].date = date;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+static void pedo_add_steps(int n)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_days[0].steps += n;
+    s_stats.steps += n;
+    portEXIT_CRITICAL(&s_lock);
+    s_dirty = true;
+}
+
+static void pedo_step(int64_t t)
+{
+    int64_t gap = t - s_last_step;
+    if (gap < P_MS(PEDO_STEP_MIN_MS))
+    {
+        return; // 一步里的第二个峰
+    }
+    s_last_step = t;
+    float amp = s_peak;
+    s_peak = 0.0f;
+    if (gap > P_MS(PEDO_STEP_MAX_MS))
+    {
+        s_run = 1;
+        s_interval_ms = 0.0f;
+        s_amp = amp;
+        return;
+    }
+    s_interval_ms = s_interval_ms > 0.0f ? s_interval_ms * 0.75f + gap / 1000 * 0.25f : gap / 1000;
+    s_amp = s_amp * 0.75f + amp * 0.25f;
+    if (++s_run == PEDO_CONFIRM)
+    {
+        pedo_add_steps(PEDO_CONFIRM); // 前面没算的补上
+    }
+    else if (s_run > PEDO_CONFIRM)
+    {
+        pedo_add_steps(1);
+    }
+}
+
+static void pedo_sample(const imu_sample_t *s)
+{
+    float ax = s->acc[0] * P_ACC, ay = s->acc[1] * P_ACC, az = s->acc[2] * P_ACC;
+    float m = sqrtf(ax * ax + ay * ay + az * az);
+    s_mean += (m - s_mean) * P_MEAN_ALPHA;
+    s_lp += (m - s_mean - s_lp) * P_LP_ALPHA;
+    if (s_lp > s_peak)
+    {
+        s_peak = s_lp;
+    }
+    if (s_lp < -PEDO_TH_G * 0.5f)
+    {
+        s_below = true;
+    }
+    else if (s_below && s_lp > PEDO_TH_G)
+    {
+        s_below = false;
+        pedo_step(s->t_us);
+    }
+}
+
+static pedo_activity_t pedo_classify(int64_t now)
+{
+    if (s_run < PEDO_CONFIRM || now - s_last_step > P_MS(PEDO_STEP_MAX_MS))
+    {
+        return PEDO_STILL;
+    }
+    return s_interval_ms < PEDO_RUN_MS || s_amp > PEDO_RUN_G ? PEDO_RUN : PEDO_WALK;
+}
+
+// 走跑的时间按上一段的活动记
+static void pedo_account(int64_t now)
+{
+    uint32_t ms = (now - s_acct_us) / 1000;
+    s_acct_us = now;
+    if (s_activity == PEDO_WALK)
+    {
+        s_walk_ms += ms;
+    }
+    else if (s_activity == PEDO_RUN)
+    {
+        s_run_ms += ms;
+    }
+    else
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_days[0].walk_min += s_walk_ms / 60000;
+    s_days[0].run_min += s_run_ms / 60000;
+    portEXIT_CRITICAL(&s_lock);
+    s_walk_ms %= 60000;
+    s_run_ms %= 60000;
+}
+
+static bool pedo_open(int64_t now)
+{
+    if ((!imu_running() && qmi8658_init() != ESP_OK) || imu_start() != ESP_OK)
+    {
+        idle_mgr_imu_released();
+        return false;
+    }
+    if (imu_add_listener(s_task) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "no IMU listener slot");
+        imu_stop();
+        idle_mgr_imu_released();
+        return false;
+    }
+    s_holding = true;
+    s_open_us = now;
+    s_acct_us = now;
+    s_last_step = 0;
+    s_run = 0;
+    s_below = false;
+    s_lp = 0.0f;
+    s_mean = 1.0f;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.wakes++;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+static void pedo_close(int64_t now)
+{
+    pedo_account(now);
+    imu_remove_listener(s_task);
+    imu_stop();
+    idle_mgr_imu_released(); // 没别人在用的话芯片回到只测运动
+    s_holding = false;
+    s_activity = PEDO_STILL;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.active_ms += (now - s_open_us) / 1000;
+    s_stats.false_wakes += s_last_step == 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void pedo_task(void *arg)
+{
+    static imu_sample_t s_batch[QMI8658_FIFO_SAMPLES];
+    uint32_t cursor = 0;
+    pedo_load();
+    uint32_t date = pedo_date();
+    if (s_days[0].date != date)
+    {
+        pedo_shift(date); // 关机期间换过天 或者时间还没对上 先记在日期0
+    }
+    s_saved_us = esp_timer_get_time();
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(s_holding ? PEDO_IDLE_MS / 4 : PEDO_TICK_MS));
+        int64_t now = esp_timer_get_time();
+        if (!s_holding && s_motion && pedo_open(now))
+        {
+            cursor = imu_head();
+        }
+        s_motion = false;
+        if (s_holding)
+        {
+            uint32_t c0 = esp_cpu_get_cycle_count();
+            int total = 0;
+            int n;
+            while ((n = imu_read(&cursor, s_batch, QMI8658_FIFO_SAMPLES)) > 0)
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    pedo_sample(&s_batch[i]);
+                }
+                total += n;
+            }
+            pedo_account(now);
+            s_activity = pedo_classify(now);
+            uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+            portENTER_CRITICAL(&s_lock);
+            s_stats.samples += total;
+            s_stats.cycles += cycles;
+            portEXIT_CRITICAL(&s_lock);
+            int64_t last = s_last_step ? s_last_step : s_open_us;
+            if (now - last > P_MS(PEDO_IDLE_MS))
+            {
+                pedo_close(now);
+            }
+        }
+        bool new_day = pedo_check_day();
+        if (new_day || (s_dirty && now - s_saved_us >= PEDO_SAVE_MS))
+        {
+            pedo_save(now);
+        }
+    }
+}
+
+// 在空闲管理的任务里
+static void pedo_motion(const evt_t *ev)
+{
+    s_motion = true;
+    if (!s_holding)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+esp_err_t pedometer_start(void)
+{
+    ESP_RETURN_ON_FALSE(s_task == NULL, ESP_ERR_INVALID_STATE, TAG, "already started");
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_PEDOMETER, pedo_task, NULL, &s_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+    s_start_us = esp_timer_get_time();
+    return evt_bus_subscribe(EVT_MOTION, pedo_motion, EVT_BUS_DIRECT);
+}
+
+pedo_activity_t pedometer_activity(void)
+{
+    return s_activity;
+}
+
+void pedometer_today(pedo_day_t *day)
+{
+    portENTER_CRITICAL(&s_lock);
+    *day = s_days[0];
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int pedometer_history(pedo_day_t *days, int max)
+{
+    int n = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < PEDO_DAYS && n < max; i++)
+    {
+        if (i == 0 || s_days[i].date || s_days[i].steps)
+        {
+            days[n++] = s_days[i];
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return n;
+}
+
+void pedometer_get_stats(pedometer_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    if (s_holding)
+    {
+        stats->active_ms += (now - s_open_us) / 1000;
+    }
+    stats->tracked_ms = s_task ? (now - s_start_us) / 1000 : 0;
+    if (stats->tracked_ms)
+    {
+        uint64_t cpu_ms = stats->cycles / (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000);
+        stats->cpu_ms_per_h = cpu_ms * 3600000 / stats->tracked_ms;
+        stats->active_s_per_h = stats->active_ms * 3600 / stats->tracked_ms;
+        stats->ua = stats->active_ms * CONFIG_APP_PEDOMETER_ACTIVE_UA / stats->tracked_ms;
+    }
+}
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 计步和活动 ****************************/
+// 放着不动时不开FIFO 芯片留在空闲管理设的只测运动(加速度低功耗21Hz) 这个任务一直睡着
+// 空闲管理读到Any-Motion发EVT_MOTION 板子没引出INT1 这就是运动中断 最多晚IDLE_POLL_MS 亮屏时IDLE_ON_POLL_MS
+// 动了就imu_start(和别的模块配对) 按FIFO水位一批一批处理 PEDO_IDLE_MS没有步子就imu_stop 芯片回到只测运动
+// 手势这些开着IMU时样本本来就在读 计步跟着看 不多花I2C
+// 计步: 加速度模长减掉1秒的均值 平滑到4Hz左右 过正门限而且之前过了负门限的一半算一个峰
+//       两峰间隔在PEDO_STEP_MIN_MS~PEDO_STEP_MAX_MS 连着PEDO_CONFIRM步才开始算 前面几步补上 拍一下桌子不算
+// 活动: 步子断了算静止 步频快或者峰值大算跑 不然是走
+// 每天的步数和走 跑的分钟存NVS 最近PEDO_DAYS天一个blob 攒着 隔CONFIG_APP_PEDOMETER_SAVE_MIN分钟或者换天才写
+// 时间还没对上时记在日期0那天 对上了是同一天就并进去
+// 成本: 开着FIFO的时间 这个任务的CPU周期 按Kconfig里传感器多出来的电流 折成每小时
+
+#define PEDO_DAYS               7
+#define PEDO_IDLE_MS            8000    // 叫醒以后这么久没步子就关FIFO
+#define PEDO_TICK_MS            60000   // 睡着时这么久看一次换天和要不要写NVS
+#define PEDO_TH_G               0.08f   // 平滑以后的峰 g
+#define PEDO_STEP_MIN_MS        250
+#define PEDO_STEP_MAX_MS        2000
+#define PEDO_CONFIRM            4
+#define PEDO_RUN_MS             380     // 平均步间隔比这个短算跑
+#define PEDO_RUN_G              0.6f    // 或者峰值比这个大
+#define PEDO_SAVE_MS            (CONFIG_APP_PEDOMETER_SAVE_MIN * 60000LL)
+#define PEDO_NVS_NAMESPACE      "pedo"
+#define PEDO_NVS_KEY            "days"
+
+typedef enum {
+    PEDO_STILL,
+    PEDO_WALK,
+    PEDO_RUN,
+} pedo_activity_t;
+
+typedef struct {
+    uint32_t date;                      // 20261015这样 时间没对上是0
+    uint32_t steps;
+    uint16_t walk_min;
+    uint16_t run_min;
+} pedo_day_t;
+
+typedef struct {
+    uint32_t steps;                     // 开机以后
+    uint32_t wakes;                     // 被运动叫醒开FIFO的次数
+    uint32_t false_wakes;               // 叫醒了一步没走又关掉的
+    uint32_t samples;
+    uint64_t cycles;
+    uint64_t active_ms;                 // 开着FIFO的时间 含现在这一段
+    uint64_t tracked_ms;                // 开始以后
+    uint32_t saves;
+    uint32_t save_errors;
+    uint32_t cpu_ms_per_h;              // 下面三个按上面的折成每小时
+    uint32_t active_s_per_h;
+    uint32_t ua;                        // 传感器多出来的平均电流估计
+} pedometer_stats_t;
+
+#if CONFIG_APP_PEDOMETER
+esp_err_t pedometer_start(void);        // 空闲管理之后调 NVS在任务里读
+pedo_activity_t pedometer_activity(void);
+const char *pedometer_activity_name(pedo_activity_t a);
+void pedometer_today(pedo_day_t *day);
+int pedometer_history(pedo_day_t *days, int max);  // 今天在最前 返回几天
+void pedometer_get_stats(pedometer_stats_t *stats);
+#endif
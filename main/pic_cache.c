@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include "pic_cache.h"
+#include "task_plan.h"
+#include "pic_jpeg.h"
+#include "pic_rgb565.h"
+#include "ui_perf.h"
+#include "sd_fs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "pic_cache";
+
+typedef struct {
+    char path[PIC_CACHE_PATH_LEN];
+    off_t size;                         // 文件大小和修改时间 用来发现同名文件被替换
+    time_t mtime;
+    lv_img_dsc_t img;
+    uint32_t stamp;                     // 最后一次使用 越小越久没用
+    uint16_t pins;                      // 正在被lv_img引用 不能删
+    bool used;
+    bool stale;                         // 文件变了 等release后删掉
+} pic_entry_t;
+
+static pic_entry_t s_entries[PIC_CACHE_MAX_ENTRIES];
+static pic_cache_stats_t s_stats;
+static uint32_t s_clock;
+static SemaphoreHandle_t s_mutex;
+
+// 预取请求 新请求直接覆盖没做完的旧请求
+static TaskHandle_t s_worker;
+static char s_want[PIC_PREFETCH_MAX][PIC_CACHE_PATH_LEN];
+static int s_want_cnt;
+static uint32_t s_want_gen;
+static char s_loading[PIC_CACHE_PATH_LEN];     // 预取任务正在解码的文件 不走LVGL的才会设
+
+static void cache_lock(void)
+{
+    if (s_mutex == NULL)
+    {
+        s_mutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+}
+
+static void cache_unlock(void)
+{
+    xSemaphoreGive(s_mutex);
+}
+
+static void entry_free(pic_entry_t *e)
+{
+    s_stats.bytes -= e->img.data_size;
+    s_stats.entries--;
+    heap_caps_free((void *)e->img.data);
+    memset(e, 0, sizeof(*e));
+}
+
+// 从最久没用的开始删 直到放得下need字节并有一个空位 返回空位 放不下返回NULL
+static pic_entry_t *cache_make_room(uint32_t need)
+{
+    while (true)
+    {
+        pic_entry_t *slot = NULL;
+        pic_entry_t *lru = NULL;
+        for (int i = 0; i < PIC_CACHE_MAX_ENTRIES; i++)
+        {
+            pic_entry_t *e = &s_entries[i];
+            if (!e->used)
+            {
+                slot = slot ? slot : e;
+            }
+            else if (e->pins == 0 && (lru == NULL || e->stamp < lru->stamp))
+            {
+                lru = e;
+            }
+        }
+        if (slot && s_stats.bytes + need <= PIC_CACHE_BUDGET)
+        {
+            return slot;
+        }
+        if (lru == NULL)
+        {
+            return NULL;
+        }
+        entry_free(lru);
+        s_stats.evictions++;
+    }
+}
+
+static void img_fill(lv_img_dsc_t *img, lv_img_cf_t cf, uint32_t w, uint32_t h, uint32_t bytes, uint8_t *data)
+{
+    memset(img, 0, sizeof(*img));
+    img->header.cf = cf;
+    img->header.w = w;
+    img->header.h = h;
+    img->data_size = bytes;
+    img->data = data;
+}
+
+static uint32_t rd16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool has_ext(const char *fs_path, const char *ext)
+{
+    const char *dot = strrchr(fs_path, '.');
+    return dot && strcasecmp(dot, ext) == 0;
+}
+
+// 拍照存的是24位BMP 自己用stdio读 不碰LVGL 可以在任何任务里调用
+// 只认24位、32位和565的16位 其他的返回false 交给LVGL的解码器
+static bool pic_decode_bmp(const char *fs_path, lv_img_dsc_t *img)
+{
+    FILE *f = fopen(fs_path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    uint8_t hdr[54];
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || hdr[0] != 'B' || hdr[1] != 'M')
+    {
+        fclose(f);
+        return false;
+    }
+    uint32_t offset = rd32(hdr + 10);
+    int32_t w = (int32_t)rd32(hdr + 18);
+    int32_t h = (int32_t)rd32(hdr + 22);
+    uint32_t bpp = rd16(hdr + 28);
+    uint32_t comp = rd32(hdr + 30);
+    bool top_down = h < 0;
+    h = top_down ? -h : h;
+    bool ok = w > 0 && h > 0 && w <= LV_COORD_MAX && h <= LV_COORD_MAX &&
+              ((bpp == 24 && comp == 0) || (bpp == 32 && (comp == 0 || comp == 3)) || (bpp == 16 && comp == 3));
+    if (ok && bpp == 16)
+    {
+        // 16位只接受RGB565的掩码
+        uint8_t masks[12];
+        ok = fseek(f, 14 + rd32(hdr + 14), SEEK_SET) == 0 && fread(masks, 1, sizeof(masks), f) == sizeof(masks) &&
+             rd32(masks) == 0xF800 && rd32(masks + 4) == 0x07E0 && rd32(masks + 8) == 0x001F;
+    }
+    // 和LVGL的BMP解码器一样 32位按带alpha处理
+    uint32_t px = bpp == 32 ? LV_IMG_PX_SIZE_ALPHA_BYTE : LV_COLOR_SIZE / 8;
+    uint32_t bytes = (uint32_t)w * h * px;
+    uint32_t row_bytes = ((w * bpp + 31) / 32) * 4;
+    uint8_t *data = NULL;
+    uint8_t *row = NULL;
+    if (ok && bytes <= PIC_CACHE_BUDGET)
+    {
+        data = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        row = heap_caps_malloc(row_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    ok = data && row && fseek(f, offset, SEEK_SET) == 0;
+
+    // 文件里默认从最下面一行开始 按文件顺序读 往对应的行里写
+    for (int32_t y = 0; y < h && ok; y++)
+    {
+        ok = fread(row, 1, row_bytes, f) == row_bytes;
+        uint8_t *out = data + (top_down ? y : h - 1 - y) * w * px;
+        const uint8_t *in = row;
+        for (int32_t x = 0; x < w && ok; x++)
+        {
+            lv_color_t c;
+            if (bpp == 16)
+            {
+                uint32_t v = rd16(in);
+                c = lv_color_make((v >> 8) & 0xF8, (v >> 3) & 0xFC, (v << 3) & 0xF8);
+                in += 2;
+            }
+            else
+            {
+                c = lv_color_make(in[2], in[1], in[0]);
+                in += bpp / 8;
+            }
+            memcpy(out, &c, sizeof(c));
+            if (bpp == 32)
+            {
+                out[sizeof(c)] = in[-1];
+            }
+            out += px;
+        }
+    }
+    fclose(f);
+    heap_caps_free(row);
+    if (!ok)
+    {
+        heap_caps_free(data);
+        return false;
+    }
+    img_fill(img, bpp == 32 ? LV_IMG_CF_TRUE_COLOR_ALPHA : LV_IMG_CF_TRUE_COLOR, w, h, bytes, data);
+    return true;
+}
+
+// 用LVGL注册的解码器把整张图读出来 只接受输出RGB565或RGB565+A8的 要持有LVGL锁
+static bool pic_decode_lvgl(const char *fs_path, lv_img_dsc_t *img)
+{
+    char src[PIC_CACHE_PATH_LEN + 4];
+    lv_snprintf(src, sizeof(src), SD_FS_DRIVE "%s", fs_path);
+    lv_img_decoder_dsc_t dec;
+    if (lv_img_decoder_open(&dec, src, lv_color_white(), 0) != LV_RES_OK)
+    {
+        return false;
+    }
+
+    // SJPG报的是RAW 逐行读出来的是lv_color_t 整块给出的RAW是没解码的原始数据 用不了
+    lv_img_cf_t cf = dec.header.cf;
+    uint32_t px;
+    if (cf == LV_IMG_CF_TRUE_COLOR || (cf == LV_IMG_CF_RAW && dec.img_data == NULL))
+    {
+        cf = LV_IMG_CF_TRUE_COLOR;
+        px = LV_COLOR_SIZE / 8;
+    }
+    else if (cf == LV_IMG_CF_TRUE_COLOR_ALPHA || (cf == LV_IMG_CF_RAW_ALPHA && dec.img_data == NULL))
+    {
+        cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+        px = LV_IMG_PX_SIZE_ALPHA_BYTE;
+    }
+    else
+    {
+        lv_img_decoder_close(&dec);
+        return false;
+    }
+
+    uint32_t w = dec.header.w;
+    uint32_t h = dec.header.h;
+    uint32_t bytes = w * h * px;
+    uint8_t *data = NULL;
+    if (bytes && bytes <= PIC_CACHE_BUDGET)
+    {
+        data = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (data == NULL)
+    {
+        lv_img_decoder_close(&dec);
+        return false;
+    }
+
+    bool ok = true;
+    if (dec.img_data)
+    {
+        memcpy(data, dec.img_data, bytes);
+    }
+    else
+    {
+        for (uint32_t y = 0; y < h && ok; y++)
+        {
+            ok = lv_img_decoder_read_line(&dec, 0, y, w, data + y * w * px) == LV_RES_OK;
+        }
+    }
+    lv_img_decoder_close(&dec);
+    if (!ok)
+    {
+        heap_caps_free(data);
+        return false;
+    }
+
+    img_fill(img, cf, w, h, bytes, data);
+    return true;
+}
+
+// 不用LVGL锁的解码 BMP自己读 .rgb565整块读进来 JPEG流式解码并缩到屏幕大小 其他格式返回false
+static bool pic_decode_native(const char *fs_path, int max_w, int max_h, lv_img_dsc_t *img)
+{
+    if (has_ext(fs_path, ".bmp"))
+    {
+        return pic_decode_bmp(fs_path, img);
+    }
+    if (has_ext(fs_path, "." PIC_RGB565_EXT))
+    {
+        return pic_rgb565_load(fs_path, PIC_CACHE_BUDGET, img);
+    }
+#if CONFIG_APP_PIC_JPEG_STREAM
+    if (has_ext(fs_path, ".jpg") || has_ext(fs_path, ".jpeg"))
+    {
+        pic_jpeg_info_t info;
+        if (!pic_jpeg_decode(fs_path, max_w, max_h, PIC_CACHE_BUDGET, img, &info))
+        {
+            return false;
+        }
+        ESP_LOGI(TAG, "%s %ux%u streamed at 1/%d to %ux%u", fs_path, (unsigned)info.src_w, (unsigned)info.src_h, 1 << info.scale,
+                 (unsigned)img->header.w, (unsigned)img->header.h);
+        cache_lock();
+        s_stats.streamed++;
+        cache_unlock();
+        return true;
+    }
+#endif
+    return false;
+}
+
+static bool pic_decode(const char *fs_path, lv_img_dsc_t *img)
+{
+    return pic_decode_native(fs_path, PIC_FIT_W, PIC_FIT_H, img) || pic_decode_lvgl(fs_path, img);
+}
+
+// 持有缓存锁时调用 找到就返回 文件变了的顺手删掉
+static pic_entry_t *cache_find(const char *fs_path, const struct stat *st)
+{
+    for (int i = 0; i < PIC_CACHE_MAX_ENTRIES; i++)
+    {
+        pic_entry_t *e = &s_entries[i];
+        if (!e->used || e->stale || strcmp(e->path, fs_path) != 0)
+        {
+            continue;
+        }
+        if (e->size == st->st_size && e->mtime == st->st_mtime)
+        {
+            return e;
+        }
+        if (e->pins)
+        {
+            e->stale = true;
+        }
+        else
+        {
+            entry_free(e);
+        }
+    }
+    return NULL;
+}
+
+// 持有缓存锁时调用 放不下时释放img并返回NULL
+static pic_entry_t *cache_insert(const char *fs_path, const struct stat *st, const lv_img_dsc_t *img, uint16_t pins)
+{
+    pic_entry_t *e = cache_make_room(img->data_size);
+    if (e == NULL)
+    {
+        s_stats.uncacheable++;
+        heap_caps_free((void *)img->data);
+        return NULL;
+    }
+    strcpy(e->path, fs_path);
+    e->size = st->st_size;
+    e->mtime = st->st_mtime;
+    e->img = *img;
+    e->pins = pins;
+    e->stamp = ++s_clock;
+    e->used = true;
+    s_stats.entries++;
+    s_stats.bytes += img->data_size;
+    return e;
+}
+
+const lv_img_dsc_t *pic_cache_acquire(const char *fs_path)
+{
+    struct stat st;
+    if (fs_path == NULL || strlen(fs_path) >= PIC_CACHE_PATH_LEN || stat(fs_path, &st) != 0)
+    {
+        return NULL;
+    }
+
+    cache_lock();
+    // 预取任务正好在解这张 等它做完 比再解一遍快
+    if (strcmp(s_loading, fs_path) == 0)
+    {
+        s_stats.waits++;
+        while (strcmp(s_loading, fs_path) == 0)
+        {
+            cache_unlock();
+            vTaskDelay(1);
+            cache_lock();
+        }
+    }
+    pic_entry_t *e = cache_find(fs_path, &st);
+    if (e)
+    {
+        e->pins++;
+        e->stamp = ++s_clock;
+        s_stats.hits++;
+        cache_unlock();
+        return &e->img;
+    }
+    s_stats.misses++;
+    cache_unlock();
+
+    // 解码慢 不占着缓存的锁
+    lv_img_dsc_t img;
+    int64_t t0 = esp_timer_get_time();
+    bool ok = pic_decode(fs_path, &img);
+    int64_t us = esp_timer_get_time() - t0;
+
+    cache_lock();
+    s_stats.decode_us += us;
+    e = NULL;
+    if (ok)
+    {
+        e = cache_insert(fs_path, &st, &img, 1);
+    }
+    else
+    {
+        s_stats.uncacheable++;
+    }
+    cache_unlock();
+    if (e == NULL)
+    {
+        ESP_LOGW(TAG, "%s not cached", fs_path);
+        return NULL;
+    }
+    ESP_LOGI(TAG, "%s %ux%u decoded in %lld ms", fs_path, (unsigned)img.header.w, (unsigned)img.header.h, us / 1000);
+    return &e->img;
+}
+
+void pic_cache_release(const lv_img_dsc_t *img)
+{
+    if (img == NULL)
+    {
+        return;
+    }
+    cache_lock();
+    for (int i = 0; i < PIC_CACHE_MAX_ENTRIES; i++)
+    {
+        pic_entry_t *e = &s_entries[i];
+        if (e->used && &e->img == img && e->pins)
+        {
+            e->pins--;
+            if (e->pins == 0 && e->stale)
+            {
+                entry_free(e);
+            }
+            break;
+        }
+    }
+    cache_unlock();
+}
+
+void pic_cache_clear(void)
+{
+    cache_lock();
+    for (int i = 0; i < PIC_CACHE_MAX_ENTRIES; i++)
+    {
+        if (s_entries[i].used && s_entries[i].pins == 0)
+        {
+            entry_free(&s_entries[i]);
+        }
+    }
+    cache_unlock();
+}
+
+void pic_cache_get_stats(pic_cache_stats_t *stats)
+{
+    cache_lock();
+    *stats = s_stats;
+    cache_unlock();
+}
+
+// 解一张放进缓存 不加引用 已经在缓存里的跳过
+static void prefetch_one(const char *fs_path)
+{
+    struct stat st;
+    if (stat(fs_path, &st) != 0)
+    {
+        return;
+    }
+    cache_lock();
+    bool cached = cache_find(fs_path, &st) != NULL;
+    if (!cached)
+    {
+        strcpy(s_loading, fs_path);
+    }
+    cache_unlock();
+    if (cached)
+    {
+        return;
+    }
+
+    lv_img_dsc_t img;
+    int64_t t0 = esp_timer_get_time();
+    bool ok = pic_decode_native(fs_path, PIC_FIT_W, PIC_FIT_H, &img);
+    if (!ok)
+    {
+        cache_lock();
+        s_loading[0] = '\0';
+        cache_unlock();
+        // PNG等只能用LVGL的解码器 解码期间界面会停住
+        // 持有LVGL锁时界面任务不可能在acquire里等 不用标记s_loading
+        ui_lock(0);
+        ok = pic_decode_lvgl(fs_path, &img);
+        ui_unlock();
+    }
+    int64_t us = esp_timer_get_time() - t0;
+
+    cache_lock();
+    s_loading[0] = '\0';
+    s_stats.decode_us += us;
+    if (ok && cache_insert(fs_path, &st, &img, 0))
+    {
+        s_stats.prefetched++;
+    }
+    cache_unlock();
+}
+
+static void pic_prefetch_task(void *arg)
+{
+    char path[PIC_CACHE_PATH_LEN];
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (int i = 0;; i++)
+        {
+            // 每张开始前看一眼 有新请求就从新请求的第一张重新开始
+            cache_lock();
+            uint32_t gen = s_want_gen;
+            bool more = i < s_want_cnt;
+            if (more)
+            {
+                strcpy(path, s_want[i]);
+            }
+            cache_unlock();
+            if (!more)
+            {
+                break;
+            }
+            prefetch_one(path);
+            cache_lock();
+            if (gen != s_want_gen)
+            {
+                i = -1;
+            }
+            cache_unlock();
+        }
+    }
+}
+
+void pic_cache_prefetch(const char *const *paths, int n)
+{
+    cache_lock();
+    if (s_worker == NULL)
+    {
+        BaseType_t ok = task_plan_create(TASK_PIC_PREFETCH, pic_prefetch_task, NULL, &s_worker);
+        if (ok != pdPASS)
+        {
+            s_worker = NULL;
+            cache_unlock();
+            ESP_LOGE(TAG, "prefetch task create failed");
+            return;
+        }
+    }
+    s_want_cnt = 0;
+    for (int i = 0; i < n && s_want_cnt < PIC_PREFETCH_MAX; i++)
+    {
+        if (paths[i] && strlen(paths[i]) < PIC_CACHE_PATH_LEN)
+        {
+            strcpy(s_want[s_want_cnt++], paths[i]);
+        }
+    }
+    s_want_gen++;
+    cache_unlock();
+    xTaskNotifyGive(s_worker);
+}
+
+bool pic_cache_decode(const char *fs_path, lv_img_dsc_t *img)
+{
+    return pic_cache_decode_fit(fs_path, PIC_FIT_W, PIC_FIT_H, img);
+}
+
+bool pic_cache_decode_fit(const char *fs_path, int max_w, int max_h, lv_img_dsc_t *img)
+{
+    if (pic_decode_native(fs_path, max_w, max_h, img))
+    {
+        return true;
+    }
+    ui_lock(0);
+    bool ok = pic_decode_lvgl(fs_path, img);
+    ui_unlock();
+    return ok;
+}
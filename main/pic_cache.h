@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** 图片解码缓存 ****************************/
+// LV_IMG_CACHE_DEF_SIZE是0 每次重画都要从SD卡重新打开并解码图片
+// 这里把整张图解码成RGB565(带alpha的是RGB565+A8)放进PSRAM 交给lv_img当变量图片
+// 重画直接读内存 不碰文件 缓存按字节预算 满了先删最久没用的 正在显示的不会被删
+// 同一路径文件大小或修改时间变了就重新解码
+// 可以让核0上的任务提前把前后几张解好 BMP自己解码 其他格式借用LVGL的解码器 要拿LVGL锁
+// JPEG默认用tjpgd流式解码 直接缩到PIC_FIT_W x PIC_FIT_H以内 大照片也不会全尺寸放进内存
+
+#ifdef CONFIG_APP_PIC_CACHE_KB
+#define PIC_CACHE_BUDGET        (CONFIG_APP_PIC_CACHE_KB * 1024)
+#else
+#define PIC_CACHE_BUDGET        (2 * 1024 * 1024)
+#endif
+#define PIC_CACHE_MAX_ENTRIES   16
+#define PIC_CACHE_PATH_LEN      128
+#define PIC_FIT_W               320     // JPEG流式解码的最大输出 屏幕大小
+#define PIC_FIT_H               240
+#define PIC_PREFETCH_MAX        4       // 一次最多预取几张
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;                    // 需要解码的次数
+    uint32_t evictions;
+    uint32_t uncacheable;               // 格式不支持或超过预算 只能按文件显示
+    uint32_t prefetched;                // 预取任务解好放进缓存的
+    uint32_t waits;                     // 要显示的正好在预取 等它解完的次数
+    uint32_t streamed;                  // 走JPEG流式解码的
+    uint32_t entries;
+    uint32_t bytes;                     // 当前占用的PSRAM
+    uint64_t decode_us;                 // 所有解码的总耗时
+} pic_cache_stats_t;
+
+// fs_path是VFS路径 比如/sdcard/photo/a.bmp 要在持有LVGL锁时调用 解码用的是LVGL的解码器
+// 返回的图片一直有效 直到对它调用pic_cache_release 失败返回NULL 调用者按文件路径显示
+const lv_img_dsc_t *pic_cache_acquire(const char *fs_path);
+void pic_cache_release(const lv_img_dsc_t *img);
+// 按顺序预取 越可能马上要看的放越前面 会取消还没做完的上一次请求 路径会被复制
+void pic_cache_prefetch(const char *const *paths, int n);
+// 不经过缓存解出整张图 用完heap_caps_free(img->data) 非BMP要拿LVGL锁 不能在持有锁时调用
+bool pic_cache_decode(const char *fs_path, lv_img_dsc_t *img);
+// 同上 JPEG缩到max_w x max_h以内而不是屏幕大小 其他格式按原尺寸
+bool pic_cache_decode_fit(const char *fs_path, int max_w, int max_h, lv_img_dsc_t *img);
+void pic_cache_clear(void);             // 删掉所有没在用的
+void pic_cache_get_stats(pic_cache_stats_t *stats);
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include "pic_jpeg.h"
+#include "mem_pool.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#if CONFIG_JD_USE_ROM
+#include "rom/tjpgd.h"
+typedef unsigned int jpeg_out_t;        // ROM里的tjpgd版本老 回调返回类型不同
+#else
+#include "tjpgd.h"
+typedef int jpeg_out_t;
+#endif
+
+// ROM里固定输出RGB888
+#ifndef JD_FORMAT
+#define JD_FORMAT 0
+#endif
+
+static const char *TAG = "pic_jpeg";
+
+#define JPEG_WORK_SIZE  PIC_JPEG_WORK_SIZE
+#define JPEG_FILE_BUF   4096            // SD卡一次读4KB 比tjpgd每次要的512字节快
+
+typedef struct {
+    FILE *f;                            // 为NULL时从read或者内存里读
+    pic_jpeg_read_t read;
+    pic_jpeg_progress_t progress;
+    void *arg;
+    lv_img_dsc_t *img;
+    const uint8_t *mem;
+    size_t mem_len;
+    size_t mem_pos;
+    lv_color_t *out;
+    uint32_t sw;                        // tjpgd缩小后的尺寸
+    uint32_t sh;
+    uint32_t tw;                        // 输出图尺寸
+    uint32_t th;
+} jpeg_ctx_t;
+
+static unsigned int jpeg_in_cb(JDEC *jd, uint8_t *buf, unsigned int n)
+{
+    jpeg_ctx_t *ctx = jd->device;
+    if (ctx->read)
+    {
+        return ctx->read(ctx->arg, buf, n);
+    }
+    if (ctx->f == NULL)
+    {
+        n = LV_MIN(n, ctx->mem_len - ctx->mem_pos);
+        if (buf)
+        {
+            memcpy(buf, ctx->mem + ctx->mem_pos, n);
+        }
+        ctx->mem_pos += n;
+        return n;
+    }
+    if (buf)
+    {
+        return fread(buf, 1, n, ctx->f);
+    }
+    return fseek(ctx->f, n, SEEK_CUR) == 0 ? n : 0;
+}
+
+// 每次给一个MCU块 坐标是tjpgd缩小后的 输出图更小时按比例落点 多个源点落在同一点时后来的覆盖
+static jpeg_out_t jpeg_out_cb(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    jpeg_ctx_t *ctx = jd->device;
+    const uint8_t *in = bitmap;
+    bool same = ctx->tw == ctx->sw && ctx->th == ctx->sh;
+    for (uint32_t y = rect->top; y <= rect->bottom; y++)
+    {
+        uint32_t dy = same ? y : y * ctx->th / ctx->sh;
+        for (uint32_t x = rect->left; x <= rect->right; x++)
+        {
+#if JD_FORMAT == 0
+            lv_color_t c = lv_color_make(in[0], in[1], in[2]);
+            in += 3;
+#else
+            uint16_t v = in[0] | (in[1] << 8);
+            lv_color_t c = lv_color_make((v >> 8) & 0xF8, (v >> 3) & 0xFC, (v << 3) & 0xF8);
+            in += 2;
+#endif
+            if (x < ctx->sw && y < ctx->sh)
+            {
+                uint32_t dx = same ? x : x * ctx->tw / ctx->sw;
+                ctx->out[dy * ctx->tw + dx] = c;
+            }
+        }
+    }
+    // 一行MCU的最后一块 上面的行都不会再变了
+    if (ctx->progress && rect->right + 1 >= ctx->sw)
+    {
+        uint32_t bottom = LV_MIN(rect->bottom + 1, ctx->sh);
+        ctx->progress(ctx->arg, ctx->img, ctx->tw == ctx->sw && ctx->th == ctx->sh ? bottom : bottom * ctx->th / ctx->sh);
+    }
+    return 1;
+}
+
+// 文件和流共用 ctx里的输入已经准备好
+static bool jpeg_decode(jpeg_ctx_t *ctx, int max_w, int max_h, uint32_t max_bytes, lv_img_dsc_t *img,
+                        pic_jpeg_info_t *info, const char *what)
+{
+    int64_t t0 = esp_timer_get_time();
+    void *work = mem_pool_alloc(MEM_POOL_DECODER, JPEG_WORK_SIZE);
+    JDEC jd;
+    JRESULT res = work ? jd_prepare(&jd, jpeg_in_cb, work, JPEG_WORK_SIZE, ctx) : JDR_MEM1;
+    bool ok = res == JDR_OK;
+
+    uint8_t scale = 0;
+    if (ok)
+    {
+        // 选最小的缩小倍数 让tjpgd输出不超过目标 1/8还大就再抽点
+        while (scale < 3 && ((jd.width >> scale) > (uint32_t)max_w || (jd.height >> scale) > (uint32_t)max_h))
+        {
+            scale++;
+        }
+        ctx->sw = LV_MAX(jd.width >> scale, 1);
+        ctx->sh = LV_MAX(jd.height >> scale, 1);
+        ctx->tw = LV_MIN(ctx->sw, (uint32_t)max_w);
+        ctx->th = LV_MAX(ctx->sh * ctx->tw / ctx->sw, 1);
+        if (ctx->th > (uint32_t)max_h)
+        {
+            ctx->th = max_h;
+            ctx->tw = LV_MAX(ctx->sw * ctx->th / ctx->sh, 1);
+        }
+        uint32_t bytes = ctx->tw * ctx->th * sizeof(lv_color_t);
+        ctx->out = bytes <= max_bytes ? heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+        ok = ctx->out != NULL;
+    }
+    if (ok)
+    {
+        memset(img, 0, sizeof(*img));
+        img->header.cf = LV_IMG_CF_TRUE_COLOR;
+        img->header.w = ctx->tw;
+        img->header.h = ctx->th;
+        img->data_size = ctx->tw * ctx->th * sizeof(lv_color_t);
+        img->data = (const uint8_t *)ctx->out;
+        if (ctx->progress)
+        {
+            // 边下边解的 先给一张黑的 解出来一行显示一行
+            memset(ctx->out, 0, img->data_size);
+            ctx->img = img;
+            ctx->progress(ctx->arg, img, 0);
+        }
+        res = jd_decomp(&jd, jpeg_out_cb, scale);
+        ok = res == JDR_OK;
+    }
+    mem_pool_free(work);
+    if (!ok)
+    {
+        // 边下边解的可能正显示着 解出来的部分留给调用者
+        if (ctx->progress == NULL || ctx->out == NULL)
+        {
+            heap_caps_free(ctx->out);
+            img->data = NULL;
+        }
+        ESP_LOGD(TAG, "%s: tjpgd result %d", what, res);
+        return false;
+    }
+    if (info)
+    {
+        info->src_w = jd.width;
+        info->src_h = jd.height;
+        info->scale = scale;
+        info->decode_us = esp_timer_get_time() - t0;
+    }
+    return true;
+}
+
+bool pic_jpeg_decode(const char *fs_path, int max_w, int max_h, uint32_t max_bytes, lv_img_dsc_t *img, pic_jpeg_info_t *info)
+{
+    jpeg_ctx_t ctx = {0};
+    ctx.f = fopen(fs_path, "rb");
+    if (ctx.f == NULL)
+    {
+        return false;
+    }
+    setvbuf(ctx.f, NULL, _IOFBF, JPEG_FILE_BUF);
+    bool ok = jpeg_decode(&ctx, max_w, max_h, max_bytes, img, info, fs_path);
+    fclose(ctx.f);
+    return ok;
+}
+
+bool pic_jpeg_decode_stream(pic_jpeg_read_t read, pic_jpeg_progress_t progress, void *arg, int max_w, int max_h,
+                            uint32_t max_bytes, lv_img_dsc_t *img, pic_jpeg_info_t *info)
+{
+    jpeg_ctx_t ctx = {
+        .read = read,
+        .progress = progress,
+        .arg = arg,
+    };
+    return jpeg_decode(&ctx, max_w, max_h, max_bytes, img, info, "stream");
+}
+
+bool pic_jpeg_decode_frame(const uint8_t *jpg, size_t len, int w, int h, lv_color_t *out, void *work, pic_jpeg_info_t *info)
+{
+    int64_t t0 = esp_timer_get_time();
+    jpeg_ctx_t ctx = {
+        .mem = jpg,
+        .mem_len = len,
+        .out = out,
+        .tw = w,
+        .th = h,
+    };
+    JDEC jd;
+    JRESULT res = jd_prepare(&jd, jpeg_in_cb, work, JPEG_WORK_SIZE, &ctx);
+    if (res != JDR_OK || jd.width < (uint32_t)w || jd.height < (uint32_t)h)
+    {
+        ESP_LOGD(TAG, "frame: tjpgd result %d", res);
+        return false;
+    }
+    // 和看图相反 选缩小后还能盖满输出的最大倍数 剩下的抽点 每一点都有源
+    uint8_t scale = 0;
+    while (scale < 3 && (jd.width >> (scale + 1)) >= (uint32_t)w && (jd.height >> (scale + 1)) >= (uint32_t)h)
+    {
+        scale++;
+    }
+    ctx.sw = jd.width >> scale;
+    ctx.sh = jd.height >> scale;
+    res = jd_decomp(&jd, jpeg_out_cb, scale);
+    if (res != JDR_OK)
+    {
+        ESP_LOGD(TAG, "frame: tjpgd result %d", res);
+        return false;
+    }
+    if (info)
+    {
+        info->src_w = jd.width;
+        info->src_h = jd.height;
+        info->scale = scale;
+        info->decode_us = esp_timer_get_time() - t0;
+    }
+    return true;
+}
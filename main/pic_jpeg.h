@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** JPEG流式解码 ****************************/
+// 用tjpgd(S3上是ROM里的)边读文件边按MCU解码 同时用它自带的1/2 1/4 1/8缩小
+// 解出来的块直接写进不超过max_w x max_h的RGB565图里 还大就再按比例抽点
+// 峰值内存只有输出图、3KB的工作区和文件缓冲 和照片本身多大没有关系 也不用LVGL锁
+// 渐进式JPEG tjpgd不支持 返回false
+
+#define PIC_JPEG_WORK_SIZE  3100        // tjpgd推荐的工作区 和图片大小无关
+
+typedef struct {
+    uint16_t src_w;                     // 照片原尺寸
+    uint16_t src_h;
+    uint8_t scale;                      // tjpgd缩小 0~3 即1/1到1/8
+    uint32_t decode_us;
+} pic_jpeg_info_t;
+
+// 成功时img->data是PSRAM里的RGB565 用完heap_caps_free max_bytes是输出图允许的最大字节数
+bool pic_jpeg_decode(const char *fs_path, int max_w, int max_h, uint32_t max_bytes, lv_img_dsc_t *img, pic_jpeg_info_t *info);
+// 数据边到边解: read阻塞到有数据 buf为NULL是跳过n字节 返回0表示没有了(断了或者取消) tjpgd就此失败
+// progress在分配好输出图以后先来一次rows=0 之后每解完一行MCU来一次 rows行以上已经是最终的样子
+// img->data在progress第一次来时就能拿去显示 失败时不释放 可能正显示着 不为NULL的由调用者释放
+typedef size_t (*pic_jpeg_read_t)(void *arg, uint8_t *buf, size_t n);
+typedef void (*pic_jpeg_progress_t)(void *arg, const lv_img_dsc_t *img, int rows);
+bool pic_jpeg_decode_stream(pic_jpeg_read_t read, pic_jpeg_progress_t progress, void *arg, int max_w, int max_h,
+                            uint32_t max_bytes, lv_img_dsc_t *img, pic_jpeg_info_t *info);
+// 摄像头的JPEG帧 从内存解成正好w x h 写进调用者的out work是PIC_JPEG_WORK_SIZE的内部RAM 每帧都解时不用反复分配
+// 源图比w x h还小返回false
+bool pic_jpeg_decode_frame(const uint8_t *jpg, size_t len, int w, int h, lv_color_t *out, void *work, pic_jpeg_info_t *info);
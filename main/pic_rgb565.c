@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pic_rgb565.h"
+#include "sd_writer.h"
+#include "sd_dir_cache.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+static const char *TAG = "pic_rgb565";
+
+static bool header_ok(const lv_img_header_t *h)
+{
+    return h->cf == LV_IMG_CF_TRUE_COLOR && h->always_zero == 0 && h->w > 0 && h->h > 0;
+}
+
+esp_err_t pic_rgb565_save(const char *fs_path, const void *pixels, int w, int h)
+{
+    ESP_RETURN_ON_FALSE(pixels && w > 0 && h > 0, ESP_ERR_INVALID_ARG, TAG, "invalid frame");
+    lv_img_header_t hdr = {
+        .cf = LV_IMG_CF_TRUE_COLOR,
+        .w = w,
+        .h = h,
+    };
+    size_t bytes = (size_t)w * h * sizeof(lv_color_t);
+    sd_writer_t *f = sd_writer_open(fs_path, sizeof(hdr) + bytes);
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "open %s failed", fs_path);
+    if (sd_writer_write(f, &hdr, sizeof(hdr)) != ESP_OK || sd_writer_write(f, pixels, bytes) != ESP_OK)
+    {
+        sd_writer_abort(f);
+        ESP_LOGE(TAG, "write %s failed", fs_path);
+        return ESP_FAIL;
+    }
+    if (sd_writer_close(f) != ESP_OK)
+    {
+        unlink(fs_path);    // 写了一半的文件不留
+        sd_dir_cache_changed(fs_path);
+        ESP_LOGE(TAG, "close %s failed", fs_path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool pic_rgb565_load(const char *fs_path, uint32_t max_bytes, lv_img_dsc_t *img)
+{
+    FILE *f = fopen(fs_path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    lv_img_header_t hdr;
+    struct stat st;
+    bool ok = fread(&hdr, 1, sizeof(hdr), f) == sizeof(hdr) && header_ok(&hdr) && fstat(fileno(f), &st) == 0;
+    uint32_t bytes = ok ? hdr.w * hdr.h * sizeof(lv_color_t) : 0;
+    ok = ok && st.st_size >= (off_t)(sizeof(hdr) + bytes) && bytes <= max_bytes;
+    uint8_t *data = ok ? heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    // 像素就是LVGL要的样子 一次读完
+    ok = data && fread(data, 1, bytes, f) == bytes;
+    fclose(f);
+    if (!ok)
+    {
+        heap_caps_free(data);
+        return false;
+    }
+    memset(img, 0, sizeof(*img));
+    img->header = hdr;
+    img->data_size = bytes;
+    img->data = data;
+    return true;
+}
+
+/************ LVGL解码器 文件管理器等直接用"S:"/"A:"路径打开时走这里 按行从文件读 ************/
+static lv_res_t rgb565_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    if (lv_img_src_get_type(src) != LV_IMG_SRC_FILE || strcmp(lv_fs_get_ext(src), PIC_RGB565_EXT) != 0)
+    {
+        return LV_RES_INV;
+    }
+    lv_fs_file_t f;
+    if (lv_fs_open(&f, src, LV_FS_MODE_RD) != LV_FS_RES_OK)
+    {
+        return LV_RES_INV;
+    }
+    uint32_t br = 0;
+    lv_fs_res_t res = lv_fs_read(&f, header, sizeof(*header), &br);
+    lv_fs_close(&f);
+    return res == LV_FS_RES_OK && br == sizeof(*header) && header_ok(header) ? LV_RES_OK : LV_RES_INV;
+}
+
+static lv_res_t rgb565_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    if (dsc->src_type != LV_IMG_SRC_FILE || strcmp(lv_fs_get_ext(dsc->src), PIC_RGB565_EXT) != 0)
+    {
+        return LV_RES_INV;
+    }
+    lv_fs_file_t *f = lv_mem_alloc(sizeof(lv_fs_file_t));
+    if (f == NULL)
+    {
+        return LV_RES_INV;
+    }
+    if (lv_fs_open(f, dsc->src, LV_FS_MODE_RD) != LV_FS_RES_OK)
+    {
+        lv_mem_free(f);
+        return LV_RES_INV;
+    }
+    dsc->user_data = f;
+    dsc->img_data = NULL;
+    return LV_RES_OK;
+}
+
+static lv_res_t rgb565_read_line(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc, lv_coord_t x, lv_coord_t y, lv_coord_t len,
+                                 uint8_t *buf)
+{
+    lv_fs_file_t *f = dsc->user_data;
+    uint32_t pos = sizeof(lv_img_header_t) + ((uint32_t)y * dsc->header.w + x) * sizeof(lv_color_t);
+    uint32_t btr = len * sizeof(lv_color_t);
+    uint32_t br = 0;
+    if (lv_fs_seek(f, pos, LV_FS_SEEK_SET) != LV_FS_RES_OK || lv_fs_read(f, buf, btr, &br) != LV_FS_RES_OK || br != btr)
+    {
+        return LV_RES_INV;
+    }
+    return LV_RES_OK;
+}
+
+static void rgb565_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    lv_fs_file_t *f = dsc->user_data;
+    if (f)
+    {
+        lv_fs_close(f);
+        lv_mem_free(f);
+        dsc->user_data = NULL;
+    }
+}
+
+void pic_rgb565_decoder_init(void)
+{
+    static lv_img_decoder_t *s_decoder;
+    if (s_decoder)
+    {
+        return;
+    }
+    s_decoder = lv_img_decoder_create();
+    lv_img_decoder_set_info_cb(s_decoder, rgb565_info);
+    lv_img_decoder_set_open_cb(s_decoder, rgb565_open);
+    lv_img_decoder_set_read_line_cb(s_decoder, rgb565_read_line);
+    lv_img_decoder_set_close_cb(s_decoder, rgb565_close);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+
+/*********************** 原生RGB565图片格式 ****************************/
+// 文件开头是4字节的lv_img_header_t 后面直接是LVGL字节序(LV_COLOR_16_SWAP)的RGB565像素 逐行从上往下
+// 摄像头帧本来就是这个字节序 拍照直接写盘 显示时整块读进内存就能用 不用任何转换
+// 320x240一张150KB 比24位BMP小三分之一
+
+#define PIC_RGB565_EXT          "rgb565"
+
+esp_err_t pic_rgb565_save(const char *fs_path, const void *pixels, int w, int h);
+// 整张读进PSRAM 用完heap_caps_free(img->data) 超过max_bytes返回false
+bool pic_rgb565_load(const char *fs_path, uint32_t max_bytes, lv_img_dsc_t *img);
+void pic_rgb565_decoder_init(void);     // 注册LVGL解码器 "S:"/"A:"路径的.rgb565也能直接lv_img_set_src 持有LVGL锁时调用
@@ -0,0 +1,444 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pic_thumb.h"
+#include "task_plan.h"
+#include "pic_cache.h"
+#include "ui_msg.h"
+#include "sd_dir_cache.h"
+#include "sd_writer.h"
+#include "mem_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "psram_bw.h"
+
+static const char *TAG = "pic_thumb";
+
+#define THUMB_BYTES     (PIC_THUMB_W * PIC_THUMB_H * sizeof(lv_color_t))
+#define THUMB_HDR_SIZE  66              // 文件头14 信息头40 三个颜色掩码12
+
+typedef struct {
+    char path[PIC_CACHE_PATH_LEN];      // 原图
+    uint16_t dir_len;
+    int tag;
+    uint32_t seq;                       // 0表示没有请求
+    bool pending;                       // 还没被任务取走
+    pic_thumb_ready_cb_t cb;
+} thumb_req_t;
+
+static thumb_req_t s_req[PIC_THUMB_SLOTS];
+static lv_img_dsc_t s_slot_img[PIC_THUMB_SLOTS];
+static uint32_t s_seq;
+static pic_thumb_stats_t s_stats;
+static SemaphoreHandle_t s_mutex;
+static SemaphoreHandle_t s_applied;
+static TaskHandle_t s_worker;
+
+// 任务做好的一张 等LVGL任务拷到对应的slot
+static uint16_t *s_scratch;
+static struct {
+    int slot;
+    uint32_t seq;
+    uint16_t w;
+    uint16_t h;
+} s_done;
+
+static void put16(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+// FNV-1a 文件名、大小和修改时间一起算 照片被替换后对不上
+static uint32_t thumb_key(const char *name, const struct stat *st)
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = name; *p; p++)
+    {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    uint32_t v[2] = {(uint32_t)st->st_size, (uint32_t)st->st_mtime};
+    const uint8_t *b = (const uint8_t *)v;
+    for (size_t i = 0; i < sizeof(v); i++)
+    {
+        h = (h ^ b[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool thumb_read(const char *tpath, uint16_t *w, uint16_t *h)
+{
+    struct stat st;
+    lv_img_dsc_t img;
+    if (stat(tpath, &st) != 0 || !pic_cache_decode(tpath, &img))
+    {
+        return false;
+    }
+    bool ok = img.header.cf == LV_IMG_CF_TRUE_COLOR && img.header.w <= PIC_THUMB_W && img.header.h <= PIC_THUMB_H;
+    if (ok)
+    {
+        memcpy(s_scratch, img.data, img.data_size);
+        *w = img.header.w;
+        *h = img.header.h;
+    }
+    heap_caps_free((void *)img.data);
+    return ok;
+}
+
+// 按面积平均缩小 保持长宽比 比缩略图小的不放大
+static void thumb_scale(const lv_img_dsc_t *src, uint16_t *w, uint16_t *h)
+{
+    uint32_t sw = src->header.w;
+    uint32_t sh = src->header.h;
+    uint32_t px = src->header.cf == LV_IMG_CF_TRUE_COLOR_ALPHA ? LV_IMG_PX_SIZE_ALPHA_BYTE : sizeof(lv_color_t);
+    uint32_t tw = LV_MIN(sw, PIC_THUMB_W);
+    uint32_t th = LV_MAX(sh * tw / sw, 1);
+    if (th > PIC_THUMB_H)
+    {
+        th = PIC_THUMB_H;
+        tw = LV_MAX(sw * th / sh, 1);
+    }
+
+    for (uint32_t ty = 0; ty < th; ty++)
+    {
+        uint32_t y0 = ty * sh / th;
+        uint32_t y1 = LV_MAX((ty + 1) * sh / th, y0 + 1);
+        for (uint32_t tx = 0; tx < tw; tx++)
+        {
+            uint32_t x0 = tx * sw / tw;
+            uint32_t x1 = LV_MAX((tx + 1) * sw / tw, x0 + 1);
+            uint32_t r = 0, g = 0, b = 0;
+            for (uint32_t y = y0; y < y1; y++)
+            {
+                const uint8_t *p = src->data + (y * sw + x0) * px;
+                for (uint32_t x = x0; x < x1; x++, p += px)
+                {
+                    lv_color_t c;
+                    memcpy(&c, p, sizeof(c));
+                    r += LV_COLOR_GET_R(c);
+                    g += LV_COLOR_GET_G(c);
+                    b += LV_COLOR_GET_B(c);
+                }
+            }
+            uint32_t n = (y1 - y0) * (x1 - x0);
+            lv_color_t c;
+            LV_COLOR_SET_R(c, r / n);
+            LV_COLOR_SET_G(c, g / n);
+            LV_COLOR_SET_B(c, b / n);
+            s_scratch[ty * tw + tx] = c.full;
+        }
+    }
+    *w = tw;
+    *h = th;
+}
+
+// 16位565 BMP 高度写负数表示从上往下存 宽是偶数时每行不用补齐
+static bool thumb_write(const char *tpath, uint16_t w, uint16_t h)
+{
+    uint32_t row_bytes = (w * 2 + 3) & ~3u;
+    uint8_t hdr[THUMB_HDR_SIZE] = {'B', 'M'};
+    put32(hdr + 2, THUMB_HDR_SIZE + row_bytes * h);
+    put32(hdr + 10, THUMB_HDR_SIZE);
+    put32(hdr + 14, 40);
+    put32(hdr + 18, w);
+    put32(hdr + 22, (uint32_t)-(int32_t)h);
+    put16(hdr + 26, 1);
+    put16(hdr + 28, 16);
+    put32(hdr + 30, 3);
+    put32(hdr + 34, row_bytes * h);
+    put32(hdr + 54, 0xF800);
+    put32(hdr + 58, 0x07E0);
+    put32(hdr + 62, 0x001F);
+
+    sd_writer_t *f = sd_writer_open(tpath, sizeof(hdr) + row_bytes * h);
+    if (f == NULL)
+    {
+        return false;
+    }
+    bool ok = sd_writer_write(f, hdr, sizeof(hdr)) == ESP_OK;
+    uint8_t row[PIC_THUMB_W * 2 + 4] = {0};
+    for (uint16_t y = 0; y < h && ok; y++)
+    {
+        for (uint16_t x = 0; x < w; x++)
+        {
+            lv_color_t c = {.full = s_scratch[y * w + x]};
+            put16(row + x * 2, (LV_COLOR_GET_R(c) << 11) | (LV_COLOR_GET_G(c) << 5) | LV_COLOR_GET_B(c));
+        }
+        ok = sd_writer_write(f, row, row_bytes) == ESP_OK;
+    }
+    if (!ok)
+    {
+        sd_writer_abort(f);
+        return false;
+    }
+    // 一行一行交进去的 写卡模块攒成整块才写
+    if (sd_writer_close(f) != ESP_OK)
+    {
+        unlink(tpath);
+        sd_dir_cache_changed(tpath);
+        return false;
+    }
+    return true;
+}
+
+// 先找.thumbs里有没有 没有就解原图生成并存下来 结果在s_scratch
+static bool thumb_load(const char *path, uint16_t dir_len, uint16_t *w, uint16_t *h)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        return false;
+    }
+    char tpath[PIC_CACHE_PATH_LEN];
+    snprintf(tpath, sizeof(tpath), "%.*s/" PIC_THUMB_DIR "/%08lx.bmp", dir_len, path,
+             (unsigned long)thumb_key(path + dir_len + 1, &st));
+
+    int64_t t0 = esp_timer_get_time();
+    if (thumb_read(tpath, w, h))
+    {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+        s_stats.loaded++;
+        s_stats.load_us += esp_timer_get_time() - t0;
+        xSemaphoreGive(s_mutex);
+        return true;
+    }
+
+    lv_img_dsc_t img;
+    if (!pic_cache_decode(path, &img))
+    {
+        return false;
+    }
+    thumb_scale(&img, w, h);
+    heap_caps_free((void *)img.data);
+
+    char dir[PIC_CACHE_PATH_LEN];
+    snprintf(dir, sizeof(dir), "%.*s/" PIC_THUMB_DIR, dir_len, path);
+    bool made = mkdir(dir, 0775) == 0;
+    if (made)
+    {
+        sd_dir_cache_changed(dir);  // 图片目录里多了.thumbs
+    }
+    if (!made && errno != EEXIST)
+    {
+        ESP_LOGW(TAG, "mkdir %s failed", dir);
+    }
+    else if (!thumb_write(tpath, *w, *h))
+    {
+        ESP_LOGW(TAG, "write %s failed", tpath);
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_stats.generated++;
+    s_stats.gen_us += esp_timer_get_time() - t0;
+    xSemaphoreGive(s_mutex);
+    return true;
+}
+
+// LVGL任务里执行 把做好的一张拷到slot自己的缓冲 再通知调用者
+static void thumb_apply(void *arg)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    int slot = s_done.slot;
+    thumb_req_t *r = &s_req[slot];
+    lv_img_dsc_t *img = &s_slot_img[slot];
+    bool ok = r->seq == s_done.seq && r->cb;
+    if (ok && img->data == NULL)
+    {
+        img->data = mem_pool_alloc(MEM_POOL_UI, THUMB_BYTES);
+        ok = img->data != NULL;
+    }
+    pic_thumb_ready_cb_t cb = r->cb;
+    int tag = r->tag;
+    if (ok)
+    {
+        img->header.cf = LV_IMG_CF_TRUE_COLOR;
+        img->header.w = s_done.w;
+        img->header.h = s_done.h;
+        img->data_size = s_done.w * s_done.h * sizeof(lv_color_t);
+        memcpy((void *)img->data, s_scratch, img->data_size);
+        r->seq = 0;
+    }
+    else
+    {
+        s_stats.canceled++;
+    }
+    xSemaphoreGive(s_mutex);
+    xSemaphoreGive(s_applied);
+    if (ok)
+    {
+        cb(slot, tag, img);
+    }
+}
+
+static void pic_thumb_task(void *arg)
+{
+    char path[PIC_CACHE_PATH_LEN];
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (true)
+        {
+            // 先来先做 格子是从上往下绑定的 上面的先出来
+            xSemaphoreTake(s_mutex, portMAX_DELAY);
+            int slot = -1;
+            for (int i = 0; i < PIC_THUMB_SLOTS; i++)
+            {
+                if (s_req[i].pending && (slot < 0 || s_req[i].seq < s_req[slot].seq))
+                {
+                    slot = i;
+                }
+            }
+            if (slot < 0)
+            {
+                xSemaphoreGive(s_mutex);
+                break;
+            }
+            thumb_req_t *r = &s_req[slot];
+            r->pending = false;
+            uint32_t seq = r->seq;
+            uint16_t dir_len = r->dir_len;
+            strcpy(path, r->path);
+            xSemaphoreGive(s_mutex);
+
+            psram_bw_yield(); // 后台解码大图 摄像头和音频吃紧时先等等
+            uint16_t w, h;
+            bool ok = thumb_load(path, dir_len, &w, &h);
+
+            xSemaphoreTake(s_mutex, portMAX_DELAY);
+            bool current = r->seq == seq;
+            if (!ok)
+            {
+                s_stats.failed++;
+            }
+            else if (!current)
+            {
+                s_stats.canceled++;
+            }
+            s_done.slot = slot;
+            s_done.seq = seq;
+            s_done.w = w;
+            s_done.h = h;
+            xSemaphoreGive(s_mutex);
+            if (!ok)
+            {
+                ESP_LOGW(TAG, "no thumbnail for %s", path);
+            }
+            // LVGL任务拷走之前s_scratch不能被下一张覆盖
+            else if (current && ui_post_call(thumb_apply, NULL))
+            {
+                xSemaphoreTake(s_applied, portMAX_DELAY);
+            }
+        }
+    }
+}
+
+static bool thumb_start(void)
+{
+    if (s_worker)
+    {
+        return true;
+    }
+    s_scratch = mem_pool_alloc(MEM_POOL_UI, THUMB_BYTES);
+    s_applied = xSemaphoreCreateBinary();
+    if (s_scratch == NULL || s_applied == NULL ||
+        task_plan_create(TASK_PIC_THUMB, pic_thumb_task, NULL, &s_worker) != pdPASS)
+    {
+        ESP_LOGE(TAG, "thumbnail task start failed");
+        mem_pool_free(s_scratch);
+        s_scratch = NULL;
+        if (s_applied)
+        {
+            vSemaphoreDelete(s_applied);
+            s_applied = NULL;
+        }
+        s_worker = NULL;
+        return false;
+    }
+    return true;
+}
+
+void pic_thumb_request(int slot, int tag, const char *dir, const char *name, pic_thumb_ready_cb_t cb)
+{
+    if (slot < 0 || slot >= PIC_THUMB_SLOTS)
+    {
+        return;
+    }
+    if (s_mutex == NULL)
+    {
+        s_mutex = xSemaphoreCreateMutex();
+    }
+    if (!thumb_start())
+    {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    thumb_req_t *r = &s_req[slot];
+    int n = snprintf(r->path, sizeof(r->path), "%s/%s", dir, name);
+    if (n <= 0 || n >= (int)sizeof(r->path))
+    {
+        r->seq = 0;
+        r->pending = false;
+        xSemaphoreGive(s_mutex);
+        return;
+    }
+    r->dir_len = strlen(dir);
+    r->tag = tag;
+    r->cb = cb;
+    r->seq = ++s_seq;
+    r->pending = true;
+    s_stats.requests++;
+    xSemaphoreGive(s_mutex);
+    xTaskNotifyGive(s_worker);
+}
+
+void pic_thumb_cancel(int slot)
+{
+    if (s_mutex == NULL || slot < 0 || slot >= PIC_THUMB_SLOTS)
+    {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    s_req[slot].seq = 0;
+    s_req[slot].pending = false;
+    xSemaphoreGive(s_mutex);
+}
+
+void pic_thumb_release_all(void)
+{
+    if (s_mutex == NULL)
+    {
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (int i = 0; i < PIC_THUMB_SLOTS; i++)
+    {
+        s_req[i].seq = 0;
+        s_req[i].pending = false;
+        mem_pool_free((void *)s_slot_img[i].data);
+        memset(&s_slot_img[i], 0, sizeof(s_slot_img[i]));
+    }
+    xSemaphoreGive(s_mutex);
+}
+
+void pic_thumb_get_stats(pic_thumb_stats_t *stats)
+{
+    if (s_mutex == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *stats = s_stats;
+    xSemaphoreGive(s_mutex);
+}
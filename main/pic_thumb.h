@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** 图片缩略图 ****************************/
+// 每张照片只在第一次需要时解码整张图 缩成不超过96x72的RGB565 存到同目录下的.thumbs里
+// 缩略图文件是从上往下存的16位565 BMP 和拍照的BMP一样不用LVGL解码器就能读 名字由文件名+大小+修改时间算出
+// 照片被替换后名字对不上 自然会重新生成 加载和生成都在核0上的任务里做 不卡界面
+
+#define PIC_THUMB_W             96
+#define PIC_THUMB_H             72
+#define PIC_THUMB_DIR           ".thumbs"
+#define PIC_THUMB_SLOTS         20      // 同时显示的缩略图 每个占一块PSRAM
+
+// 在LVGL任务里调用 thumb在同一个slot下一次回调或pic_thumb_release_all之前有效
+typedef void (*pic_thumb_ready_cb_t)(int slot, int tag, const lv_img_dsc_t *thumb);
+
+typedef struct {
+    uint32_t requests;
+    uint32_t loaded;                    // 从.thumbs读出来的
+    uint32_t generated;                 // 解码原图新生成的
+    uint32_t failed;                    // 原图解不了或太大
+    uint32_t canceled;                  // 做完之前格子已经换了内容
+    uint64_t load_us;
+    uint64_t gen_us;
+} pic_thumb_stats_t;
+
+// 让slot显示dir下的name 同一slot还没做的旧请求被替换掉 tag原样传回回调 用来核对
+void pic_thumb_request(int slot, int tag, const char *dir, const char *name, pic_thumb_ready_cb_t cb);
+void pic_thumb_cancel(int slot);
+void pic_thumb_release_all(void);       // 取消所有请求 释放显示用的内存 在LVGL任务里调用
+void pic_thumb_get_stats(pic_thumb_stats_t *stats);
@@ -0,0 +1,433 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "playlist.h"
+#include "media_lib.h"
+#include "sd_dir_cache.h"
+#include "esp32_s3_szp.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "playlist";
+
+#define PL_CAPS             (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+static uint32_t *s_ids;                 // 媒体库的文件编号 s_ids为NULL表示没有打开的列表
+static uint32_t s_count, s_cap;
+static char s_path[PLAYLIST_PATH_LEN];
+static char s_dir[PLAYLIST_PATH_LEN];   // 列表文件所在的目录 相对路径从这里算
+static uint32_t s_layout;               // 建表时媒体库的布局签名
+static playlist_stats_t s_stats;
+static SemaphoreHandle_t s_mutex;
+
+static void pl_lock(void)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+}
+
+static void pl_unlock(void)
+{
+    xSemaphoreGive(s_mutex);
+}
+
+// 列表里的一行转成VFS路径 .和..就地化简
+static bool pl_resolve(const char *dir, const char *line, char *out, size_t len)
+{
+    char tmp[PLAYLIST_PATH_LEN * 2];
+    if (strstr(line, "://"))
+    {
+        return false; // 网络地址不进表
+    }
+    if (isalpha((unsigned char)line[0]) && line[1] == ':')
+    {
+        line += 2; // Windows盘符 当作卡的根目录
+    }
+    size_t mp = strlen(SD_MOUNT_POINT);
+    int n;
+    if (line[0] == '/' || line[0] == '\\')
+    {
+        bool vfs = strncmp(line, SD_MOUNT_POINT, mp) == 0 && (line[mp] == '/' || line[mp] == '\\');
+        n = snprintf(tmp, sizeof(tmp), "%s%s", vfs ? "" : SD_MOUNT_POINT, line);
+    }
+    else
+    {
+        n = snprintf(tmp, sizeof(tmp), "%s/%s", dir, line);
+    }
+    if (n < 0 || n >= (int)sizeof(tmp))
+    {
+        return false;
+    }
+
+    size_t o = 0;
+    for (const char *p = tmp; *p;)
+    {
+        while (*p == '/' || *p == '\\')
+        {
+            p++;
+        }
+        size_t seg = strcspn(p, "/\\");
+        if (seg == 0)
+        {
+            break;
+        }
+        if (seg == 2 && p[0] == '.' && p[1] == '.')
+        {
+            while (o > 0 && out[--o] != '/')
+            {
+            }
+        }
+        else if (seg != 1 || p[0] != '.')
+        {
+            if (o + 1 + seg >= len)
+            {
+                return false;
+            }
+            out[o++] = '/';
+            memcpy(out + o, p, seg);
+            o += seg;
+        }
+        p += seg;
+    }
+    out[o] = '\0';
+    return o > 0;
+}
+
+// 曲目路径写进列表文件时的样子 在列表目录下的写相对路径 别的写卡上的绝对路径 换一台机器也能用
+static void pl_entry_text(const char *dir, const char *track, char *out, size_t len)
+{
+    size_t n = strlen(dir);
+    size_t mp = strlen(SD_MOUNT_POINT);
+    if (strncasecmp(track, dir, n) == 0 && track[n] == '/')
+    {
+        strlcpy(out, track + n + 1, len);
+    }
+    else if (strncmp(track, SD_MOUNT_POINT, mp) == 0 && track[mp] == '/')
+    {
+        strlcpy(out, track + mp, len);
+    }
+    else
+    {
+        strlcpy(out, track, len);
+    }
+}
+
+static void pl_dir_of(const char *path, char *dir, size_t len)
+{
+    strlcpy(dir, path, len);
+    char *slash = strrchr(dir, '/');
+    if (slash)
+    {
+        *slash = '\0';
+    }
+}
+
+// 持有锁时调用
+static bool pl_push(uint32_t id)
+{
+    if (s_count == s_cap)
+    {
+        if (s_cap >= PLAYLIST_MAX_ENTRIES)
+        {
+            s_stats.truncated++;
+            return false;
+        }
+        uint32_t cap = s_cap * 2;
+        cap = cap > PLAYLIST_MAX_ENTRIES ? PLAYLIST_MAX_ENTRIES : cap;
+        uint32_t *ids = heap_caps_realloc(s_ids, cap * sizeof(uint32_t), PL_CAPS);
+        if (ids == NULL)
+        {
+            s_stats.truncated++;
+            return false;
+        }
+        s_ids = ids;
+        s_cap = cap;
+    }
+    s_ids[s_count++] = id;
+    return true;
+}
+
+// 持有锁时调用
+static void pl_drop(uint32_t index)
+{
+    memmove(s_ids + index, s_ids + index + 1, (s_count - index - 1) * sizeof(uint32_t));
+    s_count--;
+}
+
+// 持有锁时调用 从头读列表文件重建编号表
+static void pl_parse(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    s_layout = media_lib_layout();
+    s_count = 0;
+    s_stats.missing = 0;
+    s_stats.removed = 0;
+    s_stats.truncated = 0;
+    FILE *fp = fopen(s_path, "r");
+    if (fp == NULL)
+    {
+        ESP_LOGW(TAG, "unable to read %s", s_path);
+        s_stats.entries = 0;
+        return;
+    }
+    char line[PLAYLIST_LINE_LEN];
+    char path[PLAYLIST_PATH_LEN];
+    bool first = true;
+    while (fgets(line, sizeof(line), fp))
+    {
+        size_t n = strlen(line);
+        if (n == sizeof(line) - 1 && line[n - 1] != '\n')
+        {
+            // 太长的行整行跳过
+            int c;
+            while ((c = fgetc(fp)) != EOF && c != '\n')
+            {
+            }
+            first = false;
+            continue;
+        }
+        while (n > 0 && isspace((unsigned char)line[n - 1]))
+        {
+            line[--n] = '\0';
+        }
+        char *p = line;
+        if (first && strncmp(p, "\xEF\xBB\xBF", 3) == 0)
+        {
+            p += 3;
+        }
+        first = false;
+        while (*p == ' ' || *p == '\t')
+        {
+            p++;
+        }
+        if (strncmp(p, PLAYLIST_REMOVE_TAG, sizeof(PLAYLIST_REMOVE_TAG) - 1) == 0)
+        {
+            uint32_t id = pl_resolve(s_dir, p + sizeof(PLAYLIST_REMOVE_TAG) - 1, path, sizeof(path))
+                              ? media_lib_file_id(path)
+                              : MEDIA_LIB_NO_ID;
+            for (uint32_t i = s_count; id != MEDIA_LIB_NO_ID && i-- > 0;)
+            {
+                if (s_ids[i] == id)
+                {
+                    pl_drop(i);
+                    s_stats.removed++;
+                    break;
+                }
+            }
+            continue;
+        }
+        if (*p == '\0' || *p == '#')
+        {
+            continue;
+        }
+        uint32_t id = pl_resolve(s_dir, p, path, sizeof(path)) ? media_lib_file_id(path) : MEDIA_LIB_NO_ID;
+        if (id == MEDIA_LIB_NO_ID)
+        {
+            s_stats.missing++;
+            continue;
+        }
+        pl_push(id);
+    }
+    fclose(fp);
+    s_stats.entries = s_count;
+    s_stats.parses++;
+    s_stats.last_parse_ms = (esp_timer_get_time() - t0) / 1000;
+    ESP_LOGI(TAG, "%s: %lu tracks, %lu missing, %lu removed in %lu ms", s_path, (unsigned long)s_count,
+             (unsigned long)s_stats.missing, (unsigned long)s_stats.removed, (unsigned long)s_stats.last_parse_ms);
+}
+
+// 持有锁时调用 卡上的目录或文件名变过 编号可能已经不对了 重新读一遍
+static void pl_check(void)
+{
+    uint32_t layout = media_lib_layout();
+    if (s_ids && layout && layout != s_layout)
+    {
+        ESP_LOGI(TAG, "media library layout changed, rereading");
+        pl_parse();
+    }
+}
+
+// 在列表文件末尾加一行 原来最后一行没换行先补上 新建的.m3u8先写文件头
+static esp_err_t pl_write_line(const char *file, const char *prefix, const char *text)
+{
+    FILE *fp = fopen(file, "a+");
+    if (fp == NULL)
+    {
+        ESP_LOGW(TAG, "unable to write %s", file);
+        return ESP_FAIL;
+    }
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    bool newline = false;
+    if (size > 0 && fseek(fp, -1, SEEK_END) == 0)
+    {
+        newline = fgetc(fp) != '\n';
+        fseek(fp, 0, SEEK_END); // 读完换写之间要定位一次
+    }
+    int n = 0;
+    if (size <= 0)
+    {
+        n |= fputs("#EXTM3U\n", fp) < 0;
+    }
+    n |= fprintf(fp, "%s%s%s\n", newline ? "\n" : "", prefix, text) < 0;
+    n |= fclose(fp) != 0;
+    sd_dir_cache_changed(file);
+    s_stats.appends++;
+    return n ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t playlist_open(const char *path)
+{
+    if (s_mutex == NULL && (s_mutex = xSemaphoreCreateMutex()) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!media_lib_ready())
+    {
+        ESP_LOGW(TAG, "media library not ready");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (strlen(path) >= sizeof(s_path))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pl_lock();
+    heap_caps_free(s_ids);
+    s_ids = heap_caps_malloc(256 * sizeof(uint32_t), PL_CAPS);
+    s_cap = s_ids ? 256 : 0;
+    s_count = 0;
+    esp_err_t ret = s_ids ? ESP_OK : ESP_ERR_NO_MEM;
+    if (ret == ESP_OK)
+    {
+        strlcpy(s_path, path, sizeof(s_path));
+        pl_dir_of(path, s_dir, sizeof(s_dir));
+        pl_parse();
+    }
+    pl_unlock();
+    return ret;
+}
+
+void playlist_close(void)
+{
+    if (s_mutex == NULL)
+    {
+        return;
+    }
+    pl_lock();
+    heap_caps_free(s_ids);
+    s_ids = NULL;
+    s_count = s_cap = 0;
+    s_stats.entries = 0;
+    pl_unlock();
+}
+
+bool playlist_active(void)
+{
+    return s_ids != NULL;
+}
+
+bool playlist_is_open(const char *path)
+{
+    if (s_mutex == NULL)
+    {
+        return false;
+    }
+    pl_lock();
+    bool open = s_ids && strcasecmp(s_path, path) == 0;
+    pl_unlock();
+    return open;
+}
+
+int playlist_count(void)
+{
+    if (s_mutex == NULL)
+    {
+        return 0;
+    }
+    pl_lock();
+    pl_check();
+    int n = s_count;
+    pl_unlock();
+    return n;
+}
+
+bool playlist_path(int index, char *out, size_t len)
+{
+    if (s_mutex == NULL)
+    {
+        return false;
+    }
+    pl_lock();
+    pl_check();
+    bool ok = s_ids && index >= 0 && (uint32_t)index < s_count && media_lib_file_path(s_ids[index], out, len);
+    pl_unlock();
+    return ok;
+}
+
+esp_err_t playlist_append(const char *playlist, const char *track)
+{
+    if (s_mutex == NULL && (s_mutex = xSemaphoreCreateMutex()) == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t id = media_lib_file_id(track);
+    if (id == MEDIA_LIB_NO_ID)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    char dir[PLAYLIST_PATH_LEN];
+    char text[PLAYLIST_PATH_LEN];
+    pl_dir_of(playlist, dir, sizeof(dir));
+    pl_entry_text(dir, track, text, sizeof(text));
+    pl_lock();
+    esp_err_t ret = pl_write_line(playlist, "", text);
+    if (ret == ESP_OK && s_ids && strcasecmp(s_path, playlist) == 0)
+    {
+        pl_push(id);
+        s_stats.entries = s_count;
+    }
+    pl_unlock();
+    ESP_LOGI(TAG, "%s += %s", playlist, text);
+    return ret;
+}
+
+esp_err_t playlist_remove(int index)
+{
+    if (s_mutex == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    char track[PLAYLIST_PATH_LEN];
+    char text[PLAYLIST_PATH_LEN];
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+    pl_lock();
+    if (s_ids && index >= 0 && (uint32_t)index < s_count && media_lib_file_path(s_ids[index], track, sizeof(track)))
+    {
+        pl_entry_text(s_dir, track, text, sizeof(text));
+        ret = pl_write_line(s_path, PLAYLIST_REMOVE_TAG, text);
+        if (ret == ESP_OK)
+        {
+            pl_drop(index);
+            s_stats.entries = s_count;
+            ESP_LOGI(TAG, "%s -= %s", s_path, text);
+        }
+    }
+    pl_unlock();
+    return ret;
+}
+
+void playlist_get_stats(playlist_stats_t *stats)
+{
+    if (s_mutex == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    pl_lock();
+    *stats = s_stats;
+    pl_unlock();
+}
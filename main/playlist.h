@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** .m3u/.m3u8播放列表 ****************************/
+// 打开时把列表文件读一遍 每一行换成媒体库的文件编号 存成一张编号表 之后按序号取路径是O(1) 不再读文件
+// 一万首的列表表只占40KB 放PSRAM 上一首下一首和随机播放都直接按序号查表
+// 相对路径相对列表文件所在的目录 绝对路径是卡上的路径 反斜杠 Windows盘符 .和..都认 #开头的行跳过
+// 网络地址和卡上找不到的行记在missing里 卡上的目录和文件名变了(媒体库的布局签名变了)下次取路径时重新读一遍
+// 改列表只往文件末尾追加 加一首追加一行路径 删一首追加一行PLAYLIST_REMOVE_TAG加路径 读的时候去掉它前面最后一个同样的曲目
+// 别的播放器把删除行当注释 列表里同一首出现多次时删的是最后一个 不一定是点的那一个
+// 同一时间只打开一个列表 路径按UTF-8处理
+
+#define PLAYLIST_MAX_ENTRIES    CONFIG_APP_PLAYLIST_MAX_ENTRIES
+#define PLAYLIST_PATH_LEN       256
+#define PLAYLIST_LINE_LEN       320     // 比这更长的行跳过
+#define PLAYLIST_REMOVE_TAG     "#X-REMOVE:"
+#define PLAYLIST_FAVORITES      "/sdcard/music/favorites.m3u8"  // 音乐界面长按曲目加到这里
+
+typedef struct {
+    uint32_t entries;                   // 表里现在的曲目数
+    uint32_t missing;                   // 最近一次读文件时没找到的行
+    uint32_t removed;                   // 最近一次读文件时删除行去掉的
+    uint32_t truncated;                 // 超过PLAYLIST_MAX_ENTRIES丢掉的
+    uint32_t parses;
+    uint32_t last_parse_ms;
+    uint32_t appends;                   // 累计追加的行
+} playlist_stats_t;
+
+// 读列表文件建编号表 原来打开的关掉 媒体库还没准备好返回ESP_ERR_INVALID_STATE
+esp_err_t playlist_open(const char *path);
+void playlist_close(void);
+bool playlist_active(void);
+bool playlist_is_open(const char *path);    // 打开的是不是这个文件 不分大小写
+int playlist_count(void);
+bool playlist_path(int index, char *out, size_t len);   // 第index首的VFS路径
+// 在playlist文件末尾加一首 文件不存在就新建 就是打开的那个列表时表也跟着长
+// track要在媒体库里 不在返回ESP_ERR_NOT_FOUND
+esp_err_t playlist_append(const char *playlist, const char *track);
+esp_err_t playlist_remove(int index);   // 从打开的列表里删掉第index首
+void playlist_get_stats(playlist_stats_t *stats);
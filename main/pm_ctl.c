@@ -0,0 +1,224 @@
+#include <string.h>
+#include "pm_ctl.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+#include "esp_sleep.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_freertos_hooks.h"
+#include "esp_log.h"
+#include "standby.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+static const char *TAG = "pm_ctl";
+
+// 自动浅睡要调度器的tickless空闲
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE && CONFIG_APP_PM_LIGHT_SLEEP
+#define PM_LIGHT_SLEEP  1
+#else
+#define PM_LIGHT_SLEEP  0
+#endif
+
+static const char *const s_names[PM_STATE_COUNT] = {"camera", "audio", "voice", "ui", "low", "standby"};
+static const uint32_t s_ma[PM_STATE_COUNT] = {
+    CONFIG_APP_PM_CAMERA_MA,
+    CONFIG_APP_PM_AUDIO_MA,
+    CONFIG_APP_PM_AUDIO_MA,
+    CONFIG_APP_PM_UI_MA,
+    CONFIG_APP_PM_LOW_MA,
+    CONFIG_APP_PM_STANDBY_MA,
+};
+
+static bool s_held[PM_CLIENT_COUNT];
+static bool s_standby;
+static int s_state = PM_STATE_LOW;
+static int64_t s_since_us;              // 进入现在这个状态的时间
+static pm_ctl_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t s_ui_timer;
+static volatile uint32_t s_idle_wakeups[2];
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t s_pm_locks[PM_CLIENT_COUNT];
+#endif
+
+// 在锁里调
+static void state_update(int64_t now)
+{
+    int state = PM_STATE_LOW;
+    for (int i = 0; i < PM_CLIENT_COUNT; i++)
+    {
+        if (s_held[i])
+        {
+            state = i;
+            break;
+        }
+    }
+    if (state == PM_STATE_LOW && s_standby)
+    {
+        state = PM_STATE_STANDBY;
+    }
+    s_stats.ms[s_state] += (now - s_since_us) / 1000;
+    s_since_us = now - (now - s_since_us) % 1000; // 不满1ms的留给下一段
+    s_state = state;
+}
+
+void pm_ctl_set(pm_client_t client, bool on)
+{
+    if (client >= PM_CLIENT_COUNT)
+    {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    bool acquired = false;
+    // 锁的计数和s_held要一起改 拿和放在中断里也能调 放在临界区里
+    portENTER_CRITICAL(&s_lock);
+    if (s_held[client] != on)
+    {
+        acquired = on;
+        s_held[client] = on;
+        s_stats.acquires[client] += on;
+        state_update(now);
+#if CONFIG_PM_ENABLE
+        if (s_pm_locks[client] && on)
+        {
+            esp_pm_lock_acquire(s_pm_locks[client]);
+        }
+        else if (s_pm_locks[client])
+        {
+            esp_pm_lock_release(s_pm_locks[client]);
+        }
+#endif
+    }
+    portEXIT_CRITICAL(&s_lock);
+#if CONFIG_APP_STANDBY
+    if (acquired && client != PM_CLIENT_UI)
+    {
+        standby_client_wake(); // 要干活了 待机着就退出来
+    }
+#endif
+}
+
+void pm_ctl_standby(bool on)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_standby = on;
+    state_update(now);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 返回true 空闲任务调完就等中断 所以每调一次就是核被叫醒过一次
+static bool idle_hook_core0(void)
+{
+    s_idle_wakeups[0]++;
+    return true;
+}
+
+static bool idle_hook_core1(void)
+{
+    s_idle_wakeups[1]++;
+    return true;
+}
+
+static void ui_timer_cb(void *arg)
+{
+    pm_ctl_set(PM_CLIENT_UI, false);
+}
+
+void pm_ctl_ui_busy(void)
+{
+    pm_ctl_set(PM_CLIENT_UI, true);
+    if (s_ui_timer && esp_timer_restart(s_ui_timer, PM_UI_HOLD_MS * 1000ULL) != ESP_OK)
+    {
+        esp_timer_start_once(s_ui_timer, PM_UI_HOLD_MS * 1000ULL);
+    }
+}
+
+void pm_ctl_touch_wake(uint32_t latency_us)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (s_state >= PM_STATE_LOW)
+    {
+        s_stats.wakes++;
+        s_stats.wake_us_total += latency_us;
+        if (latency_us > s_stats.wake_us_max)
+        {
+            s_stats.wake_us_max = latency_us;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t pm_ctl_init(void)
+{
+    if (s_ui_timer)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_since_us = esp_timer_get_time();
+    const esp_timer_create_args_t args = {
+        .callback = ui_timer_cb,
+        .name = "pm_ui",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_ui_timer), TAG, "ui timer create failed");
+#if CONFIG_PM_ENABLE
+    for (int i = 0; i < PM_CLIENT_COUNT; i++)
+    {
+        ESP_RETURN_ON_ERROR(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, s_names[i], &s_pm_locks[i]), TAG,
+                            "pm lock failed");
+    }
+#endif
+    ESP_RETURN_ON_ERROR(esp_register_freertos_idle_hook_for_cpu(idle_hook_core0, 0), TAG, "idle hook failed");
+    ESP_RETURN_ON_ERROR(esp_register_freertos_idle_hook_for_cpu(idle_hook_core1, 1), TAG, "idle hook failed");
+    pm_ctl_set(PM_CLIENT_UI, true); // 开机全速 主界面出来以后没人碰才放
+#if CONFIG_PM_ENABLE
+    const esp_pm_config_t pm = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = PM_MIN_MHZ,
+        .light_sleep_enable = PM_LIGHT_SLEEP,
+    };
+    ESP_RETURN_ON_ERROR(esp_pm_configure(&pm), TAG, "pm configure failed");
+#if PM_LIGHT_SLEEP
+    // 串口收到字符叫醒 浅睡时按的第一个键会丢
+    uart_set_wakeup_threshold(CONFIG_ESP_CONSOLE_UART_NUM, 3);
+    esp_sleep_enable_uart_wakeup(CONFIG_ESP_CONSOLE_UART_NUM);
+#endif
+    s_stats.light_sleep = PM_LIGHT_SLEEP;
+    ESP_LOGI(TAG, "%d MHz when busy, %d MHz%s otherwise", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, PM_MIN_MHZ,
+             PM_LIGHT_SLEEP ? " with light sleep" : "");
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off, CPU stays at %d MHz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#endif
+    return ESP_OK;
+}
+
+bool pm_ctl_held(pm_client_t client)
+{
+    return client < PM_CLIENT_COUNT && s_held[client];
+}
+
+const char *pm_ctl_state_name(int state)
+{
+    return state >= 0 && state < PM_STATE_COUNT ? s_names[state] : "";
+}
+
+void pm_ctl_get_stats(pm_ctl_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    state_update(now);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    stats->idle_wakeups[0] = s_idle_wakeups[0];
+    stats->idle_wakeups[1] = s_idle_wakeups[1];
+    memcpy(stats->ma, s_ma, sizeof(s_ma));
+    uint64_t total = 0, charge = 0;
+    for (int i = 0; i < PM_STATE_COUNT; i++)
+    {
+        total += stats->ms[i];
+        charge += stats->ms[i] * s_ma[i];
+    }
+    stats->avg_ma = total ? charge / total : 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 调频和浅睡 ****************************/
+// 以前一直240MHz 主界面放着不动也是
+// 现在每个要性能的地方拿自己的CPU_FREQ_MAX锁: 摄像头界面 放音乐 语音识别 有人在操作界面
+// 都没拿着就降到PM_MIN_MHZ 开了浅睡的话空闲时自动进浅睡 定时器或中断叫醒
+// 界面的锁由触摸拿着 松手PM_UI_HOLD_MS以后放掉 滑动惯性和动画跑完
+// 板子量不了电流 按各状态待的时间和Kconfig里的电流估平均值 和空闲管理一样
+
+#define PM_MIN_MHZ              CONFIG_APP_PM_MIN_MHZ
+#define PM_UI_HOLD_MS           CONFIG_APP_PM_UI_HOLD_MS
+
+typedef enum {
+    PM_CLIENT_CAMERA,                   // 按电流从大到小排 同时拿着的算最前面那个
+    PM_CLIENT_AUDIO,
+    PM_CLIENT_VOICE,
+    PM_CLIENT_UI,
+    PM_CLIENT_COUNT,
+} pm_client_t;
+
+#define PM_STATE_LOW            PM_CLIENT_COUNT     // 谁都没拿着
+#define PM_STATE_STANDBY        (PM_CLIENT_COUNT + 1)   // 谁都没拿着 而且在待机 见standby.h
+#define PM_STATE_COUNT          (PM_CLIENT_COUNT + 2)
+
+typedef struct {
+    bool light_sleep;                   // 开了自动浅睡
+    uint64_t ms[PM_STATE_COUNT];        // 各状态待的时间
+    uint32_t ma[PM_STATE_COUNT];        // 各状态的电流 Kconfig里填的
+    uint32_t acquires[PM_CLIENT_COUNT];
+    uint32_t wakes;                     // 降频时来的第一下触摸
+    uint64_t wake_us_total;             // 手指落下到LVGL拿到 没接触摸INT时是最坏情况
+    uint32_t wake_us_max;
+    uint32_t avg_ma;
+    uint32_t idle_wakeups[2];           // 每个核从空闲里被叫醒的次数 定时器和中断都算
+} pm_ctl_stats_t;
+
+esp_err_t pm_ctl_init(void);            // 开机最早调 界面的锁先拿着 直到第一次pm_ctl_ui_busy以后没人碰
+void pm_ctl_set(pm_client_t client, bool on);   // 重复调没关系 不嵌套
+void pm_ctl_ui_busy(void);              // 按着屏幕时每次读触摸都调 续上界面的锁
+void pm_ctl_touch_wake(uint32_t latency_us);    // 新按下时在pm_ctl_ui_busy之前调 降着频的话记一次叫醒
+void pm_ctl_standby(bool on);           // 待机进出时调 只影响按状态估的电流
+bool pm_ctl_held(pm_client_t client);   // 这个客户现在拿着没有
+const char *pm_ctl_state_name(int state);
+void pm_ctl_get_stats(pm_ctl_stats_t *stats);
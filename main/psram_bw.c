@@ -0,0 +1,239 @@
+#include <string.h>
+#include "psram_bw.h"
+#include "telemetry.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "soc/soc.h"
+#include "soc/extmem_reg.h"
+#include "freertos/event_groups.h"
+
+#if CONFIG_APP_PSRAM_BW
+
+static const char *TAG = "psram_bw";
+
+// S3的EXTMEM里有DBUS访问和缺失的计数 别的芯片或者头文件里没有就只靠上报的流量
+#if defined(EXTMEM_DBUS_ACS_SPIRAM_MISS_CNT_REG) && defined(EXTMEM_CACHE_ACS_CNT_CLR_REG) && defined(EXTMEM_DBUS_ACS_CNT_CLR)
+#define PSRAM_BW_HW_CNT         1
+#define PSRAM_BW_LINE           CONFIG_ESP32S3_DATA_CACHE_LINE_SIZE
+#else
+#define PSRAM_BW_HW_CNT         0
+#endif
+
+#define BUDGET_BYTES_PER_S      ((uint64_t)CONFIG_APP_PSRAM_BW_BUDGET_MBPS * 1000000)
+#define HIGH_PCT                CONFIG_APP_PSRAM_BW_HIGH_PCT
+#define EV_NOT_CRITICAL         BIT0
+
+static esp_timer_handle_t s_timer;
+static EventGroupHandle_t s_ev;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool s_timer_on;
+static volatile psram_bw_level_t s_level = PSRAM_BW_OK;
+static uint32_t s_src_bytes[PSRAM_BW_SRC_COUNT];   // 原子加 定时器里取走清零
+static uint32_t s_risk;                 // 按位 PSRAM_BW_RT_xxx
+static volatile TickType_t s_last_report;
+static volatile TickType_t s_last_rt;
+static TickType_t s_crit_until;
+static psram_bw_stats_t s_stats;
+
+static const char *const s_level_names[PSRAM_BW_LEVELS] = { "ok", "busy", "critical" };
+
+static void set_level(psram_bw_level_t level)
+{
+    if (level == s_level)
+    {
+        return;
+    }
+    ESP_LOGD(TAG, "%s -> %s, %lu%% of budget", s_level_names[s_level], s_level_names[level],
+             (unsigned long)s_stats.util_pct);
+    s_level = level;
+    if (level == PSRAM_BW_CRITICAL)
+    {
+        xEventGroupClearBits(s_ev, EV_NOT_CRITICAL);
+    }
+    else
+    {
+        xEventGroupSetBits(s_ev, EV_NOT_CRITICAL);
+    }
+}
+
+// esp_timer任务里
+static void sample_cb(void *arg)
+{
+    const TickType_t now = xTaskGetTickCount();
+    uint32_t cpu_bytes = 0, miss = 0;
+#if PSRAM_BW_HW_CNT
+    miss = REG_READ(EXTMEM_DBUS_ACS_SPIRAM_MISS_CNT_REG);
+    REG_WRITE(EXTMEM_CACHE_ACS_CNT_CLR_REG, EXTMEM_DBUS_ACS_CNT_CLR);
+    cpu_bytes = miss * PSRAM_BW_LINE;
+#endif
+    uint32_t src[PSRAM_BW_SRC_COUNT], total = cpu_bytes;
+    for (int i = 0; i < PSRAM_BW_SRC_COUNT; i++)
+    {
+        src[i] = __atomic_exchange_n(&s_src_bytes[i], 0, __ATOMIC_RELAXED);
+        total += src[i];
+    }
+    const uint32_t risk = __atomic_exchange_n(&s_risk, 0, __ATOMIC_RELAXED);
+    const uint32_t util = (uint64_t)total * 1000 / PSRAM_BW_PERIOD_MS * 100 / BUDGET_BYTES_PER_S;
+    const bool rt_active = now - s_last_rt < pdMS_TO_TICKS(PSRAM_BW_HOLD_MS);
+
+    if (risk)
+    {
+        s_crit_until = now + pdMS_TO_TICKS(PSRAM_BW_HOLD_MS);
+    }
+    psram_bw_level_t level = PSRAM_BW_OK;
+    if ((int32_t)(s_crit_until - now) > 0)
+    {
+        level = PSRAM_BW_CRITICAL;
+    }
+    else if (rt_active && (util >= HIGH_PCT || (s_level != PSRAM_BW_OK && util >= HIGH_PCT / 2)))
+    {
+        level = PSRAM_BW_BUSY;  // 降下来要到一半 不在门限上来回跳
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.util_pct = util;
+    s_stats.util_peak_pct = util > s_stats.util_peak_pct ? util : s_stats.util_peak_pct;
+    s_stats.cpu_kbps = (uint64_t)cpu_bytes * 1000 / PSRAM_BW_PERIOD_MS / 1024;
+    for (int i = 0; i < PSRAM_BW_SRC_COUNT; i++)
+    {
+        s_stats.src_kbps[i] = (uint64_t)src[i] * 1000 / PSRAM_BW_PERIOD_MS / 1024;
+    }
+    s_stats.misses += miss;
+    for (int i = 0; i < PSRAM_BW_RT_COUNT; i++)
+    {
+        s_stats.risks[i] += (risk >> i) & 1;
+    }
+    s_stats.level_ms[level] += PSRAM_BW_PERIOD_MS;
+    portEXIT_CRITICAL(&s_lock);
+    set_level(level);
+
+    if (level == PSRAM_BW_OK && now - s_last_report > pdMS_TO_TICKS(PSRAM_BW_IDLE_MS))
+    {
+        esp_timer_stop(s_timer);    // 先停再清标志 中间来的上报顶多漏一次
+        portENTER_CRITICAL(&s_lock);
+        s_timer_on = false;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static void timer_kick(void)
+{
+    s_last_report = xTaskGetTickCount();
+    if (s_timer == NULL || s_timer_on)
+    {
+        return;
+    }
+    bool start = false;
+    portENTER_CRITICAL(&s_lock);
+    if (!s_timer_on)
+    {
+        s_timer_on = start = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (start)
+    {
+#if PSRAM_BW_HW_CNT
+        REG_WRITE(EXTMEM_CACHE_ACS_CNT_CLR_REG, EXTMEM_DBUS_ACS_CNT_CLR);   // 停着时攒的不算
+#endif
+        esp_timer_start_periodic(s_timer, PSRAM_BW_PERIOD_MS * 1000);
+    }
+}
+
+void psram_bw_add(psram_bw_src_t src, uint32_t bytes)
+{
+    if (src < PSRAM_BW_SRC_COUNT)
+    {
+        __atomic_fetch_add(&s_src_bytes[src], bytes, __ATOMIC_RELAXED);
+        timer_kick();
+    }
+}
+
+void psram_bw_rt(psram_bw_rt_t rt, bool at_risk)
+{
+    if (rt >= PSRAM_BW_RT_COUNT)
+    {
+        return;
+    }
+    if (at_risk)
+    {
+        __atomic_fetch_or(&s_risk, 1u << rt, __ATOMIC_RELAXED);
+    }
+    s_last_rt = xTaskGetTickCount();
+    timer_kick();
+}
+
+void psram_bw_yield(void)
+{
+    const psram_bw_level_t level = s_level;
+    if (level == PSRAM_BW_OK || s_ev == NULL)
+    {
+        vTaskDelay(1);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.yields++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    if (level == PSRAM_BW_BUSY)
+    {
+        vTaskDelay(pdMS_TO_TICKS(PSRAM_BW_BUSY_DELAY_MS));
+        portENTER_CRITICAL(&s_lock);
+        s_stats.yields++;
+        s_stats.throttled++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    EventBits_t bits = xEventGroupWaitBits(s_ev, EV_NOT_CRITICAL, pdFALSE, pdFALSE, pdMS_TO_TICKS(PSRAM_BW_MAX_WAIT_MS));
+    uint32_t ms = (esp_timer_get_time() - t0) / 1000;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.yields++;
+    s_stats.waits++;
+    s_stats.wait_ms += ms;
+    s_stats.wait_timeouts += !(bits & EV_NOT_CRITICAL);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+psram_bw_level_t psram_bw_level(void)
+{
+    return s_level;
+}
+
+void psram_bw_get_stats(psram_bw_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    stats->hw_counters = PSRAM_BW_HW_CNT;
+    stats->level = s_level;
+}
+
+// 遥测在esp_timer任务里读
+static uint32_t tlm_util(void *arg)
+{
+    return s_stats.util_pct;
+}
+
+static uint32_t tlm_level(void *arg)
+{
+    return s_level;
+}
+
+esp_err_t psram_bw_init(void)
+{
+    s_ev = xEventGroupCreate();
+    ESP_RETURN_ON_FALSE(s_ev, ESP_ERR_NO_MEM, TAG, "no memory");
+    xEventGroupSetBits(s_ev, EV_NOT_CRITICAL);
+    const esp_timer_create_args_t args = {
+        .callback = sample_cb,
+        .name = "psram_bw",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "create timer");
+    telemetry_add("psram_util_pct", TELEMETRY_GAUGE, tlm_util, NULL);
+    telemetry_add("psram_level", TELEMETRY_GAUGE, tlm_level, NULL);
+    ESP_LOGI(TAG, "budget %d MB/s, busy above %d%%, cache miss counters %s", CONFIG_APP_PSRAM_BW_BUDGET_MBPS, HIGH_PCT,
+             PSRAM_BW_HW_CNT ? "on" : "not available");
+    return ESP_OK;
+}
+
+#endif
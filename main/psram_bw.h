@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+/*********************** PSRAM带宽监视和后台节流 ****************************/
+// 八线PSRAM 80MHz 摄像头的帧缓冲 GIF和图片缓存 LVGL的分配 解码缓冲都在上面 一起跑时预览会掉帧
+// 每PSRAM_BW_PERIOD_MS看一次:
+//   CPU这边 读cache的DBUS访问和PSRAM缺失计数 一次缺失按一行cache算流量 没有这组寄存器的芯片是0
+//   DMA和大块拷贝 摄像头每帧的大小 直接渲染模式整帧拷去中转缓冲的量 由各自上报
+//   实时的 摄像头预览丢了帧 音频的PCM缓冲低于四分之一 各自报一次有没有危险
+// 合起来分三级:
+//   OK      谁都不急 后台照常
+//   BUSY    有实时的在跑 流量超过预算的CONFIG_APP_PSRAM_BW_HIGH_PCT 后台每步多睡一会 降到一半以下才回OK
+//   CRITICAL 实时的报了危险 后台停着等 最多PSRAM_BW_MAX_WAIT_MS 报危险以后保持PSRAM_BW_HOLD_MS
+// 后台指媒体库扫卡 音乐索引和响度估计 缩略图生成 它们原来每步vTaskDelay(1)的地方换成psram_bw_yield
+// 没人上报时定时器停着 不影响浅睡 上报都在任务里 不能在中断里调
+
+#define PSRAM_BW_PERIOD_MS      100
+#define PSRAM_BW_IDLE_MS        2000    // 这么久没人上报就停定时器
+#define PSRAM_BW_HOLD_MS        1000
+#define PSRAM_BW_BUSY_DELAY_MS  20
+#define PSRAM_BW_MAX_WAIT_MS    1000    // 后台不能一直饿着
+
+typedef enum {
+    PSRAM_BW_OK,
+    PSRAM_BW_BUSY,
+    PSRAM_BW_CRITICAL,
+    PSRAM_BW_LEVELS,
+} psram_bw_level_t;
+
+typedef enum {
+    PSRAM_BW_SRC_CAMERA,                // 帧缓冲的DMA写入
+    PSRAM_BW_SRC_LCD,                   // 直接渲染模式读整帧
+    PSRAM_BW_SRC_COUNT,
+} psram_bw_src_t;
+
+typedef enum {
+    PSRAM_BW_RT_CAMERA,
+    PSRAM_BW_RT_AUDIO,
+    PSRAM_BW_RT_COUNT,
+} psram_bw_rt_t;
+
+typedef struct {
+    bool hw_counters;                   // 读得到cache的缺失计数
+    psram_bw_level_t level;
+    uint32_t util_pct;                  // 最近一个周期 占预算的百分比
+    uint32_t util_peak_pct;
+    uint32_t cpu_kbps;                  // 最近一个周期 cache缺失换算的
+    uint32_t src_kbps[PSRAM_BW_SRC_COUNT];
+    uint64_t misses;
+    uint32_t risks[PSRAM_BW_RT_COUNT];  // 报危险的次数
+    uint64_t level_ms[PSRAM_BW_LEVELS];
+    uint32_t yields;
+    uint32_t throttled;                 // BUSY时多睡的
+    uint32_t waits;                     // CRITICAL时停下等的
+    uint32_t wait_timeouts;
+    uint64_t wait_ms;
+} psram_bw_stats_t;
+
+#if CONFIG_APP_PSRAM_BW
+esp_err_t psram_bw_init(void);
+void psram_bw_add(psram_bw_src_t src, uint32_t bytes);
+void psram_bw_rt(psram_bw_rt_t rt, bool at_risk);  // 实时的每帧或者每个周期报一次 报了才算在跑
+void psram_bw_yield(void);              // 后台每做完一步调 代替vTaskDelay(1)
+psram_bw_level_t psram_bw_level(void);
+void psram_bw_get_stats(psram_bw_stats_t *stats);
+#else
+static inline esp_err_t psram_bw_init(void) { return ESP_OK; }
+static inline void psram_bw_add(psram_bw_src_t src, uint32_t bytes) { }
+static inline void psram_bw_rt(psram_bw_rt_t rt, bool at_risk) { }
+static inline void psram_bw_yield(void) { vTaskDelay(1); }
+static inline psram_bw_level_t psram_bw_level(void) { return PSRAM_BW_OK; }
+#endif
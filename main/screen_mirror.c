@@ -0,0 +1,404 @@
+#include <string.h>
+#include "screen_mirror.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp32_s3_szp.h"
+#include "ui_msg.h"
+#include "psram_bw.h"
+#include "task_plan.h"
+
+#if CONFIG_APP_SCREEN_MIRROR
+
+static const char *TAG = "screen_mirror";
+
+#define MIRROR_TILES_X          ((BSP_LCD_H_RES + SCREEN_MIRROR_TILE - 1) / SCREEN_MIRROR_TILE)
+#define MIRROR_TILES_Y          ((BSP_LCD_V_RES + SCREEN_MIRROR_TILE - 1) / SCREEN_MIRROR_TILE)
+#define MIRROR_RECT_PX          (BSP_LCD_H_RES * SCREEN_MIRROR_TILE)
+#define MIRROR_RLE_MAX(px)      ((px) * 2 + ((px) + 127) / 128)  // 全是原样像素时最长
+#define MIRROR_RECT_HDR         12
+#define MIRROR_FRAME_HDR        4
+#define MIRROR_RUN_MAX          129
+#define MIRROR_LIT_MAX          128
+#define MIRROR_FLAG_LAST        0x01
+#define MIRROR_INTERVAL_US      (1000000 / CONFIG_APP_SCREEN_MIRROR_FPS)
+
+_Static_assert(MIRROR_TILES_X <= 32, "one dirty word per tile row");
+_Static_assert(MIRROR_FRAME_HDR + MIRROR_RECT_HDR + MIRROR_RLE_MAX(MIRROR_RECT_PX) <= SCREEN_MIRROR_OUT_LEN,
+               "a full tile row must fit in one chunk");
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static screen_mirror_stats_t s_stats;
+static httpd_handle_t s_server;
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_sent;
+static lv_color_t *s_shadow;            // PSRAM 和屏幕一样大 第一次有人连上时分配
+static uint32_t s_dirty[MIRROR_TILES_Y];   // 每行块一个字 LVGL任务置位 压缩任务取走
+static volatile bool s_active;
+
+// 下面这些只在压缩任务里用
+static uint8_t *s_out;
+static size_t s_out_len;
+static uint16_t s_out_rects;
+static uint16_t *s_rect_px;             // 一个矩形拷出来连续放 游程编码不用管行距
+
+// 下面这些只在httpd任务里用
+static int s_clients[SCREEN_MIRROR_CLIENTS] = {-1, -1};
+static int s_client_count;
+
+static const char s_mirror_html[] =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\">"
+    "<meta name=\"viewport\" content=\"width=device-width\"><title>Mirror</title></head><body>"
+    "<canvas id=\"c\" style=\"border:1px solid #ccc;image-rendering:pixelated;width:640px\"></canvas>"
+    "<div id=\"st\">连接中</div><script>"
+    "var c=document.getElementById('c'),g=c.getContext('2d'),sw=1,n=0,B=0,T=Date.now();"
+    "function conn(){var ws=new WebSocket('ws://'+location.host+'/ws/mirror');ws.binaryType='arraybuffer';"
+    "ws.onclose=()=>{document.getElementById('st').textContent='断开';setTimeout(conn,2000)};"
+    "ws.onmessage=e=>{if(typeof e.data=='string'){var m=JSON.parse(e.data);c.width=m.w;c.height=m.h;sw=m.swap;return}"
+    "var v=new DataView(e.data),b=new Uint8Array(e.data),o=4,k=v.getUint16(2,true);B+=b.length;"
+    "for(var r=0;r<k;r++,o=end){var x=v.getUint16(o,true),y=v.getUint16(o+2,true),w=v.getUint16(o+4,true),"
+    "h=v.getUint16(o+6,true),p=o+12,end=p+v.getUint32(o+8,true),im=g.createImageData(w,h),d=im.data,q=0;"
+    "while(p<end){var t=b[p++],lit=t<128,cnt=lit?t+1:t-126;"
+    "for(var i=0;i<cnt;i++){var j=lit?p+2*i:p,c=sw?b[j]<<8|b[j+1]:b[j+1]<<8|b[j];"
+    "d[q++]=(c>>11)*255/31;d[q++]=(c>>5&63)*255/63;d[q++]=(c&31)*255/31;d[q++]=255}p+=lit?2*cnt:2}"
+    "g.putImageData(im,x,y)}"
+    "if(b[1]&1)n++;var s=(Date.now()-T)/1000;if(s>=2){document.getElementById('st').textContent="
+    "(n/s).toFixed(1)+' fps '+(B/1024/s).toFixed(1)+' KB/s';n=0;B=0;T=Date.now()}}}"
+    "conn();</script></body></html>";
+
+/********************************** tee 在LVGL任务里 **********************************/
+
+static void mirror_tee(const lv_area_t *area, const lv_color_t *px, int stride)
+{
+    const int64_t t0 = esp_timer_get_time();
+    const int w = lv_area_get_width(area);
+    for (int y = area->y1; y <= area->y2; y++, px += stride)
+    {
+        memcpy(s_shadow + y * BSP_LCD_H_RES + area->x1, px, w * sizeof(lv_color_t));
+    }
+    const int tx1 = area->x1 / SCREEN_MIRROR_TILE, tx2 = area->x2 / SCREEN_MIRROR_TILE;
+    const uint32_t mask = ((1u << (tx2 - tx1 + 1)) - 1) << tx1;
+    for (int ty = area->y1 / SCREEN_MIRROR_TILE; ty <= area->y2 / SCREEN_MIRROR_TILE; ty++)
+    {
+        __atomic_fetch_or(&s_dirty[ty], mask, __ATOMIC_RELEASE);
+    }
+    psram_bw_add(PSRAM_BW_SRC_LCD, w * lv_area_get_height(area) * sizeof(lv_color_t));
+    xTaskNotifyGive(s_task);
+    const uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.tees++;
+    s_stats.tee_us += us;
+    s_stats.tee_max_us = us > s_stats.tee_max_us ? us : s_stats.tee_max_us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 影子帧是旧的 让LVGL整屏重画一遍 tee会把它拷进来
+static void mirror_invalidate(void *arg)
+{
+    lv_obj_invalidate(lv_scr_act());
+    lv_obj_invalidate(lv_layer_top());
+}
+
+/********************************** 压缩和发送 **********************************/
+
+static size_t rle_encode(const uint16_t *px, int n, uint8_t *out)
+{
+    size_t o = 0;
+    int i = 0;
+    while (i < n)
+    {
+        int run = 1;
+        while (i + run < n && run < MIRROR_RUN_MAX && px[i + run] == px[i])
+        {
+            run++;
+        }
+        if (run >= 2)
+        {
+            out[o++] = 0x80 | (run - 2);
+            memcpy(out + o, &px[i], 2);
+            o += 2;
+            i += run;
+            continue;
+        }
+        // 原样的一直到下一段重复开始
+        int lit = 1;
+        while (i + lit < n && lit < MIRROR_LIT_MAX && !(i + lit + 1 < n && px[i + lit] == px[i + lit + 1]))
+        {
+            lit++;
+        }
+        out[o++] = lit - 1;
+        memcpy(out + o, &px[i], lit * 2);
+        o += lit * 2;
+        i += lit;
+    }
+    return o;
+}
+
+// 在httpd任务里 断开的在发的时候才发现
+static void send_work(void *arg)
+{
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_BINARY,
+        .payload = s_out,
+        .len = s_out_len,
+    };
+    uint32_t sent = 0, failed = 0;
+    for (int i = 0; i < SCREEN_MIRROR_CLIENTS; i++)
+    {
+        int fd = s_clients[i];
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (httpd_ws_get_fd_info(s_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+            httpd_ws_send_frame_async(s_server, fd, &frame) != ESP_OK)
+        {
+            ESP_LOGI(TAG, "client %d gone", fd);
+            s_clients[i] = -1;
+            s_client_count--;
+            failed++;
+            continue;
+        }
+        sent++;
+    }
+    if (s_client_count == 0)
+    {
+        bsp_display_set_tee_cb(NULL);
+        s_active = false;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += (uint64_t)s_out_len * sent;
+    s_stats.send_failed += failed;
+    s_stats.clients = s_client_count;
+    s_stats.active = s_active;
+    portEXIT_CRITICAL(&s_lock);
+    xSemaphoreGive(s_sent);
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v & 0xffff);
+    put_u16(p + 2, v >> 16);
+}
+
+static bool chunk_send(bool last)
+{
+    s_out[0] = 'S';
+    s_out[1] = last ? MIRROR_FLAG_LAST : 0;
+    put_u16(s_out + 2, s_out_rects);
+    const int64_t t0 = esp_timer_get_time();
+    bool ok = httpd_queue_work(s_server, send_work, NULL) == ESP_OK;
+    if (ok)
+    {
+        xSemaphoreTake(s_sent, portMAX_DELAY);  // 等它发完 这就是背压
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.send_us += esp_timer_get_time() - t0;
+    s_stats.chunks += ok;
+    s_stats.send_failed += !ok;
+    portEXIT_CRITICAL(&s_lock);
+    s_out_len = MIRROR_FRAME_HDR;
+    s_out_rects = 0;
+    return ok && s_active;
+}
+
+static bool rect_add(int x, int y, int w, int h)
+{
+    const int n = w * h;
+    if (s_out_len + MIRROR_RECT_HDR + MIRROR_RLE_MAX(n) > SCREEN_MIRROR_OUT_LEN && !chunk_send(false))
+    {
+        return false;
+    }
+    const int64_t t0 = esp_timer_get_time();
+    for (int r = 0; r < h; r++)
+    {
+        memcpy(s_rect_px + r * w, s_shadow + (y + r) * BSP_LCD_H_RES + x, w * sizeof(lv_color_t));
+    }
+    uint8_t *hdr = s_out + s_out_len;
+    size_t len = rle_encode(s_rect_px, n, hdr + MIRROR_RECT_HDR);
+    put_u16(hdr, x);
+    put_u16(hdr + 2, y);
+    put_u16(hdr + 4, w);
+    put_u16(hdr + 6, h);
+    put_u32(hdr + 8, len);
+    s_out_len += MIRROR_RECT_HDR + len;
+    s_out_rects++;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.rects++;
+    s_stats.raw_bytes += n * sizeof(lv_color_t);
+    s_stats.encode_us += esp_timer_get_time() - t0;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+static void mirror_task(void *arg)
+{
+    int64_t last_us = 0;
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (!s_active)
+        {
+            continue;
+        }
+        // 限帧率 等的这段时间里画的都合并进这一次
+        const int64_t wait_us = last_us + MIRROR_INTERVAL_US - esp_timer_get_time();
+        if (wait_us > 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(wait_us / 1000) + 1);
+        }
+        last_us = esp_timer_get_time();
+        s_out_len = MIRROR_FRAME_HDR;
+        s_out_rects = 0;
+        bool ok = true;
+        for (int ty = 0; ok && ty < MIRROR_TILES_Y; ty++)
+        {
+            uint32_t bits = __atomic_exchange_n(&s_dirty[ty], 0, __ATOMIC_ACQUIRE);
+            const int y = ty * SCREEN_MIRROR_TILE;
+            const int h = LV_MIN(SCREEN_MIRROR_TILE, BSP_LCD_V_RES - y);
+            while (ok && bits)
+            {
+                const int tx = __builtin_ctz(bits);
+                int n = 0;
+                while (tx + n < MIRROR_TILES_X && (bits >> (tx + n) & 1))
+                {
+                    n++;
+                }
+                bits &= ~(((1u << n) - 1) << tx);
+                const int x = tx * SCREEN_MIRROR_TILE;
+                ok = rect_add(x, y, LV_MIN(n * SCREEN_MIRROR_TILE, BSP_LCD_H_RES - x), h);
+            }
+        }
+        if (ok && s_out_rects)
+        {
+            ok = chunk_send(true);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.updates += ok;
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+}
+
+/********************************** 连接 在httpd任务里 **********************************/
+
+static esp_err_t mirror_start(void)
+{
+    if (s_shadow == NULL)
+    {
+        s_shadow = heap_caps_calloc(BSP_LCD_H_RES * BSP_LCD_V_RES, sizeof(lv_color_t), MALLOC_CAP_SPIRAM);
+        s_out = heap_caps_malloc(SCREEN_MIRROR_OUT_LEN, MALLOC_CAP_SPIRAM);
+        s_rect_px = heap_caps_malloc(MIRROR_RECT_PX * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+        if (s_shadow == NULL || s_out == NULL || s_rect_px == NULL)
+        {
+            heap_caps_free(s_shadow);
+            heap_caps_free(s_out);
+            heap_caps_free(s_rect_px);
+            s_shadow = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (s_task == NULL)
+    {
+        s_sent = xSemaphoreCreateBinary();
+        ESP_RETURN_ON_FALSE(s_sent, ESP_ERR_NO_MEM, TAG, "no memory");
+        ESP_RETURN_ON_FALSE(task_plan_create(TASK_SCREEN_MIRROR, mirror_task, NULL, &s_task) == pdPASS,
+                            ESP_ERR_NO_MEM, TAG, "create task");
+    }
+    s_active = true;
+    bsp_display_set_tee_cb(mirror_tee);
+    return ESP_OK;
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    if (req->method != HTTP_GET)
+    {
+        // 页面不发东西 发了也读掉扔了
+        uint8_t buf[16];
+        httpd_ws_frame_t frame = {0};
+        ESP_RETURN_ON_ERROR(httpd_ws_recv_frame(req, &frame, 0), TAG, "recv frame length");
+        if (frame.len > sizeof(buf))
+        {
+            return ESP_FAIL;
+        }
+        frame.payload = buf;
+        return frame.len ? httpd_ws_recv_frame(req, &frame, frame.len) : ESP_OK;
+    }
+    const int fd = httpd_req_to_sockfd(req);
+    int slot = -1;
+    for (int i = 0; i < SCREEN_MIRROR_CLIENTS; i++)
+    {
+        if (s_clients[i] < 0 && slot < 0)
+        {
+            slot = i;
+        }
+    }
+    if (slot < 0)
+    {
+        ESP_LOGW(TAG, "too many clients");
+        return ESP_FAIL;
+    }
+    char hello[48];
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)hello,
+        .len = snprintf(hello, sizeof(hello), "{\"w\":%d,\"h\":%d,\"swap\":%d}", BSP_LCD_H_RES, BSP_LCD_V_RES,
+                        LV_COLOR_16_SWAP),
+    };
+    ESP_RETURN_ON_ERROR(httpd_ws_send_frame(req, &frame), TAG, "send hello");
+    if (s_client_count == 0)
+    {
+        ESP_RETURN_ON_ERROR(mirror_start(), TAG, "start");
+    }
+    s_clients[slot] = fd;
+    s_client_count++;
+    ui_post_call(mirror_invalidate, NULL);  // 新来的要一整屏
+    portENTER_CRITICAL(&s_lock);
+    s_stats.connects++;
+    s_stats.clients = s_client_count;
+    s_stats.active = true;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "client %d connected, %d watching", fd, s_client_count);
+    return ESP_OK;
+}
+
+static esp_err_t mirror_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html; charset=utf-8");
+    return httpd_resp_send(req, s_mirror_html, sizeof(s_mirror_html) - 1);
+}
+
+esp_err_t screen_mirror_register(httpd_handle_t server)
+{
+    static const httpd_uri_t uris[] = {
+        {.uri = "/mirror", .method = HTTP_GET, .handler = mirror_handler},
+        {.uri = "/ws/mirror", .method = HTTP_GET, .handler = ws_handler, .is_websocket = true},
+    };
+    for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &uris[i]), TAG, "register %s", uris[i].uri);
+    }
+    s_server = server;
+    return ESP_OK;
+}
+
+void screen_mirror_get_stats(screen_mirror_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
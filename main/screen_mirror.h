@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+
+/*********************** 屏幕镜像 ****************************/
+// 挂在文件传输的httpd上 浏览器打开 /mirror 看屏幕 演示和远程帮人看问题用
+// 有页面连着时在刷屏回调里接一个tee 发往屏幕的每块像素拷进PSRAM里的影子帧 按16x16的块记脏
+// 这一步只有一次memcpy和几个原子或 不等网络 本地渲染基本不受影响 花的时间记在tee_us里
+// 压缩任务被叫醒后取走脏块 每行连着的脏块算一个矩形 RGB565按像素游程编码 攒满一段发一个二进制帧
+// 上一段还没发完就等着 这期间新画的只是让脏块再置位 中间的画面自然合并掉 网络慢就少发几帧
+// 压缩时屏幕还在画 读到一半的块已经又被标脏 下一轮会重发 不会留错的画面
+// 连上先回一个文本帧 {"w":320,"h":240,"swap":1} swap是像素字节序 之后全是二进制帧:
+//   帧头 u8 'S' u8 标志(bit0 这次更新的最后一段) u16 矩形数
+//   矩形 u16 x y w h u32 长度 游程数据
+//   游程 一个字节c c<0x80 后面c+1个原样的像素 否则下一个像素重复c-0x80+2次
+// 相机预览直接写屏不经过LVGL 那段时间镜像停在进预览前的画面
+
+#define SCREEN_MIRROR_CLIENTS   2
+#define SCREEN_MIRROR_TILE      16
+#define SCREEN_MIRROR_OUT_LEN   (32 * 1024) // 一段二进制帧 一个矩形最大一整行块 10KB多一点
+
+typedef struct {
+    bool active;
+    uint8_t clients;
+    uint32_t connects;
+    uint32_t tees;                      // 刷屏回调交过来的块
+    uint64_t tee_us;                    // 花在拷影子帧上的 和渲染时间比就是镜像的开销
+    uint32_t tee_max_us;
+    uint32_t updates;                   // 发出去的更新 一次可能合并了好几帧
+    uint32_t chunks;                    // WebSocket帧
+    uint32_t rects;
+    uint64_t raw_bytes;                 // 矩形原始的像素字节
+    uint64_t bytes;                     // 压缩后 一个页面算一份
+    uint64_t encode_us;
+    uint64_t send_us;                   // 等httpd发完的时间 网络慢这里就长
+    uint32_t send_failed;
+} screen_mirror_stats_t;
+
+#if CONFIG_APP_SCREEN_MIRROR
+esp_err_t screen_mirror_register(httpd_handle_t server);   // httpd起来以后注册/mirror和/ws/mirror
+void screen_mirror_get_stats(screen_mirror_stats_t *stats);
+#endif
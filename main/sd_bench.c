@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "sd_bench.h"
+#include "esp32_s3_szp.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "ff.h"
+
+static const char *TAG = "sd_bench";
+
+typedef struct {
+    int width;
+    int freq_khz;
+} sd_bench_mode_t;
+
+static const sd_bench_mode_t s_modes[] = {
+    {1, SDMMC_FREQ_DEFAULT},
+    {1, SDMMC_FREQ_HIGHSPEED},
+#if SD_BUS_WIDTH == 4
+    {4, SDMMC_FREQ_DEFAULT},
+    {4, SDMMC_FREQ_HIGHSPEED},
+#endif
+};
+
+// 整块从内部RAM写再读回来 不经过stdio的缓冲 返回字节每微秒 就是MB/s
+static esp_err_t bench_file(uint8_t *buf, float *write_mbs, float *read_mbs)
+{
+    FILE *f = fopen(SD_BENCH_FILE, "wb");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "cannot create %s", SD_BENCH_FILE);
+    setvbuf(f, NULL, _IONBF, 0);
+    int64_t t0 = esp_timer_get_time();
+    size_t done = 0;
+    while (done < SD_BENCH_BYTES && fwrite(buf, 1, SD_BENCH_CHUNK, f) == SD_BENCH_CHUNK)
+    {
+        done += SD_BENCH_CHUNK;
+    }
+    fsync(fileno(f));
+    int64_t t1 = esp_timer_get_time();
+    fclose(f);
+    if (done < SD_BENCH_BYTES)
+    {
+        unlink(SD_BENCH_FILE);
+        ESP_LOGE(TAG, "write stopped at %u bytes", (unsigned)done);
+        return ESP_FAIL;
+    }
+    *write_mbs = (float)done / (t1 - t0);
+
+    f = fopen(SD_BENCH_FILE, "rb");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "cannot open %s", SD_BENCH_FILE);
+    setvbuf(f, NULL, _IONBF, 0);
+    t0 = esp_timer_get_time();
+    done = 0;
+    while (done < SD_BENCH_BYTES && fread(buf, 1, SD_BENCH_CHUNK, f) == SD_BENCH_CHUNK)
+    {
+        done += SD_BENCH_CHUNK;
+    }
+    t1 = esp_timer_get_time();
+    fclose(f);
+    unlink(SD_BENCH_FILE);
+    ESP_RETURN_ON_FALSE(done == SD_BENCH_BYTES, ESP_FAIL, TAG, "read stopped at %u bytes", (unsigned)done);
+    *read_mbs = (float)done / (t1 - t0);
+    return ESP_OK;
+}
+
+// 从文件里随机挑扇区定位读一个 返回总耗时 最慢的一次放进max_us
+static uint32_t seek_run(FIL *fil, uint8_t *buf, uint32_t *max_us)
+{
+    uint32_t x = 12345;
+    uint32_t total = 0;
+    *max_us = 0;
+    for (int i = 0; i < SD_BENCH_SEEKS; i++)
+    {
+        x = x * 1103515245 + 12345;
+        FSIZE_t pos = (FSIZE_t)(x % (SD_BENCH_BYTES / 512)) * 512;
+        UINT br;
+        int64_t t0 = esp_timer_get_time();
+        if (f_lseek(fil, pos) != FR_OK || f_read(fil, buf, 512, &br) != FR_OK || br != 512)
+        {
+            ESP_LOGE(TAG, "seek to %lu failed", (unsigned long)pos);
+            break;
+        }
+        uint32_t us = esp_timer_get_time() - t0;
+        total += us;
+        *max_us = us > *max_us ? us : *max_us;
+    }
+    return total;
+}
+
+// 同一个文件先顺着FAT链定位 再建簇链表(CLMT)定位 往回跳的时候不用再从第一个簇走起
+// 直接用FATFS 不经过VFS 两种都能在一次开机里测到
+static esp_err_t bench_seek(uint8_t *buf)
+{
+    static FIL fil;
+    char fpath[sizeof(SD_BENCH_FILE) + 4];
+    ESP_RETURN_ON_FALSE(bsp_sdcard_fatfs_path(SD_BENCH_FILE, fpath, sizeof(fpath)), ESP_FAIL, TAG, "card not mounted");
+    FRESULT fr = f_open(&fil, fpath, FA_WRITE | FA_CREATE_ALWAYS);
+    ESP_RETURN_ON_FALSE(fr == FR_OK, ESP_FAIL, TAG, "cannot create %s: %d", SD_BENCH_FILE, fr);
+    UINT bw = SD_BENCH_CHUNK;
+    for (size_t done = 0; fr == FR_OK && bw == SD_BENCH_CHUNK && done < SD_BENCH_BYTES; done += SD_BENCH_CHUNK)
+    {
+        fr = f_write(&fil, buf, SD_BENCH_CHUNK, &bw);
+    }
+    f_close(&fil);
+    if (fr != FR_OK || bw != SD_BENCH_CHUNK)
+    {
+        f_unlink(fpath);
+        ESP_LOGE(TAG, "cannot write %s: %d", SD_BENCH_FILE, fr);
+        return ESP_FAIL;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    fr = f_open(&fil, fpath, FA_READ);
+    uint32_t open_us = esp_timer_get_time() - t0;
+    if (fr != FR_OK)
+    {
+        f_unlink(fpath);
+        ESP_LOGE(TAG, "cannot open %s: %d", SD_BENCH_FILE, fr);
+        return ESP_FAIL;
+    }
+    uint32_t chain_max, chain_us = seek_run(&fil, buf, &chain_max);
+    ESP_LOGI(TAG, "seek: open %.2f ms, %d random reads via FAT chain: avg %.2f ms, max %.2f ms", open_us / 1000.0,
+             SD_BENCH_SEEKS, chain_us / 1000.0 / SD_BENCH_SEEKS, chain_max / 1000.0);
+#if FF_USE_FASTSEEK
+    DWORD *clmt = heap_caps_malloc(CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE * sizeof(DWORD), MALLOC_CAP_8BIT);
+    if (clmt)
+    {
+        clmt[0] = CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE;
+        fil.cltbl = clmt;
+        t0 = esp_timer_get_time();
+        fr = f_lseek(&fil, CREATE_LINKMAP);
+        uint32_t map_us = esp_timer_get_time() - t0;
+        if (fr == FR_OK)
+        {
+            uint32_t map_max, map_total = seek_run(&fil, buf, &map_max);
+            ESP_LOGI(TAG, "seek: link map %lu words built in %.2f ms, %d random reads: avg %.2f ms, max %.2f ms",
+                     (unsigned long)clmt[0], map_us / 1000.0, SD_BENCH_SEEKS, map_total / 1000.0 / SD_BENCH_SEEKS,
+                     map_max / 1000.0);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "seek: no link map (%d), file has more fragments than %d words hold", fr,
+                     CONFIG_FATFS_FAST_SEEK_BUFFER_SIZE);
+        }
+        fil.cltbl = NULL;
+        heap_caps_free(clmt);
+    }
+#else
+    ESP_LOGI(TAG, "seek: CONFIG_FATFS_USE_FASTSEEK is off, no link map comparison");
+#endif
+    f_close(&fil);
+    f_unlink(fpath);
+    return ESP_OK;
+}
+
+esp_err_t sd_bench_run(void)
+{
+    uint8_t *buf = heap_caps_malloc(SD_BENCH_CHUNK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    ESP_RETURN_ON_FALSE(buf, ESP_ERR_NO_MEM, TAG, "no DMA buffer");
+    for (int i = 0; i < SD_BENCH_CHUNK; i++)
+    {
+        buf[i] = i * 7 + (i >> 8);
+    }
+
+    ESP_LOGI(TAG, "%-6s %9s %9s %10s %10s", "bus", "want kHz", "real kHz", "write MB/s", "read MB/s");
+    for (int i = 0; i < sizeof(s_modes) / sizeof(s_modes[0]); i++)
+    {
+        const sd_bench_mode_t *m = &s_modes[i];
+        bsp_sdcard_unmount();
+        esp_err_t ret = bsp_sdcard_mount_bus(m->width, m->freq_khz);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGI(TAG, "%d-bit  %9d %9s  mount failed: %s", m->width, m->freq_khz, "-", esp_err_to_name(ret));
+            continue;
+        }
+        int width, khz;
+        bsp_sdcard_get_bus(&width, &khz);
+        float wr, rd;
+        if (bench_file(buf, &wr, &rd) == ESP_OK)
+        {
+            ESP_LOGI(TAG, "%d-bit  %9d %9d %10.2f %10.2f", width, m->freq_khz, khz, wr, rd);
+        }
+    }
+
+    // 换回平时用的配置 媒体文件平时就是这样读的
+    bsp_sdcard_unmount();
+    esp_err_t ret = bsp_sdcard_mount();
+    if (ret == ESP_OK)
+    {
+        bench_seek(buf);
+    }
+    heap_caps_free(buf);
+    return ret;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** SD卡读写基准 ****************************/
+// 依次用1线/4线 20MHz/40MHz重新挂载SD卡 每种写一个测试文件再读回来 打印每种的MB/s
+// 板子没配4线就只测1线 结束后按配置重新挂载 测试期间SD卡上别的东西都不能用 只在开机挂载阶段跑
+// 最后在平时的配置下随机定位读同一个文件 比较顺着FAT链找簇和用簇链表(fast seek)的打开和定位耗时
+
+#define SD_BENCH_FILE       "/sdcard/.sdbench.tmp"
+#define SD_BENCH_BYTES      (CONFIG_APP_SD_BENCH_MB * 1024 * 1024)
+#define SD_BENCH_CHUNK      (32 * 1024)     // 和录像、照片写盘的块一样大
+#define SD_BENCH_SEEKS      64              // 随机定位的次数 每次读一个扇区
+
+esp_err_t sd_bench_run(void);           // 在调用者任务里同步执行 SD卡要已经挂载
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sd_dir_cache.h"
+#include "media_lib.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "sd_dir_cache";
+
+typedef struct {
+    char path[SD_DIR_CACHE_PATH_LEN];
+    char *recs;                         // PSRAM
+    uint32_t len;
+    uint32_t stamp;                     // 最后一次使用 越小越久没用
+    bool used;
+    bool held;                          // 卸过卡 媒体库核对之前不拿出来用
+} dir_entry_t;
+
+static dir_entry_t s_entries[SD_DIR_CACHE_MAX_DIRS];
+static sd_dir_cache_stats_t s_stats;
+static uint32_t s_clock;
+static volatile uint32_t s_gen;
+static SemaphoreHandle_t s_mutex;
+
+static void cache_lock(void)
+{
+    if (s_mutex == NULL)
+    {
+        s_mutex = xSemaphoreCreateMutex();
+    }
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+}
+
+static void cache_unlock(void)
+{
+    xSemaphoreGive(s_mutex);
+}
+
+static void entry_free(dir_entry_t *e)
+{
+    s_stats.bytes -= e->len;
+    s_stats.entries--;
+    heap_caps_free(e->recs);
+    memset(e, 0, sizeof(*e));
+}
+
+// 持有锁时调用
+static dir_entry_t *cache_find(const char *path)
+{
+    for (int i = 0; i < SD_DIR_CACHE_MAX_DIRS; i++)
+    {
+        if (s_entries[i].used && strcmp(s_entries[i].path, path) == 0)
+        {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+// 从最久没用的开始删 直到放得下need字节并有一个空位
+static dir_entry_t *cache_make_room(uint32_t need)
+{
+    while (true)
+    {
+        dir_entry_t *slot = NULL;
+        dir_entry_t *lru = NULL;
+        for (int i = 0; i < SD_DIR_CACHE_MAX_DIRS; i++)
+        {
+            dir_entry_t *e = &s_entries[i];
+            if (!e->used)
+            {
+                slot = slot ? slot : e;
+            }
+            else if (lru == NULL || e->stamp < lru->stamp)
+            {
+                lru = e;
+            }
+        }
+        if (slot && s_stats.bytes + need <= SD_DIR_CACHE_BUDGET)
+        {
+            return slot;
+        }
+        if (lru == NULL)
+        {
+            return NULL;
+        }
+        entry_free(lru);
+        s_stats.evictions++;
+    }
+}
+
+bool sd_dir_cache_get(const char *path, char **recs, size_t *len)
+{
+    cache_lock();
+    dir_entry_t *e = cache_find(path);
+    char *copy = NULL;
+    if (e && !e->held)
+    {
+        // 空目录也要给一个能free的指针
+        copy = malloc(e->len ? e->len : 1);
+        if (copy)
+        {
+            memcpy(copy, e->recs, e->len);
+            *recs = copy;
+            *len = e->len;
+            e->stamp = ++s_clock;
+        }
+    }
+    if (copy)
+    {
+        s_stats.hits++;
+    }
+    else
+    {
+        s_stats.misses++;
+    }
+    cache_unlock();
+    return copy != NULL;
+}
+
+uint32_t sd_dir_cache_gen(void)
+{
+    return s_gen;
+}
+
+void sd_dir_cache_put(const char *path, uint32_t gen, const char *recs, size_t len)
+{
+    if (SD_DIR_CACHE_BUDGET == 0 || strlen(path) >= SD_DIR_CACHE_PATH_LEN || len > SD_DIR_CACHE_BUDGET)
+    {
+        return;
+    }
+    cache_lock();
+    if (gen != s_gen)
+    {
+        // 读的时候卡上有改动 不知道改的是不是这个目录 不放
+        s_stats.discarded++;
+        cache_unlock();
+        return;
+    }
+    dir_entry_t *e = cache_find(path);
+    if (e)
+    {
+        entry_free(e);
+    }
+    e = cache_make_room(len);
+    char *copy = e ? heap_caps_malloc(len ? len : 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    if (copy)
+    {
+        memcpy(copy, recs, len);
+        strcpy(e->path, path);
+        e->recs = copy;
+        e->len = len;
+        e->stamp = ++s_clock;
+        e->used = true;
+        s_stats.entries++;
+        s_stats.bytes += len;
+    }
+    cache_unlock();
+}
+
+void sd_dir_cache_changed(const char *file_path)
+{
+    const char *slash = strrchr(file_path, '/');
+    if (slash == NULL)
+    {
+        return;
+    }
+    char dir[SD_DIR_CACHE_PATH_LEN];
+    size_t n = slash - file_path;
+    cache_lock();
+    s_gen++;
+    if (n < sizeof(dir))
+    {
+        memcpy(dir, file_path, n);
+        dir[n] = '\0';
+        dir_entry_t *e = cache_find(dir);
+        if (e)
+        {
+            ESP_LOGD(TAG, "%s changed", dir);
+            entry_free(e);
+            s_stats.invalidated++;
+        }
+    }
+    cache_unlock();
+    media_lib_changed(file_path);   // 写卡的地方都报到这里 媒体库也跟着作废那个目录
+}
+
+void sd_dir_cache_clear(void)
+{
+    cache_lock();
+    s_gen++;
+    for (int i = 0; i < SD_DIR_CACHE_MAX_DIRS; i++)
+    {
+        if (s_entries[i].used)
+        {
+            entry_free(&s_entries[i]);
+        }
+    }
+    cache_unlock();
+}
+
+void sd_dir_cache_hold(void)
+{
+    cache_lock();
+    s_gen++;
+    for (int i = 0; i < SD_DIR_CACHE_MAX_DIRS; i++)
+    {
+        s_entries[i].held = s_entries[i].used;
+    }
+    cache_unlock();
+}
+
+void sd_dir_cache_verify(const char *path, bool unchanged)
+{
+    cache_lock();
+    dir_entry_t *e = cache_find(path);
+    if (e && e->held)
+    {
+        if (unchanged)
+        {
+            e->held = false;
+            s_stats.restored++;
+        }
+        else
+        {
+            ESP_LOGD(TAG, "%s changed while unmounted", path);
+            entry_free(e);
+            s_stats.invalidated++;
+        }
+    }
+    cache_unlock();
+}
+
+void sd_dir_cache_get_stats(sd_dir_cache_stats_t *stats)
+{
+    cache_lock();
+    *stats = s_stats;
+    cache_unlock();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+
+
+/*********************** SD卡目录缓存 ****************************/
+// 文件浏览器列过的目录整个放进PSRAM 按路径找 返回上一级或者再进同一个目录时不用再读卡
+// FATFS增删文件不会改目录自己的修改时间 所以靠改动计数: 本程序在卡上新建/删除/写文件时报告一下 那个目录就作废
+// 每次改动全局计数加一 列目录前记下计数 读完发现中间变过就不放进缓存 读到一半的旧内容不会留下来
+// 按字节预算 满了先删最久没用的
+// 卸卡时不清空 先扣着不用 挂回同一张卡后媒体库逐个目录核对 没变的接着用 变了的和换了卡才丢掉
+
+#define SD_DIR_CACHE_BUDGET     (CONFIG_APP_DIR_CACHE_KB * 1024)
+#define SD_DIR_CACHE_MAX_DIRS   16
+#define SD_DIR_CACHE_PATH_LEN   256
+
+// 目录项的记录 一条接一条: 1字节类型 4字节文件大小 4字节修改时间 以0结尾的名字 数都是小端
+// 类型 0其他 1音乐 2视频 3图片 4GIF 5目录 和文件浏览器的图标一一对应
+// 修改时间是FATFS的日期在高16位 时间在低16位 直接比大小就是先后
+#define SD_DIR_REC_HDR          9
+#define SD_DIR_TYPE_DIR         5
+
+static inline uint32_t sd_dir_rec_u32(const char *p)
+{
+    const uint8_t *b = (const uint8_t *)p;
+    return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static inline int sd_dir_rec_type(const char *rec)
+{
+    return (uint8_t)rec[0];
+}
+
+static inline uint32_t sd_dir_rec_size(const char *rec)
+{
+    return sd_dir_rec_u32(rec + 1);
+}
+
+static inline uint32_t sd_dir_rec_mtime(const char *rec)
+{
+    return sd_dir_rec_u32(rec + 5);
+}
+
+static inline const char *sd_dir_rec_name(const char *rec)
+{
+    return rec + SD_DIR_REC_HDR;
+}
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t invalidated;               // 目录里有东西变了丢掉的
+    uint32_t discarded;                 // 读的时候卡上变了 没放进来的
+    uint32_t restored;                  // 重新挂卡后核对过没变 接着用的
+    uint32_t evictions;
+    uint32_t entries;
+    uint32_t bytes;                     // 当前占用的PSRAM
+} sd_dir_cache_stats_t;
+
+// 命中时拷一份记录出来 malloc的 调用者free 没有或者作废了返回false
+bool sd_dir_cache_get(const char *path, char **recs, size_t *len);
+uint32_t sd_dir_cache_gen(void);        // 开始读目录前记下来 放进缓存时带上
+void sd_dir_cache_put(const char *path, uint32_t gen, const char *recs, size_t len);
+void sd_dir_cache_changed(const char *file_path);   // file_path新建 删除或者写过 它所在的目录作废 媒体库里的也是
+void sd_dir_cache_clear(void);
+void sd_dir_cache_hold(void);           // 卸卡时调用 已有的目录先不用
+void sd_dir_cache_verify(const char *path, bool unchanged);    // 重新挂卡后 媒体库读完path这个目录报过来
+void sd_dir_cache_get_stats(sd_dir_cache_stats_t *stats);
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sd_fs.h"
+#include "esp32_s3_szp.h"
+#include "fd_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lvgl.h"
+
+static const char *TAG = "sd_fs";
+
+#define SD_FS_SECTOR            512
+
+typedef struct {
+    fd_pool_file_t *f;                  // 同一个文件在别处开着时共用句柄
+    uint8_t *buf;
+    uint32_t buf_size;
+    uint32_t buf_pos;                   // buf[0]对应的文件位置
+    uint32_t buf_len;                   // 缓冲里有效的字节数
+    uint32_t pos;                       // LVGL看到的读写位置
+    uint32_t size;
+    uint32_t reads;
+    uint32_t fills;
+    uint32_t bytes;
+    int64_t t_open;
+    char name[32];
+} sd_file_t;
+
+static sd_fs_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 从文件的pos处读len字节到dst 句柄可能共用 带偏移读不碰它的位置
+static bool file_read_at(sd_file_t *sf, uint32_t pos, void *dst, uint32_t len, uint32_t *got)
+{
+    int n = fd_pool_pread(sf->f, dst, len, pos);
+    sf->fills++;
+    *got = n > 0 ? n : 0;
+    return n >= 0;
+}
+
+static void *sd_fs_open(lv_fs_drv_t *drv, const char *path, lv_fs_mode_t mode)
+{
+    LV_UNUSED(drv);
+    if (mode != LV_FS_MODE_RD || path == NULL)
+    {
+        return NULL;
+    }
+    int64_t t0 = esp_timer_get_time();
+    char real_path[256];
+    if (path[0] == '/')
+    {
+        strlcpy(real_path, path, sizeof(real_path));
+    }
+    else
+    {
+        snprintf(real_path, sizeof(real_path), "%s/%s", SD_MOUNT_POINT, path);
+    }
+
+    sd_file_t *sf = calloc(1, sizeof(*sf));
+    fd_pool_file_t *f = sf ? fd_pool_open(real_path) : NULL;
+    if (f == NULL)
+    {
+        free(sf);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.failed++;
+        portEXIT_CRITICAL(&s_lock);
+        return NULL;
+    }
+    // 自己做缓冲 不经过stdio
+    sf->f = f;
+    sf->size = fd_pool_size(f);
+    sf->t_open = t0;
+
+    // 小文件只要够装下整个文件的缓冲
+    uint32_t want = SD_FS_READAHEAD;
+    if (sf->size + SD_FS_SECTOR < want)
+    {
+        want = (sf->size + SD_FS_SECTOR * 2 - 1) & ~(SD_FS_SECTOR - 1);
+    }
+    // SDMMC只能直接DMA进内部RAM 放PSRAM里会被驱动拆成一个扇区一次 内部RAM不够时才退到PSRAM
+    sf->buf = heap_caps_malloc(want, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (sf->buf == NULL)
+    {
+        sf->buf = heap_caps_malloc(want, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    sf->buf_size = sf->buf ? want : 0;
+
+    const char *base = strrchr(real_path, '/');
+    strlcpy(sf->name, base ? base + 1 : real_path, sizeof(sf->name));
+    return sf;
+}
+
+static lv_fs_res_t sd_fs_close(lv_fs_drv_t *drv, void *file_p)
+{
+    LV_UNUSED(drv);
+    sd_file_t *sf = file_p;
+    fd_pool_close(sf->f);
+    heap_caps_free(sf->buf);
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - sf->t_open);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.opened++;
+    s_stats.reads += sf->reads;
+    s_stats.fills += sf->fills;
+    s_stats.bytes += sf->bytes;
+    s_stats.open_us += us;
+    if (us > s_stats.max_open_us)
+    {
+        s_stats.max_open_us = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (sf->reads)
+    {
+        ESP_LOGI(TAG, "%s: %lu KB in %.1f ms, %lu reads -> %lu SD reads", sf->name, (unsigned long)sf->bytes / 1024,
+                 us / 1000.0, (unsigned long)sf->reads, (unsigned long)sf->fills);
+    }
+    free(sf);
+    return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t sd_fs_read(lv_fs_drv_t *drv, void *file_p, void *buf, uint32_t btr, uint32_t *br)
+{
+    LV_UNUSED(drv);
+    sd_file_t *sf = file_p;
+    uint8_t *out = buf;
+    uint32_t done = 0;
+    sf->reads++;
+    if (sf->pos >= sf->size)
+    {
+        btr = 0;
+    }
+    else if (btr > sf->size - sf->pos)
+    {
+        btr = sf->size - sf->pos;
+    }
+
+    while (done < btr)
+    {
+        // 缓冲里有的先拷走
+        if (sf->pos >= sf->buf_pos && sf->pos < sf->buf_pos + sf->buf_len)
+        {
+            uint32_t off = sf->pos - sf->buf_pos;
+            uint32_t n = LV_MIN(sf->buf_len - off, btr - done);
+            memcpy(out + done, sf->buf + off, n);
+            sf->pos += n;
+            done += n;
+            continue;
+        }
+        uint32_t left = btr - done;
+        uint32_t got;
+        if (left >= sf->buf_size)
+        {
+            // 大块读取不过缓冲 整扇区的部分直接读进去 零头下一轮从缓冲给
+            uint32_t n = sf->buf_size ? left & ~(SD_FS_SECTOR - 1) : left;
+            if (!file_read_at(sf, sf->pos, out + done, n, &got))
+            {
+                break;
+            }
+            portENTER_CRITICAL(&s_lock);
+            s_stats.direct++;
+            portEXIT_CRITICAL(&s_lock);
+            sf->pos += got;
+            done += got;
+            if (got < n)
+            {
+                break;
+            }
+            continue;
+        }
+        // 从当前位置往下对齐到扇区 一次读满缓冲
+        uint32_t start = sf->pos & ~(SD_FS_SECTOR - 1);
+        if (!file_read_at(sf, start, sf->buf, sf->buf_size, &got) || start + got <= sf->pos)
+        {
+            sf->buf_len = 0;
+            break;
+        }
+        sf->buf_pos = start;
+        sf->buf_len = got;
+    }
+    sf->bytes += done;
+    if (br)
+    {
+        *br = done;
+    }
+    return (done == btr) ? LV_FS_RES_OK : LV_FS_RES_FS_ERR;
+}
+
+static lv_fs_res_t sd_fs_seek(lv_fs_drv_t *drv, void *file_p, uint32_t pos, lv_fs_whence_t whence)
+{
+    LV_UNUSED(drv);
+    sd_file_t *sf = file_p;
+    // 只记下位置 读的时候缓冲里没有才去读卡
+    int64_t p = pos;
+    if (whence == LV_FS_SEEK_CUR)
+    {
+        p += sf->pos;
+    }
+    else if (whence == LV_FS_SEEK_END)
+    {
+        p += sf->size;
+    }
+    if (p < 0 || p > UINT32_MAX)
+    {
+        return LV_FS_RES_INV_PARAM;
+    }
+    sf->pos = p;
+    return LV_FS_RES_OK;
+}
+
+static lv_fs_res_t sd_fs_tell(lv_fs_drv_t *drv, void *file_p, uint32_t *pos_p)
+{
+    LV_UNUSED(drv);
+    sd_file_t *sf = file_p;
+    *pos_p = sf->pos;
+    return LV_FS_RES_OK;
+}
+
+void sd_fs_register(void)
+{
+    static lv_fs_drv_t drv;
+    lv_fs_drv_init(&drv);
+    drv.letter = SD_FS_LETTER;
+    drv.cache_size = 0;                 // lv_fs自己的缓存会把大读取拆开 缓冲都在这里做
+    drv.open_cb = sd_fs_open;
+    drv.close_cb = sd_fs_close;
+    drv.read_cb = sd_fs_read;
+    drv.seek_cb = sd_fs_seek;
+    drv.tell_cb = sd_fs_tell;
+    lv_fs_drv_register(&drv);
+}
+
+void sd_fs_get_stats(sd_fs_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+
+/*********************** SD卡的LVGL文件系统驱动 ****************************/
+// LVGL自带的stdio盘符"A:"只有256字节缓存 解码器按行读一张图要上千次FATFS调用
+// "S:"盘符每个打开的文件带一块预读缓冲 按扇区对齐一次读满 小读取直接从缓冲里拷
+// 句柄从fd_pool拿 同一张图被缩略图和大图同时读时共用一个fd
+// 比缓冲还大的读取直接读进调用者的内存 路径和"A:"一样写完整的VFS路径 比如S:/sdcard/pic/a.jpg
+// 只读 写文件还是走"A:"或者直接fopen
+
+#define SD_FS_LETTER            'S'
+#define SD_FS_READAHEAD         (CONFIG_APP_SD_FS_READAHEAD_KB * 1024)
+
+// 图片解码用的盘符 关掉预读时退回LVGL的stdio驱动
+#if CONFIG_APP_SD_FS_READAHEAD_KB > 0
+#define SD_FS_DRIVE             "S:"
+#else
+#define SD_FS_DRIVE             "A:"
+#endif
+
+typedef struct {
+    uint32_t opened;
+    uint32_t failed;
+    uint32_t reads;                     // LVGL发来的读请求
+    uint32_t fills;                     // 真正的FATFS读取 包括直接读进调用者内存的
+    uint32_t direct;                    // 其中绕过预读缓冲的
+    uint64_t bytes;                     // 交给LVGL的字节数
+    uint64_t open_us;                   // 打开到关闭的总耗时 也就是一张图的加载时间
+    uint32_t max_open_us;
+} sd_fs_stats_t;
+
+void sd_fs_register(void);              // 注册"S:"盘符 在lv_init之后调用
+void sd_fs_get_stats(sd_fs_stats_t *stats);
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include "sd_hotplug.h"
+#include "task_plan.h"
+#include "evt_bus.h"
+#include "esp32_s3_szp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "sdmmc_cmd.h"
+#include "esp_log.h"
+
+static const char *TAG = "sd_hotplug";
+
+extern sdmmc_card_t *sdmmc_card;
+
+static sd_hotplug_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_task;
+
+// EVT_SD的直接订阅者都返回了才往下走 拔卡时它们关完文件才卸载
+static void notify(sd_hotplug_event_t event)
+{
+    evt_bus_publish(EVT_SD, event, 0);
+}
+
+// 卡座开关说有没有卡 没接开关的话不知道 当作有
+static bool slot_occupied(void)
+{
+#if SD_CD_IO >= 0
+    return gpio_get_level(SD_CD_IO) == 0;
+#else
+    return true;
+#endif
+}
+
+// 挂着的卡还在不在 CMD13和数据读写一样排队 不会打断正在进行的传输
+static bool card_alive(void)
+{
+    if (!slot_occupied())
+    {
+        return false;
+    }
+    static int s_misses;
+    if (sdmmc_get_status(sdmmc_card) == ESP_OK)
+    {
+        s_misses = 0;
+        return true;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.status_errors++;
+    portEXIT_CRITICAL(&s_lock);
+    if (++s_misses < SD_HOTPLUG_MISSES)
+    {
+        return true;
+    }
+    s_misses = 0;
+    return false;
+}
+
+static void card_removed(void)
+{
+    ESP_LOGW(TAG, "SD card removed");
+    portENTER_CRITICAL(&s_lock);
+    s_stats.removals++;
+    portEXIT_CRITICAL(&s_lock);
+    notify(SD_HOTPLUG_REMOVED);     // 录像 播放这些先关掉文件
+    esp_err_t ret = bsp_sdcard_unmount();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "unmount failed (%s)", esp_err_to_name(ret));
+    }
+}
+
+static bool card_probe(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.probes++;
+    portEXIT_CRITICAL(&s_lock);
+    if (bsp_sdcard_mount() != ESP_OK)
+    {
+        return false;
+    }
+    ESP_LOGI(TAG, "SD card inserted");
+    portENTER_CRITICAL(&s_lock);
+    s_stats.insertions++;
+    portEXIT_CRITICAL(&s_lock);
+    notify(SD_HOTPLUG_INSERTED);
+    return true;
+}
+
+static void hotplug_task(void *arg)
+{
+    uint32_t probe_ms = SD_HOTPLUG_POLL_MS;
+    uint32_t waited_ms = 0;
+    for (;;)
+    {
+        vTaskDelay(pdMS_TO_TICKS(SD_HOTPLUG_POLL_MS));
+        if (bsp_sdcard_mounted())
+        {
+            if (!card_alive())
+            {
+                card_removed();
+                probe_ms = SD_HOTPLUG_POLL_MS;
+                waited_ms = 0;
+            }
+            continue;
+        }
+#if SD_CD_IO >= 0
+        // 有检测开关 插上了才挂 挂不上多半是卡坏了 照样越试越慢
+        if (!slot_occupied())
+        {
+            probe_ms = SD_HOTPLUG_POLL_MS;
+            waited_ms = 0;
+            continue;
+        }
+        if (waited_ms == 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(SD_HOTPLUG_SETTLE_MS));
+        }
+#endif
+        waited_ms += SD_HOTPLUG_POLL_MS;
+        if (waited_ms < probe_ms)
+        {
+            continue;
+        }
+        waited_ms = 0;
+        if (card_probe())
+        {
+            probe_ms = SD_HOTPLUG_POLL_MS;
+        }
+        else if (probe_ms < SD_HOTPLUG_MAX_PROBE_MS)
+        {
+            probe_ms *= 2;
+        }
+    }
+}
+
+esp_err_t sd_hotplug_start(void)
+{
+    if (s_task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+#if SD_CD_IO >= 0
+    gpio_config_t cd = {
+        .pin_bit_mask = 1ULL << SD_CD_IO,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+    };
+    gpio_config(&cd);
+#endif
+    if (task_plan_create(TASK_SD_HOTPLUG, hotplug_task, NULL, &s_task) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void sd_hotplug_get_stats(sd_hotplug_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** SD卡热插拔 ****************************/
+// 低优先级任务盯着卡 拔卡后先让在用卡的模块停下(录像 播放) 再卸载 插上新卡不用重启就挂上
+// 卡座有检测开关(CONFIG_APP_SD_CD_GPIO)就看它的电平 没有就定时问卡的状态(CMD13) 连着两次不回才算拔了
+// 没卡时只能试着挂载来发现插卡 失败一次间隔翻倍 最长SD_HOTPLUG_MAX_PROBE_MS
+// 挂回同一张卡时目录缓存留着 媒体库核对过没变的目录接着用(见sd_dir_cache.h) 不必整个重来
+
+#define SD_HOTPLUG_POLL_MS          CONFIG_APP_SD_POLL_MS
+#define SD_HOTPLUG_MAX_PROBE_MS     8000
+#define SD_HOTPLUG_MISSES           2       // CMD13连着这么多次不回算拔卡
+#define SD_HOTPLUG_SETTLE_MS        300     // 检测开关说有卡以后等触点接稳再挂
+
+typedef enum {
+    SD_HOTPLUG_REMOVED = 0,             // 卡已经拔了 还没卸载 回调返回前把打开的文件关掉
+    SD_HOTPLUG_INSERTED,                // 新挂上的
+} sd_hotplug_event_t;
+
+// 变化作为EVT_SD发到evt_bus a是sd_hotplug_event_t
+// 用EVT_BUS_DIRECT订阅的在热插拔任务里调 可以阻塞一会儿 不要碰LVGL 界面的事另外用EVT_BUS_UI订阅
+
+typedef struct {
+    uint32_t removals;
+    uint32_t insertions;
+    uint32_t probes;                    // 没卡时试着挂载的次数
+    uint32_t status_errors;             // CMD13没回或者报错
+} sd_hotplug_stats_t;
+
+esp_err_t sd_hotplug_start(void);       // 开机的SD卡阶段结束后调用 卡在不在都要启动
+void sd_hotplug_get_stats(sd_hotplug_stats_t *stats);
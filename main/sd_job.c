@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sd_job.h"
+#include "sd_writer.h"
+#include "sd_dir_cache.h"
+#include "fd_pool.h"
+#include "task_plan.h"
+#include "esp32_s3_szp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "ff.h"
+
+static const char *TAG = "sd_job";
+
+#define JOB_PATH_LEN        SD_DIR_CACHE_PATH_LEN
+#define JOB_FPATH_LEN       (SD_DIR_CACHE_PATH_LEN + 4)
+#define JOB_SPEED_MIN       (1024 * 1024)   // 比这小的文件打开关闭占大头 不算速度
+
+struct sd_job {
+    sd_job_op_t op;
+    uint32_t gen;                       // 和s_gen不一样就是被取消了
+    char dst[JOB_PATH_LEN];
+    char *srcs;                         // 一个接一个以0结尾的路径
+    size_t used;
+    size_t size;
+    sd_job_cb_t cb;
+    void *arg;
+};
+
+// 目录递归每一层的东西 放堆上 任务栈只留路径
+typedef struct {
+    FF_DIR dir;
+    FILINFO fno;
+    char fpath[JOB_FPATH_LEN];
+} job_frame_t;
+
+typedef struct {
+    esp_err_t (*file)(sd_job_t *job, const char *src, const char *dst, uint32_t size);
+    esp_err_t (*dir_pre)(sd_job_t *job, const char *src, const char *dst);     // 进去之前
+    esp_err_t (*dir_post)(sd_job_t *job, const char *src, const char *dst);    // 里面都做完了
+} job_walk_t;
+
+static QueueHandle_t s_queue;
+static volatile uint32_t s_gen;
+static volatile int s_pending;          // 排着的加正在做的
+static sd_job_progress_t s_prog;        // 下面这些只有作业任务用
+static int64_t s_t_report;
+static FIL s_in;
+static char s_fsrc[JOB_FPATH_LEN];
+static char s_fdst[JOB_FPATH_LEN];
+static char s_src[JOB_PATH_LEN];
+static char s_dst[JOB_PATH_LEN];
+static FILINFO s_fno;
+static sd_job_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool job_cancelled(const sd_job_t *job)
+{
+    return job->gen != s_gen;
+}
+
+static bool job_ff(const char *path, char *out)
+{
+    return bsp_sdcard_fatfs_path(path, out, JOB_FPATH_LEN);
+}
+
+static const char *job_base(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static void job_report(sd_job_t *job, const char *name, bool force)
+{
+    int64_t now = esp_timer_get_time();
+    if (job->cb == NULL || (!force && now - s_t_report < SD_JOB_PROGRESS_MS * 1000))
+    {
+        return;
+    }
+    s_t_report = now;
+    s_prog.name = name;
+    job->cb(&s_prog, job->arg);
+}
+
+// dir下没有name就用name 有了就试name_1.ext name_2.ext 都有了或者太长返回false
+static bool job_unique(const char *dir, const char *name, char *out)
+{
+    const char *dot = strrchr(name, '.');
+    int stem = dot && dot != name ? dot - name : (int)strlen(name);
+    for (int i = 0; i < 100; i++)
+    {
+        int n = i == 0 ? snprintf(out, JOB_PATH_LEN, "%s/%s", dir, name)
+                       : snprintf(out, JOB_PATH_LEN, "%s/%.*s_%d%s", dir, stem, name, i, name + stem);
+        if (n >= JOB_PATH_LEN || !job_ff(out, s_fdst))
+        {
+            return false;
+        }
+        if (f_stat(s_fdst, NULL) == FR_NO_FILE)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// src是目录 一项项走下去 名字就地接在src和dst后面 回来时截掉
+static esp_err_t job_walk(sd_job_t *job, const job_walk_t *ops, char *src, char *dst, int depth)
+{
+    ESP_RETURN_ON_FALSE(depth < SD_JOB_MAX_DEPTH, ESP_ERR_NOT_SUPPORTED, TAG, "%s: too deep", src);
+    job_frame_t *fr = malloc(sizeof(job_frame_t));
+    if (fr == NULL || !job_ff(src, fr->fpath) || f_opendir(&fr->dir, fr->fpath) != FR_OK)
+    {
+        free(fr);
+        ESP_LOGE(TAG, "open dir %s failed", src);
+        return ESP_FAIL;
+    }
+    size_t sl = strlen(src);
+    size_t dl = dst ? strlen(dst) : 0;
+    esp_err_t ret = ESP_OK;
+    while (ret == ESP_OK && !job_cancelled(job))
+    {
+        if (f_readdir(&fr->dir, &fr->fno) != FR_OK)
+        {
+            ret = ESP_FAIL;
+            break;
+        }
+        if (fr->fno.fname[0] == '\0')
+        {
+            break;
+        }
+        if (snprintf(src + sl, JOB_PATH_LEN - sl, "/%s", fr->fno.fname) >= (int)(JOB_PATH_LEN - sl) ||
+            (dst && snprintf(dst + dl, JOB_PATH_LEN - dl, "/%s", fr->fno.fname) >= (int)(JOB_PATH_LEN - dl)))
+        {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+        else if (fr->fno.fattrib & AM_DIR)
+        {
+            ret = ops->dir_pre ? ops->dir_pre(job, src, dst) : ESP_OK;
+            if (ret == ESP_OK)
+            {
+                ret = job_walk(job, ops, src, dst, depth + 1);
+            }
+            if (ret == ESP_OK && ops->dir_post)
+            {
+                ret = ops->dir_post(job, src, dst);
+            }
+        }
+        else
+        {
+            ret = ops->file(job, src, dst, (uint32_t)fr->fno.fsize);
+        }
+        src[sl] = '\0';
+        if (dst)
+        {
+            dst[dl] = '\0';
+        }
+    }
+    f_closedir(&fr->dir);
+    free(fr);
+    return ret;
+}
+
+/******************** 数一遍 ********************/
+static esp_err_t count_file(sd_job_t *job, const char *src, const char *dst, uint32_t size)
+{
+    s_prog.files++;
+    s_prog.bytes += size;
+    return ESP_OK;
+}
+
+static const job_walk_t s_count_ops = {.file = count_file};
+
+/******************** 复制 ********************/
+// 读进sd_writer正在填的那块 填满了它交给写盘任务 这边接着读下一块
+static esp_err_t copy_file(sd_job_t *job, const char *src, const char *dst, uint32_t size)
+{
+    const char *name = job_base(src);
+    if (!job_ff(src, s_fsrc) || f_open(&s_in, s_fsrc, FA_READ) != FR_OK)
+    {
+        ESP_LOGE(TAG, "open %s failed", src);
+        return ESP_FAIL;
+    }
+    sd_writer_t *w = sd_writer_open(dst, size);
+    if (w == NULL)
+    {
+        f_close(&s_in);
+        return ESP_FAIL;
+    }
+    int64_t t0 = esp_timer_get_time();
+    uint32_t copied = 0;
+    esp_err_t ret = ESP_OK;
+    while (!job_cancelled(job))
+    {
+        size_t room;
+        uint8_t *p = sd_writer_reserve(w, &room);
+        UINT br = 0;
+        if (p == NULL || f_read(&s_in, p, room, &br) != FR_OK)
+        {
+            ret = ESP_FAIL;
+            break;
+        }
+        ret = sd_writer_commit(w, br);
+        copied += br;
+        s_prog.bytes_done += br;
+        if (ret != ESP_OK || br < room)
+        {
+            break;
+        }
+        job_report(job, name, false);
+    }
+    f_close(&s_in);
+    if (ret == ESP_OK && !job_cancelled(job))
+    {
+        ret = sd_writer_close(w);
+    }
+    else
+    {
+        sd_writer_abort(w); // 写了一半的不留
+        if (ret == ESP_OK)
+        {
+            return ESP_OK; // 取消了 不算错
+        }
+    }
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "copy %s -> %s failed", src, dst);
+        return ret;
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    uint32_t kbps = us && copied >= JOB_SPEED_MIN ? (uint32_t)((uint64_t)copied * 1000000 / 1024 / us) : 0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.copied++;
+    s_stats.copy_bytes += copied;
+    s_stats.copy_us += us;
+    if (kbps > s_stats.max_copy_kbps)
+    {
+        s_stats.max_copy_kbps = kbps;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    s_prog.files_done++;
+    job_report(job, name, true);
+    return ESP_OK;
+}
+
+static esp_err_t copy_mkdir(sd_job_t *job, const char *src, const char *dst)
+{
+    if (!job_ff(dst, s_fdst))
+    {
+        return ESP_FAIL;
+    }
+    FRESULT fr = f_mkdir(s_fdst);
+    sd_dir_cache_changed(dst);
+    ESP_RETURN_ON_FALSE(fr == FR_OK || fr == FR_EXIST, ESP_FAIL, TAG, "mkdir %s failed (%d)", dst, fr);
+    return ESP_OK;
+}
+
+static const job_walk_t s_copy_ops = {.file = copy_file, .dir_pre = copy_mkdir};
+
+/******************** 删除 ********************/
+static esp_err_t delete_one(sd_job_t *job, const char *src)
+{
+    fd_pool_flush(src);     // 留着的空闲句柄先关 FATFS不管开着的文件
+    FRESULT fr = job_ff(src, s_fsrc) ? f_unlink(s_fsrc) : FR_INVALID_NAME;
+    sd_dir_cache_changed(src);
+    ESP_RETURN_ON_FALSE(fr == FR_OK, ESP_FAIL, TAG, "delete %s failed (%d)", src, fr);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.deleted++;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+static esp_err_t delete_file(sd_job_t *job, const char *src, const char *dst, uint32_t size)
+{
+    esp_err_t ret = delete_one(job, src);
+    s_prog.files_done++;
+    job_report(job, job_base(src), false);
+    return ret;
+}
+
+static esp_err_t delete_dir(sd_job_t *job, const char *src, const char *dst)
+{
+    return delete_one(job, src);
+}
+
+static const job_walk_t s_delete_ops = {.file = delete_file, .dir_post = delete_dir};
+
+/******************** 改目录项 ********************/
+static esp_err_t job_rename(const char *src, const char *dst, bool is_dir)
+{
+    fd_pool_flush(src);
+    FRESULT fr = job_ff(src, s_fsrc) && job_ff(dst, s_fdst) ? f_rename(s_fsrc, s_fdst) : FR_INVALID_NAME;
+    sd_dir_cache_changed(src);
+    sd_dir_cache_changed(dst);
+    if (is_dir)
+    {
+        sd_dir_cache_clear(); // 下面各级目录缓存的路径都变了
+    }
+    ESP_RETURN_ON_FALSE(fr == FR_OK, fr == FR_EXIST ? ESP_ERR_INVALID_STATE : ESP_FAIL, TAG,
+                        "rename %s -> %s failed (%d)", src, dst, fr);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.moved++;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+// dst在src里面 或者就是src
+static bool job_inside(const char *dst, const char *src)
+{
+    size_t n = strlen(src);
+    return strncmp(dst, src, n) == 0 && (dst[n] == '\0' || dst[n] == '/');
+}
+
+// 选中的一项
+static esp_err_t job_item(sd_job_t *job, const char *src)
+{
+    if (!job_ff(src, s_fsrc) || f_stat(s_fsrc, &s_fno) != FR_OK)
+    {
+        ESP_LOGE(TAG, "%s not found", src);
+        return ESP_ERR_NOT_FOUND;
+    }
+    bool is_dir = s_fno.fattrib & AM_DIR;
+    uint32_t size = (uint32_t)s_fno.fsize;
+    const char *name = job_base(src);
+    esp_err_t ret = ESP_OK;
+    switch (job->op)
+    {
+    case SD_JOB_COPY:
+        ESP_RETURN_ON_FALSE(!is_dir || !job_inside(job->dst, src), ESP_ERR_INVALID_ARG, TAG, "%s into itself", src);
+        ESP_RETURN_ON_FALSE(job_unique(job->dst, name, s_dst), ESP_ERR_INVALID_SIZE, TAG, "no name for %s", src);
+        if (!is_dir)
+        {
+            return copy_file(job, src, s_dst, size);
+        }
+        strlcpy(s_src, src, sizeof(s_src));
+        ret = copy_mkdir(job, s_src, s_dst);
+        return ret == ESP_OK ? job_walk(job, &s_copy_ops, s_src, s_dst, 0) : ret;
+    case SD_JOB_DELETE:
+        if (!is_dir)
+        {
+            return delete_file(job, src, NULL, size);
+        }
+        strlcpy(s_src, src, sizeof(s_src));
+        ret = job_walk(job, &s_delete_ops, s_src, NULL, 0);
+        return ret == ESP_OK && !job_cancelled(job) ? delete_one(job, src) : ret;
+    case SD_JOB_MOVE:
+    {
+        size_t n = name - src - 1;
+        if (strlen(job->dst) == n && strncmp(job->dst, src, n) == 0)
+        {
+            ret = ESP_OK; // 已经在这个目录里了
+        }
+        else if (is_dir && job_inside(job->dst, src))
+        {
+            ESP_LOGE(TAG, "%s into itself", src);
+            ret = ESP_ERR_INVALID_ARG;
+        }
+        else
+        {
+            ret = job_unique(job->dst, name, s_dst) ? job_rename(src, s_dst, is_dir) : ESP_ERR_INVALID_SIZE;
+        }
+        s_prog.files_done++;
+        job_report(job, name, true);
+        return ret;
+    }
+    case SD_JOB_RENAME:
+    {
+        int n = snprintf(s_dst, sizeof(s_dst), "%.*s/%s", (int)(name - src - 1), src, job->dst);
+        ESP_RETURN_ON_FALSE(n < (int)sizeof(s_dst) && job->dst[0] && strchr(job->dst, '/') == NULL, ESP_ERR_INVALID_ARG, TAG,
+                            "bad name %s", job->dst);
+        ret = job_rename(src, s_dst, is_dir);
+        s_prog.files_done++;
+        job_report(job, name, true);
+        return ret;
+    }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+static void job_run(sd_job_t *job)
+{
+    int64_t t0 = esp_timer_get_time();
+    memset(&s_prog, 0, sizeof(s_prog));
+    s_prog.op = job->op;
+    s_t_report = 0;
+    // 复制和删除先数一遍 进度条才有总数
+    for (const char *p = job->srcs; p < job->srcs + job->used && !job_cancelled(job); p += strlen(p) + 1)
+    {
+        if (job->op == SD_JOB_MOVE || job->op == SD_JOB_RENAME)
+        {
+            s_prog.files++;
+        }
+        else if (job_ff(p, s_fsrc) && f_stat(s_fsrc, &s_fno) == FR_OK)
+        {
+            if (s_fno.fattrib & AM_DIR)
+            {
+                strlcpy(s_src, p, sizeof(s_src));
+                job_walk(job, &s_count_ops, s_src, NULL, 0);
+            }
+            else
+            {
+                count_file(job, p, NULL, (uint32_t)s_fno.fsize);
+            }
+        }
+    }
+    job_report(job, NULL, true);
+
+    for (const char *p = job->srcs; p < job->srcs + job->used && !job_cancelled(job); p += strlen(p) + 1)
+    {
+        esp_err_t ret = job_item(job, p);
+        if (ret != ESP_OK && s_prog.err == ESP_OK)
+        {
+            s_prog.err = ret;
+        }
+        if (ret != ESP_OK && job->op != SD_JOB_DELETE)
+        {
+            break; // 删除遇到删不掉的接着删别的 其他的停下来
+        }
+    }
+    s_prog.cancelled = job_cancelled(job);
+    s_prog.finished = true;
+    int64_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.jobs++;
+    s_stats.failed += s_prog.err != ESP_OK;
+    s_stats.cancelled += s_prog.cancelled;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%s: %lu/%lu items, %lu KB in %lld ms (%.0f KB/s)%s%s", sd_job_op_name(job->op),
+             (unsigned long)s_prog.files_done, (unsigned long)s_prog.files, (unsigned long)(s_prog.bytes_done / 1024),
+             us / 1000, us ? s_prog.bytes_done * 1e6 / 1024 / us : 0.0, s_prog.cancelled ? ", cancelled" : "",
+             s_prog.err != ESP_OK ? ", failed" : "");
+    job_report(job, NULL, true);
+}
+
+static void job_free(sd_job_t *job)
+{
+    free(job->srcs);
+    free(job);
+}
+
+static void job_task(void *arg)
+{
+    sd_job_t *job;
+    for (;;)
+    {
+        xQueueReceive(s_queue, &job, portMAX_DELAY);
+        job_run(job);
+        job_free(job);
+        portENTER_CRITICAL(&s_lock);
+        s_pending--;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+sd_job_t *sd_job_new(sd_job_op_t op, const char *dst)
+{
+    sd_job_t *job = calloc(1, sizeof(sd_job_t));
+    if (job == NULL)
+    {
+        return NULL;
+    }
+    job->op = op;
+    if (dst && strlcpy(job->dst, dst, sizeof(job->dst)) >= sizeof(job->dst))
+    {
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+esp_err_t sd_job_add(sd_job_t *job, const char *src)
+{
+    size_t len = strlen(src) + 1;
+    ESP_RETURN_ON_FALSE(len <= JOB_PATH_LEN, ESP_ERR_INVALID_SIZE, TAG, "path too long");
+    if (job->used + len > job->size)
+    {
+        size_t size = job->size ? job->size * 2 : 512;
+        while (size < job->used + len)
+        {
+            size *= 2;
+        }
+        char *p = realloc(job->srcs, size);
+        ESP_RETURN_ON_FALSE(p, ESP_ERR_NO_MEM, TAG, "no memory for %s", src);
+        job->srcs = p;
+        job->size = size;
+    }
+    memcpy(job->srcs + job->used, src, len);
+    job->used += len;
+    return ESP_OK;
+}
+
+esp_err_t sd_job_submit(sd_job_t *job, sd_job_cb_t cb, void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    if (job->used == 0)
+    {
+        ret = ESP_ERR_INVALID_ARG;
+    }
+    else if (s_queue == NULL)
+    {
+        s_queue = xQueueCreate(SD_JOB_QUEUE_LEN, sizeof(sd_job_t *));
+        if (s_queue == NULL || task_plan_create(TASK_SD_JOB, job_task, NULL, NULL) != pdPASS)
+        {
+            ESP_LOGE(TAG, "job task start failed");
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    if (ret == ESP_OK)
+    {
+        job->cb = cb;
+        job->arg = arg;
+        job->gen = s_gen;
+        portENTER_CRITICAL(&s_lock);
+        s_pending++;
+        portEXIT_CRITICAL(&s_lock);
+        if (xQueueSend(s_queue, &job, 0) != pdTRUE)
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_pending--;
+            portEXIT_CRITICAL(&s_lock);
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    if (ret != ESP_OK)
+    {
+        job_free(job);
+    }
+    return ret;
+}
+
+void sd_job_cancel(void)
+{
+    s_gen++;
+}
+
+bool sd_job_busy(void)
+{
+    return s_pending > 0;
+}
+
+const char *sd_job_op_name(sd_job_op_t op)
+{
+    static const char *const names[] = {"copy", "move", "delete", "rename"};
+    return op <= SD_JOB_RENAME ? names[op] : "?";
+}
+
+void sd_job_get_stats(sd_job_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
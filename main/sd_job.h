@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** SD卡后台文件操作 ****************************/
+// 文件浏览器的复制 移动 删除 改名 在核0的低优先级任务里一个接一个做 界面只管投递和显示进度
+// 复制: 源文件f_read直接读进sd_writer的块缓冲 读满一块交给写盘任务 同时读下一块 读写交替不拷贝
+//       目标预分配成源文件的大小 目录整个递归复制
+// 移动: 都在SD卡这一个卷上 只改目录项(f_rename) 不搬数据 目录也是一次
+// 删除: 目录递归删 改名: 同一个目录里f_rename
+// 目标已经有同名的 复制和移动自动加_1 _2 改名报错
+// 进度在任务里回调 最多SD_JOB_PROGRESS_MS一次 每个文件完了和整个作业结束时各一次
+
+#define SD_JOB_QUEUE_LEN        4
+#define SD_JOB_PROGRESS_MS      100
+#define SD_JOB_MAX_DEPTH        8       // 递归复制/删除的目录层数
+
+typedef enum {
+    SD_JOB_COPY,
+    SD_JOB_MOVE,
+    SD_JOB_DELETE,
+    SD_JOB_RENAME,
+} sd_job_op_t;
+
+typedef struct {
+    sd_job_op_t op;
+    uint32_t files_done;
+    uint32_t files;                     // 复制和删除先数过 移动是选中的项数
+    uint64_t bytes_done;
+    uint64_t bytes;                     // 只有复制有
+    const char *name;                   // 正在做的 回调返回后失效
+    bool finished;
+    bool cancelled;
+    esp_err_t err;                      // 结束时第一个错误
+} sd_job_progress_t;
+
+// 在作业任务里调用 不能碰LVGL 用ui_post_*
+typedef void (*sd_job_cb_t)(const sd_job_progress_t *p, void *arg);
+
+typedef struct sd_job sd_job_t;
+
+typedef struct {
+    uint32_t jobs;
+    uint32_t failed;                    // 出过错的作业
+    uint32_t cancelled;
+    uint32_t copied;                    // 文件数
+    uint32_t moved;                     // 改目录项的次数 移动和改名
+    uint32_t deleted;
+    uint64_t copy_bytes;
+    uint64_t copy_us;
+    uint32_t max_copy_kbps;             // 单个大于1MB的文件里最快的
+} sd_job_stats_t;
+
+// dst: 复制和移动是目标目录 改名是新名字 删除不用
+sd_job_t *sd_job_new(sd_job_op_t op, const char *dst);
+esp_err_t sd_job_add(sd_job_t *job, const char *src);   // 加一个源路径 /sdcard下的
+// 交给后台任务 job归它管 失败也会释放
+esp_err_t sd_job_submit(sd_job_t *job, sd_job_cb_t cb, void *arg);
+void sd_job_cancel(void);               // 停掉正在做的和排着的 做了一半的文件删掉
+bool sd_job_busy(void);
+const char *sd_job_op_name(sd_job_op_t op);
+void sd_job_get_stats(sd_job_stats_t *stats);
@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sd_sort.h"
+#include "sd_dir_cache.h"
+#include "media_type.h"
+#include "ff.h"
+
+#define SORT_FULL_KEY_LEN   (4 * 256)   // 255字节的名字每个字节最多变成4字节键
+
+static struct {
+    const char *recs;
+    const uint32_t *offs;
+    const sd_sort_key_t *keys;
+    sd_sort_mode_t mode;
+} s_ctx;
+
+// 取一个UTF-8字符 坏的字节当成单个字符
+static uint32_t utf8_next(const uint8_t **p)
+{
+    const uint8_t *s = *p;
+    uint32_t c = s[0];
+    int n = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    for (int i = 1; i <= n; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            n = 0;
+            break;
+        }
+    }
+    if (n)
+    {
+        c &= 0x3F >> n;
+        for (int i = 1; i <= n; i++)
+        {
+            c = c << 6 | (s[i] & 0x3F);
+        }
+    }
+    *p = s + n + 1;
+    return c;
+}
+
+// ASCII一个字节 GBK两个字节(第一个字节>=0x81 排在ASCII后面) 936里没有的0xFF加三字节码点 排在最后
+// 字节串直接比大小就是想要的顺序
+size_t sd_sort_collate(const char *name, uint8_t *key, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)name;
+    size_t n = 0;
+    while (*p)
+    {
+        uint32_t c = utf8_next(&p);
+        uint8_t unit[4];
+        int m;
+        if (c < 0x80)
+        {
+            unit[0] = c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+            m = 1;
+        }
+        else
+        {
+            WCHAR oem = c <= 0xFFFF ? ff_uni2oem(c, 936) : 0;
+            if (oem >= 0x8100)
+            {
+                unit[0] = oem >> 8;
+                unit[1] = oem;
+                m = 2;
+            }
+            else
+            {
+                unit[0] = 0xFF;
+                unit[1] = c >> 16;
+                unit[2] = c >> 8;
+                unit[3] = c;
+                m = 4;
+            }
+        }
+        for (int i = 0; i < m; i++, n++)
+        {
+            if (n < len)
+            {
+                key[n] = unit[i];
+            }
+        }
+    }
+    if (n < len)
+    {
+        memset(key + n, 0, len - n);
+    }
+    return n;
+}
+
+void sd_sort_keys(const char *recs, const uint32_t *offs, int from, int count, sd_sort_key_t *keys)
+{
+    for (int i = from; i < count; i++)
+    {
+        sd_sort_collate(sd_dir_rec_name(recs + offs[i]), keys[i].k, SD_SORT_KEY_LEN);
+    }
+}
+
+// 其他文件排在认识的类型后面
+static int type_rank(int type)
+{
+    return type == MEDIA_TYPE_OTHER ? MEDIA_TYPE_PLAYLIST + 1 : type;
+}
+
+static int name_cmp(uint32_t a, uint32_t b)
+{
+    int r = memcmp(s_ctx.keys[a].k, s_ctx.keys[b].k, SD_SORT_KEY_LEN);
+    if (r != 0)
+    {
+        return r;
+    }
+    // 前缀一样 比完整的键 很少走到这里
+    static uint8_t ka[SORT_FULL_KEY_LEN];
+    static uint8_t kb[SORT_FULL_KEY_LEN];
+    size_t la = sd_sort_collate(sd_dir_rec_name(s_ctx.recs + s_ctx.offs[a]), ka, sizeof(ka));
+    size_t lb = sd_sort_collate(sd_dir_rec_name(s_ctx.recs + s_ctx.offs[b]), kb, sizeof(kb));
+    size_t n = la < lb ? la : lb;
+    r = memcmp(ka, kb, n < sizeof(ka) ? n : sizeof(ka));
+    return r ? r : (la > lb) - (la < lb);
+}
+
+static int view_cmp(const void *pa, const void *pb)
+{
+    uint32_t a = *(const uint32_t *)pa;
+    uint32_t b = *(const uint32_t *)pb;
+    const char *ra = s_ctx.recs + s_ctx.offs[a];
+    const char *rb = s_ctx.recs + s_ctx.offs[b];
+    int da = sd_dir_rec_type(ra) == SD_DIR_TYPE_DIR;
+    int db = sd_dir_rec_type(rb) == SD_DIR_TYPE_DIR;
+    int r = db - da;
+    if (r == 0 && s_ctx.mode == SD_SORT_SIZE)
+    {
+        uint32_t sa = sd_dir_rec_size(ra);
+        uint32_t sb = sd_dir_rec_size(rb);
+        r = (sa < sb) - (sa > sb);
+    }
+    else if (r == 0 && s_ctx.mode == SD_SORT_DATE)
+    {
+        uint32_t ta = sd_dir_rec_mtime(ra);
+        uint32_t tb = sd_dir_rec_mtime(rb);
+        r = (ta < tb) - (ta > tb);
+    }
+    else if (r == 0 && s_ctx.mode == SD_SORT_TYPE)
+    {
+        r = type_rank(sd_dir_rec_type(ra)) - type_rank(sd_dir_rec_type(rb));
+    }
+    if (r == 0 && s_ctx.mode != SD_SORT_FAT)
+    {
+        r = name_cmp(a, b);
+    }
+    return r ? r : (a > b) - (a < b);
+}
+
+int sd_sort_view(const char *recs, const uint32_t *offs, const sd_sort_key_t *keys, int count,
+                 sd_sort_mode_t mode, bool media_only, uint32_t *view)
+{
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!media_only || sd_dir_rec_type(recs + offs[i]) != MEDIA_TYPE_OTHER)
+        {
+            view[n++] = i;
+        }
+    }
+    if (mode != SD_SORT_FAT)
+    {
+        s_ctx.recs = recs;
+        s_ctx.offs = offs;
+        s_ctx.keys = keys;
+        s_ctx.mode = mode;
+        qsort(view, n, sizeof(view[0]), view_cmp);
+    }
+    return n;
+}
+
+const char *sd_sort_mode_name(sd_sort_mode_t mode)
+{
+    static const char *const names[SD_SORT_COUNT] = {"FAT", "A-Z", "Size", "Date", "Type"};
+    return mode < SD_SORT_COUNT ? names[mode] : "?";
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*********************** SD卡目录排序 ****************************/
+// 对目录缓存格式的记录(见sd_dir_cache.h)排序和筛选 只动一张下标表 不读卡
+// 名字先转成排序键: ASCII字母不分大小写 汉字按代码页936(GBK)的编码 GB2312的一级字就是按拼音排的
+// 每项预先存键的前SD_SORT_KEY_LEN字节 比较基本就是一次memcmp 前缀一样才现算完整的键
+// 除了原始顺序 都是目录在前 最后按名字 名字也一样的按原来的顺序 结果是稳定的
+
+#define SD_SORT_KEY_LEN         12
+
+typedef enum {
+    SD_SORT_FAT = 0,                    // 卡上的原始顺序
+    SD_SORT_NAME,
+    SD_SORT_SIZE,                       // 大的在前
+    SD_SORT_DATE,                       // 新的在前
+    SD_SORT_TYPE,                       // 音乐 视频 图片 GIF 其他 同类按名字
+    SD_SORT_COUNT,
+} sd_sort_mode_t;
+
+typedef struct {
+    uint8_t k[SD_SORT_KEY_LEN];
+} sd_sort_key_t;
+
+// 名字的排序键 写满len字节 不够的补0 返回完整的键有多长
+size_t sd_sort_collate(const char *name, uint8_t *key, size_t len);
+// 给第from到count-1条记录算键 目录是一批一批到的 只算新来的
+void sd_sort_keys(const char *recs, const uint32_t *offs, int from, int count, sd_sort_key_t *keys);
+// 按mode排 media_only时只留目录和认识的媒体文件 view里是记录的下标 返回留下了几项
+// 用了一个静态的比较上下文 只在LVGL任务里调用
+int sd_sort_view(const char *recs, const uint32_t *offs, const sd_sort_key_t *keys, int count,
+                 sd_sort_mode_t mode, bool media_only, uint32_t *view);
+const char *sd_sort_mode_name(sd_sort_mode_t mode);     // 按键上显示的短名字
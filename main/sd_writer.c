@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sd_writer.h"
+#include "task_plan.h"
+#include "sd_dir_cache.h"
+#include "esp32_s3_szp.h"
+#include "sys_trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "ff.h"
+
+static const char *TAG = "sd_writer";
+
+#define WRITER_QUEUE_LEN    8
+
+struct sd_writer {
+    FIL fil;
+    uint8_t *buf[2];
+    SemaphoreHandle_t free;             // 空着的缓冲 调用者手里总拿着一块
+    int cur;                            // 调用者正在填的
+    uint32_t fill;
+    uint32_t size;                      // 调用者交进来的总字节
+    uint32_t prealloc;
+    uint32_t since_sync;                // 写盘任务用
+    volatile bool failed;
+    char path[SD_DIR_CACHE_PATH_LEN];
+};
+
+typedef struct {
+    sd_writer_t *w;
+    int slot;
+    uint32_t len;
+} writer_job_t;
+
+static QueueHandle_t s_queue;
+static sd_writer_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void writer_task(void *arg)
+{
+    writer_job_t job;
+    for (;;)
+    {
+        xQueueReceive(s_queue, &job, portMAX_DELAY);
+        sd_writer_t *w = job.w;
+        uint32_t us = 0;
+        bool synced = false;
+        if (!w->failed)
+        {
+            UINT bw = 0;
+            int64_t t0 = esp_timer_get_time();
+            SYS_TRACE_BEGIN("sd_write");
+            FRESULT fr = f_write(&w->fil, w->buf[job.slot], job.len, &bw);
+            w->since_sync += bw;
+            if (fr == FR_OK && bw == job.len && SD_WRITER_SYNC_BYTES && w->since_sync >= SD_WRITER_SYNC_BYTES)
+            {
+                fr = f_sync(&w->fil);
+                w->since_sync = 0;
+                synced = true;
+            }
+            SYS_TRACE_END("sd_write");
+            us = esp_timer_get_time() - t0;
+            if (fr != FR_OK || bw != job.len)
+            {
+                ESP_LOGE(TAG, "%s: write failed (%d)", w->path, fr);
+                w->failed = true;
+            }
+        }
+        portENTER_CRITICAL(&s_lock);
+        if (!w->failed)
+        {
+            s_stats.bytes += job.len;
+            s_stats.blocks++;
+            s_stats.write_us += us;
+            s_stats.syncs += synced;
+            if (us > s_stats.max_write_us)
+            {
+                s_stats.max_write_us = us;
+            }
+        }
+        portEXIT_CRITICAL(&s_lock);
+        xSemaphoreGive(w->free);
+    }
+}
+
+static void writer_free(sd_writer_t *w)
+{
+    heap_caps_free(w->buf[0]);
+    heap_caps_free(w->buf[1]);
+    if (w->free)
+    {
+        vSemaphoreDelete(w->free);
+    }
+    free(w);
+}
+
+static void count_failed(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.failed++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 把正在填的这块交出去 换另一块来填 另一块还在写就等它
+static void writer_submit(sd_writer_t *w)
+{
+    writer_job_t job = {.w = w, .slot = w->cur, .len = w->fill};
+    xQueueSend(s_queue, &job, portMAX_DELAY);
+    w->cur ^= 1;
+    w->fill = 0;
+    if (xSemaphoreTake(w->free, 0) != pdTRUE)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.stalls++;
+        portEXIT_CRITICAL(&s_lock);
+        xSemaphoreTake(w->free, portMAX_DELAY);
+    }
+}
+
+// 等交出去的那块写完 之后文件只有调用者在动
+static void writer_drain(sd_writer_t *w)
+{
+    xSemaphoreTake(w->free, portMAX_DELAY);
+    xSemaphoreGive(w->free);
+}
+
+sd_writer_t *sd_writer_open(const char *path, uint32_t prealloc)
+{
+    if (s_queue == NULL)
+    {
+        s_queue = xQueueCreate(WRITER_QUEUE_LEN, sizeof(writer_job_t));
+        if (s_queue == NULL ||
+            task_plan_create(TASK_SD_WRITER, writer_task, NULL, NULL) != pdPASS)
+        {
+            ESP_LOGE(TAG, "writer task start failed");
+            count_failed();
+            return NULL;
+        }
+    }
+    char fpath[SD_DIR_CACHE_PATH_LEN + 4];
+    sd_writer_t *w = calloc(1, sizeof(sd_writer_t));
+    if (w == NULL || !bsp_sdcard_fatfs_path(path, fpath, sizeof(fpath)))
+    {
+        free(w);
+        count_failed();
+        return NULL;
+    }
+    strlcpy(w->path, path, sizeof(w->path));
+    for (int i = 0; i < 2; i++)
+    {
+        w->buf[i] = heap_caps_malloc(SD_WRITER_BLOCK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (w->buf[i] == NULL)
+        {
+            w->buf[i] = heap_caps_malloc(SD_WRITER_BLOCK, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        }
+    }
+    w->free = xSemaphoreCreateCounting(2, 1);   // 另一块一开始就在调用者手里
+    FRESULT fr = FR_INT_ERR;
+    if (w->buf[0] == NULL || w->buf[1] == NULL || w->free == NULL ||
+        (fr = f_open(&w->fil, fpath, FA_WRITE | FA_CREATE_ALWAYS)) != FR_OK)
+    {
+        ESP_LOGE(TAG, "open %s failed (%d)", path, fr);
+        writer_free(w);
+        count_failed();
+        return NULL;
+    }
+
+    if (prealloc)
+    {
+        bool contiguous = false;
+#if FF_USE_EXPAND
+        contiguous = f_expand(&w->fil, prealloc, 1) == FR_OK;
+#endif
+        // 找不到连续的空簇 就在写模式下移到文件尾后面 FATFS照样把簇链提前分配好
+        if (!contiguous && (f_lseek(&w->fil, prealloc) != FR_OK || f_lseek(&w->fil, 0) != FR_OK))
+        {
+            ESP_LOGW(TAG, "%s: preallocating %lu KB failed", path, (unsigned long)prealloc / 1024);
+        }
+        w->prealloc = f_size(&w->fil);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.contiguous += contiguous;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    sd_dir_cache_changed(path);
+    return w;
+}
+
+esp_err_t sd_writer_write(sd_writer_t *w, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len > 0 && !w->failed)
+    {
+        uint32_t n = SD_WRITER_BLOCK - w->fill;
+        n = n < len ? n : len;
+        memcpy(w->buf[w->cur] + w->fill, p, n);
+        w->fill += n;
+        w->size += n;
+        p += n;
+        len -= n;
+        if (w->fill == SD_WRITER_BLOCK)
+        {
+            writer_submit(w);
+        }
+    }
+    return w->failed ? ESP_FAIL : ESP_OK;
+}
+
+uint8_t *sd_writer_reserve(sd_writer_t *w, size_t *room)
+{
+    if (w->failed)
+    {
+        *room = 0;
+        return NULL;
+    }
+    *room = SD_WRITER_BLOCK - w->fill;
+    return w->buf[w->cur] + w->fill;
+}
+
+esp_err_t sd_writer_commit(sd_writer_t *w, size_t len)
+{
+    if (len > SD_WRITER_BLOCK - w->fill)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    w->fill += len;
+    w->size += len;
+    if (w->fill == SD_WRITER_BLOCK)
+    {
+        writer_submit(w);
+    }
+    return w->failed ? ESP_FAIL : ESP_OK;
+}
+
+esp_err_t sd_writer_write_at(sd_writer_t *w, uint32_t offset, const void *data, size_t len)
+{
+    if (offset > w->size || len > w->size - offset)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *p = data;
+    uint32_t flushed = w->size - w->fill;
+    if (offset < flushed)
+    {
+        // 已经交出去的部分 等写完了直接改文件 再回到原来的位置
+        uint32_t n = flushed - offset < len ? flushed - offset : len;
+        writer_drain(w);
+        UINT bw = 0;
+        if (w->failed || f_lseek(&w->fil, offset) != FR_OK || f_write(&w->fil, p, n, &bw) != FR_OK || bw != n ||
+            f_lseek(&w->fil, flushed) != FR_OK)
+        {
+            w->failed = true;
+            return ESP_FAIL;
+        }
+        p += n;
+        offset += n;
+        len -= n;
+    }
+    // 还在缓冲里的直接改缓冲
+    memcpy(w->buf[w->cur] + (offset - flushed), p, len);
+    return ESP_OK;
+}
+
+uint32_t sd_writer_size(const sd_writer_t *w)
+{
+    return w->size;
+}
+
+esp_err_t sd_writer_close(sd_writer_t *w)
+{
+    if (w->fill)
+    {
+        writer_submit(w);
+    }
+    writer_drain(w);
+    bool ok = !w->failed;
+    if (ok && w->prealloc > w->size)
+    {
+        ok = f_lseek(&w->fil, w->size) == FR_OK && f_truncate(&w->fil) == FR_OK;
+    }
+    ok = f_close(&w->fil) == FR_OK && ok;
+    sd_dir_cache_changed(w->path);
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "%s: close failed", w->path);
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (ok)
+    {
+        s_stats.files++;
+    }
+    else
+    {
+        s_stats.failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    writer_free(w);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+void sd_writer_abort(sd_writer_t *w)
+{
+    writer_drain(w);
+    f_close(&w->fil);
+    char fpath[SD_DIR_CACHE_PATH_LEN + 4];
+    if (bsp_sdcard_fatfs_path(w->path, fpath, sizeof(fpath)))
+    {
+        f_unlink(fpath);
+    }
+    sd_dir_cache_changed(w->path);
+    count_failed();
+    writer_free(w);
+}
+
+void sd_writer_get_stats(sd_writer_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** SD卡的大块写 ****************************/
+// 拍照 缩略图 录像都经过这里写卡 直接用FATFS 不经过newlib的stdio
+// 每个文件两块缓冲 调用者往一块里拷 写满了交给core 0上的写盘任务 自己接着填另一块 编码和写卡同时进行
+// 写下去的块都从块大小的整数倍处开始 块是分配单元(8KB)的整数倍 FATFS整扇区直接从缓冲DMA进卡
+// 缓冲先用内部RAM SDMMC从PSRAM发会被驱动拆成一个扇区一次 内部RAM不够时才退到PSRAM
+// 知道大概多大的文件开的时候预分配 FATFS能找到连续的空簇就一次分配好 关闭时截掉没用完的
+// 长时间录像每写够CONFIG_APP_SD_WRITER_SYNC_MB同步一次 断电也只丢最后这一段 平时只在关闭时同步
+
+#define SD_WRITER_BLOCK         (CONFIG_APP_SD_WRITER_BLOCK_KB * 1024)
+#define SD_WRITER_SYNC_BYTES    (CONFIG_APP_SD_WRITER_SYNC_MB * 1024 * 1024)
+
+typedef struct sd_writer sd_writer_t;
+
+typedef struct {
+    uint32_t files;                     // 正常关闭的
+    uint32_t failed;                    // 打开或写失败的
+    uint64_t bytes;
+    uint32_t blocks;                    // 交给FATFS的写
+    uint64_t write_us;                  // 写盘任务花在f_write上的时间
+    uint32_t max_write_us;
+    uint32_t stalls;                    // 两块缓冲都在写 调用者只好等
+    uint32_t syncs;
+    uint32_t contiguous;                // 预分配到了连续的簇
+} sd_writer_stats_t;
+
+// path是/sdcard下的VFS路径 已经有的文件清空重写 prealloc是预计的大小 0表示不预分配
+sd_writer_t *sd_writer_open(const char *path, uint32_t prealloc);
+esp_err_t sd_writer_write(sd_writer_t *w, const void *data, size_t len);   // 拷进缓冲就返回 写卡出过错返回ESP_FAIL
+// 不拷贝的写法 拿到当前块里空着的地方和大小 直接让socket之类收进去 再commit实际收到的长度
+// 填满一块commit时交出去 返回的指针在下一次reserve之前有效 写卡出过错返回NULL
+uint8_t *sd_writer_reserve(sd_writer_t *w, size_t *room);
+esp_err_t sd_writer_commit(sd_writer_t *w, size_t len);
+// 回头改已经写过的地方 比如头部的长度 还在缓冲里的直接改缓冲
+esp_err_t sd_writer_write_at(sd_writer_t *w, uint32_t offset, const void *data, size_t len);
+uint32_t sd_writer_size(const sd_writer_t *w);  // 已经写了多少字节
+esp_err_t sd_writer_close(sd_writer_t *w);      // 写完剩下的 截掉预分配多出来的 报告目录变了 w失效
+void sd_writer_abort(sd_writer_t *w);           // 关掉删除 w失效
+void sd_writer_get_stats(sd_writer_stats_t *stats);
@@ -0,0 +1,326 @@
+#include <string.h>
+#include "standby.h"
+#include "task_plan.h"
+#include "pm_ctl.h"
+#include "idle_mgr.h"
+#include "evt_bus.h"
+#include "ui_perf.h"
+#include "voice_memo.h"
+#include "multiroom.h"
+#include "intercom.h"
+#include "cam_stream.h"
+#include "esp32_s3_szp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#if CONFIG_APP_STANDBY
+
+static const char *TAG = "standby";
+
+#define WAKE_BIT(src)           (1u << (src))
+
+static const char *const s_wake_names[STANDBY_WAKE_COUNT] = {"touch", "key", "motion", "ui", "client"};
+
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_mux;         // 进出待机 待机任务和空闲管理任务都会调
+static volatile bool s_active;
+static bool s_touch_irq;                // 接了触摸INT
+static volatile int64_t s_isr_us;       // 中断叫醒的时刻
+static int64_t s_enter_us;
+static int64_t s_resume_t0;             // 亮屏的叫醒时刻 背光亮了算醒来时间 0是没在等
+static uint32_t s_wakeups0;             // 进待机时两个核的空闲叫醒计数
+static standby_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void IRAM_ATTR touch_isr_cb(void)
+{
+    BaseType_t woken = pdFALSE;
+    s_isr_us = esp_timer_get_time();
+    xTaskNotifyFromISR(s_task, WAKE_BIT(STANDBY_WAKE_TOUCH), eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// 浅睡叫醒要低电平 按着会一直进中断 进来一次就关掉 下次进待机再开
+static void key_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    gpio_intr_disable(STANDBY_KEY_GPIO);
+    s_isr_us = esp_timer_get_time();
+    xTaskNotifyFromISR(s_task, WAKE_BIT(STANDBY_WAKE_KEY), eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static uint32_t idle_wakeups(void)
+{
+    pm_ctl_stats_t pm;
+    pm_ctl_get_stats(&pm);
+    return pm.idle_wakeups[0] + pm.idle_wakeups[1];
+}
+
+// 熄屏了 没有人要全速 也没有在用麦克风和网络推流的
+static bool can_enter(void)
+{
+    if (idle_mgr_state() != IDLE_OFF)
+    {
+        return false;
+    }
+    for (int i = 0; i < PM_CLIENT_COUNT; i++)
+    {
+        if (pm_ctl_held(i))
+        {
+            return false;
+        }
+    }
+#if CONFIG_APP_INTERCOM
+    if (intercom_in_call())
+    {
+        return false;
+    }
+#endif
+    return !voice_memo_active() && multiroom_role() == MULTIROOM_OFF && !cam_stream_active();
+}
+
+static void wake_arm(bool on)
+{
+    if (on)
+    {
+        if (s_touch_irq)
+        {
+            bsp_touch_set_irq_cb(touch_isr_cb);
+        }
+        gpio_isr_handler_add(STANDBY_KEY_GPIO, key_isr, NULL);
+        gpio_wakeup_enable(STANDBY_KEY_GPIO, GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+        gpio_intr_enable(STANDBY_KEY_GPIO);
+    }
+    else
+    {
+        bsp_touch_set_irq_cb(NULL);
+        gpio_intr_disable(STANDBY_KEY_GPIO);
+        gpio_wakeup_disable(STANDBY_KEY_GPIO);
+        gpio_isr_handler_remove(STANDBY_KEY_GPIO);
+    }
+}
+
+static void standby_enter(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    xSemaphoreTake(s_mux, portMAX_DELAY);
+    if (bsp_display_sleep(true) != ESP_OK)
+    {
+        xSemaphoreGive(s_mux);
+        ESP_LOGW(TAG, "display did not sleep, staying awake");
+        return;
+    }
+    bsp_audio_standby(true);
+    s_isr_us = 0;
+    wake_arm(true);
+    pm_ctl_standby(true);
+    s_wakeups0 = idle_wakeups();
+    s_enter_us = esp_timer_get_time();
+    s_active = true;
+    xSemaphoreGive(s_mux);
+
+    uint32_t us = s_enter_us - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.entries++;
+    s_stats.enter_us_max = us > s_stats.enter_us_max ? us : s_stats.enter_us_max;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "standby (%lu us)", (unsigned long)us);
+}
+
+// t_wake是叫醒的时刻 醒来时间从它算
+static void standby_leave(standby_wake_t src, int64_t t_wake)
+{
+    xSemaphoreTake(s_mux, portMAX_DELAY);
+    if (!s_active)
+    {
+        xSemaphoreGive(s_mux);
+        return;
+    }
+    s_active = false;
+    wake_arm(false);
+    bsp_display_sleep(false);           // 先出屏幕 背光在调用者后面开
+    bsp_audio_standby(false);
+    pm_ctl_standby(false);
+    int64_t now = esp_timer_get_time();
+    uint32_t wakeups = idle_wakeups() - s_wakeups0;
+    xSemaphoreGive(s_mux);
+
+    portENTER_CRITICAL(&s_lock);
+    s_stats.wakes[src]++;
+    s_stats.standby_ms += (now - s_enter_us) / 1000;
+    s_stats.idle_wakeups += wakeups;
+    s_resume_t0 = src == STANDBY_WAKE_CLIENT ? 0 : t_wake;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "woken by %s after %llu s, panel back in %lu us", s_wake_names[src], (now - s_enter_us) / 1000000,
+             (unsigned long)(now - t_wake));
+}
+
+// 在空闲管理的任务里 背光刚开完
+static void standby_on_idle(const evt_t *ev)
+{
+    if (ev->a == IDLE_ON)
+    {
+        portENTER_CRITICAL(&s_lock);
+        if (s_resume_t0)
+        {
+            uint32_t us = ev->t_us - s_resume_t0;
+            s_resume_t0 = 0;
+            s_stats.resumes++;
+            s_stats.resume_us_last = us;
+            s_stats.resume_us_total += us;
+            s_stats.resume_us_max = us > s_stats.resume_us_max ? us : s_stats.resume_us_max;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    xTaskNotify(s_task, 0, eNoAction); // 熄屏了就开始等
+}
+
+static void standby_task(void *arg)
+{
+    int64_t off_since = 0;
+    for (;;)
+    {
+        TickType_t wait = portMAX_DELAY;
+        if (s_active && !s_touch_irq)
+        {
+            wait = pdMS_TO_TICKS(STANDBY_POLL_MS);
+        }
+        else if (!s_active && idle_mgr_state() == IDLE_OFF)
+        {
+            wait = pdMS_TO_TICKS(off_since ? STANDBY_ENTER_MS : STANDBY_CHECK_MS);
+        }
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, wait);
+
+        if (s_active)
+        {
+            standby_wake_t src = STANDBY_WAKE_COUNT;
+            int64_t t = s_isr_us;
+            if (bits & WAKE_BIT(STANDBY_WAKE_KEY))
+            {
+                src = STANDBY_WAKE_KEY;
+            }
+            else if (bits & WAKE_BIT(STANDBY_WAKE_TOUCH))
+            {
+                src = STANDBY_WAKE_TOUCH;
+            }
+            else if (!s_touch_irq && bsp_touch_pressed_raw())
+            {
+                src = STANDBY_WAKE_TOUCH;
+                t = esp_timer_get_time();
+            }
+            else if (bits & WAKE_BIT(STANDBY_WAKE_CLIENT))
+            {
+                src = STANDBY_WAKE_CLIENT;
+                t = esp_timer_get_time();
+            }
+            if (src == STANDBY_WAKE_COUNT)
+            {
+                continue;
+            }
+            standby_leave(src, t);
+            off_since = 0;
+            if (src != STANDBY_WAKE_CLIENT)
+            {
+                // 算一次活动 空闲管理马上开背光 熄屏时盖上的那层吃掉这次触摸
+                ui_lock(0);
+                lv_disp_trig_activity(NULL);
+                ui_unlock();
+                idle_mgr_kick();
+            }
+            continue;
+        }
+
+        if (!can_enter())
+        {
+            off_since = 0;
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        if (off_since == 0)
+        {
+            off_since = now;
+        }
+        else if (now - off_since >= STANDBY_ENTER_MS * 1000LL)
+        {
+            off_since = 0;
+            standby_enter();
+        }
+    }
+}
+
+esp_err_t standby_start(void)
+{
+    if (s_task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const gpio_config_t io = {
+        .pin_bit_mask = BIT64(STANDBY_KEY_GPIO),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&io), TAG, "key gpio config failed");
+    esp_err_t ret = gpio_install_isr_service(0);
+    ESP_RETURN_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, TAG, "gpio isr service failed");
+    bsp_touch_stats_t ts;
+    bsp_touch_get_stats(&ts);
+    s_touch_irq = ts.irq;
+    s_mux = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_mux, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_STANDBY, standby_task, NULL, &s_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+    evt_bus_subscribe(EVT_IDLE, standby_on_idle, EVT_BUS_DIRECT);
+    ESP_LOGI(TAG, "standby %d ms after the screen goes off, touch %s", STANDBY_ENTER_MS,
+             s_touch_irq ? "on INT" : "polled");
+    return ESP_OK;
+}
+
+void standby_wake(standby_wake_t src)
+{
+    if (s_active && src < STANDBY_WAKE_COUNT)
+    {
+        standby_leave(src, esp_timer_get_time());
+    }
+}
+
+void standby_client_wake(void)
+{
+    if (!s_active || s_task == NULL)
+    {
+        return;
+    }
+    if (xPortInIsrContext())
+    {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(s_task, WAKE_BIT(STANDBY_WAKE_CLIENT), eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        xTaskNotify(s_task, WAKE_BIT(STANDBY_WAKE_CLIENT), eSetBits);
+    }
+}
+
+bool standby_active(void)
+{
+    return s_active;
+}
+
+void standby_get_stats(standby_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
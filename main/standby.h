@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 熄屏待机 ****************************/
+// 以前熄屏了音乐停着 LVGL照样刷新读触摸 I2S两个通道开着 驱动一直拿着APB的电源锁 芯片进不了浅睡
+// 现在空闲管理熄屏STANDBY_ENTER_MS以后 没人拿着pm_ctl的锁 也没有录音 对讲 同步播放 推流 就进待机:
+//   LVGL停掉刷新和读触摸的定时器 其它定时器和界面消息照常 ST7789发SLPIN 显存里的画面留着
+//   I2S两个通道都关掉 暂停的播放器 解码器和打开的文件都在内存里不动 麦克风也停 待机时听不到唤醒词
+//   摄像头界面本来就不让熄屏 拍照推流的时候不进待机
+//   剩下的就是pm_ctl的自动浅睡 两次定时器之间睡
+// 叫醒: 接了触摸INT的话中断叫醒 没接就每STANDBY_POLL_MS直接读一次触摸芯片 BOOT键下降沿中断
+//   拿起来的运动由空闲管理照常每IDLE_POLL_MS读一次 有人拿pm_ctl的锁(闹钟 远程点歌)也退出待机
+// 醒来只发SLPOUT恢复刷新 睡着时作废的区域画一次 不重画整屏 不重开文件
+// 醒来时间: 中断或读到按下的时刻到背光亮 板子量不了电流 按pm_ctl的standby状态和Kconfig里的电流估
+
+#define STANDBY_ENTER_MS        1000    // 熄屏以后再等这么久 刚熄屏就被碰亮的不折腾屏幕
+#define STANDBY_CHECK_MS        1000    // 熄屏着但不能待机时多久再看一次
+#define STANDBY_POLL_MS         100     // 没接触摸INT时读触摸芯片的间隔 和空闲管理读运动一样
+#define STANDBY_KEY_GPIO        GPIO_NUM_0  // BOOT键 按下是低
+
+typedef enum {
+    STANDBY_WAKE_TOUCH,
+    STANDBY_WAKE_KEY,
+    STANDBY_WAKE_MOTION,                // 空闲管理读到拿起来了
+    STANDBY_WAKE_UI,                    // 别处触发了LVGL的活动
+    STANDBY_WAKE_CLIENT,                // 有人拿了pm_ctl的锁 屏幕不亮
+    STANDBY_WAKE_COUNT,
+} standby_wake_t;
+
+typedef struct {
+    uint32_t entries;
+    uint32_t wakes[STANDBY_WAKE_COUNT];
+    uint64_t standby_ms;                // 待机的总时间
+    uint32_t idle_wakeups;              // 待机时两个核从空闲里被叫醒的次数 除standby_ms就是每秒几次
+    uint32_t enter_us_max;              // 停刷新 排空传输 SLPIN 关I2S
+    uint32_t resumes;                   // 醒来亮了屏的
+    uint32_t resume_us_last;            // 叫醒到背光亮
+    uint32_t resume_us_max;
+    uint64_t resume_us_total;
+} standby_stats_t;
+
+#if CONFIG_APP_STANDBY
+esp_err_t standby_start(void);          // 空闲管理起来以后调
+void standby_wake(standby_wake_t src);  // 空闲管理在点亮背光之前调 没在待机直接返回 同步做完
+void standby_client_wake(void);         // pm_ctl有人拿锁时调 中断里也能调 只通知待机任务
+bool standby_active(void);
+void standby_get_stats(standby_stats_t *stats);
+#endif
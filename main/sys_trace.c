@@ -0,0 +1,532 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "sys_trace.h"
+
+#if CONFIG_APP_SYS_TRACE
+#include "esp32_s3_szp.h"
+#include "sd_writer.h"
+#include "esp_private/cache_utils.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "sys_trace";
+
+#define RING_MASK           (SYS_TRACE_RING_RECS - 1)
+#define TRACE_DIR           SD_MOUNT_POINT"/trace"
+#define OUT_LEN             1024        // 导出时攒这么多交出去一次
+#define OPEN_MAX            32          // 导出时同时没配上对的区段
+#define ISR_DEPTH           4           // 每个核中断嵌套
+#define TID_IRQ             2           // CPU进程里 0 1是两个核的任务线 2 3是中断线
+
+_Static_assert((SYS_TRACE_RING_RECS & RING_MASK) == 0, "APP_SYS_TRACE_RING_KB must be a power of two");
+
+// 一条16字节 seq是下标加一 最后写 导出时对不上的是没写完或者被覆盖了一半
+typedef struct {
+    uint32_t seq;
+    uint32_t t;                         // esp_timer的低32位 导出时展开
+    uint32_t hdr;                       // 低8位类型 8~15位核 高16位MARK带的数
+    uint32_t arg;
+} sys_trace_rec_t;
+
+typedef struct {
+    uint32_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+} trace_task_t;
+
+typedef enum {
+    OPEN_SPAN,
+    OPEN_WAIT,
+    OPEN_HOLD,
+} open_kind_t;
+
+typedef struct {
+    uint32_t task;
+    uint32_t name;
+    int64_t t;
+    open_kind_t kind;
+} open_t;
+
+typedef struct {
+    sys_trace_out_t out;
+    void *arg;
+    esp_err_t err;
+    size_t used;
+    uint64_t bytes;
+    bool first;                         // 还没写过事件 不要逗号
+    uint32_t cur_task[2];               // 每个核上正在跑的
+    int64_t cur_since[2];
+    struct {
+        uint32_t name;
+        int64_t t;
+    } isr[2][ISR_DEPTH];
+    int isr_n[2];
+    open_t open[OPEN_MAX];
+    int open_n;
+    bool used_tid[SYS_TRACE_MAX_TASKS];
+} export_t;
+
+static sys_trace_rec_t *s_ring;
+static volatile bool s_on;
+static uint32_t s_head;                 // 写的人原子加 一直往上加 取下标时与掩码
+static uint32_t s_dropped;
+static uint32_t s_cur[2];               // 每个核上次记下的任务 同一个任务又切回来不记
+static trace_task_t s_tasks[SYS_TRACE_MAX_TASKS];
+static int s_ntasks;
+static uint32_t s_idle[2];
+static bool s_exporting;
+static char s_out[OUT_LEN];
+static export_t s_exp;
+static sys_trace_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void IRAM_ATTR trace_put(uint32_t type, uint32_t arg, uint32_t val)
+{
+    // flash写着的时候cache关着 碰PSRAM会死
+    if (!spi_flash_cache_enabled())
+    {
+        __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    uint32_t i = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    sys_trace_rec_t *r = &s_ring[i & RING_MASK];
+    r->t = (uint32_t)esp_timer_get_time();
+    r->hdr = type | (uint32_t)esp_cpu_get_core_id() << 8 | val << 16;
+    r->arg = arg;
+    __atomic_store_n(&r->seq, i + 1, __ATOMIC_RELEASE);
+}
+
+void IRAM_ATTR sys_trace_event(sys_trace_ev_t type, const char *name, uint16_t val)
+{
+    if (s_on)
+    {
+        trace_put(type, (uint32_t)name, val);
+    }
+}
+
+// 在vTaskSwitchContext里 调度器的锁拿着 什么都不能等
+void IRAM_ATTR sys_trace_task_switched_in(void)
+{
+    if (!s_on)
+    {
+        return;
+    }
+    int core = esp_cpu_get_core_id();
+    uint32_t h = (uint32_t)xTaskGetCurrentTaskHandle();
+    if (h != s_cur[core])
+    {
+        s_cur[core] = h;
+        trace_put(SYS_TRACE_EV_SWITCH, h, 0);
+    }
+}
+
+// 开始和停下时各取一次 中间新建又删掉的任务叫不出名字
+static void tasks_snapshot(void)
+{
+    UBaseType_t cap = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *st = heap_caps_malloc(cap * sizeof(TaskStatus_t), MALLOC_CAP_SPIRAM);
+    UBaseType_t n = st ? uxTaskGetSystemState(st, cap, NULL) : 0;
+    for (UBaseType_t i = 0; i < n; i++)
+    {
+        int k = 0;
+        while (k < s_ntasks && s_tasks[k].handle != (uint32_t)st[i].xHandle)
+        {
+            k++;
+        }
+        if (k == SYS_TRACE_MAX_TASKS)
+        {
+            break;
+        }
+        s_tasks[k].handle = (uint32_t)st[i].xHandle;
+        strlcpy(s_tasks[k].name, st[i].pcTaskName, sizeof(s_tasks[k].name));
+        s_ntasks = k == s_ntasks ? k + 1 : s_ntasks;
+    }
+    free(st);
+}
+
+esp_err_t sys_trace_start(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool busy = s_exporting;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_RETURN_ON_FALSE(!busy, ESP_ERR_INVALID_STATE, TAG, "exporting");
+    if (s_on)
+    {
+        return ESP_OK;
+    }
+    if (s_ring == NULL)
+    {
+        s_ring = heap_caps_malloc(SYS_TRACE_RING_RECS * sizeof(sys_trace_rec_t), MALLOC_CAP_SPIRAM);
+        ESP_RETURN_ON_FALSE(s_ring, ESP_ERR_NO_MEM, TAG, "no memory for %d KB ring", CONFIG_APP_SYS_TRACE_RING_KB);
+    }
+    memset(s_ring, 0, SYS_TRACE_RING_RECS * sizeof(sys_trace_rec_t));
+    s_ntasks = 0;
+    tasks_snapshot();
+    s_head = 0;
+    s_dropped = 0;
+    s_cur[0] = s_cur[1] = 0;
+    s_on = true;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.running = true;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "tracing into %d KB ring", CONFIG_APP_SYS_TRACE_RING_KB);
+    return ESP_OK;
+}
+
+void sys_trace_stop(void)
+{
+    if (!s_on)
+    {
+        return;
+    }
+    s_on = false;
+    vTaskDelay(1);  // 正在写的那几条写完
+    tasks_snapshot();
+    s_idle[0] = (uint32_t)xTaskGetIdleTaskHandleForCPU(0);
+    s_idle[1] = (uint32_t)xTaskGetIdleTaskHandleForCPU(1);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.running = false;
+    s_stats.events += s_head;
+    s_stats.dropped += s_dropped;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "stopped, %lu events (%lu kept), %lu dropped", (unsigned long)s_head,
+             (unsigned long)(s_head < SYS_TRACE_RING_RECS ? s_head : SYS_TRACE_RING_RECS), (unsigned long)s_dropped);
+}
+
+bool sys_trace_running(void)
+{
+    return s_on;
+}
+
+static void out_flush(export_t *e)
+{
+    if (e->err == ESP_OK && e->used)
+    {
+        e->err = e->out(s_out, e->used, e->arg);
+        e->bytes += e->used;
+    }
+    e->used = 0;
+}
+
+static void out_printf(export_t *e, const char *fmt, ...)
+{
+    va_list ap;
+    for (int retry = 0; retry < 2 && e->err == ESP_OK; retry++)
+    {
+        va_start(ap, fmt);
+        int n = vsnprintf(s_out + e->used, OUT_LEN - e->used, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && e->used + n < OUT_LEN)
+        {
+            e->used += n;
+            return;
+        }
+        out_flush(e);
+    }
+}
+
+// 一个事件 pid 0是CPU 1是tasks dur小于0是瞬时的标记
+static void out_event(export_t *e, const char *ph, int pid, int tid, const char *name, int64_t t, int64_t dur)
+{
+    out_printf(e, "%s\n{\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ts\":%lld", e->first ? "" : ",", ph,
+               pid, tid, name, (long long)t);
+    e->first = false;
+    if (dur >= 0)
+    {
+        out_printf(e, ",\"dur\":%lld}", (long long)dur);
+    }
+    else
+    {
+        out_printf(e, ",\"s\":\"t\"}");
+    }
+}
+
+static int task_index(uint32_t handle)
+{
+    for (int i = 0; i < s_ntasks; i++)
+    {
+        if (s_tasks[i].handle == handle)
+        {
+            return i;
+        }
+    }
+    if (s_ntasks == SYS_TRACE_MAX_TASKS)
+    {
+        return -1;
+    }
+    s_tasks[s_ntasks].handle = handle;
+    snprintf(s_tasks[s_ntasks].name, sizeof(s_tasks[0].name), "%08lx", (unsigned long)handle);
+    return s_ntasks++;
+}
+
+// tasks进程里的线号 0留给认不出来的
+static int task_tid(export_t *e, uint32_t handle)
+{
+    int i = handle ? task_index(handle) : -1;
+    if (i >= 0)
+    {
+        e->used_tid[i] = true;
+    }
+    return i + 1;
+}
+
+static void core_switch(export_t *e, int core, uint32_t task, int64_t t)
+{
+    uint32_t prev = e->cur_task[core];
+    if (prev && prev != s_idle[core])
+    {
+        int i = task_index(prev);
+        out_event(e, "X", 0, core, i >= 0 ? s_tasks[i].name : "?", e->cur_since[core], t - e->cur_since[core]);
+    }
+    e->cur_task[core] = task;
+    e->cur_since[core] = t;
+}
+
+static int open_find(export_t *e, uint32_t task, uint32_t name, open_kind_t kind)
+{
+    for (int i = e->open_n - 1; i >= 0; i--)
+    {
+        if (e->open[i].task == task && e->open[i].name == name && e->open[i].kind == kind)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void open_push(export_t *e, uint32_t task, uint32_t name, open_kind_t kind, int64_t t)
+{
+    int i = kind == OPEN_SPAN ? -1 : open_find(e, task, name, kind);  // 锁超时没拿到的等待 下次等待顶掉
+    if (i < 0)
+    {
+        if (e->open_n == OPEN_MAX)
+        {
+            memmove(&e->open[0], &e->open[1], sizeof(open_t) * (OPEN_MAX - 1));   // 配不上对的最旧的丢掉
+            e->open_n--;
+        }
+        i = e->open_n++;
+    }
+    e->open[i] = (open_t){.task = task, .name = name, .t = t, .kind = kind};
+}
+
+// 配上了返回开始的时刻 没配上返回-1
+static int64_t open_pop(export_t *e, uint32_t task, uint32_t name, open_kind_t kind)
+{
+    int i = open_find(e, task, name, kind);
+    if (i < 0)
+    {
+        return -1;
+    }
+    int64_t t = e->open[i].t;
+    memmove(&e->open[i], &e->open[i + 1], sizeof(open_t) * (e->open_n - i - 1));
+    e->open_n--;
+    return t;
+}
+
+static void export_rec(export_t *e, const sys_trace_rec_t *r, int64_t t)
+{
+    int type = r->hdr & 0xFF;
+    int core = (r->hdr >> 8) & 1;
+    uint32_t task = e->cur_task[core];
+    const char *name = (const char *)r->arg;
+    char label[40];
+    int64_t t0;
+    switch (type)
+    {
+    case SYS_TRACE_EV_SWITCH:
+        core_switch(e, core, r->arg, t);
+        break;
+    case SYS_TRACE_EV_ISR_ENTER:
+        if (e->isr_n[core] < ISR_DEPTH)
+        {
+            e->isr[core][e->isr_n[core]].name = r->arg;
+            e->isr[core][e->isr_n[core]].t = t;
+        }
+        e->isr_n[core]++;
+        break;
+    case SYS_TRACE_EV_ISR_EXIT:
+        if (e->isr_n[core] > 0 && --e->isr_n[core] < ISR_DEPTH && e->isr[core][e->isr_n[core]].name == r->arg)
+        {
+            t0 = e->isr[core][e->isr_n[core]].t;
+            out_event(e, "X", 0, TID_IRQ + core, name, t0, t - t0);
+        }
+        break;
+    case SYS_TRACE_EV_LOCK_WAIT:
+        open_push(e, task, r->arg, OPEN_WAIT, t);
+        break;
+    case SYS_TRACE_EV_LOCK_TAKE:
+        if ((t0 = open_pop(e, task, r->arg, OPEN_WAIT)) >= 0)
+        {
+            snprintf(label, sizeof(label), "%s wait", name);
+            out_event(e, "X", 1, task_tid(e, task), label, t0, t - t0);
+        }
+        open_push(e, task, r->arg, OPEN_HOLD, t);
+        break;
+    case SYS_TRACE_EV_LOCK_GIVE:
+        if ((t0 = open_pop(e, task, r->arg, OPEN_HOLD)) >= 0)
+        {
+            out_event(e, "X", 1, task_tid(e, task), name, t0, t - t0);
+        }
+        break;
+    case SYS_TRACE_EV_BEGIN:
+        open_push(e, task, r->arg, OPEN_SPAN, t);
+        break;
+    case SYS_TRACE_EV_END:
+        if ((t0 = open_pop(e, task, r->arg, OPEN_SPAN)) >= 0)
+        {
+            out_event(e, "X", 1, task_tid(e, task), name, t0, t - t0);
+        }
+        break;
+    case SYS_TRACE_EV_MARK:
+        snprintf(label, sizeof(label), "%s %lu", name, (unsigned long)(r->hdr >> 16));
+        out_event(e, "i", 1, task_tid(e, task), label, t, -1);
+        break;
+    }
+}
+
+static void export_meta(export_t *e, int pid, int tid, const char *key, const char *name)
+{
+    if (tid < 0)
+    {
+        out_printf(e, ",\n{\"ph\":\"M\",\"pid\":%d,\"name\":\"%s\",\"args\":{\"name\":\"%s\"}}", pid, key, name);
+    }
+    else
+    {
+        out_printf(e, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"args\":{\"name\":\"%s\"}}", pid, tid,
+                   key, name);
+    }
+}
+
+// 按写入的顺序过一遍环 任务切换 中断 区段配成对变成有长度的事件 名字表最后写
+esp_err_t sys_trace_export(sys_trace_out_t out, void *arg)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool busy = s_exporting || s_on || s_ring == NULL;
+    s_exporting = !busy;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_RETURN_ON_FALSE(!busy, ESP_ERR_INVALID_STATE, TAG, "running, exporting or never started");
+
+    int64_t start = esp_timer_get_time();
+    export_t *e = &s_exp;
+    memset(e, 0, sizeof(*e));
+    e->out = out;
+    e->arg = arg;
+    e->first = true;
+    uint32_t head = s_head;
+    uint32_t first = head > SYS_TRACE_RING_RECS ? head - SYS_TRACE_RING_RECS : 0;
+    uint32_t kept = 0;
+    uint32_t last32 = 0;
+    int64_t t = 0;
+    out_printf(e, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (uint32_t i = first; i < head && e->err == ESP_OK; i++)
+    {
+        sys_trace_rec_t r = s_ring[i & RING_MASK];
+        if (r.seq != i + 1)
+        {
+            continue;
+        }
+        // 时刻用开机以来的微秒 和日志对得上 第一条按现在往回推 之后按差值展开 两个核的可能稍微倒着 差值按有符号算
+        t = kept ? t + (int32_t)(r.t - last32) : start - (uint32_t)((uint32_t)start - r.t);
+        last32 = r.t;
+        kept++;
+        export_rec(e, &r, t);
+    }
+    for (int c = 0; c < 2; c++)
+    {
+        core_switch(e, c, 0, t);
+    }
+
+    out_printf(e, "%s\n{\"ph\":\"M\",\"pid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"CPU\"}}",
+               e->first ? "" : ",");
+    export_meta(e, 1, -1, "process_name", "tasks");
+    char name[24];
+    for (int c = 0; c < 2; c++)
+    {
+        snprintf(name, sizeof(name), "core %d", c);
+        export_meta(e, 0, c, "thread_name", name);
+        snprintf(name, sizeof(name), "core %d irq", c);
+        export_meta(e, 0, TID_IRQ + c, "thread_name", name);
+    }
+    export_meta(e, 1, 0, "thread_name", "?");
+    for (int i = 0; i < s_ntasks; i++)
+    {
+        if (e->used_tid[i])
+        {
+            export_meta(e, 1, i + 1, "thread_name", s_tasks[i].name);
+        }
+    }
+    out_printf(e, "\n]}\n");
+    out_flush(e);
+
+    uint32_t ms = (esp_timer_get_time() - start) / 1000;
+    portENTER_CRITICAL(&s_lock);
+    s_exporting = false;
+    s_stats.exported = kept;
+    s_stats.exports++;
+    s_stats.bytes += e->bytes;
+    if (ms > s_stats.max_export_ms)
+    {
+        s_stats.max_export_ms = ms;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "exported %lu events, %llu KB in %lu ms", (unsigned long)kept, e->bytes / 1024, (unsigned long)ms);
+    return e->err;
+}
+
+static esp_err_t save_out(const void *data, size_t len, void *arg)
+{
+    return sd_writer_write(arg, data, len);
+}
+
+esp_err_t sys_trace_save(char *path, size_t len)
+{
+    sys_trace_stop();
+    ESP_RETURN_ON_FALSE(bsp_sdcard_mounted(), ESP_ERR_INVALID_STATE, TAG, "no sd card");
+    if (mkdir(TRACE_DIR, 0775) != 0)
+    {
+        struct stat st;
+        ESP_RETURN_ON_FALSE(stat(TRACE_DIR, &st) == 0, ESP_FAIL, TAG, "mkdir %s failed", TRACE_DIR);
+    }
+    char buf[64];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    snprintf(buf, sizeof(buf), "%s/trace_%02d%02d_%02d%02d%02d.json", TRACE_DIR, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    sd_writer_t *w = sd_writer_open(buf, 0);
+    ESP_RETURN_ON_FALSE(w, ESP_FAIL, TAG, "open %s failed", buf);
+    esp_err_t err = sys_trace_export(save_out, w);
+    if (err != ESP_OK)
+    {
+        sd_writer_abort(w);
+        return err;
+    }
+    ESP_RETURN_ON_ERROR(sd_writer_close(w), TAG, "close %s", buf);
+    ESP_LOGI(TAG, "saved %s", buf);
+    if (path)
+    {
+        strlcpy(path, buf, len);
+    }
+    return ESP_OK;
+}
+
+void sys_trace_get_stats(sys_trace_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    if (s_on)
+    {
+        stats->events += s_head;
+        stats->dropped += s_dropped;
+    }
+}
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 系统时间线跟踪 ****************************/
+// 看两个核上音频 LVGL 相机 SD卡这些任务是怎么交错的
+// 记任务切换(FreeRTOS的traceTASK_SWITCHED_IN钩子) 我们自己的中断进出 LVGL锁的等待 拿到和放开 各模块的区段和标记
+// 每条16字节写进PSRAM里的环 原子加占一格 最后写序号算提交 不加锁 中断里也能用 环满了覆盖最旧的 留下的是最近一段
+// flash写着的时候cache关了 PSRAM碰不得 这时的事件直接丢掉计数
+// 停下以后导出成Chrome/Perfetto的JSON(ui.perfetto.dev或chrome://tracing直接打开):
+//   CPU进程 每个核一条任务线 一条中断线
+//   tasks进程 每个任务一条线 上面是它的区段 锁等待和持锁 标记
+// 导出: GET /api/trace?start开始 GET /api/trace停下并下载 GET /api/trace?save停下并存到卡上
+//       串口控制台按r开始 再按r停下存到卡上
+// 跟不到的: SDMMC和相机VSYNC的中断在IDF和esp32-camera里面 用sd_write区段和cam_fb标记代替
+
+#define SYS_TRACE_RING_RECS     (CONFIG_APP_SYS_TRACE_RING_KB * 1024 / 16)
+#define SYS_TRACE_MAX_TASKS     64      // 导出时能叫出名字的任务 多了的按句柄显示
+
+typedef enum {
+    SYS_TRACE_EV_SWITCH = 1,            // 参数是切进来的任务句柄
+    SYS_TRACE_EV_ISR_ENTER,             // 参数都是字符串常量的地址 导出时才去读
+    SYS_TRACE_EV_ISR_EXIT,
+    SYS_TRACE_EV_LOCK_WAIT,
+    SYS_TRACE_EV_LOCK_TAKE,
+    SYS_TRACE_EV_LOCK_GIVE,
+    SYS_TRACE_EV_BEGIN,
+    SYS_TRACE_EV_END,
+    SYS_TRACE_EV_MARK,                  // 另带一个16位的数
+} sys_trace_ev_t;
+
+typedef struct {
+    bool running;
+    uint32_t events;                    // 写进环的 包括被覆盖的
+    uint32_t dropped;                   // cache关着丢的
+    uint32_t exported;                  // 上一次导出的记录数
+    uint32_t exports;
+    uint64_t bytes;                     // 导出的JSON
+    uint32_t max_export_ms;
+} sys_trace_stats_t;
+
+// 导出的输出 返回错误就停
+typedef esp_err_t (*sys_trace_out_t)(const void *data, size_t len, void *arg);
+
+#if CONFIG_APP_SYS_TRACE
+#define SYS_TRACE_ISR_ENTER(name)   sys_trace_event(SYS_TRACE_EV_ISR_ENTER, name, 0)
+#define SYS_TRACE_ISR_EXIT(name)    sys_trace_event(SYS_TRACE_EV_ISR_EXIT, name, 0)
+#define SYS_TRACE_LOCK_WAIT(name)   sys_trace_event(SYS_TRACE_EV_LOCK_WAIT, name, 0)
+#define SYS_TRACE_LOCK_TAKE(name)   sys_trace_event(SYS_TRACE_EV_LOCK_TAKE, name, 0)
+#define SYS_TRACE_LOCK_GIVE(name)   sys_trace_event(SYS_TRACE_EV_LOCK_GIVE, name, 0)
+#define SYS_TRACE_BEGIN(name)       sys_trace_event(SYS_TRACE_EV_BEGIN, name, 0)
+#define SYS_TRACE_END(name)         sys_trace_event(SYS_TRACE_EV_END, name, 0)
+#define SYS_TRACE_MARK(name, val)   sys_trace_event(SYS_TRACE_EV_MARK, name, val)
+#else
+#define SYS_TRACE_ISR_ENTER(name)   do { } while (0)
+#define SYS_TRACE_ISR_EXIT(name)    do { } while (0)
+#define SYS_TRACE_LOCK_WAIT(name)   do { } while (0)
+#define SYS_TRACE_LOCK_TAKE(name)   do { } while (0)
+#define SYS_TRACE_LOCK_GIVE(name)   do { } while (0)
+#define SYS_TRACE_BEGIN(name)       do { } while (0)
+#define SYS_TRACE_END(name)         do { } while (0)
+#define SYS_TRACE_MARK(name, val)   do { } while (0)
+#endif
+
+// name必须是字符串常量 同名的BEGIN和END在同一个任务里配对 可以嵌套
+void sys_trace_event(sys_trace_ev_t type, const char *name, uint16_t val);
+void sys_trace_task_switched_in(void);  // FreeRTOS的钩子 见sys_trace_hooks.h
+
+esp_err_t sys_trace_start(void);        // 第一次调用时分配环 清掉上一次的
+void sys_trace_stop(void);
+bool sys_trace_running(void);
+// 停下以后才能导出 可以导出多次
+esp_err_t sys_trace_export(sys_trace_out_t out, void *arg);
+// 停下并存成卡上/trace目录下的trace_MMDD_HHMMSS.json path拿回文件名 可以是NULL
+esp_err_t sys_trace_save(char *path, size_t len);
+void sys_trace_get_stats(sys_trace_stats_t *stats);
@@ -0,0 +1,8 @@
+#pragma once
+
+// 开了CONFIG_APP_SYS_TRACE时由main/CMakeLists.txt强制包含进freertos组件的每个文件
+// FreeRTOS的trace宏没定义才用空的默认值 所以要赶在它自己的头文件之前
+#ifndef __ASSEMBLER__
+void sys_trace_task_switched_in(void);
+#define traceTASK_SWITCHED_IN() sys_trace_task_switched_in()
+#endif
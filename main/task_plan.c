@@ -0,0 +1,158 @@
+#include <string.h>
+#include "task_plan.h"
+#include "ui_sysmon.h"
+#include "esp_log.h"
+
+static const char *TAG = "task_plan";
+
+#define PLAN(n, c, p, s) {.name = n, .core = c, .prio = p, .stack = s}
+
+static const task_plan_t s_plan[TASK_PLAN_COUNT] = {
+    [TASK_I2C_BUS] = PLAN("i2c_bus", 0, 6, 3072),              // 比所有用I2C的都不低 排进来马上做 只让着PCM送数
+    [TASK_LVGL] = PLAN("LVGL task", 0, 4, 6144),                // GIF解码在ui_gif自己的任务里 这里只剩PNG/SJPG解码和绘制
+    [TASK_MAIN_PAGE] = PLAN("main_page_task", 0, 5, 4096),
+    [TASK_ATT_VIEW] = PLAN("task_process_att", 0, 5, 2048),     // 只是刷界面 不和解码挤核1
+    [TASK_SD_BROWSE] = PLAN("task_process_sdcard", 0, 4, 3072), // 列目录是SD卡的活 放核1会和解码抢
+    [TASK_SD_LIST] = PLAN("sd_list", 0, 4, 4096),
+    [TASK_WIFI_CONNECT] = PLAN("app_wifi_connect", 0, 5, 4096),
+    [TASK_WIFI_TIPS] = PLAN("wifiset_tips_task", 0, 5, 2048),
+    [TASK_WIFI_AUTO] = PLAN("wifi_auto", 0, 4, 3072),
+    [TASK_WIFI_SVC] = PLAN("wifi_svc", 0, 4, 4096),
+    [TASK_NET_RADIO] = PLAN("net_radio", 0, 5, 4096),
+    [TASK_MULTIROOM_TX] = PLAN("multiroom_tx", 0, 5, 3072),     // 读SD卡按时刻广播 比界面高 包晚了只是吃掉抖动缓冲
+    [TASK_HTTPD] = PLAN("httpd", 0, tskIDLE_PRIORITY + 5, 6144),
+    [TASK_OTA] = PLAN("ota_update", 0, 3, 6144),
+    [TASK_SCREEN_MIRROR] = PLAN("screen_mirror", 0, 2, 3072),   // 比界面低 跟不上只是多合并几帧
+    [TASK_MQTT_CLIENT] = PLAN("mqtt_task", 0, 5, 6144),         // esp-mqtt自己的 收命令和管重连 和httpd一样高
+    [TASK_MQTT_SVC] = PLAN("mqtt_svc", 0, 2, 4096),             // 一分钟左右醒一次 取遥测编消息 发一阵
+    [TASK_NET_PIC] = PLAN("net_pic", 0, 3, 6144),               // 和照片预取一样 TLS握手和tjpgd都在这个栈上
+    [TASK_BLE_START] = PLAN("ble_start", 0, 3, 4096),
+    [TASK_AIR_MOUSE] = PLAN("air_mouse", 0, 5, 3072),           // 比IMU读取低
+    [TASK_IMU] = PLAN("imu", 0, 6, 3072),                       // 读晚了FIFO会溢出 比写卡的任务高
+    [TASK_ATTITUDE] = PLAN("attitude", 0, 5, 3072),             // 比采样任务低 采样任务每发布一批叫醒一次
+    [TASK_IMU_GESTURE] = PLAN("imu_gesture", 0, 2, 3072),       // 一直开着 每批几十微秒 晚一点只是手势晚认出来
+    [TASK_PEDOMETER] = PLAN("pedometer", 0, 2, 3072),           // 和手势一样 步子晚几十毫秒算没关系
+    [TASK_IMU_LOG] = PLAN("imu_log", 0, 5, 3072),               // 和姿态解算一样 每批读完就拷走 采样环只有一秒多
+    [TASK_IMU_LOG_WR] = PLAN("imu_log_wr", 0, 3, 3072),         // 写卡可以慢 有PSRAM的环顶着
+    [TASK_IDLE_MGR] = PLAN("idle_mgr", 0, 2, 3072),             // 只是定时看一眼 比什么都低
+    [TASK_APP_RES] = PLAN("app_res", 0, 2, 4096),               // 没人用的外设过一会再关 不急
+    [TASK_ALARM] = PLAN("alarm", 0, 2, 3072),                   // 每秒看一眼 响铃的片段由送数任务放
+    [TASK_STANDBY] = PLAN("standby", 0, 4, 3072),               // 醒来的路径要快 比空闲管理和后台任务高
+    [TASK_FLASH_LOG] = PLAN("flash_log", 0, 1, 3072),           // 写flash时两个核都停 攒一批在空闲时写
+
+    [TASK_SD_HOTPLUG] = PLAN("sd_hotplug", 0, 2, 3072),         // 只是偶尔问一下卡 比写卡的任务低
+    [TASK_SD_WRITER] = PLAN("sd_writer", 0, 5, 3072),           // 比拍照和录像的任务高一点 卡一直有活干
+    [TASK_SD_JOB] = PLAN("sd_job", 0, 3, 4096),                 // 比界面低 读一块就交给写盘任务 卡照样跑满
+    [TASK_MEDIA_LIB] = PLAN("media_lib", 0, 1, 4096),           // 比音乐索引还低 只在空闲时走卡
+    [TASK_MUSIC_INDEX] = PLAN("music_index", 0, 2, 5120),       // 估计响度时还要跑MP3解码
+    [TASK_ALARM_DECODE] = PLAN("alarm_decode", 0, 1, 5120),     // 铃声解码进SPIFFS 不急 MP3解码和音乐索引一样的栈
+    [TASK_MUSIC_RESUME] = PLAN("music_resume", 0, 2, 3072),
+    [TASK_MUSIC_PREFETCH] = PLAN("music_prefetch", 0, 4, 3072),
+    [TASK_MUSIC_LYRICS] = PLAN("music_lyrics", 0, 3, 3072),     // 每100ms查一次表 不让索引的解码拖住换行
+    [TASK_PIC_PREFETCH] = PLAN("pic_prefetch", 0, 3, 4096),     // 比界面任务低 不抢翻页的CPU
+    [TASK_PIC_THUMB] = PLAN("pic_thumb", 0, 2, 4096),           // 比照片预取低
+    [TASK_UI_SLIDE] = PLAN("ui_slide", 0, 3, 4096),
+    [TASK_UI_ZOOM] = PLAN("ui_zoom", 0, 3, 4096),
+    [TASK_UI_GIF] = PLAN("ui_gif", 0, 3, 4096),
+    [TASK_UI_AVI] = PLAN("ui_avi", 0, 3, 4096),
+    [TASK_CAM_CAPTURE] = PLAN("cam_capture", 0, 4, 4096),
+    [TASK_CAM_STREAM] = PLAN("cam_stream", 0, 4, 4096),
+    [TASK_CAM_AVI] = PLAN("cam_avi", 0, 4, 4096),
+    [TASK_CAM_MOTION] = PLAN("cam_motion", 0, 3, 3072),
+    [TASK_CAM_FACE] = PLAN("cam_face", 0, 2, 8192),            // 推理一帧几十毫秒 比界面低 预览在核1不受影响
+    [TASK_SCAN_VIEW] = PLAN("scan_view", 0, 5, 4096),           // 扫码的取帧和预览放界面这边 核1留给识别
+
+    [TASK_AUDIO_PCM_FEED] = PLAN("audio_pcm_feed", 0, 7, 3072), // I2S不能断 全机最高
+    [TASK_AUDIO_FADE] = PLAN("Audio Fade", 0, 6, 4096),         // 交叉淡入时下一首在另一个核上解码
+    [TASK_FLAC_MC] = PLAN("flac_mc", 0, 6, 2048),               // 核1解FLAC时第一声道的预测还原 和淡入解码一样高
+    [TASK_AUDIO_VIS] = PLAN("audio_vis", 0, 3, 3072),           // 解码在核1 分析放核0
+    [TASK_VOICE_FEED] = PLAN("voice_feed", 0, 6, 4096),         // 比PCM送数低 比界面和SD卡的后台任务高
+    [TASK_INTERCOM_NET] = PLAN("intercom_net", 0, 6, 4096),     // 收对讲的声音包 和语音送数一样 晚了吃掉抖动缓冲
+    [TASK_INTERCOM_TX] = PLAN("intercom_tx", 0, 5, 3072),       // 编ADPCM发包 一包20ms 比界面高
+    [TASK_INTERCOM_VTX] = PLAN("intercom_vtx", 0, 3, 3072),     // 画面分片发 比声音和界面低 发不完就丢帧
+
+    [TASK_AUDIO_PLAYER] = PLAN("Audio Task", 1, 6, 4096),
+    [TASK_POWER_MUSIC] = PLAN("power_music_task", 1, 5, 4096),  // 播放开机音乐 不阻塞主界面
+    [TASK_MULTIROOM_RX] = PLAN("multiroom_rx", 1, 6, 5120),     // 按约定时刻解码MP3 和音乐解码一样
+    [TASK_CAM_VIEW] = PLAN("task_process_camera", 1, 5, 4096),  // 比解码低 音乐和预览一起时先保声音
+    [TASK_VOICE_DETECT] = PLAN("voice_detect", 1, 6, 6144),     // 要跟上实时 比相机预览高
+    [TASK_VOICE_MEMO] = PLAN("voice_memo", 1, 3, 3072),         // 比识别低 比TTS和统计高 环满了才会丢
+    [TASK_AUDIO_TUNER] = PLAN("audio_tuner", 1, 3, 3072),       // 送数在核0 分析放核1 晚了只是跳一块
+    [TASK_CAM_QR] = PLAN("cam_qr", 1, 3, 20480),                // quirc_decode的数据流在栈上 将近18KB
+    [TASK_VOICE_TTS] = PLAN("voice_tts", 1, 2, 6144),           // 比识别和AFE都低 只用它们剩下的
+    [TASK_VOICE_VOCAB] = PLAN("voice_vocab", 1, 1, 4096),       // 几秒看一眼媒体库 改命令表是在识别任务里
+    [TASK_INTERCOM_VRX] = PLAN("intercom_vrx", 1, 2, 4096),     // 对讲画面拼帧解码 和TTS一样只用识别剩下的
+
+    [TASK_BOOT_STAGE] = PLAN("boot_", tskNO_AFFINITY, 5, 4096), // 名字和核由各阶段自己给
+    [TASK_LCD_BENCH] = PLAN("lcd_bench", 0, 3, 4096),
+    [TASK_LCD_DRAW_BENCH] = PLAN("lcd_draw_bench", 0, 3, 4096),
+    [TASK_AUDIO_BENCH] = PLAN("audio_bench", 0, 3, 6144),
+    [TASK_VOICE_BENCH] = PLAN("voice_bench", 1, 2, 4096),       // 只是记录 比识别和界面都低
+    [TASK_BENCH_SUITE] = PLAN("bench_suite", 0, 3, 6144),       // 和audio_bench一样 解码在这个栈上
+};
+
+const task_plan_t *task_plan_get(task_plan_id_t id)
+{
+    return &s_plan[id];
+}
+
+BaseType_t task_plan_create(task_plan_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *out)
+{
+    const task_plan_t *p = task_plan_get(id);
+    return xTaskCreatePinnedToCore(fn, p->name, p->stack, arg, p->prio, out, p->core);
+}
+
+static const task_plan_t *plan_find(const char *name)
+{
+    for (int i = 0; i < TASK_PLAN_COUNT; i++)
+    {
+        if (strcmp(s_plan[i].name, name) == 0)
+        {
+            return &s_plan[i];
+        }
+    }
+    return NULL;
+}
+
+void task_plan_log(void)
+{
+    static sysmon_base_t base;
+    static sysmon_snapshot_t snap;
+    if (sysmon_sample(&base, &snap) != ESP_OK)
+    {
+        return;
+    }
+    if (snap.elapsed_ms == 0)
+    {
+        ESP_LOGI(TAG, "baseline taken, ask again for per-core load");
+        return;
+    }
+    uint32_t planned[2] = {0}, other[2] = {0};
+    for (int i = 0; i < snap.count; i++)
+    {
+        const sysmon_task_t *t = &snap.tasks[i];
+        const task_plan_t *p = plan_find(t->name);
+        if (p && p->core != tskNO_AFFINITY && p->core != t->core)
+        {
+            ESP_LOGW(TAG, "%s planned on core %d, pinned to %d", t->name, p->core, t->core);
+        }
+        if (t->core < 0 || strncmp(t->name, "IDLE", 4) == 0)
+        {
+            continue; // 不绑核的不知道跑在哪 空闲任务不算负载
+        }
+        if (p)
+        {
+            planned[t->core] += t->cpu_pm;
+        }
+        else
+        {
+            other[t->core] += t->cpu_pm;
+        }
+    }
+    for (int c = 0; c < 2; c++)
+    {
+        ESP_LOGI(TAG, "core%d: %u.%u%% busy, planned tasks %lu.%lu%%, others %lu.%lu%%", c, snap.core_pm[c] / 10,
+                 snap.core_pm[c] % 10, (unsigned long)planned[c] / 10, (unsigned long)planned[c] % 10,
+                 (unsigned long)other[c] / 10, (unsigned long)other[c] % 10);
+    }
+}
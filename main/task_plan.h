@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+
+/*********************** 任务分核和优先级 ****************************/
+// 所有任务的名字 核 优先级 栈都在task_plan.c的一张表里 不在各自创建的地方写死
+// 核0 界面 网络 蓝牙 IMU SD卡读写和各种后台任务 LVGL也绑在这里
+// 核1 只放跟着实时走的媒体 音乐解码 语音识别 摄像头预览 不让SD卡扫描和后台任务来抢
+// 同一个核上 送I2S的数据最高 然后是会丢数据的(IMU FIFO 识别) 界面 后台任务 最低是只在空闲时干的
+// 组件自己建的任务(LVGL 音乐播放 HTTP服务器)也在表里 从表里取配置传给它们
+// task_plan_log按表里的核汇总实测占用 实际绑的核和表里不一样的会报出来
+
+typedef enum {
+    // 核0 界面和网络
+    TASK_I2C_BUS,
+    TASK_LVGL,
+    TASK_MAIN_PAGE,
+    TASK_ATT_VIEW,
+    TASK_SD_BROWSE,
+    TASK_SD_LIST,
+    TASK_WIFI_CONNECT,
+    TASK_WIFI_TIPS,
+    TASK_WIFI_AUTO,
+    TASK_WIFI_SVC,
+    TASK_NET_RADIO,
+    TASK_MULTIROOM_TX,
+    TASK_HTTPD,
+    TASK_OTA,
+    TASK_SCREEN_MIRROR,
+    TASK_MQTT_CLIENT,
+    TASK_MQTT_SVC,
+    TASK_NET_PIC,
+    TASK_BLE_START,
+    TASK_AIR_MOUSE,
+    TASK_IMU,
+    TASK_ATTITUDE,
+    TASK_IMU_GESTURE,
+    TASK_PEDOMETER,
+    TASK_IMU_LOG,
+    TASK_IMU_LOG_WR,
+    TASK_IDLE_MGR,
+    TASK_APP_RES,
+    TASK_ALARM,
+    TASK_STANDBY,
+    TASK_FLASH_LOG,
+    // 核0 SD卡和图片
+    TASK_SD_HOTPLUG,
+    TASK_SD_WRITER,
+    TASK_SD_JOB,
+    TASK_MEDIA_LIB,
+    TASK_MUSIC_INDEX,
+    TASK_ALARM_DECODE,
+    TASK_MUSIC_RESUME,
+    TASK_MUSIC_PREFETCH,
+    TASK_MUSIC_LYRICS,
+    TASK_PIC_PREFETCH,
+    TASK_PIC_THUMB,
+    TASK_UI_SLIDE,
+    TASK_UI_ZOOM,
+    TASK_UI_GIF,
+    TASK_UI_AVI,
+    TASK_CAM_CAPTURE,
+    TASK_CAM_STREAM,
+    TASK_CAM_AVI,
+    TASK_CAM_MOTION,
+    TASK_CAM_FACE,
+    TASK_SCAN_VIEW,
+    // 核0 音频的周边
+    TASK_AUDIO_PCM_FEED,
+    TASK_AUDIO_FADE,
+    TASK_FLAC_MC,
+    TASK_AUDIO_VIS,
+    TASK_VOICE_FEED,
+    TASK_INTERCOM_NET,
+    TASK_INTERCOM_TX,
+    TASK_INTERCOM_VTX,
+    // 核1 媒体
+    TASK_AUDIO_PLAYER,
+    TASK_POWER_MUSIC,
+    TASK_MULTIROOM_RX,
+    TASK_CAM_VIEW,
+    TASK_VOICE_DETECT,
+    TASK_VOICE_MEMO,
+    TASK_AUDIO_TUNER,
+    TASK_CAM_QR,
+    TASK_VOICE_TTS,
+    TASK_VOICE_VOCAB,
+    TASK_INTERCOM_VRX,
+    // 开机和测试
+    TASK_BOOT_STAGE,
+    TASK_LCD_BENCH,
+    TASK_LCD_DRAW_BENCH,
+    TASK_AUDIO_BENCH,
+    TASK_VOICE_BENCH,
+    TASK_BENCH_SUITE,
+    TASK_PLAN_COUNT,
+} task_plan_id_t;
+
+typedef struct {
+    const char *name;
+    int8_t core;                        // tskNO_AFFINITY不绑
+    uint8_t prio;
+    uint16_t stack;                     // 字节
+} task_plan_t;
+
+const task_plan_t *task_plan_get(task_plan_id_t id);
+BaseType_t task_plan_create(task_plan_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *out);   // 和xTaskCreatePinnedToCore一样返回pdPASS
+void task_plan_log(void);               // 和上一次调用比 每个核上表里的任务和其他的各占多少
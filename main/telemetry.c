@@ -0,0 +1,237 @@
+#include <string.h>
+#include "telemetry.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "telemetry";
+
+typedef struct {
+    char name[TELEMETRY_NAME_LEN];
+    telemetry_kind_t kind;
+    telemetry_read_t read;
+    void *arg;
+} metric_t;
+
+static metric_t s_metrics[TELEMETRY_MAX_METRICS];
+static volatile int s_count;            // 写好一列才加一 采样只看这个
+static telemetry_row_t *s_ring;
+static volatile uint32_t s_head;        // 下一行的seq
+static esp_timer_handle_t s_timer;
+static bool s_armed;                    // 定时器排着下一次
+static int64_t s_lease_until;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static telemetry_stats_t s_stats;
+static telemetry_cpu_t s_cpu;           // 只在esp_timer任务里用
+
+static void sample_cb(void *arg)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint32_t head = s_head;
+    telemetry_row_t *row = &s_ring[head % TELEMETRY_RING];
+    int count = s_count;
+    row->seq = head;
+    row->t_ms = t0 / 1000;
+    row->count = count;
+    for (int i = 0; i < count; i++)
+    {
+        row->v[i] = s_metrics[i].read(s_metrics[i].arg);
+    }
+    __atomic_store_n(&s_head, head + 1, __ATOMIC_RELEASE);
+
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    // 租约到了就不再排下一次 续租的人看到没排着会重新排
+    bool again = t0 < s_lease_until;
+    s_armed = again;
+    s_stats.sampling = again;
+    s_stats.rows++;
+    s_stats.sample_us += us;
+    s_stats.sample_max_us = us > s_stats.sample_max_us ? us : s_stats.sample_max_us;
+    portEXIT_CRITICAL(&s_lock);
+    if (again)
+    {
+        esp_timer_start_once(s_timer, (uint64_t)CONFIG_APP_TELEMETRY_PERIOD_MS * 1000);
+    }
+}
+
+static uint32_t read_free(void *arg)
+{
+    return heap_caps_get_free_size((uint32_t)(uintptr_t)arg);
+}
+
+static uint32_t read_block(void *arg)
+{
+    return heap_caps_get_largest_free_block((uint32_t)(uintptr_t)arg);
+}
+
+static uint32_t read_min(void *arg)
+{
+    return heap_caps_get_minimum_free_size((uint32_t)(uintptr_t)arg);
+}
+
+static uint32_t read_cpu(void *arg)
+{
+    return telemetry_cpu_load(&s_cpu, (int)(uintptr_t)arg);
+}
+
+esp_err_t telemetry_init(void)
+{
+    if (s_ring)
+    {
+        return ESP_OK;
+    }
+    s_ring = heap_caps_calloc(TELEMETRY_RING, sizeof(telemetry_row_t), MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(s_ring, ESP_ERR_NO_MEM, TAG, "no mem for ring");
+    const esp_timer_create_args_t args = {
+        .callback = sample_cb,
+        .name = "telemetry",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "create timer");
+
+    telemetry_add("int_free", TELEMETRY_GAUGE, read_free, (void *)MALLOC_CAP_INTERNAL);
+    telemetry_add("int_min", TELEMETRY_GAUGE, read_min, (void *)MALLOC_CAP_INTERNAL);
+    telemetry_add("int_block", TELEMETRY_GAUGE, read_block, (void *)MALLOC_CAP_INTERNAL);
+    telemetry_add("dma_free", TELEMETRY_GAUGE, read_free, (void *)MALLOC_CAP_DMA);
+    telemetry_add("dma_block", TELEMETRY_GAUGE, read_block, (void *)MALLOC_CAP_DMA);
+    telemetry_add("psram_free", TELEMETRY_GAUGE, read_free, (void *)MALLOC_CAP_SPIRAM);
+    telemetry_add("psram_block", TELEMETRY_GAUGE, read_block, (void *)MALLOC_CAP_SPIRAM);
+    telemetry_add("cpu0_pm", TELEMETRY_GAUGE, read_cpu, (void *)0);
+    telemetry_add("cpu1_pm", TELEMETRY_GAUGE, read_cpu, (void *)1);
+    return ESP_OK;
+}
+
+int telemetry_add(const char *name, telemetry_kind_t kind, telemetry_read_t read, void *arg)
+{
+    portENTER_CRITICAL(&s_lock);
+    int i = s_count;
+    if (i < TELEMETRY_MAX_METRICS)
+    {
+        strlcpy(s_metrics[i].name, name, sizeof(s_metrics[i].name));
+        s_metrics[i].kind = kind;
+        s_metrics[i].read = read;
+        s_metrics[i].arg = arg;
+        s_count = i + 1;
+        s_stats.metrics = i + 1;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (i >= TELEMETRY_MAX_METRICS)
+    {
+        ESP_LOGW(TAG, "no slot for %s", name);
+        return -1;
+    }
+    return i;
+}
+
+int telemetry_count(void)
+{
+    return s_count;
+}
+
+const char *telemetry_name(int i)
+{
+    return i >= 0 && i < s_count ? s_metrics[i].name : "";
+}
+
+telemetry_kind_t telemetry_kind(int i)
+{
+    return i >= 0 && i < s_count ? s_metrics[i].kind : TELEMETRY_GAUGE;
+}
+
+uint32_t telemetry_period_ms(void)
+{
+    return CONFIG_APP_TELEMETRY_PERIOD_MS;
+}
+
+void telemetry_lease(uint32_t ms)
+{
+    if (s_timer == NULL)
+    {
+        return;
+    }
+    int64_t until = esp_timer_get_time() + (int64_t)ms * 1000;
+    portENTER_CRITICAL(&s_lock);
+    s_lease_until = until > s_lease_until ? until : s_lease_until;
+    bool arm = !s_armed;
+    s_armed = true;
+    s_stats.sampling = true;
+    s_stats.leases += arm;
+    portEXIT_CRITICAL(&s_lock);
+    if (arm)
+    {
+        esp_timer_start_once(s_timer, 0); // 马上采一行 看的人不用等一个周期
+    }
+}
+
+uint32_t telemetry_head(void)
+{
+    return __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+}
+
+int telemetry_read(uint32_t *cursor, telemetry_row_t *rows, int max)
+{
+    if (s_ring == NULL)
+    {
+        return 0;
+    }
+    uint32_t head = telemetry_head();
+    // 最老的一格可能正在被写 不读
+    uint32_t oldest = head > TELEMETRY_RING - 1 ? head - (TELEMETRY_RING - 1) : 0;
+    uint32_t lost = 0;
+    if ((int32_t)(head - *cursor) < 0)
+    {
+        *cursor = head; // 重启以前的游标
+    }
+    if ((int32_t)(*cursor - oldest) < 0)
+    {
+        lost = oldest - *cursor;
+        *cursor = oldest;
+    }
+    int n = 0;
+    while (n < max && *cursor != head)
+    {
+        rows[n] = s_ring[*cursor % TELEMETRY_RING];
+        // 拷的时候被写过了 这一行作废
+        if (telemetry_head() - *cursor >= TELEMETRY_RING || rows[n].seq != *cursor)
+        {
+            lost++;
+        }
+        else
+        {
+            n++;
+        }
+        (*cursor)++;
+    }
+    if (lost)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.lost += lost;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    return n;
+}
+
+// 运行时间统计用的是esp_timer的微秒 空闲任务跑了多久就是闲了多久
+uint16_t telemetry_cpu_load(telemetry_cpu_t *st, int core)
+{
+    TaskStatus_t status;
+    vTaskGetInfo(xTaskGetIdleTaskHandleForCPU(core), &status, pdFALSE, eRunning);
+    int64_t now = esp_timer_get_time();
+    uint32_t elapsed = now - st->t_us[core];
+    uint32_t idle = status.ulRunTimeCounter - st->idle_us[core];
+    uint16_t load = st->t_us[core] && elapsed && idle < elapsed ? 1000 - (uint64_t)idle * 1000 / elapsed : 0;
+    st->idle_us[core] = status.ulRunTimeCounter;
+    st->t_us[core] = now;
+    return load;
+}
+
+void telemetry_get_stats(telemetry_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
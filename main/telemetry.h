@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+
+/*********************** 运行时遥测 ****************************/
+// 各模块注册计数和量表 每个一列 给名字和一个读数的回调
+// 有人在看(租约没到期)时esp_timer按周期调一遍回调 一行写进环形缓冲 没人看定时器不动 一点开销都没有
+// 环形缓冲只有采样这一个写者 读的人各拿一个游标 不加锁 读的时候被覆盖的行丢掉
+// 导出的人(串口 HTTP)每次读的时候续租约 停了过一会采样自己停
+// 回调在esp_timer任务里 不能阻塞 只读自己的统计
+// 计数是一直往上加的 导出原值 差分由看的人算 量表是当时的值
+
+#define TELEMETRY_MAX_METRICS   32
+#define TELEMETRY_RING          120     // 行 按默认周期是两分钟
+#define TELEMETRY_NAME_LEN      20
+#define TELEMETRY_LEASE_MS      30000   // 导出一次续的租约
+
+typedef enum {
+    TELEMETRY_GAUGE,
+    TELEMETRY_COUNTER,
+} telemetry_kind_t;
+
+typedef uint32_t (*telemetry_read_t)(void *arg);
+
+typedef struct {
+    uint32_t seq;                       // 第几行 读的人靠它接着读
+    uint32_t t_ms;                      // 开机到采样
+    uint8_t count;                      // 采样时注册了的列数
+    uint32_t v[TELEMETRY_MAX_METRICS];
+} telemetry_row_t;
+
+// 算CPU占用的上一次空闲时间 每个用的人一份 互不影响
+typedef struct {
+    uint32_t idle_us[2];
+    int64_t t_us[2];
+} telemetry_cpu_t;
+
+typedef struct {
+    bool sampling;
+    uint32_t metrics;
+    uint32_t rows;                      // 采过的行
+    uint32_t leases;                    // 从停着被叫醒的次数
+    uint32_t lost;                      // 读的人没跟上被覆盖的行
+    uint32_t sample_max_us;             // 采一行最长的时间
+    uint64_t sample_us;
+} telemetry_stats_t;
+
+esp_err_t telemetry_init(void);         // 开机早点调 建定时器 注册堆和CPU
+int telemetry_add(const char *name, telemetry_kind_t kind, telemetry_read_t read, void *arg);  // 返回列号 满了-1
+int telemetry_count(void);
+const char *telemetry_name(int i);
+telemetry_kind_t telemetry_kind(int i);
+uint32_t telemetry_period_ms(void);
+void telemetry_lease(uint32_t ms);      // 至少采样到ms以后
+uint32_t telemetry_head(void);          // 下一行的seq 从现在开始读就用它当游标
+int telemetry_read(uint32_t *cursor, telemetry_row_t *rows, int max);   // 读游标后面的行 返回行数
+uint16_t telemetry_cpu_load(telemetry_cpu_t *st, int core);    // 上次调用以来的占用 千分比 第一次是0
+void telemetry_get_stats(telemetry_stats_t *stats);
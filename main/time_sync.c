@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+#include "time_sync.h"
+#include "evt_bus.h"
+#include "nvs.h"
+#include "esp_netif_sntp.h"
+#include "esp_sntp.h"
+#include "esp_timer.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "time_sync";
+
+#define TIME_NVS_NAMESPACE  "time"
+#define TIME_NVS_KEY        "last"
+
+static esp_timer_handle_t s_save_timer;
+static int64_t s_base_us;               // 墙上时间减开机时间 用来算对时的偏差
+static bool s_started;
+static time_sync_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_source_names[] = {"none", "saved", "rtc", "sntp"};
+
+const char *time_sync_source_name(time_sync_source_t source)
+{
+    return source <= TIME_SYNC_SNTP ? s_source_names[source] : "?";
+}
+
+static int64_t wall_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static esp_err_t time_save(void)
+{
+    time_t now = time(NULL);
+    if (now < TIME_SYNC_MIN_EPOCH)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(TIME_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs open");
+    esp_err_t ret = nvs_set_i64(nvs, TIME_NVS_KEY, now);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (ret == ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.saves++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    return ret;
+}
+
+static void save_timer_cb(void *arg)
+{
+    time_save();
+}
+
+void time_sync_restore(void)
+{
+    setenv("TZ", TIME_SYNC_TZ, 1);
+    tzset();
+
+    time_sync_source_t source = TIME_SYNC_RTC;
+    if (time(NULL) < TIME_SYNC_MIN_EPOCH)
+    {
+        // 断电开机 系统时间从1970开始 用上次保存的
+        source = TIME_SYNC_NONE;
+        nvs_handle_t nvs;
+        int64_t saved = 0;
+        if (nvs_open(TIME_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK)
+        {
+            nvs_get_i64(nvs, TIME_NVS_KEY, &saved);
+            nvs_close(nvs);
+        }
+        if (saved >= TIME_SYNC_MIN_EPOCH)
+        {
+            struct timeval tv = {.tv_sec = saved};
+            settimeofday(&tv, NULL);
+            source = TIME_SYNC_SAVED;
+        }
+    }
+    s_base_us = wall_us() - esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_stats.boot_source = source;
+    s_stats.source = source;
+    portEXIT_CRITICAL(&s_lock);
+
+    const esp_timer_create_args_t args = {.callback = save_timer_cb, .name = "time_save"};
+    if (esp_timer_create(&args, &s_save_timer) == ESP_OK)
+    {
+        esp_timer_start_periodic(s_save_timer, (uint64_t)TIME_SYNC_SAVE_S * 1000000);
+    }
+    ESP_LOGI(TAG, "boot time from %s", s_source_names[source]);
+}
+
+// 在lwip任务里 平滑模式下偏差不大时时间还没改 adjtime在慢慢拉
+static void sync_cb(struct timeval *tv)
+{
+    int64_t base = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec - esp_timer_get_time();
+    int64_t offset_ms = (base - s_base_us) / 1000;
+    s_base_us = base;
+    bool slewing = sntp_get_sync_status() == SNTP_SYNC_STATUS_IN_PROGRESS;
+    portENTER_CRITICAL(&s_lock);
+    bool first = s_stats.syncs == 0;
+    if (first)
+    {
+        s_stats.first_sync_ms = esp_timer_get_time() / 1000;
+    }
+    s_stats.syncs++;
+    s_stats.source = TIME_SYNC_SNTP;
+    s_stats.last_offset_ms = offset_ms;
+    s_stats.slewing = slewing;
+    s_stats.steps += !slewing;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "SNTP offset %lld ms, %s", offset_ms, slewing ? "slewing" : "stepped");
+    time_save();
+    evt_bus_publish(EVT_TIME_SYNCED, TIME_SYNC_SNTP, 0);
+}
+
+esp_err_t time_sync_start(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool first = !s_started;
+    s_started = true;
+    portEXIT_CRITICAL(&s_lock);
+    if (!first)
+    {
+        return ESP_OK;
+    }
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(TIME_SYNC_SERVER);
+    config.smooth_sync = true;  // 偏差在adjtime范围内就慢慢拉 不跳秒
+    config.sync_cb = sync_cb;
+    // 不等结果 没连网时lwip自己隔一会再试 连上以后按CONFIG_LWIP_SNTP_UPDATE_DELAY定期对
+    return esp_netif_sntp_init(&config);
+}
+
+bool time_sync_valid(void)
+{
+    return time_sync_source() != TIME_SYNC_NONE;
+}
+
+time_sync_source_t time_sync_source(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    time_sync_source_t source = s_stats.source;
+    portEXIT_CRITICAL(&s_lock);
+    return source;
+}
+
+void time_sync_get_stats(time_sync_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    if (stats->slewing && sntp_get_sync_status() != SNTP_SYNC_STATUS_IN_PROGRESS)
+    {
+        stats->slewing = false; // adjtime拉完了
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 系统时间 ****************************/
+// 开机就有时间 主页时钟马上显示 不用等连上网对时
+// 软件复位和深度睡眠后系统时间由RTC定时器接着走 本来就是准的 直接用
+// 断电以后RTC没了 用NVS里最后保存的时间 只是个下限 断电多久不知道 标成估计值 界面显示成灰色
+// 对时不阻塞任何任务 SNTP在lwip里后台跑 偏差小的用adjtime慢慢拉过去 秒数不会跳 太大才直接设
+// 对上以后和之后每TIME_SYNC_SAVE_S存一次NVS 作为下次断电开机的起点
+
+#define TIME_SYNC_TZ            "CST-8"
+#define TIME_SYNC_SERVER        "cn.pool.ntp.org"
+#define TIME_SYNC_SAVE_S        (15 * 60)
+#define TIME_SYNC_MIN_EPOCH     1704067200  // 2024-01-01 比这个早说明系统时间是开机的默认值
+
+typedef enum {
+    TIME_SYNC_NONE,                     // 从来没有过时间
+    TIME_SYNC_SAVED,                    // NVS里的估计值
+    TIME_SYNC_RTC,                      // 复位或睡眠以前的时间接着走的
+    TIME_SYNC_SNTP,                     // 这次开机对过时
+} time_sync_source_t;
+
+typedef struct {
+    time_sync_source_t boot_source;     // 开机时用的是哪个
+    time_sync_source_t source;
+    uint32_t syncs;
+    uint32_t first_sync_ms;             // 开机到第一次对上
+    int64_t last_offset_ms;             // 最近一次对时 服务器减本地
+    bool slewing;                       // adjtime还在拉
+    uint32_t steps;                     // 偏差太大直接设时间的次数
+    uint32_t saves;
+} time_sync_stats_t;
+
+void time_sync_restore(void);           // nvs_flash_init以后尽早调用 设时区 没有时间就用NVS里的
+esp_err_t time_sync_start(void);        // 网络接口初始化以后调用 每次对上发一次EVT_TIME_SYNCED 在lwip任务里
+bool time_sync_valid(void);             // 有可以显示的时间 估计值也算
+time_sync_source_t time_sync_source(void);
+const char *time_sync_source_name(time_sync_source_t source);
+void time_sync_get_stats(time_sync_stats_t *stats);
@@ -0,0 +1,427 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "ui_avi.h"
+#include "task_plan.h"
+#include "pic_jpeg.h"
+#include "mem_pool.h"
+#include "fd_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_avi";
+
+#define AVI_PATH_LEN        160
+#define AVI_POLL_MS         50          // 解码任务等缓冲时隔这么久看一眼控件是不是已经删了
+#define AVI_TIMER_MS        5
+#define AVI_FRAME_MAX       (256 * 1024)    // 一帧JPEG最大多少 再大当作坏文件
+
+typedef struct {
+    uint8_t idx;                        // 缓冲下标 UI_AVI_BUFS表示放完了
+    uint32_t frame;                     // 帧号 显示时刻从它算
+} avi_msg_t;
+
+typedef struct {
+    // 两边共用
+    volatile bool quit;
+    uint8_t refs;                       // 控件和解码任务各一份 最后放手的一方释放
+    QueueHandle_t ready_q;              // 解码任务 -> LVGL
+    QueueHandle_t free_q;               // LVGL -> 解码任务
+    uint8_t *bufs[UI_AVI_BUFS];
+    uint16_t width;                     // 输出尺寸
+    uint16_t height;
+    uint32_t us_per_frame;
+    uint32_t movi_pos;                  // 'movi'后面第一个块
+    uint32_t movi_end;
+    int64_t t_start;
+    char path[AVI_PATH_LEN];
+    // 只在LVGL任务里用
+    lv_obj_t *img;
+    lv_img_dsc_t dsc;
+    lv_timer_t *timer;
+    int shown;                          // 正在显示的缓冲 -1是还没有
+    avi_msg_t next;
+    bool has_next;
+} avi_player_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ui_avi_stats_t s_stats;
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void avi_put(avi_player_t *p)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool last = --p->refs == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!last)
+    {
+        return;
+    }
+    for (int i = 0; i < UI_AVI_BUFS; i++)
+    {
+        mem_pool_free(p->bufs[i]);
+    }
+    if (p->ready_q)
+    {
+        vQueueDelete(p->ready_q);
+    }
+    if (p->free_q)
+    {
+        vQueueDelete(p->free_q);
+    }
+    free(p);
+}
+
+static int64_t avi_due(const avi_player_t *p, uint32_t frame)
+{
+    return p->t_start + (int64_t)frame * p->us_per_frame;
+}
+
+// 找avih和movi 只看RIFF最外层和hdrl里面
+static bool avi_parse(FILE *f, uint32_t *w, uint32_t *h, uint32_t *us_per_frame, uint32_t *movi_pos, uint32_t *movi_end)
+{
+    uint8_t hdr[12];
+    if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "AVI ", 4) != 0)
+    {
+        return false;
+    }
+    uint32_t riff_end = rd32(hdr + 4) + 8;
+    uint32_t pos = 12;
+    bool have_avih = false;
+    while (pos + 8 <= riff_end && fseek(f, pos, SEEK_SET) == 0 && fread(hdr, 1, 12, f) >= 8)
+    {
+        uint32_t size = rd32(hdr + 4);
+        if (memcmp(hdr, "LIST", 4) == 0 && memcmp(hdr + 8, "hdrl", 4) == 0)
+        {
+            // hdrl里第一个就是avih
+            uint8_t avih[8 + 56];
+            if (fread(avih, 1, sizeof(avih), f) == sizeof(avih) && memcmp(avih, "avih", 4) == 0)
+            {
+                *us_per_frame = rd32(avih + 8);
+                *w = rd32(avih + 8 + 32);
+                *h = rd32(avih + 8 + 36);
+                have_avih = true;
+            }
+        }
+        else if (memcmp(hdr, "LIST", 4) == 0 && memcmp(hdr + 8, "movi", 4) == 0)
+        {
+            *movi_pos = pos + 12;
+            *movi_end = pos + 8 + size;
+            return have_avih;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+/************ 解码任务 ************/
+static void avi_post_end(avi_player_t *p)
+{
+    avi_msg_t msg = {.idx = UI_AVI_BUFS};
+    while (!p->quit && xQueueSend(p->ready_q, &msg, pdMS_TO_TICKS(AVI_POLL_MS)) != pdTRUE)
+    {
+    }
+}
+
+// 顺着读 不fseek 块都从stdio的大缓冲里拷 跳过的帧也只是多拷一次
+static void avi_play(avi_player_t *p, FILE *f, uint8_t *jpg, void *work)
+{
+    if (fseek(f, p->movi_pos, SEEK_SET) != 0)
+    {
+        return;
+    }
+    uint32_t pos = p->movi_pos;
+    uint32_t frame = 0;
+    while (!p->quit && pos + 8 <= p->movi_end)
+    {
+        uint8_t hdr[8];
+        int64_t t0 = esp_timer_get_time();
+        if (fread(hdr, 1, 8, f) != 8)
+        {
+            break;
+        }
+        pos += 8;
+        uint32_t size = rd32(hdr + 4);
+        if (memcmp(hdr, "LIST", 4) == 0)
+        {
+            // rec列表 跳过类型进去接着读
+            if (fread(hdr, 1, 4, f) != 4)
+            {
+                break;
+            }
+            pos += 4;
+            continue;
+        }
+        bool video = hdr[2] == 'd' && (hdr[3] == 'c' || hdr[3] == 'b');
+        uint32_t padded = size + (size & 1);
+        if (padded > AVI_FRAME_MAX)
+        {
+            if (video || fseek(f, padded, SEEK_CUR) != 0)
+            {
+                break;
+            }
+            pos += padded;
+            continue;
+        }
+        if (fread(jpg, 1, padded, f) != padded)
+        {
+            break;
+        }
+        pos += padded;
+        if (!video || size == 0)
+        {
+            continue;                   // 音频 JUNK之类
+        }
+        uint32_t read_us = esp_timer_get_time() - t0;
+        uint32_t n = frame++;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.frames++;
+        s_stats.read_us += read_us;
+        s_stats.bytes += size;
+        portEXIT_CRITICAL(&s_lock);
+        // 解完也赶不上下一帧的时刻 不如直接跳过
+        if (esp_timer_get_time() > avi_due(p, n + 1))
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_stats.skipped++;
+            portEXIT_CRITICAL(&s_lock);
+            continue;
+        }
+
+        uint8_t idx;
+        while (!p->quit && xQueueReceive(p->free_q, &idx, pdMS_TO_TICKS(AVI_POLL_MS)) != pdTRUE)
+        {
+        }
+        if (p->quit)
+        {
+            break;
+        }
+        pic_jpeg_info_t info;
+        bool ok = pic_jpeg_decode_frame(jpg, size, p->width, p->height, (lv_color_t *)p->bufs[idx], work, &info);
+        portENTER_CRITICAL(&s_lock);
+        if (ok)
+        {
+            s_stats.decoded++;
+            s_stats.decode_us += info.decode_us;
+            if (info.decode_us > s_stats.max_decode_us)
+            {
+                s_stats.max_decode_us = info.decode_us;
+            }
+        }
+        else
+        {
+            s_stats.failed++;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        avi_msg_t msg = {.idx = idx, .frame = n};
+        if (!ok)
+        {
+            xQueueSend(p->free_q, &idx, 0);
+        }
+        else
+        {
+            while (!p->quit && xQueueSend(p->ready_q, &msg, pdMS_TO_TICKS(AVI_POLL_MS)) != pdTRUE)
+            {
+            }
+        }
+    }
+}
+
+static void avi_task(void *arg)
+{
+    avi_player_t *p = arg;
+    FILE *f = fd_pool_fopen(p->path, "rb");
+    uint8_t *ahead = heap_caps_malloc(UI_AVI_READAHEAD, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *jpg = heap_caps_malloc(AVI_FRAME_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    void *work = mem_pool_alloc(MEM_POOL_DECODER, PIC_JPEG_WORK_SIZE);
+    if (f && jpg && work)
+    {
+        if (ahead)
+        {
+            setvbuf(f, (char *)ahead, _IOFBF, UI_AVI_READAHEAD);
+        }
+        avi_play(p, f, jpg, work);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "%s: player buffers alloc failed", p->path);
+    }
+    if (f)
+    {
+        fclose(f);
+    }
+    heap_caps_free(ahead);
+    heap_caps_free(jpg);
+    mem_pool_free(work);
+    avi_post_end(p);
+    avi_put(p);
+    vTaskDelete(NULL);
+}
+
+/************ LVGL任务 ************/
+static void avi_show(avi_player_t *p, uint8_t idx)
+{
+    if (p->shown >= 0)
+    {
+        xQueueSend(p->free_q, &(uint8_t){p->shown}, 0);
+    }
+    p->shown = idx;
+    p->dsc.data = p->bufs[idx];
+    lv_img_set_src(p->img, &p->dsc);
+    lv_obj_invalidate(p->img);          // 同一个dsc换了数据 要自己标脏
+    portENTER_CRITICAL(&s_lock);
+    s_stats.shown++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void avi_timer_cb(lv_timer_t *t)
+{
+    avi_player_t *p = t->user_data;
+    int64_t now = esp_timer_get_time();
+    int pick = -1;
+    for (;;)
+    {
+        if (!p->has_next && xQueueReceive(p->ready_q, &p->next, 0) != pdTRUE)
+        {
+            break;
+        }
+        p->has_next = true;
+        if (p->next.idx == UI_AVI_BUFS)
+        {
+            if (pick < 0)
+            {
+                // 放完了 停在最后一帧
+                lv_timer_pause(t);
+                lv_event_send(p->img, LV_EVENT_READY, NULL);
+            }
+            break;
+        }
+        if (avi_due(p, p->next.frame) > now)
+        {
+            break;
+        }
+        // 后面一帧也到点了 前面这帧不显示直接还回去
+        if (pick >= 0)
+        {
+            xQueueSend(p->free_q, &(uint8_t){pick}, 0);
+            portENTER_CRITICAL(&s_lock);
+            s_stats.dropped++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        pick = p->next.idx;
+        p->has_next = false;
+    }
+    if (pick >= 0)
+    {
+        avi_show(p, pick);
+    }
+}
+
+static void avi_delete_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    avi_player_t *p = lv_obj_get_user_data(obj);
+    if (p == NULL)
+    {
+        return;
+    }
+    lv_obj_set_user_data(obj, NULL);
+    lv_timer_del(p->timer);
+    lv_img_cache_invalidate_src(&p->dsc);
+    p->quit = true;
+    avi_put(p);
+}
+
+lv_obj_t *ui_avi_create(lv_obj_t *parent, lv_coord_t max_w, lv_coord_t max_h, const char *path)
+{
+    if (path[0] && path[1] == ':')
+    {
+        path += 2;                      // LVGL盘符 这里直接用stdio
+    }
+    uint32_t w = 0, h = 0, us = 0, movi_pos = 0, movi_end = 0;
+    FILE *f = fopen(path, "rb");
+    bool ok = f && avi_parse(f, &w, &h, &us, &movi_pos, &movi_end) && w && h;
+    if (f)
+    {
+        fclose(f);
+    }
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "%s: not a readable AVI", path);
+        return NULL;
+    }
+    // 按比例缩进框里 不放大 tjpgd要求源图不比输出小
+    uint32_t tw = LV_MIN(w, (uint32_t)max_w);
+    uint32_t th = LV_MAX(h * tw / w, 1);
+    if (th > (uint32_t)max_h)
+    {
+        th = max_h;
+        tw = LV_MAX(w * th / h, 1);
+    }
+
+    avi_player_t *p = calloc(1, sizeof(*p));
+    if (p == NULL)
+    {
+        return NULL;
+    }
+    p->width = tw;
+    p->height = th;
+    p->us_per_frame = us ? us : 66666;  // 没写帧率的按15fps
+    p->movi_pos = movi_pos;
+    p->movi_end = movi_end;
+    p->shown = -1;
+    strlcpy(p->path, path, sizeof(p->path));
+    p->ready_q = xQueueCreate(UI_AVI_BUFS + 1, sizeof(avi_msg_t));
+    p->free_q = xQueueCreate(UI_AVI_BUFS, sizeof(uint8_t));
+    ok = p->ready_q && p->free_q;
+    for (uint8_t i = 0; ok && i < UI_AVI_BUFS; i++)
+    {
+        p->bufs[i] = mem_pool_alloc(MEM_POOL_MEDIA, tw * th * sizeof(lv_color_t));
+        ok = p->bufs[i] != NULL;
+        if (ok)
+        {
+            xQueueSend(p->free_q, &i, 0);
+        }
+    }
+    p->t_start = esp_timer_get_time();
+    p->refs = 2;
+    if (!ok || task_plan_create(TASK_UI_AVI, avi_task, p, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "%s: player start failed", path);
+        p->refs = 1;
+        avi_put(p);
+        return NULL;
+    }
+
+    lv_obj_t *obj = lv_img_create(parent);
+    p->img = obj;
+    p->dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    p->dsc.header.w = tw;
+    p->dsc.header.h = th;
+    p->dsc.data_size = tw * th * sizeof(lv_color_t);
+    p->timer = lv_timer_create(avi_timer_cb, AVI_TIMER_MS, p);
+    lv_obj_set_size(obj, tw, th);
+    lv_obj_set_user_data(obj, p);
+    lv_obj_add_event_cb(obj, avi_delete_cb, LV_EVENT_DELETE, NULL);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.players++;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%s: %lux%lu at %.1f fps, shown at %lux%lu", path, (unsigned long)w, (unsigned long)h,
+             1e6 / p->us_per_frame, (unsigned long)tw, (unsigned long)th);
+    return obj;
+}
+
+void ui_avi_get_stats(ui_avi_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
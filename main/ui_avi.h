@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+
+/*********************** MJPEG AVI播放 ****************************/
+// 控件是一个lv_img core 0上的任务顺着movi读00dc块 用tjpgd解进几块RGB565缓冲 LVGL任务按时间换图
+// 文件用一大块PSRAM做stdio缓冲 SD卡一次读很多 解码不用一帧一帧等卡
+// 时间按打开时刻加帧号乘帧间隔算 解码跟不上时直接跳过已经过点的帧 不会越放越慢
+// 音频块(01wb)现在跳过不放 画面按墙上时钟走 以后加声音也是对这个时钟
+// 放完发LV_EVENT_READY 停在最后一帧
+
+#define UI_AVI_BUFS             3       // 一块在显示 一块在排队 一块在解
+#define UI_AVI_READAHEAD        (CONFIG_APP_AVI_READAHEAD_KB * 1024)
+
+typedef struct {
+    uint32_t players;
+    uint32_t frames;                    // 读到的视频帧
+    uint32_t decoded;
+    uint32_t skipped;                   // 解码前就已经过点 没解直接跳过的
+    uint32_t dropped;                   // 解好了但是下一帧也到点了 没显示的
+    uint32_t shown;
+    uint32_t failed;                    // 解不出来的
+    uint64_t decode_us;
+    uint32_t max_decode_us;
+    uint64_t read_us;                   // 从文件读块花的时间
+    uint64_t bytes;
+} ui_avi_stats_t;
+
+// 在parent里建播放控件 视频按比例缩到不超过max_w x max_h path可以带盘符 不是MJPEG的AVI返回NULL 持有LVGL锁时调用
+lv_obj_t *ui_avi_create(lv_obj_t *parent, lv_coord_t max_w, lv_coord_t max_h, const char *path);
+void ui_avi_get_stats(ui_avi_stats_t *stats);
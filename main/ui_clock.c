@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "ui_clock.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_clock";
+
+#define CLOCK_GLYPHS        11          // 0到9 冒号
+#define CLOCK_COLON         10
+
+typedef struct {
+    char text[UI_CLOCK_CELLS];          // 现在显示的 0表示还没设过
+    lv_color_t color;
+} clock_view_t;
+
+// 字形缓存 只在LVGL任务里用
+static const lv_font_t *s_font;
+static lv_img_dsc_t s_glyph[CLOCK_GLYPHS];
+static lv_coord_t s_digit_w;
+static lv_coord_t s_colon_w;
+static lv_coord_t s_h;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ui_clock_stats_t s_stats;
+
+static inline int glyph_index(char c)
+{
+    return c == ':' ? CLOCK_COLON : c - '0';
+}
+
+static inline bool cell_is_colon(int i)
+{
+    return i == 2 || i == 5;
+}
+
+static lv_coord_t cell_x(int i)
+{
+    // 格子位置是固定的 数字 数字 冒号 数字 数字 冒号 数字 数字
+    return (i - i / 3) * s_digit_w + (i / 3) * s_colon_w;
+}
+
+// 用LVGL自己的文字渲染画一遍 黑底白字的亮度就是A8的透明度
+static bool glyphs_build(const lv_font_t *font)
+{
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < CLOCK_GLYPHS; i++)
+    {
+        free((void *)s_glyph[i].data);
+        s_glyph[i].data = NULL;
+    }
+    s_digit_w = 0;
+    for (char c = '0'; c <= '9'; c++)
+    {
+        lv_coord_t w = lv_font_get_glyph_width(font, c, 0);
+        s_digit_w = w > s_digit_w ? w : s_digit_w;
+    }
+    s_colon_w = lv_font_get_glyph_width(font, ':', 0);
+    s_h = lv_font_get_line_height(font);
+
+    lv_color_t *buf = heap_caps_malloc(LV_CANVAS_BUF_SIZE_TRUE_COLOR(s_digit_w, s_h), MALLOC_CAP_DEFAULT);
+    if (buf == NULL)
+    {
+        return false;
+    }
+    lv_obj_t *canvas = lv_canvas_create(lv_layer_sys());
+    lv_obj_add_flag(canvas, LV_OBJ_FLAG_HIDDEN);
+    lv_draw_label_dsc_t dsc;
+    lv_draw_label_dsc_init(&dsc);
+    dsc.font = font;
+    dsc.color = lv_color_white();
+    uint32_t bytes = 0;
+    bool ok = true;
+    for (int g = 0; g < CLOCK_GLYPHS && ok; g++)
+    {
+        char txt[2] = {g == CLOCK_COLON ? ':' : '0' + g, 0};
+        lv_coord_t w = g == CLOCK_COLON ? s_colon_w : s_digit_w;
+        lv_canvas_set_buffer(canvas, buf, w, s_h, LV_IMG_CF_TRUE_COLOR);
+        lv_canvas_fill_bg(canvas, lv_color_black(), LV_OPA_COVER);
+        // 窄的数字在格子里居中
+        lv_canvas_draw_text(canvas, (w - lv_font_get_glyph_width(font, txt[0], 0)) / 2, 0, w, &dsc, txt);
+        uint8_t *a8 = malloc(w * s_h);
+        if (a8 == NULL)
+        {
+            ok = false;
+            break;
+        }
+        for (int i = 0; i < w * s_h; i++)
+        {
+            a8[i] = lv_color_brightness(buf[i]);
+        }
+        s_glyph[g] = (lv_img_dsc_t){
+            .header.cf = LV_IMG_CF_ALPHA_8BIT,
+            .header.w = w,
+            .header.h = s_h,
+            .data_size = w * s_h,
+            .data = a8,
+        };
+        bytes += w * s_h;
+    }
+    lv_obj_del(canvas);
+    heap_caps_free(buf);
+    if (!ok)
+    {
+        return false;
+    }
+    s_font = font;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.cache_bytes = bytes;
+    s_stats.cache_us = esp_timer_get_time() - t0;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "glyphs %dx%d (colon %d), %lu bytes", s_digit_w, s_h, s_colon_w, (unsigned long)bytes);
+    return true;
+}
+
+static void cell_area(lv_obj_t *obj, int i, lv_area_t *area)
+{
+    lv_obj_get_coords(obj, area);
+    area->x1 += cell_x(i);
+    area->x2 = area->x1 + (cell_is_colon(i) ? s_colon_w : s_digit_w) - 1;
+    area->y2 = area->y1 + s_h - 1;
+}
+
+static void clock_event_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    clock_view_t *v = lv_obj_get_user_data(obj);
+    if (lv_event_get_code(e) == LV_EVENT_DELETE)
+    {
+        free(v);
+        return;
+    }
+    // LV_EVENT_DRAW_MAIN 只画和这次刷新区域相交的格子
+    int64_t t0 = esp_timer_get_time();
+    lv_draw_ctx_t *ctx = lv_event_get_draw_ctx(e);
+    lv_draw_img_dsc_t dsc;
+    lv_draw_img_dsc_init(&dsc);
+    dsc.recolor = v->color; // A8图片用这个颜色
+    int drawn = 0;
+    for (int i = 0; i < UI_CLOCK_CELLS; i++)
+    {
+        lv_area_t area, clip;
+        cell_area(obj, i, &area);
+        if (v->text[i] == 0 || !_lv_area_intersect(&clip, &area, ctx->clip_area))
+        {
+            continue;
+        }
+        lv_draw_img(ctx, &dsc, &area, &s_glyph[glyph_index(v->text[i])]);
+        drawn++;
+    }
+    if (drawn)
+    {
+        uint32_t us = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.draws += drawn;
+        s_stats.draw_us += us;
+        s_stats.draw_max_us = us > s_stats.draw_max_us ? us : s_stats.draw_max_us;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+lv_obj_t *ui_clock_create(lv_obj_t *parent, const lv_font_t *font)
+{
+    if (font != s_font && !glyphs_build(font))
+    {
+        ESP_LOGE(TAG, "no memory for glyphs");
+        return NULL;
+    }
+    clock_view_t *v = calloc(1, sizeof(*v));
+    if (v == NULL)
+    {
+        return NULL;
+    }
+    v->color = lv_color_white();
+    lv_obj_t *obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(obj); // 没有背景 边框 只画字形
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(obj, cell_x(UI_CLOCK_CELLS), s_h);
+    lv_obj_set_user_data(obj, v);
+    lv_obj_add_event_cb(obj, clock_event_cb, LV_EVENT_DRAW_MAIN, NULL);
+    lv_obj_add_event_cb(obj, clock_event_cb, LV_EVENT_DELETE, NULL);
+    return obj;
+}
+
+void ui_clock_set(lv_obj_t *clock, const struct tm *tm)
+{
+    clock_view_t *v = lv_obj_get_user_data(clock);
+    char text[UI_CLOCK_CELLS + 1];
+    snprintf(text, sizeof(text), "%02u:%02u:%02u", (unsigned)tm->tm_hour % 100, (unsigned)tm->tm_min % 100,
+             (unsigned)tm->tm_sec % 100);
+    uint32_t cells = 0, px = 0;
+    for (int i = 0; i < UI_CLOCK_CELLS; i++)
+    {
+        if (text[i] == v->text[i])
+        {
+            continue;
+        }
+        v->text[i] = text[i];
+        lv_area_t area;
+        cell_area(clock, i, &area);
+        lv_obj_invalidate_area(clock, &area);
+        cells++;
+        px += lv_area_get_size(&area);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.updates++;
+    s_stats.cells += cells;
+    s_stats.px += px;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ui_clock_set_color(lv_obj_t *clock, lv_color_t color)
+{
+    clock_view_t *v = lv_obj_get_user_data(clock);
+    if (lv_color_to32(v->color) == lv_color_to32(color))
+    {
+        return;
+    }
+    v->color = color;
+    lv_obj_invalidate(clock);
+    lv_area_t area;
+    lv_obj_get_coords(clock, &area);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.cells += UI_CLOCK_CELLS;
+    s_stats.px += lv_area_get_size(&area);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ui_clock_get_stats(ui_clock_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
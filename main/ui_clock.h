@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "lvgl.h"
+
+
+/*********************** 主页时钟 ****************************/
+// "时:分:秒"八个字符 每个字符一个固定宽度的格子 数字用最宽的那个的宽度 位置不会随数字变
+// 建控件时把0到9和冒号用同一个字体画一遍 转成A8的图片存起来 以后画的时候直接贴 不再排版和查字形
+// 每秒只把变了的格子标脏 一般只有秒的个位 一个12x22的小块 日期交给调用方 过零点才改
+
+#define UI_CLOCK_CELLS          8       // HH:MM:SS
+
+typedef struct {
+    uint32_t updates;                   // ui_clock_set的次数
+    uint32_t cells;                     // 标脏的格子 整个重画算8个
+    uint64_t px;                        // 标脏的像素
+    uint32_t draws;                     // 画格子的次数 一次刷新里可能画好几个
+    uint64_t draw_us;
+    uint32_t draw_max_us;
+    uint32_t cache_bytes;               // 字形图片
+    uint32_t cache_us;                  // 画字形花的时间 只有一次
+} ui_clock_stats_t;
+
+// 持有LVGL锁时调用 font第一次用时画字形 返回的控件大小固定
+lv_obj_t *ui_clock_create(lv_obj_t *parent, const lv_font_t *font);
+void ui_clock_set(lv_obj_t *clock, const struct tm *tm);
+void ui_clock_set_color(lv_obj_t *clock, lv_color_t color);  // 和现在一样就什么都不做
+void ui_clock_get_stats(ui_clock_stats_t *stats);
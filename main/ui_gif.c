@@ -0,0 +1,591 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "ui_gif.h"
+#include "task_plan.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "src/extra/libs/gif/gifdec.h"
+
+static const char *TAG = "ui_gif";
+
+#define GIF_CACHE_BUDGET    ((uint32_t)CONFIG_APP_GIF_CACHE_KB * 1024)
+#define GIF_FILE_MAX        (4 * 1024 * 1024)
+#define GIF_PATH_LEN        160
+#define GIF_READY_DEPTH     4
+#define GIF_POLL_MS         50          // 解码任务等队列时隔这么久看一眼控件是不是已经删了
+#define GIF_MIN_DELAY_MS    10          // 和lv_gif一样 延时为0的帧按定时器周期放
+#define GIF_STATS_MS        1000
+
+enum {
+    GIF_MSG_FRAME,
+    GIF_MSG_STREAM,                     // 缓存不下了 之后的帧显示完要还缓冲
+    GIF_MSG_DONE,                       // 第一遍放完 帧都在缓存里了
+    GIF_MSG_END,                        // 放完或者出错 停在当前帧
+};
+
+typedef struct {
+    uint8_t type;
+    uint16_t value;                     // FRAME是延时ms DONE是还要放几遍 0一直循环
+    uint8_t *buf;
+    lv_area_t dirty;                    // 相对图片左上角
+} gif_msg_t;
+
+typedef struct {
+    uint8_t *buf;
+    lv_area_t dirty;
+    uint16_t delay_ms;
+} gif_frame_t;
+
+typedef struct {
+    // 两边共用
+    volatile bool quit;                 // 控件删了 解码任务尽快退出
+    uint8_t refs;                       // 控件和解码任务各一份 最后放手的一方释放
+    QueueHandle_t ready_q;              // 解码任务 -> LVGL
+    QueueHandle_t free_q;               // LVGL -> 解码任务 边解边放时显示完的缓冲
+    uint8_t **bufs;                     // 解码任务分配的所有帧缓冲 只有它往里加
+    uint16_t buf_count;
+    uint16_t buf_cap;
+    uint16_t cache_max;                 // 预算内最多缓存几帧 0表示一开始就边解边放
+    uint16_t width;
+    uint16_t height;
+    uint32_t frame_bytes;
+    uint32_t cache_bytes;
+    uint64_t decode_us;
+    char path[GIF_PATH_LEN];
+    // 只在解码任务里用
+    uint8_t *file;
+    gd_GIF *gif;
+    // 只在LVGL任务里用
+    lv_obj_t *img;
+    lv_img_dsc_t dsc;
+    lv_timer_t *timer;
+    gif_frame_t *frames;                // 缓存模式下收到的帧
+    uint16_t count;
+    uint16_t index;
+    uint16_t plays_left;
+    uint16_t delay_ms;
+    bool cached;
+    bool stream;
+    bool waiting;                       // 这一帧已经记过一次late
+    uint32_t last_show;
+    uint32_t win_start;
+    uint32_t win_shown;
+    uint64_t win_decode_us;
+} gif_player_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ui_gif_stats_t s_stats;
+
+static void gif_put(gif_player_t *p)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool last = --p->refs == 0;
+    if (last)
+    {
+        s_stats.cache_bytes -= p->cache_bytes;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!last)
+    {
+        return;
+    }
+    for (int i = 0; i < p->buf_count; i++)
+    {
+        heap_caps_free(p->bufs[i]);
+    }
+    free(p->bufs);
+    free(p->frames);
+    if (p->ready_q)
+    {
+        vQueueDelete(p->ready_q);
+    }
+    if (p->free_q)
+    {
+        vQueueDelete(p->free_q);
+    }
+    free(p);
+}
+
+/************ 解码任务 ************/
+static bool gif_post(gif_player_t *p, const gif_msg_t *msg)
+{
+    while (!p->quit)
+    {
+        if (xQueueSend(p->ready_q, msg, pdMS_TO_TICKS(GIF_POLL_MS)) == pdTRUE)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint8_t *gif_alloc_buf(gif_player_t *p)
+{
+    uint8_t *buf = heap_caps_malloc(p->frame_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buf)
+    {
+        p->bufs[p->buf_count++] = buf;
+    }
+    return buf;
+}
+
+// 缓存模式每帧一块新的 放不下就通知LVGL那边把显示过的还回来 之后轮流用
+static uint8_t *gif_get_buf(gif_player_t *p, bool *stream)
+{
+    uint8_t *buf = NULL;
+    if (!*stream)
+    {
+        if (p->buf_count < p->cache_max && (buf = gif_alloc_buf(p)) != NULL)
+        {
+            return buf;
+        }
+        *stream = true;
+        ESP_LOGI(TAG, "%s: %u frames do not fit in %lu KB, streaming", p->path, p->buf_count + 1,
+                 (unsigned long)GIF_CACHE_BUDGET / 1024);
+        gif_msg_t msg = {.type = GIF_MSG_STREAM};
+        if (!gif_post(p, &msg))
+        {
+            return NULL;
+        }
+    }
+    if (p->buf_count < UI_GIF_STREAM_BUFS && (buf = gif_alloc_buf(p)) != NULL)
+    {
+        return buf;
+    }
+    if (p->buf_count < 2)
+    {
+        return NULL;                    // 至少一块显示一块解 不然就互相等
+    }
+    while (!p->quit)
+    {
+        if (xQueueReceive(p->free_q, &buf, pdMS_TO_TICKS(GIF_POLL_MS)) == pdTRUE)
+        {
+            return buf;
+        }
+    }
+    return NULL;
+}
+
+// 整个文件读进PSRAM 之后gifdec从内存读 不经过lv_fs
+// gifdec自己的内存走lv_mem_alloc 这里LV_MEM_CUSTOM是malloc 不用LVGL锁
+static bool gif_load(gif_player_t *p)
+{
+    if (p->file)
+    {
+        p->gif = gd_open_gif_data(p->file);    // ui_gif_set_src_data给的 已经在内存里了
+        return p->gif && p->gif->width == p->width && p->gif->height == p->height;
+    }
+    FILE *f = fopen(p->path, "rb");
+    struct stat st;
+    bool ok = f && fstat(fileno(f), &st) == 0 && st.st_size > 13 && st.st_size <= GIF_FILE_MAX;
+    p->file = ok ? heap_caps_malloc(st.st_size + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    ok = p->file && fread(p->file, 1, st.st_size, f) == (size_t)st.st_size;
+    if (f)
+    {
+        fclose(f);
+    }
+    if (!ok)
+    {
+        return false;
+    }
+    p->file[st.st_size] = ';';          // 文件截断在两帧之间时gifdec读到它就当动画结束
+    p->gif = gd_open_gif_data(p->file);
+    return p->gif && p->gif->width == p->width && p->gif->height == p->height;
+}
+
+static void gif_decode(gif_player_t *p)
+{
+    gd_GIF *gif = p->gif;
+    bool stream = p->cache_max == 0;
+    uint32_t n = 0;
+    lv_area_t prev = {0};
+    gif_msg_t msg;
+    while (!p->quit)
+    {
+        int64_t t0 = esp_timer_get_time();
+        uint32_t pos = gif->f_rw_p;
+        int res = gd_get_frame(gif);
+        // 一直循环的GIF读到结尾gifdec自己跳回开头 读指针变小了就是又从第一帧开始了
+        bool wrapped = res > 0 && gif->f_rw_p < pos;
+        if (res <= 0)
+        {
+            if (res < 0)
+            {
+                ESP_LOGW(TAG, "%s: bad frame %lu", p->path, (unsigned long)n);
+            }
+            msg = (gif_msg_t){.type = GIF_MSG_END};
+            gif_post(p, &msg);
+            return;
+        }
+        if (wrapped && !stream)
+        {
+            p->cache_bytes = p->buf_count * p->frame_bytes;
+            portENTER_CRITICAL(&s_lock);
+            s_stats.cached++;
+            s_stats.cache_bytes += p->cache_bytes;
+            portEXIT_CRITICAL(&s_lock);
+            ESP_LOGI(TAG, "%s: %u frames cached, %lu KB", p->path, p->buf_count, (unsigned long)p->cache_bytes / 1024);
+            msg = (gif_msg_t){.type = GIF_MSG_DONE, .value = gif->loop_count > 0 ? gif->loop_count : 0};
+            gif_post(p, &msg);
+            return;
+        }
+        // 上一帧的处置(恢复背景之类)改的是上一帧的矩形 加上这一帧自己的
+        lv_area_t cur = {gif->fx, gif->fy, gif->fx + gif->fw - 1, gif->fy + gif->fh - 1};
+        lv_area_t dirty = {0, 0, p->width - 1, p->height - 1};
+        if (n > 0 && !wrapped)
+        {
+            _lv_area_join(&dirty, &prev, &cur);
+        }
+        prev = cur;
+        gd_render_frame(gif, gif->canvas);
+        int64_t us = esp_timer_get_time() - t0;
+
+        bool was_stream = stream;
+        uint8_t *buf = gif_get_buf(p, &stream);
+        if (buf == NULL)
+        {
+            msg = (gif_msg_t){.type = GIF_MSG_END};
+            gif_post(p, &msg);
+            return;
+        }
+        if (stream && !was_stream)
+        {
+            portENTER_CRITICAL(&s_lock);
+            s_stats.streamed++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        t0 = esp_timer_get_time();
+        memcpy(buf, gif->canvas, p->frame_bytes);
+        us += esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.decoded++;
+        s_stats.decode_us += us;
+        p->decode_us += us;
+        portEXIT_CRITICAL(&s_lock);
+
+        msg = (gif_msg_t){.type = GIF_MSG_FRAME, .value = gif->gce.delay * 10, .buf = buf, .dirty = dirty};
+        if (!gif_post(p, &msg))
+        {
+            return;
+        }
+        n++;
+    }
+}
+
+static void gif_task(void *arg)
+{
+    gif_player_t *p = arg;
+    if (gif_load(p))
+    {
+        gif_decode(p);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "%s: not a readable GIF89a", p->path);
+        gif_msg_t msg = {.type = GIF_MSG_END};
+        gif_post(p, &msg);
+    }
+    if (p->gif)
+    {
+        gd_close_gif(p->gif);
+    }
+    heap_caps_free(p->file);
+    gif_put(p);
+    vTaskDelete(NULL);
+}
+
+/************ LVGL任务 ************/
+static void gif_show(gif_player_t *p, const gif_frame_t *f)
+{
+    bool first = p->dsc.data == NULL;
+    p->dsc.data = f->buf;
+    p->delay_ms = LV_MAX(f->delay_ms, GIF_MIN_DELAY_MS);
+    p->last_show = lv_tick_get();
+    p->waiting = false;
+    lv_img_cache_invalidate_src(&p->dsc);
+    if (first)
+    {
+        lv_img_set_src(p->img, &p->dsc);
+    }
+    else
+    {
+        lv_area_t a = f->dirty;
+        lv_area_move(&a, p->img->coords.x1, p->img->coords.y1);
+        lv_obj_invalidate_area(p->img, &a);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.shown++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void gif_stop(gif_player_t *p)
+{
+    lv_timer_pause(p->timer);
+    lv_event_send(p->img, LV_EVENT_READY, NULL);
+}
+
+// 缓存的帧里按顺序往下走 回到第一帧时整张刷新
+static void gif_next_cached(gif_player_t *p)
+{
+    if (++p->index >= p->count)
+    {
+        if (p->plays_left == 1)
+        {
+            gif_stop(p);
+            return;
+        }
+        if (p->plays_left > 1)
+        {
+            p->plays_left--;
+        }
+        p->index = 0;
+    }
+    gif_frame_t f = p->frames[p->index];
+    if (p->index == 0)
+    {
+        f.dirty = (lv_area_t){0, 0, p->width - 1, p->height - 1};
+    }
+    gif_show(p, &f);
+}
+
+// 转成边解边放 显示过的缓冲除了正在显示的都还给解码任务
+static void gif_release_shown(gif_player_t *p)
+{
+    for (int i = 0; i < p->count; i++)
+    {
+        if (p->frames[i].buf != p->dsc.data)
+        {
+            xQueueSend(p->free_q, &p->frames[i].buf, 0);
+        }
+    }
+    p->count = 0;
+    p->stream = true;
+}
+
+static void gif_window(gif_player_t *p)
+{
+    uint32_t elaps = lv_tick_elaps(p->win_start);
+    if (elaps < GIF_STATS_MS)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    uint64_t us = p->decode_us;
+    uint32_t shown = s_stats.shown;
+    s_stats.fps = (shown - p->win_shown) * 1000.0f / elaps;
+    s_stats.cpu = (us - p->win_decode_us) / (elaps * 10.0f);
+    portEXIT_CRITICAL(&s_lock);
+    p->win_start = lv_tick_get();
+    p->win_shown = shown;
+    p->win_decode_us = us;
+}
+
+static void gif_timer_cb(lv_timer_t *t)
+{
+    gif_player_t *p = t->user_data;
+    gif_window(p);
+    if (p->dsc.data && lv_tick_elaps(p->last_show) < p->delay_ms)
+    {
+        return;
+    }
+    if (p->cached)
+    {
+        gif_next_cached(p);
+        return;
+    }
+    gif_msg_t msg;
+    while (xQueueReceive(p->ready_q, &msg, 0) == pdTRUE)
+    {
+        if (msg.type == GIF_MSG_STREAM)
+        {
+            gif_release_shown(p);
+            continue;
+        }
+        if (msg.type == GIF_MSG_END)
+        {
+            gif_stop(p);
+            return;
+        }
+        if (msg.type == GIF_MSG_DONE)
+        {
+            p->cached = true;
+            p->plays_left = msg.value;
+            p->index = 0;
+            if (p->count == 1)
+            {
+                lv_timer_pause(t);      // 只有一帧 不用再动了
+                return;
+            }
+            gif_frame_t f = p->frames[0];
+            f.dirty = (lv_area_t){0, 0, p->width - 1, p->height - 1};
+            gif_show(p, &f);
+            return;
+        }
+        uint8_t *old = (uint8_t *)p->dsc.data;
+        gif_frame_t f = {.buf = msg.buf, .dirty = msg.dirty, .delay_ms = msg.value};
+        if (!p->stream)
+        {
+            p->frames[p->count++] = f;
+        }
+        else if (old)
+        {
+            xQueueSend(p->free_q, &old, 0);
+        }
+        gif_show(p, &f);
+        return;
+    }
+    if (p->dsc.data && !p->waiting)
+    {
+        p->waiting = true;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.late++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static void gif_detach(lv_obj_t *obj)
+{
+    gif_player_t *p = lv_obj_get_user_data(obj);
+    if (p == NULL)
+    {
+        return;
+    }
+    lv_obj_set_user_data(obj, NULL);
+    lv_timer_del(p->timer);
+    lv_img_cache_invalidate_src(&p->dsc);
+    p->quit = true;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.fps = 0;
+    s_stats.cpu = 0;
+    portEXIT_CRITICAL(&s_lock);
+    gif_put(p);
+}
+
+static void gif_delete_cb(lv_event_t *e)
+{
+    gif_detach(lv_event_get_target(e));
+}
+
+lv_obj_t *ui_gif_create(lv_obj_t *parent)
+{
+    lv_obj_t *obj = lv_img_create(parent);
+    lv_obj_set_user_data(obj, NULL);
+    lv_obj_add_event_cb(obj, gif_delete_cb, LV_EVENT_DELETE, NULL);
+    return obj;
+}
+
+// 尺寸已经从文件头拿到 file不为NULL时是调用者读好的整个文件 交给解码任务释放
+static bool gif_start(lv_obj_t *obj, uint16_t w, uint16_t h, const char *path, uint8_t *file)
+{
+    gif_player_t *p = calloc(1, sizeof(*p));
+    if (p == NULL)
+    {
+        heap_caps_free(file);
+        return false;
+    }
+    p->width = w;
+    p->height = h;
+    p->file = file;
+    p->frame_bytes = (uint32_t)w * h * LV_IMG_PX_SIZE_ALPHA_BYTE;
+    uint32_t fit = GIF_CACHE_BUDGET / p->frame_bytes;
+    p->cache_max = fit < 2 ? 0 : LV_MIN(fit, UINT16_MAX);
+    p->stream = p->cache_max == 0;
+    p->buf_cap = LV_MAX(p->cache_max, UI_GIF_STREAM_BUFS);
+    p->bufs = calloc(p->buf_cap, sizeof(*p->bufs));
+    p->frames = calloc(LV_MAX(p->cache_max, 1), sizeof(*p->frames));
+    p->ready_q = xQueueCreate(GIF_READY_DEPTH, sizeof(gif_msg_t));
+    p->free_q = xQueueCreate(p->buf_cap, sizeof(uint8_t *));
+    strlcpy(p->path, path, sizeof(p->path));
+    p->refs = 2;
+    if (p->bufs == NULL || p->frames == NULL || p->ready_q == NULL || p->free_q == NULL ||
+        task_plan_create(TASK_UI_GIF, gif_task, p, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "%s: player start failed", path);
+        heap_caps_free(p->file);
+        p->refs = 1;
+        gif_put(p);
+        return false;
+    }
+
+    p->img = obj;
+    p->dsc.header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+    p->dsc.header.w = w;
+    p->dsc.header.h = h;
+    p->dsc.data_size = p->frame_bytes;
+    p->timer = lv_timer_create(gif_timer_cb, GIF_MIN_DELAY_MS, p);
+    p->win_start = lv_tick_get();
+    lv_obj_set_size(obj, w, h);
+    lv_obj_set_user_data(obj, p);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.players++;
+    p->win_shown = s_stats.shown;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+bool ui_gif_set_src(lv_obj_t *obj, const char *path)
+{
+    if (lv_obj_get_user_data(obj))
+    {
+        lv_img_set_src(obj, NULL);      // 旧的描述符跟着播放器一起释放
+        gif_detach(obj);
+    }
+    if (path[0] && path[1] == ':')
+    {
+        path += 2;                      // LVGL盘符 这里直接用stdio
+    }
+    // 先只读文件头 拿到尺寸控件马上能排版 整个文件由解码任务去读
+    uint8_t hdr[10];
+    FILE *f = fopen(path, "rb");
+    bool ok = f && fread(hdr, 1, sizeof(hdr), f) == sizeof(hdr) && memcmp(hdr, "GIF89a", 6) == 0;
+    if (f)
+    {
+        fclose(f);
+    }
+    uint16_t w = ok ? hdr[6] | (hdr[7] << 8) : 0;
+    uint16_t h = ok ? hdr[8] | (hdr[9] << 8) : 0;
+    if (w == 0 || h == 0)
+    {
+        ESP_LOGW(TAG, "%s: not a GIF89a file", path);
+        return false;
+    }
+    return gif_start(obj, w, h, path, NULL);
+}
+
+bool ui_gif_set_src_data(lv_obj_t *obj, const uint8_t *data, size_t len, const char *name)
+{
+    if (lv_obj_get_user_data(obj))
+    {
+        lv_img_set_src(obj, NULL);
+        gif_detach(obj);
+    }
+    uint16_t w = len > 13 ? data[6] | (data[7] << 8) : 0;
+    uint16_t h = len > 13 ? data[8] | (data[9] << 8) : 0;
+    if (w == 0 || h == 0 || len > GIF_FILE_MAX || memcmp(data, "GIF89a", 6) != 0)
+    {
+        ESP_LOGW(TAG, "%s: not a GIF89a file", name);
+        return false;
+    }
+    uint8_t *file = heap_caps_malloc(len + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (file == NULL)
+    {
+        return false;
+    }
+    memcpy(file, data, len);
+    file[len] = ';';                    // 和gif_load一样 截断的当动画结束
+    return gif_start(obj, w, h, name, file);
+}
+
+void ui_gif_get_stats(ui_gif_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** GIF播放 ****************************/
+// 代替lv_gif 控件就是一个lv_img 每个GIF一个core 0上的解码任务做LZW 整个文件先读进PSRAM
+// 第一遍播放时每帧合成好的画面留在PSRAM 之后循环直接换指针 解码任务退出
+// 整个动画放不进CONFIG_APP_GIF_CACHE_KB就边解边放 几块缓冲轮流用
+// 换帧时只刷新上一帧和这一帧矩形的并集 不是整个控件
+// GIF自己规定的循环次数放完后发LV_EVENT_READY 和lv_gif一样
+
+#define UI_GIF_STREAM_BUFS      3       // 边解边放时的缓冲块数 一块在显示 一块在排队 一块在解
+
+typedef struct {
+    uint32_t players;                   // 打开过的GIF
+    uint32_t decoded;                   // 解出来的帧
+    uint64_t decode_us;                 // 解码任务里LZW和合成的累计时间
+    uint32_t shown;                     // 显示过的帧
+    uint32_t late;                      // 到点了下一帧还没解好
+    uint32_t cached;                    // 整个缓存下来的动画
+    uint32_t streamed;                  // 缓存不下 边解边放的
+    uint32_t cache_bytes;               // 现在缓存的帧占的PSRAM
+    float fps;                          // 最近一秒的实际帧率
+    float cpu;                          // 最近一秒解码占core 0的百分比
+} ui_gif_stats_t;
+
+lv_obj_t *ui_gif_create(lv_obj_t *parent);
+// path可以带"A:"盘符 打不开或不是GIF返回false 持有LVGL锁时调用
+bool ui_gif_set_src(lv_obj_t *obj, const char *path);
+// 整个文件已经在内存里(比如网上下载的) 复制一份交给解码任务 name只用来打日志
+bool ui_gif_set_src_data(lv_obj_t *obj, const uint8_t *data, size_t len, const char *name);
+void ui_gif_get_stats(ui_gif_stats_t *stats);
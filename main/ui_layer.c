@@ -0,0 +1,327 @@
+#include <string.h>
+#include "ui_layer.h"
+#include "ui_perf.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "ui_layer";
+
+#if CONFIG_APP_UI_LAYER_CACHE
+#define LAYER_CACHE     1
+#else
+#define LAYER_CACHE     0
+#endif
+
+typedef struct {
+    lv_obj_t *obj;
+    lv_img_dsc_t dsc;                   // data为NULL表示还没画快照
+    lv_coord_t ext;                     // 阴影超出对象的部分 快照比对象大这么多
+    bool swapped;                       // 这次滚动画的是快照
+} ui_layer_t;
+
+static ui_layer_t s_layers[UI_LAYER_MAX];
+static int s_count;
+static lv_timer_t *s_prepare_timer;
+static struct {
+    lv_obj_t *parent;                   // 正在滚动的容器
+    bool cached;
+    int64_t t0;
+    uint32_t frames;
+    uint64_t render_us;
+} s_scroll;
+static ui_layer_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static ui_layer_t *layer_find(lv_obj_t *obj)
+{
+    for (int i = 0; i < s_count; i++)
+    {
+        if (s_layers[i].obj == obj)
+        {
+            return &s_layers[i];
+        }
+    }
+    return NULL;
+}
+
+static void layer_drop(ui_layer_t *l)
+{
+    if (l->dsc.data)
+    {
+        lv_img_cache_invalidate_src(&l->dsc);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.bytes -= l->dsc.data_size;
+        portEXIT_CRITICAL(&s_lock);
+        heap_caps_free((void *)l->dsc.data);
+        l->dsc.data = NULL;
+    }
+}
+
+// 快照是ARGB8565 转成RGB565A8 画的时候LVGL直接按透明度混合 不用逐像素拆
+static bool layer_snapshot(ui_layer_t *l)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint32_t size = lv_snapshot_buf_size_needed(l->obj, LV_IMG_CF_TRUE_COLOR_ALPHA);
+    uint8_t *argb = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    uint8_t *buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    lv_img_dsc_t dsc;
+    if (argb == NULL || buf == NULL || lv_snapshot_take_to_buf(l->obj, LV_IMG_CF_TRUE_COLOR_ALPHA, &dsc, argb, size) != LV_RES_OK)
+    {
+        heap_caps_free(argb);
+        heap_caps_free(buf);
+        ESP_LOGW(TAG, "snapshot of %lu bytes failed", (unsigned long)size);
+        return false;
+    }
+    uint32_t n = (uint32_t)dsc.header.w * dsc.header.h;
+    lv_color_t *color = (lv_color_t *)buf;
+    lv_opa_t *alpha = buf + n * sizeof(lv_color_t);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const uint8_t *px = argb + i * LV_IMG_PX_SIZE_ALPHA_BYTE;
+        color[i].full = px[0] | (px[1] << 8);
+        alpha[i] = px[2];
+    }
+    heap_caps_free(argb);
+
+    l->ext = _lv_obj_get_ext_draw_size(l->obj);
+    l->dsc = dsc;
+    l->dsc.header.cf = LV_IMG_CF_RGB565A8;
+    l->dsc.data = buf;
+    l->dsc.data_size = size;
+    lv_img_cache_invalidate_src(&l->dsc);
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.snapshots++;
+    s_stats.snapshot_us += us;
+    s_stats.bytes += size;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+// 按下或者有焦点时的样子不能当快照
+static bool layer_ready(ui_layer_t *l)
+{
+    return l->dsc.data || (lv_obj_get_state(l->obj) == LV_STATE_DEFAULT && layer_snapshot(l));
+}
+
+static void layer_prepare_cb(lv_timer_t *t)
+{
+    s_prepare_timer = NULL;
+    if (s_scroll.parent)
+    {
+        return; // 滚动开始时会补上
+    }
+    int64_t t0 = esp_timer_get_time();
+    int made = 0;
+    for (int i = 0; i < s_count; i++)
+    {
+        if (s_layers[i].dsc.data == NULL && layer_ready(&s_layers[i]))
+        {
+            made++;
+        }
+    }
+    if (made)
+    {
+        ESP_LOGI(TAG, "%d snapshots in %lu us, %lu KB in PSRAM", made, (unsigned long)(esp_timer_get_time() - t0),
+                 (unsigned long)s_stats.bytes / 1024);
+    }
+}
+
+static void layer_prepare_later(void)
+{
+    if (LAYER_CACHE && s_prepare_timer == NULL)
+    {
+        s_prepare_timer = lv_timer_create(layer_prepare_cb, UI_LAYER_PREPARE_MS, NULL);
+        lv_timer_set_repeat_count(s_prepare_timer, 1);
+    }
+}
+
+static void layer_set_swapped(ui_layer_t *l, bool on)
+{
+    l->swapped = on;
+    if (on)
+    {
+        lv_obj_set_style_opa(l->obj, LV_OPA_TRANSP, 0);
+    }
+    else
+    {
+        lv_obj_remove_local_style_prop(l->obj, LV_STYLE_OPA, 0);
+    }
+}
+
+static void layer_swap(lv_obj_t *parent, bool on)
+{
+    for (int i = 0; i < s_count; i++)
+    {
+        ui_layer_t *l = &s_layers[i];
+        if (lv_obj_get_parent(l->obj) != parent || l->swapped == on)
+        {
+            continue;
+        }
+        if (on && !layer_ready(l))
+        {
+            continue; // 这个这次照常画
+        }
+        layer_set_swapped(l, on);
+    }
+}
+
+static void scroll_begin(lv_obj_t *parent)
+{
+    if (s_scroll.parent)
+    {
+        return; // 拖动以后接着的惯性和吸附动画还算同一次
+    }
+    s_scroll.parent = parent;
+    s_scroll.cached = LAYER_CACHE;
+    s_scroll.t0 = esp_timer_get_time();
+    ui_perf_get_totals(&s_scroll.frames, &s_scroll.render_us);
+    if (s_scroll.cached)
+    {
+        layer_swap(parent, true);
+    }
+}
+
+static void scroll_end(lv_obj_t *parent)
+{
+    // 松手时惯性停了就发SCROLL_END 吸附动画才刚开始 等动画完了那次
+    if (s_scroll.parent != parent || lv_obj_is_scrolling(parent) || lv_anim_get(parent, NULL))
+    {
+        return;
+    }
+    if (s_scroll.cached)
+    {
+        layer_swap(parent, false);
+    }
+    uint32_t frames;
+    uint64_t render_us;
+    ui_perf_get_totals(&frames, &render_us);
+    int k = s_scroll.cached;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.scrolls[k]++;
+    s_stats.frames[k] += frames - s_scroll.frames;
+    s_stats.scroll_us[k] += esp_timer_get_time() - s_scroll.t0;
+    s_stats.render_us[k] += render_us - s_scroll.render_us;
+    portEXIT_CRITICAL(&s_lock);
+    s_scroll.parent = NULL;
+}
+
+// 容器的背景画完 子对象还没画 快照放在原对象的位置
+static void parent_draw_cb(lv_event_t *e)
+{
+    lv_obj_t *parent = lv_event_get_current_target(e);
+    if (s_scroll.parent != parent || !s_scroll.cached)
+    {
+        return;
+    }
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_draw_img_dsc_t dsc;
+    lv_draw_img_dsc_init(&dsc);
+    for (int i = 0; i < s_count; i++)
+    {
+        ui_layer_t *l = &s_layers[i];
+        if (!l->swapped || lv_obj_get_parent(l->obj) != parent)
+        {
+            continue;
+        }
+        lv_area_t a = l->obj->coords;
+        lv_area_increase(&a, l->ext, l->ext);
+        lv_area_t clip;
+        if (_lv_area_intersect(&clip, &a, draw_ctx->clip_area))
+        {
+            lv_draw_img(draw_ctx, &dsc, &a, &l->dsc);
+        }
+    }
+}
+
+static void parent_scroll_cb(lv_event_t *e)
+{
+    lv_obj_t *parent = lv_event_get_current_target(e);
+    if (lv_event_get_target(e) != parent)
+    {
+        return; // 里面别的可滚动的子对象冒上来的
+    }
+    if (lv_event_get_code(e) == LV_EVENT_SCROLL_BEGIN)
+    {
+        scroll_begin(parent);
+    }
+    else
+    {
+        scroll_end(parent);
+    }
+}
+
+static void parent_delete_cb(lv_event_t *e)
+{
+    if (s_scroll.parent == lv_event_get_target(e))
+    {
+        s_scroll.parent = NULL;
+    }
+}
+
+static void layer_delete_cb(lv_event_t *e)
+{
+    ui_layer_t *l = layer_find(lv_event_get_target(e));
+    if (l == NULL)
+    {
+        return;
+    }
+    layer_drop(l);
+    *l = s_layers[--s_count];
+    portENTER_CRITICAL(&s_lock);
+    s_stats.layers = s_count;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ui_layer_add(lv_obj_t *obj)
+{
+    lv_obj_t *parent = lv_obj_get_parent(obj);
+    if (parent == NULL || layer_find(obj) || s_count >= UI_LAYER_MAX)
+    {
+        return;
+    }
+    bool first = true;
+    for (int i = 0; i < s_count; i++)
+    {
+        first &= lv_obj_get_parent(s_layers[i].obj) != parent;
+    }
+    if (first)
+    {
+        lv_obj_add_event_cb(parent, parent_scroll_cb, LV_EVENT_SCROLL_BEGIN, NULL);
+        lv_obj_add_event_cb(parent, parent_scroll_cb, LV_EVENT_SCROLL_END, NULL);
+        lv_obj_add_event_cb(parent, parent_draw_cb, LV_EVENT_DRAW_MAIN_END, NULL);
+        lv_obj_add_event_cb(parent, parent_delete_cb, LV_EVENT_DELETE, NULL);
+    }
+    memset(&s_layers[s_count], 0, sizeof(s_layers[0]));
+    s_layers[s_count++].obj = obj;
+    lv_obj_add_event_cb(obj, layer_delete_cb, LV_EVENT_DELETE, NULL);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.layers = s_count;
+    portEXIT_CRITICAL(&s_lock);
+    layer_prepare_later();
+}
+
+void ui_layer_invalidate(lv_obj_t *obj)
+{
+    for (int i = 0; i < s_count; i++)
+    {
+        if (obj == NULL || s_layers[i].obj == obj)
+        {
+            if (s_layers[i].swapped)
+            {
+                layer_set_swapped(&s_layers[i], false); // 这次滚动剩下的照常画
+            }
+            layer_drop(&s_layers[i]);
+        }
+    }
+    layer_prepare_later();
+}
+
+void ui_layer_get_stats(ui_layer_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
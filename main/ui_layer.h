@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+
+/*********************** 滚动时的图层快照 ****************************/
+// 主界面滚动时每帧都要重画每个图标按钮的圆角遮罩 阴影 和图标的透明混合
+// 滚动容器里不变的子对象登记进来 空闲时各画一次快照 转成RGB565A8放进PSRAM
+// 滚动时原对象设成全透明不画 容器画完背景后把快照直接混合上去 停下来(吸附动画结束)再换回原对象
+// 对象还在原来的位置 点击 吸附和滚动范围都不受影响
+// 对象的样式或者内容变了调ui_layer_invalidate 下次滚动前重画快照
+// 关掉CONFIG_APP_UI_LAYER_CACHE时只统计不替换 用来比较前后的滚动帧率和渲染占用
+// 都在LVGL任务里或持有LVGL锁时调 ui_layer_get_stats除外
+
+#define UI_LAYER_MAX            16
+#define UI_LAYER_PREPARE_MS     500     // 登记以后等界面画出来再画快照 不拖慢建界面
+
+typedef struct {
+    uint32_t layers;                    // 登记的对象
+    uint32_t snapshots;                 // 画过的快照
+    uint32_t snapshot_us;               // 画快照和转换格式总共花的
+    uint32_t bytes;                     // PSRAM里的快照
+    uint32_t scrolls[2];                // [0]画原对象 [1]用快照 的滚动次数
+    uint32_t frames[2];                 // 滚动时的刷新次数
+    uint64_t scroll_us[2];              // 滚动的时间
+    uint64_t render_us[2];              // 滚动时LVGL渲染的时间 除以滚动时间就是渲染占用
+} ui_layer_stats_t;
+
+// obj的父对象是滚动容器 obj删掉时快照自动释放
+void ui_layer_add(lv_obj_t *obj);
+void ui_layer_invalidate(lv_obj_t *obj);    // NULL是全部
+void ui_layer_get_stats(ui_layer_stats_t *stats);
@@ -0,0 +1,218 @@
+#include <string.h>
+#include "ui_marquee.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_marquee";
+
+#define MARQUEE_STEP_MS     (1000 / UI_MARQUEE_SPEED)
+
+typedef struct {
+    lv_img_dsc_t dsc;                   // 整行文字的A8位图 data在PSRAM
+    lv_coord_t text_w;
+    lv_coord_t period;                  // 一圈的像素 文字加空白
+    lv_coord_t offset;                  // 现在画到哪里
+    uint32_t start;                     // offset为0的时刻 暂停时记的是已经走了的毫秒
+    bool paused;
+    lv_timer_t *timer;
+} ui_marquee_t;
+
+static void marquee_free_bitmap(ui_marquee_t *m)
+{
+    if (m->dsc.data)
+    {
+        lv_img_cache_invalidate_src(&m->dsc);
+        heap_caps_free((void *)m->dsc.data);
+        m->dsc.data = NULL;
+    }
+}
+
+// 一个字形按bpp展开成8位透明度 叠到位图上(x, y)的位置 字形的行之间不补齐
+static void glyph_blit(uint8_t *bmp, lv_coord_t bw, lv_coord_t bh, const lv_font_glyph_dsc_t *g, const uint8_t *src,
+                       lv_coord_t x0, lv_coord_t y0)
+{
+    uint32_t bpp = g->bpp;
+    uint32_t max = (1u << bpp) - 1;
+    uint32_t bit = 0;
+    for (int y = 0; y < g->box_h; y++)
+    {
+        for (int x = 0; x < g->box_w; x++, bit += bpp)
+        {
+            uint32_t v = (src[bit >> 3] >> (8 - bpp - (bit & 7))) & max;
+            lv_coord_t px = x0 + x, py = y0 + y;
+            if (v && px >= 0 && px < bw && py >= 0 && py < bh)
+            {
+                uint8_t *d = &bmp[py * bw + px];
+                uint32_t a = v * 255 / max;
+                *d = a > *d ? a : *d; // 相邻字形的边缘重叠时取大的
+            }
+        }
+    }
+}
+
+// 和lv_draw_label排一行的方法一样 字距和fallback字体都照算 占位的方框不画
+static bool marquee_render(lv_obj_t *obj, ui_marquee_t *m, const char *text)
+{
+    const lv_font_t *font = lv_obj_get_style_text_font(obj, 0);
+    lv_coord_t h = lv_font_get_line_height(font);
+    lv_coord_t w = lv_txt_get_width(text, strlen(text), font, 0, LV_TEXT_FLAG_NONE);
+    marquee_free_bitmap(m);
+    m->text_w = w;
+    m->period = w + lv_font_get_glyph_width(font, ' ', ' ') * UI_MARQUEE_GAP_CHARS;
+    lv_obj_set_height(obj, h);
+    if (w <= 0)
+    {
+        return true;
+    }
+    uint8_t *bmp = heap_caps_calloc(1, (size_t)w * h, MALLOC_CAP_SPIRAM);
+    if (bmp == NULL)
+    {
+        ESP_LOGE(TAG, "no PSRAM for a %dx%d line", w, h);
+        return false;
+    }
+    lv_coord_t x = 0;
+    uint32_t i = 0, len = strlen(text);
+    while (i < len)
+    {
+        uint32_t letter, letter_next;
+        _lv_txt_encoded_letter_next_2(text, &letter, &letter_next, &i);
+        lv_font_glyph_dsc_t g;
+        if (!lv_font_get_glyph_dsc(font, &g, letter, letter_next))
+        {
+            continue;
+        }
+        const lv_font_t *f = g.resolved_font ? g.resolved_font : font;
+        const uint8_t *src = g.is_placeholder || g.box_w == 0 ? NULL : lv_font_get_glyph_bitmap(f, letter);
+        if (src)
+        {
+            lv_coord_t y = (f->line_height - f->base_line) - g.box_h - g.ofs_y;
+            glyph_blit(bmp, w, h, &g, src, x + g.ofs_x, y);
+        }
+        x += g.adv_w;
+    }
+    m->dsc.header.cf = LV_IMG_CF_ALPHA_8BIT;
+    m->dsc.header.w = w;
+    m->dsc.header.h = h;
+    m->dsc.data_size = (uint32_t)w * h;
+    m->dsc.data = bmp;
+    return true;
+}
+
+static void marquee_draw_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    ui_marquee_t *m = lv_obj_get_user_data(obj);
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_area_t clip;
+    if (m->dsc.data == NULL || !_lv_area_intersect(&clip, &obj->coords, draw_ctx->clip_area))
+    {
+        return;
+    }
+    const lv_area_t *clip_ori = draw_ctx->clip_area;
+    draw_ctx->clip_area = &clip;
+    lv_draw_img_dsc_t dsc;
+    lv_draw_img_dsc_init(&dsc);
+    dsc.recolor = lv_obj_get_style_text_color_filtered(obj, 0);
+    dsc.opa = lv_obj_get_style_text_opa(obj, 0);
+    // 一圈比对象宽 所以最多贴两份
+    lv_area_t a;
+    a.x1 = obj->coords.x1 - m->offset;
+    a.y1 = obj->coords.y1;
+    a.x2 = a.x1 + m->text_w - 1;
+    a.y2 = a.y1 + m->dsc.header.h - 1;
+    lv_draw_img(draw_ctx, &dsc, &a, &m->dsc);
+    if (m->text_w > lv_obj_get_width(obj) && a.x1 + m->period <= obj->coords.x2)
+    {
+        lv_area_move(&a, m->period, 0);
+        lv_draw_img(draw_ctx, &dsc, &a, &m->dsc);
+    }
+    draw_ctx->clip_area = clip_ori;
+}
+
+static void marquee_timer_cb(lv_timer_t *t)
+{
+    lv_obj_t *obj = t->user_data;
+    ui_marquee_t *m = lv_obj_get_user_data(obj);
+    lv_coord_t offset = lv_tick_elaps(m->start) * UI_MARQUEE_SPEED / 1000 % m->period;
+    if (offset != m->offset)
+    {
+        m->offset = offset;
+        lv_obj_invalidate(obj);
+    }
+}
+
+// 文字放得下就不要定时器
+static void marquee_timer_update(lv_obj_t *obj, ui_marquee_t *m)
+{
+    bool want = !m->paused && m->dsc.data && m->text_w > lv_obj_get_content_width(obj);
+    if (want && m->timer == NULL)
+    {
+        m->start = lv_tick_get() - m->start;
+        m->timer = lv_timer_create(marquee_timer_cb, MARQUEE_STEP_MS, obj);
+    }
+    else if (!want && m->timer)
+    {
+        m->start = lv_tick_elaps(m->start) % ((uint32_t)m->period * 1000 / UI_MARQUEE_SPEED);
+        lv_timer_del(m->timer);
+        m->timer = NULL;
+    }
+}
+
+static void marquee_event_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    ui_marquee_t *m = lv_obj_get_user_data(obj);
+    if (lv_event_get_code(e) == LV_EVENT_SIZE_CHANGED)
+    {
+        marquee_timer_update(obj, m);
+        return;
+    }
+    // LV_EVENT_DELETE
+    if (m->timer)
+    {
+        lv_timer_del(m->timer);
+    }
+    marquee_free_bitmap(m);
+    lv_mem_free(m);
+    lv_obj_set_user_data(obj, NULL);
+}
+
+lv_obj_t *ui_marquee_create(lv_obj_t *parent)
+{
+    ui_marquee_t *m = lv_mem_alloc(sizeof(*m));
+    if (m == NULL)
+    {
+        return NULL;
+    }
+    memset(m, 0, sizeof(*m));
+    lv_obj_t *obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(obj);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_user_data(obj, m);
+    lv_obj_add_event_cb(obj, marquee_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+    lv_obj_add_event_cb(obj, marquee_event_cb, LV_EVENT_SIZE_CHANGED, NULL);
+    lv_obj_add_event_cb(obj, marquee_event_cb, LV_EVENT_DELETE, NULL);
+    return obj;
+}
+
+void ui_marquee_set_text(lv_obj_t *obj, const char *text)
+{
+    ui_marquee_t *m = lv_obj_get_user_data(obj);
+    if (m->timer)
+    {
+        lv_timer_del(m->timer);
+        m->timer = NULL;
+    }
+    m->start = 0;
+    m->offset = 0;
+    marquee_render(obj, m, text);
+    marquee_timer_update(obj, m);
+    lv_obj_invalidate(obj);
+}
+
+void ui_marquee_pause(lv_obj_t *obj, bool pause)
+{
+    ui_marquee_t *m = lv_obj_get_user_data(obj);
+    m->paused = pause;
+    marquee_timer_update(obj, m);
+}
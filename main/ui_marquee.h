@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** 跑马灯 ****************************/
+// LV_LABEL_LONG_SCROLL_CIRCULAR每动一下都重新排版 每个字都重新从字体里取字形按4bpp画 主界面一直开着的欢迎语也是
+// 这里设置文字时把整行按字体画一次成A8位图放进PSRAM 以后只改偏移
+// 画的时候把位图首尾相接贴两份 用text_color一次混合 每秒UI_MARQUEE_SPEED个像素 到了下一个像素才让LVGL重画
+// 文字比宽度短就不动 居左显示
+// 字体和颜色用对象的text_font和text_color样式 改了字体要重新设文字 宽度调用的人设 高度跟字体的行高
+// 都在LVGL任务里或持有LVGL锁时调
+
+#define UI_MARQUEE_SPEED        40      // 像素每秒 和LVGL默认的跑马灯差不多
+#define UI_MARQUEE_GAP_CHARS    3       // 首尾之间空几个空格 和LV_LABEL_WAIT_CHAR_COUNT一样
+
+lv_obj_t *ui_marquee_create(lv_obj_t *parent);
+void ui_marquee_set_text(lv_obj_t *obj, const char *text);
+void ui_marquee_pause(lv_obj_t *obj, bool pause);  // 看不见时停掉定时器 不白白唤醒LVGL任务
@@ -0,0 +1,237 @@
+#include <string.h>
+#include <stdlib.h>
+#include "ui_mem.h"
+#include "telemetry.h"
+#include "freertos/FreeRTOS.h"
+#include "multi_heap.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "ui_mem";
+
+#if CONFIG_APP_LV_MEM_POOL_INTERNAL
+#define MAIN_CAPS       (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#else
+#define MAIN_CAPS       (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#endif
+#define FAST_CAPS       (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define FAST_MAX        (CONFIG_APP_LV_MEM_FAST_KB * 1024 / 4)  // 再大的是图片解码之类 不是每帧的缓冲
+
+typedef struct {
+    const char *name;
+    uint32_t caps;
+    uint32_t size;
+    uint8_t *base;
+    multi_heap_handle_t heap;
+    portMUX_TYPE lock;                  // 给multi_heap用
+} pool_t;
+
+static pool_t s_pools[UI_MEM_POOLS] = {
+    [UI_MEM_MAIN] = {
+        .name = "main",
+        .caps = MAIN_CAPS,
+        .size = CONFIG_APP_LV_MEM_POOL_KB * 1024,
+        .lock = portMUX_INITIALIZER_UNLOCKED,
+    },
+    [UI_MEM_FAST] = {
+        .name = "fast",
+        .caps = FAST_CAPS,
+        .size = CONFIG_APP_LV_MEM_FAST_KB * 1024,
+        .lock = portMUX_INITIALIZER_UNLOCKED,
+    },
+};
+static bool s_render;                   // 只在LVGL任务里改
+static ui_mem_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static pool_t *pool_of(const void *ptr)
+{
+    for (int i = 0; i < UI_MEM_POOLS; i++)
+    {
+        pool_t *p = &s_pools[i];
+        if (p->heap && (const uint8_t *)ptr >= p->base && (const uint8_t *)ptr < p->base + p->size)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void *pool_alloc(int i, size_t size)
+{
+    pool_t *p = &s_pools[i];
+    if (p->heap == NULL)
+    {
+        return NULL;
+    }
+    void *ptr = multi_heap_malloc(p->heap, size);
+    portENTER_CRITICAL(&s_lock);
+    if (ptr)
+    {
+        s_stats.pool[i].allocs++;
+    }
+    else
+    {
+        s_stats.pool[i].misses++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ptr;
+}
+
+// 两个池都没有 照以前一样走标准库
+static void *heap_alloc(size_t size)
+{
+    void *ptr = malloc(size);
+    portENTER_CRITICAL(&s_lock);
+    if (ptr)
+    {
+        s_stats.overflow++;
+    }
+    else
+    {
+        s_stats.failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ptr;
+}
+
+static uint32_t read_used(void *arg)
+{
+    pool_t *p = &s_pools[(int)(uintptr_t)arg];
+    return p->heap ? p->size - multi_heap_free_size(p->heap) : 0;
+}
+
+static uint32_t read_frag(void *arg)
+{
+    ui_mem_stats_t st;
+    ui_mem_get_stats(&st);
+    return st.pool[UI_MEM_MAIN].frag_pct;
+}
+
+static uint32_t read_overflow(void *arg)
+{
+    return s_stats.overflow;
+}
+
+esp_err_t ui_mem_init(void)
+{
+    for (int i = 0; i < UI_MEM_POOLS; i++)
+    {
+        pool_t *p = &s_pools[i];
+        if (p->heap || p->size == 0)
+        {
+            continue;
+        }
+        p->base = heap_caps_malloc(p->size, p->caps);
+        if (p->base)
+        {
+            p->heap = multi_heap_register(p->base, p->size);
+        }
+        if (p->heap == NULL)
+        {
+            heap_caps_free(p->base);
+            p->base = NULL;
+            ESP_LOGW(TAG, "no %lu KB for the %s pool, LVGL uses the heap", (unsigned long)p->size / 1024, p->name);
+            continue;
+        }
+        multi_heap_set_lock(p->heap, &p->lock);
+        s_stats.pool[i].size = p->size;
+        ESP_LOGI(TAG, "%s pool: %lu KB in %s", p->name, (unsigned long)p->size / 1024,
+                 (p->caps & MALLOC_CAP_SPIRAM) ? "PSRAM" : "internal RAM");
+    }
+    ESP_RETURN_ON_FALSE(s_pools[UI_MEM_MAIN].heap, ESP_ERR_NO_MEM, TAG, "no LVGL pool");
+
+    telemetry_add("lv_mem_used", TELEMETRY_GAUGE, read_used, (void *)UI_MEM_MAIN);
+    telemetry_add("lv_mem_frag_pct", TELEMETRY_GAUGE, read_frag, NULL);
+    telemetry_add("lv_fast_used", TELEMETRY_GAUGE, read_used, (void *)UI_MEM_FAST);
+    telemetry_add("lv_mem_overflow", TELEMETRY_COUNTER, read_overflow, NULL);
+    return ESP_OK;
+}
+
+void *ui_mem_alloc(size_t size)
+{
+    void *ptr = NULL;
+    if (s_render && size <= FAST_MAX)
+    {
+        ptr = pool_alloc(UI_MEM_FAST, size);
+    }
+    if (ptr == NULL)
+    {
+        ptr = pool_alloc(UI_MEM_MAIN, size);
+    }
+    return ptr ? ptr : heap_alloc(size);
+}
+
+void ui_mem_free(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+    pool_t *p = pool_of(ptr);
+    if (p)
+    {
+        multi_heap_free(p->heap, ptr);
+    }
+    else
+    {
+        free(ptr);
+    }
+}
+
+void *ui_mem_realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return ui_mem_alloc(size);
+    }
+    pool_t *p = pool_of(ptr);
+    if (p == NULL)
+    {
+        return realloc(ptr, size); // 池建好以前要的 留在堆里
+    }
+    void *n = multi_heap_realloc(p->heap, ptr, size);
+    if (n)
+    {
+        return n;
+    }
+    // 原来的池里放不下 换个地方 原来的还在
+    n = ui_mem_alloc(size);
+    if (n)
+    {
+        size_t old = multi_heap_get_allocated_size(p->heap, ptr);
+        memcpy(n, ptr, old < size ? old : size);
+        multi_heap_free(p->heap, ptr);
+    }
+    return n;
+}
+
+void ui_mem_render(bool on)
+{
+    s_render = on;
+}
+
+void ui_mem_get_stats(ui_mem_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    for (int i = 0; i < UI_MEM_POOLS; i++)
+    {
+        pool_t *p = &s_pools[i];
+        if (p->heap == NULL)
+        {
+            continue;
+        }
+        multi_heap_info_t info;
+        multi_heap_get_info(p->heap, &info);
+        ui_mem_pool_stats_t *s = &stats->pool[i];
+        s->used = p->size - info.total_free_bytes;
+        s->peak = p->size - info.minimum_free_bytes;
+        s->largest = info.largest_free_block;
+        s->frag_pct = info.total_free_bytes ? 100 - (uint64_t)info.largest_free_block * 100 / info.total_free_bytes : 0;
+        s->blocks = info.allocated_blocks;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+
+/*********************** LVGL的内存 ****************************/
+// LV_MEM_CUSTOM的malloc/free 以前是标准库的 LVGL的小对象和样式跟着所有人的小块挤在内部RAM里(2KB以下总在内部)
+// 这里开机先从PSRAM(可以改内部RAM)要一整块 注册成ESP-IDF的TLSF堆 LVGL自己用 碎也只碎在自己的池里
+// 渲染期间(render_start到monitor)要的小块是每帧用完就放的画图缓冲 先放内部RAM的小池 画起来快
+// 池满了退回原来的堆 记一次溢出
+// lv_mem.c通过CONFIG_LV_MEM_CUSTOM_INCLUDE包含这个文件 见main/CMakeLists.txt 这里不要包含lvgl.h
+
+typedef enum {
+    UI_MEM_MAIN,                        // 对象 样式 文字 图片缓存
+    UI_MEM_FAST,                        // 渲染时的临时缓冲 内部RAM
+    UI_MEM_POOLS,
+} ui_mem_pool_t;
+
+typedef struct {
+    uint32_t size;                      // 0是没有这个池
+    uint32_t used;
+    uint32_t peak;
+    uint32_t largest;                   // 最大的整块
+    uint8_t frag_pct;                   // 剩余里拼不成最大块的比例
+    uint32_t blocks;                    // 在用的块
+    uint32_t allocs;
+    uint32_t misses;                    // 池里没有 转到别处的
+} ui_mem_pool_stats_t;
+
+typedef struct {
+    ui_mem_pool_stats_t pool[UI_MEM_POOLS];
+    uint32_t overflow;                  // 两个池都没有 从堆里分的
+    uint32_t failed;                    // 堆里也没有
+} ui_mem_stats_t;
+
+esp_err_t ui_mem_init(void);            // telemetry_init之后 LVGL初始化之前 在这之前要的都走堆
+void *ui_mem_alloc(size_t size);
+void ui_mem_free(void *ptr);
+void *ui_mem_realloc(void *ptr, size_t size);
+void ui_mem_render(bool on);            // 显示驱动在渲染开始和结束时调
+void ui_mem_get_stats(ui_mem_stats_t *stats);   // 要走一遍池 别在渲染里调
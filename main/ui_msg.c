@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "ui_msg.h"
+#include "esp_lvgl_port.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "ui_msg";
+
+typedef enum {
+    UI_MSG_TEXT,
+    UI_MSG_BAR,
+    UI_MSG_IMG_SRC,
+    UI_MSG_DEL,
+    UI_MSG_CALL,
+} ui_msg_kind_t;
+
+typedef struct {
+    uint8_t kind;
+    lv_obj_t *obj;                      // CALL消息里是参数
+    union {
+        char text[UI_MSG_TEXT_LEN];
+        struct {
+            int32_t start;
+            int32_t value;
+        } bar;
+        const void *src;
+        ui_msg_fn_t fn;
+    };
+} ui_msg_t;
+
+// 有界多生产者队列 每格带序号 生产者用CAS抢位置 写完再发布序号
+// 消费者只有LVGL任务一个 不需要CAS
+// 序号存的是减去格子下标后的值 全0就是初始状态 开机前就可以投递
+typedef struct {
+    atomic_uint seq;
+    ui_msg_t msg;
+} ui_msg_cell_t;
+
+static ui_msg_cell_t s_cells[UI_MSG_QUEUE_LEN];
+static atomic_uint s_tail;
+static unsigned s_head;
+
+static ui_msg_t s_batch[UI_MSG_QUEUE_LEN];  // 只在LVGL任务里用
+static TaskHandle_t s_ui_task = NULL;
+static bool s_draining = false;
+static lv_timer_t *s_timer = NULL;
+
+static ui_msg_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+_Static_assert((UI_MSG_QUEUE_LEN & (UI_MSG_QUEUE_LEN - 1)) == 0, "UI_MSG_QUEUE_LEN must be a power of two");
+
+static bool msg_push(const ui_msg_t *m)
+{
+    unsigned pos = atomic_load_explicit(&s_tail, memory_order_relaxed);
+    ui_msg_cell_t *cell;
+    while (1)
+    {
+        unsigned idx = pos & (UI_MSG_QUEUE_LEN - 1);
+        cell = &s_cells[idx];
+        unsigned seq = atomic_load_explicit(&cell->seq, memory_order_acquire) + idx;
+        int diff = (int)(seq - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&s_tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;   // 满了
+        }
+        else
+        {
+            pos = atomic_load_explicit(&s_tail, memory_order_relaxed);
+        }
+    }
+    cell->msg = *m;
+    atomic_store_explicit(&cell->seq, pos + 1 - (pos & (UI_MSG_QUEUE_LEN - 1)), memory_order_release);
+    return true;
+}
+
+static bool msg_pending(void)
+{
+    unsigned idx = s_head & (UI_MSG_QUEUE_LEN - 1);
+    unsigned seq = atomic_load_explicit(&s_cells[idx].seq, memory_order_acquire) + idx;
+    return (int)(seq - (s_head + 1)) >= 0;
+}
+
+static bool msg_pop(ui_msg_t *m)
+{
+    unsigned idx = s_head & (UI_MSG_QUEUE_LEN - 1);
+    ui_msg_cell_t *cell = &s_cells[idx];
+    unsigned seq = atomic_load_explicit(&cell->seq, memory_order_acquire) + idx;
+    if ((int)(seq - (s_head + 1)) < 0)
+    {
+        return false;
+    }
+    *m = cell->msg;
+    atomic_store_explicit(&cell->seq, s_head + UI_MSG_QUEUE_LEN - idx, memory_order_release);
+    s_head++;
+    return true;
+}
+
+// 后面还有同一控件的同类更新 或者它马上要被删掉 这条就不用执行了
+static bool msg_superseded(int i, int n)
+{
+    const ui_msg_t *m = &s_batch[i];
+    if (m->kind > UI_MSG_IMG_SRC)
+    {
+        return false;
+    }
+    for (int j = i + 1; j < n; j++)
+    {
+        if (s_batch[j].obj == m->obj && (s_batch[j].kind == m->kind || s_batch[j].kind == UI_MSG_DEL))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void msg_drain(void)
+{
+    int n = 0;
+    s_draining = true;
+    int64_t t0 = esp_timer_get_time();
+    while (n < UI_MSG_QUEUE_LEN && msg_pop(&s_batch[n]))
+    {
+        n++;
+    }
+
+    uint32_t applied = 0, coalesced = 0, stale = 0;
+    for (int i = 0; i < n; i++)
+    {
+        ui_msg_t *m = &s_batch[i];
+        if (msg_superseded(i, n))
+        {
+            coalesced++;
+            continue;
+        }
+        // 发送者不知道界面是否已经被返回键删掉 执行前先确认控件还在
+        if (m->kind != UI_MSG_CALL && !lv_obj_is_valid(m->obj))
+        {
+            stale++;
+            continue;
+        }
+        switch (m->kind)
+        {
+        case UI_MSG_TEXT:
+            lv_label_set_text(m->obj, m->text);
+            break;
+        case UI_MSG_BAR:
+            lv_bar_set_start_value(m->obj, m->bar.start, LV_ANIM_OFF);
+            lv_bar_set_value(m->obj, m->bar.value, LV_ANIM_OFF);
+            break;
+        case UI_MSG_IMG_SRC:
+            lv_img_set_src(m->obj, m->src);
+            break;
+        case UI_MSG_DEL:
+            lv_obj_del(m->obj);
+            break;
+        case UI_MSG_CALL:
+            m->fn(m->obj);
+            break;
+        }
+        applied++;
+    }
+    uint32_t us = esp_timer_get_time() - t0;
+    s_draining = false;
+
+    if (n == 0)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.applied += applied;
+    s_stats.coalesced += coalesced;
+    s_stats.stale += stale;
+    if ((uint32_t)n > s_stats.max_batch)
+    {
+        s_stats.max_batch = n;
+    }
+    if (us > s_stats.max_apply_us)
+    {
+        s_stats.max_apply_us = us;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+// 队列空了就停着 不让LVGL任务每5ms醒一次 投递的人再叫醒
+// 先停再取 取完还有就接着跑 中间投进来的不会漏
+static void msg_timer_cb(lv_timer_t *t)
+{
+    s_ui_task = xTaskGetCurrentTaskHandle();
+    lv_timer_pause(t);
+    msg_drain();
+    if (msg_pending())
+    {
+        lv_timer_resume(t);
+    }
+}
+
+// 只改一个位 其他任务里调也没关系
+static void msg_kick(void)
+{
+    if (s_timer)
+    {
+        lv_timer_resume(s_timer);
+        lvgl_port_task_wake();
+    }
+}
+
+void ui_msg_init(void)
+{
+    if (s_timer == NULL)
+    {
+        s_timer = lv_timer_create(msg_timer_cb, UI_MSG_PERIOD_MS, NULL);
+    }
+}
+
+static void msg_count(bool ok)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    if (ok)
+    {
+        s_stats.posted++;
+    }
+    else
+    {
+        s_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+// 文字/进度条这类更新丢了也会被下一条补上 满了直接返回
+static bool msg_post(const ui_msg_t *m)
+{
+    bool ok = msg_push(m);
+    msg_count(ok);
+    if (ok)
+    {
+        msg_kick();
+    }
+    return ok;
+}
+
+// 删除和回调不能丢 满了就等LVGL任务取走 在LVGL任务里直接先执行掉已有的
+static bool msg_post_wait(const ui_msg_t *m)
+{
+    if (msg_post(m))
+    {
+        return true;
+    }
+    if (xTaskGetCurrentTaskHandle() == s_ui_task)
+    {
+        if (!s_draining)
+        {
+            msg_drain();
+            return msg_post(m);
+        }
+    }
+    else
+    {
+        for (int waited = 0; waited < UI_MSG_FULL_WAIT_MS; waited += portTICK_PERIOD_MS)
+        {
+            vTaskDelay(1);
+            if (msg_push(m))
+            {
+                msg_count(true);
+                msg_kick();
+                return true;
+            }
+        }
+    }
+    ESP_LOGW(TAG, "queue full, message %d dropped", m->kind);
+    return false;
+}
+
+bool ui_post_text(lv_obj_t *label, const char *fmt, ...)
+{
+    ui_msg_t m = { .kind = UI_MSG_TEXT, .obj = label };
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(m.text, sizeof(m.text), fmt, ap);
+    va_end(ap);
+    return msg_post(&m);
+}
+
+bool ui_post_bar(lv_obj_t *bar, int32_t start, int32_t value)
+{
+    ui_msg_t m = { .kind = UI_MSG_BAR, .obj = bar, .bar = { start, value } };
+    return msg_post(&m);
+}
+
+bool ui_post_img_src(lv_obj_t *img, const void *src)
+{
+    ui_msg_t m = { .kind = UI_MSG_IMG_SRC, .obj = img, .src = src };
+    return msg_post(&m);
+}
+
+bool ui_post_del(lv_obj_t *obj)
+{
+    ui_msg_t m = { .kind = UI_MSG_DEL, .obj = obj };
+    return msg_post_wait(&m);
+}
+
+bool ui_post_call(ui_msg_fn_t fn, void *arg)
+{
+    ui_msg_t m = { .kind = UI_MSG_CALL, .obj = arg, .fn = fn };
+    return msg_post_wait(&m);
+}
+
+void ui_msg_get_stats(ui_msg_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
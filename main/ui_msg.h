@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** 界面消息队列 ****************************/
+// 后台任务不再拿LVGL锁 把界面更新投递到无锁队列里 由LVGL任务里的定时器取出执行
+// 同一控件的同类更新(文字 进度条 图片源)在一批里只执行最后一条
+// 投递不会阻塞 只有队列满时 结构性的消息(删除 回调)才让发送者等一会
+// 队列空的时候定时器停着 投递成功就叫醒LVGL任务
+
+#define UI_MSG_QUEUE_LEN        32      // 必须是2的幂
+#define UI_MSG_TEXT_LEN         48      // 文字消息的最大长度(含结尾0)
+#define UI_MSG_PERIOD_MS        5       // 有消息时取队列的周期
+#define UI_MSG_FULL_WAIT_MS     100     // 队列满时删除/回调消息最多等这么久
+
+typedef void (*ui_msg_fn_t)(void *arg);    // 在LVGL任务里执行 已持有LVGL锁
+
+typedef struct {
+    uint32_t posted;
+    uint32_t applied;
+    uint32_t coalesced;                 // 被同一控件后来的更新覆盖掉的
+    uint32_t stale;                     // 执行时目标控件已经被删掉的
+    uint32_t dropped;                   // 队列满丢掉的
+    uint32_t max_batch;                 // 一次取出的最多消息数
+    uint32_t max_apply_us;              // 一次执行一批的最长时间
+} ui_msg_stats_t;
+
+void ui_msg_init(void);                 // 创建取队列的定时器 要在持有LVGL锁时调用
+bool ui_post_text(lv_obj_t *label, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+bool ui_post_bar(lv_obj_t *bar, int32_t start, int32_t value);
+bool ui_post_img_src(lv_obj_t *img, const void *src);
+bool ui_post_del(lv_obj_t *obj);
+bool ui_post_call(ui_msg_fn_t fn, void *arg);
+void ui_msg_get_stats(ui_msg_stats_t *stats);
@@ -0,0 +1,122 @@
+#include <math.h>
+#include <string.h>
+#include "ui_orient.h"
+#include "imu.h"
+#include "idle_mgr.h"
+#include "esp32_s3_szp.h"
+#include "esp_lvgl_port.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_APP_UI_ORIENT
+
+static const char *TAG = "ui_orient";
+
+static lv_timer_t *s_timer;
+static int s_cand = -1;                 // 正在等着稳住的方向 -1是没有
+static int64_t s_cand_us;
+static ui_orient_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 读一组加速度 IMU在读FIFO就不再走I2C
+static bool orient_read(int16_t acc[3], bool *reg)
+{
+    imu_sample_t smp;
+    if (imu_running() && imu_latest(&smp))
+    {
+        memcpy(acc, smp.acc, sizeof(smp.acc));
+        *reg = false;
+        return true;
+    }
+    uint8_t raw[6];
+    if (qmi8658_register_read(QMI8658_AX_L, raw, sizeof(raw)) != ESP_OK)
+    {
+        return false;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        acc[i] = (int16_t)(raw[2 * i] | raw[2 * i + 1] << 8);
+    }
+    *reg = true;
+    return true;
+}
+
+static void orient_timer_cb(lv_timer_t *t)
+{
+#if CONFIG_APP_IDLE_MGR
+    if (idle_mgr_state() != IDLE_ON)
+    {
+        s_cand = -1;    // 熄屏时不读 亮了重新等稳
+        return;
+    }
+#endif
+    int16_t acc[3];
+    bool reg;
+    if (!orient_read(acc, &reg))
+    {
+        return;
+    }
+    float g[3];
+    for (int i = 0; i < 3; i++)
+    {
+        g[i] = (float)acc[i] / IMU_ACC_LSB_PER_G;
+    }
+    // 模长在0.8~1.2g之间才算拿稳了 没初始化的芯片读出来是0 也在这里挡掉
+    float m2 = g[0] * g[0] + g[1] * g[1] + g[2] * g[2];
+    float up = g[UI_ORIENT_AXIS] * UI_ORIENT_SIGN;
+    float side = fabsf(g[1 - UI_ORIENT_AXIS]);
+    int dir = -1;
+    if (m2 > 0.64f && m2 < 1.44f && fabsf(up) > UI_ORIENT_TILT_G && fabsf(up) > side)
+    {
+        dir = up > 0 ? LV_DISP_ROT_NONE : LV_DISP_ROT_180;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    s_stats.polls++;
+    s_stats.reg_reads += reg;
+    s_stats.unsettled += dir < 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (dir != s_cand)
+    {
+        s_cand = dir;
+        s_cand_us = now;
+        return;
+    }
+    if (dir < 0 || dir == bsp_display_get_rotation() || now - s_cand_us < UI_ORIENT_HOLD_MS * 1000LL)
+    {
+        return;
+    }
+    esp_err_t err = bsp_display_set_rotation((lv_disp_rot_t)dir);
+    portENTER_CRITICAL(&s_lock);
+    if (err == ESP_OK)
+    {
+        s_stats.flips++;
+    }
+    else
+    {
+        s_stats.deferred++;     // 预览中 方向没变的话下一次还会再试
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ui_orient_start(void)
+{
+    lvgl_port_lock(0);
+    if (s_timer == NULL)
+    {
+        s_timer = lv_timer_create(orient_timer_cb, UI_ORIENT_POLL_MS, NULL);
+    }
+    lvgl_port_unlock();
+    ESP_LOGI(TAG, "started, polling every %d ms", UI_ORIENT_POLL_MS);
+}
+
+void ui_orient_get_stats(ui_orient_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 跟着重力转屏 ****************************/
+// 亮屏时LVGL定时器每UI_ORIENT_POLL_MS看一次重力 IMU在读FIFO就拿最新的一组 没在读就直接读加速度寄存器
+// 空闲管理让芯片留在只测运动(加速度21Hz) 寄存器里的值是新的 一次6字节 和触摸一样在LVGL任务里走I2C
+// 重力沿屏幕上下方向(UI_ORIENT_AXIS)的分量超过UI_ORIENT_TILT_G 而且比另一个屏幕内的轴大 模长接近1g
+// 同一个方向连着UI_ORIENT_HOLD_MS才转 平放 竖着拿和晃的时候都不动
+// 只在横屏的两个方向(0和180)之间转 界面都按320x240摆 竖屏要等界面按父对象大小排了再放开
+// 转屏见bsp_display_set_rotation 两帧之间改MADCTL 平时每帧不多花 转的那一帧整屏重画
+
+#define UI_ORIENT_POLL_MS       200
+#define UI_ORIENT_HOLD_MS       600
+#define UI_ORIENT_TILT_G        0.5f    // 大约倾斜30度
+#define UI_ORIENT_AXIS          1       // 屏幕上下方向对应的传感器轴 0x 1y
+#define UI_ORIENT_SIGN          1       // 正着拿时这个轴上的重力是正的 装反了改成-1
+
+typedef struct {
+    uint32_t polls;
+    uint32_t reg_reads;                 // IMU没在读 直接读寄存器的次数
+    uint32_t unsettled;                 // 在动 平放或者竖着 没有判方向
+    uint32_t flips;
+    uint32_t deferred;                  // 该转的时候在预览 下次再试
+} ui_orient_stats_t;
+
+#if CONFIG_APP_UI_ORIENT
+void ui_orient_start(void);             // LVGL起来以后调用
+void ui_orient_get_stats(ui_orient_stats_t *stats);
+#endif
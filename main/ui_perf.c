@@ -0,0 +1,498 @@
+#include <stdio.h>
+#include <string.h>
+#include "ui_perf.h"
+#include "telemetry.h"
+#include "sys_trace.h"
+#include "esp32_s3_szp.h"
+#include "esp_lvgl_port.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "ui_perf";
+
+#define UI_PERF_REFR_PERIOD_US  (CONFIG_LV_DISP_DEF_REFR_PERIOD * 1000)
+#define UI_PERF_OVERLAY_MS      500
+
+// 桶的上界(微秒) 大约每档乘1.4 最后一档收所有更慢的
+static const uint32_t s_bounds[UI_PERF_BUCKETS] = {
+    250, 350, 500, 700, 1000, 1400, 2000, 2800, 4000, 5600,
+    8000, 11000, 16000, 22000, 32000, 45000, 64000, 90000, 180000, UINT32_MAX,
+};
+
+typedef struct {
+    uint16_t counts[UI_PERF_BUCKETS];
+    uint32_t samples;
+    uint32_t max_us;
+} ui_perf_hist_t;
+
+typedef struct {
+    ui_perf_hist_t hist[UI_PERF_METRICS];
+    uint32_t refreshes;             // 和直方图一起减半
+    uint32_t misses;
+} ui_perf_screen_t;
+
+static ui_perf_screen_t s_screens[UI_PERF_SCREENS];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static const char *const *s_names = NULL;
+static int s_count = 0;
+static int (*s_current)(void) = NULL;
+
+static lv_obj_t *s_overlay = NULL;
+static lv_timer_t *s_overlay_timer = NULL;
+static ui_perf_overlay_fmt_t s_extra = NULL;
+static uint32_t s_frames_total;         // 不减半 给遥测当计数
+static uint32_t s_misses_total;
+static uint64_t s_render_us_total;
+
+// 正在持有锁的 只有持有者改 看门狗在s_lock里读
+typedef struct {
+    TaskHandle_t task;
+    int depth;                          // 锁是递归的 最外面一层才算
+    const char *func;
+    int line;
+    int64_t t0;
+    bool stuck;                         // 看门狗已经报过这一次
+    char name[16];
+} ui_lock_hold_t;
+
+static ui_lock_hold_t s_hold;
+static ui_lock_site_t s_sites[UI_LOCK_SITES];
+static int64_t s_site_warned[UI_LOCK_SITES];
+static int s_nsites;
+static uint32_t s_lock_timeouts;
+static uint32_t s_long_holds_total;
+static esp_timer_handle_t s_lock_watch;
+
+static int perf_screen(void)
+{
+    int s = s_current ? s_current() : 0;
+    return s >= 0 && s < UI_PERF_SCREENS ? s : 0;
+}
+
+static int perf_bucket(uint32_t us)
+{
+    int b = 0;
+    while (us > s_bounds[b])
+    {
+        b++;
+    }
+    return b;
+}
+
+static void perf_decay(ui_perf_hist_t *h)
+{
+    h->samples = 0;
+    for (int b = 0; b < UI_PERF_BUCKETS; b++)
+    {
+        h->counts[b] >>= 1;
+        h->samples += h->counts[b];
+    }
+    h->max_us >>= 1;    // 不知道最大值还在不在窗口里 让它慢慢降下来
+}
+
+// 调用者持有s_lock
+static void perf_add(ui_perf_screen_t *scr, ui_perf_metric_t metric, uint32_t us)
+{
+    ui_perf_hist_t *h = &scr->hist[metric];
+    if (h->samples >= UI_PERF_WINDOW)
+    {
+        perf_decay(h);
+        if (metric == UI_PERF_RENDER)
+        {
+            scr->refreshes >>= 1;
+            scr->misses >>= 1;
+        }
+    }
+    h->counts[perf_bucket(us)]++;
+    h->samples++;
+    if (us > h->max_us)
+    {
+        h->max_us = us;
+    }
+}
+
+static uint32_t perf_percentile(const ui_perf_hist_t *h, uint32_t pct)
+{
+    uint32_t want = (h->samples * pct + 99) / 100;
+    uint32_t acc = 0;
+    for (int b = 0; b < UI_PERF_BUCKETS; b++)
+    {
+        acc += h->counts[b];
+        if (acc >= want && acc)
+        {
+            // 最后一档没有上界 用最大值
+            return b == UI_PERF_BUCKETS - 1 || s_bounds[b] > h->max_us ? h->max_us : s_bounds[b];
+        }
+    }
+    return h->max_us;
+}
+
+// 在LVGL任务里 每次刷新结束时由BSP调用
+static void perf_on_refresh(uint32_t total_us, uint32_t wait_us, uint32_t flush_us)
+{
+    ui_perf_screen_t *scr = &s_screens[perf_screen()];
+    uint32_t render_us = total_us > wait_us ? total_us - wait_us : 0;
+    portENTER_CRITICAL(&s_lock);
+    perf_add(scr, UI_PERF_RENDER, render_us);
+    perf_add(scr, UI_PERF_FLUSH, flush_us);
+    scr->refreshes++;
+    s_frames_total++;
+    s_render_us_total += render_us;
+    if (total_us > UI_PERF_REFR_PERIOD_US)
+    {
+        scr->misses++;
+        s_misses_total++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 遥测读当前界面的p95 在esp_timer任务里
+static uint32_t tlm_p95(void *arg)
+{
+    ui_perf_summary_t sum;
+    ui_perf_get(perf_screen(), (ui_perf_metric_t)(uintptr_t)arg, &sum);
+    return sum.p95_us;
+}
+
+static uint32_t tlm_total(void *arg)
+{
+    return *(volatile uint32_t *)arg;
+}
+
+// 持有中的锁已经超过UI_LOCK_STUCK_MS 这时LVGL任务在等 界面不动 每次持有只报一次
+static void lock_watch_cb(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    ui_lock_hold_t h;
+    portENTER_CRITICAL(&s_lock);
+    bool stuck = s_hold.depth > 0 && !s_hold.stuck && now - s_hold.t0 > UI_LOCK_STUCK_MS * 1000;
+    s_hold.stuck |= stuck;
+    h = s_hold;
+    portEXIT_CRITICAL(&s_lock);
+    if (stuck)
+    {
+        ESP_LOGW(TAG, "LVGL lock held %lu ms so far by %s at %s:%d, UI frozen", (unsigned long)((now - h.t0) / 1000),
+                 h.name, h.func, h.line);
+    }
+}
+
+void ui_perf_init(const char *const *names, int count, int (*current_screen)(void))
+{
+    s_names = names;
+    s_count = count < UI_PERF_SCREENS ? count : UI_PERF_SCREENS;
+    s_current = current_screen;
+    bsp_display_set_refresh_cb(perf_on_refresh);
+    telemetry_add("lv_render_p95", TELEMETRY_GAUGE, tlm_p95, (void *)UI_PERF_RENDER);
+    telemetry_add("lv_flush_p95", TELEMETRY_GAUGE, tlm_p95, (void *)UI_PERF_FLUSH);
+    telemetry_add("lv_frames", TELEMETRY_COUNTER, tlm_total, &s_frames_total);
+    telemetry_add("lv_misses", TELEMETRY_COUNTER, tlm_total, &s_misses_total);
+    telemetry_add("lv_long_holds", TELEMETRY_COUNTER, tlm_total, &s_long_holds_total);
+    const esp_timer_create_args_t args = {
+        .callback = lock_watch_cb,
+        .name = "ui_lock_watch",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&args, &s_lock_watch) == ESP_OK)
+    {
+        esp_timer_start_periodic(s_lock_watch, UI_LOCK_WATCH_MS * 1000);
+    }
+}
+
+bool ui_lock_at(uint32_t timeout_ms, const char *func, int line)
+{
+    int64_t t0 = esp_timer_get_time();
+    SYS_TRACE_LOCK_WAIT("lvgl");
+    bool ok = lvgl_port_lock(timeout_ms);
+    if (ok)
+    {
+        SYS_TRACE_LOCK_TAKE("lvgl");
+    }
+    int64_t now = esp_timer_get_time();
+    ui_perf_screen_t *scr = &s_screens[perf_screen()];
+    ui_lock_hold_t h;
+    portENTER_CRITICAL(&s_lock);
+    perf_add(scr, UI_PERF_LOCK, now - t0);
+    if (ok && s_hold.depth++ == 0)
+    {
+        s_hold.task = xTaskGetCurrentTaskHandle();
+        s_hold.func = func;
+        s_hold.line = line;
+        s_hold.t0 = now;
+        s_hold.stuck = false;
+        strlcpy(s_hold.name, pcTaskGetName(NULL), sizeof(s_hold.name));
+    }
+    s_lock_timeouts += !ok;
+    h = s_hold;
+    portEXIT_CRITICAL(&s_lock);
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "ui_lock timed out after %lu ms at %s:%d, held by %s at %s:%d for %lu ms",
+                 (unsigned long)timeout_ms, func, line, h.depth ? h.name : "?", h.depth ? h.func : "?",
+                 h.depth ? h.line : 0, h.depth ? (unsigned long)((now - h.t0) / 1000) : 0UL);
+    }
+    return ok;
+}
+
+// 调用处的表满了 顶掉最长一次最短的 比它还短的就不记了
+static ui_lock_site_t *lock_site(const ui_lock_hold_t *h, uint32_t us)
+{
+    int min = 0;
+    for (int i = 0; i < s_nsites; i++)
+    {
+        if (s_sites[i].func == h->func && s_sites[i].line == h->line)
+        {
+            return &s_sites[i];
+        }
+        min = s_sites[i].max_us < s_sites[min].max_us ? i : min;
+    }
+    int i = min;
+    if (s_nsites < UI_LOCK_SITES)
+    {
+        i = s_nsites++;
+    }
+    else if (s_sites[min].max_us >= us)
+    {
+        return NULL;
+    }
+    memset(&s_sites[i], 0, sizeof(s_sites[i]));
+    s_sites[i].func = h->func;
+    s_sites[i].line = h->line;
+    s_site_warned[i] = 0;
+    return &s_sites[i];
+}
+
+void ui_unlock(void)
+{
+    int64_t now = esp_timer_get_time();
+    ui_lock_hold_t h = {0};
+    bool last = false;
+    bool warn = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_hold.depth > 0 && s_hold.task == xTaskGetCurrentTaskHandle() && --s_hold.depth == 0)
+    {
+        last = true;
+        h = s_hold;
+        s_hold.task = NULL;
+    }
+    uint32_t us = now - h.t0;
+    ui_lock_site_t *site = last ? lock_site(&h, us) : NULL;
+    if (site)
+    {
+        site->holds++;
+        site->total_us += us;
+        if (us > site->max_us)
+        {
+            // 比这个调用处以前的都长 马上警告 否则隔一段时间才警告
+            warn = us > UI_LOCK_WARN_US;
+            site->max_us = us;
+            memcpy(site->task, h.name, sizeof(site->task));
+        }
+        if (us > UI_LOCK_WARN_US)
+        {
+            site->over++;
+            s_long_holds_total++;
+            int64_t *warned = &s_site_warned[site - s_sites];
+            warn |= now - *warned > UI_LOCK_WARN_GAP_MS * 1000;
+            *warned = warn ? now : *warned;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    SYS_TRACE_LOCK_GIVE("lvgl");
+    lvgl_port_unlock();
+    if (warn)
+    {
+        ESP_LOGW(TAG, "LVGL lock held %.1f ms (> %d ms) by %s at %s:%d", us / 1000.0, UI_LOCK_WARN_US / 1000, h.name,
+                 h.func, h.line);
+    }
+}
+
+bool ui_lock_get_holder(ui_lock_site_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    memset(out, 0, sizeof(*out));
+    portENTER_CRITICAL(&s_lock);
+    bool held = s_hold.depth > 0;
+    if (held)
+    {
+        out->func = s_hold.func;
+        out->line = s_hold.line;
+        memcpy(out->task, s_hold.name, sizeof(out->task));
+        out->max_us = now - s_hold.t0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return held;
+}
+
+int ui_lock_get_top(ui_lock_site_t *out, int max, uint32_t *timeouts)
+{
+    portENTER_CRITICAL(&s_lock);
+    int n = 0;
+    for (int i = 0; i < s_nsites; i++)
+    {
+        // 插入排序 按最长一次从大到小 满了挤掉最后一个
+        int k = n;
+        while (k > 0 && out[k - 1].max_us < s_sites[i].max_us)
+        {
+            if (k < max)
+            {
+                out[k] = out[k - 1];
+            }
+            k--;
+        }
+        if (k < max)
+        {
+            out[k] = s_sites[i];
+            n += n < max;
+        }
+    }
+    if (timeouts)
+    {
+        *timeouts = s_lock_timeouts;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return n;
+}
+
+void ui_perf_get(int screen, ui_perf_metric_t metric, ui_perf_summary_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (screen < 0 || screen >= UI_PERF_SCREENS || metric >= UI_PERF_METRICS)
+    {
+        return;
+    }
+    ui_perf_hist_t h;
+    portENTER_CRITICAL(&s_lock);
+    h = s_screens[screen].hist[metric];
+    portEXIT_CRITICAL(&s_lock);
+    out->samples = h.samples;
+    if (h.samples)
+    {
+        out->p50_us = perf_percentile(&h, 50);
+        out->p95_us = perf_percentile(&h, 95);
+        out->p99_us = perf_percentile(&h, 99);
+        out->max_us = h.max_us;
+    }
+}
+
+void ui_perf_get_misses(int screen, uint32_t *refreshes, uint32_t *misses)
+{
+    *refreshes = *misses = 0;
+    if (screen < 0 || screen >= UI_PERF_SCREENS)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *refreshes = s_screens[screen].refreshes;
+    *misses = s_screens[screen].misses;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static const char *perf_name(int screen)
+{
+    return s_names && screen < s_count ? s_names[screen] : "?";
+}
+
+void ui_perf_get_totals(uint32_t *frames, uint64_t *render_us)
+{
+    portENTER_CRITICAL(&s_lock);
+    *frames = s_frames_total;
+    *render_us = s_render_us_total;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ui_perf_log(void)
+{
+    for (int s = 0; s < UI_PERF_SCREENS; s++)
+    {
+        ui_perf_summary_t r, f, l;
+        uint32_t refr, miss;
+        ui_perf_get(s, UI_PERF_RENDER, &r);
+        ui_perf_get(s, UI_PERF_FLUSH, &f);
+        ui_perf_get(s, UI_PERF_LOCK, &l);
+        ui_perf_get_misses(s, &refr, &miss);
+        if (r.samples == 0 && l.samples == 0)
+        {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-8s render p50/95/99 %.1f/%.1f/%.1f ms, flush %.1f/%.1f/%.1f ms, lock %.1f/%.1f/%.1f ms, miss %lu/%lu (>%d ms)",
+                 perf_name(s), r.p50_us / 1000.0, r.p95_us / 1000.0, r.p99_us / 1000.0,
+                 f.p50_us / 1000.0, f.p95_us / 1000.0, f.p99_us / 1000.0,
+                 l.p50_us / 1000.0, l.p95_us / 1000.0, l.p99_us / 1000.0,
+                 (unsigned long)miss, (unsigned long)refr, CONFIG_LV_DISP_DEF_REFR_PERIOD);
+    }
+    ui_lock_site_t top[UI_LOCK_TOP];
+    uint32_t timeouts;
+    int n = ui_lock_get_top(top, UI_LOCK_TOP, &timeouts);
+    for (int i = 0; i < n; i++)
+    {
+        ESP_LOGI(TAG, "lock %s:%d %lu holds, avg %.1f ms, max %.1f ms (%s), %lu over %d ms", top[i].func, top[i].line,
+                 (unsigned long)top[i].holds, top[i].total_us / 1000.0 / top[i].holds, top[i].max_us / 1000.0,
+                 top[i].task, (unsigned long)top[i].over, UI_LOCK_WARN_US / 1000);
+    }
+    if (timeouts)
+    {
+        ESP_LOGI(TAG, "lock %lu ui_lock timeouts", (unsigned long)timeouts);
+    }
+}
+
+// 浮层本身每500ms改一次文字 会引起一小块重画 算在被统计的界面里
+static void perf_overlay_timer_cb(lv_timer_t *t)
+{
+    int s = perf_screen();
+    ui_perf_summary_t r, f, l;
+    uint32_t refr, miss;
+    ui_perf_get(s, UI_PERF_RENDER, &r);
+    ui_perf_get(s, UI_PERF_FLUSH, &f);
+    ui_perf_get(s, UI_PERF_LOCK, &l);
+    ui_perf_get_misses(s, &refr, &miss);
+    char text[UI_PERF_OVERLAY_TEXT];
+    int n = snprintf(text, sizeof(text), "%s\nR %lu/%lu/%lu\nF %lu/%lu/%lu\nL %lu/%lu/%lu\nmiss %lu%%",
+                     perf_name(s),
+                     (unsigned long)r.p50_us / 100, (unsigned long)r.p95_us / 100, (unsigned long)r.p99_us / 100,
+                     (unsigned long)f.p50_us / 100, (unsigned long)f.p95_us / 100, (unsigned long)f.p99_us / 100,
+                     (unsigned long)l.p50_us / 100, (unsigned long)l.p95_us / 100, (unsigned long)l.p99_us / 100,
+                     (unsigned long)(refr ? miss * 100 / refr : 0));
+    if (s_extra && n > 0 && n < (int)sizeof(text) - 2)
+    {
+        text[n++] = '\n';
+        s_extra(text + n, sizeof(text) - n);
+    }
+    lv_label_set_text(s_overlay, text);
+}
+
+void ui_perf_overlay_set_extra(ui_perf_overlay_fmt_t fmt)
+{
+    s_extra = fmt;
+}
+
+void ui_perf_overlay_show(bool show)
+{
+    if (show && s_overlay == NULL)
+    {
+        // 放在系统层 切换应用界面时不会被删掉 数值单位是0.1ms
+        s_overlay = lv_label_create(lv_layer_sys());
+        lv_obj_set_style_bg_color(s_overlay, lv_color_hex(0x000000), 0);
+        lv_obj_set_style_bg_opa(s_overlay, LV_OPA_70, 0);
+        lv_obj_set_style_text_color(s_overlay, lv_color_hex(0x00ff00), 0);
+        lv_obj_set_style_text_font(s_overlay, &lv_font_montserrat_14, 0);
+        lv_obj_set_style_pad_all(s_overlay, 2, 0);
+        lv_obj_align(s_overlay, LV_ALIGN_BOTTOM_RIGHT, 0, 0);
+        lv_obj_clear_flag(s_overlay, LV_OBJ_FLAG_CLICKABLE);
+        s_overlay_timer = lv_timer_create(perf_overlay_timer_cb, UI_PERF_OVERLAY_MS, NULL);
+        perf_overlay_timer_cb(s_overlay_timer);
+    }
+    else if (!show && s_overlay)
+    {
+        lv_timer_del(s_overlay_timer);
+        lv_obj_del(s_overlay);
+        s_overlay_timer = NULL;
+        s_overlay = NULL;
+    }
+}
+
+void ui_perf_overlay_toggle(void)
+{
+    ui_perf_overlay_show(s_overlay == NULL);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl.h"
+
+
+/*********************** 界面性能统计 ****************************/
+// 每个应用界面分别统计 渲染耗时 发送耗时 等LVGL锁的时间 三个直方图
+// 桶按对数分布 取p50/p95/p99 超过刷新周期(CONFIG_LV_DISP_DEF_REFR_PERIOD)算一次掉帧
+// 每个直方图满UI_PERF_WINDOW个样本后全部减半 保持是最近一段时间的分布
+
+#define UI_PERF_SCREENS         9       // 主界面加8个应用 和icon_flag对应
+#define UI_PERF_BUCKETS         20
+#define UI_PERF_WINDOW          512
+#define UI_PERF_OVERLAY_TEXT    256     // 浮层文字 包括其他模块加的几行
+
+// LVGL锁的持有 ui_lock记下是哪个任务在哪个函数哪一行拿的 放开时按调用处累计
+// 持有超过一帧(UI_LOCK_WARN_US)打警告 还没放开就已经超过UI_LOCK_STUCK_MS的由定时器先报出来 这时界面是卡住的
+// 只认ui_lock拿的 LVGL任务自己在lv_timer_handler外面拿的锁算在渲染里
+#define UI_LOCK_SITES           24      // 记多少个调用处 满了顶掉最轻的
+#define UI_LOCK_TOP             6       // ui_perf_log打最重的几个
+#define UI_LOCK_WARN_US         (CONFIG_LV_DISP_DEF_REFR_PERIOD * 1000)
+#define UI_LOCK_STUCK_MS        250
+#define UI_LOCK_WATCH_MS        100     // 看门狗多久看一次
+#define UI_LOCK_WARN_GAP_MS     10000   // 同一个调用处不是更重的 这么久才再警告一次
+
+typedef enum {
+    UI_PERF_RENDER,                     // LVGL画一次刷新的时间 不含等传输
+    UI_PERF_FLUSH,                      // 这次刷新在SPI链路上忙的时间
+    UI_PERF_LOCK,                       // 其他任务在ui_lock里等锁的时间
+    UI_PERF_METRICS,
+} ui_perf_metric_t;
+
+typedef struct {
+    const char *func;                   // 拿锁的函数 和行号一起算一个调用处
+    int line;
+    char task[16];                      // 最长那一次是哪个任务
+    uint32_t holds;
+    uint32_t over;                      // 超过UI_LOCK_WARN_US的次数
+    uint64_t total_us;
+    uint32_t max_us;
+} ui_lock_site_t;
+
+typedef struct {
+    uint32_t samples;                   // 窗口内的样本数
+    uint32_t p50_us;                    // 分位数 取所在桶的上界
+    uint32_t p95_us;
+    uint32_t p99_us;
+    uint32_t max_us;                    // 窗口内的最大值
+} ui_perf_summary_t;
+
+// names: 每个界面的名字 current_screen: 返回当前界面的编号 0..count-1
+void ui_perf_init(const char *const *names, int count, int (*current_screen)(void));
+// 代替lvgl_port_lock 顺便统计等锁时间 记下持有者 timeout_ms是0一直等
+#define ui_lock(timeout_ms) ui_lock_at(timeout_ms, __func__, __LINE__)
+bool ui_lock_at(uint32_t timeout_ms, const char *func, int line);
+void ui_unlock(void);
+// 按最长一次持有从大到小 返回个数 timeouts拿回ui_lock超时的次数 可以是NULL
+int ui_lock_get_top(ui_lock_site_t *out, int max, uint32_t *timeouts);
+// 现在谁拿着锁 没人拿返回false func line task是持有者 max_us是已经拿了多久
+bool ui_lock_get_holder(ui_lock_site_t *out);
+void ui_perf_get(int screen, ui_perf_metric_t metric, ui_perf_summary_t *out);
+void ui_perf_get_misses(int screen, uint32_t *refreshes, uint32_t *misses);
+// 开机以来的刷新次数和渲染时间 不减半 算一段时间的帧率和渲染占用
+void ui_perf_get_totals(uint32_t *frames, uint64_t *render_us);
+void ui_perf_log(void);                 // 每个有数据的界面打印一行
+void ui_perf_overlay_show(bool show);   // 要在持有LVGL锁时调用
+void ui_perf_overlay_toggle(void);
+// 其他模块在浮层下面加几行 fmt在LVGL任务里每次刷新浮层时调用 往buf里写不超过len的以0结尾的文字
+typedef void (*ui_perf_overlay_fmt_t)(char *buf, size_t len);
+void ui_perf_overlay_set_extra(ui_perf_overlay_fmt_t fmt);
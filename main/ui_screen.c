@@ -0,0 +1,287 @@
+#include <string.h>
+#include "ui_screen.h"
+#include "ui_theme.h"
+#include "ui_trans.h"
+#include "heap_audit.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "ui_screen";
+
+typedef struct {
+    const ui_screen_desc_t *desc;
+    lv_obj_t *root;
+    bool active;
+    bool cold;                          // 这次进入是否重建了
+    int64_t enter_us;                   // 等待第一次完整绘制 0表示没有在等
+    int64_t left_us;                    // 最近一次退出的时刻 回收时先删最久的
+    ui_screen_stats_t stats;
+} ui_screen_t;
+
+static ui_screen_t s_screens[UI_SCREEN_MAX];
+static ui_screen_home_cb_t s_home_cb;
+static bool s_home_visible = true;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool screen_low_memory(void)
+{
+    return heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < UI_SCREEN_MIN_FREE;
+}
+
+// except是要进的界面 不回收它自己
+static int screen_oldest_hidden(int except)
+{
+    int oldest = -1;
+    for (int i = 1; i < UI_SCREEN_MAX; i++)
+    {
+        ui_screen_t *s = &s_screens[i];
+        if (i != except && s->root && !s->active && (oldest < 0 || s->left_us < s_screens[oldest].left_us))
+        {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+// 要进的界面说了要多少PSRAM 不够就按最久没用的顺序回收
+static void screen_psram_reserve(int id, const ui_screen_desc_t *desc)
+{
+    size_t need = (size_t)desc->psram_kb * 1024;
+    int oldest;
+    while (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < need && (oldest = screen_oldest_hidden(id)) >= 0)
+    {
+        ESP_LOGI(TAG, "%s needs %u KB PSRAM, evicting %s", desc->name, desc->psram_kb, s_screens[oldest].desc->name);
+        ui_screen_evict(oldest);
+    }
+    if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < need)
+    {
+        ESP_LOGW(TAG, "%s needs %u KB PSRAM, %u KB free", desc->name, desc->psram_kb,
+                 (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024);
+    }
+}
+
+// 根对象每画完一块就会收到 最后一个区域的最后一块画完时 整个界面才算出来了
+static void screen_draw_cb(lv_event_t *e)
+{
+    ui_screen_t *s = lv_event_get_user_data(e);
+    lv_disp_t *disp = lv_obj_get_disp(s->root);
+    if (s->enter_us == 0 || !disp->driver->draw_buf->last_area || !disp->driver->draw_buf->last_part)
+    {
+        return;
+    }
+    uint32_t us = esp_timer_get_time() - s->enter_us;
+    s->enter_us = 0;
+    portENTER_CRITICAL(&s_lock);
+    s->stats.last_us = us;
+    if (us > s->stats.max_us)
+    {
+        s->stats.max_us = us;
+    }
+    if (s->cold)
+    {
+        s->stats.cold_us_total += us;
+    }
+    else
+    {
+        s->stats.warm_us_total += us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 主界面没有自己的根对象 没有应用开着就是它在显示
+static void screen_home_update(void)
+{
+    bool visible = true;
+    for (int i = 1; i < UI_SCREEN_MAX; i++)
+    {
+        if (s_screens[i].active)
+        {
+            visible = false;
+            break;
+        }
+    }
+    if (visible != s_home_visible)
+    {
+        s_home_visible = visible;
+        if (s_home_cb)
+        {
+            s_home_cb(visible);
+        }
+    }
+}
+
+void ui_screen_set_home_cb(ui_screen_home_cb_t cb)
+{
+    s_home_cb = cb;
+}
+
+bool ui_screen_home_visible(void)
+{
+    return s_home_visible;
+}
+
+static lv_obj_t *screen_create_root(ui_screen_t *s)
+{
+    lv_obj_t *root = lv_obj_create(lv_scr_act());
+    lv_obj_add_style(root, ui_style(UI_STYLE_SCREEN), 0);
+    if (s->desc->bg_color != 0xffffff)
+    {
+        lv_obj_set_style_bg_color(root, lv_color_hex(s->desc->bg_color), 0); // 共享样式是白底 其他颜色才需要本地属性
+    }
+    lv_obj_add_event_cb(root, screen_draw_cb, LV_EVENT_DRAW_POST_END, s);
+    return root;
+}
+
+lv_obj_t *ui_screen_enter(int id, const ui_screen_desc_t *desc)
+{
+    if (id <= 0 || id >= UI_SCREEN_MAX)
+    {
+        return NULL;
+    }
+    ui_trans_begin(UI_TRANS_FORWARD);
+    screen_psram_reserve(id, desc);
+    ui_screen_t *s = &s_screens[id];
+    s->desc = desc;
+    s->enter_us = esp_timer_get_time();
+    s->cold = s->root == NULL;
+#if CONFIG_APP_HEAP_AUDIT
+    heap_audit_enter(id, desc->name, s->cold);
+#endif
+    if (!s->active)
+    {
+        app_res_acquire(desc->res); // 摄像头这些要在建界面之前起来
+    }
+    if (s->cold)
+    {
+        ui_screen_trim(); // 先给新界面腾地方
+        s->root = screen_create_root(s);
+        desc->build(s->root);
+    }
+    else
+    {
+        lv_obj_clear_flag(s->root, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_move_foreground(s->root);
+    }
+    s->active = true;
+    screen_home_update();
+    if (desc->enter)
+    {
+        desc->enter(s->root);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s->stats.entries++;
+    if (s->cold)
+    {
+        s->stats.builds++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return s->root;
+}
+
+void ui_screen_leave(int id)
+{
+    if (id <= 0 || id >= UI_SCREEN_MAX || !s_screens[id].active)
+    {
+        return;
+    }
+    ui_trans_begin(UI_TRANS_BACK);
+    ui_screen_t *s = &s_screens[id];
+    s->active = false;
+    s->enter_us = 0;
+    if (s->desc->leave)
+    {
+        s->desc->leave(s->root);
+    }
+    lv_obj_add_flag(s->root, LV_OBJ_FLAG_HIDDEN);
+    app_res_release(s->desc->res);
+    s->left_us = esp_timer_get_time();
+    screen_home_update();
+    ui_screen_trim();
+#if CONFIG_APP_HEAP_AUDIT
+    heap_audit_leave(id);
+#endif
+}
+
+void ui_screen_evict(int id)
+{
+    if (id <= 0 || id >= UI_SCREEN_MAX || s_screens[id].root == NULL)
+    {
+        return;
+    }
+    ui_screen_t *s = &s_screens[id];
+    if (s->active)
+    {
+        s->active = false;
+        if (s->desc->leave)
+        {
+            s->desc->leave(s->root);
+        }
+        app_res_release(s->desc->res);
+    }
+    lv_obj_del(s->root);
+    s->root = NULL;
+    s->enter_us = 0;
+    screen_home_update();
+    if (s->desc->evicted)
+    {
+        s->desc->evicted();
+    }
+    portENTER_CRITICAL(&s_lock);
+    s->stats.evictions++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ui_screen_trim(void)
+{
+    while (screen_low_memory())
+    {
+        int oldest = screen_oldest_hidden(0);
+        if (oldest < 0)
+        {
+            return;
+        }
+        ESP_LOGI(TAG, "low memory (%u bytes internal free), evicting %s", (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+                 s_screens[oldest].desc->name);
+        ui_screen_evict(oldest);
+    }
+}
+
+bool ui_screen_is_active(int id)
+{
+    return id > 0 && id < UI_SCREEN_MAX && s_screens[id].active;
+}
+
+void ui_screen_get_stats(int id, ui_screen_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (id <= 0 || id >= UI_SCREEN_MAX)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_screens[id].stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void ui_screen_log(void)
+{
+    for (int i = 1; i < UI_SCREEN_MAX; i++)
+    {
+        ui_screen_stats_t st;
+        ui_screen_get_stats(i, &st);
+        if (st.entries == 0)
+        {
+            continue;
+        }
+        uint32_t warm = st.entries - st.builds;
+        ESP_LOGI(TAG, "%-8s %lu entries: cold %lu avg %.1f ms, warm %lu avg %.1f ms, last %.1f ms, max %.1f ms, %lu evicted%s",
+                 s_screens[i].desc ? s_screens[i].desc->name : "?", (unsigned long)st.entries,
+                 (unsigned long)st.builds, st.builds ? st.cold_us_total / 1000.0 / st.builds : 0.0,
+                 (unsigned long)warm, warm ? st.warm_us_total / 1000.0 / warm : 0.0,
+                 st.last_us / 1000.0, st.max_us / 1000.0, (unsigned long)st.evictions,
+                 s_screens[i].root ? "" : " (not resident)");
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "app_res.h"
+
+
+/*********************** 应用界面管理 ****************************/
+// 每个应用的界面第一次进入时才创建 退出时只隐藏 再次进入直接显示
+// 内部RAM低于UI_SCREEN_MIN_FREE时 按最久没用的顺序删掉隐藏的界面 下次进入再重建
+// 进入耗时从调用ui_screen_enter到这个界面第一次完整画完 冷启动和再次进入分开统计
+// 界面声明要用的外设(app_res)和PSRAM 进入时拿 退出或者被回收时还
+
+#define UI_SCREEN_MAX           12          // 和icon_flag对应 0是主界面不用
+#define UI_SCREEN_MIN_FREE      (48 * 1024) // 内部RAM剩余低于这个值就开始回收隐藏的界面
+
+typedef struct {
+    const char *name;
+    uint32_t bg_color;                  // 界面背景色
+    uint32_t res;                       // 要用的外设 APP_RES_BIT 进入前拿到 退出后还
+    uint16_t psram_kb;                  // 进入前PSRAM至少要剩这么多 不够先回收隐藏的界面
+    void (*build)(lv_obj_t *root);      // 第一次进入或被回收后再进入时 创建子控件
+    void (*enter)(lv_obj_t *root);      // 每次进入 启动定时器/任务 刷新内容 可为NULL
+    void (*leave)(lv_obj_t *root);      // 每次退出 停掉enter里启动的东西 可为NULL
+    void (*evicted)(void);              // 界面被删除后 清掉指向其中控件的全局指针 可为NULL
+} ui_screen_desc_t;
+
+typedef struct {
+    uint32_t entries;
+    uint32_t builds;                    // 需要重建的进入次数 包括第一次
+    uint32_t evictions;
+    uint32_t cold_us_total;             // 重建的进入 总耗时
+    uint32_t warm_us_total;             // 直接显示的进入 总耗时
+    uint32_t last_us;
+    uint32_t max_us;
+} ui_screen_stats_t;
+
+typedef void (*ui_screen_home_cb_t)(bool visible);    // 主界面露出来或被应用盖住 在LVGL任务里
+
+// 以下函数都要在LVGL任务里或持有LVGL锁时调用
+lv_obj_t *ui_screen_enter(int id, const ui_screen_desc_t *desc);   // 返回界面根对象
+void ui_screen_leave(int id);
+void ui_screen_evict(int id);           // 马上删除 正在显示的会先调用leave
+void ui_screen_trim(void);              // 内存不够时回收隐藏的界面
+bool ui_screen_is_active(int id);
+bool ui_screen_home_visible(void);      // 没有应用开着
+void ui_screen_set_home_cb(ui_screen_home_cb_t cb);     // 主界面上的定时器只在露出来时跑
+void ui_screen_get_stats(int id, ui_screen_stats_t *stats);
+void ui_screen_log(void);
@@ -0,0 +1,113 @@
+#include "ui_scroll.h"
+
+#define SCROLL_FLING_MIN        2       // 松手时每帧移动超过这么多像素才惯性滑动
+#define SCROLL_FLING_FRAMES     20      // 按最后一帧的速度再滑这么多帧的距离
+#define SCROLL_FLING_MS         400
+
+static ui_scroll_t *scroll_of(lv_obj_t *obj)
+{
+    return lv_obj_get_user_data(obj);
+}
+
+static void scroll_anim_cb(void *var, int32_t value)
+{
+    lv_obj_t *obj = var;
+    ui_scroll_t *s = scroll_of(obj);
+    s->offset = value;
+    s->layout_cb(obj);
+}
+
+void ui_scroll_init(ui_scroll_t *s, ui_scroll_layout_cb_t layout_cb)
+{
+    s->offset = 0;
+    s->drag = 0;
+    s->velocity = 0;
+    s->layout_cb = layout_cb;
+}
+
+void ui_scroll_clamp(ui_scroll_t *s, int32_t max)
+{
+    if (s->offset > max)
+    {
+        s->offset = max;
+    }
+    if (s->offset < 0)
+    {
+        s->offset = 0;
+    }
+}
+
+void ui_scroll_stop(lv_obj_t *obj)
+{
+    lv_anim_del(obj, scroll_anim_cb);
+}
+
+void ui_scroll_to(lv_obj_t *obj, int32_t offset)
+{
+    ui_scroll_t *s = scroll_of(obj);
+    lv_anim_del(obj, scroll_anim_cb);
+    s->offset = offset;
+    s->layout_cb(obj);
+}
+
+bool ui_scroll_dragged(lv_obj_t *obj)
+{
+    return scroll_of(obj)->drag >= UI_SCROLL_CLICK_SLOP;
+}
+
+bool ui_scroll_event(lv_obj_t *obj, lv_event_code_t code)
+{
+    ui_scroll_t *s = scroll_of(obj);
+    if (code == LV_EVENT_PRESSED)
+    {
+        lv_anim_del(obj, scroll_anim_cb);
+        s->drag = 0;
+        s->velocity = 0;
+    }
+    else if (code == LV_EVENT_PRESSING)
+    {
+        lv_point_t vect;
+        lv_indev_get_vect(lv_indev_get_act(), &vect);
+        if (vect.y)
+        {
+            s->drag += LV_ABS(vect.y);
+            s->velocity = -vect.y;
+            s->offset -= vect.y;
+            s->layout_cb(obj);
+        }
+    }
+    else if (code == LV_EVENT_RELEASED)
+    {
+        if (s->drag < UI_SCROLL_CLICK_SLOP)
+        {
+            return true;
+        }
+        if (LV_ABS(s->velocity) > SCROLL_FLING_MIN)
+        {
+            // 惯性滚动 按最后一帧的速度再滑一段 超出两头由layout_cb里的clamp挡住
+            lv_anim_t a;
+            lv_anim_init(&a);
+            lv_anim_set_var(&a, obj);
+            lv_anim_set_exec_cb(&a, scroll_anim_cb);
+            lv_anim_set_values(&a, s->offset, s->offset + s->velocity * SCROLL_FLING_FRAMES);
+            lv_anim_set_time(&a, SCROLL_FLING_MS);
+            lv_anim_set_path_cb(&a, lv_anim_path_ease_out);
+            lv_anim_start(&a);
+        }
+    }
+    else if (code == LV_EVENT_DELETE)
+    {
+        lv_anim_del(obj, scroll_anim_cb);
+    }
+    return false;
+}
+
+void ui_scroll_point(lv_obj_t *obj, int32_t *x, int32_t *y)
+{
+    lv_point_t p;
+    lv_area_t area;
+    lv_indev_get_point(lv_indev_get_act(), &p);
+    lv_obj_get_content_coords(obj, &area);
+    *x = p.x - area.x1;
+    *y = scroll_of(obj)->offset + p.y - area.y1;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** 虚拟控件共用的竖直滚动 ****************************/
+// ui_vlist和ui_vgrid共用 拖动 松手后的惯性滑动和点击判断都在这里 控件只管按offset摆放自己复用的行或格子
+// 滚动位置用int32保存 不受lv_coord_t(16位)的内容高度限制
+// ui_scroll_t要放在控件结构体的第一个 控件对象的user_data指向这个结构体 动画回调靠它找到滚动状态
+// 都在LVGL任务里或持有LVGL锁时调
+
+#define UI_SCROLL_CLICK_SLOP    8       // 拖动超过这个距离就不算点击(像素)
+
+typedef void (*ui_scroll_layout_cb_t)(lv_obj_t *obj);  // 滚动位置变了 控件按offset重新摆放 先调ui_scroll_clamp
+
+typedef struct {
+    int32_t offset;                     // 滚动位置(像素)
+    int32_t drag;                       // 本次按下后累计拖动的距离
+    int32_t velocity;                   // 松手时的速度 用于惯性滚动
+    ui_scroll_layout_cb_t layout_cb;
+} ui_scroll_t;
+
+void ui_scroll_init(ui_scroll_t *s, ui_scroll_layout_cb_t layout_cb);
+void ui_scroll_clamp(ui_scroll_t *s, int32_t max);             // offset限制在[0, max]
+void ui_scroll_stop(lv_obj_t *obj);                             // 停掉惯性滑动 删除控件时也要调
+void ui_scroll_to(lv_obj_t *obj, int32_t offset);               // 停掉惯性滑动 跳到offset 再摆放
+// 控件的事件回调里先交给它 拖动和惯性滑动在这里处理 返回true表示这次松手是点击
+bool ui_scroll_event(lv_obj_t *obj, lv_event_code_t code);
+bool ui_scroll_dragged(lv_obj_t *obj);                          // 本次按下后拖动过 不算点击和长按
+// 按下的点在内容里的坐标 y算上了滚动位置
+void ui_scroll_point(lv_obj_t *obj, int32_t *x, int32_t *y);
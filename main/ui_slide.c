@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "ui_slide.h"
+#include "task_plan.h"
+#include "pic_cache.h"
+#include "lcd_draw.h"
+#include "mem_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_slide";
+
+#define SLIDE_TIMER_MS      10
+
+typedef enum {
+    SLIDE_JOB_IDLE,
+    SLIDE_JOB_PENDING,                  // 任务在解 路径和缓冲归任务
+    SLIDE_JOB_DONE,
+    SLIDE_JOB_FAILED,
+} slide_job_t;
+
+typedef struct {
+    // 两边共用
+    uint8_t refs;                       // 控件和解码任务各一份 最后放手的一方释放
+    volatile bool quit;
+    volatile slide_job_t job;
+    char path[PIC_CACHE_PATH_LEN];
+    uint16_t *job_buf;
+    lv_coord_t w;
+    lv_coord_t h;
+    uint16_t *bufs[3];
+    TaskHandle_t task;
+    // 只在LVGL任务里用
+    lv_obj_t *obj;
+    lv_timer_t *timer;
+    lv_img_dsc_t dsc;
+    uint16_t *cur;
+    uint16_t *next;
+    uint16_t *out;
+    ui_slide_path_cb_t path_cb;
+    int count;
+    int index;
+    int next_index;
+    int fails;                          // 连续解不出来的张数 一圈都不行就不再试
+    int64_t due;                        // 下一次开始切换的时刻
+    int64_t fade_t0;
+    uint32_t fade_a;
+    bool fading;
+    bool late;
+} slide_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ui_slide_stats_t s_stats;
+
+static void slide_put(slide_t *s)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool last = --s->refs == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!last)
+    {
+        return;
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        mem_pool_free(s->bufs[i]);
+    }
+    free(s);
+}
+
+static void slide_set_job(slide_t *s, slide_job_t job)
+{
+    portENTER_CRITICAL(&s_lock);
+    s->job = job;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/************ 解码任务 ************/
+// 白底居中 比缓冲大的按比例缩小 取最近的点 带alpha的合成到白底上
+static void slide_compose(uint16_t *dst, lv_coord_t w, lv_coord_t h, const lv_img_dsc_t *img)
+{
+    lv_color_t white = lv_color_white();
+    lcd_draw_fill16(dst, white.full, (size_t)w * h);
+    uint32_t iw = img->header.w;
+    uint32_t ih = img->header.h;
+    bool alpha = img->header.cf == LV_IMG_CF_TRUE_COLOR_ALPHA;
+    uint32_t px_size = alpha ? LV_IMG_PX_SIZE_ALPHA_BYTE : sizeof(lv_color_t);
+
+    // step是目标一个像素对应多少个源像素 16位小数
+    uint32_t step = 1 << 16;
+    if (iw > (uint32_t)w || ih > (uint32_t)h)
+    {
+        step = LV_MAX((iw << 16) / w, (ih << 16) / h) + 1;
+    }
+    uint32_t dw = LV_MIN((iw << 16) / step, (uint32_t)w);
+    uint32_t dh = LV_MIN((ih << 16) / step, (uint32_t)h);
+    uint16_t *base = dst + (size_t)((h - dh) / 2) * w + (w - dw) / 2;
+    for (uint32_t y = 0; y < dh; y++)
+    {
+        const uint8_t *row = img->data + (size_t)((y * step) >> 16) * iw * px_size;
+        uint16_t *d = base + (size_t)y * w;
+        if (step == 1 << 16 && !alpha)
+        {
+            memcpy(d, row, dw * sizeof(uint16_t));
+            continue;
+        }
+        uint32_t sx = 0;
+        for (uint32_t x = 0; x < dw; x++, sx += step)
+        {
+            const uint8_t *p = row + (sx >> 16) * px_size;
+            lv_color_t c;
+            memcpy(&c, p, sizeof(c));
+            d[x] = alpha ? lv_color_mix(c, white, p[sizeof(c)]).full : c.full;
+        }
+    }
+}
+
+static void slide_task(void *arg)
+{
+    slide_t *s = arg;
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (s->quit)
+        {
+            break;
+        }
+        if (s->job != SLIDE_JOB_PENDING)
+        {
+            continue;
+        }
+        int64_t t0 = esp_timer_get_time();
+        lv_img_dsc_t img;
+        bool ok = pic_cache_decode(s->path, &img);
+        if (ok)
+        {
+            slide_compose(s->job_buf, s->w, s->h, &img);
+            heap_caps_free((void *)img.data);
+        }
+        uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+        portENTER_CRITICAL(&s_lock);
+        if (ok)
+        {
+            s_stats.decoded++;
+            s_stats.decode_us += us;
+            if (us > s_stats.max_decode_us)
+            {
+                s_stats.max_decode_us = us;
+            }
+        }
+        else
+        {
+            s_stats.failed++;
+        }
+        s->job = ok ? SLIDE_JOB_DONE : SLIDE_JOB_FAILED;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    slide_put(s);
+    vTaskDelete(NULL);
+}
+
+/************ LVGL任务 ************/
+static void slide_request(slide_t *s, int index)
+{
+    s->next_index = (index % s->count + s->count) % s->count;
+    if (!s->path_cb(s->next_index, s->path, sizeof(s->path)))
+    {
+        slide_set_job(s, SLIDE_JOB_FAILED);
+        return;
+    }
+    s->job_buf = s->next;
+    slide_set_job(s, SLIDE_JOB_PENDING);
+    xTaskNotifyGive(s->task);
+}
+
+static void slide_show(slide_t *s, uint16_t *buf)
+{
+    s->dsc.data = (const uint8_t *)buf;
+    lv_img_cache_invalidate_src(&s->dsc);
+    lv_obj_invalidate(s->obj);
+}
+
+// 淡入淡出结束 下一张变成当前 空出来的缓冲马上拿去解再下一张
+static void slide_finish(slide_t *s)
+{
+    uint16_t *old = s->cur;
+    s->cur = s->next;
+    s->next = old;
+    s->index = s->next_index;
+    s->fading = false;
+    slide_show(s, s->cur);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.slides++;
+    portEXIT_CRITICAL(&s_lock);
+    if (s->count > 1)
+    {
+        slide_request(s, s->index + 1);
+    }
+    else
+    {
+        slide_set_job(s, SLIDE_JOB_IDLE);
+    }
+}
+
+static void slide_fade_step(slide_t *s, int64_t now)
+{
+    int64_t t = now - s->fade_t0;
+    int64_t fade_us = LV_MAX(UI_SLIDE_FADE_MS, 1) * 1000LL;
+    uint32_t a = (t >= fade_us) ? 32 : (uint32_t)(t * 32 / fade_us);
+    if (a >= 32)
+    {
+        slide_finish(s);
+        return;
+    }
+    if (a == s->fade_a)
+    {
+        return;
+    }
+    s->fade_a = a;
+    int64_t t0 = esp_timer_get_time();
+    lcd_draw_mix16(s->out, s->next, s->cur, (size_t)s->w * s->h, a);
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.fade_steps++;
+    s_stats.blend_us += us;
+    portEXIT_CRITICAL(&s_lock);
+    slide_show(s, s->out);
+}
+
+static void slide_timer_cb(lv_timer_t *t)
+{
+    slide_t *s = t->user_data;
+    int64_t now = esp_timer_get_time();
+    if (s->fading)
+    {
+        slide_fade_step(s, now);
+        return;
+    }
+    if (now < s->due || s->job == SLIDE_JOB_IDLE)
+    {
+        return;
+    }
+    if (s->job == SLIDE_JOB_PENDING)
+    {
+        if (!s->late)
+        {
+            s->late = true;
+            portENTER_CRITICAL(&s_lock);
+            s_stats.late++;
+            portEXIT_CRITICAL(&s_lock);
+        }
+        return;
+    }
+    if (s->job == SLIDE_JOB_FAILED)
+    {
+        if (++s->fails >= s->count)
+        {
+            ESP_LOGW(TAG, "no decodable image, stopping");
+            slide_set_job(s, SLIDE_JOB_IDLE);
+            return;
+        }
+        slide_request(s, s->next_index + 1);
+        return;
+    }
+
+    // 下一张好了 按预定时刻往后排 晚了超过一个间隔就从现在重新算 不连着补切
+    s->fails = 0;
+    uint32_t late_ms = (uint32_t)((now - s->due) / 1000);
+    portENTER_CRITICAL(&s_lock);
+    if (late_ms > s_stats.max_late_ms)
+    {
+        s_stats.max_late_ms = late_ms;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    s->due += UI_SLIDE_INTERVAL_MS * 1000LL;
+    if (s->due <= now)
+    {
+        s->due = now + UI_SLIDE_INTERVAL_MS * 1000LL;
+    }
+    s->late = false;
+    s->fading = true;
+    s->fade_t0 = now;
+    s->fade_a = 0;
+    if (UI_SLIDE_FADE_MS == 0)
+    {
+        slide_finish(s);
+    }
+}
+
+static void slide_event_cb(lv_event_t *e)
+{
+    slide_t *s = lv_event_get_user_data(e);
+    if (lv_event_get_code(e) != LV_EVENT_DELETE)
+    {
+        return;
+    }
+    lv_timer_del(s->timer);
+    s->obj = NULL;
+    s->quit = true;
+    if (s->task)
+    {
+        xTaskNotifyGive(s->task);
+    }
+    slide_put(s);
+}
+
+lv_obj_t *ui_slide_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, int count, int start, ui_slide_path_cb_t path_cb)
+{
+    lv_obj_t *obj = lv_img_create(parent);
+    lv_obj_set_size(obj, w, h);
+    lv_obj_add_flag(obj, LV_OBJ_FLAG_CLICKABLE);
+    if (count <= 0)
+    {
+        return obj;
+    }
+
+    slide_t *s = calloc(1, sizeof(*s));
+    bool ok = s != NULL;
+    for (int i = 0; ok && i < 3; i++)
+    {
+        s->bufs[i] = mem_pool_alloc(MEM_POOL_MEDIA, (size_t)w * h * sizeof(uint16_t));
+        ok = s->bufs[i] != NULL;
+    }
+    if (!ok)
+    {
+        ESP_LOGE(TAG, "no memory for %dx%d buffers", w, h);
+        if (s)
+        {
+            s->refs = 1;
+            slide_put(s);
+        }
+        return obj;
+    }
+    s->obj = obj;
+    s->w = w;
+    s->h = h;
+    s->count = count;
+    s->index = (start % count + count) % count;
+    s->path_cb = path_cb;
+    s->cur = s->bufs[0];
+    s->next = s->bufs[1];
+    s->out = s->bufs[2];
+    // 第一张从白屏淡入 解完马上开始
+    lcd_draw_fill16(s->cur, lv_color_white().full, (size_t)w * h);
+    s->dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    s->dsc.header.w = w;
+    s->dsc.header.h = h;
+    s->dsc.data_size = (uint32_t)w * h * sizeof(uint16_t);
+    s->dsc.data = (const uint8_t *)s->cur;
+    s->refs = 2;
+    if (task_plan_create(TASK_UI_SLIDE, slide_task, s, &s->task) != pdPASS)
+    {
+        ESP_LOGE(TAG, "decode task start failed");
+        s->refs = 1;
+        slide_put(s);
+        return obj;
+    }
+    lv_img_set_src(obj, &s->dsc);
+    lv_obj_set_user_data(obj, s);
+    s->timer = lv_timer_create(slide_timer_cb, SLIDE_TIMER_MS, s);
+    lv_obj_add_event_cb(obj, slide_event_cb, LV_EVENT_DELETE, s);
+    s->due = esp_timer_get_time();
+    slide_request(s, s->index);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.shows++;
+    portEXIT_CRITICAL(&s_lock);
+    return obj;
+}
+
+int ui_slide_get_index(lv_obj_t *obj)
+{
+    slide_t *s = lv_obj_get_user_data(obj);
+    return s ? s->index : 0;
+}
+
+void ui_slide_get_stats(ui_slide_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+
+/*********************** 图库幻灯片 ****************************/
+// 三块和控件一样大的RGB565缓冲: 正在显示的 下一张 淡入淡出时的输出
+// 显示第N张的时候core 0上的任务已经把N+1解码 缩放 居中画进下一张的缓冲
+// 切换时每一步用lcd_draw_mix16把两张按比例混进输出缓冲 不让LVGL每帧给整张图做透明度
+// 切换时刻按开始时间加整数个间隔算 解码快慢不会让节奏越走越偏 下一张没解完才会晚
+
+#define UI_SLIDE_INTERVAL_MS    CONFIG_APP_SLIDESHOW_INTERVAL_MS
+#define UI_SLIDE_FADE_MS        CONFIG_APP_SLIDESHOW_FADE_MS
+
+// 取第index张图片的VFS路径 在LVGL任务里调用
+typedef bool (*ui_slide_path_cb_t)(int index, char *path, size_t len);
+
+typedef struct {
+    uint32_t shows;                     // 幻灯片开始放的次数
+    uint32_t slides;                    // 换过的张数
+    uint32_t late;                      // 到点了下一张还没解完的次数
+    uint32_t decoded;
+    uint32_t failed;                    // 解不出来跳过的
+    uint64_t decode_us;                 // 解码加缩放画进缓冲
+    uint32_t max_decode_us;
+    uint32_t fade_steps;
+    uint64_t blend_us;
+    uint32_t max_late_ms;               // 最晚的一次比预定时刻晚了多少
+} ui_slide_stats_t;
+
+// 在parent里建一个w x h的幻灯片 从第start张开始 一共count张 持有LVGL锁时调用 删掉对象就停止
+lv_obj_t *ui_slide_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, int count, int start, ui_slide_path_cb_t path_cb);
+int ui_slide_get_index(lv_obj_t *obj);  // 正在显示第几张
+void ui_slide_get_stats(ui_slide_stats_t *stats);
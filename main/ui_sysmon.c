@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ui_sysmon.h"
+#include "ui_vlist.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "sysmon";
+
+static sysmon_base_t s_ui_base;
+static sysmon_snapshot_t s_ui_snap;     // 只在LVGL任务里用
+static lv_obj_t *s_summary;
+static lv_obj_t *s_list;
+static lv_timer_t *s_timer;
+
+static int task_cmp(const void *a, const void *b)
+{
+    const sysmon_task_t *x = a, *y = b;
+    if (x->cpu_pm != y->cpu_pm)
+    {
+        return x->cpu_pm < y->cpu_pm ? 1 : -1;
+    }
+    return strcmp(x->name, y->name);
+}
+
+static uint32_t base_runtime(const sysmon_base_t *base, uint32_t number, bool *found)
+{
+    for (int i = 0; i < base->count; i++)
+    {
+        if (base->number[i] == number)
+        {
+            *found = true;
+            return base->runtime[i];
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+esp_err_t sysmon_sample(sysmon_base_t *base, sysmon_snapshot_t *out)
+{
+    // 一次两KB 每秒一次 调的人各自分配 不用加锁
+    TaskStatus_t *st = heap_caps_malloc(SYSMON_MAX_TASKS * sizeof(TaskStatus_t), MALLOC_CAP_SPIRAM);
+    if (st == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    uint32_t total;
+    int n = uxTaskGetSystemState(st, SYSMON_MAX_TASKS, &total);
+    int64_t now = esp_timer_get_time();
+    if (n == 0)
+    {
+        free(st);
+        ESP_LOGW(TAG, "more than %d tasks", SYSMON_MAX_TASKS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t elapsed = base->t_us ? now - base->t_us : 0;
+    TaskHandle_t idle[2] = {xTaskGetIdleTaskHandleForCPU(0), xTaskGetIdleTaskHandleForCPU(1)};
+    out->count = n;
+    out->elapsed_ms = elapsed / 1000;
+    out->core_pm[0] = out->core_pm[1] = 0;
+    for (int i = 0; i < n; i++)
+    {
+        sysmon_task_t *t = &out->tasks[i];
+        bool found;
+        uint32_t prev = base_runtime(base, st[i].xTaskNumber, &found);
+        uint32_t delta = st[i].ulRunTimeCounter - prev;
+        uint32_t pm = found && elapsed ? (uint64_t)delta * 1000 / elapsed : 0;
+        strlcpy(t->name, st[i].pcTaskName, sizeof(t->name));
+        t->cpu_pm = pm > 1000 ? 1000 : pm;
+        t->stack_free = st[i].usStackHighWaterMark; // 栈的单位是字节
+        t->prio = st[i].uxCurrentPriority;
+        BaseType_t core = xTaskGetAffinity(st[i].xHandle);
+        t->core = core == tskNO_AFFINITY ? -1 : core;
+        for (int c = 0; c < 2; c++)
+        {
+            if (st[i].xHandle == idle[c] && found && elapsed)
+            {
+                out->core_pm[c] = 1000 - t->cpu_pm;
+            }
+        }
+        base->number[i] = st[i].xTaskNumber;
+        base->runtime[i] = st[i].ulRunTimeCounter;
+    }
+    base->count = n;
+    base->t_us = now;
+    free(st);
+    qsort(out->tasks, n, sizeof(out->tasks[0]), task_cmp);
+    return ESP_OK;
+}
+
+void sysmon_log(void)
+{
+    static sysmon_base_t base;
+    static sysmon_snapshot_t snap;
+    if (sysmon_sample(&base, &snap) != ESP_OK)
+    {
+        return;
+    }
+    if (snap.elapsed_ms == 0)
+    {
+        ESP_LOGI(TAG, "%d tasks, baseline taken, ask again for CPU", snap.count);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "%d tasks over %lu ms, core0 %u.%u%% core1 %u.%u%%", snap.count,
+                 (unsigned long)snap.elapsed_ms, snap.core_pm[0] / 10, snap.core_pm[0] % 10, snap.core_pm[1] / 10,
+                 snap.core_pm[1] % 10);
+    }
+    for (int i = 0; i < snap.count; i++)
+    {
+        const sysmon_task_t *t = &snap.tasks[i];
+        ESP_LOGI(TAG, "  %-16s core %2d prio %2u cpu %3u.%u%% stack free %5u", t->name, t->core, t->prio,
+                 t->cpu_pm / 10, t->cpu_pm % 10, t->stack_free);
+    }
+}
+
+static void list_text(int index, char *buf, size_t len)
+{
+    if (index >= s_ui_snap.count)
+    {
+        buf[0] = 0;
+        return;
+    }
+    const sysmon_task_t *t = &s_ui_snap.tasks[index];
+    char core[4] = "-";
+    if (t->core >= 0)
+    {
+        snprintf(core, sizeof(core), "%d", t->core);
+    }
+    snprintf(buf, len, "%u.%u%%  %s  core %s  prio %u  stack %u", t->cpu_pm / 10, t->cpu_pm % 10, t->name, core,
+             t->prio, t->stack_free);
+}
+
+static void refresh_cb(lv_timer_t *timer)
+{
+    if (sysmon_sample(&s_ui_base, &s_ui_snap) != ESP_OK)
+    {
+        return;
+    }
+    lv_label_set_text_fmt(s_summary, "CPU0 %u.%u%%   CPU1 %u.%u%%   %d tasks", s_ui_snap.core_pm[0] / 10,
+                          s_ui_snap.core_pm[0] % 10, s_ui_snap.core_pm[1] / 10, s_ui_snap.core_pm[1] % 10,
+                          s_ui_snap.count);
+    ui_vlist_set_count(s_list, s_ui_snap.count);
+}
+
+void ui_sysmon_build(lv_obj_t *root)
+{
+    s_summary = lv_label_create(root);
+    lv_obj_set_style_text_font(s_summary, &lv_font_montserrat_20, 0);
+    lv_label_set_text(s_summary, "");
+    lv_obj_align(s_summary, LV_ALIGN_TOP_LEFT, 8, 44);
+
+    s_list = ui_vlist_create(root, 320, 240 - 70, SYSMON_LIST_ROW_H, list_text, NULL);
+    if (s_list == NULL)
+    {
+        return;
+    }
+    lv_obj_align(s_list, LV_ALIGN_TOP_LEFT, 0, 70);
+    lv_obj_set_style_border_width(s_list, 0, 0);
+    lv_obj_set_style_text_font(s_list, &lv_font_montserrat_14, 0);
+}
+
+void ui_sysmon_start(void)
+{
+    if (s_timer || s_list == NULL)
+    {
+        return;
+    }
+    memset(&s_ui_base, 0, sizeof(s_ui_base));
+    refresh_cb(NULL); // 先记基准 一秒后才有占用
+    s_timer = lv_timer_create(refresh_cb, SYSMON_PERIOD_MS, NULL);
+}
+
+void ui_sysmon_stop(void)
+{
+    if (s_timer)
+    {
+        lv_timer_del(s_timer);
+        s_timer = NULL;
+    }
+}
+
+void ui_sysmon_evicted(void)
+{
+    ui_sysmon_stop();
+    s_summary = NULL;
+    s_list = NULL;
+}
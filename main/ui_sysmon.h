@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "lvgl.h"
+
+
+/*********************** 系统监视 ****************************/
+// uxTaskGetSystemState取所有任务的运行时间 和上一次比得到这段时间每个任务占一个核的百分比
+// 再列出优先级 绑在哪个核 栈剩余的最低水位 栈大小和分核照着这些数调
+// 界面上是一个虚拟列表 按占用从高到低 每秒刷新一次 只在界面显示的时候采
+// 串口上也能打一遍 和界面各用各的基准 互不影响
+
+#define SYSMON_MAX_TASKS        48
+#define SYSMON_PERIOD_MS        1000
+#define SYSMON_LIST_ROW_H       24
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint16_t cpu_pm;                    // 这段时间占一个核的千分比
+    uint16_t stack_free;                // 栈剩余的最低水位 字节
+    uint8_t prio;
+    int8_t core;                        // -1 不绑核
+} sysmon_task_t;
+
+typedef struct {
+    int count;
+    uint16_t core_pm[2];                // 两个核的占用 按空闲任务算
+    uint32_t elapsed_ms;
+    sysmon_task_t tasks[SYSMON_MAX_TASKS];    // 按占用从高到低
+} sysmon_snapshot_t;
+
+// 基准 第一次调sysmon_sample只记下各任务的运行时间 占用都是0
+typedef struct {
+    uint32_t number[SYSMON_MAX_TASKS];
+    uint32_t runtime[SYSMON_MAX_TASKS];
+    int count;
+    int64_t t_us;
+} sysmon_base_t;
+
+esp_err_t sysmon_sample(sysmon_base_t *base, sysmon_snapshot_t *out);
+void sysmon_log(void);                  // 和上一次调用比 打一张表
+
+// 以下要持有LVGL锁
+void ui_sysmon_build(lv_obj_t *root);   // 标题栏下面的概要和任务列表
+void ui_sysmon_start(void);             // 进界面 开始每秒刷新
+void ui_sysmon_stop(void);
+void ui_sysmon_evicted(void);
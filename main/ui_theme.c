@@ -0,0 +1,228 @@
+#include <string.h>
+#include "ui_theme.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_theme";
+
+static lv_style_t s_styles[UI_STYLE_COUNT];
+static bool s_ready = false;
+
+// 滚轮渐隐用的两段图 上段从底色不透明到全透明 下段反过来 数据在一块内存里
+typedef struct {
+    lv_coord_t w;
+    lv_coord_t top_h;
+    lv_coord_t bottom_h;
+    lv_color_t color;
+    uint8_t *data;
+    lv_img_dsc_t top;
+    lv_img_dsc_t bottom;
+} roller_fade_t;
+
+static roller_fade_t s_fade;
+
+// 320x240 不带边框和间隙的整屏容器
+static void theme_full_screen(lv_style_t *s, lv_coord_t radius)
+{
+    lv_style_set_radius(s, radius);
+    lv_style_set_bg_opa(s, LV_OPA_COVER);
+    lv_style_set_border_width(s, 0);
+    lv_style_set_pad_all(s, 0);
+    lv_style_set_width(s, 320);
+    lv_style_set_height(s, 240);
+}
+
+void ui_theme_init(void)
+{
+    if (s_ready)
+    {
+        return;
+    }
+    for (int i = 0; i < UI_STYLE_COUNT; i++)
+    {
+        lv_style_init(&s_styles[i]);
+    }
+
+    lv_style_t *s = &s_styles[UI_STYLE_SCREEN];
+    theme_full_screen(s, 10);
+    lv_style_set_bg_color(s, lv_color_hex(0xffffff));
+
+    theme_full_screen(&s_styles[UI_STYLE_PAGE], 0);
+
+    s = &s_styles[UI_STYLE_MAIN];
+    theme_full_screen(s, 10);
+    lv_style_set_bg_color(s, lv_color_hex(0x00BFFF));
+    lv_style_set_bg_grad_color(s, lv_color_hex(0x00BF00));
+    lv_style_set_bg_grad_dir(s, LV_GRAD_DIR_VER);
+
+    s = &s_styles[UI_STYLE_APP_ICON];
+    lv_style_set_radius(s, 16);
+    lv_style_set_bg_opa(s, LV_OPA_COVER);
+    lv_style_set_text_color(s, lv_color_hex(0xffffff));
+    lv_style_set_border_width(s, 0);
+    lv_style_set_pad_all(s, 5);
+    lv_style_set_width(s, 80);
+    lv_style_set_height(s, 80);
+
+    s = &s_styles[UI_STYLE_TITLE];
+    lv_style_set_width(s, 320);
+    lv_style_set_height(s, 40);
+    lv_style_set_pad_all(s, 0);
+
+    s = &s_styles[UI_STYLE_BACK_BTN];
+    lv_style_set_width(s, 60);
+    lv_style_set_height(s, 30);
+    lv_style_set_border_width(s, 0);
+    lv_style_set_pad_all(s, 0);
+    lv_style_set_bg_opa(s, LV_OPA_TRANSP);
+    lv_style_set_shadow_opa(s, LV_OPA_TRANSP);
+
+    s = &s_styles[UI_STYLE_BACK_LABEL];
+    lv_style_set_text_font(s, &lv_font_montserrat_20);
+    lv_style_set_text_color(s, lv_color_hex(0xffffff));
+
+    s = &s_styles[UI_STYLE_BTN_BG];
+    lv_style_set_bg_opa(s, LV_OPA_100);
+    lv_style_set_bg_color(s, lv_color_make(255, 255, 255));
+    lv_style_set_shadow_width(s, 0);
+
+    lv_style_set_outline_width(&s_styles[UI_STYLE_BTN_NO_OUTLINE], 0);
+
+    s = &s_styles[UI_STYLE_CAPTURE];
+    lv_style_set_radius(s, 25);
+    lv_style_set_bg_color(s, lv_color_hex(0x000000));
+    lv_style_set_bg_opa(s, LV_OPA_40);
+    lv_style_set_border_width(s, 2);
+    lv_style_set_border_color(s, lv_color_hex(0xffffff));
+    lv_style_set_shadow_width(s, 12);
+    lv_style_set_shadow_color(s, lv_color_hex(0x000000));
+    lv_style_set_shadow_opa(s, LV_OPA_40);
+
+    s = &s_styles[UI_STYLE_CAPTURE_PRESSED];
+    lv_style_set_bg_color(s, lv_color_hex(0xffffff));
+    lv_style_set_bg_opa(s, LV_OPA_60);
+    lv_style_set_border_color(s, lv_color_hex(0x000000));
+
+    s = &s_styles[UI_STYLE_ROLLER];
+    lv_style_set_bg_color(s, lv_color_black());
+    lv_style_set_text_color(s, lv_color_white());
+    lv_style_set_border_width(s, 0);
+    lv_style_set_pad_all(s, 0);
+    lv_style_set_radius(s, 0);
+
+    s_ready = true;
+    ESP_LOGI(TAG, "%d shared styles, %lu bytes", UI_STYLE_COUNT, (unsigned long)ui_theme_mem_size());
+}
+
+lv_style_t *ui_style(ui_style_id_t id)
+{
+    if (!s_ready)
+    {
+        ui_theme_init();
+    }
+    return &s_styles[id < UI_STYLE_COUNT ? id : UI_STYLE_SCREEN];
+}
+
+uint32_t ui_theme_mem_size(void)
+{
+    // 只有一个属性时存在样式结构体里 多于一个才单独分配 每个属性一个值加一个ID
+    uint32_t bytes = 0;
+    for (int i = 0; i < UI_STYLE_COUNT; i++)
+    {
+        if (s_styles[i].prop_cnt > 1)
+        {
+            bytes += s_styles[i].prop_cnt * (sizeof(lv_style_value_t) + sizeof(uint16_t));
+        }
+    }
+    return bytes;
+}
+
+// 一段n行 第i行的不透明度 和lv_draw_mask_fade在这几行上给内容的正好互补
+static void roller_fade_fill(uint8_t *px, lv_coord_t w, lv_coord_t n, lv_color_t color, bool down)
+{
+    for (lv_coord_t i = 0; i < n; i++)
+    {
+        uint8_t a = n > 1 ? i * 255 / (n - 1) : 255;
+        a = down ? a : 255 - a;
+        for (lv_coord_t x = 0; x < w; x++)
+        {
+            memcpy(px, &color, sizeof(color));
+            px[sizeof(color)] = a;
+            px += LV_IMG_PX_SIZE_ALPHA_BYTE;
+        }
+    }
+}
+
+static void roller_fade_dsc(lv_img_dsc_t *dsc, lv_coord_t w, lv_coord_t h, const uint8_t *data)
+{
+    lv_img_cache_invalidate_src(dsc);
+    memset(dsc, 0, sizeof(*dsc));
+    dsc->header.cf = LV_IMG_CF_TRUE_COLOR_ALPHA;
+    dsc->header.w = w;
+    dsc->header.h = h;
+    dsc->data_size = (uint32_t)w * h * LV_IMG_PX_SIZE_ALPHA_BYTE;
+    dsc->data = data;
+}
+
+static const roller_fade_t *roller_fade_get(lv_coord_t w, lv_coord_t top_h, lv_coord_t bottom_h, lv_color_t color)
+{
+    roller_fade_t *f = &s_fade;
+    if (f->data && f->w == w && f->top_h == top_h && f->bottom_h == bottom_h && f->color.full == color.full)
+    {
+        return f;
+    }
+    uint8_t *data = lv_mem_realloc(f->data, (size_t)w * (top_h + bottom_h) * LV_IMG_PX_SIZE_ALPHA_BYTE);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    f->data = data;
+    f->w = w;
+    f->top_h = top_h;
+    f->bottom_h = bottom_h;
+    f->color = color;
+    uint8_t *bottom = data + (size_t)w * top_h * LV_IMG_PX_SIZE_ALPHA_BYTE;
+    roller_fade_fill(data, w, top_h, color, false);
+    roller_fade_fill(bottom, w, bottom_h, color, true);
+    roller_fade_dsc(&f->top, w, top_h, data);
+    roller_fade_dsc(&f->bottom, w, bottom_h, bottom);
+    ESP_LOGI(TAG, "roller fade %dx%d+%d built", w, top_h, bottom_h);
+    return f;
+}
+
+// 滚轮自己画完选中行以后贴上去 不用改覆盖检查的结果
+static void roller_fade_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    const lv_font_t *font = lv_obj_get_style_text_font(obj, LV_PART_MAIN);
+    lv_coord_t line_space = lv_obj_get_style_text_line_space(obj, LV_PART_MAIN);
+    lv_coord_t font_h = lv_font_get_line_height(font);
+
+    // 和原来的两段遮罩同样的范围
+    lv_area_t coords;
+    lv_obj_get_coords(obj, &coords);
+    lv_area_t top = coords;
+    top.y2 = coords.y1 + (lv_obj_get_height(obj) - font_h - line_space) / 2;
+    lv_area_t bottom = coords;
+    bottom.y1 = top.y2 + font_h + line_space - 1;
+    if (top.y2 < top.y1 || bottom.y1 > bottom.y2)
+    {
+        return;
+    }
+    lv_color_t color = lv_obj_get_style_bg_color(lv_obj_get_parent(obj), LV_PART_MAIN);
+    const roller_fade_t *f = roller_fade_get(lv_area_get_width(&coords), lv_area_get_height(&top),
+                                             lv_area_get_height(&bottom), color);
+    if (f == NULL)
+    {
+        return;
+    }
+    lv_draw_img_dsc_t dsc;
+    lv_draw_img_dsc_init(&dsc);
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_draw_img(draw_ctx, &dsc, &top, &f->top);
+    lv_draw_img(draw_ctx, &dsc, &bottom, &f->bottom);
+}
+
+void ui_roller_fade(lv_obj_t *roller)
+{
+    lv_obj_add_event_cb(roller, roller_fade_cb, LV_EVENT_DRAW_POST, NULL);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include "lvgl.h"
+
+
+/*********************** 共享样式 ****************************/
+// 所有界面共用的样式在开机时建好一次 之后按ID取用 不再在进入界面时重复lv_style_init
+// 样式被控件引用期间不能重新初始化 否则属性内存泄漏 已经加了这个样式的控件也拿不到刷新
+
+typedef enum {
+    UI_STYLE_SCREEN,            // 应用界面根对象 320x240 圆角 白底 背景色可用本地样式覆盖
+    UI_STYLE_PAGE,              // WiFi连接页 320x240 无圆角
+    UI_STYLE_MAIN,              // 主界面 蓝绿渐变背景
+    UI_STYLE_APP_ICON,          // 主界面应用图标 80x80
+    UI_STYLE_TITLE,             // 应用标题栏 320x40 背景色各应用自己设
+    UI_STYLE_BACK_BTN,          // 标题栏返回键 60x30 透明背景
+    UI_STYLE_BACK_LABEL,        // 返回键上的箭头 白色
+    UI_STYLE_BTN_BG,            // 播放器和图片浏览的白底按键
+    UI_STYLE_BTN_NO_OUTLINE,    // 按键聚焦时不画外框
+    UI_STYLE_CAPTURE,           // 摄像头拍照键
+    UI_STYLE_CAPTURE_PRESSED,   // 拍照键按下
+    UI_STYLE_ROLLER,            // WiFi密码输入的滚轮
+    UI_STYLE_COUNT,
+} ui_style_id_t;
+
+void ui_theme_init(void);               // 在LVGL任务里或持有LVGL锁时调用 重复调用无效果
+lv_style_t *ui_style(ui_style_id_t id);
+uint32_t ui_theme_mem_size(void);       // 所有样式属性占用的堆内存 字节
+// 滚轮选中行上下两段渐隐到父对象的底色 不用fade遮罩 贴两张预先画好的带透明度的图
+// 遮罩会让滚轮整块每一个像素都过一遍遮罩 滚动时每帧都这样 贴图只碰上下两段
+// 几个滚轮一样大时共用一份图 父对象换了底色 滚轮换了大小或字体时重画
+void ui_roller_fade(lv_obj_t *roller);
@@ -0,0 +1,231 @@
+#include <string.h>
+#include "ui_trans.h"
+#include "ui_perf.h"
+#include "mem_pool.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "ui_trans";
+
+#if CONFIG_APP_UI_TRANSITION_SLIDE
+#define TRANS_SLIDE     1
+#define TRANS_FADE      0
+#elif CONFIG_APP_UI_TRANSITION_FADE
+#define TRANS_SLIDE     0
+#define TRANS_FADE      1
+#else
+#define TRANS_SLIDE     0
+#define TRANS_FADE      0
+#endif
+
+static struct {
+    lv_obj_t *cover;                    // NULL是没有在切换
+    lv_img_dsc_t img[2];                // [0]旧界面 [1]新界面 data为NULL是还没画
+    ui_trans_dir_t dir;
+    int32_t value;                      // 滑动是移了多少像素 淡入是新界面的透明度
+    lv_timer_t *timer;                  // 等新界面建好再画它的快照
+    int64_t t0;                         // 动画开始 0是还没开始
+    uint32_t frames;
+    uint64_t render_us;
+} s_trans;
+
+static ui_trans_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void trans_free(int i)
+{
+    lv_img_dsc_t *img = &s_trans.img[i];
+    if (img->data)
+    {
+        lv_img_cache_invalidate_src(img);
+        mem_pool_free((void *)img->data);
+        img->data = NULL;
+    }
+}
+
+// 整屏画一张不带透明度的RGB565 界面都是不透明的
+static bool trans_snapshot(int i, lv_obj_t *scr)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint32_t size = lv_snapshot_buf_size_needed(scr, LV_IMG_CF_TRUE_COLOR);
+    void *buf = mem_pool_alloc(MEM_POOL_MEDIA, size);
+    lv_img_dsc_t *img = &s_trans.img[i];
+    if (buf == NULL || lv_snapshot_take_to_buf(scr, LV_IMG_CF_TRUE_COLOR, img, buf, size) != LV_RES_OK)
+    {
+        mem_pool_free(buf);
+        memset(img, 0, sizeof(*img));
+        ESP_LOGW(TAG, "snapshot of %lu bytes failed", (unsigned long)size);
+        return false;
+    }
+    lv_img_cache_invalidate_src(img);
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.snapshots++;
+    s_stats.snapshot_us += us;
+    if (us > s_stats.snapshot_max_us)
+    {
+        s_stats.snapshot_max_us = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+static void trans_end(void)
+{
+    if (s_trans.timer)
+    {
+        lv_timer_del(s_trans.timer);
+        s_trans.timer = NULL;
+    }
+    if (s_trans.cover == NULL)
+    {
+        return;
+    }
+    if (s_trans.t0)
+    {
+        uint32_t frames;
+        uint64_t render_us;
+        ui_perf_get_totals(&frames, &render_us);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.transitions++;
+        s_stats.frames += frames - s_trans.frames;
+        s_stats.anim_us += esp_timer_get_time() - s_trans.t0;
+        s_stats.render_us += render_us - s_trans.render_us;
+        portEXIT_CRITICAL(&s_lock);
+        s_trans.t0 = 0;
+    }
+    lv_obj_t *cover = s_trans.cover;
+    s_trans.cover = NULL;
+    lv_obj_del(cover); // 动画跟着删 下面真正的界面整个重画一次
+    trans_free(0);
+    trans_free(1);
+}
+
+static void trans_draw_img(lv_draw_ctx_t *draw_ctx, const lv_draw_img_dsc_t *dsc, const lv_area_t *a, const lv_img_dsc_t *img)
+{
+    lv_area_t clip;
+    if (_lv_area_intersect(&clip, a, draw_ctx->clip_area))
+    {
+        lv_draw_img(draw_ctx, dsc, a, img);
+    }
+}
+
+static void cover_draw_cb(lv_event_t *e)
+{
+    lv_obj_t *cover = lv_event_get_target(e);
+    lv_draw_ctx_t *draw_ctx = lv_event_get_draw_ctx(e);
+    lv_draw_img_dsc_t dsc;
+    lv_draw_img_dsc_init(&dsc);
+    lv_area_t a_old = cover->coords;
+    lv_area_t a_new = cover->coords;
+    if (s_trans.img[1].data == NULL)
+    {
+        trans_draw_img(draw_ctx, &dsc, &a_old, &s_trans.img[0]);
+        return;
+    }
+#if TRANS_SLIDE
+    // 两张首尾相接 一起移动 正好拼满一屏
+    lv_coord_t w = lv_area_get_width(&cover->coords);
+    lv_coord_t dx = s_trans.dir == UI_TRANS_FORWARD ? -s_trans.value : s_trans.value;
+    lv_area_move(&a_old, dx, 0);
+    lv_area_move(&a_new, dx + (s_trans.dir == UI_TRANS_FORWARD ? w : -w), 0);
+    trans_draw_img(draw_ctx, &dsc, &a_old, &s_trans.img[0]);
+    trans_draw_img(draw_ctx, &dsc, &a_new, &s_trans.img[1]);
+#else
+    trans_draw_img(draw_ctx, &dsc, &a_old, &s_trans.img[0]);
+    dsc.opa = s_trans.value;
+    trans_draw_img(draw_ctx, &dsc, &a_new, &s_trans.img[1]);
+#endif
+}
+
+// 快照是不透明的 告诉LVGL下面的控件不用画
+static void cover_check_cb(lv_event_t *e)
+{
+    lv_obj_t *cover = lv_event_get_target(e);
+    lv_cover_check_info_t *info = lv_event_get_param(e);
+    if (_lv_area_is_in(info->area, &cover->coords, 0))
+    {
+        info->res = LV_COVER_RES_COVER;
+    }
+}
+
+static void trans_anim_cb(void *var, int32_t v)
+{
+    if (v != s_trans.value)
+    {
+        s_trans.value = v;
+        lv_obj_invalidate(var);
+    }
+}
+
+static void trans_ready_cb(lv_anim_t *a)
+{
+    trans_end();
+}
+
+// 调begin的人已经建好或者藏好了界面 盖子先藏起来 不然会画进快照里
+static void trans_start_cb(lv_timer_t *t)
+{
+    s_trans.timer = NULL;
+    lv_obj_t *cover = s_trans.cover;
+    lv_obj_add_flag(cover, LV_OBJ_FLAG_HIDDEN);
+    bool ok = trans_snapshot(1, lv_obj_get_parent(cover));
+    lv_obj_clear_flag(cover, LV_OBJ_FLAG_HIDDEN);
+    if (!ok)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.skipped++;
+        portEXIT_CRITICAL(&s_lock);
+        trans_end();
+        return;
+    }
+    lv_obj_move_foreground(cover); // 新建的界面根对象在它上面
+    s_trans.value = 0;
+    s_trans.t0 = esp_timer_get_time();
+    ui_perf_get_totals(&s_trans.frames, &s_trans.render_us);
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, cover);
+    lv_anim_set_exec_cb(&a, trans_anim_cb);
+    lv_anim_set_values(&a, 0, TRANS_SLIDE ? lv_obj_get_width(cover) : LV_OPA_COVER);
+    lv_anim_set_time(&a, UI_TRANS_MS);
+    lv_anim_set_path_cb(&a, lv_anim_path_ease_out);
+    lv_anim_set_ready_cb(&a, trans_ready_cb);
+    lv_anim_start(&a);
+}
+
+void ui_trans_begin(ui_trans_dir_t dir)
+{
+    if (!TRANS_SLIDE && !TRANS_FADE)
+    {
+        return;
+    }
+    trans_end(); // 上一次还没放完 直接跳到最后
+    lv_obj_t *scr = lv_scr_act();
+    if (!trans_snapshot(0, scr))
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.skipped++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    lv_obj_t *cover = lv_obj_create(scr);
+    lv_obj_remove_style_all(cover);
+    lv_obj_add_flag(cover, LV_OBJ_FLAG_FLOATING); // 不算进屏幕的滚动范围 动画期间的点击都落在它上面
+    lv_obj_clear_flag(cover, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(cover, lv_obj_get_width(scr), lv_obj_get_height(scr));
+    lv_obj_add_event_cb(cover, cover_draw_cb, LV_EVENT_DRAW_MAIN, NULL);
+    lv_obj_add_event_cb(cover, cover_check_cb, LV_EVENT_COVER_CHECK, NULL);
+    s_trans.cover = cover;
+    s_trans.dir = dir;
+    s_trans.timer = lv_timer_create(trans_start_cb, 0, NULL);
+    lv_timer_set_repeat_count(s_trans.timer, 1);
+}
+
+void ui_trans_get_stats(ui_trans_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
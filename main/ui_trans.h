@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+
+/*********************** 进出应用的切换动画 ****************************/
+// 应用界面盖在主界面上 以前进出时直接显示或隐藏 整屏的控件树马上重画一遍
+// 切换前把当前整屏画成一张RGB565快照 切换后下一轮LVGL定时器再画一张 放在媒体池里
+// 动画期间屏幕最上面是一个盖住全屏的对象 只把两张快照按进度贴上去(滑动)或者叠起来(淡入)
+// 下面的控件树不画 每帧的开销只和屏幕大小有关 动画完了删掉盖子 真正的界面再完整画一次
+// 池里没有空块或者关掉了CONFIG_APP_UI_TRANSITION就和以前一样直接切
+// 都在LVGL任务里或持有LVGL锁时调 ui_trans_get_stats除外
+
+#define UI_TRANS_MS             240     // 动画时长 LVGL每30ms刷一次 大约8帧
+
+typedef enum {
+    UI_TRANS_FORWARD,                   // 进应用 新界面从右边进来
+    UI_TRANS_BACK,                      // 回主界面 旧界面往右边出去
+} ui_trans_dir_t;
+
+typedef struct {
+    uint32_t transitions;               // 放完的动画
+    uint32_t skipped;                   // 没缓冲或者画快照失败 直接切的
+    uint32_t snapshots;
+    uint32_t snapshot_us;               // 画快照总共花的
+    uint32_t snapshot_max_us;
+    uint32_t frames;                    // 动画期间的刷新次数
+    uint64_t anim_us;                   // 动画的时间 和frames一起算帧率
+    uint64_t render_us;                 // 动画期间LVGL渲染的时间 除以frames是每帧的开销
+} ui_trans_stats_t;
+
+// 在改变界面之前调 现在的样子当作旧界面 改完以后的样子等下一轮自己取
+void ui_trans_begin(ui_trans_dir_t dir);
+void ui_trans_get_stats(ui_trans_stats_t *stats);
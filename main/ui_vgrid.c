@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include "ui_vgrid.h"
+#include "ui_scroll.h"
+
+typedef struct {
+    ui_scroll_t scroll;                 // 拖动和惯性滑动 必须是第一个成员
+    lv_obj_t *cells[UI_VGRID_MAX_CELLS];
+    lv_obj_t *imgs[UI_VGRID_MAX_CELLS];
+    int cell_index[UI_VGRID_MAX_CELLS]; // 每个格子当前显示的条目 -1表示空
+    int cell_count;                     // 总是cols的整数倍
+    int cols;
+    lv_coord_t cell_w;
+    lv_coord_t cell_h;
+    int count;
+    ui_vgrid_bind_cb_t bind_cb;
+    ui_vgrid_select_cb_t select_cb;
+} ui_vgrid_t;
+
+static int32_t vgrid_max_offset(const ui_vgrid_t *v, lv_obj_t *grid)
+{
+    int32_t rows = (v->count + v->cols - 1) / v->cols;
+    int32_t max = rows * v->cell_h - lv_obj_get_content_height(grid);
+    return max > 0 ? max : 0;
+}
+
+static void vgrid_bind_cell(lv_obj_t *grid, ui_vgrid_t *v, int c, int index)
+{
+    if (index < 0 || index >= v->count)
+    {
+        index = -1;
+    }
+    if (index == v->cell_index[c])
+    {
+        return;
+    }
+    v->cell_index[c] = index;
+    if (index < 0)
+    {
+        lv_obj_add_flag(v->cells[c], LV_OBJ_FLAG_HIDDEN);
+    }
+    else
+    {
+        lv_obj_clear_flag(v->cells[c], LV_OBJ_FLAG_HIDDEN);
+    }
+    v->bind_cb(grid, c, index, v->imgs[c]);
+}
+
+// 第index项固定放在格子index % cell_count 滚动一行只需要重新绑定一行的格子
+static void vgrid_layout(lv_obj_t *grid)
+{
+    ui_vgrid_t *v = lv_obj_get_user_data(grid);
+    ui_scroll_clamp(&v->scroll, vgrid_max_offset(v, grid));
+
+    int first_row = v->scroll.offset / v->cell_h;
+    int32_t shift = v->scroll.offset % v->cell_h;
+    int rows = v->cell_count / v->cols;
+    for (int k = 0; k < rows; k++)
+    {
+        for (int col = 0; col < v->cols; col++)
+        {
+            int index = (first_row + k) * v->cols + col;
+            int c = index % v->cell_count;
+            vgrid_bind_cell(grid, v, c, index);
+            lv_obj_set_pos(v->cells[c], (lv_coord_t)(col * v->cell_w), (lv_coord_t)(k * v->cell_h - shift));
+        }
+    }
+}
+
+static void vgrid_event_cb(lv_event_t *e)
+{
+    lv_obj_t *grid = lv_event_get_target(e);
+    ui_vgrid_t *v = lv_obj_get_user_data(grid);
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if (ui_scroll_event(grid, code))
+    {
+        int32_t x, y;
+        ui_scroll_point(grid, &x, &y);
+        int col = x / v->cell_w;
+        int index = y / v->cell_h * v->cols + col;
+        if (col >= 0 && col < v->cols && index >= 0 && index < v->count && v->select_cb)
+        {
+            v->select_cb(grid, index);
+        }
+    }
+    else if (code == LV_EVENT_DELETE)
+    {
+        free(v);
+        lv_obj_set_user_data(grid, NULL);
+    }
+}
+
+lv_obj_t *ui_vgrid_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, int cols, lv_coord_t cell_h,
+                          ui_vgrid_bind_cb_t bind_cb, ui_vgrid_select_cb_t select_cb)
+{
+    ui_vgrid_t *v = calloc(1, sizeof(ui_vgrid_t));
+    if (v == NULL)
+    {
+        return NULL;
+    }
+    ui_scroll_init(&v->scroll, vgrid_layout);
+    v->cols = cols;
+    v->cell_h = cell_h;
+    v->bind_cb = bind_cb;
+    v->select_cb = select_cb;
+
+    lv_obj_t *grid = lv_obj_create(parent);
+    lv_obj_set_size(grid, w, h);
+    lv_obj_set_style_pad_all(grid, 4, 0);
+    lv_obj_clear_flag(grid, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(grid, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_user_data(grid, v);
+    lv_obj_add_event_cb(grid, vgrid_event_cb, LV_EVENT_ALL, NULL);
+    lv_obj_update_layout(grid);
+
+    // 可见行数加一行 滚动时上下两行都露出一部分
+    int rows = lv_obj_get_content_height(grid) / cell_h + 2;
+    if (rows * cols > UI_VGRID_MAX_CELLS)
+    {
+        rows = UI_VGRID_MAX_CELLS / cols;
+    }
+    v->cell_count = rows * cols;
+    v->cell_w = lv_obj_get_content_width(grid) / cols;
+    for (int c = 0; c < v->cell_count; c++)
+    {
+        lv_obj_t *cell = lv_obj_create(grid);
+        lv_obj_set_size(cell, v->cell_w - 4, cell_h - 4);
+        lv_obj_set_style_pad_all(cell, 0, 0);
+        lv_obj_set_style_border_width(cell, 0, 0);
+        lv_obj_set_style_radius(cell, 4, 0);
+        lv_obj_set_style_bg_color(cell, lv_palette_lighten(LV_PALETTE_GREY, 2), 0);
+        lv_obj_clear_flag(cell, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(cell, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_t *img = lv_img_create(cell);
+        lv_obj_center(img);
+        v->cells[c] = cell;
+        v->imgs[c] = img;
+        v->cell_index[c] = -1;
+    }
+    return grid;
+}
+
+void ui_vgrid_set_count(lv_obj_t *grid, int count)
+{
+    ui_vgrid_t *v = lv_obj_get_user_data(grid);
+    v->count = count;
+    for (int c = 0; c < v->cell_count; c++)
+    {
+        vgrid_bind_cell(grid, v, c, -1);
+    }
+    vgrid_layout(grid);
+}
+
+void ui_vgrid_scroll_to(lv_obj_t *grid, int index)
+{
+    ui_vgrid_t *v = lv_obj_get_user_data(grid);
+    ui_scroll_to(grid, (int32_t)(index / v->cols) * v->cell_h - (lv_obj_get_content_height(grid) - v->cell_h) / 2);
+}
+
+int ui_vgrid_cell_count(lv_obj_t *grid)
+{
+    ui_vgrid_t *v = lv_obj_get_user_data(grid);
+    return v->cell_count;
+}
+
+int ui_vgrid_get_cell_index(lv_obj_t *grid, int cell)
+{
+    ui_vgrid_t *v = lv_obj_get_user_data(grid);
+    return (cell >= 0 && cell < v->cell_count) ? v->cell_index[cell] : -1;
+}
+
+lv_obj_t *ui_vgrid_get_cell_img(lv_obj_t *grid, int cell)
+{
+    ui_vgrid_t *v = lv_obj_get_user_data(grid);
+    return (cell >= 0 && cell < v->cell_count) ? v->imgs[cell] : NULL;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** 虚拟网格控件 ****************************/
+// 和ui_vlist一样只创建可见的几行格子 滚动时复用 条目再多也只有这么多控件 拖动和惯性滑动也一样用ui_scroll
+// 每个格子里有一个lv_img 格子换了条目时通过bind_cb告诉调用者 由调用者填图片
+
+#define UI_VGRID_MAX_CELLS      20      // 最多同时存在的格子数
+
+// 格子cell改为显示第index项 index为-1表示格子被隐藏 img是格子里的图片控件
+typedef void (*ui_vgrid_bind_cb_t)(lv_obj_t *grid, int cell, int index, lv_obj_t *img);
+typedef void (*ui_vgrid_select_cb_t)(lv_obj_t *grid, int index);     // 点击了第index项
+
+lv_obj_t *ui_vgrid_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, int cols, lv_coord_t cell_h,
+                          ui_vgrid_bind_cb_t bind_cb, ui_vgrid_select_cb_t select_cb);
+void ui_vgrid_set_count(lv_obj_t *grid, int count);             // 设置条目数 重新绑定所有格子
+void ui_vgrid_scroll_to(lv_obj_t *grid, int index);             // 让第index项所在行显示在中间
+int ui_vgrid_cell_count(lv_obj_t *grid);
+int ui_vgrid_get_cell_index(lv_obj_t *grid, int cell);          // 格子当前显示的条目 -1表示空
+lv_obj_t *ui_vgrid_get_cell_img(lv_obj_t *grid, int cell);
@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include "ui_vlist.h"
+#include "ui_scroll.h"
+
+typedef struct {
+    ui_scroll_t scroll;                 // 拖动和惯性滑动 必须是第一个成员
+    lv_obj_t *rows[UI_VLIST_MAX_ROWS];
+    lv_obj_t *icons[UI_VLIST_MAX_ROWS]; // 行标签的子对象 没有图标时为NULL
+    int row_index[UI_VLIST_MAX_ROWS];   // 每行当前显示的条目 -1表示空
+    int row_count;
+    lv_coord_t row_h;
+    lv_obj_t *bar;                      // 右侧位置指示条
+    int count;
+    int selected;
+    ui_vlist_text_cb_t text_cb;
+    ui_vlist_select_cb_t select_cb;
+    ui_vlist_icon_cb_t icon_cb;
+    ui_vlist_select_cb_t long_cb;
+    bool long_fired;                    // 这次按下已经算长按 松手不再算点击
+} ui_vlist_t;
+
+static int32_t vlist_max_offset(const ui_vlist_t *v, lv_obj_t *list)
+{
+    int32_t max = (int32_t)v->count * v->row_h - lv_obj_get_content_height(list);
+    return max > 0 ? max : 0;
+}
+
+static void vlist_bind_row(ui_vlist_t *v, int r, int index)
+{
+    lv_obj_t *row = v->rows[r];
+    if (index != v->row_index[r])
+    {
+        v->row_index[r] = index;
+        if (index < 0 || index >= v->count)
+        {
+            lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+            return;
+        }
+        char text[UI_VLIST_TEXT_LEN];
+        text[0] = 0;
+        v->text_cb(index, text, sizeof(text));
+        lv_label_set_text(row, text);
+        if (v->icon_cb)
+        {
+            lv_label_set_text_static(v->icons[r], v->icon_cb(index));
+        }
+        lv_obj_clear_flag(row, LV_OBJ_FLAG_HIDDEN);
+    }
+    if (index == v->selected)
+    {
+        lv_obj_add_state(row, LV_STATE_CHECKED);
+    }
+    else
+    {
+        lv_obj_clear_state(row, LV_STATE_CHECKED);
+    }
+}
+
+// 按滚动位置摆放各行 行r固定显示index % row_count 滚动一行只需要重新取一行的文字
+static void vlist_layout(lv_obj_t *list)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    int32_t max = vlist_max_offset(v, list);
+    ui_scroll_clamp(&v->scroll, max);
+
+    int first = v->scroll.offset / v->row_h;
+    int32_t shift = v->scroll.offset % v->row_h;
+    for (int k = 0; k < v->row_count; k++)
+    {
+        int index = first + k;
+        int r = index % v->row_count;
+        vlist_bind_row(v, r, index);
+        lv_obj_set_y(v->rows[r], (lv_coord_t)(k * v->row_h - shift));
+    }
+
+    // 位置指示条
+    lv_coord_t h = lv_obj_get_content_height(list);
+    if (max == 0)
+    {
+        lv_obj_add_flag(v->bar, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    lv_coord_t bar_h = (lv_coord_t)LV_MAX(16, (int32_t)h * h / ((int32_t)v->count * v->row_h));
+    lv_obj_set_height(v->bar, bar_h);
+    lv_obj_set_y(v->bar, (lv_coord_t)((int64_t)(h - bar_h) * v->scroll.offset / max));
+    lv_obj_clear_flag(v->bar, LV_OBJ_FLAG_HIDDEN);
+}
+
+// 标签没法竖直居中 用上边距把一行字放到中间
+static void vlist_center_text(lv_obj_t *label, lv_coord_t row_h)
+{
+    lv_obj_set_style_pad_top(label, (row_h - lv_font_get_line_height(lv_obj_get_style_text_font(label, 0))) / 2, 0);
+}
+
+// 按下的点在第几行 不在条目上返回-1
+static int vlist_hit(lv_obj_t *list, const ui_vlist_t *v)
+{
+    int32_t x, y;
+    ui_scroll_point(list, &x, &y);
+    int index = y / v->row_h;
+    return index >= 0 && index < v->count ? index : -1;
+}
+
+static void vlist_event_cb(lv_event_t *e)
+{
+    lv_obj_t *list = lv_event_get_target(e);
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    lv_event_code_t code = lv_event_get_code(e);
+
+    bool click = ui_scroll_event(list, code);
+    if (code == LV_EVENT_PRESSED)
+    {
+        v->long_fired = false;
+    }
+    else if (code == LV_EVENT_LONG_PRESSED)
+    {
+        int index = v->long_cb && !ui_scroll_dragged(list) ? vlist_hit(list, v) : -1;
+        if (index >= 0)
+        {
+            v->long_fired = true;
+            v->long_cb(list, index);
+        }
+    }
+    else if (code == LV_EVENT_RELEASED)
+    {
+        // 长按过的这次松手已经处理过了
+        int index = click && !v->long_fired ? vlist_hit(list, v) : -1;
+        if (index >= 0)
+        {
+            ui_vlist_set_selected(list, index, false);
+            if (v->select_cb)
+            {
+                v->select_cb(list, index);
+            }
+        }
+    }
+    else if (code == LV_EVENT_DELETE)
+    {
+        free(v);
+        lv_obj_set_user_data(list, NULL);
+    }
+}
+
+lv_obj_t *ui_vlist_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, lv_coord_t row_h,
+                          ui_vlist_text_cb_t text_cb, ui_vlist_select_cb_t select_cb)
+{
+    ui_vlist_t *v = calloc(1, sizeof(ui_vlist_t));
+    if (v == NULL)
+    {
+        return NULL;
+    }
+    ui_scroll_init(&v->scroll, vlist_layout);
+    v->row_h = row_h;
+    v->selected = -1;
+    v->text_cb = text_cb;
+    v->select_cb = select_cb;
+
+    lv_obj_t *list = lv_obj_create(parent);
+    lv_obj_set_size(list, w, h);
+    lv_obj_set_style_pad_all(list, 4, 0);
+    lv_obj_clear_flag(list, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(list, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_user_data(list, v);
+    lv_obj_add_event_cb(list, vlist_event_cb, LV_EVENT_ALL, NULL);
+    lv_obj_update_layout(list);
+
+    // 可见行数加一行 滚动时上下两行都露出一部分
+    v->row_count = lv_obj_get_content_height(list) / row_h + 2;
+    if (v->row_count > UI_VLIST_MAX_ROWS)
+    {
+        v->row_count = UI_VLIST_MAX_ROWS;
+    }
+    lv_coord_t row_w = lv_obj_get_content_width(list) - 6;
+    for (int r = 0; r < v->row_count; r++)
+    {
+        lv_obj_t *row = lv_label_create(list);
+        lv_obj_set_size(row, row_w, row_h);
+        lv_label_set_long_mode(row, LV_LABEL_LONG_DOT);
+        lv_obj_clear_flag(row, LV_OBJ_FLAG_CLICKABLE);
+        vlist_center_text(row, row_h);
+        lv_obj_set_style_bg_color(row, lv_palette_main(LV_PALETTE_BLUE), LV_STATE_CHECKED);
+        lv_obj_set_style_bg_opa(row, LV_OPA_COVER, LV_STATE_CHECKED);
+        lv_obj_set_style_text_color(row, lv_color_white(), LV_STATE_CHECKED);
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+        v->rows[r] = row;
+        v->row_index[r] = -1;
+    }
+
+    v->bar = lv_obj_create(list);
+    lv_obj_set_size(v->bar, 3, 16);
+    lv_obj_set_style_border_width(v->bar, 0, 0);
+    lv_obj_set_style_radius(v->bar, 2, 0);
+    lv_obj_set_style_bg_color(v->bar, lv_palette_main(LV_PALETTE_GREY), 0);
+    lv_obj_clear_flag(v->bar, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_align(v->bar, LV_ALIGN_TOP_RIGHT, 0, 0);
+    lv_obj_add_flag(v->bar, LV_OBJ_FLAG_HIDDEN);
+
+    return list;
+}
+
+void ui_vlist_refresh(lv_obj_t *list)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    for (int r = 0; r < v->row_count; r++)
+    {
+        v->row_index[r] = -1;
+    }
+    vlist_layout(list);
+}
+
+void ui_vlist_set_count(lv_obj_t *list, int count)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    v->count = count;
+    if (v->selected >= count)
+    {
+        v->selected = -1;
+    }
+    ui_vlist_refresh(list);
+}
+
+void ui_vlist_set_selected(lv_obj_t *list, int index, bool scroll_to)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    v->selected = (index >= 0 && index < v->count) ? index : -1;
+    if (scroll_to && v->selected >= 0)
+    {
+        // 选中行放在中间
+        ui_scroll_stop(list);
+        v->scroll.offset = (int32_t)v->selected * v->row_h - (lv_obj_get_content_height(list) - v->row_h) / 2;
+    }
+    for (int r = 0; r < v->row_count; r++)
+    {
+        if (v->row_index[r] >= 0)
+        {
+            vlist_bind_row(v, r, v->row_index[r]);
+        }
+    }
+    vlist_layout(list);
+}
+
+int ui_vlist_get_selected(lv_obj_t *list)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    return v->selected;
+}
+
+void ui_vlist_grow(lv_obj_t *list, int count)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    for (int r = 0; r < v->row_count; r++)
+    {
+        // 原来超出末尾藏起来的行 现在可能有内容了
+        if (v->row_index[r] >= v->count)
+        {
+            v->row_index[r] = -1;
+        }
+    }
+    v->count = count;
+    vlist_layout(list);
+}
+
+void ui_vlist_set_icons(lv_obj_t *list, ui_vlist_icon_cb_t icon_cb, const lv_font_t *font)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    lv_coord_t icon_w = lv_font_get_line_height(font) + 6;
+    for (int r = 0; r < v->row_count; r++)
+    {
+        lv_obj_t *row = v->rows[r];
+        vlist_center_text(row, v->row_h);
+        lv_obj_set_style_pad_left(row, icon_w, 0);
+        if (v->icons[r] == NULL)
+        {
+            v->icons[r] = lv_label_create(row);
+        }
+        lv_obj_t *icon = v->icons[r];
+        lv_obj_set_style_text_font(icon, font, 0);
+        lv_obj_set_size(icon, icon_w, v->row_h);
+        // 子对象按父对象的内容区对齐 退回到行的左上角
+        lv_obj_align(icon, LV_ALIGN_TOP_LEFT, -icon_w, -lv_obj_get_style_pad_top(row, 0));
+        vlist_center_text(icon, v->row_h);
+        v->row_index[r] = -1;
+    }
+    v->icon_cb = icon_cb;
+    vlist_layout(list);
+}
+
+void ui_vlist_set_long_press_cb(lv_obj_t *list, ui_vlist_select_cb_t long_cb)
+{
+    ui_vlist_t *v = lv_obj_get_user_data(list);
+    v->long_cb = long_cb;
+}
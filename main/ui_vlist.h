@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl.h"
+
+
+/*********************** 虚拟列表控件 ****************************/
+// 只创建可见的几行 滚动时复用这些行并按需取文字 条目数再多也是O(1)
+// 拖动和惯性滑动用ui_scroll 和ui_vgrid共用
+
+#define UI_VLIST_MAX_ROWS       12      // 最多同时显示的行数
+#define UI_VLIST_TEXT_LEN       128     // 每行文字缓冲
+
+typedef void (*ui_vlist_text_cb_t)(int index, char *buf, size_t len); // 取第index行的文字
+typedef void (*ui_vlist_select_cb_t)(lv_obj_t *list, int index);     // 点击了第index行
+typedef const char *(*ui_vlist_icon_cb_t)(int index);                // 第index行左边的图标 返回静态字符串
+
+lv_obj_t *ui_vlist_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, lv_coord_t row_h,
+                          ui_vlist_text_cb_t text_cb, ui_vlist_select_cb_t select_cb);
+void ui_vlist_set_count(lv_obj_t *list, int count);             // 设置条目数 重新取可见行的文字
+void ui_vlist_set_selected(lv_obj_t *list, int index, bool scroll_to); // 高亮第index行 可选滚动到该行
+int ui_vlist_get_selected(lv_obj_t *list);
+void ui_vlist_refresh(lv_obj_t *list);                          // 条目内容变化后重新取可见行的文字
+void ui_vlist_grow(lv_obj_t *list, int count);                  // 只在末尾加了条目 已经显示的行不再重新取文字
+// 每行左边加一列图标 图标用font 列表自己的字体要在这之前设好 行的上边距按它重新算
+void ui_vlist_set_icons(lv_obj_t *list, ui_vlist_icon_cb_t icon_cb, const lv_font_t *font);
+// 长按第index行 没拖动才算 长按过的这次松手不再算点击
+void ui_vlist_set_long_press_cb(lv_obj_t *list, ui_vlist_select_cb_t long_cb);
@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "ui_zoom.h"
+#include "task_plan.h"
+#include "pic_cache.h"
+#include "ui_msg.h"
+#include "esp32_s3_szp.h"
+#include "mem_pool.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_zoom";
+
+#define ZOOM_DBLCLICK_MS    350
+#define ZOOM_TILE_SHIFT     6           // UI_ZOOM_TILE = 1 << 6
+#define ZOOM_TILE_MASK      (UI_ZOOM_TILE - 1)
+#define ZOOM_TILE_PX_SHIFT  (2 * ZOOM_TILE_SHIFT)
+
+typedef struct {
+    uint16_t w;
+    uint16_t h;
+    uint16_t tiles_x;
+    uint16_t tiles_y;
+    uint16_t *px;                       // 块按行排 每块内部也按行排
+} zoom_level_t;
+
+typedef struct {
+    // 两边共用
+    uint8_t refs;                       // 控件和加载任务各一份 最后放手的一方释放
+    volatile bool quit;
+    bool failed;
+    char path[PIC_CACHE_PATH_LEN];
+    zoom_level_t lv[UI_ZOOM_LEVELS];
+    // 只在LVGL任务里用
+    lv_obj_t *obj;
+    lv_obj_t *label;
+    lv_img_dsc_t dsc;
+    uint16_t *view;
+    lv_coord_t vw;
+    lv_coord_t vh;
+    bool ready;
+    float z;                            // 屏幕像素 / 原图像素
+    float fit;
+    float ox;                           // 原图左上角在视口里的位置
+    float oy;
+    bool pinching;
+    bool skip_pan;
+    float z0;
+    float d0;
+    float ix;                           // 捏合开始时两指中点下面的原图坐标
+    float iy;
+    uint32_t last_click;
+} zoom_view_t;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ui_zoom_stats_t s_stats;
+
+static void zoom_put(zoom_view_t *v)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool last = --v->refs == 0;
+    portEXIT_CRITICAL(&s_lock);
+    if (!last)
+    {
+        return;
+    }
+    for (int i = 0; i < UI_ZOOM_LEVELS; i++)
+    {
+        heap_caps_free(v->lv[i].px);
+    }
+    free(v);
+}
+
+static inline uint16_t *level_px(const zoom_level_t *l, int x, int y)
+{
+    size_t tile = (size_t)(y >> ZOOM_TILE_SHIFT) * l->tiles_x + (x >> ZOOM_TILE_SHIFT);
+    return l->px + (tile << ZOOM_TILE_PX_SHIFT) + ((y & ZOOM_TILE_MASK) << ZOOM_TILE_SHIFT) + (x & ZOOM_TILE_MASK);
+}
+
+static bool level_alloc(zoom_level_t *l, int w, int h)
+{
+    l->w = w;
+    l->h = h;
+    l->tiles_x = (w + ZOOM_TILE_MASK) >> ZOOM_TILE_SHIFT;
+    l->tiles_y = (h + ZOOM_TILE_MASK) >> ZOOM_TILE_SHIFT;
+    size_t bytes = ((size_t)l->tiles_x * l->tiles_y << ZOOM_TILE_PX_SHIFT) * sizeof(uint16_t);
+    l->px = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return l->px != NULL;
+}
+
+/************ 加载任务 ************/
+// LV_COLOR_16_SWAP时像素是反的 先换回来再按分量平均
+static inline uint16_t px_swap(uint16_t v)
+{
+#if LV_COLOR_16_SWAP
+    return (uint16_t)((v >> 8) | (v << 8));
+#else
+    return v;
+#endif
+}
+
+static uint16_t px_avg4(uint16_t a, uint16_t b, uint16_t c, uint16_t d)
+{
+    a = px_swap(a);
+    b = px_swap(b);
+    c = px_swap(c);
+    d = px_swap(d);
+    uint32_t r = ((a >> 11) + (b >> 11) + (c >> 11) + (d >> 11) + 2) >> 2;
+    uint32_t g = (((a >> 5) & 0x3f) + ((b >> 5) & 0x3f) + ((c >> 5) & 0x3f) + ((d >> 5) & 0x3f) + 2) >> 2;
+    uint32_t bl = ((a & 0x1f) + (b & 0x1f) + (c & 0x1f) + (d & 0x1f) + 2) >> 2;
+    return px_swap((uint16_t)((r << 11) | (g << 5) | bl));
+}
+
+// 原图切块 带alpha的合成到白底上 和查看器背景一样
+static void level_fill(zoom_level_t *l, const lv_img_dsc_t *src)
+{
+    bool alpha = src->header.cf == LV_IMG_CF_TRUE_COLOR_ALPHA;
+    uint32_t px_size = alpha ? LV_IMG_PX_SIZE_ALPHA_BYTE : sizeof(lv_color_t);
+    lv_color_t white = lv_color_white();
+    for (int y = 0; y < l->h; y++)
+    {
+        const uint8_t *in = src->data + (size_t)y * l->w * px_size;
+        if (!alpha)
+        {
+            for (int x = 0; x < l->w; x += UI_ZOOM_TILE)
+            {
+                int n = LV_MIN(UI_ZOOM_TILE, l->w - x);
+                memcpy(level_px(l, x, y), in + x * sizeof(uint16_t), n * sizeof(uint16_t));
+            }
+            continue;
+        }
+        for (int x = 0; x < l->w; x++, in += px_size)
+        {
+            lv_color_t c;
+            memcpy(&c, in, sizeof(c));
+            *level_px(l, x, y) = lv_color_mix(c, white, in[sizeof(c)]).full;
+        }
+    }
+}
+
+// 上一级每2x2取平均 奇数边上的最后一列(行)重复用
+static void level_half(zoom_level_t *dst, const zoom_level_t *src)
+{
+    for (int y = 0; y < dst->h; y++)
+    {
+        int y0 = LV_MIN(2 * y, src->h - 1);
+        int y1 = LV_MIN(2 * y + 1, src->h - 1);
+        for (int x = 0; x < dst->w; x++)
+        {
+            int x0 = LV_MIN(2 * x, src->w - 1);
+            int x1 = LV_MIN(2 * x + 1, src->w - 1);
+            *level_px(dst, x, y) = px_avg4(*level_px(src, x0, y0), *level_px(src, x1, y0),
+                                           *level_px(src, x0, y1), *level_px(src, x1, y1));
+        }
+    }
+}
+
+static bool zoom_build(zoom_view_t *v, const lv_img_dsc_t *src)
+{
+    if (!level_alloc(&v->lv[0], src->header.w, src->header.h))
+    {
+        return false;
+    }
+    level_fill(&v->lv[0], src);
+    for (int i = 1; i < UI_ZOOM_LEVELS && !v->quit; i++)
+    {
+        const zoom_level_t *up = &v->lv[i - 1];
+        if (!level_alloc(&v->lv[i], LV_MAX((up->w + 1) / 2, 1), LV_MAX((up->h + 1) / 2, 1)))
+        {
+            return false;
+        }
+        level_half(&v->lv[i], up);
+    }
+    return !v->quit;
+}
+
+static void zoom_ready(void *arg);
+
+static void zoom_task(void *arg)
+{
+    zoom_view_t *v = arg;
+    int64_t t0 = esp_timer_get_time();
+    lv_img_dsc_t src;
+    bool ok = pic_cache_decode_fit(v->path, UI_ZOOM_SRC_MAX_W, UI_ZOOM_SRC_MAX_H, &src);
+    if (ok)
+    {
+        ok = zoom_build(v, &src);
+        heap_caps_free((void *)src.data);
+    }
+    v->failed = !ok;
+    int64_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    if (ok)
+    {
+        s_stats.opened++;
+        s_stats.load_us += us;
+    }
+    else
+    {
+        s_stats.failed++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (ok)
+    {
+        ESP_LOGI(TAG, "%s %ux%u ready in %lld ms", v->path, v->lv[0].w, v->lv[0].h, us / 1000);
+    }
+    if (!ui_post_call(zoom_ready, v))
+    {
+        zoom_put(v);
+    }
+    vTaskDelete(NULL);
+}
+
+/************ LVGL任务 ************/
+// 按当前倍数选一级: 这一级缩小后仍不比屏幕像素稀的最小一级
+static void zoom_render(zoom_view_t *v)
+{
+    int64_t t0 = esp_timer_get_time();
+    int l = 0;
+    while (l + 1 < UI_ZOOM_LEVELS && v->z * (1 << (l + 1)) <= 1.0f)
+    {
+        l++;
+    }
+    const zoom_level_t *L = &v->lv[l];
+    float s = v->z * (1 << l);          // 屏幕像素 / 这一级像素
+    int32_t step = (int32_t)(65536.0f / s);
+    int xa = LV_MAX(0, (int)ceilf(v->ox));
+    int xb = LV_MIN(v->vw, (int)ceilf(v->ox + v->lv[0].w * v->z));
+    int32_t fx0 = (int32_t)((xa + 0.5f - v->ox) / s * 65536.0f);
+    uint16_t bg = lv_color_white().full;
+
+    for (int y = 0; y < v->vh; y++)
+    {
+        uint16_t *out = v->view + y * v->vw;
+        float fy = (y + 0.5f - v->oy) / s;
+        if (fy < 0 || fy >= L->h || xa >= xb)
+        {
+            for (int x = 0; x < v->vw; x++)
+            {
+                out[x] = bg;
+            }
+            continue;
+        }
+        int ly = (int)fy;
+        const uint16_t *row = level_px(L, 0, ly);
+        for (int x = 0; x < xa; x++)
+        {
+            out[x] = bg;
+        }
+        int32_t fx = fx0;
+        for (int x = xa; x < xb; x++, fx += step)
+        {
+            int lx = LV_MIN(fx >> 16, L->w - 1);
+            out[x] = row[((lx >> ZOOM_TILE_SHIFT) << ZOOM_TILE_PX_SHIFT) + (lx & ZOOM_TILE_MASK)];
+        }
+        for (int x = xb; x < v->vw; x++)
+        {
+            out[x] = bg;
+        }
+    }
+    lv_img_cache_invalidate_src(&v->dsc);
+    lv_obj_invalidate(v->obj);
+
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.renders++;
+    s_stats.render_us += us;
+    s_stats.max_render_us = LV_MAX(s_stats.max_render_us, us);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 倍数限制在适应屏幕到UI_ZOOM_MAX 比视口小的方向居中 大的方向不留白边
+static void zoom_clamp(zoom_view_t *v)
+{
+    v->z = fmaxf(v->fit, fminf(v->z, UI_ZOOM_MAX));
+    float iw = v->lv[0].w * v->z;
+    float ih = v->lv[0].h * v->z;
+    v->ox = iw <= v->vw ? (v->vw - iw) / 2 : fminf(0, fmaxf(v->ox, v->vw - iw));
+    v->oy = ih <= v->vh ? (v->vh - ih) / 2 : fminf(0, fmaxf(v->oy, v->vh - ih));
+}
+
+// 以视口里的(px, py)为中心缩放到z
+static void zoom_at(zoom_view_t *v, float z, float px, float py)
+{
+    float ix = (px - v->ox) / v->z;
+    float iy = (py - v->oy) / v->z;
+    v->z = z;
+    v->ox = px - ix * z;
+    v->oy = py - iy * z;
+}
+
+static void zoom_ready(void *arg)
+{
+    zoom_view_t *v = arg;
+    if (v->obj && v->failed)
+    {
+        lv_label_set_text(v->label, LV_SYMBOL_WARNING);
+    }
+    else if (v->obj)
+    {
+        lv_obj_del(v->label);
+        v->label = NULL;
+        v->fit = fminf(1.0f, fminf((float)v->vw / v->lv[0].w, (float)v->vh / v->lv[0].h));
+        v->z = v->fit;
+        zoom_clamp(v);
+        v->ready = true;
+        zoom_render(v);
+        lv_img_set_src(v->obj, &v->dsc);
+    }
+    zoom_put(v);
+}
+
+static void zoom_pressing(zoom_view_t *v)
+{
+    lv_point_t pt[2];
+    uint8_t n = bsp_touch_get_points(pt, 2);
+    float z = v->z;
+    float ox = v->ox;
+    float oy = v->oy;
+    if (n >= 2)
+    {
+        float mx = (pt[0].x + pt[1].x) / 2.0f - v->obj->coords.x1;
+        float my = (pt[0].y + pt[1].y) / 2.0f - v->obj->coords.y1;
+        float d = fmaxf(hypotf(pt[0].x - pt[1].x, pt[0].y - pt[1].y), 1.0f);
+        if (!v->pinching)
+        {
+            v->pinching = true;
+            v->z0 = v->z;
+            v->d0 = d;
+            v->ix = (mx - v->ox) / v->z;
+            v->iy = (my - v->oy) / v->z;
+            return;
+        }
+        // 两指中点下面始终是同一个原图点 中点移动就是拖动
+        v->z = fmaxf(v->fit, fminf(v->z0 * d / v->d0, UI_ZOOM_MAX));
+        v->ox = mx - v->ix * v->z;
+        v->oy = my - v->iy * v->z;
+    }
+    else
+    {
+        if (v->pinching)
+        {
+            // 抬起一根手指后LVGL的点会跳到剩下那根 这一下的位移不算
+            v->pinching = false;
+            v->skip_pan = true;
+            return;
+        }
+        lv_point_t vect;
+        lv_indev_get_vect(lv_indev_get_act(), &vect);
+        if (v->skip_pan)
+        {
+            v->skip_pan = false;
+            return;
+        }
+        v->ox += vect.x;
+        v->oy += vect.y;
+    }
+    zoom_clamp(v);
+    if (z != v->z || ox != v->ox || oy != v->oy)
+    {
+        zoom_render(v);
+    }
+}
+
+static void zoom_double_click(zoom_view_t *v)
+{
+    lv_point_t p;
+    lv_indev_get_point(lv_indev_get_act(), &p);
+    float target = v->z > v->fit * 1.01f ? v->fit : fmaxf(1.0f, v->fit * 2);
+    zoom_at(v, target, p.x - v->obj->coords.x1, p.y - v->obj->coords.y1);
+    zoom_clamp(v);
+    zoom_render(v);
+}
+
+static void zoom_event_cb(lv_event_t *e)
+{
+    zoom_view_t *v = lv_event_get_user_data(e);
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code == LV_EVENT_DELETE)
+    {
+        v->obj = NULL;
+        v->quit = true;
+        mem_pool_free(v->view);
+        v->view = NULL;
+        zoom_put(v);
+        return;
+    }
+    if (!v->ready)
+    {
+        return;
+    }
+    if (code == LV_EVENT_PRESSED)
+    {
+        v->pinching = false;
+        v->skip_pan = false;
+    }
+    else if (code == LV_EVENT_PRESSING)
+    {
+        zoom_pressing(v);
+    }
+    else if (code == LV_EVENT_SHORT_CLICKED)
+    {
+        if (lv_tick_elaps(v->last_click) < ZOOM_DBLCLICK_MS)
+        {
+            zoom_double_click(v);
+            v->last_click = 0;
+            return;
+        }
+        v->last_click = lv_tick_get();
+    }
+}
+
+lv_obj_t *ui_zoom_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, const char *path)
+{
+    if (path[0] && path[1] == ':')
+    {
+        path += 2;                      // LVGL盘符 解码用的是VFS路径
+    }
+    lv_obj_t *obj = lv_img_create(parent);
+    lv_obj_set_size(obj, w, h);
+    lv_obj_add_flag(obj, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLL_CHAIN | LV_OBJ_FLAG_GESTURE_BUBBLE);
+    lv_obj_t *label = lv_label_create(obj);
+    lv_label_set_text(label, LV_SYMBOL_REFRESH);
+    lv_obj_center(label);
+
+    zoom_view_t *v = calloc(1, sizeof(*v));
+    uint16_t *view = v ? mem_pool_alloc(MEM_POOL_MEDIA, (size_t)w * h * sizeof(uint16_t)) : NULL;
+    if (view == NULL)
+    {
+        free(v);
+        lv_label_set_text(label, LV_SYMBOL_WARNING);
+        return obj;
+    }
+    v->obj = obj;
+    v->label = label;
+    v->view = view;
+    v->vw = w;
+    v->vh = h;
+    v->dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    v->dsc.header.w = w;
+    v->dsc.header.h = h;
+    v->dsc.data_size = (uint32_t)w * h * sizeof(uint16_t);
+    v->dsc.data = (const uint8_t *)view;
+    strlcpy(v->path, path, sizeof(v->path));
+    v->refs = 2;
+    lv_obj_add_event_cb(obj, zoom_event_cb, LV_EVENT_ALL, v);
+    if (task_plan_create(TASK_UI_ZOOM, zoom_task, v, NULL) != pdPASS)
+    {
+        ESP_LOGE(TAG, "load task start failed");
+        v->refs = 1;
+        v->failed = true;
+        lv_label_set_text(label, LV_SYMBOL_WARNING);
+    }
+    return obj;
+}
+
+void ui_zoom_get_stats(ui_zoom_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
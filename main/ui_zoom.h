@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** 可缩放的图片查看器 ****************************/
+// 图片在core 0上解码后切成64x64的块放进PSRAM 同时做出1/2和1/4两级 组成金字塔
+// 显示用一块和视口一样大的RGB565缓冲 缩放或拖动时选最接近当前倍数的一级
+// 只从落在视口里的块取点画进缓冲 不用LVGL的变换每帧去缩整张图
+// 单指拖动 双指捏合缩放 双击在适应屏幕和1:1之间切换
+
+#define UI_ZOOM_TILE            64
+#define UI_ZOOM_LEVELS          3
+#define UI_ZOOM_MAX             4       // 最多放大到原图一个像素占4x4
+#define UI_ZOOM_SRC_MAX_W       1024    // JPEG按这个尺寸以内解码 更大的由tjpgd先缩小
+#define UI_ZOOM_SRC_MAX_H       768
+
+typedef struct {
+    uint32_t opened;
+    uint32_t failed;
+    uint64_t load_us;                   // 解码加建金字塔
+    uint32_t renders;
+    uint64_t render_us;
+    uint32_t max_render_us;
+} ui_zoom_stats_t;
+
+// 在parent里建一个w x h的查看器 后台开始加载path(可以带"A:"盘符) 持有LVGL锁时调用
+lv_obj_t *ui_zoom_create(lv_obj_t *parent, lv_coord_t w, lv_coord_t h, const char *path);
+void ui_zoom_get_stats(ui_zoom_stats_t *stats);
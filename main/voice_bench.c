@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "voice_bench.h"
+#include "task_plan.h"
+#include "voice_cmd.h"
+#include "esp32_s3_szp.h"
+#include "sd_hotplug.h"
+#include "evt_bus.h"
+#include "ui_gif.h"
+#include "ui_perf.h"
+#include "ui_screen.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "voice_bench";
+
+#define BENCH_CAMERA_SCREEN 4           // icon_flag
+#define BENCH_SLICE_BYTES   (VOICE_BENCH_PSRAM_BYTES / VOICE_BENCH_SLICES)
+
+static uint8_t *s_src;
+static uint8_t *s_dst;
+static QueueHandle_t s_queue;
+static SemaphoreHandle_t s_file_lock;   // 热插拔任务要来关文件
+static FILE *s_fp;
+static int64_t s_t_start;
+static uint64_t s_kbps_sum[VOICE_BENCH_CTXS];
+static voice_bench_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_ctx_names[VOICE_BENCH_CTXS] = {"idle", "camera", "gif"};
+static const char *const s_ev_names[] = {"wake", "command", "timeout", "false_wake"};
+
+const char *voice_bench_ctx_name(voice_bench_ctx_t ctx)
+{
+    return ctx < VOICE_BENCH_CTXS ? s_ctx_names[ctx] : "?";
+}
+
+static voice_bench_ctx_t bench_ctx(void)
+{
+    if (ui_screen_is_active(BENCH_CAMERA_SCREEN))
+    {
+        return VOICE_BENCH_CAMERA;
+    }
+    ui_gif_stats_t g;
+    ui_gif_get_stats(&g);
+    return g.fps > 0 ? VOICE_BENCH_GIF : VOICE_BENCH_IDLE;
+}
+
+static int slice_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// 返回KB/s 每段的时间排序取中间的
+static uint32_t psram_probe(void)
+{
+    uint32_t us[VOICE_BENCH_SLICES];
+    for (int i = 0; i < VOICE_BENCH_SLICES; i++)
+    {
+        int64_t t0 = esp_timer_get_time();
+        memcpy(s_dst + i * BENCH_SLICE_BYTES, s_src + i * BENCH_SLICE_BYTES, BENCH_SLICE_BYTES);
+        us[i] = esp_timer_get_time() - t0;
+    }
+    qsort(us, VOICE_BENCH_SLICES, sizeof(us[0]), slice_cmp);
+    uint32_t mid = us[VOICE_BENCH_SLICES / 2];
+    return mid ? (uint64_t)BENCH_SLICE_BYTES * 1000000 / 1024 / mid : 0;
+}
+
+float voice_bench_false_per_hour(void)
+{
+    voice_cmd_stats_t vc;
+    voice_cmd_get_stats(&vc);
+    int64_t us = esp_timer_get_time() - s_t_start;
+    return s_t_start && us > 0 ? vc.false_wakes * 3600e6f / us : 0;
+}
+
+// 调用者持有s_file_lock
+static void file_close(void)
+{
+    if (s_fp)
+    {
+        fclose(s_fp);
+        s_fp = NULL;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.logging = false;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static void file_open(void)
+{
+    if (mkdir(VOICE_BENCH_DIR, 0775) != 0)
+    {
+        struct stat st;
+        if (stat(VOICE_BENCH_DIR, &st) != 0)
+        {
+            ESP_LOGW(TAG, "mkdir %s failed", VOICE_BENCH_DIR);
+            return;
+        }
+    }
+    char path[64];
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    snprintf(path, sizeof(path), "%s/voice_%02d%02d_%02d%02d%02d.csv", VOICE_BENCH_DIR, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    s_fp = fopen(path, "w");
+    if (s_fp == NULL)
+    {
+        ESP_LOGW(TAG, "open %s failed", path);
+        return;
+    }
+    fputs("#t_ms,type,cmd,prob,eou_ms,action_ms,lag_ms,music\n"
+          "#t_ms,stat,wakes,commands,false_wakes,fa_per_h,eou_avg_ms,eou_max_ms,feed_cyc,fetch_wn_us,fetch_vad_us,"
+          "mn_us,afe_pct,core0,core1,lag_ms,psram_kbps,ctx\n", s_fp);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.logging = true;
+    s_stats.files++;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "logging to %s", path);
+}
+
+// 调用者持有s_file_lock 写坏了关掉 卡还在的话下个周期再开
+static void file_row(int n)
+{
+    bool ok = n > 0;
+    portENTER_CRITICAL(&s_lock);
+    if (ok)
+    {
+        s_stats.rows++;
+    }
+    else
+    {
+        s_stats.write_errors++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!ok)
+    {
+        file_close();
+    }
+}
+
+static void write_event(const voice_cmd_event_t *ev)
+{
+    xSemaphoreTake(s_file_lock, portMAX_DELAY);
+    if (s_fp)
+    {
+        file_row(fprintf(s_fp, "%lld,%s,%s,%.2f,%lu,%lu,%lu,%d\n", esp_timer_get_time() / 1000,
+                         s_ev_names[ev->type], voice_cmd_name(ev->cmd), ev->prob, (unsigned long)ev->eou_us / 1000,
+                         (unsigned long)ev->action_us / 1000, (unsigned long)ev->lag_ms, ev->music));
+    }
+    xSemaphoreGive(s_file_lock);
+}
+
+static void write_stat(uint32_t kbps, voice_bench_ctx_t ctx)
+{
+    voice_cmd_stats_t vc;
+    voice_cmd_get_stats(&vc);
+    xSemaphoreTake(s_file_lock, portMAX_DELAY);
+    if (s_fp == NULL && bsp_sdcard_mounted())
+    {
+        file_open();
+    }
+    if (s_fp)
+    {
+        file_row(fprintf(s_fp, "%lld,stat,%lu,%lu,%lu,%.2f,%lu,%lu,%lu,%lu,%lu,%lu,%u,%u,%u,%lu,%lu,%s\n",
+                         esp_timer_get_time() / 1000, (unsigned long)vc.wakes, (unsigned long)vc.commands,
+                         (unsigned long)vc.false_wakes, voice_bench_false_per_hour(),
+                         (unsigned long)(vc.commands ? vc.eou_us_total / vc.commands / 1000 : 0),
+                         (unsigned long)vc.eou_us_max / 1000, (unsigned long)(vc.fed ? vc.feed_cycles / vc.fed : 0),
+                         (unsigned long)vc.fetch_wn_us, (unsigned long)vc.fetch_vad_us,
+                         (unsigned long)(vc.mn_chunks ? vc.mn_us_total / vc.mn_chunks : 0), vc.afe_load,
+                         vc.core_load[0], vc.core_load[1], (unsigned long)vc.lag_ms, (unsigned long)kbps,
+                         s_ctx_names[ctx]));
+    }
+    if (s_fp)
+    {
+        fflush(s_fp);
+        fsync(fileno(s_fp));
+    }
+    xSemaphoreGive(s_file_lock);
+}
+
+static void bench_task(void *arg)
+{
+    TickType_t next = xTaskGetTickCount() + pdMS_TO_TICKS(VOICE_BENCH_PERIOD_MS);
+    for (;;)
+    {
+        TickType_t now = xTaskGetTickCount();
+        voice_cmd_event_t ev;
+        if ((int32_t)(next - now) > 0 && xQueueReceive(s_queue, &ev, next - now) == pdTRUE)
+        {
+            write_event(&ev);
+            continue;
+        }
+        next += pdMS_TO_TICKS(VOICE_BENCH_PERIOD_MS);
+
+        voice_bench_ctx_t ctx = bench_ctx();
+        uint32_t kbps = psram_probe();
+        portENTER_CRITICAL(&s_lock);
+        uint32_t n = ++s_stats.probes[ctx];
+        s_kbps_sum[ctx] += kbps;
+        s_stats.psram_kbps[ctx] = s_kbps_sum[ctx] / n;
+        if (n == 1 || kbps < s_stats.psram_kbps_min[ctx])
+        {
+            s_stats.psram_kbps_min[ctx] = kbps;
+        }
+        s_stats.psram_kbps_last = kbps;
+        s_stats.ctx_last = ctx;
+        portEXIT_CRITICAL(&s_lock);
+        write_stat(kbps, ctx);
+    }
+}
+
+// 在识别任务或LVGL任务里 队列满了就丢
+static void bench_listener(const voice_cmd_event_t *ev)
+{
+    if (xQueueSend(s_queue, ev, 0) != pdTRUE)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.dropped++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+static void bench_sd_event(const evt_t *ev)
+{
+    if (ev->a == SD_HOTPLUG_REMOVED)
+    {
+        xSemaphoreTake(s_file_lock, portMAX_DELAY);
+        file_close();
+        xSemaphoreGive(s_file_lock);
+    }
+}
+
+// 在LVGL任务里 接在性能浮层下面
+static void bench_overlay(char *buf, size_t len)
+{
+    voice_cmd_stats_t vc;
+    voice_cmd_get_stats(&vc);
+    voice_bench_stats_t bs;
+    voice_bench_get_stats(&bs);
+    snprintf(buf, len, "WN %lu VAD %lu MN %lu us\nAFE %u%% lag %lu ms\nEOU %lu/%lu ms FA %.1f/h\nPSRAM %lu MB/s %s",
+             (unsigned long)(vc.fetch_wn_us > vc.fetch_vad_us ? vc.fetch_wn_us - vc.fetch_vad_us : 0),
+             (unsigned long)vc.fetch_vad_us, (unsigned long)(vc.mn_chunks ? vc.mn_us_total / vc.mn_chunks : 0),
+             vc.afe_load, (unsigned long)vc.lag_ms,
+             (unsigned long)(vc.commands ? vc.eou_us_total / vc.commands / 1000 : 0),
+             (unsigned long)vc.eou_us_max / 1000, voice_bench_false_per_hour(),
+             (unsigned long)bs.psram_kbps_last / 1024, s_ctx_names[bs.ctx_last]);
+}
+
+esp_err_t voice_bench_start(void)
+{
+    if (s_queue)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_src = heap_caps_malloc(VOICE_BENCH_PSRAM_BYTES, MALLOC_CAP_SPIRAM);
+    s_dst = heap_caps_malloc(VOICE_BENCH_PSRAM_BYTES, MALLOC_CAP_SPIRAM);
+    s_file_lock = xSemaphoreCreateMutex();
+    s_queue = xQueueCreate(VOICE_BENCH_QUEUE, sizeof(voice_cmd_event_t));
+    ESP_RETURN_ON_FALSE(s_src && s_dst && s_file_lock && s_queue, ESP_ERR_NO_MEM, TAG, "no memory");
+    memset(s_src, 0x5a, VOICE_BENCH_PSRAM_BYTES);
+    s_t_start = esp_timer_get_time();
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_VOICE_BENCH, bench_task, NULL, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+    evt_bus_subscribe(EVT_SD, bench_sd_event, EVT_BUS_DIRECT);
+    voice_cmd_set_listener(bench_listener);
+    ui_perf_overlay_set_extra(bench_overlay);
+    return ESP_OK;
+}
+
+void voice_bench_get_stats(voice_bench_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 语音识别的基准和遥测 ****************************/
+// 换模型(WN9还是别的唤醒词 MN6还是MN7)要拿数据比 延迟 误唤醒 各段耗时由voice_cmd自己记 这里落到卡上和性能浮层里
+// 每VOICE_BENCH_PERIOD_MS测一次PSRAM带宽 按当时相机界面开着 GIF在放 都没有分开记 再写一行汇总
+// 唤醒 命令 超时由voice_cmd的监听交过来 排进队列 后台任务写卡 监听里不碰卡
+// 带宽: 两块VOICE_BENCH_PSRAM_BYTES的PSRAM对拷 比数据cache大 每次都真的走总线
+//   分VOICE_BENCH_SLICES段各自计时取中位数 被抢占的那几段不影响结果 是相对值 只拿来比有没有相机和GIF
+// 卡拔了就关文件 再插上的下一个周期新开一个
+//
+// 文件 VOICE_BENCH_DIR/voice_MMDD_HHMMSS.csv 一行一条 第二列是类型 #开头的两行是两种行的列名
+//   wake command timeout false_wake: t_ms,type,cmd,prob,eou_ms,action_ms,lag_ms,music
+//   stat: t_ms,stat,wakes,commands,false_wakes,fa_per_h,eou_avg_ms,eou_max_ms,feed_cyc,fetch_wn_us,fetch_vad_us,
+//         mn_us,afe_pct,core0,core1,lag_ms,psram_kbps,ctx
+// 时间都是开机以来的毫秒 每个周期fsync一次 断电最多丢一个周期
+
+#define VOICE_BENCH_DIR         SD_MOUNT_POINT"/voice"
+#define VOICE_BENCH_PERIOD_MS   5000
+#define VOICE_BENCH_PSRAM_BYTES (64 * 1024)
+#define VOICE_BENCH_SLICES      16
+#define VOICE_BENCH_QUEUE       16      // 两个周期之间最多攒这么多事件
+
+typedef enum {
+    VOICE_BENCH_IDLE,                   // 没开相机 没放GIF
+    VOICE_BENCH_CAMERA,                 // 相机界面开着 同时放GIF也算这个
+    VOICE_BENCH_GIF,
+    VOICE_BENCH_CTXS,
+} voice_bench_ctx_t;
+
+typedef struct {
+    uint32_t probes[VOICE_BENCH_CTXS];
+    uint32_t psram_kbps[VOICE_BENCH_CTXS];      // 平均 KB/s
+    uint32_t psram_kbps_min[VOICE_BENCH_CTXS];
+    uint32_t psram_kbps_last;
+    voice_bench_ctx_t ctx_last;
+    uint32_t rows;                      // 写到卡上的行
+    uint32_t dropped;                   // 队列满了丢的事件
+    uint32_t write_errors;
+    uint32_t files;
+    bool logging;                       // 现在有文件开着
+} voice_bench_stats_t;
+
+esp_err_t voice_bench_start(void);      // voice_cmd_start之后调用 没卡也能跑 插上卡以后下一个周期开文件
+void voice_bench_get_stats(voice_bench_stats_t *stats);
+float voice_bench_false_per_hour(void); // 从开始到现在的误唤醒 每小时
+const char *voice_bench_ctx_name(voice_bench_ctx_t ctx);
@@ -0,0 +1,1032 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "voice_cmd.h"
+#include "task_plan.h"
+#include "app_ui.h"
+#include "ui_msg.h"
+#include "esp32_s3_szp.h"
+#include "audio_pcm.h"
+#include "audio_player.h"
+#include "audio_resample.h"
+#include "voice_ref.h"
+#include "voice_tts.h"
+#include "esp_afe_sr_models.h"
+#include "esp_mn_models.h"
+#include "esp_mn_iface.h"
+#include "esp_mn_speech_commands.h"
+#include "esp_wn_iface.h"
+#include "esp_wn_models.h"
+#include "model_path.h"
+#if CONFIG_APP_VOICE_GATE
+#include "esp_vad.h"
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "pm_ctl.h"
+
+static const char *TAG = "voice_cmd";
+
+#define VOICE_MODEL_PART    "model"
+#define VOICE_HAVE_RUNTIME  (CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+
+typedef struct {
+    const char *pinyin;                 // MultiNet6的命令 拼音 字之间空格隔开
+    void (*action)(void);               // 在LVGL任务里执行
+    voice_tts_phrase_t say;             // 执行完说的 VOICE_TTS_VOLUME说调整后的音量
+} voice_cmd_t;
+
+// 下标就是命令ID 同一个动作可以有几种说法
+static const voice_cmd_t s_cmds[] = {
+    {"bo fang yin yue", ai_play, VOICE_TTS_PLAY},
+    {"zan ting", ai_pause, VOICE_TTS_PAUSE},
+    {"zan ting bo fang", ai_pause, VOICE_TTS_PAUSE},
+    {"ji xu bo fang", ai_resume, VOICE_TTS_RESUME},
+    {"shang yi shou", ai_prev_music, VOICE_TTS_PREV},
+    {"xia yi shou", ai_next_music, VOICE_TTS_NEXT},
+    {"zeng da yin liang", ai_volume_up, VOICE_TTS_VOLUME},
+    {"da sheng yi dian", ai_volume_up, VOICE_TTS_VOLUME},
+    {"jian xiao yin liang", ai_volume_down, VOICE_TTS_VOLUME},
+    {"xiao sheng yi dian", ai_volume_down, VOICE_TTS_VOLUME},
+    {"da kai zi tai", ai_open_icon1, VOICE_TTS_OPEN},
+    {"da kai yin yue", ai_open_icon2, VOICE_TTS_OPEN},
+    {"da kai cun chu ka", ai_open_icon3, VOICE_TTS_OPEN},
+    {"da kai xiang ji", ai_open_icon4, VOICE_TTS_OPEN},
+    {"da kai wu xian wang luo", ai_open_icon5, VOICE_TTS_OPEN},
+    {"da kai lan ya", ai_open_icon6, VOICE_TTS_OPEN},
+    {"tui chu", ai_tuichu, VOICE_TTS_BACK},
+    {"fan hui", ai_tuichu, VOICE_TTS_BACK},
+#if CONFIG_APP_VOICE_MEMO
+    {"kai shi lu yin", ai_memo_start, VOICE_TTS_RECORD},
+    {"ting zhi lu yin", ai_memo_stop, VOICE_TTS_SAVED},
+    {"jie shu lu yin", ai_memo_stop, VOICE_TTS_SAVED},
+#endif
+};
+#define VOICE_CMD_COUNT     (sizeof(s_cmds) / sizeof(s_cmds[0]))
+_Static_assert(VOICE_CMD_COUNT <= VOICE_CMD_DYN_BASE, "fixed commands overlap dynamic IDs");
+
+static const esp_afe_sr_iface_t *s_afe = &ESP_AFE_SR_HANDLE;
+static esp_afe_sr_data_t *s_afe_data;
+static esp_mn_iface_t *s_mn;
+static model_iface_data_t *s_mn_data;
+static int16_t *s_feed_buf;
+static int s_feed_chunk;                // AFE每次要的帧数 每帧三路
+#if CONFIG_APP_VOICE_REF_LOOPBACK
+#define VOICE_MIC16_FRAMES  1024        // 读一块转到16k以后的上限 8k升到16k也够
+static int16_t *s_afe_buf;              // 两路麦克风加参考 攒够s_feed_chunk帧送给AFE
+static int16_t *s_mic16;
+static audio_resample_t s_mic_rs;
+#endif
+static TaskHandle_t s_feed_task;
+static TaskHandle_t s_detect_task;
+static volatile bool s_listening;
+static atomic_uint s_fed_frames;        // 送进AFE的帧数 识别任务拿来算积压
+static int64_t s_wake_t;                // 识别出结果的时刻 界面执行完时拿来算延迟
+static int64_t s_cmd_t;
+static bool s_cmd_music;                // 命令是放着歌的时候说的
+static uint64_t s_load_sum[2][2];       // [放着歌][核] 负载累加 算平均
+static uint32_t s_load_n[2];
+static float s_cmd_prob;
+static uint32_t s_cmd_lag;
+static int64_t s_eou_t;                 // 命令最后一块人声的录音时刻
+static voice_cmd_listener_t s_listener;
+static voice_cmd_mic_tap_t s_mic_tap;
+static volatile voice_cmd_afe_tap_t s_afe_tap;
+static voice_cmd_dyn_action_t s_dyn_action;
+static voice_cmd_edit_fn_t s_edit_fn;   // 等识别任务来调 s_lock管着
+static void *s_edit_arg;
+static bool s_edit_running;
+static SemaphoreHandle_t s_edit_done;
+static TaskHandle_t s_afe_tasks[VOICE_AFE_TASKS];
+static int s_afe_task_n;
+static uint32_t s_win_wn;               // 这个负载窗口里开着WakeNet取的块数 识别任务加 送数任务算负载时清 都在s_lock里
+static uint32_t s_win_mn;               // 在听命令时取的块数
+static uint64_t s_win_mn_us;
+#if CONFIG_APP_VOICE_GATE
+static vad_handle_t s_vad;
+static int16_t s_vad_frame[VOICE_GATE_FRAME];   // 一块里第0路麦克风的10ms 排成连续的给VAD
+static int16_t *s_preroll;              // 门关着时的块 排好的三路 环形 PSRAM
+static int s_preroll_n;                 // 能放几块
+static int s_preroll_head;              // 下一块写在哪
+static int s_preroll_fill;
+static volatile bool s_gate_open;
+static volatile bool s_gate_woke;       // 这次开门以后唤醒过
+static int s_gate_run;                  // 连着判成人声的VAD帧数
+static int64_t s_gate_speech_t;         // 最后一帧人声
+static int64_t s_gate_open_t;
+static uint64_t s_load_gate_sum[2][2];  // [开着门][核]
+static uint32_t s_load_gate_n[2];
+#endif
+static voice_cmd_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void voice_emit(voice_cmd_event_type_t type, int cmd, uint32_t lag_ms, uint32_t eou_us, uint32_t action_us,
+                       bool music)
+{
+    voice_cmd_listener_t cb = s_listener;
+    if (cb)
+    {
+        voice_cmd_event_t ev = {
+            .type = type,
+            .cmd = cmd,
+            .prob = type == VOICE_EV_COMMAND ? s_cmd_prob : 0,
+            .lag_ms = lag_ms,
+            .eou_us = eou_us,
+            .action_us = action_us,
+            .music = music,
+        };
+        cb(&ev);
+    }
+}
+
+// 以下三个在LVGL任务里执行
+static void voice_wake_ui(void *arg)
+{
+    ai_gui_in();
+    uint32_t us = esp_timer_get_time() - s_wake_t;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.wake_ui_us_total += us;
+    if (us > s_stats.wake_ui_us_max)
+    {
+        s_stats.wake_ui_us_max = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void voice_timeout_ui(void *arg)
+{
+    ai_gui_out();
+}
+
+static void voice_action(void *arg)
+{
+    int id = (intptr_t)arg;
+    const voice_cmd_t *cmd = id < VOICE_CMD_COUNT ? &s_cmds[id] : NULL;
+    ai_gui_out();
+    voice_tts_phrase_t say;
+    if (cmd)
+    {
+        cmd->action();
+        say = cmd->say;
+    }
+    else
+    {
+        say = s_dyn_action(id);
+    }
+    int64_t now = esp_timer_get_time();
+    uint32_t us = now - s_cmd_t;
+    uint32_t eou = now - s_eou_t;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.commands++;
+    s_stats.commands_music += s_cmd_music;
+    s_stats.cmd_us_total += us;
+    if (us > s_stats.cmd_us_max)
+    {
+        s_stats.cmd_us_max = us;
+    }
+    s_stats.eou_us_total += eou;
+    if (eou > s_stats.eou_us_max)
+    {
+        s_stats.eou_us_max = eou;
+    }
+    if (cmd == NULL)
+    {
+        s_stats.dyn_commands++;
+        s_stats.dyn_eou_us_total += eou;
+        if (eou > s_stats.dyn_eou_us_max)
+        {
+            s_stats.dyn_eou_us_max = eou;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "command %d done in %lu us, %lu ms after speech ended", id, (unsigned long)us,
+             (unsigned long)eou / 1000);
+    voice_emit(VOICE_EV_COMMAND, id, s_cmd_lag, eou, us, s_cmd_music);
+#if CONFIG_APP_VOICE_TTS
+    if (say == VOICE_TTS_VOLUME)
+    {
+        voice_tts_say_volume(audio_pcm_get_volume());
+    }
+    else
+    {
+        voice_tts_say(say);
+    }
+#else
+    (void)say;
+#endif
+}
+
+// 在识别任务里 改命令表这段时间AFE里积压着
+static void voice_edit_run(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    voice_cmd_edit_fn_t fn = s_edit_fn;
+    void *arg = s_edit_arg;
+    s_edit_fn = NULL;
+    s_edit_running = fn != NULL;
+    portEXIT_CRITICAL(&s_lock);
+    if (fn == NULL)
+    {
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    fn(arg);
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_edit_running = false;
+    s_stats.edits++;
+    if (us > s_stats.edit_us_max)
+    {
+        s_stats.edit_us_max = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    xSemaphoreGive(s_edit_done);
+}
+
+static inline void voice_mic_tap(const int16_t *mic, size_t frames, int stride)
+{
+    voice_cmd_mic_tap_t tap = s_mic_tap;
+    if (tap)
+    {
+        tap(mic, frames, stride);
+    }
+}
+
+// pack是其中把四路排成AFE要的格式花的
+static void feed_account(uint32_t cycles, uint32_t pack, bool skipped)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (skipped)
+    {
+        s_stats.skipped++;
+    }
+    else
+    {
+        s_stats.fed++;
+        s_stats.feed_cycles += cycles;
+        s_stats.pack_cycles += pack;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#if CONFIG_APP_VOICE_GATE
+// 一块三路里的第0路按10ms一帧过VAD 块尾不够一帧的几个样本不看
+static bool gate_vad(const int16_t *chunk)
+{
+    bool speech = false;
+    for (int f = 0; f + VOICE_GATE_FRAME <= s_feed_chunk; f += VOICE_GATE_FRAME)
+    {
+        for (int i = 0; i < VOICE_GATE_FRAME; i++)
+        {
+            s_vad_frame[i] = chunk[3 * (f + i)];
+        }
+        if (vad_process(s_vad, s_vad_frame, VOICE_SAMPLE_RATE, 10) == VAD_SPEECH)
+        {
+            speech = ++s_gate_run >= VOICE_GATE_ONSET;
+        }
+        else
+        {
+            s_gate_run = 0;
+        }
+    }
+    return speech;
+}
+
+static void gate_set(bool open, int64_t now)
+{
+    s_gate_open = open;
+    pm_ctl_set(PM_CLIENT_VOICE, open); // 门关着只跑VAD 可以降频
+    portENTER_CRITICAL(&s_lock);
+    if (open)
+    {
+        s_stats.gate_opens++;
+    }
+    else
+    {
+        s_stats.gate_idle_opens += !s_gate_woke;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (open)
+    {
+        s_gate_open_t = now;
+        s_gate_woke = false;
+    }
+    else
+    {
+        ESP_LOGD(TAG, "gate closed after %lu ms", (unsigned long)((now - s_gate_open_t) / 1000));
+    }
+}
+
+// 门开着返回true 这块照常送AFE 关着的块存进预录的环
+// 有人声就开门 先把预录的几块按顺序补进AFE 唤醒词开头那几十毫秒不会丢
+// 听命令 改命令表(识别任务要取得到数才会去改) 对讲接着AFE输出时不关
+static bool gate_pass(const int16_t *chunk)
+{
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    bool speech = gate_vad(chunk);
+    int64_t now = esp_timer_get_time();
+    if (speech)
+    {
+        s_gate_speech_t = now;
+    }
+    bool keep = speech || s_listening || s_edit_fn || s_edit_running || s_afe_tap;
+    if (s_gate_open && !keep && now - s_gate_speech_t >= VOICE_GATE_HANG_MS * 1000LL)
+    {
+        gate_set(false, now);
+        s_preroll_fill = 0;
+    }
+    else if (!s_gate_open && keep)
+    {
+        gate_set(true, now);
+        int n = s_preroll_fill;
+        for (int i = 0; i < n; i++)
+        {
+            int k = (s_preroll_head - n + i + s_preroll_n) % s_preroll_n;
+            s_afe->feed(s_afe_data, s_preroll + (size_t)k * s_feed_chunk * 3);
+        }
+        atomic_fetch_add_explicit(&s_fed_frames, n * s_feed_chunk, memory_order_relaxed);
+        s_preroll_fill = 0;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.gate_preroll_chunks += n;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    if (!s_gate_open)
+    {
+        memcpy(s_preroll + (size_t)s_preroll_head * s_feed_chunk * 3, chunk, s_feed_chunk * 3 * sizeof(int16_t));
+        s_preroll_head = (s_preroll_head + 1) % s_preroll_n;
+        if (s_preroll_fill < s_preroll_n)
+        {
+            s_preroll_fill++;
+        }
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.vad_cycles += cycles;
+    s_stats.vad_chunks++;
+    s_stats.gated += !s_gate_open;
+    portEXIT_CRITICAL(&s_lock);
+    return s_gate_open;
+}
+#endif
+
+// 排好的一块三路交给AFE 开了门控的话门关着就不送
+static void voice_feed(const int16_t *chunk)
+{
+#if CONFIG_APP_VOICE_GATE
+    if (!gate_pass(chunk))
+    {
+        return;
+    }
+#endif
+    s_afe->feed(s_afe_data, chunk);
+    atomic_fetch_add_explicit(&s_fed_frames, s_feed_chunk, memory_order_relaxed);
+}
+
+static void voice_load_update(void);
+
+// 负载窗口由送数任务推 门关着的时候识别任务一直等在fetch里
+static void voice_load_tick(void)
+{
+    static int64_t t_load;
+    int64_t now = esp_timer_get_time();
+    if (now - t_load >= VOICE_LOAD_PERIOD_MS * 1000)
+    {
+        t_load = now;
+        voice_load_update();
+    }
+}
+
+#if CONFIG_APP_VOICE_REF_LOOPBACK
+// 参考用喇叭实际放的 两路麦克风不管现在什么采样率都转到16k 攒够一块再送
+static void feed_task(void *arg)
+{
+    int bytes = s_feed_chunk * ADC_I2S_CHANNEL * sizeof(int16_t);
+    int fill = 0;                       // s_afe_buf里已有的帧数
+    uint32_t rate = 0;
+    int64_t idx = 0;                    // s_afe_buf第一帧的序号
+    for (;;)
+    {
+        esp_err_t ret = bsp_get_feed_data(true, s_feed_buf, bytes);
+        voice_load_tick();
+        int64_t now = esp_timer_get_time();
+        uint32_t r = bsp_microphone_get_rate();
+        if (ret != ESP_OK || r == 0)
+        {
+            feed_account(0, 0, true);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        size_t frames = s_feed_chunk;
+        if (r != rate)
+        {
+            // 换了采样率 攒了一半的丢掉 重采样器重建
+            rate = r;
+            fill = 0;
+            if (s_mic_rs.in_rate)
+            {
+                audio_resample_deinit(&s_mic_rs);
+            }
+            if (rate != VOICE_SAMPLE_RATE && audio_resample_init(&s_mic_rs, rate, VOICE_SAMPLE_RATE, 2) != ESP_OK)
+            {
+                rate = 0;
+            }
+        }
+        if (rate == 0)
+        {
+            feed_account(0, 0, true);
+            continue;
+        }
+        if (rate == VOICE_SAMPLE_RATE)
+        {
+            // 一块正好是AFE的一块 参考取出来和麦克风一遍排好 原地送 不再过s_afe_buf
+            int64_t first = voice_ref_mic_index(now, frames);
+            int16_t *ref = s_mic16; // 16k时重采样的缓冲用不上 借来放参考
+            voice_ref_read(first, ref, frames, 1);
+            uint32_t p0 = esp_cpu_get_cycle_count();
+            bsp_feed_pack(s_feed_buf, ref, s_feed_buf, frames);
+            uint32_t pack = esp_cpu_get_cycle_count() - p0;
+            voice_mic_tap(s_feed_buf, frames, 3);
+            voice_ref_estimate(s_feed_buf, 3, first, frames);
+            voice_feed(s_feed_buf);
+            fill = 0;
+            feed_account(esp_cpu_get_cycle_count() - c0, pack, false);
+            continue;
+        }
+        // 四路里取1和3两路麦克风 原地排到前面 转到16k再和参考拼
+        uint32_t p0 = esp_cpu_get_cycle_count();
+        bsp_feed_pick_mics(s_feed_buf, s_feed_buf, s_feed_chunk);
+        uint32_t pack = esp_cpu_get_cycle_count() - p0;
+        size_t used = 0;
+        frames = audio_resample_process(&s_mic_rs, s_feed_buf, s_feed_chunk, s_mic16, VOICE_MIC16_FRAMES, &used);
+        const int16_t *mic = s_mic16;
+        voice_mic_tap(mic, frames, 2);
+        int64_t first = voice_ref_mic_index(now, frames);
+        if (fill == 0)
+        {
+            idx = first;
+        }
+        else if (first != idx + fill)
+        {
+            fill = 0; // 麦克风重新对齐了 攒的和参考对不上
+            idx = first;
+        }
+        uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+
+        for (size_t done = 0; done < frames;)
+        {
+            size_t n = frames - done < (size_t)(s_feed_chunk - fill) ? frames - done : (size_t)(s_feed_chunk - fill);
+            c0 = esp_cpu_get_cycle_count();
+            int16_t *dst = s_afe_buf + 3 * fill;
+            for (size_t i = 0; i < n; i++)
+            {
+                dst[3 * i] = mic[2 * (done + i)];
+                dst[3 * i + 1] = mic[2 * (done + i) + 1];
+            }
+            voice_ref_read(idx + fill, dst + 2, n, 3);
+            fill += n;
+            done += n;
+            if (fill == s_feed_chunk)
+            {
+                voice_ref_estimate(s_afe_buf, 3, idx, s_feed_chunk);
+                voice_feed(s_afe_buf);
+                idx += fill;
+                fill = 0;
+            }
+            cycles += esp_cpu_get_cycle_count() - c0;
+            if (fill == 0)
+            {
+                feed_account(cycles, pack, false);
+                cycles = 0;
+                pack = 0;
+            }
+        }
+    }
+}
+#else
+// 参考用ES7210的第0路 播放把采样率改掉以后就不送了
+static void feed_task(void *arg)
+{
+    // ES7210读出来是四路 原地排成三路 缓冲按四路分配
+    int bytes = s_feed_chunk * ADC_I2S_CHANNEL * sizeof(int16_t);
+    for (;;)
+    {
+        esp_err_t ret = bsp_get_feed_data(true, s_feed_buf, bytes);
+        voice_load_tick();
+        if (ret != ESP_OK || bsp_microphone_get_rate() != VOICE_SAMPLE_RATE)
+        {
+            feed_account(0, 0, true);
+            if (ret != ESP_OK)
+            {
+                vTaskDelay(pdMS_TO_TICKS(10));
+            }
+            continue;
+        }
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        bsp_feed_pack(s_feed_buf, NULL, s_feed_buf, s_feed_chunk);
+        uint32_t pack = esp_cpu_get_cycle_count() - c0;
+        voice_mic_tap(s_feed_buf, s_feed_chunk, 3);
+        voice_feed(s_feed_buf);
+        uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+        feed_account(cycles, pack, false);
+    }
+}
+#endif
+
+// 放歌和不放分开统计 比较回声消除前后的识别率和负载
+static bool voice_music_on(void)
+{
+    return audio_player_get_state() == AUDIO_PLAYER_STATE_PLAYING;
+}
+
+#if VOICE_HAVE_RUNTIME
+static uint32_t task_runtime(TaskHandle_t task)
+{
+    TaskStatus_t st;
+    vTaskGetInfo(task, &st, pdFALSE, eRunning);
+    return st.ulRunTimeCounter;
+}
+#endif
+
+// 运行时间统计用esp_timer 单位是微秒 空闲任务没跑的就是忙的
+static void voice_load_update(void)
+{
+#if VOICE_HAVE_RUNTIME
+    static int64_t t_last;
+    static uint32_t idle_last[2], feed_last, detect_last, afe_last;
+    int64_t now = esp_timer_get_time();
+    uint32_t idle[2];
+    for (int i = 0; i < 2; i++)
+    {
+        idle[i] = task_runtime(xTaskGetIdleTaskHandleForCPU(i));
+    }
+    uint32_t feed = task_runtime(s_feed_task);
+    uint32_t detect = task_runtime(s_detect_task);
+    uint32_t afe = 0;
+    for (int i = 0; i < s_afe_task_n; i++)
+    {
+        afe += task_runtime(s_afe_tasks[i]);
+    }
+    uint32_t span = now - t_last;
+    if (t_last && span)
+    {
+        portENTER_CRITICAL(&s_lock);
+        int m = voice_music_on();
+        for (int i = 0; i < 2; i++)
+        {
+            uint32_t busy = idle[i] - idle_last[i] < span ? span - (idle[i] - idle_last[i]) : 0;
+            s_stats.core_load[i] = (uint64_t)busy * 100 / span;
+            s_load_sum[m][i] += s_stats.core_load[i];
+        }
+        s_load_n[m]++;
+        for (int i = 0; i < 2; i++)
+        {
+            s_stats.load_music[i] = s_load_n[1] ? s_load_sum[1][i] / s_load_n[1] : 0;
+            s_stats.load_quiet[i] = s_load_n[0] ? s_load_sum[0][i] / s_load_n[0] : 0;
+        }
+        if (m)
+        {
+            s_stats.music_ms += span / 1000;
+        }
+        else
+        {
+            s_stats.quiet_ms += span / 1000;
+        }
+        s_stats.feed_load = (uint64_t)(feed - feed_last) * 100 / span;
+        s_stats.detect_load = (uint64_t)(detect - detect_last) * 100 / span;
+        s_stats.afe_load = (uint64_t)(afe - afe_last) * 100 / span;
+#if CONFIG_APP_VOICE_GATE
+        // 门开着时就是原来一直开着的流水线 和关着的比 省下多少
+        int g = s_gate_open;
+        for (int i = 0; i < 2; i++)
+        {
+            s_load_gate_sum[g][i] += s_stats.core_load[i];
+        }
+        s_load_gate_n[g]++;
+        for (int i = 0; i < 2; i++)
+        {
+            s_stats.load_open[i] = s_load_gate_n[1] ? s_load_gate_sum[1][i] / s_load_gate_n[1] : 0;
+            s_stats.load_gated[i] = s_load_gate_n[0] ? s_load_gate_sum[0][i] / s_load_gate_n[0] : 0;
+        }
+#endif
+        // 整个窗口只在一种状态里的才算得出每块的CPU时间
+        uint32_t busy = detect - detect_last;
+        if (s_win_wn && !s_win_mn)
+        {
+            s_stats.fetch_wn_us = busy / s_win_wn;
+        }
+        else if (s_win_mn && !s_win_wn)
+        {
+            s_stats.fetch_vad_us = busy > s_win_mn_us ? (busy - s_win_mn_us) / s_win_mn : 0;
+        }
+        portEXIT_CRITICAL(&s_lock);
+    }
+    t_last = now;
+    memcpy(idle_last, idle, sizeof(idle));
+    feed_last = feed;
+    detect_last = detect;
+    afe_last = afe;
+#endif
+#if CONFIG_APP_VOICE_GATE
+    static int64_t t_gate;
+    int64_t t = esp_timer_get_time();
+    uint32_t ms = t_gate ? (t - t_gate) / 1000 : 0;
+    t_gate = t;
+#endif
+    portENTER_CRITICAL(&s_lock);
+#if CONFIG_APP_VOICE_GATE
+    if (s_gate_open)
+    {
+        s_stats.gate_open_ms += ms;
+    }
+    else
+    {
+        s_stats.gate_closed_ms += ms;
+    }
+#endif
+    s_win_wn = 0;
+    s_win_mn = 0;
+    s_win_mn_us = 0;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void detect_task(void *arg)
+{
+    int fetch_chunk = s_afe->get_fetch_chunksize(s_afe_data);
+    uint32_t fetched = 0;
+    int64_t speech_t = 0;               // 唤醒后最后一块人声的录音时刻
+    int64_t wake_rec_t = 0;             // 唤醒词那一块的录音时刻
+    bool heard = false;                 // 唤醒词之后听到过人声
+    for (;;)
+    {
+        afe_fetch_result_t *res = s_afe->fetch(s_afe_data);
+        int64_t now = esp_timer_get_time();
+        if (res == NULL || res->ret_value == ESP_FAIL)
+        {
+            continue;
+        }
+        fetched += fetch_chunk;
+        if (!s_listening && s_edit_fn)
+        {
+            voice_edit_run();
+        }
+        uint32_t lag_ms = (atomic_load_explicit(&s_fed_frames, memory_order_relaxed) - fetched) / (VOICE_SAMPLE_RATE / 1000);
+        portENTER_CRITICAL(&s_lock);
+        s_stats.lag_ms = lag_ms;
+        if (lag_ms > s_stats.lag_ms_max)
+        {
+            s_stats.lag_ms_max = lag_ms;
+        }
+        if (s_listening)
+        {
+            s_win_mn++;
+        }
+        else
+        {
+            s_win_wn++;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        // 这一块是积压的那么多之前录的
+        int64_t rec_t = now - (int64_t)lag_ms * 1000;
+        voice_cmd_afe_tap_t afe_tap = s_afe_tap;
+        if (afe_tap)
+        {
+            afe_tap(res->data, fetch_chunk, rec_t);
+        }
+        if (s_listening && res->vad_state == AFE_VAD_SPEECH)
+        {
+            speech_t = rec_t;
+            heard |= rec_t - wake_rec_t >= VOICE_WAKE_GRACE_MS * 1000;
+        }
+
+        if (!s_listening)
+        {
+            if (res->wakeup_state != WAKENET_DETECTED)
+            {
+                continue;
+            }
+            // 唤醒后关掉WakeNet 这段时间的算力给MultiNet
+            s_afe->disable_wakenet(s_afe_data);
+            s_mn->clean(s_mn_data);
+            s_listening = true;
+#if CONFIG_APP_VOICE_GATE
+            s_gate_woke = true;
+#endif
+            s_wake_t = now;
+            wake_rec_t = rec_t;
+            speech_t = 0;
+            heard = false;
+            bool music = voice_music_on();
+            portENTER_CRITICAL(&s_lock);
+            s_stats.wakes++;
+            s_stats.wakes_music += music;
+            portEXIT_CRITICAL(&s_lock);
+            ESP_LOGI(TAG, "wake word, lag %lu ms", (unsigned long)lag_ms);
+            ui_post_call(voice_wake_ui, NULL);
+            voice_emit(VOICE_EV_WAKE, -1, lag_ms, 0, 0, music);
+            continue;
+        }
+
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        int64_t t0 = esp_timer_get_time();
+        esp_mn_state_t state = s_mn->detect(s_mn_data, res->data);
+        uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+        uint32_t mn_us = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_lock);
+        s_win_mn_us += mn_us;
+        s_stats.mn_cycles += cycles;
+        s_stats.mn_us_total += mn_us;
+        s_stats.mn_chunks++;
+        if (mn_us > s_stats.mn_us_max)
+        {
+            s_stats.mn_us_max = mn_us;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        if (state == ESP_MN_STATE_DETECTING)
+        {
+            continue;
+        }
+        if (state == ESP_MN_STATE_DETECTED)
+        {
+            esp_mn_results_t *mn = s_mn->get_results(s_mn_data);
+            int id = mn->num > 0 ? mn->command_id[0] : -1;
+            if ((id >= 0 && id < VOICE_CMD_COUNT) || (id >= VOICE_CMD_DYN_BASE && s_dyn_action))
+            {
+                ESP_LOGI(TAG, "command %d \"%s\" prob %.2f, lag %lu ms", id, mn->string, mn->prob[0],
+                         (unsigned long)lag_ms);
+                s_cmd_t = esp_timer_get_time();
+                s_cmd_music = voice_music_on();
+                s_cmd_prob = mn->prob[0];
+                s_cmd_lag = lag_ms;
+                s_eou_t = speech_t ? speech_t : rec_t; // VAD还没来得及判出人声时按这一块算
+                ui_post_call(voice_action, (void *)(intptr_t)id);
+            }
+            else
+            {
+                ui_post_call(voice_timeout_ui, NULL);
+            }
+        }
+        else
+        {
+            bool music = voice_music_on();
+            portENTER_CRITICAL(&s_lock);
+            s_stats.timeouts++;
+            s_stats.timeouts_music += music;
+            s_stats.false_wakes += !heard;
+            portEXIT_CRITICAL(&s_lock);
+            ui_post_call(voice_timeout_ui, NULL);
+            voice_emit(heard ? VOICE_EV_TIMEOUT : VOICE_EV_FALSE_WAKE, -1, lag_ms, 0, 0, music);
+#if CONFIG_APP_VOICE_TTS
+            if (heard)
+            {
+                voice_tts_say(VOICE_TTS_SORRY); // 误唤醒就不出声了
+            }
+#endif
+        }
+        s_listening = false;
+        s_afe->enable_wakenet(s_afe_data);
+    }
+}
+
+// 原来按半字一个个搬的排法 开机跑一遍和bsp_feed_pack比 算省下多少
+static uint32_t feed_pack_bench(void)
+{
+    int16_t *b = s_feed_buf;
+    uint32_t c0 = esp_cpu_get_cycle_count();
+#if CONFIG_APP_VOICE_REF_LOOPBACK
+    // 先排成两路 再和参考一起抄进s_afe_buf
+    for (int i = 0; i < s_feed_chunk; i++)
+    {
+        int16_t m1 = b[4 * i + 1];
+        int16_t m2 = b[4 * i + 3];
+        b[2 * i] = m1;
+        b[2 * i + 1] = m2;
+    }
+    for (int i = 0; i < s_feed_chunk; i++)
+    {
+        s_afe_buf[3 * i] = b[2 * i];
+        s_afe_buf[3 * i + 1] = b[2 * i + 1];
+        s_afe_buf[3 * i + 2] = s_mic16[i];
+    }
+#else
+    for (int i = 0; i < s_feed_chunk; i++)
+    {
+        int16_t ref = b[4 * i + 0];
+        b[3 * i + 0] = b[4 * i + 1];
+        b[3 * i + 1] = b[4 * i + 3];
+        b[3 * i + 2] = ref;
+    }
+#endif
+    return esp_cpu_get_cycle_count() - c0;
+}
+
+static esp_err_t voice_commands_load(void)
+{
+    ESP_RETURN_ON_ERROR(esp_mn_commands_alloc(s_mn, s_mn_data), TAG, "command list alloc failed");
+    esp_mn_commands_clear();
+    for (int i = 0; i < VOICE_CMD_COUNT; i++)
+    {
+        esp_mn_commands_add(i, (char *)s_cmds[i].pinyin);
+    }
+    esp_mn_error_t *err = esp_mn_commands_update();
+    if (err)
+    {
+        for (int i = 0; i < err->num; i++)
+        {
+            ESP_LOGW(TAG, "command \"%s\" rejected by MultiNet", err->phrases[i]->string);
+        }
+    }
+    return ESP_OK;
+}
+
+#if VOICE_HAVE_RUNTIME
+static TaskStatus_t *task_snapshot(UBaseType_t *n)
+{
+    UBaseType_t cap = uxTaskGetNumberOfTasks() + 8;
+    TaskStatus_t *st = malloc(cap * sizeof(TaskStatus_t));
+    *n = st ? uxTaskGetSystemState(st, cap, NULL) : 0;
+    return st;
+}
+
+// AFE不告诉它起了哪些任务 创建前后各拍一次任务表 多出来的 优先级是给AFE的那个 就是它的
+static void afe_tasks_find(const TaskStatus_t *before, UBaseType_t n0, UBaseType_t prio)
+{
+    UBaseType_t n1;
+    TaskStatus_t *after = task_snapshot(&n1);
+    for (UBaseType_t i = 0; i < n1 && s_afe_task_n < VOICE_AFE_TASKS; i++)
+    {
+        bool old = false;
+        for (UBaseType_t j = 0; j < n0 && !old; j++)
+        {
+            old = before[j].xHandle == after[i].xHandle;
+        }
+        if (!old && after[i].uxBasePriority == prio)
+        {
+            s_afe_tasks[s_afe_task_n++] = after[i].xHandle;
+            ESP_LOGI(TAG, "AFE task %s", after[i].pcTaskName);
+        }
+    }
+    free(after);
+}
+#endif
+
+esp_err_t voice_cmd_start(void)
+{
+    if (s_feed_task)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    srmodel_list_t *models = esp_srmodel_init(VOICE_MODEL_PART);
+    ESP_RETURN_ON_FALSE(models && models->num > 0, ESP_ERR_NOT_FOUND, TAG, "no models in the %s partition",
+                        VOICE_MODEL_PART);
+
+    afe_config_t cfg = AFE_CONFIG_DEFAULT();
+    cfg.wakenet_model_name = esp_srmodel_filter(models, ESP_WN_PREFIX, NULL);
+    cfg.afe_perferred_core = task_plan_get(TASK_VOICE_DETECT)->core; // BSS任务跟识别任务在一起
+    cfg.afe_perferred_priority = task_plan_get(TASK_VOICE_DETECT)->prio - 1;
+#if VOICE_HAVE_RUNTIME
+    UBaseType_t n0;
+    TaskStatus_t *before = task_snapshot(&n0);
+#endif
+    s_afe_data = s_afe->create_from_config(&cfg);
+#if VOICE_HAVE_RUNTIME
+    if (s_afe_data && before)
+    {
+        afe_tasks_find(before, n0, cfg.afe_perferred_priority);
+    }
+    free(before);
+#endif
+    ESP_RETURN_ON_FALSE(s_afe_data, ESP_ERR_NO_MEM, TAG, "AFE create failed");
+
+    char *mn_name = esp_srmodel_filter(models, ESP_MN_PREFIX, ESP_MN_CHINESE);
+    s_mn = mn_name ? esp_mn_handle_from_name(mn_name) : NULL;
+    ESP_RETURN_ON_FALSE(s_mn, ESP_ERR_NOT_FOUND, TAG, "no Chinese MultiNet model");
+    s_mn_data = s_mn->create(mn_name, VOICE_CMD_TIMEOUT_MS);
+    ESP_RETURN_ON_FALSE(s_mn_data, ESP_ERR_NO_MEM, TAG, "MultiNet create failed");
+    ESP_RETURN_ON_ERROR(voice_commands_load(), TAG, "commands failed");
+
+    s_edit_done = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(s_edit_done, ESP_ERR_NO_MEM, TAG, "semaphore create failed");
+
+    s_feed_chunk = s_afe->get_feed_chunksize(s_afe_data);
+    s_feed_buf = heap_caps_malloc(s_feed_chunk * ADC_I2S_CHANNEL * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    ESP_RETURN_ON_FALSE(s_feed_buf, ESP_ERR_NO_MEM, TAG, "feed buffer alloc failed");
+#if CONFIG_APP_VOICE_REF_LOOPBACK
+    s_afe_buf = heap_caps_malloc(s_feed_chunk * 3 * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    s_mic16 = heap_caps_malloc(VOICE_MIC16_FRAMES * 2 * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    ESP_RETURN_ON_FALSE(s_afe_buf && s_mic16, ESP_ERR_NO_MEM, TAG, "feed buffer alloc failed");
+    ESP_RETURN_ON_ERROR(voice_ref_init(), TAG, "reference init failed");
+    audio_pcm_set_tap(voice_ref_tap);
+#endif
+    memset(s_feed_buf, 0, s_feed_chunk * ADC_I2S_CHANNEL * sizeof(int16_t));
+    s_stats.pack_scalar_cycles = feed_pack_bench();
+
+#if CONFIG_APP_VOICE_GATE
+    s_vad = vad_create((vad_mode_t)VOICE_GATE_VAD_MODE);
+    ESP_RETURN_ON_FALSE(s_vad, ESP_ERR_NO_MEM, TAG, "VAD create failed");
+    int chunk_ms = s_feed_chunk * 1000 / VOICE_SAMPLE_RATE;
+    s_preroll_n = (VOICE_GATE_PREROLL_MS + chunk_ms - 1) / chunk_ms;
+    s_preroll = heap_caps_malloc((size_t)s_preroll_n * s_feed_chunk * 3 * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(s_preroll, ESP_ERR_NO_MEM, TAG, "pre-roll alloc failed");
+    // 门先关着 有人声才拿CPU_FREQ_MAX锁
+#else
+    pm_ctl_set(PM_CLIENT_VOICE, true); // 一直在听 80MHz跟不上AFE和唤醒词
+#endif
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_VOICE_DETECT, detect_task, NULL, &s_detect_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "detect task create failed");
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_VOICE_FEED, feed_task, NULL, &s_feed_task) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "feed task create failed");
+    ESP_LOGI(TAG, "%s + %s, %d commands, feed %d / fetch %d frames", cfg.wakenet_model_name, mn_name,
+             (int)VOICE_CMD_COUNT, s_feed_chunk, s_afe->get_fetch_chunksize(s_afe_data));
+    return ESP_OK;
+}
+
+bool voice_cmd_listening(void)
+{
+    return s_listening;
+}
+
+void voice_cmd_get_stats(voice_cmd_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void voice_cmd_set_listener(voice_cmd_listener_t cb)
+{
+    s_listener = cb;
+}
+
+esp_err_t voice_cmd_set_mic_tap(voice_cmd_mic_tap_t cb)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool busy = cb && (s_feed_task == NULL || (s_mic_tap && s_mic_tap != cb));
+    if (!busy)
+    {
+        s_mic_tap = cb;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return busy ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t voice_cmd_set_afe_tap(voice_cmd_afe_tap_t cb)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool busy = cb && (s_detect_task == NULL || (s_afe_tap && s_afe_tap != cb));
+    if (!busy)
+    {
+        s_afe_tap = cb;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return busy ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+const char *voice_cmd_name(int cmd)
+{
+    return cmd >= 0 && cmd < VOICE_CMD_COUNT ? s_cmds[cmd].pinyin : "";
+}
+
+void voice_cmd_set_dyn_action(voice_cmd_dyn_action_t cb)
+{
+    s_dyn_action = cb;
+}
+
+esp_err_t voice_cmd_edit(voice_cmd_edit_fn_t fn, void *arg, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(s_detect_task, ESP_ERR_INVALID_STATE, TAG, "voice not started");
+    portENTER_CRITICAL(&s_lock);
+    bool busy = s_edit_fn || s_edit_running;
+    if (!busy)
+    {
+        s_edit_fn = fn;
+        s_edit_arg = arg;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (busy)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(s_edit_done, pdMS_TO_TICKS(timeout_ms)) == pdTRUE)
+    {
+        return ESP_OK;
+    }
+    portENTER_CRITICAL(&s_lock);
+    bool taken = s_edit_fn == NULL;
+    s_edit_fn = NULL;
+    portEXIT_CRITICAL(&s_lock);
+    if (taken)
+    {
+        xSemaphoreTake(s_edit_done, portMAX_DELAY); // 已经在改了 等它改完 arg还在用
+        return ESP_OK;
+    }
+    return ESP_ERR_TIMEOUT;
+}
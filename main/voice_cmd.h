@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "voice_tts.h"
+
+
+/*********************** 语音控制 ****************************/
+// 一直听着唤醒词"Hi 乐鑫" 唤醒后在VOICE_CMD_TIMEOUT_MS里听一句命令 执行app_ui.h里对应的ai_*函数
+// 送数任务在核0 从ES7210读一块 排成AFE要的两路麦克风加一路参考 交给AFE
+// 排列按32位字做(bsp_feed_pack) 16k时原地排好直接送 AFE的feed自己还会抄一次进它的环 这一次省不掉
+// 识别任务在核1 从AFE取处理过的单路音频 平时过WakeNet9 唤醒后关掉WakeNet改过MultiNet6
+// AFE自己的BSS任务也放在核1 核0留给LVGL和解码
+// 录音和播放共用I2S时钟 播放44.1k之类的歌时麦克风也跟着变了
+// 模型放在model分区 idf.py flash时由esp-sr一起烧进去
+//
+// 延迟分两段: 唤醒词到界面出现提示 命令识别出来到界面执行完 都从识别出结果的时刻算起
+// 另外记AFE里积压的音频 取出的比送进去的落后多少 这是说完话到识别出来之前多出的时间
+// 各核负载和两个任务的占比靠FreeRTOS的运行时间统计 没开CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS时是0
+// 唤醒 命令 超时和负载都按放没放歌分开记 对着同样说N次比较回声消除的效果
+// 说完到执行: AFE的VAD最后一块人声的录音时刻(取出时刻减去积压)到界面执行完 含MultiNet等尾音判定的时间
+// 误唤醒: 唤醒后过了VOICE_WAKE_GRACE_MS再没听到人声就超时的 按听的总时长折成每小时
+// 各段耗时: AFE自己的任务在创建前后比一下任务表认出来 按运行时间算负载
+//   取数里的CPU时间按窗口算 整个窗口都开着WakeNet的是AFE取数加WakeNet 整个窗口都在听命令的扣掉MultiNet是只有取数 两者差是WakeNet
+//
+// 回声消除的参考有两种(CONFIG_APP_VOICE_REF_LOOPBACK):
+//   开: 参考是送到喇叭的PCM 见voice_ref.h 麦克风任何采样率都转到16k 放歌时也能用
+//   关: 参考是ES7210的第0路 录音不是16k时不送
+//
+// 门控(CONFIG_APP_VOICE_GATE): 送数任务照常读和排 第0路麦克风按10ms一帧过esp_vad
+// 没人声时块不送AFE 存进预录的环 AFE的BSS WakeNet都等着没活干 也不拿CPU_FREQ_MAX锁 可以降频
+// 连着VOICE_GATE_ONSET帧人声开门 预录的块先补进AFE 唤醒词开头不丢 VOICE_GATE_HANG_MS没人声再关
+// 负载按门开着和关着分开平均 开着的就是原来一直开着的开销
+
+#define VOICE_CMD_TIMEOUT_MS    CONFIG_APP_VOICE_CMD_TIMEOUT_MS
+#define VOICE_SAMPLE_RATE       16000
+#define VOICE_LOAD_PERIOD_MS    2000    // 负载按这么长取一次
+#define VOICE_WAKE_GRACE_MS     400     // 唤醒后这么久里的人声算唤醒词的尾巴
+#define VOICE_AFE_TASKS         4       // 最多认几个AFE的任务
+#define VOICE_CMD_DYN_BASE      32      // 动态命令的ID从这里开始 前面是固定命令的下标
+#if CONFIG_APP_VOICE_GATE
+#define VOICE_GATE_PREROLL_MS   CONFIG_APP_VOICE_GATE_PREROLL_MS
+#define VOICE_GATE_FRAME        (VOICE_SAMPLE_RATE / 100)   // esp_vad一帧10ms
+#define VOICE_GATE_ONSET        3       // 连着这么多帧人声才开门 敲一下桌子不算
+#define VOICE_GATE_HANG_MS      1500    // 开着门这么久没人声就关
+#define VOICE_GATE_VAD_MODE     3       // VAD_MODE_0~4 越大越不容易把噪声当人声
+#endif
+
+typedef struct {
+    uint32_t wakes;
+    uint32_t commands;                  // 识别出来并交给界面的
+    uint32_t timeouts;                  // 唤醒后没听到认识的命令
+    uint32_t fed;                       // 送数任务处理的块数 开了门控时包括门关着没送进AFE的
+    uint32_t skipped;                   // 采样率不对丢掉的块数
+    uint32_t lag_ms;                    // 现在AFE里积压的音频
+    uint32_t lag_ms_max;
+    uint32_t wake_ui_us_max;            // 唤醒到提示出现
+    uint64_t wake_ui_us_total;
+    uint32_t cmd_us_max;                // 命令到执行完
+    uint64_t cmd_us_total;
+    uint64_t feed_cycles;               // 花在重排和AFE feed上的
+    uint64_t mn_cycles;                 // 花在MultiNet上的
+    uint64_t pack_cycles;               // feed_cycles里把四路排成AFE格式的
+    uint32_t pack_scalar_cycles;        // 原来按半字搬一块要的 开机量一次 和pack_cycles/fed比
+    uint32_t wakes_music;               // 上面三个里放着歌的
+    uint32_t commands_music;
+    uint32_t timeouts_music;
+    uint64_t music_ms;                  // 放着歌和没放歌各听了多久
+    uint64_t quiet_ms;
+    uint8_t load_music[2];              // 放着歌和没放歌时各核的平均负载
+    uint8_t load_quiet[2];
+    uint8_t core_load[2];               // 上个VOICE_LOAD_PERIOD_MS里各核的负载 百分比
+    uint8_t feed_load;                  // 其中送数任务占它那个核的
+    uint8_t detect_load;                // 识别任务占核1的
+    uint8_t afe_load;                   // AFE自己的任务占它那个核的
+    uint32_t false_wakes;               // 唤醒后没再听到人声就超时的
+    uint32_t eou_us_max;                // 说完最后一个字到执行完
+    uint64_t eou_us_total;              // 除以commands
+    uint32_t fetch_wn_us;               // 每块取数的CPU时间 开着WakeNet 最近一个整窗口
+    uint32_t fetch_vad_us;              // 关着WakeNet 扣掉MultiNet
+    uint32_t mn_us_max;                 // MultiNet每块
+    uint64_t mn_us_total;
+    uint32_t mn_chunks;
+    uint32_t dyn_commands;              // commands里动态命令的 按歌名放歌这些
+    uint32_t dyn_eou_us_max;            // 动态命令说完到执行完 命令表大了MultiNet每块也慢
+    uint64_t dyn_eou_us_total;
+    uint32_t edits;                     // 识别任务里改过几次命令表
+    uint32_t edit_us_max;               // 改命令表时识别任务停着 积压在lag_ms_max里也看得到
+    uint32_t gate_opens;                // 以下是门控的
+    uint32_t gate_idle_opens;           // 开了门到关上也没唤醒的 说话 放歌 电视
+    uint32_t gated;                     // 门关着没送AFE的块
+    uint32_t gate_preroll_chunks;       // 开门时补进AFE的预录块
+    uint64_t vad_cycles;                // 除以vad_chunks是每块VAD的开销
+    uint32_t vad_chunks;
+    uint64_t gate_open_ms;
+    uint64_t gate_closed_ms;
+    uint8_t load_open[2];               // 门开着和关着时各核的平均负载
+    uint8_t load_gated[2];
+} voice_cmd_stats_t;
+
+typedef enum {
+    VOICE_EV_WAKE,
+    VOICE_EV_COMMAND,
+    VOICE_EV_TIMEOUT,                   // 听到了人声 没认出命令
+    VOICE_EV_FALSE_WAKE,                // 超时 唤醒后没再听到人声
+} voice_cmd_event_type_t;
+
+typedef struct {
+    voice_cmd_event_type_t type;
+    int cmd;                            // s_cmds的下标 只有COMMAND有 其他是-1
+    float prob;
+    uint32_t lag_ms;                    // 出结果时AFE里的积压
+    uint32_t eou_us;                    // COMMAND: 说完到执行完
+    uint32_t action_us;                 // COMMAND: 识别出来到执行完
+    bool music;
+} voice_cmd_event_t;
+
+// 动态命令识别出来 在LVGL任务里调 返回执行完要说的话
+typedef voice_tts_phrase_t (*voice_cmd_dyn_action_t)(int id);
+// 在识别任务里调 这时没在听命令 可以用esp_mn_commands_xxx改命令表 改完自己update
+typedef void (*voice_cmd_edit_fn_t)(void *arg);
+
+// 在识别任务或LVGL任务里调用 不能阻塞
+typedef void (*voice_cmd_listener_t)(const voice_cmd_event_t *ev);
+// 送数任务每读一块调一次 已经是16k 两路麦克风mic[0] mic[1] 下一帧在mic[stride] 要很快返回
+typedef void (*voice_cmd_mic_tap_t)(const int16_t *mic, size_t frames, int stride);
+// 识别任务每取一块调一次 是AFE出来的16k单声道(回声消掉了) rec_t是这一块的录音时刻 要很快返回
+typedef void (*voice_cmd_afe_tap_t)(const int16_t *pcm, size_t frames, int64_t rec_t);
+
+esp_err_t voice_cmd_start(void);        // 音频芯片和主界面都起来以后调用 模型加载在这里做
+bool voice_cmd_listening(void);         // 唤醒了 正在等命令
+void voice_cmd_get_stats(voice_cmd_stats_t *stats);
+void voice_cmd_set_listener(voice_cmd_listener_t cb); // 唤醒 命令 超时各来一次 NULL取消
+esp_err_t voice_cmd_set_mic_tap(voice_cmd_mic_tap_t cb); // 同时只接一个 没在送数或者别人接着返回ESP_ERR_INVALID_STATE NULL取消
+esp_err_t voice_cmd_set_afe_tap(voice_cmd_afe_tap_t cb); // 同上 接着时语音门一直开着
+const char *voice_cmd_name(int cmd);    // 命令的拼音 动态命令是空的
+void voice_cmd_set_dyn_action(voice_cmd_dyn_action_t cb);  // ID不小于VOICE_CMD_DYN_BASE的命令交给它
+// 让识别任务下次取完一块 没在听命令时调fn 调完才返回 timeout_ms内还没轮到就取消 返回ESP_ERR_TIMEOUT
+esp_err_t voice_cmd_edit(voice_cmd_edit_fn_t fn, void *arg, uint32_t timeout_ms);
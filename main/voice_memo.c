@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "voice_memo.h"
+#include "task_plan.h"
+#include "voice_cmd.h"
+#include "audio_adpcm.h"
+#include "esp32_s3_szp.h"
+#include "sd_writer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "voice_memo";
+
+#define MEMO_OUT_BYTES      (VOICE_MEMO_WRITE_BLOCKS * ADPCM_BLOCK_BYTES)
+#define MEMO_SPLIT_SAMPLES  ((uint32_t)VOICE_MEMO_SPLIT_MIN * 60 * VOICE_MEMO_RATE)
+
+_Static_assert(sizeof(voice_memo_wav_t) == 60, "voice_memo_wav_t layout");
+
+static int16_t *s_ring;                 // PSRAM 单声道16k
+static uint32_t s_head;                 // 环的写入和读出 都是一直往上加的样本数
+static uint32_t s_tail;
+static bool s_taking;                   // 送数任务往环里放 停止或写卡出错以后就不放了
+static bool s_active;
+static volatile bool s_stopping;
+static bool s_failed;
+static TaskHandle_t s_task;
+static SemaphoreHandle_t s_done;
+static SemaphoreHandle_t s_api_lock;    // 界面和热插拔任务都可能来停
+static sd_writer_t *s_writer;
+static char s_path[64];
+static audio_adpcm_t s_adpcm;
+static uint8_t *s_out;                  // 攒着还没交给sd_writer的ADPCM块 内部RAM
+static int s_out_blocks;
+static uint32_t s_file_samples;         // 当前文件里已经交出去的样本
+static uint32_t s_file_blocks;
+static int64_t s_header_t;
+static uint32_t s_skipped0;             // 开始时送数任务已经丢的块
+static voice_memo_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 在送数任务里 两路麦克风取平均放进环 整个拷贝都在锁里 停止时不会拷到一半
+static void memo_tap(const int16_t *mic, size_t frames, int stride)
+{
+    bool wake = false;
+    portENTER_CRITICAL(&s_lock);
+    if (s_taking)
+    {
+        uint32_t used = s_head - s_tail;
+        uint32_t n = frames < VOICE_MEMO_RING_SAMPLES - used ? frames : VOICE_MEMO_RING_SAMPLES - used;
+        uint32_t pos = s_head % VOICE_MEMO_RING_SAMPLES;
+        for (uint32_t i = 0; i < n; i++, mic += stride)
+        {
+            s_ring[pos] = (mic[0] + mic[1]) >> 1;
+            pos = pos + 1 == VOICE_MEMO_RING_SAMPLES ? 0 : pos + 1;
+        }
+        s_head += n;
+        s_stats.dropped += frames - n;
+        used += n;
+        if (used > s_stats.ring_peak)
+        {
+            s_stats.ring_peak = used;
+        }
+        wake = used >= ADPCM_BLOCK_SAMPLES * VOICE_MEMO_WRITE_BLOCKS;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (wake)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void wav_header(voice_memo_wav_t *h)
+{
+    uint32_t data = s_file_blocks * ADPCM_BLOCK_BYTES;
+    *h = (voice_memo_wav_t){
+        .riff = {'R', 'I', 'F', 'F'},
+        .riff_bytes = sizeof(*h) - 8 + data,
+        .wave = {'W', 'A', 'V', 'E'},
+        .fmt = {'f', 'm', 't', ' '},
+        .fmt_bytes = 20,
+        .format = ADPCM_WAV_FORMAT,
+        .channels = 1,
+        .rate = VOICE_MEMO_RATE,
+        .byte_rate = (uint32_t)((uint64_t)VOICE_MEMO_RATE * ADPCM_BLOCK_BYTES / ADPCM_BLOCK_SAMPLES),
+        .block_align = ADPCM_BLOCK_BYTES,
+        .bits = 4,
+        .extra_bytes = 2,
+        .block_samples = ADPCM_BLOCK_SAMPLES,
+        .fact = {'f', 'a', 'c', 't'},
+        .fact_bytes = 4,
+        .samples = s_file_samples,
+        .data = {'d', 'a', 't', 'a'},
+        .data_bytes = data,
+    };
+}
+
+static void write_failed(const char *what)
+{
+    if (!s_failed)
+    {
+        ESP_LOGE(TAG, "%s: %s failed, recording stopped", s_path, what);
+    }
+    s_failed = true;
+    portENTER_CRITICAL(&s_lock);
+    s_taking = false;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 攒的块交给sd_writer 两块缓冲都在写时这里会等 环顶着
+static void out_flush(void)
+{
+    if (s_out_blocks == 0 || s_failed)
+    {
+        s_out_blocks = 0;
+        return;
+    }
+    uint32_t bytes = s_out_blocks * ADPCM_BLOCK_BYTES;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t ret = sd_writer_write(s_writer, s_out, bytes);
+    uint32_t us = esp_timer_get_time() - t0;
+    if (ret != ESP_OK)
+    {
+        write_failed("write");
+        return;
+    }
+    s_file_blocks += s_out_blocks;
+    s_out_blocks = 0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += bytes;
+    s_stats.writes++;
+    s_stats.write_us += us;
+    if (us > s_stats.write_max_us)
+    {
+        s_stats.write_max_us = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 只在刚交完一批时改 头里的长度和sd_writer里的对得上
+static void header_update(void)
+{
+    if (s_failed)
+    {
+        return;
+    }
+    voice_memo_wav_t h;
+    wav_header(&h);
+    int64_t t0 = esp_timer_get_time();
+    if (sd_writer_write_at(s_writer, 0, &h, sizeof(h)) != ESP_OK)
+    {
+        write_failed("header");
+        return;
+    }
+    uint32_t us = esp_timer_get_time() - t0;
+    s_header_t = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    if (us > s_stats.header_max_us)
+    {
+        s_stats.header_max_us = us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static esp_err_t file_open(void)
+{
+    if (mkdir(VOICE_MEMO_DIR, 0775) != 0)
+    {
+        struct stat st;
+        ESP_RETURN_ON_FALSE(stat(VOICE_MEMO_DIR, &st) == 0, ESP_FAIL, TAG, "mkdir %s failed", VOICE_MEMO_DIR);
+    }
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    snprintf(s_path, sizeof(s_path), "%s/memo_%02d%02d_%02d%02d%02d.wav", VOICE_MEMO_DIR, tm.tm_mon + 1, tm.tm_mday,
+             tm.tm_hour, tm.tm_min, tm.tm_sec);
+    s_writer = sd_writer_open(s_path, VOICE_MEMO_PREALLOC_BYTES);
+    ESP_RETURN_ON_FALSE(s_writer, ESP_FAIL, TAG, "open %s failed", s_path);
+    s_file_samples = 0;
+    s_file_blocks = 0;
+    s_header_t = esp_timer_get_time();
+    voice_memo_wav_t h;
+    wav_header(&h);
+    ESP_RETURN_ON_ERROR(sd_writer_write(s_writer, &h, sizeof(h)), TAG, "header");
+    portENTER_CRITICAL(&s_lock);
+    s_stats.files++;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%s: recording", s_path);
+    return ESP_OK;
+}
+
+static void file_close(void)
+{
+    if (s_writer == NULL)
+    {
+        return; // 分段时新文件没开成
+    }
+    out_flush();
+    header_update();
+    bool ok = sd_writer_close(s_writer) == ESP_OK && !s_failed;
+    s_writer = NULL;
+    ESP_LOGI(TAG, "%s: %lu s, %lu KB%s", s_path, (unsigned long)(s_file_samples / VOICE_MEMO_RATE),
+             (unsigned long)(s_file_blocks * ADPCM_BLOCK_BYTES / 1024), ok ? "" : ", write failed");
+}
+
+// 环里够一块就编一块 flush时最后不满的一块补0
+static void encode_available(bool flush)
+{
+    static int16_t s_block[ADPCM_BLOCK_SAMPLES];
+    for (;;)
+    {
+        portENTER_CRITICAL(&s_lock);
+        uint32_t avail = s_head - s_tail;
+        portEXIT_CRITICAL(&s_lock);
+        uint32_t n = avail < ADPCM_BLOCK_SAMPLES ? avail : ADPCM_BLOCK_SAMPLES;
+        if (n == 0 || (n < ADPCM_BLOCK_SAMPLES && !flush))
+        {
+            return;
+        }
+        uint32_t pos = s_tail % VOICE_MEMO_RING_SAMPLES;
+        uint32_t first = n < VOICE_MEMO_RING_SAMPLES - pos ? n : VOICE_MEMO_RING_SAMPLES - pos;
+        memcpy(s_block, s_ring + pos, first * sizeof(int16_t));
+        memcpy(s_block + first, s_ring, (n - first) * sizeof(int16_t));
+        memset(s_block + n, 0, (ADPCM_BLOCK_SAMPLES - n) * sizeof(int16_t));
+        portENTER_CRITICAL(&s_lock);
+        s_tail += n;
+        portEXIT_CRITICAL(&s_lock);
+        if (s_failed)
+        {
+            continue; // 写不进去了 只是把环读空
+        }
+
+        // 到了分段的长度 换个文件 下一块进新文件
+        if (s_file_samples + ADPCM_BLOCK_SAMPLES > MEMO_SPLIT_SAMPLES)
+        {
+            file_close();
+            if (file_open() != ESP_OK)
+            {
+                write_failed("split");
+                continue;
+            }
+        }
+        uint32_t c0 = esp_cpu_get_cycle_count();
+        audio_adpcm_encode_block(&s_adpcm, s_block, s_out + s_out_blocks * ADPCM_BLOCK_BYTES);
+        uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+        s_out_blocks++;
+        s_file_samples += n;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.samples += n;
+        s_stats.encode_cycles = cycles;
+        portEXIT_CRITICAL(&s_lock);
+        if (s_out_blocks == VOICE_MEMO_WRITE_BLOCKS)
+        {
+            out_flush();
+            if (esp_timer_get_time() - s_header_t >= VOICE_MEMO_HEADER_S * 1000000LL)
+            {
+                header_update();
+            }
+        }
+    }
+}
+
+static void memo_task(void *arg)
+{
+    while (!s_stopping)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(500));
+        encode_available(false);
+    }
+    encode_available(true); // 停止时送数那边已经不放了 环里剩的就是全部
+    file_close();
+    xSemaphoreGive(s_done);
+    vTaskDelete(NULL);
+}
+
+static void memo_free(void)
+{
+    heap_caps_free(s_ring);
+    s_ring = NULL;
+    heap_caps_free(s_out);
+    s_out = NULL;
+    if (s_done)
+    {
+        vSemaphoreDelete(s_done);
+        s_done = NULL;
+    }
+}
+
+esp_err_t voice_memo_start(void)
+{
+    if (s_api_lock == NULL)
+    {
+        s_api_lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(s_api_lock, ESP_ERR_NO_MEM, TAG, "no memory");
+    }
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (s_active || !bsp_sdcard_mounted())
+    {
+        goto out;
+    }
+    ret = ESP_ERR_NO_MEM;
+    s_ring = heap_caps_malloc(VOICE_MEMO_RING_SAMPLES * sizeof(int16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_out = heap_caps_malloc(MEMO_OUT_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_done = xSemaphoreCreateBinary();
+    if (!s_ring || !s_out || !s_done)
+    {
+        ESP_LOGE(TAG, "recorder buffers alloc failed");
+        memo_free();
+        goto out;
+    }
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_failed = false;
+    ret = file_open();
+    if (ret != ESP_OK)
+    {
+        if (s_writer)
+        {
+            sd_writer_abort(s_writer);
+            s_writer = NULL;
+        }
+        memo_free();
+        goto out;
+    }
+    audio_adpcm_init(&s_adpcm);
+    s_out_blocks = 0;
+    s_head = 0;
+    s_tail = 0;
+    s_stopping = false;
+    voice_cmd_stats_t vc;
+    voice_cmd_get_stats(&vc);
+    s_skipped0 = vc.skipped;
+    ret = ESP_FAIL;
+    if (task_plan_create(TASK_VOICE_MEMO, memo_task, NULL, &s_task) != pdPASS)
+    {
+        sd_writer_abort(s_writer);
+        s_writer = NULL;
+        memo_free();
+        goto out;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_taking = true;
+    s_stats.recording = true;
+    portEXIT_CRITICAL(&s_lock);
+    ret = voice_cmd_set_mic_tap(memo_tap);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "microphones not available (voice control not feeding, or tuner open)");
+        portENTER_CRITICAL(&s_lock);
+        s_taking = false;
+        portEXIT_CRITICAL(&s_lock);
+        s_stopping = true;
+        xTaskNotifyGive(s_task);
+        xSemaphoreTake(s_done, portMAX_DELAY);
+        remove(s_path);
+        memo_free();
+        portENTER_CRITICAL(&s_lock);
+        s_stats.recording = false;
+        portEXIT_CRITICAL(&s_lock);
+        goto out;
+    }
+    s_active = true;
+out:
+    xSemaphoreGive(s_api_lock);
+    return ret;
+}
+
+bool voice_memo_active(void)
+{
+    return s_active;
+}
+
+esp_err_t voice_memo_stop(void)
+{
+    ESP_RETURN_ON_FALSE(s_api_lock, ESP_ERR_INVALID_STATE, TAG, "not recording");
+    xSemaphoreTake(s_api_lock, portMAX_DELAY);
+    if (!s_active)
+    {
+        xSemaphoreGive(s_api_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    voice_cmd_set_mic_tap(NULL);
+    portENTER_CRITICAL(&s_lock);
+    s_taking = false; // 锁里改 送数任务不会拷到一半
+    portEXIT_CRITICAL(&s_lock);
+    s_stopping = true;
+    xTaskNotifyGive(s_task);
+    xSemaphoreTake(s_done, portMAX_DELAY);
+    s_active = false;
+    bool ok = !s_failed;
+    memo_free();
+
+    voice_cmd_stats_t vc;
+    voice_cmd_get_stats(&vc);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.recording = false;
+    s_stats.mic_skipped = vc.skipped - s_skipped0;
+    voice_memo_stats_t st = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%lu s in %lu files, %llu KB, dropped %lu samples, mic skipped %lu chunks, ring peak %lu ms, "
+             "write max %lu us (avg %lu), header max %lu us%s",
+             (unsigned long)(st.samples / VOICE_MEMO_RATE), (unsigned long)st.files,
+             (unsigned long long)(st.bytes / 1024), (unsigned long)st.dropped, (unsigned long)st.mic_skipped,
+             (unsigned long)(st.ring_peak / (VOICE_MEMO_RATE / 1000)), (unsigned long)st.write_max_us,
+             (unsigned long)(st.writes ? st.write_us / st.writes : 0), (unsigned long)st.header_max_us,
+             ok ? "" : ", write failed");
+    xSemaphoreGive(s_api_lock);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+void voice_memo_get_stats(voice_memo_stats_t *stats)
+{
+    voice_cmd_stats_t vc;
+    if (s_active)
+    {
+        voice_cmd_get_stats(&vc);
+    }
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    if (s_active)
+    {
+        stats->mic_skipped = vc.skipped - s_skipped0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
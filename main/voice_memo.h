@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 录音 ****************************/
+// 语音备忘录 两路麦克风取平均 16k单声道 IMA ADPCM压到四分之一 边录边写卡 一小时约29MB
+// 麦克风由语音识别的送数任务读 它每读一块转到16k后交一份过来(voice_cmd_set_mic_tap) 这里不再开I2S
+// 送数任务里只拷进PSRAM的环 编码和写卡在核1的低优先级任务里 编好的攒成一大块交给sd_writer
+// sd_writer两块缓冲轮着写 卡偶尔卡住几百毫秒只是环里多积压一些 环放不下才丢 丢的样本单独计
+// 每VOICE_MEMO_SPLIT_MIN分钟换一个文件 换文件时环接着收 录几个小时也不断
+// 每VOICE_MEMO_HEADER_S秒回头改一次WAV头里的长度 断电也能放出来 最多少最后这一段
+//
+// 文件 VOICE_MEMO_DIR/memo_MMDD_HHMMSS.wav 标准的IMA ADPCM WAV 电脑上直接能放
+//   最后一块不满时补0 fact里是实际的样本数
+
+#define VOICE_MEMO_DIR          SD_MOUNT_POINT"/memo"
+#define VOICE_MEMO_RATE         16000
+#define VOICE_MEMO_RING_MS      CONFIG_APP_VOICE_MEMO_RING_MS
+#define VOICE_MEMO_RING_SAMPLES (VOICE_MEMO_RING_MS * (VOICE_MEMO_RATE / 1000))
+#define VOICE_MEMO_WRITE_BLOCKS 32      // 攒够这么多ADPCM块(8KB 约半秒)交一次sd_writer
+#define VOICE_MEMO_HEADER_S     30
+#define VOICE_MEMO_SPLIT_MIN    CONFIG_APP_VOICE_MEMO_SPLIT_MIN
+#define VOICE_MEMO_PREALLOC_BYTES (CONFIG_APP_VOICE_MEMO_PREALLOC_MB * 1024 * 1024)
+
+typedef struct __attribute__((packed)) {
+    char riff[4];                       // "RIFF"
+    uint32_t riff_bytes;                // 文件大小减8
+    char wave[4];                       // "WAVE"
+    char fmt[4];                        // "fmt "
+    uint32_t fmt_bytes;                 // 20
+    uint16_t format;                    // ADPCM_WAV_FORMAT
+    uint16_t channels;
+    uint32_t rate;
+    uint32_t byte_rate;
+    uint16_t block_align;               // ADPCM_BLOCK_BYTES
+    uint16_t bits;                      // 4
+    uint16_t extra_bytes;               // 2
+    uint16_t block_samples;             // ADPCM_BLOCK_SAMPLES
+    char fact[4];                       // "fact"
+    uint32_t fact_bytes;                // 4
+    uint32_t samples;
+    char data[4];                       // "data"
+    uint32_t data_bytes;
+} voice_memo_wav_t;
+
+typedef struct {
+    bool recording;
+    uint32_t files;                     // 这次录音写了几个文件
+    uint64_t samples;                   // 写进文件的
+    uint64_t bytes;                     // 交给sd_writer的
+    uint32_t dropped;                   // 环满了丢的样本 卡写得太慢
+    uint32_t mic_skipped;               // 送数任务没读到的块 麦克风那边断了
+    uint32_t ring_peak;                 // 环里最多积压的样本
+    uint32_t writes;                    // sd_writer_write的次数
+    uint32_t write_max_us;              // 最慢的一次 两块缓冲都在写就要等
+    uint64_t write_us;
+    uint32_t header_max_us;             // 回头改头 要等缓冲写完
+    uint32_t encode_cycles;             // 每块ADPCM 最近一块
+} voice_memo_stats_t;
+
+esp_err_t voice_memo_start(void);       // 语音识别在送数时才能录 不然返回ESP_ERR_INVALID_STATE
+bool voice_memo_active(void);
+esp_err_t voice_memo_stop(void);        // 环里的写完 补上头 会阻塞
+void voice_memo_get_stats(voice_memo_stats_t *stats);   // 录的时候也可以调用 停了保留最后一次的
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "voice_ref.h"
+#include "audio_resample.h"
+#include "esp32_s3_szp.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "voice_ref";
+
+#define REF_MASK        (VOICE_REF_RING - 1)
+#define REF_OUT_FRAMES  (VOICE_REF_BLOCK * 2)   // 8k的歌升到16k最多翻倍
+#define EST_MIN_RMS     64                      // 参考或麦克风比这还小就不做互相关
+
+static int16_t *s_ring;                 // PSRAM 按序号取模
+static int64_t s_hi;                    // 写到的最大序号+1 以下VOICE_REF_RING个是有效的
+static int64_t s_next;                  // 播放一侧接着排的序号
+static int64_t s_mic_next;              // 麦克风一侧 只在送数任务里用
+static int64_t s_est_next;              // 下次互相关的序号
+static volatile int32_t s_delay;
+static uint32_t s_rate;                 // 重采样器现在的输入采样率
+static audio_resample_t s_rs;
+static bool s_rs_active;
+static int16_t s_mono[VOICE_REF_BLOCK];
+static int16_t s_out[REF_OUT_FRAMES];
+static int16_t s_est_ref[VOICE_REF_EST_LEN + 2 * VOICE_REF_EST_SEARCH];
+static voice_ref_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t voice_ref_init(void)
+{
+    if (s_ring)
+    {
+        return ESP_OK;
+    }
+    s_ring = heap_caps_calloc(VOICE_REF_RING, sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(s_ring, ESP_ERR_NO_MEM, TAG, "no mem for ring");
+    s_delay = VOICE_REF_DELAY_MS * (VOICE_REF_RATE / 1000);
+    return ESP_OK;
+}
+
+// 只在播放一侧调用 往前跳的话中间补0
+static void ref_write(int64_t idx, const int16_t *pcm, size_t n)
+{
+    int64_t hi;
+    portENTER_CRITICAL(&s_lock);
+    hi = s_hi;
+    portEXIT_CRITICAL(&s_lock);
+    if (idx > hi)
+    {
+        int64_t gap = idx - hi > VOICE_REF_RING ? VOICE_REF_RING : idx - hi;
+        for (int64_t i = 0; i < gap; i++)
+        {
+            s_ring[(hi + i) & REF_MASK] = 0;
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        s_ring[(idx + i) & REF_MASK] = pcm[i];
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (idx + (int64_t)n > s_hi)
+    {
+        s_hi = idx + n;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static bool ref_rate_set(uint32_t rate)
+{
+    if (rate == s_rate)
+    {
+        return true;
+    }
+    if (s_rs_active)
+    {
+        audio_resample_deinit(&s_rs);
+        s_rs_active = false;
+    }
+    s_rate = rate;
+    if (rate != VOICE_REF_RATE)
+    {
+        s_rs_active = audio_resample_init(&s_rs, rate, VOICE_REF_RATE, 1) == ESP_OK;
+        return s_rs_active;
+    }
+    return true;
+}
+
+void voice_ref_tap(const void *pcm, size_t len, uint32_t rate, int channels, uint32_t bits)
+{
+    if (s_ring == NULL || rate == 0 || len == 0)
+    {
+        return;
+    }
+    if (bits != 16 || !ref_rate_set(rate))
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.skipped++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    size_t frames = len / (channels * sizeof(int16_t));
+    // 写进DMA就返回了 这块的最后一帧要等队列里排在前面的都播完才出来
+    int64_t end_us = esp_timer_get_time() + (int64_t)BSP_I2S_DMA_DESC_NUM * BSP_I2S_DMA_FRAME_NUM * 1000000 / rate;
+    int64_t first = VOICE_REF_IDX(end_us) - (int64_t)frames * VOICE_REF_RATE / rate;
+    bool resync = llabs(first - s_next) > VOICE_REF_TOLERANCE;
+    if (resync)
+    {
+        if (s_rs_active)
+        {
+            audio_resample_reset(&s_rs);
+        }
+    }
+    else
+    {
+        first = s_next;
+    }
+
+    const int16_t *in = pcm;
+    int64_t w = first;
+    for (size_t done = 0; done < frames;)
+    {
+        size_t n = frames - done > VOICE_REF_BLOCK ? VOICE_REF_BLOCK : frames - done;
+        for (size_t i = 0; i < n; i++)
+        {
+            const int16_t *f = in + (done + i) * channels;
+            s_mono[i] = channels == 2 ? (int16_t)((f[0] + f[1]) >> 1) : f[0];
+        }
+        done += n;
+        if (!s_rs_active)
+        {
+            ref_write(w, s_mono, n);
+            w += n;
+            continue;
+        }
+        size_t used_total = 0;
+        while (used_total < n)
+        {
+            size_t used = 0;
+            size_t out = audio_resample_process(&s_rs, s_mono + used_total, n - used_total, s_out, REF_OUT_FRAMES, &used);
+            ref_write(w, s_out, out);
+            w += out;
+            used_total += used;
+            if (out == 0 && used == 0)
+            {
+                break;
+            }
+        }
+    }
+    s_next = w;
+
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.taps++;
+    s_stats.ref_resyncs += resync;
+    s_stats.cycles += cycles;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int64_t voice_ref_mic_index(int64_t t_us, size_t frames)
+{
+    int64_t first = VOICE_REF_IDX(t_us) - (int64_t)frames;
+    if (llabs(first - s_mic_next) > VOICE_REF_TOLERANCE)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.mic_resyncs++;
+        portEXIT_CRITICAL(&s_lock);
+    }
+    else
+    {
+        first = s_mic_next;
+    }
+    s_mic_next = first + frames;
+    return first;
+}
+
+void voice_ref_read(int64_t idx, int16_t *out, size_t n, int stride)
+{
+    int64_t hi;
+    portENTER_CRITICAL(&s_lock);
+    hi = s_hi;
+    portEXIT_CRITICAL(&s_lock);
+    int64_t j = idx - s_delay;
+    for (size_t i = 0; i < n; i++, j++)
+    {
+        out[i * stride] = (s_ring && j < hi && j >= hi - VOICE_REF_RING) ? s_ring[j & REF_MASK] : 0;
+    }
+}
+
+// 麦克风隔一个取一个 在参考里前后VOICE_REF_EST_SEARCH找最像的位置
+void voice_ref_estimate(const int16_t *mic, int stride, int64_t idx, size_t n)
+{
+    if (s_ring == NULL || n < VOICE_REF_EST_LEN || idx < s_est_next || !voice_ref_playing())
+    {
+        return;
+    }
+    s_est_next = idx + VOICE_REF_EST_MS * (VOICE_REF_RATE / 1000);
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    const int S = VOICE_REF_EST_SEARCH;
+    voice_ref_read(idx - S, s_est_ref, VOICE_REF_EST_LEN + 2 * S, 1);
+
+    int64_t em = 0, er = 0;
+    for (int k = 0; k < VOICE_REF_EST_LEN; k += 2)
+    {
+        int32_t m = mic[k * stride];
+        em += m * m;
+    }
+    for (int k = 0; k < VOICE_REF_EST_LEN + 2 * S; k++)
+    {
+        er += s_est_ref[k] * s_est_ref[k];
+    }
+    int64_t min_e = (int64_t)EST_MIN_RMS * EST_MIN_RMS * VOICE_REF_EST_LEN / 2;
+    bool done = false;
+    int best_l = 0;
+    int64_t best_c = 0;
+    if (em >= min_e && er >= min_e)
+    {
+        for (int l = -S; l <= S; l++)
+        {
+            const int16_t *r = s_est_ref + S + l;
+            int64_t c = 0;
+            for (int k = 0; k < VOICE_REF_EST_LEN; k += 2)
+            {
+                c += (int32_t)mic[k * stride] * r[k];
+            }
+            c = c < 0 ? -c : c; // 喇叭接反了也算
+            if (c > best_c)
+            {
+                best_c = c;
+                best_l = l;
+            }
+        }
+        done = true;
+    }
+    uint32_t corr = 0;
+    if (done)
+    {
+        const int16_t *r = s_est_ref + S + best_l;
+        int64_t rw = 0;
+        for (int k = 0; k < VOICE_REF_EST_LEN; k += 2)
+        {
+            rw += r[k] * r[k];
+        }
+        corr = rw ? (uint32_t)(100.0 * best_c / sqrt((double)em * rw)) : 0;
+        // 峰值在l 说明麦克风的这一帧对着参考里早delay-l的那一帧
+        if (corr >= VOICE_REF_EST_MIN_CORR && best_l)
+        {
+            int32_t step = best_l / 2 ? best_l / 2 : best_l;
+            int32_t d = s_delay - step;
+            s_delay = d > VOICE_REF_MAX_DELAY ? VOICE_REF_MAX_DELAY : d < -VOICE_REF_MAX_DELAY ? -VOICE_REF_MAX_DELAY : d;
+        }
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - c0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.cycles += cycles;
+    if (done)
+    {
+        s_stats.estimates++;
+        s_stats.corrections += corr >= VOICE_REF_EST_MIN_CORR && best_l;
+        s_stats.corr = corr;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool voice_ref_playing(void)
+{
+    int64_t hi;
+    portENTER_CRITICAL(&s_lock);
+    hi = s_hi;
+    portEXIT_CRITICAL(&s_lock);
+    return hi + VOICE_REF_RATE / 5 > VOICE_REF_IDX(esp_timer_get_time());
+}
+
+void voice_ref_get_stats(voice_ref_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+    stats->delay = s_delay;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 回声消除的播放参考 ****************************/
+// 放歌时喇叭的声音比人声大得多 AFE的AEC要一路和麦克风对得上的参考
+// 送到I2S的PCM写完以后由audio_pcm交过来 转单声道重采样到16k 按它从喇叭出来的时刻放进一个环
+// 时刻按写进DMA的时间加上DMA队列里排在前面的长度算 麦克风按读出来的时间算 两边都折成16k的采样序号
+// 序号连续时就接着往后排 和算出来的差太多才重新对齐 时钟抖动不会累积
+// 剩下的固定差(喇叭和麦克风芯片的延迟 重采样的群延迟)由VOICE_REF_DELAY_MS给初值
+// 每隔VOICE_REF_EST_MS做一次互相关 相关性够强就往峰值方向修正一半
+//
+// 换算: 序号 = esp_timer微秒 * 16 / 1000
+// 环里没写过的位置和停止播放以后的位置读出来是0
+
+#define VOICE_REF_RATE          16000
+#define VOICE_REF_RING          16384   // 约1秒 2的幂
+#define VOICE_REF_BLOCK         256     // 转单声道和重采样每次处理的帧数
+#define VOICE_REF_TOLERANCE     320     // 算出来的序号和接着排的差超过20ms才重新对齐
+#define VOICE_REF_DELAY_MS      CONFIG_APP_VOICE_REF_DELAY_MS
+#define VOICE_REF_EST_MS        2000
+#define VOICE_REF_EST_SEARCH    320     // 互相关前后各找20ms
+#define VOICE_REF_EST_LEN       512     // 互相关用的麦克风样本数 隔一个取一个
+#define VOICE_REF_EST_MIN_CORR  30      // 归一化相关系数低于0.30不修正
+#define VOICE_REF_MAX_DELAY     1600    // 修正不超过前后100ms
+#define VOICE_REF_IDX(us)       ((int64_t)(us) * 16 / 1000)
+
+typedef struct {
+    uint32_t taps;                      // 交过来的块数
+    uint32_t skipped;                   // 不是16位的 没法做参考
+    uint32_t ref_resyncs;               // 播放一侧重新对齐的次数 暂停 换歌 欠载都会有一次
+    uint32_t mic_resyncs;               // 麦克风一侧
+    uint32_t estimates;                 // 做过的互相关
+    uint32_t corrections;               // 其中相关性够强 修正了延迟的
+    int32_t delay;                      // 现在用的延迟 16k采样数 正数是参考比麦克风早
+    uint32_t corr;                      // 最近一次互相关的峰值 百分比
+    uint64_t cycles;                    // 转单声道 重采样 写环 互相关一共花的
+} voice_ref_stats_t;
+
+esp_err_t voice_ref_init(void);
+void voice_ref_tap(const void *pcm, size_t len, uint32_t rate, int channels, uint32_t bits); // 给audio_pcm_set_tap
+int64_t voice_ref_mic_index(int64_t t_us, size_t frames); // 麦克风这一块第一帧的序号 t_us是读出来的时刻
+void voice_ref_read(int64_t idx, int16_t *out, size_t n, int stride); // 取和麦克风第idx帧对齐的参考
+void voice_ref_estimate(const int16_t *mic, int stride, int64_t idx, size_t n); // 麦克风一块送进AFE之前调用
+bool voice_ref_playing(void);           // 最近有声音送到喇叭
+void voice_ref_get_stats(voice_ref_stats_t *stats);
@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "voice_tts.h"
+#include "task_plan.h"
+#include "audio_pcm.h"
+#include "boot.h"
+#include "esp32_s3_szp.h"
+#include "esp_tts.h"
+#include "esp_tts_voice_xiaole.h"
+#include "esp_tts_voice_template.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "voice_tts";
+
+#define TTS_SILENCE         300         // 头尾低于这个幅度的算静音
+#define TTS_PAD_FRAMES      160         // 去掉静音后头尾各留10ms 拼数字时不会太急
+
+_Static_assert(sizeof(voice_tts_cache_header_t) == 20, "voice_tts_cache_header_t layout");
+
+// 下标和voice_tts_phrase_t对应
+static const char *const s_texts[VOICE_TTS_PHRASES] = {
+    [VOICE_TTS_OK] = "好的",
+    [VOICE_TTS_PLAY] = "播放音乐",
+    [VOICE_TTS_PAUSE] = "已暂停",
+    [VOICE_TTS_RESUME] = "继续播放",
+    [VOICE_TTS_PREV] = "上一首",
+    [VOICE_TTS_NEXT] = "下一首",
+    [VOICE_TTS_VOLUME] = "音量",
+    [VOICE_TTS_OPEN] = "正在打开",
+    [VOICE_TTS_BACK] = "返回",
+    [VOICE_TTS_SORRY] = "没听清",
+    [VOICE_TTS_RECORD] = "开始录音",
+    [VOICE_TTS_SAVED] = "录音已保存",
+    [VOICE_TTS_DIGIT0] = "零", "一", "二", "三", "四", "五", "六", "七", "八", "九",
+    [VOICE_TTS_TEN] = "十",
+    [VOICE_TTS_HUNDRED] = "百",
+};
+
+typedef struct {
+    char text[VOICE_TTS_TEXT_MAX];
+    int64_t t_queued;
+} tts_req_t;
+
+static QueueHandle_t s_queue;
+static uint8_t *s_voice_data;           // PSRAM 加载着TTS时才有
+static esp_tts_voice_t *s_voice;
+static esp_tts_handle_t s_tts;
+static uint8_t *s_cache;                // 和卡上的文件一样的布局 PSRAM
+static const voice_tts_cache_entry_t *s_index;
+static const int16_t *s_pcm;
+static volatile bool s_ready;
+static voice_tts_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t text_hash(void)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < VOICE_TTS_PHRASES; i++)
+    {
+        for (const char *c = s_texts[i]; ; c++)
+        {
+            h = (h ^ (uint8_t)*c) * 16777619u; // 带上结尾的0 分得开每一句
+            if (*c == 0)
+            {
+                break;
+            }
+        }
+    }
+    return (h ^ VOICE_TTS_SPEED) * 16777619u;
+}
+
+static void tts_unload(void)
+{
+    if (s_tts)
+    {
+        esp_tts_destroy(s_tts);
+        s_tts = NULL;
+    }
+    if (s_voice)
+    {
+        esp_tts_voice_set_free(s_voice);
+        s_voice = NULL;
+    }
+    heap_caps_free(s_voice_data);
+    s_voice_data = NULL;
+}
+
+static esp_err_t tts_load(void)
+{
+    if (s_tts)
+    {
+        return ESP_OK;
+    }
+    int64_t t0 = esp_timer_get_time();
+    FILE *f = fopen(VOICE_TTS_VOICE_FILE, "rb");
+    ESP_RETURN_ON_FALSE(f, ESP_ERR_NOT_FOUND, TAG, "no %s", VOICE_TTS_VOICE_FILE);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    s_voice_data = size > 0 ? heap_caps_malloc(size, MALLOC_CAP_SPIRAM) : NULL;
+    bool ok = s_voice_data && fread(s_voice_data, 1, size, f) == (size_t)size;
+    fclose(f);
+    if (ok)
+    {
+        s_voice = esp_tts_voice_set_init(&esp_tts_voice_template, s_voice_data);
+        s_tts = s_voice ? esp_tts_create(s_voice) : NULL;
+    }
+    if (s_tts == NULL)
+    {
+        tts_unload();
+        ESP_LOGE(TAG, "TTS load failed (%ld bytes)", size);
+        return ESP_FAIL;
+    }
+    uint32_t ms = (esp_timer_get_time() - t0) / 1000;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.loads++;
+    s_stats.load_ms = ms;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "TTS loaded, %ld KB voice data in %lu ms", size / 1024, (unsigned long)ms);
+    return ESP_OK;
+}
+
+// 整句合成进out 返回帧数 放不下的截掉
+static size_t tts_synth(const char *text, int16_t *out, size_t max)
+{
+    size_t n = 0;
+    if (esp_tts_parse_chinese(s_tts, text))
+    {
+        int len = 0;
+        do
+        {
+            short *pcm = esp_tts_stream_play(s_tts, &len, VOICE_TTS_SPEED);
+            size_t k = len > 0 ? (size_t)len : 0;
+            k = k < max - n ? k : max - n;
+            memcpy(out + n, pcm, k * sizeof(int16_t));
+            n += k;
+        } while (len > 0);
+    }
+    esp_tts_stream_reset(s_tts);
+    return n;
+}
+
+// 去掉头尾的静音 返回剩下的帧数 *start是开头
+static size_t trim_silence(const int16_t *pcm, size_t n, size_t *start)
+{
+    size_t a = 0, b = n;
+    while (a < b && pcm[a] < TTS_SILENCE && pcm[a] > -TTS_SILENCE)
+    {
+        a++;
+    }
+    while (b > a && pcm[b - 1] < TTS_SILENCE && pcm[b - 1] > -TTS_SILENCE)
+    {
+        b--;
+    }
+    a = a > TTS_PAD_FRAMES ? a - TTS_PAD_FRAMES : 0;
+    b = b + TTS_PAD_FRAMES < n ? b + TTS_PAD_FRAMES : n;
+    *start = a;
+    return b - a;
+}
+
+static void cache_set(uint8_t *blob)
+{
+    s_cache = blob;
+    s_index = (const voice_tts_cache_entry_t *)(blob + sizeof(voice_tts_cache_header_t));
+    s_pcm = (const int16_t *)(s_index + VOICE_TTS_PHRASES);
+}
+
+static size_t cache_bytes(uint32_t frames)
+{
+    return sizeof(voice_tts_cache_header_t) + VOICE_TTS_PHRASES * sizeof(voice_tts_cache_entry_t) +
+           frames * sizeof(int16_t);
+}
+
+static esp_err_t cache_read(void)
+{
+    FILE *f = fopen(VOICE_TTS_CACHE_FILE, "rb");
+    if (f == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    voice_tts_cache_header_t h;
+    esp_err_t ret = ESP_ERR_INVALID_VERSION;
+    if (fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, VOICE_TTS_MAGIC, 4) == 0 &&
+        h.version == VOICE_TTS_VERSION && h.count == VOICE_TTS_PHRASES && h.rate == VOICE_TTS_RATE &&
+        h.text_hash == text_hash() && h.frames <= VOICE_TTS_PHRASES * VOICE_TTS_CLIP_MAX_S * VOICE_TTS_RATE)
+    {
+        size_t size = cache_bytes(h.frames);
+        uint8_t *blob = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        ret = ESP_ERR_NO_MEM;
+        if (blob)
+        {
+            memcpy(blob, &h, sizeof(h));
+            ret = fread(blob + sizeof(h), 1, size - sizeof(h), f) == size - sizeof(h) ? ESP_OK : ESP_FAIL;
+            if (ret == ESP_OK)
+            {
+                cache_set(blob);
+            }
+            else
+            {
+                heap_caps_free(blob);
+            }
+        }
+    }
+    fclose(f);
+    return ret;
+}
+
+static void cache_write(void)
+{
+    if (mkdir(VOICE_TTS_DIR, 0775) != 0)
+    {
+        struct stat st;
+        if (stat(VOICE_TTS_DIR, &st) != 0)
+        {
+            return;
+        }
+    }
+    const voice_tts_cache_header_t *h = (const voice_tts_cache_header_t *)s_cache;
+    size_t size = cache_bytes(h->frames);
+    FILE *f = fopen(VOICE_TTS_CACHE_FILE, "wb");
+    bool ok = f && fwrite(s_cache, 1, size, f) == size;
+    if (f)
+    {
+        ok = fclose(f) == 0 && ok;
+    }
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "write %s failed", VOICE_TTS_CACHE_FILE);
+        remove(VOICE_TTS_CACHE_FILE);
+    }
+}
+
+// 每句合成进一块临时缓冲 去掉静音接到后面 最后按实际大小收成一块
+static esp_err_t cache_build(void)
+{
+    ESP_RETURN_ON_ERROR(tts_load(), TAG, "no TTS to build the cache");
+    const size_t clip_max = VOICE_TTS_CLIP_MAX_S * VOICE_TTS_RATE;
+    int16_t *clip = heap_caps_malloc(clip_max * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    uint8_t *blob = heap_caps_malloc(cache_bytes(VOICE_TTS_PHRASES * clip_max), MALLOC_CAP_SPIRAM);
+    if (clip == NULL || blob == NULL)
+    {
+        heap_caps_free(clip);
+        heap_caps_free(blob);
+        return ESP_ERR_NO_MEM;
+    }
+    voice_tts_cache_entry_t *index = (voice_tts_cache_entry_t *)(blob + sizeof(voice_tts_cache_header_t));
+    int16_t *pcm = (int16_t *)(index + VOICE_TTS_PHRASES);
+    uint32_t frames = 0;
+    for (int i = 0; i < VOICE_TTS_PHRASES; i++)
+    {
+        size_t start = 0;
+        size_t n = tts_synth(s_texts[i], clip, clip_max);
+        n = trim_silence(clip, n, &start);
+        memcpy(pcm + frames, clip + start, n * sizeof(int16_t));
+        index[i].offset = frames;
+        index[i].frames = n;
+        frames += n;
+    }
+    heap_caps_free(clip);
+    voice_tts_cache_header_t h = {
+        .magic = VOICE_TTS_MAGIC,
+        .version = VOICE_TTS_VERSION,
+        .count = VOICE_TTS_PHRASES,
+        .rate = VOICE_TTS_RATE,
+        .text_hash = text_hash(),
+        .frames = frames,
+    };
+    memcpy(blob, &h, sizeof(h));
+    uint8_t *fit = heap_caps_realloc(blob, cache_bytes(frames), MALLOC_CAP_SPIRAM);
+    cache_set(fit ? fit : blob);
+    cache_write();
+    return ESP_OK;
+}
+
+// 现合成 每段拷一份交给audio_pcm 放完由它释放
+static void say_text(const tts_req_t *req)
+{
+    if (tts_load() != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.dropped++;
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    int64_t t0 = esp_timer_get_time();
+    uint32_t first_us = 0;
+    uint64_t frames = 0;
+    if (esp_tts_parse_chinese(s_tts, req->text))
+    {
+        int len = 0;
+        do
+        {
+            short *pcm = esp_tts_stream_play(s_tts, &len, VOICE_TTS_SPEED);
+            if (len <= 0)
+            {
+                break;
+            }
+            int16_t *chunk = heap_caps_malloc(len * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+            if (chunk == NULL)
+            {
+                break;
+            }
+            memcpy(chunk, pcm, len * sizeof(int16_t));
+            if (audio_pcm_prompt(chunk, len, VOICE_TTS_RATE, heap_caps_free, chunk) != ESP_OK)
+            {
+                heap_caps_free(chunk);
+                break;
+            }
+            if (first_us == 0)
+            {
+                first_us = esp_timer_get_time() - req->t_queued;
+            }
+            frames += len;
+        } while (len > 0);
+    }
+    esp_tts_stream_reset(s_tts);
+    uint64_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.texts++;
+    s_stats.synth_us += us;
+    s_stats.synth_frames += frames;
+    if (first_us > s_stats.first_us_max)
+    {
+        s_stats.first_us_max = first_us;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void tts_task(void *arg)
+{
+    boot_wait(BOOT_BIT(BOOT_STAGE_SD), BOOT_WAIT_FOREVER);
+    int64_t t0 = esp_timer_get_time();
+    bool from_file = cache_read() == ESP_OK;
+    if (from_file || cache_build() == ESP_OK)
+    {
+        const voice_tts_cache_header_t *h = (const voice_tts_cache_header_t *)s_cache;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.from_file = from_file;
+        s_stats.build_ms = (esp_timer_get_time() - t0) / 1000;
+        s_stats.cache_bytes = cache_bytes(h->frames);
+        s_stats.ready = true;
+        portEXIT_CRITICAL(&s_lock);
+        s_ready = true;
+        ESP_LOGI(TAG, "%d phrases, %lu KB PCM, %s in %lu ms", VOICE_TTS_PHRASES,
+                 (unsigned long)h->frames * sizeof(int16_t) / 1024, from_file ? "read" : "synthesized",
+                 (unsigned long)s_stats.build_ms);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "no phrase cache, spoken feedback off");
+    }
+
+    for (;;)
+    {
+        tts_req_t req;
+        if (xQueueReceive(s_queue, &req, s_tts ? pdMS_TO_TICKS(VOICE_TTS_UNLOAD_MS) : portMAX_DELAY) == pdTRUE)
+        {
+            say_text(&req);
+        }
+        else
+        {
+            tts_unload(); // 一阵子没用了 把3MB的声音数据还给PSRAM
+            ESP_LOGI(TAG, "TTS unloaded");
+        }
+    }
+}
+
+esp_err_t voice_tts_start(void)
+{
+    if (s_queue)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_queue = xQueueCreate(VOICE_TTS_QUEUE, sizeof(tts_req_t));
+    ESP_RETURN_ON_FALSE(s_queue, ESP_ERR_NO_MEM, TAG, "no memory");
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_VOICE_TTS, tts_task, NULL, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task create failed");
+    return ESP_OK;
+}
+
+bool voice_tts_ready(void)
+{
+    return s_ready;
+}
+
+static esp_err_t say_clips(const voice_tts_phrase_t *p, int n)
+{
+    esp_err_t ret = s_ready ? ESP_OK : ESP_ERR_INVALID_STATE;
+    for (int i = 0; i < n && ret == ESP_OK; i++)
+    {
+        const voice_tts_cache_entry_t *e = &s_index[p[i]];
+        ret = e->frames ? audio_pcm_prompt(s_pcm + e->offset, e->frames, VOICE_TTS_RATE, NULL, NULL) : ESP_OK;
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (ret == ESP_OK)
+    {
+        s_stats.says++;
+    }
+    else
+    {
+        s_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+esp_err_t voice_tts_say(voice_tts_phrase_t phrase)
+{
+    ESP_RETURN_ON_FALSE(phrase < VOICE_TTS_PHRASES, ESP_ERR_INVALID_ARG, TAG, "bad phrase");
+    return say_clips(&phrase, 1);
+}
+
+// 数字转成要拼的片段 返回个数 二十以上是"几十几" 十几不说"一十"
+static int number_clips(int n, voice_tts_phrase_t *out)
+{
+    int k = 0;
+    if (n >= 100)
+    {
+        out[k++] = VOICE_TTS_DIGIT0 + 1;
+        out[k++] = VOICE_TTS_HUNDRED;
+        return k;
+    }
+    if (n >= 10)
+    {
+        if (n >= 20)
+        {
+            out[k++] = VOICE_TTS_DIGIT0 + n / 10;
+        }
+        out[k++] = VOICE_TTS_TEN;
+        if (n % 10)
+        {
+            out[k++] = VOICE_TTS_DIGIT0 + n % 10;
+        }
+        return k;
+    }
+    out[k++] = VOICE_TTS_DIGIT0 + n;
+    return k;
+}
+
+esp_err_t voice_tts_say_number(int n)
+{
+    voice_tts_phrase_t p[3];
+    n = n < 0 ? 0 : n > 100 ? 100 : n;
+    return say_clips(p, number_clips(n, p));
+}
+
+esp_err_t voice_tts_say_volume(int volume)
+{
+    voice_tts_phrase_t p[4] = {VOICE_TTS_VOLUME};
+    volume = volume < 0 ? 0 : volume > 100 ? 100 : volume;
+    return say_clips(p, 1 + number_clips(volume, p + 1));
+}
+
+esp_err_t voice_tts_say_text(const char *text)
+{
+    ESP_RETURN_ON_FALSE(s_queue && text, ESP_ERR_INVALID_STATE, TAG, "not started");
+    tts_req_t req = {.t_queued = esp_timer_get_time()};
+    strlcpy(req.text, text, sizeof(req.text));
+    if (xQueueSend(s_queue, &req, 0) != pdTRUE)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.dropped++;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void voice_tts_get_stats(voice_tts_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
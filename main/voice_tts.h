@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 语音播报 ****************************/
+// 语音命令执行完说一句确认 用esp-sr里的esp-tts 中文 声音是xiaole 16k单声道
+// 固定的话开机合成一次 去掉头尾的静音放在PSRAM里 播放时直接交给audio_pcm_prompt 没有合成的延迟
+// 数字也是缓存的片段 "音量六十"由"音量" "六" "十"拼起来 同样不用合成
+// 缓存整块存到卡上VOICE_TTS_CACHE_FILE 下次开机文字表没变就直接读进来 这时TTS根本不加载
+// 只有缓存里没有的话(voice_tts_say_text)才现合成 在核1的低优先级任务里 合成一段交一段 边合成边放
+// TTS的声音数据(esp_tts_voice_data_xiaole.dat 约3MB)分区表里放不下 从卡上VOICE_TTS_VOICE_FILE读进PSRAM
+// 用完VOICE_TTS_UNLOAD_MS没再用就释放
+
+#define VOICE_TTS_DIR           SD_MOUNT_POINT"/tts"
+#define VOICE_TTS_VOICE_FILE    VOICE_TTS_DIR"/esp_tts_voice_data_xiaole.dat"
+#define VOICE_TTS_CACHE_FILE    VOICE_TTS_DIR"/cache.bin"
+#define VOICE_TTS_RATE          16000
+#define VOICE_TTS_SPEED         3       // esp-tts的语速 0慢 5快
+#define VOICE_TTS_UNLOAD_MS     30000
+#define VOICE_TTS_TEXT_MAX      64      // voice_tts_say_text一次最多的字节 UTF-8
+#define VOICE_TTS_QUEUE         4
+#define VOICE_TTS_CLIP_MAX_S    3       // 一句固定的话最长
+#define VOICE_TTS_MAGIC         "TTSC"
+#define VOICE_TTS_VERSION       1
+
+typedef enum {
+    VOICE_TTS_OK,                       // 好的
+    VOICE_TTS_PLAY,                     // 播放音乐
+    VOICE_TTS_PAUSE,                    // 已暂停
+    VOICE_TTS_RESUME,                   // 继续播放
+    VOICE_TTS_PREV,                     // 上一首
+    VOICE_TTS_NEXT,                     // 下一首
+    VOICE_TTS_VOLUME,                   // 音量 后面接数字
+    VOICE_TTS_OPEN,                     // 正在打开
+    VOICE_TTS_BACK,                     // 返回
+    VOICE_TTS_SORRY,                    // 没听清
+    VOICE_TTS_RECORD,                   // 开始录音
+    VOICE_TTS_SAVED,                    // 录音已保存
+    VOICE_TTS_DIGIT0,                   // 零到九 连着排
+    VOICE_TTS_DIGIT9 = VOICE_TTS_DIGIT0 + 9,
+    VOICE_TTS_TEN,
+    VOICE_TTS_HUNDRED,
+    VOICE_TTS_PHRASES,
+} voice_tts_phrase_t;
+
+// 卡上缓存文件 全部小端 头 索引 PCM 三段连着
+typedef struct __attribute__((packed)) {
+    char magic[4];                      // VOICE_TTS_MAGIC
+    uint16_t version;
+    uint16_t count;                     // VOICE_TTS_PHRASES
+    uint32_t rate;
+    uint32_t text_hash;                 // 文字表和语速的FNV-1a 对不上就重新合成
+    uint32_t frames;                    // PCM一共多少帧
+} voice_tts_cache_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t offset;                    // 从PCM段开头算的帧数
+    uint32_t frames;
+} voice_tts_cache_entry_t;
+
+typedef struct {
+    bool ready;                         // 缓存有了
+    bool from_file;                     // 缓存是从卡上读的
+    uint32_t build_ms;                  // 读缓存或合成缓存花的时间
+    uint32_t cache_bytes;
+    uint32_t says;                      // 用缓存片段说的
+    uint32_t texts;                     // 现合成的
+    uint32_t dropped;                   // 没准备好或队列满
+    uint32_t loads;                     // 加载TTS的次数
+    uint32_t load_ms;                   // 最近一次加载
+    uint32_t first_us_max;              // 现合成: 排进队列到第一段交给audio_pcm
+    uint64_t synth_us;                  // 现合成的累计时间
+    uint64_t synth_frames;
+} voice_tts_stats_t;
+
+esp_err_t voice_tts_start(void);        // audio_pcm_init以后调用 后台等SD卡 读缓存或合成
+bool voice_tts_ready(void);
+esp_err_t voice_tts_say(voice_tts_phrase_t phrase);
+esp_err_t voice_tts_say_number(int n);  // 0到100 用缓存的数字拼
+esp_err_t voice_tts_say_volume(int volume);
+esp_err_t voice_tts_say_text(const char *text); // 排进队列现合成 不阻塞
+void voice_tts_get_stats(voice_tts_stats_t *stats);
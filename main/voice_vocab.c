@@ -0,0 +1,484 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include "voice_vocab.h"
+#include "voice_cmd.h"
+#include "media_lib.h"
+#include "music_index.h"
+#include "app_ui.h"
+#include "esp32_s3_szp.h"
+#include "task_plan.h"
+#include "esp_mn_speech_commands.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#if CONFIG_APP_VOICE_VOCAB
+
+static const char *TAG = "voice_vocab";
+
+#define VOCAB_PLAY          "bo fang "
+#define VOCAB_APP_BASE      (VOICE_CMD_DYN_BASE + VOICE_VOCAB_SONGS)
+#define VOCAB_NAMES_LINES   512
+
+typedef struct {
+    char phrase[VOICE_VOCAB_PHRASE_LEN];    // 空的是没用的槽
+    char path[VOICE_VOCAB_PATH_LEN];
+} vocab_song_t;
+
+typedef struct {
+    const char *name;                   // app_mod_t的name
+    const char *phrase;
+} vocab_app_t;
+
+static const vocab_app_t s_app_words[] = {
+    {"att", "da kai zi tai"},
+    {"music", "da kai yin yue"},
+    {"sdcard", "da kai cun chu ka"},
+    {"camera", "da kai xiang ji"},
+    {"wifi", "da kai wu xian wang luo"},
+    {"bt", "da kai lan ya"},
+    {"gallery", "da kai xiang ce"},
+    {"sysmon", "da kai xi tong jian shi"},
+    {"tuner", "da kai tiao yin qi"},
+    {"scan", "da kai sao ma"},
+    {"bench", "da kai xing neng ce shi"},
+};
+#define VOCAB_APPS          (sizeof(s_app_words) / sizeof(s_app_words[0]))
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static voice_vocab_stats_t s_stats;
+static TaskHandle_t s_task;
+static vocab_song_t *s_slots;           // PSRAM 下标加VOICE_CMD_DYN_BASE是命令ID 识别出来在LVGL任务里读
+static int s_app_ids[VOCAB_APPS];       // 0是没编进去
+
+// 下面这些只在后台任务和它等着的那次识别任务里用
+static vocab_song_t *s_next;            // 这次走目录得到的
+static bool *s_matched;
+static uint16_t s_rm[VOICE_VOCAB_SONGS];    // 要删的槽
+static uint16_t s_add[VOICE_VOCAB_SONGS];   // 要加的槽
+static bool s_add_ok[VOICE_VOCAB_SONGS];
+static int s_rm_n;
+static int s_add_n;
+static bool s_apps_pending;
+static int s_apps_ok;
+static char *s_names;                   // 拼音文件 读进来原地切开
+static const char *s_name_key[VOCAB_NAMES_LINES];
+static const char *s_name_val[VOCAB_NAMES_LINES];
+static int s_name_n;
+
+/********************************** 拼音 **********************************/
+
+// 只认字母和空格 转小写 多个空格并一个 去掉头尾 有别的字符返回false
+static bool pinyin_norm(const char *in, size_t in_len, char *out, size_t len)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < in_len && in[i]; i++)
+    {
+        char c = in[i];
+        if (c == ' ' || c == '_' || c == '-')
+        {
+            if (n && out[n - 1] != ' ')
+            {
+                c = ' ';
+            }
+            else
+            {
+                continue;
+            }
+        }
+        else if (isalpha((unsigned char)c))
+        {
+            c = tolower((unsigned char)c);
+        }
+        else
+        {
+            return false;
+        }
+        if (n + 1 >= len)
+        {
+            return false;
+        }
+        out[n++] = c;
+    }
+    while (n && out[n - 1] == ' ')
+    {
+        n--;
+    }
+    out[n] = '\0';
+    return n > 0;
+}
+
+static void names_free(void)
+{
+    heap_caps_free(s_names);
+    s_names = NULL;
+    s_name_n = 0;
+}
+
+// "文件名<TAB>拼音" 一行一首 #开头的是注释
+static void names_load(void)
+{
+    names_free();
+    FILE *f = fopen(VOICE_VOCAB_NAMES_FILE, "r");
+    if (f == NULL)
+    {
+        struct stat st;
+        if (stat(VOICE_VOCAB_NAMES_OLD, &st) == 0)
+        {
+            ESP_LOGW(TAG, "%s is no longer read, move it to %s", VOICE_VOCAB_NAMES_OLD, VOICE_VOCAB_NAMES_FILE);
+        }
+        return;
+    }
+    s_names = heap_caps_malloc(VOICE_VOCAB_NAMES_MAX + 1, MALLOC_CAP_SPIRAM);
+    size_t len = s_names ? fread(s_names, 1, VOICE_VOCAB_NAMES_MAX, f) : 0;
+    fclose(f);
+    if (s_names == NULL)
+    {
+        return;
+    }
+    s_names[len] = '\0';
+    char *save = NULL;
+    for (char *line = strtok_r(s_names, "\r\n", &save); line && s_name_n < VOCAB_NAMES_LINES;
+         line = strtok_r(NULL, "\r\n", &save))
+    {
+        char *tab = strchr(line, '\t');
+        if (line[0] == '#' || tab == NULL)
+        {
+            continue;
+        }
+        *tab = '\0';
+        s_name_key[s_name_n] = line;
+        s_name_val[s_name_n] = tab + 1;
+        s_name_n++;
+    }
+}
+
+static const char *names_find(const char *file)
+{
+    for (int i = 0; i < s_name_n; i++)
+    {
+        if (strcasecmp(s_name_key[i], file) == 0)
+        {
+            return s_name_val[i];
+        }
+    }
+    return NULL;
+}
+
+// 拼音文件 标题 文件名 按顺序第一个能当拼音的
+static bool song_pinyin(const char *file, char *out, size_t len)
+{
+    const char *given = names_find(file);
+    if (given)
+    {
+        return pinyin_norm(given, strlen(given), out, len);
+    }
+    music_meta_t meta;
+    if (music_index_lookup(file, &meta) && meta.title[0] && pinyin_norm(meta.title, sizeof(meta.title), out, len))
+    {
+        return true;
+    }
+    const char *dot = strrchr(file, '.');
+    return pinyin_norm(file, dot ? dot - file : strlen(file), out, len);
+}
+
+/********************************** 重建 **********************************/
+
+// 走一遍音乐目录 编成s_next 返回首数 媒体库没有这个目录或者它脏着返回-1
+static int scan_songs(uint32_t *no_pinyin)
+{
+    file_iterator_instance_t *it = media_lib_iterator(SD_MOUNT_POINT "/music", MEDIA_TYPE_AUDIO);
+    if (it == NULL)
+    {
+        return -1;
+    }
+    names_load();
+    int n = 0;
+    size_t count = file_iterator_get_count(it);
+    char pinyin[VOICE_VOCAB_PHRASE_LEN - sizeof(VOCAB_PLAY) + 1];
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *file = file_iterator_get_name_from_index(it, i);
+        if (file == NULL || !song_pinyin(file, pinyin, sizeof(pinyin)))
+        {
+            (*no_pinyin)++;
+            continue;
+        }
+        vocab_song_t *s = &s_next[n];
+        snprintf(s->phrase, sizeof(s->phrase), VOCAB_PLAY "%s", pinyin);
+        bool dup = false;
+        for (int j = 0; j < VOICE_CMD_DYN_BASE && !dup; j++)
+        {
+            dup = strcmp(voice_cmd_name(j), s->phrase) == 0; // 叫"yin yue"的歌不能把"bo fang yin yue"抢走
+        }
+        for (int j = 0; j < n && !dup; j++)
+        {
+            dup = strcmp(s_next[j].phrase, s->phrase) == 0;
+        }
+        if (dup || file_iterator_get_full_path_from_index(it, i, s->path, sizeof(s->path)) <= 0)
+        {
+            continue;   // 同名的只留第一首
+        }
+        if (++n == VOICE_VOCAB_SONGS)
+        {
+            break;
+        }
+    }
+    media_lib_iterator_free(it);
+    names_free();
+    return n;
+}
+
+// 在识别任务里
+static void vocab_apply(void *arg)
+{
+    for (int i = 0; i < s_rm_n; i++)
+    {
+        esp_mn_commands_remove(s_slots[s_rm[i]].phrase);
+    }
+    for (int i = 0; i < s_add_n; i++)
+    {
+        s_add_ok[i] = esp_mn_commands_add(VOICE_CMD_DYN_BASE + s_add[i], s_slots[s_add[i]].phrase) == ESP_OK;
+    }
+    if (s_apps_pending)
+    {
+        // 固定命令里有同一句的 add只改它的ID
+        for (int i = 0; i < VOCAB_APPS; i++)
+        {
+            s_apps_ok += s_app_ids[i] && esp_mn_commands_add(VOCAB_APP_BASE + i, (char *)s_app_words[i].phrase) == ESP_OK;
+        }
+    }
+    esp_mn_error_t *err = esp_mn_commands_update();
+    for (int i = 0; err && i < err->num; i++)
+    {
+        int slot = err->phrases[i]->command_id - VOICE_CMD_DYN_BASE;
+        for (int j = 0; j < s_add_n; j++)
+        {
+            s_add_ok[j] &= s_add[j] != slot;
+        }
+        ESP_LOGW(TAG, "\"%s\" rejected by MultiNet", err->phrases[i]->string);
+    }
+}
+
+static void slot_clear(int slot)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_slots[slot].phrase[0] = '\0';
+    s_slots[slot].path[0] = '\0';
+    portEXIT_CRITICAL(&s_lock);
+}
+
+// 和现在的命令表比 只改变了的 音乐目录还没走到返回false 过一会儿再来
+static bool vocab_rebuild(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint32_t no_pinyin = 0;
+    int n = scan_songs(&no_pinyin);
+    bool scanned = n >= 0;
+    if (!scanned && !s_apps_pending)
+    {
+        return false;
+    }
+    n = scanned ? n : 0;    // 卡还没好 应用先加上 歌的槽这时都是空的
+    memset(s_matched, 0, VOICE_VOCAB_SONGS * sizeof(bool));
+    s_rm_n = 0;
+    s_add_n = 0;
+    int songs = 0;
+    for (int slot = 0; slot < VOICE_VOCAB_SONGS; slot++)
+    {
+        vocab_song_t *cur = &s_slots[slot];
+        if (!cur->phrase[0])
+        {
+            continue;
+        }
+        int j = 0;
+        while (j < n && strcmp(s_next[j].phrase, cur->phrase) != 0)
+        {
+            j++;
+        }
+        if (j == n)
+        {
+            s_rm[s_rm_n++] = slot;
+            continue;
+        }
+        s_matched[j] = true;
+        songs++;
+        if (strcmp(s_next[j].path, cur->path) != 0)
+        {
+            portENTER_CRITICAL(&s_lock);
+            strcpy(cur->path, s_next[j].path); // 文件挪了 同一句话放新的路径
+            portEXIT_CRITICAL(&s_lock);
+        }
+    }
+    // 新的只放进这次之前就空着的槽 要删的那句在update之前还可能被识别出来 它的路径还得留着
+    int slot = 0;
+    uint32_t over = 0;
+    for (int j = 0; j < n; j++)
+    {
+        if (s_matched[j])
+        {
+            continue;
+        }
+        while (slot < VOICE_VOCAB_SONGS && s_slots[slot].phrase[0])
+        {
+            slot++;
+        }
+        if (slot == VOICE_VOCAB_SONGS)
+        {
+            over++;
+            continue;
+        }
+        portENTER_CRITICAL(&s_lock);
+        s_slots[slot] = s_next[j];
+        portEXIT_CRITICAL(&s_lock);
+        s_add[s_add_n++] = slot;
+    }
+    uint32_t scan_ms = (esp_timer_get_time() - t0) / 1000;
+
+    uint32_t apply_us = 0;
+    uint32_t rejected = 0;
+    if (s_rm_n || s_add_n || s_apps_pending)
+    {
+        t0 = esp_timer_get_time();
+        esp_err_t err = voice_cmd_edit(vocab_apply, NULL, VOICE_VOCAB_EDIT_MS);
+        apply_us = esp_timer_get_time() - t0;
+        if (err != ESP_OK)
+        {
+            // 没改成 新放进去的槽收回来 下次再比
+            for (int i = 0; i < s_add_n; i++)
+            {
+                slot_clear(s_add[i]);
+            }
+            ESP_LOGW(TAG, "command list not updated: %s", esp_err_to_name(err));
+            return false;
+        }
+        for (int i = 0; i < s_rm_n; i++)
+        {
+            slot_clear(s_rm[i]);
+        }
+        for (int i = 0; i < s_add_n; i++)
+        {
+            if (s_add_ok[i])
+            {
+                songs++;
+            }
+            else
+            {
+                slot_clear(s_add[i]);
+                rejected++;
+            }
+        }
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.songs = songs;
+    s_stats.apps = s_apps_ok;
+    s_stats.rebuilds++;
+    s_stats.added += s_add_n - rejected;
+    s_stats.removed += s_rm_n;
+    s_stats.rejected += rejected;
+    s_stats.no_pinyin = no_pinyin;
+    s_stats.over = over;
+    s_stats.scan_ms = scan_ms;
+    if (apply_us)
+    {
+        s_stats.apply_us = apply_us;
+        s_stats.apply_us_max = apply_us > s_stats.apply_us_max ? apply_us : s_stats.apply_us_max;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "%d songs (+%d -%d, %lu rejected, %lu without pinyin), scan %lu ms, apply %lu us",
+             songs, s_add_n - (int)rejected, s_rm_n, (unsigned long)rejected, (unsigned long)no_pinyin,
+             (unsigned long)scan_ms, (unsigned long)apply_us);
+    s_apps_pending = false;
+    return scanned;
+}
+
+// 布局 索引扫完没有 拼音文件 哪个变了都要重建
+static uint32_t vocab_signature(void)
+{
+    uint32_t sig = media_lib_layout() * 31 + music_index_ready();
+    struct stat st;
+    if (stat(VOICE_VOCAB_NAMES_FILE, &st) == 0)
+    {
+        sig = sig * 31 + (uint32_t)st.st_mtime;
+        sig = sig * 31 + (uint32_t)st.st_size;
+    }
+    return sig;
+}
+
+static void vocab_task(void *arg)
+{
+    uint32_t built = 0;
+    bool first = true;
+    for (;;)
+    {
+        uint32_t sig = vocab_signature();
+        if ((first || sig != built) && vocab_rebuild())
+        {
+            built = sig;
+            first = false;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(VOICE_VOCAB_POLL_MS));
+    }
+}
+
+// 在LVGL任务里
+static voice_tts_phrase_t vocab_action(int id)
+{
+    int slot = id - VOICE_CMD_DYN_BASE;
+    if (slot >= VOICE_VOCAB_SONGS)
+    {
+        slot -= VOICE_VOCAB_SONGS;
+        if (slot >= VOCAB_APPS || !s_app_ids[slot])
+        {
+            return VOICE_TTS_SORRY;
+        }
+        ai_open_app(s_app_ids[slot]);
+        return VOICE_TTS_OPEN;
+    }
+    char path[VOICE_VOCAB_PATH_LEN];
+    portENTER_CRITICAL(&s_lock);
+    strcpy(path, s_slots[slot].path);
+    s_stats.plays += path[0] != '\0';
+    s_stats.missing += path[0] == '\0';
+    portEXIT_CRITICAL(&s_lock);
+    if (!path[0])
+    {
+        return VOICE_TTS_SORRY;
+    }
+    ESP_LOGI(TAG, "play %s", path);
+    ai_play_file(path);
+    return VOICE_TTS_PLAY;
+}
+
+esp_err_t voice_vocab_start(void)
+{
+    ESP_RETURN_ON_FALSE(s_task == NULL, ESP_ERR_INVALID_STATE, TAG, "already started");
+    s_slots = heap_caps_calloc(VOICE_VOCAB_SONGS, sizeof(vocab_song_t), MALLOC_CAP_SPIRAM);
+    s_next = heap_caps_malloc(VOICE_VOCAB_SONGS * sizeof(vocab_song_t), MALLOC_CAP_SPIRAM);
+    s_matched = heap_caps_malloc(VOICE_VOCAB_SONGS * sizeof(bool), MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(s_slots && s_next && s_matched, ESP_ERR_NO_MEM, TAG, "no memory");
+    for (int i = 0; i < VOCAB_APPS; i++)
+    {
+        s_app_ids[i] = ai_app_id(s_app_words[i].name);
+    }
+    s_apps_pending = true;
+    voice_cmd_set_dyn_action(vocab_action);
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_VOICE_VOCAB, vocab_task, NULL, &s_task) == pdPASS, ESP_ERR_NO_MEM,
+                        TAG, "task create failed");
+    return ESP_OK;
+}
+
+void voice_vocab_get_stats(voice_vocab_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
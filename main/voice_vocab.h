@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** 按音乐库生成的语音命令 ****************************/
+// MultiNet6的命令表除了voice_cmd.c里固定的那些 再加上"bo fang <歌名>"和"da kai <应用>"
+// 歌从媒体库里/sdcard/music下的音频文件来 拼音按下面的顺序找:
+//   VOICE_VOCAB_NAMES_FILE 里一行一首 "文件名<TAB>拼音" 中文歌名只能这样给 板子上没有汉字转拼音的表
+//   索引里的标题 没有标题用去掉扩展名的文件名 只有字母和空格的当拼音试一下 MultiNet不认的记在rejected里
+// 应用按编进去的应用表生成一次 和固定命令同一句话的 改成按应用名打开 不再按图标位置
+// 后台任务每VOICE_VOCAB_POLL_MS看一眼媒体库的布局 索引是否扫完 拼音文件的时间 变了才重建
+// 重建只和上次比 删掉没了的 加上新的 没变的不动 一句话都没变就不update
+// 改命令表要在识别任务里做(见voice_cmd_edit) 这段时间识别停着 花的时间记在apply_us里
+// 说完到执行完的时间 命令表变大以后MultiNet每块的时间 在voice_cmd的统计里
+
+#define VOICE_VOCAB_NAMES_FILE  "/sdcard/.cache/voice_names"     // 不放音乐目录 曲目列表不会看到它
+#define VOICE_VOCAB_NAMES_OLD   "/sdcard/music/.voice_names"     // 以前的位置 不再读 还在的话提示挪走
+#define VOICE_VOCAB_NAMES_MAX   16384   // 拼音文件最多读这么多字节
+#define VOICE_VOCAB_SONGS       CONFIG_APP_VOICE_VOCAB_SONGS
+#define VOICE_VOCAB_PHRASE_LEN  64      // 和ESP_MN_MAX_PHRASE_LEN一样 含"bo fang "
+#define VOICE_VOCAB_PATH_LEN    128
+#define VOICE_VOCAB_POLL_MS     5000
+#define VOICE_VOCAB_EDIT_MS     10000   // 等识别任务空出来的最长时间 听命令时要等它听完
+
+typedef struct {
+    uint32_t songs;                     // 现在命令表里的歌
+    uint32_t apps;
+    uint32_t rebuilds;
+    uint32_t added;                     // 累计加进去的
+    uint32_t removed;
+    uint32_t rejected;                  // MultiNet不认的拼音 累计
+    uint32_t no_pinyin;                 // 上次重建时找不到拼音的歌
+    uint32_t over;                      // 上次重建时超过VOICE_VOCAB_SONGS没加的
+    uint32_t scan_ms;                   // 上次走音乐目录和比对花的 在后台任务里
+    uint32_t apply_us;                  // 上次在识别任务里改命令表花的 这段时间识别停着
+    uint32_t apply_us_max;
+    uint32_t plays;
+    uint32_t missing;                   // 识别出来时那首歌已经删了
+} voice_vocab_stats_t;
+
+#if CONFIG_APP_VOICE_VOCAB
+esp_err_t voice_vocab_start(void);      // voice_cmd_start成功以后调一次
+void voice_vocab_get_stats(voice_vocab_stats_t *stats);
+#endif
@@ -0,0 +1,592 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include "web_dash.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "mdns.h"
+#include "audio_player.h"
+#include "audio_pcm.h"
+#include "app_ui.h"
+#include "ui_msg.h"
+#include "ui_perf.h"
+#include "sd_writer.h"
+#include "sd_fs.h"
+#include "file_server.h"
+#include "telemetry.h"
+
+#if CONFIG_APP_WEB_DASH
+
+static const char *TAG = "web_dash";
+
+#define DASH_CMD_LEN            24      // 页面发来的命令最长的
+
+enum {
+    COL_CPU0,
+    COL_CPU1,
+    COL_INT_FREE,
+    COL_INT_BLOCK,
+    COL_DMA_FREE,
+    COL_PSRAM_FREE,
+    COL_PSRAM_BLOCK,
+    COL_PCM_FILL,
+    COL_UNDERRUNS,
+    COL_FPS,
+    COL_SD_WRITE,
+    COL_SD_READ,
+    COL_STATE,
+    COL_VOLUME,
+    COL_POSITION,
+    COL_COUNT,
+};
+
+static const char *const s_col_names[COL_COUNT] = {
+    "cpu0", "cpu1", "int_free", "int_block", "dma_free", "psram_free", "psram_block", "pcm_fill",
+    "underruns", "fps", "sd_write", "sd_read", "state", "volume", "position",
+};
+static const char *const s_col_units[COL_COUNT] = {
+    "%", "%", "KB", "KB", "KB", "KB", "KB", "%", "", "", "KB/s", "KB/s", "", "%", "s",
+};
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static web_dash_stats_t s_stats;
+static httpd_handle_t s_server;
+static esp_timer_handle_t s_timer;
+static uint16_t s_period_ms = CONFIG_APP_WEB_DASH_PERIOD_MS;
+static volatile bool s_want_key = true;
+static volatile bool s_out_busy;       // esp_timer任务置位 httpd任务发完清掉
+static char s_out[WEB_DASH_OUT_LEN];
+static size_t s_out_len;
+
+// 下面这些只在esp_timer任务里用
+static int32_t s_batch[WEB_DASH_BATCH_MAX][COL_COUNT];
+static int32_t s_last[COL_COUNT];       // 上一帧最后一个样本
+static uint8_t s_count;
+static uint32_t s_seq;
+static uint32_t s_t0_ms;
+static telemetry_cpu_t s_cpu;
+static int64_t s_prev_us;
+static uint32_t s_prev_frames;
+static uint64_t s_prev_wr;
+static uint64_t s_prev_rd;
+
+// 下面这些只在httpd任务里用
+static int s_clients[WEB_DASH_CLIENTS] = {-1, -1, -1, -1};
+static int s_client_count;
+static char s_hello[512];
+
+static const char s_dash_html[] =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\">"
+    "<meta name=\"viewport\" content=\"width=device-width\"><title>Dashboard</title>"
+    "<style>td{padding:0 8px}td:nth-child(2){text-align:right}</style></head><body>"
+    "<div><span id=\"st\">连接中</span> <button onclick=\"S('prev')\">|&lt;</button>"
+    "<button onclick=\"S('play')\">播放</button><button onclick=\"S('pause')\">暂停</button>"
+    "<button onclick=\"S('resume')\">继续</button><button onclick=\"S('next')\">&gt;|</button>"
+    " 音量<input type=\"range\" id=\"vol\" min=\"0\" max=\"100\" onchange=\"S('vol '+this.value)\">"
+    " 周期<input id=\"per\" size=\"4\" onchange=\"S('period '+this.value)\">ms</div>"
+    "<canvas id=\"c\" width=\"480\" height=\"120\" style=\"border:1px solid #ccc\"></canvas>"
+    "<table id=\"t\"></table><script>"
+    "var ws,N=[],cur=[],seq=-1,wait=0,H=[],G={};"
+    "function $(i){return document.getElementById(i)}"
+    "function S(c){if(ws&&ws.readyState==1)ws.send(c)}"
+    "function push(){H.push(cur.slice());if(H.length>240)H.shift()}"
+    "function show(){cur.forEach((v,i)=>$('v'+i).textContent=v);"
+    "$('st').textContent=['停止','播放','暂停'][cur[G.state]]+' '+cur[G.position]+'s';"
+    "if(document.activeElement!=$('vol'))$('vol').value=cur[G.volume];"
+    "var c=$('c').getContext('2d'),w=480/240;c.clearRect(0,0,480,120);"
+    "[['cpu0','#e53935'],['cpu1','#1e88e5'],['fps','#43a047'],['pcm_fill','#fb8c00']].forEach(p=>{"
+    "c.strokeStyle=p[1];c.beginPath();H.forEach((r,x)=>c.lineTo(x*w,120-Math.min(r[G[p[0]]],100)*1.2));c.stroke();})}"
+    "function conn(){ws=new WebSocket('ws://'+location.host+'/ws');"
+    "ws.onopen=()=>ws.send('hello');"
+    "ws.onclose=()=>{$('st').textContent='断开';setTimeout(conn,2000)};"
+    "ws.onmessage=e=>{var m=JSON.parse(e.data);"
+    "if(m.names){N=m.names;G={};var t=$('t');t.innerHTML='';$('per').value=m.period;seq=-1;H=[];"
+    "N.forEach((n,i)=>{G[n]=i;var r=t.insertRow();r.insertCell().textContent=n;"
+    "r.insertCell().id='v'+i;r.insertCell().textContent=m.units[i]});return}"
+    "if(!N.length)return;if(m.k){cur=m.k.slice();wait=0;push()}"
+    "else if(seq<0||m.s!=seq+1){seq=-1;if(!wait){wait=1;S('key')}return}"
+    "seq=m.s;$('per').placeholder=m.p;"
+    "m.d.forEach(d=>{for(var i=0;i<d.length;i+=2)cur[d[i]]+=d[i+1];push()});show()}}"
+    "conn();</script></body></html>";
+
+/********************************** 采样和编码 在esp_timer任务里 **********************************/
+
+static void sample_take(int32_t *v)
+{
+    const int64_t now = esp_timer_get_time();
+    const uint32_t dt_us = s_prev_us ? now - s_prev_us : 0;
+    s_prev_us = now;
+    for (int i = 0; i < 2; i++)
+    {
+        v[COL_CPU0 + i] = (telemetry_cpu_load(&s_cpu, i) + 5) / 10;
+    }
+    v[COL_INT_FREE] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024;
+    v[COL_INT_BLOCK] = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) / 1024;
+    v[COL_DMA_FREE] = heap_caps_get_free_size(MALLOC_CAP_DMA) / 1024;
+    v[COL_PSRAM_FREE] = heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 1024;
+    v[COL_PSRAM_BLOCK] = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) / 1024;
+
+    audio_pcm_stats_t pcm;
+    audio_pcm_get_stats(&pcm);
+    v[COL_PCM_FILL] = pcm.ring_size ? (uint64_t)pcm.fill * 100 / pcm.ring_size : 0;
+    v[COL_UNDERRUNS] = pcm.underruns;
+
+    // 帧率和SD卡吞吐量是两次采样之间的差 第一个样本是0
+    uint32_t frames;
+    uint64_t render_us;
+    ui_perf_get_totals(&frames, &render_us);
+    sd_writer_stats_t sw;
+    sd_writer_get_stats(&sw);
+    sd_fs_stats_t sf;
+    sd_fs_get_stats(&sf);
+    file_server_stats_t fs;
+    file_server_get_stats(&fs);
+    const uint64_t rd = sf.bytes + fs.download_bytes;
+    v[COL_FPS] = dt_us ? (uint64_t)(frames - s_prev_frames) * 1000000 / dt_us : 0;
+    v[COL_SD_WRITE] = dt_us ? (sw.bytes - s_prev_wr) * 1000000 / 1024 / dt_us : 0;
+    v[COL_SD_READ] = dt_us ? (rd - s_prev_rd) * 1000000 / 1024 / dt_us : 0;
+    s_prev_frames = frames;
+    s_prev_wr = sw.bytes;
+    s_prev_rd = rd;
+
+    audio_player_position_t pos = {0};
+    audio_player_get_position(&pos);
+    audio_player_state_t state = audio_player_get_state();
+    v[COL_STATE] = state == AUDIO_PLAYER_STATE_PLAYING ? 1 : state == AUDIO_PLAYER_STATE_PAUSE ? 2 : 0;
+    v[COL_VOLUME] = audio_pcm_get_volume();
+    v[COL_POSITION] = pos.position_ms / 1000;
+}
+
+static bool out_printf(size_t *used, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static bool out_printf(size_t *used, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(s_out + *used, sizeof(s_out) - *used, fmt, ap);
+    va_end(ap);
+    if (n < 0 || *used + n >= sizeof(s_out))
+    {
+        return false;
+    }
+    *used += n;
+    return true;
+}
+
+// 编进s_out 装不下返回0 下一帧发全量
+static size_t frame_encode(bool key, uint32_t *cols)
+{
+    size_t used = 0;
+    bool ok = out_printf(&used, "{\"s\":%lu,\"t\":%lu,\"p\":%u", (unsigned long)s_seq, (unsigned long)s_t0_ms,
+                         s_period_ms);
+    const int32_t *prev = s_last;
+    int first = 0;
+    if (key)
+    {
+        ok = ok && out_printf(&used, ",\"k\":[");
+        for (int c = 0; ok && c < COL_COUNT; c++)
+        {
+            ok = out_printf(&used, "%s%ld", c ? "," : "", (long)s_batch[0][c]);
+        }
+        ok = ok && out_printf(&used, "]");
+        *cols += COL_COUNT;
+        prev = s_batch[0];
+        first = 1;
+    }
+    ok = ok && out_printf(&used, ",\"d\":[");
+    for (int i = first; ok && i < s_count; i++)
+    {
+        ok = out_printf(&used, "%s[", i > first ? "," : "");
+        bool any = false;
+        for (int c = 0; ok && c < COL_COUNT; c++)
+        {
+            if (s_batch[i][c] != prev[c])
+            {
+                ok = out_printf(&used, "%s%d,%ld", any ? "," : "", c, (long)(s_batch[i][c] - prev[c]));
+                any = true;
+                (*cols)++;
+            }
+        }
+        ok = ok && out_printf(&used, "]");
+        prev = s_batch[i];
+    }
+    ok = ok && out_printf(&used, "]}");
+    return ok ? used : 0;
+}
+
+static void send_work(void *arg);
+
+static void sample_cb(void *arg)
+{
+    const int64_t t0 = esp_timer_get_time();
+    if (s_count == 0)
+    {
+        s_t0_ms = t0 / 1000;
+    }
+    sample_take(s_batch[s_count]);
+    bool dropped = false, sent = false, key = false;
+    uint32_t cols = 0;
+    if (++s_count >= CONFIG_APP_WEB_DASH_BATCH)
+    {
+        if (s_out_busy)
+        {
+            dropped = true;
+        }
+        else
+        {
+            key = s_want_key || s_seq % WEB_DASH_KEY_EVERY == 0;
+            s_want_key = false;
+            s_out_len = frame_encode(key, &cols);
+            s_out_busy = s_out_len > 0;
+            if (s_out_busy && httpd_queue_work(s_server, send_work, NULL) != ESP_OK)
+            {
+                s_out_busy = false;
+            }
+            sent = s_out_busy;
+            dropped = !sent;
+        }
+        if (dropped)
+        {
+            s_want_key = true;  // 页面的状态对不上了
+        }
+        memcpy(s_last, s_batch[s_count - 1], sizeof(s_last));
+        s_seq++;
+        s_count = 0;
+    }
+    uint32_t us = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.samples++;
+    s_stats.cols_sampled += COL_COUNT;
+    s_stats.cols_sent += cols;
+    s_stats.frames += sent;
+    s_stats.key_frames += sent && key;
+    s_stats.dropped += dropped;
+    s_stats.sample_max_us = us > s_stats.sample_max_us ? us : s_stats.sample_max_us;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/********************************** 连接和命令 在httpd任务里 **********************************/
+
+static void timer_restart(void)
+{
+    esp_timer_stop(s_timer);
+    if (s_client_count)
+    {
+        esp_timer_start_periodic(s_timer, (uint64_t)s_period_ms * 1000);
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.clients = s_client_count;
+    s_stats.period_ms = s_period_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static void client_remove(int i)
+{
+    ESP_LOGI(TAG, "client %d gone", s_clients[i]);
+    s_clients[i] = -1;
+    s_client_count--;
+    if (s_client_count == 0)
+    {
+        timer_restart();    // 没人看了 停下
+    }
+    else
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.clients = s_client_count;
+        portEXIT_CRITICAL(&s_lock);
+    }
+}
+
+// 断开的在发的时候才发现 httpd关socket不会告诉这里
+static void send_work(void *arg)
+{
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)s_out,
+        .len = s_out_len,
+    };
+    uint32_t sent = 0;
+    for (int i = 0; i < WEB_DASH_CLIENTS; i++)
+    {
+        int fd = s_clients[i];
+        if (fd < 0)
+        {
+            continue;
+        }
+        if (httpd_ws_get_fd_info(s_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+            httpd_ws_send_frame_async(s_server, fd, &frame) != ESP_OK)
+        {
+            client_remove(i);
+            continue;
+        }
+        sent++;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.bytes += (uint64_t)s_out_len * sent;
+    portEXIT_CRITICAL(&s_lock);
+    s_out_busy = false;
+}
+
+static void dash_play(void *arg)
+{
+    ai_play();
+}
+
+static void dash_pause(void *arg)
+{
+    ai_pause();
+}
+
+static void dash_resume(void *arg)
+{
+    ai_resume();
+}
+
+static void dash_next(void *arg)
+{
+    ai_next_music();
+}
+
+static void dash_prev(void *arg)
+{
+    ai_prev_music();
+}
+
+static void dash_seek(void *arg)
+{
+    ai_seek((uintptr_t)arg);
+}
+
+static void dash_volume(void *arg)
+{
+    ai_volume_set((uintptr_t)arg);
+}
+
+static void dash_volume_up(void *arg)
+{
+    ai_volume_up();
+}
+
+static void dash_volume_down(void *arg)
+{
+    ai_volume_down();
+}
+
+static esp_err_t hello_send(httpd_req_t *req)
+{
+    size_t used = snprintf(s_hello, sizeof(s_hello), "{\"period\":%u,\"batch\":%d,\"names\":[", s_period_ms,
+                           CONFIG_APP_WEB_DASH_BATCH);
+    for (int c = 0; c < COL_COUNT; c++)
+    {
+        used += snprintf(s_hello + used, sizeof(s_hello) - used, "%s\"%s\"", c ? "," : "", s_col_names[c]);
+    }
+    used += snprintf(s_hello + used, sizeof(s_hello) - used, "],\"units\":[");
+    for (int c = 0; c < COL_COUNT; c++)
+    {
+        used += snprintf(s_hello + used, sizeof(s_hello) - used, "%s\"%s\"", c ? "," : "", s_col_units[c]);
+    }
+    used += snprintf(s_hello + used, sizeof(s_hello) - used, "]}");
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)s_hello,
+        .len = used,
+    };
+    return httpd_ws_send_frame(req, &frame);
+}
+
+static bool cmd_handle(httpd_req_t *req, const char *cmd)
+{
+    const char *arg = strchr(cmd, ' ');
+    const uint32_t val = arg ? strtoul(arg + 1, NULL, 10) : 0;
+    if (strcmp(cmd, "hello") == 0)
+    {
+        s_want_key = true;
+        return hello_send(req) == ESP_OK;
+    }
+    if (strcmp(cmd, "key") == 0)
+    {
+        s_want_key = true;
+        return true;
+    }
+    if (strcmp(cmd, "play") == 0)
+    {
+        return ui_post_call(dash_play, NULL);
+    }
+    if (strcmp(cmd, "pause") == 0)
+    {
+        return ui_post_call(dash_pause, NULL);
+    }
+    if (strcmp(cmd, "resume") == 0)
+    {
+        return ui_post_call(dash_resume, NULL);
+    }
+    if (strcmp(cmd, "next") == 0)
+    {
+        return ui_post_call(dash_next, NULL);
+    }
+    if (strcmp(cmd, "prev") == 0)
+    {
+        return ui_post_call(dash_prev, NULL);
+    }
+    if (strcmp(cmd, "vol+") == 0)
+    {
+        return ui_post_call(dash_volume_up, NULL);
+    }
+    if (strcmp(cmd, "vol-") == 0)
+    {
+        return ui_post_call(dash_volume_down, NULL);
+    }
+    if (arg && strncmp(cmd, "vol ", 4) == 0)
+    {
+        return val <= 100 && ui_post_call(dash_volume, (void *)(uintptr_t)val);
+    }
+    if (arg && strncmp(cmd, "seek ", 5) == 0)
+    {
+        return ui_post_call(dash_seek, (void *)(uintptr_t)val);
+    }
+    if (arg && strncmp(cmd, "period ", 7) == 0)
+    {
+        if (val < WEB_DASH_PERIOD_MIN || val > 10000)
+        {
+            return false;
+        }
+        s_period_ms = val;
+        timer_restart();
+        ESP_LOGI(TAG, "sample every %lu ms", (unsigned long)val);
+        return true;
+    }
+    return false;
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    // 握手完成时带着GET进来一次 之后每个数据帧进来一次
+    if (req->method == HTTP_GET)
+    {
+        const int fd = httpd_req_to_sockfd(req);
+        int slot = -1;
+        for (int i = 0; i < WEB_DASH_CLIENTS; i++)
+        {
+            if (s_clients[i] == fd)
+            {
+                return ESP_OK;
+            }
+            if (s_clients[i] < 0 && slot < 0)
+            {
+                slot = i;
+            }
+        }
+        if (slot < 0)
+        {
+            ESP_LOGW(TAG, "too many clients");
+            return ESP_FAIL;
+        }
+        s_clients[slot] = fd;
+        s_client_count++;
+        portENTER_CRITICAL(&s_lock);
+        s_stats.connects++;
+        portEXIT_CRITICAL(&s_lock);
+        s_want_key = true;
+        if (s_client_count == 1)
+        {
+            s_count = 0;    // 定时器停着 没人在改
+            memset(&s_cpu, 0, sizeof(s_cpu));
+            s_prev_us = 0;
+        }
+        timer_restart();
+        ESP_LOGI(TAG, "client %d connected, %d watching", fd, s_client_count);
+        return ESP_OK;
+    }
+
+    char cmd[DASH_CMD_LEN];
+    httpd_ws_frame_t frame = {0};
+    ESP_RETURN_ON_ERROR(httpd_ws_recv_frame(req, &frame, 0), TAG, "recv frame length");
+    if (frame.type != HTTPD_WS_TYPE_TEXT || frame.len == 0 || frame.len >= sizeof(cmd))
+    {
+        return frame.len >= sizeof(cmd) ? ESP_FAIL : ESP_OK;
+    }
+    frame.payload = (uint8_t *)cmd;
+    ESP_RETURN_ON_ERROR(httpd_ws_recv_frame(req, &frame, frame.len), TAG, "recv frame");
+    cmd[frame.len] = '\0';
+    bool ok = cmd_handle(req, cmd);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.commands += ok;
+    s_stats.rejected += !ok;
+    portEXIT_CRITICAL(&s_lock);
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "bad command \"%s\"", cmd);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t dash_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/html; charset=utf-8");
+    return httpd_resp_send(req, s_dash_html, sizeof(s_dash_html) - 1);
+}
+
+static void mdns_start(void)
+{
+    esp_err_t err = mdns_init();
+    if (err == ESP_OK)
+    {
+        mdns_hostname_set(CONFIG_APP_WEB_DASH_HOSTNAME);
+        mdns_instance_name_set("ESP32-S3 dashboard");
+        err = mdns_service_add(NULL, "_http", "_tcp", CONFIG_APP_FILE_SERVER_PORT, NULL, 0);
+    }
+    if (err == ESP_OK)
+    {
+        mdns_service_txt_item_set("_http", "_tcp", "path", "/dash");
+        portENTER_CRITICAL(&s_lock);
+        s_stats.mdns = true;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "dashboard at http://%s.local:%d/dash", CONFIG_APP_WEB_DASH_HOSTNAME,
+                 CONFIG_APP_FILE_SERVER_PORT);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "mdns failed: %s, use the IP address", esp_err_to_name(err));
+    }
+}
+
+esp_err_t web_dash_register(httpd_handle_t server)
+{
+    if (s_timer == NULL)
+    {
+        const esp_timer_create_args_t args = {
+            .callback = sample_cb,
+            .name = "web_dash",
+        };
+        ESP_RETURN_ON_ERROR(esp_timer_create(&args, &s_timer), TAG, "create timer");
+        mdns_start();
+    }
+    static const httpd_uri_t uris[] = {
+        {.uri = "/dash", .method = HTTP_GET, .handler = dash_handler},
+        {.uri = "/ws", .method = HTTP_GET, .handler = ws_handler, .is_websocket = true},
+    };
+    for (int i = 0; i < sizeof(uris) / sizeof(uris[0]); i++)
+    {
+        ESP_RETURN_ON_ERROR(httpd_register_uri_handler(server, &uris[i]), TAG, "register %s", uris[i].uri);
+    }
+    s_server = server;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.period_ms = s_period_ms;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+void web_dash_get_stats(web_dash_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
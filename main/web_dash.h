@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+
+/*********************** 网页仪表盘 ****************************/
+// 挂在文件传输的httpd上 浏览器打开 http://CONFIG_APP_WEB_DASH_HOSTNAME.local:端口/dash 不用记IP
+// mDNS在第一次起httpd时开 报主机名和_http._tcp服务
+// /ws是WebSocket 页面连上先发hello 回一次列名和单位 之后按周期推
+// 每CONFIG_APP_WEB_DASH_PERIOD_MS在esp_timer任务里采一个样本 全是整数 CPU负载用遥测的算法
+// 攒CONFIG_APP_WEB_DASH_BATCH个样本发一帧 帧是JSON:
+//   {"s":帧号,"t":第一个样本的ms,"k":[全量],"d":[[列,差值,列,差值...],...]}
+//   有k时k就是第一个样本 d是后面的 没有k时d的第一项是和上一帧最后一个样本比
+//   每个样本只带变了的列 没变的列不占地方
+// 新连上的 丢了帧的 每WEB_DASH_KEY_EVERY帧 下一帧带全量 页面看帧号不连续就等全量
+// 页面发文本命令 play pause resume next prev vol+ vol- vol <0~100> seek <ms> period <ms> key
+// 播放器的命令和BLE遥控一样交给LVGL任务调ai_*
+// 编码在esp_timer任务里 发送交给httpd任务 上一帧还没发完这一帧丢掉
+// 没有页面连着定时器停着
+
+#define WEB_DASH_CLIENTS        4
+#define WEB_DASH_BATCH_MAX      16
+#define WEB_DASH_PERIOD_MIN     50      // 页面能设的最短采样周期 ms
+#define WEB_DASH_KEY_EVERY      30      // 这么多帧发一次全量
+#define WEB_DASH_OUT_LEN        4096    // 一帧JSON 全部列都变也装得下
+
+typedef struct {
+    bool mdns;                          // mDNS起来了
+    uint8_t clients;
+    uint16_t period_ms;
+    uint32_t connects;
+    uint32_t commands;
+    uint32_t rejected;
+    uint32_t samples;
+    uint32_t frames;
+    uint32_t key_frames;
+    uint32_t dropped;                   // 上一帧还在发 这一帧丢掉的
+    uint64_t bytes;                     // 发给所有页面的 一帧发几个页面算几份
+    uint64_t cols_sampled;              // 采的列数 和下面的比看差分省了多少
+    uint64_t cols_sent;                 // 实际发出去的列 全量加变了的
+    uint32_t sample_max_us;             // 采样加编码
+} web_dash_stats_t;
+
+#if CONFIG_APP_WEB_DASH
+esp_err_t web_dash_register(httpd_handle_t server);    // httpd起来以后注册/dash和/ws 第一次调顺便开mDNS
+void web_dash_get_stats(web_dash_stats_t *stats);
+#endif
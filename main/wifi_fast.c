@@ -0,0 +1,137 @@
+#include <string.h>
+#include "wifi_fast.h"
+#include "nvs.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "wifi_fast";
+
+#define FAST_NVS_NAMESPACE  "wifi"
+#define FAST_NVS_KEY        "last_ap"
+
+static wifi_fast_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const s_result_names[WIFI_FAST_RESULTS] = {"direct", "fallback", "failed", "manual"};
+
+esp_err_t wifi_fast_load(wifi_fast_ap_t *ap)
+{
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(FAST_NVS_NAMESPACE, NVS_READONLY, &nvs), TAG, "no saved AP");
+    size_t len = sizeof(*ap);
+    esp_err_t ret = nvs_get_blob(nvs, FAST_NVS_KEY, ap, &len);
+    nvs_close(nvs);
+    if (ret == ESP_OK && len != sizeof(*ap))
+    {
+        ret = ESP_ERR_INVALID_SIZE; // 结构体变化后的旧数据
+    }
+    if (ret == ESP_OK)
+    {
+        ap->ssid[sizeof(ap->ssid) - 1] = 0;
+        ap->password[sizeof(ap->password) - 1] = 0;
+        ret = ap->ssid[0] ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ret;
+}
+
+esp_err_t wifi_fast_save(const wifi_fast_ap_t *ap)
+{
+    wifi_fast_ap_t old;
+    if (wifi_fast_load(&old) == ESP_OK && memcmp(&old, ap, sizeof(old)) == 0)
+    {
+        return ESP_OK;
+    }
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(FAST_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs_open failed");
+    esp_err_t ret = nvs_set_blob(nvs, FAST_NVS_KEY, ap, sizeof(*ap));
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (ret == ESP_OK)
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.saves++;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGI(TAG, "saved %s on channel %u", ap->ssid, ap->channel);
+    }
+    return ret;
+}
+
+esp_err_t wifi_fast_forget(void)
+{
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(FAST_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "nvs_open failed");
+    esp_err_t ret = nvs_erase_key(nvs, FAST_NVS_KEY);
+    if (ret == ESP_OK)
+    {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+void wifi_fast_config(const wifi_fast_ap_t *ap, bool direct, wifi_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    strlcpy((char *)cfg->sta.ssid, ap->ssid, sizeof(cfg->sta.ssid));
+    strlcpy((char *)cfg->sta.password, ap->password, sizeof(cfg->sta.password));
+    cfg->sta.threshold.authmode = ap->password[0] ? WIFI_AUTH_WPA2_PSK : WIFI_AUTH_OPEN;
+    cfg->sta.sae_pwe_h2e = WPA3_SAE_PWE_BOTH;
+    cfg->sta.pmf_cfg.capable = true;
+    if (direct && ap->channel)
+    {
+        cfg->sta.scan_method = WIFI_FAST_SCAN;
+        cfg->sta.channel = ap->channel;
+        cfg->sta.bssid_set = true;
+        memcpy(cfg->sta.bssid, ap->bssid, sizeof(cfg->sta.bssid));
+    }
+    else
+    {
+        cfg->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        cfg->sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL; // 同名的几台里连信号最好的
+    }
+}
+
+void wifi_fast_note(wifi_fast_result_t result, uint32_t us)
+{
+    if (result >= WIFI_FAST_RESULTS)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_stats.count[result]++;
+    s_stats.last = result;
+    if (result != WIFI_FAST_FAILED)
+    {
+        s_stats.last_us = us;
+        if (s_stats.best_us == 0 || us < s_stats.best_us)
+        {
+            s_stats.best_us = us;
+        }
+        if (us > s_stats.worst_us)
+        {
+            s_stats.worst_us = us;
+        }
+        if (s_stats.boot_ms == 0)
+        {
+            s_stats.boot_ms = esp_timer_get_time() / 1000;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void wifi_fast_get_stats(wifi_fast_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+const char *wifi_fast_result_name(wifi_fast_result_t result)
+{
+    return result < WIFI_FAST_RESULTS ? s_result_names[result] : "?";
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+#include "sdkconfig.h"
+
+
+/*********************** WiFi开机直连 ****************************/
+// 上次连上的SSID 密码 BSSID 信道存在NVS 开机不扫描 直接按信道和BSSID连 一般几百毫秒拿到IP
+// 直连失败(路由器换了信道或者换了一台)退回全信道扫描再连一次 连上以后把新的BSSID和信道存回去
+// 配合sdkconfig里的LWIP_DHCP_RESTORE_LAST_IP(直接请求上次的地址)和关掉DHCP的ARP检查 省掉最慢的两步
+// 这里只管保存和统计 连接本身在wifi_svc的服务任务里 和手动连接走同一个状态机
+
+#define WIFI_FAST_DIRECT_MS     1500    // 直连等这么久拿不到IP就退回扫描
+#define WIFI_FAST_SCAN_MS       8000
+
+typedef struct {
+    char ssid[33];
+    char password[65];
+    uint8_t bssid[6];
+    uint8_t channel;                    // 0表示没有 只能扫描
+    uint8_t authmode;                   // wifi_auth_mode_t
+} wifi_fast_ap_t;
+
+typedef enum {
+    WIFI_FAST_DIRECT,                   // 按保存的信道和BSSID直接连上
+    WIFI_FAST_FALLBACK,                 // 直连不行 扫描以后连上
+    WIFI_FAST_FAILED,
+    WIFI_FAST_MANUAL,                   // 在WiFi应用里手动连上
+    WIFI_FAST_RESULTS,
+} wifi_fast_result_t;
+
+typedef struct {
+    uint32_t count[WIFI_FAST_RESULTS];
+    uint32_t last_us;                   // 最近一次 开始WiFi初始化到拿到IP
+    uint32_t best_us;
+    uint32_t worst_us;
+    uint32_t boot_ms;                   // 开机到拿到IP
+    wifi_fast_result_t last;
+    uint32_t saves;                     // 写NVS的次数 没变不写
+} wifi_fast_stats_t;
+
+esp_err_t wifi_fast_load(wifi_fast_ap_t *ap);           // 没保存过返回ESP_ERR_NVS_NOT_FOUND
+esp_err_t wifi_fast_save(const wifi_fast_ap_t *ap);     // 和NVS里的一样就不写
+esp_err_t wifi_fast_forget(void);
+// 填sta配置 direct时带上BSSID和信道 只扫那一个信道
+void wifi_fast_config(const wifi_fast_ap_t *ap, bool direct, wifi_config_t *cfg);
+void wifi_fast_note(wifi_fast_result_t result, uint32_t us);   // 连接的一方报告结果
+void wifi_fast_get_stats(wifi_fast_stats_t *stats);
+const char *wifi_fast_result_name(wifi_fast_result_t result);
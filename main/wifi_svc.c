@@ -0,0 +1,701 @@
+#include <stdio.h>
+#include <string.h>
+#include "wifi_svc.h"
+#include "task_plan.h"
+#include "wifi_fast.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_event.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "wifi_svc";
+
+#define SVC_QUEUE           8
+#define SVC_SCAN_BATCH      16          // 一个信道一次取这么多条
+#define SVC_DISC_WAIT_MS    500         // 主动断开后等断开事件 等不到也往下走
+#define SVC_BIT_STARTED     BIT0
+#define SVC_BIT_CONNECTED   BIT1
+
+typedef enum {
+    MSG_SCAN,
+    MSG_CONNECT,
+    MSG_SCAN_DONE,                      // 以下由事件回调和定时器转过来
+    MSG_DISCONNECTED,
+    MSG_GOT_IP,
+    MSG_TIMER,
+} svc_msg_type_t;
+
+typedef struct {
+    svc_msg_type_t type;
+    uint32_t gen;                       // TIMER: 过期的定时器丢掉
+    uint8_t reason;                     // DISCONNECTED: wifi_err_reason_t
+    bool direct;                        // CONNECT: 先按保存的信道和BSSID直连
+    wifi_fast_result_t source;          // CONNECT: DIRECT或MANUAL
+    int64_t t_req;
+    wifi_fast_ap_t ap;
+} svc_msg_t;
+
+static QueueHandle_t s_queue;
+static EventGroupHandle_t s_bits;
+static esp_netif_t *s_netif;
+static esp_timer_handle_t s_timer;
+static volatile uint32_t s_timer_gen;
+static bool s_init;
+static wifi_svc_listener_t s_listeners[WIFI_SVC_LISTENERS];
+static wifi_svc_ap_t s_results[WIFI_SVC_SCAN_MAX];
+static int s_result_n;
+static wifi_svc_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 以下只在服务任务里用
+static wifi_svc_state_t s_state = WIFI_SVC_OFF;
+static wifi_fast_ap_t s_target;
+static bool s_direct;                   // 这次尝试带着BSSID和信道
+static wifi_fast_result_t s_source;
+static int64_t s_t_req;
+static int s_retry;
+static bool s_timed_out;                // 超时主动断开了 等断开事件以后再往下走
+static bool s_disc_ignore;              // 换AP时断开旧连接 下一个断开事件不算
+static uint32_t s_backoff_ms;
+static uint8_t s_scan_ch;               // 正在扫的信道 0表示没在扫
+static bool s_scan_pending;
+static int64_t s_scan_t0;
+static bool s_scan_first;
+
+static const char *const s_state_names[] = {"off", "idle", "connecting", "connected", "reconnecting", "failed"};
+
+const char *wifi_svc_state_name(wifi_svc_state_t state)
+{
+    return state <= WIFI_SVC_FAILED ? s_state_names[state] : "?";
+}
+
+static void notify(wifi_svc_event_type_t type, uint8_t channel)
+{
+    wifi_svc_listener_t cbs[WIFI_SVC_LISTENERS];
+    portENTER_CRITICAL(&s_lock);
+    memcpy(cbs, s_listeners, sizeof(cbs));
+    wifi_svc_event_t ev = {
+        .type = type,
+        .state = s_state,
+        .channel = channel,
+        .count = s_result_n,
+    };
+    portEXIT_CRITICAL(&s_lock);
+    for (int i = 0; i < WIFI_SVC_LISTENERS; i++)
+    {
+        if (cbs[i])
+        {
+            cbs[i](&ev);
+        }
+    }
+}
+
+static void set_state(wifi_svc_state_t state)
+{
+    if (state == s_state)
+    {
+        return;
+    }
+    ESP_LOGI(TAG, "%s -> %s", s_state_names[s_state], s_state_names[state]);
+    portENTER_CRITICAL(&s_lock);
+    s_state = state;
+    s_stats.state = state;
+    portEXIT_CRITICAL(&s_lock);
+    if (state == WIFI_SVC_CONNECTED)
+    {
+        xEventGroupSetBits(s_bits, SVC_BIT_CONNECTED);
+    }
+    else
+    {
+        xEventGroupClearBits(s_bits, SVC_BIT_CONNECTED);
+    }
+    notify(WIFI_SVC_EV_STATE, 0);
+}
+
+static void timer_cb(void *arg)
+{
+    svc_msg_t msg = {.type = MSG_TIMER, .gen = s_timer_gen};
+    xQueueSend(s_queue, &msg, 0);
+}
+
+static void timer_arm(uint32_t ms)
+{
+    esp_timer_stop(s_timer);
+    s_timer_gen++;
+    esp_timer_start_once(s_timer, (uint64_t)ms * 1000);
+}
+
+static void timer_cancel(void)
+{
+    esp_timer_stop(s_timer);
+    s_timer_gen++;
+}
+
+// 在事件循环任务里 只转进队列
+static void event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    svc_msg_t msg = {0};
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START)
+    {
+        xEventGroupSetBits(s_bits, SVC_BIT_STARTED);
+        return;
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_SCAN_DONE)
+    {
+        msg.type = MSG_SCAN_DONE;
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        msg.type = MSG_DISCONNECTED;
+        msg.reason = ((wifi_event_sta_disconnected_t *)data)->reason;
+    }
+    else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP)
+    {
+        msg.type = MSG_GOT_IP;
+    }
+    else
+    {
+        return;
+    }
+    if (xQueueSend(s_queue, &msg, 0) != pdTRUE)
+    {
+        ESP_LOGW(TAG, "queue full, event %d lost", msg.type);
+    }
+}
+
+/*********************** 扫描 ****************************/
+
+static void scan_finish(void)
+{
+    uint32_t ms = (esp_timer_get_time() - s_scan_t0) / 1000;
+    s_scan_ch = 0;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.scans++;
+    s_stats.scan_ms_last = ms;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "scan: %d networks in %lu ms", s_result_n, (unsigned long)ms);
+    notify(WIFI_SVC_EV_SCAN_DONE, 0);
+}
+
+static void scan_channel(void)
+{
+    wifi_scan_config_t cfg = {
+        .channel = s_scan_ch,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {.min = WIFI_SVC_CH_MIN_MS, .max = WIFI_SVC_CH_MAX_MS},
+    };
+    esp_err_t ret = esp_wifi_scan_start(&cfg, false);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "scan channel %u: %s", s_scan_ch, esp_err_to_name(ret));
+        scan_finish();
+    }
+}
+
+static void scan_begin(void)
+{
+    if (s_state == WIFI_SVC_CONNECTING || s_state == WIFI_SVC_RECONNECTING)
+    {
+        s_scan_pending = true; // 驱动在连接时不让扫 连完再说
+        return;
+    }
+    s_scan_pending = false;
+    if (s_scan_ch)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_lock);
+    s_result_n = 0;
+    portEXIT_CRITICAL(&s_lock);
+    s_scan_t0 = esp_timer_get_time();
+    s_scan_first = true;
+    s_scan_ch = 1;
+    scan_channel();
+}
+
+// 同名的只留信号最好的 表满了挤掉最弱的
+static void scan_merge(const wifi_ap_record_t *rec)
+{
+    if (rec->ssid[0] == 0)
+    {
+        return; // 隐藏网络 列表里选不了
+    }
+    int slot = -1, weakest = 0;
+    for (int i = 0; i < s_result_n; i++)
+    {
+        if (strcmp(s_results[i].ssid, (const char *)rec->ssid) == 0)
+        {
+            slot = i;
+            break;
+        }
+        if (s_results[i].rssi < s_results[weakest].rssi)
+        {
+            weakest = i;
+        }
+    }
+    if (slot < 0)
+    {
+        if (s_result_n < WIFI_SVC_SCAN_MAX)
+        {
+            slot = s_result_n++;
+        }
+        else if (rec->rssi > s_results[weakest].rssi)
+        {
+            slot = weakest;
+        }
+        else
+        {
+            return;
+        }
+    }
+    else if (rec->rssi <= s_results[slot].rssi)
+    {
+        return;
+    }
+    wifi_svc_ap_t *ap = &s_results[slot];
+    strlcpy(ap->ssid, (const char *)rec->ssid, sizeof(ap->ssid));
+    ap->rssi = rec->rssi;
+    ap->channel = rec->primary;
+    ap->authmode = rec->authmode;
+}
+
+static void scan_done(void)
+{
+    static wifi_ap_record_t s_batch[SVC_SCAN_BATCH];
+    uint16_t n = SVC_SCAN_BATCH;
+    if (esp_wifi_scan_get_ap_records(&n, s_batch) != ESP_OK)
+    {
+        n = 0;
+    }
+    if (s_scan_ch == 0)
+    {
+        return; // 扫描被连接打断 结果已经不要了
+    }
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < n; i++)
+    {
+        scan_merge(&s_batch[i]);
+    }
+    int count = s_result_n;
+    if (s_scan_first && count)
+    {
+        s_stats.first_result_ms = (esp_timer_get_time() - s_scan_t0) / 1000;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    s_scan_first = s_scan_first && count == 0;
+    notify(WIFI_SVC_EV_SCAN_UPDATE, s_scan_ch);
+    if (++s_scan_ch > WIFI_SVC_CHANNELS)
+    {
+        scan_finish();
+    }
+    else
+    {
+        scan_channel();
+    }
+}
+
+/*********************** 连接 ****************************/
+
+static void conn_apply(bool direct)
+{
+    wifi_config_t cfg;
+    s_direct = direct && s_target.channel;
+    wifi_fast_config(&s_target, s_direct, &cfg);
+    esp_wifi_set_config(WIFI_IF_STA, &cfg);
+    s_retry = 0;
+    s_timed_out = false;
+    esp_wifi_connect();
+    timer_arm(s_direct ? WIFI_FAST_DIRECT_MS : WIFI_FAST_SCAN_MS);
+}
+
+static void conn_begin(const svc_msg_t *msg)
+{
+    if (s_scan_ch)
+    {
+        s_scan_ch = 0;
+        esp_wifi_scan_stop();
+        notify(WIFI_SVC_EV_SCAN_DONE, 0);
+    }
+    if (s_state == WIFI_SVC_CONNECTED || s_state == WIFI_SVC_RECONNECTING || s_state == WIFI_SVC_CONNECTING)
+    {
+        // 换一个AP 旧连接的断开事件不算这次的失败
+        s_disc_ignore = esp_wifi_disconnect() == ESP_OK;
+    }
+    s_target = msg->ap;
+    s_source = msg->source;
+    s_t_req = msg->t_req;
+    set_state(WIFI_SVC_CONNECTING);
+    conn_apply(msg->direct);
+}
+
+// 一次尝试失败 直连的退回扫描 否则放弃
+static void conn_failed(void)
+{
+    timer_cancel();
+    if (s_direct)
+    {
+        ESP_LOGI(TAG, "%s not on channel %u, scanning", s_target.ssid, s_target.channel);
+        s_source = WIFI_FAST_FALLBACK;
+        conn_apply(false);
+        return;
+    }
+    uint32_t us = esp_timer_get_time() - s_t_req;
+    wifi_fast_note(WIFI_FAST_FAILED, us);
+    portENTER_CRITICAL(&s_lock);
+    s_stats.failures++;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGW(TAG, "connect to %s failed after %lu ms", s_target.ssid, (unsigned long)us / 1000);
+    set_state(WIFI_SVC_FAILED);
+    if (s_scan_pending)
+    {
+        scan_begin();
+    }
+}
+
+// 连上以后记下这台AP的BSSID和信道 下次开机直连
+static void conn_remember(void)
+{
+    wifi_ap_record_t rec;
+    wifi_fast_ap_t ap = s_target;
+    if (esp_wifi_sta_get_ap_info(&rec) == ESP_OK)
+    {
+        memcpy(ap.bssid, rec.bssid, sizeof(ap.bssid));
+        ap.channel = rec.primary;
+        ap.authmode = rec.authmode;
+    }
+    wifi_fast_save(&ap); // 和保存的一样就不写
+}
+
+static void on_got_ip(void)
+{
+    timer_cancel();
+    bool again = s_state == WIFI_SVC_RECONNECTING;
+    portENTER_CRITICAL(&s_lock);
+    s_stats.connects++;
+    s_stats.reconnects += again;
+    portEXIT_CRITICAL(&s_lock);
+    if (!again)
+    {
+        uint32_t us = esp_timer_get_time() - s_t_req;
+        wifi_fast_note(s_source, us);
+        ESP_LOGI(TAG, "connected to %s (%s) in %lu ms", s_target.ssid, wifi_fast_result_name(s_source),
+                 (unsigned long)us / 1000);
+        conn_remember();
+    }
+    s_backoff_ms = 1000;
+    set_state(WIFI_SVC_CONNECTED);
+    if (s_scan_pending)
+    {
+        scan_begin();
+    }
+}
+
+static void on_disconnected(uint8_t reason)
+{
+    if (s_disc_ignore)
+    {
+        s_disc_ignore = false;
+        return;
+    }
+    if (s_timed_out)
+    {
+        // 自己断开的 这个事件是预料中的
+        s_timed_out = false;
+        if (s_state == WIFI_SVC_CONNECTING)
+        {
+            conn_failed();
+        }
+        return;
+    }
+    switch (s_state)
+    {
+    case WIFI_SVC_CONNECTING:
+        if (s_retry < WIFI_SVC_RETRY - (s_direct ? 2 : 0)) // 直连只重试一次 不行就扫描
+        {
+            s_retry++;
+            esp_wifi_connect();
+        }
+        else
+        {
+            ESP_LOGI(TAG, "%s: disconnected, reason %u", s_target.ssid, reason);
+            conn_failed();
+        }
+        break;
+    case WIFI_SVC_CONNECTED:
+    {
+        portENTER_CRITICAL(&s_lock);
+        s_stats.drops++;
+        portEXIT_CRITICAL(&s_lock);
+        ESP_LOGW(TAG, "lost %s, reason %u", s_target.ssid, reason);
+        // AP可能换了信道 重连不再带BSSID
+        wifi_config_t cfg;
+        wifi_fast_config(&s_target, false, &cfg);
+        esp_wifi_set_config(WIFI_IF_STA, &cfg);
+        s_backoff_ms = 1000;
+        set_state(WIFI_SVC_RECONNECTING);
+        esp_wifi_connect();
+        break;
+    }
+    case WIFI_SVC_RECONNECTING:
+        timer_arm(s_backoff_ms);
+        s_backoff_ms = s_backoff_ms * 2 < WIFI_SVC_BACKOFF_MAX_MS ? s_backoff_ms * 2 : WIFI_SVC_BACKOFF_MAX_MS;
+        break;
+    default:
+        break;
+    }
+}
+
+static void on_timer(void)
+{
+    if (s_state == WIFI_SVC_RECONNECTING)
+    {
+        esp_wifi_connect();
+    }
+    else if (s_state == WIFI_SVC_CONNECTING)
+    {
+        if (s_timed_out)
+        {
+            // 断开事件一直没来
+            s_timed_out = false;
+            conn_failed();
+            return;
+        }
+        s_timed_out = true;
+        if (esp_wifi_disconnect() == ESP_OK)
+        {
+            timer_arm(SVC_DISC_WAIT_MS);
+        }
+        else
+        {
+            s_timed_out = false;
+            conn_failed();
+        }
+    }
+}
+
+static void svc_task(void *arg)
+{
+    for (;;)
+    {
+        svc_msg_t msg;
+        xQueueReceive(s_queue, &msg, portMAX_DELAY);
+        switch (msg.type)
+        {
+        case MSG_SCAN:
+            scan_begin();
+            break;
+        case MSG_CONNECT:
+            conn_begin(&msg);
+            break;
+        case MSG_SCAN_DONE:
+            scan_done();
+            break;
+        case MSG_DISCONNECTED:
+            on_disconnected(msg.reason);
+            break;
+        case MSG_GOT_IP:
+            on_got_ip();
+            break;
+        case MSG_TIMER:
+            if (msg.gen == s_timer_gen)
+            {
+                on_timer();
+            }
+            break;
+        }
+    }
+}
+
+static esp_err_t svc_init(void)
+{
+    int64_t t0 = esp_timer_get_time();
+    s_bits = xEventGroupCreate();
+    s_queue = xQueueCreate(SVC_QUEUE, sizeof(svc_msg_t));
+    ESP_RETURN_ON_FALSE(s_bits && s_queue, ESP_ERR_NO_MEM, TAG, "no memory");
+    const esp_timer_create_args_t targs = {.callback = timer_cb, .name = "wifi_svc"};
+    ESP_RETURN_ON_ERROR(esp_timer_create(&targs, &s_timer), TAG, "timer");
+
+    ESP_RETURN_ON_ERROR(esp_netif_init(), TAG, "netif");
+    esp_err_t ret = esp_event_loop_create_default();
+    ESP_RETURN_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, TAG, "event loop");
+    s_netif = esp_netif_create_default_wifi_sta();
+    ESP_RETURN_ON_FALSE(s_netif, ESP_FAIL, TAG, "sta netif");
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_wifi_init(&cfg), TAG, "wifi init");
+    ESP_RETURN_ON_ERROR(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, event_handler, NULL, NULL),
+                        TAG, "wifi events");
+    ESP_RETURN_ON_ERROR(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, event_handler, NULL, NULL),
+                        TAG, "ip events");
+    ESP_RETURN_ON_ERROR(esp_wifi_set_storage(WIFI_STORAGE_RAM), TAG, "storage"); // 上次的AP由wifi_fast存
+    ESP_RETURN_ON_ERROR(esp_wifi_set_mode(WIFI_MODE_STA), TAG, "mode");
+    ESP_RETURN_ON_FALSE(task_plan_create(TASK_WIFI_SVC, svc_task, NULL, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "task");
+    ESP_RETURN_ON_ERROR(esp_wifi_start(), TAG, "start");
+    xEventGroupWaitBits(s_bits, SVC_BIT_STARTED, pdFALSE, pdFALSE, pdMS_TO_TICKS(1000));
+    uint32_t ms = (esp_timer_get_time() - t0) / 1000;
+    portENTER_CRITICAL(&s_lock);
+    s_state = WIFI_SVC_IDLE;
+    s_stats.state = WIFI_SVC_IDLE;
+    s_stats.init_ms = ms;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "WiFi up in %lu ms", (unsigned long)ms);
+    return ESP_OK;
+}
+
+esp_err_t wifi_svc_start(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool first = !s_init;
+    s_init = true;
+    portEXIT_CRITICAL(&s_lock);
+    if (first)
+    {
+        esp_err_t ret = svc_init();
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "WiFi init failed: %s", esp_err_to_name(ret));
+        }
+        return ret;
+    }
+    // 别的任务正在初始化 等它做完
+    for (int i = 0; i < 100 && wifi_svc_state() == WIFI_SVC_OFF; i++)
+    {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    return wifi_svc_state() == WIFI_SVC_OFF ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t wifi_svc_subscribe(wifi_svc_listener_t cb)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < WIFI_SVC_LISTENERS; i++)
+    {
+        if (s_listeners[i] == cb)
+        {
+            ret = ESP_OK;
+            break;
+        }
+        if (s_listeners[i] == NULL && ret != ESP_OK)
+        {
+            s_listeners[i] = cb;
+            ret = ESP_OK;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+void wifi_svc_unsubscribe(wifi_svc_listener_t cb)
+{
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < WIFI_SVC_LISTENERS; i++)
+    {
+        if (s_listeners[i] == cb)
+        {
+            s_listeners[i] = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+static esp_err_t svc_post(const svc_msg_t *msg)
+{
+    ESP_RETURN_ON_FALSE(wifi_svc_state() != WIFI_SVC_OFF, ESP_ERR_INVALID_STATE, TAG, "not started");
+    return xQueueSend(s_queue, msg, pdMS_TO_TICKS(100)) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t wifi_svc_scan(void)
+{
+    svc_msg_t msg = {.type = MSG_SCAN};
+    return svc_post(&msg);
+}
+
+int wifi_svc_scan_results(wifi_svc_ap_t *out, int max)
+{
+    wifi_svc_ap_t all[WIFI_SVC_SCAN_MAX];
+    portENTER_CRITICAL(&s_lock);
+    int n = s_result_n;
+    memcpy(all, s_results, n * sizeof(all[0]));
+    portEXIT_CRITICAL(&s_lock);
+    // 插入排序 最多十几个
+    for (int i = 1; i < n; i++)
+    {
+        wifi_svc_ap_t ap = all[i];
+        int j = i;
+        for (; j > 0 && all[j - 1].rssi < ap.rssi; j--)
+        {
+            all[j] = all[j - 1];
+        }
+        all[j] = ap;
+    }
+    n = n < max ? n : max;
+    memcpy(out, all, n * sizeof(all[0]));
+    return n;
+}
+
+esp_err_t wifi_svc_connect(const char *ssid, const char *password)
+{
+    ESP_RETURN_ON_FALSE(ssid && ssid[0], ESP_ERR_INVALID_ARG, TAG, "no ssid");
+    svc_msg_t msg = {.type = MSG_CONNECT, .source = WIFI_FAST_MANUAL, .t_req = esp_timer_get_time()};
+    strlcpy(msg.ap.ssid, ssid, sizeof(msg.ap.ssid));
+    strlcpy(msg.ap.password, password ? password : "", sizeof(msg.ap.password));
+    return svc_post(&msg);
+}
+
+esp_err_t wifi_svc_autoconnect(void)
+{
+    svc_msg_t msg = {.type = MSG_CONNECT, .direct = true, .source = WIFI_FAST_DIRECT, .t_req = esp_timer_get_time()};
+    if (wifi_fast_load(&msg.ap) != ESP_OK)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return svc_post(&msg);
+}
+
+wifi_svc_state_t wifi_svc_state(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    wifi_svc_state_t state = s_stats.state;
+    portEXIT_CRITICAL(&s_lock);
+    return state;
+}
+
+bool wifi_svc_connected(void)
+{
+    return wifi_svc_state() == WIFI_SVC_CONNECTED;
+}
+
+bool wifi_svc_get_ip(char *ip, size_t len)
+{
+    esp_netif_ip_info_t info;
+    if (!wifi_svc_connected() || esp_netif_get_ip_info(s_netif, &info) != ESP_OK || info.ip.addr == 0)
+    {
+        return false;
+    }
+    snprintf(ip, len, IPSTR, IP2STR(&info.ip));
+    return true;
+}
+
+bool wifi_svc_wait_connected(uint32_t timeout_ms)
+{
+    if (wifi_svc_state() == WIFI_SVC_OFF)
+    {
+        return false;
+    }
+    TickType_t ticks = timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return xEventGroupWaitBits(s_bits, SVC_BIT_CONNECTED, pdFALSE, pdFALSE, ticks) & SVC_BIT_CONNECTED;
+}
+
+void wifi_svc_get_stats(wifi_svc_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_lock);
+    *stats = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
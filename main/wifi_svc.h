@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+
+/*********************** WiFi连接服务 ****************************/
+// 协议栈(netif 默认事件循环 WiFi驱动)第一次用时初始化 以后一直留着 进出WiFi应用不再反复初始化和释放
+// 所有扫描 连接 断开重连都在服务任务里按状态机走 事件回调只把事件转进队列 界面和别的功能订阅状态变化
+// 扫描一次只扫一个信道 每扫完一个信道合并进结果表通知一次 列表跟着一点点出来 不用等全部扫完
+// 连上以后掉线自己重连 间隔从1秒翻倍到WIFI_SVC_BACKOFF_MAX_MS 网络电台 直播这些后台功能不会因为离开应用断网
+// 连上的AP交给wifi_fast记下 开机直连也走这里
+//
+// 监听在服务任务里调用 不能阻塞 要动界面用ui_post_call
+
+#define WIFI_SVC_SCAN_MAX       16      // 结果表最多记这么多个SSID 同名的只留信号最好的
+#define WIFI_SVC_CHANNELS       13
+#define WIFI_SVC_CH_MIN_MS      30      // 每个信道主动扫描的停留时间
+#define WIFI_SVC_CH_MAX_MS      80
+#define WIFI_SVC_LISTENERS      4
+#define WIFI_SVC_RETRY          3       // 一次连接里驱动报断开后重试的次数
+#define WIFI_SVC_BACKOFF_MAX_MS 30000
+
+typedef enum {
+    WIFI_SVC_OFF,                       // 还没初始化
+    WIFI_SVC_IDLE,                      // 协议栈起来了 没连
+    WIFI_SVC_CONNECTING,
+    WIFI_SVC_CONNECTED,                 // 拿到IP
+    WIFI_SVC_RECONNECTING,              // 连上过又掉了 在按退避重连
+    WIFI_SVC_FAILED,                    // 这次连接放弃了 可以再发起
+} wifi_svc_state_t;
+
+typedef enum {
+    WIFI_SVC_EV_STATE,                  // 状态变了
+    WIFI_SVC_EV_SCAN_UPDATE,            // 又扫完一个信道 结果表有更新
+    WIFI_SVC_EV_SCAN_DONE,
+} wifi_svc_event_type_t;
+
+typedef struct {
+    wifi_svc_event_type_t type;
+    wifi_svc_state_t state;
+    uint8_t channel;                    // SCAN_UPDATE: 刚扫完的信道
+    uint8_t count;                      // 结果表里现在有几个
+} wifi_svc_event_t;
+
+typedef void (*wifi_svc_listener_t)(const wifi_svc_event_t *ev);
+
+typedef struct {
+    char ssid[33];
+    int8_t rssi;
+    uint8_t channel;
+    uint8_t authmode;                   // wifi_auth_mode_t
+} wifi_svc_ap_t;
+
+typedef struct {
+    wifi_svc_state_t state;
+    uint32_t init_ms;                   // 协议栈初始化花的时间 只有一次
+    uint32_t scans;
+    uint32_t scan_ms_last;              // 最近一次全部信道扫完
+    uint32_t first_result_ms;           // 最近一次扫描 开始到第一个结果出来
+    uint32_t connects;                  // 拿到IP的次数 包括重连
+    uint32_t failures;
+    uint32_t drops;                     // 连上以后掉线
+    uint32_t reconnects;                // 掉线后重连上的
+} wifi_svc_stats_t;
+
+esp_err_t wifi_svc_start(void);         // 可以多次调用 第一次初始化协议栈
+esp_err_t wifi_svc_subscribe(wifi_svc_listener_t cb);
+void wifi_svc_unsubscribe(wifi_svc_listener_t cb);
+esp_err_t wifi_svc_scan(void);          // 不阻塞 连接中收到的等连完再扫
+int wifi_svc_scan_results(wifi_svc_ap_t *out, int max);    // 按信号从强到弱 返回个数
+esp_err_t wifi_svc_connect(const char *ssid, const char *password); // 不阻塞 结果看状态事件
+esp_err_t wifi_svc_autoconnect(void);   // 按wifi_fast保存的AP直连 没保存过返回ESP_ERR_NOT_FOUND
+wifi_svc_state_t wifi_svc_state(void);
+bool wifi_svc_connected(void);
+bool wifi_svc_get_ip(char *ip, size_t len);
+bool wifi_svc_wait_connected(uint32_t timeout_ms);
+const char *wifi_svc_state_name(wifi_svc_state_t state);
+void wifi_svc_get_stats(wifi_svc_stats_t *stats);
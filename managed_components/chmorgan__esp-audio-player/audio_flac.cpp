@@ -2,6 +2,11 @@
 #include <cstring>
 #include <cstdlib>
 
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+
 #include "audio_log.h"
 #include "audio_flac.h"
 
@@ -55,6 +60,34 @@ static bool ensure_output_buffer(decode_data *output, size_t required_bytes) {
     return true;
 }
 
+// 单声道复制成两路，多声道开了 downmix 时混成立体声
+static size_t flac_out_channels(const FLACContext *ctx) {
+    return (ctx->channels > 2 && !ctx->downmix) ? static_cast<size_t>(ctx->channels) : 2;
+}
+
+// 解码核心的每声道工作区 每个样本都要读写几次
+// 优先按 FLAC_DECODED_CAPS 放内部RAM，放不下再退回默认堆(可能是PSRAM)
+static int *alloc_decoded(int blocksize, bool *internal) {
+    size_t bytes = sizeof(int) * static_cast<size_t>(blocksize);
+    void *p = heap_caps_malloc(bytes, FLAC_DECODED_CAPS);
+    *internal = p && esp_ptr_internal(p);
+    if (!p) {
+        p = malloc(bytes);
+    }
+    return static_cast<int*>(p);
+}
+
+// 输入环 解码和找帧头逐字节扫描 放内部RAM比PSRAM快
+// 高采样率24位文件的最大帧可能很大 内部RAM放不下就退回默认堆
+static void *alloc_input(size_t bytes, bool *internal) {
+    void *p = heap_caps_malloc(bytes, FLAC_DECODED_CAPS);
+    *internal = p && esp_ptr_internal(p);
+    if (!p) {
+        p = malloc(bytes);
+    }
+    return p;
+}
+
 // ... flac_instance_init / free (内存生命周期管理) ...
 void flac_instance_init(flac_instance *instance) {
     if (!instance) {
@@ -64,10 +97,22 @@ void flac_instance_init(flac_instance *instance) {
     std::memset(&instance->ctx, 0, sizeof(instance->ctx));
     instance->data_buf = nullptr;
     instance->data_buf_size = 0;
-    instance->bytes_in_data_buf = 0;
-    instance->read_ptr = nullptr;
+    instance->frame_span = 0;
+    instance->data_internal = false;
     instance->eof_reached = false;
     instance->data_start = 0;
+    instance->data_end = 0;
+    instance->seekpoints = nullptr;
+    instance->seekpoints_cap = 0;
+    instance->frames = 0;
+    instance->decode_us = 0;
+    instance->last_us = 0;
+    instance->max_us = 0;
+    instance->decode_cycles = 0;
+    instance->decoded_internal = false;
+    instance->crc_frames = 0;
+    instance->crc_errors = 0;
+    instance->crc_cycles = 0;
 }
 
 void flac_instance_free(flac_instance *instance) {
@@ -75,26 +120,72 @@ void flac_instance_free(flac_instance *instance) {
         return;
     }
 
-    if (instance->ctx.decoded0) {
-        free(instance->ctx.decoded0);
-        instance->ctx.decoded0 = nullptr;
-    }
-    if (instance->ctx.decoded1) {
-        free(instance->ctx.decoded1);
-        instance->ctx.decoded1 = nullptr;
+    for (int c = 0; c < FLAC_MAX_CHANNELS; ++c) {
+        free(instance->ctx.decoded[c]);
+        instance->ctx.decoded[c] = nullptr;
     }
     if (instance->data_buf) {
         free(instance->data_buf);
         instance->data_buf = nullptr;
     }
+    if (instance->seekpoints) {
+        free(instance->seekpoints);
+        instance->seekpoints = nullptr;
+    }
+    instance->seekpoints_cap = 0;
+    instance->ctx.seekpoints = 0;
 
     instance->data_buf_size = 0;
-    instance->bytes_in_data_buf = 0;
-    instance->read_ptr = nullptr;
+    instance->frame_span = 0;
     instance->eof_reached = false;
     instance->data_start = 0;
 }
 
+// 解析SEEKTABLE，保存到instance->seekpoints，供flac_seek直接定位
+#define FLAC_SEEKPOINT_SIZE 18
+#define FLAC_MAX_SEEKPOINTS 2048
+static bool parse_seek_table(FILE *fp, flac_instance *instance, uint32_t block_length) {
+    size_t count = block_length / FLAC_SEEKPOINT_SIZE;
+    size_t keep = std::min<size_t>(count, FLAC_MAX_SEEKPOINTS);
+
+    instance->ctx.seektable = static_cast<int>(ftell(fp));
+    instance->ctx.seekpoints = 0;
+    if (keep > instance->seekpoints_cap) {
+        flac_seekpoint *points = static_cast<flac_seekpoint*>(realloc(instance->seekpoints, keep * sizeof(flac_seekpoint)));
+        if (!points) {
+            // 没有内存就不用定位表，退化为按码率插值
+            return fseek(fp, static_cast<long>(block_length), SEEK_CUR) == 0;
+        }
+        instance->seekpoints = points;
+        instance->seekpoints_cap = keep;
+    }
+
+    uint8_t point[FLAC_SEEKPOINT_SIZE];
+    size_t n = 0;
+    for (size_t k = 0; k < count; ++k) {
+        if (fread(point, 1, sizeof(point), fp) != sizeof(point)) {
+            return false;
+        }
+        uint64_t sample = read_be64(point);
+        uint64_t offset = read_be64(point + 8);
+        if ((k >= keep) || (sample == 0xFFFFFFFFFFFFFFFFULL) || (sample > UINT32_MAX) || (offset > UINT32_MAX)) {
+            continue;
+        }
+        instance->seekpoints[n].sample = static_cast<uint32_t>(sample);
+        instance->seekpoints[n].offset = static_cast<uint32_t>(offset);
+        n++;
+    }
+    instance->ctx.seekpoints = static_cast<int>(n);
+
+    size_t rest = block_length - count * FLAC_SEEKPOINT_SIZE;
+    if (rest && fseek(fp, static_cast<long>(rest), SEEK_CUR) != 0) {
+        return false;
+    }
+
+    LOGI_1("seektable: %d points", static_cast<int>(n));
+    return true;
+}
+
 // Parse STREAMINFO and size internal/output buffers to the advertised maxima
 // FLAC 文件的开头必须是 "fLaC" 标记，紧接着是 STREAMINFO，元信息解析
 // 这里包含了全局信息：最小/最大块大小、采样率、总样本数等。
@@ -136,15 +227,16 @@ static bool parse_stream_info(FILE *fp, flac_instance *instance, decode_data *ou
             instance->ctx.bps = static_cast<int>(((packed >> 36) & 0x1F) + 1);
             instance->ctx.totalsamples = packed & 0xFFFFFFFFFULL;
 
-    // 限制：这里只支持最多 2 声道。FLAC 标准支持 8 声道，但嵌入式 DAC 通常只有 2 个。
-            if (instance->ctx.channels == 0 || instance->ctx.channels > 2) {
+            // DAC只有2个声道：多声道在解码输出时直接混成立体声
+            instance->ctx.downmix = 1;
+            if (instance->ctx.channels == 0 || instance->ctx.channels > FLAC_MAX_CHANNELS) {
                 return false;
             }
             if (instance->ctx.max_blocksize == 0) {
                 return false;
             }
 
-            size_t channels_out = (instance->ctx.channels == 1) ? 2 : instance->ctx.channels;
+            size_t channels_out = flac_out_channels(&instance->ctx);
             size_t bytes_per_sample = (instance->ctx.bps > 16) ? sizeof(int32_t) : sizeof(int16_t);
             size_t required_bytes = instance->ctx.max_blocksize * channels_out * bytes_per_sample;
 
@@ -153,43 +245,51 @@ static bool parse_stream_info(FILE *fp, flac_instance *instance, decode_data *ou
             }
 
             // Allocate internal decode buffers for FLACContext
-            // ... 为解码核心分配内存 (ctx.decoded0/decoded1) ...
-            // ... 初始化滑动读取缓冲区 data_buf ...
-            if (instance->ctx.decoded0) {
-                free(instance->ctx.decoded0);
-                instance->ctx.decoded0 = nullptr;
-            }
-            if (instance->ctx.decoded1) {
-                free(instance->ctx.decoded1);
-                instance->ctx.decoded1 = nullptr;
+            // ... 为解码核心分配内存 (ctx.decoded[]，每声道一块) ...
+            // ... 分配输入环 data_buf ...
+            for (int c = 0; c < FLAC_MAX_CHANNELS; ++c) {
+                free(instance->ctx.decoded[c]);
+                instance->ctx.decoded[c] = nullptr;
             }
 
-            instance->ctx.decoded0 = static_cast<int*>(malloc(sizeof(int) * instance->ctx.max_blocksize));
-            if (!instance->ctx.decoded0) {
-                return false;
-            }
-            if (instance->ctx.channels == 2) {
-                instance->ctx.decoded1 = static_cast<int*>(malloc(sizeof(int) * instance->ctx.max_blocksize));
-                if (!instance->ctx.decoded1) {
+            instance->decoded_internal = true;
+            for (int c = 0; c < instance->ctx.channels; ++c) {
+                bool internal = false;
+                instance->ctx.decoded[c] = alloc_decoded(instance->ctx.max_blocksize, &internal);
+                if (!instance->ctx.decoded[c]) {
                     return false;
                 }
+                instance->decoded_internal = instance->decoded_internal && internal;
             }
+            LOGI_1("decode buffers in %s", instance->decoded_internal ? "internal RAM" : "default heap");
 
-            size_t data_buffer_target = instance->ctx.max_framesize ?
+            // 输入环是两个最大帧长：任何一帧都能在环内连续存放，折回时不用重叠搬移
+            size_t frame_span = instance->ctx.max_framesize ?
                 static_cast<size_t>(instance->ctx.max_framesize) + 16 :
                 static_cast<size_t>(16 * 1024);
-            data_buffer_target = std::max<size_t>(data_buffer_target, 4 * 1024);
+            frame_span = std::max<size_t>(frame_span, 4 * 1024);
 
-            uint8_t *new_data_buf = static_cast<uint8_t*>(realloc(instance->data_buf, data_buffer_target));
-            if (!new_data_buf) {
-                return false;
+            if (!instance->data_buf || instance->data_buf_size != 2 * frame_span) {
+                free(instance->data_buf);
+                instance->data_buf = static_cast<uint8_t*>(alloc_input(2 * frame_span, &instance->data_internal));
+                if (!instance->data_buf) {
+                    instance->data_buf_size = 0;
+                    return false;
+                }
             }
 
-            instance->data_buf = new_data_buf;
-            instance->data_buf_size = data_buffer_target;
-            instance->read_ptr = instance->data_buf;
-            instance->bytes_in_data_buf = 0;
+            instance->data_buf_size = 2 * frame_span;
+            instance->frame_span = frame_span;
+            instance->ctx.bitstream_index = 0;
+            instance->ctx.bitstream_size = 0;
             instance->eof_reached = false;
+            LOGI_1("input ring %d bytes in %s", (int)instance->data_buf_size,
+                   instance->data_internal ? "internal RAM" : "default heap");
+        } else if (block_type == 3) {
+            // SEEKTABLE：每个定位点18字节 (采样号8 + 偏移8 + 帧采样数2)，占位点采样号全为1
+            if (!parse_seek_table(fp, instance, block_length)) {
+                return false;
+            }
         } else {
             // Skip other metadata blocks，其他直接忽略
             if (fseek(fp, static_cast<long>(block_length), SEEK_CUR) != 0) {
@@ -354,32 +454,35 @@ bool is_flac(FILE *fp, decode_data *output, flac_instance *instance) {
             return false;
         }
     } else {
-        // 不是 ID3，回退到文件开头，准备检查 fLaC
-        fseek(fp, 0, SEEK_SET);
-        if (fread(header, 1, 4, fp) != 4) {
+        // 不是 ID3，回到 fLaC 标记之后，header 前 4 字节就是标记
+        if (fseek(fp, 4, SEEK_SET) != 0) {
             return false;
         }
     }
 
-    uint8_t magic[4];
-    if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic)) {
-        return false;
-    }
-
-    if (std::memcmp(magic, "fLaC", sizeof(magic)) != 0) {
+    // 标记已经读在 header 里，不能再读一次，否则比较的是 STREAMINFO 块头
+    if (std::memcmp(header, "fLaC", 4) != 0) {
         fseek(fp, 0, SEEK_SET);
         return false;
     }
 
     // Reset runtime state but keep already allocated buffers if present
-    instance->bytes_in_data_buf = 0;
-    instance->read_ptr = instance->data_buf;
     instance->eof_reached = false;
     instance->ctx.sample_skip = 0;
     instance->ctx.framesize = 0;
     instance->ctx.samplenumber = 0;
     instance->ctx.bitstream_size = 0;
     instance->ctx.bitstream_index = 0;
+    instance->ctx.seektable = 0;
+    instance->ctx.seekpoints = 0;
+    instance->frames = 0;
+    instance->decode_us = 0;
+    instance->last_us = 0;
+    instance->max_us = 0;
+    instance->decode_cycles = 0;
+    instance->crc_frames = 0;
+    instance->crc_errors = 0;
+    instance->crc_cycles = 0;
     // 解析 StreamInfo
     bool ok = parse_stream_info(fp, instance, output);
     if (!ok) {
@@ -388,6 +491,8 @@ bool is_flac(FILE *fp, decode_data *output, flac_instance *instance) {
     }
     //ftell用于获取文件指针在文件中的当前位置。
     instance->data_start = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    instance->data_end = ftell(fp);
     //将文件开始位置向后移动，跳过文件头和元数据块，定位到音频数据的起始位置
     fseek(fp, instance->data_start, SEEK_SET);
 
@@ -397,36 +502,38 @@ bool is_flac(FILE *fp, decode_data *output, flac_instance *instance) {
 }
 
 // FLAC音乐会有多个音乐帧，每个帧的长度不固定，且都有自己的帧头
-// Refill the sliding input buffer while preserving unread bytes
-// 核心 I/O 逻辑：滑动窗口缓冲区填充
-// FLAC 帧长度不固定。如果缓冲区剩下的数据不够一帧，需要把剩下的数据搬到头部，
-// 然后从文件读取新数据填满缓冲区。
-// 
+// 输入环：data_buf 大小为 2 * frame_span，ctx.bitstream_index 是读位置，ctx.bitstream_size 是已填充的末尾。
+// 帧总是在 data_buf 里连续存放，解码核心直接按线性缓冲区读，不用处理回绕。
+// 未读数据不足一帧才读卡，一次读满环尾；读位置离环尾不足一帧时先把剩余的尾巴
+// 复制到环首再读。此时读位置已过半，尾巴不到 frame_span，复制源和目标不会重叠，
+// 每绕一圈最多复制一次、不到一帧，不再是每帧搬移整个缓冲区。
 static DECODE_STATUS handle_refill(FILE *fp, flac_instance *inst) {
-    //未读取
-    size_t unread = inst->bytes_in_data_buf - static_cast<size_t>(inst->read_ptr - inst->data_buf);
-    bool need_refill = (unread < (inst->data_buf_size / 2)) && !inst->eof_reached;
-    // memmove 处理未读数据 -> fread 填充 -> 更新指针
-    if (need_refill) {
-        //先把没有读的数据搬到缓冲区头部
-        memmove(inst->data_buf, inst->read_ptr, unread);
-
-        size_t free_space = inst->data_buf_size - unread;
-        //然后从文件读取新数据填充缓冲区剩余空间，不一定与空余空间相同
-        size_t n_read = fread(inst->data_buf + unread, 1, free_space, fp);
-
-        inst->bytes_in_data_buf = unread + n_read;
-        //重置读指针到缓冲区头部
-        inst->read_ptr = inst->data_buf;
+    FLACContext *ctx = &inst->ctx;
+    size_t index = static_cast<size_t>(ctx->bitstream_index);
+    size_t size = static_cast<size_t>(ctx->bitstream_size);
+    size_t unread = size - index;
+
+    if (unread < inst->frame_span && !inst->eof_reached) {
+        if (index + inst->frame_span > inst->data_buf_size) {
+            memcpy(inst->data_buf, inst->data_buf + index, unread);
+            index = 0;
+            size = unread;
+        }
+
+        size_t free_space = inst->data_buf_size - size;
+        size_t n_read = fread(inst->data_buf + size, 1, free_space, fp);
+        size += n_read;
         //小于看看是否读到文件尾了
         if (n_read < free_space) {
             inst->eof_reached = feof(fp);
         }
+        ctx->bitstream_index = static_cast<int>(index);
+        ctx->bitstream_size = static_cast<int>(size);
 
-        ESP_LOGI(TAG, "refill: pos %ld unread %d n_read %d eof %d", ftell(fp), (int)unread, (int)n_read, inst->eof_reached);
+        LOGI_2("refill: pos %ld unread %d n_read %d eof %d", ftell(fp), (int)unread, (int)n_read, inst->eof_reached);
     }
 
-    if (inst->bytes_in_data_buf == 0) {
+    if (ctx->bitstream_size == ctx->bitstream_index) {
         return inst->eof_reached ? DECODE_STATUS_DONE : DECODE_STATUS_NO_DATA_CONTINUE;
     }
 
@@ -443,10 +550,12 @@ DECODE_STATUS decode_flac(FILE *fp, decode_data *pData, flac_instance *pInstance
     if (refill_status != DECODE_STATUS_CONTINUE) {
         return refill_status;
     }
+    FLACContext *ctx = &pInstance->ctx;
     //填充后解码前定位帧头
-    size_t unread = pInstance->bytes_in_data_buf - static_cast<size_t>(pInstance->read_ptr - pInstance->data_buf);
-    // Locate next frame sync inside the sliding buffer
-    int offset = flac_seek_frame(pInstance->read_ptr, static_cast<uint32_t>(unread), &pInstance->ctx);
+    size_t unread = static_cast<size_t>(ctx->bitstream_size - ctx->bitstream_index);
+    uint8_t *read_ptr = pInstance->data_buf + ctx->bitstream_index;
+    // Locate next frame sync inside the ring
+    int offset = flac_seek_frame(read_ptr, static_cast<uint32_t>(unread), ctx);
     LOGI_2("seek: unread %d offset %d", (int)unread, offset);
     
     //找不到帧头
@@ -454,18 +563,22 @@ DECODE_STATUS decode_flac(FILE *fp, decode_data *pData, flac_instance *pInstance
         if (pInstance->eof_reached) {
             return DECODE_STATUS_DONE;
         }
-        // Drop buffer and try to refill next call
-        pInstance->read_ptr = pInstance->data_buf;
-        pInstance->bytes_in_data_buf = 0;
+        // 丢掉扫过的数据，留下最后3字节，同步字可能跨在补读的边界上
+        ctx->bitstream_index = ctx->bitstream_size - static_cast<int>(std::min<size_t>(unread, 3));
         return DECODE_STATUS_NO_DATA_CONTINUE;
     }
 
     //frame_buf_size除去帧头偏移，剩下的buffer中的大小（输入数组），准备解码
-    uint8_t *frame_ptr = pInstance->read_ptr + offset;
+    uint8_t *frame_ptr = read_ptr + offset;
     int frame_buf_size = static_cast<int>(unread - static_cast<size_t>(offset));
+    if (!pInstance->eof_reached && static_cast<size_t>(frame_buf_size) < pInstance->frame_span) {
+        // 帧头后面可能不够一整帧，先跳到帧头，下次补读后再解码，避免读到帧外
+        ctx->bitstream_index += offset;
+        return DECODE_STATUS_NO_DATA_CONTINUE;
+    }
 
     int decode_result = 0;
-    size_t channels_out = (pInstance->ctx.channels == 1) ? 2 : pInstance->ctx.channels;
+    size_t channels_out = flac_out_channels(&pInstance->ctx);
     size_t bytes_per_sample = (pInstance->ctx.bps > 16) ? sizeof(int32_t) : sizeof(int16_t);
     size_t required_bytes = static_cast<size_t>(pInstance->ctx.max_blocksize) * channels_out * bytes_per_sample;
 
@@ -476,46 +589,55 @@ DECODE_STATUS decode_flac(FILE *fp, decode_data *pData, flac_instance *pInstance
     }
     //在此处解码的时候会更新frame_size
     
+    int64_t start_us = esp_timer_get_time();
+    uint32_t start_cycles = esp_cpu_get_cycle_count();
     if (pInstance->ctx.bps > 16) {
-        // int32_t *s = reinterpret_cast<int32_t*>(pData->samples);
-        // //I2S 配置是否 32bit 槽+MSB 对齐：clk_set_fn/驱动应与数据对齐方式一致；
-        // size_t samples = pInstance->ctx.blocksize * channels_out;
-        // for (size_t k = 0; k < samples; ++k) s[k] <<= 8; // 24bit -> 32bit MSB对齐
         decode_result = flac_decode_frame24(&pInstance->ctx, frame_ptr, frame_buf_size,
                                             reinterpret_cast<int32_t*>(pData->samples));
+        if (decode_result == 0) {
+            // 解码结果右对齐，I2S 32bit 槽按 MSB 对齐输出，左移到高位
+            int32_t *s = reinterpret_cast<int32_t*>(pData->samples);
+            size_t samples = static_cast<size_t>(pInstance->ctx.blocksize) * channels_out;
+            int shift = 32 - pInstance->ctx.bps;
+            for (size_t k = 0; k < samples; ++k) {
+                s[k] = static_cast<int32_t>(static_cast<uint32_t>(s[k]) << shift);
+            }
+        }
         pData->fmt.bits_per_sample = 32;
     } else {
         decode_result = flac_decode_frame16(&pInstance->ctx, frame_ptr, frame_buf_size,
                                             reinterpret_cast<int16_t*>(pData->samples));
         pData->fmt.bits_per_sample = 16;
     }
+    uint32_t cost_cycles = esp_cpu_get_cycle_count() - start_cycles;
+    uint32_t cost_us = static_cast<uint32_t>(esp_timer_get_time() - start_us);
+
+#if CONFIG_FLAC_DECODER_VERIFY_CRC
+    // 解码刚读过这些字节，紧接着校验帧尾CRC-16，数据还在cache里
+    if (decode_result == 0 && pInstance->ctx.framesize <= frame_buf_size) {
+        uint32_t crc_start = esp_cpu_get_cycle_count();
+        int crc_result = flac_check_crc16(frame_ptr, pInstance->ctx.framesize);
+        pInstance->crc_cycles += esp_cpu_get_cycle_count() - crc_start;
+        pInstance->crc_frames++;
+        if (crc_result != 0) {
+            // SD卡坏扇区等导致数据损坏：整帧静音代替噪声，帧长不变，时间轴不乱
+            pInstance->crc_errors++;
+            ESP_LOGW(TAG, "flac crc error at sample %lu, frame muted", pInstance->ctx.samplenumber);
+            memset(pData->samples, 0, static_cast<size_t>(pInstance->ctx.blocksize) * channels_out * bytes_per_sample);
+        }
+    }
+#endif
 
     if (decode_result != 0) {
         ESP_LOGE(TAG, "flac decode error %d", decode_result);
-        // Attempt to skip past this frame to continue playback
-
-        size_t consumed = std::max<size_t>(1, pInstance->ctx.framesize + offset);
-        //更新读指针
-        pInstance->read_ptr += consumed;
-        if (pInstance->read_ptr > pInstance->data_buf + pInstance->bytes_in_data_buf) {
-            pInstance->read_ptr = pInstance->data_buf;
-            pInstance->bytes_in_data_buf = 0;
-        }
-        return pInstance->eof_reached ? DECODE_STATUS_DONE : DECODE_STATUS_NO_DATA_CONTINUE;
-    }
-        //消耗总字节数
-    size_t consumed_bytes = static_cast<size_t>(pInstance->ctx.framesize) + static_cast<size_t>(offset);
-    if (consumed_bytes > unread) {
-        consumed_bytes = unread;
+        // 出错时 framesize 还是上一帧的，越过这个同步字，下次从后面重新找帧头
+        ctx->bitstream_index += offset + 1;
+        return DECODE_STATUS_NO_DATA_CONTINUE;
     }
-    //解读当前帧后，更新滑动缓冲区大小
+    //消耗总字节数，只移动读位置
+    size_t consumed_bytes = std::min<size_t>(static_cast<size_t>(ctx->framesize) + static_cast<size_t>(offset), unread);
+    ctx->bitstream_index += static_cast<int>(consumed_bytes);
     size_t remaining = unread - consumed_bytes;
-    uint8_t *next_start = frame_ptr + pInstance->ctx.framesize;
-    // Compact unread data to buffer front so the next seek starts at position 0
-    memmove(pInstance->data_buf, next_start, remaining);
-    //更新指针
-    pInstance->read_ptr = pInstance->data_buf;
-    pInstance->bytes_in_data_buf = remaining;
         LOGI_2("ok: sr %d ch %d bps %d fc %d framesize %d remaining %d", pInstance->ctx.samplerate,
             pInstance->ctx.channels, pInstance->ctx.bps, (int)pInstance->ctx.blocksize, (int)pInstance->ctx.framesize,
             (int)remaining);
@@ -524,5 +646,82 @@ DECODE_STATUS decode_flac(FILE *fp, decode_data *pData, flac_instance *pInstance
     pData->fmt.channels = static_cast<uint32_t>(channels_out);
     pData->frame_count = static_cast<size_t>(pInstance->ctx.blocksize);
 
+    // 只统计帧解码本身，不含读卡和找帧头
+    pInstance->frames++;
+    pInstance->decode_us += cost_us;
+    pInstance->decode_cycles += cost_cycles;
+    pInstance->last_us = cost_us;
+    if (cost_us > pInstance->max_us) {
+        pInstance->max_us = cost_us;
+    }
+
     return DECODE_STATUS_CONTINUE;
 }
+
+uint32_t flac_duration_ms(const flac_instance *instance) {
+    if (!instance || instance->ctx.samplerate <= 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>(static_cast<uint64_t>(instance->ctx.totalsamples) * 1000 / instance->ctx.samplerate);
+}
+
+// 定位到 target_sample 所在位置
+// 在定位表中二分找到目标前后两个定位点，再在两点之间按采样数线性插值字节偏移，
+// 只需一次fseek。没有定位表时两端点就是数据起点和文件末尾。
+// 插值落点不一定是帧头，下次 decode_flac 会用 flac_seek_frame 同步到下一帧，
+// 帧头中的采样号给出真实位置，CRC8 校验排除误同步。
+bool flac_seek(FILE *fp, flac_instance *instance, uint64_t target_sample) {
+    if (!fp || !instance || instance->data_end <= instance->data_start) {
+        return false;
+    }
+
+    uint64_t lo_sample = 0;
+    uint64_t lo_offset = 0;
+    uint64_t hi_sample = instance->ctx.totalsamples;
+    uint64_t hi_offset = static_cast<uint64_t>(instance->data_end - instance->data_start);
+
+    int lo = 0;
+    int hi = instance->ctx.seekpoints - 1;
+    int found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (instance->seekpoints[mid].sample <= target_sample) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (found >= 0) {
+        lo_sample = instance->seekpoints[found].sample;
+        lo_offset = instance->seekpoints[found].offset;
+        if (found + 1 < instance->ctx.seekpoints) {
+            hi_sample = instance->seekpoints[found + 1].sample;
+            hi_offset = instance->seekpoints[found + 1].offset;
+        }
+    } else if (instance->ctx.seekpoints > 0) {
+        hi_sample = instance->seekpoints[0].sample;
+        hi_offset = instance->seekpoints[0].offset;
+    }
+
+    uint64_t offset = lo_offset;
+    if ((target_sample > lo_sample) && (hi_sample > lo_sample) && (hi_offset > lo_offset)) {
+        offset += (target_sample - lo_sample) * (hi_offset - lo_offset) / (hi_sample - lo_sample);
+        // 退回一个最大帧长，落在目标帧之前而不是之后
+        uint64_t back = instance->ctx.max_framesize ? static_cast<uint64_t>(instance->ctx.max_framesize) : 0;
+        offset = (offset - lo_offset > back) ? offset - back : lo_offset;
+    }
+
+    if (fseek(fp, static_cast<long>(instance->data_start + offset), SEEK_SET) != 0) {
+        return false;
+    }
+
+    instance->ctx.bitstream_index = 0;
+    instance->ctx.bitstream_size = 0;
+    instance->eof_reached = false;
+    instance->ctx.samplenumber = static_cast<unsigned long>(target_sample);
+
+    LOGI_1("seek sample %d -> offset %d (points %d)", static_cast<int>(target_sample),
+           static_cast<int>(offset), instance->ctx.seekpoints);
+    return true;
+}
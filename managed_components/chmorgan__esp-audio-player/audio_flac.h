@@ -18,20 +18,39 @@ extern "C" {
 extern "C" {
 #endif
 
+typedef struct {
+    uint32_t sample;        // First sample of the target frame
+    uint32_t offset;        // Byte offset of the target frame from data_start
+} flac_seekpoint;
+
 typedef struct {
     FLACContext ctx;        // Decoder state from components/flac
-    uint8_t *data_buf;      // Sliding read buffer for input frames
+    uint8_t *data_buf;      // Input ring, 2 * frame_span bytes; cursors are ctx.bitstream_index/size
     size_t data_buf_size;   // Allocated size for data_buf
-    size_t bytes_in_data_buf; // Bytes currently stored in data_buf
-    uint8_t *read_ptr;      // Read cursor within data_buf
+    size_t frame_span;      // Largest frame the ring must hold contiguously (max_framesize + slack)
+    bool data_internal;     // data_buf landed in internal RAM
     bool eof_reached;       // Set once fread() reaches EOF
     long data_start;        // Byte offset where audio frames begin
+    long data_end;          // File size, end of the last frame
+    flac_seekpoint *seekpoints; // Parsed SEEKTABLE, ctx.seekpoints entries
+    size_t seekpoints_cap;  // Allocated entries in seekpoints
+    uint32_t frames;        // Frames decoded since the file was opened
+    uint64_t decode_us;     // Time spent in flac_decode_frame16/24 for those frames
+    uint32_t last_us;       // Decode time of the last frame
+    uint32_t max_us;        // Slowest frame
+    uint64_t decode_cycles; // CPU cycles spent in flac_decode_frame16/24 for those frames
+    bool decoded_internal;  // decoded[] landed in internal RAM
+    uint32_t crc_frames;    // Frames checked against the CRC-16 footer
+    uint32_t crc_errors;    // Frames that failed the check and were muted
+    uint64_t crc_cycles;    // CPU cycles spent in flac_check_crc16
 } flac_instance;
 
 void flac_instance_init(flac_instance *instance);
 bool is_flac(FILE *fp, decode_data *output, flac_instance *instance);
 DECODE_STATUS decode_flac(FILE *fp, decode_data *pData, flac_instance *pInstance);
 void flac_instance_free(flac_instance *instance);
+uint32_t flac_duration_ms(const flac_instance *instance);
+bool flac_seek(FILE *fp, flac_instance *instance, uint64_t target_sample);
 
 #ifdef __cplusplus
 }
@@ -167,3 +167,133 @@ DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData,
 
     return DECODE_STATUS_CONTINUE;
 }
+
+static uint32_t read_be32(const uint8_t *buf) {
+    return (static_cast<uint32_t>(buf[0]) << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+void mp3_parse_info(FILE *fp, mp3_instance *pInstance) {
+    static const uint16_t bitrate_v1_l3[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0};
+    static const uint16_t bitrate_v2_l3[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0};
+    static const uint16_t rate_table[3] = {44100, 48000, 32000};
+
+    pInstance->audio_start = 0;
+    pInstance->file_size = 0;
+    pInstance->sample_rate = 0;
+    pInstance->samples_per_frame = 0;
+    pInstance->bitrate_kbps = 0;
+    pInstance->xing_frames = 0;
+    pInstance->has_toc = false;
+
+    fseek(fp, 0, SEEK_END);
+    pInstance->file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    mp3_id3_header_v2_t tag;
+    if ((sizeof(tag) == fread(&tag, 1, sizeof(tag), fp)) && (memcmp("ID3", tag.header, sizeof(tag.header)) == 0)) {
+        pInstance->audio_start = 10 + (((tag.size[0] & 0x7F) << 21) | ((tag.size[1] & 0x7F) << 14) |
+                                       ((tag.size[2] & 0x7F) << 7) | (tag.size[3] & 0x7F));
+    }
+
+    // the Xing header lives inside the first frame, the decode buffer is not
+    // in use yet so borrow it
+    fseek(fp, pInstance->audio_start, SEEK_SET);
+    uint8_t *buf = pInstance->data_buf;
+    size_t n = fread(buf, 1, MAINBUF_SIZE, fp);
+    fseek(fp, 0, SEEK_SET);
+
+    for (size_t i = 0; i + 4 < n; i++) {
+        if ((buf[i] != 0xFF) || ((buf[i + 1] & 0xE0) != 0xE0)) {
+            continue;
+        }
+        int ver = (buf[i + 1] >> 3) & 3;    // 3: MPEG1, 2: MPEG2, 0: MPEG2.5
+        int layer = (buf[i + 1] >> 1) & 3;  // 1: Layer III
+        int br_idx = buf[i + 2] >> 4;
+        int sr_idx = (buf[i + 2] >> 2) & 3;
+        if ((ver == 1) || (layer != 1) || (br_idx == 0) || (br_idx == 15) || (sr_idx == 3)) {
+            continue;
+        }
+        bool mono = (buf[i + 3] >> 6) == 3;
+        pInstance->audio_start += i;
+        pInstance->sample_rate = rate_table[sr_idx] >> ((ver == 3) ? 0 : ((ver == 2) ? 1 : 2));
+        pInstance->samples_per_frame = (ver == 3) ? 1152 : 576;
+        pInstance->bitrate_kbps = (ver == 3) ? bitrate_v1_l3[br_idx] : bitrate_v2_l3[br_idx];
+
+        // Xing/Info follows the side info
+        size_t side = (ver == 3) ? (mono ? 17 : 32) : (mono ? 9 : 17);
+        size_t x = i + 4 + side;
+        if ((x + 8 <= n) && ((memcmp(buf + x, "Xing", 4) == 0) || (memcmp(buf + x, "Info", 4) == 0))) {
+            uint32_t flags = read_be32(buf + x + 4);
+            size_t p = x + 8;
+            if ((flags & 0x1) && (p + 4 <= n)) {
+                pInstance->xing_frames = read_be32(buf + p);
+                p += 4;
+            }
+            if (flags & 0x2) {
+                p += 4; // byte count
+            }
+            if ((flags & 0x4) && (p + sizeof(pInstance->toc) <= n)) {
+                memcpy(pInstance->toc, buf + p, sizeof(pInstance->toc));
+                pInstance->has_toc = true;
+            }
+        }
+        break;
+    }
+
+    LOGI_1("mp3 info: start %ld, sr %d, kbps %d, frames %u, toc %d", pInstance->audio_start,
+           pInstance->sample_rate, pInstance->bitrate_kbps, (unsigned)pInstance->xing_frames, pInstance->has_toc);
+}
+
+uint32_t mp3_duration_ms(const mp3_instance *pInstance) {
+    if (pInstance->xing_frames && pInstance->sample_rate) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(pInstance->xing_frames) *
+                                     pInstance->samples_per_frame * 1000 / pInstance->sample_rate);
+    }
+    if (pInstance->bitrate_kbps && (pInstance->file_size > pInstance->audio_start)) {
+        return static_cast<uint32_t>(static_cast<uint64_t>(pInstance->file_size - pInstance->audio_start) *
+                                     8 / pInstance->bitrate_kbps);
+    }
+    return 0;
+}
+
+/**
+ * Jump to position_ms with a single fseek. With a Xing TOC the byte offset is
+ * interpolated between the two TOC entries around the target percentage,
+ * otherwise the file is treated as CBR. The decoder resyncs on the next frame
+ * header, the first frame after the jump may underflow the bit reservoir and
+ * is skipped by decode_mp3().
+ */
+bool mp3_seek(FILE *fp, mp3_instance *pInstance, uint32_t position_ms) {
+    uint32_t duration = mp3_duration_ms(pInstance);
+    if ((duration == 0) || (pInstance->file_size <= pInstance->audio_start)) {
+        return false;
+    }
+    if (position_ms >= duration) {
+        position_ms = duration - 1;
+    }
+
+    uint64_t audio_bytes = pInstance->file_size - pInstance->audio_start;
+    uint64_t offset;
+    if (pInstance->has_toc) {
+        // percentage in 1/1000 steps, TOC entries are 1/256 of the audio bytes
+        uint32_t permille = static_cast<uint32_t>(static_cast<uint64_t>(position_ms) * 1000 / duration);
+        uint32_t idx = permille / 10;
+        uint32_t fa = pInstance->toc[idx];
+        uint32_t fb = (idx < 99) ? pInstance->toc[idx + 1] : 256;
+        uint32_t fx = fa * 10 + (fb - fa) * (permille % 10);   // in 1/2560 steps
+        offset = audio_bytes * fx / 2560;
+    } else {
+        offset = static_cast<uint64_t>(position_ms) * pInstance->bitrate_kbps / 8;
+    }
+
+    if (fseek(fp, static_cast<long>(pInstance->audio_start + offset), SEEK_SET) != 0) {
+        return false;
+    }
+
+    pInstance->bytes_in_data_buf = 0;
+    pInstance->read_ptr = pInstance->data_buf;
+    pInstance->eof_reached = false;
+
+    LOGI_1("seek %u ms -> offset %u", (unsigned)position_ms, (unsigned)offset);
+    return true;
+}
@@ -42,7 +42,34 @@ typedef struct {
 
     // set to true if the end of file has been reached
     bool eof_reached;
+
+    // Seek information, filled by mp3_parse_info()
+
+    /** offset of the first frame, after any ID3v2 tag */
+    long audio_start;
+
+    /** file size in bytes */
+    long file_size;
+
+    /** sample rate and samples per frame of the first frame */
+    int sample_rate;
+    int samples_per_frame;
+
+    /** bitrate of the first frame in kbps, used for CBR estimates */
+    int bitrate_kbps;
+
+    /** frame count from the Xing/Info header, 0 if not present */
+    uint32_t xing_frames;
+
+    /** Xing TOC, valid if has_toc */
+    bool has_toc;
+    uint8_t toc[100];
 } mp3_instance;
 
 bool is_mp3(FILE *fp);
 DECODE_STATUS decode_mp3(HMP3Decoder mp3_decoder, FILE *fp, decode_data *pData, mp3_instance *pInstance);
+
+/** parse the first frame and Xing/Info header, leaves fp at the start of the file */
+void mp3_parse_info(FILE *fp, mp3_instance *pInstance);
+uint32_t mp3_duration_ms(const mp3_instance *pInstance);
+bool mp3_seek(FILE *fp, mp3_instance *pInstance, uint32_t position_ms);
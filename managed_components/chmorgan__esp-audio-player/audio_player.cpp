@@ -28,9 +28,15 @@
 
 #include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
 
 #include "sdkconfig.h"
 
@@ -50,6 +56,7 @@ typedef enum {
     AUDIO_PLAYER_REQUEST_RESUME,             /**< resumed paused playback */
     AUDIO_PLAYER_REQUEST_PLAY,               /**< initiate playing a new file */
     AUDIO_PLAYER_REQUEST_STOP,               /**< stop playback */
+    AUDIO_PLAYER_REQUEST_SEEK,               /**< seek within the present file */
     AUDIO_PLAYER_REQUEST_SHUTDOWN_THREAD,    /**< shutdown audio playback thread */
     AUDIO_PLAYER_REQUEST_MAX
 } audio_player_event_type_t;
@@ -59,6 +66,9 @@ typedef struct {
 
     // valid if type == AUDIO_PLAYER_EVENT_TYPE_PLAY
     FILE* fp;
+
+    // valid if type == AUDIO_PLAYER_REQUEST_SEEK
+    uint32_t position_ms;
 } audio_player_event_t;
 
 typedef enum {
@@ -74,24 +84,22 @@ typedef enum {
 #endif
 } FILE_TYPE;
 
-typedef struct audio_instance {
-    /**
-     * Set to true before task is created, false immediately before the
-     * task is deleted.
-     */
-    bool running;
+/**
+ * Decoder state for one file. The player normally decodes with a single lane,
+ * a crossfade decodes the incoming file on the second lane from another task
+ * and the lanes swap roles once the outgoing file has finished.
+ */
+typedef struct {
+    FILE *fp;
+    FILE_TYPE file_type;
 
     decode_data output;
 
-    QueueHandle_t event_queue;
+    /** output holds a decoded frame that was not written yet */
+    bool pending;
 
-    /* **************** AUDIO CALLBACK **************** */
-    //函数指针绑定
-    audio_player_cb_t s_audio_cb;
-    void *audio_cb_usrt_ctx;
-    audio_player_state_t state;
-
-    audio_player_config_t config;
+    /** duration of the file, 0 if unknown */
+    uint32_t duration_ms;
 
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
     wav_instance wav_data;
@@ -105,6 +113,61 @@ typedef struct audio_instance {
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
     flac_instance flac_data;
 #endif
+} decoder_lane_t;
+
+typedef struct audio_instance {
+    /**
+     * Set to true before task is created, false immediately before the
+     * task is deleted.
+     */
+    bool running;
+
+    /** lanes[lane] is the file being played */
+    decoder_lane_t lanes[2];
+    int lane;
+
+    QueueHandle_t event_queue;
+
+    /** next file for gapless playback, length 1 */
+    QueueHandle_t next_queue;
+
+    /** output format of the previous file, kept across gapless transitions */
+    format i2s_format;
+
+    /** playback position of the present file, updated by the audio task */
+    volatile uint32_t position_frames;
+    volatile uint32_t position_rate;
+    volatile uint32_t duration_ms;
+    volatile uint32_t last_seek_us;
+
+    /** decode timing of the present file, written by the audio task */
+    audio_player_decode_stats_t decode_stats;
+
+    /* **************** CROSSFADE **************** */
+    volatile uint32_t crossfade_ms;
+    TaskHandle_t fade_task;
+    SemaphoreHandle_t fade_idle;        /**< given by the fade task when a fade job ends */
+    StreamBufferHandle_t fade_stream;   /**< decoded PCM of the incoming file */
+    uint8_t *fade_stream_storage;
+    int16_t *fade_mix_buf;              /**< incoming PCM read back for mixing */
+    size_t fade_mix_buf_size;
+    bool fade_active;                   /**< a fade job was started and not collected yet */
+    volatile bool fade_abort;
+    volatile bool fade_format_ok;       /**< incoming file matches the outgoing format */
+    uint32_t fade_len;                  /**< fade length in frames */
+    uint32_t fade_pos;                  /**< frames mixed so far */
+    volatile uint32_t fade_decoded;     /**< frames the fade task put into fade_stream */
+
+    /* **************** DIRECT PCM **************** */
+    decode_data direct;                 /**< block buffer for wav files, samples is NULL when disabled */
+
+    /* **************** AUDIO CALLBACK **************** */
+    //函数指针绑定
+    audio_player_cb_t s_audio_cb;
+    void *audio_cb_usrt_ctx;
+    audio_player_state_t state;
+
+    audio_player_config_t config;
 } audio_instance_t;
 
 static audio_instance_t instance;
@@ -145,6 +208,10 @@ const char* event_to_string(audio_player_callback_event_t event) {
         return "AUDIO_PLAYER_CALLBACK_EVENT_SHUTDOWN";
     case AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE:
         return "AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE";
+    case AUDIO_PLAYER_CALLBACK_EVENT_PREFETCH_NEXT:
+        return "AUDIO_PLAYER_CALLBACK_EVENT_PREFETCH_NEXT";
+    case AUDIO_PLAYER_CALLBACK_EVENT_SEEK_DONE:
+        return "AUDIO_PLAYER_CALLBACK_EVENT_SEEK_DONE";
     case AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN:
         return "AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN";
     }
@@ -199,12 +266,26 @@ static void set_state(audio_instance_t *i, audio_player_state_t new_state) {
 
 static void audio_instance_init(audio_instance_t &i) {
     i.event_queue = NULL;
+    i.next_queue = NULL;
     i.s_audio_cb = NULL;
     i.audio_cb_usrt_ctx = NULL;
     i.state = AUDIO_PLAYER_STATE_IDLE;
+    i.lane = 0;
+    memset(i.lanes, 0, sizeof(i.lanes));
     #if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
-    flac_instance_init(&i.flac_data);
+    flac_instance_init(&i.lanes[0].flac_data);
+    flac_instance_init(&i.lanes[1].flac_data);
     #endif
+    i.crossfade_ms = 0;
+    i.fade_task = NULL;
+    i.fade_idle = NULL;
+    i.fade_stream = NULL;
+    i.fade_stream_storage = NULL;
+    i.fade_mix_buf = NULL;
+    i.fade_mix_buf_size = 0;
+    i.fade_active = false;
+    memset(&i.direct, 0, sizeof(i.direct));
+    memset(&i.decode_stats, 0, sizeof(i.decode_stats));
 }
 
 static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &adata)
@@ -248,54 +329,515 @@ static esp_err_t mono_to_stereo(uint32_t output_bits_per_sample, decode_data &ad
     return ESP_OK;
 }
 
-static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
+/* **************** DECODER LANES **************** */
+static esp_err_t lane_alloc(decoder_lane_t *l)
 {
-    LOGI_1("start to decode");
+    /** See https://github.com/ultraembedded/libhelix-mp3/blob/0a0e0673f82bc6804e5a3ddb15fb6efdcde747cd/testwrap/main.c#L74 */
+    l->output.samples_capacity = MAX_NCHAN * MAX_NGRAN * MAX_NSAMP;
+    l->output.samples_capacity_max = l->output.samples_capacity * 2;
+    l->output.samples = static_cast<uint8_t*>(malloc(l->output.samples_capacity_max));
+    LOGI_1("samples_capacity %d bytes", l->output.samples_capacity_max);
+    ESP_RETURN_ON_FALSE(NULL != l->output.samples, ESP_ERR_NO_MEM,
+        TAG, "Failed allocate output buffer");
 
-    format i2s_format;
-    memset(&i2s_format, 0, sizeof(i2s_format));
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+    l->mp3_data.data_buf_size = MAINBUF_SIZE * 3;
+    l->mp3_data.data_buf = static_cast<uint8_t*>(malloc(l->mp3_data.data_buf_size));
+    ESP_RETURN_ON_FALSE(NULL != l->mp3_data.data_buf, ESP_ERR_NO_MEM,
+        TAG, "Failed allocate mp3 data buffer");
 
-    esp_err_t ret = ESP_OK;
-    audio_player_event_t audio_event = { .type = AUDIO_PLAYER_REQUEST_NONE, .fp = NULL };
+    l->mp3_decoder = MP3InitDecoder();
+    ESP_RETURN_ON_FALSE(NULL != l->mp3_decoder, ESP_ERR_NO_MEM,
+        TAG, "Failed create MP3 decoder");
+#endif
+
+    return ESP_OK;
+}
+
+static void lane_free(decoder_lane_t *l)
+{
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+    if(l->mp3_decoder) MP3FreeDecoder(l->mp3_decoder);
+    if(l->mp3_data.data_buf) free(l->mp3_data.data_buf);
+    l->mp3_decoder = NULL;
+    l->mp3_data.data_buf = NULL;
+#endif
+    if(l->output.samples) free(l->output.samples);
+    l->output.samples = NULL;
+
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    flac_instance_free(&l->flac_data);
+#endif
+
+    if(l->fp) {
+        fclose(l->fp);
+        l->fp = NULL;
+    }
+}
+
+/**
+ * Detect the file type and prepare the lane for decoding fp
+ */
+static FILE_TYPE lane_open(decoder_lane_t *l, FILE *fp)
+{
+    l->fp = fp;
+    l->file_type = FILE_TYPE_UNKNOWN;
+    l->pending = false;
+    l->duration_ms = 0;
 
-    FILE_TYPE file_type = FILE_TYPE_UNKNOWN;
+    // flac goes first, is_mp3() accepts anything that starts with an ID3 tag
+    // and FLAC rips often carry one
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    if(l->file_type == FILE_TYPE_UNKNOWN)
+    {
+        if(is_flac(fp, &l->output, &l->flac_data)) {
+            l->file_type = FILE_TYPE_FLAC;
+            LOGI_1("file is flac");
+            l->duration_ms = flac_duration_ms(&l->flac_data);
+        }
+    }
+#endif
 
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-    if(is_mp3(fp)) {
-        file_type = FILE_TYPE_MP3;
+    if(l->file_type == FILE_TYPE_UNKNOWN && is_mp3(fp)) {
+        l->file_type = FILE_TYPE_MP3;
         LOGI_1("file is mp3");
 
+        mp3_parse_info(fp, &l->mp3_data);
+        l->duration_ms = mp3_duration_ms(&l->mp3_data);
+
         // initialize mp3_instance
-        i->mp3_data.bytes_in_data_buf = 0;
-        i->mp3_data.read_ptr = i->mp3_data.data_buf;
-        i->mp3_data.eof_reached = false;
+        l->mp3_data.bytes_in_data_buf = 0;
+        l->mp3_data.read_ptr = l->mp3_data.data_buf;
+        l->mp3_data.eof_reached = false;
     }
 #endif
 
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
     // This can be a pointless condition depending on the build options, no reason to warn about it
     // cppcheck-suppress knownConditionTrueFalse
-    if(file_type == FILE_TYPE_UNKNOWN)
+    if(l->file_type == FILE_TYPE_UNKNOWN)
     {
-        if(is_wav(fp, &i->wav_data)) {
-            file_type = FILE_TYPE_WAV;
+        if(is_wav(fp, &l->wav_data)) {
+            l->file_type = FILE_TYPE_WAV;
             LOGI_1("file is wav");
+            l->duration_ms = wav_duration_ms(&l->wav_data);
         }
     }
 #endif
 
+    return l->file_type;
+}
+
+static const char *file_type_name(FILE_TYPE type)
+{
+    switch(type) {
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+        case FILE_TYPE_MP3: return "mp3";
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+        case FILE_TYPE_WAV: return "wav";
+#endif
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
-    if(file_type == FILE_TYPE_UNKNOWN)
-    {
-        if(is_flac(fp, &i->output, &i->flac_data)) {
-            file_type = FILE_TYPE_FLAC;
-            LOGI_1("file is flac");
+        case FILE_TYPE_FLAC: return "flac";
+#endif
+        default: return NULL;
+    }
+}
+
+/**
+ * Decode the next frame into l->output, mono is converted to stereo as
+ * es8311 requires stereo input even though it is mono output
+ */
+static DECODE_STATUS lane_decode(decoder_lane_t *l)
+{
+    DECODE_STATUS decode_status = DECODE_STATUS_ERROR;
+
+    switch(l->file_type) {
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+        case FILE_TYPE_MP3:
+            decode_status = decode_mp3(l->mp3_decoder, l->fp, &l->output, &l->mp3_data);
+            break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+        case FILE_TYPE_WAV:
+            decode_status = decode_wav(l->fp, &l->output, &l->wav_data);
+            break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+        case FILE_TYPE_FLAC:
+            decode_status = decode_flac(l->fp, &l->output, &l->flac_data);
+            break;
+#endif
+        case FILE_TYPE_UNKNOWN:
+            ESP_LOGE(TAG, "unexpected unknown file type when decoding");
+            break;
+    }
+
+    if((decode_status == DECODE_STATUS_CONTINUE) && (l->output.fmt.channels == 1)) {
+        LOGI_3("c == 1, mono -> stereo");
+        if(mono_to_stereo(l->output.fmt.bits_per_sample, l->output) != ESP_OK) {
+            decode_status = DECODE_STATUS_ERROR;
+        }
+    }
+
+    return decode_status;
+}
+
+/**
+ * Reposition the decoder of the present file, each decoder jumps directly
+ * to the target without decoding the skipped audio
+ */
+static void aplay_seek(audio_instance_t *i, decoder_lane_t *l, uint32_t position_ms)
+{
+    int64_t start = esp_timer_get_time();
+    bool ok = false;
+    uint32_t rate = 0;
+
+    switch(l->file_type) {
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
+        case FILE_TYPE_MP3:
+            ok = mp3_seek(l->fp, &l->mp3_data, position_ms);
+            rate = l->mp3_data.sample_rate;
+            break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+        case FILE_TYPE_WAV:
+            ok = wav_seek(l->fp, &l->wav_data, position_ms);
+            rate = l->wav_data.header.SampleRate;
+            break;
+#endif
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+        case FILE_TYPE_FLAC:
+            ok = flac_seek(l->fp, &l->flac_data,
+                           static_cast<uint64_t>(position_ms) * l->flac_data.ctx.samplerate / 1000);
+            rate = l->flac_data.ctx.samplerate;
+            break;
+#endif
+        case FILE_TYPE_UNKNOWN:
+            break;
+    }
+
+    i->last_seek_us = static_cast<uint32_t>(esp_timer_get_time() - start);
+    if(!ok) {
+        ESP_LOGW(TAG, "seek to %u ms failed", (unsigned)position_ms);
+        return;
+    }
+
+    l->pending = false;
+    i->position_rate = rate;
+    i->position_frames = static_cast<uint32_t>(static_cast<uint64_t>(position_ms) * rate / 1000);
+    ESP_LOGI(TAG, "seek to %u ms took %u us", (unsigned)position_ms, (unsigned)i->last_seek_us);
+    dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_SEEK_DONE);
+}
+
+/* **************** CROSSFADE **************** */
+#define FADE_STREAM_SIZE    (32 * 1024)
+#define FADE_BLOCK_MS       20
+
+static void scalar_mix(int16_t *out, const int16_t *in, size_t frames, uint32_t fade_pos, uint32_t fade_len)
+{
+    for(size_t f = 0; f < frames; f++) {
+        uint32_t pos = fade_pos + f;
+        int32_t g = (pos >= fade_len) ? 32768 : static_cast<int32_t>((static_cast<uint64_t>(pos) << 15) / fade_len);
+        for(int c = 0; c < 2; c++) {
+            int32_t a = out[f * 2 + c];
+            int32_t b = in[f * 2 + c];
+            out[f * 2 + c] = static_cast<int16_t>((a * (32768 - g) + b * g) >> 15);
+        }
+    }
+}
+
+static bool fade_send(audio_instance_t *i, const uint8_t *data, size_t len)
+{
+    while(len && !i->fade_abort) {
+        size_t sent = xStreamBufferSend(i->fade_stream, data, len, pdMS_TO_TICKS(FADE_BLOCK_MS));
+        data += sent;
+        len -= sent;
+    }
+    return len == 0;
+}
+
+/**
+ * Decodes the head of the incoming file into fade_stream on the other core.
+ * Stops after fade_len frames, the decoder state stays in the lane so the
+ * audio task continues from there once the outgoing file has finished.
+ */
+static void fade_task(void *pvParam)
+{
+    audio_instance_t *i = static_cast<audio_instance_t*>(pvParam);
+
+    while(true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        decoder_lane_t *l = &i->lanes[i->lane ^ 1];
+
+        if(lane_open(l, l->fp) != FILE_TYPE_UNKNOWN) {
+            while(!i->fade_abort && (i->fade_decoded < i->fade_len)) {
+                DECODE_STATUS st = lane_decode(l);
+                if(st == DECODE_STATUS_NO_DATA_CONTINUE) {
+                    continue;
+                } else if(st != DECODE_STATUS_CONTINUE) {
+                    break;
+                }
+
+                if((l->output.fmt.bits_per_sample != 16) ||
+                   (l->output.fmt.channels != i->i2s_format.channels) ||
+                   (l->output.fmt.sample_rate != i->i2s_format.sample_rate)) {
+                    // can't mix, the audio task plays this frame after a gapless switch
+                    LOGI_1("crossfade format mismatch, falling back to gapless");
+                    i->fade_format_ok = false;
+                    l->pending = true;
+                    break;
+                }
+
+                if(!fade_send(i, l->output.samples, l->output.frame_count * 2 * sizeof(int16_t))) {
+                    break;
+                }
+                i->fade_decoded += l->output.frame_count;
+            }
+        }
+
+        xSemaphoreGive(i->fade_idle);
+    }
+}
+
+static esp_err_t fade_alloc(audio_instance_t *i)
+{
+    if(i->fade_task) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(lane_alloc(&i->lanes[i->lane ^ 1]), TAG, "crossfade lane");
+
+    i->fade_mix_buf_size = i->lanes[i->lane].output.samples_capacity_max;
+    i->fade_mix_buf = static_cast<int16_t*>(malloc(i->fade_mix_buf_size));
+    ESP_RETURN_ON_FALSE(NULL != i->fade_mix_buf, ESP_ERR_NO_MEM, TAG, "crossfade mix buffer");
+
+    // PCM waiting to be mixed, sits in PSRAM when available
+    i->fade_stream_storage = static_cast<uint8_t*>(heap_caps_malloc(FADE_STREAM_SIZE + 1, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if(!i->fade_stream_storage) {
+        i->fade_stream_storage = static_cast<uint8_t*>(malloc(FADE_STREAM_SIZE + 1));
+    }
+    ESP_RETURN_ON_FALSE(NULL != i->fade_stream_storage, ESP_ERR_NO_MEM, TAG, "crossfade stream");
+
+    static StaticStreamBuffer_t fade_stream_struct;
+    i->fade_stream = xStreamBufferCreateStatic(FADE_STREAM_SIZE, 1, i->fade_stream_storage, &fade_stream_struct);
+
+    i->fade_idle = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(NULL != i->fade_idle, ESP_ERR_NO_MEM, TAG, "crossfade semaphore");
+
+    BaseType_t task_val = xTaskCreatePinnedToCore(fade_task, "Audio Fade", 4 * 1024, i,
+                                                  i->config.priority, &i->fade_task, i->config.fade_core_id);
+    ESP_RETURN_ON_FALSE(pdPASS == task_val, ESP_ERR_NO_MEM, TAG, "Failed create fade task");
+
+    return ESP_OK;
+}
+
+static void fade_free(audio_instance_t *i)
+{
+    if(i->fade_task) {
+        vTaskDelete(i->fade_task);
+        i->fade_task = NULL;
+    }
+    if(i->fade_idle) {
+        vSemaphoreDelete(i->fade_idle);
+        i->fade_idle = NULL;
+    }
+    if(i->fade_stream) {
+        vStreamBufferDelete(i->fade_stream);
+        i->fade_stream = NULL;
+    }
+    if(i->fade_stream_storage) {
+        heap_caps_free(i->fade_stream_storage);
+        i->fade_stream_storage = NULL;
+    }
+    if(i->fade_mix_buf) {
+        free(i->fade_mix_buf);
+        i->fade_mix_buf = NULL;
+    }
+}
+
+/**
+ * Start decoding the incoming file if the present one is within crossfade_ms
+ * of its end and a next file is queued
+ */
+static void fade_maybe_start(audio_instance_t *i, decoder_lane_t *l)
+{
+    if(i->fade_active || !i->crossfade_ms || !i->fade_task || !l->duration_ms ||
+       (i->i2s_format.bits_per_sample != 16) || !i->position_rate) {
+        return;
+    }
+
+    uint32_t position_ms = static_cast<uint32_t>(static_cast<uint64_t>(i->position_frames) * 1000 / i->position_rate);
+    if(position_ms + i->crossfade_ms < l->duration_ms) {
+        return;
+    }
+
+    FILE *next_fp = NULL;
+    if(pdPASS != xQueueReceive(i->next_queue, &next_fp, 0)) {
+        return;
+    }
+
+    decoder_lane_t *next = &i->lanes[i->lane ^ 1];
+    next->fp = next_fp;
+    i->fade_len = static_cast<uint32_t>(static_cast<uint64_t>(l->duration_ms - position_ms) * i->position_rate / 1000);
+    if(i->fade_len == 0) {
+        i->fade_len = 1;
+    }
+    i->fade_pos = 0;
+    i->fade_decoded = 0;
+    i->fade_abort = false;
+    i->fade_format_ok = true;
+    xStreamBufferReset(i->fade_stream);
+    i->fade_active = true;
+    LOGI_1("crossfade start, %u frames", (unsigned)i->fade_len);
+    xTaskNotifyGive(i->fade_task);
+}
+
+/**
+ * Wait for the fade task to finish its job, the incoming lane is left as the
+ * fade task prepared it
+ */
+static void fade_collect(audio_instance_t *i)
+{
+    if(!i->fade_active) {
+        return;
+    }
+    xSemaphoreTake(i->fade_idle, portMAX_DELAY);
+    i->fade_active = false;
+}
+
+/**
+ * Abort a running fade. On a seek the incoming file goes back to next_queue
+ * so it still follows gaplessly, on stop or play it is closed.
+ */
+static void fade_cancel(audio_instance_t *i, bool requeue)
+{
+    if(!i->fade_active) {
+        return;
+    }
+    i->fade_abort = true;
+    fade_collect(i);
+    xStreamBufferReset(i->fade_stream);
+
+    decoder_lane_t *next = &i->lanes[i->lane ^ 1];
+    if(next->fp) {
+        // the lane is opened again from the start of the file, is_*() rewind it
+        if(!requeue || (pdPASS != xQueueSend(i->next_queue, &next->fp, 0))) {
+            fclose(next->fp);
+        }
+        next->fp = NULL;
+    }
+}
+
+/**
+ * Mix frames of the incoming file into the outgoing samples, waits briefly
+ * if the fade task is behind
+ */
+static void fade_mix(audio_instance_t *i, decoder_lane_t *l)
+{
+    size_t frames = l->output.frame_count;
+    size_t want = frames * 2 * sizeof(int16_t);
+    if((i->fade_pos >= i->fade_len) || !i->fade_format_ok) {
+        return;
+    }
+    if(want > i->fade_mix_buf_size) {
+        want = i->fade_mix_buf_size;
+    }
+
+    size_t got = 0;
+    uint8_t *dst = reinterpret_cast<uint8_t*>(i->fade_mix_buf);
+    while(got < want) {
+        size_t n = xStreamBufferReceive(i->fade_stream, dst + got, want - got, pdMS_TO_TICKS(FADE_BLOCK_MS));
+        if(n == 0) {
+            break;
         }
+        got += n;
+    }
+
+    size_t mix_frames = got / (2 * sizeof(int16_t));
+    if(mix_frames) {
+        audio_player_mix_fn mix = i->config.mix_fn ? i->config.mix_fn : scalar_mix;
+        mix(reinterpret_cast<int16_t*>(l->output.samples), i->fade_mix_buf, mix_frames, i->fade_pos, i->fade_len);
+        i->fade_pos += mix_frames;
     }
+}
+
+static esp_err_t aplay_write(audio_instance_t *i, const void *samples, size_t bytes_to_write, bool direct = false)
+{
+    /**
+     * Block until all data has been accepted into the i2s driver, however
+     * the i2s driver has been configured with a buffer to allow for the next round of
+     * audio decoding to occur while the previous set of samples is finishing playback, in order
+     * to ensure playback without interruption.
+     */
+    size_t i2s_bytes_written = 0;
+    audio_player_write_fn write_fn = direct ? i->config.direct_write_fn : i->config.write_fn;
+    esp_err_t ret = write_fn(const_cast<void*>(samples), bytes_to_write, &i2s_bytes_written, portMAX_DELAY);
+    if(bytes_to_write != i2s_bytes_written) {
+        ESP_LOGE(TAG, "to write %d != written %d", bytes_to_write, i2s_bytes_written);
+    }
+    return ret;
+}
+
+/**
+ * Outgoing file finished during a crossfade, play what the fade task decoded
+ * but was not mixed yet and switch to the incoming lane
+ */
+static void fade_handover(audio_instance_t *i)
+{
+    fade_collect(i);
+
+    size_t n;
+    uint8_t *buf = reinterpret_cast<uint8_t*>(i->fade_mix_buf);
+    while((n = xStreamBufferReceive(i->fade_stream, buf, i->fade_mix_buf_size, 0)) > 0) {
+        aplay_write(i, buf, n);
+    }
+
+    i->lane ^= 1;
+    i->position_frames = i->fade_decoded;
+    LOGI_1("crossfade handover, mixed %u of %u frames", (unsigned)i->fade_pos, (unsigned)i->fade_len);
+}
+
+static esp_err_t aplay_file(audio_instance_t *i, decoder_lane_t *l, bool *completed)
+{
+    LOGI_1("start to decode");
+
+    // i2s_format lives in the instance so that a gapless switch to a file with
+    // the same format doesn't reconfigure the clock
+    format &i2s_format = i->i2s_format;
+    FILE *fp = l->fp;
+
+    esp_err_t ret = ESP_OK;
+    *completed = false;
+
+    // position at which the next file is requested, 0 when prefetch is disabled
+    long prefetch_pos = 0;
+    if(i->config.prefetch_bytes) {
+        struct stat st;
+        if(fstat(fileno(fp), &st) == 0) {
+            prefetch_pos = (st.st_size > (off_t)i->config.prefetch_bytes) ?
+                           (long)(st.st_size - i->config.prefetch_bytes) : 1;
+        }
+    }
+
+    audio_player_event_t audio_event = { .type = AUDIO_PLAYER_REQUEST_NONE, .fp = NULL };
+
+    i->duration_ms = l->duration_ms;
+
+    // pcm files skip the decoder buffer and go to direct_write_fn in large blocks
+    bool direct = false;
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+    direct = (i->direct.samples != NULL) && (l->file_type == FILE_TYPE_WAV) &&
+             wav_direct_supported(&l->wav_data) && (fileno(fp) >= 0);
 #endif
+    decode_data *out = &l->output;
+
+    memset(&i->decode_stats, 0, sizeof(i->decode_stats));
+    i->decode_stats.codec = file_type_name(l->file_type);
 
     // cppcheck-suppress knownConditionTrueFalse
-    if(file_type == FILE_TYPE_UNKNOWN) {
+    if(l->file_type == FILE_TYPE_UNKNOWN) {
         ESP_LOGE(TAG, "unknown file type, cleaning up");
         dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE);
         goto clean_up;
@@ -316,7 +858,12 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
                 while(1) {
                     xQueuePeek(i->event_queue, &audio_event, portMAX_DELAY);
 
-                    if((AUDIO_PLAYER_REQUEST_PLAY != audio_event.type) &&
+                    if(AUDIO_PLAYER_REQUEST_SEEK == audio_event.type) {
+                        // seeking while paused repositions now and stays paused
+                        xQueueReceive(i->event_queue, &audio_event, 0);
+                        fade_cancel(i, true);
+                        aplay_seek(i, l, audio_event.position_ms);
+                    } else if((AUDIO_PLAYER_REQUEST_PLAY != audio_event.type) &&
                        (AUDIO_PLAYER_REQUEST_STOP != audio_event.type) &&
                        (AUDIO_PLAYER_REQUEST_RESUME != audio_event.type))
                     {
@@ -341,6 +888,11 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
                 (AUDIO_PLAYER_REQUEST_PLAY == audio_event.type)) {
                 ret = ESP_OK;
                 goto clean_up;
+            } else if (AUDIO_PLAYER_REQUEST_SEEK == audio_event.type) {
+                xQueueReceive(i->event_queue, &audio_event, 0);
+                fade_cancel(i, true); // seeking out of the fade window cancels the crossfade
+                aplay_seek(i, l, audio_event.position_ms);
+                continue;
             } else {
                 // receive to discard the event, this event has no
                 // impact on the state of playback
@@ -351,47 +903,52 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
 
         set_state(i, AUDIO_PLAYER_STATE_PLAYING);
 
-        DECODE_STATUS decode_status = DECODE_STATUS_ERROR;
-
-        switch(file_type) {
-#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-            case FILE_TYPE_MP3:
-                decode_status = decode_mp3(i->mp3_decoder, fp, &i->output, &i->mp3_data);
-                break;
-#endif
+        DECODE_STATUS decode_status;
+        out = &l->output;
+        int64_t decode_start = esp_timer_get_time();
+        if(l->pending) {
+            // frame decoded by the fade task that could not be mixed
+            l->pending = false;
+            decode_status = DECODE_STATUS_CONTINUE;
 #if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
-            case FILE_TYPE_WAV:
-                decode_status = decode_wav(fp, &i->output, &i->wav_data);
-                break;
-#endif
-#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
-            case FILE_TYPE_FLAC:
-                decode_status = decode_flac(fp, &i->output, &i->flac_data);
-                break;
+        } else if(direct && !i->fade_active) {
+            // crossfade mixes into l->output, so the tail of a fade uses the regular path
+            out = &i->direct;
+            decode_status = decode_wav_direct(fp, out, &l->wav_data);
 #endif
-            case FILE_TYPE_UNKNOWN:
-                ESP_LOGE(TAG, "unexpected unknown file type when decoding");
-                break;
+        } else {
+            decode_status = lane_decode(l);
         }
 
         // break out and exit if we aren't supposed to continue decoding
         if(decode_status == DECODE_STATUS_CONTINUE)
         {
-            // if mono, convert to stereo as es8311 requires stereo input
-            // even though it is mono output
-            if(i->output.fmt.channels ==  1) {
-                LOGI_3("c == 1, mono -> stereo");
-                ret = mono_to_stereo(i->output.fmt.bits_per_sample, i->output);
-                if(ret != ESP_OK) {
-                    goto clean_up;
-                }
+            uint32_t cost = static_cast<uint32_t>(esp_timer_get_time() - decode_start);
+            audio_player_decode_stats_t &st = i->decode_stats;
+            st.frames++;
+            st.pcm_frames += out->frame_count;
+            st.total_us += cost;
+            st.last_us = cost;
+            if(cost > st.max_us) {
+                st.max_us = cost;
+            }
+
+            i->position_rate = out->fmt.sample_rate;
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+            if(l->file_type == FILE_TYPE_FLAC) {
+                // the frame header carries the real sample number, exact after a seek
+                i->position_frames = l->flac_data.ctx.samplenumber + l->output.frame_count;
+            } else
+#endif
+            {
+                i->position_frames += out->frame_count;
             }
 
             /* Configure I2S clock if the output format changed */
-            if ((i2s_format.sample_rate != i->output.fmt.sample_rate) ||
-                    (i2s_format.channels != i->output.fmt.channels) ||
-                    (i2s_format.bits_per_sample != i->output.fmt.bits_per_sample)) {
-                i2s_format = i->output.fmt;
+            if ((i2s_format.sample_rate != out->fmt.sample_rate) ||
+                    (i2s_format.channels != out->fmt.channels) ||
+                    (i2s_format.bits_per_sample != out->fmt.bits_per_sample)) {
+                i2s_format = out->fmt;
                 LOGI_1("format change: sr=%d, bit=%d, ch=%d",
                         i2s_format.sample_rate,
                         i2s_format.bits_per_sample,
@@ -403,31 +960,40 @@ static esp_err_t aplay_file(audio_instance_t *i, FILE *fp)
                 ESP_GOTO_ON_ERROR(ret, clean_up, TAG, "i2s_set_clk");
             }
 
-            /**
-             * Block until all data has been accepted into the i2s driver, however
-             * the i2s driver has been configured with a buffer to allow for the next round of
-             * audio decoding to occur while the previous set of samples is finishing playback, in order
-             * to ensure playback without interruption.
-             */
-            size_t i2s_bytes_written = 0;
-            size_t bytes_to_write = i->output.frame_count * i->output.fmt.channels * (i2s_format.bits_per_sample / 8);
+            if(i->fade_active) {
+                fade_mix(i, l);
+            }
+
+            size_t bytes_to_write = out->frame_count * out->fmt.channels * (i2s_format.bits_per_sample / 8);
             LOGI_2("c %d, bps %d, bytes %d, frame_count %d",
-                i->output.fmt.channels,
+                out->fmt.channels,
                 i2s_format.bits_per_sample,
                 bytes_to_write,
-                i->output.frame_count);
+                out->frame_count);
 
-            i->config.write_fn(i->output.samples, bytes_to_write, &i2s_bytes_written, portMAX_DELAY);
-            if(bytes_to_write != i2s_bytes_written) {
-                ESP_LOGE(TAG, "to write %d != written %d", bytes_to_write, i2s_bytes_written);
-            }
+            aplay_write(i, out->samples, bytes_to_write, out == &i->direct);
         } else if(decode_status == DECODE_STATUS_NO_DATA_CONTINUE)
         {
             LOGI_2("no data");
         } else { // DECODE_STATUS_DONE || DECODE_STATUS_ERROR
             LOGI_1("breaking out of playback");
+            *completed = (decode_status == DECODE_STATUS_DONE);
             break;
         }
+
+        // ask for the next file once, while the tail of this one is still playing,
+        // early enough for the crossfade if one is configured
+        bool prefetch = prefetch_pos && (ftell(fp) >= prefetch_pos);
+        if(prefetch_pos && i->crossfade_ms && l->duration_ms && i->position_rate) {
+            uint64_t ms = static_cast<uint64_t>(i->position_frames) * 1000 / i->position_rate;
+            prefetch |= (ms + i->crossfade_ms + 2000 >= l->duration_ms);
+        }
+        if(prefetch) {
+            prefetch_pos = 0;
+            dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_PREFETCH_NEXT);
+        }
+
+        fade_maybe_start(i, l);
     } while (true);
 
 clean_up:
@@ -482,14 +1048,65 @@ static void audio_task(void *pvParam)
         }
 
         i->config.mute_fn(AUDIO_PLAYER_UNMUTE);
-        esp_err_t ret_val = aplay_file(i, audio_event.fp);
-        if(ret_val != ESP_OK)
-        {
-            ESP_LOGE(TAG, "aplay_file() %d", ret_val);
+        memset(&i->i2s_format, 0, sizeof(i->i2s_format));
+
+        decoder_lane_t *l = &i->lanes[i->lane];
+        i->position_frames = 0;
+        i->position_rate = 0;
+        lane_open(l, audio_event.fp);
+
+        while(l->fp) {
+            bool completed = false;
+            esp_err_t ret_val = aplay_file(i, l, &completed);
+            if(ret_val != ESP_OK)
+            {
+                ESP_LOGE(TAG, "aplay_file() %d", ret_val);
+            }
+            fclose(l->fp);
+            l->fp = NULL;
+
+            bool ended = completed && (ret_val == ESP_OK);
+
+            // crossfade: the fade task already opened and started the next file
+            if(i->fade_active) {
+                if(ended) {
+                    fade_handover(i);
+                    l = &i->lanes[i->lane];
+                    if(l->file_type == FILE_TYPE_UNKNOWN) {
+                        dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE);
+                        fclose(l->fp);
+                        l->fp = NULL;
+                    } else {
+                        dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT);
+                    }
+                } else {
+                    fade_cancel(i, false);
+                }
+                continue;
+            }
+
+            // gapless: continue with the queued file only if this one ran to the end,
+            // a stop or play request discards it
+            FILE *next_fp = NULL;
+            if(pdPASS == xQueueReceive(i->next_queue, &next_fp, 0)) {
+                if(ended) {
+                    LOGI_1("gapless switch to next file");
+                    dispatch_callback(i, AUDIO_PLAYER_CALLBACK_EVENT_COMPLETED_PLAYING_NEXT);
+                    i->position_frames = 0;
+                    lane_open(l, next_fp);
+                } else {
+                    fclose(next_fp);
+                }
+            }
         }
+
         i->config.mute_fn(AUDIO_PLAYER_MUTE);
 
-        if(audio_event.fp) fclose(audio_event.fp);
+        // stopped while paused, there will be no PLAYING -> IDLE transition
+        // below so report Pause -> Idle here
+        if(i->state == AUDIO_PLAYER_STATE_PAUSE) {
+            set_state(i, AUDIO_PLAYER_STATE_IDLE);
+        }
     }
 }
 
@@ -513,6 +1130,165 @@ esp_err_t audio_player_play(FILE *fp)
     return audio_send_event(&instance, event);
 }
 
+esp_err_t audio_player_queue_next(FILE *fp)
+{
+    LOGI_1("%s", __FUNCTION__);
+    ESP_RETURN_ON_FALSE(NULL != instance.next_queue, ESP_ERR_INVALID_STATE,
+        TAG, "Audio task not started yet");
+
+    BaseType_t ret_val = xQueueSend(instance.next_queue, &fp, 0);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_ERR_INVALID_STATE,
+        TAG, "A next file is already queued");
+
+    return ESP_OK;
+}
+
+esp_err_t audio_player_seek(uint32_t position_ms)
+{
+    LOGI_1("%s", __FUNCTION__);
+    audio_player_event_t event = { .type = AUDIO_PLAYER_REQUEST_SEEK, .fp = NULL, .position_ms = position_ms };
+    return audio_send_event(&instance, event);
+}
+
+esp_err_t audio_player_get_position(audio_player_position_t *pos)
+{
+    ESP_RETURN_ON_FALSE(NULL != pos, ESP_ERR_INVALID_ARG, TAG, "pos is NULL");
+
+    uint32_t rate = instance.position_rate;
+    pos->position_ms = rate ? static_cast<uint32_t>(static_cast<uint64_t>(instance.position_frames) * 1000 / rate) : 0;
+    pos->duration_ms = instance.duration_ms;
+    pos->last_seek_us = instance.last_seek_us;
+    return ESP_OK;
+}
+
+esp_err_t audio_player_get_decode_stats(audio_player_decode_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(NULL != stats, ESP_ERR_INVALID_ARG, TAG, "stats is NULL");
+
+    *stats = instance.decode_stats;
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
+    const decoder_lane_t *l = &instance.lanes[instance.lane];
+    if(l->file_type == FILE_TYPE_FLAC) {
+        stats->core_us = l->flac_data.decode_us;
+        stats->core_max_us = l->flac_data.max_us;
+        stats->core_cycles = l->flac_data.decode_cycles;
+        stats->crc_frames = l->flac_data.crc_frames;
+        stats->crc_errors = l->flac_data.crc_errors;
+        stats->crc_cycles = l->flac_data.crc_cycles;
+#if CONFIG_FLAC_DECODER_FAST_MEMORY
+        stats->core_fast_mem = l->flac_data.decoded_internal;
+#endif
+    }
+#endif
+    return ESP_OK;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *static_cast<const uint32_t*>(a);
+    uint32_t y = *static_cast<const uint32_t*>(b);
+    return (x > y) - (x < y);
+}
+
+esp_err_t audio_player_benchmark(FILE *fp, audio_player_bench_result_t *result)
+{
+    ESP_RETURN_ON_FALSE(NULL != fp, ESP_ERR_INVALID_ARG, TAG, "fp is NULL");
+    if(NULL == result) {
+        fclose(fp);
+        ESP_LOGE(TAG, "result is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(result, 0, sizeof(*result));
+
+    uint32_t *cycles = static_cast<uint32_t*>(heap_caps_malloc(AUDIO_PLAYER_BENCH_MAX_FRAMES * sizeof(uint32_t),
+                                                               MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if(!cycles) {
+        cycles = static_cast<uint32_t*>(malloc(AUDIO_PLAYER_BENCH_MAX_FRAMES * sizeof(uint32_t)));
+    }
+
+    // measured from here so the peak covers the decoder but not the bookkeeping above
+    size_t internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t internal_min = internal_free;
+    size_t psram_min = psram_free;
+
+    // the lane is far too big for a task stack, and must not touch the playing lanes
+    decoder_lane_t *l = static_cast<decoder_lane_t*>(calloc(1, sizeof(decoder_lane_t)));
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_FALSE(l && cycles, ESP_ERR_NO_MEM, cleanup, TAG, "no memory for benchmark");
+    ESP_GOTO_ON_ERROR(lane_alloc(l), cleanup, TAG, "lane_alloc failed");
+    {
+        FILE_TYPE type = lane_open(l, fp);
+        fp = NULL;  // owned by the lane now
+        ESP_GOTO_ON_FALSE(type != FILE_TYPE_UNKNOWN, ESP_ERR_NOT_SUPPORTED, cleanup, TAG, "unsupported file");
+        result->codec = file_type_name(type);
+
+        int64_t start_us = esp_timer_get_time();
+        uint32_t recorded = 0;
+        DECODE_STATUS status;
+        do {
+            uint32_t c0 = esp_cpu_get_cycle_count();
+            status = lane_decode(l);
+            uint32_t dc = esp_cpu_get_cycle_count() - c0;
+
+            if(status == DECODE_STATUS_CONTINUE && l->output.frame_count) {
+                result->frames++;
+                result->pcm_frames += l->output.frame_count;
+                result->total_cycles += dc;
+                result->sample_rate = l->output.fmt.sample_rate;
+                if(recorded < AUDIO_PLAYER_BENCH_MAX_FRAMES) {
+                    cycles[recorded++] = dc;
+                }
+            }
+
+            // outside the timed window, heap_caps walks the heap list
+            size_t f = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+            if(f < internal_min) internal_min = f;
+            f = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+            if(f < psram_min) psram_min = f;
+        } while(status == DECODE_STATUS_CONTINUE || status == DECODE_STATUS_NO_DATA_CONTINUE);
+        result->wall_us = esp_timer_get_time() - start_us;
+        ESP_GOTO_ON_FALSE(status == DECODE_STATUS_DONE, ESP_FAIL, cleanup, TAG, "decode error after %lu frames",
+                          (unsigned long)result->frames);
+
+        uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+        if(recorded) {
+            qsort(cycles, recorded, sizeof(uint32_t), cmp_u32);
+            result->p50_us = cycles[recorded / 2] / mhz;
+            result->p99_us = cycles[(recorded * 99) / 100] / mhz;
+            result->max_us = cycles[recorded - 1] / mhz;
+        }
+        if(result->total_cycles && result->sample_rate) {
+            double audio_s = static_cast<double>(result->pcm_frames) / result->sample_rate;
+            double decode_s = static_cast<double>(result->total_cycles) / (mhz * 1e6);
+            result->realtime = static_cast<float>(audio_s / decode_s);
+        }
+    }
+
+cleanup:
+    result->heap_internal_peak = internal_free - internal_min;
+    result->heap_psram_peak = psram_free - psram_min;
+    if(l) {
+        lane_free(l);   // closes the lane's file
+        free(l);
+    }
+    if(fp) {
+        fclose(fp);
+    }
+    free(cycles);
+    return ret;
+}
+
+esp_err_t audio_player_set_crossfade(uint32_t crossfade_ms)
+{
+    if(crossfade_ms) {
+        // the second decoder is only allocated once crossfade is used
+        ESP_RETURN_ON_ERROR(fade_alloc(&instance), TAG, "crossfade");
+    }
+    instance.crossfade_ms = crossfade_ms;
+    return ESP_OK;
+}
+
 esp_err_t audio_player_pause(void)
 {
     LOGI_1("%s", __FUNCTION__);
@@ -547,15 +1323,22 @@ static esp_err_t _internal_audio_player_shutdown_thread(void)
 
 static void cleanup_memory(audio_instance_t &i)
 {
-#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-    if(i.mp3_decoder) MP3FreeDecoder(i.mp3_decoder);
-    if(i.mp3_data.data_buf) free(i.mp3_data.data_buf);
-#endif
-    if(i.output.samples) free(i.output.samples);
+    fade_free(&i);
+    lane_free(&i.lanes[0]);
+    lane_free(&i.lanes[1]);
+    if(i.direct.samples) {
+        heap_caps_free(i.direct.samples);
+        i.direct.samples = NULL;
+    }
 
-    #if defined(CONFIG_AUDIO_PLAYER_ENABLE_FLAC)
-    flac_instance_free(&i.flac_data);
-    #endif
+    if(i.next_queue) {
+        FILE *next_fp = NULL;
+        while(pdPASS == xQueueReceive(i.next_queue, &next_fp, 0)) {
+            fclose(next_fp);
+        }
+        vQueueDelete(i.next_queue);
+        i.next_queue = NULL;
+    }
 
     vQueueDelete(i.event_queue);
 }
@@ -572,26 +1355,31 @@ esp_err_t audio_player_new(audio_player_config_t config)
     instance.event_queue = xQueueCreate(4, sizeof(audio_player_event_t));
     ESP_RETURN_ON_FALSE(NULL != instance.event_queue, -1, TAG, "xQueueCreate");
 
-    /** See https://github.com/ultraembedded/libhelix-mp3/blob/0a0e0673f82bc6804e5a3ddb15fb6efdcde747cd/testwrap/main.c#L74 */
-    instance.output.samples_capacity = MAX_NCHAN * MAX_NGRAN * MAX_NSAMP;
-    instance.output.samples_capacity_max = instance.output.samples_capacity * 2;
-    instance.output.samples = static_cast<uint8_t*>(malloc(instance.output.samples_capacity_max));
-    LOGI_1("samples_capacity %d bytes", instance.output.samples_capacity_max);
-    int ret = ESP_OK;
-    ESP_GOTO_ON_FALSE(NULL != instance.output.samples, ESP_ERR_NO_MEM, cleanup,
-        TAG, "Failed allocate output buffer");
+    instance.next_queue = xQueueCreate(1, sizeof(FILE *));
+    ESP_RETURN_ON_FALSE(NULL != instance.next_queue, -1, TAG, "xQueueCreate");
 
-#if defined(CONFIG_AUDIO_PLAYER_ENABLE_MP3)
-    instance.mp3_data.data_buf_size = MAINBUF_SIZE * 3;
-    instance.mp3_data.data_buf = static_cast<uint8_t*>(malloc(instance.mp3_data.data_buf_size));
-    ESP_GOTO_ON_FALSE(NULL != instance.mp3_data.data_buf, ESP_ERR_NO_MEM, cleanup,
-        TAG, "Failed allocate mp3 data buffer");
+    int ret = lane_alloc(&instance.lanes[0]);
+    ESP_GOTO_ON_ERROR(ret, cleanup, TAG, "Failed allocate decoder");
 
-    instance.mp3_decoder = MP3InitDecoder();
-    ESP_GOTO_ON_FALSE(NULL != instance.mp3_decoder, ESP_ERR_NO_MEM, cleanup,
-        TAG, "Failed create MP3 decoder");
+#if defined(CONFIG_AUDIO_PLAYER_ENABLE_WAV)
+    if(config.direct_write_fn) {
+        // internal, DMA capable and word aligned so the SD driver reads sectors straight into it
+        size_t size = config.direct_buf_bytes ? config.direct_buf_bytes : 32 * 1024;
+        instance.direct.samples = static_cast<uint8_t*>(heap_caps_aligned_alloc(4, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL));
+        if(instance.direct.samples) {
+            instance.direct.samples_capacity = size;
+            instance.direct.samples_capacity_max = size;
+        } else {
+            ESP_LOGW(TAG, "no memory for %d byte pcm block buffer, wav files use the decoder path", size);
+        }
+    }
 #endif
 
+    if(config.crossfade_ms) {
+        ret = audio_player_set_crossfade(config.crossfade_ms);
+        ESP_GOTO_ON_ERROR(ret, cleanup, TAG, "Failed allocate crossfade");
+    }
+
     instance.running = true;
     task_val = xTaskCreatePinnedToCore(
         (TaskFunction_t)        audio_task,
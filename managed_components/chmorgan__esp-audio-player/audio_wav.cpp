@@ -1,5 +1,6 @@
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 #include "audio_wav.h"
 
 static const char *TAG = "wav";
@@ -35,6 +36,8 @@ bool is_wav(FILE *fp, wav_instance *pInstance) {
 
         if(memcmp(subchunk.SubchunkID, "data", 4) == 0)
         {
+            pInstance->data_start = ftell(fp);
+            pInstance->data_size = subchunk.SubchunkSize;
             break;
         } else {
             // advance beyond this subchunk, it could be a 'LIST' chunk with file info or some other unhandled subchunk
@@ -79,3 +82,148 @@ DECODE_STATUS decode_wav(FILE *fp, decode_data *pData, wav_instance *pInstance)
 
     return (bytes_read == 0) ? DECODE_STATUS_DONE : DECODE_STATUS_CONTINUE;
 }
+
+/**
+ * 16/24/32 bit integer PCM with one or two channels can be read by decode_wav_direct()
+ */
+bool wav_direct_supported(const wav_instance *pInstance) {
+    int bits = pInstance->header.BitsPerSample;
+    int ch = pInstance->header.NumChannels;
+    return (pInstance->header.AudioFormat == 1) &&
+           (bits == 16 || bits == 24 || bits == 32) &&
+           (ch == 1 || ch == 2);
+}
+
+/**
+ * Read a large block of PCM straight into pData->samples, which should be a
+ * DMA capable, word aligned buffer of samples_capacity bytes.
+ *
+ * The read bypasses the stdio buffer so FATFS can transfer whole sectors into
+ * the buffer without bouncing them through the FILE buffer, and the output is
+ * converted in place to what the i2s driver takes without a second buffer:
+ * - mono is duplicated to stereo
+ * - packed 24 bit is widened to left justified 32 bit, reported as 32 bits per sample
+ *
+ * Reads stop at the end of the 'data' subchunk so trailing chunks aren't played.
+ */
+DECODE_STATUS decode_wav_direct(FILE *fp, decode_data *pData, wav_instance *pInstance) {
+    size_t in_bps = pInstance->header.BitsPerSample / BITS_PER_BYTE;
+    size_t out_bps = (in_bps == 3) ? 4 : in_bps;
+    size_t ch = pInstance->header.NumChannels;
+    size_t in_frame = in_bps * ch;
+    size_t out_frame = out_bps * 2;
+
+    long pos = ftell(fp);
+    if(pos < 0) {
+        return DECODE_STATUS_ERROR;
+    }
+
+    long data_end = pInstance->data_start + static_cast<long>(pInstance->data_size);
+    if(pos >= data_end) {
+        pData->frame_count = 0;
+        return DECODE_STATUS_DONE;
+    }
+
+    size_t frames = pData->samples_capacity / out_frame;
+    size_t remain = (data_end - pos) / in_frame;
+    if(frames > remain) {
+        frames = remain;
+    } else {
+        // end the read on a sector boundary so the following reads are sector aligned,
+        // only the first read after open or seek gets shortened
+        size_t f = frames;
+        while(f && ((pos + static_cast<long>(f * in_frame)) % WAV_DIRECT_SECTOR) != 0 && (frames - f) < WAV_DIRECT_SECTOR) {
+            f--;
+        }
+        if(f && ((pos + static_cast<long>(f * in_frame)) % WAV_DIRECT_SECTOR) == 0) {
+            frames = f;
+        }
+    }
+    if(frames == 0) {
+        pData->frame_count = 0;
+        return DECODE_STATUS_DONE;
+    }
+
+    // ftell() accounted for what the FILE buffer had read ahead, position the
+    // descriptor there, read and then resync the FILE so ftell/fseek stay valid
+    int fd = fileno(fp);
+    ssize_t got = -1;
+    if(lseek(fd, pos, SEEK_SET) == pos) {
+        got = read(fd, pData->samples, frames * in_frame);
+    }
+    if(got <= 0) {
+        pData->frame_count = 0;
+        return (got == 0) ? DECODE_STATUS_DONE : DECODE_STATUS_ERROR;
+    }
+    fseek(fp, pos + got, SEEK_SET);
+
+    frames = static_cast<size_t>(got) / in_frame;
+    size_t samples_in = frames * ch;
+
+    // widen back to front so the conversion can be done in place
+    if(in_bps == 3) {
+        const uint8_t *in = pData->samples + samples_in * 3;
+        int32_t *out = reinterpret_cast<int32_t*>(pData->samples) + samples_in * (ch == 1 ? 2 : 1);
+        for(size_t s = samples_in; s; s--) {
+            in -= 3;
+            int32_t v = static_cast<int32_t>((static_cast<uint32_t>(in[0]) << 8) |
+                                             (static_cast<uint32_t>(in[1]) << 16) |
+                                             (static_cast<uint32_t>(in[2]) << 24));
+            *--out = v;
+            if(ch == 1) {
+                *--out = v;
+            }
+        }
+    } else if(ch == 1 && in_bps == 2) {
+        const int16_t *in = reinterpret_cast<int16_t*>(pData->samples) + samples_in;
+        int16_t *out = reinterpret_cast<int16_t*>(pData->samples) + samples_in * 2;
+        for(size_t s = samples_in; s; s--) {
+            int16_t v = *--in;
+            *--out = v;
+            *--out = v;
+        }
+    } else if(ch == 1) {
+        const int32_t *in = reinterpret_cast<int32_t*>(pData->samples) + samples_in;
+        int32_t *out = reinterpret_cast<int32_t*>(pData->samples) + samples_in * 2;
+        for(size_t s = samples_in; s; s--) {
+            int32_t v = *--in;
+            *--out = v;
+            *--out = v;
+        }
+    }
+
+    pData->fmt.channels = 2;
+    pData->fmt.bits_per_sample = out_bps * BITS_PER_BYTE;
+    pData->fmt.sample_rate = pInstance->header.SampleRate;
+    pData->frame_count = frames;
+
+    LOGI_2("direct read %d bytes at %ld, frame_count %d", static_cast<int>(got), pos, frames);
+
+    return DECODE_STATUS_CONTINUE;
+}
+
+uint32_t wav_duration_ms(const wav_instance *pInstance) {
+    if(pInstance->header.ByteRate <= 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>(static_cast<uint64_t>(pInstance->data_size) * 1000 / pInstance->header.ByteRate);
+}
+
+/**
+ * PCM is seekable to the exact frame, align the offset to a whole frame
+ */
+bool wav_seek(FILE *fp, wav_instance *pInstance, uint32_t position_ms) {
+    size_t bytes_per_frame = (pInstance->header.BitsPerSample / BITS_PER_BYTE) * pInstance->header.NumChannels;
+    if(bytes_per_frame == 0) {
+        return false;
+    }
+
+    uint64_t frame = static_cast<uint64_t>(position_ms) * pInstance->header.SampleRate / 1000;
+    uint64_t offset = frame * bytes_per_frame;
+    if(offset > pInstance->data_size) {
+        offset = pInstance->data_size - (pInstance->data_size % bytes_per_frame);
+    }
+
+    LOGI_1("seek %u ms -> offset %u", (unsigned)position_ms, (unsigned)offset);
+    return fseek(fp, static_cast<long>(pInstance->data_start + offset), SEEK_SET) == 0;
+}
@@ -28,7 +28,21 @@ typedef struct {
 
 typedef struct {
     wav_header_t header;
+
+    /** offset and size of the 'data' subchunk payload */
+    long data_start;
+    uint32_t data_size;
 } wav_instance;
 
+/**
+ * Size of the read unit used by decode_wav_direct(), reads end on a multiple
+ * of this so that FATFS transfers whole sectors straight into the caller's buffer
+ */
+#define WAV_DIRECT_SECTOR   512
+
 bool is_wav(FILE *fp, wav_instance *pInstance);
 DECODE_STATUS decode_wav(FILE *fp, decode_data *pData, wav_instance *pInstance);
+bool wav_direct_supported(const wav_instance *pInstance);
+DECODE_STATUS decode_wav_direct(FILE *fp, decode_data *pData, wav_instance *pInstance);
+uint32_t wav_duration_ms(const wav_instance *pInstance);
+bool wav_seek(FILE *fp, wav_instance *pInstance, uint32_t position_ms);
@@ -78,6 +78,8 @@ typedef enum {
     AUDIO_PLAYER_CALLBACK_EVENT_PAUSE, /**< Player is pausing */
     AUDIO_PLAYER_CALLBACK_EVENT_SHUTDOWN, /**< Player is shutting down */
     AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN_FILE_TYPE, /**< File type is unknown */
+    AUDIO_PLAYER_CALLBACK_EVENT_PREFETCH_NEXT, /**< Near the end of the file, audio_player_queue_next() may be called */
+    AUDIO_PLAYER_CALLBACK_EVENT_SEEK_DONE, /**< A seek completed, audio written before this event belongs to the old position */
     AUDIO_PLAYER_CALLBACK_EVENT_UNKNOWN /**< Unknown event */
 } audio_player_callback_event_t;
 
@@ -104,6 +106,132 @@ typedef void (*audio_player_cb_t)(audio_player_cb_ctx_t *);
  */
 esp_err_t audio_player_play(FILE *fp);
 
+/**
+ * @brief Queue the file to play right after the current one (gapless).
+ *
+ * Usually called in response to AUDIO_PLAYER_CALLBACK_EVENT_PREFETCH_NEXT.
+ * When the current file finishes naturally the player switches to fp without
+ * going through IDLE and without muting, cb(COMPLETED_PLAYING_NEXT) is sent.
+ * If playback is stopped or another file is played the queued fp is discarded.
+ *
+ * @param fp - If ESP_OK is returned, will be fclose()ed by the audio system.
+ *             If not ESP_OK returned then should be fclose()d by the caller.
+ * @return
+ *    - ESP_OK: Success in queuing the next file
+ *    - ESP_ERR_INVALID_STATE: A next file is already queued
+ */
+esp_err_t audio_player_queue_next(FILE *fp);
+
+/**
+ * @brief Seek within the file that is playing or paused
+ *
+ * FLAC uses the SEEKTABLE (interpolated between seek points), MP3 uses the
+ * Xing/Info TOC or a CBR estimate, WAV is sample exact. The decoder jumps
+ * directly to the target without decoding from the start.
+ * cb(SEEK_DONE) is sent from the audio task once the decoder is repositioned.
+ *
+ * @param position_ms - target position from the start of the file
+ * @return
+ *    - ESP_OK: Success in queuing seek request
+ *    - Others: Fail
+ */
+esp_err_t audio_player_seek(uint32_t position_ms);
+
+typedef struct {
+    uint32_t position_ms;   /*< position of the last decoded frame */
+    uint32_t duration_ms;   /*< duration of the file, 0 if unknown */
+    uint32_t last_seek_us;  /*< time taken by the last seek */
+} audio_player_position_t;
+
+/**
+ * @brief Get the playback position and duration of the present file
+ *
+ * @param pos - filled with the present position
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: pos is NULL
+ */
+esp_err_t audio_player_get_position(audio_player_position_t *pos);
+
+typedef struct {
+    const char *codec;      /*< "mp3", "wav" or "flac", NULL before the first file */
+    uint32_t frames;        /*< decoder calls that produced pcm in the present file */
+    uint64_t pcm_frames;    /*< pcm frames those calls produced */
+    uint64_t total_us;      /*< time spent in the decoder, including file reads */
+    uint32_t last_us;       /*< time of the last decoder call */
+    uint32_t max_us;        /*< slowest decoder call */
+    uint64_t core_us;       /*< flac only: time inside the frame decoder, without reads and sync search */
+    uint32_t core_max_us;   /*< flac only: slowest frame inside the frame decoder */
+    uint64_t core_cycles;   /*< flac only: CPU cycles inside the frame decoder, core_cycles / frames = cycles per frame */
+    bool core_fast_mem;     /*< flac only: decode loops in IRAM and decode buffers in internal RAM */
+    uint32_t crc_frames;    /*< flac only: frames checked against their CRC-16 */
+    uint32_t crc_errors;    /*< flac only: frames that failed the check and were muted */
+    uint64_t crc_cycles;    /*< flac only: CPU cycles spent on the CRC check, compare with core_cycles */
+} audio_player_decode_stats_t;
+
+/**
+ * @brief Get the decode timing of the present file
+ *
+ * Counters restart when a new file starts playing. total_us / pcm_frames
+ * gives the per sample cost that can be compared across decoders.
+ *
+ * @param stats - filled with the present counters
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: stats is NULL
+ */
+esp_err_t audio_player_get_decode_stats(audio_player_decode_stats_t *stats);
+
+#define AUDIO_PLAYER_BENCH_MAX_FRAMES  16384   /*< decoder calls kept for the percentiles, later calls only count in the totals */
+
+typedef struct {
+    const char *codec;          /*< "mp3", "wav" or "flac" */
+    uint32_t frames;            /*< decoder calls that produced pcm */
+    uint64_t pcm_frames;        /*< pcm frames produced */
+    uint32_t sample_rate;
+    uint64_t total_cycles;      /*< CPU cycles inside the decoder, file reads included */
+    uint32_t p50_us;            /*< median decoder call */
+    uint32_t p99_us;
+    uint32_t max_us;
+    float realtime;             /*< audio duration / decode time, below 1 cannot play in real time */
+    int64_t wall_us;            /*< whole run including heap sampling */
+    size_t heap_internal_peak;  /*< peak internal heap taken during the run, decoder state included */
+    size_t heap_psram_peak;     /*< same for PSRAM */
+} audio_player_bench_result_t;
+
+/**
+ * @brief Decode a whole file as fast as possible and discard the output
+ *
+ * Runs in the calling task with a decoder of its own, so it does not disturb
+ * the player, although both compete for the CPU while a file is playing.
+ * The cycle counter is per core, the calling task should be pinned.
+ *
+ * @param fp - file to decode, closed when the benchmark returns
+ * @param result - filled with the measurements, also on a decode error
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: fp or result is NULL
+ *    - ESP_ERR_NO_MEM: Failed to allocate the decoder
+ *    - ESP_ERR_NOT_SUPPORTED: Not a file type any enabled decoder handles
+ *    - ESP_FAIL: The decoder reported an error
+ */
+esp_err_t audio_player_benchmark(FILE *fp, audio_player_bench_result_t *result);
+
+/**
+ * @brief Set the crossfade length used for files queued with audio_player_queue_next()
+ *
+ * The incoming file is decoded by a second decoder on config.fade_core_id
+ * during the last crossfade_ms of the present file and mixed in with
+ * config.mix_fn. Files with a different output format, or non 16 bit output,
+ * fall back to a gapless switch. Takes effect from the next transition.
+ *
+ * @param crossfade_ms - crossfade length, 0 for gapless transitions
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Failed to allocate the second decoder
+ */
+esp_err_t audio_player_set_crossfade(uint32_t crossfade_ms);
+
 /**
  * @brief Pause playback
  *
@@ -153,12 +281,25 @@ typedef esp_err_t (*audio_player_mute_fn)(AUDIO_PLAYER_MUTE_SETTING setting);
 typedef esp_err_t (*audio_reconfig_std_clock)(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
 typedef esp_err_t (*audio_player_write_fn)(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
 
+/**
+ * Crossfade mixer, out = out * (1 - g) + in * g where g ramps from
+ * fade_pos / fade_len to (fade_pos + frames) / fade_len.
+ * Both buffers are interleaved 16 bit stereo, the result is written to out.
+ */
+typedef void (*audio_player_mix_fn)(int16_t *out, const int16_t *in, size_t frames, uint32_t fade_pos, uint32_t fade_len);
+
 typedef struct {
     audio_player_mute_fn mute_fn;
     audio_reconfig_std_clock clk_set_fn;
     audio_player_write_fn write_fn;
     UBaseType_t priority; /*< FreeRTOS task priority */
+    size_t prefetch_bytes; /*< send cb(PREFETCH_NEXT) this many bytes before EOF, 0 disables */
     BaseType_t coreID; /*< ESP32 core ID */
+    uint32_t crossfade_ms; /*< crossfade between a file and the queued next file, 0 disables */
+    BaseType_t fade_core_id; /*< core of the task decoding the incoming file during a crossfade */
+    audio_player_mix_fn mix_fn; /*< crossfade mixer, NULL uses a scalar mixer */
+    audio_player_write_fn direct_write_fn; /*< wav PCM is read in large blocks and written here without decoding, NULL disables */
+    size_t direct_buf_bytes; /*< size of the DMA capable block buffer for direct_write_fn, 0 uses 32 KB */
 } audio_player_config_t;
 
 /**
@@ -417,6 +417,15 @@ static __inline Word64 SAR64(Word64 x, int n)
 #elif defined(__xtensa__)
 
 #include "xtensa/config/core-isa.h"
+#include "sdkconfig.h"
+
+/* CONFIG_HELIX_MP3_XTENSA_KERNELS: mulsh和abs只是算数 不写volatile 编译器才能把它们和取数穿插着排
+ * 也能把重复的乘法合并 结果和volatile的一样 */
+#if CONFIG_HELIX_MP3_XTENSA_KERNELS
+#define HELIX_ASM	__asm__
+#else
+#define HELIX_ASM	__asm__ volatile
+#endif
 
 typedef long long Word64;
 
@@ -440,7 +449,7 @@ static __inline int MULSHIFT32(int x, int y)
      *   require an extra "mov r0, r1")
      */
     int ret;
-    asm volatile ("mulsh %0, %1, %2" : "=r" (ret) : "r" (x), "r" (y));
+    HELIX_ASM ("mulsh %0, %1, %2" : "=r" (ret) : "r" (x), "r" (y));
     return ret;
 }
 
@@ -455,7 +464,7 @@ static __inline int MULSHIFT32(int x, int y)
 static __inline int FASTABS(int x)
 {
     int ret;
-    asm volatile ("abs %0, %1" : "=r" (ret) : "r" (x));
+    HELIX_ASM ("abs %0, %1" : "=r" (ret) : "r" (x));
     return ret;
 }
 
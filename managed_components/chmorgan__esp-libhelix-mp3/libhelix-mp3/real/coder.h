@@ -46,6 +46,20 @@
 
 #include "mp3common.h"
 
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#endif
+
+/* CONFIG_HELIX_MP3_FAST_MEMORY: 合成滤波 IMDCT DCT32放IRAM 它们查的系数表放内部DRAM */
+#if CONFIG_HELIX_MP3_FAST_MEMORY
+#define HELIX_ICODE		IRAM_ATTR
+#define HELIX_ICONST	DRAM_ATTR
+#else
+#define HELIX_ICODE
+#define HELIX_ICONST
+#endif
+
 #if defined(ASSERT)
 #undef ASSERT
 #endif
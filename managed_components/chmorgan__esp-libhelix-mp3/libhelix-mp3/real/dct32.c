@@ -141,7 +141,7 @@ static const int dcttab[48] = {
  *                enough registers)
  **************************************************************************************/
 // about 1ms faster in RAM
-void FDCT32(int *buf, int *dest, int offset, int oddBlock, int gb)
+void HELIX_ICODE FDCT32(int *buf, int *dest, int offset, int oddBlock, int gb)
 {
     int i, s, tmp, es;
     const int *cptr = dcttab;
@@ -70,7 +70,7 @@
  *                 gain from AntiAlias < 2.0)
  **************************************************************************************/
 // a little bit faster in RAM (< 1 ms per block)
-static void AntiAlias(int *x, int nBfly)
+static void HELIX_ICODE AntiAlias(int *x, int nBfly)
 {
 	int k, a0, b0, c0, c1;
 	const int *c;
@@ -130,7 +130,7 @@ static void AntiAlias(int *x, int nBfly)
  *              all blocks gain at least 1 guard bit via window (long blocks get extra
  *                sign bit, short blocks can have one addition but max gain < 1.0)
  **************************************************************************************/
-static void WinPrevious(int *xPrev, int *xPrevWin, int btPrev)
+static void HELIX_ICODE WinPrevious(int *xPrev, int *xPrevWin, int btPrev)
 {
 	int i, x, *xp, *xpwLo, *xpwHi, wLo, wHi;
 	const int *wpLo, *wpHi;
@@ -183,7 +183,7 @@ static void WinPrevious(int *xPrev, int *xPrevWin, int btPrev)
  *
  * Return:      updated mOut (from new outputs y)
  **************************************************************************************/
-static int FreqInvertRescale(int *y, int *xPrev, int blockIdx, int es)
+static int HELIX_ICODE FreqInvertRescale(int *y, int *xPrev, int blockIdx, int es)
 {
 	int i, d, mOut;
 	int y0, y1, y2, y3, y4, y5, y6, y7, y8;
@@ -254,12 +254,12 @@ static const int c9_4 = 0x7e0e2e32;
 /* format = Q31
  * cos(((0:8) + 0.5) * (pi/18)) 
  */
-static const int c18[9] = {
+static const int c18[9] HELIX_ICONST = {
 	0x7f834ed0, 0x7ba3751d, 0x7401e4c1, 0x68d9f964, 0x5a82799a, 0x496af3e2, 0x36185aee, 0x2120fb83, 0x0b27eb5c, 
 };
 
 /* require at least 3 guard bits in x[] to ensure no overflow */
-static __inline void idct9(int *x)
+static __inline void HELIX_ICODE idct9(int *x)
 {
 	int a1, a2, a3, a4, a5, a6, a7, a8, a9;
 	int a10, a11, a12, a13, a14, a15, a16, a17, a18;
@@ -368,7 +368,7 @@ int fastWin36[18] = {
  *                inline asm may or may not be helpful)
  **************************************************************************************/
 // barely faster in RAM
-static int IMDCT36(int *xCurr, int *xPrev, int *y, int btCurr, int btPrev, int blockIdx, int gb)
+static int HELIX_ICODE IMDCT36(int *xCurr, int *xPrev, int *y, int btCurr, int btPrev, int blockIdx, int gb)
 {
 	int i, es, xBuf[18], xPrevWin[18];
 	int acc1, acc2, s, d, t, mOut;
@@ -471,7 +471,7 @@ static int c6[3] = { 0x7ba3751d, 0x5a82799a, 0x2120fb83 };	/* format = Q31, cos(
 /* 12-point inverse DCT, used in IMDCT12x3() 
  * 4 input guard bits will ensure no overflow
  */
-static __inline void imdct12 (int *x, int *out)
+static __inline void HELIX_ICODE imdct12 (int *x, int *out)
 {
 	int a0, a1, a2;
 	int x0, x1, x2, x3, x4, x5;
@@ -537,7 +537,7 @@ static __inline void imdct12 (int *x, int *out)
  * TODO:        optimize for ARM
  **************************************************************************************/
  // barely faster in RAM
-static int IMDCT12x3(int *xCurr, int *xPrev, int *y, int btPrev, int blockIdx, int gb)
+static int HELIX_ICODE IMDCT12x3(int *xCurr, int *xPrev, int *y, int btPrev, int blockIdx, int gb)
 {
 	int i, es, mOut, yLo, xBuf[18], xPrevWin[18];	/* need temp buffer for reordering short blocks */
 	const int *wp;
@@ -619,7 +619,7 @@ static int IMDCT12x3(int *xCurr, int *xPrev, int *y, int btPrev, int blockIdx, i
  *
  * TODO:        examine mixedBlock/winSwitch logic carefully (test he_mode.bit)
  **************************************************************************************/
-static int HybridTransform(int *xCurr, int *xPrev, int y[BLOCK_SIZE][NBANDS], SideInfoSub *sis, BlockCount *bc)
+static int HELIX_ICODE HybridTransform(int *xCurr, int *xPrev, int y[BLOCK_SIZE][NBANDS], SideInfoSub *sis, BlockCount *bc)
 {
 	int xPrevWin[18], currWinIdx, prevWinIdx;
 	int i, j, nBlocksOut, nonZero, mOut;
@@ -719,7 +719,7 @@ static int HybridTransform(int *xCurr, int *xPrev, int y[BLOCK_SIZE][NBANDS], Si
  * Return:      0 on success,  -1 if null input pointers
  **************************************************************************************/
  // a bit faster in RAM
-int IMDCT(MP3DecInfo *mp3DecInfo, int gr, int ch)
+int HELIX_ICODE IMDCT(MP3DecInfo *mp3DecInfo, int gr, int ch)
 {
 	int nBfly, blockCutoff;
 	FrameHeader *fh;
@@ -0,0 +1,139 @@
+/* ***** BEGIN LICENSE BLOCK ***** 
+ * Version: RCSL 1.0/RPSL 1.0 
+ *  
+ * Portions Copyright (c) 1995-2002 RealNetworks, Inc. All Rights Reserved. 
+ *      
+ * The contents of this file, and the files included with this file, are 
+ * subject to the current version of the RealNetworks Public Source License 
+ * Version 1.0 (the "RPSL") available at 
+ * http://www.helixcommunity.org/content/rpsl unless you have licensed 
+ * the file under the RealNetworks Community Source License Version 1.0 
+ * (the "RCSL") available at http://www.helixcommunity.org/content/rcsl, 
+ * in which case the RCSL will apply. You may also obtain the license terms 
+ * directly from RealNetworks.  You may not use this file except in 
+ * compliance with the RPSL or, if you have a valid RCSL with RealNetworks 
+ * applicable to this file, the RCSL.  Please see the applicable RPSL or 
+ * RCSL for the rights, obligations and limitations governing use of the 
+ * contents of the file.  
+ *  
+ * This file is part of the Helix DNA Technology. RealNetworks is the 
+ * developer of the Original Code and owns the copyrights in the portions 
+ * it created. 
+ *  
+ * This file, and the files included with this file, is distributed and made 
+ * available on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER 
+ * EXPRESS OR IMPLIED, AND REALNETWORKS HEREBY DISCLAIMS ALL SUCH WARRANTIES, 
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY, FITNESS 
+ * FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT. 
+ * 
+ * Technology Compatibility Kit Test Suite(s) Location: 
+ *    http://www.helixcommunity.org/content/tck 
+ * 
+ * Contributor(s): 
+ *  
+ * ***** END LICENSE BLOCK ***** */ 
+
+
+/**************************************************************************************
+ * Fixed-point MP3 decoder
+ * Jon Recker (jrecker@real.com), Ken Cooke (kenc@real.com)
+ * June 2003
+ *
+ * xtensa/polyphase.c - polyphase synthesis filter for Xtensa LX6/LX7 (ESP32, ESP32-S3)
+ *
+ * 和../polyphase.c算的是同一组64位乘加 输出逐位相同 只是换了顺序
+ * 参考版立体声一次算左右两个声道的4个64位累加器 加上系数和指针要20多个寄存器
+ * 窗口调用只看得到16个 循环里一直在压栈出栈 这里一次只滤一个声道 2个累加器放得下
+ * 系数多读一遍 放在内部DRAM里只是1个周期一次 截成16位用CLAMPS
+ * PIE只有16位乘法 32x32的乘加用不上 MULSHIFT32见assembly.h
+ **************************************************************************************/
+
+#include "coder.h"
+#include "assembly.h"
+
+/* 和../polyphase.c一样 */
+#define DEF_NFRACBITS	(DQ_FRACBITS_OUT - 2 - 2 - 15)
+#define CSHIFT	12
+
+static __inline short ClipToShort(int x, int fracBits)
+{
+	x >>= fracBits;
+#if XCHAL_HAVE_CLAMPS
+	/* 截到[-32768, 32767] */
+	asm ("clamps %0, %0, 15" : "+r" (x));
+#else
+	int sign = x >> 31;
+	if (sign != (x >> 15))
+		x = sign ^ ((1 << 15) - 1);
+#endif
+	return (short)x;
+}
+
+/**************************************************************************************
+ * Function:    PolyphaseChannel
+ *
+ * Description: filter one subband and produce 32 output PCM samples for one channel
+ *
+ * Inputs:      pointer to PCM output buffer, first sample of this channel
+ *              pointer to start of vbuf for this channel (vbuf + 32 for the right channel)
+ *              start of filter coefficient table (in proper, shuffled order)
+ *              distance between two output samples (1 = mono, 2 = interleaved stereo)
+ *
+ * Outputs:     32 samples of one channel of decoded PCM data, (i.e. Q16.0)
+ **************************************************************************************/
+static void HELIX_ICODE PolyphaseChannel(short *pcm, const int *vbuf, const int *coefBase, int step)
+{
+	int i, j, vLo, vHi, c1, c2;
+	const int *coef, *vb1;
+	Word64 sum1, sum2;
+	const Word64 rndVal = (Word64)( 1 << (DEF_NFRACBITS - 1 + (32 - CSHIFT)) );
+
+	/* special case, output sample 0 */
+	coef = coefBase;
+	sum1 = rndVal;
+#pragma GCC unroll 8
+	for (j = 0; j < 8; j++) {
+		c1 = coef[2*j];		c2 = coef[2*j+1];
+		sum1 = MADD64(sum1, vbuf[j], c1);
+		sum1 = MADD64(sum1, vbuf[23-j], -c2);
+	}
+	pcm[0] = ClipToShort((int)SAR64(sum1, (32-CSHIFT)), DEF_NFRACBITS);
+
+	/* special case, output sample 16 */
+	coef = coefBase + 256;
+	vb1 = vbuf + 64*16;
+	sum1 = rndVal;
+#pragma GCC unroll 8
+	for (j = 0; j < 8; j++)
+		sum1 = MADD64(sum1, vb1[j], coef[j]);
+	pcm[16*step] = ClipToShort((int)SAR64(sum1, (32-CSHIFT)), DEF_NFRACBITS);
+
+	/* main convolution loop: sum1 = samples 1, 2, 3, ... 15   sum2 = samples 31, 30, ... 17 */
+	coef = coefBase + 16;
+	vb1 = vbuf + 64;
+	for (i = 1; i < 16; i++) {
+		sum1 = sum2 = rndVal;
+#pragma GCC unroll 8
+		for (j = 0; j < 8; j++) {
+			c1 = *coef++;		c2 = *coef++;
+			vLo = vb1[j];		vHi = vb1[23-j];
+			sum1 = MADD64(sum1, vLo,  c1);	sum2 = MADD64(sum2, vLo,  c2);
+			sum1 = MADD64(sum1, vHi, -c2);	sum2 = MADD64(sum2, vHi,  c1);
+		}
+		vb1 += 64;
+		pcm[i*step]      = ClipToShort((int)SAR64(sum1, (32-CSHIFT)), DEF_NFRACBITS);
+		pcm[(32-i)*step] = ClipToShort((int)SAR64(sum2, (32-CSHIFT)), DEF_NFRACBITS);
+	}
+}
+
+void HELIX_ICODE PolyphaseMono(short *pcm, int *vbuf, const int *coefBase)
+{
+	PolyphaseChannel(pcm, vbuf, coefBase, 1);
+}
+
+/* interleaves PCM samples LRLRLR... */
+void HELIX_ICODE PolyphaseStereo(short *pcm, int *vbuf, const int *coefBase)
+{
+	PolyphaseChannel(pcm, vbuf, coefBase, 2);
+	PolyphaseChannel(pcm + 1, vbuf + 32, coefBase, 2);
+}
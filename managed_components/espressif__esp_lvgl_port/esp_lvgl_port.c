@@ -73,6 +73,9 @@ typedef struct {
 typedef struct lvgl_port_ctx_s {
     SemaphoreHandle_t   lvgl_mux;
     esp_timer_handle_t  tick_timer;
+    TaskHandle_t        task;
+    int64_t             tick_us;    /* Time already passed on to lv_tick_inc */
+    uint32_t            wakeups;
     bool                running;
     int                 task_max_sleep_ms;
 #ifdef ESP_LVGL_PORT_USB_HOST_HID_COMPONENT
@@ -125,7 +128,6 @@ typedef struct {
 * Local variables
 *******************************************************************************/
 static lvgl_port_ctx_t lvgl_port_ctx;
-static int lvgl_port_timer_period_ms = 5;
 
 /*******************************************************************************
 * Function definitions
@@ -177,7 +179,6 @@ esp_err_t lvgl_port_init(const lvgl_port_cfg_t *cfg)
     /* LVGL init */
     lv_init();
     /* Tick init */
-    lvgl_port_timer_period_ms = cfg->timer_period_ms;
     ESP_RETURN_ON_ERROR(lvgl_port_tick_init(), TAG, "");
     /* Create task */
     lvgl_port_ctx.task_max_sleep_ms = cfg->task_max_sleep_ms;
@@ -189,9 +190,9 @@ esp_err_t lvgl_port_init(const lvgl_port_cfg_t *cfg)
 
     BaseType_t res;
     if (cfg->task_affinity < 0) {
-        res = xTaskCreate(lvgl_port_task, "LVGL task", cfg->task_stack, NULL, cfg->task_priority, NULL);
+        res = xTaskCreate(lvgl_port_task, "LVGL task", cfg->task_stack, NULL, cfg->task_priority, &lvgl_port_ctx.task);
     } else {
-        res = xTaskCreatePinnedToCore(lvgl_port_task, "LVGL task", cfg->task_stack, NULL, cfg->task_priority, NULL, cfg->task_affinity);
+        res = xTaskCreatePinnedToCore(lvgl_port_task, "LVGL task", cfg->task_stack, NULL, cfg->task_priority, &lvgl_port_ctx.task, cfg->task_affinity);
     }
     ESP_GOTO_ON_FALSE(res == pdPASS, ESP_FAIL, err, TAG, "Create LVGL task fail!");
 
@@ -207,9 +208,10 @@ esp_err_t lvgl_port_resume(void)
 {
     esp_err_t ret = ESP_ERR_INVALID_STATE;
 
-    if (lvgl_port_ctx.tick_timer != NULL) {
+    if (lvgl_port_ctx.lvgl_mux != NULL) {
         lv_timer_enable(true);
-        ret = esp_timer_start_periodic(lvgl_port_ctx.tick_timer, lvgl_port_timer_period_ms * 1000);
+        lvgl_port_task_wake();
+        ret = ESP_OK;
     }
 
     return ret;
@@ -219,9 +221,9 @@ esp_err_t lvgl_port_stop(void)
 {
     esp_err_t ret = ESP_ERR_INVALID_STATE;
 
-    if (lvgl_port_ctx.tick_timer != NULL) {
+    if (lvgl_port_ctx.lvgl_mux != NULL) {
         lv_timer_enable(false);
-        ret = esp_timer_stop(lvgl_port_ctx.tick_timer);
+        ret = ESP_OK;
     }
 
     return ret;
@@ -653,18 +655,52 @@ esp_err_t lvgl_port_remove_usb_hid_input(lv_indev_t *hid)
 }
 #endif
 
+/* Bring the LVGL tick up to date. Called with the LVGL mutex held, so
+ * everything that can read lv_tick_get() sees the current time without a
+ * periodic tick timer waking the chip. */
+static void lvgl_port_tick_update(void)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t ms = (now - lvgl_port_ctx.tick_us) / 1000;
+    if (ms) {
+        lv_tick_inc(ms);
+        lvgl_port_ctx.tick_us += (int64_t)ms * 1000;
+    }
+}
+
 bool lvgl_port_lock(uint32_t timeout_ms)
 {
     assert(lvgl_port_ctx.lvgl_mux && "lvgl_port_init must be called first");
 
     const TickType_t timeout_ticks = (timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
-    return xSemaphoreTakeRecursive(lvgl_port_ctx.lvgl_mux, timeout_ticks) == pdTRUE;
+    if (xSemaphoreTakeRecursive(lvgl_port_ctx.lvgl_mux, timeout_ticks) != pdTRUE) {
+        return false;
+    }
+    lvgl_port_tick_update();
+    return true;
 }
 
 void lvgl_port_unlock(void)
 {
     assert(lvgl_port_ctx.lvgl_mux && "lvgl_port_init must be called first");
     xSemaphoreGiveRecursive(lvgl_port_ctx.lvgl_mux);
+    /* Another task may have invalidated something; let the LVGL task run its
+     * timers now instead of at the end of its sleep. */
+    if (lvgl_port_ctx.task && xTaskGetCurrentTaskHandle() != lvgl_port_ctx.task) {
+        xTaskNotifyGive(lvgl_port_ctx.task);
+    }
+}
+
+void lvgl_port_task_wake(void)
+{
+    if (lvgl_port_ctx.task) {
+        xTaskNotifyGive(lvgl_port_ctx.task);
+    }
+}
+
+uint32_t lvgl_port_task_wakeups(void)
+{
+    return lvgl_port_ctx.wakeups;
 }
 
 void lvgl_port_flush_ready(lv_disp_t *disp)
@@ -696,7 +732,9 @@ static void lvgl_port_task(void *arg)
         } else if (task_delay_ms < 1) {
             task_delay_ms = 1;
         }
-        vTaskDelay(pdMS_TO_TICKS(task_delay_ms));
+        /* Sleep until the next LVGL timer is due or someone wakes us */
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(task_delay_ms));
+        lvgl_port_ctx.wakeups++;
     }
 
     lvgl_port_task_deinit();
@@ -1257,19 +1295,10 @@ static void lvgl_port_usb_hid_callback(hid_host_device_handle_t hid_device_handl
 }
 #endif
 
-static void lvgl_port_tick_increment(void *arg)
-{
-    /* Tell LVGL how many milliseconds have elapsed */
-    lv_tick_inc(lvgl_port_timer_period_ms);
-}
-
 static esp_err_t lvgl_port_tick_init(void)
 {
-    // Tick interface for LVGL (using esp_timer to generate 2ms periodic event)
-    const esp_timer_create_args_t lvgl_tick_timer_args = {
-        .callback = &lvgl_port_tick_increment,
-        .name = "LVGL tick",
-    };
-    ESP_RETURN_ON_ERROR(esp_timer_create(&lvgl_tick_timer_args, &lvgl_port_ctx.tick_timer), TAG, "Creating LVGL timer filed!");
-    return esp_timer_start_periodic(lvgl_port_ctx.tick_timer, lvgl_port_timer_period_ms * 1000);
+    /* No periodic tick timer: the tick is advanced from esp_timer_get_time()
+     * whenever the LVGL mutex is taken, see lvgl_port_tick_update() */
+    lvgl_port_ctx.tick_us = esp_timer_get_time();
+    return ESP_OK;
 }
@@ -48,7 +48,7 @@ typedef struct {
     int task_stack;         /*!< LVGL task stack size */
     int task_affinity;      /*!< LVGL task pinned to core (-1 is no affinity) */
     int task_max_sleep_ms;  /*!< Maximum sleep in LVGL task */
-    int timer_period_ms;    /*!< LVGL timer tick period in ms */
+    int timer_period_ms;    /*!< Unused: the LVGL tick follows esp_timer_get_time() */
 } lvgl_port_cfg_t;
 
 /**
@@ -330,6 +330,20 @@ esp_err_t lvgl_port_stop(void);
  */
 esp_err_t lvgl_port_resume(void);
 
+/**
+ * @brief Wake the LVGL task so it runs its timers now
+ *
+ * The task sleeps until the next LVGL timer is due. Producers that need
+ * LVGL to act sooner (e.g. after queueing UI work) call this; it is not
+ * needed after lvgl_port_lock()/lvgl_port_unlock(), which wakes the task.
+ */
+void lvgl_port_task_wake(void);
+
+/**
+ * @brief Number of times the LVGL task has woken up since start
+ */
+uint32_t lvgl_port_task_wakeups(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+# 把LVGL图片转换器出的.c打包成assets分区 只用标准库 构建时由main/CMakeLists.txt调用
+#
+# 用法: asset_pack.py main/assets/img_*.c ... -o assets.bin [--swap 1] [--raw]
+#   每个.c里取LV_COLOR_DEPTH 16、LV_COLOR_16_SWAP和--swap一样的那份像素 名字用lv_img_dsc_t的变量名
+#   带透明的图拆成RGB565A8(先全部颜色再全部透明度) 再按字节RLE压缩 程序第一次用时解开放进PSRAM
+#   压缩了不比原来小的图(或者--raw)原样放 程序直接指着映射的flash 格式见main/asset_part.h
+#   最后打印每张图和总共多少字节 压缩了多少
+#
+# 文件 全部小端:
+#   文件头 16字节
+#     u32 magic "AST1", u16 version, u16 count, u32 data_bytes(文件头之后), u32 crc(文件头之后全部的CRC32)
+#   索引 count条 每条36字节 按名字排好:
+#     char name[20](补0), u32 offset(相对分区开头), u32 size(分区里的字节数), u32 raw_size(解开以后),
+#     u32 lv_img_header_t(cf:5 always_zero:3 reserved:2 w:11 h:11) cf是解开以后的格式
+#   数据 每张从ALIGN的整数倍开始 size和raw_size一样就是没压缩
+#   RLE: 一个控制字节c 最高位1: 后面一个字节重复(c&0x7f)+1次 最高位0: 后面跟c+1个原样的字节
+import argparse
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = 0x31545341  # "AST1"
+VERSION = 2
+HEADER = struct.Struct('<IHHII')
+ENTRY = struct.Struct('<20sIIII')
+NAME_MAX = 19
+ALIGN = 16
+
+CF = {
+    'LV_IMG_CF_TRUE_COLOR': 4,
+    'LV_IMG_CF_TRUE_COLOR_ALPHA': 5,
+    'LV_IMG_CF_TRUE_COLOR_CHROMA_KEYED': 6,
+}
+PX_BYTES = {4: 2, 5: 3, 6: 2}
+CF_RGB565A8 = 20  # LVGL 8.3的LV_IMG_CF_RGB565A8
+RUN_MAX = 128
+RUN_MIN = 3  # 至少这么多个相同的字节才编成重复
+
+
+def parse_image(path, swap):
+    src = open(path, encoding='utf-8').read()
+    m = re.search(r'const\s+lv_img_dsc_t\s+(\w+)\s*=\s*\{(.*?)\};', src, re.S)
+    if not m:
+        sys.exit('%s: no lv_img_dsc_t' % path)
+    name, body = m.group(1), m.group(2)
+    cf_name = re.search(r'\.header\.cf\s*=\s*(\w+)', body).group(1)
+    if cf_name not in CF:
+        sys.exit('%s: %s is not supported' % (path, cf_name))
+    cf = CF[cf_name]
+    w = int(re.search(r'\.header\.w\s*=\s*(\d+)', body).group(1))
+    h = int(re.search(r'\.header\.h\s*=\s*(\d+)', body).group(1))
+
+    cond = r'#if LV_COLOR_DEPTH == 16 && LV_COLOR_16_SWAP %s 0' % ('!=' if swap else '==')
+    b0 = src.find(cond)
+    if b0 < 0:
+        sys.exit('%s: no 16 bit pixels with swap=%d' % (path, swap))
+    b1 = src.index('#endif', b0)
+    block = src[src.index('\n', b0):b1]
+    block = re.sub(r'/\*.*?\*/', '', block, flags=re.S)
+    data = bytes(int(x, 16) for x in re.findall(r'0x([0-9a-fA-F]{2})', block))
+    if len(data) != w * h * PX_BYTES[cf]:
+        sys.exit('%s: %d bytes of pixels, expected %d' % (path, len(data), w * h * PX_BYTES[cf]))
+    if len(name) > NAME_MAX:
+        sys.exit('%s: name %s is longer than %d' % (path, name, NAME_MAX))
+    return name, cf, w, h, data
+
+
+def to_rgb565a8(data, n):
+    # 每个像素3字节 前两个是颜色(已经是LVGL字节序) 后一个是透明度
+    color = bytearray(2 * n)
+    color[0::2] = data[0::3]
+    color[1::2] = data[1::3]
+    return bytes(color) + data[2::3]
+
+
+def rle_encode(data):
+    out = bytearray()
+    lit = bytearray()
+    i, n = 0, len(data)
+    while i < n:
+        j = i
+        while j < n and j - i < RUN_MAX and data[j] == data[i]:
+            j += 1
+        if j - i >= RUN_MIN:
+            while lit:
+                out.append(len(lit[:RUN_MAX]) - 1)
+                out += lit[:RUN_MAX]
+                del lit[:RUN_MAX]
+            out += bytes((0x80 | (j - i - 1), data[i]))
+            i = j
+        else:
+            lit.append(data[i])
+            i += 1
+    while lit:
+        out.append(len(lit[:RUN_MAX]) - 1)
+        out += lit[:RUN_MAX]
+        del lit[:RUN_MAX]
+    return bytes(out)
+
+
+def rle_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        c = data[i]
+        if c & 0x80:
+            out += bytes((data[i + 1],)) * ((c & 0x7f) + 1)
+            i += 2
+        else:
+            out += data[i + 1:i + 2 + c]
+            i += 2 + c
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='pack LVGL image C files into a flash file for the assets partition')
+    ap.add_argument('images', nargs='+', help='LVGL image converter output')
+    ap.add_argument('--swap', type=int, default=1, help='LV_COLOR_16_SWAP of the firmware')
+    ap.add_argument('--raw', action='store_true', help='store every image as it is')
+    ap.add_argument('-o', '--output', required=True)
+    args = ap.parse_args()
+
+    images = sorted((parse_image(p, args.swap) for p in args.images), key=lambda i: i[0])
+    names = [i[0] for i in images]
+    if len(set(names)) != len(names):
+        sys.exit('duplicate image names')
+
+    pos = HEADER.size + ENTRY.size * len(images)
+    index = b''
+    pixels = b''
+    raw_total = packed_total = 0
+    for name, cf, w, h, data in images:
+        raw = data
+        if cf == CF['LV_IMG_CF_TRUE_COLOR_ALPHA'] and not args.raw:
+            planar = to_rgb565a8(data, w * h)
+            packed = rle_encode(planar)
+            assert rle_decode(packed) == planar
+            if len(packed) < len(planar):
+                cf, raw, data = CF_RGB565A8, planar, packed
+        pad = -pos % ALIGN
+        pixels += b'\0' * pad
+        pos += pad
+        index += ENTRY.pack(name.encode(), pos, len(data), len(raw), cf | (w << 10) | (h << 21))
+        pixels += data
+        pos += len(data)
+        raw_total += len(raw)
+        packed_total += len(data)
+        print('%-20s %3dx%-3d %6d -> %6d bytes%s' % (name, w, h, len(raw), len(data),
+                                                     ' RLE' if len(data) != len(raw) else ''))
+
+    body = index + pixels
+    with open(args.output, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, VERSION, len(images), len(body), zlib.crc32(body)))
+        f.write(body)
+    print('assets: %d images, %d KB (pixels %d KB, %.1f%% of raw)' %
+          (len(images), (HEADER.size + len(body)) // 1024, packed_total // 1024,
+           100.0 * packed_total / max(raw_total, 1)))
+
+
+if __name__ == '__main__':
+    main()
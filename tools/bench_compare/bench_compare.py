@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# 比较基准套件的报告(main/bench_suite.h) 找退步 只用标准库
+#
+# 用法: bench_compare.py base.json new.json [更多.json ...] [--threshold 5] [--by-device]
+#   第一份是基线 后面的逐份和它比 每项打印基线值 新值 变化百分比
+#   变差超过阈值(百分比)的标REGRESSION 有一份有退步就返回1 可以放进CI
+#   format不同的不比 测项和单位可能变了
+#   sdkconfig或者设备(MAC)不同照样比 但在表头提醒 不同配置的差别不一定是代码的问题
+#   --by-device 报告按MAC分组 每台设备拿自己最早的一份当基线 用来看一批设备各自有没有退步
+#
+# 报告格式:
+#   {"format": 1, "time": ..., "firmware": {"version", "elf_sha256", "sdkconfig_sha256", ...},
+#    "device": {"mac", "cpu_mhz", "sd_khz", "lcd_buf_lines", ...},
+#    "results": [{"name", "unit", "higher_better", "value" 跳过的是null, "skipped"}]}
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path, encoding='utf-8') as f:
+        rep = json.load(f)
+    rep['_path'] = path
+    rep['_values'] = {r['name']: r for r in rep.get('results', [])}
+    return rep
+
+
+def label(rep):
+    fw = rep.get('firmware', {})
+    return '%s (%s, %s)' % (rep['_path'], fw.get('version', '?'), rep.get('time') or 'no time')
+
+
+def compare(base, new, threshold):
+    """打印一份对比 返回退步的项数"""
+    print('base: %s' % label(base))
+    print('new:  %s' % label(new))
+    if base.get('format') != new.get('format'):
+        print('  format %s vs %s, not comparable\n' % (base.get('format'), new.get('format')))
+        return 0
+    notes = []
+    bfw, nfw = base.get('firmware', {}), new.get('firmware', {})
+    if bfw.get('sdkconfig_sha256') != nfw.get('sdkconfig_sha256'):
+        notes.append('sdkconfig differs')
+    bdev, ndev = base.get('device', {}), new.get('device', {})
+    if bdev.get('mac') != ndev.get('mac'):
+        notes.append('different device')
+    for key in ('cpu_mhz', 'psram_kb', 'sd_bus_width', 'sd_khz', 'lcd_buf_lines', 'lcd_mode'):
+        if bdev.get(key) != ndev.get(key):
+            notes.append('%s %s -> %s' % (key, bdev.get(key), ndev.get(key)))
+    if notes:
+        print('  note: ' + ', '.join(notes))
+
+    bad = 0
+    print('  %-18s %12s %12s %8s' % ('test', 'base', 'new', 'change'))
+    for name, b in base['_values'].items():
+        n = new['_values'].get(name)
+        unit = b.get('unit', '')
+        if n is None or b.get('value') is None or n.get('value') is None:
+            bv = '-' if b.get('value') is None else '%.2f' % b['value']
+            nv = '-' if n is None or n.get('value') is None else '%.2f' % n['value']
+            print('  %-18s %12s %12s %8s  %s' % (name, bv, nv, 'skipped', unit))
+            continue
+        bv, nv = b['value'], n['value']
+        change = (nv - bv) / bv * 100 if bv else 0.0
+        worse = -change if b.get('higher_better', True) else change
+        flag = ''
+        if worse > threshold:
+            flag = '  REGRESSION'
+            bad += 1
+        elif -worse > threshold:
+            flag = '  better'
+        print('  %-18s %12.2f %12.2f %+7.1f%%  %s%s' % (name, bv, nv, change, unit, flag))
+    for name in new['_values']:
+        if name not in base['_values']:
+            print('  %-18s %12s %12s %8s' % (name, '-', '-', 'new'))
+    print()
+    return bad
+
+
+def main():
+    ap = argparse.ArgumentParser(description='compare bench_suite reports')
+    ap.add_argument('reports', nargs='+')
+    ap.add_argument('--threshold', type=float, default=5.0, help='percent change counted as regression')
+    ap.add_argument('--by-device', action='store_true', help='baseline per device MAC, oldest report first')
+    args = ap.parse_args()
+    reps = [load(p) for p in args.reports]
+
+    groups = [reps]
+    if args.by_device:
+        by_mac = {}
+        for rep in reps:
+            by_mac.setdefault(rep.get('device', {}).get('mac', '?'), []).append(rep)
+        groups = [sorted(g, key=lambda r: r.get('time') or '') for g in by_mac.values()]
+
+    bad = 0
+    for group in groups:
+        if len(group) < 2:
+            print('%s: only one report\n' % label(group[0]))
+            continue
+        for new in group[1:]:
+            bad += compare(group[0], new, args.threshold)
+    if bad:
+        print('%d regressions over %.1f%%' % (bad, args.threshold))
+    sys.exit(1 if bad else 0)
+
+
+if __name__ == '__main__':
+    main()
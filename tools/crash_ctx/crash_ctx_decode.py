@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+# 核心转储里死前遥测(main/crash_ctx.h)的主机端解码 只用标准库
+#
+# 用法: crash_ctx_decode.py coredump.bin [build/<项目>.elf] [--csv out.csv]
+#   coredump.bin 是GET http://<ip>:<端口>/api/coredump下载的
+#                或者 parttool.py read_partition --partition-name coredump --output coredump.bin
+#   ELF要是死的那次构建 锁的名字和拿LVGL锁的函数按地址从里面取 不给就只打地址
+#   栈和寄存器用IDF的 espcoredump.py info_corefile -t raw -c coredump.bin <ELF>
+#
+# 转储里s_snap不压缩 按CRASH_CTX_MAGIC在整个文件里找 全部小端:
+#   u32 magic "CCTX", u16 version, u16 rows, u16 metrics, u16 locks, u32 period_ms, u32 head, u32 t_ms
+#   char names[32][20], u8 kinds[32] (0量表 1计数)
+#   8个锁 每个32字节: u32 名字地址, u32 函数地址, i32 行号, char holder[16], u32 since_ms
+#   rows行 每行140字节: u32 seq, u32 t_ms, u8 count, 3字节填充, u32 v[32]
+#   最新一行在row[(head-1) % rows] seq对不上的是还没写过或者写到一半的
+import argparse
+import struct
+import sys
+
+MAGIC = 0x58544343
+VERSION = 1
+MAX_METRICS = 32
+NAME_LEN = 20
+MAX_LOCKS = 8
+HDR = struct.Struct('<IHHHHIII')
+LOCK = struct.Struct('<IIi16sI')
+ROW = struct.Struct('<IIB3x%dI' % MAX_METRICS)
+COUNTER = 1
+
+
+class Elf:
+    """只为按地址取rodata里的字符串 读节头表"""
+
+    def __init__(self, path):
+        self.data = open(path, 'rb').read()
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1:
+            sys.exit('%s is not a 32-bit ELF' % path)
+        shoff, = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            _, stype, _, addr, off, size = struct.unpack_from('<IIIIII', self.data, shoff + i * shentsize)
+            if addr and size and stype != 8:  # SHT_NOBITS没有文件内容
+                self.sections.append((addr, off, size))
+
+    def string(self, addr):
+        for base, off, size in self.sections:
+            if base <= addr < base + size:
+                start = off + addr - base
+                end = self.data.find(b'\0', start, off + size)
+                if end >= 0:
+                    return self.data[start:end].decode('utf-8', 'replace')
+        return None
+
+
+def cstr(b):
+    return b.split(b'\0', 1)[0].decode('utf-8', 'replace')
+
+
+def find_snap(data):
+    # 栈里碰巧也可能有这个数 头里的几个数都合理才算
+    pos = data.find(struct.pack('<I', MAGIC))
+    while pos >= 0:
+        if pos + HDR.size <= len(data):
+            _, ver, rows, metrics, locks, _, _, _ = HDR.unpack_from(data, pos)
+            size = HDR.size + MAX_METRICS * (NAME_LEN + 1) + MAX_LOCKS * LOCK.size + rows * ROW.size
+            if ver == VERSION and 0 < rows <= 1024 and metrics <= MAX_METRICS and locks <= MAX_LOCKS \
+                    and pos + size <= len(data):
+                return pos
+        pos = data.find(struct.pack('<I', MAGIC), pos + 1)
+    return -1
+
+
+def main():
+    ap = argparse.ArgumentParser(description='print the telemetry snapshot inside a core dump')
+    ap.add_argument('dump')
+    ap.add_argument('elf', nargs='?')
+    ap.add_argument('--csv', help='also write the rows as CSV')
+    args = ap.parse_args()
+
+    data = open(args.dump, 'rb').read()
+    elf = Elf(args.elf) if args.elf else None
+    pos = find_snap(data)
+    if pos < 0:
+        sys.exit('no crash context in %s (APP_CRASH_CTX off, or not an ELF core dump)' % args.dump)
+
+    _, _, nrows, nmetrics, nlocks, period, head, t_ms = HDR.unpack_from(data, pos)
+    off = pos + HDR.size
+    names = [cstr(data[off + i * NAME_LEN:off + (i + 1) * NAME_LEN]) for i in range(MAX_METRICS)]
+    off += MAX_METRICS * NAME_LEN
+    kinds = list(data[off:off + MAX_METRICS])
+    off += MAX_METRICS
+
+    def sym(addr):
+        if addr == 0:
+            return ''
+        s = elf.string(addr) if elf else None
+        return s if s is not None else '<0x%08x>' % addr
+
+    print('last snapshot at %.1f s after boot, %d rows every %d ms' % (t_ms / 1e3, nrows, period))
+    print('locks:')
+    for i in range(MAX_LOCKS):
+        name, func, line, holder, since = LOCK.unpack_from(data, off + i * LOCK.size)
+        if i >= nlocks:
+            continue
+        holder = cstr(holder)
+        if not holder:
+            print('  %-14s free' % sym(name))
+            continue
+        where = ' at %s:%d' % (sym(func), line) if func else ''
+        print('  %-14s held by %-16s for >= %d ms%s' % (sym(name), holder, t_ms - since, where))
+    off += MAX_LOCKS * LOCK.size
+
+    rows = []
+    for seq in range(max(0, head - nrows), head):
+        r = ROW.unpack_from(data, off + (seq % nrows) * ROW.size)
+        if r[0] == seq:
+            rows.append(r)
+    if not rows:
+        print('no telemetry rows')
+        return 1
+
+    # 计数显示这一行比上一行多了多少 量表原样
+    cols = range(min(nmetrics, MAX_METRICS))
+    header = ['t_s'] + [names[i] + ('+' if kinds[i] == COUNTER else '') for i in cols]
+    table = []
+    prev = None
+    for r in rows:
+        count, v = r[2], r[3:]
+        line = ['%.1f' % (r[1] / 1e3)]
+        for i in cols:
+            if i >= count:
+                line.append('')
+            elif kinds[i] == COUNTER:
+                line.append(str(v[i] - prev[3 + i]) if prev and i < prev[2] and v[i] >= prev[3 + i] else '')
+            else:
+                line.append(str(v[i]))
+        table.append(line)
+        prev = r
+    # 列太多 竖着打 一列一行
+    print('telemetry (counters as increase per row, *_pm is per mille):')
+    width = max(len(h) for h in header)
+    for c, h in enumerate(header):
+        print('  %-*s %s' % (width, h, ' '.join('%8s' % t[c] for t in table)))
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write(','.join(header) + '\n')
+            for t in table:
+                f.write(','.join(t) + '\n')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
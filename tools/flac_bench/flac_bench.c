@@ -0,0 +1,287 @@
+/*
+ * components/flac 的主机端基准和一致性检查
+ *
+ * 用法: flac_bench [-n 循环次数] a.flac [b.flac ...]
+ *   每个文件整段解码 n 次 报告 MB/s(按压缩后字节) 和实时倍数
+ *   第一次解码的PCM算MD5 和STREAMINFO里的签名比对
+ *   如果旁边有同名的 .wav (flac -d 的输出) 再和它的data块MD5比对
+ *   有任何一项不一致 返回值非0 可以直接挂到ctest/CI里
+ *
+ * 语料用 make_corpus.sh 从WAV生成 -0/-5/-8 三个压缩等级
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "flacdecoder.h"
+#include "md5.h"
+
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+} blob_t;
+
+static int load_file(const char *path, blob_t *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    // 末尾留余量 位读取器会往后多看几个字节
+    out->data = calloc(1, n + 64);
+    out->size = out->data ? fread(out->data, 1, n, f) : 0;
+    fclose(f);
+    return out->data && out->size == (size_t)n ? 0 : -1;
+}
+
+static uint32_t be(const uint8_t *p, int n)
+{
+    uint32_t v = 0;
+    while (n--)
+    {
+        v = (v << 8) | *p++;
+    }
+    return v;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// 解析 [ID3v2] fLaC 和 metadata 块 返回第一帧的偏移
+static long parse_header(const blob_t *b, FLACContext *fc, uint8_t md5[16])
+{
+    size_t pos = 0;
+    if (b->size > 10 && memcmp(b->data, "ID3", 3) == 0)
+    {
+        pos = 10 + ((b->data[6] & 0x7f) << 21 | (b->data[7] & 0x7f) << 14 | (b->data[8] & 0x7f) << 7 | (b->data[9] & 0x7f));
+    }
+    if (pos + 4 > b->size || memcmp(b->data + pos, "fLaC", 4) != 0)
+    {
+        return -1;
+    }
+    pos += 4;
+
+    int last = 0, got_info = 0;
+    while (!last && pos + 4 <= b->size)
+    {
+        const uint8_t *h = b->data + pos;
+        last = h[0] >> 7;
+        uint32_t len = be(h + 1, 3);
+        if ((h[0] & 0x7f) == 0 && len >= 34 && pos + 4 + 34 <= b->size)
+        {
+            const uint8_t *si = h + 4;
+            fc->min_blocksize = be(si, 2);
+            fc->max_blocksize = be(si + 2, 2);
+            fc->min_framesize = be(si + 4, 3);
+            fc->max_framesize = be(si + 7, 3);
+            uint64_t packed = (uint64_t)be(si + 10, 4) << 32 | be(si + 14, 4);
+            fc->samplerate = (packed >> 44) & 0xfffff;
+            fc->channels = ((packed >> 41) & 7) + 1;
+            fc->bps = ((packed >> 36) & 0x1f) + 1;
+            fc->totalsamples = packed & 0xfffffffffULL;
+            memcpy(md5, si + 18, 16);
+            got_info = 1;
+        }
+        pos += 4 + len;
+    }
+    return got_info ? (long)pos : -1;
+}
+
+// flac -d 输出的WAV 取data块
+static int wav_data(const blob_t *b, const uint8_t **data, size_t *size)
+{
+    if (b->size < 12 || memcmp(b->data, "RIFF", 4) != 0 || memcmp(b->data + 8, "WAVE", 4) != 0)
+    {
+        return -1;
+    }
+    size_t pos = 12;
+    while (pos + 8 <= b->size)
+    {
+        uint32_t len = le32(b->data + pos + 4);
+        if (memcmp(b->data + pos, "data", 4) == 0)
+        {
+            *data = b->data + pos + 8;
+            *size = len <= b->size - pos - 8 ? len : b->size - pos - 8;
+            return 0;
+        }
+        pos += 8 + len + (len & 1);
+    }
+    return -1;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void md5_hex(const uint8_t d[16], char out[33])
+{
+    for (int i = 0; i < 16; i++)
+    {
+        sprintf(out + 2 * i, "%02x", d[i]);
+    }
+}
+
+// 按FLAC签名的格式(小端 每样本(bps+7)/8字节 声道交织)把一帧喂给MD5
+static void md5_frame(md5_ctx_t *md5, const void *wav, int blocksize, int channels, int bps)
+{
+    const int out_ch = channels == 1 ? 2 : channels;    // 单声道解码输出成两路 只取第一路
+    const int bytes = (bps + 7) / 8;
+    uint8_t tmp[4 * 8];
+    for (int i = 0; i < blocksize; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            int32_t v = bps > 16 ? ((const int32_t *)wav)[i * out_ch + c] : ((const int16_t *)wav)[i * out_ch + c];
+            for (int k = 0; k < bytes; k++)
+            {
+                tmp[c * bytes + k] = (uint8_t)(v >> (8 * k));
+            }
+        }
+        md5_update(md5, tmp, channels * bytes);
+    }
+}
+
+static int bench_file(const char *path, int loops)
+{
+    blob_t b;
+    if (load_file(path, &b) != 0)
+    {
+        printf("%s: cannot read\n", path);
+        return 1;
+    }
+
+    FLACContext fc;
+    uint8_t want[16];
+    memset(&fc, 0, sizeof(fc));
+    long start = parse_header(&b, &fc, want);
+    if (start < 0 || fc.max_blocksize == 0)
+    {
+        printf("%s: not a FLAC stream\n", path);
+        free(b.data);
+        return 1;
+    }
+
+    for (int c = 0; c < fc.channels; c++)
+    {
+        fc.decoded[c] = malloc(sizeof(int) * fc.max_blocksize);
+    }
+    fc.downmix = 0;     // 保留全部声道 才能和签名比对
+    const int out_ch = fc.channels == 1 ? 2 : fc.channels;
+    void *wav = malloc((size_t)fc.max_blocksize * out_ch * sizeof(int32_t));
+
+    md5_ctx_t md5;
+    md5_init(&md5);
+    unsigned long samples = 0, frames = 0, crc_errors = 0;
+    int errors = 0;
+    double t0 = now_s();
+    for (int l = 0; l < loops; l++)
+    {
+        size_t pos = start;
+        while (pos < b.size)
+        {
+            int off = flac_seek_frame(b.data + pos, b.size - pos, &fc);
+            if (off < 0)
+            {
+                break;
+            }
+            pos += off;
+            int r = fc.bps > 16 ? flac_decode_frame24(&fc, b.data + pos, b.size - pos, wav)
+                                : flac_decode_frame16(&fc, b.data + pos, b.size - pos, wav);
+            if (r != 0)
+            {
+                errors++;
+                pos++;
+                continue;
+            }
+            if (l == 0)
+            {
+                if (fc.framesize <= (int)(b.size - pos) && flac_check_crc16(b.data + pos, fc.framesize) != 0)
+                {
+                    crc_errors++;
+                }
+                md5_frame(&md5, wav, fc.blocksize, fc.channels, fc.bps);
+                samples += fc.blocksize;
+                frames++;
+            }
+            pos += fc.framesize;
+        }
+    }
+    double sec = now_s() - t0;
+
+    uint8_t got[16], zero[16] = { 0 };
+    char got_hex[33];
+    md5_final(&md5, got);
+    md5_hex(got, got_hex);
+    const char *sig = memcmp(want, zero, 16) == 0 ? "n/a" : memcmp(want, got, 16) == 0 ? "OK" : "FAIL";
+    int fail = errors || crc_errors || strcmp(sig, "FAIL") == 0 || (fc.totalsamples && samples != fc.totalsamples);
+
+    // 同名 .wav 作为 flac -d 的参考输出
+    const char *ref = "-";
+    char ref_path[1024];
+    size_t stem = strlen(path);
+    if (stem > 5 && strcmp(path + stem - 5, ".flac") == 0)
+    {
+        stem -= 5;
+    }
+    snprintf(ref_path, sizeof(ref_path), "%.*s.wav", (int)stem, path);
+    blob_t rb;
+    if (load_file(ref_path, &rb) == 0)
+    {
+        const uint8_t *pcm;
+        size_t pcm_size;
+        uint8_t rd[16];
+        if (wav_data(&rb, &pcm, &pcm_size) == 0)
+        {
+            md5_ctx_t rm;
+            md5_init(&rm);
+            md5_update(&rm, pcm, pcm_size);
+            md5_final(&rm, rd);
+            ref = memcmp(rd, got, 16) == 0 ? "OK" : "FAIL";
+            fail |= strcmp(ref, "FAIL") == 0;
+        }
+        free(rb.data);
+    }
+
+    double audio_s = fc.samplerate ? (double)samples / fc.samplerate : 0;
+    printf("%-40s %2dch %2dbit %6d Hz %6lu frames %8.1f MB/s %7.1fx RT  md5 %s  ref %s  err %d crc %lu  %s\n",
+           path, fc.channels, fc.bps, fc.samplerate, frames, sec > 0 ? (double)(b.size - start) * loops / sec / 1e6 : 0,
+           sec > 0 ? audio_s * loops / sec : 0, sig, ref, errors, crc_errors, got_hex);
+
+    for (int c = 0; c < fc.channels; c++)
+    {
+        free(fc.decoded[c]);
+    }
+    free(wav);
+    free(b.data);
+    return fail;
+}
+
+int main(int argc, char **argv)
+{
+    int loops = 1, first = 1, fail = 0;
+    if (argc > 2 && strcmp(argv[1], "-n") == 0)
+    {
+        loops = atoi(argv[2]) > 0 ? atoi(argv[2]) : 1;
+        first = 3;
+    }
+    if (first >= argc)
+    {
+        fprintf(stderr, "usage: %s [-n loops] file.flac...\n", argv[0]);
+        return 2;
+    }
+    for (int i = first; i < argc; i++)
+    {
+        fail |= bench_file(argv[i], loops);
+    }
+    return fail;
+}
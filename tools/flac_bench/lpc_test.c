@@ -0,0 +1,197 @@
+/*
+ * LPC还原核的主机端一致性检查 不需要语料
+ *
+ * 1~32阶 16/17/24bit(17bit是16bit流的side声道) 随机系数 精度 qlevel和块长
+ * 先按定义用64位算出残差 再交给 lpc_restore() 必须还原出原样本
+ * 同一组数据再跑一遍展开核之前的通用循环(按流的bps选32/64位) 它不会溢出的时候两边逐样本一致
+ * 另外固定一组17bit side声道的大系数 旧循环的32位累加会绕回 新的必须选64位并且还原正确
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flacdecoder.c"    // 要测的是文件内的静态函数
+
+#define BLOCK_MAX   4608
+#define TRIALS      40      // 每个阶数和位宽的随机组数
+
+static uint32_t s_rng = 0x12345678;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static int32_t rnd_range(int32_t lo, int32_t hi)
+{
+    return lo + (int32_t)(rnd() % (uint32_t)(hi - lo + 1));
+}
+
+/* 展开核之前 decode_subframe_lpc 里的循环 原样保留 */
+static void old_lpc(int32_t *decoded, const int *coeffs, int pred_order, int qlevel, int blocksize, int bps)
+{
+    int i, j;
+    if (bps > 16) {
+        int64_t sum;
+        for (i = pred_order; i < blocksize; i++) {
+            sum = 0;
+            for (j = 0; j < pred_order; j++)
+                sum += (int64_t)coeffs[j] * decoded[i-j-1];
+            decoded[i] += sum >> qlevel;
+        }
+    } else {
+        for (i = pred_order; i < blocksize-1; i += 2) {
+            int c;
+            int d = decoded[i-pred_order];
+            int s0 = 0, s1 = 0;
+            for (j = pred_order-1; j > 0; j--) {
+                c = coeffs[j];
+                s0 += c*d;
+                d = decoded[i-j];
+                s1 += c*d;
+            }
+            c = coeffs[0];
+            s0 += c*d;
+            d = decoded[i] += s0 >> qlevel;
+            s1 += c*d;
+            decoded[i+1] += s1 >> qlevel;
+        }
+        if (i < blocksize) {
+            int sum = 0;
+            for (j = 0; j < pred_order; j++)
+                sum += coeffs[j] * decoded[i-j-1];
+            decoded[i] += sum >> qlevel;
+        }
+    }
+}
+
+/* x的前order个是预热样本 后面换成残差 残差放不进32位返回-1 */
+static int make_residual(const int32_t *x, int32_t *res, const int *coeffs, int order, int qlevel, int blocksize)
+{
+    memcpy(res, x, order * sizeof(int32_t));
+    for (int i = order; i < blocksize; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++)
+            sum += (int64_t)coeffs[j] * x[i-j-1];
+        int64_t r = x[i] - (sum >> qlevel);
+        if (r < INT32_MIN || r > INT32_MAX)
+            return -1;
+        res[i] = (int32_t)r;
+    }
+    return 0;
+}
+
+static int32_t s_x[BLOCK_MAX], s_res[BLOCK_MAX], s_new[BLOCK_MAX], s_old[BLOCK_MAX];
+
+/* 返回0是通过 *old_diff 记下旧循环和新结果不一样(只允许在旧循环会溢出时) */
+static int run_case(const char *what, int bps, int curr_bps, int order, const int *coeffs, int qlevel,
+                    int blocksize, int *old_diff)
+{
+    unsigned abs_sum = 0;
+    for (int j = 0; j < order; j++)
+        abs_sum += coeffs[j] < 0 ? -coeffs[j] : coeffs[j];
+    int wide = lpc_need_wide(curr_bps, abs_sum);
+
+    memcpy(s_new, s_res, blocksize * sizeof(int32_t));
+    lpc_restore(s_new, coeffs, order, qlevel, blocksize, wide);
+    for (int i = 0; i < blocksize; i++) {
+        if (s_new[i] != s_x[i]) {
+            printf("%s: bps %d/%d order %d qlevel %d block %d %s: sample %d is %ld, expected %ld\n",
+                   what, bps, curr_bps, order, qlevel, blocksize, wide ? "64-bit" : "32-bit",
+                   i, (long)s_new[i], (long)s_x[i]);
+            return 1;
+        }
+    }
+
+    memcpy(s_old, s_res, blocksize * sizeof(int32_t));
+    old_lpc(s_old, coeffs, order, qlevel, blocksize, bps);
+    *old_diff = memcmp(s_old, s_new, blocksize * sizeof(int32_t)) != 0;
+    // 旧循环在 bps>16 时是64位 <=16bit时只有累加上界超过32位才可能不一样
+    if (*old_diff && (bps > 16 || !wide)) {
+        printf("%s: bps %d/%d order %d qlevel %d block %d: old loop differs without overflow\n",
+               what, bps, curr_bps, order, qlevel, blocksize);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_random(int bps, int curr_bps, int *cases, int *wide_cases, int *old_diffs)
+{
+    static const int blocks[] = {0, 1151, 4096, 4608};   // 0是order+1 只有一个要还原的样本
+    int32_t full = (1 << (curr_bps - 1)) - 1;
+    for (int order = 1; order <= 32; order++) {
+        for (int t = 0; t < TRIALS; t++) {
+            int coeffs[32];
+            int prec = rnd_range(2, 15);
+            int qlevel = rnd_range(0, 15);
+            int blocksize = blocks[t % 4] ? blocks[t % 4] : order + 1;
+            for (int j = 0; j < order; j++)
+                coeffs[j] = rnd_range(-(1 << (prec - 1)), (1 << (prec - 1)) - 1);
+            // 一半满幅 一半小信号 小信号时残差小 更像真实的流
+            int32_t amp = t & 1 ? full : full >> rnd_range(4, curr_bps - 2);
+            for (int i = 0; i < blocksize; i++)
+                s_x[i] = rnd_range(-amp - 1, amp);
+            if (make_residual(s_x, s_res, coeffs, order, qlevel, blocksize) < 0)
+                continue;
+            unsigned abs_sum = 0;
+            for (int j = 0; j < order; j++)
+                abs_sum += coeffs[j] < 0 ? -coeffs[j] : coeffs[j];
+            int old_diff;
+            if (run_case("random", bps, curr_bps, order, coeffs, qlevel, blocksize, &old_diff))
+                return 1;
+            (*cases)++;
+            *wide_cases += lpc_need_wide(curr_bps, abs_sum);
+            *old_diffs += old_diff;
+        }
+    }
+    return 0;
+}
+
+/* 16bit流的17bit side声道 8阶系数都是16383 上界17+17=34位
+ * 旧循环按流的bps走32位 累加到约8.6e9绕回 新的要选64位 */
+static int check_side_overflow(void)
+{
+    int coeffs[8];
+    for (int j = 0; j < 8; j++)
+        coeffs[j] = 16383;
+    for (int i = 0; i < 1024; i++)
+        s_x[i] = 65535;
+    if (!lpc_need_wide(17, 8 * 16383)) {
+        printf("side: 17-bit channel with sum|coeff| %d did not pick the 64-bit path\n", 8 * 16383);
+        return 1;
+    }
+    if (lpc_need_wide(16, 1 << 15)) {
+        printf("side: 16-bit channel with sum|coeff| 32768 picked the 64-bit path\n");
+        return 1;
+    }
+    if (make_residual(s_x, s_res, coeffs, 8, 14, 1024) < 0) {
+        printf("side: residual does not fit\n");
+        return 1;
+    }
+    int old_diff;
+    if (run_case("side", 16, 17, 8, coeffs, 14, 1024, &old_diff))
+        return 1;
+    if (!old_diff) {
+        printf("side: old loop did not overflow, the case no longer pins the accumulator width\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const int widths[][2] = {{16, 16}, {16, 17}, {24, 24}};   // 流的bps 声道的bps
+    int fail = 0;
+    for (int w = 0; w < 3; w++) {
+        int cases = 0, wide_cases = 0, old_diffs = 0;
+        fail |= check_random(widths[w][0], widths[w][1], &cases, &wide_cases, &old_diffs);
+        printf("%2d-bit channel of a %d-bit stream: %d cases, %d on the 64-bit path, "
+               "%d where the old loop overflowed 32 bits\n",
+               widths[w][1], widths[w][0], cases, wide_cases, old_diffs);
+    }
+    fail |= check_side_overflow();
+    printf(fail ? "FAIL\n" : "orders 1-32 bit-exact\n");
+    return fail;
+}
@@ -0,0 +1,15 @@
+#!/bin/sh
+# 从WAV生成flac_bench用的语料: 每个WAV按 -0/-5/-8 压缩 再用 flac -d 解出参考WAV
+# 用法: make_corpus.sh <输出目录> a.wav [b.wav ...]   需要安装 flac 命令行工具
+set -e
+out=$1
+shift
+mkdir -p "$out"
+for wav in "$@"; do
+    name=$(basename "$wav" .wav)
+    for level in 0 5 8; do
+        f="$out/${name}_l$level.flac"
+        flac -s -f -$level -o "$f" "$wav"
+        flac -s -f -d -o "$out/${name}_l$level.wav" "$f"
+    done
+done
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// RFC 1321 MD5 用来和STREAMINFO里的签名/flac -d的输出比对
+typedef struct {
+    uint32_t state[4];
+    uint64_t bytes;
+    uint8_t buf[64];
+} md5_ctx_t;
+
+void md5_init(md5_ctx_t *ctx);
+void md5_update(md5_ctx_t *ctx, const void *data, size_t len);
+void md5_final(md5_ctx_t *ctx, uint8_t digest[16]);
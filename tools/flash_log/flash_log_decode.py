@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+# flash里的二进制日志(main/flash_log.h)的主机端解码 只用标准库
+#
+# 用法: flash_log_decode.py applog.bin build/<项目>.elf [-o out.txt] [--boot N]
+#   applog.bin 是整个applog分区: GET http://<ip>:<端口>/api/log
+#              或者 parttool.py read_partition --partition-name applog --output applog.bin
+#   ELF要是写日志的那次构建 格式串按地址从里面取 对不上扇区头里记的SHA会提醒
+#   每行: 开机序号 开机以来的秒数 [对过时间的话墙上时间] 核 格式化以后的内容
+#   --boot 只输出这一次开机的
+#
+# 分区格式 全部小端 每个扇区4096字节:
+#   扇区头 32字节: u32 magic "FLG1", u32 seq, u32 boot, u32 保留, char elf_sha[16]
+#   之后记录一条接一条 扇区里剩下的是0xFF
+#   记录: u32 头(高8位0xB1 位8核 低8位参数个数n), u32 格式串地址或特殊编号, u32 esp_timer低32位, n个u32参数
+#     特殊编号 1 开机: 开机序号 esp_reset_reason
+#              2 时刻: esp_timer低32位 高32位 time()
+#              3 丢了: 环满了丢的条数
+import argparse
+import hashlib
+import re
+import struct
+import sys
+import time
+
+SECTOR = 4096
+SECTOR_HDR = struct.Struct('<IIII16s')
+MAGIC = 0x31474C46
+TAG = 0xB1
+ID_BOOT, ID_TIME, ID_LOST = 1, 2, 3
+RESET = ['unknown', 'power-on', 'ext', 'sw', 'panic', 'int_wdt', 'task_wdt', 'wdt', 'deepsleep',
+         'brownout', 'sdio', 'usb', 'jtag', 'efuse', 'pwr_glitch', 'cpu_lockup']
+CONV = re.compile(r'%([-+ #0]*)(\d+)?(\.\d+)?(hh|h|ll|l|z|j|t|L)?([diouxXcspfeEgGaA%])')
+
+
+class Elf:
+    """只为按地址取rodata里的字符串 读节头表"""
+
+    def __init__(self, path):
+        self.data = open(path, 'rb').read()
+        self.sha = hashlib.sha256(self.data).hexdigest()
+        if self.data[:4] != b'\x7fELF' or self.data[4] != 1:
+            sys.exit('%s is not a 32-bit ELF' % path)
+        shoff, = struct.unpack_from('<I', self.data, 0x20)
+        shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            _, stype, _, addr, off, size = struct.unpack_from('<IIIIII', self.data, shoff + i * shentsize)
+            if addr and size and stype != 8:  # SHT_NOBITS没有文件内容
+                self.sections.append((addr, off, size))
+
+    def string(self, addr):
+        for base, off, size in self.sections:
+            if base <= addr < base + size:
+                start = off + addr - base
+                end = self.data.find(b'\0', start, off + size)
+                if end >= 0:
+                    return self.data[start:end].decode('utf-8', 'replace')
+        return None
+
+
+def format_args(elf, fmt, args):
+    args = list(args)
+    out = []
+    pos = 0
+    for m in CONV.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        v = args.pop(0) if args else 0
+        spec = '%' + (flags or '') + (width or '') + (prec or '')
+        if conv in 'di':
+            out.append((spec + 'd') % (v - (1 << 32) if v & 0x80000000 else v))
+        elif conv in 'ouxX':
+            out.append((spec + (conv if conv != 'u' else 'd')) % v)
+        elif conv == 'c':
+            out.append((spec + 'c') % chr(v & 0xFF))
+        elif conv == 'p':
+            out.append('0x%08x' % v)
+        elif conv == 's':
+            s = elf.string(v)
+            out.append((spec + 's') % (s if s is not None else '<0x%08x>' % v))
+        else:
+            out.append('<float>')  # 按整数存的 换不回来
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+def sectors(data):
+    found = []
+    for off in range(0, len(data) - SECTOR + 1, SECTOR):
+        magic, seq, boot, _, sha = SECTOR_HDR.unpack_from(data, off)
+        if magic == MAGIC:
+            found.append((seq, boot, sha.decode('ascii', 'replace'), off))
+    # 按和最新那个的差排 seq回绕了也对 分区里的扇区数远小于2^31
+    if found:
+        top = found[0][0]
+        for s in found:
+            top = s[0] if (s[0] - top) & 0x80000000 == 0 else top
+        found.sort(key=lambda s: ((s[0] - top + 0x80000000) & 0xFFFFFFFF) - 0x80000000)
+    return found
+
+
+def records(data, off):
+    pos = off + SECTOR_HDR.size
+    while pos + 12 <= off + SECTOR:
+        hdr, ident, t = struct.unpack_from('<III', data, pos)
+        n = hdr & 0xFF
+        if hdr >> 24 != TAG or n > 6 or pos + 12 + 4 * n > off + SECTOR:
+            return
+        args = struct.unpack_from('<%dI' % n, data, pos + 12)
+        pos += 12 + 4 * n
+        yield (hdr >> 8) & 0xFF, ident, t, args
+
+
+def main():
+    ap = argparse.ArgumentParser(description='decode the applog flash partition')
+    ap.add_argument('dump')
+    ap.add_argument('elf')
+    ap.add_argument('-o', '--output', help='text file, default stdout')
+    ap.add_argument('--boot', type=int, help='only this boot')
+    args = ap.parse_args()
+
+    data = open(args.dump, 'rb').read()
+    elf = Elf(args.elf)
+    found = sectors(data)
+    if not found:
+        sys.exit('no log sectors in %s' % args.dump)
+    out = open(args.output, 'w') if args.output else sys.stdout
+
+    boot = found[0][1]
+    base = None         # 最近一条时刻记录的esp_timer 64位
+    wall = None         # 那时的time() 减去base 就是开机时刻
+    count = lost = 0
+    mismatch = set()
+    for seq, _, sha, off in found:
+        if not elf.sha.startswith(sha.rstrip('\0')):
+            mismatch.add(sha)
+        for core, ident, t, a in records(data, off):
+            if base is not None:
+                # 低32位展开成离上一条时刻最近的
+                full = min(((base >> 32) + k << 32 | t for k in (-1, 0, 1)), key=lambda v: abs(v - base))
+            else:
+                full = t
+            if ident == ID_BOOT:
+                boot = a[0]
+                base = wall = None
+                reason = RESET[a[1]] if a[1] < len(RESET) else str(a[1])
+                if args.boot is None or args.boot == boot:
+                    out.write('==== boot %d (reset: %s) ====\n' % (boot, reason))
+                continue
+            if ident == ID_TIME:
+                base = a[1] << 32 | a[0]
+                # 没对过时间的time()是开机以来的秒数 不算墙上时间
+                wall = a[2] - base / 1e6 if a[2] > 1500000000 else None
+                continue
+            if args.boot is not None and args.boot != boot:
+                continue
+            if ident == ID_LOST:
+                lost += a[0]
+                text = '... %d records lost, ring full' % a[0]
+            else:
+                fmt = elf.string(ident)
+                text = format_args(elf, fmt, a) if fmt is not None else '<no string at 0x%08x> %s' % (
+                    ident, ' '.join('0x%x' % v for v in a))
+                count += 1
+            stamp = ''
+            if wall is not None:
+                w = wall + full / 1e6
+                stamp = ' ' + time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(w)) + '.%03d' % (w * 1000 % 1000)
+            out.write('%d %12.6f%s c%d %s\n' % (boot, full / 1e6, stamp, core, text))
+    if out is not sys.stdout:
+        out.close()
+
+    print('%d sectors, %d records, %d lost' % (len(found), count, lost), file=sys.stderr)
+    for sha in mismatch:
+        print('warning: sectors written by ELF %s, not %s: strings may be wrong' % (sha, elf.sha[:16]),
+              file=sys.stderr)
+    return 1 if mismatch else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
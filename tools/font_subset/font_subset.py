@@ -0,0 +1,432 @@
+#!/usr/bin/env python3
+# 把lv_font_conv出的整个字库(.c)拆成两份 只用标准库 构建时由main/CMakeLists.txt调用
+#
+# 用法: font_subset.py full.c --scan main -o font_alipuhui20.c -b font_alipuhui20_ext.bin
+#   编进程序的: ASCII到CJK之前的符号 GB2312全部 源代码字符串里出现的字 其余字体(图标)的码位
+#     输出的格式和lv_font_conv一样 字距只留两边都在子集里的 fallback指向外挂的字形
+#   外挂的: 剩下的字形 写进fonts分区 格式见main/font_ext.h
+#   --scan 扫描目录下的.c和.h 只看字符串常量 注释里的中文不算
+#   最后打印两份各多少字 多少字节
+#
+# 外挂文件 全部小端:
+#   文件头 32字节
+#     u32 magic "AFX1", u16 version, u16 header_bytes, u32 count, u32 block_offset,
+#     u32 bitmap_offset, u32 bitmap_bytes, u16 line_height, i16 base_line, u8 bpp, 3字节保留
+#   索引 count条 每条u64 按码位排好:
+#     位0-17 码位, 18-27 adv_w(1/16像素), 28-32 box_w, 33-37 box_h, 38-43 ofs_x, 44-49 ofs_y(有符号),
+#     50-63 压缩后的字节数
+#   每FONT_EXT_BLOCK个字形一个u32 这组第一个字形相对bitmap_offset的位置 后面的按字节数累加
+#   字形: 4bpp 每个像素一个半字节 高半字节在前 先和上一行异或 再编码:
+#     不是0的半字节原样 0后面跟一个半字节n 表示n+1个0 最后不满一个字节补0
+import argparse
+import os
+import re
+import struct
+import sys
+
+MAGIC = 0x31584641  # "AFX1"
+VERSION = 1
+HEADER = struct.Struct('<IHHIIIIHhB3x')
+BLOCK = 32
+MAX_BOX = 31
+SLOT_BYTES = 512  # 和font_ext.c里解开的格子一样大
+
+CJK_START = 0x2E80
+
+
+def parse_font(path):
+    src = open(path, encoding='utf-8').read()
+
+    b0 = src.index('glyph_bitmap[] = {')
+    b1 = src.index('};', b0)
+    bitmap = bytes(int(x, 16) for x in re.findall(r'0x([0-9a-fA-F]+)', src[b0:b1]))
+
+    g0 = src.index('glyph_dsc[] = {')
+    g1 = src.index('};', g0)
+    glyphs = [tuple(int(v) for v in m) for m in re.findall(
+        r'\{\.bitmap_index = (\d+), \.adv_w = (\d+), \.box_w = (\d+), \.box_h = (\d+), '
+        r'\.ofs_x = (-?\d+), \.ofs_y = (-?\d+)\}', src[g0:g1])]
+
+    lists = {}
+    for m in re.finditer(r'static const uint(?:8|16)_t (unicode_list_\d+|glyph_id_ofs_list_\d+)\[\] = \{(.*?)\};',
+                         src, re.S):
+        lists[m.group(1)] = [int(x, 0) for x in re.findall(r'0x[0-9a-fA-F]+|\d+', m.group(2))]
+
+    c0 = src.index('cmaps[] =')
+    c1 = src.index('\n};', c0)
+    cp2g = {}
+    for m in re.finditer(r'\.range_start = (\d+), \.range_length = (\d+), \.glyph_id_start = (\d+),\s*'
+                         r'\.unicode_list = (\w+), \.glyph_id_ofs_list = (\w+), \.list_length = (\d+), '
+                         r'\.type = LV_FONT_FMT_TXT_CMAP_(\w+)', src[c0:c1]):
+        start, length, gid = int(m.group(1)), int(m.group(2)), int(m.group(3))
+        ulist, olist, kind = m.group(4), m.group(5), m.group(7)
+        if kind == 'FORMAT0_TINY':
+            for i in range(length):
+                cp2g[start + i] = gid + i
+        elif kind == 'FORMAT0_FULL':
+            for i, ofs in enumerate(lists[olist]):
+                if ofs or i == 0:
+                    cp2g[start + i] = gid + ofs
+        elif kind == 'SPARSE_TINY':
+            for i, u in enumerate(lists[ulist]):
+                cp2g[start + u] = gid + i
+        else:
+            for i, u in enumerate(lists[ulist]):
+                cp2g[start + u] = gid + lists[olist][i]
+
+    k0 = src.index('kern_pair_glyph_ids[] =')
+    k1 = src.index('};', k0)
+    ids = [int(x) for x in re.findall(r'-?\d+', src[k0 + len('kern_pair_glyph_ids[] ='):k1])]
+    v0 = src.index('kern_pair_values[] =')
+    v1 = src.index('};', v0)
+    vals = [int(x) for x in re.findall(r'-?\d+', src[v0 + len('kern_pair_values[] ='):v1])]
+    kerns = list(zip(ids[0::2], ids[1::2], vals))
+
+    metrics = {}
+    for key in ('line_height', 'base_line', 'kern_scale', 'bpp'):
+        m = re.search(r'\.%s = (-?\d+)' % key, src)
+        metrics[key] = int(m.group(1))
+    opts = re.search(r'^ \* Opts: (.*)$', src, re.M).group(1)
+    return bitmap, glyphs, cp2g, kerns, metrics, opts
+
+
+def glyph_bytes(bitmap, g):
+    w, h = g[2], g[3]
+    return bitmap[g[0]:g[0] + (w * h + 1) // 2]
+
+
+def strip_comments(text):
+    # 只留字符串常量 字符常量里的引号不当成字符串开头
+    out = []
+    i = 0
+    n = len(text)
+    while i < n:
+        c = text[i]
+        if text.startswith('//', i):
+            i = text.find('\n', i)
+            i = n if i < 0 else i
+        elif text.startswith('/*', i):
+            i = text.find('*/', i + 2)
+            i = n if i < 0 else i + 2
+        elif c == "'":
+            j = i + 1
+            while j < n and text[j] != "'":
+                j += 2 if text[j] == '\\' else 1
+            i = j + 1
+        elif c == '"':
+            j = i + 1
+            while j < n and text[j] != '"':
+                j += 2 if text[j] == '\\' else 1
+            out.append(text[i + 1:j])
+            i = j + 1
+        else:
+            i += 1
+    return out
+
+
+def scan_strings(dirs):
+    used = set()
+    for d in dirs:
+        for root, _, files in os.walk(d):
+            if os.path.basename(root) == 'assets':
+                continue
+            for f in files:
+                if not f.endswith(('.c', '.h')):
+                    continue
+                text = open(os.path.join(root, f), encoding='utf-8', errors='ignore').read()
+                for s in strip_comments(text):
+                    used.update(ord(ch) for ch in s if ord(ch) >= 0x80)
+    return used
+
+
+def gb2312_set():
+    out = set()
+    for hi in range(0xA1, 0xF8):
+        for lo in range(0xA1, 0xFF):
+            try:
+                out.add(ord(bytes([hi, lo]).decode('gb2312')))
+            except UnicodeDecodeError:
+                pass
+    return out
+
+
+def encode_glyph(data, w, h):
+    nib = []
+    for b in data:
+        nib += [b >> 4, b & 15]
+    nib = nib[:w * h]
+    filt = nib[:w] + [nib[k] ^ nib[k - w] for k in range(w, len(nib))]
+    out = []
+    i = 0
+    while i < len(filt):
+        if filt[i]:
+            out.append(filt[i])
+            i += 1
+            continue
+        j = i
+        while j < len(filt) and filt[j] == 0 and j - i < 16:
+            j += 1
+        out += [0, j - i - 1]
+        i = j
+    if len(out) & 1:
+        out.append(0)
+    return bytes((out[k] << 4) | out[k + 1] for k in range(0, len(out), 2))
+
+
+def write_ext(path, bitmap, glyphs, cps, cp2g, metrics):
+    index = bytearray()
+    blocks = bytearray()
+    data = bytearray()
+    for n, cp in enumerate(cps):
+        g = glyphs[cp2g[cp]]
+        _, adv, w, h, ox, oy = g
+        if w > MAX_BOX or h > MAX_BOX or (w * h + 1) // 2 > SLOT_BYTES or adv > 1023 or \
+                not -32 <= ox < 32 or not -32 <= oy < 32 or cp >= 1 << 18:
+            sys.exit('U+%04X does not fit the index: %r' % (cp, g))
+        enc = encode_glyph(glyph_bytes(bitmap, g), w, h) if w * h else b''
+        if n % BLOCK == 0:
+            blocks += struct.pack('<I', len(data))
+        rec = cp | adv << 18 | w << 28 | h << 33 | (ox & 63) << 38 | (oy & 63) << 44 | len(enc) << 50
+        index += struct.pack('<Q', rec)
+        data += enc
+    block_off = HEADER.size + len(index)
+    bitmap_off = block_off + len(blocks)
+    hdr = HEADER.pack(MAGIC, VERSION, HEADER.size, len(cps), block_off, bitmap_off, len(data),
+                      metrics['line_height'], metrics['base_line'], metrics['bpp'])
+    with open(path, 'wb') as f:
+        f.write(hdr + index + blocks + data)
+    return bitmap_off + len(data), len(data)
+
+
+def c_array(values, fmt, per_line):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ', '.join(fmt(v) for v in values[i:i + per_line]))
+    return ',\n'.join(lines)
+
+
+def write_subset(path, name, fallback, bitmap, glyphs, cps, cp2g, kerns, metrics, opts):
+    guard = name.upper()
+    new_id = {}
+    bm = bytearray()
+    dsc = ['    {.bitmap_index = 0, .adv_w = 0, .box_w = 0, .box_h = 0, .ofs_x = 0, .ofs_y = 0} /* id = 0 reserved */']
+    parts = []
+    for cp in cps:
+        old = cp2g[cp]
+        if old in new_id:
+            continue
+        new_id[old] = len(dsc)
+        g = glyphs[old]
+        data = glyph_bytes(bitmap, g)
+        dsc.append('    {.bitmap_index = %d, .adv_w = %d, .box_w = %d, .box_h = %d, .ofs_x = %d, .ofs_y = %d}' %
+                   (len(bm), g[1], g[2], g[3], g[4], g[5]))
+        ch = chr(cp).replace('\\', '\\\\').replace('"', '\\"')
+        if cp < 0x20 or 0xD800 <= cp < 0xE000 or ch == '*':
+            ch = ''
+        body = c_array(list(data), lambda v: '0x%x' % v, 8)
+        parts.append('    /* U+%04X "%s" */\n%s' % (cp, ch, body + ',' if body else ''))
+        bm += data
+
+    # 连续的一段用FORMAT0_TINY 其余按不超过16位的跨度分成稀疏表
+    # LVGL 8.3查表时是rcp > range_length才跳过 末尾后面那个码位也会算进来 子集里那个字多半在外挂字库里
+    # 所以range_length写成跨度减1 换LVGL 9(改成了>=)要去掉
+    cmaps = []
+    lists = []
+    runs = []
+    for cp in cps:
+        if runs and cp == runs[-1][1] + 1 and new_id[cp2g[cp]] == new_id[cp2g[runs[-1][1]]] + 1:
+            runs[-1][1] = cp
+        else:
+            runs.append([cp, cp])
+    sparse = []
+
+    def flush_sparse():
+        if not sparse:
+            return
+        idx = len(cmaps)
+        start = sparse[0]
+        lists.append('static const uint16_t unicode_list_%d[] = {\n%s\n};\n' %
+                     (idx, c_array([c - start for c in sparse], lambda v: '0x%x' % v, 8)))
+        cmaps.append('    {\n        .range_start = %d, .range_length = %d, .glyph_id_start = %d,\n'
+                     '        .unicode_list = unicode_list_%d, .glyph_id_ofs_list = NULL, .list_length = %d, '
+                     '.type = LV_FONT_FMT_TXT_CMAP_SPARSE_TINY\n    }' %
+                     (start, sparse[-1] - start, new_id[cp2g[start]], idx, len(sparse)))
+        sparse.clear()
+
+    for a, b in runs:
+        if b - a + 1 >= 16:
+            flush_sparse()
+            cmaps.append('    {\n        .range_start = %d, .range_length = %d, .glyph_id_start = %d,\n'
+                         '        .unicode_list = NULL, .glyph_id_ofs_list = NULL, .list_length = 0, '
+                         '.type = LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY\n    }' % (a, b - a, new_id[cp2g[a]]))
+            continue
+        for cp in range(a, b + 1):
+            if sparse and (cp - sparse[0] > 0xFFFF or new_id[cp2g[cp]] != new_id[cp2g[sparse[-1]]] + 1):
+                flush_sparse()
+            sparse.append(cp)
+    flush_sparse()
+
+    pairs = sorted((new_id[l], new_id[r], v) for l, r, v in kerns if l in new_id and r in new_id)
+
+    with open(path, 'w', encoding='utf-8') as f:
+        f.write('''/*******************************************************************************
+ * Size: 20 px
+ * Bpp: %d
+ * Opts: %s
+ * Subset: tools/font_subset/font_subset.py, other glyphs are read from the fonts partition (%s)
+ ******************************************************************************/
+
+#include "lvgl.h"
+
+#ifndef %s
+#define %s 1
+#endif
+
+#if %s
+
+extern lv_font_t %s;
+
+/*-----------------
+ *    BITMAPS
+ *----------------*/
+
+/*Store the image of the glyphs*/
+static LV_ATTRIBUTE_LARGE_CONST const uint8_t glyph_bitmap[] = {
+%s
+};
+
+
+/*---------------------
+ *  GLYPH DESCRIPTION
+ *--------------------*/
+
+static const lv_font_fmt_txt_glyph_dsc_t glyph_dsc[] = {
+%s
+};
+
+/*---------------------
+ *  CHARACTER MAPPING
+ *--------------------*/
+
+%s
+/*Collect the unicode lists and glyph_id offsets*/
+static const lv_font_fmt_txt_cmap_t cmaps[] =
+{
+%s
+};
+
+/*-----------------
+ *    KERNING
+ *----------------*/
+
+
+/*Pair left and right glyphs for kerning*/
+static const uint16_t kern_pair_glyph_ids[] =
+{
+%s
+};
+
+/* Kerning between the respective left and right glyphs
+ * 4.4 format which needs to scaled with `kern_scale`*/
+static const int8_t kern_pair_values[] =
+{
+%s
+};
+
+/*Collect the kern pair's data in one place*/
+static const lv_font_fmt_txt_kern_pair_t kern_pairs =
+{
+    .glyph_ids = kern_pair_glyph_ids,
+    .values = kern_pair_values,
+    .pair_cnt = %d,
+    .glyph_ids_size = 1
+};
+
+/*--------------------
+ *  ALL CUSTOM DATA
+ *--------------------*/
+
+/*Store all the custom data of the font*/
+static  lv_font_fmt_txt_glyph_cache_t cache;
+
+static const lv_font_fmt_txt_dsc_t font_dsc = {
+    .glyph_bitmap = glyph_bitmap,
+    .glyph_dsc = glyph_dsc,
+    .cmaps = cmaps,
+    .kern_dsc = &kern_pairs,
+    .kern_scale = %d,
+    .cmap_num = %d,
+    .bpp = %d,
+    .kern_classes = 0,
+    .bitmap_format = 0,
+    .cache = &cache
+};
+
+
+/*-----------------
+ *  PUBLIC FONT
+ *----------------*/
+
+/*Initialize a public general font descriptor*/
+const lv_font_t %s = {
+    .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,    /*Function pointer to get glyph's data*/
+    .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,    /*Function pointer to get glyph's bitmap*/
+    .line_height = %d,          /*The maximum line height required by the font*/
+    .base_line = %d,             /*Baseline measured from the bottom of the line*/
+    .subpx = LV_FONT_SUBPX_NONE,
+    .underline_position = -1,
+    .underline_thickness = 1,
+    .dsc = &font_dsc,          /*The custom font data. Will be accessed by `get_glyph_bitmap/dsc` */
+    .fallback = &%s,
+    .user_data = NULL,
+};
+
+#if (LV_FONT_FMT_TXT_LARGE == 0)
+#  error "Too large font or glyphs in %s. Enable LV_FONT_FMT_TXT_LARGE in lv_conf.h")
+#endif
+
+
+#endif /*#if %s*/
+
+''' % (metrics['bpp'], opts, fallback, guard, guard, guard, fallback, '\n\n'.join(parts), ',\n'.join(dsc),
+       '\n'.join(lists), ',\n'.join(cmaps), c_array(['%d, %d' % (l, r) for l, r, _ in pairs], str, 1),
+       c_array([v for _, _, v in pairs], str, 8), len(pairs), metrics['kern_scale'], len(cmaps),
+       metrics['bpp'], name, metrics['line_height'], metrics['base_line'], fallback, guard, guard))
+    return len(new_id), len(bm), len(pairs)
+
+
+def main():
+    ap = argparse.ArgumentParser(description='split an lv_font_conv font into a built-in subset and a flash file')
+    ap.add_argument('font', help='lv_font_conv output with every glyph')
+    ap.add_argument('--scan', action='append', default=[], help='source directory whose strings must be built in')
+    ap.add_argument('--name', default='font_alipuhui20')
+    ap.add_argument('--fallback', default='font_alipuhui20_ext', help='lv_font_t for the flash glyphs')
+    ap.add_argument('-o', '--output', required=True, help='subset .c file')
+    ap.add_argument('-b', '--binary', required=True, help='flash file for the fonts partition')
+    args = ap.parse_args()
+
+    bitmap, glyphs, cp2g, kerns, metrics, opts = parse_font(args.font)
+    if metrics['bpp'] != 4:
+        sys.exit('only 4 bpp fonts are supported')
+    gb = gb2312_set()
+    used = scan_strings(args.scan)
+    keep = sorted(cp for cp in cp2g
+                  if cp < CJK_START or cp in gb or cp in used or 0xE000 <= cp < 0xF900 or 0xFF00 <= cp < 0xFFF0)
+    keep_set = set(keep)
+    rest = sorted(cp for cp in cp2g if cp not in keep_set)
+    missing = sorted(cp for cp in used if cp not in cp2g)
+
+    n, bm_bytes, pairs = write_subset(args.output, args.name, args.fallback, bitmap, glyphs, keep, cp2g, kerns,
+                                      metrics, opts)
+    total, ext_bytes = write_ext(args.binary, bitmap, glyphs, rest, cp2g, metrics)
+    raw = sum(len(glyph_bytes(bitmap, glyphs[cp2g[cp]])) for cp in rest)
+    print('%s: %d glyphs built in, %d KB bitmaps, %d kern pairs (%d strings chars)' %
+          (args.name, n, bm_bytes // 1024, pairs, len(used)))
+    print('%s: %d glyphs in flash, %d KB (bitmaps %d KB, %.1f%% of raw)' %
+          (args.fallback, len(rest), total // 1024, ext_bytes // 1024, 100.0 * ext_bytes / max(raw, 1)))
+    if missing:
+        print('warning: not in the font: %s' % ' '.join('U+%04X' % cp for cp in missing[:20]))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+# 姿态传感器原始数据记录(main/imu_log.h)的主机端解码 只用标准库
+#
+# 用法: imu_log_decode.py imu_0101_120000.bin [-o out.csv] [--raw]
+#   输出CSV: 芯片采样编号 相对第一组的秒数(按编号和标称ODR算) 主机时刻 三轴加速度(g) 三轴角速度(dps)
+#   --raw 输出原始的int16读数 不换算
+#   最后在stderr打印汇总: 组数 编号断开的次数和丢的组数 结束记录里设备自己计的丢失
+#   编号断开或者没有结束记录(没正常停止) 返回值是1 可以直接用在脚本里判断这次记录能不能用
+#
+# 文件格式 全部小端:
+#   文件头 64字节
+#     char magic[4] "QIMU", u16 version, u16 header_bytes, u16 odr_hz,
+#     u16 acc_lsb_per_g, u16 gyr_lsb_per_dps, u16 sample_bytes,
+#     i64 start_us, i64 start_unix, 32字节保留
+#   之后是记录 每条16字节的头: u8 type, u8 count, u16 lost, u32 ts, i64 t_us
+#     type 1 样本: 后面count组 每组 i16 ax ay az gx gy gz 编号从ts起连续加1
+#               lost是这条和上一条之间没进文件的组数(最多记65535) 以ts的差为准
+#     type 2 结束: 后面16字节 u32 samples, lost_fifo, lost_ring, lost_buf
+#   文件可能在最后一条记录中间断掉(掉电) 不完整的记录丢弃
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct('<4sHHHHHHqq32x')
+REC = struct.Struct('<BBHIq')
+END = struct.Struct('<IIII')
+REC_SAMPLES = 1
+REC_END = 2
+
+
+def main():
+    ap = argparse.ArgumentParser(description='decode a QMI8658 binary log')
+    ap.add_argument('log')
+    ap.add_argument('-o', '--output', help='CSV file, default stdout')
+    ap.add_argument('--raw', action='store_true', help='write raw int16 readings')
+    args = ap.parse_args()
+
+    data = open(args.log, 'rb').read()
+    if len(data) < HEADER.size:
+        sys.exit('file too short')
+    magic, version, header_bytes, odr, acc_lsb, gyr_lsb, sample_bytes, start_us, start_unix = \
+        HEADER.unpack_from(data, 0)
+    if magic != b'QIMU':
+        sys.exit('not an IMU log')
+    if version != 1 or sample_bytes != 12:
+        sys.exit('unsupported version %d / sample size %d' % (version, sample_bytes))
+    sample = struct.Struct('<6h')
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    if args.raw:
+        out.write('ts,t_s,host_us,ax,ay,az,gx,gy,gz\n')
+    else:
+        out.write('ts,t_s,host_us,ax_g,ay_g,az_g,gx_dps,gy_dps,gz_dps\n')
+
+    pos = header_bytes
+    first_ts = None
+    next_ts = None
+    samples = 0
+    breaks = 0
+    lost = 0
+    end = None
+    truncated = False
+    while pos + REC.size <= len(data):
+        rtype, count, rec_lost, ts, t_us = REC.unpack_from(data, pos)
+        pos += REC.size
+        if rtype == REC_END:
+            if pos + END.size > len(data):
+                truncated = True
+                break
+            end = END.unpack_from(data, pos)
+            pos += END.size
+            break
+        if rtype != REC_SAMPLES or pos + count * sample_bytes > len(data):
+            truncated = True
+            break
+        if first_ts is None:
+            first_ts = ts
+        elif ts != next_ts:
+            breaks += 1
+            lost += (ts - next_ts) & 0xFFFFFFFF
+        for i in range(count):
+            v = sample.unpack_from(data, pos + i * sample_bytes)
+            n = (ts + i - first_ts) & 0xFFFFFFFF
+            host = t_us + i * 1000000 // odr
+            if args.raw:
+                out.write('%d,%.6f,%d,%d,%d,%d,%d,%d,%d\n' % ((ts + i, n / odr, host) + v))
+            else:
+                out.write('%d,%.6f,%d,%.5f,%.5f,%.5f,%.3f,%.3f,%.3f\n' % (
+                    ts + i, n / odr, host, v[0] / acc_lsb, v[1] / acc_lsb, v[2] / acc_lsb,
+                    v[3] / gyr_lsb, v[4] / gyr_lsb, v[5] / gyr_lsb))
+        pos += count * sample_bytes
+        samples += count
+        next_ts = (ts + count) & 0xFFFFFFFF
+    if out is not sys.stdout:
+        out.close()
+
+    print('%d Hz, %d samples (%.1f s), %d breaks, %d samples missing' %
+          (odr, samples, samples / odr, breaks, lost), file=sys.stderr)
+    if end:
+        print('device: %d samples, lost %d fifo / %d ring / %d buffer' % end, file=sys.stderr)
+        if end[0] != samples:
+            print('sample count does not match the end record', file=sys.stderr)
+    else:
+        print('no end record%s: logging did not stop cleanly' % (' (truncated record)' if truncated else ''),
+              file=sys.stderr)
+    return 0 if end and lost == 0 and end[0] == samples else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
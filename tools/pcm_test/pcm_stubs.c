@@ -0,0 +1,155 @@
+/* audio_pcm.c用到的其他模块和FreeRTOS的替身 */
+#include <string.h>
+#include "esp32_s3_szp.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "task_plan.h"
+#include "telemetry.h"
+#include "audio_vis.h"
+#include "audio_eq.h"
+#include "audio_lat.h"
+#include "pcm_stubs.h"
+
+static TickType_t s_tick;
+static RingbufHandle_t s_rb;            // audio_pcm_init建的那个 测试从这里取数据
+
+TickType_t xTaskGetTickCount(void)
+{
+    return s_tick;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    s_tick += ticks ? ticks : 1;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)s_tick * portTICK_PERIOD_MS * 1000;
+}
+
+RingbufHandle_t xRingbufferCreateStatic(size_t size, RingbufferType_t type, uint8_t *storage, StaticRingbuffer_t *rb)
+{
+    memset(rb, 0, sizeof(*rb));
+    rb->storage = storage;
+    rb->size = size;
+    s_rb = rb;
+    return rb;
+}
+
+// 跟IDF的字节缓冲一样 放不下整块就不放 这里不等
+BaseType_t xRingbufferSend(RingbufHandle_t rb, const void *data, size_t size, TickType_t wait)
+{
+    (void)wait;
+    if (rb->fill + size > rb->size)
+    {
+        return pdFALSE;
+    }
+    const uint8_t *p = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        rb->storage[(rb->head + rb->fill + i) % rb->size] = p[i];
+    }
+    rb->fill += size;
+    return pdTRUE;
+}
+
+// 借出去的是连续的一段 绕回时分两次取
+void *xRingbufferReceiveUpTo(RingbufHandle_t rb, size_t *size, TickType_t wait, size_t max)
+{
+    (void)wait;
+    size_t n = rb->size - rb->head;
+    n = n < rb->fill ? n : rb->fill;
+    n = n < max ? n : max;
+    if (n == 0)
+    {
+        return NULL;
+    }
+    rb->lent = n;
+    *size = n;
+    return rb->storage + rb->head;
+}
+
+void vRingbufferReturnItem(RingbufHandle_t rb, void *item)
+{
+    (void)item;
+    rb->head = (rb->head + rb->lent) % rb->size;
+    rb->fill -= rb->lent;
+    rb->lent = 0;
+}
+
+void vRingbufferGetInfo(RingbufHandle_t rb, UBaseType_t *free, UBaseType_t *read, UBaseType_t *write,
+                        UBaseType_t *acquire, UBaseType_t *waiting)
+{
+    if (free) *free = rb->size - rb->fill;
+    if (read) *read = rb->head;
+    if (write) *write = (rb->head + rb->fill) % rb->size;
+    if (acquire) *acquire = *write;
+    if (waiting) *waiting = rb->fill;
+}
+
+size_t stub_ring_take(void *dst, size_t max)
+{
+    uint8_t *out = dst;
+    size_t got = 0;
+    while (s_rb && got < max)
+    {
+        size_t len = 0;
+        void *data = xRingbufferReceiveUpTo(s_rb, &len, 0, max - got);
+        if (data == NULL)
+        {
+            break;
+        }
+        memcpy(out + got, data, len);
+        got += len;
+        vRingbufferReturnItem(s_rb, data);
+    }
+    return got;
+}
+
+// 送数任务不起 数据由测试自己取
+BaseType_t task_plan_create(task_plan_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *out)
+{
+    (void)id; (void)fn; (void)arg;
+    if (out) *out = NULL;
+    return pdPASS;
+}
+
+int telemetry_add(const char *name, telemetry_kind_t kind, telemetry_read_t read, void *arg)
+{
+    (void)name; (void)kind; (void)read; (void)arg;
+    return 0;
+}
+
+esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    (void)audio_buffer; (void)timeout_ms;
+    if (bytes_written) *bytes_written = len;
+    return ESP_OK;
+}
+
+esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
+{
+    (void)rate; (void)bits_cfg; (void)ch;
+    return ESP_OK;
+}
+
+bool bsp_audio_in_standby(void)
+{
+    return false;
+}
+
+esp_err_t bsp_codec_mute_set(bool enable)
+{
+    (void)enable;
+    return ESP_OK;
+}
+
+void audio_vis_set_format(uint32_t rate, int channels) { (void)rate; (void)channels; }
+void audio_vis_tap(const int16_t *pcm, size_t frames) { (void)pcm; (void)frames; }
+void audio_eq_set_rate(uint32_t rate, int channels) { (void)rate; (void)channels; }
+void audio_eq_process(int16_t *pcm, size_t frames) { (void)pcm; (void)frames; }
+void audio_lat_mark(audio_lat_stage_t stage) { (void)stage; }
+void audio_lat_i2s(const void *buf, size_t len) { (void)buf; (void)len; }
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <stddef.h>
+
+size_t stub_ring_take(void *dst, size_t max);  // 当送数任务 从环形缓冲取走最多max字节
@@ -0,0 +1,164 @@
+/* 主机端测试 环形缓冲写满时变速和重采样的输出一帧不丢
+ * 同一段输入跑两遍: 一遍小块写 每次写完都取空 缓冲从不满
+ * 另一遍大块写 每次只取走一点 写入总是超时 按汇报的字节数接着写 像播放器那样
+ * 两遍取出来的数据要一模一样 变速时只比两遍都有的部分 见check()
+ * 另外看交叉淡化混音在中段不会溢出绕回 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "audio_pcm.h"
+#include "audio_tstretch.h"
+#include "pcm_stubs.h"
+
+#define IN_RATE         44100
+#define IN_FRAMES       (IN_RATE * 2)
+#define SMALL_FRAMES    32          // 小块 输出远小于缓冲
+#define BIG_FRAMES      4096
+#define SLOW_TAKE       1000        // 慢的一遍每次写完只取走这么多字节
+#define RING_MS         20
+
+static int16_t *s_src;
+static int16_t *s_in;
+
+// 写一遍 返回取出来的字节数 slow时缓冲总是满的
+static size_t run(int speed, uint32_t out_rate, bool slow, uint8_t *out, size_t out_max, uint32_t *timeouts)
+{
+    audio_pcm_stats_t st;
+    audio_pcm_get_stats(&st);
+    uint32_t t0 = st.timeouts;
+
+    audio_pcm_set_speed(speed);
+    audio_pcm_set_output_rate(out_rate);
+    audio_pcm_set_fs(IN_RATE, 16, I2S_SLOT_MODE_STEREO);
+    size_t got = stub_ring_take(out, out_max);   // 上一遍的都取走了 这里应该是空的
+
+    size_t pos = 0;
+    for (int idle = 0; idle < 4;)
+    {
+        size_t frames = IN_FRAMES - pos;
+        size_t step = slow ? BIG_FRAMES : SMALL_FRAMES;
+        frames = frames < step ? frames : step;
+        memcpy(s_in, s_src + pos * 2, frames * 2 * sizeof(int16_t));   // 写入会原地处理 每次从原始数据拷
+        size_t written = 0;
+        audio_pcm_write(s_in, frames * 2 * sizeof(int16_t), &written, 0);
+        pos += written / (2 * sizeof(int16_t));
+        size_t n = stub_ring_take(out + got, slow ? SLOW_TAKE : out_max - got);
+        got += n;
+        // 输入写完以后再空写几次 留着的尾巴写完了 也取空了才算完
+        idle = (pos == IN_FRAMES && n == 0) ? idle + 1 : 0;
+    }
+
+    audio_pcm_get_stats(&st);
+    *timeouts = st.timeouts - t0;
+    return got;
+}
+
+static int check(int speed, uint32_t out_rate)
+{
+    size_t out_max = (size_t)IN_FRAMES * 2 * sizeof(int16_t) * 4;
+    uint8_t *ref = calloc(1, out_max);
+    uint8_t *full = calloc(1, out_max);
+    uint32_t ref_timeouts = 0;
+    uint32_t full_timeouts = 0;
+    size_t ref_len = run(speed, out_rate, false, ref, out_max, &ref_timeouts);
+    size_t full_len = run(speed, out_rate, true, full, out_max, &full_timeouts);
+
+    // 变速级攒着的输入要等下一次写入才出 输入写完时攒了多少跟分块有关 尾巴可以差这么多
+    size_t hold = speed != 100 ? TSTRETCH_BUF_FRAMES * 2 * sizeof(int16_t) * 2 : 0;
+    size_t len = ref_len < full_len ? ref_len : full_len;
+    size_t diff = ref_len > full_len ? ref_len - full_len : full_len - ref_len;
+
+    int fail = 0;
+    if (ref_timeouts != 0)
+    {
+        printf("speed %d out %lu: reference run hit a full ring\n", speed, (unsigned long)out_rate);
+        fail = 1;
+    }
+    else if (full_timeouts == 0)
+    {
+        printf("speed %d out %lu: ring never filled\n", speed, (unsigned long)out_rate);
+        fail = 1;
+    }
+    else if (diff > hold || memcmp(ref, full, len) != 0)
+    {
+        size_t i = 0;
+        while (i < len && ref[i] == full[i])
+        {
+            i++;
+        }
+        printf("speed %d out %lu: %zu bytes vs %zu with a full ring, first difference at %zu\n",
+               speed, (unsigned long)out_rate, ref_len, full_len, i);
+        fail = 1;
+    }
+    else
+    {
+        printf("speed %d out %lu: %zu bytes match, %lu full-ring timeouts\n",
+               speed, (unsigned long)out_rate, len, (unsigned long)full_timeouts);
+    }
+    free(ref);
+    free(full);
+    return fail;
+}
+
+// 交叉淡化中段两边都接近满幅时 和要饱和在满幅 不能绕成负数
+static int check_crossfade(void)
+{
+    enum { FRAMES = 256, FADE = 1024 };
+    static int16_t out[FRAMES * 2], in[FRAMES * 2];
+    for (int i = 0; i < FRAMES * 2; i++)
+    {
+        out[i] = 30000;
+        in[i] = 30000;
+    }
+    // 从+1个样本开始 out不是16字节对齐 走逐个加的那段
+    audio_pcm_crossfade_mix(out + 2, in + 2, FRAMES - 1, FADE / 2 - FRAMES / 2, FADE);
+    for (int i = 2; i < FRAMES * 2; i++)
+    {
+        if (out[i] < 30000)
+        {
+            printf("crossfade: sample %d is %d, the sum wrapped\n", i, out[i]);
+            return 1;
+        }
+    }
+    printf("crossfade: mid-fade sum of two near full-scale inputs clips at %d\n", out[FRAMES]);
+    return 0;
+}
+
+int main(void)
+{
+    s_src = malloc(IN_FRAMES * 2 * sizeof(int16_t));
+    s_in = malloc(BIG_FRAMES * 2 * sizeof(int16_t));
+    for (int i = 0; i < IN_FRAMES; i++)
+    {
+        double t = (double)i / IN_RATE;
+        s_src[2 * i] = (int16_t)(12000 * sin(2 * M_PI * 440 * t) + 3000 * sin(2 * M_PI * 3100 * t));
+        s_src[2 * i + 1] = (int16_t)(9000 * sin(2 * M_PI * 660 * t + 1.0));
+    }
+
+    if (audio_pcm_init(RING_MS) != ESP_OK)
+    {
+        printf("audio_pcm_init failed\n");
+        return 1;
+    }
+    // 增益先渐变到满 之后两遍都是直通
+    audio_pcm_set_volume(100);
+    audio_pcm_set_mute(false);
+    audio_pcm_set_fs(IN_RATE, 16, I2S_SLOT_MODE_STEREO);
+    for (int i = 0; i < 4; i++)
+    {
+        size_t written = 0;
+        memcpy(s_in, s_src, SMALL_FRAMES * 2 * sizeof(int16_t));
+        audio_pcm_write(s_in, SMALL_FRAMES * 2 * sizeof(int16_t), &written, 0);
+        uint8_t sink[4096];
+        stub_ring_take(sink, sizeof(sink));
+    }
+
+    int fail = 0;
+    fail |= check(100, 48000);      // 只有重采样
+    fail |= check(125, 48000);      // 变速再重采样
+    fail |= check(80, 0);           // 只有变速
+    fail |= check(100, 0);          // 直接写缓冲
+    fail |= check_crossfade();
+    return fail;
+}
@@ -0,0 +1,7 @@
+/* PCM测试用的ESP-IDF替身 */
+#pragma once
+
+typedef enum {
+    I2S_SLOT_MODE_MONO = 1,
+    I2S_SLOT_MODE_STEREO = 2,
+} i2s_slot_mode_t;
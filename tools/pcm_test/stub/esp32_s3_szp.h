@@ -0,0 +1,26 @@
+/* PCM测试用的BSP替身 I2S和codec的函数在pcm_stubs.c 什么都不做 */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/i2s_std.h"
+
+#define CODEC_DEFAULT_SAMPLE_RATE    (16000)
+#define CODEC_DEFAULT_BIT_WIDTH      (16)
+#define CODEC_DEFAULT_CHANNEL        (2)
+#define BSP_I2S_DMA_DESC_NUM         8
+#define BSP_I2S_DMA_FRAME_NUM        480
+
+esp_err_t bsp_i2s_write(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+esp_err_t bsp_codec_set_fs(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch);
+bool bsp_audio_in_standby(void);
+esp_err_t bsp_codec_mute_set(bool enable);
@@ -0,0 +1,25 @@
+/* PCM测试用的ESP-IDF替身 */
+#pragma once
+
+#include "esp_log.h"
+
+#define ESP_RETURN_ON_FALSE(a, err_code, log_tag, fmt, ...) do {        \
+        if (!(a)) {                                                     \
+            ESP_LOGE(log_tag, fmt, ##__VA_ARGS__);                      \
+            return err_code;                                            \
+        }                                                               \
+    } while (0)
+#define ESP_RETURN_ON_ERROR(x, log_tag, fmt, ...) do {                  \
+        esp_err_t err_rc_ = (x);                                        \
+        if (err_rc_ != ESP_OK) {                                        \
+            ESP_LOGE(log_tag, fmt, ##__VA_ARGS__);                      \
+            return err_rc_;                                             \
+        }                                                               \
+    } while (0)
+#define ESP_GOTO_ON_FALSE(a, err_code, goto_tag, log_tag, fmt, ...) do { \
+        if (!(a)) {                                                     \
+            ESP_LOGE(log_tag, fmt, ##__VA_ARGS__);                      \
+            ret = err_code;                                             \
+            goto goto_tag;                                              \
+        }                                                               \
+    } while (0)
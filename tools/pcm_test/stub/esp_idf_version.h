@@ -0,0 +1,5 @@
+/* PCM测试用的ESP-IDF替身 esp-dsp的头文件要 */
+#pragma once
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch)    (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION                             ESP_IDF_VERSION_VAL(5, 1, 4)
@@ -0,0 +1,6 @@
+/* PCM测试用的ESP-IDF替身 跟着假的节拍走 */
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,21 @@
+/* PCM测试用的FreeRTOS替身 测试只有一个线程 不起送数任务 锁和临界区什么都不做
+ * 节拍是假的 vTaskDelay往前拨 */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int portMUX_TYPE;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE                          1
+#define pdFALSE                         0
+#define pdPASS                          pdTRUE
+#define portMAX_DELAY                   ((TickType_t)0xffffffffUL)
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portTICK_PERIOD_MS              10
+#define pdMS_TO_TICKS(ms)               ((TickType_t)((uint64_t)(ms) / portTICK_PERIOD_MS))
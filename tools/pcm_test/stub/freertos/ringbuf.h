@@ -0,0 +1,28 @@
+/* PCM测试用的FreeRTOS替身 只有字节缓冲 实现在pcm_stubs.c
+ * 满了不等 测试自己当送数任务 用stub_ring_take取走数据 */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef enum {
+    RINGBUF_TYPE_NOSPLIT = 0,
+    RINGBUF_TYPE_ALLOWSPLIT,
+    RINGBUF_TYPE_BYTEBUF,
+} RingbufferType_t;
+
+typedef struct {
+    uint8_t *storage;
+    size_t size;
+    size_t head;            // 下一个读的位置
+    size_t fill;
+    size_t lent;            // ReceiveUpTo借出去还没还的
+} StaticRingbuffer_t;
+
+typedef StaticRingbuffer_t *RingbufHandle_t;
+
+RingbufHandle_t xRingbufferCreateStatic(size_t size, RingbufferType_t type, uint8_t *storage, StaticRingbuffer_t *rb);
+BaseType_t xRingbufferSend(RingbufHandle_t rb, const void *data, size_t size, TickType_t wait);
+void *xRingbufferReceiveUpTo(RingbufHandle_t rb, size_t *size, TickType_t wait, size_t max);
+void vRingbufferReturnItem(RingbufHandle_t rb, void *item);
+void vRingbufferGetInfo(RingbufHandle_t rb, UBaseType_t *free, UBaseType_t *read, UBaseType_t *write,
+                        UBaseType_t *acquire, UBaseType_t *waiting);
@@ -0,0 +1,11 @@
+/* PCM测试用的FreeRTOS替身 只有一个线程 锁拿了就有 */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+
+#define xSemaphoreCreateMutex()         ((SemaphoreHandle_t)1)
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait) { (void)sem; (void)wait; return pdTRUE; }
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) { (void)sem; return pdTRUE; }
+#define vSemaphoreDelete(sem)           ((void)(sem))
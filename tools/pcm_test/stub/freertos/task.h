@@ -0,0 +1,10 @@
+/* PCM测试用的FreeRTOS替身 */
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
@@ -0,0 +1,7 @@
+/* PCM测试用的配置 跟板子的默认值一样 只留audio_pcm.c和它的头文件看的几项
+ * 没有CONFIG_DSP_OPTIMIZED esp-dsp走ANSI实现 */
+#pragma once
+
+#define CONFIG_APP_AUDIO_HIRES          1
+#define CONFIG_LV_DISP_DEF_REFR_PERIOD  30
+#define CONFIG_APP_SYS_TRACE_RING_KB    16
@@ -0,0 +1,499 @@
+/*
+ * 主机端UI模拟器 不接板子量每个界面的渲染时间
+ *
+ * 用法: ui_sim [-s 界面] [-n 次数] [-t 轨迹] [--budget ms] [--csv 文件] [--shot 目录] [-l] [-v]
+ *              [--sdl [--record 轨迹]]
+ *   默认每个界面: 建界面 切过去 走SIM_SETTLE_MS虚拟时间 整屏强制重画n次
+ *   -t 按触摸轨迹回放 轨迹里的界面额外统计回放期间每一帧的渲染时间 滚动 点按 动画都算
+ *   --budget 重画的平均或者回放的p95超过这么多毫秒 返回值非0 可以直接挂到CI里
+ *   --shot 每个界面停稳以后存一张PPM 改了样式可以直接比图
+ *   --sdl 开窗口用鼠标点 --record 把点的过程存成轨迹 以后无界面回放
+ *
+ * 时间是虚拟的: 每步lv_tick_inc(SIM_STEP_MS)再跑一次lv_timer_handler 动画 滚动惯性 长按都和板子上一样按tick走
+ * 同一份轨迹每次回放画的帧完全一样 只有渲染花的时间是真的
+ * 主机比ESP32-S3快得多 毫秒数只能和主机上的另一次比 看的是改动前后的相对变化
+ *
+ * 轨迹是文本 一行一条 #开头是注释:
+ *   screen <名字>        新建这个界面切过去 停稳
+ *   wait <ms>            什么都不做走这么久
+ *   press <x> <y>        按下
+ *   move <x> <y> <ms>    按着 这么久里匀速移到(x,y)
+ *   release              松开
+ *   redraw [n]           整屏重画n次 算进这个界面的重画统计
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "lvgl.h"
+#include "esp_timer.h"
+#include "ui_theme.h"
+#include "ui_perf.h"
+#include "sim_screens.h"
+#if SIM_SDL
+#include <SDL.h>
+#include "sim_sdl.h"
+#endif
+
+#define SIM_W               320
+#define SIM_H               240
+#ifdef CONFIG_APP_LCD_DRAW_BUF_HEIGHT
+#define SIM_BUF_LINES       CONFIG_APP_LCD_DRAW_BUF_HEIGHT
+#else
+#define SIM_BUF_LINES       20          // 和esp32_s3_szp.h的BSP_LCD_DRAW_BUF_HEIGHT一样
+#endif
+#define SIM_STEP_MS         5
+#define SIM_SETTLE_MS       1000        // 比ui_layer的UI_LAYER_PREPARE_MS长 快照画完了才开始量
+#define SIM_REDRAWS         20
+#define SIM_LINE_MAX        128
+
+int sim_log_level = 1;
+
+typedef struct {
+    uint32_t *us;
+    int count;
+    int cap;
+    uint64_t px;
+} sim_series_t;
+
+typedef struct {
+    const sim_screen_t *screen;
+    bool used;
+    uint32_t build_us;
+    uint32_t first_us;
+    sim_series_t redraw;
+    sim_series_t trace;
+} sim_result_t;
+
+static lv_color_t s_fb[SIM_W * SIM_H];
+static lv_color_t s_buf[2][SIM_W * SIM_BUF_LINES];
+static lv_disp_draw_buf_t s_draw_buf;
+static lv_disp_drv_t s_disp_drv;
+static lv_indev_drv_t s_indev_drv;
+static bool s_pressed;
+static lv_point_t s_point;
+
+static sim_result_t *s_results;
+static sim_result_t *s_cur;             // 正在显示的界面
+static sim_series_t *s_sink;            // 这一帧的渲染时间记到哪
+static int64_t s_render_t0;
+static uint32_t s_last_us;
+static uint32_t s_last_px;
+static uint32_t s_frames;               // ui_perf_get_totals给ui_layer用
+static uint64_t s_render_us;
+static const char *s_shot_dir;
+static FILE *s_record;
+
+static void series_add(sim_series_t *s, uint32_t us, uint32_t px)
+{
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 64;
+        s->us = realloc(s->us, s->cap * sizeof(uint32_t));
+    }
+    s->us[s->count++] = us;
+    s->px += px;
+}
+
+static int u32_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// 平均 p95 最大 毫秒
+static void series_summary(sim_series_t *s, double *avg, double *p95, double *max)
+{
+    *avg = *p95 = *max = 0;
+    if (s->count == 0) {
+        return;
+    }
+    qsort(s->us, s->count, sizeof(uint32_t), u32_cmp);
+    uint64_t sum = 0;
+    for (int i = 0; i < s->count; i++) {
+        sum += s->us[i];
+    }
+    *avg = sum / 1000.0 / s->count;
+    *p95 = s->us[(s->count * 95 + 99) / 100 - 1] / 1000.0;
+    *max = s->us[s->count - 1] / 1000.0;
+}
+
+static void disp_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_p)
+{
+    int w = lv_area_get_width(area);
+    for (int y = area->y1; y <= area->y2; y++) {
+        memcpy(&s_fb[y * SIM_W + area->x1], color_p, w * sizeof(lv_color_t));
+        color_p += w;
+    }
+    lv_disp_flush_ready(drv);
+}
+
+static void disp_render_start(lv_disp_drv_t *drv)
+{
+    s_render_t0 = esp_timer_get_time();
+}
+
+// 一次刷新的所有区域都画完送出去以后
+static void disp_monitor(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+    s_last_us = esp_timer_get_time() - s_render_t0;
+    s_last_px = px;
+    s_frames++;
+    s_render_us += s_last_us;
+    if (s_sink) {
+        series_add(s_sink, s_last_us, px);
+    }
+}
+
+static void indev_read(lv_indev_drv_t *drv, lv_indev_data_t *data)
+{
+    data->point = s_point;
+    data->state = s_pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+// ui_layer.c统计滚动时的渲染占用要用 板子上在ui_perf.c
+void ui_perf_get_totals(uint32_t *frames, uint64_t *render_us)
+{
+    *frames = s_frames;
+    *render_us = s_render_us;
+}
+
+static void sim_step(uint32_t ms)
+{
+    for (uint32_t t = 0; t < ms; t += SIM_STEP_MS) {
+        lv_tick_inc(SIM_STEP_MS);
+        lv_timer_handler();
+    }
+}
+
+static void write_ppm(const char *name)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s.ppm", s_shot_dir, name);
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", SIM_W, SIM_H);
+    for (int i = 0; i < SIM_W * SIM_H; i++) {
+        uint32_t c = lv_color_to32(s_fb[i]);
+        uint8_t rgb[3] = {c >> 16, c >> 8, c};
+        fwrite(rgb, 1, 3, f);
+    }
+    fclose(f);
+}
+
+// 新建界面切过去 删掉旧的 停稳
+static void screen_open(sim_result_t *r)
+{
+    lv_obj_t *old = lv_scr_act();
+    int64_t t0 = esp_timer_get_time();
+    lv_obj_t *scr = lv_obj_create(NULL);
+    r->screen->build(scr);
+    r->build_us = esp_timer_get_time() - t0;
+    lv_scr_load(scr);
+    lv_obj_del(old);
+    s_cur = r;
+    r->used = true;
+    s_sink = NULL;
+    s_last_us = 0;
+    lv_refr_now(NULL);
+    r->first_us = s_last_us;
+    sim_step(SIM_SETTLE_MS);
+    if (s_shot_dir) {
+        write_ppm(r->screen->name);
+    }
+    if (s_record) {
+        fprintf(s_record, "screen %s\n", r->screen->name);
+    }
+}
+
+static void screen_redraw(sim_result_t *r, int n)
+{
+    s_sink = &r->redraw;
+    for (int i = 0; i < n; i++) {
+        lv_obj_invalidate(lv_scr_act());
+        lv_refr_now(NULL);
+    }
+    s_sink = NULL;
+}
+
+static sim_result_t *result_of(const sim_screen_t *screen)
+{
+    return &s_results[screen - sim_screens];
+}
+
+static int trace_run(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+    char line[SIM_LINE_MAX];
+    char name[64];
+    int lineno = 0;
+    int x, y, ms, n;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        if (sscanf(p, "screen %63s", name) == 1) {
+            const sim_screen_t *screen = sim_screen_find(name);
+            if (screen == NULL) {
+                fprintf(stderr, "%s:%d: no screen %s (ui_sim -l)\n", path, lineno, name);
+                fclose(f);
+                return -1;
+            }
+            screen_open(result_of(screen));
+            continue;
+        }
+        if (s_cur == NULL) {
+            fprintf(stderr, "%s:%d: a trace starts with a screen line\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+        s_sink = &s_cur->trace;
+        if (sscanf(p, "wait %d", &ms) == 1) {
+            sim_step(ms);
+        } else if (sscanf(p, "press %d %d", &x, &y) == 2) {
+            s_point = (lv_point_t){x, y};
+            s_pressed = true;
+            sim_step(SIM_STEP_MS);
+        } else if (sscanf(p, "move %d %d %d", &x, &y, &ms) == 3) {
+            lv_point_t from = s_point;
+            int steps = ms / SIM_STEP_MS > 0 ? ms / SIM_STEP_MS : 1;
+            for (int i = 1; i <= steps; i++) {
+                s_point.x = from.x + (x - from.x) * i / steps;
+                s_point.y = from.y + (y - from.y) * i / steps;
+                sim_step(SIM_STEP_MS);
+            }
+        } else if (strncmp(p, "release", 7) == 0) {
+            s_pressed = false;
+            sim_step(SIM_STEP_MS);
+        } else if (strncmp(p, "redraw", 6) == 0) {
+            n = 1;
+            sscanf(p, "redraw %d", &n);
+            screen_redraw(s_cur, n);
+        } else {
+            fprintf(stderr, "%s:%d: cannot parse: %s", path, lineno, p);
+            fclose(f);
+            return -1;
+        }
+        s_sink = NULL;
+    }
+    fclose(f);
+    return 0;
+}
+
+#if SIM_SDL
+// 实时跑 鼠标当触摸 录轨迹时每帧按着的位置变了记一条move
+static void sdl_run(int first)
+{
+    if (!sim_sdl_init(SIM_W, SIM_H, 2)) {
+        return;
+    }
+    int index = first;
+    screen_open(&s_results[index]);
+    sim_sdl_input_t in = {0};
+    bool was_pressed = false;
+    lv_point_t last = {0, 0};
+    uint32_t idle_ms = 0;
+    int64_t t_prev = esp_timer_get_time();
+    while (sim_sdl_poll(&in)) {
+        if (in.screen_step) {
+            index = (index + in.screen_step + sim_screen_count) % sim_screen_count;
+            screen_open(&s_results[index]);
+            idle_ms = 0;
+        }
+        s_pressed = in.pressed;
+        s_point = (lv_point_t){in.x, in.y};
+        if (s_record) {
+            if (s_pressed != was_pressed || (s_pressed && (last.x != in.x || last.y != in.y))) {
+                if (idle_ms && !(s_pressed && was_pressed)) {
+                    fprintf(s_record, "wait %u\n", (unsigned)idle_ms);
+                }
+                if (s_pressed && !was_pressed) {
+                    fprintf(s_record, "press %d %d\n", in.x, in.y);
+                } else if (s_pressed) {
+                    fprintf(s_record, "move %d %d %u\n", in.x, in.y, (unsigned)(idle_ms ? idle_ms : SIM_STEP_MS));
+                } else {
+                    fprintf(s_record, "release\n");
+                }
+                idle_ms = 0;
+                last = s_point;
+            }
+            was_pressed = s_pressed;
+        }
+        s_sink = &s_cur->trace;
+        int64_t now = esp_timer_get_time();
+        uint32_t ms = (now - t_prev) / 1000 / SIM_STEP_MS * SIM_STEP_MS;
+        if (ms < SIM_STEP_MS) {
+            SDL_Delay(SIM_STEP_MS);
+            continue;
+        }
+        t_prev += ms * 1000;
+        idle_ms += ms;
+        sim_step(ms);
+        s_sink = NULL;
+        sim_sdl_present(s_fb);
+    }
+    sim_sdl_deinit();
+}
+#endif
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: ui_sim [-s screen] [-n redraws] [-t trace] [--budget ms] [--csv file] [--shot dir] [-l] [-v]"
+#if SIM_SDL
+                    " [--sdl [--record trace]]"
+#endif
+                    "\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *only = NULL;
+    const char *trace = NULL;
+    const char *csv = NULL;
+    const char *record = NULL;
+    double budget = 0;
+    int redraws = SIM_REDRAWS;
+    bool sdl = false;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool more = i + 1 < argc;
+        if (strcmp(a, "-s") == 0 && more) {
+            only = argv[++i];
+        } else if (strcmp(a, "-n") == 0 && more) {
+            redraws = atoi(argv[++i]);
+        } else if (strcmp(a, "-t") == 0 && more) {
+            trace = argv[++i];
+        } else if (strcmp(a, "--budget") == 0 && more) {
+            budget = atof(argv[++i]);
+        } else if (strcmp(a, "--csv") == 0 && more) {
+            csv = argv[++i];
+        } else if (strcmp(a, "--shot") == 0 && more) {
+            s_shot_dir = argv[++i];
+        } else if (strcmp(a, "--record") == 0 && more) {
+            record = argv[++i];
+        } else if (strcmp(a, "--sdl") == 0) {
+            sdl = true;
+        } else if (strcmp(a, "-v") == 0) {
+            sim_log_level = 2;
+        } else if (strcmp(a, "-l") == 0) {
+            for (int k = 0; k < sim_screen_count; k++) {
+                printf("%-14s %s\n", sim_screens[k].name, sim_screens[k].mirrors);
+            }
+            return 0;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (only && sim_screen_find(only) == NULL) {
+        fprintf(stderr, "no screen %s (ui_sim -l)\n", only);
+        return 2;
+    }
+#if !SIM_SDL
+    if (sdl || record) {
+        fprintf(stderr, "built without SDL2\n");
+        return 2;
+    }
+#endif
+    if (s_shot_dir) {
+        mkdir(s_shot_dir, 0755);
+    }
+
+    lv_init();
+    lv_disp_draw_buf_init(&s_draw_buf, s_buf[0], s_buf[1], SIM_W * SIM_BUF_LINES);
+    lv_disp_drv_init(&s_disp_drv);
+    s_disp_drv.hor_res = SIM_W;
+    s_disp_drv.ver_res = SIM_H;
+    s_disp_drv.draw_buf = &s_draw_buf;
+    s_disp_drv.flush_cb = disp_flush;
+    s_disp_drv.render_start_cb = disp_render_start;
+    s_disp_drv.monitor_cb = disp_monitor;
+    lv_disp_drv_register(&s_disp_drv);
+    lv_indev_drv_init(&s_indev_drv);
+    s_indev_drv.type = LV_INDEV_TYPE_POINTER;
+    s_indev_drv.read_cb = indev_read;
+    lv_indev_drv_register(&s_indev_drv);
+    ui_theme_init();
+
+    s_results = calloc(sim_screen_count, sizeof(sim_result_t));
+    for (int i = 0; i < sim_screen_count; i++) {
+        s_results[i].screen = &sim_screens[i];
+    }
+    if (record) {
+        s_record = fopen(record, "w");
+        if (s_record == NULL) {
+            fprintf(stderr, "cannot write %s\n", record);
+            return 2;
+        }
+        fprintf(s_record, "# recorded by ui_sim --sdl\n");
+    }
+
+    if (sdl) {
+#if SIM_SDL
+        sdl_run(only ? (int)(sim_screen_find(only) - sim_screens) : 0);
+#endif
+    } else if (trace) {
+        if (trace_run(trace) != 0) {
+            return 2;
+        }
+    }
+    if (!sdl) {
+        for (int i = 0; i < sim_screen_count; i++) {
+            if (only ? strcmp(only, sim_screens[i].name) == 0 : !trace || !s_results[i].used) {
+                screen_open(&s_results[i]);
+                screen_redraw(&s_results[i], redraws);
+            }
+        }
+    }
+    if (s_record) {
+        fclose(s_record);
+    }
+
+    FILE *out = csv ? fopen(csv, "w") : NULL;
+    if (out) {
+        fprintf(out, "screen,build_ms,first_ms,redraws,redraw_avg_ms,redraw_p95_ms,redraw_max_ms,"
+                     "trace_frames,trace_avg_ms,trace_p95_ms,trace_max_ms,trace_px_per_frame\n");
+    }
+    printf("%-14s %8s %8s %26s %26s %9s\n", "screen", "build", "first", "redraw avg/p95/max",
+           "trace frames avg/p95/max", "px/frame");
+    int over = 0;
+    for (int i = 0; i < sim_screen_count; i++) {
+        sim_result_t *r = &s_results[i];
+        if (!r->used) {
+            continue;
+        }
+        double ra, rp, rm, ta, tp, tm;
+        series_summary(&r->redraw, &ra, &rp, &rm);
+        series_summary(&r->trace, &ta, &tp, &tm);
+        uint32_t px = r->trace.count ? r->trace.px / r->trace.count : 0;
+        char trace_col[40] = "-";
+        if (r->trace.count) {
+            snprintf(trace_col, sizeof(trace_col), "%5d %6.2f/%6.2f/%6.2f", r->trace.count, ta, tp, tm);
+        }
+        printf("%-14s %8.2f %8.2f %8.2f/%8.2f/%8.2f %26s %9u\n", r->screen->name, r->build_us / 1000.0,
+               r->first_us / 1000.0, ra, rp, rm, trace_col, (unsigned)px);
+        if (out) {
+            fprintf(out, "%s,%.3f,%.3f,%d,%.3f,%.3f,%.3f,%d,%.3f,%.3f,%.3f,%u\n", r->screen->name,
+                    r->build_us / 1000.0, r->first_us / 1000.0, r->redraw.count, ra, rp, rm, r->trace.count, ta, tp,
+                    tm, (unsigned)px);
+        }
+        if (budget > 0 && (ra > budget || tp > budget)) {
+            fprintf(stderr, "%s over budget: redraw avg %.2f ms, trace p95 %.2f ms, budget %.2f ms\n",
+                    r->screen->name, ra, tp, budget);
+            over++;
+        }
+    }
+    if (out) {
+        fclose(out);
+    }
+    return over ? 1 : 0;
+}
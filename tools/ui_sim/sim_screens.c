@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "sim_screens.h"
+#include "ui_theme.h"
+#include "ui_vlist.h"
+#include "ui_vgrid.h"
+#include "ui_marquee.h"
+#include "ui_layer.h"
+#include "ui_clock.h"
+
+LV_FONT_DECLARE(font_alipuhui20);
+LV_IMG_DECLARE(img_att_icon);
+LV_IMG_DECLARE(img_music_icon);
+LV_IMG_DECLARE(img_sd_icon);
+LV_IMG_DECLARE(img_camera_icon);
+LV_IMG_DECLARE(img_wifiset_icon);
+LV_IMG_DECLARE(img_btset_icon);
+LV_IMG_DECLARE(img_pic_icon);
+
+#define SIM_CLOCK_BASE      1792065600  // 2026-10-15 12:00:00 UTC 时钟从这里按虚拟时间走 每次跑画的都一样
+#define SIM_LIST_ROWS       2000
+#define SIM_GRID_ITEMS      600
+
+/******************************** 主界面 app_ui.c lv_main_page ********************************/
+
+// 和app_ui.c的s_apps一样的顺序 颜色和图标抄各应用的app_mod_t
+typedef struct {
+    uint32_t color;
+    const lv_img_dsc_t *icon;
+    const char *symbol;
+} sim_app_t;
+
+static const sim_app_t s_apps[] = {
+    {0x30a830, &img_att_icon, NULL},
+    {0xf87c30, &img_music_icon, NULL},
+    {0x008b8b, &img_sd_icon, NULL},
+    {0xd8b010, &img_camera_icon, NULL},
+    {0xcd5c5c, &img_wifiset_icon, NULL},
+    {0xb87fa8, &img_btset_icon, NULL},
+    {0x3c8dbc, &img_pic_icon, NULL},
+    {0x607d8b, NULL, LV_SYMBOL_SETTINGS},
+    {0xe67e22, NULL, LV_SYMBOL_AUDIO},
+    {0x2c3e50, NULL, LV_SYMBOL_EYE_OPEN},
+};
+
+static lv_obj_t *s_clock;
+static lv_obj_t *s_date;
+
+static void home_clock_cb(lv_timer_t *timer)
+{
+    time_t now = SIM_CLOCK_BASE + lv_tick_get() / 1000;
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    ui_clock_set(s_clock, &tm);
+    lv_label_set_text_fmt(s_date, "%d年%02d月%02d日", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+static void home_delete_cb(lv_event_t *e)
+{
+    lv_timer_del(lv_event_get_user_data(e));
+    s_clock = s_date = NULL;
+}
+
+// 对过时的样子: 日期加缓存字形的时钟 没对时的欢迎语跑马灯见home_marquee
+static void home_common(lv_obj_t *scr, lv_obj_t **main_out)
+{
+    lv_obj_set_style_bg_color(scr, lv_color_hex(0x000000), 0);
+    lv_obj_t *main_obj = lv_obj_create(scr);
+    lv_obj_add_style(main_obj, ui_style(UI_STYLE_MAIN), 0);
+    lv_obj_set_scroll_dir(main_obj, LV_DIR_VER);
+    lv_obj_set_scrollbar_mode(main_obj, LV_SCROLLBAR_MODE_AUTO);
+    lv_obj_set_scroll_snap_y(main_obj, LV_SCROLL_SNAP_START);
+
+    lv_obj_t *sylbom_label = lv_label_create(main_obj);
+    lv_obj_set_style_text_font(sylbom_label, &lv_font_montserrat_20, 0);
+    lv_obj_set_style_text_color(sylbom_label, lv_color_hex(0xffffff), 0);
+    lv_label_set_text(sylbom_label, LV_SYMBOL_BLUETOOTH " " LV_SYMBOL_WIFI);
+    lv_obj_align_to(sylbom_label, main_obj, LV_ALIGN_TOP_RIGHT, -10, 10);
+
+    lv_style_t *btn_style = ui_style(UI_STYLE_APP_ICON);
+    for (int i = 0; i < (int)(sizeof(s_apps) / sizeof(s_apps[0])); i++) {
+        lv_obj_t *icon = lv_btn_create(main_obj);
+        lv_obj_add_style(icon, btn_style, 0);
+        lv_obj_set_style_bg_color(icon, lv_color_hex(s_apps[i].color), 0);
+        lv_obj_set_pos(icon, 15 + i % 3 * 105, 50 + i / 3 * 97);
+
+        lv_obj_t *img = lv_img_create(icon);
+        if (s_apps[i].icon) {
+            lv_img_set_src(img, s_apps[i].icon);
+        } else {
+            lv_obj_set_style_text_font(img, &lv_font_montserrat_20, 0);
+            lv_obj_set_style_text_color(img, lv_color_hex(0xffffff), 0);
+            lv_img_set_src(img, s_apps[i].symbol);
+        }
+        lv_obj_align(img, LV_ALIGN_CENTER, 0, 0);
+        ui_layer_add(icon);
+    }
+    *main_out = main_obj;
+}
+
+static void home_build(lv_obj_t *scr)
+{
+    lv_obj_t *main_obj;
+    home_common(scr, &main_obj);
+    s_clock = ui_clock_create(main_obj, &font_alipuhui20);
+    s_date = lv_label_create(main_obj);
+    lv_obj_set_style_text_font(s_date, &font_alipuhui20, 0);
+    lv_obj_set_style_text_color(s_date, lv_color_hex(0xffffff), 0);
+    lv_obj_align(s_date, LV_ALIGN_TOP_LEFT, 10, 5);
+    lv_timer_t *timer = lv_timer_create(home_clock_cb, 1000, NULL);
+    home_clock_cb(timer);
+    if (s_clock) {
+        ui_clock_set_color(s_clock, lv_color_hex(0xffffff));
+        lv_obj_align_to(s_clock, s_date, LV_ALIGN_OUT_RIGHT_MID, 10, 0);
+    }
+    lv_obj_add_event_cb(main_obj, home_delete_cb, LV_EVENT_DELETE, timer);
+}
+
+static void home_marquee_build(lv_obj_t *scr)
+{
+    lv_obj_t *main_obj;
+    home_common(scr, &main_obj);
+    lv_obj_t *label = ui_marquee_create(main_obj);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_set_width(label, 280);
+    ui_marquee_set_text(label, "欢迎使用立创实战派开发板");
+    lv_obj_align_to(label, main_obj, LV_ALIGN_TOP_LEFT, 8, 5);
+}
+
+/******************************** 应用界面的公共部分 ui_screen.c ********************************/
+
+static lv_obj_t *app_root(lv_obj_t *scr, uint32_t title_color, const char *title)
+{
+    lv_obj_set_style_bg_color(scr, lv_color_hex(0x000000), 0);
+    lv_obj_t *root = lv_obj_create(scr);
+    lv_obj_add_style(root, ui_style(UI_STYLE_SCREEN), 0);
+
+    lv_obj_t *bar = lv_obj_create(root);
+    lv_obj_add_style(bar, ui_style(UI_STYLE_TITLE), 0);
+    lv_obj_align(bar, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_set_style_bg_color(bar, lv_color_hex(title_color), 0);
+    lv_obj_t *label = lv_label_create(bar);
+    lv_label_set_text(label, title);
+    lv_obj_set_style_text_color(label, lv_color_hex(0xffffff), 0);
+    lv_obj_set_style_text_font(label, &font_alipuhui20, 0);
+    lv_obj_align(label, LV_ALIGN_CENTER, 0, 0);
+
+    lv_obj_t *back = lv_btn_create(bar);
+    lv_obj_align(back, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_add_style(back, ui_style(UI_STYLE_BACK_BTN), 0);
+    lv_obj_t *arrow = lv_label_create(back);
+    lv_label_set_text(arrow, LV_SYMBOL_LEFT);
+    lv_obj_add_style(arrow, ui_style(UI_STYLE_BACK_LABEL), 0);
+    lv_obj_align(arrow, LV_ALIGN_CENTER, -10, 0);
+    return root;
+}
+
+/******************************** 文件浏览 app_sdcard.c ********************************/
+
+static const char *const s_names[] = {
+    "音乐", "照片", "录音", "周杰伦 - 晴天.mp3", "陈奕迅 - 十年.flac", "pic_1015_120000.jpg",
+    "memo_1015_080000.wav", "说明书.txt", "playlist.m3u", "video_0101.avi",
+};
+
+static void sd_text(int index, char *buf, size_t len)
+{
+    snprintf(buf, len, "%03d %s", index, s_names[index % (sizeof(s_names) / sizeof(s_names[0]))]);
+}
+
+static const char *sd_icon(int index)
+{
+    static const char *const icons[] = {LV_SYMBOL_DIRECTORY, LV_SYMBOL_AUDIO, LV_SYMBOL_IMAGE, LV_SYMBOL_FILE};
+    return icons[index % 4];
+}
+
+static void sdcard_build(lv_obj_t *scr)
+{
+    lv_obj_t *root = app_root(scr, 0x008b8b, "SD卡");
+    lv_obj_t *list = ui_vlist_create(root, 320, 200, 40, sd_text, NULL);
+    lv_obj_align(list, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_border_width(list, 0, 0);
+    lv_obj_set_style_text_font(list, &font_alipuhui20, 0);
+    ui_vlist_set_icons(list, sd_icon, &lv_font_montserrat_24);
+    ui_vlist_set_count(list, SIM_LIST_ROWS);
+}
+
+/******************************** 缩略图网格 app_gallery.c ********************************/
+
+// 96x72的假缩略图 一张渐变图所有格子共用 和真缩略图一样是不带透明的RGB565
+static lv_color_t s_thumb_px[96 * 72];
+static lv_img_dsc_t s_thumb = {
+    .header.cf = LV_IMG_CF_TRUE_COLOR,
+    .header.w = 96,
+    .header.h = 72,
+    .data_size = sizeof(s_thumb_px),
+    .data = (const uint8_t *)s_thumb_px,
+};
+
+static void grid_bind(lv_obj_t *grid, int cell, int index, lv_obj_t *img)
+{
+    lv_img_set_src(img, index < 0 ? NULL : &s_thumb);
+    lv_obj_center(img);
+}
+
+static void gallery_build(lv_obj_t *scr)
+{
+    for (int y = 0; y < 72; y++) {
+        for (int x = 0; x < 96; x++) {
+            s_thumb_px[y * 96 + x] = lv_color_make(x * 255 / 95, y * 255 / 71, 128);
+        }
+    }
+    lv_obj_t *root = app_root(scr, 0x808080, "图片浏览器");
+    lv_obj_t *grid = ui_vgrid_create(root, 320, 200, 3, 80, grid_bind, NULL);
+    lv_obj_align(grid, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_radius(grid, 0, 0);
+    lv_obj_set_style_border_width(grid, 0, 0);
+    ui_vgrid_set_count(grid, SIM_GRID_ITEMS);
+}
+
+/******************************** WiFi密码 app_wifi.c ********************************/
+
+static void wifi_btn(lv_obj_t *parent, lv_align_t align, lv_coord_t x, lv_coord_t y, lv_coord_t w, const char *text)
+{
+    lv_obj_t *btn = lv_btn_create(parent);
+    lv_obj_align(btn, align, x, y);
+    lv_obj_set_width(btn, w);
+    lv_obj_t *label = lv_label_create(btn);
+    lv_label_set_text(label, text);
+    lv_obj_set_style_text_font(label, &lv_font_montserrat_20, 0);
+    lv_obj_center(label);
+}
+
+static void wifi_build(lv_obj_t *scr)
+{
+    lv_obj_t *page = lv_obj_create(scr);
+    lv_obj_add_style(page, ui_style(UI_STYLE_PAGE), 0);
+
+    lv_obj_t *name = lv_label_create(page);
+    lv_obj_set_style_text_font(name, &lv_font_montserrat_20, 0);
+    lv_label_set_text(name, "HomeWiFi-5G");
+    lv_obj_align(name, LV_ALIGN_TOP_MID, 0, 10);
+
+    lv_obj_t *ta = lv_textarea_create(page);
+    lv_obj_set_style_text_font(ta, &lv_font_montserrat_20, 0);
+    lv_textarea_set_one_line(ta, true);
+    lv_textarea_set_placeholder_text(ta, "password");
+    lv_obj_set_width(ta, 150);
+    lv_obj_align(ta, LV_ALIGN_TOP_LEFT, 10, 40);
+    lv_obj_add_state(ta, LV_STATE_FOCUSED);
+    wifi_btn(page, LV_ALIGN_TOP_LEFT, 170, 40, 65, "OK");
+    wifi_btn(page, LV_ALIGN_TOP_LEFT, 245, 40, 65, LV_SYMBOL_BACKSPACE);
+
+    static const char *const opts[] = {
+        "0\n1\n2\n3\n4\n5\n6\n7\n8\n9",
+        "a\nb\nc\nd\ne\nf\ng\nh\ni\nj\nk\nl\nm\nn\no\np\nq\nr\ns\nt\nu\nv\nw\nx\ny\nz",
+        "A\nB\nC\nD\nE\nF\nG\nH\nI\nJ\nK\nL\nM\nN\nO\nP\nQ\nR\nS\nT\nU\nV\nW\nX\nY\nZ",
+    };
+    static const uint16_t selected[] = {5, 15, 15};
+    for (int i = 0; i < 3; i++) {
+        lv_obj_t *roller = lv_roller_create(page);
+        lv_obj_add_style(roller, ui_style(UI_STYLE_ROLLER), 0);
+        lv_obj_set_style_bg_opa(roller, LV_OPA_50, LV_PART_SELECTED);
+        lv_roller_set_options(roller, opts[i], LV_ROLLER_MODE_INFINITE);
+        lv_roller_set_visible_row_count(roller, 3);
+        lv_roller_set_selected(roller, selected[i], LV_ANIM_OFF);
+        lv_obj_set_width(roller, 90);
+        lv_obj_set_style_text_font(roller, &lv_font_montserrat_20, 0);
+        lv_obj_align(roller, LV_ALIGN_BOTTOM_LEFT, 15 + i * 100, -53);
+        ui_roller_fade(roller);
+        wifi_btn(page, LV_ALIGN_BOTTOM_LEFT, 15 + i * 100, -10, 90, LV_SYMBOL_OK);
+    }
+}
+
+/******************************** 搜索键盘 app_sdcard.c sd_search_open ********************************/
+
+static void search_build(lv_obj_t *scr)
+{
+    lv_obj_t *root = app_root(scr, 0x008b8b, "");
+    lv_obj_t *ta = lv_textarea_create(lv_obj_get_child(root, 0));
+    lv_textarea_set_one_line(ta, true);
+    lv_textarea_set_text(ta, "晴天");
+    lv_obj_set_style_text_font(ta, &font_alipuhui20, 0);
+    lv_obj_set_size(ta, 200, 36);
+    lv_obj_align(ta, LV_ALIGN_LEFT_MID, 62, 0);
+    lv_obj_add_state(ta, LV_STATE_FOCUSED);
+    lv_obj_t *list = ui_vlist_create(root, 320, 80, 40, sd_text, NULL);
+    lv_obj_align(list, LV_ALIGN_TOP_LEFT, 0, 40);
+    lv_obj_set_style_text_font(list, &font_alipuhui20, 0);
+    ui_vlist_set_count(list, 12);
+    lv_obj_t *kb = lv_keyboard_create(root);
+    lv_obj_set_size(kb, 320, 120);
+    lv_obj_align(kb, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_keyboard_set_textarea(kb, ta);
+}
+
+const sim_screen_t sim_screens[] = {
+    {"home", "app_ui.c", home_build},
+    {"home_marquee", "app_ui.c", home_marquee_build},
+    {"sdcard", "app_sdcard.c", sdcard_build},
+    {"gallery", "app_gallery.c", gallery_build},
+    {"wifi", "app_wifi.c", wifi_build},
+    {"search", "app_sdcard.c", search_build},
+};
+const int sim_screen_count = sizeof(sim_screens) / sizeof(sim_screens[0]);
+
+const sim_screen_t *sim_screen_find(const char *name)
+{
+    for (int i = 0; i < sim_screen_count; i++) {
+        if (strcmp(sim_screens[i].name, name) == 0) {
+            return &sim_screens[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "lvgl.h"
+
+
+/*********************** 模拟器里的界面 ****************************/
+// 每个界面照着对应的app_xxx.c搭 样式和控件用main/里的同一份代码 数据换成编出来的假数据
+// 应用的布局改了这里也跟着改 不然量出来的就不是板子上画的东西
+
+typedef struct {
+    const char *name;
+    const char *mirrors;                // 照着哪个源文件搭的
+    void (*build)(lv_obj_t *scr);       // scr是新建的320x240屏幕 建完由调用的切过去
+} sim_screen_t;
+
+extern const sim_screen_t sim_screens[];
+extern const int sim_screen_count;
+
+const sim_screen_t *sim_screen_find(const char *name);
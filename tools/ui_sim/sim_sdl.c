@@ -0,0 +1,92 @@
+#include <SDL.h>
+#include "sim_sdl.h"
+
+static SDL_Window *s_win;
+static SDL_Renderer *s_ren;
+static SDL_Texture *s_tex;
+static uint32_t *s_argb;
+static int s_w, s_h, s_scale;
+
+bool sim_sdl_init(int w, int h, int scale)
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        fprintf(stderr, "SDL_Init: %s\n", SDL_GetError());
+        return false;
+    }
+    s_w = w;
+    s_h = h;
+    s_scale = scale;
+    s_win = SDL_CreateWindow("ui_sim", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, w * scale, h * scale, 0);
+    s_ren = s_win ? SDL_CreateRenderer(s_win, -1, 0) : NULL;
+    s_tex = s_ren ? SDL_CreateTexture(s_ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h) : NULL;
+    s_argb = malloc(w * h * sizeof(uint32_t));
+    if (s_tex == NULL || s_argb == NULL) {
+        fprintf(stderr, "SDL window: %s\n", SDL_GetError());
+        sim_sdl_deinit();
+        return false;
+    }
+    return true;
+}
+
+bool sim_sdl_poll(sim_sdl_input_t *in)
+{
+    SDL_Event ev;
+    in->screen_step = 0;
+    while (SDL_PollEvent(&ev)) {
+        switch (ev.type) {
+        case SDL_QUIT:
+            return false;
+        case SDL_KEYDOWN:
+            if (ev.key.keysym.sym == SDLK_ESCAPE) {
+                return false;
+            }
+            in->screen_step = ev.key.keysym.sym == SDLK_RIGHT ? 1 : ev.key.keysym.sym == SDLK_LEFT ? -1 : 0;
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            if (ev.button.button == SDL_BUTTON_LEFT) {
+                in->pressed = ev.type == SDL_MOUSEBUTTONDOWN;
+                in->x = ev.button.x / s_scale;
+                in->y = ev.button.y / s_scale;
+            }
+            break;
+        case SDL_MOUSEMOTION:
+            in->x = ev.motion.x / s_scale;
+            in->y = ev.motion.y / s_scale;
+            break;
+        }
+    }
+    in->x = in->x < 0 ? 0 : in->x >= s_w ? s_w - 1 : in->x;
+    in->y = in->y < 0 ? 0 : in->y >= s_h ? s_h - 1 : in->y;
+    return true;
+}
+
+void sim_sdl_present(const lv_color_t *fb)
+{
+    for (int i = 0; i < s_w * s_h; i++) {
+        s_argb[i] = lv_color_to32(fb[i]) | 0xFF000000;
+    }
+    SDL_UpdateTexture(s_tex, NULL, s_argb, s_w * sizeof(uint32_t));
+    SDL_RenderClear(s_ren);
+    SDL_RenderCopy(s_ren, s_tex, NULL, NULL);
+    SDL_RenderPresent(s_ren);
+}
+
+void sim_sdl_deinit(void)
+{
+    if (s_tex) {
+        SDL_DestroyTexture(s_tex);
+    }
+    if (s_ren) {
+        SDL_DestroyRenderer(s_ren);
+    }
+    if (s_win) {
+        SDL_DestroyWindow(s_win);
+    }
+    free(s_argb);
+    s_tex = NULL;
+    s_ren = NULL;
+    s_win = NULL;
+    s_argb = NULL;
+    SDL_Quit();
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+
+/*********************** SDL窗口后端 ****************************/
+// 只在找到SDL2时编进来 鼠标左键当触摸 左右方向键切界面 Esc或关窗口退出
+
+typedef struct {
+    bool pressed;
+    int x;
+    int y;
+    int screen_step;                    // 这次按了左(-1)右(+1)方向键
+} sim_sdl_input_t;
+
+bool sim_sdl_init(int w, int h, int scale);
+bool sim_sdl_poll(sim_sdl_input_t *in); // 返回false是要退出
+void sim_sdl_present(const lv_color_t *fb);
+void sim_sdl_deinit(void);
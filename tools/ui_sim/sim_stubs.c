@@ -0,0 +1,51 @@
+/*
+ * 板子上的几样东西在主机上的替身
+ *   esp_timer_get_time  单调时钟
+ *   ui_mem_*            LVGL的LV_MEM_CUSTOM 板子上是PSRAM和内部RAM两个池 这里直接用堆
+ *   font_alipuhui20_ext 编进程序的字库子集的fallback 板子上从fonts分区读 这里一个字也没有 缺的字画成方框
+ */
+#include <stdlib.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "ui_mem.h"
+#include "lvgl.h"
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void *ui_mem_alloc(size_t size)
+{
+    return malloc(size);
+}
+
+void ui_mem_free(void *ptr)
+{
+    free(ptr);
+}
+
+void *ui_mem_realloc(void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static bool ext_get_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc, uint32_t letter, uint32_t next)
+{
+    return false;
+}
+
+static const uint8_t *ext_get_glyph_bitmap(const lv_font_t *font, uint32_t letter)
+{
+    return NULL;
+}
+
+lv_font_t font_alipuhui20_ext = {
+    .get_glyph_dsc = ext_get_glyph_dsc,
+    .get_glyph_bitmap = ext_get_glyph_bitmap,
+    .subpx = LV_FONT_SUBPX_NONE,
+    .underline_position = -1,
+    .underline_thickness = 1,
+};
@@ -0,0 +1,17 @@
+/* 模拟器用的ESP-IDF替身 主机上只有一个堆 能力位都不管 */
+#pragma once
+
+#include <stdlib.h>
+#include <stddef.h>
+
+#define MALLOC_CAP_DEFAULT      (1 << 0)
+#define MALLOC_CAP_8BIT         (1 << 1)
+#define MALLOC_CAP_32BIT        (1 << 2)
+#define MALLOC_CAP_DMA          (1 << 3)
+#define MALLOC_CAP_INTERNAL     (1 << 4)
+#define MALLOC_CAP_SPIRAM       (1 << 5)
+
+#define heap_caps_malloc(size, caps)        malloc(size)
+#define heap_caps_calloc(n, size, caps)     calloc(n, size)
+#define heap_caps_realloc(ptr, size, caps)  realloc(ptr, size)
+#define heap_caps_free(ptr)                 free(ptr)
@@ -0,0 +1,16 @@
+/* 模拟器用的ESP-IDF替身 日志直接打到stderr -q时只留警告和错误 */
+#pragma once
+
+#include <stdio.h>
+#include "esp_err.h"
+
+extern int sim_log_level;               // 0错误 1警告 2信息 sim_main.c里设
+
+#define SIM_LOG(lvl, ch, tag, fmt, ...) do {                                        \
+        if (sim_log_level >= (lvl)) fprintf(stderr, ch " (%s) " fmt "\n", tag, ##__VA_ARGS__); \
+    } while (0)
+#define ESP_LOGE(tag, fmt, ...) SIM_LOG(0, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) SIM_LOG(1, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) SIM_LOG(2, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) do { if (0) fprintf(stderr, fmt, ##__VA_ARGS__); } while (0)
+#define ESP_LOGV(tag, fmt, ...) ESP_LOGD(tag, fmt, ##__VA_ARGS__)
@@ -0,0 +1,6 @@
+/* 模拟器用的ESP-IDF替身 微秒 单调时钟 */
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,13 @@
+/* 模拟器用的ESP-IDF替身 模拟器只有一个线程 临界区什么都不做 */
+#pragma once
+
+#include <stdint.h>
+
+typedef int portMUX_TYPE;
+typedef uint32_t TickType_t;
+
+#define portMUX_INITIALIZER_UNLOCKED    0
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portTICK_PERIOD_MS              1
+#define pdMS_TO_TICKS(ms)               ((TickType_t)(ms))
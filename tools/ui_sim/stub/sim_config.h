@@ -0,0 +1,6 @@
+/* 生成的sdkconfig.h最后包含这个 工程的sdkconfig比Kconfig旧时 编进来的源文件要的选项在这里补上Kconfig的默认值 */
+#pragma once
+
+#if !defined(CONFIG_APP_UI_LAYER_CACHE) && !defined(SIM_UNSET_CONFIG_APP_UI_LAYER_CACHE)
+#define CONFIG_APP_UI_LAYER_CACHE 1
+#endif